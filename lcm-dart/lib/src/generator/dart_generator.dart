@@ -222,6 +222,13 @@ class DartGenerator {
   void _generateDecodeArray(MemberDecl member, StructDecl struct) {
     final depth = member.dimensions.length;
 
+    // The innermost dimension of a numeric array is read as one typed list
+    final listMethod = _typeMapper.getDecodeListMethod(member.type.fullName);
+    if (listMethod != null) {
+      _generateDecodeTypedArray(member, listMethod);
+      return;
+    }
+
     // Initialize the array - use element type (starting from dim 1, not 0)
     _writeln('final ${member.name} = <${_getNestedListType(member, 1)}>[];');
 
@@ -263,6 +270,37 @@ class DartGenerator {
     }
   }
 
+  void _generateDecodeTypedArray(MemberDecl member, String listMethod) {
+    final depth = member.dimensions.length;
+    final innerSize = member.dimensions[depth - 1].size;
+
+    if (depth == 1) {
+      _writeln('final ${member.name} = buf.$listMethod($innerSize);');
+      return;
+    }
+
+    _writeln('final ${member.name} = <${_getNestedListType(member, 1)}>[];');
+
+    for (int d = 0; d < depth - 1; d++) {
+      final indexVar = 'i$d';
+      _writeln('for (var $indexVar = 0; $indexVar < ${member.dimensions[d].size}; $indexVar++) {');
+      _indent++;
+
+      if (d < depth - 2) {
+        final accessor = _buildAccessor(member.name, d);
+        _writeln('$accessor.add(<${_getNestedListType(member, d + 2)}>[]);');
+      }
+    }
+
+    final accessor = _buildAccessor(member.name, depth - 2);
+    _writeln('$accessor.add(buf.$listMethod($innerSize));');
+
+    for (int d = 0; d < depth - 1; d++) {
+      _indent--;
+      _writeln('}');
+    }
+  }
+
   String _buildAccessor(String name, int depth) {
     final buffer = StringBuffer(name);
     for (int d = 0; d < depth; d++) {
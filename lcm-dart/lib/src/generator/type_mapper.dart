@@ -49,6 +49,21 @@ class TypeMapper {
     };
   }
 
+  /// Get the buffer method name that decodes an array of a type into a typed
+  /// list in one call, or null if its elements are decoded one at a time
+  String? getDecodeListMethod(String lcmType) {
+    return switch (lcmType) {
+      'int8_t' => 'getInt8List',
+      'int16_t' => 'getInt16List',
+      'int32_t' => 'getInt32List',
+      'int64_t' => 'getInt64List',
+      'byte' => 'getUint8View',
+      'float' => 'getFloat32List',
+      'double' => 'getFloat64List',
+      _ => null,
+    };
+  }
+
   /// Check if a type is a numeric primitive (can use standard buffer methods)
   bool isNumericPrimitive(String lcmType) {
     return switch (lcmType) {
@@ -81,9 +81,7 @@ class LcmBuffer {
   }
 
   void putUint8List(List<int> bytes) {
-    for (var i = 0; i < bytes.length; i++) {
-      _data.setUint8(_position + i, bytes[i]);
-    }
+    uint8List.setRange(_position, _position + bytes.length, bytes);
     _position += bytes.length;
   }
 
@@ -150,11 +148,85 @@ class LcmBuffer {
   }
 
   Uint8List getUint8List(int length) {
-    final result = Uint8List(length);
+    return Uint8List.fromList(getUint8View(length));
+  }
+
+  // Array decoding methods. These fill a typed list in one pass instead of
+  // building a List of boxed values element by element.
+
+  /// Returns the next [length] bytes without copying them. The view shares
+  /// memory with the buffer, so it sees later changes to it.
+  Uint8List getUint8View(int length) {
+    _checkRange(length);
+    final result = _data.buffer.asUint8List(_data.offsetInBytes + _position, length);
+    _position += length;
+    return result;
+  }
+
+  Int8List getInt8List(int length) {
+    _checkRange(length);
+    final result = Int8List(length);
     for (var i = 0; i < length; i++) {
-      result[i] = _data.getUint8(_position + i);
+      result[i] = _data.getInt8(_position + i);
     }
     _position += length;
     return result;
   }
+
+  Int16List getInt16List(int length) {
+    _checkRange(length * 2);
+    final result = Int16List(length);
+    for (var i = 0; i < length; i++) {
+      result[i] = _data.getInt16(_position + i * 2, Endian.big);
+    }
+    _position += length * 2;
+    return result;
+  }
+
+  Int32List getInt32List(int length) {
+    _checkRange(length * 4);
+    final result = Int32List(length);
+    for (var i = 0; i < length; i++) {
+      result[i] = _data.getInt32(_position + i * 4, Endian.big);
+    }
+    _position += length * 4;
+    return result;
+  }
+
+  Int64List getInt64List(int length) {
+    _checkRange(length * 8);
+    final result = Int64List(length);
+    for (var i = 0; i < length; i++) {
+      result[i] = _data.getInt64(_position + i * 8, Endian.big);
+    }
+    _position += length * 8;
+    return result;
+  }
+
+  Float32List getFloat32List(int length) {
+    _checkRange(length * 4);
+    final result = Float32List(length);
+    for (var i = 0; i < length; i++) {
+      result[i] = _data.getFloat32(_position + i * 4, Endian.big);
+    }
+    _position += length * 4;
+    return result;
+  }
+
+  Float64List getFloat64List(int length) {
+    _checkRange(length * 8);
+    final result = Float64List(length);
+    for (var i = 0; i < length; i++) {
+      result[i] = _data.getFloat64(_position + i * 8, Endian.big);
+    }
+    _position += length * 8;
+    return result;
+  }
+
+  void _checkRange(int length) {
+    if (length < 0 || _position + length > _data.lengthInBytes) {
+      throw RangeError('LcmBuffer needed $length bytes at $_position, '
+          'only ${_data.lengthInBytes - _position} available');
+    }
+  }
 }
@@ -149,4 +149,42 @@ void main() {
       lcm.close();
     });
   });
+
+  group('LcmBuffer', () {
+    test('decodes arrays into typed lists', () {
+      final buf = LcmBuffer(64);
+      for (final v in [1, -2, 0x12345678]) {
+        buf.putInt32(v);
+      }
+      for (final v in [0.5, -1.25]) {
+        buf.putFloat64(v);
+      }
+      buf.position = 0;
+
+      final ints = buf.getInt32List(3);
+      expect(ints, isA<Int32List>());
+      expect(ints, equals([1, -2, 0x12345678]));
+      final doubles = buf.getFloat64List(2);
+      expect(doubles, isA<Float64List>());
+      expect(doubles, equals([0.5, -1.25]));
+      expect(buf.position, equals(28));
+    });
+
+    test('returns byte arrays as views', () {
+      final data = Uint8List.fromList([1, 2, 3, 4]);
+      final buf = LcmBuffer.fromUint8List(data);
+      buf.getUint8();
+
+      final view = buf.getUint8View(2);
+      expect(view, equals([2, 3]));
+      data[1] = 9;
+      expect(view[0], equals(9));
+      expect(buf.position, equals(3));
+    });
+
+    test('throws when an array runs past the end', () {
+      final buf = LcmBuffer(8);
+      expect(() => buf.getInt32List(3), throwsA(isA<RangeError>()));
+    });
+  });
 }
@@ -0,0 +1,64 @@
+using System;
+using System.Collections.Generic;
+
+namespace LCM.LCM
+{
+    /// <summary>
+    /// A pool of byte arrays, so that providers can reassemble messages
+    /// without allocating a buffer for each one. Arrays are handed out in power
+    /// of two lengths, and a few of each length are kept for reuse.
+    /// </summary>
+    internal class BufferPool
+    {
+        private const int MAX_FREE_PER_LENGTH = 4;
+
+        // free arrays, indexed by the log2 of their length
+        private List<Stack<byte[]>> free = new List<Stack<byte[]>>();
+
+        /// <summary>
+        /// Returns an array of at least size bytes.
+        /// </summary>
+        public byte[] Acquire(int size)
+        {
+            int sizeClass = SizeClass(size);
+            lock (free)
+            {
+                if (sizeClass < free.Count && free[sizeClass].Count > 0)
+                {
+                    return free[sizeClass].Pop();
+                }
+            }
+            return new byte[1 << sizeClass];
+        }
+
+        /// <summary>
+        /// Returns an array obtained from Acquire() to the pool. The array must
+        /// not be used afterwards.
+        /// </summary>
+        public void Release(byte[] buf)
+        {
+            int sizeClass = SizeClass(buf.Length);
+            lock (free)
+            {
+                while (free.Count <= sizeClass)
+                {
+                    free.Add(new Stack<byte[]>());
+                }
+                if (free[sizeClass].Count < MAX_FREE_PER_LENGTH)
+                {
+                    free[sizeClass].Push(buf);
+                }
+            }
+        }
+
+        private static int SizeClass(int size)
+        {
+            int sizeClass = 0;
+            while ((1 << sizeClass) < size)
+            {
+                sizeClass++;
+            }
+            return sizeClass;
+        }
+    }
+}
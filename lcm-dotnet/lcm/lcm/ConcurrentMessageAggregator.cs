@@ -0,0 +1,313 @@
+using System;
+using System.Collections.Generic;
+using System.Threading;
+
+namespace LCM.LCM
+{
+    /// <summary>
+    /// Accumulates received LCM messages in a bounded lock-free queue.
+    /// <p>
+    /// This is an alternative to {@link MessageAggregator} for programs that
+    /// retrieve messages from several threads. Receiving and retrieving messages
+    /// doesn't take a lock; a lock is only taken to wake up threads waiting in
+    /// GetNextMessage.
+    /// <p>
+    /// The queue holds a fixed number of messages. What happens to a message
+    /// that arrives when it is full is set by the OverflowPolicy.
+    /// </summary>
+    public class ConcurrentMessageAggregator : LCMSubscriber
+    {
+        /// <summary>
+        /// What to do with messages that arrive while the queue is full.
+        /// </summary>
+        public enum OverflowPolicy
+        {
+            /// <summary>
+            /// Discard the oldest queued message to make room.
+            /// </summary>
+            DropOldest,
+
+            /// <summary>
+            /// Discard the arriving message.
+            /// </summary>
+            DropNewest,
+
+            /// <summary>
+            /// Keep only the most recent message; the capacity is ignored.
+            /// Subscribe one aggregator per channel to keep the latest message of each.
+            /// </summary>
+            LatestOnly
+        }
+
+        private readonly OverflowPolicy policy;
+
+        // A ring of slots, each with a sequence number telling whether it may be
+        // written or read for a given position (D. Vyukov's bounded MPMC queue).
+        private readonly int mask;
+        private readonly MessageAggregator.Message[] slots;
+        private readonly long[] sequences;
+        private long head = 0;
+        private long tail = 0;
+
+        // the message held under LatestOnly
+        private MessageAggregator.Message latest = null;
+
+        private long dropped = 0;
+
+        // threads waiting for a message, which receivers only lock to wake up
+        private readonly object signal = new object();
+        private int waiters = 0;
+
+        /// <summary>
+        /// Creates an aggregator that queues up to 1024 messages, discarding the
+        /// oldest ones when full.
+        /// </summary>
+        public ConcurrentMessageAggregator() : this(1024, OverflowPolicy.DropOldest)
+        {
+        }
+
+        /// <summary>
+        /// Constructor.
+        /// </summary>
+        /// <param name="capacity">the number of messages queued, rounded up to a power of two</param>
+        /// <param name="policy">what to do with messages that arrive while the queue is full</param>
+        public ConcurrentMessageAggregator(int capacity, OverflowPolicy policy)
+        {
+            if (capacity < 1 || capacity > (1 << 30))
+            {
+                throw new ArgumentOutOfRangeException("capacity");
+            }
+
+            int size = 1;
+            while (size < capacity)
+            {
+                size <<= 1;
+            }
+
+            this.policy = policy;
+            mask = size - 1;
+            slots = new MessageAggregator.Message[size];
+            sequences = new long[size];
+            for (int i = 0; i < size; i++)
+            {
+                sequences[i] = i;
+            }
+        }
+
+        /// <summary>
+        /// The number of received messages waiting to be retrieved. The count is
+        /// only a snapshot while messages are being received.
+        /// </summary>
+        public int MessagesAvailable
+        {
+            get
+            {
+                if (policy == OverflowPolicy.LatestOnly)
+                {
+                    return Interlocked.CompareExchange(ref latest, null, null) == null ? 0 : 1;
+                }
+                return (int) Math.Max(0, Interlocked.Read(ref tail) - Interlocked.Read(ref head));
+            }
+        }
+
+        /// <summary>
+        /// The number of messages discarded because the queue was full.
+        /// </summary>
+        public long MessagesDropped
+        {
+            get { return Interlocked.Read(ref dropped); }
+        }
+
+        private bool Offer(MessageAggregator.Message m)
+        {
+            long pos = Interlocked.Read(ref tail);
+            while (true)
+            {
+                int index = (int) pos & mask;
+                long dif = Thread.VolatileRead(ref sequences[index]) - pos;
+                if (dif == 0)
+                {
+                    if (Interlocked.CompareExchange(ref tail, pos + 1, pos) == pos)
+                    {
+                        slots[index] = m;
+                        Thread.VolatileWrite(ref sequences[index], pos + 1);
+                        return true;
+                    }
+                }
+                else if (dif < 0)
+                {
+                    return false; // full
+                }
+                pos = Interlocked.Read(ref tail);
+            }
+        }
+
+        private MessageAggregator.Message Poll()
+        {
+            if (policy == OverflowPolicy.LatestOnly)
+            {
+                return Interlocked.Exchange(ref latest, null);
+            }
+
+            long pos = Interlocked.Read(ref head);
+            while (true)
+            {
+                int index = (int) pos & mask;
+                long dif = Thread.VolatileRead(ref sequences[index]) - (pos + 1);
+                if (dif == 0)
+                {
+                    if (Interlocked.CompareExchange(ref head, pos + 1, pos) == pos)
+                    {
+                        MessageAggregator.Message m = slots[index];
+                        slots[index] = null;
+                        Thread.VolatileWrite(ref sequences[index], pos + mask + 1);
+                        return m;
+                    }
+                }
+                else if (dif < 0)
+                {
+                    return null; // empty
+                }
+                pos = Interlocked.Read(ref head);
+            }
+        }
+
+        /// <summary>
+        /// Internal method, called by LCM when a message is received.
+        /// </summary>
+        public void MessageReceived(LCM lcm, string channel, LCMDataInputStream dins)
+        {
+            MessageAggregator.Message m;
+            try
+            {
+                byte[] data = new byte[dins.Available];
+                dins.ReadFully(data);
+                m = new MessageAggregator.Message(channel, data);
+            }
+            catch (System.IO.IOException)
+            {
+                return;
+            }
+
+            switch (policy)
+            {
+                case OverflowPolicy.LatestOnly:
+                    if (Interlocked.Exchange(ref latest, m) != null)
+                    {
+                        Interlocked.Increment(ref dropped);
+                    }
+                    break;
+                case OverflowPolicy.DropNewest:
+                    if (!Offer(m))
+                    {
+                        Interlocked.Increment(ref dropped);
+                        return;
+                    }
+                    break;
+                case OverflowPolicy.DropOldest:
+                    while (!Offer(m))
+                    {
+                        if (Poll() != null)
+                        {
+                            Interlocked.Increment(ref dropped);
+                        }
+                    }
+                    break;
+            }
+
+            if (Thread.VolatileRead(ref waiters) > 0)
+            {
+                lock (signal)
+                {
+                    Monitor.PulseAll(signal);
+                }
+            }
+        }
+
+        /// <summary>
+        /// Attempt to retrieve the next received LCM message.
+        /// </summary>
+        /// <param name="timeoutMs">Max # of milliseconds to wait for a message.  If 0,
+        /// then don't wait. If less than 0, then wait indefinitely.</param>
+        /// <returns>a Message, or null if no message was received.</returns>
+        public MessageAggregator.Message GetNextMessage(long timeoutMs)
+        {
+            MessageAggregator.Message m = Poll();
+            if (m != null || timeoutMs == 0)
+            {
+                return m;
+            }
+
+            DateTime deadline = DateTime.UtcNow.AddMilliseconds(timeoutMs);
+            lock (signal)
+            {
+                Interlocked.Increment(ref waiters);
+                try
+                {
+                    while (true)
+                    {
+                        // checked after registering as a waiter, so that a
+                        // message received meanwhile isn't missed
+                        m = Poll();
+                        if (m != null)
+                        {
+                            return m;
+                        }
+
+                        if (timeoutMs < 0)
+                        {
+                            Monitor.Wait(signal);
+                        }
+                        else
+                        {
+                            TimeSpan remaining = deadline - DateTime.UtcNow;
+                            if (remaining <= TimeSpan.Zero)
+                            {
+                                return null;
+                            }
+                            Monitor.Wait(signal, remaining);
+                        }
+                    }
+                }
+                catch (ThreadInterruptedException)
+                {
+                    return null;
+                }
+                finally
+                {
+                    Interlocked.Decrement(ref waiters);
+                }
+            }
+        }
+
+        /// <summary>
+        /// Retrieves the next message, waiting if necessary.
+        /// </summary>
+        public MessageAggregator.Message GetNextMessage()
+        {
+            return GetNextMessage(-1);
+        }
+
+        /// <summary>
+        /// Retrieves up to maxMessages queued messages without waiting.
+        /// </summary>
+        /// <param name="output">list that the messages are added to, oldest first</param>
+        /// <param name="maxMessages">the most messages to retrieve</param>
+        /// <returns>the number of messages added</returns>
+        public int DrainMessages(ICollection<MessageAggregator.Message> output, int maxMessages)
+        {
+            int count = 0;
+            while (count < maxMessages)
+            {
+                MessageAggregator.Message m = Poll();
+                if (m == null)
+                {
+                    break;
+                }
+                output.Add(m);
+                count++;
+            }
+            return count;
+        }
+    }
+}
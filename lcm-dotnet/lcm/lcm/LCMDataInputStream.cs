@@ -11,6 +11,8 @@ namespace LCM.LCM
         private int pos = 0; // current index into buf.
         private int startpos; // index of first valid byte
         private int endpos; // index of byte after last valid byte
+        private byte[] scratch; // for swapping bytes on little endian machines
+        private float[] floatScratch = new float[1];
 
 		/// <summary>
         /// Returns the internal buffer representation.
@@ -93,44 +95,87 @@ namespace LCM.LCM
 		public override short ReadInt16()
 		{
 			NeedInput(2);
+            short v = (short) ((buf[pos] << 8) | buf[pos + 1]);
             pos += 2;
-			return Util.BitConverter.ToInt16(buf, pos - 2);
+			return v;
 		}
 		
 		public override ushort ReadUInt16()
 		{
-            NeedInput(2);
-            pos += 2;
-            return Util.BitConverter.ToUInt16(buf, pos - 2);
+            return (ushort) ReadInt16();
 		}
 		
 		public override int ReadInt32()
 		{
             NeedInput(4);
+            int v = (buf[pos] << 24) | (buf[pos + 1] << 16) | (buf[pos + 2] << 8) | buf[pos + 3];
             pos += 4;
-            return Util.BitConverter.ToInt32(buf, pos - 4);
+            return v;
 		}
 		
 		public override long ReadInt64()
 		{
             NeedInput(8);
-            pos += 8;
-            return Util.BitConverter.ToInt64(buf, pos - 8);
+            long hi = (uint) ReadInt32();
+            long lo = (uint) ReadInt32();
+            return (hi << 32) | lo;
 		}
 		
 		public override float ReadSingle()
 		{
-			NeedInput(4);
-            pos += 4;
-            return Util.BitConverter.ToSingle(buf, pos - 4);
+            ReadArray(floatScratch, 4, 1);
+            return floatScratch[0];
 		}
 		
 		public override double ReadDouble()
         {
-            NeedInput(8);
-            pos += 8;
-            return Util.BitConverter.ToDouble(buf, pos - 8);
+            return System.BitConverter.Int64BitsToDouble(ReadInt64());
 		}
+
+        private byte[] Scratch(int len)
+        {
+            if (scratch == null || scratch.Length < len)
+            {
+                scratch = new byte[Math.Max(len, 64)];
+            }
+            return scratch;
+        }
+
+        /// <summary>
+        /// Reads count big endian elements of elementSize bytes each into the
+        /// start of the one dimensional primitive array a, with a single copy
+        /// rather than one call per element.
+        /// </summary>
+        public void ReadArray(Array a, int elementSize, int count)
+        {
+            if (count < 0 || (long) count * elementSize > Available)
+            {
+                throw new System.IO.EndOfStreamException("LCMDataInputStream needed " + count + " elements, only " + Available + " bytes available.");
+            }
+
+            int len = count * elementSize;
+            if (len == 0)
+            {
+                return;
+            }
+            if (elementSize == 1 || !System.BitConverter.IsLittleEndian)
+            {
+                System.Buffer.BlockCopy(buf, pos, a, 0, len);
+            }
+            else
+            {
+                byte[] tmp = Scratch(len);
+                for (int i = 0; i < len; i += elementSize)
+                {
+                    for (int j = 0; j < elementSize; j++)
+                    {
+                        tmp[i + j] = buf[pos + i + elementSize - 1 - j];
+                    }
+                }
+                System.Buffer.BlockCopy(tmp, 0, a, 0, len);
+            }
+            pos += len;
+        }
 		
 		public void ReadFully(byte[] b)
 		{
@@ -170,7 +215,7 @@ namespace LCM.LCM
 			System.Text.StringBuilder sb = new System.Text.StringBuilder();
 			while (true)
 			{
-				int v = buf[pos++] & 0xff;
+				int v = ReadByte();
 				if (v == 0)
 					break;
 				sb.Append((char) v);
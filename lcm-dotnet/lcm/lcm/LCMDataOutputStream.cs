@@ -6,6 +6,7 @@ namespace LCM.LCM
 	{
         private byte[] buf;
         private int pos;
+        private float[] floatScratch = new float[1];
 
 		/// <summary>
         /// Returns the internal buffer, which may be longer than the
@@ -130,31 +131,60 @@ namespace LCM.LCM
 		
 		public override void Write(double v)
 		{
-			Write(Util.BitConverter.GetBytes(v));
+			Write(System.BitConverter.DoubleToInt64Bits(v));
 		}
 		
 		public override void Write(float v)
         {
-            Write(Util.BitConverter.GetBytes(v));
+            floatScratch[0] = v;
+            WriteArray(floatScratch, 4, 1);
 		}
 		
 		public override void Write(int v)
 		{
             EnsureSpace(4);
-            Write(Util.BitConverter.GetBytes(v));
+            buf[pos++] = (byte) (v >> 24);
+            buf[pos++] = (byte) (v >> 16);
+            buf[pos++] = (byte) (v >> 8);
+            buf[pos++] = (byte) v;
 		}
 		
 		public override void Write(long v)
 		{
-            EnsureSpace(8);
-            Write(Util.BitConverter.GetBytes(v));
+            Write((int) (v >> 32));
+            Write((int) v);
 		}
 		
 		public override void Write(short v)
 		{
             EnsureSpace(2);
-            Write(Util.BitConverter.GetBytes(v));
+            buf[pos++] = (byte) (v >> 8);
+            buf[pos++] = (byte) v;
 		}
+
+        /// <summary>
+        /// Writes the first count elements of the one dimensional primitive
+        /// array a, each elementSize bytes long, big endian with a single copy
+        /// rather than one call per element.
+        /// </summary>
+        public void WriteArray(Array a, int elementSize, int count)
+        {
+            int len = count * elementSize;
+            if (len == 0)
+            {
+                return;
+            }
+            EnsureSpace(len);
+            System.Buffer.BlockCopy(a, 0, buf, pos, len);
+            if (elementSize > 1 && System.BitConverter.IsLittleEndian)
+            {
+                for (int i = pos; i < pos + len; i += elementSize)
+                {
+                    Array.Reverse(buf, i, elementSize);
+                }
+            }
+            pos += len;
+        }
 		
 		public void WriteUTF(string s)
 		{
@@ -34,6 +34,7 @@ namespace LCM.LCM
         private int msgSeqNumber = 0;
 
         private Dictionary<SocketAddress, FragmentBuffer> fragBufs = new Dictionary<SocketAddress, FragmentBuffer>();
+        private BufferPool bufferPool = new BufferPool();
 
         private LCM lcm;
 
@@ -253,29 +254,37 @@ namespace LCM.LCM
 			internal int fragments_remaining = 0;
 			internal byte[] data = null;
 			
-			public FragmentBuffer(SocketAddress from, string channel, int msgSeqNumber, int data_size, int fragments_remaining)
+			public FragmentBuffer(SocketAddress from, string channel, int msgSeqNumber, int data_size, int fragments_remaining, byte[] data)
 			{
 				this.from = from;
 				this.channel = channel;
 				this.msgSeqNumber = msgSeqNumber;
 				this.data_size = data_size;
 				this.fragments_remaining = fragments_remaining;
-				this.data = new byte[data_size];
+				this.data = data;
 			}
 		}
+
+        private void RemoveFragmentBuffer(FragmentBuffer fbuf)
+        {
+            fragBufs.Remove(fbuf.from);
+            bufferPool.Release(fbuf.data);
+        }
 		
 		private void ReaderThreadRun()
 		{
-			byte[] packetData;
-            IPEndPoint from = new IPEndPoint(IPAddress.Any, 0);
+            // packets are received into the same array, since subscribers
+            // only see it until ReceiveMessage returns
+			byte[] packetData = new byte[65536];
+            EndPoint from = new IPEndPoint(IPAddress.Any, 0);
 			
 			readerDone = false;
 			while (!readerDone)
 			{
 				try
 				{
-					packetData = sock.Receive(ref from);
-					HandlePacket(packetData, from);
+					int packetLen = sock.Client.ReceiveFrom(packetData, ref from);
+					HandlePacket(packetData, packetLen, (IPEndPoint) from);
 				}
 				catch(SocketException ex)
 				{
@@ -308,46 +317,34 @@ namespace LCM.LCM
 			int fragmentId = ins.ReadInt16() & 0xffff;
 			int fragmentsInMsg = ins.ReadInt16() & 0xffff;
 			
-			// read entire packet payload
-			byte[] payload = new byte[ins.Available];
-			ins.ReadFully(payload);
-			
-			if (ins.Available > 0)
-			{
-				System.Console.Error.WriteLine("Unread data! " + ins.Available);
-			}
-			
-			int dataStart = 0;
-			int fragSize = payload.Length;
+			// the payload is used in place
+			int dataStart = ins.BufferOffset;
+			int fragSize = ins.Available;
 			
 			FragmentBuffer fbuf;
-            fragBufs.TryGetValue(from.Serialize(), out fbuf);
+            SocketAddress fromAddr = from.Serialize();
+            fragBufs.TryGetValue(fromAddr, out fbuf);
 			
 			if (fbuf != null && ((fbuf.msgSeqNumber != msgSeqNumber) || (fbuf.data_size != msgSize)))
 			{
-                fragBufs.Remove(fbuf.from);
+                RemoveFragmentBuffer(fbuf);
 				fbuf = null;
 			}
 			
 			if (fbuf == null && fragmentId == 0)
 			{	
-				// extract channel name
-				int channelLen = 0;
-				for (; channelLen < payload.Length; channelLen++)
-				{
-					if (payload[channelLen] == 0)
-					{
-						break;
-					}
-				}
+                if (msgSize < 0 || msgSize > (1 << 30))
+                {
+                    System.Console.Error.WriteLine("LC: dropping oversized message");
+                    return;
+                }
 
-				dataStart = channelLen + 1;
-				fragSize -= (channelLen + 1);
-				string tempStr;
-				tempStr = System.Text.Encoding.GetEncoding("US-ASCII").GetString(payload);
-				string channel = new string(tempStr.ToCharArray(), 0, channelLen);
+				// extract channel name
+				string channel = ins.ReadStringZ();
+				dataStart = ins.BufferOffset;
+				fragSize = ins.Available;
 
-                fbuf = new FragmentBuffer(from.Serialize(), channel, msgSeqNumber, msgSize, fragmentsInMsg);
+                fbuf = new FragmentBuffer(fromAddr, channel, msgSeqNumber, msgSize, fragmentsInMsg, bufferPool.Acquire(msgSize));
 
                 fragBufs.Add(fbuf.from, fbuf);
 			}
@@ -358,26 +355,26 @@ namespace LCM.LCM
 				return ;
 			}
 			
-			if (fragmentOffset + fragSize > fbuf.data_size)
+			if (fragmentOffset < 0 || (long) fragmentOffset + fragSize > fbuf.data_size)
 			{
 				System.Console.Error.WriteLine("LC: dropping invalid fragment");
-                fragBufs.Remove(fbuf.from);
+                RemoveFragmentBuffer(fbuf);
 				return ;
 			}
 			
-			Array.Copy(payload, dataStart, fbuf.data, fragmentOffset, fragSize);
+			Array.Copy(packetData, dataStart, fbuf.data, fragmentOffset, fragSize);
 			fbuf.fragments_remaining--;
 			
 			if (0 == fbuf.fragments_remaining)
 			{
 				lcm.ReceiveMessage(fbuf.channel, fbuf.data, 0, fbuf.data_size);
-                fragBufs.Remove(fbuf.from);
+                RemoveFragmentBuffer(fbuf);
 			}
 		}
 
-        private void HandlePacket(byte[] packetData, IPEndPoint from)
+        private void HandlePacket(byte[] packetData, int packetLen, IPEndPoint from)
 		{
-			LCMDataInputStream ins = new LCMDataInputStream(packetData, 0, packetData.Length);
+			LCMDataInputStream ins = new LCMDataInputStream(packetData, 0, packetLen);
 			
 			int magic = ins.ReadInt32();
             if (magic == UDPMulticastProvider.MAGIC_SHORT)
@@ -6,38 +6,137 @@ package lcm
 // #include <string.h>
 // #include <lcm/lcm.h>
 //
-// extern void goLCMCallbackHandler(void *, int, char *);
+// // A message of a batch, whose data is at offset in the data of the batch.
+// typedef struct {
+//     int id;
+//     int size;
+//     size_t offset;
+// } lcm_go_msg_t;
+//
+// // The messages handled by one call to lcm_go_handle_batch(), copied out of
+// // the receive buffers, which are only valid in the message handler.
+// typedef struct {
+//     lcm_go_msg_t *msgs;
+//     int num_msgs;
+//     int msgs_capacity;
+//     char *data;
+//     size_t data_size;
+//     size_t data_capacity;
+// } lcm_go_batch_t;
+//
+// typedef struct {
+//     lcm_subscription_t *subscription;
+//     lcm_go_batch_t *batch;
+//     int id;
+// } lcm_go_subscription_t;
 //
 // static void lcm_msg_handler(const lcm_recv_buf_t *buffer,
-//                                   const char *channel, void *userdata) {
-//      (void)userdata;
-//      goLCMCallbackHandler((void *)buffer->data, (int)buffer->data_size,
-//                           (char *)channel);
+//                             const char *channel, void *userdata) {
+//     lcm_go_subscription_t *sub = (lcm_go_subscription_t *)userdata;
+//     lcm_go_batch_t *batch = sub->batch;
+//     (void)channel;
+//
+//     // a message is handled once for each subscription to it, so a batch may
+//     // hold more messages than were asked for
+//     if (batch->num_msgs == batch->msgs_capacity) {
+//         int capacity = batch->msgs_capacity ? 2 * batch->msgs_capacity : 64;
+//         lcm_go_msg_t *msgs = (lcm_go_msg_t *)realloc(
+//             batch->msgs, capacity * sizeof(lcm_go_msg_t));
+//         if (!msgs)
+//             return;
+//         batch->msgs = msgs;
+//         batch->msgs_capacity = capacity;
+//     }
+//     if (batch->data_size + buffer->data_size > batch->data_capacity) {
+//         size_t capacity = 2 * batch->data_capacity;
+//         if (capacity < batch->data_size + buffer->data_size)
+//             capacity = batch->data_size + buffer->data_size;
+//         char *data = (char *)realloc(batch->data, capacity);
+//         if (!data)
+//             return;
+//         batch->data = data;
+//         batch->data_capacity = capacity;
+//     }
+//
+//     lcm_go_msg_t *msg = &batch->msgs[batch->num_msgs++];
+//     msg->id = sub->id;
+//     msg->size = (int)buffer->data_size;
+//     msg->offset = batch->data_size;
+//     memcpy(batch->data + batch->data_size, buffer->data, buffer->data_size);
+//     batch->data_size += buffer->data_size;
+// }
+//
+// static lcm_go_subscription_t *lcm_go_subscribe(lcm_t *lcm,
+//                                                const char *channel,
+//                                                lcm_go_batch_t *batch, int id) {
+//     lcm_go_subscription_t *sub =
+//         (lcm_go_subscription_t *)malloc(sizeof(lcm_go_subscription_t));
+//     sub->batch = batch;
+//     sub->id = id;
+//     sub->subscription = lcm_subscribe(lcm, channel, &lcm_msg_handler, sub);
+//     if (!sub->subscription) {
+//         free(sub);
+//         return NULL;
+//     }
+//     return sub;
 // }
 //
-// static lcm_subscription_t * lcm_go_subscribe(lcm_t *lcm,
-//                                              const char *channel) {
-//     return lcm_subscribe(lcm, channel, &lcm_msg_handler, NULL);
+// static int lcm_go_unsubscribe(lcm_t *lcm, lcm_go_subscription_t *sub) {
+//     int status = lcm_unsubscribe(lcm, sub->subscription);
+//     if (status == 0)
+//         free(sub);
+//     return status;
+// }
+//
+// static int lcm_go_handle_batch(lcm_t *lcm, lcm_go_batch_t *batch,
+//                                int max_msgs) {
+//     batch->num_msgs = 0;
+//     batch->data_size = 0;
+//     return lcm_handle_batch(lcm, max_msgs, -1);
+// }
+//
+// static void lcm_go_batch_destroy(lcm_go_batch_t *batch) {
+//     free(batch->msgs);
+//     free(batch->data);
+//     free(batch);
 // }
 import "C"
 
 import (
 	"errors"
+	"sync"
 	"unsafe"
 )
 
+// batchSize is the maximum number of messages that are handed from C to Go in
+// one call.
+const batchSize = 64
+
 // Subscription is a wrapper type for a subscription to an LCM channel.
 type Subscription struct {
 	ReceiveChan chan []byte // Channel on which messages to the subscribed channel are forwarded
 	Drops       int         // The number of dropped packages so far
 	channel     string
-	cPtr        *C.lcm_subscription_t
+	id          C.int
+	cPtr        *C.lcm_go_subscription_t
 }
 
-var subscriptions map[LCM]map[string]Subscription
+var (
+	// subscriptionsMutex guards subscriptions, receivers and nextID.
+	subscriptionsMutex sync.Mutex
+	subscriptions      map[LCM]map[string]Subscription
+	// receivers are the subscriptions by the ids that the C side tags the
+	// messages of a batch with, so that delivery doesn't look up channels.
+	receivers map[C.int]*Subscription
+	nextID    C.int
+	// bufferPool holds the buffers of messages that were passed to
+	// ReleaseBuffer, or that were dropped.
+	bufferPool sync.Pool
+)
 
 func init() {
 	subscriptions = make(map[LCM]map[string]Subscription)
+	receivers = make(map[C.int]*Subscription)
 }
 
 // Channel returns the LCM channel name of the subscription.
@@ -50,6 +149,7 @@ type LCM struct {
 	Errors chan error // Errors when handling incoming LCM messages
 	closed bool
 	cPtr   *C.lcm_t
+	batch  *C.lcm_go_batch_t
 }
 
 // New returns a new LCM instance using the default provider as defined in the
@@ -76,11 +176,14 @@ func NewProvider(provider string) (LCM, error) {
 	lcm := LCM{
 		Errors: make(chan error),
 		cPtr:   cPtr,
+		batch:  (*C.lcm_go_batch_t)(C.calloc(1, C.sizeof_lcm_go_batch_t)),
 	}
 
-	go lcm.handle()
-
+	subscriptionsMutex.Lock()
 	subscriptions[lcm] = make(map[string]Subscription)
+	subscriptionsMutex.Unlock()
+
+	go lcm.handle()
 
 	return lcm, nil
 }
@@ -88,22 +191,36 @@ func NewProvider(provider string) (LCM, error) {
 // Subscribe subscribes to an LCM channel with the given buffer size.
 // Whenever an incoming message is handled by LCM the encoded data is sent in
 // the form of a []byte down the ReceiveChan member of the returned
-// Subscription.
+// Subscription. Once the caller is done with a message, it may pass it to
+// ReleaseBuffer so that its memory is reused.
 func (lcm LCM) Subscribe(channel string, size int) (Subscription, error) {
 	cChannel := C.CString(channel)
 	defer C.free(unsafe.Pointer(cChannel))
 
-	cPtr := C.lcm_go_subscribe(lcm.cPtr, cChannel)
-	if cPtr == nil {
-		return Subscription{}, errors.New("could not subscribe to channel " +
-			channel)
-	}
-
 	subscription := Subscription{
 		ReceiveChan: make(chan []byte, size),
 		channel:     channel,
-		cPtr:        cPtr,
 	}
+
+	// the subscription receives as soon as the C side subscribes
+	subscriptionsMutex.Lock()
+	nextID++
+	subscription.id = nextID
+	receiver := subscription
+	receivers[subscription.id] = &receiver
+	subscriptionsMutex.Unlock()
+
+	cPtr := C.lcm_go_subscribe(lcm.cPtr, cChannel, lcm.batch, subscription.id)
+
+	subscriptionsMutex.Lock()
+	defer subscriptionsMutex.Unlock()
+	if cPtr == nil {
+		delete(receivers, subscription.id)
+		return Subscription{}, errors.New("could not subscribe to channel " +
+			channel)
+	}
+	subscription.cPtr = cPtr
+	receiver.cPtr = cPtr
 	subscriptions[lcm][channel] = subscription
 
 	return subscription, nil
@@ -111,11 +228,16 @@ func (lcm LCM) Subscribe(channel string, size int) (Subscription, error) {
 
 // Unsubscribe removes an Subscription from an LCM object.
 func (lcm LCM) Unsubscribe(subscription Subscription) error {
-	status := C.lcm_unsubscribe(lcm.cPtr, subscription.cPtr)
+	status := C.lcm_go_unsubscribe(lcm.cPtr, subscription.cPtr)
 	if status != 0 {
 		return errors.New("could not unsubsribe from " + subscription.channel)
 	}
 
+	subscriptionsMutex.Lock()
+	defer subscriptionsMutex.Unlock()
+
+	// the channel is only closed once no batch can deliver to it
+	delete(receivers, subscription.id)
 	close(subscription.ReceiveChan)
 
 	if _, ok := subscriptions[lcm][subscription.channel]; ok {
@@ -127,7 +249,14 @@ func (lcm LCM) Unsubscribe(subscription Subscription) error {
 
 // UnsubscribeAll removes all Subscriptions from an LCM object.
 func (lcm LCM) UnsubscribeAll() error {
+	subscriptionsMutex.Lock()
+	subs := make([]Subscription, 0, len(subscriptions[lcm]))
 	for _, sub := range subscriptions[lcm] {
+		subs = append(subs, sub)
+	}
+	subscriptionsMutex.Unlock()
+
+	for _, sub := range subs {
 		if err := lcm.Unsubscribe(sub); err != nil {
 			return err
 		}
@@ -183,13 +312,20 @@ func (lcm *LCM) Destroy() error {
 	lcmInstance := *lcm
 	lcm.closed = true
 
+	// the subscriptions are released while their lcm_t still exists
+	err := lcmInstance.UnsubscribeAll()
+
 	C.lcm_destroy(lcm.cPtr)
 
-	if err := lcmInstance.UnsubscribeAll(); err != nil {
+	if err != nil {
 		return err
 	}
 
+	subscriptionsMutex.Lock()
 	delete(subscriptions, lcmInstance)
+	subscriptionsMutex.Unlock()
+
+	C.lcm_go_batch_destroy(lcm.batch)
 
 	return nil
 }
@@ -198,27 +334,57 @@ func (lcm LCM) handle() {
 	defer close(lcm.Errors)
 
 	for !lcm.closed {
-		if status := C.lcm_handle(lcm.cPtr); status != 0 {
-			lcm.Errors <- errors.New("could not call lcm_handle")
+		if status := C.lcm_go_handle_batch(lcm.cPtr, lcm.batch, batchSize); status < 0 {
+			lcm.Errors <- errors.New("could not call lcm_handle_batch")
+		} else {
+			lcm.deliver()
 		}
 	}
 }
 
-//export goLCMCallbackHandler
-func goLCMCallbackHandler(data unsafe.Pointer, size C.int, name *C.char) {
-	channel := C.GoString(name)
-	buffer := C.GoBytes(data, size)
+// deliver forwards the messages of the last batch to their subscriptions.
+func (lcm LCM) deliver() {
+	batch := lcm.batch
+	if batch.num_msgs == 0 {
+		return
+	}
+	msgs := unsafe.Slice(batch.msgs, batch.num_msgs)
+	data := unsafe.Slice((*byte)(unsafe.Pointer(batch.data)), batch.data_size)
 
-	for _, subs := range subscriptions {
-		if sub, ok := subs[channel]; ok {
-			select {
-			case sub.ReceiveChan <- buffer:
-				break
-			default:
-				sub.Drops++
-			}
-		} else {
-			panic("LCM gave us a msg on a non-existing channel")
+	subscriptionsMutex.Lock()
+	defer subscriptionsMutex.Unlock()
+
+	for i := range msgs {
+		// the subscription may be gone by now
+		sub, ok := receivers[msgs[i].id]
+		if !ok {
+			continue
+		}
+
+		buffer := getBuffer(int(msgs[i].size))
+		copy(buffer, data[msgs[i].offset:])
+
+		select {
+		case sub.ReceiveChan <- buffer:
+		default:
+			sub.Drops++
+			ReleaseBuffer(buffer)
 		}
 	}
 }
+
+// getBuffer returns a buffer of the given size, reusing a released one if it's
+// big enough.
+func getBuffer(size int) []byte {
+	if buffer, ok := bufferPool.Get().(*[]byte); ok && cap(*buffer) >= size {
+		return (*buffer)[:size]
+	}
+	return make([]byte, size)
+}
+
+// ReleaseBuffer hands a message received from a ReceiveChan back, so that its
+// memory is reused for the messages received later. The message must not be
+// used after it has been released.
+func ReleaseBuffer(buffer []byte) {
+	bufferPool.Put(&buffer)
+}
@@ -100,3 +100,53 @@ func TestLCMProviderUDPM(t *testing.T) {
 func TestLCMProviderMemQ(t *testing.T) {
 	runTest(t, "memq://")
 }
+
+func TestLCMBatchDelivery(t *testing.T) {
+	lcm, err := NewProvider("memq://")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer func() {
+		if err = lcm.Destroy(); err != nil {
+			t.Fatal(err)
+		}
+	}()
+
+	// Each message of a batch goes to the subscription of its channel.
+	channels := []string{"TEST_A", "TEST_B"}
+	var subs []Subscription
+	for _, channel := range channels {
+		sub, err := lcm.Subscribe(channel, messageGoal)
+		if err != nil {
+			t.Fatal(err)
+		}
+		subs = append(subs, sub)
+	}
+
+	publishers := make([]chan<- []byte, len(channels))
+	for i, channel := range channels {
+		publishers[i], _ = lcm.Publisher(channel)
+	}
+	for i := 0; i < messageGoal; i++ {
+		publishers[i%2] <- []byte(channels[i%2])
+	}
+	for _, publisher := range publishers {
+		close(publisher)
+	}
+
+	for i, sub := range subs {
+		for received := 0; received < messageGoal/2; received++ {
+			select {
+			case <-time.After(timeout):
+				t.Fatalf("timed out after %d messages on %s", received, channels[i])
+			case data := <-sub.ReceiveChan:
+				if string(data) != channels[i] {
+					t.Fatalf("expected %q on %s but received %q", channels[i],
+						channels[i], data)
+				}
+				// Released buffers are reused for later messages.
+				ReleaseBuffer(data)
+			}
+		}
+	}
+}
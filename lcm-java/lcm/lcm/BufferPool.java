@@ -0,0 +1,53 @@
+package lcm.lcm;
+
+import java.nio.*;
+import java.util.*;
+
+/** A pool of direct byte buffers, so that providers can receive messages
+ * without allocating a buffer for each one. Buffers are handed out in power
+ * of two capacities, and a few of each capacity are kept for reuse.
+ **/
+class BufferPool
+{
+    static final int MAX_FREE_PER_CAPACITY = 4;
+
+    // free buffers, indexed by the log2 of their capacity
+    ArrayList<ArrayDeque<ByteBuffer>> free = new ArrayList<ArrayDeque<ByteBuffer>>();
+
+    /** Returns a buffer with a capacity of at least size, whose position is
+     * zero and whose limit is size.
+     **/
+    synchronized ByteBuffer acquire(int size)
+    {
+        int sizeClass = sizeClass(size);
+
+        ByteBuffer buf = null;
+        if (sizeClass < free.size())
+            buf = free.get(sizeClass).pollFirst();
+        if (buf == null)
+            buf = ByteBuffer.allocateDirect(1 << sizeClass);
+
+        buf.clear();
+        buf.limit(size);
+        return buf;
+    }
+
+    /** Returns a buffer obtained from acquire() to the pool. The buffer must
+     * not be used afterwards.
+     **/
+    synchronized void release(ByteBuffer buf)
+    {
+        int sizeClass = sizeClass(buf.capacity());
+        while (free.size() <= sizeClass)
+            free.add(new ArrayDeque<ByteBuffer>());
+
+        ArrayDeque<ByteBuffer> buffers = free.get(sizeClass);
+        if (buffers.size() < MAX_FREE_PER_CAPACITY)
+            buffers.addFirst(buf);
+    }
+
+    static int sizeClass(int size)
+    {
+        return size <= 1 ? 0 : 32 - Integer.numberOfLeadingZeros(size - 1);
+    }
+}
@@ -0,0 +1,276 @@
+package lcm.lcm;
+
+import java.io.*;
+import java.util.*;
+import java.util.concurrent.atomic.*;
+
+/**
+ * Accumulates received LCM messages in a bounded lock-free queue.
+ * <p>
+ * This is an alternative to {@link MessageAggregator} for programs that
+ * retrieve messages from several threads. Receiving and retrieving messages
+ * doesn't take a lock; a lock is only taken to wake up threads waiting in
+ * {@link #getNextMessage(long) getNextMessage}.
+ * <p>
+ * The queue holds a fixed number of messages. What happens to a message
+ * that arrives when it is full is set by the {@link OverflowPolicy}.
+ */
+public class ConcurrentMessageAggregator
+    implements LCMSubscriber
+{
+    /**
+     * What to do with messages that arrive while the queue is full.
+     */
+    public enum OverflowPolicy {
+        /** Discard the oldest queued message to make room. */
+        DROP_OLDEST,
+        /** Discard the arriving message. */
+        DROP_NEWEST,
+        /**
+         * Keep only the most recent message; the capacity is ignored.
+         * Subscribe one aggregator per channel to keep the latest message of
+         * each.
+         */
+        LATEST_ONLY
+    }
+
+    /**
+     * A received message.
+     */
+    public static class Message {
+        /**
+         * The raw data bytes of the message body.
+         */
+        final public byte[] data;
+        /**
+         * Channel on which the message was received.
+         */
+        final public String channel;
+        public Message(String channel_, byte[] data_)
+        {
+            data = data_;
+            channel = channel_;
+        }
+    }
+
+    final OverflowPolicy policy;
+
+    // A ring of slots, each with a sequence number telling whether it may be
+    // written or read for a given position (D. Vyukov's bounded MPMC queue).
+    final int mask;
+    final AtomicReferenceArray<Message> slots;
+    final AtomicLongArray sequences;
+    final AtomicLong head = new AtomicLong();
+    final AtomicLong tail = new AtomicLong();
+
+    // the message held under LATEST_ONLY
+    final AtomicReference<Message> latest = new AtomicReference<Message>();
+
+    final AtomicLong dropped = new AtomicLong();
+
+    // threads waiting for a message, which receivers only lock to wake up
+    final Object signal = new Object();
+    final AtomicInteger waiters = new AtomicInteger();
+
+    /**
+     * Creates an aggregator that queues up to 1024 messages, discarding the
+     * oldest ones when full.
+     */
+    public ConcurrentMessageAggregator()
+    {
+        this(1024, OverflowPolicy.DROP_OLDEST);
+    }
+
+    /**
+     * @param capacity the number of messages queued, rounded up to a power
+     * of two.
+     * @param policy what to do with messages that arrive while the queue is
+     * full.
+     */
+    public ConcurrentMessageAggregator(int capacity, OverflowPolicy policy)
+    {
+        if (capacity < 1 || capacity > (1 << 30))
+            throw new IllegalArgumentException("capacity must be between 1 and 2^30");
+
+        int size = Integer.highestOneBit(capacity);
+        if (size < capacity)
+            size <<= 1;
+
+        this.policy = policy;
+        mask = size - 1;
+        slots = new AtomicReferenceArray<Message>(size);
+        sequences = new AtomicLongArray(size);
+        for (int i = 0; i < size; i++)
+            sequences.set(i, i);
+    }
+
+    boolean offer(Message m)
+    {
+        long pos = tail.get();
+        while (true) {
+            int index = (int) pos & mask;
+            long dif = sequences.get(index) - pos;
+            if (dif == 0) {
+                if (tail.compareAndSet(pos, pos + 1)) {
+                    slots.set(index, m);
+                    sequences.set(index, pos + 1);
+                    return true;
+                }
+                pos = tail.get();
+            } else if (dif < 0) {
+                return false; // full
+            } else {
+                pos = tail.get();
+            }
+        }
+    }
+
+    Message poll()
+    {
+        if (policy == OverflowPolicy.LATEST_ONLY)
+            return latest.getAndSet(null);
+
+        long pos = head.get();
+        while (true) {
+            int index = (int) pos & mask;
+            long dif = sequences.get(index) - (pos + 1);
+            if (dif == 0) {
+                if (head.compareAndSet(pos, pos + 1)) {
+                    Message m = slots.getAndSet(index, null);
+                    sequences.set(index, pos + mask + 1);
+                    return m;
+                }
+                pos = head.get();
+            } else if (dif < 0) {
+                return null; // empty
+            } else {
+                pos = head.get();
+            }
+        }
+    }
+
+    /**
+     * Internal method, called by LCM when a message is received.
+     */
+    public void messageReceived(LCM lcm, String channel, LCMDataInputStream dins)
+    {
+        Message m;
+        try {
+            byte data[] = new byte[dins.available()];
+            dins.readFully(data);
+            m = new Message(channel, data);
+        } catch (IOException xcp) {
+            return;
+        }
+
+        switch (policy) {
+            case LATEST_ONLY:
+                if (latest.getAndSet(m) != null)
+                    dropped.incrementAndGet();
+                break;
+            case DROP_NEWEST:
+                if (!offer(m)) {
+                    dropped.incrementAndGet();
+                    return;
+                }
+                break;
+            case DROP_OLDEST:
+                while (!offer(m)) {
+                    if (poll() != null)
+                        dropped.incrementAndGet();
+                }
+                break;
+        }
+
+        if (waiters.get() > 0) {
+            synchronized (signal) {
+                signal.notifyAll();
+            }
+        }
+    }
+
+    /**
+     * Attempt to retrieve the next received LCM message.
+     * @param timeout_ms Max # of milliseconds to wait for a message.  If 0,
+     * then don't wait.  If less than 0, then wait indefinitely.
+     * @return a Message, or null if no message was received.
+     */
+    public Message getNextMessage(long timeout_ms)
+    {
+        Message m = poll();
+        if (m != null || timeout_ms == 0)
+            return m;
+
+        long deadline = System.nanoTime() + timeout_ms * 1000000L;
+        synchronized (signal) {
+            waiters.incrementAndGet();
+            try {
+                while (true) {
+                    // checked after registering as a waiter, so that a
+                    // message received meanwhile isn't missed
+                    m = poll();
+                    if (m != null)
+                        return m;
+
+                    if (timeout_ms < 0) {
+                        signal.wait();
+                    } else {
+                        long remaining_ms = (deadline - System.nanoTime()) / 1000000L;
+                        if (remaining_ms <= 0)
+                            return null;
+                        signal.wait(remaining_ms);
+                    }
+                }
+            } catch (InterruptedException xcp) {
+                return null;
+            } finally {
+                waiters.decrementAndGet();
+            }
+        }
+    }
+
+    /**
+     * Retrieves the next message, waiting if necessary.
+     */
+    public Message getNextMessage()
+    {
+        return getNextMessage(-1);
+    }
+
+    /**
+     * Retrieves up to max_messages queued messages without waiting.
+     * @param out collection that the messages are added to, oldest first.
+     * @return the number of messages added.
+     */
+    public int drainMessages(Collection<? super Message> out, int max_messages)
+    {
+        int count = 0;
+        while (count < max_messages) {
+            Message m = poll();
+            if (m == null)
+                break;
+            out.add(m);
+            count++;
+        }
+        return count;
+    }
+
+    /**
+     * Returns the number of received messages waiting to be retrieved. The
+     * count is only a snapshot while messages are being received.
+     */
+    public int numMessagesAvailable()
+    {
+        if (policy == OverflowPolicy.LATEST_ONLY)
+            return latest.get() == null ? 0 : 1;
+        return (int) Math.max(0, tail.get() - head.get());
+    }
+
+    /**
+     * Returns the number of messages discarded because the queue was full.
+     */
+    public long getNumDropped()
+    {
+        return dropped.get();
+    }
+}
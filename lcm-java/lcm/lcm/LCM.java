@@ -31,15 +31,26 @@ public class LCM
     }
 
     ArrayList<SubscriptionRecord> subscriptions = new ArrayList<SubscriptionRecord>();
-    ArrayList<Provider> providers = new ArrayList<Provider>();
+    // not changed after the constructor until close(), which sets it to null
+    volatile ArrayList<Provider> providers = new ArrayList<Provider>();
 
     HashMap<String,ArrayList<SubscriptionRecord>> subscriptionsMap = new HashMap<String,ArrayList<SubscriptionRecord>>();
 
-    boolean closed = false;
+    volatile boolean closed = false;
 
     static LCM singleton;
 
-    LCMDataOutputStream encodeBuffer = new LCMDataOutputStream(new byte[1024]);
+    // each publishing thread encodes into its own buffer, so that threads
+    // only wait on each other in the providers
+    ThreadLocal<LCMDataOutputStream> encodeBuffers = new ThreadLocal<LCMDataOutputStream>() {
+        protected LCMDataOutputStream initialValue() {
+            return new LCMDataOutputStream(new byte[1024]);
+        }
+    };
+
+    // the copy of a received buffer for subscribers that read arrays,
+    // guarded by the subscriptions lock
+    byte receiveBuffer[] = new byte[1024];
 
     /** Create a new LCM object, connecting to one or more URLs. If
      * no URL is specified, the environment variable LCM_DEFAULT_URL is
@@ -115,13 +126,16 @@ public class LCM
     }
 
     /** Publish an LCM-defined type on a channel. If more than one URL was
-     * specified, the message will be sent on each.
+     * specified, the message will be sent on each. This may be called
+     * from several threads at once; each thread encodes into its own
+     * buffer.
      **/
-    public synchronized void publish(String channel, LCMEncodable e)
+    public void publish(String channel, LCMEncodable e)
     {
         if (this.closed) throw new IllegalStateException();
 
         try {
+            LCMDataOutputStream encodeBuffer = encodeBuffers.get();
             encodeBuffer.reset();
 
             e.encode(encodeBuffer);
@@ -134,12 +148,15 @@ public class LCM
 
     /** Publish raw data on a channel, bypassing the LCM type
      * specification. If more than one URL was specified when the LCM
-     * object was created, the message will be sent on each.
+     * object was created, the message will be sent on each. Each
+     * provider serializes its own sends, so publishing threads don't wait
+     * on each other otherwise.
      **/
-    public synchronized void publish(String channel, byte[] data, int offset, int length)
+    public void publish(String channel, byte[] data, int offset, int length)
         throws IOException
     {
-        if (this.closed) throw new IllegalStateException();
+        ArrayList<Provider> providers = this.providers;
+        if (this.closed || providers == null) throw new IllegalStateException();
         for (Provider p : providers)
             p.publish(channel, data, offset, length);
     }
@@ -224,25 +241,68 @@ public class LCM
     {
         if (this.closed) throw new IllegalStateException();
         synchronized (subscriptions) {
-            ArrayList<SubscriptionRecord> srecs = subscriptionsMap.get(channel);
-
-            if (srecs == null) {
-                // must build this list!
-                srecs = new ArrayList<SubscriptionRecord>();
-                subscriptionsMap.put(channel, srecs);
+            for (SubscriptionRecord srec : getSubscriptions(channel)) {
+                srec.lcsub.messageReceived(this,
+                                           channel,
+                                           new LCMDataInputStream(data, offset, length));
+            }
+        }
+    }
 
-                for (SubscriptionRecord srec : subscriptions) {
-                    if (srec.pat.matcher(channel).matches())
-                        srecs.add(srec);
+    /** Not for use by end users. Like receiveMessage(String, byte[], int,
+     * int), for a message held by a buffer from its position to its
+     * limit. An LCMByteBufferSubscriber gets a read-only view of the buffer,
+     * and other subscribers get a copy of it that is reused across
+     * messages, so the buffer must stay valid only until this method
+     * returns.
+     **/
+    public void receiveMessage(String channel, ByteBuffer data)
+    {
+        if (this.closed) throw new IllegalStateException();
+        synchronized (subscriptions) {
+            ByteBuffer slice = null;
+            int length = data.remaining();
+            boolean copied = false;
+
+            for (SubscriptionRecord srec : getSubscriptions(channel)) {
+                if (srec.lcsub instanceof LCMByteBufferSubscriber) {
+                    if (slice == null)
+                        slice = data.slice();
+                    ((LCMByteBufferSubscriber) srec.lcsub).messageReceived(this,
+                        channel, slice.asReadOnlyBuffer());
+                    continue;
                 }
-            }
 
-            for (SubscriptionRecord srec : srecs) {
+                if (!copied) {
+                    if (receiveBuffer.length < length)
+                        receiveBuffer = new byte[Math.max(length, 2 * receiveBuffer.length)];
+                    data.duplicate().get(receiveBuffer, 0, length);
+                    copied = true;
+                }
                 srec.lcsub.messageReceived(this,
                                            channel,
-                                           new LCMDataInputStream(data, offset, length));
+                                           new LCMDataInputStream(receiveBuffer, 0, length));
+            }
+        }
+    }
+
+    // Must be called with the subscriptions lock held.
+    ArrayList<SubscriptionRecord> getSubscriptions(String channel)
+    {
+        ArrayList<SubscriptionRecord> srecs = subscriptionsMap.get(channel);
+
+        if (srecs == null) {
+            // must build this list!
+            srecs = new ArrayList<SubscriptionRecord>();
+            subscriptionsMap.put(channel, srecs);
+
+            for (SubscriptionRecord srec : subscriptions) {
+                if (srec.pat.matcher(channel).matches())
+                    srecs.add(srec);
             }
         }
+
+        return srecs;
     }
 
     /** A convenience function that subscribes to all LCM channels. **/
@@ -0,0 +1,34 @@
+package lcm.lcm;
+
+import java.nio.*;
+
+/** A subscriber that receives the contents of messages as a read-only
+ * ByteBuffer, rather than as an LCMDataInputStream over a copy of them.
+ **/
+public interface LCMByteBufferSubscriber extends LCMSubscriber
+{
+    /**
+     * Invoked by LCM when a message is received.
+     *
+     * This method is invoked from the LCM thread. The buffer holds the
+     * message from its position to its limit, and is only valid until this
+     * method returns, since the memory behind it is reused for later
+     * messages. Copy whatever is needed afterwards.
+     *
+     * @param lcm the LCM instance that received the message.
+     * @param channel the channel on which the message was received.
+     * @param data the message contents.
+     */
+    public void messageReceived(LCM lcm, String channel, ByteBuffer data);
+
+    /**
+     * Invoked for messages of providers that receive into arrays. Passes the
+     * remaining contents of the stream to messageReceived(LCM, String,
+     * ByteBuffer).
+     */
+    default public void messageReceived(LCM lcm, String channel, LCMDataInputStream ins)
+    {
+        ByteBuffer data = ByteBuffer.wrap(ins.getBuffer(), ins.getBufferOffset(), ins.available());
+        messageReceived(lcm, channel, data.slice().asReadOnlyBuffer());
+    }
+}
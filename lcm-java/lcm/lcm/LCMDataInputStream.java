@@ -1,6 +1,7 @@
 package lcm.lcm;
 
 import java.io.*;
+import java.nio.*;
 
 /** Will not throw EOF. **/
 public final class LCMDataInputStream implements DataInput
@@ -31,6 +32,13 @@ public final class LCMDataInputStream implements DataInput
             throw new EOFException("LCMDataInputStream needed "+need+" bytes, only "+available()+" available.");
     }
 
+    void needElements(int count, int size) throws EOFException
+    {
+        if (count < 0 || (long) count * size > available())
+            throw new EOFException("LCMDataInputStream needed "+count+" elements of "+size+
+                                   " bytes, only "+available()+" bytes available.");
+    }
+
     public int available()
     {
         return endpos - pos - 1;
@@ -127,6 +135,106 @@ public final class LCMDataInputStream implements DataInput
         pos += len;
     }
 
+    /** Reads len big-endian shorts into s, starting at off. **/
+    public void readShorts(short s[], int off, int len) throws IOException
+    {
+        needElements(len, 2);
+        ByteBuffer.wrap(buf, pos, len*2).asShortBuffer().get(s, off, len);
+        pos += len*2;
+    }
+
+    /** Reads len big-endian shorts from ins into s, starting at off, in one
+     * call if ins is an LCMDataInputStream. **/
+    public static void readShorts(DataInput ins, short s[], int off, int len) throws IOException
+    {
+        if (ins instanceof LCMDataInputStream) {
+            ((LCMDataInputStream) ins).readShorts(s, off, len);
+            return;
+        }
+        for (int j = 0; j < len; j++)
+            s[off + j] = ins.readShort();
+    }
+
+    /** Reads len big-endian ints into i, starting at off. **/
+    public void readInts(int i[], int off, int len) throws IOException
+    {
+        needElements(len, 4);
+        ByteBuffer.wrap(buf, pos, len*4).asIntBuffer().get(i, off, len);
+        pos += len*4;
+    }
+
+    /** Reads len big-endian ints from ins into i, starting at off, in one
+     * call if ins is an LCMDataInputStream. **/
+    public static void readInts(DataInput ins, int i[], int off, int len) throws IOException
+    {
+        if (ins instanceof LCMDataInputStream) {
+            ((LCMDataInputStream) ins).readInts(i, off, len);
+            return;
+        }
+        for (int j = 0; j < len; j++)
+            i[off + j] = ins.readInt();
+    }
+
+    /** Reads len big-endian longs into l, starting at off. **/
+    public void readLongs(long l[], int off, int len) throws IOException
+    {
+        needElements(len, 8);
+        ByteBuffer.wrap(buf, pos, len*8).asLongBuffer().get(l, off, len);
+        pos += len*8;
+    }
+
+    /** Reads len big-endian longs from ins into l, starting at off, in one
+     * call if ins is an LCMDataInputStream. **/
+    public static void readLongs(DataInput ins, long l[], int off, int len) throws IOException
+    {
+        if (ins instanceof LCMDataInputStream) {
+            ((LCMDataInputStream) ins).readLongs(l, off, len);
+            return;
+        }
+        for (int j = 0; j < len; j++)
+            l[off + j] = ins.readLong();
+    }
+
+    /** Reads len big-endian floats into f, starting at off. **/
+    public void readFloats(float f[], int off, int len) throws IOException
+    {
+        needElements(len, 4);
+        ByteBuffer.wrap(buf, pos, len*4).asFloatBuffer().get(f, off, len);
+        pos += len*4;
+    }
+
+    /** Reads len big-endian floats from ins into f, starting at off, in one
+     * call if ins is an LCMDataInputStream. **/
+    public static void readFloats(DataInput ins, float f[], int off, int len) throws IOException
+    {
+        if (ins instanceof LCMDataInputStream) {
+            ((LCMDataInputStream) ins).readFloats(f, off, len);
+            return;
+        }
+        for (int j = 0; j < len; j++)
+            f[off + j] = ins.readFloat();
+    }
+
+    /** Reads len big-endian doubles into d, starting at off. **/
+    public void readDoubles(double d[], int off, int len) throws IOException
+    {
+        needElements(len, 8);
+        ByteBuffer.wrap(buf, pos, len*8).asDoubleBuffer().get(d, off, len);
+        pos += len*8;
+    }
+
+    /** Reads len big-endian doubles from ins into d, starting at off, in one
+     * call if ins is an LCMDataInputStream. **/
+    public static void readDoubles(DataInput ins, double d[], int off, int len) throws IOException
+    {
+        if (ins instanceof LCMDataInputStream) {
+            ((LCMDataInputStream) ins).readDoubles(d, off, len);
+            return;
+        }
+        for (int j = 0; j < len; j++)
+            d[off + j] = ins.readDouble();
+    }
+
     /** Writes chars as one byte per char, filling high byte with zero. **/
     public void readFullyBytesAsChars(char c[]) throws IOException
     {
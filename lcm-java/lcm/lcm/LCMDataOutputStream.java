@@ -1,6 +1,7 @@
 package lcm.lcm;
 
 import java.io.*;
+import java.nio.*;
 
 public final class LCMDataOutputStream implements DataOutput
 {
@@ -55,6 +56,111 @@ public final class LCMDataOutputStream implements DataOutput
         pos += len;
     }
 
+    /** Writes len shorts from s, starting at off, in big-endian order. **/
+    public void writeShorts(short s[], int off, int len)
+    {
+        ensureSpace(len*2);
+        ByteBuffer.wrap(buf, pos, len*2).asShortBuffer().put(s, off, len);
+        pos += len*2;
+    }
+
+    /** Writes len shorts from s, starting at off, to outs in big-endian
+     * order, in one call if outs is an LCMDataOutputStream. **/
+    public static void writeShorts(DataOutput outs, short s[], int off, int len)
+        throws IOException
+    {
+        if (outs instanceof LCMDataOutputStream) {
+            ((LCMDataOutputStream) outs).writeShorts(s, off, len);
+            return;
+        }
+        for (int j = 0; j < len; j++)
+            outs.writeShort(s[off + j]);
+    }
+
+    /** Writes len ints from i, starting at off, in big-endian order. **/
+    public void writeInts(int i[], int off, int len)
+    {
+        ensureSpace(len*4);
+        ByteBuffer.wrap(buf, pos, len*4).asIntBuffer().put(i, off, len);
+        pos += len*4;
+    }
+
+    /** Writes len ints from i, starting at off, to outs in big-endian
+     * order, in one call if outs is an LCMDataOutputStream. **/
+    public static void writeInts(DataOutput outs, int i[], int off, int len)
+        throws IOException
+    {
+        if (outs instanceof LCMDataOutputStream) {
+            ((LCMDataOutputStream) outs).writeInts(i, off, len);
+            return;
+        }
+        for (int j = 0; j < len; j++)
+            outs.writeInt(i[off + j]);
+    }
+
+    /** Writes len longs from l, starting at off, in big-endian order. **/
+    public void writeLongs(long l[], int off, int len)
+    {
+        ensureSpace(len*8);
+        ByteBuffer.wrap(buf, pos, len*8).asLongBuffer().put(l, off, len);
+        pos += len*8;
+    }
+
+    /** Writes len longs from l, starting at off, to outs in big-endian
+     * order, in one call if outs is an LCMDataOutputStream. **/
+    public static void writeLongs(DataOutput outs, long l[], int off, int len)
+        throws IOException
+    {
+        if (outs instanceof LCMDataOutputStream) {
+            ((LCMDataOutputStream) outs).writeLongs(l, off, len);
+            return;
+        }
+        for (int j = 0; j < len; j++)
+            outs.writeLong(l[off + j]);
+    }
+
+    /** Writes len floats from f, starting at off, in big-endian order. **/
+    public void writeFloats(float f[], int off, int len)
+    {
+        ensureSpace(len*4);
+        ByteBuffer.wrap(buf, pos, len*4).asFloatBuffer().put(f, off, len);
+        pos += len*4;
+    }
+
+    /** Writes len floats from f, starting at off, to outs in big-endian
+     * order, in one call if outs is an LCMDataOutputStream. **/
+    public static void writeFloats(DataOutput outs, float f[], int off, int len)
+        throws IOException
+    {
+        if (outs instanceof LCMDataOutputStream) {
+            ((LCMDataOutputStream) outs).writeFloats(f, off, len);
+            return;
+        }
+        for (int j = 0; j < len; j++)
+            outs.writeFloat(f[off + j]);
+    }
+
+    /** Writes len doubles from d, starting at off, in big-endian order. **/
+    public void writeDoubles(double d[], int off, int len)
+    {
+        ensureSpace(len*8);
+        ByteBuffer.wrap(buf, pos, len*8).asDoubleBuffer().put(d, off, len);
+        pos += len*8;
+    }
+
+    /** Writes len doubles from d, starting at off, to outs in big-endian
+     * order, in one call if outs is an LCMDataOutputStream. **/
+    public static void writeDoubles(DataOutput outs, double d[], int off, int len)
+        throws IOException
+    {
+        if (outs instanceof LCMDataOutputStream) {
+            ((LCMDataOutputStream) outs).writeDoubles(d, off, len);
+            return;
+        }
+        for (int j = 0; j < len; j++)
+            outs.writeDouble(d[off + j]);
+    }
+
     /** Writes one byte per char **/
     public void writeCharsAsBytes(char c[])
     {
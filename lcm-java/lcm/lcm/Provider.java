@@ -12,7 +12,8 @@ public interface Provider
 {
     /**
        Publish() will be called when an application sends a message, and
-       could be called on an arbitrary thread.
+       could be called on an arbitrary thread, including from several
+       threads at once. The provider must serialize its sends itself.
     **/
     public void publish(String channel, byte data[], int offset, int len);
 
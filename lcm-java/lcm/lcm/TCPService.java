@@ -3,28 +3,49 @@ package lcm.lcm;
 import java.net.*;
 import java.io.*;
 import java.util.*;
-import java.util.concurrent.locks.*;
 import java.util.regex.*;
 import java.nio.*;
+import java.nio.channels.*;
 
+/** Relays messages between TCPProvider clients. All connections are served
+ * by one thread waiting on a Selector. Each client has a bounded queue of
+ * outbound messages, so that a slow client drops its own messages instead
+ * of stalling the others, and is only sent the channels it subscribed to.
+ **/
 public class TCPService
 {
-    ServerSocket serverSocket;
+    // messages queued for a client beyond this are dropped
+    static final int MAX_QUEUED_BYTES = 4 * 1024 * 1024;
 
-    AcceptThread acceptThread;
-    ArrayList<ClientThread> clients = new ArrayList<ClientThread>();
-    ReadWriteLock clients_lock = new ReentrantReadWriteLock();
+    static final int MAX_MESSAGE_SIZE = 1 << 30;
 
-    int bytesCount = 0;
+    // the number of channel match results each client remembers
+    static final int MAX_CACHED_CHANNELS = 1024;
+
+    ServerSocketChannel serverChannel;
+    Selector selector;
+
+    SelectorThread selectorThread;
+    // only accessed from the selector thread
+    ArrayList<Client> clients = new ArrayList<Client>();
+    volatile int numClients = 0;
+
+    // messages passed to relay() from other threads, sent by the selector thread
+    ArrayList<ByteBuffer> pending = new ArrayList<ByteBuffer>();
+
+    volatile int bytesCount = 0;
+    volatile int droppedCount = 0;
 
     public TCPService(int port) throws IOException
     {
-        serverSocket = new ServerSocket(port);
-        //	sock.setReuseAddress(true);
-        //	sock.setLoopbackMode(false); // true *disables* loopback
+        selector = Selector.open();
+        serverChannel = ServerSocketChannel.open();
+        serverChannel.bind(new InetSocketAddress(port));
+        serverChannel.configureBlocking(false);
+        serverChannel.register(selector, SelectionKey.OP_ACCEPT);
 
-        acceptThread = new AcceptThread();
-        acceptThread.start();
+        selectorThread = new SelectorThread();
+        selectorThread.start();
 
         long inittime = System.currentTimeMillis();
         long starttime = System.currentTimeMillis();
@@ -37,66 +58,185 @@ public class TCPService
             long endtime = System.currentTimeMillis();
             double dt = (endtime - starttime) / 1000.0;
             starttime = endtime;
-            System.out.printf("%10.3f : %10.1f kB/s, %d clients\n",(endtime - inittime)/1000.0, bytesCount/1024.0/dt, clients.size());
+            System.out.printf("%10.3f : %10.1f kB/s, %d clients, %d dropped\n",(endtime - inittime)/1000.0, bytesCount/1024.0/dt, numClients, droppedCount);
             bytesCount = 0;
+            droppedCount = 0;
         }
         // interrupt signal received
         closeResources();
     }
 
     private void closeResources() throws IOException {
-        acceptThread.interrupt();
-        serverSocket.close();
-        synchronized(clients) {
-            for (ClientThread clientThread : clients) {
-                clientThread.closeResources();
-            }
+        selectorThread.interrupt();
+        selector.wakeup();
+        try {
+            selectorThread.join();
+        } catch (InterruptedException ex) {
         }
     }
 
+    static ByteBuffer encodeMessage(byte channel[], byte data[])
+    {
+        ByteBuffer msg = ByteBuffer.allocate(12 + channel.length + data.length);
+        msg.putInt(TCPProvider.MESSAGE_TYPE_PUBLISH);
+        msg.putInt(channel.length);
+        msg.put(channel);
+        msg.putInt(data.length);
+        msg.put(data);
+        msg.flip();
+        return msg;
+    }
 
+    /** Sends a message to every client subscribed to its channel. May be
+     * called from any thread.
+     **/
     public void relay(byte channel[], byte data[])
     {
-        // synchronously send to all clients.
-        String chanstr = new String(channel);
-        try {
-            clients_lock.readLock().lock();
-            for (ClientThread client : clients) {
-                client.send(chanstr, channel, data);
-            }
-        } finally {
-            clients_lock.readLock().unlock();
+        ByteBuffer msg = encodeMessage(channel, data);
+        if (Thread.currentThread() == selectorThread) {
+            selectorThread.relay(new String(channel), msg);
+            return;
         }
+
+        synchronized (pending) {
+            pending.add(msg);
+        }
+        selector.wakeup();
     }
 
-    class AcceptThread extends Thread
+    class SelectorThread extends Thread
     {
+        SelectorThread()
+        {
+            setDaemon(true);
+        }
+
         public void run()
         {
-            while (!Thread.interrupted()) {
+            while (!isInterrupted()) {
                 try {
-                    Socket clientSock = serverSocket.accept();
+                    selector.select();
+                } catch (IOException ex) {
+                    System.err.println("ex: "+ex);
+                    break;
+                }
+
+                Iterator<SelectionKey> it = selector.selectedKeys().iterator();
+                while (it.hasNext()) {
+                    SelectionKey key = it.next();
+                    it.remove();
 
-                    ClientThread client = new ClientThread(clientSock);
-                    client.start();
+                    if (key.isValid() && key.isAcceptable()) {
+                        accept();
+                        continue;
+                    }
 
+                    Client client = (Client) key.attachment();
                     try {
-                        clients_lock.writeLock().lock();
-                        clients.add(client);
-                    } finally {
-                        clients_lock.writeLock().unlock();
+                        if (key.isValid() && key.isReadable())
+                            client.read();
+                        if (key.isValid() && key.isWritable())
+                            client.flush();
+                    } catch (IOException ex) {
+                        removeClient(client);
+                    }
+                }
+
+                ArrayList<ByteBuffer> msgs = null;
+                synchronized (pending) {
+                    if (!pending.isEmpty()) {
+                        msgs = new ArrayList<ByteBuffer>(pending);
+                        pending.clear();
+                    }
+                }
+                if (msgs != null) {
+                    for (ByteBuffer msg : msgs) {
+                        byte channel[] = new byte[msg.getInt(4)];
+                        for (int i = 0; i < channel.length; i++)
+                            channel[i] = msg.get(8 + i);
+                        relay(new String(channel), msg);
                     }
+                }
+            }
+
+            for (Client client : new ArrayList<Client>(clients))
+                removeClient(client);
+            try {
+                serverChannel.close();
+                selector.close();
+            } catch (IOException ex) {
+            }
+        }
+
+        void accept()
+        {
+            try {
+                SocketChannel sock = serverChannel.accept();
+                if (sock == null)
+                    return;
+                sock.configureBlocking(false);
+                sock.setOption(StandardSocketOptions.TCP_NODELAY, true);
+
+                Client client = new Client(sock);
+                client.key = sock.register(selector, SelectionKey.OP_READ, client);
+                clients.add(client);
+                numClients = clients.size();
+
+                ByteBuffer hello = ByteBuffer.allocate(8);
+                hello.putInt(TCPProvider.MAGIC_SERVER);
+                hello.putInt(TCPProvider.VERSION);
+                hello.flip();
+                client.enqueue(hello);
+            } catch (IOException ex) {
+            }
+        }
+
+        void removeClient(Client client)
+        {
+            if (clients.remove(client))
+                numClients = clients.size();
+            client.key.cancel();
+            try {
+                client.sock.close();
+            } catch (IOException ex) {
+            }
+        }
+
+        /** Queues an encoded message to subscribed clients; msg is not
+         * modified, each client sends a view of it.
+         **/
+        void relay(String channel, ByteBuffer msg)
+        {
+            ArrayList<Client> failed = null;
+            for (Client client : clients) {
+                if (!client.isSubscribed(channel))
+                    continue;
+                try {
+                    client.enqueue(msg.duplicate());
                 } catch (IOException ex) {
+                    if (failed == null)
+                        failed = new ArrayList<Client>();
+                    failed.add(client);
                 }
             }
+            if (failed != null) {
+                for (Client client : failed)
+                    removeClient(client);
+            }
         }
     }
 
-    class ClientThread extends Thread
+    class Client
     {
-        Socket sock;
-        DataInputStream ins;
-        DataOutputStream outs;
+        SocketChannel sock;
+        SelectionKey key;
+
+        // received bytes that don't form a whole message yet
+        ByteBuffer in = ByteBuffer.allocate(64 * 1024);
+        boolean handshakeReceived = false;
+
+        ArrayDeque<ByteBuffer> outbound = new ArrayDeque<ByteBuffer>();
+        int queuedBytes = 0;
 
         class SubscriptionRecord
         {
@@ -109,109 +249,154 @@ public class TCPService
         }
 
         ArrayList<SubscriptionRecord> subscriptions = new ArrayList<SubscriptionRecord>();
-        ReadWriteLock subscriptions_lock = new ReentrantReadWriteLock();
+        // whether a channel matches any subscription, cleared when they change
+        HashMap<String, Boolean> matches = new HashMap<String, Boolean>();
 
-        public ClientThread(Socket sock) throws IOException
+        Client(SocketChannel sock)
         {
             this.sock = sock;
-
-            ins = new DataInputStream(sock.getInputStream());
-            outs = new DataOutputStream(sock.getOutputStream());
-
-            outs.writeInt(TCPProvider.MAGIC_SERVER);
-            outs.writeInt(TCPProvider.VERSION);
         }
 
-        public void run()
+        boolean isSubscribed(String channel)
         {
-            ///////////////////////
-            // read messages until something bad happens.
-            try {
-                while (true) {
-                    int type = ins.readInt();
-                    if (type == TCPProvider.MESSAGE_TYPE_PUBLISH) {
-                        int channellen = ins.readInt();
-                        byte channel[] = new byte[channellen];
-                        ins.readFully(channel);
-
-                        int datalen = ins.readInt();
-                        byte data[] = new byte[datalen];
-                        ins.readFully(data);
-
-                        TCPService.this.relay(channel, data);
-
-                        bytesCount += channellen + datalen + 8;
-                    } else if(type == TCPProvider.MESSAGE_TYPE_SUBSCRIBE) {
-                        int channellen = ins.readInt();
-                        byte channel[] = new byte[channellen];
-                        ins.readFully(channel);
-                        try {
-                            subscriptions_lock.writeLock().lock();
-                            subscriptions.add(new SubscriptionRecord(new String(channel)));
-                        } finally {
-                            subscriptions_lock.writeLock().unlock();
-                        }
-                    } else if(type == TCPProvider.MESSAGE_TYPE_UNSUBSCRIBE) {
-                        int channellen = ins.readInt();
-                        byte channel[] = new byte[channellen];
-                        ins.readFully(channel);
-                        String re = new String(channel);
-                        try {
-                            subscriptions_lock.writeLock().lock();
-                            for(int i=0, n=subscriptions.size(); i<n; i++) {
-                                if(subscriptions.get(i).regex.equals(re)) {
-                                    subscriptions.remove(i);
-                                    break;
-                                }
-                            }
-                        } finally {
-                            subscriptions_lock.writeLock().unlock();
-                        }
+            Boolean match = matches.get(channel);
+            if (match == null) {
+                match = false;
+                for (SubscriptionRecord sr : subscriptions) {
+                    if (sr.pat.matcher(channel).matches()) {
+                        match = true;
+                        break;
                     }
                 }
-            } catch (IOException ex) {
+                if (matches.size() >= MAX_CACHED_CHANNELS)
+                    matches.clear();
+                matches.put(channel, match);
             }
+            return match;
+        }
 
-            ///////////////////////
-            // Something bad happened, close this connection.
-            try {
-                closeResources();
-            } catch (IOException ex) {
+        void enqueue(ByteBuffer msg) throws IOException
+        {
+            if (!outbound.isEmpty() && queuedBytes + msg.remaining() > MAX_QUEUED_BYTES) {
+                droppedCount++;
+                return;
             }
+            boolean wasEmpty = outbound.isEmpty();
+            outbound.addLast(msg);
+            queuedBytes += msg.remaining();
+            if (wasEmpty)
+                flush();
+        }
 
-            try {
-                clients_lock.writeLock().lock();
-                clients.remove(this);
-            } finally {
-                clients_lock.writeLock().unlock();
+        /** Writes as much of the outbound queue as the socket accepts, and
+         * waits for the socket to become writable if some remains.
+         **/
+        void flush() throws IOException
+        {
+            while (!outbound.isEmpty()) {
+                ByteBuffer msg = outbound.peekFirst();
+                int n = sock.write(msg);
+                queuedBytes -= n;
+                if (msg.hasRemaining())
+                    break;
+                outbound.pollFirst();
             }
+
+            int ops = outbound.isEmpty() ? SelectionKey.OP_READ
+                : SelectionKey.OP_READ | SelectionKey.OP_WRITE;
+            if (key.interestOps() != ops)
+                key.interestOps(ops);
         }
 
-        public void closeResources() throws IOException {
-            sock.close();
+        void read() throws IOException
+        {
+            if (sock.read(in) < 0)
+                throw new EOFException();
+
+            in.flip();
+            while (handleMessage())
+                ;
+            in.compact();
         }
 
-        public void send(String chanstr, byte channel[], byte data[])
+        /** Handles the message at the position of in, if all of it has been
+         * received. Returns false if more bytes are needed.
+         **/
+        boolean handleMessage() throws IOException
         {
-            try {
-                subscriptions_lock.readLock().lock();
-                for(SubscriptionRecord sr : subscriptions) {
-                    if(sr.pat.matcher(chanstr).matches()) {
-                        synchronized(outs) {
-                            outs.writeInt(TCPProvider.MESSAGE_TYPE_PUBLISH);
-                            outs.writeInt(channel.length);
-                            outs.write(channel);
-                            outs.writeInt(data.length);
-                            outs.write(data);
-                            outs.flush();
-                            return;
-                        }
+            int start = in.position();
+
+            if (!handshakeReceived) {
+                if (in.remaining() < 8)
+                    return false;
+                if (in.getInt() != TCPProvider.MAGIC_CLIENT)
+                    throw new IOException("bad magic");
+                in.getInt(); // client version
+                handshakeReceived = true;
+                return true;
+            }
+
+            if (in.remaining() < 8)
+                return false;
+            int type = in.getInt();
+            int channellen = in.getInt();
+            if (channellen < 0 || channellen > MAX_MESSAGE_SIZE)
+                throw new IOException("bad channel length");
+            if (!need(start, 8 + channellen + (type == TCPProvider.MESSAGE_TYPE_PUBLISH ? 4 : 0)))
+                return false;
+
+            byte channel[] = new byte[channellen];
+            in.get(channel);
+
+            if (type == TCPProvider.MESSAGE_TYPE_PUBLISH) {
+                int datalen = in.getInt();
+                if (datalen < 0 || datalen > MAX_MESSAGE_SIZE)
+                    throw new IOException("bad message length");
+                if (!need(start, 12 + channellen + datalen))
+                    return false;
+
+                byte data[] = new byte[datalen];
+                in.get(data);
+
+                selectorThread.relay(new String(channel), encodeMessage(channel, data));
+
+                bytesCount += channellen + datalen + 8;
+            } else if (type == TCPProvider.MESSAGE_TYPE_SUBSCRIBE) {
+                try {
+                    subscriptions.add(new SubscriptionRecord(new String(channel)));
+                } catch (PatternSyntaxException ex) {
+                    System.err.println("TCPService: bad subscription: "+ex.getMessage());
+                }
+                matches.clear();
+            } else if (type == TCPProvider.MESSAGE_TYPE_UNSUBSCRIBE) {
+                String re = new String(channel);
+                for (int i = 0, n = subscriptions.size(); i < n; i++) {
+                    if (subscriptions.get(i).regex.equals(re)) {
+                        subscriptions.remove(i);
+                        break;
                     }
                 }
-            } catch (IOException ex) {
-            } finally {
-                subscriptions_lock.readLock().unlock();
+                matches.clear();
+            }
+            return true;
+        }
+
+        /** Returns whether size bytes from start have been received. If not,
+         * rewinds in to start and makes sure it can hold them.
+         **/
+        boolean need(int start, int size)
+        {
+            if (in.limit() - start >= size)
+                return true;
+
+            in.position(start);
+            if (in.capacity() < size) {
+                ByteBuffer bigger = ByteBuffer.allocate(size);
+                bigger.put(in);
+                bigger.flip();
+                in = bigger;
             }
+            return false;
         }
     }
 
@@ -5,6 +5,7 @@ import java.io.*;
 import java.util.*;
 import java.util.regex.*;
 import java.nio.*;
+import java.nio.channels.*;
 
 /** LCM provider for the udpm: URL. All messages are broadcast over a
  * pre-arranged UDP multicast address. Subscription operations are a
@@ -13,10 +14,17 @@ import java.nio.*;
  * This mechanism is very simple, low-latency, and efficient due to
  * not having to transmit messages more than once when there are
  * multiple subscribers. Since it uses UDP, it is lossy.
+ *
+ * Datagrams are received with NIO into pooled direct buffers, and every
+ * datagram that is ready is handled before waiting again, so receiving
+ * doesn't allocate per message.
  **/
 public class UDPMulticastProvider implements Provider
 {
-    MulticastSocket sock;
+    // as in the C implementation, one channel sends and another receives
+    DatagramChannel sendChannel;
+    DatagramChannel recvChannel;
+    MembershipKey membership;
 
     static final String DEFAULT_NETWORK = "239.255.76.67:7667";
     static final int    DEFAULT_TTL     = 0;
@@ -24,6 +32,11 @@ public class UDPMulticastProvider implements Provider
     static final int    MAGIC_SHORT = 0x4c433032; // ascii of "LC02"
     static final int    MAGIC_LONG  = 0x4c433033; // ascii of "LC03"
     static final int    FRAGMENTATION_THRESHOLD = 64000;
+    static final int    MAX_DATAGRAM_SIZE = 65536;
+    // the most datagrams handled per wakeup of the reader
+    static final int    MAX_BATCH = 16;
+    // the most channel names remembered before the cache starts over
+    static final int    MAX_CHANNEL_NAMES = 1024;
 
     ReaderThread reader;
 
@@ -31,10 +44,13 @@ public class UDPMulticastProvider implements Provider
 
     HashMap<SocketAddress, FragmentBuffer> fragBufs = new HashMap<SocketAddress, FragmentBuffer>();
 
+    BufferPool bufferPool = new BufferPool();
+
     LCM lcm;
 
     InetAddress inetAddr;
     int         inetPort;
+    InetSocketAddress groupAddr;
 
     static
     {
@@ -51,13 +67,8 @@ public class UDPMulticastProvider implements Provider
         inetAddr = InetAddress.getByName(addrport[0]);
         inetPort = Integer.valueOf(addrport[1]);
 
-        sock = new MulticastSocket(inetPort);
-
-        sock.setReuseAddress(true);
-        // TODO setLoopbackMode was deprecated in Java 1.14 but not added until Java 1.9. Replace it
-        // with the line below when the minimum Java version is 1.9 or higher.
-        // sock.setOption(StandardSocketOptions.IP_MULTICAST_LOOP, false); // true *disables* loopback
-        sock.setLoopbackMode(false); // true *disables* loopback
+        groupAddr = new InetSocketAddress(inetAddr, inetPort);
+        NetworkInterface iface = getMulticastInterface(groupAddr);
 
         int ttl = up.get("ttl", DEFAULT_TTL);
         if (ttl == 0)
@@ -67,10 +78,36 @@ public class UDPMulticastProvider implements Provider
         else
             System.err.println("LCM: TTL set to 1.");
 
-        sock.setTimeToLive(up.get("ttl", DEFAULT_TTL));
+        sendChannel = DatagramChannel.open(StandardProtocolFamily.INET);
+        sendChannel.setOption(StandardSocketOptions.IP_MULTICAST_IF, iface);
+        sendChannel.setOption(StandardSocketOptions.IP_MULTICAST_TTL, ttl);
+        sendChannel.setOption(StandardSocketOptions.IP_MULTICAST_LOOP, true);
 
-        SocketAddress socketAddr = new InetSocketAddress(inetAddr, inetPort);
-        sock.joinGroup(socketAddr, null);
+        recvChannel = DatagramChannel.open(StandardProtocolFamily.INET);
+        recvChannel.setOption(StandardSocketOptions.SO_REUSEADDR, true);
+        recvChannel.bind(new InetSocketAddress(inetPort));
+        membership = recvChannel.join(inetAddr, iface);
+        recvChannel.configureBlocking(false);
+    }
+
+    /** Returns the interface that traffic to the group is routed through,
+     * which a MulticastSocket joins the group on by default, or the loopback
+     * interface if there is no route.
+     **/
+    static NetworkInterface getMulticastInterface(InetSocketAddress groupAddr) throws IOException
+    {
+        DatagramSocket probe = new DatagramSocket();
+        try {
+            // connecting a UDP socket only looks up its route
+            probe.connect(groupAddr);
+            NetworkInterface iface = NetworkInterface.getByInetAddress(probe.getLocalAddress());
+            if (iface != null && iface.supportsMulticast())
+                return iface;
+        } catch (SocketException ex) {
+        } finally {
+            probe.close();
+        }
+        return NetworkInterface.getByInetAddress(InetAddress.getLoopbackAddress());
     }
 
     public synchronized void publish(String channel, byte data[], int offset, int length)
@@ -102,8 +139,15 @@ public class UDPMulticastProvider implements Provider
             }
         }
         reader = null;
-        sock.close();
-        sock = null;
+        try {
+            membership.drop();
+            recvChannel.close();
+            sendChannel.close();
+        } catch (IOException ex) {
+            System.err.println("ex: "+ex);
+        }
+        recvChannel = null;
+        sendChannel = null;
         fragBufs = null;
     }
 
@@ -124,7 +168,7 @@ public class UDPMulticastProvider implements Provider
 
             outs.write(data, offset, length);
 
-            sock.send(new DatagramPacket(outs.getBuffer(), 0, outs.size(), inetAddr, inetPort));
+            sendChannel.send(ByteBuffer.wrap(outs.getBuffer(), 0, outs.size()), groupAddr);
 
         } else {
             int nfragments = payload_size / FRAGMENTATION_THRESHOLD;
@@ -156,7 +200,7 @@ public class UDPMulticastProvider implements Provider
             outs.write(data, offset, firstfrag_datasize);
 
             byte[] b = bouts.toByteArray();
-            sock.send(new DatagramPacket(b, 0, b.length, inetAddr, inetPort));
+            sendChannel.send(ByteBuffer.wrap(b), groupAddr);
 
             fragment_offset += firstfrag_datasize;
 
@@ -174,7 +218,7 @@ public class UDPMulticastProvider implements Provider
                 outs.write(data, offset+fragment_offset, fraglen);
 
                 b = bouts.toByteArray();
-                sock.send(new DatagramPacket(b, 0, b.length, inetAddr, inetPort));
+                sendChannel.send(ByteBuffer.wrap(b), groupAddr);
 
                 fragment_offset += fraglen;
             }
@@ -190,7 +234,7 @@ public class UDPMulticastProvider implements Provider
         int msgSeqNumber = 0;
         int data_size = 0;
         int fragments_remaining = 0;
-        byte[] data = null;
+        ByteBuffer data = null;
         boolean frag_received[];
 
         FragmentBuffer(SocketAddress from, String channel, int msgSeqNumber, int data_size,
@@ -201,13 +245,23 @@ public class UDPMulticastProvider implements Provider
             this.msgSeqNumber = msgSeqNumber;
             this.data_size = data_size;
             this.fragments_remaining = fragments_remaining;
-            this.data = new byte[data_size];
+            this.data = bufferPool.acquire(data_size);
             this.frag_received = new boolean[fragments_remaining];
         }
     }
 
+    void removeFragmentBuffer(FragmentBuffer fbuf)
+    {
+        fragBufs.remove(fbuf.from);
+        bufferPool.release(fbuf.data);
+    }
+
     class ReaderThread extends Thread
     {
+        // channel names by their bytes, so that a name isn't decoded for
+        // every message
+        HashMap<ByteBuffer, String> channelNames = new HashMap<ByteBuffer, String>();
+
         ReaderThread()
         {
             setDaemon(true);
@@ -215,73 +269,125 @@ public class UDPMulticastProvider implements Provider
 
         public void run()
         {
-            DatagramPacket packet = new DatagramPacket(new byte[65536], 65536);
+            ByteBuffer bufs[] = new ByteBuffer[MAX_BATCH];
+            // views of bufs, for looking up channel names
+            ByteBuffer names[] = new ByteBuffer[MAX_BATCH];
+            SocketAddress froms[] = new SocketAddress[MAX_BATCH];
+            for (int i = 0; i < MAX_BATCH; i++) {
+                bufs[i] = bufferPool.acquire(MAX_DATAGRAM_SIZE);
+                names[i] = bufs[i].duplicate();
+            }
+
+            Selector selector = null;
+            try {
+                selector = Selector.open();
+                recvChannel.register(selector, SelectionKey.OP_READ);
+            } catch (IOException ex) {
+                System.err.println("ex: "+ex);
+                return;
+            }
 
             while (!isInterrupted()) {
                 try {
-                    sock.receive(packet);
-                    handlePacket(packet);
+                    selector.select();
+                    selector.selectedKeys().clear();
+
+                    int count = 0;
+                    while (count < MAX_BATCH) {
+                        bufs[count].clear();
+                        froms[count] = recvChannel.receive(bufs[count]);
+                        if (froms[count] == null)
+                            break;
+                        bufs[count].flip();
+                        count++;
+                    }
+
+                    // the subscription lock is taken once for the batch
+                    synchronized (lcm.subscriptions) {
+                        for (int i = 0; i < count; i++) {
+                            try {
+                                handlePacket(froms[i], bufs[i], names[i]);
+                            } catch (BufferUnderflowException ex) {
+                                System.err.println("LC: dropping truncated packet");
+                            }
+                        }
+                    }
+                } catch (ClosedChannelException ex) {
+                    // closed by close()
+                    break;
                 } catch (IOException ex) {
                     System.err.println("ex: "+ex);
                     continue;
                 }
             }
-        }
 
-        @Override
-        public void interrupt() {
-            super.interrupt();
-            sock.close();
+            try {
+                selector.close();
+            } catch (IOException ex) {
+            }
+            for (int i = 0; i < MAX_BATCH; i++)
+                bufferPool.release(bufs[i]);
         }
 
-        void handleShortMessage(DatagramPacket packet, LCMDataInputStream ins) throws IOException
+        // Reads the zero terminated channel name at the position of buf.
+        String readChannel(ByteBuffer buf, ByteBuffer name) throws IOException
         {
-            int msgSeqNumber = ins.readInt();
-            String channel = ins.readStringZ();
+            int start = buf.position();
+            int end = start;
+            while (end < buf.limit() && buf.get(end) != 0)
+                end++;
+            if (end == buf.limit())
+                throw new BufferUnderflowException();
+
+            name.limit(end);
+            name.position(start);
+            String channel = channelNames.get(name);
+            if (channel == null) {
+                byte bytes[] = new byte[end - start];
+                buf.get(bytes);
+                channel = new String(bytes, "US-ASCII");
+                if (channelNames.size() >= MAX_CHANNEL_NAMES)
+                    channelNames.clear();
+                channelNames.put(ByteBuffer.wrap(bytes), channel);
+            }
 
-            lcm.receiveMessage(channel, ins.getBuffer(), ins.getBufferOffset(), ins.available());
+            buf.position(end + 1);
+            return channel;
         }
 
-        void handleFragment (DatagramPacket packet, LCMDataInputStream ins) throws IOException
+        void handleShortMessage(ByteBuffer buf, ByteBuffer name) throws IOException
         {
-            int msgSeqNumber = ins.readInt();
-            int msg_size = ins.readInt() & 0xffffffff;
-            int fragment_offset = ins.readInt() & 0xffffffff;
-            int fragment_id = ins.readShort() & 0xffff;
-            int fragments_in_msg = ins.readShort() & 0xffff;
-
-            // read entire packet payload
-            byte payload[] = new byte[ins.available()];
-            ins.readFully(payload);
-
-            if (ins.available() > 0) {
-                System.err.println("Unread data! "+ins.available());
-            }
+            int msgSeqNumber = buf.getInt();
+            String channel = readChannel(buf, name);
+
+            lcm.receiveMessage(channel, buf);
+        }
 
-            int data_start = 0;
-            int frag_size = payload.length;
+        void handleFragment(SocketAddress from, ByteBuffer buf, ByteBuffer name)
+            throws IOException
+        {
+            int msgSeqNumber = buf.getInt();
+            int msg_size = buf.getInt();
+            int fragment_offset = buf.getInt();
+            int fragment_id = buf.getShort() & 0xffff;
+            int fragments_in_msg = buf.getShort() & 0xffff;
 
-            SocketAddress from = packet.getSocketAddress();
             FragmentBuffer fbuf = fragBufs.get(from);
 
             if (fbuf != null && ((fbuf.msgSeqNumber != msgSeqNumber) ||
                                  (fbuf.data_size != msg_size))) {
-                fragBufs.remove(fbuf.from);
+                removeFragmentBuffer(fbuf);
                 fbuf = null;
             }
 
             if (null == fbuf && 0 == fragment_id) {
+                if (msg_size < 0 || msg_size > (1 << 30)) {
+                    System.err.println ("LC: dropping oversized message");
+                    return;
+                }
 
                 // extract channel name
-                int channel_len = 0;
-                for (; channel_len < payload.length; channel_len++) {
-                    if (0 == payload[channel_len]) {
-                        break;
-                    }
-                }
-                data_start = channel_len + 1;
-                frag_size -= channel_len + 1;
-                String channel = new String(payload, 0, channel_len, "US-ASCII");
+                String channel = readChannel(buf, name);
 
                 fbuf = new FragmentBuffer (from, channel, msgSeqNumber, msg_size, fragments_in_msg);
 
@@ -293,37 +399,38 @@ public class UDPMulticastProvider implements Provider
                 return;
             }
 
-            if (fragment_offset + frag_size > fbuf.data_size) {
+            int frag_size = buf.remaining();
+            if (fragment_offset < 0 || (long) fragment_offset + frag_size > fbuf.data_size ||
+                fragment_id >= fbuf.frag_received.length) {
                 System.err.println ("LC: dropping invalid fragment");
-                fragBufs.remove (fbuf.from);
+                removeFragmentBuffer(fbuf);
                 return;
             }
 
             if (!fbuf.frag_received[fragment_id]) {
                 fbuf.frag_received[fragment_id] = true;
 
-                System.arraycopy(payload, data_start, fbuf.data, fragment_offset, frag_size);
+                fbuf.data.position(fragment_offset);
+                fbuf.data.put(buf);
 
                 fbuf.fragments_remaining --;
             }
 
             if (0 == fbuf.fragments_remaining) {
-                lcm.receiveMessage(fbuf.channel, fbuf.data, 0, fbuf.data_size);
-                fragBufs.remove (fbuf.from);
+                fbuf.data.position(0);
+                fbuf.data.limit(fbuf.data_size);
+                lcm.receiveMessage(fbuf.channel, fbuf.data);
+                removeFragmentBuffer(fbuf);
             }
         }
 
-        void handlePacket(DatagramPacket packet) throws IOException
+        void handlePacket(SocketAddress from, ByteBuffer buf, ByteBuffer name) throws IOException
         {
-            LCMDataInputStream ins = new LCMDataInputStream(packet.getData(),
-                                                            packet.getOffset(),
-                                                            packet.getLength());
-
-            int magic = ins.readInt();
+            int magic = buf.getInt();
             if (magic == MAGIC_SHORT) {
-                handleShortMessage(packet, ins);
+                handleShortMessage(buf, name);
             } else if (magic == MAGIC_LONG) {
-                handleFragment(packet, ins);
+                handleFragment(from, buf, name);
             } else {
                 System.err.println("bad magic: " + Integer.toHexString(magic));
                 return;
@@ -29,5 +29,12 @@ public class ChannelData
     public long        hz_max_interval;
     public long        hz_bytes;
 
-    public Object      last;         // last received object on this channel.
+    public Object      last;         // last decoded object on this channel.
+
+    // the encoding of the last received message, decoded by Spy only while
+    // the viewer is open. Guarded by this object.
+    public byte        lastBytes[];
+    public int         lastLength;
+    public long        lastSeq;       // incremented for each received message
+    public long        decodedSeq;    // lastSeq of the message held by last
 }
@@ -7,6 +7,7 @@ import java.awt.event.*;
 
 import java.io.*;
 import java.util.*;
+import java.util.concurrent.*;
 import lcm.util.*;
 import java.lang.reflect.*;
 
@@ -27,6 +28,20 @@ public class Spy
     JTable channelTable = new JTable(channelTableModel);
     ChartData chartData;
 
+    // how often messages are decoded for open viewers, about the rate at
+    // which the display refreshes
+    static final long DECODE_PERIOD_MS = 33;
+
+    ScheduledExecutorService decoder = Executors.newSingleThreadScheduledExecutor(
+        new ThreadFactory() {
+            public Thread newThread(Runnable r)
+            {
+                Thread t = new Thread(r, "lcm-spy decoder");
+                t.setDaemon(true);
+                return t;
+            }
+        });
+
     ArrayList<SpyPlugin> plugins = new ArrayList<SpyPlugin>();
 
     JButton clearButton = new JButton("Clear");
@@ -80,6 +95,8 @@ public class Spy
         lcm.subscribeAll(new MySubscriber());
 
         new HzThread().start();
+        decoder.scheduleWithFixedDelay(new DecodeTask(), DECODE_PERIOD_MS, DECODE_PERIOD_MS,
+                                       TimeUnit.MILLISECONDS);
 
         clearButton.addActionListener(new ActionListener()
         {
@@ -323,36 +340,38 @@ public class Spy
 
     }
 
+    /** Keeps the per channel statistics, which only need the message
+     * header, and a copy of the last message. Decoding is left to
+     * DecodeTask, so that high rate channels don't stall the LCM thread.
+     **/
     class MySubscriber implements LCMSubscriber
     {
         public void messageReceived(LCM lcm, String channel, LCMDataInputStream dins)
         {
-            Object o = null;
             ChannelData cd = channelMap.get(channel);
-            int msg_size = 0;
 
             try {
-                msg_size = dins.available();
+                int msg_size = dins.available();
                 long fingerprint = (msg_size >=8) ? dins.readLong() : -1;
                 dins.reset();
 
-                Class cls = handlers.getClassByFingerprint(fingerprint);
+                if (cd == null || cd.fingerprint != fingerprint) {
+                    Class cls = handlers.getClassByFingerprint(fingerprint);
 
-                if (cd == null) {
-                    cd = new ChannelData();
-                    cd.name = channel;
-                    cd.cls = cls;
-                    cd.fingerprint = fingerprint;
-                    cd.row = channelList.size();
+                    if (cd == null) {
+                        cd = new ChannelData();
+                        cd.name = channel;
+                        cd.cls = cls;
+                        cd.fingerprint = fingerprint;
+                        cd.row = channelList.size();
 
-                    synchronized(channelList) {
-                        channelMap.put(channel, cd);
-                        channelList.add(cd);
-                        _channelTableModel.fireTableDataChanged();
-                    }
+                        synchronized(channelList) {
+                            channelMap.put(channel, cd);
+                            channelList.add(cd);
+                            _channelTableModel.fireTableDataChanged();
+                        }
 
-                } else {
-                    if (cls != null && cd.cls != null && !cd.cls.equals(cls)) {
+                    } else if (cls != null && cd.cls != null && !cd.cls.equals(cls)) {
                         System.out.println("WARNING: Class changed for channel "+channel);
                         cd.nerrors++;
                     }
@@ -367,31 +386,84 @@ public class Spy
 
                 cd.nreceived++;
 
-                o = ((Class<?>)cd.cls).getConstructor(DataInput.class).newInstance(dins);
-                cd.last = o;
-
-                if (cd.viewer != null)
-                    cd.viewer.setObject(o, cd.last_utime);
+                if (cd.cls == null) {
+                    cd.nerrors++;
+                    return;
+                }
 
-            } catch (NullPointerException ex) {
-                cd.nerrors++;
+                synchronized(cd) {
+                    if (cd.lastBytes == null || cd.lastBytes.length < msg_size)
+                        cd.lastBytes = new byte[msg_size];
+                    dins.readFully(cd.lastBytes, 0, msg_size);
+                    cd.lastLength = msg_size;
+                    cd.lastSeq++;
+                }
             } catch (IOException ex) {
-                cd.nerrors++;
+                if (cd != null)
+                    cd.nerrors++;
                 System.out.println("Spy.messageReceived ex: "+ex);
+            }
+        }
+    }
+
+    /** Decodes the last message of each channel whose viewer is open, if it
+     * has changed since the last run, and passes it to the viewer.
+     **/
+    class DecodeTask implements Runnable
+    {
+        public void run()
+        {
+            ArrayList<ChannelData> open = new ArrayList<ChannelData>();
+            synchronized(channelList) {
+                for (ChannelData cd : channelList) {
+                    JFrame frame = cd.viewerFrame;
+                    if (cd.viewer != null && frame != null && frame.isVisible())
+                        open.add(cd);
+                }
+            }
+
+            for (ChannelData cd : open) {
+                byte data[];
+                long utime;
+                synchronized(cd) {
+                    if (cd.lastSeq == cd.decodedSeq)
+                        continue;
+                    data = Arrays.copyOf(cd.lastBytes, cd.lastLength);
+                    utime = cd.last_utime;
+                    cd.decodedSeq = cd.lastSeq;
+                }
+
+                Object o = decode(cd, data);
+                if (o == null)
+                    continue;
+                cd.last = o;
+
+                ObjectPanel viewer = cd.viewer;
+                if (viewer != null)
+                    viewer.setObject(o, utime);
+            }
+        }
+
+        Object decode(ChannelData cd, byte data[])
+        {
+            try {
+                LCMDataInputStream dins = new LCMDataInputStream(data);
+                return ((Class<?>)cd.cls).getConstructor(DataInput.class).newInstance(dins);
             } catch (NoSuchMethodException ex) {
                 cd.nerrors++;
-                System.out.println("Spy.messageReceived ex: "+ex);
+                System.out.println("Spy.decode ex: "+ex);
             } catch (InstantiationException ex) {
                 cd.nerrors++;
-                System.out.println("Spy.messageReceived ex: "+ex);
+                System.out.println("Spy.decode ex: "+ex);
             } catch (IllegalAccessException ex) {
                 cd.nerrors++;
-                System.out.println("Spy.messageReceived ex: "+ex);
+                System.out.println("Spy.decode ex: "+ex);
             } catch (InvocationTargetException ex) {
                 cd.nerrors++;
                 // these are almost always spurious
                 //System.out.println("ex: "+ex+"..."+ex.getTargetException());
             }
+            return null;
         }
     }
 
@@ -58,6 +58,17 @@ static inline uint16_t decode_u16(const uint8_t *p)
     return v;
 }
 
+// FNV-1a hash of a channel name.
+static uint32_t hash_channel(const char *channel)
+{
+    uint32_t hash = 2166136261u;
+    for (const char *p = channel; *p != 0; p++) {
+        hash ^= (uint8_t) *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
 // Called by lcmlite internally when a packet is decoded. (Provides a
 // common delivery code path for fragmented and non-fragmented
 // packets.)
@@ -65,29 +76,15 @@ static void deliver_packet(lcmlite_t *lcm, const char *channel, const void *buf,
 {
     //    printf("deliver packet, channel %-30s, size %10d\n", channel, buflen);
 
-    for (lcmlite_subscription_t *sub = lcm->first_subscription; sub != NULL; sub = sub->next) {
-        int good = 1;
-
-        for (int pos = 0; 1; pos++) {
-            // special case: does the channel have a wildcard-like expression in it?
-            if (sub->channel[pos] == '.' && sub->channel[pos + 1] == '*')
-                break;
-
-            if (sub->channel[pos] == channel[pos]) {
-                // end of both strings? if so, we're done.
-                if (channel[pos] == 0)
-                    break;
-
-                // proceed to the next letter
-                continue;
-            }
-
-            // not a match.
-            good = 0;
-            break;
-        }
+    uint32_t hash = hash_channel(channel);
+    lcmlite_subscription_t *sub = lcm->subscriptions[hash % LCM_SUBSCRIPTION_BUCKETS];
+    for (; sub != NULL; sub = sub->next) {
+        if (sub->channel_hash == hash && !strcmp(sub->channel, channel))
+            sub->callback(lcm, channel, buf, buf_len, sub->user);
+    }
 
-        if (good)
+    for (sub = lcm->first_wildcard_subscription; sub != NULL; sub = sub->next) {
+        if (!strncmp(sub->channel, channel, sub->prefix_len))
             sub->callback(lcm, channel, buf, buf_len, sub->user);
     }
 }
@@ -103,6 +100,19 @@ int lcmlite_init(lcmlite_t *lcm, void (*transmit_packet)(const void *_buf, int b
     return 0;
 }
 
+int lcmlite_init_segments(lcmlite_t *lcm,
+                          void (*transmit_segments)(const void *header, int header_len,
+                                                    const void *payload, int payload_len,
+                                                    void *user),
+                          void *transmit_user)
+{
+    memset(lcm, 0, sizeof(lcmlite_t));
+    lcm->transmit_segments = transmit_segments;
+    lcm->transmit_user = transmit_user;
+
+    return 0;
+}
+
 /** Call this function whenever an LCM UDP packet is
  * received. Registered LCM handlers will be called
  * synchronously. When the function returns, the buffer can be safely
@@ -257,8 +267,35 @@ int lcmlite_receive_packet(lcmlite_t *lcm, const void *_buf, int buf_len, uint64
 
 void lcmlite_subscribe(lcmlite_t *lcm, lcmlite_subscription_t *sub)
 {
-    sub->next = lcm->first_subscription;
-    lcm->first_subscription = sub;
+    // special case: does the channel have a wildcard-like expression in it?
+    const char *wildcard = strstr(sub->channel, ".*");
+    if (wildcard) {
+        sub->prefix_len = wildcard - sub->channel;
+        sub->next = lcm->first_wildcard_subscription;
+        lcm->first_wildcard_subscription = sub;
+    } else {
+        sub->prefix_len = -1;
+        sub->channel_hash = hash_channel(sub->channel);
+        lcmlite_subscription_t **bucket =
+            &lcm->subscriptions[sub->channel_hash % LCM_SUBSCRIPTION_BUCKETS];
+        sub->next = *bucket;
+        *bucket = sub;
+    }
+}
+
+// Transmits a packet whose header_len bytes of header are at the start of
+// the publish buffer, followed by payload.  The payload is copied after the
+// header unless the packet is transmitted in segments.
+static void transmit_publish_buffer(lcmlite_t *lcm, uint32_t header_len, const void *payload,
+                                    uint32_t payload_len)
+{
+    if (lcm->transmit_segments) {
+        lcm->transmit_segments(lcm->publish_buffer, header_len, payload, payload_len,
+                               lcm->transmit_user);
+        return;
+    }
+    memcpy(&lcm->publish_buffer[header_len], payload, payload_len);
+    lcm->transmit_packet(lcm->publish_buffer, header_len + payload_len, lcm->transmit_user);
 }
 
 int lcmlite_publish(lcmlite_t *lcm, const char *channel, const void *_buf, int buf_len)
@@ -280,10 +317,7 @@ int lcmlite_publish(lcmlite_t *lcm, const char *channel, const void *_buf, int b
         }
         lcm->publish_buffer[buf_pos++] = 0;
 
-        memcpy(&lcm->publish_buffer[buf_pos], _buf, buf_len);
-        buf_pos += buf_len;
-
-        lcm->transmit_packet(lcm->publish_buffer, buf_pos, lcm->transmit_user);
+        transmit_publish_buffer(lcm, buf_pos, _buf, buf_len);
 
         return 0;
     } else {
@@ -325,11 +359,8 @@ int lcmlite_publish(lcmlite_t *lcm, const char *channel, const void *_buf, int b
             if (this_fragment_size > max_fragment_size)
                 this_fragment_size = max_fragment_size;
 
-            memcpy(&lcm->publish_buffer[buf_pos], &((char *) _buf)[fragment_offset],
-                   this_fragment_size);
-            buf_pos += this_fragment_size;
-
-            lcm->transmit_packet(lcm->publish_buffer, buf_pos, lcm->transmit_user);
+            transmit_publish_buffer(lcm, buf_pos, &((const char *) _buf)[fragment_offset],
+                                    this_fragment_size);
 
             fragment_offset += this_fragment_size;
             fragment_id++;
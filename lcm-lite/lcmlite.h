@@ -29,23 +29,49 @@
  * the defines below.
  **/
 
-// Disable long packet reception by setting NUM BUFFERS to zero.
+// Each of the defines below can be overridden when compiling, e.g. with
+// -DLCM3_NUM_BUFFERS=2, as long as every file that includes lcmlite.h
+// sees the same value.
+//
+// Disable long packet reception by setting NUM BUFFERS to zero. Each
+// buffer reassembles one fragmented message, so NUM_BUFFERS messages
+// from different senders can be in flight at once.
 // Total memory allocated is roughly:
 //
 // NUM_BUFFERS*(MAX_PACKET_SIZE + MAX_FRAGMENTS + CHANNEL_LENGTH) + PUBLISH_BUFFER_SIZE
 //
 // Note that for full LCM compatibility, CHANNEL_LENGTH must be 256.
 //
+#ifndef LCM3_NUM_BUFFERS
 #define LCM3_NUM_BUFFERS 4
+#endif
+#ifndef LCM3_MAX_PACKET_SIZE
 #define LCM3_MAX_PACKET_SIZE (300000)
+#endif
+#ifndef LCM3_MAX_FRAGMENTS
 #define LCM3_MAX_FRAGMENTS 256
+#endif
 
+#ifndef LCM_MAX_CHANNEL_LENGTH
 #define LCM_MAX_CHANNEL_LENGTH 256
+#endif
 
 // LCMLite will allocate a single buffer of the size below for
 // publishing messages. The LCM3 fragmentation option will be used to
-// send messages larger than this.
+// send messages larger than this. With lcmlite_init_segments(), only
+// the packet headers are written to this buffer, but it still sets the
+// size of the packets.
+#ifndef LCM_PUBLISH_BUFFER_SIZE
 #define LCM_PUBLISH_BUFFER_SIZE 8192
+#endif
+
+// Subscriptions to a channel name are found through a hash table with
+// this many buckets, so that a packet is only compared with the
+// subscriptions whose channel has the same hash. Subscriptions ending
+// with ".*" are compared with every packet.
+#ifndef LCM_SUBSCRIPTION_BUCKETS
+#define LCM_SUBSCRIPTION_BUCKETS 32
+#endif
 
 typedef struct lcmlite_subscription lcmlite_subscription_t;
 typedef struct lcmlite lcmlite_t;
@@ -68,8 +94,12 @@ struct lcmlite_subscription {
     void (*callback)(lcmlite_t *lcm, const char *channel, const void *buf, int buf_len, void *user);
     void *user;
 
-    // 'next' field is for lcmlite internal use.
+    // The remaining fields are for lcmlite internal use.
     lcmlite_subscription_t *next;
+    // hash of the channel, or the length of the prefix before ".*" for a
+    // wildcard subscription, which has prefix_len >= 0
+    uint32_t channel_hash;
+    int prefix_len;
 };
 
 struct lcmlite {
@@ -84,18 +114,33 @@ struct lcmlite {
     int32_t last_fragment_count;
 
     void (*transmit_packet)(const void *_buf, int buf_len, void *user);
+    void (*transmit_segments)(const void *header, int header_len, const void *payload,
+                              int payload_len, void *user);
     void *transmit_user;
 
     uint8_t publish_buffer[LCM_PUBLISH_BUFFER_SIZE];
     uint32_t msg_seq;
 
-    lcmlite_subscription_t *first_subscription;
+    lcmlite_subscription_t *subscriptions[LCM_SUBSCRIPTION_BUCKETS];
+    lcmlite_subscription_t *first_wildcard_subscription;
 };
 
 // Caller allocates the lcmlite_t object, which we initialize.
 int lcmlite_init(lcmlite_t *lcm, void (*transmit_packet)(const void *_buf, int buf_len, void *user),
                  void *transmit_user);
 
+// Like lcmlite_init(), but each packet is transmitted as two segments: its
+// header, which is in the lcmlite_t object, and its payload, which points
+// into the buffer passed to lcmlite_publish(). The packet is the header
+// followed by the payload. This avoids copying the message, for example when
+// the network interface can DMA the segments directly. The segments are only
+// valid until transmit_segments returns.
+int lcmlite_init_segments(lcmlite_t *lcm,
+                          void (*transmit_segments)(const void *header, int header_len,
+                                                    const void *payload, int payload_len,
+                                                    void *user),
+                          void *transmit_user);
+
 // The user is responsible for creating and listening on a UDP
 // multicast socket. When a packet is received, call this function. Do
 // not call this function from more than one thread at a time. Returns
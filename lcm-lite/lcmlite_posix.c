@@ -4,6 +4,10 @@
 // needed for MACOS and FreeBSD
 // #define USE_REUSEPORT
 
+// transmit the header and payload of each packet without copying them
+// together first
+// #define USE_TRANSMIT_SEGMENTS
+
 #include <arpa/inet.h>
 #include <assert.h>
 #include <netinet/in.h>
@@ -13,6 +17,7 @@
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "lcmlite.h"
@@ -32,6 +37,29 @@ void transmit_packet(const void *_buf, int buf_len, void *user)
         perror("transmit_packet: sendto");
 }
 
+void transmit_segments(const void *header, int header_len, const void *payload, int payload_len,
+                       void *user)
+{
+    struct transmit_info *tinfo = (struct transmit_info *) user;
+
+    struct iovec iov[2];
+    iov[0].iov_base = (void *) header;
+    iov[0].iov_len = header_len;
+    iov[1].iov_base = (void *) payload;
+    iov[1].iov_len = payload_len;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &tinfo->send_addr;
+    msg.msg_namelen = sizeof(tinfo->send_addr);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+
+    ssize_t res = sendmsg(tinfo->send_fd, &msg, 0);
+    if (res < 0)
+        perror("transmit_segments: sendmsg");
+}
+
 static void abc_callback(lcmlite_t *lcm, const char *channel, const void *buf, int buf_len,
                          void *user)
 {
@@ -124,7 +152,11 @@ int main(int argc, char *argv[])
     struct transmit_info tinfo;
     tinfo.send_addr = send_addr;
     tinfo.send_fd = send_fd;
+#ifdef USE_TRANSMIT_SEGMENTS
+    lcmlite_init_segments(&lcm, transmit_segments, &tinfo);
+#else
     lcmlite_init(&lcm, transmit_packet, &tinfo);
+#endif
 
     // subscribe to LCM messages
     if (1) {
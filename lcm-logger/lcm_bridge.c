@@ -0,0 +1,419 @@
+#include <getopt.h>
+#include <glib.h>
+#include <inttypes.h>
+#include <lcm/lcm.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "glib_util.h"
+
+#define DEFAULT_MAX_QUEUED_MB 100
+#define DEFAULT_BATCH_SIZE 64
+// the most messages that wait in the queue, whatever their size
+#define QUEUE_LENGTH 16384
+
+GMainLoop *_mainloop;
+
+// A --rename or --rate rule, for the channels that regex matches.
+typedef struct {
+    GRegex *regex;
+    char *replacement;
+    double rate;
+} rule_t;
+
+// What the bridge does with a channel: the channel it's published on, or NULL
+// if it's not forwarded, and the token bucket of its --rate, like that of
+// lcm-logger --decimate.
+typedef struct {
+    char *target;
+    double rate;
+    double tokens;
+    int64_t last_utime;
+    int64_t limited;
+} route_t;
+
+// A received message waiting to be published, which is retained instead of
+// copied.
+typedef struct {
+    const char *target;
+    lcm_recv_buf_t *rbuf;
+} queued_t;
+
+typedef struct {
+    lcm_t *src;
+    lcm_t *dst;
+    GRegex *exclude;
+    GPtrArray *renames;
+    GPtrArray *rates;
+    GHashTable *routes;  // char* -> route_t*
+    int batch_size;
+    int64_t max_queued_bytes;
+    int quiet;  // bool
+
+    // the messages waiting for the forward thread, in a ring of QUEUE_LENGTH,
+    // which are all guarded by mutex
+    GMutex mutex;
+    GCond cond;
+    queued_t queue[QUEUE_LENGTH];
+    int head;
+    int length;
+    int64_t queued_bytes;
+    int exit_flag;  // bool
+    GThread *forward_thread;
+
+    // these are only used by the main thread
+    int64_t received;
+    int64_t dropped;
+    int64_t bytes;
+    int64_t last_report_utime;
+    int64_t last_report_received;
+    int64_t last_report_bytes;
+} bridge_t;
+
+static int add_rule(GPtrArray *rules, const char *option, const char *arg, int is_rate)
+{
+    const char *sep = is_rate ? strrchr(arg, '=') : strchr(arg, '=');
+    if (!sep || sep == arg) {
+        fprintf(stderr, "ERROR.  --%s must be REGEX=%s\n", option, is_rate ? "HZ" : "NAME");
+        return 1;
+    }
+    rule_t *rule = g_new0(rule_t, 1);
+    if (is_rate) {
+        char *eptr = NULL;
+        rule->rate = strtod(sep + 1, &eptr);
+        if (eptr == sep + 1 || *eptr || rule->rate <= 0) {
+            fprintf(stderr, "ERROR.  --%s must be REGEX=HZ\n", option);
+            g_free(rule);
+            return 1;
+        }
+    } else {
+        rule->replacement = g_strdup(sep + 1);
+    }
+    char *regexbuf = g_strdup_printf("^%.*s$", (int) (sep - arg), arg);
+    GError *rerr = NULL;
+    rule->regex = g_regex_new(regexbuf, (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, &rerr);
+    g_free(regexbuf);
+    if (rerr) {
+        fprintf(stderr, "%s\n", rerr->message);
+        g_error_free(rerr);
+        g_free(rule->replacement);
+        g_free(rule);
+        return 1;
+    }
+    g_ptr_array_add(rules, rule);
+    return 0;
+}
+
+static void rule_free(void *p)
+{
+    rule_t *rule = (rule_t *) p;
+    g_regex_unref(rule->regex);
+    g_free(rule->replacement);
+    g_free(rule);
+}
+
+static void route_free(void *p)
+{
+    route_t *route = (route_t *) p;
+    g_free(route->target);
+    g_free(route);
+}
+
+// Returns the route of a channel, which is worked out once.
+static route_t *get_route(bridge_t *bridge, const char *channel)
+{
+    route_t *route = (route_t *) g_hash_table_lookup(bridge->routes, channel);
+    if (route)
+        return route;
+
+    route = g_new0(route_t, 1);
+    if (!bridge->exclude || !g_regex_match(bridge->exclude, channel, (GRegexMatchFlags) 0, NULL)) {
+        for (unsigned int i = 0; i < bridge->renames->len && !route->target; i++) {
+            rule_t *rule = (rule_t *) g_ptr_array_index(bridge->renames, i);
+            if (g_regex_match(rule->regex, channel, (GRegexMatchFlags) 0, NULL))
+                route->target = g_regex_replace(rule->regex, channel, -1, 0, rule->replacement,
+                                                (GRegexMatchFlags) 0, NULL);
+        }
+        if (!route->target)
+            route->target = g_strdup(channel);
+        for (unsigned int i = 0; i < bridge->rates->len; i++) {
+            rule_t *rule = (rule_t *) g_ptr_array_index(bridge->rates, i);
+            if (g_regex_match(rule->regex, channel, (GRegexMatchFlags) 0, NULL)) {
+                route->rate = rule->rate;
+                route->tokens = 1;
+                break;
+            }
+        }
+    }
+    g_hash_table_insert(bridge->routes, g_strdup(channel), route);
+    return route;
+}
+
+static void message_handler(const lcm_recv_buf_t *rbuf, const char *channel, void *user_data)
+{
+    bridge_t *bridge = (bridge_t *) user_data;
+    route_t *route = get_route(bridge, channel);
+    if (!route->target)
+        return;
+    bridge->received++;
+    bridge->bytes += rbuf->data_size;
+
+    if (route->rate > 0) {
+        if (route->last_utime)
+            route->tokens = MIN(1.0, route->tokens + (rbuf->recv_utime - route->last_utime) *
+                                                         route->rate / 1e6);
+        route->last_utime = rbuf->recv_utime;
+        if (route->tokens < 1) {
+            route->limited++;
+            return;
+        }
+        route->tokens -= 1;
+    }
+
+    g_mutex_lock(&bridge->mutex);
+    int full = bridge->length == QUEUE_LENGTH ||
+               bridge->queued_bytes + rbuf->data_size > bridge->max_queued_bytes;
+    g_mutex_unlock(&bridge->mutex);
+    // only this thread adds to the queue, so there's still room once the
+    // message is retained
+    lcm_recv_buf_t *retained = full ? NULL : lcm_recv_buf_retain(rbuf);
+    if (!retained) {
+        bridge->dropped++;
+        return;
+    }
+    g_mutex_lock(&bridge->mutex);
+    queued_t *queued = &bridge->queue[(bridge->head + bridge->length) % QUEUE_LENGTH];
+    queued->target = route->target;
+    queued->rbuf = retained;
+    bridge->length++;
+    bridge->queued_bytes += retained->data_size;
+    g_cond_signal(&bridge->cond);
+    g_mutex_unlock(&bridge->mutex);
+}
+
+// Publishes the queued messages, a batch at a time, from the buffers that
+// they were received into.
+static void *forward_thread(void *user_data)
+{
+    bridge_t *bridge = (bridge_t *) user_data;
+    lcm_publish_msg_t *msgs = g_new(lcm_publish_msg_t, bridge->batch_size);
+    queued_t *batch = g_new(queued_t, bridge->batch_size);
+
+    g_mutex_lock(&bridge->mutex);
+    while (1) {
+        while (!bridge->length && !bridge->exit_flag)
+            g_cond_wait(&bridge->cond, &bridge->mutex);
+        if (!bridge->length)
+            break;
+        int n = MIN(bridge->length, bridge->batch_size);
+        for (int i = 0; i < n; i++)
+            batch[i] = bridge->queue[(bridge->head + i) % QUEUE_LENGTH];
+        g_mutex_unlock(&bridge->mutex);
+
+        int64_t bytes = 0;
+        for (int i = 0; i < n; i++) {
+            msgs[i].channel = batch[i].target;
+            msgs[i].data = batch[i].rbuf->data;
+            msgs[i].datalen = batch[i].rbuf->data_size;
+            bytes += batch[i].rbuf->data_size;
+        }
+        if (0 != lcm_publish_batch(bridge->dst, msgs, n))
+            fprintf(stderr, "Error: failed to publish %d message%s\n", n, n == 1 ? "" : "s");
+        for (int i = 0; i < n; i++)
+            lcm_recv_buf_release(batch[i].rbuf);
+
+        g_mutex_lock(&bridge->mutex);
+        bridge->head = (bridge->head + n) % QUEUE_LENGTH;
+        bridge->length -= n;
+        bridge->queued_bytes -= bytes;
+    }
+    g_mutex_unlock(&bridge->mutex);
+
+    g_free(batch);
+    g_free(msgs);
+    return NULL;
+}
+
+static gboolean report(void *user_data)
+{
+    bridge_t *bridge = (bridge_t *) user_data;
+    int64_t now = g_get_real_time();
+    double dt = (now - bridge->last_report_utime) / 1e6;
+    int64_t limited = 0;
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, bridge->routes);
+    while (g_hash_table_iter_next(&iter, NULL, &value))
+        limited += ((route_t *) value)->limited;
+    printf("Received: %-9" PRIi64 " Rate limited: %-9" PRIi64 " Dropped: %-9" PRIi64
+           " Msg/s: %8.2f  KB/s: %8.2f\n",
+           bridge->received, limited, bridge->dropped,
+           (bridge->received - bridge->last_report_received) / dt,
+           (bridge->bytes - bridge->last_report_bytes) / dt / 1024.0);
+    bridge->last_report_utime = now;
+    bridge->last_report_received = bridge->received;
+    bridge->last_report_bytes = bridge->bytes;
+    return TRUE;
+}
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: lcm-bridge [options] FROM_URL TO_URL\n"
+            "\n"
+            "Forwards the messages received on the LCM URL FROM_URL to TO_URL, such as\n"
+            "from one multicast group to another, or to a remote site over tcpq.  Messages\n"
+            "are published from the buffers they were received into, in batches.  To\n"
+            "forward both ways, run a bridge each way with channels that don't overlap,\n"
+            "so that messages aren't forwarded back.\n"
+            "\n"
+            "Options:\n"
+            "\n"
+            "  -c, --channel=REGEX        Forward the channels that match REGEX.\n"
+            "                             (default: \".*\")\n"
+            "  -x, --exclude=REGEX        Don't forward the channels that match REGEX.\n"
+            "      --rename=REGEX=NAME    Publish the channels that match REGEX on NAME,\n"
+            "                             in which \\1 and so on are the groups of REGEX.\n"
+            "                             Can be repeated, and the first match is used.\n"
+            "      --rate=REGEX=HZ        Forward at most HZ messages per second of each\n"
+            "                             channel that matches REGEX.  Can be repeated,\n"
+            "                             and the first match is used.\n"
+            "  -b, --batch=N              Publish up to N messages at once.  (default: 64)\n"
+            "  -m, --max-queued-mb=SZ     Maximum size of messages waiting to be published\n"
+            "                             before dropping messages.  (default: 100 MB)\n"
+            "  -q, --quiet                Don't print statistics every second.\n"
+            "  -h, --help                 Shows this help text and exits.\n"
+            "\n"
+            "Example:\n"
+            "    # Forward the POSE channels to a remote site, as SITE_A_POSE...\n"
+            "    lcm-bridge -c 'POSE.*' --rename='(.*)=SITE_A_\\1' \\\n"
+            "        udpm://239.255.76.67:7667 tcpq://remote:7700\n"
+            "\n");
+}
+
+int main(int argc, char *argv[])
+{
+    bridge_t bridge;
+    memset(&bridge, 0, sizeof(bridge));
+    bridge.renames = g_ptr_array_new_with_free_func(rule_free);
+    bridge.rates = g_ptr_array_new_with_free_func(rule_free);
+    bridge.routes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, route_free);
+    bridge.batch_size = DEFAULT_BATCH_SIZE;
+    double max_queued_mb = DEFAULT_MAX_QUEUED_MB;
+    char *chan_regex = strdup(".*");
+
+    const char *optstring = "b:c:hm:qx:";
+    struct option long_opts[] = {
+        {"batch", required_argument, 0, 'b'},
+        {"channel", required_argument, 0, 'c'},
+        {"help", no_argument, 0, 'h'},
+        {"max-queued-mb", required_argument, 0, 'm'},
+        {"quiet", no_argument, 0, 'q'},
+        {"exclude", required_argument, 0, 'x'},
+        {"rename", required_argument, 0, 128},
+        {"rate", required_argument, 0, 129},
+        {0, 0, 0, 0},
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, optstring, long_opts, 0)) >= 0) {
+        switch (c) {
+        case 'b': /* --batch */
+            bridge.batch_size = atoi(optarg);
+            if (bridge.batch_size <= 0) {
+                usage();
+                return 1;
+            }
+            break;
+        case 'c': /* --channel */
+            free(chan_regex);
+            chan_regex = strdup(optarg);
+            break;
+        case 'm': /* --max-queued-mb */
+            max_queued_mb = strtod(optarg, NULL);
+            if (max_queued_mb <= 0) {
+                usage();
+                return 1;
+            }
+            break;
+        case 'q': /* --quiet */
+            bridge.quiet = 1;
+            break;
+        case 'x': { /* --exclude */
+            if (bridge.exclude)
+                g_regex_unref(bridge.exclude);
+            char *regexbuf = g_strdup_printf("^%s$", optarg);
+            GError *rerr = NULL;
+            bridge.exclude =
+                g_regex_new(regexbuf, (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, &rerr);
+            g_free(regexbuf);
+            if (rerr) {
+                fprintf(stderr, "%s\n", rerr->message);
+                return 1;
+            }
+        } break;
+        case 128: /* --rename */
+            if (0 != add_rule(bridge.renames, "rename", optarg, 0))
+                return 1;
+            break;
+        case 129: /* --rate */
+            if (0 != add_rule(bridge.rates, "rate", optarg, 1))
+                return 1;
+            break;
+        case 'h':
+        default:
+            usage();
+            return 1;
+        };
+    }
+    if (argc - optind != 2) {
+        usage();
+        return 1;
+    }
+    bridge.max_queued_bytes = (int64_t) (max_queued_mb * (1 << 20));
+
+    bridge.src = lcm_create(argv[optind]);
+    bridge.dst = lcm_create(argv[optind + 1]);
+    if (!bridge.src || !bridge.dst) {
+        fprintf(stderr, "Couldn't initialize LCM!\n");
+        return 1;
+    }
+
+    g_mutex_init(&bridge.mutex);
+    g_cond_init(&bridge.cond);
+    bridge.forward_thread = g_thread_new(NULL, forward_thread, &bridge);
+
+    lcm_subscribe(bridge.src, chan_regex, message_handler, &bridge);
+    free(chan_regex);
+
+    _mainloop = g_main_loop_new(NULL, FALSE);
+    signal_pipe_glib_quit_on_kill();
+    glib_mainloop_attach_lcm(bridge.src);
+    if (!bridge.quiet) {
+        bridge.last_report_utime = g_get_real_time();
+        g_timeout_add(1000, report, &bridge);
+    }
+
+    g_main_loop_run(_mainloop);
+
+    // publish what's queued, and release it before the source is destroyed
+    g_mutex_lock(&bridge.mutex);
+    bridge.exit_flag = 1;
+    g_cond_signal(&bridge.cond);
+    g_mutex_unlock(&bridge.mutex);
+    g_thread_join(bridge.forward_thread);
+
+    glib_mainloop_detach_lcm(bridge.src);
+    lcm_destroy(bridge.src);
+    lcm_destroy(bridge.dst);
+    g_main_loop_unref(_mainloop);
+    g_mutex_clear(&bridge.mutex);
+    g_cond_clear(&bridge.cond);
+    g_hash_table_destroy(bridge.routes);
+    g_ptr_array_free(bridge.renames, TRUE);
+    g_ptr_array_free(bridge.rates, TRUE);
+    if (bridge.exclude)
+        g_regex_unref(bridge.exclude);
+    return 0;
+}
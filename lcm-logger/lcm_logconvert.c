@@ -0,0 +1,334 @@
+#include <getopt.h>
+#include <glib.h>
+#include <lcm/lcm.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WIN32
+#include <winsock2.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+// the channel of the datagrams that lcm-logger --raw logs, and the bytes of
+// the sender's address and port before each datagram
+#define RAW_CHANNEL "LCM_UDPM_RAW"
+#define RAW_ADDR_SIZE 6
+
+#define MAGIC_SHORT 0x4c433032   // LC02, a message in one datagram
+#define MAGIC_LONG 0x4c433033    // LC03, a fragment of a message
+#define MAGIC_BUNDLE 0x4c433034  // LC04, several short messages
+#define MAGIC_NACK 0x4c433037    // LC07, a request for missing fragments
+#define SHORT_HEADER_SIZE 8
+#define LONG_HEADER_SIZE 20
+
+static void usage(char *cmd)
+{
+    fprintf(stderr,
+            "\
+Usage: %s [OPTION...] INPUT OUTPUT\n\n\
+Converts the LCM log file INPUT to OUTPUT, in the block format if INPUT is in\n\
+the original format, or in the original format if INPUT is a block log.\n\
+\n\
+Options:\n\
+  -h, --help          Shows some help text and exits.\n\
+  -r, --reassemble    Turns the datagrams that lcm-logger --raw logged in INPUT\n\
+                      into the messages that they make up, in OUTPUT in the\n\
+                      original format.  Compressed, delta and parity datagrams\n\
+                      are skipped.\n\
+  \n",
+            cmd);
+}
+
+static int to_block_log(const char *input, const char *output)
+{
+    lcm_eventlog_t *in = lcm_eventlog_create(input, "r");
+    if (!in) {
+        fprintf(stderr, "Error: Failed to open %s\n", input);
+        return -1;
+    }
+    lcm_blocklog_t *out = lcm_blocklog_create(output, "w");
+    if (!out) {
+        fprintf(stderr, "Error: Failed to open %s\n", output);
+        lcm_eventlog_destroy(in);
+        return -1;
+    }
+
+    int status = 0;
+    lcm_eventlog_event_t event = {0};
+    size_t capacity = 0;
+    while (0 == lcm_eventlog_read_next_event_into(in, &event, &capacity)) {
+        if (0 != lcm_blocklog_write_event(out, &event)) {
+            status = -1;
+            break;
+        }
+    }
+    free(event.channel);
+    lcm_blocklog_destroy(out);
+    lcm_eventlog_destroy(in);
+    return status;
+}
+
+static int from_block_log(const char *input, const char *output)
+{
+    lcm_blocklog_t *in = lcm_blocklog_create(input, "r");
+    if (!in) {
+        fprintf(stderr, "Error: Failed to open %s\n", input);
+        return -1;
+    }
+    lcm_eventlog_t *out = lcm_eventlog_create(output, "w");
+    if (!out) {
+        fprintf(stderr, "Error: Failed to open %s\n", output);
+        lcm_blocklog_destroy(in);
+        return -1;
+    }
+
+    int status = 0;
+    const lcm_eventlog_event_t *le;
+    while ((le = lcm_blocklog_read_next_event(in))) {
+        lcm_eventlog_event_t event = *le;
+        if (0 != lcm_eventlog_write_event(out, &event)) {
+            status = -1;
+            break;
+        }
+    }
+    lcm_eventlog_destroy(out);
+    lcm_blocklog_destroy(in);
+    return status;
+}
+
+static uint32_t read_u32(const char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return ntohl(v);
+}
+
+static uint16_t read_u16(const char *p)
+{
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return ntohs(v);
+}
+
+// The fragments received so far of a sender's message.  Like udpm, only the
+// latest message of each sender is reassembled, since its fragments are sent
+// one after another.
+typedef struct {
+    uint32_t seqno;
+    uint32_t size;
+    uint16_t num_fragments;
+    uint16_t received;
+    char *channel;  // once the first fragment is received
+    char *data;
+    uint8_t *have;  // a bit for each fragment
+} message_t;
+
+static void message_free(message_t *msg)
+{
+    free(msg->channel);
+    free(msg->data);
+    free(msg->have);
+    free(msg);
+}
+
+typedef struct {
+    lcm_eventlog_t *out;
+    GHashTable *messages;  // message_t of each sender
+    int64_t timestamp;     // of the datagram
+    int64_t incomplete;
+    int64_t skipped;
+    int status;
+} reassembly_t;
+
+static void reassembly_write(reassembly_t *r, const char *channel, const char *data,
+                             uint32_t size)
+{
+    lcm_eventlog_event_t event = {0};
+    event.timestamp = r->timestamp;
+    event.channellen = strlen(channel);
+    event.channel = (char *) channel;
+    event.datalen = size;
+    event.data = (void *) data;
+    if (0 != lcm_eventlog_write_event(r->out, &event))
+        r->status = -1;
+}
+
+static void reassemble_fragment(reassembly_t *r, uint64_t sender, const char *buf, int size)
+{
+    uint32_t seqno = read_u32(buf + 4);
+    uint32_t msg_size = read_u32(buf + 8);
+    uint32_t offset = read_u32(buf + 12);
+    uint16_t fragment_no = read_u16(buf + 16);
+    uint16_t num_fragments = read_u16(buf + 18);
+    const char *payload = buf + LONG_HEADER_SIZE;
+    const char *end = buf + size;
+    if (fragment_no >= num_fragments)
+        return;
+
+    message_t *msg = (message_t *) g_hash_table_lookup(r->messages, &sender);
+    if (msg && (msg->seqno != seqno || msg->size != msg_size ||
+                msg->num_fragments != num_fragments)) {
+        r->incomplete++;
+        g_hash_table_remove(r->messages, &sender);
+        msg = NULL;
+    }
+    if (!msg) {
+        msg = (message_t *) calloc(1, sizeof(message_t));
+        msg->seqno = seqno;
+        msg->size = msg_size;
+        msg->num_fragments = num_fragments;
+        msg->data = (char *) malloc(msg_size ? msg_size : 1);
+        msg->have = (uint8_t *) calloc((num_fragments + 7) / 8, 1);
+        uint64_t *key = g_new(uint64_t, 1);
+        *key = sender;
+        g_hash_table_insert(r->messages, key, msg);
+    }
+    if (msg->have[fragment_no / 8] & (1 << (fragment_no % 8)))
+        return;  // sent again, for a NACK
+    if (fragment_no == 0) {
+        const char *nul = (const char *) memchr(payload, 0, end - payload);
+        if (!nul)
+            return;
+        msg->channel = strdup(payload);
+        payload = nul + 1;
+    }
+    uint32_t len = end - payload;
+    if (offset > msg_size || len > msg_size - offset)
+        return;
+    memcpy(msg->data + offset, payload, len);
+    msg->have[fragment_no / 8] |= 1 << (fragment_no % 8);
+    msg->received++;
+    if (msg->received == msg->num_fragments) {
+        reassembly_write(r, msg->channel, msg->data, msg->size);
+        g_hash_table_remove(r->messages, &sender);
+    }
+}
+
+static void reassemble_datagram(reassembly_t *r, const char *buf, int size)
+{
+    if (size < RAW_ADDR_SIZE + SHORT_HEADER_SIZE)
+        return;
+    uint64_t sender = ((uint64_t) read_u32(buf) << 16) | read_u16(buf + 4);
+    buf += RAW_ADDR_SIZE;
+    size -= RAW_ADDR_SIZE;
+    const char *end = buf + size;
+
+    uint32_t magic = read_u32(buf);
+    if (magic == MAGIC_SHORT) {
+        const char *channel = buf + SHORT_HEADER_SIZE;
+        const char *nul = (const char *) memchr(channel, 0, end - channel);
+        if (nul)
+            reassembly_write(r, channel, nul + 1, end - nul - 1);
+    } else if (magic == MAGIC_BUNDLE) {
+        const char *pos = buf + SHORT_HEADER_SIZE;
+        while (pos < end) {
+            const char *nul = (const char *) memchr(pos, 0, end - pos);
+            if (!nul || end - nul < 5)
+                break;
+            uint32_t len = read_u32(nul + 1);
+            if (len > (uint32_t) (end - nul - 5))
+                break;
+            reassembly_write(r, pos, nul + 5, len);
+            pos = nul + 5 + len;
+        }
+    } else if (magic == MAGIC_LONG) {
+        if (size >= LONG_HEADER_SIZE)
+            reassemble_fragment(r, sender, buf, size);
+    } else if (magic != MAGIC_NACK) {
+        r->skipped++;
+    }
+}
+
+// Writes the events of input to output, with those of lcm-logger --raw
+// turned into the messages that their datagrams make up.
+static int reassemble(const char *input, const char *output)
+{
+    lcm_eventlog_t *in = lcm_eventlog_create(input, "r");
+    if (!in) {
+        fprintf(stderr, "Error: Failed to open %s\n", input);
+        return -1;
+    }
+    reassembly_t r = {0};
+    r.out = lcm_eventlog_create(output, "w");
+    if (!r.out) {
+        fprintf(stderr, "Error: Failed to open %s\n", output);
+        lcm_eventlog_destroy(in);
+        return -1;
+    }
+    r.messages = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free,
+                                       (GDestroyNotify) message_free);
+
+    lcm_eventlog_event_t event = {0};
+    size_t capacity = 0;
+    while (r.status == 0 && 0 == lcm_eventlog_read_next_event_into(in, &event, &capacity)) {
+        if (strcmp(event.channel, RAW_CHANNEL)) {
+            if (0 != lcm_eventlog_write_event(r.out, &event))
+                r.status = -1;
+            continue;
+        }
+        r.timestamp = event.timestamp;
+        reassemble_datagram(&r, (const char *) event.data, event.datalen);
+    }
+    r.incomplete += g_hash_table_size(r.messages);
+    if (r.incomplete)
+        fprintf(stderr, "%" PRIi64 " messages were missing fragments\n", r.incomplete);
+    if (r.skipped)
+        fprintf(stderr, "Skipped %" PRIi64 " compressed, delta or parity datagrams\n",
+                r.skipped);
+
+    g_hash_table_destroy(r.messages);
+    free(event.channel);
+    lcm_eventlog_destroy(r.out);
+    lcm_eventlog_destroy(in);
+    return r.status;
+}
+
+int main(int argc, char **argv)
+{
+    int c;
+    struct option long_opts[] = {
+        {"help", no_argument, 0, 'h'},
+        {"reassemble", no_argument, 0, 'r'},
+        {0, 0, 0, 0},
+    };
+
+    int raw = 0;
+    while ((c = getopt_long(argc, argv, "hr", long_opts, 0)) >= 0) {
+        switch (c) {
+        case 'r':
+            raw = 1;
+            break;
+        case 'h':
+        default:
+            usage(argv[0]);
+            return 1;
+        };
+    }
+
+    if (argc - optind != 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const char *input = argv[optind];
+    const char *output = argv[optind + 1];
+    int status;
+    if (raw && lcm_blocklog_detect(input)) {
+        fprintf(stderr, "Error: --reassemble needs a log in the original format\n");
+        return 1;
+    }
+    if (raw)
+        status = reassemble(input, output);
+    else if (lcm_blocklog_detect(input))
+        status = from_block_log(input, output);
+    else
+        status = to_block_log(input, output);
+    if (0 != status) {
+        fprintf(stderr, "Error: Failed to convert %s\n", input);
+        return 1;
+    }
+    return 0;
+}
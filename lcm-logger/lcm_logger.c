@@ -1,3 +1,8 @@
+#ifdef __linux__
+// fallocate() and sync_file_range() are GNU extensions
+#define _GNU_SOURCE
+#endif
+
 #include <assert.h>
 #include <errno.h>
 #include <getopt.h>
@@ -5,6 +10,7 @@
 #include <glib/gstdio.h>
 #include <lcm/lcm.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -28,9 +34,18 @@
 #endif
 
 #ifndef WIN32
+#include <arpa/inet.h>
+#include <fcntl.h> /* open */
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/statvfs.h>
 #endif
 
+#ifdef __linux__
+#include <fcntl.h> /* fallocate, sync_file_range */
+#endif
+
 #include <inttypes.h>
 
 #include "glib_util.h"
@@ -39,7 +54,41 @@
 #define USE_SIGHUP
 #endif
 
+#ifdef SIGUSR1
+#define USE_SIGUSR1
+#endif
+
 #define DEFAULT_MAX_WRITE_QUEUE_SIZE_MB 100
+// the most queued events that the write thread writes at once
+#define WRITE_BATCH_SIZE 256
+// log files grow by this much preallocated space at a time, or by the
+// --split-mb size, so that the filesystem doesn't allocate with every write
+#define PREALLOCATE_SIZE (64 << 20)
+// written data is handed to the disk every this many bytes, so that syncs have
+// little left to write
+#define WRITE_BEHIND_SIZE (8 << 20)
+// messages of at least this many bytes are kept with lcm_recv_buf_retain()
+// until they are written, instead of being copied into the write queue
+#define RETAIN_MIN_SIZE 4096
+// how often the write thread of --ring looks for a SIGUSR1, and for the end of
+// --ring-post, while no messages arrive
+#define RING_POLL_INTERVAL_US 100000
+
+// the channel of the event at the start of each log file that lists the
+// --decimate rules
+#define DECIMATION_CHANNEL "LCM_LOGGER_DECIMATION"
+
+// the channel of the datagrams of --raw, whose data is the 4-byte IPv4 address
+// and 2-byte port that a datagram came from, in network order, followed by the
+// datagram
+#define RAW_CHANNEL "LCM_UDPM_RAW"
+#define RAW_ADDR_SIZE 6
+// --raw receives up to this many datagrams at once, into buffers of the
+// largest datagram
+#define RAW_BATCH_SIZE 64
+#define RAW_DATAGRAM_SIZE 65536
+// and takes up to this many batches before the main loop runs again
+#define RAW_MAX_BATCHES 16
 
 #define SECONDS_PER_HOUR 3600
 
@@ -50,6 +99,9 @@ GMainLoop *_mainloop;
 // in some way in response to SIGHUP. lcm-logger responds by rotating logs.
 static int _reset_logfile = 0;  // bool
 
+// Set by SIGUSR1, to have --ring write the recent events to a log file.
+static int _ring_trigger = 0;  // bool
+
 static inline int64_t timestamp_seconds(int64_t v)
 {
     return v / 1000000;
@@ -194,7 +246,115 @@ static int64_t parse_mem_size(const char *str)
     return val * scale;
 }
 
+// A message waiting to be written.  It's 8-byte aligned in the event ring,
+// and a size of 0 instead means that the rest of the ring is unused, and the
+// next message is at its start.
+typedef struct {
+    size_t size;
+    lcm_eventlog_event_t event;
+    // the received message that event.data points into, if it wasn't copied
+    lcm_recv_buf_t *retained;
+    // followed by the channel, NUL-terminated, and the data unless retained
+} queued_event_t;
+
+// The messages waiting to be written, in a ring of max_write_queue_size bytes
+// that's allocated up front.  Only the message handler moves head, and only
+// the write thread moves tail, so all that they share is the number of bytes
+// used.
+typedef struct {
+    char *buf;
+    size_t capacity;
+    size_t head;
+    size_t tail;
+    // the bytes of the last message reserved, with any skipped at the end
+    size_t reserved;
+    gsize used;
+    // the bytes of the retained messages that the queued ones point to, which
+    // count against the capacity too
+    size_t retained_reserved;
+    gsize retained;
+    // set while the write thread waits for messages
+    int waiting;
+    GMutex mutex;
+    GCond cond;
+} event_ring_t;
+
+// The preallocated space of a log file, and how much of it is written to disk.
+typedef struct {
+    int64_t allocated;
+    int64_t written_behind;
+    // the size to preallocate next, or 0 once done
+    int64_t chunk;
+    int grow;          // bool
+    int preallocated;  // bool
+} file_space_t;
+
+// A message kept by --ring.  It's 8-byte aligned in the flight ring, and a
+// size of 0 instead means that the rest of the ring is unused, like in the
+// event ring.
+typedef struct {
+    size_t size;
+    int64_t timestamp;
+    int32_t channellen;
+    int32_t datalen;
+    // followed by the channel, NUL-terminated, and the data
+} ring_record_t;
+
+// The recent messages of --ring, in a ring of capacity bytes that's
+// allocated, or mapped from a file, up front.  The oldest are dropped to make
+// room for new ones, and once they're older than window.  Only the write
+// thread uses it.
+typedef struct {
+    char *buf;
+    size_t capacity;
+    size_t head;
+    size_t tail;
+    // the bytes from tail to head, with any skipped at the end
+    size_t used;
+    int64_t num_records;
+    // the microseconds of messages kept, or 0 for as many as fit
+    int64_t window;
+    int mapped;  // bool
+} flight_ring_t;
+
+// What the message handler knows of a channel: the write_queue that its
+// messages go to, or NULL if they're not logged, and how many were received.
+typedef struct {
+    event_ring_t *queue;
+    int64_t events;
+    int64_t bytes;
+    int64_t dropped;
+    // the messages per second that --decimate logs, or 0 for all of them, the
+    // token bucket that has a token for each message that may be logged, and
+    // the messages left out
+    double rate;
+    double tokens;
+    int64_t last_utime;
+    int64_t decimated;
+} channel_stats_t;
+
+// A --decimate rule, which logs at most rate messages per second of each
+// channel that regex matches.
+typedef struct {
+    GRegex *regex;
+    double rate;
+} decimation_t;
+
 typedef struct logger logger_t;
+
+// A group of channels that's logged to a file of its own, by a write thread
+// of its own, so that the log can be written to several disks at once.
+typedef struct {
+    GRegex *regex;
+    char fname[PATH_MAX];
+    lcm_eventlog_t *log;
+    event_ring_t write_queue;
+    file_space_t space;
+    GThread *write_thread;
+    logger_t *logger;
+    int64_t last_fflush_time;
+} shard_t;
+
 struct logger {
     lcm_eventlog_t *log;
 
@@ -215,19 +375,39 @@ struct logger {
     int rotate;
     int quiet;   // bool
     int append;  // bool
+    int index;   // bool
     int64_t disk_quota;
 
+    // the shards, and the channel_stats_t of each channel that's been
+    // received, whose write_queue is the shard's if a shard's regex matches
+    // the channel
+    GPtrArray *shards;
+    GHashTable *channels;
+    // the decimation_t of --decimate, of which the first match is used
+    GPtrArray *decimations;
+    // the number of the next event, across the shards
+    int64_t next_eventnum;
+
     GThread *write_thread;
-    GAsyncQueue *write_queue;
-    GMutex mutex;
+    event_ring_t write_queue;
+    file_space_t space;
+
+    // syncs the log file to disk, so that the write thread doesn't wait for
+    // the disk
+    GThread *sync_thread;
+    GMutex sync_mutex;
+    GCond sync_cond;
+    // a duplicate of the log file's descriptor while it's synced, so that the
+    // log file can be closed in the meantime, or -1
+    int sync_fd;
+    int sync_thread_exit_flag;  // bool
 
     // bool for inverted matching (e.g., logging all but some channels)
     int invert_channels;
     GRegex *regex;
 
-    // these members controlled by mutex
+    // these members are set under write_queue.mutex, and read atomically
     struct {
-        int64_t write_queue_size;
         int write_thread_exit_flag;  // bool
     } sync;
     // these members controlled by write thread
@@ -245,8 +425,102 @@ struct logger {
     int64_t last_drop_report_count;
 
     int64_t last_quota_time;
+
+    // the channel that statistics are published on every stats_interval_ms,
+    // or NULL, and the totals as of the last time
+    char *stats_channel;
+    int stats_interval_ms;
+    int64_t last_stats_time;
+    int64_t last_stats_events;
+    int64_t last_stats_bytes;
+
+    // --ring: the recent messages that are kept in memory instead of being
+    // logged, until a SIGUSR1 or a message on a channel that matches
+    // ring_trigger has them written to a new log file, along with the
+    // messages of the following ring_post microseconds
+    int ring_enabled;  // bool
+    flight_ring_t ring;
+    char *ring_file;
+    char *ring_trigger;
+    int64_t ring_post;
+    int ring_triggered;  // bool, set atomically
+
+    // --raw: the socket that's joined to the udpm multicast group instead of
+    // subscribing, whose datagrams are logged as they are on RAW_CHANNEL, the
+    // buffers that they're received into, and the --ring-trigger to look for
+    // in their channels
+    int raw;  // bool
+    int raw_fd;
+    char *raw_bufs;
+    channel_stats_t *raw_stats;
+    GRegex *raw_trigger;
 };
 
+// Starts keeping chunk bytes preallocated past the end of the log file, or if
+// grow isn't set, preallocates just the first chunk, for a log file that's
+// split instead of growing any further.
+static void file_space_init(file_space_t *space, lcm_eventlog_t *log, int64_t chunk, int grow)
+{
+    memset(space, 0, sizeof(*space));
+#ifdef __linux__
+    off_t end = lseek(fileno(log->f), 0, SEEK_END);
+    space->allocated = space->written_behind = end < 0 ? 0 : end;
+    space->chunk = chunk;
+    space->grow = grow;
+#else
+    (void) log;
+    (void) chunk;
+    (void) grow;
+#endif
+}
+
+// Hands the data written since last time to the disk without waiting for it,
+// and preallocates the next chunk once the log file nears the end of its space.
+static void file_space_update(file_space_t *space, lcm_eventlog_t *log)
+{
+#ifdef __linux__
+    int fd = fileno(log->f);
+    off_t end = lseek(fd, 0, SEEK_CUR);
+    if (end < 0)
+        return;
+    if (end - space->written_behind >= WRITE_BEHIND_SIZE) {
+        sync_file_range(fd, space->written_behind, end - space->written_behind,
+                        SYNC_FILE_RANGE_WRITE);
+        space->written_behind = end;
+    }
+    if (space->chunk > 0 && end + space->chunk / 4 >= space->allocated) {
+        space->preallocated = 1;
+        if (0 != fallocate(fd, FALLOC_FL_KEEP_SIZE, space->allocated, space->chunk)) {
+            // filesystems that can't preallocate just grow by writes
+            space->chunk = 0;
+        } else {
+            space->allocated += space->chunk;
+            if (!space->grow)
+                space->chunk = 0;
+        }
+    }
+#else
+    (void) space;
+    (void) log;
+#endif
+}
+
+// Closes the log file, freeing any preallocated space past its end.
+static void close_logfile(lcm_eventlog_t *log, const file_space_t *space)
+{
+#ifdef __linux__
+    if (space->preallocated) {
+        fflush(log->f);
+        off_t end = lseek(fileno(log->f), 0, SEEK_END);
+        if (end >= 0 && 0 != ftruncate(fileno(log->f), end))
+            perror("Error: ftruncate failed");
+    }
+#else
+    (void) space;
+#endif
+    lcm_eventlog_destroy(log);
+}
+
 static void rotate_logfiles(logger_t *logger)
 {
     if (!logger->quiet) {
@@ -260,6 +534,10 @@ static void rotate_logfiles(logger_t *logger)
         }
     }
     g_free(tomove);
+    tomove = g_strdup_printf("%s.%d.idx", logger->fname_prefix, logger->rotate - 1);
+    if (g_file_test(tomove, G_FILE_TEST_EXISTS))
+        g_unlink(tomove);
+    g_free(tomove);
 
     // Rotate away any existing log files
     for (int file_num = logger->rotate - 1; file_num >= 0; file_num--) {
@@ -272,7 +550,77 @@ static void rotate_logfiles(logger_t *logger)
         }
         g_free(newname);
         g_free(tomove);
+
+        // the index of the log file, if any, goes with it
+        newname = g_strdup_printf("%s.%d.idx", logger->fname_prefix, file_num);
+        tomove = g_strdup_printf("%s.%d.idx", logger->fname_prefix, file_num - 1);
+        if (g_file_test(tomove, G_FILE_TEST_EXISTS))
+            g_rename(tomove, newname);
+        g_free(newname);
+        g_free(tomove);
+    }
+}
+
+// Removes the incomplete event that a logger which stopped while writing the
+// log file may have left at its end, before appending to it.  Returns the
+// number of the next event, or -1 on failure.
+static int64_t recover_logfile(logger_t *logger, const char *fname)
+{
+    if (!g_file_test(fname, G_FILE_TEST_EXISTS))
+        return 0;
+    int64_t next_eventnum;
+    int64_t removed = lcm_eventlog_recover(fname, &next_eventnum);
+    if (removed < 0) {
+        fprintf(stderr, "Refusing to append to \"%s\", which isn't a log file\n", fname);
+        return -1;
     }
+    if (removed > 0 && !logger->quiet)
+        printf("Removed %" PRIi64 " bytes of an incomplete event from the end of \"%s\"\n",
+               removed, fname);
+    return next_eventnum;
+}
+
+// Writes the DECIMATION_CHANNEL event, whose data is the text "LCM-DECIMATE 1"
+// and a line of the regular expression and rate of each --decimate rule, so
+// that readers of the log know the rate that its channels were logged at.
+static int write_decimations(logger_t *logger)
+{
+    if (!logger->decimations->len)
+        return 0;
+    GString *text = g_string_new("LCM-DECIMATE 1\n");
+    for (unsigned int i = 0; i < logger->decimations->len; i++) {
+        decimation_t *decimation = (decimation_t *) g_ptr_array_index(logger->decimations, i);
+        g_string_append_printf(text, "%s\t%g\n", g_regex_get_pattern(decimation->regex),
+                               decimation->rate);
+    }
+    lcm_eventlog_event_t le;
+    memset(&le, 0, sizeof(le));
+    le.timestamp = g_get_real_time();
+    // --ring writes older messages after it
+    if (logger->ring_enabled && logger->ring.num_records) {
+        ring_record_t *oldest = (ring_record_t *) (logger->ring.buf + logger->ring.tail);
+        if (oldest->size == 0)
+            oldest = (ring_record_t *) logger->ring.buf;
+        le.timestamp = oldest->timestamp;
+    }
+    le.channellen = strlen(DECIMATION_CHANNEL);
+    le.channel = (char *) DECIMATION_CHANNEL;
+    le.datalen = text->len;
+    le.data = text->str;
+    lcm_eventlog_event_t *events[1] = {&le};
+    int status;
+    if (logger->shards->len) {
+        le.eventnum = logger->next_eventnum++;
+        status = lcm_eventlog_write_numbered_events(logger->log, events, 1);
+    } else {
+        status = lcm_eventlog_write_events(logger->log, events, 1);
+    }
+    g_string_free(text, TRUE);
+    if (0 != status) {
+        perror("Error: failed to write the decimation event");
+        return 1;
+    }
+    return 0;
 }
 
 static int open_logfile(logger_t *logger)
@@ -331,6 +679,11 @@ static int open_logfile(logger_t *logger)
         printf("Opening log file \"%s\"\n", logger->fname);
     }
 
+    // the events appended are numbered after those in the log file
+    int64_t next_eventnum = 0;
+    if (logger->append && (next_eventnum = recover_logfile(logger, logger->fname)) < 0)
+        return 1;
+
     // open output file in append mode if we're rotating log files or appending
     // use write mode if not.
     const char *logmode = (logger->rotate > 0 || logger->append) ? "a" : "w";
@@ -339,15 +692,301 @@ static int open_logfile(logger_t *logger)
         perror("Error: fopen failed");
         return 1;
     }
+    logger->log->eventcount = next_eventnum;
+    if (logger->index && 0 != lcm_eventlog_write_index(logger->log))
+        return 1;
+    // a sharded log's event numbers are taken once the shards are open
+    if (!logger->shards->len && 0 != write_decimations(logger))
+        return 1;
+    if (logger->auto_split_mb > 0)
+        file_space_init(&logger->space, logger->log, (int64_t) (logger->auto_split_mb * (1 << 20)),
+                        0);
+    else
+        file_space_init(&logger->space, logger->log, PREALLOCATE_SIZE, 1);
     return 0;
 }
 
+#ifndef WIN32
+static void *sync_thread(void *user_data)
+{
+    logger_t *logger = (logger_t *) user_data;
+
+    g_mutex_lock(&logger->sync_mutex);
+    while (1) {
+        while (logger->sync_fd < 0 && !logger->sync_thread_exit_flag)
+            g_cond_wait(&logger->sync_cond, &logger->sync_mutex);
+        if (logger->sync_fd < 0)
+            break;
+        int fd = logger->sync_fd;
+        g_mutex_unlock(&logger->sync_mutex);
+
+        fdatasync(fd);
+        close(fd);
+
+        g_mutex_lock(&logger->sync_mutex);
+        logger->sync_fd = -1;
+    }
+    g_mutex_unlock(&logger->sync_mutex);
+    return NULL;
+}
+
+// Has the sync thread sync the log file, unless it's still syncing, in which
+// case the next flush does.
+static void request_sync(logger_t *logger)
+{
+    g_mutex_lock(&logger->sync_mutex);
+    if (logger->sync_fd < 0) {
+        logger->sync_fd = dup(fileno(logger->log->f));
+        g_cond_signal(&logger->sync_cond);
+    }
+    g_mutex_unlock(&logger->sync_mutex);
+}
+#endif
+
+static int event_ring_init(event_ring_t *ring, int64_t size)
+{
+    ring->capacity = size & ~(int64_t) 7;
+    ring->buf = (char *) malloc(ring->capacity);
+    if (!ring->buf)
+        return -1;
+    ring->head = ring->tail = ring->reserved = 0;
+    ring->used = 0;
+    ring->retained_reserved = 0;
+    ring->retained = 0;
+    ring->waiting = 0;
+    g_mutex_init(&ring->mutex);
+    g_cond_init(&ring->cond);
+    return 0;
+}
+
+static void event_ring_clear(event_ring_t *ring)
+{
+    free(ring->buf);
+    g_mutex_clear(&ring->mutex);
+    g_cond_clear(&ring->cond);
+}
+
+// Reserves space for a message with size bytes after its queued_event_t, and
+// retained_size bytes of retained data, or returns NULL if the ring is too
+// full.  Called by the message handler.
+static queued_event_t *event_ring_reserve(event_ring_t *ring, size_t size, size_t retained_size)
+{
+    size = (sizeof(queued_event_t) + size + 7) & ~(size_t) 7;
+    size_t pos = ring->head;
+    size_t needed = size;
+    if (ring->capacity - pos < size) {
+        needed += ring->capacity - pos;
+        pos = 0;
+    }
+    if ((gsize) g_atomic_pointer_get(&ring->used) + (gsize) g_atomic_pointer_get(&ring->retained) +
+            needed + retained_size >
+        ring->capacity)
+        return NULL;
+
+    if (pos != ring->head)
+        ((queued_event_t *) (ring->buf + ring->head))->size = 0;
+    queued_event_t *queued = (queued_event_t *) (ring->buf + pos);
+    queued->size = size;
+    ring->head = pos + size == ring->capacity ? 0 : pos + size;
+    ring->reserved = needed;
+    ring->retained_reserved = retained_size;
+    return queued;
+}
+
+// Passes the message last reserved to the write thread.
+static void event_ring_publish(event_ring_t *ring)
+{
+    g_atomic_pointer_add(&ring->retained, ring->retained_reserved);
+    g_atomic_pointer_add(&ring->used, ring->reserved);
+    if (g_atomic_int_get(&ring->waiting)) {
+        g_mutex_lock(&ring->mutex);
+        g_cond_signal(&ring->cond);
+        g_mutex_unlock(&ring->mutex);
+    }
+}
+
+// Returns the next message after the ones that *consumed bytes were taken
+// for, or NULL if there isn't one yet.  Called by the write thread.
+static queued_event_t *event_ring_next(event_ring_t *ring, size_t *consumed)
+{
+    if ((gsize) g_atomic_pointer_get(&ring->used) == *consumed)
+        return NULL;
+    queued_event_t *queued = (queued_event_t *) (ring->buf + ring->tail);
+    if (queued->size == 0) {
+        *consumed += ring->capacity - ring->tail;
+        queued = (queued_event_t *) ring->buf;
+        ring->tail = 0;
+    }
+    *consumed += queued->size;
+    ring->tail += queued->size;
+    if (ring->tail == ring->capacity)
+        ring->tail = 0;
+    return queued;
+}
+
+// Frees the space of the num_events messages in batch, that consumed bytes
+// were taken for, and releases the messages that they retained.
+static void event_ring_release(event_ring_t *ring, size_t consumed, lcm_eventlog_event_t **batch,
+                               int num_events)
+{
+    gsize retained = 0;
+    for (int i = 0; i < num_events; i++) {
+        queued_event_t *queued =
+            (queued_event_t *) ((char *) batch[i] - offsetof(queued_event_t, event));
+        if (queued->retained) {
+            retained += queued->retained->data_size;
+            lcm_recv_buf_release(queued->retained);
+        }
+    }
+    if (retained)
+        g_atomic_pointer_add(&ring->retained, -(gssize) retained);
+    g_atomic_pointer_add(&ring->used, -(gssize) consumed);
+}
+
+// Waits until there's a message, or the write thread should exit.
+static void event_ring_wait(event_ring_t *ring, const int *exit_flag)
+{
+    g_mutex_lock(&ring->mutex);
+    g_atomic_int_set(&ring->waiting, 1);
+    while (g_atomic_pointer_get(&ring->used) == 0 && !g_atomic_int_get(exit_flag))
+        g_cond_wait(&ring->cond, &ring->mutex);
+    g_atomic_int_set(&ring->waiting, 0);
+    g_mutex_unlock(&ring->mutex);
+}
+
+// Like event_ring_wait(), but gives up at the monotonic time end_time.
+static void event_ring_wait_until(event_ring_t *ring, const int *exit_flag, int64_t end_time)
+{
+    g_mutex_lock(&ring->mutex);
+    g_atomic_int_set(&ring->waiting, 1);
+    while (g_atomic_pointer_get(&ring->used) == 0 && !g_atomic_int_get(exit_flag))
+        if (!g_cond_wait_until(&ring->cond, &ring->mutex, end_time))
+            break;
+    g_atomic_int_set(&ring->waiting, 0);
+    g_mutex_unlock(&ring->mutex);
+}
+
+// Allocates the flight ring, or maps it from the file fname if it isn't NULL,
+// and touches all of it, so that keeping messages doesn't fault in pages.
+static int flight_ring_init(flight_ring_t *ring, int64_t size, const char *fname)
+{
+    ring->capacity = size & ~(int64_t) 7;
+    ring->head = ring->tail = ring->used = 0;
+    ring->num_records = 0;
+    ring->mapped = fname != NULL;
+    if (fname) {
+#ifdef WIN32
+        fprintf(stderr, "--ring-file is not supported on Windows\n");
+        return -1;
+#else
+        int fd = open(fname, O_RDWR | O_CREAT, 0644);
+        if (fd < 0 || 0 != ftruncate(fd, ring->capacity)) {
+            perror(fname);
+            if (fd >= 0)
+                close(fd);
+            return -1;
+        }
+        void *buf = mmap(NULL, ring->capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (buf == MAP_FAILED) {
+            perror("Error: mmap failed");
+            return -1;
+        }
+        ring->buf = (char *) buf;
+#endif
+    } else {
+        ring->buf = (char *) malloc(ring->capacity);
+        if (!ring->buf)
+            return -1;
+    }
+    memset(ring->buf, 0, ring->capacity);
+    return 0;
+}
+
+static void flight_ring_clear(flight_ring_t *ring)
+{
+#ifndef WIN32
+    if (ring->mapped) {
+        munmap(ring->buf, ring->capacity);
+        return;
+    }
+#endif
+    free(ring->buf);
+}
+
+// Drops the oldest message.
+static void flight_ring_drop(flight_ring_t *ring)
+{
+    ring_record_t *record = (ring_record_t *) (ring->buf + ring->tail);
+    if (record->size == 0) {
+        ring->used -= ring->capacity - ring->tail;
+        record = (ring_record_t *) ring->buf;
+        ring->tail = 0;
+    }
+    ring->used -= record->size;
+    ring->tail += record->size;
+    if (ring->tail == ring->capacity)
+        ring->tail = 0;
+    ring->num_records--;
+}
+
+// Keeps a copy of le, dropping the oldest messages to make room for it, and
+// those that have fallen out of the window.  A message that's larger than the
+// ring is dropped instead.
+static void flight_ring_push(flight_ring_t *ring, const lcm_eventlog_event_t *le)
+{
+    size_t size = (sizeof(ring_record_t) + le->channellen + 1 + le->datalen + 7) & ~(size_t) 7;
+    if (size > ring->capacity)
+        return;
+
+    size_t pos, needed;
+    while (1) {
+        if (ring->num_records == 0)
+            ring->head = ring->tail = ring->used = 0;
+        pos = ring->head;
+        needed = size;
+        if (ring->capacity - pos < size) {
+            needed += ring->capacity - pos;
+            pos = 0;
+        }
+        if (ring->used + needed <= ring->capacity)
+            break;
+        flight_ring_drop(ring);
+    }
+
+    if (pos != ring->head)
+        ((ring_record_t *) (ring->buf + ring->head))->size = 0;
+    ring_record_t *record = (ring_record_t *) (ring->buf + pos);
+    record->size = size;
+    record->timestamp = le->timestamp;
+    record->channellen = le->channellen;
+    record->datalen = le->datalen;
+    char *channel = (char *) (record + 1);
+    memcpy(channel, le->channel, le->channellen);
+    channel[le->channellen] = 0;
+    memcpy(channel + le->channellen + 1, le->data, le->datalen);
+    ring->head = pos + size == ring->capacity ? 0 : pos + size;
+    ring->used += needed;
+    ring->num_records++;
+
+    if (ring->window) {
+        while (ring->num_records > 1) {
+            ring_record_t *oldest = (ring_record_t *) (ring->buf + ring->tail);
+            if (oldest->size == 0)
+                oldest = (ring_record_t *) ring->buf;
+            if (oldest->timestamp >= le->timestamp - ring->window)
+                break;
+            flight_ring_drop(ring);
+        }
+    }
+}
+
 static void *write_thread(void *user_data)
 {
     logger_t *logger = (logger_t *) user_data;
 
     while (1) {
-        void *msg = g_async_queue_pop(logger->write_queue);
+        event_ring_wait(&logger->write_queue, &logger->sync.write_thread_exit_flag);
 
         // ---
         // Is it time to start a new logfile?
@@ -363,7 +1002,7 @@ static void *write_thread(void *user_data)
 
         if (split_log) {
             // Yes.  open up a new log file
-            lcm_eventlog_destroy(logger->log);
+            close_logfile(logger->log, &logger->space);
 
             if (logger->rotate > 0) {
                 rotate_logfiles(logger);
@@ -378,58 +1017,54 @@ static void *write_thread(void *user_data)
         }
 
         // ---
-        // Should the write thread exit?
-
-        {
-            // Looking at the address of write_thread_exit_flag instead of its value.
-            // [2024-10-08 judfs: Why though?]
-            void *sentinel_msg = &(logger->sync.write_thread_exit_flag);
-
-            if (msg == sentinel_msg) {
-                return NULL;
-            }
+        // Take the events that are queued, to write them together
+        lcm_eventlog_event_t *batch[WRITE_BATCH_SIZE];
+        int num_events = 0;
+        size_t consumed = 0;
+        queued_event_t *queued;
+        while (num_events < WRITE_BATCH_SIZE &&
+               (queued = event_ring_next(&logger->write_queue, &consumed))) {
+            batch[num_events++] = &queued->event;
         }
 
         // ---
-        // Track the pop
-        lcm_eventlog_event_t *log_event = (lcm_eventlog_event_t *) msg;
-        {  // LOCK
-            g_mutex_lock(&logger->mutex);
-
-            int64_t sz =
-                sizeof(lcm_eventlog_event_t) + log_event->channellen + 1 + log_event->datalen;
-            logger->sync.write_queue_size -= sz;
-            g_mutex_unlock(&logger->mutex);
+        // Should the write thread exit?
+        if (num_events == 0) {
+            return NULL;
         }
 
         // ---
-        // Write the event to disk
-        if (0 != lcm_eventlog_write_event(logger->log, log_event)) {
+        // Write the events to disk
+        int status = logger->shards->len
+                         ? lcm_eventlog_write_numbered_events(logger->log, batch, num_events)
+                         : lcm_eventlog_write_events(logger->log, batch, num_events);
+        if (0 != status) {
             // Write error
             static int64_t last_spew_utime = 0;
             char *reason = strdup(strerror(errno));
             int64_t now = g_get_real_time();
             if (now - last_spew_utime > 500000) {
-                fprintf(stderr, "lcm_eventlog_write_event: %s\n", reason);
+                fprintf(stderr, "lcm_eventlog_write_events: %s\n", reason);
                 last_spew_utime = now;
             }
             free(reason);
-            free(log_event);
             if (errno == ENOSPC) {
                 exit(1);
             } else {
+                event_ring_release(&logger->write_queue, consumed, batch, num_events);
                 continue;
             }
         }
+        file_space_update(&logger->space, logger->log);
 
+        lcm_eventlog_event_t *log_event = batch[num_events - 1];
         assert(logger->fflush_interval_ms >= 0);
         gboolean needs_flushed =
             (log_event->timestamp - logger->last_fflush_time) > (logger->fflush_interval_ms * 1000);
         if (needs_flushed) {
             fflush(logger->log->f);
 #ifndef WIN32
-            // Perform a full fsync operation after flush
-            fdatasync(fileno(logger->log->f));
+            request_sync(logger);
 #endif
             logger->last_fflush_time = log_event->timestamp;
         }
@@ -437,11 +1072,12 @@ static void *write_thread(void *user_data)
         // ---
         // Bookkeeping, cleanup
         int64_t offset_utime = log_event->timestamp - logger->time0;
-        logger->nevents++;
-        logger->events_since_last_report++;
-        logger->logsize += 4 + 8 + 8 + 4 + log_event->channellen + 4 + log_event->datalen;
-
-        free(log_event);
+        for (int i = 0; i < num_events; i++) {
+            logger->nevents++;
+            logger->events_since_last_report++;
+            logger->logsize += 4 + 8 + 8 + 4 + batch[i]->channellen + 4 + batch[i]->datalen;
+        }
+        event_ring_release(&logger->write_queue, consumed, batch, num_events);
 
         // ---
         // UI update
@@ -485,76 +1121,709 @@ static void *write_thread(void *user_data)
                 g_main_loop_quit(_mainloop);
             }
         }
-
     }  // END while (1)
 }
 
-static void message_handler(const lcm_recv_buf_t *rbuf, const char *channel, void *u)
+// Writes events to the log file of a --ring trigger.
+static void ring_write_events(logger_t *logger, lcm_eventlog_event_t **events, int num_events)
 {
-    logger_t *logger = (logger_t *) u;
+    if (num_events == 0)
+        return;
+    if (0 != lcm_eventlog_write_events(logger->log, events, num_events)) {
+        fprintf(stderr, "lcm_eventlog_write_events: %s\n", strerror(errno));
+        if (errno == ENOSPC)
+            exit(1);
+        return;
+    }
+    file_space_update(&logger->space, logger->log);
+    for (int i = 0; i < num_events; i++) {
+        logger->nevents++;
+        logger->logsize += 4 + 8 + 8 + 4 + events[i]->channellen + 4 + events[i]->datalen;
+    }
+}
 
-    if (logger->invert_channels) {
-        if (g_regex_match(logger->regex, channel, (GRegexMatchFlags) 0, NULL))
-            return;
+// Opens the log file of a --ring trigger, and writes the messages kept in the
+// flight ring to it, emptying it.
+static void ring_open_logfile(logger_t *logger)
+{
+    if (logger->rotate > 0)
+        rotate_logfiles(logger);
+    if (0 != open_logfile(logger)) {
+        printf("Failed to open next log. Aborting.\n");
+        exit(1);
     }
+    logger->nevents = 0;
+    logger->logsize = 0;
+
+    flight_ring_t *ring = &logger->ring;
+    lcm_eventlog_event_t records[WRITE_BATCH_SIZE];
+    lcm_eventlog_event_t *batch[WRITE_BATCH_SIZE];
+    int num_events = 0;
+    size_t pos = ring->tail;
+    for (int64_t i = 0; i < ring->num_records; i++) {
+        ring_record_t *record = (ring_record_t *) (ring->buf + pos);
+        if (record->size == 0) {
+            record = (ring_record_t *) ring->buf;
+            pos = 0;
+        }
+        pos += record->size;
+        if (pos == ring->capacity)
+            pos = 0;
+
+        lcm_eventlog_event_t *le = &records[num_events];
+        le->timestamp = record->timestamp;
+        le->channellen = record->channellen;
+        le->datalen = record->datalen;
+        le->channel = (char *) (record + 1);
+        le->data = le->channel + record->channellen + 1;
+        batch[num_events++] = le;
+        if (num_events == WRITE_BATCH_SIZE) {
+            ring_write_events(logger, batch, num_events);
+            num_events = 0;
+        }
+    }
+    ring_write_events(logger, batch, num_events);
+    ring->head = ring->tail = ring->used = 0;
+    ring->num_records = 0;
+}
 
-    int channellen = strlen(channel);
+static void ring_close_logfile(logger_t *logger)
+{
+    close_logfile(logger->log, &logger->space);
+    logger->log = NULL;
+    if (!logger->quiet)
+        printf("Wrote %" PRIi64 " events ( %" PRIi64 " MB ) to \"%s\"\n", logger->nevents,
+               logger->logsize / 1048576, logger->fname);
+}
 
-    // Check if the backlog of unwritten messages is too big.  If so, then
-    // ignore this event
-    int64_t event_sz = sizeof(lcm_eventlog_event_t) + channellen + 1 + rbuf->data_size;
-    {  // LOCK
-        g_mutex_lock(&logger->mutex);
-        int64_t pending_queue_mem = event_sz + logger->sync.write_queue_size;
+// The write thread of --ring, which keeps the queued messages in the flight
+// ring instead of writing them, until a trigger has them written to a new log
+// file, after which messages are written to it until ring_post has passed.
+static void *ring_write_thread(void *user_data)
+{
+    logger_t *logger = (logger_t *) user_data;
+    // the time that messages are written until, after a trigger
+    int64_t post_end = 0;
 
-        if (pending_queue_mem > logger->max_write_queue_size) {
-            g_mutex_unlock(&logger->mutex);
+    while (1) {
+        event_ring_wait_until(&logger->write_queue, &logger->sync.write_thread_exit_flag,
+                              g_get_monotonic_time() + RING_POLL_INTERVAL_US);
+
+        // a trigger while writing writes for longer
+        if (_ring_trigger || g_atomic_int_get(&logger->ring_triggered)) {
+            _ring_trigger = 0;
+            g_atomic_int_set(&logger->ring_triggered, 0);
+            if (!logger->log)
+                ring_open_logfile(logger);
+            post_end = g_get_real_time() + logger->ring_post;
+        }
 
-            // Can't write to logfile fast enough. Drop packet.
-            logger->dropped_packets_count++;
+        lcm_eventlog_event_t *batch[WRITE_BATCH_SIZE];
+        int num_events = 0;
+        size_t consumed = 0;
+        queued_event_t *queued;
+        while (num_events < WRITE_BATCH_SIZE &&
+               (queued = event_ring_next(&logger->write_queue, &consumed))) {
+            batch[num_events++] = &queued->event;
+        }
 
-            // maybe print an informational message to stdout
-            int64_t now = g_get_real_time();
-            int rc = logger->dropped_packets_count - logger->last_drop_report_count;
-
-            if (now - logger->last_drop_report_utime > 1000000 && rc > 0) {
-                if (!logger->quiet)
-                    printf("Can't write to log fast enough.  Dropped %d packet%s\n", rc,
-                           rc == 1 ? "" : "s");
-                logger->last_drop_report_utime = now;
-                logger->last_drop_report_count = logger->dropped_packets_count;
+        if (num_events == 0) {
+            int exiting = g_atomic_int_get(&logger->sync.write_thread_exit_flag);
+            if (logger->log && (exiting || g_get_real_time() > post_end))
+                ring_close_logfile(logger);
+            if (exiting)
+                return NULL;
+            continue;
+        }
+
+        // the messages up to post_end are written, and the rest are kept
+        int first = 0;
+        for (int i = 0; i < num_events; i++) {
+            if (logger->log && batch[i]->timestamp > post_end) {
+                ring_write_events(logger, batch + first, i - first);
+                ring_close_logfile(logger);
             }
-            return;
-        } else {
-            logger->sync.write_queue_size = pending_queue_mem;
+            if (!logger->log) {
+                flight_ring_push(&logger->ring, batch[i]);
+                first = i + 1;
+            }
+        }
+        if (logger->log) {
+            ring_write_events(logger, batch + first, num_events - first);
+            fflush(logger->log->f);
+        }
+        event_ring_release(&logger->write_queue, consumed, batch, num_events);
+    }
+}
 
-            g_mutex_unlock(&logger->mutex);
+static void *shard_write_thread(void *user_data)
+{
+    shard_t *shard = (shard_t *) user_data;
+    logger_t *logger = shard->logger;
+
+    while (1) {
+        event_ring_wait(&shard->write_queue, &logger->sync.write_thread_exit_flag);
+
+        lcm_eventlog_event_t *batch[WRITE_BATCH_SIZE];
+        int num_events = 0;
+        size_t consumed = 0;
+        queued_event_t *queued;
+        while (num_events < WRITE_BATCH_SIZE &&
+               (queued = event_ring_next(&shard->write_queue, &consumed))) {
+            batch[num_events++] = &queued->event;
+        }
+        if (num_events == 0) {
+            return NULL;
+        }
+
+        if (0 != lcm_eventlog_write_numbered_events(shard->log, batch, num_events)) {
+            fprintf(stderr, "Error: Failed to write to %s: %s\n", shard->fname, strerror(errno));
+            if (errno == ENOSPC) {
+                exit(1);
+            }
+        }
+        file_space_update(&shard->space, shard->log);
+        int64_t timestamp = batch[num_events - 1]->timestamp;
+        event_ring_release(&shard->write_queue, consumed, batch, num_events);
+
+        if (timestamp - shard->last_fflush_time > logger->fflush_interval_ms * 1000) {
+            fflush(shard->log->f);
+#ifndef WIN32
+            fdatasync(fileno(shard->log->f));
+#endif
+            shard->last_fflush_time = timestamp;
         }
     }
+}
 
-    // Queue up the message for writing to disk by the write thread
+// Parses --shard=FILE=REGEX.
+static int add_shard(logger_t *logger, const char *arg)
+{
+    const char *sep = strchr(arg, '=');
+    if (!sep || sep == arg || strlen(arg) - (sep - arg) >= PATH_MAX || sep - arg >= PATH_MAX) {
+        fprintf(stderr, "ERROR.  --shard must be FILE=REGEX\n");
+        return 1;
+    }
+    shard_t *shard = (shard_t *) calloc(1, sizeof(shard_t));
+    memcpy(shard->fname, arg, sep - arg);
+    char *regexbuf = g_strdup_printf("^%s$", sep + 1);
+    GError *rerr = NULL;
+    shard->regex = g_regex_new(regexbuf, (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, &rerr);
+    g_free(regexbuf);
+    if (rerr) {
+        fprintf(stderr, "%s\n", rerr->message);
+        g_error_free(rerr);
+        free(shard);
+        return 1;
+    }
+    shard->logger = logger;
+    g_ptr_array_add(logger->shards, shard);
+    return 0;
+}
 
-    // Make a flat allocation for both an event_t and its data buffers.
-    lcm_eventlog_event_t *log_event = (lcm_eventlog_event_t *) malloc(event_sz);
-    memset(log_event, 0, event_sz);
+static int add_decimation(logger_t *logger, const char *arg)
+{
+    const char *sep = strrchr(arg, '=');
+    char *eptr = NULL;
+    double rate = sep ? strtod(sep + 1, &eptr) : 0;
+    if (!sep || sep == arg || eptr == sep + 1 || *eptr || rate <= 0) {
+        fprintf(stderr, "ERROR.  --decimate must be REGEX=RATE\n");
+        return 1;
+    }
+    char *regexbuf = g_strdup_printf("^%.*s$", (int) (sep - arg), arg);
+    GError *rerr = NULL;
+    GRegex *regex = g_regex_new(regexbuf, (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, &rerr);
+    g_free(regexbuf);
+    if (rerr) {
+        fprintf(stderr, "%s\n", rerr->message);
+        g_error_free(rerr);
+        return 1;
+    }
+    decimation_t *decimation = g_new0(decimation_t, 1);
+    decimation->regex = regex;
+    decimation->rate = rate;
+    g_ptr_array_add(logger->decimations, decimation);
+    return 0;
+}
+
+static int open_shard(logger_t *logger, shard_t *shard)
+{
+    if (!(logger->force_overwrite || logger->append)) {
+        if (g_file_test(shard->fname, G_FILE_TEST_EXISTS)) {
+            fprintf(stderr, "Refusing to overwrite existing file \"%s\"\n", shard->fname);
+            return 1;
+        }
+    }
+
+    // create directories if needed
+    char *dirpart = g_path_get_dirname(shard->fname);
+    if (!g_file_test(dirpart, G_FILE_TEST_IS_DIR)) {
+        mkdir_with_parents(dirpart, 0755);
+    }
+    g_free(dirpart);
+
+    if (!logger->quiet) {
+        printf("Opening log file \"%s\"\n", shard->fname);
+    }
+    // the shards are numbered together, after the events in any of them
+    if (logger->append) {
+        int64_t next_eventnum = recover_logfile(logger, shard->fname);
+        if (next_eventnum < 0)
+            return 1;
+        logger->next_eventnum = MAX(logger->next_eventnum, next_eventnum);
+    }
+    shard->log = lcm_eventlog_create(shard->fname, logger->append ? "a" : "w");
+    if (shard->log == NULL) {
+        perror("Error: fopen failed");
+        return 1;
+    }
+    if (logger->index && 0 != lcm_eventlog_write_index(shard->log))
+        return 1;
+    file_space_init(&shard->space, shard->log, PREALLOCATE_SIZE, 1);
+    return 0;
+}
+
+// Writes the line of the manifest for a log file, with its path relative to
+// the manifest if it's in the same directory.
+static void write_manifest_line(FILE *f, const char *manifest_dir, const char *fname,
+                                const char *regex)
+{
+    char *dir = g_path_get_dirname(fname);
+    char *path;
+    if (!strcmp(dir, manifest_dir)) {
+        path = g_path_get_basename(fname);
+    } else if (g_path_is_absolute(fname)) {
+        path = g_strdup(fname);
+    } else {
+        char *cwd = g_get_current_dir();
+        path = g_build_filename(cwd, fname, NULL);
+        g_free(cwd);
+    }
+    if (regex)
+        fprintf(f, "%s\t%s\n", path, regex);
+    else
+        fprintf(f, "%s\n", path);
+    g_free(path);
+    g_free(dir);
+}
+
+// Writes FILE.shards, which lists the log files, so that they can be read
+// as one log.
+static int write_manifest(logger_t *logger)
+{
+    char *manifest = g_strdup_printf("%s.shards", logger->fname);
+    FILE *f = fopen(manifest, "w");
+    if (!f) {
+        fprintf(stderr, "Error: Failed to write %s\n", manifest);
+        g_free(manifest);
+        return 1;
+    }
+    char *manifest_dir = g_path_get_dirname(manifest);
+    fprintf(f, "LCM-SHARDS 1\n");
+    write_manifest_line(f, manifest_dir, logger->fname, NULL);
+    for (unsigned int i = 0; i < logger->shards->len; i++) {
+        shard_t *shard = (shard_t *) g_ptr_array_index(logger->shards, i);
+        write_manifest_line(f, manifest_dir, shard->fname, g_regex_get_pattern(shard->regex));
+    }
+    int status = fclose(f) == 0 ? 0 : 1;
+    g_free(manifest_dir);
+    g_free(manifest);
+    return status;
+}
+
+// Returns the write_queue for a channel.
+static channel_stats_t *channel_stats(logger_t *logger, const char *channel)
+{
+    channel_stats_t *stats = (channel_stats_t *) g_hash_table_lookup(logger->channels, channel);
+    if (stats)
+        return stats;
+
+    stats = g_new0(channel_stats_t, 1);
+    if (logger->invert_channels &&
+        g_regex_match(logger->regex, channel, (GRegexMatchFlags) 0, NULL)) {
+        stats->queue = NULL;
+    } else {
+        stats->queue = &logger->write_queue;
+        for (unsigned int i = 0; i < logger->shards->len; i++) {
+            shard_t *shard = (shard_t *) g_ptr_array_index(logger->shards, i);
+            if (g_regex_match(shard->regex, channel, (GRegexMatchFlags) 0, NULL)) {
+                stats->queue = &shard->write_queue;
+                break;
+            }
+        }
+        for (unsigned int i = 0; i < logger->decimations->len; i++) {
+            decimation_t *decimation = (decimation_t *) g_ptr_array_index(logger->decimations, i);
+            if (g_regex_match(decimation->regex, channel, (GRegexMatchFlags) 0, NULL)) {
+                stats->rate = decimation->rate;
+                stats->tokens = 1;
+                break;
+            }
+        }
+    }
+    g_hash_table_insert(logger->channels, g_strdup(channel), stats);
+    return stats;
+}
+
+// Counts a message that the write queue had no room for.
+static void count_drop(logger_t *logger, channel_stats_t *stats)
+{
+    logger->dropped_packets_count++;
+    stats->dropped++;
+
+    // maybe print an informational message to stdout
+    int64_t now = g_get_real_time();
+    int rc = logger->dropped_packets_count - logger->last_drop_report_count;
+
+    if (now - logger->last_drop_report_utime > 1000000 && rc > 0) {
+        if (!logger->quiet)
+            printf("Can't write to log fast enough.  Dropped %d packet%s\n", rc,
+                   rc == 1 ? "" : "s");
+        logger->last_drop_report_utime = now;
+        logger->last_drop_report_count = logger->dropped_packets_count;
+    }
+}
+
+static void message_handler(const lcm_recv_buf_t *rbuf, const char *channel, void *u)
+{
+    logger_t *logger = (logger_t *) u;
+
+    channel_stats_t *stats = channel_stats(logger, channel);
+    if (!stats->queue)
+        return;
+    stats->events++;
+    stats->bytes += rbuf->data_size;
+
+    // Leave the message out if the channel's --decimate rate has been used
+    // up.  The bucket holds one token, so the messages logged are spread out.
+    if (stats->rate > 0) {
+        if (stats->last_utime)
+            stats->tokens = MIN(1.0, stats->tokens + (rbuf->recv_utime - stats->last_utime) *
+                                                          stats->rate / 1e6);
+        stats->last_utime = rbuf->recv_utime;
+        if (stats->tokens < 1) {
+            stats->decimated++;
+            return;
+        }
+        stats->tokens -= 1;
+    }
+
+    int channellen = strlen(channel);
+
+    // Reserve space for the event and its data in the queue of unwritten
+    // messages.  If it's too full, then ignore this event.  Large messages
+    // count against the queue size, but are written from the buffer that they
+    // were received into.
+    event_ring_t *queue = stats->queue;
+    lcm_recv_buf_t *retained =
+        rbuf->data_size >= RETAIN_MIN_SIZE ? lcm_recv_buf_retain(rbuf) : NULL;
+    queued_event_t *queued =
+        retained ? event_ring_reserve(queue, channellen + 1, rbuf->data_size)
+                 : event_ring_reserve(queue, channellen + 1 + rbuf->data_size, 0);
+    if (!queued) {
+        // Can't write to logfile fast enough. Drop packet.
+        lcm_recv_buf_release(retained);
+        count_drop(logger, stats);
+        return;
+    }
+
+    // Queue up the message for writing to disk by the write thread
+    lcm_eventlog_event_t *log_event = &queued->event;
 
     // Store the channel just past the end of the struct
-    log_event->channel = ((char *) log_event) + sizeof(lcm_eventlog_event_t);
+    log_event->channel = (char *) (queued + 1);
     // Store the data past the channel.
     log_event->data = log_event->channel + channellen + 1;
-    assert((char *) log_event->data + rbuf->data_size == (char *) log_event + event_sz);
 
     //
     log_event->timestamp = rbuf->recv_utime;
     log_event->channellen = channellen;
     log_event->datalen = rbuf->data_size;
-    // log_write_event will handle le.eventnum.
+    // log_write_event will handle le.eventnum, unless the log is sharded.
+    log_event->eventnum = logger->next_eventnum++;
+
+    memcpy(log_event->channel, channel, channellen + 1);
+
+    queued->retained = retained;
+    if (retained)
+        log_event->data = retained->data;
+    else
+        memcpy(log_event->data, rbuf->data, rbuf->data_size);
+
+    event_ring_publish(queue);
+}
+
+// Has --ring write the recent messages to a log file.
+static void trigger_handler(const lcm_recv_buf_t *rbuf, const char *channel, void *u)
+{
+    logger_t *logger = (logger_t *) u;
+    g_atomic_int_set(&logger->ring_triggered, 1);
+}
+
+#ifndef WIN32
+// Opens the socket of --raw, joined to the multicast group of the udpm URL,
+// or of the default URL if it's NULL.
+static int raw_open(logger_t *logger, const char *url)
+{
+    if (!url)
+        url = getenv("LCM_DEFAULT_URL");
+    if (!url)
+        url = "udpm://239.255.76.67:7667";
+    if (strncmp(url, "udpm://", 7)) {
+        fprintf(stderr, "ERROR.  --raw requires a udpm:// LCM URL\n");
+        return 1;
+    }
+    // the options that follow the address are the publishers' business
+    char *addr = g_strndup(url + 7, strcspn(url + 7, "?"));
+    char *port = strchr(addr, ':');
+    struct sockaddr_in sin;
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(port ? atoi(port + 1) : 7667);
+    sin.sin_addr.s_addr = INADDR_ANY;
+    if (port)
+        *port = 0;
+    struct ip_mreq mreq;
+    mreq.imr_interface.s_addr = INADDR_ANY;
+    int valid = inet_aton(addr[0] ? addr : "239.255.76.67", &mreq.imr_multiaddr);
+    g_free(addr);
+    if (!valid) {
+        fprintf(stderr, "ERROR.  --raw: bad multicast address in \"%s\"\n", url);
+        return 1;
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return 1;
+    }
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+#if defined(__APPLE__) || defined(__FreeBSD__)
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+#endif
+#ifdef SO_TIMESTAMP
+    setsockopt(fd, SOL_SOCKET, SO_TIMESTAMP, &opt, sizeof(opt));
+#endif
+    // room for bursts while the main loop is busy
+    int size = 8 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    if (bind(fd, (struct sockaddr *) &sin, sizeof(sin)) < 0 ||
+        setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+        perror("--raw");
+        close(fd);
+        return 1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    logger->raw_fd = fd;
+    logger->raw_bufs = (char *) malloc((size_t) RAW_BATCH_SIZE * RAW_DATAGRAM_SIZE);
+    logger->raw_stats = channel_stats(logger, RAW_CHANNEL);
+    return 0;
+}
+
+// Returns whether the channel of a datagram, if it has one, matches the
+// --ring-trigger.  Fragments after the first, which don't have a channel,
+// don't.
+static int raw_triggers(logger_t *logger, const char *data, int size)
+{
+    if (size < 8)
+        return 0;
+    uint32_t magic = ntohl(*(const uint32_t *) data);
+    int pos;
+    if (magic == 0x4c433032)  // LC02, a short message
+        pos = 8;
+    else if ((magic == 0x4c433033 || magic == 0x4c433035 || magic == 0x4c433038) && size >= 20 &&
+             ntohs(*(const uint16_t *) (data + 16)) == 0)  // the first fragment
+        pos = 20;
+    else if (magic == 0x4c433034)  // LC04, a bundle of short messages
+        pos = 8;
+    else
+        return 0;
+    while (pos < size) {
+        const char *channel = data + pos;
+        const char *end = (const char *) memchr(channel, 0, size - pos);
+        if (!end)
+            return 0;
+        if (g_regex_match(logger->raw_trigger, channel, (GRegexMatchFlags) 0, NULL))
+            return 1;
+        if (magic != 0x4c433034 || end + 5 > data + size)
+            return 0;
+        pos = end + 5 - data + ntohl(*(const uint32_t *) (end + 1));
+    }
+    return 0;
+}
+
+// Queues a datagram of --raw for writing, as an event on RAW_CHANNEL.
+static void raw_queue(logger_t *logger, int64_t timestamp, const struct sockaddr_in *from,
+                      const char *data, int size)
+{
+    channel_stats_t *stats = logger->raw_stats;
+    stats->events++;
+    stats->bytes += size;
+    if (logger->raw_trigger && raw_triggers(logger, data, size))
+        g_atomic_int_set(&logger->ring_triggered, 1);
+
+    int channellen = strlen(RAW_CHANNEL);
+    int datalen = RAW_ADDR_SIZE + size;
+    queued_event_t *queued = event_ring_reserve(stats->queue, channellen + 1 + datalen, 0);
+    if (!queued) {
+        count_drop(logger, stats);
+        return;
+    }
+    lcm_eventlog_event_t *log_event = &queued->event;
+    log_event->channel = (char *) (queued + 1);
+    log_event->data = log_event->channel + channellen + 1;
+    log_event->timestamp = timestamp;
+    log_event->channellen = channellen;
+    log_event->datalen = datalen;
+    log_event->eventnum = logger->next_eventnum++;
+    memcpy(log_event->channel, RAW_CHANNEL, channellen + 1);
+    char *dst = (char *) log_event->data;
+    memcpy(dst, &from->sin_addr.s_addr, 4);
+    memcpy(dst + 4, &from->sin_port, 2);
+    memcpy(dst + RAW_ADDR_SIZE, data, size);
+    queued->retained = NULL;
+    event_ring_publish(stats->queue);
+}
+
+#ifdef __linux__
+typedef struct mmsghdr raw_msg_t;
+#else
+typedef struct {
+    struct msghdr msg_hdr;
+    unsigned int msg_len;
+} raw_msg_t;
+#endif
+
+// Takes the datagrams waiting in the socket of --raw, a batch at a time, and
+// queues them.
+static gboolean raw_read(GIOChannel *source, GIOCondition cond, void *user_data)
+{
+    logger_t *logger = (logger_t *) user_data;
+    struct sockaddr_in from[RAW_BATCH_SIZE];
+    struct iovec iov[RAW_BATCH_SIZE];
+    char control[RAW_BATCH_SIZE][64];
+    raw_msg_t msgs[RAW_BATCH_SIZE];
+    for (int batch = 0; batch < RAW_MAX_BATCHES; batch++) {
+        memset(msgs, 0, sizeof(msgs));
+        for (int i = 0; i < RAW_BATCH_SIZE; i++) {
+            iov[i].iov_base = logger->raw_bufs + (size_t) i * RAW_DATAGRAM_SIZE;
+            iov[i].iov_len = RAW_DATAGRAM_SIZE;
+            msgs[i].msg_hdr.msg_name = &from[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_control = control[i];
+            msgs[i].msg_hdr.msg_controllen = sizeof(control[i]);
+        }
+#ifdef __linux__
+        int n = recvmmsg(logger->raw_fd, msgs, RAW_BATCH_SIZE, MSG_DONTWAIT, NULL);
+#else
+        // one at a time where there's no recvmmsg()
+        int n = 0;
+        while (n < RAW_BATCH_SIZE) {
+            ssize_t len = recvmsg(logger->raw_fd, &msgs[n].msg_hdr, MSG_DONTWAIT);
+            if (len < 0)
+                break;
+            msgs[n++].msg_len = len;
+        }
+        if (n == 0)
+            n = -1;
+#endif
+        if (n <= 0)
+            break;
+        int64_t now = g_get_real_time();
+        for (int i = 0; i < n; i++) {
+            int64_t timestamp = now;
+#ifdef SO_TIMESTAMP
+            for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cmsg;
+                 cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg)) {
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMP) {
+                    struct timeval tv;
+                    memcpy(&tv, CMSG_DATA(cmsg), sizeof(tv));
+                    timestamp = (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+                }
+            }
+#endif
+            raw_queue(logger, timestamp, &from[i], (const char *) iov[i].iov_base,
+                      msgs[i].msg_len);
+        }
+        if (n < RAW_BATCH_SIZE)
+            break;
+    }
+    return TRUE;
+}
+#endif
 
-    strcpy(log_event->channel, channel);
+static void append_json_string(GString *json, const char *str)
+{
+    g_string_append_c(json, '"');
+    for (const char *c = str; *c; c++) {
+        if (*c == '"' || *c == '\\')
+            g_string_append_printf(json, "\\%c", *c);
+        else if ((unsigned char) *c < 0x20)
+            g_string_append_printf(json, "\\u%04x", *c);
+        else
+            g_string_append_c(json, *c);
+    }
+    g_string_append_c(json, '"');
+}
 
-    memcpy(log_event->data, rbuf->data, rbuf->data_size);
+// Publishes the logger's statistics on logger->stats_channel, as a JSON
+// object of text, so that loggers can be monitored without parsing stdout.
+static gboolean publish_stats(void *user_data)
+{
+    logger_t *logger = (logger_t *) user_data;
+
+    int64_t events = 0, bytes = 0, decimated = 0;
+    GString *channels = g_string_new(NULL);
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, logger->channels);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        channel_stats_t *stats = (channel_stats_t *) value;
+        if (!stats->queue)
+            continue;
+        events += stats->events;
+        bytes += stats->bytes;
+        decimated += stats->decimated;
+        g_string_append(channels, channels->len ? ", " : "");
+        append_json_string(channels, (const char *) key);
+        g_string_append_printf(channels,
+                               ": {\"events\": %" PRIi64 ", \"bytes\": %" PRIi64
+                               ", \"dropped\": %" PRIi64 ", \"decimated\": %" PRIi64 "}",
+                               stats->events, stats->bytes, stats->dropped, stats->decimated);
+    }
+
+    int64_t queued = (gsize) g_atomic_pointer_get(&logger->write_queue.used);
+    int64_t capacity = logger->write_queue.capacity;
+    for (unsigned int i = 0; i < logger->shards->len; i++) {
+        shard_t *shard = (shard_t *) g_ptr_array_index(logger->shards, i);
+        queued += (gsize) g_atomic_pointer_get(&shard->write_queue.used);
+        capacity += shard->write_queue.capacity;
+    }
 
-    g_async_queue_push(logger->write_queue, log_event);
+    int64_t now = g_get_real_time();
+    double dt = (now - logger->last_stats_time) / 1e6;
+    GString *json = g_string_new(NULL);
+    g_string_append_printf(json,
+                           "{\"utime\": %" PRIi64 ", \"events\": %" PRIi64 ", \"bytes\": %" PRIi64
+                           ", \"dropped\": %" PRIi64 ", \"decimated\": %" PRIi64
+                           ", \"events_per_sec\": %.2f"
+                           ", \"bytes_per_sec\": %.2f, \"queued_bytes\": %" PRIi64
+                           ", \"queue_capacity\": %" PRIi64 ", \"channels\": {%s}}",
+                           now, events, bytes, logger->dropped_packets_count, decimated,
+                           (events - logger->last_stats_events) / dt,
+                           (bytes - logger->last_stats_bytes) / dt, queued, capacity,
+                           channels->str);
+    lcm_publish(logger->lcm, logger->stats_channel, json->str, json->len);
+    g_string_free(json, TRUE);
+    g_string_free(channels, TRUE);
+
+    logger->last_stats_time = now;
+    logger->last_stats_events = events;
+    logger->last_stats_bytes = bytes;
+    return TRUE;
 }
 
 #ifdef USE_SIGHUP
@@ -564,6 +1833,13 @@ static void sighup_handler(int signum)
 }
 #endif
 
+#ifdef USE_SIGUSR1
+static void sigusr1_handler(int signum)
+{
+    _ring_trigger = 1;
+}
+#endif
+
 static void usage()
 {
     // Manually wrapped to 80cols Leaves 52 for flag help.
@@ -586,6 +1862,9 @@ static void usage()
             "                             (default: 100)\n"
             "  -f, --force                Overwrite existing files.\n"
             "  -h, --help                 Shows this help text and exits.\n"
+            "      --index                Write an index of the log file to FILE.idx, for\n"
+            "                             seeking quickly.  Without it, the index can be\n"
+            "                             written later with lcm-logindex.\n"
             "  -i, --increment            Automatically append a suffix to FILE\n"
             "                             such that the resulting filename does not\n"
             "                             already exist.  This option precludes -f and\n"
@@ -606,14 +1885,58 @@ static void usage()
             "      --split-mb=N           Automatically start writing to a new log\n"
             "                             file once the log file exceeds N MB in size\n"
             "                             (can be fractional).  This option requires -i\n"
-            "                             or --rotate.\n"
+            "                             or --rotate.  Each log file's N MB are\n"
+            "                             preallocated on disk, where supported.\n"
             "\n"
             "  -q, --quiet                Suppress normal output and only report errors.\n"
+            "      --raw                  Log the datagrams of the udpm URL as they are\n"
+            "                             received, in batches, on LCM_UDPM_RAW, instead\n"
+            "                             of the messages that they make up, so that\n"
+            "                             logging keeps up with more traffic.  The log is\n"
+            "                             turned into messages later with\n"
+            "                             lcm-logconvert --reassemble.  --ring-trigger\n"
+            "                             matches the channels of the datagrams.  This\n"
+            "                             option precludes -c, -v, --shard and --decimate.\n"
+            "      --ring=WINDOW          Keep the recent messages in memory instead of\n"
+            "                             logging them, and write them to a new log file\n"
+            "                             when triggered, with SIGUSR1 or --ring-trigger.\n"
+            "                             WINDOW is the seconds of messages to keep, in a\n"
+            "                             buffer the size of -m, or a size like \"500MB\",\n"
+            "                             to keep as many as fit.  Each trigger writes to\n"
+            "                             a new file, as with -i, unless --rotate is used.\n"
+            "                             This option precludes -a, --shard and\n"
+            "                             --split-mb.\n"
+            "      --ring-file=PATH       Map the --ring buffer from the file PATH, instead\n"
+            "                             of allocating it.\n"
+            "      --ring-post=SEC        Keep logging for SEC seconds after a trigger.\n"
+            "                             (default: 0)\n"
+            "      --ring-trigger=REGEX   Trigger --ring with any message on a channel that\n"
+            "                             matches REGEX, which doesn't need to be logged.\n"
+            "      --shard=SHARD=REGEX    Log the channels that match REGEX to the file\n"
+            "                             SHARD instead of FILE, with a write thread and\n"
+            "                             -m of memory of its own.  Can be repeated, and\n"
+            "                             the first match is used.  Event numbers count\n"
+            "                             across the files, and FILE.shards lists them,\n"
+            "                             so that they can be played back as one log.\n"
+            "                             This option precludes --rotate and --split-mb.\n"
+            "      --stats-channel=CHAN   Publish statistics on CHAN: the messages, bytes\n"
+            "                             and drops of each channel and in total, the\n"
+            "                             throughput and the bytes waiting to be written,\n"
+            "                             as a JSON object of text.\n"
+            "      --stats-interval=MS    Publish statistics every MS milliseconds.\n"
+            "                             (default: 1000)\n"
             "  -a, --append               Append events to the given log file.\n"
+            "                             An incomplete event at its end is removed\n"
+            "                             first.\n"
             "  -s, --strftime             Format FILE with strftime.\n"
             "  -v, --invert-channels      Invert channels.  Log everything that CHAN\n"
             "                             does not match.\n"
             "\n"
+            "      --decimate=REGEX=RATE  Log at most RATE messages per second of each\n"
+            "                             channel that REGEX matches, and leave the rest\n"
+            "                             out.  Can be repeated, and the first match is\n"
+            "                             used.  Each log file starts with an event on\n"
+            "                             LCM_LOGGER_DECIMATION that lists the rules.\n"
             "      --disk-quota=SIZE      Minimum amount of free space to reserve on the disk\n"
             "                             being written to. lcm-logger will exit when it sees\n"
             "                             the current free disk space has fallen below the\n"
@@ -644,6 +1967,17 @@ static void usage()
             "    Moving to a new file happens either when the current log file size exceeds\n"
             "    the limit specified by --split-mb, or when lcm-logger receives a SIGHUP.\n"
             "    A user may send SIGHUP with the kill command to trigger rotating logs.\n"
+            "\n"
+            "Flight recorder\n"
+            "===============\n"
+            "    With --ring, lcm-logger keeps the recent messages in memory, and doesn't\n"
+            "    write to the disk until something of interest happens.  For example:\n"
+            "\n"
+            "        # Keep the last 30 seconds, and write them, along with the next 10\n"
+            "        # seconds, to crash.00, crash.01, ... on a message on FAULT\n"
+            "        lcm-logger --ring=30 --ring-post=10 --ring-trigger=FAULT crash\n"
+            "\n"
+            "    A user may send SIGUSR1 with the kill command to trigger it too.\n"
             "\n");
 }
 
@@ -671,8 +2005,13 @@ int main(int argc, char *argv[])
     logger.quiet = 0;
     logger.append = 0;
     logger.disk_quota = 0;
+    logger.shards = g_ptr_array_new();
+    logger.decimations = g_ptr_array_new();
+    logger.channels = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    logger.stats_interval_ms = 1000;
 
     char *lcmurl = NULL;
+    int64_t ring_size = 0;
 
     // Arg Parsing:
     // https://www.gnu.org/software/libc/manual/html_node/Getopt.html
@@ -697,6 +2036,16 @@ int main(int argc, char *argv[])
         {"flush-interval", required_argument, 0, 'u'},
         {"invert-channels", no_argument, 0, 'v'},
         {"disk-quota", required_argument, 0, 128},
+        {"index", no_argument, 0, 129},
+        {"shard", required_argument, 0, 130},
+        {"stats-channel", required_argument, 0, 131},
+        {"stats-interval", required_argument, 0, 132},
+        {"ring", required_argument, 0, 133},
+        {"ring-file", required_argument, 0, 134},
+        {"ring-post", required_argument, 0, 135},
+        {"ring-trigger", required_argument, 0, 136},
+        {"decimate", required_argument, 0, 137},
+        {"raw", no_argument, 0, 138},
         {0, 0, 0, 0},
     };
 
@@ -771,6 +2120,68 @@ int main(int argc, char *argv[])
                 return 1;
             }
         } break;
+        case 129: /* --index */
+            logger.index = 1;
+            break;
+        case 130: /* --shard */
+            if (0 != add_shard(&logger, optarg))
+                return 1;
+            break;
+        case 131: /* --stats-channel */
+            free(logger.stats_channel);
+            logger.stats_channel = strdup(optarg);
+            break;
+        case 132: /* --stats-interval */
+            logger.stats_interval_ms = atol(optarg);
+            if (logger.stats_interval_ms <= 0) {
+                usage();
+                return 1;
+            }
+            break;
+        case 133: { /* --ring */
+            char *eptr = NULL;
+            double seconds = strtod(optarg, &eptr);
+            if (eptr != optarg && (!*eptr || !strcmp(eptr, "s"))) {
+                logger.ring.window = (int64_t) (seconds * 1e6);
+                ring_size = 0;
+            } else {
+                logger.ring.window = 0;
+                ring_size = parse_mem_size(optarg);
+            }
+            if (logger.ring.window < 0 || ring_size < 0 ||
+                (logger.ring.window == 0 && ring_size == 0)) {
+                printf("--ring: Invalid argument\n\n");
+                usage();
+                return 1;
+            }
+            logger.ring_enabled = 1;
+        } break;
+        case 134: /* --ring-file */
+            free(logger.ring_file);
+            logger.ring_file = strdup(optarg);
+            break;
+        case 135: /* --ring-post */
+            logger.ring_post = (int64_t) (strtod(optarg, NULL) * 1e6);
+            if (logger.ring_post < 0) {
+                usage();
+                return 1;
+            }
+            break;
+        case 136: /* --ring-trigger */
+            free(logger.ring_trigger);
+            logger.ring_trigger = strdup(optarg);
+            break;
+        case 137: /* --decimate */
+            if (0 != add_decimation(&logger, optarg))
+                return 1;
+            break;
+        case 138: /* --raw */
+#ifdef WIN32
+            printf("--raw not yet supported on windows.\n");
+            return 1;
+#endif
+            logger.raw = 1;
+            break;
 
         //
         case 'h':
@@ -828,14 +2239,49 @@ int main(int argc, char *argv[])
         fprintf(stderr, "ERROR.  --increment and --rotate can't both be used\n");
         return 1;
     }
+    if (logger.shards->len && (logger.rotate > 0 || logger.auto_split_mb > 0)) {
+        fprintf(stderr, "ERROR.  --shard can't be used with --rotate or --split-mb\n");
+        return 1;
+    }
     if (logger.force_overwrite && logger.append) {
         fprintf(stderr, "ERROR.  --force_overwrite and --append can't both be used\n");
     }
+    if (logger.ring_enabled && (logger.append || logger.shards->len || logger.auto_split_mb > 0)) {
+        fprintf(stderr, "ERROR.  --ring can't be used with --append, --shard or --split-mb\n");
+        return 1;
+    }
+    if (!logger.ring_enabled && (logger.ring_file || logger.ring_trigger || logger.ring_post)) {
+        fprintf(stderr, "ERROR.  --ring-file, --ring-post and --ring-trigger require --ring\n");
+        return 1;
+    }
+    if (logger.raw && (strcmp(chan_regex, ".*") || logger.invert_channels || logger.shards->len ||
+                       logger.decimations->len)) {
+        fprintf(stderr, "ERROR.  --raw can't be used with -c, -v, --shard or --decimate\n");
+        return 1;
+    }
+    // each trigger writes a log file of its own
+    if (logger.ring_enabled && logger.rotate <= 0)
+        logger.auto_increment = 1;
 
     logger.time0 = g_get_real_time();
     logger.max_write_queue_size = (int64_t) (max_write_queue_size_mb * (1 << 20));
 
-    if (0 != open_logfile(&logger))
+    if (logger.ring_enabled) {
+        if (0 != flight_ring_init(&logger.ring, ring_size ? ring_size : logger.max_write_queue_size,
+                                  logger.ring_file)) {
+            fprintf(stderr, "Couldn't allocate the --ring buffer\n");
+            return 1;
+        }
+    } else if (0 != open_logfile(&logger)) {
+        return 1;
+    }
+    for (unsigned int i = 0; i < logger.shards->len; i++) {
+        if (0 != open_shard(&logger, (shard_t *) g_ptr_array_index(logger.shards, i)))
+            return 1;
+    }
+    if (logger.shards->len && 0 != write_manifest(&logger))
+        return 1;
+    if (logger.shards->len && 0 != write_decimations(&logger))
         return 1;
 
     /* THREADING:
@@ -844,37 +2290,88 @@ int main(int argc, char *argv[])
      *      `g_main_loop_run(_mainloop)` effectively does
      *      `while (not_interrupted) lcm_handle(logger.lcm);`.
      *      That in turn calls message_handler for every message.
-     *      Messages are copied into a logger_event_t and pushed into
-     *      the logger.write_queue.
+     *      Messages are copied into a queued_event_t in the logger.write_queue
+     *      ring, or only referred to by it if they are large enough to be
+     *      retained until they are written.
      *      When a stop signal (Ctrl+C) is received, glib returns control to `main`.
-     *      A sentinel value is then pushed to the write_queue to indicate that
+     *      logger.sync.write_thread_exit_flag is then set to indicate that
      *      the write thread should stop.
      *
      * 2 (logger.write_thread):
      *      Dumps the write_queue to disk.
-     *      Stops when the sentinel value is found in the queue.
+     *      Stops when the write_queue is empty and the exit flag is set.
      *
-     * The address of logger.sync.write_thread_exit_flag is used as the sentinel value.
-     * The value itself is not being used...
+     *      With --ring, it keeps the write_queue's messages in logger.ring
+     *      instead, until a trigger has it dump them to a new log file.
+     *
+     * 2b (the write_thread of each shard):
+     *      Dumps the shard's write_queue to its log file, and stops the same way.
+     *
+     * 3 (logger.sync_thread):
+     *      Syncs the log file to disk when the write thread flushes it, so
+     *      that a slow disk doesn't stall the write thread.
+     *      Stops when the write thread has stopped.
      *
      */
 
     // create write thread
     logger.sync.write_thread_exit_flag = 0;
-    g_mutex_init(&logger.mutex);
-    logger.sync.write_queue_size = 0;
-    logger.write_queue = g_async_queue_new();
-    logger.write_thread = g_thread_new(NULL, write_thread, &logger);
+    if (0 != event_ring_init(&logger.write_queue, logger.max_write_queue_size)) {
+        fprintf(stderr, "Couldn't allocate the write queue\n");
+        return 1;
+    }
+    logger.write_thread =
+        g_thread_new(NULL, logger.ring_enabled ? ring_write_thread : write_thread, &logger);
+    for (unsigned int i = 0; i < logger.shards->len; i++) {
+        shard_t *shard = (shard_t *) g_ptr_array_index(logger.shards, i);
+        if (0 != event_ring_init(&shard->write_queue, logger.max_write_queue_size)) {
+            fprintf(stderr, "Couldn't allocate the write queue\n");
+            return 1;
+        }
+        shard->write_thread = g_thread_new(NULL, shard_write_thread, shard);
+    }
+
+    // create sync thread
+    g_mutex_init(&logger.sync_mutex);
+    g_cond_init(&logger.sync_cond);
+    logger.sync_fd = -1;
+    logger.sync_thread_exit_flag = 0;
+#ifndef WIN32
+    logger.sync_thread = g_thread_new(NULL, sync_thread, &logger);
+#endif
 
     // begin logging
-    logger.lcm = lcm_create(lcmurl);
+    if (logger.raw) {
+#ifndef WIN32
+        if (0 != raw_open(&logger, lcmurl))
+            return 1;
+#endif
+        if (logger.ring_trigger) {
+            char *regexbuf = g_strdup_printf("^%s$", logger.ring_trigger);
+            GError *rerr = NULL;
+            logger.raw_trigger =
+                g_regex_new(regexbuf, (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, &rerr);
+            g_free(regexbuf);
+            if (rerr) {
+                fprintf(stderr, "%s\n", rerr->message);
+                return 1;
+            }
+        }
+        // only to publish statistics, so that LCM doesn't receive as well
+        if (logger.stats_channel)
+            logger.lcm = lcm_create(lcmurl);
+    } else {
+        logger.lcm = lcm_create(lcmurl);
+    }
     free(lcmurl);
-    if (!logger.lcm) {
+    if (!logger.lcm && (!logger.raw || logger.stats_channel)) {
         fprintf(stderr, "Couldn't initialize LCM!");
         return 1;
     }
 
-    if (logger.invert_channels) {
+    if (logger.raw) {
+        // the datagrams are read from logger.raw_fd instead
+    } else if (logger.invert_channels) {
         // if inverting the channels, subscribe to everything and invert on the
         // callback
         lcm_subscribe(logger.lcm, ".*", message_handler, &logger);
@@ -891,16 +2388,34 @@ int main(int argc, char *argv[])
         // otherwise, let LCM handle the regex
         lcm_subscribe(logger.lcm, chan_regex, message_handler, &logger);
     }
+    if (logger.ring_trigger && !logger.raw)
+        lcm_subscribe(logger.lcm, logger.ring_trigger, trigger_handler, &logger);
 
     free(chan_regex);
 
     _mainloop = g_main_loop_new(NULL, FALSE);
     signal_pipe_glib_quit_on_kill();
-    glib_mainloop_attach_lcm(logger.lcm);
+    GIOChannel *raw_ioc = NULL;
+    if (logger.raw) {
+#ifndef WIN32
+        raw_ioc = g_io_channel_unix_new(logger.raw_fd);
+        g_io_add_watch(raw_ioc, G_IO_IN, (GIOFunc) raw_read, &logger);
+#endif
+    } else {
+        glib_mainloop_attach_lcm(logger.lcm);
+    }
+    if (logger.stats_channel) {
+        logger.last_stats_time = g_get_real_time();
+        g_timeout_add(logger.stats_interval_ms, publish_stats, &logger);
+    }
 
 #ifdef USE_SIGHUP
     signal(SIGHUP, sighup_handler);
 #endif
+#ifdef USE_SIGUSR1
+    if (logger.ring_enabled)
+        signal(SIGUSR1, sigusr1_handler);
+#endif
 
     // ------------------------------------------------------------------------
     // main loop - Returns after a stop signal (Ctrl-C)
@@ -912,33 +2427,75 @@ int main(int argc, char *argv[])
     fprintf(stderr, "\nLogger exiting\n");
 
     {  // LOCK
-        // stop the write thread
-        g_mutex_lock(&logger.mutex);
-        logger.sync.write_thread_exit_flag = 1;
-        g_mutex_unlock(&logger.mutex);
+        // stop the write thread, after it writes the queued events
+        g_mutex_lock(&logger.write_queue.mutex);
+        g_atomic_int_set(&logger.sync.write_thread_exit_flag, 1);
+        g_cond_signal(&logger.write_queue.cond);
+        g_mutex_unlock(&logger.write_queue.mutex);
+    }
+    for (unsigned int i = 0; i < logger.shards->len; i++) {
+        shard_t *shard = (shard_t *) g_ptr_array_index(logger.shards, i);
+        g_mutex_lock(&shard->write_queue.mutex);
+        g_cond_signal(&shard->write_queue.cond);
+        g_mutex_unlock(&shard->write_queue.mutex);
     }
 
-    void *stop_sentinel = &(logger.sync.write_thread_exit_flag);
-    g_async_queue_push(logger.write_queue, stop_sentinel);
     g_thread_join(logger.write_thread);
+    for (unsigned int i = 0; i < logger.shards->len; i++)
+        g_thread_join(((shard_t *) g_ptr_array_index(logger.shards, i))->write_thread);
 
-    g_mutex_clear(&logger.mutex);
+#ifndef WIN32
+    // stop the sync thread, after it finishes any sync
+    g_mutex_lock(&logger.sync_mutex);
+    logger.sync_thread_exit_flag = 1;
+    g_cond_signal(&logger.sync_cond);
+    g_mutex_unlock(&logger.sync_mutex);
+    g_thread_join(logger.sync_thread);
+#endif
+    g_mutex_clear(&logger.sync_mutex);
+    g_cond_clear(&logger.sync_cond);
 
     // cleanup.  This isn't strictly necessary, do it to be pedantic and so that
     // leak checkers don't complain
-    glib_mainloop_detach_lcm(logger.lcm);
-    lcm_destroy(logger.lcm);
-    lcm_eventlog_destroy(logger.log);
+    if (logger.raw) {
+#ifndef WIN32
+        g_io_channel_unref(raw_ioc);
+        close(logger.raw_fd);
+#endif
+        free(logger.raw_bufs);
+        if (logger.raw_trigger)
+            g_regex_unref(logger.raw_trigger);
+    } else {
+        glib_mainloop_detach_lcm(logger.lcm);
+    }
+    if (logger.lcm)
+        lcm_destroy(logger.lcm);
+    if (logger.log)
+        close_logfile(logger.log, &logger.space);
+    if (logger.ring_enabled)
+        flight_ring_clear(&logger.ring);
+    free(logger.ring_file);
+    free(logger.ring_trigger);
 
     g_free(logger.write_directory);
 
-    for (void *msg = g_async_queue_try_pop(logger.write_queue); msg;
-         msg = g_async_queue_try_pop(logger.write_queue)) {
-        if (msg == &logger.sync.write_thread_exit_flag)
-            continue;
-        free(msg);
+    event_ring_clear(&logger.write_queue);
+    for (unsigned int i = 0; i < logger.shards->len; i++) {
+        shard_t *shard = (shard_t *) g_ptr_array_index(logger.shards, i);
+        close_logfile(shard->log, &shard->space);
+        event_ring_clear(&shard->write_queue);
+        g_regex_unref(shard->regex);
+        free(shard);
+    }
+    g_ptr_array_free(logger.shards, TRUE);
+    for (unsigned int i = 0; i < logger.decimations->len; i++) {
+        decimation_t *decimation = (decimation_t *) g_ptr_array_index(logger.decimations, i);
+        g_regex_unref(decimation->regex);
+        g_free(decimation);
     }
-    g_async_queue_unref(logger.write_queue);
+    g_ptr_array_free(logger.decimations, TRUE);
+    g_hash_table_destroy(logger.channels);
+    free(logger.stats_channel);
 
     if (logger.invert_channels) {
         g_regex_unref(logger.regex);
@@ -1,9 +1,13 @@
 #include <getopt.h>
+#include <glib.h>
 #include <lcm/lcm.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+// the most messages published at once when replaying as fast as possible
+#define REPLAY_BATCH_SIZE 64
+
 typedef struct logplayer logplayer_t;
 struct logplayer {
     lcm_t *lcm_in;
@@ -22,16 +26,120 @@ void handler(const lcm_recv_buf_t *rbuf, const char *channel, void *u)
     lcm_publish(l->lcm_out, channel, rbuf->data, rbuf->data_size);
 }
 
+// A channel of the log file, and whether it's played.
+typedef struct {
+    char *name;
+    int wanted;
+} replay_channel_t;
+
+static void replay_channel_free(void *p)
+{
+    replay_channel_t *channel = (replay_channel_t *) p;
+    g_free(channel->name);
+    free(channel);
+}
+
+static replay_channel_t *replay_channel(GHashTable *channels, GRegex *regex,
+                                        const lcm_eventlog_view_t *view)
+{
+    // longer channels can't be published
+    if (view->channellen > LCM_MAX_CHANNEL_NAME_LENGTH)
+        return NULL;
+    char name[LCM_MAX_CHANNEL_NAME_LENGTH + 1];
+    memcpy(name, view->channel, view->channellen);
+    name[view->channellen] = 0;
+
+    replay_channel_t *channel = (replay_channel_t *) g_hash_table_lookup(channels, name);
+    if (!channel) {
+        channel = (replay_channel_t *) calloc(1, sizeof(replay_channel_t));
+        channel->name = g_strdup(name);
+        channel->wanted = g_regex_match(regex, name, (GRegexMatchFlags) 0, NULL);
+        g_hash_table_insert(channels, channel->name, channel);
+    }
+    return channel;
+}
+
+// Replays the log file as fast as possible, or at most max_bytes_per_sec bytes
+// and max_msgs_per_sec messages a second if they're nonzero.  The log file is
+// read from memory, and its messages are published in batches.
+static int replay_fast(logplayer_t *l, const char *file, GRegex *regex,
+                       double max_bytes_per_sec, double max_msgs_per_sec)
+{
+    lcm_eventlog_mmap_t *log = lcm_eventlog_mmap_open(file);
+    if (!log) {
+        fprintf(stderr, "Error: Failed to open %s\n", file);
+        return -1;
+    }
+    GHashTable *channels = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                                 replay_channel_free);
+
+    // with a message rate, a batch is a millisecond of messages at most
+    int batch_size = REPLAY_BATCH_SIZE;
+    if (max_msgs_per_sec > 0)
+        batch_size = CLAMP((int) (max_msgs_per_sec / 1000), 1, REPLAY_BATCH_SIZE);
+
+    lcm_publish_msg_t batch[REPLAY_BATCH_SIZE];
+    int num_msgs = 0;
+    int64_t total_msgs = 0;
+    int64_t total_bytes = 0;
+    int64_t start_time = g_get_monotonic_time();
+    lcm_eventlog_view_t view;
+    memset(&view, 0, sizeof(view));
+    int more;
+    do {
+        more = 0 == lcm_eventlog_next_view(log, &view);
+        if (more) {
+            replay_channel_t *channel = replay_channel(channels, regex, &view);
+            if (channel && channel->wanted) {
+                if (l->verbose)
+                    printf("%.3f Channel %-20s size %d\n", view.timestamp / 1000000.0,
+                           channel->name, view.datalen);
+                batch[num_msgs].channel = channel->name;
+                batch[num_msgs].data = view.data;
+                batch[num_msgs].datalen = view.datalen;
+                num_msgs++;
+            }
+        }
+        if (num_msgs == batch_size || (!more && num_msgs > 0)) {
+            // wait until the batch is within the rates
+            for (int i = 0; i < num_msgs; i++)
+                total_bytes += batch[i].datalen;
+            total_msgs += num_msgs;
+            double min_secs = 0;
+            if (max_bytes_per_sec > 0)
+                min_secs = total_bytes / max_bytes_per_sec;
+            if (max_msgs_per_sec > 0)
+                min_secs = MAX(min_secs, total_msgs / max_msgs_per_sec);
+            int64_t wait = start_time + (int64_t) (min_secs * 1e6) - g_get_monotonic_time();
+            if (wait > 0)
+                g_usleep(wait);
+
+            lcm_publish_batch(l->lcm_out, batch, num_msgs);
+            num_msgs = 0;
+        }
+    } while (more);
+
+    g_hash_table_destroy(channels);
+    lcm_eventlog_mmap_close(log);
+    return 0;
+}
+
 static void usage(char *cmd)
 {
     fprintf(stderr,
             "\
-Usage: %s [OPTION...] FILE\n\n\
-Reads packets from an LCM log file and publishes them to LCM.\n\
+Usage: %s [OPTION...] FILE...\n\n\
+Reads packets from an LCM log file and publishes them to LCM.  Several log\n\
+files are played together, in order of their packets' timestamps.\n\
 \n\
 Options:\n\
   -v, --verbose       Print information about each packet.\n\
-  -s, --speed=NUM     Playback speed multiplier.  Default is 1.0.\n\
+  -s, --speed=NUM     Playback speed multiplier.  Default is 1.0.  If 0 or\n\
+                      max, the log file is played as fast as possible.\n\
+      --max-mb-per-sec=NUM\n\
+                      With --speed=max, play at most NUM MB a second.\n\
+      --max-msgs-per-sec=NUM\n\
+                      With --speed=max, play at most NUM messages a second.\n\
   -e, --regexp=EXPR   GLib regular expression of channels to play.\n\
   -l, --lcm-url=URL   Play logged messages on the specified LCM URL.\n\
   -h, --help          Shows some help text and exits.\n\
@@ -43,12 +151,16 @@ int main(int argc, char **argv)
 {
     logplayer_t l;
     double speed = 1.0;
+    double max_bytes_per_sec = 0;
+    double max_msgs_per_sec = 0;
     int c;
     char *expression = NULL;
     struct option long_opts[] = {
         {"help", no_argument, 0, 'h'},          {"speed", required_argument, 0, 's'},
         {"lcm-url", required_argument, 0, 'l'}, {"verbose", no_argument, 0, 'v'},
-        {"regexp", required_argument, 0, 'e'},  {0, 0, 0, 0},
+        {"regexp", required_argument, 0, 'e'},  {"max-mb-per-sec", required_argument, 0, 128},
+        {"max-msgs-per-sec", required_argument, 0, 129},
+        {0, 0, 0, 0},
     };
 
     char *lcmurl = NULL;
@@ -56,7 +168,13 @@ int main(int argc, char **argv)
     while ((c = getopt_long(argc, argv, "hp:s:ve:l:", long_opts, 0)) >= 0) {
         switch (c) {
         case 's':
-            speed = strtod(optarg, NULL);
+            speed = strcmp(optarg, "max") ? strtod(optarg, NULL) : 0;
+            break;
+        case 128:
+            max_bytes_per_sec = strtod(optarg, NULL) * (1 << 20);
+            break;
+        case 129:
+            max_msgs_per_sec = strtod(optarg, NULL);
             break;
         case 'l':
             free(lcmurl);
@@ -75,21 +193,55 @@ int main(int argc, char **argv)
         };
     }
 
-    if (optind != argc - 1) {
+    if (optind >= argc) {
         usage(argv[0]);
         return 1;
     }
 
-    char *file = argv[optind];
-    printf("Using playback speed %f\n", speed);
+    // the file provider reads a list of log files as one
+    int num_files = argc - optind;
+    char *file = g_strjoinv(",", argv + optind);
+    if (speed > 0)
+        printf("Using playback speed %f\n", speed);
+    else
+        printf("Playing as fast as possible\n");
     if (!expression)
         expression = strdup(".*");
+
+    // a log file of the original format is played straight from memory as
+    // fast as possible, instead of event by event through an lcm_t
+    if (speed <= 0 && num_files == 1 && !lcm_blocklog_detect(file) &&
+        !lcm_eventlog_merge_detect(file)) {
+        char *regexbuf = g_strdup_printf("^%s$", expression);
+        GError *rerr = NULL;
+        GRegex *regex = g_regex_new(regexbuf, (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, &rerr);
+        g_free(regexbuf);
+        free(expression);
+        if (rerr) {
+            fprintf(stderr, "%s\n", rerr->message);
+            g_error_free(rerr);
+            return 1;
+        }
+
+        l.lcm_out = lcm_create(lcmurl);
+        free(lcmurl);
+        if (!l.lcm_out) {
+            fprintf(stderr, "Error: Failed to create LCM\n");
+            g_regex_unref(regex);
+            return 1;
+        }
+        int status = replay_fast(&l, file, regex, max_bytes_per_sec, max_msgs_per_sec);
+        lcm_destroy(l.lcm_out);
+        g_regex_unref(regex);
+        g_free(file);
+        return status == 0 ? 0 : 1;
+    }
 #ifndef WIN32
     char url_in[strlen(file) + 64];
 #else
     char url_in[2048];
 #endif
-    sprintf(url_in, "file://%s?speed=%f", argv[optind], speed);
+    sprintf(url_in, "file://%s?speed=%f", file, speed);
     l.lcm_in = lcm_create(url_in);
     if (!l.lcm_in) {
         fprintf(stderr, "Error: Failed to open %s\n", file);
@@ -114,4 +266,5 @@ int main(int argc, char **argv)
     lcm_destroy(l.lcm_in);
     lcm_destroy(l.lcm_out);
     free(expression);
+    g_free(file);
 }
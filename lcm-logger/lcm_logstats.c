@@ -0,0 +1,398 @@
+#include <getopt.h>
+#include <glib.h>
+#include <inttypes.h>
+#include <lcm/lcm.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#define fseeko _fseeki64
+#define ftello _ftelli64
+#endif
+
+// the most threads that read the log file
+#define MAX_THREADS 64
+
+// The events on a channel, in the time window, of a part of the log file or
+// the whole of it.
+typedef struct {
+    char *name;
+    int wanted;
+    int64_t events;
+    int64_t bytes;
+    int64_t first_timestamp;
+    int64_t last_timestamp;
+    // the longest time between two events on the channel
+    int64_t max_gap;
+} channel_stats_t;
+
+typedef struct {
+    const lcm_eventlog_mmap_t *log;
+    GRegex *regex;
+    int64_t start_timestamp;
+    int64_t end_timestamp;
+} logstats_t;
+
+// A part of the log file, which is read by a thread.  The events that start
+// from start to end are read, starting at the first valid one.
+typedef struct {
+    const logstats_t *stats;
+    int64_t start;
+    int64_t end;
+    // the offset of the first event read, and of the event after the last one
+    // read, which is the first that starts at or after end
+    int64_t first_offset;
+    int64_t next_offset;
+
+    GHashTable *channels;  // char* -> channel_stats_t*
+    // all of the events of the part, including those not in the time window
+    int64_t events;
+    int64_t first_eventnum;
+    int64_t last_eventnum;
+    // the events whose numbers are skipped, which the logger dropped
+    int64_t missing_events;
+    // the events written to out, if it's set
+    lcm_eventlog_t *out;
+} range_t;
+
+static void channel_stats_free(void *p)
+{
+    channel_stats_t *channel = (channel_stats_t *) p;
+    g_free(channel->name);
+    free(channel);
+}
+
+static channel_stats_t *channel_stats(range_t *range, const lcm_eventlog_view_t *view)
+{
+    char name[1000];
+    memcpy(name, view->channel, view->channellen);
+    name[view->channellen] = 0;
+
+    channel_stats_t *channel = (channel_stats_t *) g_hash_table_lookup(range->channels, name);
+    if (!channel) {
+        channel = (channel_stats_t *) calloc(1, sizeof(channel_stats_t));
+        channel->name = g_strdup(name);
+        channel->wanted = !range->stats->regex ||
+                          g_regex_match(range->stats->regex, name, (GRegexMatchFlags) 0, NULL);
+        g_hash_table_insert(range->channels, channel->name, channel);
+    }
+    return channel;
+}
+
+static void count_event(range_t *range, const lcm_eventlog_view_t *view)
+{
+    if (range->events > 0 && view->eventnum > range->last_eventnum + 1)
+        range->missing_events += view->eventnum - range->last_eventnum - 1;
+    if (range->events == 0)
+        range->first_eventnum = view->eventnum;
+    range->last_eventnum = view->eventnum;
+    range->events++;
+
+    const logstats_t *stats = range->stats;
+    if (view->timestamp < stats->start_timestamp || view->timestamp >= stats->end_timestamp)
+        return;
+    channel_stats_t *channel = channel_stats(range, view);
+    if (!channel->wanted)
+        return;
+
+    if (range->out) {
+        lcm_eventlog_event_t event;
+        event.timestamp = view->timestamp;
+        event.channellen = view->channellen;
+        event.datalen = view->datalen;
+        event.channel = channel->name;
+        event.data = (void *) view->data;
+        if (0 != lcm_eventlog_write_event(range->out, &event)) {
+            fprintf(stderr, "Error: Failed to write an event\n");
+            exit(1);
+        }
+    }
+    if (channel->events > 0)
+        channel->max_gap = MAX(channel->max_gap, view->timestamp - channel->last_timestamp);
+    else
+        channel->first_timestamp = view->timestamp;
+    channel->last_timestamp = view->timestamp;
+    channel->events++;
+    channel->bytes += view->datalen;
+}
+
+// Reads the events of a part of the log file, resynchronizing after data that
+// isn't a valid event.
+static void *read_range(void *user)
+{
+    range_t *range = (range_t *) user;
+    const lcm_eventlog_mmap_t *log = range->stats->log;
+    lcm_eventlog_view_t view;
+    memset(&view, 0, sizeof(view));
+    if (0 != lcm_eventlog_find_view(log, range->start, &view)) {
+        range->first_offset = range->next_offset = INT64_MAX;
+        return NULL;
+    }
+    range->first_offset = view.offset;
+    while (view.offset < range->end) {
+        count_event(range, &view);
+        if (0 != lcm_eventlog_next_view(log, &view) &&
+            0 != lcm_eventlog_find_view(log, view.offset + 1, &view)) {
+            view.offset = INT64_MAX;
+            break;
+        }
+    }
+    range->next_offset = view.offset;
+    return NULL;
+}
+
+static void range_init(range_t *range, const logstats_t *stats, int64_t start, int64_t end)
+{
+    memset(range, 0, sizeof(*range));
+    range->stats = stats;
+    range->start = start;
+    range->end = end;
+    range->channels =
+        g_hash_table_new_full(g_str_hash, g_str_equal, NULL, channel_stats_free);
+}
+
+static gint compare_channels(gconstpointer a, gconstpointer b)
+{
+    const channel_stats_t *ca = *(const channel_stats_t *const *) a;
+    const channel_stats_t *cb = *(const channel_stats_t *const *) b;
+    return strcmp(ca->name, cb->name);
+}
+
+// Adds the statistics of the next part of the log file to those of the parts
+// before it.
+static void merge_range(range_t *total, const range_t *range)
+{
+    if (range->events > 0) {
+        if (total->events == 0)
+            total->first_eventnum = range->first_eventnum;
+        else if (range->first_eventnum > total->last_eventnum + 1)
+            total->missing_events += range->first_eventnum - total->last_eventnum - 1;
+        total->last_eventnum = range->last_eventnum;
+        total->events += range->events;
+        total->missing_events += range->missing_events;
+    }
+
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, range->channels);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        const channel_stats_t *part = (const channel_stats_t *) value;
+        if (part->events == 0)
+            continue;
+        channel_stats_t *channel =
+            (channel_stats_t *) g_hash_table_lookup(total->channels, part->name);
+        if (!channel) {
+            channel = (channel_stats_t *) calloc(1, sizeof(channel_stats_t));
+            *channel = *part;
+            channel->name = g_strdup(part->name);
+            g_hash_table_insert(total->channels, channel->name, channel);
+            continue;
+        }
+        channel->max_gap = MAX(channel->max_gap, part->max_gap);
+        channel->max_gap = MAX(channel->max_gap, part->first_timestamp - channel->last_timestamp);
+        channel->last_timestamp = part->last_timestamp;
+        channel->events += part->events;
+        channel->bytes += part->bytes;
+    }
+}
+
+static void print_stats(const range_t *total)
+{
+    GPtrArray *channels = g_ptr_array_new();
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, total->channels);
+    while (g_hash_table_iter_next(&iter, NULL, &value))
+        g_ptr_array_add(channels, value);
+    g_ptr_array_sort(channels, compare_channels);
+
+    int64_t events = 0;
+    int64_t bytes = 0;
+    int64_t first_timestamp = INT64_MAX;
+    int64_t last_timestamp = INT64_MIN;
+    printf("%-32s %10s %10s %10s %12s\n", "Channel", "Events", "MB", "Hz", "Max gap (ms)");
+    for (guint i = 0; i < channels->len; i++) {
+        const channel_stats_t *channel = (const channel_stats_t *) g_ptr_array_index(channels, i);
+        double secs = (channel->last_timestamp - channel->first_timestamp) / 1e6;
+        // the rate counts the intervals between the events
+        double hz = secs > 0 ? (channel->events - 1) / secs : 0;
+        printf("%-32s %10" PRIi64 " %10.3f %10.2f %12.3f\n", channel->name, channel->events,
+               channel->bytes / (double) (1 << 20), hz, channel->max_gap / 1e3);
+        events += channel->events;
+        bytes += channel->bytes;
+        first_timestamp = MIN(first_timestamp, channel->first_timestamp);
+        last_timestamp = MAX(last_timestamp, channel->last_timestamp);
+    }
+    g_ptr_array_free(channels, TRUE);
+
+    double secs = events > 0 ? (last_timestamp - first_timestamp) / 1e6 : 0;
+    printf("\n%" PRIi64 " events, %.3f MB over %.3f seconds\n", events, bytes / (double) (1 << 20),
+           secs);
+    if (total->missing_events > 0)
+        printf("%" PRIi64 " event numbers are missing from the log file\n",
+               total->missing_events);
+}
+
+static void usage(char *cmd)
+{
+    fprintf(stderr,
+            "\
+Usage: %s [OPTION...] FILE\n\n\
+Prints the number of events, bytes, rate and longest gap between events of\n\
+each channel of the LCM log file FILE, reading parts of it in parallel.\n\
+\n\
+Options:\n\
+  -e, --regexp=EXPR   GLib regular expression of channels to include.\n\
+  -s, --start=SEC     Include the events from SEC seconds after the first one.\n\
+  -t, --end=SEC       Include the events until SEC seconds after the first one.\n\
+  -o, --output=FILE   Write the events included to the log file FILE.\n\
+  -j, --threads=N     Read with N threads.  Defaults to the number of CPUs.\n\
+  -h, --help          Shows some help text and exits.\n\
+  \n",
+            cmd);
+}
+
+int main(int argc, char **argv)
+{
+    int c;
+    struct option long_opts[] = {
+        {"help", no_argument, 0, 'h'},          {"regexp", required_argument, 0, 'e'},
+        {"start", required_argument, 0, 's'},   {"end", required_argument, 0, 't'},
+        {"output", required_argument, 0, 'o'},  {"threads", required_argument, 0, 'j'},
+        {0, 0, 0, 0},
+    };
+
+    char *expression = NULL;
+    double start_secs = -1;
+    double end_secs = -1;
+    char *output = NULL;
+    int num_threads = g_get_num_processors();
+    while ((c = getopt_long(argc, argv, "he:s:t:o:j:", long_opts, 0)) >= 0) {
+        switch (c) {
+        case 'e':
+            expression = optarg;
+            break;
+        case 's':
+            start_secs = strtod(optarg, NULL);
+            break;
+        case 't':
+            end_secs = strtod(optarg, NULL);
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'j':
+            num_threads = atoi(optarg);
+            if (num_threads < 1 || num_threads > MAX_THREADS) {
+                fprintf(stderr, "Error: The number of threads must be from 1 to %d\n",
+                        MAX_THREADS);
+                return 1;
+            }
+            break;
+        case 'h':
+        default:
+            usage(argv[0]);
+            return 1;
+        };
+    }
+
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    const char *file = argv[optind];
+
+    logstats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    if (expression) {
+        char *regexbuf = g_strdup_printf("^%s$", expression);
+        GError *rerr = NULL;
+        stats.regex = g_regex_new(regexbuf, (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, &rerr);
+        g_free(regexbuf);
+        if (rerr) {
+            fprintf(stderr, "%s\n", rerr->message);
+            g_error_free(rerr);
+            return 1;
+        }
+    }
+
+    lcm_eventlog_mmap_t *log = lcm_eventlog_mmap_open(file);
+    if (!log) {
+        fprintf(stderr, "Error: Failed to open %s\n", file);
+        return 1;
+    }
+    stats.log = log;
+
+    // the time window is relative to the first event
+    lcm_eventlog_view_t first;
+    int64_t size = 0;
+    stats.start_timestamp = INT64_MIN;
+    stats.end_timestamp = INT64_MAX;
+    if (0 == lcm_eventlog_find_view(log, 0, &first)) {
+        FILE *f = fopen(file, "rb");
+        if (f && 0 == fseeko(f, 0, SEEK_END))
+            size = ftello(f);
+        if (f)
+            fclose(f);
+        if (start_secs >= 0)
+            stats.start_timestamp = first.timestamp + (int64_t) (start_secs * 1e6);
+        if (end_secs >= 0)
+            stats.end_timestamp = first.timestamp + (int64_t) (end_secs * 1e6);
+    }
+
+    // The log file is split into a part for each thread, each of which starts
+    // reading at its first valid event.  If that isn't where the part before
+    // it stopped, because it started in the data of an event, then it's read
+    // again from there.
+    range_t ranges[MAX_THREADS];
+    GThread *threads[MAX_THREADS];
+    for (int i = 0; i < num_threads; i++) {
+        range_init(&ranges[i], &stats, size * i / num_threads, size * (i + 1) / num_threads);
+        threads[i] = i > 0 ? g_thread_new("lcm-logstats", read_range, &ranges[i]) : NULL;
+    }
+    read_range(&ranges[0]);
+    for (int i = 1; i < num_threads; i++) {
+        g_thread_join(threads[i]);
+        if (ranges[i].first_offset != ranges[i - 1].next_offset) {
+            int64_t end = ranges[i].end;
+            g_hash_table_destroy(ranges[i].channels);
+            range_init(&ranges[i], &stats, MIN(ranges[i - 1].next_offset, size), end);
+            read_range(&ranges[i]);
+        }
+    }
+
+    range_t total;
+    range_init(&total, &stats, 0, size);
+    for (int i = 0; i < num_threads; i++)
+        merge_range(&total, &ranges[i]);
+    print_stats(&total);
+
+    // The events are written in order, after they've been counted.
+    int status = 0;
+    if (output) {
+        lcm_eventlog_t *out = lcm_eventlog_create(output, "w");
+        if (!out) {
+            fprintf(stderr, "Error: Failed to open %s\n", output);
+            status = 1;
+        }
+        for (int i = 0; out && i < num_threads; i++) {
+            int64_t start = ranges[i].start;
+            int64_t end = ranges[i].end;
+            g_hash_table_destroy(ranges[i].channels);
+            range_init(&ranges[i], &stats, start, end);
+            ranges[i].out = out;
+            read_range(&ranges[i]);
+        }
+        if (out)
+            lcm_eventlog_destroy(out);
+    }
+
+    for (int i = 0; i < num_threads; i++)
+        g_hash_table_destroy(ranges[i].channels);
+    g_hash_table_destroy(total.channels);
+    lcm_eventlog_mmap_close(log);
+    if (stats.regex)
+        g_regex_unref(stats.regex);
+    return status;
+}
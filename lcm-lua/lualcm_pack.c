@@ -1,6 +1,7 @@
 #include "lualcm_pack.h"
 
 #include "errno.h"
+#include "lcm/lcm_coretypes.h"
 #include "lua_ver_helper.h"
 #include "lualcm_hash.h"
 #include "stdint.h"
@@ -19,6 +20,7 @@
 /* functions */
 static int impl_unpack(lua_State *);
 static int impl_pack(lua_State *);
+static int impl_compile(lua_State *);
 static int impl_prepare_string(lua_State *);
 static int impl_trim_to_null(lua_State *);
 static int impl_utf8_check(lua_State *);
@@ -44,23 +46,39 @@ typedef struct impl_pack_op {
     size_t repeat; /* for strings, repeat is used as the string length */
 } impl_pack_op_t;
 
-typedef struct impl_pack_op_list {
-    size_t num_ops;
+/* a parsed format. compile() returns one as a userdatum, which pack and
+ * unpack take in place of the format string, so that generated code only
+ * parses each of its formats once. */
+typedef struct impl_plan {
     impl_pack_op_t *ops;
-    bool big_endian;
-} impl_pack_op_list_t;
+    size_t num_ops;
+    bool is_little_endian;
+    size_t buf_size;
+    int stack_size;
+} impl_plan_t;
+
+#define IMPL_PLAN_METATABLE "lcm._pack.plan"
+
+/* the number of values that are converted at a time */
+#define IMPL_CHUNK_SIZE 64
+
+/* the largest packed buffer that is built on the C stack */
+#define IMPL_STACK_BUFFER_SIZE 256
 
 /* supporting functions */
 static bool impl_format_to_ops(impl_pack_op_t *, size_t, size_t *, bool *, const char *,
                                const char **);
 static size_t impl_get_required_buffer_size(impl_pack_op_t *, size_t);
 static int impl_get_required_stack_size(impl_pack_op_t *, size_t);
-static bool impl_unpack_buffer(lua_State *, impl_pack_op_t *, size_t, bool, const uint8_t *, size_t,
+static bool impl_plan_init(impl_plan_t *, impl_pack_op_t *, size_t, const char *, const char **);
+static const impl_plan_t *impl_get_plan(lua_State *, int, impl_plan_t *, impl_pack_op_t *, size_t);
+static bool impl_unpack_buffer(lua_State *, const impl_plan_t *, const uint8_t *, size_t,
                                const char **);
-static bool impl_pack_buffer(lua_State *, impl_pack_op_t *, size_t, bool, uint8_t *, size_t,
-                             size_t *, const char **);
+static bool impl_pack_buffer(lua_State *, const impl_plan_t *, uint8_t *, size_t, size_t *,
+                             const char **);
 static bool impl_is_machine_little_endian(void);
 static void impl_swap_bytes(uint8_t *, size_t);
+static void impl_copy_values(void *, const void *, size_t, size_t, bool);
 
 /* unpack helper functions */
 static void impl_unpack_int8_t(lua_State *, const uint8_t *, size_t *, size_t);
@@ -96,95 +114,105 @@ void ll_pack_register(lua_State *L)
     const struct luaL_Reg functions[] = {
         {"pack", impl_pack},
         {"unpack", impl_unpack},
+        {"compile", impl_compile},
         {"prepare_string", impl_prepare_string},
         {"_trim_to_null", impl_trim_to_null},
         {"_utf8_check", impl_utf8_check},
         {NULL, NULL},
     };
 
+    /* plans have pack and unpack methods */
+    const struct luaL_Reg plan_methods[] = {
+        {"pack", impl_pack},
+        {"unpack", impl_unpack},
+        {NULL, NULL},
+    };
+
+    luaL_newmetatable(L, IMPL_PLAN_METATABLE);
+    lua_newtable(L);
+    luaX_registertable(L, plan_methods);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+
     luaX_registerglobal(L, "lcm._pack", functions);
 }
 
-int impl_unpack(lua_State *L)
+int impl_compile(lua_State *L)
 {
     /* get the format */
     const char *format = luaL_checkstring(L, 1);
 
-    /* some variables used for reading the format */
-    bool is_little_endian;
-    size_t num_ops;
-    impl_pack_op_t ops[20];
+    /* each operator takes at least one character of the format */
+    const size_t max_num_ops = strlen(format) + 1;
+    impl_plan_t *plan = (impl_plan_t *) lua_newuserdata(
+        L, sizeof(impl_plan_t) + max_num_ops * sizeof(impl_pack_op_t));
 
-    /* variables used to check results */
-    bool success;
+    /* userdata aren't moved, so the ops can follow the plan */
     const char *error_message;
-
-    /* turn format into ops */
-    success = impl_format_to_ops(ops, 20, &num_ops, &is_little_endian, format, &error_message);
-
-    /* check the result */
-    if (!success) {
+    if (!impl_plan_init(plan, (impl_pack_op_t *) (plan + 1), max_num_ops, format,
+                        &error_message)) {
         luaL_error(L, "error reading format: %s", error_message);
     }
 
-    /* get number of values */
-    const int num_values = impl_get_required_stack_size(ops, num_ops);
+    luaL_getmetatable(L, IMPL_PLAN_METATABLE);
+    lua_setmetatable(L, -2);
+
+    return 1;
+}
+
+int impl_unpack(lua_State *L)
+{
+    /* get the plan, parsing the format if necessary */
+    impl_pack_op_t ops[20];
+    impl_plan_t parsed;
+    const impl_plan_t *plan = impl_get_plan(L, 1, &parsed, ops, 20);
 
     /* check the stack size, since some users may try to unpack many values */
-    luaL_checkstack(L, num_values, "Does it look like I have infinite stack?!");
+    luaL_checkstack(L, plan->stack_size, "Does it look like I have infinite stack?!");
 
     /* get the buffer */
     size_t buf_size;
     const uint8_t *buf = (const uint8_t *) luaL_checklstring(L, 2, &buf_size);
 
     /* use ops to unpack */
-    success = impl_unpack_buffer(L, ops, num_ops, is_little_endian, buf, buf_size, &error_message);
+    const char *error_message;
+    bool success = impl_unpack_buffer(L, plan, buf, buf_size, &error_message);
 
     /* check the result */
     if (!success) {
         luaL_error(L, "error unpacking buffer: %s", error_message);
     }
 
-    return num_values;
+    return plan->stack_size;
 }
 
 int impl_pack(lua_State *L)
 {
-    /* get the format */
-    const char *format = luaL_checkstring(L, 1);
-
-    /* some variables used for reading the format */
-    bool is_little_endian;
-    size_t num_ops;
+    /* get the plan, parsing the format if necessary */
     impl_pack_op_t ops[20];
-
-    /* variables used to check results */
-    bool success;
-    const char *error_message;
-
-    /* turn format into ops */
-    success = impl_format_to_ops(ops, 20, &num_ops, &is_little_endian, format, &error_message);
-
-    /* check the result */
-    if (!success) {
-        luaL_error(L, "error reading format: %s", error_message);
+    impl_plan_t parsed;
+    const impl_plan_t *plan = impl_get_plan(L, 1, &parsed, ops, 20);
+
+    /* make buffer, small ones on the stack */
+    uint8_t stack_buf[IMPL_STACK_BUFFER_SIZE];
+    uint8_t *buf = stack_buf;
+    if (plan->buf_size > sizeof(stack_buf)) {
+        buf = (uint8_t *) malloc(plan->buf_size);
     }
 
-    /* make buffer */
-    const size_t buf_size = impl_get_required_buffer_size(ops, num_ops);
-    uint8_t *buf = (uint8_t *) malloc(buf_size);
-
-    /* remove format string from the stack, pack requires this */
-    lua_remove(L, 1);
+    /* the format stays at the bottom of the stack, which keeps a plan alive
+     * while it's used */
 
     /* use ops to pack */
     size_t actual_buf_size = 0;
-    success = impl_pack_buffer(L, ops, num_ops, is_little_endian, buf, buf_size, &actual_buf_size,
-                               &error_message);
+    const char *error_message;
+    bool success =
+        impl_pack_buffer(L, plan, buf, plan->buf_size, &actual_buf_size, &error_message);
 
     /* check the result */
     if (!success) {
-        free(buf);
+        if (buf != stack_buf)
+            free(buf);
         luaL_error(L, "error packing buffer: %s", error_message);
     }
 
@@ -194,7 +222,8 @@ int impl_pack(lua_State *L)
 
     /* push the buffer */
     lua_pushlstring(L, (const char *) buf, actual_buf_size);
-    free(buf);
+    if (buf != stack_buf)
+        free(buf);
 
     return 1;
 }
@@ -255,7 +284,8 @@ static bool impl_format_to_ops(impl_pack_op_t *ops, size_t max_num_ops, size_t *
     if (c == '@' || c == '=' || c == '<' || c == '>' || c == '!') {
         switch (c) {
         case '@':
-            return false; /* not supported */
+            *error_message = "native alignment is not supported";
+            return false;
             break;
         case '=':
             *is_little_endian = impl_is_machine_little_endian();
@@ -359,6 +389,43 @@ static bool impl_format_to_ops(impl_pack_op_t *ops, size_t max_num_ops, size_t *
     return true;
 }
 
+static bool impl_plan_init(impl_plan_t *plan, impl_pack_op_t *ops, size_t max_num_ops,
+                           const char *format, const char **error_message)
+{
+    plan->ops = ops;
+    if (!impl_format_to_ops(ops, max_num_ops, &plan->num_ops, &plan->is_little_endian, format,
+                            error_message)) {
+        return false;
+    }
+
+    plan->buf_size = impl_get_required_buffer_size(ops, plan->num_ops);
+    plan->stack_size = impl_get_required_stack_size(ops, plan->num_ops);
+    return true;
+}
+
+static const impl_plan_t *impl_get_plan(lua_State *L, int index, impl_plan_t *parsed,
+                                        impl_pack_op_t *ops, size_t max_num_ops)
+{
+    /* a compiled plan */
+    if (lua_getmetatable(L, index)) {
+        luaL_getmetatable(L, IMPL_PLAN_METATABLE);
+        bool is_plan = lua_rawequal(L, -1, -2);
+        lua_pop(L, 2);
+        if (is_plan) {
+            return (const impl_plan_t *) lua_touserdata(L, index);
+        }
+    }
+
+    /* otherwise a format, parsed into the given ops */
+    const char *format = luaL_checkstring(L, index);
+    const char *error_message;
+    if (!impl_plan_init(parsed, ops, max_num_ops, format, &error_message)) {
+        luaL_error(L, "error reading format: %s", error_message);
+    }
+
+    return parsed;
+}
+
 static size_t impl_get_required_buffer_size(impl_pack_op_t *ops, size_t num_ops)
 {
     size_t buf_size = 0;
@@ -451,20 +518,20 @@ static int impl_get_required_stack_size(impl_pack_op_t *ops, size_t num_ops)
     return num_values;
 }
 
-static bool impl_unpack_buffer(lua_State *L, impl_pack_op_t *ops, size_t num_ops,
-                               bool is_little_endian, const uint8_t *buf, size_t buf_size,
-                               const char **error_message)
+static bool impl_unpack_buffer(lua_State *L, const impl_plan_t *plan, const uint8_t *buf,
+                               size_t buf_size, const char **error_message)
 {
-    const size_t req_buf_size = impl_get_required_buffer_size(ops, num_ops);
+    const impl_pack_op_t *ops = plan->ops;
+    const size_t num_ops = plan->num_ops;
 
     /* make sure we won't run out of buffer */
-    if (req_buf_size > buf_size) {
+    if (plan->buf_size > buf_size) {
         *error_message = "buffer is too small";
         return false;
     }
 
     bool swap = false;
-    if (is_little_endian != impl_is_machine_little_endian()) {
+    if (plan->is_little_endian != impl_is_machine_little_endian()) {
         swap = true;
     }
 
@@ -512,27 +579,27 @@ static bool impl_unpack_buffer(lua_State *L, impl_pack_op_t *ops, size_t num_ops
     return true;
 }
 
-static bool impl_pack_buffer(lua_State *L, impl_pack_op_t *ops, size_t num_ops,
-                             bool is_little_endian, uint8_t *buf, size_t max_buf_size,
-                             size_t *buf_size, const char **error_message)
+static bool impl_pack_buffer(lua_State *L, const impl_plan_t *plan, uint8_t *buf,
+                             size_t max_buf_size, size_t *buf_size, const char **error_message)
 {
-    const size_t req_buf_size = impl_get_required_buffer_size(ops, num_ops);
-    const int req_stack_size = impl_get_required_stack_size(ops, num_ops);
+    const impl_pack_op_t *ops = plan->ops;
+    const size_t num_ops = plan->num_ops;
+    const int req_stack_size = plan->stack_size;
 
     /* this check ensures the offset will never exceed max_buf_size */
-    if (req_buf_size > max_buf_size) {
+    if (plan->buf_size > max_buf_size) {
         *error_message = "buffer is too small";
         return false;
     }
 
-    /* this assumes only arguments are on the stack */
-    if (req_stack_size > lua_gettop(L)) {
+    /* this assumes only the format and arguments are on the stack */
+    if (req_stack_size > lua_gettop(L) - 1) {
         *error_message = "missing arguments";
         return false;
     }
 
     bool swap = false;
-    if (is_little_endian != impl_is_machine_little_endian()) {
+    if (plan->is_little_endian != impl_is_machine_little_endian()) {
         swap = true;
     }
 
@@ -578,10 +645,10 @@ static bool impl_pack_buffer(lua_State *L, impl_pack_op_t *ops, size_t num_ops,
         }
     }
 
-    /* at this point, req_buf_size and offset will be the same if offset is
-     * greater than req_buf_size, then we should worry about a segfault */
+    /* at this point, plan->buf_size and offset will be the same if offset is
+     * greater than plan->buf_size, then we should worry about a segfault */
 
-    *buf_size = offset; /* or req_buf_size */
+    *buf_size = offset; /* or plan->buf_size */
 
     return true;
 }
@@ -609,6 +676,35 @@ static void impl_swap_bytes(uint8_t *buffer, size_t num)
     }
 }
 
+static void impl_copy_values(void *dst, const void *src, size_t count, size_t size, bool swap)
+{
+    if (!swap) {
+        memcpy(dst, src, count * size);
+        return;
+    }
+
+#if defined(__LCM_LITTLE_ENDIAN)
+    /* the coretypes kernels swap from the wire's big endian order */
+    switch (size) {
+    case 2:
+        __lcm_copy_swap16(dst, src, (int) count);
+        return;
+    case 4:
+        __lcm_copy_swap32(dst, src, (int) count);
+        return;
+    case 8:
+        __lcm_copy_swap64(dst, src, (int) count);
+        return;
+    }
+#endif
+
+    memcpy(dst, src, count * size);
+    size_t i;
+    for (i = 0; i < count; ++i) {
+        impl_swap_bytes((uint8_t *) dst + i * size, size);
+    }
+}
+
 static void impl_unpack_int8_t(lua_State *L, const uint8_t *buf, size_t *offset, size_t repeat)
 {
     while (repeat-- > 0) {
@@ -621,36 +717,45 @@ static void impl_unpack_int8_t(lua_State *L, const uint8_t *buf, size_t *offset,
 static void impl_unpack_int16_t(lua_State *L, const uint8_t *buf, size_t *offset, size_t repeat,
                                 bool swap)
 {
-    while (repeat-- > 0) {
-        int16_t n = *((int16_t *) (buf + *offset));
-        if (swap)
-            impl_swap_bytes((uint8_t *) &n, sizeof(int16_t));
-        lua_pushnumber(L, n);
-        *offset += sizeof(int16_t);
+    int16_t n[IMPL_CHUNK_SIZE];
+    while (repeat > 0) {
+        size_t count = repeat < IMPL_CHUNK_SIZE ? repeat : IMPL_CHUNK_SIZE;
+        impl_copy_values(n, buf + *offset, count, sizeof(int16_t), swap);
+        size_t i;
+        for (i = 0; i < count; ++i)
+            lua_pushnumber(L, n[i]);
+        *offset += count * sizeof(int16_t);
+        repeat -= count;
     }
 }
 
 static void impl_unpack_int32_t(lua_State *L, const uint8_t *buf, size_t *offset, size_t repeat,
                                 bool swap)
 {
-    while (repeat-- > 0) {
-        int32_t n = *((int32_t *) (buf + *offset));
-        if (swap)
-            impl_swap_bytes((uint8_t *) &n, sizeof(int32_t));
-        lua_pushnumber(L, n);
-        *offset += sizeof(int32_t);
+    int32_t n[IMPL_CHUNK_SIZE];
+    while (repeat > 0) {
+        size_t count = repeat < IMPL_CHUNK_SIZE ? repeat : IMPL_CHUNK_SIZE;
+        impl_copy_values(n, buf + *offset, count, sizeof(int32_t), swap);
+        size_t i;
+        for (i = 0; i < count; ++i)
+            lua_pushnumber(L, n[i]);
+        *offset += count * sizeof(int32_t);
+        repeat -= count;
     }
 }
 
 static void impl_unpack_uint32_t(lua_State *L, const uint8_t *buf, size_t *offset, size_t repeat,
                                  bool swap)
 {
-    while (repeat-- > 0) {
-        uint32_t n = *((uint32_t *) (buf + *offset));
-        if (swap)
-            impl_swap_bytes((uint8_t *) &n, sizeof(uint32_t));
-        lua_pushnumber(L, n);
-        *offset += sizeof(uint32_t);
+    uint32_t n[IMPL_CHUNK_SIZE];
+    while (repeat > 0) {
+        size_t count = repeat < IMPL_CHUNK_SIZE ? repeat : IMPL_CHUNK_SIZE;
+        impl_copy_values(n, buf + *offset, count, sizeof(uint32_t), swap);
+        size_t i;
+        for (i = 0; i < count; ++i)
+            lua_pushnumber(L, n[i]);
+        *offset += count * sizeof(uint32_t);
+        repeat -= count;
     }
 }
 
@@ -660,43 +765,53 @@ static void impl_unpack_int64_t(lua_State *L, const uint8_t *buf, size_t *offset
     static const int64_t DOUBLE_MAX_INT = 9007199254740992; /* 2^53 */
     static bool warned = false;
 
-    while (repeat-- > 0) {
-        int64_t n = *((int64_t *) (buf + *offset));
-        if (swap)
-            impl_swap_bytes((uint8_t *) &n, sizeof(int64_t));
-        if (!warned) {
-            if (n >= DOUBLE_MAX_INT || n <= -DOUBLE_MAX_INT) {
-                fprintf(stderr,
-                        "WARNING! Unpacking really large integers may result in loss "
-                        "of precision!\n");
+    int64_t n[IMPL_CHUNK_SIZE];
+    while (repeat > 0) {
+        size_t count = repeat < IMPL_CHUNK_SIZE ? repeat : IMPL_CHUNK_SIZE;
+        impl_copy_values(n, buf + *offset, count, sizeof(int64_t), swap);
+        size_t i;
+        for (i = 0; i < count; ++i) {
+            if (!warned) {
+                if (n[i] >= DOUBLE_MAX_INT || n[i] <= -DOUBLE_MAX_INT) {
+                    fprintf(stderr,
+                            "WARNING! Unpacking really large integers may result in loss "
+                            "of precision!\n");
+                }
             }
+            lua_pushnumber(L, n[i]);
         }
-        lua_pushnumber(L, n);
-        *offset += sizeof(int64_t);
+        *offset += count * sizeof(int64_t);
+        repeat -= count;
     }
 }
 
 static void impl_unpack_float(lua_State *L, const uint8_t *buf, size_t *offset, size_t repeat,
                               bool swap)
 {
-    while (repeat-- > 0) {
-        float n = *((float *) (buf + *offset));
-        if (swap)
-            impl_swap_bytes((uint8_t *) &n, sizeof(float));
-        lua_pushnumber(L, n);
-        *offset += sizeof(float);
+    float n[IMPL_CHUNK_SIZE];
+    while (repeat > 0) {
+        size_t count = repeat < IMPL_CHUNK_SIZE ? repeat : IMPL_CHUNK_SIZE;
+        impl_copy_values(n, buf + *offset, count, sizeof(float), swap);
+        size_t i;
+        for (i = 0; i < count; ++i)
+            lua_pushnumber(L, n[i]);
+        *offset += count * sizeof(float);
+        repeat -= count;
     }
 }
 
 static void impl_unpack_double(lua_State *L, const uint8_t *buf, size_t *offset, size_t repeat,
                                bool swap)
 {
-    while (repeat-- > 0) {
-        double n = *((double *) (buf + *offset));
-        if (swap)
-            impl_swap_bytes((uint8_t *) &n, sizeof(double));
-        lua_pushnumber(L, n);
-        *offset += sizeof(double);
+    double n[IMPL_CHUNK_SIZE];
+    while (repeat > 0) {
+        size_t count = repeat < IMPL_CHUNK_SIZE ? repeat : IMPL_CHUNK_SIZE;
+        impl_copy_values(n, buf + *offset, count, sizeof(double), swap);
+        size_t i;
+        for (i = 0; i < count; ++i)
+            lua_pushnumber(L, n[i]);
+        *offset += count * sizeof(double);
+        repeat -= count;
     }
 }
 
@@ -750,78 +865,96 @@ static void impl_pack_int8_t(lua_State *L, uint8_t *buf, size_t *offset, int *st
 static void impl_pack_int16_t(lua_State *L, uint8_t *buf, size_t *offset, int *stack_pos,
                               size_t repeat, bool swap)
 {
-    while (repeat-- > 0) {
-        int16_t n = (int16_t) luaL_checknumber(L, *stack_pos);
-        *((int16_t *) (buf + *offset)) = n;
-        if (swap)
-            impl_swap_bytes(buf + *offset, sizeof(int16_t));
-        *offset += sizeof(int16_t);
-        *stack_pos += 1;
+    int16_t n[IMPL_CHUNK_SIZE];
+    while (repeat > 0) {
+        size_t count = repeat < IMPL_CHUNK_SIZE ? repeat : IMPL_CHUNK_SIZE;
+        size_t i;
+        for (i = 0; i < count; ++i)
+            n[i] = (int16_t) luaL_checknumber(L, *stack_pos + (int) i);
+        impl_copy_values(buf + *offset, n, count, sizeof(int16_t), swap);
+        *offset += count * sizeof(int16_t);
+        *stack_pos += (int) count;
+        repeat -= count;
     }
 }
 
 static void impl_pack_int32_t(lua_State *L, uint8_t *buf, size_t *offset, int *stack_pos,
                               size_t repeat, bool swap)
 {
-    while (repeat-- > 0) {
-        int32_t n = (int32_t) luaL_checknumber(L, *stack_pos);
-        *((int32_t *) (buf + *offset)) = n;
-        if (swap)
-            impl_swap_bytes(buf + *offset, sizeof(int32_t));
-        *offset += sizeof(int32_t);
-        *stack_pos += 1;
+    int32_t n[IMPL_CHUNK_SIZE];
+    while (repeat > 0) {
+        size_t count = repeat < IMPL_CHUNK_SIZE ? repeat : IMPL_CHUNK_SIZE;
+        size_t i;
+        for (i = 0; i < count; ++i)
+            n[i] = (int32_t) luaL_checknumber(L, *stack_pos + (int) i);
+        impl_copy_values(buf + *offset, n, count, sizeof(int32_t), swap);
+        *offset += count * sizeof(int32_t);
+        *stack_pos += (int) count;
+        repeat -= count;
     }
 }
 
 static void impl_pack_uint32_t(lua_State *L, uint8_t *buf, size_t *offset, int *stack_pos,
                                size_t repeat, bool swap)
 {
-    while (repeat-- > 0) {
-        uint32_t n = (uint32_t) luaL_checknumber(L, *stack_pos);
-        *((uint32_t *) (buf + *offset)) = n;
-        if (swap)
-            impl_swap_bytes(buf + *offset, sizeof(uint32_t));
-        *offset += sizeof(uint32_t);
-        *stack_pos += 1;
+    uint32_t n[IMPL_CHUNK_SIZE];
+    while (repeat > 0) {
+        size_t count = repeat < IMPL_CHUNK_SIZE ? repeat : IMPL_CHUNK_SIZE;
+        size_t i;
+        for (i = 0; i < count; ++i)
+            n[i] = (uint32_t) luaL_checknumber(L, *stack_pos + (int) i);
+        impl_copy_values(buf + *offset, n, count, sizeof(uint32_t), swap);
+        *offset += count * sizeof(uint32_t);
+        *stack_pos += (int) count;
+        repeat -= count;
     }
 }
 
 static void impl_pack_int64_t(lua_State *L, uint8_t *buf, size_t *offset, int *stack_pos,
                               size_t repeat, bool swap)
 {
-    while (repeat-- > 0) {
-        int64_t n = (int64_t) luaL_checknumber(L, *stack_pos);
-        *((int64_t *) (buf + *offset)) = n;
-        if (swap)
-            impl_swap_bytes(buf + *offset, sizeof(int64_t));
-        *offset += sizeof(int64_t);
-        *stack_pos += 1;
+    int64_t n[IMPL_CHUNK_SIZE];
+    while (repeat > 0) {
+        size_t count = repeat < IMPL_CHUNK_SIZE ? repeat : IMPL_CHUNK_SIZE;
+        size_t i;
+        for (i = 0; i < count; ++i)
+            n[i] = (int64_t) luaL_checknumber(L, *stack_pos + (int) i);
+        impl_copy_values(buf + *offset, n, count, sizeof(int64_t), swap);
+        *offset += count * sizeof(int64_t);
+        *stack_pos += (int) count;
+        repeat -= count;
     }
 }
 
 static void impl_pack_float(lua_State *L, uint8_t *buf, size_t *offset, int *stack_pos,
                             size_t repeat, bool swap)
 {
-    while (repeat-- > 0) {
-        float n = (float) luaL_checknumber(L, *stack_pos);
-        *((float *) (buf + *offset)) = n;
-        if (swap)
-            impl_swap_bytes(buf + *offset, sizeof(float));
-        *offset += sizeof(float);
-        *stack_pos += 1;
+    float n[IMPL_CHUNK_SIZE];
+    while (repeat > 0) {
+        size_t count = repeat < IMPL_CHUNK_SIZE ? repeat : IMPL_CHUNK_SIZE;
+        size_t i;
+        for (i = 0; i < count; ++i)
+            n[i] = (float) luaL_checknumber(L, *stack_pos + (int) i);
+        impl_copy_values(buf + *offset, n, count, sizeof(float), swap);
+        *offset += count * sizeof(float);
+        *stack_pos += (int) count;
+        repeat -= count;
     }
 }
 
 static void impl_pack_double(lua_State *L, uint8_t *buf, size_t *offset, int *stack_pos,
                              size_t repeat, bool swap)
 {
-    while (repeat-- > 0) {
-        double n = (double) luaL_checknumber(L, *stack_pos);
-        *((double *) (buf + *offset)) = n;
-        if (swap)
-            impl_swap_bytes(buf + *offset, sizeof(double));
-        *offset += sizeof(double);
-        *stack_pos += 1;
+    double n[IMPL_CHUNK_SIZE];
+    while (repeat > 0) {
+        size_t count = repeat < IMPL_CHUNK_SIZE ? repeat : IMPL_CHUNK_SIZE;
+        size_t i;
+        for (i = 0; i < count; ++i)
+            n[i] = (double) luaL_checknumber(L, *stack_pos + (int) i);
+        impl_copy_values(buf + *offset, n, count, sizeof(double), swap);
+        *offset += count * sizeof(double);
+        *stack_pos += (int) count;
+        repeat -= count;
     }
 }
 
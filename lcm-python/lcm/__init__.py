@@ -108,6 +108,35 @@ to next() returning the next L{Event<lcm.Event>} in the log.
         """
         return self.c_eventlog.seek_to_timestamp (timestamp)
 
+    def seek_to_eventnum (self, eventnum):
+        """Seek to the event with a particular event number, or to the first
+        event after it.  Uses the index of the log file, if it has one.
+
+        @param eventnum: Event number of the target event in the log file.
+
+        @return: None
+        @raise ValueError: if there is no such event
+        """
+        return self.c_eventlog.seek_to_eventnum (eventnum)
+
+    def read_channel_event (self, channel, n):
+        """
+        Reads the nth event on a channel, counting from 0.  The next
+        read_next_event() returns the event after it.  The events on the
+        channel before it are found from the index of the log file, or from
+        the last event read on the same channel.
+
+        @param channel: the channel of the event
+        @param n: the number of events on the channel before it
+
+        @return: the L{Event<lcm.Event>}, or None if the channel doesn't
+        have that many events
+        @rtype: L{Event<lcm.Event>}
+        """
+        tup = self.c_eventlog.read_channel_event (channel, n)
+        if not tup: return None
+        return Event (*tup)
+
     def size (self):
         """
         @return: the total size of the log file, in bytes
@@ -174,6 +203,87 @@ to next() returning the next L{Event<lcm.Event>} in the log.
         """
         return self.c_eventlog.ftell ()
 
+def _int_array(data, typecode, dtype):
+    # a NumPy array if NumPy is installed, and an array.array otherwise
+    try:
+        import numpy
+        return numpy.frombuffer(data, dtype)
+    except ImportError:
+        import array
+        result = array.array(typecode)
+        result.frombytes(data)
+        return result
+
+class MappedEventLog(object):
+    """MappedEventLog reads an LCM log file by mapping it into memory, which is
+faster than reading it with an L{EventLog<lcm.EventLog>}.
+
+Iterating over a MappedEventLog yields an (eventnum, timestamp, channel, data)
+tuple for each event in the log file, from the start of the file.  data is a
+read-only memoryview of the message in the mapping, rather than a copy of it.
+The log file can't be closed while any of these memoryviews exist.
+
+@undocumented: __iter__
+    """
+    def __init__ (self, path:PathArgument, channels = None):
+        """
+        Initializer
+
+        @param path:  Path to the logfile to open
+        @param channels:  If not None, the channels to read.  Events on other
+        channels are skipped without reading their data.
+        """
+        if isinstance(path, PathLike):
+            path = str(path)
+
+        self.c_log = _lcm.MappedEventLog (path, channels)
+
+    @property
+    def channels (self):
+        """
+        The channels of the events read so far, whose indices are the channel
+        ids returned by scan().
+
+        @rtype: list
+        """
+        return self.c_log.channels
+
+    def __iter__ (self):
+        return iter (self.c_log)
+
+    def read_event (self, offset):
+        """
+        @param offset: byte offset from start of log
+
+        @return: the (eventnum, timestamp, channel, data) tuple of the first
+        event at or after offset, or None if there isn't one.
+        """
+        return self.c_log.read_event (offset)
+
+    def scan (self):
+        """
+        Reads the timestamp, channel and offset of every event in the log
+        file, without reading the data.
+
+        @return: a (timestamps, channel_ids, offsets) tuple of arrays with an
+        element for each event.  The channel of an event is
+        channels[channel_ids[i]], and its offset can be passed to
+        read_event().  The arrays are NumPy arrays if NumPy is installed, and
+        array.array objects otherwise.
+        """
+        timestamps, channel_ids, offsets = self.c_log.scan ()
+        return (_int_array (timestamps, 'q', 'int64'),
+                _int_array (channel_ids, 'i', 'int32'),
+                _int_array (offsets, 'q', 'int64'))
+
+    def close (self):
+        """
+        Closes the log file.
+
+        @return: None
+        """
+        return self.c_log.close ()
+
 LCM_BIN_DIR = os.path.join(os.path.dirname(__file__), '..', 'bin')
 
 def run_script(name: str, args) -> int:
@@ -1,15 +1,25 @@
 from os import PathLike
-from typing import Callable
+from typing import Any, Callable, Iterable, Iterator, Literal, overload
 
 class LCM:
     def __init__(self, provider: str | None = None) -> None: ...
     def fileno(self) -> int: ...
     def handle(self) -> None: ...
     def handle_timeout(self, timeout_millis: int) -> int: ...
+    def handle_batch(self, max_msgs: int, timeout_millis: int = -1) -> int: ...
     def publish(self, channel: str, data: bytes) -> None: ...
+    @overload
     def subscribe(
         self, channel: str, callback: Callable[[str, bytes], None]
     ) -> LCMSubscription: ...
+    @overload
+    def subscribe(
+        self, channel: str, callback: Callable[[str, bytes], None], memoryview: Literal[False]
+    ) -> LCMSubscription: ...
+    @overload
+    def subscribe(
+        self, channel: str, callback: Callable[[str, memoryview], None], memoryview: bool
+    ) -> LCMSubscription: ...
     def unsubscribe(self, subscription_object: LCMSubscription) -> None: ...
 
 class LCMSubscription:
@@ -35,10 +45,22 @@ class EventLog:
     def read_next_event(self) -> Event: ...
     def seek(self, filepos: int) -> None: ...
     def seek_to_timestamp(self, timestamp: int) -> None: ...
+    def seek_to_eventnum(self, eventnum: int) -> None: ...
+    def read_channel_event(self, channel: str, n: int) -> Event | None: ...
     def size(self) -> int: ...
     def tell(self) -> int: ...
     def write_event(self, utime: int, channel: str, data: bytes) -> None: ...
 
+class MappedEventLog:
+    channels: list[str]
+    def __init__(
+        self, path: str | PathLike[str], channels: Iterable[str] | None = None
+    ) -> None: ...
+    def __iter__(self) -> Iterator[tuple[int, int, str, memoryview]]: ...
+    def read_event(self, offset: int) -> tuple[int, int, str, memoryview] | None: ...
+    def scan(self) -> tuple[Any, Any, Any]: ...
+    def close(self) -> None: ...
+
 LCM_BIN_DIR: str = ...
 
 def run_script(name: str, args: list[str]) -> int: ...
@@ -16,6 +16,7 @@
 #endif
 
 extern PyTypeObject pylcmeventlog_type;
+extern PyTypeObject pymappedlog_type;
 extern PyTypeObject pylcm_type;
 extern PyTypeObject pylcm_subscription_type;
 
@@ -50,6 +51,7 @@ init_lcm(void)
     PyObject *m;
 
     Py_SET_TYPE(&pylcmeventlog_type, &PyType_Type);
+    Py_SET_TYPE(&pymappedlog_type, &PyType_Type);
     Py_SET_TYPE(&pylcm_type, &PyType_Type);
     Py_SET_TYPE(&pylcm_subscription_type, &PyType_Type);
 
@@ -64,6 +66,15 @@ init_lcm(void)
 #endif
     }
 
+    Py_INCREF(&pymappedlog_type);
+    if (PyModule_AddObject(m, "MappedEventLog", (PyObject *) &pymappedlog_type) != 0) {
+#if PY_MAJOR_VERSION >= 3
+        return NULL;  // in python 3 return NULL on error
+#else
+        return;
+#endif
+    }
+
     Py_INCREF(&pylcm_type);
     if (PyModule_AddObject(m, "LCM", (PyObject *) &pylcm_type) != 0) {
 #if PY_MAJOR_VERSION >= 3
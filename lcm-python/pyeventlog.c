@@ -22,6 +22,12 @@ typedef struct {
 
         lcm_eventlog_t *eventlog;
     char mode;
+    // every event is read into this one
+    lcm_eventlog_event_t event;
+    size_t event_capacity;
+    // the cursor of the last read_channel_event(), or NULL, and its channel
+    lcm_eventlog_cursor_t *cursor;
+    char *cursor_channel;
 } PyLogObject;
 
 PyDoc_STRVAR(pylog_doc,
@@ -32,8 +38,19 @@ Event Log parser\n\
 // gives redefinition error in MSVC
 // PyTypeObject pylcmeventlog_type;
 
+static void pylog_free_cursor(PyLogObject *self)
+{
+    if (self->cursor) {
+        lcm_eventlog_cursor_destroy(self->cursor);
+        free(self->cursor_channel);
+        self->cursor = NULL;
+        self->cursor_channel = NULL;
+    }
+}
+
 static PyObject *pylog_close(PyLogObject *self)
 {
+    pylog_free_cursor(self);
     if (self->eventlog) {
         lcm_eventlog_destroy(self->eventlog);
         self->eventlog = NULL;
@@ -54,8 +71,8 @@ static PyObject *pylog_read_next_event(PyLogObject *self)
         return NULL;
     }
 
-    lcm_eventlog_event_t *next_event = lcm_eventlog_read_next_event(self->eventlog);
-    if (!next_event) {
+    lcm_eventlog_event_t *next_event = &self->event;
+    if (lcm_eventlog_read_next_event_into(self->eventlog, next_event, &self->event_capacity) < 0) {
         Py_INCREF(Py_None);
         return Py_None;
     }
@@ -70,7 +87,6 @@ static PyObject *pylog_read_next_event(PyLogObject *self)
     PyObject *result = Py_BuildValue("LLs#s#", next_event->eventnum, next_event->timestamp,
                                      next_event->channel, channellen, next_event->data, datalen);
 #endif
-    lcm_eventlog_free_event(next_event);
 
     return result;
 }
@@ -122,6 +138,75 @@ static PyObject *pylog_seek_to_timestamp(PyLogObject *self, PyObject *arg)
     }
 }
 
+static PyObject *pylog_seek_to_eventnum(PyLogObject *self, PyObject *arg)
+{
+    int64_t eventnum = PyLong_AsLongLong(arg);
+    if (PyErr_Occurred())
+        return 0;
+
+    if (!self->eventlog) {
+        PyErr_SetString(PyExc_ValueError, "event log already closed");
+        return NULL;
+    }
+
+    if (self->mode != 'r') {
+        PyErr_SetString(PyExc_RuntimeError, "seeking not allowed in write mode");
+        return NULL;
+    }
+
+    if (0 != lcm_eventlog_seek_to_eventnum(self->eventlog, eventnum)) {
+        PyErr_SetString(PyExc_ValueError, "no such event");
+        return NULL;
+    }
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static PyObject *pylog_read_channel_event(PyLogObject *self, PyObject *args)
+{
+    char *channel = NULL;
+    int64_t n = 0;
+    if (!PyArg_ParseTuple(args, "sL", &channel, &n))
+        return NULL;
+
+    if (!self->eventlog) {
+        PyErr_SetString(PyExc_ValueError, "event log already closed");
+        return NULL;
+    }
+
+    if (self->mode != 'r') {
+        PyErr_SetString(PyExc_RuntimeError, "reading not allowed in write mode");
+        return NULL;
+    }
+
+    // the cursor is kept for the next event on the same channel
+    if (self->cursor && strcmp(self->cursor_channel, channel))
+        pylog_free_cursor(self);
+    if (!self->cursor) {
+        self->cursor = lcm_eventlog_cursor_create(self->eventlog, channel);
+        self->cursor_channel = strdup(channel);
+    }
+    lcm_eventlog_event_t *le = NULL;
+    if (0 == lcm_eventlog_cursor_seek(self->cursor, n))
+        le = lcm_eventlog_cursor_next(self->cursor);
+    if (!le) {
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    Py_ssize_t channellen = le->channellen;
+    Py_ssize_t datalen = le->datalen;
+#if PY_MAJOR_VERSION >= 3
+    PyObject *result = Py_BuildValue("LLs#y#", le->eventnum, le->timestamp, le->channel,
+                                     channellen, le->data, datalen);
+#else
+    PyObject *result = Py_BuildValue("LLs#s#", le->eventnum, le->timestamp, le->channel,
+                                     channellen, le->data, datalen);
+#endif
+    lcm_eventlog_free_event(le);
+    return result;
+}
+
 static PyObject *pylog_write_next_event(PyLogObject *self, PyObject *args)
 {
     int64_t utime = 0;
@@ -182,6 +267,8 @@ static PyMethodDef pylog_methods[] = {
     {"close", (PyCFunction) pylog_close, METH_NOARGS, ""},
     {"seek", (PyCFunction) pylog_seek, METH_O, ""},
     {"seek_to_timestamp", (PyCFunction) pylog_seek_to_timestamp, METH_O, ""},
+    {"seek_to_eventnum", (PyCFunction) pylog_seek_to_eventnum, METH_O, ""},
+    {"read_channel_event", (PyCFunction) pylog_read_channel_event, METH_VARARGS, ""},
     {"read_next_event", (PyCFunction) pylog_read_next_event, METH_NOARGS, ""},
     {"write_event", (PyCFunction) pylog_write_next_event, METH_VARARGS, ""},
     {"size", (PyCFunction) pylog_size, METH_NOARGS, ""},
@@ -207,15 +294,21 @@ static PyObject *pylog_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
     if (newobj != NULL) {
         ((PyLogObject *) newobj)->eventlog = NULL;
         ((PyLogObject *) newobj)->mode = 0;
+        memset(&((PyLogObject *) newobj)->event, 0, sizeof(lcm_eventlog_event_t));
+        ((PyLogObject *) newobj)->event_capacity = 0;
+        ((PyLogObject *) newobj)->cursor = NULL;
+        ((PyLogObject *) newobj)->cursor_channel = NULL;
     }
     return newobj;
 }
 
 static void pylog_dealloc(PyLogObject *self)
 {
+    pylog_free_cursor(self);
     if (self->eventlog) {
         lcm_eventlog_destroy(self->eventlog);
     }
+    free(self->event.channel);
     Py_TYPE(self)->tp_free((PyObject *) self);
 }
 
@@ -238,6 +331,7 @@ static int pylog_initobj(PyObject *s, PyObject *args, PyObject *kwds)
         return -1;
     }
 
+    pylog_free_cursor(self);
     if (self->eventlog) {
         lcm_eventlog_destroy(self->eventlog);
     }
@@ -102,16 +102,60 @@ static void pylcm_msg_handler(const lcm_recv_buf_t *rbuf, const char *channel, v
         return;
     }
 
+    // messages usually keep arriving on the same channel, so the channel
+    // string from the last one is reused if it matches
 #if PY_MAJOR_VERSION >= 3
-    PyObject *arglist = Py_BuildValue("sy#", channel,  // build from bytes
-                                      rbuf->data, rbuf->data_size);
+    if (!subs_obj->channel || strcmp(PyUnicode_AsUTF8(subs_obj->channel), channel)) {
+        Py_XDECREF(subs_obj->channel);
+        subs_obj->channel = PyUnicode_InternFromString(channel);
+    }
+#else
+    if (!subs_obj->channel || strcmp(PyString_AS_STRING(subs_obj->channel), channel)) {
+        Py_XDECREF(subs_obj->channel);
+        subs_obj->channel = PyString_InternFromString(channel);
+    }
+#endif
+    if (!subs_obj->channel) {
+        subs_obj->lcm_obj->exception_raised = 1;
+        return;
+    }
+
+    PyObject *data;
+#if PY_MAJOR_VERSION >= 3
+    if (subs_obj->memoryview)
+        data = PyMemoryView_FromMemory((char *) rbuf->data, rbuf->data_size, PyBUF_READ);
+    else
+        data = PyBytes_FromStringAndSize((const char *) rbuf->data, rbuf->data_size);
 #else
-    PyObject *arglist = Py_BuildValue("ss#", channel,  // build from string
-                                      rbuf->data, rbuf->data_size);
+    data = PyString_FromStringAndSize((const char *) rbuf->data, rbuf->data_size);
 #endif
+    if (!data) {
+        subs_obj->lcm_obj->exception_raised = 1;
+        return;
+    }
+
+    PyObject *result =
+        PyObject_CallFunctionObjArgs(subs_obj->handler, subs_obj->channel, data, NULL);
 
-    PyObject *result = PyObject_CallObject(subs_obj->handler, arglist);
-    Py_DECREF(arglist);
+#if PY_MAJOR_VERSION >= 3
+    // the received data is only valid during the callback, so the view is
+    // released, and any use of it afterwards raises ValueError.  This fails
+    // with BufferError if the handler still holds an export of the view.
+    if (subs_obj->memoryview) {
+        PyObject *type, *value, *traceback;
+        PyErr_Fetch(&type, &value, &traceback);
+        PyObject *released = PyObject_CallMethod(data, "release", NULL);
+        Py_XDECREF(released);
+        if (type) {
+            // an exception raised by the handler takes precedence
+            PyErr_Restore(type, value, traceback);
+        } else if (!released) {
+            Py_XDECREF(result);
+            result = NULL;
+        }
+    }
+#endif
+    Py_DECREF(data);
 
     if (!result) {
         subs_obj->lcm_obj->exception_raised = 1;
@@ -122,12 +166,15 @@ static void pylcm_msg_handler(const lcm_recv_buf_t *rbuf, const char *channel, v
 
 // =============== LCM class methods ==============
 
-static PyObject *pylcm_subscribe(PyLCMObject *lcm_obj, PyObject *args)
+static PyObject *pylcm_subscribe(PyLCMObject *lcm_obj, PyObject *args, PyObject *kwargs)
 {
+    static char *keywords[] = {"channel", "callback", "memoryview", NULL};
     char *channel = NULL;
     Py_ssize_t chan_len = 0;
     PyObject *handler = NULL;
-    if (!PyArg_ParseTuple(args, "s#O", &channel, &chan_len, &handler))
+    PyObject *memoryview = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s#O|O", keywords, &channel, &chan_len,
+                                     &handler, &memoryview))
         return NULL;
 
     if (!channel || !chan_len) {
@@ -138,6 +185,12 @@ static PyObject *pylcm_subscribe(PyLCMObject *lcm_obj, PyObject *args)
         PyErr_SetString(PyExc_ValueError, "handler is not callable");
         return NULL;
     }
+#if PY_MAJOR_VERSION < 3
+    if (memoryview && PyObject_IsTrue(memoryview)) {
+        PyErr_SetString(PyExc_ValueError, "memoryview requires Python 3");
+        return NULL;
+    }
+#endif
 
     PyLCMSubscriptionObject *subs_obj =
         (PyLCMSubscriptionObject *) PyType_GenericNew(&pylcm_subscription_type, NULL, NULL);
@@ -153,6 +206,7 @@ static PyObject *pylcm_subscribe(PyLCMObject *lcm_obj, PyObject *args)
     subs_obj->handler = handler;
     Py_INCREF(handler);
     subs_obj->lcm_obj = lcm_obj;
+    subs_obj->memoryview = memoryview && PyObject_IsTrue(memoryview);
 
     PyList_Append(lcm_obj->all_handlers, (PyObject *) subs_obj);
 
@@ -161,7 +215,7 @@ static PyObject *pylcm_subscribe(PyLCMObject *lcm_obj, PyObject *args)
 
 PyDoc_STRVAR(pylcm_subscribe_doc,
              "\
-subscribe(channel, callback) -> L{LCMSubscription<lcm.LCMSubscription>}\n\
+subscribe(channel, callback, memoryview=False) -> L{LCMSubscription<lcm.LCMSubscription>}\n\
 Registers a callback function to handle messages received on the specified\n\
 channel.\n\
 \n\
@@ -173,6 +227,11 @@ expression.  Implicitly treated as the regex \"^channel$\"\n\
 When a message is received, callback is invoked with two arguments\n\
 corresponding to the actual channel on which the message was received, and \n\
 a binary string containing the raw message bytes.\n\
+@param memoryview: If true, callback is passed a read-only memoryview of the\n\
+received message instead of a copy of it.  The memoryview is only valid\n\
+until callback returns, after which it is released, so callback must not\n\
+keep it or any slice of it, and must copy anything it keeps, e.g. with\n\
+bytes(data) or data.tobytes().  Requires Python 3.\n\
 ");
 
 static PyObject *pylcm_unsubscribe(PyLCMObject *lcm_obj, PyObject *args)
@@ -254,6 +313,69 @@ Publishes a message to an LCM network\n\
 @param data: binary string containing the message to publish\n\
 ");
 
+static PyObject *pylcm_handle_batch(PyLCMObject *lcm_obj, PyObject *args)
+{
+    int max_msgs = 0;
+    int timeout_millis = -1;
+    if (!PyArg_ParseTuple(args, "i|i", &max_msgs, &timeout_millis))
+        return NULL;
+    if (max_msgs <= 0) {
+        PyErr_SetString(PyExc_ValueError, "invalid max_msgs");
+        return NULL;
+    }
+
+    dbg(DBG_PYTHON, "pylcm_handle_batch(%p, %d, %d)\n", lcm_obj, max_msgs, timeout_millis);
+
+    if (lcm_obj->saved_thread_state) {
+        PyErr_SetString(PyExc_RuntimeError,
+                        "Simultaneous calls to handle() / handle_timeout() detected");
+        return NULL;
+    }
+    lcm_obj->saved_thread_state = PyEval_SaveThread();
+    lcm_obj->exception_raised = 0;
+
+    // The first callback reacquires the GIL, which is then held while the
+    // rest of the batch is dispatched.
+    int status = lcm_handle_batch(lcm_obj->lcm, max_msgs, timeout_millis);
+
+    if (lcm_obj->saved_thread_state) {
+        PyEval_RestoreThread(lcm_obj->saved_thread_state);
+        lcm_obj->saved_thread_state = NULL;
+    }
+
+    if (lcm_obj->exception_raised) {
+        return NULL;
+    }
+    if (status < 0) {
+        PyErr_SetString(PyExc_IOError, "lcm_handle_batch() returned -1");
+        return NULL;
+    }
+    return PyInt_FromLong(status);
+}
+PyDoc_STRVAR(pylcm_handle_batch_doc,
+             "\
+handle_batch(max_msgs, timeout_millis=-1) -> int\n\
+waits for the next incoming message, then dispatches it along with the\n\
+messages that have already been received, up to max_msgs in total.\n\
+\n\
+The GIL is released only while waiting, and is held while the whole batch is\n\
+dispatched, which makes this cheaper than calling handle() once per message.\n\
+If a callback raises an exception, the rest of the batch is discarded and the\n\
+exception is raised from handle_batch().\n\
+\n\
+With a timeout of 0, this can be called from an event loop when fileno() is\n\
+readable, e.g.::\n\
+\n\
+   loop.add_reader(m.fileno(), m.handle_batch, 100, 0)\n\
+\n\
+Raises ValueError if max_msgs is invalid, or IOError if another error occurs.\n\
+\n\
+@param max_msgs: the maximum number of messages to dispatch.\n\
+@param timeout_millis: the amount of time to wait for the first message, in\n\
+milliseconds.  If negative, waits indefinitely.\n\
+@return the number of messages handled, or 0 if the function timed out.\n\
+");
+
 static PyObject *pylcm_fileno(PyLCMObject *lcm_obj)
 {
     dbg(DBG_PYTHON, "%s %p\n", __FUNCTION__, lcm_obj);
@@ -362,7 +484,9 @@ error occurs.\n\
 static PyMethodDef pylcm_methods[] = {
     {"handle", (PyCFunction) pylcm_handle, METH_NOARGS, pylcm_handle_doc},
     {"handle_timeout", (PyCFunction) pylcm_handle_timeout, METH_O, pylcm_handle_timeout_doc},
-    {"subscribe", (PyCFunction) pylcm_subscribe, METH_VARARGS, pylcm_subscribe_doc},
+    {"handle_batch", (PyCFunction) pylcm_handle_batch, METH_VARARGS, pylcm_handle_batch_doc},
+    {"subscribe", (PyCFunction) pylcm_subscribe, METH_VARARGS | METH_KEYWORDS,
+     pylcm_subscribe_doc},
     {"unsubscribe", (PyCFunction) pylcm_unsubscribe, METH_VARARGS, pylcm_unsubscribe_doc},
     {"publish", (PyCFunction) pylcm_publish, METH_VARARGS, pylcm_publish_doc},
     {"fileno", (PyCFunction) pylcm_fileno, METH_NOARGS, pylcm_fileno_doc},
@@ -72,6 +72,8 @@ static void _dealloc(PyLCMSubscriptionObject *s)
         Py_DECREF(s->handler);
         s->handler = NULL;
     }
+    Py_XDECREF(s->channel);
+    s->channel = NULL;
     // ignore s->subscription and s->lcm_obj
     Py_TYPE(s)->tp_free((PyObject *) s);
 }
@@ -88,6 +90,8 @@ static int _init(PyObject *self, PyObject *args, PyObject *kwargs)
     s->subscription = NULL;
     s->handler = NULL;
     s->lcm_obj = NULL;
+    s->memoryview = 0;
+    s->channel = NULL;
     return 0;
 }
 
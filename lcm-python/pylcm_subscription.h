@@ -17,6 +17,13 @@ typedef struct {
 
     PyObject *handler;
     PyLCMObject *lcm_obj;
+
+    // if set, the handler is passed a read-only memoryview of the received
+    // data, which is released when the handler returns, instead of a copy
+    int memoryview;
+    // the interned channel of the last message received, which is passed to
+    // the handler again while messages keep arriving on the same channel
+    PyObject *channel;
 } PyLCMSubscriptionObject;
 
 extern PyTypeObject pylcm_subscription_type;
@@ -0,0 +1,420 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <lcm/eventlog.h>
+
+// to support python 2.5 and earlier
+#ifndef Py_TYPE
+#define Py_TYPE(ob) (((PyObject *) (ob))->ob_type)
+#endif
+
+#if PY_MAJOR_VERSION >= 3
+#define PyInt_FromLong PyLong_FromLong
+#define PyString_FromStringAndSize PyUnicode_FromStringAndSize
+#define PyString_AsString PyUnicode_AsUTF8
+#define BUFFER_FLAGS 0
+#define BYTES_FORMAT "y#"
+#else
+#define BYTES_FORMAT "s#"
+#define BUFFER_FLAGS Py_TPFLAGS_HAVE_NEWBUFFER
+#endif
+
+typedef struct {
+    PyObject_HEAD
+
+        lcm_eventlog_mmap_t *log;
+    // the event that iteration has read up to
+    lcm_eventlog_view_t view;
+    // the number of memoryviews of event data, which keep the mapping open
+    Py_ssize_t exports;
+    // the data of the event that a new memoryview is of
+    const void *export_data;
+    Py_ssize_t export_len;
+
+    // the channels seen so far, as a list whose indices are the channel ids,
+    // and a dict from each channel to its id
+    PyObject *channels;
+    PyObject *channel_ids;
+    // the channels to read, or NULL to read all of them, and whether each
+    // channel seen so far is one of them, indexed by channel id
+    PyObject *filter;
+    char *wanted;
+    // the id of the last channel seen, since events on the same channel
+    // usually come together, or -1
+    int last_id;
+} PyMappedLogObject;
+
+PyDoc_STRVAR(pymappedlog_doc,
+             "\
+Event log file reader that maps the file into memory\n\
+");
+
+// Returns the id of the channel of the view, adding it to the channels seen
+// so far if necessary, or -1 on error.
+static int get_channel_id(PyMappedLogObject *self, const lcm_eventlog_view_t *view)
+{
+    if (self->last_id >= 0) {
+        PyObject *last = PyList_GET_ITEM(self->channels, self->last_id);
+        const char *name = PyString_AsString(last);
+        if (name && (int32_t) strlen(name) == view->channellen &&
+            !memcmp(name, view->channel, view->channellen))
+            return self->last_id;
+    }
+
+    PyObject *channel = PyString_FromStringAndSize(view->channel, view->channellen);
+    if (!channel)
+        return -1;
+    PyObject *id_obj = PyDict_GetItem(self->channel_ids, channel);
+    if (id_obj) {
+        Py_DECREF(channel);
+        self->last_id = (int) PyLong_AsLong(id_obj);
+        return self->last_id;
+    }
+
+    int id = (int) PyList_GET_SIZE(self->channels);
+    int wanted = 1;
+    if (self->filter) {
+        wanted = PySequence_Contains(self->filter, channel);
+        if (wanted < 0) {
+            Py_DECREF(channel);
+            return -1;
+        }
+    }
+    char *new_wanted = (char *) realloc(self->wanted, id + 1);
+    if (!new_wanted) {
+        Py_DECREF(channel);
+        PyErr_NoMemory();
+        return -1;
+    }
+    self->wanted = new_wanted;
+    self->wanted[id] = (char) wanted;
+
+    id_obj = PyInt_FromLong(id);
+    int status = id_obj ? PyDict_SetItem(self->channel_ids, channel, id_obj) : -1;
+    Py_XDECREF(id_obj);
+    if (status == 0)
+        status = PyList_Append(self->channels, channel);
+    Py_DECREF(channel);
+    if (status != 0)
+        return -1;
+    self->last_id = id;
+    return id;
+}
+
+// Reads the next event on a wanted channel after the view into it, returning
+// its channel id, or -1 at the end of the log file, or -2 on error.
+static int next_event(PyMappedLogObject *self, lcm_eventlog_view_t *view)
+{
+    while (0 == lcm_eventlog_next_view(self->log, view)) {
+        int id = get_channel_id(self, view);
+        if (id < 0)
+            return -2;
+        if (self->wanted[id])
+            return id;
+    }
+    return -1;
+}
+
+static int check_open(PyMappedLogObject *self)
+{
+    if (!self->log) {
+        PyErr_SetString(PyExc_ValueError, "event log already closed");
+        return -1;
+    }
+    return 0;
+}
+
+// Builds the (eventnum, timestamp, channel, data) tuple of the view, with a
+// memoryview of its data.
+static PyObject *build_event(PyMappedLogObject *self, const lcm_eventlog_view_t *view, int id)
+{
+    self->export_data = view->data;
+    self->export_len = view->datalen;
+    PyObject *data = PyMemoryView_FromObject((PyObject *) self);
+    if (!data)
+        return NULL;
+    PyObject *channel = PyList_GET_ITEM(self->channels, id);
+    PyObject *result = Py_BuildValue("LLON", (long long) view->eventnum,
+                                     (long long) view->timestamp, channel, data);
+    return result;
+}
+
+static PyObject *pymappedlog_close(PyMappedLogObject *self)
+{
+    if (self->exports > 0) {
+        PyErr_SetString(PyExc_BufferError, "cannot close a log with event data still in use");
+        return NULL;
+    }
+    if (self->log) {
+        lcm_eventlog_mmap_close(self->log);
+        self->log = NULL;
+    }
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static PyObject *pymappedlog_iter(PyMappedLogObject *self)
+{
+    if (check_open(self) < 0)
+        return NULL;
+    memset(&self->view, 0, sizeof(self->view));
+    Py_INCREF(self);
+    return (PyObject *) self;
+}
+
+static PyObject *pymappedlog_iternext(PyMappedLogObject *self)
+{
+    if (check_open(self) < 0)
+        return NULL;
+    int id = next_event(self, &self->view);
+    if (id < 0) {
+        // stay at the end of the log file
+        self->view.offset = -1;
+        return NULL;
+    }
+    return build_event(self, &self->view, id);
+}
+
+static PyObject *pymappedlog_read_event(PyMappedLogObject *self, PyObject *arg)
+{
+    long long offset = PyLong_AsLongLong(arg);
+    if (offset == -1 && PyErr_Occurred())
+        return NULL;
+    if (check_open(self) < 0)
+        return NULL;
+
+    lcm_eventlog_view_t view;
+    if (0 != lcm_eventlog_find_view(self->log, offset, &view)) {
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+    int id = get_channel_id(self, &view);
+    if (id < 0)
+        return NULL;
+    return build_event(self, &view, id);
+}
+
+// The arrays built up by scan(), of the events read so far
+typedef struct {
+    int64_t *timestamps;
+    int32_t *channel_ids;
+    int64_t *offsets;
+    size_t len;
+    size_t capacity;
+} scan_arrays_t;
+
+static int scan_append(scan_arrays_t *arrays, const lcm_eventlog_view_t *view, int id)
+{
+    if (arrays->len == arrays->capacity) {
+        size_t capacity = arrays->capacity ? 2 * arrays->capacity : 4096;
+        int64_t *timestamps = (int64_t *) realloc(arrays->timestamps, capacity * 8);
+        if (timestamps)
+            arrays->timestamps = timestamps;
+        int32_t *channel_ids = (int32_t *) realloc(arrays->channel_ids, capacity * 4);
+        if (channel_ids)
+            arrays->channel_ids = channel_ids;
+        int64_t *offsets = (int64_t *) realloc(arrays->offsets, capacity * 8);
+        if (offsets)
+            arrays->offsets = offsets;
+        if (!timestamps || !channel_ids || !offsets)
+            return -1;
+        arrays->capacity = capacity;
+    }
+    arrays->timestamps[arrays->len] = view->timestamp;
+    arrays->channel_ids[arrays->len] = id;
+    arrays->offsets[arrays->len] = view->offset;
+    arrays->len++;
+    return 0;
+}
+
+static PyObject *pymappedlog_scan(PyMappedLogObject *self)
+{
+    if (check_open(self) < 0)
+        return NULL;
+
+    scan_arrays_t arrays;
+    memset(&arrays, 0, sizeof(arrays));
+    lcm_eventlog_view_t view;
+    memset(&view, 0, sizeof(view));
+    int id;
+    while ((id = next_event(self, &view)) >= 0) {
+        if (0 != scan_append(&arrays, &view, id)) {
+            PyErr_NoMemory();
+            break;
+        }
+    }
+
+    PyObject *result = NULL;
+    if (!PyErr_Occurred()) {
+        // the arrays are returned as bytes of native integers, which the
+        // caller wraps in arrays
+        result = Py_BuildValue(BYTES_FORMAT BYTES_FORMAT BYTES_FORMAT,
+                               (const char *) arrays.timestamps,
+                               (Py_ssize_t) arrays.len * 8, (const char *) arrays.channel_ids,
+                               (Py_ssize_t) arrays.len * 4, (const char *) arrays.offsets,
+                               (Py_ssize_t) arrays.len * 8);
+    }
+    free(arrays.timestamps);
+    free(arrays.channel_ids);
+    free(arrays.offsets);
+    return result;
+}
+
+static PyObject *pymappedlog_get_channels(PyMappedLogObject *self, void *closure)
+{
+    Py_INCREF(self->channels);
+    return self->channels;
+}
+
+static PyMethodDef pymappedlog_methods[] = {
+    {"close", (PyCFunction) pymappedlog_close, METH_NOARGS, ""},
+    {"read_event", (PyCFunction) pymappedlog_read_event, METH_O, ""},
+    {"scan", (PyCFunction) pymappedlog_scan, METH_NOARGS, ""},
+    {NULL, NULL}, /* sentinel */
+};
+
+static PyGetSetDef pymappedlog_getset[] = {
+    {"channels", (getter) pymappedlog_get_channels, NULL, "", NULL},
+    {NULL}, /* sentinel */
+};
+
+// ==================== buffer protocol ====================
+
+// Each memoryview of event data is a view of this object, whose buffer is the
+// data of the event being returned.
+static int pymappedlog_getbuffer(PyMappedLogObject *self, Py_buffer *view, int flags)
+{
+    if (!self->export_data) {
+        PyErr_SetString(PyExc_BufferError, "no event data to export");
+        return -1;
+    }
+    if (PyBuffer_FillInfo(view, (PyObject *) self, (void *) self->export_data,
+                          self->export_len, 1, flags) < 0)
+        return -1;
+    self->exports++;
+    return 0;
+}
+
+static void pymappedlog_releasebuffer(PyMappedLogObject *self, Py_buffer *view)
+{
+    self->exports--;
+}
+
+static PyBufferProcs pymappedlog_as_buffer = {
+#if PY_MAJOR_VERSION < 3
+    0, 0, 0, 0,
+#endif
+    (getbufferproc) pymappedlog_getbuffer,
+    (releasebufferproc) pymappedlog_releasebuffer,
+};
+
+// ==================== class administrative methods ====================
+
+static PyObject *pymappedlog_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    PyObject *newobj = type->tp_alloc(type, 0);
+    if (newobj != NULL) {
+        PyMappedLogObject *self = (PyMappedLogObject *) newobj;
+        self->log = NULL;
+        self->exports = 0;
+        self->export_data = NULL;
+        self->channels = PyList_New(0);
+        self->channel_ids = PyDict_New();
+        self->filter = NULL;
+        self->wanted = NULL;
+        self->last_id = -1;
+        if (!self->channels || !self->channel_ids) {
+            Py_DECREF(newobj);
+            return NULL;
+        }
+    }
+    return newobj;
+}
+
+static void pymappedlog_dealloc(PyMappedLogObject *self)
+{
+    if (self->log) {
+        lcm_eventlog_mmap_close(self->log);
+    }
+    Py_XDECREF(self->channels);
+    Py_XDECREF(self->channel_ids);
+    Py_XDECREF(self->filter);
+    free(self->wanted);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static int pymappedlog_initobj(PyObject *s, PyObject *args, PyObject *kwds)
+{
+    PyMappedLogObject *self = (PyMappedLogObject *) s;
+    static char *keywords[] = {"filename", "channels", 0};
+    char *filename = NULL;
+    PyObject *channels = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|O", keywords, &filename, &channels))
+        return -1;
+
+    if (self->log) {
+        PyErr_SetString(PyExc_RuntimeError, "event log already opened");
+        return -1;
+    }
+    if (channels != Py_None) {
+        self->filter = PyFrozenSet_New(channels);
+        if (!self->filter)
+            return -1;
+    }
+
+    self->log = lcm_eventlog_mmap_open(filename);
+    if (!self->log) {
+        PyErr_SetFromErrno(PyExc_IOError);
+        return -1;
+    }
+    memset(&self->view, 0, sizeof(self->view));
+    return 0;
+}
+
+/* Type object */
+PyTypeObject pymappedlog_type = {
+#if PY_MAJOR_VERSION >= 3
+    PyVarObject_HEAD_INIT(0, 0) /* size is now part of macro */
+#else
+    PyObject_HEAD_INIT(0) /* Must fill in type value later */
+    0,                    /* ob_size */
+#endif
+    "MappedEventLog",                                        /* tp_name */
+    sizeof(PyMappedLogObject),                               /* tp_basicsize */
+    0,                                                       /* tp_itemsize */
+    (destructor) pymappedlog_dealloc,                        /* tp_dealloc */
+    0,                                                       /* tp_print */
+    0,                                                       /* tp_getattr */
+    0,                                                       /* tp_setattr */
+    0,                                                       /* tp_compare */
+    0,                                                       /* tp_repr */
+    0,                                                       /* tp_as_number */
+    0,                                                       /* tp_as_sequence */
+    0,                                                       /* tp_as_mapping */
+    0,                                                       /* tp_hash */
+    0,                                                       /* tp_call */
+    0,                                                       /* tp_str */
+    PyObject_GenericGetAttr,                                 /* tp_getattro */
+    0,                                                       /* tp_setattro */
+    &pymappedlog_as_buffer,                                  /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | BUFFER_FLAGS, /* tp_flags */
+    pymappedlog_doc,                                         /* tp_doc */
+    0,                                                       /* tp_traverse */
+    0,                                                       /* tp_clear */
+    0,                                                       /* tp_richcompare */
+    0,                                                       /* tp_weaklistoffset */
+    (getiterfunc) pymappedlog_iter,                          /* tp_iter */
+    (iternextfunc) pymappedlog_iternext,                     /* tp_iternext */
+    pymappedlog_methods,                                     /* tp_methods */
+    0,                                                       /* tp_members */
+    pymappedlog_getset,                                      /* tp_getset */
+    0,                                                       /* tp_base */
+    0,                                                       /* tp_dict */
+    0,                                                       /* tp_descr_get */
+    0,                                                       /* tp_descr_set */
+    0,                                                       /* tp_dictoffset */
+    pymappedlog_initobj,                                     /* tp_init */
+    PyType_GenericAlloc,                                     /* tp_alloc */
+    pymappedlog_new,                                         /* tp_new */
+    PyObject_Del,                                            /* tp_free */
+};
@@ -0,0 +1,270 @@
+#include "dispatcher.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "lcm_internal.h"
+
+// Each thread has a queue of its own.  It takes tasks from the front of its
+// own queue, and steals them from the back of the other threads' queues when
+// its own is empty, so that the tasks queued behind a slow handler are run by
+// the threads that are idle.
+typedef struct {
+    lcm_dispatcher_t *dispatcher;
+    int index;
+    GThread *thread;
+    GMutex mutex;  // guards tasks
+    GQueue tasks;  // lcm_dispatcher_task_t*
+} dispatch_worker_t;
+
+struct _lcm_dispatcher_t {
+    dispatch_worker_t *workers;
+    int num_workers;
+    int next_worker;  // the queue that the next submitted task goes to
+
+    // the threads wait on cond for num_queued to become positive
+    GMutex mutex;
+    GCond cond;
+    // the tasks in all of the queues together.  Only changed atomically, and
+    // increased while holding mutex as well
+    int num_queued;
+    int exit;  // guarded by mutex
+};
+
+static void push_task(dispatch_worker_t *worker, lcm_dispatcher_task_t *task)
+{
+    lcm_dispatcher_t *dispatcher = worker->dispatcher;
+    g_mutex_lock(&worker->mutex);
+    g_queue_push_tail(&worker->tasks, task);
+    g_mutex_unlock(&worker->mutex);
+
+    g_mutex_lock(&dispatcher->mutex);
+    g_atomic_int_inc(&dispatcher->num_queued);
+    g_cond_signal(&dispatcher->cond);
+    g_mutex_unlock(&dispatcher->mutex);
+}
+
+static lcm_dispatcher_task_t *take_task(dispatch_worker_t *worker)
+{
+    lcm_dispatcher_t *dispatcher = worker->dispatcher;
+    g_mutex_lock(&worker->mutex);
+    lcm_dispatcher_task_t *task = (lcm_dispatcher_task_t *) g_queue_pop_head(&worker->tasks);
+    g_mutex_unlock(&worker->mutex);
+
+    for (int i = 1; !task && i < dispatcher->num_workers; i++) {
+        dispatch_worker_t *victim =
+            &dispatcher->workers[(worker->index + i) % dispatcher->num_workers];
+        g_mutex_lock(&victim->mutex);
+        task = (lcm_dispatcher_task_t *) g_queue_pop_tail(&victim->tasks);
+        g_mutex_unlock(&victim->mutex);
+    }
+
+    if (task)
+        g_atomic_int_add(&dispatcher->num_queued, -1);
+    return task;
+}
+
+static gpointer worker_thread(gpointer user)
+{
+    dispatch_worker_t *worker = (dispatch_worker_t *) user;
+    lcm_dispatcher_t *dispatcher = worker->dispatcher;
+    while (1) {
+        lcm_dispatcher_task_t *task = take_task(worker);
+        if (task) {
+            if (task->run(task))
+                push_task(worker, task);
+            continue;
+        }
+
+        // num_queued can be positive for a moment while another thread is
+        // taking the last task, so this doesn't block then.  Once the
+        // dispatcher is destroyed, the threads exit when there is nothing
+        // left to do.
+        g_mutex_lock(&dispatcher->mutex);
+        while (g_atomic_int_get(&dispatcher->num_queued) <= 0 && !dispatcher->exit)
+            g_cond_wait(&dispatcher->cond, &dispatcher->mutex);
+        int exit = dispatcher->exit && g_atomic_int_get(&dispatcher->num_queued) <= 0;
+        g_mutex_unlock(&dispatcher->mutex);
+        if (exit)
+            return NULL;
+    }
+}
+
+void lcm_dispatcher_submit(lcm_dispatcher_t *dispatcher, lcm_dispatcher_task_t *task)
+{
+    unsigned int index = (unsigned int) g_atomic_int_add(&dispatcher->next_worker, 1);
+    push_task(&dispatcher->workers[index % dispatcher->num_workers], task);
+}
+
+// a task of lcm_dispatcher_run(), which is freed once it has run
+typedef struct {
+    lcm_dispatcher_task_t task;
+    lcm_dispatcher_func_t func;
+    void *user_data;
+} dispatch_call_t;
+
+static int call_run(lcm_dispatcher_task_t *task)
+{
+    dispatch_call_t *call = (dispatch_call_t *) task;
+    call->func(call->user_data);
+    free(call);
+    return 0;
+}
+
+int lcm_dispatcher_run(lcm_dispatcher_t *dispatcher, lcm_dispatcher_func_t func,
+                       void *user_data)
+{
+    g_mutex_lock(&dispatcher->mutex);
+    int exit = dispatcher->exit;
+    g_mutex_unlock(&dispatcher->mutex);
+    if (exit)
+        return -1;
+
+    dispatch_call_t *call = (dispatch_call_t *) malloc(sizeof(dispatch_call_t));
+    call->task.run = call_run;
+    call->func = func;
+    call->user_data = user_data;
+    lcm_dispatcher_submit(dispatcher, &call->task);
+    return 0;
+}
+
+lcm_dispatcher_t *lcm_dispatcher_create(int num_threads)
+{
+    if (num_threads < 1) {
+        fprintf(stderr, "Error: a dispatcher needs at least one thread\n");
+        return NULL;
+    }
+
+    lcm_dispatcher_t *dispatcher = (lcm_dispatcher_t *) calloc(1, sizeof(lcm_dispatcher_t));
+    g_mutex_init(&dispatcher->mutex);
+    g_cond_init(&dispatcher->cond);
+    dispatcher->num_workers = num_threads;
+    dispatcher->workers = (dispatch_worker_t *) calloc(num_threads, sizeof(dispatch_worker_t));
+    for (int i = 0; i < num_threads; i++) {
+        dispatch_worker_t *worker = &dispatcher->workers[i];
+        worker->dispatcher = dispatcher;
+        worker->index = i;
+        g_mutex_init(&worker->mutex);
+        g_queue_init(&worker->tasks);
+    }
+
+    lcm_thread_sched_t sched;
+    lcm_thread_sched_init(&sched);
+    for (int i = 0; i < num_threads; i++) {
+        dispatch_worker_t *worker = &dispatcher->workers[i];
+        worker->thread = lcm_internal_thread_new("lcm-dispatch", worker_thread, worker, &sched);
+    }
+    return dispatcher;
+}
+
+void lcm_dispatcher_destroy(lcm_dispatcher_t *dispatcher)
+{
+    g_mutex_lock(&dispatcher->mutex);
+    dispatcher->exit = 1;
+    g_cond_broadcast(&dispatcher->cond);
+    g_mutex_unlock(&dispatcher->mutex);
+
+    for (int i = 0; i < dispatcher->num_workers; i++)
+        g_thread_join(dispatcher->workers[i].thread);
+    for (int i = 0; i < dispatcher->num_workers; i++) {
+        g_mutex_clear(&dispatcher->workers[i].mutex);
+        g_queue_clear(&dispatcher->workers[i].tasks);
+    }
+    g_cond_clear(&dispatcher->cond);
+    g_mutex_clear(&dispatcher->mutex);
+    free(dispatcher->workers);
+    free(dispatcher);
+}
+
+// The tasks of a dispatch context are run by whichever thread calls
+// lcm_dispatch_context_handle().  The read end of notify_pipe holds one byte
+// while tasks are queued, so that the context can be polled along with other
+// descriptors.
+struct _lcm_dispatch_context_t {
+    GMutex mutex;  // guards tasks and the byte in notify_pipe
+    GCond cond;
+    GQueue tasks;  // lcm_dispatcher_task_t*
+    int notify_pipe[2];
+};
+
+void lcm_dispatch_context_submit(lcm_dispatch_context_t *context, lcm_dispatcher_task_t *task)
+{
+    g_mutex_lock(&context->mutex);
+    if (g_queue_is_empty(&context->tasks) &&
+        lcm_internal_pipe_write(context->notify_pipe[1], "+", 1) != 1)
+        perror(__FILE__ " - write to notify pipe");
+    g_queue_push_tail(&context->tasks, task);
+    g_cond_signal(&context->cond);
+    g_mutex_unlock(&context->mutex);
+}
+
+// Runs the next task, waiting for one until the monotonic time deadline, or
+// forever if it is negative.  Returns 1 if a task ran, 0 on timeout.
+static int context_run_next(lcm_dispatch_context_t *context, gint64 deadline)
+{
+    g_mutex_lock(&context->mutex);
+    while (g_queue_is_empty(&context->tasks)) {
+        if (deadline < 0) {
+            g_cond_wait(&context->cond, &context->mutex);
+        } else if (!g_cond_wait_until(&context->cond, &context->mutex, deadline)) {
+            g_mutex_unlock(&context->mutex);
+            return 0;
+        }
+    }
+    lcm_dispatcher_task_t *task = (lcm_dispatcher_task_t *) g_queue_pop_head(&context->tasks);
+    char ch;
+    if (g_queue_is_empty(&context->tasks) &&
+        lcm_internal_pipe_read(context->notify_pipe[0], &ch, 1) != 1)
+        perror(__FILE__ " - read from notify pipe");
+    g_mutex_unlock(&context->mutex);
+
+    if (task->run(task))
+        lcm_dispatch_context_submit(context, task);
+    return 1;
+}
+
+lcm_dispatch_context_t *lcm_dispatch_context_create(void)
+{
+    lcm_dispatch_context_t *context =
+        (lcm_dispatch_context_t *) calloc(1, sizeof(lcm_dispatch_context_t));
+    if (lcm_internal_pipe_create(context->notify_pipe) != 0) {
+        perror(__FILE__ " - pipe (notify)");
+        free(context);
+        return NULL;
+    }
+    g_mutex_init(&context->mutex);
+    g_cond_init(&context->cond);
+    g_queue_init(&context->tasks);
+    return context;
+}
+
+void lcm_dispatch_context_destroy(lcm_dispatch_context_t *context)
+{
+    // the tasks of unsubscribed subscriptions only let go of them
+    while (!g_queue_is_empty(&context->tasks))
+        context_run_next(context, -1);
+    lcm_internal_pipe_close(context->notify_pipe[0]);
+    lcm_internal_pipe_close(context->notify_pipe[1]);
+    g_cond_clear(&context->cond);
+    g_mutex_clear(&context->mutex);
+    free(context);
+}
+
+int lcm_dispatch_context_get_fileno(lcm_dispatch_context_t *context)
+{
+    return context->notify_pipe[0];
+}
+
+int lcm_dispatch_context_handle(lcm_dispatch_context_t *context)
+{
+    context_run_next(context, -1);
+    return 0;
+}
+
+int lcm_dispatch_context_handle_timeout(lcm_dispatch_context_t *context, int timeout_millis)
+{
+    if (timeout_millis < 0)
+        return -1;
+    return context_run_next(context, g_get_monotonic_time() + (gint64) timeout_millis * 1000);
+}
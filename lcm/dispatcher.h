@@ -0,0 +1,38 @@
+#ifndef __lcm_dispatcher_h__
+#define __lcm_dispatcher_h__
+
+#include "lcm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _lcm_dispatcher_task_t lcm_dispatcher_task_t;
+
+// A piece of work that is run by one of the threads of an lcm_dispatcher_t.
+struct _lcm_dispatcher_task_t {
+    // Runs the task.  Returns nonzero to have the task queued again, behind
+    // the tasks that are already waiting for the same thread.
+    int (*run)(lcm_dispatcher_task_t *task);
+};
+
+/*
+ * Queues task to be run by one of the threads of dispatcher.  The task must
+ * stay valid until its run function returns 0.  It must not be submitted
+ * again while it is queued or running.
+ */
+LCM_NO_EXPORT
+void lcm_dispatcher_submit(lcm_dispatcher_t *dispatcher, lcm_dispatcher_task_t *task);
+
+/*
+ * Queues task to be run by the next lcm_dispatch_context_handle() of context,
+ * with the same rules as lcm_dispatcher_submit().
+ */
+LCM_NO_EXPORT
+void lcm_dispatch_context_submit(lcm_dispatch_context_t *context, lcm_dispatcher_task_t *task);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -7,6 +7,16 @@
 #define __STDC_FORMAT_MACROS  // Enable integer types
 #endif
 #include <stdint.h>
+#ifndef WIN32
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+#include <glib.h>
 
 #include "eventlog.h"
 #include "ioutils.h"
@@ -19,9 +29,99 @@
 
 #define MAGIC ((int32_t) 0xEDA1DA01L)
 
+// the magic, event number, timestamp, and channel and data lengths
+#define EVENT_HEADER_SIZE 28
+
+struct _lcm_eventlog_mmap_t {
+    const uint8_t *data;
+    size_t size;
+};
+
+// the size of the buffer for reading, so that events are read in large blocks
+#define READ_BUFFER_SIZE (1 << 20)
+
+// how much of the end of a log file is read at a time when recovering it
+#define RECOVER_CHUNK_SIZE (64 << 10)
+
+// the most events written by each writev() in lcm_eventlog_write_events(),
+// with an iovec for the header, channel and data of each
+#define WRITE_BATCH_EVENTS 256
+
+// The index of a log file is written to the sidecar file <log>.idx.  It
+// starts with INDEX_MAGIC and INDEX_VERSION, followed by records that each
+// start with their type, all of them big-endian like the log file:
+//
+//   INDEX_TIME:     int64 timestamp, int64 eventnum, int64 offset
+//                   of the first event, and then of the first event after
+//                   every INDEX_INTERVAL bytes of the log file
+//   INDEX_CHANNEL:  int64 offset, int64 count, int32 channellen, channel
+//                   of the first event on each channel after a time record,
+//                   and the number of events on the channel before it, or -1
+//                   if that isn't known because the index was started on a
+//                   log file that had events already.  Version 1 indexes
+//                   have no count.
+//
+// Seeking uses the time records, and reading with a channel filter uses the
+// channel records to skip to the first wanted event after a time record.  A
+// cursor uses the counts of the channel records to find the nth event on a
+// channel.  A record that doesn't match its event, because the log file has
+// changed since, isn't used.
+#define INDEX_MAGIC ((int32_t) 0x4C434D49L)
+#define INDEX_VERSION 2
+#define INDEX_TIME 1
+#define INDEX_CHANNEL 2
+#define INDEX_INTERVAL (1 << 20)
+
+typedef struct {
+    int64_t timestamp;
+    int64_t eventnum;
+    int64_t offset;
+    // the first of the channel records that follow the time record
+    int first_channel;
+} index_entry_t;
+
+typedef struct {
+    int64_t offset;
+    int64_t count;
+    char *channel;
+} index_channel_t;
+
+// A log file, with the state that isn't public.  The read buffer is
+// allocated after it, and freed with it.
+typedef struct {
+    lcm_eventlog_t log;
+    char *path;
+
+    // writing the index
+    FILE *index_f;
+    // the offset of the next event written, and of the last time record
+    int64_t offset;
+    int64_t index_offset;
+    // the channels that have a record since the last time record
+    GHashTable *index_channels;
+    // the version of the index that's continued, and the number of events
+    // on each channel, or NULL if those aren't known
+    int index_version;
+    GHashTable *index_counts;  // char* -> int64_t*
+
+    // reading the index, the first time that it's needed
+    int index_loaded;
+    index_entry_t *entries;
+    int num_entries;
+    index_channel_t *channels;
+    int num_channels;
+
+    // the filter of lcm_eventlog_set_channel_filter(), and the offset from
+    // which the index is used to skip events again, or INT64_MAX if it's not
+    int (*wanted)(const char *channel, void *user);
+    void *wanted_user;
+    int64_t filter_next;
+} eventlog_impl_t;
+
 lcm_eventlog_t *lcm_eventlog_create(const char *path, const char *mode)
 {
     assert(!strcmp(mode, "r") || !strcmp(mode, "w") || !strcmp(mode, "a"));
+    int reading = *mode == 'r';
     if (*mode == 'w')
         mode = "wb";
     else if (*mode == 'r')
@@ -31,115 +131,544 @@ lcm_eventlog_t *lcm_eventlog_create(const char *path, const char *mode)
     else
         return NULL;
 
-    lcm_eventlog_t *l = (lcm_eventlog_t *) calloc(1, sizeof(lcm_eventlog_t));
+    size_t buffer_size = reading ? READ_BUFFER_SIZE : 0;
+    eventlog_impl_t *impl = (eventlog_impl_t *) calloc(1, sizeof(eventlog_impl_t) + buffer_size);
+    lcm_eventlog_t *l = &impl->log;
 
     l->f = fopen(path, mode);
     if (l->f == NULL) {
-        free(l);
+        free(impl);
         return NULL;
     }
+    if (reading)
+        setvbuf(l->f, (char *) (impl + 1), _IOFBF, buffer_size);
+    impl->path = strdup(path);
 
     l->eventcount = 0;
 
     return l;
 }
 
+static void free_index(eventlog_impl_t *impl)
+{
+    free(impl->entries);
+    for (int i = 0; i < impl->num_channels; i++)
+        g_free(impl->channels[i].channel);
+    free(impl->channels);
+}
+
 void lcm_eventlog_destroy(lcm_eventlog_t *l)
 {
+    eventlog_impl_t *impl = (eventlog_impl_t *) l;
     fflush(l->f);
     fclose(l->f);
-    free(l);
+    if (impl->index_f)
+        fclose(impl->index_f);
+    if (impl->index_channels)
+        g_hash_table_destroy(impl->index_channels);
+    if (impl->index_counts)
+        g_hash_table_destroy(impl->index_counts);
+    free_index(impl);
+    free(impl->path);
+    free(impl);
 }
 
-lcm_eventlog_event_t *lcm_eventlog_read_next_event(lcm_eventlog_t *l)
+static char *index_path(const char *path)
 {
-    lcm_eventlog_event_t *le = (lcm_eventlog_event_t *) calloc(1, sizeof(lcm_eventlog_event_t));
+    size_t len = strlen(path);
+    char *result = (char *) malloc(len + 5);
+    memcpy(result, path, len);
+    memcpy(result + len, ".idx", 5);
+    return result;
+}
+
+int lcm_eventlog_write_index(lcm_eventlog_t *l)
+{
+    eventlog_impl_t *impl = (eventlog_impl_t *) l;
+    if (impl->index_f)
+        return 0;
+
+    // an existing index is continued when appending to the log file
+    fseeko(l->f, 0, SEEK_END);
+    impl->offset = ftello(l->f);
+    char *idx = index_path(impl->path);
+    FILE *f = fopen(idx, impl->offset > 0 ? "ab" : "wb");
+    if (f == NULL) {
+        fprintf(stderr, "Error: Unable to open log index %s\n", idx);
+        free(idx);
+        return -1;
+    }
+    fseeko(f, 0, SEEK_END);
+    impl->index_version = INDEX_VERSION;
+    if (ftello(f) == 0) {
+        if (0 != fwrite32(f, INDEX_MAGIC) || 0 != fwrite32(f, INDEX_VERSION)) {
+            free(idx);
+            fclose(f);
+            return -1;
+        }
+    } else {
+        // the records that are appended have to be of the same version
+        FILE *existing = fopen(idx, "rb");
+        int32_t magic, version;
+        if (existing && 0 == fread32(existing, &magic) && magic == INDEX_MAGIC &&
+            0 == fread32(existing, &version) && version == 1)
+            impl->index_version = 1;
+        if (existing)
+            fclose(existing);
+    }
+    free(idx);
+    impl->index_f = f;
+    impl->index_offset = -1;
+    impl->index_channels = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    // the events on each channel are only counted from the start of the log
+    if (impl->offset == 0)
+        impl->index_counts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    return 0;
+}
+
+// Writes the records of the index for an event that's written at the offset.
+static int write_index_records(eventlog_impl_t *impl, const lcm_eventlog_event_t *le,
+                               int64_t offset)
+{
+    FILE *f = impl->index_f;
+    if (impl->index_offset < 0 || offset - impl->index_offset >= INDEX_INTERVAL) {
+        if (0 != fwrite32(f, INDEX_TIME) || 0 != fwrite64(f, le->timestamp) ||
+            0 != fwrite64(f, le->eventnum) || 0 != fwrite64(f, offset))
+            return -1;
+        impl->index_offset = offset;
+        g_hash_table_remove_all(impl->index_channels);
+    }
+
+    char *channel = g_strndup(le->channel, le->channellen);
+    int64_t count = -1;
+    if (impl->index_counts) {
+        int64_t *counter = (int64_t *) g_hash_table_lookup(impl->index_counts, channel);
+        if (!counter) {
+            counter = g_new0(int64_t, 1);
+            g_hash_table_insert(impl->index_counts, g_strdup(channel), counter);
+        }
+        count = (*counter)++;
+    }
+    if (g_hash_table_contains(impl->index_channels, channel)) {
+        g_free(channel);
+        return 0;
+    }
+    g_hash_table_add(impl->index_channels, channel);
+    if (0 != fwrite32(f, INDEX_CHANNEL) || 0 != fwrite64(f, offset) ||
+        (impl->index_version >= 2 && 0 != fwrite64(f, count)) ||
+        0 != fwrite32(f, le->channellen) ||
+        le->channellen != (int32_t) fwrite(le->channel, 1, le->channellen, f))
+        return -1;
+    return 0;
+}
+
+// Reads the time records of the index, ignoring anything after a record
+// that's incomplete or invalid.
+static void load_index(eventlog_impl_t *impl)
+{
+    impl->index_loaded = 1;
+    char *idx = index_path(impl->path);
+    FILE *f = fopen(idx, "rb");
+    free(idx);
+    if (f == NULL)
+        return;
+
+    int32_t magic, version;
+    if (0 != fread32(f, &magic) || magic != INDEX_MAGIC || 0 != fread32(f, &version) ||
+        version < 1 || version > INDEX_VERSION) {
+        fclose(f);
+        return;
+    }
+
+    int capacity = 0;
+    int channels_capacity = 0;
+    int32_t type;
+    while (0 == fread32(f, &type)) {
+        if (type == INDEX_TIME) {
+            index_entry_t entry;
+            if (0 != fread64(f, &entry.timestamp) || 0 != fread64(f, &entry.eventnum) ||
+                0 != fread64(f, &entry.offset))
+                break;
+            entry.first_channel = impl->num_channels;
+            if (impl->num_entries == capacity) {
+                capacity = capacity ? capacity * 2 : 256;
+                impl->entries =
+                    (index_entry_t *) realloc(impl->entries, capacity * sizeof(index_entry_t));
+            }
+            impl->entries[impl->num_entries++] = entry;
+        } else if (type == INDEX_CHANNEL) {
+            index_channel_t record;
+            int32_t channellen;
+            record.count = -1;
+            if (0 != fread64(f, &record.offset) ||
+                (version >= 2 && 0 != fread64(f, &record.count)) || 0 != fread32(f, &channellen) ||
+                channellen <= 0 || channellen >= 1000)
+                break;
+            record.channel = (char *) g_malloc(channellen + 1);
+            if (fread(record.channel, 1, channellen, f) != (size_t) channellen) {
+                g_free(record.channel);
+                break;
+            }
+            record.channel[channellen] = 0;
+            // a channel record belongs to the time record before it
+            if (impl->num_entries == 0) {
+                g_free(record.channel);
+                continue;
+            }
+            if (impl->num_channels == channels_capacity) {
+                channels_capacity = channels_capacity ? channels_capacity * 2 : 256;
+                impl->channels = (index_channel_t *) realloc(
+                    impl->channels, channels_capacity * sizeof(index_channel_t));
+            }
+            impl->channels[impl->num_channels++] = record;
+        } else {
+            break;
+        }
+    }
+    fclose(f);
+}
 
+// Reads the header of the next event, and checks its channel length and data
+// length.
+static int read_event_header(lcm_eventlog_t *l, lcm_eventlog_event_t *le)
+{
     uint32_t magic = 0;
     int r;
 
     do {
-        r = fgetc(l->f);
-        if (r < 0) {
-            free(le);
-            return NULL;
-        }
+        r = getc(l->f);
+        if (r < 0)
+            return -1;
         magic = (magic << 8) | (uint32_t) r;
     } while (magic != MAGIC);
 
     if (0 != fread64(l->f, &le->eventnum) || 0 != fread64(l->f, &le->timestamp) ||
         0 != fread32(l->f, &le->channellen) || 0 != fread32(l->f, &le->datalen)) {
-        free(le);
-        return NULL;
+        return -1;
     }
 
     // Sanity check the channel length and data length
     if (le->channellen <= 0 || le->channellen >= 1000) {
         fprintf(stderr, "Log event has invalid channel length: %d\n", le->channellen);
-        free(le);
-        return NULL;
+        return -1;
     }
     if (le->datalen < 0) {
         fprintf(stderr, "Log event has invalid data length: %d\n", le->datalen);
+        return -1;
+    }
+    return 0;
+}
+
+// Checks that there's a valid event or the EOF after an event.
+static int check_next_header(lcm_eventlog_t *l)
+{
+    int32_t next_magic;
+    if (0 == fread32(l->f, &next_magic)) {
+        if (next_magic != MAGIC) {
+            fprintf(stderr, "Invalid header after log data\n");
+            return -1;
+        }
+        fseeko(l->f, -4, SEEK_CUR);
+    }
+    return 0;
+}
+
+static int read_event_header_at(lcm_eventlog_t *l, int64_t offset, lcm_eventlog_event_t *le);
+
+// Checks that the event at the offset is on the channel.
+static int is_event_on_channel(lcm_eventlog_t *l, int64_t offset, const char *channel)
+{
+    lcm_eventlog_event_t le;
+    char buf[1000];
+    return 0 == read_event_header_at(l, offset, &le) &&
+           le.channellen == (int32_t) strlen(channel) &&
+           fread(buf, 1, le.channellen, l->f) == (size_t) le.channellen &&
+           0 == memcmp(buf, channel, le.channellen);
+}
+
+// At a time record of the index, skips to the first event after it on a
+// wanted channel, or to the next time record if there's none.  The events
+// between two time records are read one by one otherwise, since only the
+// first event of each channel after a time record is known.  The last time
+// record is never skipped from, since the log file may still be written to.
+static void skip_with_index(eventlog_impl_t *impl)
+{
+    lcm_eventlog_t *l = &impl->log;
+    if (!impl->index_loaded)
+        load_index(impl);
+    if (impl->filter_next == INT64_MAX)
+        return;
+    int64_t offset = ftello(l->f);
+    while (offset >= impl->filter_next) {
+        // the last time record at or before the offset
+        int lo = 0;
+        int hi = impl->num_entries;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (impl->entries[mid].offset <= offset)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if (lo == impl->num_entries) {
+            impl->filter_next = INT64_MAX;
+            return;
+        }
+        if (lo == 0) {
+            impl->filter_next = impl->entries[0].offset;
+            return;
+        }
+        const index_entry_t *entry = &impl->entries[lo - 1];
+        const index_entry_t *next = &impl->entries[lo];
+        impl->filter_next = next->offset;
+        if (entry->offset != offset)
+            return;
+
+        int64_t target = next->offset;
+        const char *target_channel = NULL;
+        for (int i = entry->first_channel; i < next->first_channel; i++) {
+            const index_channel_t *record = &impl->channels[i];
+            if (record->offset < target && impl->wanted(record->channel, impl->wanted_user)) {
+                target = record->offset;
+                target_channel = record->channel;
+            }
+        }
+        if (target == offset)
+            return;
+
+        lcm_eventlog_event_t le;
+        int matches = target_channel ? is_event_on_channel(l, target, target_channel)
+                                     : 0 == read_event_header_at(l, target, &le) &&
+                                           le.eventnum == next->eventnum &&
+                                           le.timestamp == next->timestamp;
+        if (!matches) {
+            // the log file has changed since the index was written
+            impl->filter_next = INT64_MAX;
+            fseeko(l->f, offset, SEEK_SET);
+            return;
+        }
+        fseeko(l->f, target, SEEK_SET);
+        offset = target;
+    }
+}
+
+// Reads the header and the channel of the next event that's wanted by the
+// filter, if there is one, skipping the data of the events that aren't.
+static int read_wanted_event_header(lcm_eventlog_t *l, lcm_eventlog_event_t *le, char *channel)
+{
+    eventlog_impl_t *impl = (eventlog_impl_t *) l;
+    while (1) {
+        if (impl->wanted)
+            skip_with_index(impl);
+        if (0 != read_event_header(l, le) ||
+            fread(channel, 1, le->channellen, l->f) != (size_t) le->channellen)
+            return -1;
+        channel[le->channellen] = 0;
+        if (!impl->wanted || impl->wanted(channel, impl->wanted_user))
+            return 0;
+        if (0 != fseeko(l->f, le->datalen, SEEK_CUR) || 0 != check_next_header(l))
+            return -1;
+    }
+}
+
+void lcm_eventlog_set_channel_filter(lcm_eventlog_t *l,
+                                     int (*wanted)(const char *channel, void *user), void *user)
+{
+    eventlog_impl_t *impl = (eventlog_impl_t *) l;
+    impl->wanted = wanted;
+    impl->wanted_user = user;
+}
+
+lcm_eventlog_event_t *lcm_eventlog_read_next_event(lcm_eventlog_t *l)
+{
+    lcm_eventlog_event_t *le = (lcm_eventlog_event_t *) calloc(1, sizeof(lcm_eventlog_event_t));
+
+    char channel[1000];
+    if (0 != read_wanted_event_header(l, le, channel)) {
         free(le);
         return NULL;
     }
 
     le->channel = (char *) calloc(1, le->channellen + 1);
-    if (fread(le->channel, 1, le->channellen, l->f) != (size_t) le->channellen) {
+    memcpy(le->channel, channel, le->channellen);
+
+    le->data = calloc(1, le->datalen + 1);
+    if (fread(le->data, 1, le->datalen, l->f) != (size_t) le->datalen) {
         free(le->channel);
         free(le->data);
         free(le);
         return NULL;
     }
 
-    le->data = calloc(1, le->datalen + 1);
-    if (fread(le->data, 1, le->datalen, l->f) != (size_t) le->datalen) {
+    if (0 != check_next_header(l)) {
         free(le->channel);
         free(le->data);
         free(le);
         return NULL;
     }
-
-    // Check that there's a valid event or the EOF after this event.
-    int32_t next_magic;
-    if (0 == fread32(l->f, &next_magic)) {
-        if (next_magic != MAGIC) {
-            fprintf(stderr, "Invalid header after log data\n");
-            free(le->channel);
-            free(le->data);
-            free(le);
-            return NULL;
-        }
-        fseeko(l->f, -4, SEEK_CUR);
-    }
     return le;
 }
 
-int lcm_eventlog_write_event(lcm_eventlog_t *l, lcm_eventlog_event_t *le)
+int lcm_eventlog_read_next_event_into(lcm_eventlog_t *l, lcm_eventlog_event_t *le,
+                                      size_t *capacity)
 {
-    if (0 != fwrite32(l->f, MAGIC))
+    char channel[1000];
+    if (0 != read_wanted_event_header(l, le, channel))
         return -1;
 
-    le->eventnum = l->eventcount;
+    // the channel and the data, each NUL-terminated
+    size_t size = (size_t) le->channellen + 1 + (size_t) le->datalen + 1;
+    if (size > *capacity) {
+        size_t new_capacity = *capacity * 2 > size ? *capacity * 2 : size;
+        char *block = (char *) realloc(*capacity ? le->channel : NULL, new_capacity);
+        if (!block)
+            return -1;
+        le->channel = block;
+        *capacity = new_capacity;
+    }
+    le->data = le->channel + le->channellen + 1;
 
-    if (0 != fwrite64(l->f, le->eventnum))
-        return -1;
-    if (0 != fwrite64(l->f, le->timestamp))
-        return -1;
-    if (0 != fwrite32(l->f, le->channellen))
-        return -1;
-    if (0 != fwrite32(l->f, le->datalen))
+    memcpy(le->channel, channel, le->channellen + 1);
+    if (fread(le->data, 1, le->datalen, l->f) != (size_t) le->datalen)
         return -1;
+    ((char *) le->data)[le->datalen] = 0;
+
+    return check_next_header(l);
+}
+
+static inline void write32(uint8_t *p, int32_t v)
+{
+    p[0] = (uint8_t) ((uint32_t) v >> 24);
+    p[1] = (uint8_t) ((uint32_t) v >> 16);
+    p[2] = (uint8_t) ((uint32_t) v >> 8);
+    p[3] = (uint8_t) v;
+}
+
+static inline void write64(uint8_t *p, int64_t v)
+{
+    write32(p, (int32_t) ((uint64_t) v >> 32));
+    write32(p + 4, (int32_t) (v & 0xffffffff));
+}
+
+static void encode_event_header(uint8_t *p, const lcm_eventlog_event_t *le)
+{
+    write32(p, MAGIC);
+    write64(p + 4, le->eventnum);
+    write64(p + 12, le->timestamp);
+    write32(p + 20, le->channellen);
+    write32(p + 24, le->datalen);
+}
+
+// Counts an event that's been written, and writes its index records.
+static int event_written(eventlog_impl_t *impl, const lcm_eventlog_event_t *le)
+{
+    impl->log.eventcount = le->eventnum + 1;
+    if (impl->index_f) {
+        int64_t offset = impl->offset;
+        impl->offset += EVENT_HEADER_SIZE + le->channellen + le->datalen;
+        if (0 != write_index_records(impl, le, offset))
+            return -1;
+    }
+    return 0;
+}
+
+int lcm_eventlog_write_event(lcm_eventlog_t *l, lcm_eventlog_event_t *le)
+{
+    le->eventnum = l->eventcount;
 
+    uint8_t header[EVENT_HEADER_SIZE];
+    encode_event_header(header, le);
+    if (fwrite(header, 1, EVENT_HEADER_SIZE, l->f) != EVENT_HEADER_SIZE)
+        return -1;
     if (le->channellen != (int32_t) fwrite(le->channel, 1, le->channellen, l->f))
         return -1;
     if (le->datalen != (int32_t) fwrite(le->data, 1, le->datalen, l->f))
         return -1;
 
-    l->eventcount++;
+    return event_written((eventlog_impl_t *) l, le);
+}
+
+#ifndef WIN32
+// Writes all of the iovecs, which it modifies, resuming after short writes.
+static int writev_all(int fd, struct iovec *iov, int iovcnt)
+{
+    while (iovcnt > 0) {
+        ssize_t written = writev(fd, iov, iovcnt);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        while (iovcnt > 0 && (size_t) written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *) iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+    return 0;
+}
+#endif
+
+// Writes the events, numbering them unless numbered is set.
+static int write_events(lcm_eventlog_t *l, lcm_eventlog_event_t *const *events, int num_events,
+                        int numbered)
+{
+#ifdef WIN32
+    for (int i = 0; i < num_events; i++) {
+        if (numbered)
+            l->eventcount = events[i]->eventnum;
+        if (0 != lcm_eventlog_write_event(l, events[i]))
+            return -1;
+    }
+    return 0;
+#else
+    // the events written through the stream go first
+    if (0 != fflush(l->f))
+        return -1;
+    int fd = fileno(l->f);
 
+    uint8_t headers[WRITE_BATCH_EVENTS][EVENT_HEADER_SIZE];
+    struct iovec iov[3 * WRITE_BATCH_EVENTS];
+    for (int start = 0; start < num_events; start += WRITE_BATCH_EVENTS) {
+        int n = num_events - start < WRITE_BATCH_EVENTS ? num_events - start : WRITE_BATCH_EVENTS;
+        int iovcnt = 0;
+        for (int i = 0; i < n; i++) {
+            lcm_eventlog_event_t *le = events[start + i];
+            if (!numbered)
+                le->eventnum = l->eventcount + i;
+            encode_event_header(headers[i], le);
+            iov[iovcnt].iov_base = headers[i];
+            iov[iovcnt++].iov_len = EVENT_HEADER_SIZE;
+            iov[iovcnt].iov_base = le->channel;
+            iov[iovcnt++].iov_len = le->channellen;
+            iov[iovcnt].iov_base = le->data;
+            iov[iovcnt++].iov_len = le->datalen;
+        }
+        if (0 != writev_all(fd, iov, iovcnt))
+            return -1;
+        for (int i = 0; i < n; i++) {
+            if (0 != event_written((eventlog_impl_t *) l, events[start + i]))
+                return -1;
+        }
+    }
     return 0;
+#endif
+}
+
+int lcm_eventlog_write_events(lcm_eventlog_t *l, lcm_eventlog_event_t *const *events,
+                              int num_events)
+{
+    return write_events(l, events, num_events, 0);
+}
+
+int lcm_eventlog_write_numbered_events(lcm_eventlog_t *l, lcm_eventlog_event_t *const *events,
+                                       int num_events)
+{
+    return write_events(l, events, num_events, 1);
 }
 
 void lcm_eventlog_free_event(lcm_eventlog_event_t *le)
@@ -180,8 +709,71 @@ eof:
     return -1;
 }
 
+// Reads the header of the event at the offset, without scanning for it.
+static int read_event_header_at(lcm_eventlog_t *l, int64_t offset, lcm_eventlog_event_t *le)
+{
+    int32_t magic;
+    if (0 != fseeko(l->f, offset, SEEK_SET) || 0 != fread32(l->f, &magic) || magic != MAGIC ||
+        0 != fread64(l->f, &le->eventnum) || 0 != fread64(l->f, &le->timestamp) ||
+        0 != fread32(l->f, &le->channellen) || 0 != fread32(l->f, &le->datalen))
+        return -1;
+    if (le->channellen <= 0 || le->channellen >= 1000 || le->datalen < 0)
+        return -1;
+    return 0;
+}
+
+// Seeks to the first event at or after the timestamp, from the last time
+// record of the index before it.  Returns -1 if there's no index, or it
+// doesn't match the log file.
+static int seek_with_index(eventlog_impl_t *impl, int64_t timestamp)
+{
+    if (!impl->index_loaded)
+        load_index(impl);
+    if (impl->num_entries == 0)
+        return -1;
+
+    // the first record after the timestamp
+    int lo = 0;
+    int hi = impl->num_entries;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (impl->entries[mid].timestamp <= timestamp)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0 && impl->entries[0].offset > 0)
+        return -1;
+    const index_entry_t *entry = &impl->entries[lo > 0 ? lo - 1 : 0];
+
+    lcm_eventlog_t *l = &impl->log;
+    lcm_eventlog_event_t le;
+    if (0 != read_event_header_at(l, entry->offset, &le) || le.eventnum != entry->eventnum ||
+        le.timestamp != entry->timestamp)
+        return -1;
+
+    // The events are skipped without reading them, within the read buffer
+    // mostly, as the records are at most INDEX_INTERVAL bytes apart.
+    int64_t offset = entry->offset;
+    int64_t eventnum = le.eventnum;
+    while (le.timestamp < timestamp) {
+        int64_t next = offset + EVENT_HEADER_SIZE + le.channellen + le.datalen;
+        if (0 != read_event_header_at(l, next, &le))
+            break;
+        offset = next;
+        eventnum = le.eventnum;
+    }
+    fseeko(l->f, offset, SEEK_SET);
+    l->eventcount = eventnum;
+    return 0;
+}
+
 int lcm_eventlog_seek_to_timestamp(lcm_eventlog_t *l, int64_t timestamp)
 {
+    ((eventlog_impl_t *) l)->filter_next = 0;
+    if (0 == seek_with_index((eventlog_impl_t *) l, timestamp))
+        return 0;
+
     fseeko(l->f, 0, SEEK_END);
     off_t file_len = ftello(l->f);
 
@@ -221,3 +813,615 @@ int lcm_eventlog_seek_to_timestamp(lcm_eventlog_t *l, int64_t timestamp)
 
     return 0;
 }
+
+// Seeks to the first event from the offset on with at least the event number,
+// skipping the events before it without reading them.
+static int walk_to_eventnum(lcm_eventlog_t *l, int64_t offset, int64_t eventnum)
+{
+    lcm_eventlog_event_t le;
+    while (1) {
+        if (0 != read_event_header_at(l, offset, &le))
+            return -1;
+        if (le.eventnum >= eventnum)
+            break;
+        offset += EVENT_HEADER_SIZE + le.channellen + le.datalen;
+    }
+    fseeko(l->f, offset, SEEK_SET);
+    l->eventcount = le.eventnum;
+    return 0;
+}
+
+int lcm_eventlog_seek_to_eventnum(lcm_eventlog_t *l, int64_t eventnum)
+{
+    eventlog_impl_t *impl = (eventlog_impl_t *) l;
+    impl->filter_next = 0;
+    if (!impl->index_loaded)
+        load_index(impl);
+
+    // the last time record at or before the event number
+    int lo = 0;
+    int hi = impl->num_entries;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (impl->entries[mid].eventnum <= eventnum)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo > 0 || (impl->num_entries > 0 && impl->entries[0].offset == 0)) {
+        const index_entry_t *entry = &impl->entries[lo > 0 ? lo - 1 : 0];
+        lcm_eventlog_event_t le;
+        if (0 == read_event_header_at(l, entry->offset, &le) && le.eventnum == entry->eventnum &&
+            le.timestamp == entry->timestamp)
+            return walk_to_eventnum(l, entry->offset, eventnum);
+    }
+
+    // Without an index that matches the log file, the log file is bisected
+    // for the last event before the event number, and walked from there.
+    fseeko(l->f, 0, SEEK_END);
+    int64_t start = 0;
+    int64_t end = ftello(l->f);
+    while (end - start > INDEX_INTERVAL) {
+        int64_t mid = start + (end - start) / 2;
+        fseeko(l->f, mid, SEEK_SET);
+        if (get_event_time(l) < 0 || ftello(l->f) >= end || l->eventcount >= eventnum)
+            end = mid;
+        else
+            start = ftello(l->f);
+    }
+    fseeko(l->f, start, SEEK_SET);
+    if (get_event_time(l) < 0)
+        return -1;
+    return walk_to_eventnum(l, ftello(l->f), eventnum);
+}
+
+struct _lcm_eventlog_cursor_t {
+    eventlog_impl_t *impl;
+    char *channel;
+    // the number of events on the channel before the next one, and the offset
+    // that the next one is looked for from
+    int64_t position;
+    int64_t offset;
+    // the channel records of the index for the channel that have a count, in
+    // the order of the log file
+    GArray *records;  // index_channel_t
+};
+
+static int is_cursor_channel(const char *channel, void *user)
+{
+    return !strcmp(channel, ((const lcm_eventlog_cursor_t *) user)->channel);
+}
+
+lcm_eventlog_cursor_t *lcm_eventlog_cursor_create(lcm_eventlog_t *l, const char *channel)
+{
+    eventlog_impl_t *impl = (eventlog_impl_t *) l;
+    if (!impl->index_loaded)
+        load_index(impl);
+    lcm_eventlog_cursor_t *cursor = (lcm_eventlog_cursor_t *) calloc(1, sizeof(*cursor));
+    cursor->impl = impl;
+    cursor->channel = strdup(channel);
+    cursor->records = g_array_new(FALSE, FALSE, sizeof(index_channel_t));
+    for (int i = 0; i < impl->num_channels; i++) {
+        const index_channel_t *record = &impl->channels[i];
+        if (record->count >= 0 && !strcmp(record->channel, channel))
+            g_array_append_val(cursor->records, *record);
+    }
+    return cursor;
+}
+
+void lcm_eventlog_cursor_destroy(lcm_eventlog_cursor_t *cursor)
+{
+    g_array_free(cursor->records, TRUE);
+    free(cursor->channel);
+    free(cursor);
+}
+
+// Reads through the log with the filter of the cursor instead of the one of
+// lcm_eventlog_set_channel_filter(), so that the index skips the events on
+// other channels.
+static void cursor_filter_begin(lcm_eventlog_cursor_t *cursor, int (**wanted)(const char *, void *),
+                                void **wanted_user)
+{
+    eventlog_impl_t *impl = cursor->impl;
+    *wanted = impl->wanted;
+    *wanted_user = impl->wanted_user;
+    impl->wanted = is_cursor_channel;
+    impl->wanted_user = cursor;
+    impl->filter_next = 0;
+    fseeko(impl->log.f, cursor->offset, SEEK_SET);
+}
+
+static void cursor_filter_end(lcm_eventlog_cursor_t *cursor, int (*wanted)(const char *, void *),
+                              void *wanted_user)
+{
+    eventlog_impl_t *impl = cursor->impl;
+    impl->wanted = wanted;
+    impl->wanted_user = wanted_user;
+    impl->filter_next = 0;
+}
+
+int lcm_eventlog_cursor_seek(lcm_eventlog_cursor_t *cursor, int64_t n)
+{
+    if (n < 0)
+        return -1;
+    lcm_eventlog_t *l = &cursor->impl->log;
+
+    // from the last channel record at or before the event, if it matches the
+    // log file, or else from the start of the log file
+    int64_t position = 0;
+    int64_t offset = 0;
+    int lo = 0;
+    int hi = cursor->records->len;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (g_array_index(cursor->records, index_channel_t, mid).count <= n)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo > 0) {
+        const index_channel_t *record = &g_array_index(cursor->records, index_channel_t, lo - 1);
+        if (is_event_on_channel(l, record->offset, cursor->channel)) {
+            position = record->count;
+            offset = record->offset;
+        }
+    }
+    // or from where the cursor is, if that's closer, as when it moves on by a
+    // few events
+    if (cursor->position <= n && cursor->position > position) {
+        position = cursor->position;
+        offset = cursor->offset;
+    }
+
+    // the events on the channel in between are skipped without reading them
+    int (*wanted)(const char *, void *);
+    void *wanted_user;
+    int64_t saved_position = cursor->position;
+    int64_t saved_offset = cursor->offset;
+    cursor->offset = offset;
+    cursor_filter_begin(cursor, &wanted, &wanted_user);
+    int status = 0;
+    char channel[1000];
+    lcm_eventlog_event_t le;
+    for (; position < n; position++) {
+        if (0 != read_wanted_event_header(l, &le, channel) ||
+            0 != fseeko(l->f, le.datalen, SEEK_CUR) || 0 != check_next_header(l)) {
+            status = -1;
+            break;
+        }
+    }
+    // the next event on the channel has to be there too
+    int64_t next = ftello(l->f);
+    if (status == 0 && 0 != read_wanted_event_header(l, &le, channel))
+        status = -1;
+    cursor_filter_end(cursor, wanted, wanted_user);
+    if (status == 0) {
+        cursor->position = n;
+        cursor->offset = next;
+    } else {
+        cursor->position = saved_position;
+        cursor->offset = saved_offset;
+    }
+    fseeko(l->f, cursor->offset, SEEK_SET);
+    return status;
+}
+
+int64_t lcm_eventlog_cursor_tell(const lcm_eventlog_cursor_t *cursor)
+{
+    return cursor->position;
+}
+
+lcm_eventlog_event_t *lcm_eventlog_cursor_next(lcm_eventlog_cursor_t *cursor)
+{
+    lcm_eventlog_t *l = &cursor->impl->log;
+    int (*wanted)(const char *, void *);
+    void *wanted_user;
+    cursor_filter_begin(cursor, &wanted, &wanted_user);
+    lcm_eventlog_event_t *le = lcm_eventlog_read_next_event(l);
+    cursor_filter_end(cursor, wanted, wanted_user);
+    if (le) {
+        cursor->position++;
+        cursor->offset = ftello(l->f);
+    }
+    return le;
+}
+
+int lcm_eventlog_build_index(const char *path)
+{
+    lcm_eventlog_t *l = lcm_eventlog_create(path, "r");
+    if (l == NULL) {
+        fprintf(stderr, "Error: Unable to open log file %s\n", path);
+        return -1;
+    }
+
+    eventlog_impl_t *writer = (eventlog_impl_t *) calloc(1, sizeof(eventlog_impl_t));
+    writer->path = strdup(path);
+    char *idx = index_path(path);
+    writer->index_f = fopen(idx, "wb");
+    if (writer->index_f == NULL) {
+        fprintf(stderr, "Error: Unable to open log index %s\n", idx);
+        free(idx);
+        free(writer->path);
+        free(writer);
+        lcm_eventlog_destroy(l);
+        return -1;
+    }
+    free(idx);
+    writer->index_offset = -1;
+    writer->index_channels = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    writer->index_version = INDEX_VERSION;
+    writer->index_counts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+    // Only the headers and channels are read, and the data is skipped.
+    int status = 0;
+    if (0 != fwrite32(writer->index_f, INDEX_MAGIC) ||
+        0 != fwrite32(writer->index_f, INDEX_VERSION))
+        status = -1;
+    char channel[1000];
+    lcm_eventlog_event_t le;
+    le.channel = channel;
+    while (status == 0 && 0 == read_event_header(l, &le)) {
+        int64_t offset = ftello(l->f) - EVENT_HEADER_SIZE;
+        if (fread(channel, 1, le.channellen, l->f) != (size_t) le.channellen ||
+            0 != fseeko(l->f, le.datalen, SEEK_CUR))
+            break;
+        if (0 != write_index_records(writer, &le, offset))
+            status = -1;
+    }
+    if (0 != fclose(writer->index_f))
+        status = -1;
+    writer->index_f = NULL;
+
+    lcm_eventlog_destroy(l);
+    g_hash_table_destroy(writer->index_channels);
+    g_hash_table_destroy(writer->index_counts);
+    free(writer->path);
+    free(writer);
+    return status;
+}
+
+static inline int32_t read32(const uint8_t *p)
+{
+    return (int32_t) (((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) |
+                      (uint32_t) p[3]);
+}
+
+static inline int64_t read64(const uint8_t *p)
+{
+    return (int64_t) (((uint64_t) (uint32_t) read32(p) << 32) | (uint32_t) read32(p + 4));
+}
+
+// Checks that there's a whole event at the offset, returning the offset after
+// it and its number, or -1 if there isn't.
+static int64_t check_event_at(FILE *f, int64_t offset, int64_t size, int64_t *eventnum)
+{
+    uint8_t header[EVENT_HEADER_SIZE];
+    if (size - offset < EVENT_HEADER_SIZE || 0 != fseeko(f, offset, SEEK_SET) ||
+        fread(header, 1, EVENT_HEADER_SIZE, f) != EVENT_HEADER_SIZE || read32(header) != MAGIC)
+        return -1;
+    int32_t channellen = read32(header + 20);
+    int32_t datalen = read32(header + 24);
+    if (channellen <= 0 || channellen >= 1000 || datalen < 0)
+        return -1;
+    int64_t end = offset + EVENT_HEADER_SIZE + channellen + datalen;
+    if (end > size)
+        return -1;
+    *eventnum = read64(header + 4);
+    return end;
+}
+
+// Checks that the end of the log file from the offset is what's left by a
+// write that didn't finish:  the start of an event, or zeros, which some file
+// systems leave where data wasn't written.
+static int is_partial_tail(FILE *f, int64_t offset, int64_t size)
+{
+    uint8_t header[EVENT_HEADER_SIZE];
+    size_t len = (size_t) MIN(size - offset, EVENT_HEADER_SIZE);
+    if (0 != fseeko(f, offset, SEEK_SET) || fread(header, 1, len, f) != len)
+        return 0;
+    uint8_t magic[4];
+    write32(magic, MAGIC);
+    if (0 == memcmp(header, magic, MIN(len, 4))) {
+        if (len < EVENT_HEADER_SIZE)
+            return 1;
+        int64_t end = offset + EVENT_HEADER_SIZE + (uint32_t) read32(header + 20) +
+                      (uint32_t) read32(header + 24);
+        return end > size;
+    }
+
+    fseeko(f, offset, SEEK_SET);
+    int c;
+    while ((c = getc(f)) == 0) {
+    }
+    return c == EOF;
+}
+
+// Reads the events from the offset, returning the offset after the last whole
+// one, with its number, if the rest of the log file is a partial tail, or -1
+// if there's no event at the offset or the events don't reach the end.
+static int64_t follow_events(FILE *f, int64_t offset, int64_t size, int64_t *eventnum)
+{
+    int64_t end = check_event_at(f, offset, size, eventnum);
+    if (end < 0)
+        return -1;
+    int64_t next_eventnum;
+    int64_t next;
+    while (end < size && (next = check_event_at(f, end, size, &next_eventnum)) >= 0) {
+        end = next;
+        *eventnum = next_eventnum;
+    }
+    return end == size || is_partial_tail(f, end, size) ? end : -1;
+}
+
+// Removes the records of the index for the events from the offset on.
+static int truncate_index(const char *path, int64_t offset)
+{
+    char *idx = index_path(path);
+    FILE *f = fopen(idx, "r+b");
+    free(idx);
+    if (f == NULL)
+        return 0;
+
+    int32_t magic, version;
+    int64_t keep = 0;
+    if (0 == fread32(f, &magic) && magic == INDEX_MAGIC && 0 == fread32(f, &version) &&
+        version >= 1 && version <= INDEX_VERSION) {
+        keep = 8;
+        int32_t type;
+        int64_t record_offset, ignored;
+        int32_t channellen;
+        while (0 == fread32(f, &type)) {
+            if (type == INDEX_TIME) {
+                if (0 != fread64(f, &ignored) || 0 != fread64(f, &ignored) ||
+                    0 != fread64(f, &record_offset))
+                    break;
+            } else if (type == INDEX_CHANNEL) {
+                if (0 != fread64(f, &record_offset) ||
+                    (version >= 2 && 0 != fread64(f, &ignored)) || 0 != fread32(f, &channellen) ||
+                    channellen <= 0 || channellen >= 1000 ||
+                    0 != fseeko(f, channellen, SEEK_CUR))
+                    break;
+            } else {
+                break;
+            }
+            if (record_offset >= offset)
+                break;
+            keep = ftello(f);
+        }
+    }
+    fflush(f);
+#ifdef WIN32
+    int status = _chsize_s(_fileno(f), keep) == 0 ? 0 : -1;
+#else
+    int status = ftruncate(fileno(f), keep);
+#endif
+    fclose(f);
+    return status;
+}
+
+int64_t lcm_eventlog_recover(const char *path, int64_t *next_eventnum)
+{
+    FILE *f = fopen(path, "r+b");
+    if (f == NULL) {
+        fprintf(stderr, "Error: Unable to open log file %s\n", path);
+        return -1;
+    }
+    fseeko(f, 0, SEEK_END);
+    int64_t size = ftello(f);
+
+    // The events are read from the last record of the index that matches the
+    // log file, which is at most about a megabyte from its end.
+    int64_t eventnum = -1;
+    int64_t end = size == 0 ? 0 : -1;
+    eventlog_impl_t *impl = (eventlog_impl_t *) calloc(1, sizeof(eventlog_impl_t));
+    impl->path = strdup(path);
+    load_index(impl);
+    for (int i = impl->num_entries - 1; end < 0 && i >= 0; i--) {
+        const index_entry_t *entry = &impl->entries[i];
+        int64_t entry_eventnum;
+        if (entry->offset >= size || check_event_at(f, entry->offset, size, &entry_eventnum) < 0 ||
+            entry_eventnum != entry->eventnum)
+            continue;
+        end = follow_events(f, entry->offset, size, &eventnum);
+        break;
+    }
+    free_index(impl);
+    free(impl->path);
+    free(impl);
+
+    // Otherwise, the end of the log file is searched backwards for the magic of
+    // an event that the rest of the events follow from.
+    uint8_t *chunk = (uint8_t *) malloc(RECOVER_CHUNK_SIZE + 3);
+    int64_t chunk_end = size;
+    while (end < 0 && chunk_end > 0) {
+        int64_t chunk_start = MAX(chunk_end - RECOVER_CHUNK_SIZE, 0);
+        size_t len = (size_t) (MIN(chunk_end + 3, size) - chunk_start);
+        if (0 != fseeko(f, chunk_start, SEEK_SET) || fread(chunk, 1, len, f) != len)
+            break;
+        for (int64_t i = chunk_end - chunk_start - 1; end < 0 && i >= 0; i--) {
+            if ((size_t) i + 4 <= len && read32(chunk + i) == MAGIC)
+                end = follow_events(f, chunk_start + i, size, &eventnum);
+        }
+        chunk_end = chunk_start;
+    }
+    free(chunk);
+    // a log file whose only event is incomplete has no events left
+    if (end < 0 && is_partial_tail(f, 0, size))
+        end = 0;
+    if (end < 0) {
+        fprintf(stderr, "Error: No events found at the end of log file %s\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    int status = 0;
+    if (end < size) {
+        fflush(f);
+#ifdef WIN32
+        status = _chsize_s(_fileno(f), end) == 0 ? 0 : -1;
+#else
+        status = ftruncate(fileno(f), end);
+#endif
+    }
+    if (0 != fclose(f) || status != 0 || 0 != truncate_index(path, end)) {
+        fprintf(stderr, "Error: Unable to truncate log file %s\n", path);
+        return -1;
+    }
+    if (next_eventnum)
+        *next_eventnum = eventnum + 1;
+    return size - end;
+}
+
+lcm_eventlog_mmap_t *lcm_eventlog_mmap_open(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return NULL;
+    fseeko(f, 0, SEEK_END);
+    off_t file_len = ftello(f);
+    if (file_len < 0 || (uint64_t) file_len > (size_t) -1) {
+        fprintf(stderr, "Error: Unable to map log file %s\n", path);
+        fclose(f);
+        return NULL;
+    }
+
+    lcm_eventlog_mmap_t *log = (lcm_eventlog_mmap_t *) calloc(1, sizeof(lcm_eventlog_mmap_t));
+    log->size = (size_t) file_len;
+    if (log->size > 0) {
+#ifdef WIN32
+        // no mapping, the whole file is read in instead
+        uint8_t *data = (uint8_t *) malloc(log->size);
+        fseeko(f, 0, SEEK_SET);
+        if (fread(data, 1, log->size, f) != log->size) {
+            fprintf(stderr, "Error: Unable to read log file %s\n", path);
+            free(data);
+            free(log);
+            fclose(f);
+            return NULL;
+        }
+#else
+        void *data = mmap(NULL, log->size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+        if (data == MAP_FAILED) {
+            perror("lcm_eventlog_mmap_open -- mmap");
+            free(log);
+            fclose(f);
+            return NULL;
+        }
+#ifdef MADV_SEQUENTIAL
+        // read ahead aggressively, and drop the pages that have been read
+        madvise(data, log->size, MADV_SEQUENTIAL);
+#endif
+#endif
+        log->data = (const uint8_t *) data;
+    }
+    // the mapping stays valid after the file is closed
+    fclose(f);
+    return log;
+}
+
+// Finds the first magic at or after pos with room for a whole header after it,
+// returning its offset, or -1 if there's none.  Only its first byte is searched
+// for.
+static int64_t find_magic(const lcm_eventlog_mmap_t *log, size_t pos)
+{
+    const uint8_t *data = log->data;
+    size_t size = log->size;
+    for (;;) {
+        if (pos > size || size - pos < EVENT_HEADER_SIZE)
+            return -1;
+        const uint8_t *p = (const uint8_t *) memchr(data + pos, (uint32_t) MAGIC >> 24,
+                                                    size - pos - EVENT_HEADER_SIZE + 1);
+        if (p == NULL)
+            return -1;
+        pos = (size_t) (p - data);
+        if (read32(p) == MAGIC)
+            return (int64_t) pos;
+        pos++;
+    }
+}
+
+// Reads the event at pos, whose magic has been checked, into view, or returns
+// -1 if it isn't valid, saying why if verbose is set.
+static int view_at(const lcm_eventlog_mmap_t *log, size_t pos, lcm_eventlog_view_t *view,
+                   int verbose)
+{
+    const uint8_t *data = log->data;
+    size_t size = log->size;
+    const uint8_t *header = data + pos;
+    int32_t channellen = read32(header + 20);
+    int32_t datalen = read32(header + 24);
+
+    // Sanity check the channel length and data length
+    if (channellen <= 0 || channellen >= 1000) {
+        if (verbose)
+            fprintf(stderr, "Log event has invalid channel length: %d\n", channellen);
+        return -1;
+    }
+    if (datalen < 0) {
+        if (verbose)
+            fprintf(stderr, "Log event has invalid data length: %d\n", datalen);
+        return -1;
+    }
+    size_t left = size - pos - EVENT_HEADER_SIZE;
+    if ((size_t) channellen > left || (size_t) datalen > left - channellen)
+        return -1;
+
+    // Check that there's a valid event or the EOF after this event.
+    size_t end = pos + EVENT_HEADER_SIZE + channellen + datalen;
+    if (size - end >= 4 && read32(data + end) != MAGIC) {
+        if (verbose)
+            fprintf(stderr, "Invalid header after log data\n");
+        return -1;
+    }
+
+    view->eventnum = read64(header + 4);
+    view->timestamp = read64(header + 12);
+    view->channellen = channellen;
+    view->datalen = datalen;
+    view->channel = (const char *) header + EVENT_HEADER_SIZE;
+    view->data = header + EVENT_HEADER_SIZE + channellen;
+    view->offset = (int64_t) pos;
+    return 0;
+}
+
+int lcm_eventlog_next_view(const lcm_eventlog_mmap_t *log, lcm_eventlog_view_t *view)
+{
+    uint64_t next = (uint64_t) view->offset;
+    if (view->offset < 0)
+        return -1;
+    if (view->channel)
+        next += EVENT_HEADER_SIZE + (uint32_t) view->channellen + (uint32_t) view->datalen;
+    if (next > log->size)
+        return -1;
+
+    int64_t pos = find_magic(log, (size_t) next);
+    if (pos < 0)
+        return -1;
+    return view_at(log, (size_t) pos, view, 1);
+}
+
+int lcm_eventlog_find_view(const lcm_eventlog_mmap_t *log, int64_t offset,
+                           lcm_eventlog_view_t *view)
+{
+    if (offset < 0)
+        return -1;
+    int64_t pos = offset;
+    while ((pos = find_magic(log, (size_t) pos)) >= 0) {
+        if (0 == view_at(log, (size_t) pos, view, 0))
+            return 0;
+        pos++;
+    }
+    return -1;
+}
+
+void lcm_eventlog_mmap_close(lcm_eventlog_mmap_t *log)
+{
+    if (log->size > 0) {
+#ifdef WIN32
+        free((void *) log->data);
+#else
+        munmap((void *) log->data, log->size);
+#endif
+    }
+    free(log);
+}
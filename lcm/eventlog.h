@@ -18,10 +18,41 @@ extern "C" {
 
 #define lcm_eventlog_create LCM_C_NAMESPACED(eventlog_create)
 #define lcm_eventlog_read_next_event LCM_C_NAMESPACED(eventlog_read_next_event)
+#define lcm_eventlog_read_next_event_into LCM_C_NAMESPACED(eventlog_read_next_event_into)
+#define lcm_eventlog_set_channel_filter LCM_C_NAMESPACED(eventlog_set_channel_filter)
 #define lcm_eventlog_free_event LCM_C_NAMESPACED(eventlog_free_event)
 #define lcm_eventlog_seek_to_timestamp LCM_C_NAMESPACED(eventlog_seek_to_timestamp)
+#define lcm_eventlog_seek_to_eventnum LCM_C_NAMESPACED(eventlog_seek_to_eventnum)
+#define lcm_eventlog_cursor_create LCM_C_NAMESPACED(eventlog_cursor_create)
+#define lcm_eventlog_cursor_seek LCM_C_NAMESPACED(eventlog_cursor_seek)
+#define lcm_eventlog_cursor_tell LCM_C_NAMESPACED(eventlog_cursor_tell)
+#define lcm_eventlog_cursor_next LCM_C_NAMESPACED(eventlog_cursor_next)
+#define lcm_eventlog_cursor_destroy LCM_C_NAMESPACED(eventlog_cursor_destroy)
 #define lcm_eventlog_write_event LCM_C_NAMESPACED(eventlog_write_event)
+#define lcm_eventlog_write_events LCM_C_NAMESPACED(eventlog_write_events)
+#define lcm_eventlog_write_numbered_events LCM_C_NAMESPACED(eventlog_write_numbered_events)
 #define lcm_eventlog_destroy LCM_C_NAMESPACED(eventlog_destroy)
+#define lcm_eventlog_write_index LCM_C_NAMESPACED(eventlog_write_index)
+#define lcm_eventlog_build_index LCM_C_NAMESPACED(eventlog_build_index)
+#define lcm_eventlog_recover LCM_C_NAMESPACED(eventlog_recover)
+#define lcm_eventlog_mmap_open LCM_C_NAMESPACED(eventlog_mmap_open)
+#define lcm_eventlog_next_view LCM_C_NAMESPACED(eventlog_next_view)
+#define lcm_eventlog_find_view LCM_C_NAMESPACED(eventlog_find_view)
+#define lcm_eventlog_mmap_close LCM_C_NAMESPACED(eventlog_mmap_close)
+#define lcm_blocklog_create LCM_C_NAMESPACED(blocklog_create)
+#define lcm_blocklog_detect LCM_C_NAMESPACED(blocklog_detect)
+#define lcm_blocklog_write_event LCM_C_NAMESPACED(blocklog_write_event)
+#define lcm_blocklog_set_channel_filter LCM_C_NAMESPACED(blocklog_set_channel_filter)
+#define lcm_blocklog_read_next_event LCM_C_NAMESPACED(blocklog_read_next_event)
+#define lcm_blocklog_seek_to_timestamp LCM_C_NAMESPACED(blocklog_seek_to_timestamp)
+#define lcm_blocklog_destroy LCM_C_NAMESPACED(blocklog_destroy)
+#define lcm_eventlog_merge_detect LCM_C_NAMESPACED(eventlog_merge_detect)
+#define lcm_eventlog_merge_open LCM_C_NAMESPACED(eventlog_merge_open)
+#define lcm_eventlog_merge_open_files LCM_C_NAMESPACED(eventlog_merge_open_files)
+#define lcm_eventlog_merge_next LCM_C_NAMESPACED(eventlog_merge_next)
+#define lcm_eventlog_merge_seek_to_timestamp LCM_C_NAMESPACED(eventlog_merge_seek_to_timestamp)
+#define lcm_eventlog_merge_set_channel_filter LCM_C_NAMESPACED(eventlog_merge_set_channel_filter)
+#define lcm_eventlog_merge_close LCM_C_NAMESPACED(eventlog_merge_close)
 
 /**
  * @defgroup LcmC_lcm_eventlog_t lcm_eventlog_t
@@ -107,6 +138,28 @@ lcm_eventlog_t *lcm_eventlog_create(const char *path, const char *mode);
 LCM_EXPORT
 lcm_eventlog_event_t *lcm_eventlog_read_next_event(lcm_eventlog_t *eventlog);
 
+/**
+ * Read the next event in the log file into @p event, reusing its buffer.
+ * Valid in read mode only.
+ *
+ * The channel and data of @p event share one buffer of @p capacity bytes,
+ * which @c channel points to.  It's grown with realloc() only when an event
+ * doesn't fit, so reading the events of a log file into the same event
+ * allocates only a few times.  Start with a zeroed event and a capacity of
+ * zero, and free(event->channel) after use, instead of calling
+ * lcm_eventlog_free_event().
+ *
+ * @param eventlog The log file object
+ * @param event The event to read into
+ * @param capacity The size of the buffer of @p event, updated when it grows
+ *
+ * @return 0 on success.  Returns -1 when the end of the file has been reached
+ * or when invalid data is read.
+ */
+LCM_EXPORT
+int lcm_eventlog_read_next_event_into(lcm_eventlog_t *eventlog, lcm_eventlog_event_t *event,
+                                      size_t *capacity);
+
 /**
  * Free a structure returned by lcm_eventlog_read_next_event().
  *
@@ -115,9 +168,31 @@ lcm_eventlog_event_t *lcm_eventlog_read_next_event(lcm_eventlog_t *eventlog);
 LCM_EXPORT
 void lcm_eventlog_free_event(lcm_eventlog_event_t *event);
 
+/**
+ * Read only the events on channels that @p wanted returns nonzero for, with
+ * lcm_eventlog_read_next_event() and lcm_eventlog_read_next_event_into().
+ * The data of the other events is skipped without being read.  If the log
+ * file has an index, the stretches of the log file without wanted channels
+ * that it lists are skipped too.  The filter is called for each event, so
+ * the channels that it wants may change as the log file is read.
+ *
+ * @param eventlog The log file object
+ * @param wanted The filter, or NULL to read every event
+ * @param user Passed to @p wanted
+ */
+LCM_EXPORT
+void lcm_eventlog_set_channel_filter(lcm_eventlog_t *eventlog,
+                                     int (*wanted)(const char *channel, void *user), void *user);
+
 /**
  * Seek (approximately) to a particular timestamp.
  *
+ * If the log file has an index, the file @c path.idx written by
+ * lcm_eventlog_write_index() or lcm_eventlog_build_index(), the seek is to
+ * the first event at or after the timestamp, and reads at most about a
+ * megabyte of the log file.  Otherwise, or if the index doesn't match the log
+ * file, it bisects the log file.
+ *
  * @param eventlog The log file object
  * @param ts Timestamp of the target event in the log file.
  *
@@ -126,6 +201,88 @@ void lcm_eventlog_free_event(lcm_eventlog_event_t *event);
 LCM_EXPORT
 int lcm_eventlog_seek_to_timestamp(lcm_eventlog_t *eventlog, int64_t ts);
 
+/**
+ * Seek to the event with a particular event number, or to the first event
+ * after it if there's none.
+ *
+ * If the log file has an index, this reads at most about a megabyte of the
+ * log file, like lcm_eventlog_seek_to_timestamp().  Otherwise, or if the
+ * index doesn't match the log file, it bisects the log file.
+ *
+ * @param eventlog The log file object
+ * @param eventnum Event number of the target event in the log file
+ *
+ * @return 0 on success, -1 if no event has that number or a later one
+ */
+LCM_EXPORT
+int lcm_eventlog_seek_to_eventnum(lcm_eventlog_t *eventlog, int64_t eventnum);
+
+/**
+ * A position among the events on one channel of a log file, returned by
+ * lcm_eventlog_cursor_create().
+ */
+typedef struct _lcm_eventlog_cursor_t lcm_eventlog_cursor_t;
+
+/**
+ * Create a cursor that reads the events on one channel of a log file, from
+ * the first.  Valid in read mode only.
+ *
+ * The cursor reads through the log file object, and moves it to the event
+ * after the last one that it read, but keeps its own position between calls.
+ * It uses the index of the log file, if it has one written from its first
+ * event on, to find the nth event on the channel without reading the events
+ * before it.
+ *
+ * @param eventlog The log file object, which has to outlive the cursor
+ * @param channel The channel of the events
+ *
+ * @return a newly allocated cursor, to be freed with
+ * lcm_eventlog_cursor_destroy()
+ */
+LCM_EXPORT
+lcm_eventlog_cursor_t *lcm_eventlog_cursor_create(lcm_eventlog_t *eventlog, const char *channel);
+
+/**
+ * Move a cursor to the nth event on its channel, counting from 0, so that
+ * lcm_eventlog_cursor_next() returns that event.
+ *
+ * @param cursor The cursor
+ * @param n The number of events on the channel before the target event
+ *
+ * @return 0 on success, or -1 if the channel has n events or fewer, in which
+ * case the cursor doesn't move.
+ */
+LCM_EXPORT
+int lcm_eventlog_cursor_seek(lcm_eventlog_cursor_t *cursor, int64_t n);
+
+/**
+ * @param cursor The cursor
+ *
+ * @return the number of events on the channel before the one that
+ * lcm_eventlog_cursor_next() returns next.
+ */
+LCM_EXPORT
+int64_t lcm_eventlog_cursor_tell(const lcm_eventlog_cursor_t *cursor);
+
+/**
+ * Read the next event on the channel of a cursor.  Free the returned
+ * structure with lcm_eventlog_free_event() after use.
+ *
+ * @param cursor The cursor
+ *
+ * @return the event, or NULL at the end of the log file.
+ */
+LCM_EXPORT
+lcm_eventlog_event_t *lcm_eventlog_cursor_next(lcm_eventlog_cursor_t *cursor);
+
+/**
+ * Free a cursor.
+ *
+ * @param cursor The cursor
+ */
+LCM_EXPORT
+void lcm_eventlog_cursor_destroy(lcm_eventlog_cursor_t *cursor);
+
 /**
  * Write an event into a log file.  Valid in write mode only.
  *
@@ -138,6 +295,89 @@ int lcm_eventlog_seek_to_timestamp(lcm_eventlog_t *eventlog, int64_t ts);
 LCM_EXPORT
 int lcm_eventlog_write_event(lcm_eventlog_t *eventlog, lcm_eventlog_event_t *event);
 
+/**
+ * Write several events into a log file, with as few system calls as possible
+ * and without copying them.  Valid in write mode only.  The events are
+ * written after any that were written with lcm_eventlog_write_event(), which
+ * is flushed first, and have been passed to the operating system on
+ * return.
+ *
+ * @param eventlog The log file object
+ * @param events The events to write to the file.  On return, the eventnum
+ * field of each will be filled in for you.
+ * @param num_events The number of events
+ *
+ * @return 0 on success, -1 on failure, in which case only some of the events
+ * may have been written.
+ */
+LCM_EXPORT
+int lcm_eventlog_write_events(lcm_eventlog_t *eventlog, lcm_eventlog_event_t *const *events,
+                              int num_events);
+
+/**
+ * Like lcm_eventlog_write_events(), but keep the eventnum of each event, so
+ * that the events of several log files can be numbered together.  The
+ * numbers should increase.
+ *
+ * @param eventlog The log file object
+ * @param events The events to write to the file
+ * @param num_events The number of events
+ *
+ * @return 0 on success, -1 on failure, in which case only some of the events
+ * may have been written.
+ */
+LCM_EXPORT
+int lcm_eventlog_write_numbered_events(lcm_eventlog_t *eventlog,
+                                       lcm_eventlog_event_t *const *events, int num_events);
+
+/**
+ * Write an index of the log file alongside it, to the file @c path.idx, as
+ * events are written.  Valid in write or append mode only.  The index holds
+ * the timestamp and offset of an event for every megabyte of the log file,
+ * and the offsets of the first events on each channel in between, so that
+ * lcm_eventlog_seek_to_timestamp(), lcm_eventlog_seek_to_eventnum() and
+ * lcm_eventlog_cursor_seek() don't need to search the log file.  The
+ * positions of the events on each channel are only indexed if the index is
+ * written from the first event of the log file on.
+ *
+ * @param eventlog The log file object
+ *
+ * @return 0 on success, -1 on failure.
+ */
+LCM_EXPORT
+int lcm_eventlog_write_index(lcm_eventlog_t *eventlog);
+
+/**
+ * Write the index of an existing log file, replacing the file @c path.idx.
+ *
+ * @param path Log file to index
+ *
+ * @return 0 on success, -1 on failure.
+ * @sa lcm_eventlog_write_index()
+ */
+LCM_EXPORT
+int lcm_eventlog_build_index(const char *path);
+
+/**
+ * Recover a log file that wasn't closed cleanly, such as by a logger that
+ * crashed, so that it can be read to the end and appended to.  The event that
+ * was being written when it stopped, if any, is removed from the end of the
+ * log file, and so are the records of the index after the last whole event.
+ *
+ * The last whole event is found from the last record of the index, or by
+ * searching backwards from the end of the log file, so recovering a large
+ * log file doesn't read all of it.
+ *
+ * @param path Log file to recover
+ * @param next_eventnum If not NULL, set to the number of the last event plus
+ * one, or to 0 if no events are left, on success
+ *
+ * @return the number of bytes removed, or -1 on failure, including when the
+ * end of the log file isn't a valid event.
+ */
+LCM_EXPORT
+int64_t lcm_eventlog_recover(const char *path, int64_t *next_eventnum);
+
 /**
  * Close a log file and release allocated resources.
  *
@@ -146,6 +386,280 @@ int lcm_eventlog_write_event(lcm_eventlog_t *eventlog, lcm_eventlog_event_t *eve
 LCM_EXPORT
 void lcm_eventlog_destroy(lcm_eventlog_t *eventlog);
 
+/**
+ * A log file mapped into memory for reading, returned by
+ * lcm_eventlog_mmap_open().
+ */
+typedef struct _lcm_eventlog_mmap_t lcm_eventlog_mmap_t;
+
+/**
+ * An event (message) in a log file mapped into memory.  The channel and data
+ * point into the mapping, and are valid until it's closed.
+ */
+typedef struct _lcm_eventlog_view_t lcm_eventlog_view_t;
+struct _lcm_eventlog_view_t {
+    /**
+     * The number of the event in the log file.
+     */
+    int64_t eventnum;
+    /**
+     * Time that the message was received, in microseconds since the UNIX
+     * epoch
+     */
+    int64_t timestamp;
+    /**
+     * Length of @c channel, in bytes
+     */
+    int32_t channellen;
+    /**
+     * Length of @c data, in bytes
+     */
+    int32_t datalen;
+    /**
+     * Channel that the message was received on.  Not NUL-terminated.
+     */
+    const char *channel;
+    /**
+     * Raw byte buffer containing the message payload.
+     */
+    const void *data;
+    /**
+     * Offset of the event in the log file.
+     */
+    int64_t offset;
+};
+
+/**
+ * Map a log file into memory for reading, without copying the events.
+ *
+ * @param path Log file to open
+ *
+ * @return a newly allocated lcm_eventlog_mmap_t, or NULL on failure.
+ */
+LCM_EXPORT
+lcm_eventlog_mmap_t *lcm_eventlog_mmap_open(const char *path);
+
+/**
+ * Read the event after @p view into it.  If the channel of @p view is NULL,
+ * as it is in a zeroed view, read the first event at or after its offset
+ * instead, so a zeroed view reads the first event in the log file.
+ *
+ * @param log The mapped log file
+ * @param view The previous event, and the next one on return
+ *
+ * @return 0 on success.  Returns -1 when the end of the file has been reached
+ * or when invalid data is read.
+ */
+LCM_EXPORT
+int lcm_eventlog_next_view(const lcm_eventlog_mmap_t *log, lcm_eventlog_view_t *view);
+
+/**
+ * Read the first valid event at or after an offset into @p view, skipping
+ * anything that only looks like the start of an event, such as part of the data
+ * of an event before it.  Events can be read from any offset this way, such as
+ * by threads that each read part of a log file.
+ *
+ * @param log The mapped log file
+ * @param offset The offset to start at
+ * @param view The event on return
+ *
+ * @return 0 on success, or -1 if there's no valid event after @p offset.
+ */
+LCM_EXPORT
+int lcm_eventlog_find_view(const lcm_eventlog_mmap_t *log, int64_t offset,
+                           lcm_eventlog_view_t *view);
+
+/**
+ * Unmap a log file and release allocated resources.
+ *
+ * @param log The mapped log file
+ */
+LCM_EXPORT
+void lcm_eventlog_mmap_close(lcm_eventlog_mmap_t *log);
+
+/**
+ * A log file in the block format, returned by lcm_blocklog_create().  Its
+ * events are grouped into blocks that are compressed separately, and each
+ * block lists its channels, so a reader can skip the blocks that it doesn't
+ * want without decompressing them.
+ */
+typedef struct _lcm_blocklog_t lcm_blocklog_t;
+
+/**
+ * Open a block log file for reading or writing.
+ *
+ * @param path Log file to open
+ * @param mode "r" (read) or "w" (write)
+ *
+ * @return a newly allocated lcm_blocklog_t, or NULL on failure.
+ */
+LCM_EXPORT
+lcm_blocklog_t *lcm_blocklog_create(const char *path, const char *mode);
+
+/**
+ * Check whether a file is a block log, rather than a log in the original
+ * format.
+ *
+ * @param path File to check
+ *
+ * @return 1 if it's a block log, or 0 if it isn't or can't be read.
+ */
+LCM_EXPORT
+int lcm_blocklog_detect(const char *path);
+
+/**
+ * Write an event to a block log.  The event is written with the block that
+ * it's in, when the block is full or the log is destroyed.
+ *
+ * @param log The log file object
+ * @param event The event to write.  Its event number is set.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+LCM_EXPORT
+int lcm_blocklog_write_event(lcm_blocklog_t *log, lcm_eventlog_event_t *event);
+
+/**
+ * Read only the blocks that have a channel that @p wanted returns nonzero
+ * for.  Other events in those blocks are still returned.  The filter is
+ * called when each block is read, which can be before its events are
+ * returned.
+ *
+ * @param log The log file object
+ * @param wanted The filter, or NULL to read every block
+ * @param user Passed to @p wanted
+ */
+LCM_EXPORT
+void lcm_blocklog_set_channel_filter(lcm_blocklog_t *log,
+                                     int (*wanted)(const char *channel, void *user), void *user);
+
+/**
+ * Read the next event in a block log.  The blocks after it are decompressed
+ * by other threads in the meantime.
+ *
+ * @param log The log file object
+ *
+ * @return the event, which is valid until the next call, or NULL when the
+ * end of the file has been reached or when invalid data is read.
+ */
+LCM_EXPORT
+const lcm_eventlog_event_t *lcm_blocklog_read_next_event(lcm_blocklog_t *log);
+
+/**
+ * Seek to the first event at or after a timestamp, or the end of the
+ * file, using the block index.
+ *
+ * @param log The log file object
+ * @param timestamp The timestamp to seek to, in microseconds since the UNIX
+ * epoch
+ *
+ * @return 0 on success, -1 on failure.
+ */
+LCM_EXPORT
+int lcm_blocklog_seek_to_timestamp(lcm_blocklog_t *log, int64_t timestamp);
+
+/**
+ * Close a block log and release allocated resources.  A log being written is
+ * finished with its block index.
+ *
+ * @param log The log file object
+ */
+LCM_EXPORT
+void lcm_blocklog_destroy(lcm_blocklog_t *log);
+
+/**
+ * Log files that are read as one, in order of their events' timestamps,
+ * returned by lcm_eventlog_merge_open() or lcm_eventlog_merge_open_files().
+ * They're listed by a manifest, like the one that lcm-logger writes when it
+ * shards a log:  a text file whose first line is "LCM-SHARDS 1", followed by a
+ * line for each log file.  Each line is the path of the log file, relative to
+ * the manifest unless it's absolute, optionally followed by a tab and anything
+ * else.  Only the next event of each log file is kept in memory.
+ */
+typedef struct _lcm_eventlog_merge_t lcm_eventlog_merge_t;
+
+/**
+ * Check whether a file is a manifest of log files.
+ *
+ * @param path File to check
+ *
+ * @return 1 if it's a manifest, or 0 if it isn't or can't be read.
+ */
+LCM_EXPORT
+int lcm_eventlog_merge_detect(const char *path);
+
+/**
+ * Open the log files listed by a manifest for reading.
+ *
+ * @param path The manifest
+ *
+ * @return a newly allocated lcm_eventlog_merge_t, or NULL on failure.
+ */
+LCM_EXPORT
+lcm_eventlog_merge_t *lcm_eventlog_merge_open(const char *path);
+
+/**
+ * Open log files for reading as one, such as logs recorded separately at the
+ * same time.  Unlike the shards of a log listed by a manifest, their events
+ * are renumbered in the order that they're read in, from 0.
+ *
+ * @param paths The log files
+ * @param num_paths The number of log files
+ *
+ * @return a newly allocated lcm_eventlog_merge_t, or NULL on failure.
+ */
+LCM_EXPORT
+lcm_eventlog_merge_t *lcm_eventlog_merge_open_files(const char *const *paths, int num_paths);
+
+/**
+ * Read the next event of the log files, the one with the lowest timestamp,
+ * and then the lowest event number.
+ *
+ * @param merge The log files
+ *
+ * @return the event, which is valid until the next call, or NULL when the
+ * end of every file has been reached.
+ */
+LCM_EXPORT
+const lcm_eventlog_event_t *lcm_eventlog_merge_next(lcm_eventlog_merge_t *merge);
+
+/**
+ * Seek each log file to a timestamp, as lcm_eventlog_seek_to_timestamp()
+ * does.  If the events are renumbered, then the next event is numbered by the
+ * events before it, assuming that each log file numbers its events
+ * consecutively.
+ *
+ * @param merge The log files
+ * @param timestamp The timestamp to seek to, in microseconds since the UNIX
+ * epoch
+ *
+ * @return 0 on success, -1 on failure.
+ */
+LCM_EXPORT
+int lcm_eventlog_merge_seek_to_timestamp(lcm_eventlog_merge_t *merge, int64_t timestamp);
+
+/**
+ * Read only the events on channels that @p wanted returns nonzero for, as
+ * lcm_eventlog_set_channel_filter() does for each log file.  The next event
+ * of each log file may already have been read.
+ *
+ * @param merge The log files
+ * @param wanted The filter, or NULL to read every event
+ * @param user Passed to @p wanted
+ */
+LCM_EXPORT
+void lcm_eventlog_merge_set_channel_filter(lcm_eventlog_merge_t *merge,
+                                           int (*wanted)(const char *channel, void *user),
+                                           void *user);
+
+/**
+ * Close the log files and release allocated resources.
+ *
+ * @param merge The log files
+ */
+LCM_EXPORT
+void lcm_eventlog_merge_close(lcm_eventlog_merge_t *merge);
+
 /**
  * @}
  */
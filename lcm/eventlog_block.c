@@ -0,0 +1,675 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <glib.h>
+#ifdef LCM_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#include "eventlog.h"
+#include "ioutils.h"
+
+#ifdef _MSC_VER
+#define fseeko _fseeki64
+#define ftello _ftelli64
+#endif
+
+// A block log starts with BLOCK_LOG_MAGIC and BLOCK_LOG_VERSION, followed by
+// blocks of events, and then a footer.  All integers are big-endian, as in
+// the legacy log format.
+//
+// Each block has a header:
+//
+//   int32 BLOCK_MAGIC, int32 compression, int32 compressed size,
+//   int32 uncompressed size, int32 number of events, int64 first event
+//   number, int64 first timestamp, int64 last timestamp,
+//   int32 number of new channels, and for each one, int32 length, channel,
+//   int32 size of the channel bitmap, channel bitmap
+//
+// Channels are numbered in the order that they're first logged, and each
+// block lists the channels that first appear in it.  Bit i of the bitmap is
+// set if channel i is in the block.  The header is followed by the events,
+// compressed as a whole, each of them:
+//
+//   int64 timestamp, int32 channel number, int32 data length, data
+//
+// The footer, which lets a reader find the blocks without reading all of
+// their headers, is:
+//
+//   int32 FOOTER_MAGIC, int32 number of channels, and for each one,
+//   int32 length, channel, int32 number of blocks, and for each one,
+//   int64 offset, int64 first timestamp, int64 first event number,
+//   int64 offset of the footer, int32 TRAILER_MAGIC
+//
+// A log without a footer, because the writer didn't finish, is read by
+// scanning the block headers instead.
+#define BLOCK_LOG_MAGIC ((int32_t) 0xEDA1DA02L)
+#define BLOCK_LOG_VERSION 1
+#define BLOCK_MAGIC ((int32_t) 0xEDA1DB01L)
+#define FOOTER_MAGIC ((int32_t) 0xEDA1DF01L)
+#define TRAILER_MAGIC ((int32_t) 0xEDA1DF02L)
+
+#define COMPRESSION_NONE 0
+#define COMPRESSION_LZ4 1
+
+// events are grouped into blocks of about this many bytes, uncompressed
+#define BLOCK_SIZE (1 << 20)
+// the timestamp, channel number and data length of an event in a block
+#define BLOCK_EVENT_HEADER_SIZE 16
+#define MAX_CHANNEL_LENGTH 1000
+// the most threads that decompress blocks ahead of the reader
+#define MAX_DECOMPRESS_THREADS 4
+
+typedef struct {
+    int64_t offset;
+    int64_t first_timestamp;
+    int64_t first_eventnum;
+} block_entry_t;
+
+typedef struct {
+    int32_t compression;
+    int32_t compressed_size;
+    int32_t uncompressed_size;
+    int32_t num_events;
+    int64_t first_eventnum;
+    int64_t first_timestamp;
+} block_header_t;
+
+// A block that's read, and decompressed by a worker thread.
+typedef struct {
+    block_header_t header;
+    char *compressed;
+    char *data;
+    // 0 while it's decompressed, then 1, or -1 if it's invalid
+    int status;
+} block_job_t;
+
+struct _lcm_blocklog_t {
+    FILE *f;
+    int writing;
+    // the channels by number
+    GPtrArray *channels;
+    GArray *blocks;
+    // the channel bitmap of the last block header read or written
+    GByteArray *bitmap;
+
+    // writing
+    int64_t offset;
+    int64_t eventcount;
+    GHashTable *channel_numbers;
+    GByteArray *block;
+    int32_t block_events;
+    int64_t block_first_eventnum;
+    int64_t block_first_timestamp;
+    int64_t block_last_timestamp;
+    // the channels numbered from this one are new in the block
+    unsigned int block_new_channels;
+
+    // reading
+    int (*filter)(const char *channel, void *user);
+    void *filter_user;
+    // the next block to read
+    unsigned int next_block;
+    // the blocks read ahead, in order, as a ring
+    block_job_t *pending[2 * MAX_DECOMPRESS_THREADS];
+    int pending_start;
+    int num_pending;
+    int max_pending;
+    block_job_t *cur;
+    int32_t cur_event;
+    int32_t cur_pos;
+    lcm_eventlog_event_t event;
+    // the event was read by seeking, and is returned by the next read
+    int peeked;
+
+    GThread *workers[MAX_DECOMPRESS_THREADS];
+    int num_workers;
+    GAsyncQueue *jobs;
+    GMutex mutex;
+    GCond cond;
+};
+
+static void append32(GByteArray *a, int32_t v)
+{
+    uint8_t b[4] = {(uint8_t) ((uint32_t) v >> 24), (uint8_t) ((uint32_t) v >> 16),
+                    (uint8_t) ((uint32_t) v >> 8), (uint8_t) v};
+    g_byte_array_append(a, b, 4);
+}
+
+static void append64(GByteArray *a, int64_t v)
+{
+    append32(a, (int32_t) ((uint64_t) v >> 32));
+    append32(a, (int32_t) (v & 0xffffffff));
+}
+
+static inline int32_t read32(const uint8_t *p)
+{
+    return (int32_t) (((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) |
+                      (uint32_t) p[3]);
+}
+
+static inline int64_t read64(const uint8_t *p)
+{
+    return (int64_t) (((uint64_t) (uint32_t) read32(p) << 32) | (uint32_t) read32(p + 4));
+}
+
+// Reads a channel of the footer or a block header, and adds it if add is
+// set.
+static int read_channel(lcm_blocklog_t *log, int add)
+{
+    int32_t len;
+    char channel[MAX_CHANNEL_LENGTH];
+    if (0 != fread32(log->f, &len) || len <= 0 || len >= MAX_CHANNEL_LENGTH ||
+        fread(channel, 1, len, log->f) != (size_t) len)
+        return -1;
+    if (add)
+        g_ptr_array_add(log->channels, g_strndup(channel, len));
+    return 0;
+}
+
+// Reads the header of a block into log->bitmap and the header, leaving the
+// file at the events.  The channels that are new in the block are added if
+// add_channels is set.
+static int read_block_header(lcm_blocklog_t *log, int64_t offset, block_header_t *h,
+                             int add_channels)
+{
+    int32_t magic, num_new_channels, bitmap_size;
+    int64_t last_timestamp;
+    if (0 != fseeko(log->f, offset, SEEK_SET) || 0 != fread32(log->f, &magic) ||
+        magic != BLOCK_MAGIC || 0 != fread32(log->f, &h->compression) ||
+        0 != fread32(log->f, &h->compressed_size) || 0 != fread32(log->f, &h->uncompressed_size) ||
+        0 != fread32(log->f, &h->num_events) || 0 != fread64(log->f, &h->first_eventnum) ||
+        0 != fread64(log->f, &h->first_timestamp) || 0 != fread64(log->f, &last_timestamp) ||
+        0 != fread32(log->f, &num_new_channels))
+        return -1;
+    if (h->compressed_size < 0 || h->uncompressed_size < 0 || h->num_events < 0 ||
+        num_new_channels < 0)
+        return -1;
+    for (int32_t i = 0; i < num_new_channels; i++) {
+        if (0 != read_channel(log, add_channels))
+            return -1;
+    }
+    if (0 != fread32(log->f, &bitmap_size) || bitmap_size < 0 || bitmap_size > BLOCK_SIZE)
+        return -1;
+    g_byte_array_set_size(log->bitmap, bitmap_size);
+    if (fread(log->bitmap->data, 1, bitmap_size, log->f) != (size_t) bitmap_size)
+        return -1;
+    return 0;
+}
+
+static int load_footer(lcm_blocklog_t *log)
+{
+    int64_t footer_offset;
+    int32_t magic, num_channels, num_blocks;
+    if (0 != fseeko(log->f, -12, SEEK_END))
+        return -1;
+    int64_t trailer_offset = ftello(log->f);
+    if (0 != fread64(log->f, &footer_offset) || 0 != fread32(log->f, &magic) ||
+        magic != TRAILER_MAGIC || footer_offset < 0 || footer_offset >= trailer_offset)
+        return -1;
+    if (0 != fseeko(log->f, footer_offset, SEEK_SET) || 0 != fread32(log->f, &magic) ||
+        magic != FOOTER_MAGIC || 0 != fread32(log->f, &num_channels) || num_channels < 0)
+        return -1;
+    for (int32_t i = 0; i < num_channels; i++) {
+        if (0 != read_channel(log, 1))
+            return -1;
+    }
+    if (0 != fread32(log->f, &num_blocks) || num_blocks < 0 ||
+        num_blocks > (trailer_offset - footer_offset) / 24)
+        return -1;
+    for (int32_t i = 0; i < num_blocks; i++) {
+        block_entry_t entry;
+        if (0 != fread64(log->f, &entry.offset) || 0 != fread64(log->f, &entry.first_timestamp) ||
+            0 != fread64(log->f, &entry.first_eventnum))
+            return -1;
+        g_array_append_val(log->blocks, entry);
+    }
+    return 0;
+}
+
+// Finds the blocks of a log that has no footer, up to the first one that's
+// incomplete or invalid.
+static void scan_blocks(lcm_blocklog_t *log)
+{
+    int64_t offset = 8;
+    block_header_t h;
+    while (0 == read_block_header(log, offset, &h, 1)) {
+        // the events have to be there too
+        int64_t end = ftello(log->f) + h.compressed_size;
+        if (0 != fseeko(log->f, 0, SEEK_END) || ftello(log->f) < end)
+            break;
+        block_entry_t entry = {offset, h.first_timestamp, h.first_eventnum};
+        g_array_append_val(log->blocks, entry);
+        offset = end;
+    }
+}
+
+static void decompress_block(block_job_t *job)
+{
+    block_header_t *h = &job->header;
+    int status = -1;
+    if (h->compression == COMPRESSION_NONE) {
+        job->data = job->compressed;
+        job->compressed = NULL;
+        status = h->compressed_size == h->uncompressed_size ? 1 : -1;
+    } else if (h->compression == COMPRESSION_LZ4) {
+#ifdef LCM_HAVE_LZ4
+        job->data = (char *) malloc(h->uncompressed_size + 1);
+        int size = LZ4_decompress_safe(job->compressed, job->data, h->compressed_size,
+                                       h->uncompressed_size);
+        status = size == h->uncompressed_size ? 1 : -1;
+#else
+        fprintf(stderr, "Error: Log block is compressed with LZ4, but LCM was built without it\n");
+#endif
+    }
+    free(job->compressed);
+    job->compressed = NULL;
+    job->status = status;
+}
+
+static void *decompress_thread(void *user)
+{
+    lcm_blocklog_t *log = (lcm_blocklog_t *) user;
+    while (1) {
+        block_job_t *job = (block_job_t *) g_async_queue_pop(log->jobs);
+        // the log itself is the signal to exit
+        if ((void *) job == (void *) log)
+            return NULL;
+        block_job_t done = *job;
+        decompress_block(&done);
+        g_mutex_lock(&log->mutex);
+        *job = done;
+        g_cond_broadcast(&log->cond);
+        g_mutex_unlock(&log->mutex);
+    }
+}
+
+static void wait_for_block(lcm_blocklog_t *log, block_job_t *job)
+{
+    if (log->num_workers == 0)
+        return;
+    g_mutex_lock(&log->mutex);
+    while (job->status == 0)
+        g_cond_wait(&log->cond, &log->mutex);
+    g_mutex_unlock(&log->mutex);
+}
+
+static void free_block(block_job_t *job)
+{
+    free(job->compressed);
+    free(job->data);
+    free(job);
+}
+
+// Returns whether the block whose bitmap was just read has a wanted channel.
+static int block_wanted(lcm_blocklog_t *log)
+{
+    if (!log->filter)
+        return 1;
+    for (unsigned int i = 0; i < log->bitmap->len * 8; i++) {
+        if (!(log->bitmap->data[i / 8] & (1 << (i % 8))))
+            continue;
+        if (i >= log->channels->len ||
+            log->filter((const char *) g_ptr_array_index(log->channels, i), log->filter_user))
+            return 1;
+    }
+    return 0;
+}
+
+// Reads ahead the next blocks that have wanted channels, for the workers to
+// decompress.
+static void read_ahead(lcm_blocklog_t *log)
+{
+    while (log->num_pending < log->max_pending && log->next_block < log->blocks->len) {
+        block_entry_t *entry = &g_array_index(log->blocks, block_entry_t, log->next_block);
+        log->next_block++;
+
+        block_header_t h;
+        if (0 != read_block_header(log, entry->offset, &h, 0)) {
+            fprintf(stderr, "Error: Invalid log block header\n");
+            log->next_block = log->blocks->len;
+            return;
+        }
+        if (!block_wanted(log))
+            continue;
+
+        block_job_t *job = (block_job_t *) calloc(1, sizeof(block_job_t));
+        job->header = h;
+        job->compressed = (char *) malloc(h.compressed_size + 1);
+        int index = (log->pending_start + log->num_pending) % log->max_pending;
+        log->pending[index] = job;
+        log->num_pending++;
+        if (fread(job->compressed, 1, h.compressed_size, log->f) != (size_t) h.compressed_size) {
+            job->status = -1;
+        } else if (log->num_workers > 0) {
+            g_async_queue_push(log->jobs, job);
+        } else {
+            decompress_block(job);
+        }
+    }
+}
+
+static void discard_blocks(lcm_blocklog_t *log)
+{
+    if (log->cur)
+        free_block(log->cur);
+    log->cur = NULL;
+    for (; log->num_pending > 0; log->num_pending--) {
+        block_job_t *job = log->pending[log->pending_start];
+        wait_for_block(log, job);
+        free_block(job);
+        log->pending_start = (log->pending_start + 1) % log->max_pending;
+    }
+    log->peeked = 0;
+}
+
+static lcm_blocklog_t *blocklog_new(FILE *f, int writing)
+{
+    lcm_blocklog_t *log = (lcm_blocklog_t *) calloc(1, sizeof(lcm_blocklog_t));
+    log->f = f;
+    log->writing = writing;
+    log->channels = g_ptr_array_new_with_free_func(g_free);
+    log->blocks = g_array_new(FALSE, FALSE, sizeof(block_entry_t));
+    log->bitmap = g_byte_array_new();
+    return log;
+}
+
+lcm_blocklog_t *lcm_blocklog_create(const char *path, const char *mode)
+{
+    if (strcmp(mode, "r") && strcmp(mode, "w")) {
+        fprintf(stderr, "Error: Invalid block log mode: %s\n", mode);
+        return NULL;
+    }
+    int writing = *mode == 'w';
+    FILE *f = fopen(path, writing ? "wb" : "rb");
+    if (f == NULL)
+        return NULL;
+
+    lcm_blocklog_t *log = blocklog_new(f, writing);
+    if (writing) {
+        if (0 != fwrite32(f, BLOCK_LOG_MAGIC) || 0 != fwrite32(f, BLOCK_LOG_VERSION)) {
+            lcm_blocklog_destroy(log);
+            return NULL;
+        }
+        log->offset = 8;
+        // the channels are owned by the array
+        log->channel_numbers = g_hash_table_new(g_str_hash, g_str_equal);
+        log->block = g_byte_array_sized_new(BLOCK_SIZE + BLOCK_SIZE / 4);
+        return log;
+    }
+
+    int32_t magic, version;
+    if (0 != fread32(f, &magic) || magic != BLOCK_LOG_MAGIC || 0 != fread32(f, &version) ||
+        version != BLOCK_LOG_VERSION) {
+        fprintf(stderr, "Error: %s is not a block log\n", path);
+        lcm_blocklog_destroy(log);
+        return NULL;
+    }
+    if (0 != load_footer(log)) {
+        g_ptr_array_set_size(log->channels, 0);
+        g_array_set_size(log->blocks, 0);
+        scan_blocks(log);
+    }
+
+    int threads = g_get_num_processors() - 1;
+    log->num_workers = threads < MAX_DECOMPRESS_THREADS ? threads : MAX_DECOMPRESS_THREADS;
+    log->max_pending = log->num_workers > 0 ? 2 * log->num_workers : 1;
+    if (log->num_workers > 0) {
+        g_mutex_init(&log->mutex);
+        g_cond_init(&log->cond);
+        log->jobs = g_async_queue_new();
+        for (int i = 0; i < log->num_workers; i++)
+            log->workers[i] = g_thread_new("lcm-log-decompress", decompress_thread, log);
+    }
+    return log;
+}
+
+int lcm_blocklog_detect(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return 0;
+    int32_t magic;
+    int is_block_log = 0 == fread32(f, &magic) && magic == BLOCK_LOG_MAGIC;
+    fclose(f);
+    return is_block_log;
+}
+
+static int write_block(lcm_blocklog_t *log)
+{
+    if (log->block_events == 0)
+        return 0;
+
+    const char *events = (const char *) log->block->data;
+    int32_t size = log->block->len;
+    int32_t compression = COMPRESSION_NONE;
+    char *compressed = NULL;
+#ifdef LCM_HAVE_LZ4
+    int capacity = LZ4_compressBound(size);
+    compressed = (char *) malloc(capacity);
+    int compressed_size = LZ4_compress_default(events, compressed, size, capacity);
+    if (compressed_size > 0 && compressed_size < size) {
+        compression = COMPRESSION_LZ4;
+        events = compressed;
+        size = compressed_size;
+    }
+#endif
+
+    GByteArray *header = g_byte_array_new();
+    append32(header, BLOCK_MAGIC);
+    append32(header, compression);
+    append32(header, size);
+    append32(header, log->block->len);
+    append32(header, log->block_events);
+    append64(header, log->block_first_eventnum);
+    append64(header, log->block_first_timestamp);
+    append64(header, log->block_last_timestamp);
+    append32(header, log->channels->len - log->block_new_channels);
+    for (unsigned int i = log->block_new_channels; i < log->channels->len; i++) {
+        const char *channel = (const char *) g_ptr_array_index(log->channels, i);
+        append32(header, strlen(channel));
+        g_byte_array_append(header, (const guint8 *) channel, strlen(channel));
+    }
+    append32(header, log->bitmap->len);
+    g_byte_array_append(header, log->bitmap->data, log->bitmap->len);
+
+    int status = 0;
+    if (fwrite(header->data, 1, header->len, log->f) != header->len ||
+        fwrite(events, 1, size, log->f) != (size_t) size)
+        status = -1;
+
+    block_entry_t entry = {log->offset, log->block_first_timestamp, log->block_first_eventnum};
+    g_array_append_val(log->blocks, entry);
+    log->offset += header->len + size;
+
+    g_byte_array_free(header, TRUE);
+    free(compressed);
+    g_byte_array_set_size(log->block, 0);
+    g_byte_array_set_size(log->bitmap, 0);
+    log->block_events = 0;
+    log->block_new_channels = log->channels->len;
+    return status;
+}
+
+int lcm_blocklog_write_event(lcm_blocklog_t *log, lcm_eventlog_event_t *le)
+{
+    if (!log->writing)
+        return -1;
+    if (le->channellen <= 0 || le->channellen >= MAX_CHANNEL_LENGTH || le->datalen < 0)
+        return -1;
+
+    char *channel = g_strndup(le->channel, le->channellen);
+    gpointer number = g_hash_table_lookup(log->channel_numbers, channel);
+    unsigned int n;
+    if (number) {
+        n = GPOINTER_TO_UINT(number) - 1;
+        g_free(channel);
+    } else {
+        n = log->channels->len;
+        g_ptr_array_add(log->channels, channel);
+        g_hash_table_insert(log->channel_numbers, channel, GUINT_TO_POINTER(n + 1));
+    }
+
+    le->eventnum = log->eventcount++;
+    if (log->block_events == 0) {
+        log->block_first_eventnum = le->eventnum;
+        log->block_first_timestamp = le->timestamp;
+    }
+    log->block_last_timestamp = le->timestamp;
+    log->block_events++;
+
+    append64(log->block, le->timestamp);
+    append32(log->block, n);
+    append32(log->block, le->datalen);
+    g_byte_array_append(log->block, (const guint8 *) le->data, le->datalen);
+
+    if (log->bitmap->len <= n / 8) {
+        unsigned int len = log->bitmap->len;
+        g_byte_array_set_size(log->bitmap, n / 8 + 1);
+        memset(log->bitmap->data + len, 0, log->bitmap->len - len);
+    }
+    log->bitmap->data[n / 8] |= 1 << (n % 8);
+
+    if (log->block->len >= BLOCK_SIZE)
+        return write_block(log);
+    return 0;
+}
+
+static int write_footer(lcm_blocklog_t *log)
+{
+    GByteArray *footer = g_byte_array_new();
+    append32(footer, FOOTER_MAGIC);
+    append32(footer, log->channels->len);
+    for (unsigned int i = 0; i < log->channels->len; i++) {
+        const char *channel = (const char *) g_ptr_array_index(log->channels, i);
+        append32(footer, strlen(channel));
+        g_byte_array_append(footer, (const guint8 *) channel, strlen(channel));
+    }
+    append32(footer, log->blocks->len);
+    for (unsigned int i = 0; i < log->blocks->len; i++) {
+        block_entry_t *entry = &g_array_index(log->blocks, block_entry_t, i);
+        append64(footer, entry->offset);
+        append64(footer, entry->first_timestamp);
+        append64(footer, entry->first_eventnum);
+    }
+    append64(footer, log->offset);
+    append32(footer, TRAILER_MAGIC);
+    int status = fwrite(footer->data, 1, footer->len, log->f) == footer->len ? 0 : -1;
+    g_byte_array_free(footer, TRUE);
+    return status;
+}
+
+void lcm_blocklog_set_channel_filter(lcm_blocklog_t *log,
+                                     int (*wanted)(const char *channel, void *user), void *user)
+{
+    log->filter = wanted;
+    log->filter_user = user;
+}
+
+const lcm_eventlog_event_t *lcm_blocklog_read_next_event(lcm_blocklog_t *log)
+{
+    if (log->writing)
+        return NULL;
+    if (log->peeked) {
+        log->peeked = 0;
+        return &log->event;
+    }
+
+    while (1) {
+        block_job_t *job = log->cur;
+        if (job && log->cur_event < job->header.num_events) {
+            const uint8_t *p = (const uint8_t *) job->data + log->cur_pos;
+            int32_t left = job->header.uncompressed_size - log->cur_pos;
+            if (left < BLOCK_EVENT_HEADER_SIZE)
+                break;
+            int32_t n = read32(p + 8);
+            int32_t datalen = read32(p + 12);
+            if (n < 0 || (unsigned int) n >= log->channels->len || datalen < 0 ||
+                datalen > left - BLOCK_EVENT_HEADER_SIZE)
+                break;
+
+            log->event.eventnum = job->header.first_eventnum + log->cur_event;
+            log->event.timestamp = read64(p);
+            log->event.channel = (char *) g_ptr_array_index(log->channels, n);
+            log->event.channellen = strlen(log->event.channel);
+            log->event.datalen = datalen;
+            log->event.data = (void *) (p + BLOCK_EVENT_HEADER_SIZE);
+            log->cur_pos += BLOCK_EVENT_HEADER_SIZE + datalen;
+            log->cur_event++;
+            return &log->event;
+        }
+
+        if (job)
+            free_block(job);
+        log->cur = NULL;
+        read_ahead(log);
+        if (log->num_pending == 0)
+            return NULL;
+        job = log->pending[log->pending_start];
+        log->pending_start = (log->pending_start + 1) % log->max_pending;
+        log->num_pending--;
+        log->cur = job;
+        log->cur_event = 0;
+        log->cur_pos = 0;
+        wait_for_block(log, job);
+        if (job->status < 0)
+            break;
+    }
+    fprintf(stderr, "Error: Invalid log block\n");
+    return NULL;
+}
+
+int lcm_blocklog_seek_to_timestamp(lcm_blocklog_t *log, int64_t timestamp)
+{
+    if (log->writing || log->blocks->len == 0)
+        return -1;
+    discard_blocks(log);
+
+    // the first block after the timestamp
+    unsigned int lo = 0;
+    unsigned int hi = log->blocks->len;
+    while (lo < hi) {
+        unsigned int mid = lo + (hi - lo) / 2;
+        if (g_array_index(log->blocks, block_entry_t, mid).first_timestamp <= timestamp)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    log->next_block = lo > 0 ? lo - 1 : 0;
+
+    const lcm_eventlog_event_t *le;
+    while ((le = lcm_blocklog_read_next_event(log)) && le->timestamp < timestamp) {
+    }
+    if (le)
+        log->peeked = 1;
+    return 0;
+}
+
+void lcm_blocklog_destroy(lcm_blocklog_t *log)
+{
+    if (log->writing) {
+        write_block(log);
+        write_footer(log);
+        g_hash_table_destroy(log->channel_numbers);
+        g_byte_array_free(log->block, TRUE);
+    } else {
+        discard_blocks(log);
+        if (log->num_workers > 0) {
+            for (int i = 0; i < log->num_workers; i++)
+                g_async_queue_push(log->jobs, log);
+            for (int i = 0; i < log->num_workers; i++)
+                g_thread_join(log->workers[i]);
+            g_async_queue_unref(log->jobs);
+            g_mutex_clear(&log->mutex);
+            g_cond_clear(&log->cond);
+        }
+    }
+    fclose(log->f);
+    g_ptr_array_free(log->channels, TRUE);
+    g_array_free(log->blocks, TRUE);
+    g_byte_array_free(log->bitmap, TRUE);
+    free(log);
+}
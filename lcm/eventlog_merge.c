@@ -0,0 +1,276 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#ifndef WIN32
+#include <fcntl.h>
+#endif
+
+#include "eventlog.h"
+
+#ifdef _MSC_VER
+#define fseeko _fseeki64
+#endif
+
+#define SHARDS_MAGIC "LCM-SHARDS 1"
+
+typedef struct {
+    lcm_eventlog_t *log;
+    // the next event of the log, if has_event is set
+    lcm_eventlog_event_t event;
+    size_t capacity;
+    int has_event;
+    // the event number of the first event, and one past the last one read,
+    // relative to it, if has_first is set
+    int has_first;
+    int64_t first_eventnum;
+    int64_t end;
+} merged_log_t;
+
+struct _lcm_eventlog_merge_t {
+    merged_log_t *logs;
+    int num_logs;
+    // the logs with a next event, as a binary heap of indices into logs whose
+    // first is the log of the next event
+    int *heap;
+    int heap_len;
+    // the log of the event returned last, whose next event is read next, or
+    // -1
+    int last;
+    // set if the events are renumbered in the order that they're merged in,
+    // with the number of the next event
+    int renumber;
+    int64_t next_eventnum;
+};
+
+static void read_next(merged_log_t *m)
+{
+    m->has_event = 0 == lcm_eventlog_read_next_event_into(m->log, &m->event, &m->capacity);
+    if (!m->has_event)
+        return;
+    if (!m->has_first) {
+        m->has_first = 1;
+        m->first_eventnum = m->event.eventnum;
+    }
+    m->end = MAX(m->end, m->event.eventnum - m->first_eventnum + 1);
+}
+
+// Whether the next event of log a comes before the next event of log b.
+static int is_before(const lcm_eventlog_merge_t *merge, int a, int b)
+{
+    const lcm_eventlog_event_t *ea = &merge->logs[a].event;
+    const lcm_eventlog_event_t *eb = &merge->logs[b].event;
+    if (ea->timestamp != eb->timestamp)
+        return ea->timestamp < eb->timestamp;
+    if (ea->eventnum != eb->eventnum)
+        return ea->eventnum < eb->eventnum;
+    return a < b;
+}
+
+static void sift_down(lcm_eventlog_merge_t *merge, int i)
+{
+    int *heap = merge->heap;
+    while (1) {
+        int first = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < merge->heap_len && is_before(merge, heap[left], heap[first]))
+            first = left;
+        if (right < merge->heap_len && is_before(merge, heap[right], heap[first]))
+            first = right;
+        if (first == i)
+            return;
+        int tmp = heap[i];
+        heap[i] = heap[first];
+        heap[first] = tmp;
+        i = first;
+    }
+}
+
+static void build_heap(lcm_eventlog_merge_t *merge)
+{
+    merge->heap_len = 0;
+    for (int i = 0; i < merge->num_logs; i++) {
+        if (merge->logs[i].has_event)
+            merge->heap[merge->heap_len++] = i;
+    }
+    for (int i = merge->heap_len / 2 - 1; i >= 0; i--)
+        sift_down(merge, i);
+}
+
+static int add_log(lcm_eventlog_merge_t *merge, const char *path)
+{
+    if (lcm_blocklog_detect(path)) {
+        fprintf(stderr, "Error: %s is a block log, which can't be merged\n", path);
+        return -1;
+    }
+    lcm_eventlog_t *log = lcm_eventlog_create(path, "r");
+    if (!log) {
+        fprintf(stderr, "Error: Failed to open %s\n", path);
+        return -1;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    // each log is read ahead on its own, rather than the reads of the logs
+    // seeking back and forth between them
+    posix_fadvise(fileno(log->f), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    merge->logs =
+        (merged_log_t *) realloc(merge->logs, (merge->num_logs + 1) * sizeof(merged_log_t));
+    merge->heap = (int *) realloc(merge->heap, (merge->num_logs + 1) * sizeof(int));
+    merged_log_t *m = &merge->logs[merge->num_logs++];
+    memset(m, 0, sizeof(*m));
+    m->log = log;
+    read_next(m);
+    return 0;
+}
+
+// Reads a line of the manifest without its newline, or returns 0 at the end.
+static int read_line(FILE *f, GString *line)
+{
+    g_string_truncate(line, 0);
+    int c;
+    while ((c = getc(f)) != EOF && c != '\n')
+        g_string_append_c(line, (char) c);
+    if (line->len > 0 && line->str[line->len - 1] == '\r')
+        g_string_truncate(line, line->len - 1);
+    return c != EOF || line->len > 0;
+}
+
+int lcm_eventlog_merge_detect(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return 0;
+    char magic[sizeof(SHARDS_MAGIC) - 1];
+    int is_manifest = fread(magic, 1, sizeof(magic), f) == sizeof(magic) &&
+                      0 == memcmp(magic, SHARDS_MAGIC, sizeof(magic));
+    fclose(f);
+    return is_manifest;
+}
+
+lcm_eventlog_merge_t *lcm_eventlog_merge_open(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return NULL;
+
+    GString *line = g_string_new(NULL);
+    if (!read_line(f, line) || strcmp(line->str, SHARDS_MAGIC)) {
+        fprintf(stderr, "Error: %s is not a manifest of log files\n", path);
+        g_string_free(line, TRUE);
+        fclose(f);
+        return NULL;
+    }
+
+    lcm_eventlog_merge_t *merge = (lcm_eventlog_merge_t *) calloc(1, sizeof(*merge));
+    merge->last = -1;
+    char *dir = g_path_get_dirname(path);
+    int status = 0;
+    while (read_line(f, line)) {
+        char *tab = strchr(line->str, '\t');
+        if (tab)
+            *tab = 0;
+        if (!line->str[0])
+            continue;
+
+        char *log_path = g_path_is_absolute(line->str) ? g_strdup(line->str)
+                                                       : g_build_filename(dir, line->str, NULL);
+        status = add_log(merge, log_path);
+        g_free(log_path);
+        if (status != 0)
+            break;
+    }
+    g_free(dir);
+    g_string_free(line, TRUE);
+    fclose(f);
+
+    if (status != 0) {
+        lcm_eventlog_merge_close(merge);
+        return NULL;
+    }
+    build_heap(merge);
+    return merge;
+}
+
+lcm_eventlog_merge_t *lcm_eventlog_merge_open_files(const char *const *paths, int num_paths)
+{
+    lcm_eventlog_merge_t *merge = (lcm_eventlog_merge_t *) calloc(1, sizeof(*merge));
+    merge->last = -1;
+    merge->renumber = 1;
+    for (int i = 0; i < num_paths; i++) {
+        if (0 != add_log(merge, paths[i])) {
+            lcm_eventlog_merge_close(merge);
+            return NULL;
+        }
+    }
+    build_heap(merge);
+    return merge;
+}
+
+const lcm_eventlog_event_t *lcm_eventlog_merge_next(lcm_eventlog_merge_t *merge)
+{
+    // the log of the last event is first in the heap
+    if (merge->last >= 0) {
+        read_next(&merge->logs[merge->last]);
+        if (!merge->logs[merge->last].has_event)
+            merge->heap[0] = merge->heap[--merge->heap_len];
+        sift_down(merge, 0);
+    }
+
+    if (merge->heap_len == 0) {
+        merge->last = -1;
+        return NULL;
+    }
+    merge->last = merge->heap[0];
+    lcm_eventlog_event_t *next = &merge->logs[merge->last].event;
+    if (merge->renumber)
+        next->eventnum = merge->next_eventnum++;
+    return next;
+}
+
+int lcm_eventlog_merge_seek_to_timestamp(lcm_eventlog_merge_t *merge, int64_t timestamp)
+{
+    for (int i = 0; i < merge->num_logs; i++) {
+        merged_log_t *m = &merge->logs[i];
+        // a log that ends before the timestamp has nothing left to read
+        if (0 != lcm_eventlog_seek_to_timestamp(m->log, timestamp))
+            fseeko(m->log->f, 0, SEEK_END);
+        read_next(m);
+    }
+    merge->last = -1;
+    build_heap(merge);
+
+    // the events before the next ones are counted assuming that each log
+    // numbers its events consecutively
+    merge->next_eventnum = 0;
+    for (int i = 0; i < merge->num_logs; i++) {
+        merged_log_t *m = &merge->logs[i];
+        if (m->has_event)
+            merge->next_eventnum += m->event.eventnum - m->first_eventnum;
+        else
+            merge->next_eventnum += m->end;
+    }
+    return 0;
+}
+
+void lcm_eventlog_merge_set_channel_filter(lcm_eventlog_merge_t *merge,
+                                           int (*wanted)(const char *channel, void *user),
+                                           void *user)
+{
+    for (int i = 0; i < merge->num_logs; i++)
+        lcm_eventlog_set_channel_filter(merge->logs[i].log, wanted, user);
+}
+
+void lcm_eventlog_merge_close(lcm_eventlog_merge_t *merge)
+{
+    for (int i = 0; i < merge->num_logs; i++) {
+        free(merge->logs[i].event.channel);
+        lcm_eventlog_destroy(merge->logs[i].log);
+    }
+    free(merge->logs);
+    free(merge->heap);
+    free(merge);
+}
@@ -11,97 +11,325 @@ int Subscription::setQueueCapacity(int num_messages)
     return lcm_subscription_set_queue_capacity(c_subs, num_messages);
 }
 
+int Subscription::setDropPolicy(lcm_drop_policy_t policy)
+{
+    return lcm_subscription_set_drop_policy(c_subs, policy);
+}
+
+int Subscription::setPriority(int priority)
+{
+    return lcm_subscription_set_priority(c_subs, priority);
+}
+
+int Subscription::setConflate(bool conflate)
+{
+    return lcm_subscription_set_conflate(c_subs, conflate ? 1 : 0);
+}
+
+int Subscription::setMaxRate(double hz)
+{
+    return lcm_subscription_set_max_rate(c_subs, hz);
+}
+
 int Subscription::getQueueSize() const
 {
     return lcm_subscription_get_queue_size(c_subs);
 }
 
-template <class MessageType, class ContextClass>
-class LCMTypedSubscription : public Subscription {
+uint64_t Subscription::getDropCount() const
+{
+    return lcm_subscription_get_drop_count(c_subs);
+}
+
+uint64_t Subscription::getPolicyDropCount(lcm_drop_policy_t policy) const
+{
+    return lcm_subscription_get_policy_drop_count(c_subs, policy);
+}
+
+int Subscription::getHandlerStats(lcm_handler_stats_t *stats) const
+{
+    return lcm_subscription_get_handler_stats(c_subs, stats);
+}
+
+void Subscription::setMessageReuse(bool reuse)
+{
+    reuse_message = reuse;
+}
+
+int Subscription::setExecutor(Dispatcher *dispatcher)
+{
+    executor = dispatcher ? dispatcher->getUnderlyingDispatcher() : NULL;
+    return lcm_subscription_set_executor(c_subs, executor);
+}
+
+#if LCM_CXX_11_ENABLED
+void Subscription::setDecodeAhead(Dispatcher *dispatcher)
+{
+    decode_ahead = dispatcher ? dispatcher->getUnderlyingDispatcher() : NULL;
+}
+#endif
+
+Dispatcher::Dispatcher(int num_threads) : dispatcher(lcm_dispatcher_create(num_threads)) {}
+
+Dispatcher::~Dispatcher()
+{
+    if (dispatcher)
+        lcm_dispatcher_destroy(dispatcher);
+}
+
+bool Dispatcher::good() const
+{
+    return dispatcher != NULL;
+}
+
+lcm_dispatcher_t *Dispatcher::getUnderlyingDispatcher()
+{
+    return dispatcher;
+}
+
+#if LCM_CXX_11_ENABLED
+// A message of a subscription with setDecodeAhead(), which is decoded on a
+// dispatcher while the handle method that received it goes on.  The handle
+// method waits for it, and calls the handler, before it returns.
+class LCMDecodeAheadJob {
+  public:
+    explicit LCMDecodeAheadJob(Subscription *subscription_)
+        : subscription(subscription_), decoded(false)
+    {
+    }
+    virtual ~LCMDecodeAheadJob() {}
+
+    // the lcm_dispatcher_func_t that decodes the message
+    static void run(void *user_data)
+    {
+        LCMDecodeAheadJob *job = static_cast<LCMDecodeAheadJob *>(user_data);
+        job->decode();
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->decoded = true;
+        job->cond.notify_one();
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [this] { return decoded; });
+    }
+
+    virtual void decode() = 0;
+    virtual void handle() = 0;
+
+    Subscription *const subscription;
+
+  private:
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool decoded;
+};
+#endif
+
+// The part of the typed subscriptions that decodes their messages
+template <class MessageType>
+class LCMDecodingSubscription : public Subscription {
+  protected:
+    LCMDecodingSubscription() : reused_msg(NULL) {}
+    ~LCMDecodingSubscription() { delete reused_msg; }
+
+    // Calls the handler with a decoded message.
+    virtual void handleMessage(const lcm_recv_buf_t *rbuf, const char *channel,
+                               const MessageType *msg) = 0;
+
+    // Decodes a received message and calls the handler, or hands the message
+    // to the dispatcher of setDecodeAhead().  This is what the cb_func of the
+    // typed subscriptions calls.
+    void dispatch(const lcm_recv_buf_t *rbuf, const char *channel)
+    {
+#if LCM_CXX_11_ENABLED
+        if (this->decode_ahead && !this->executor && decodeAhead(rbuf, channel))
+            return;
+#endif
+        MessageType new_msg;
+        const MessageType *msg = decode(rbuf, &new_msg);
+        if (msg)
+            handleMessage(rbuf, channel, msg);
+    }
+
+    // Decodes rbuf into new_msg, or into the reused message after
+    // setMessageReuse().  Returns the message that it decoded, or NULL if
+    // rbuf couldn't be decoded.
+    MessageType *decode(const lcm_recv_buf_t *rbuf, MessageType *new_msg)
+    {
+        MessageType *msg = new_msg;
+        if (this->reuse_message) {
+            if (!reused_msg)
+                reused_msg = new MessageType();
+            msg = reused_msg;
+        }
+        int status = msg->decode(rbuf->data, 0, rbuf->data_size);
+        if (status < 0) {
+            fprintf(stderr, "error %d decoding %s!!!\n", status, MessageType::getTypeName());
+            return NULL;
+        }
+        return msg;
+    }
+
+  private:
+    MessageType *reused_msg;
+
+#if LCM_CXX_11_ENABLED
+    class DecodeAheadMessage : public LCMDecodeAheadJob {
+      public:
+        DecodeAheadMessage(LCMDecodingSubscription *subs_, lcm_recv_buf_t *rbuf_,
+                           const char *channel_)
+            : LCMDecodeAheadJob(subs_), subs(subs_), rbuf(rbuf_), channel(channel_), status(-1)
+        {
+        }
+        ~DecodeAheadMessage() { lcm_recv_buf_release(rbuf); }
+
+        void decode() { status = msg.decode(rbuf->data, 0, rbuf->data_size); }
+
+        void handle()
+        {
+            if (status < 0)
+                fprintf(stderr, "error %d decoding %s!!!\n", status, MessageType::getTypeName());
+            else
+                subs->handleMessage(rbuf, channel.c_str(), &msg);
+        }
+
+      private:
+        LCMDecodingSubscription *subs;
+        lcm_recv_buf_t *rbuf;
+        std::string channel;
+        MessageType msg;
+        int status;
+    };
+
+    // Hands rbuf to the dispatcher of setDecodeAhead().  Returns false if it
+    // can't, so that the message is decoded right away instead.
+    bool decodeAhead(const lcm_recv_buf_t *rbuf, const char *channel)
+    {
+        lcm_recv_buf_t *kept = lcm_recv_buf_retain(rbuf);
+        if (!kept)
+            return false;
+        DecodeAheadMessage *job = new DecodeAheadMessage(this, kept, channel);
+        if (lcm_dispatcher_run(this->decode_ahead, &LCMDecodeAheadJob::run, job) < 0) {
+            delete job;
+            return false;
+        }
+        this->owner->decode_ahead_jobs.push_back(job);
+        return true;
+    }
+#endif
+};
+
+// Passes the channel name to a handler as the type that it takes.  Only a
+// handler that takes a std::string needs the name copied, into the
+// channel_buf of its subscription.
+template <class ChannelType>
+struct LCMChannelArg;
+
+template <>
+struct LCMChannelArg<const std::string &> {
+    static const std::string &get(const char *channel, std::string &channel_buf)
+    {
+        channel_buf = channel;
+        return channel_buf;
+    }
+};
+
+template <>
+struct LCMChannelArg<const char *> {
+    static const char *get(const char *channel, std::string &) { return channel; }
+};
+
+#if LCM_CXX_17_ENABLED
+template <>
+struct LCMChannelArg<std::string_view> {
+    static std::string_view get(const char *channel, std::string &) { return channel; }
+};
+#endif
+
+template <class MessageType, class ContextClass, class ChannelType>
+class LCMTypedSubscription : public LCMDecodingSubscription<MessageType> {
     friend class LCM;
 
   private:
     ContextClass context;
-    void (*handler)(const ReceiveBuffer *rbuf, const std::string &channel, const MessageType *msg,
+    void (*handler)(const ReceiveBuffer *rbuf, ChannelType channel, const MessageType *msg,
                     ContextClass context);
     static void cb_func(const lcm_recv_buf_t *rbuf, const char *channel, void *user_data)
     {
-        typedef LCMTypedSubscription<MessageType, ContextClass> SubsClass;
-        SubsClass *subs = static_cast<SubsClass *>(user_data);
-        subs->channel_buf = channel;
-        MessageType msg;
-        int status = msg.decode(rbuf->data, 0, rbuf->data_size);
-        if (status < 0) {
-            fprintf(stderr, "error %d decoding %s!!!\n", status, MessageType::getTypeName());
-            return;
-        }
-        const ReceiveBuffer rb = {rbuf->data, rbuf->data_size, rbuf->recv_utime};
-        subs->handler(&rb, subs->channel_buf, &msg, subs->context);
+        typedef LCMTypedSubscription<MessageType, ContextClass, ChannelType> SubsClass;
+        static_cast<SubsClass *>(user_data)->dispatch(rbuf, channel);
+    }
+    void handleMessage(const lcm_recv_buf_t *rbuf, const char *channel, const MessageType *msg)
+    {
+        const ReceiveBuffer rb = {rbuf->data, rbuf->data_size, rbuf->recv_utime,
+                                  rbuf->recv_time_ns, rbuf->recv_mono_ns};
+        handler(&rb, LCMChannelArg<ChannelType>::get(channel, this->channel_buf), msg, context);
     }
 };
 
-template <class ContextClass>
+template <class ContextClass, class ChannelType>
 class LCMUntypedSubscription : public Subscription {
     friend class LCM;
 
   private:
     ContextClass context;
-    void (*handler)(const ReceiveBuffer *rbuf, const std::string &channel, ContextClass context);
+    void (*handler)(const ReceiveBuffer *rbuf, ChannelType channel, ContextClass context);
     static void cb_func(const lcm_recv_buf_t *rbuf, const char *channel, void *user_data)
     {
-        typedef LCMUntypedSubscription<ContextClass> SubsClass;
+        typedef LCMUntypedSubscription<ContextClass, ChannelType> SubsClass;
         SubsClass *subs = static_cast<SubsClass *>(user_data);
-        subs->channel_buf = channel;
-        const ReceiveBuffer rb = {rbuf->data, rbuf->data_size, rbuf->recv_utime};
-        subs->handler(&rb, subs->channel_buf, subs->context);
+        const ReceiveBuffer rb = {rbuf->data, rbuf->data_size, rbuf->recv_utime,
+                                  rbuf->recv_time_ns, rbuf->recv_mono_ns};
+        subs->handler(&rb, LCMChannelArg<ChannelType>::get(channel, subs->channel_buf),
+                      subs->context);
     }
 };
 
-template <class MessageType, class MessageHandlerClass>
-class LCMMHSubscription : public Subscription {
+template <class MessageType, class MessageHandlerClass, class ChannelType>
+class LCMMHSubscription : public LCMDecodingSubscription<MessageType> {
     friend class LCM;
 
   private:
     MessageHandlerClass *handler;
-    void (MessageHandlerClass::*handlerMethod)(const ReceiveBuffer *rbuf,
-                                               const std::string &channel, const MessageType *msg);
+    void (MessageHandlerClass::*handlerMethod)(const ReceiveBuffer *rbuf, ChannelType channel,
+                                               const MessageType *msg);
     static void cb_func(const lcm_recv_buf_t *rbuf, const char *channel, void *user_data)
     {
-        LCMMHSubscription<MessageType, MessageHandlerClass> *subs =
-            static_cast<LCMMHSubscription<MessageType, MessageHandlerClass> *>(user_data);
-        MessageType msg;
-        int status = msg.decode(rbuf->data, 0, rbuf->data_size);
-        if (status < 0) {
-            fprintf(stderr, "error %d decoding %s!!!\n", status, MessageType::getTypeName());
-            return;
-        }
-        const ReceiveBuffer rb = {rbuf->data, rbuf->data_size, rbuf->recv_utime};
-        subs->channel_buf = channel;
-        (subs->handler->*subs->handlerMethod)(&rb, subs->channel_buf, &msg);
+        typedef LCMMHSubscription<MessageType, MessageHandlerClass, ChannelType> SubsClass;
+        static_cast<SubsClass *>(user_data)->dispatch(rbuf, channel);
+    }
+    void handleMessage(const lcm_recv_buf_t *rbuf, const char *channel, const MessageType *msg)
+    {
+        const ReceiveBuffer rb = {rbuf->data, rbuf->data_size, rbuf->recv_utime,
+                                  rbuf->recv_time_ns, rbuf->recv_mono_ns};
+        (handler->*handlerMethod)(&rb, LCMChannelArg<ChannelType>::get(channel, this->channel_buf),
+                                  msg);
     }
 };
 
-template <class MessageHandlerClass>
+template <class MessageHandlerClass, class ChannelType>
 class LCMMHUntypedSubscription : public Subscription {
     friend class LCM;
 
   private:
     MessageHandlerClass *handler;
-    void (MessageHandlerClass::*handlerMethod)(const ReceiveBuffer *rbuf,
-                                               const std::string &channel);
+    void (MessageHandlerClass::*handlerMethod)(const ReceiveBuffer *rbuf, ChannelType channel);
     static void cb_func(const lcm_recv_buf_t *rbuf, const char *channel, void *user_data)
     {
-        LCMMHUntypedSubscription<MessageHandlerClass> *subs =
-            static_cast<LCMMHUntypedSubscription<MessageHandlerClass> *>(user_data);
-        subs->channel_buf = channel;
-        const ReceiveBuffer rb = {rbuf->data, rbuf->data_size, rbuf->recv_utime};
-        (subs->handler->*subs->handlerMethod)(&rb, subs->channel_buf);
+        typedef LCMMHUntypedSubscription<MessageHandlerClass, ChannelType> SubsClass;
+        SubsClass *subs = static_cast<SubsClass *>(user_data);
+        const ReceiveBuffer rb = {rbuf->data, rbuf->data_size, rbuf->recv_utime,
+                                  rbuf->recv_time_ns, rbuf->recv_mono_ns};
+        (subs->handler->*subs->handlerMethod)(
+            &rb, LCMChannelArg<ChannelType>::get(channel, subs->channel_buf));
     }
 };
 
 #if LCM_CXX_11_ENABLED
 template <class MessageType>
-class LCMLambdaSubscription : public Subscription {
+class LCMLambdaSubscription : public LCMDecodingSubscription<MessageType> {
     friend class LCM;
 
   private:
@@ -109,17 +337,14 @@ class LCMLambdaSubscription : public Subscription {
     HandlerFunction handler;
     static void cb_func(const lcm_recv_buf_t *rbuf, const char *channel, void *user_data)
     {
-        LCMLambdaSubscription<MessageType> *subs =
-            static_cast<LCMLambdaSubscription<MessageType> *>(user_data);
-        subs->channel_buf = channel;
-        MessageType msg;
-        int status = msg.decode(rbuf->data, 0, rbuf->data_size);
-        if (status < 0) {
-            fprintf(stderr, "error %d decoding %s!!!\n", status, MessageType::getTypeName());
-            return;
-        }
-        const ReceiveBuffer rb = {rbuf->data, rbuf->data_size, rbuf->recv_utime};
-        (subs->handler)(&rb, subs->channel_buf, &msg);
+        static_cast<LCMLambdaSubscription<MessageType> *>(user_data)->dispatch(rbuf, channel);
+    }
+    void handleMessage(const lcm_recv_buf_t *rbuf, const char *channel, const MessageType *msg)
+    {
+        this->channel_buf = channel;
+        const ReceiveBuffer rb = {rbuf->data, rbuf->data_size, rbuf->recv_utime,
+                                  rbuf->recv_time_ns, rbuf->recv_mono_ns};
+        handler(&rb, this->channel_buf, msg);
     }
 };
 #endif
@@ -141,6 +366,13 @@ inline bool LCM::good() const
 
 inline LCM::~LCM()
 {
+#if LCM_CXX_11_ENABLED
+    // the messages still being decoded hold received buffers of lcm
+    for (size_t i = 0; i < decode_ahead_jobs.size(); i++) {
+        decode_ahead_jobs[i]->wait();
+        delete decode_ahead_jobs[i];
+    }
+#endif
     for (int i = 0, n = subscriptions.size(); i < n; i++) {
         delete subscriptions[i];
     }
@@ -150,23 +382,288 @@ inline LCM::~LCM()
 }
 
 inline int LCM::publish(const std::string &channel, const void *data, unsigned int datalen)
+{
+    return this->publish(channel.c_str(), data, datalen);
+}
+
+template <class MessageType>
+inline int LCM::publish(const std::string &channel, const MessageType *msg)
+{
+    return this->publish(channel.c_str(), msg);
+}
+
+template <class MessageType>
+inline int LCM::publish(const std::string &channel, const MessageType *msg, void *buf,
+                        unsigned int buflen)
+{
+    return this->publish(channel.c_str(), msg, buf, buflen);
+}
+
+inline int LCM::publish(const char *channel, const void *data, unsigned int datalen)
 {
     if (!this->lcm) {
         fprintf(stderr, "LCM instance not initialized.  Ignoring call to publish()\n");
         return -1;
     }
-    return lcm_publish(this->lcm, channel.c_str(), data, datalen);
+    return lcm_publish(this->lcm, channel, data, datalen);
 }
 
 template <class MessageType>
-inline int LCM::publish(const std::string &channel, const MessageType *msg)
+inline int LCM::publish(const char *channel, const MessageType *msg)
 {
+    if (!this->lcm) {
+        fprintf(stderr, "LCM instance not initialized.  Ignoring call to publish()\n");
+        return -1;
+    }
+
+    unsigned int maxlen = msg->getEncodedSize();
+    void *buf = lcm_publish_reserve(this->lcm, channel, maxlen);
+    if (!buf)
+        return -1;
+    int datalen = msg->encode(buf, 0, maxlen);
+    if (datalen < 0) {
+        lcm_publish_cancel(this->lcm, buf);
+        return -1;
+    }
+    return lcm_publish_commit(this->lcm, buf, datalen);
+}
+
+template <class MessageType>
+inline int LCM::publish(const char *channel, const MessageType *msg, void *buf,
+                        unsigned int buflen)
+{
+    // encode() fails if the buffer is too small
+    int datalen = msg->encode(buf, 0, buflen);
+    if (datalen < 0)
+        return -1;
+    return this->publish(channel, buf, datalen);
+}
+
+#if LCM_CXX_17_ENABLED
+inline bool LCM::copyChannel(std::string_view channel, char *name)
+{
+    if (channel.size() > LCM_MAX_CHANNEL_NAME_LENGTH)
+        return false;
+    channel.copy(name, channel.size());
+    name[channel.size()] = '\0';
+    return true;
+}
+
+inline int LCM::publish(std::string_view channel, const void *data, unsigned int datalen)
+{
+    char name[LCM_MAX_CHANNEL_NAME_LENGTH + 1];
+    if (!copyChannel(channel, name))
+        return this->publish(std::string(channel), data, datalen);
+    return this->publish(static_cast<const char *>(name), data, datalen);
+}
+
+template <class MessageType>
+inline int LCM::publish(std::string_view channel, const MessageType *msg)
+{
+    char name[LCM_MAX_CHANNEL_NAME_LENGTH + 1];
+    if (!copyChannel(channel, name))
+        return this->publish(std::string(channel), msg);
+    return this->publish(static_cast<const char *>(name), msg);
+}
+
+template <class MessageType>
+inline int LCM::publish(std::string_view channel, const MessageType *msg, void *buf,
+                        unsigned int buflen)
+{
+    char name[LCM_MAX_CHANNEL_NAME_LENGTH + 1];
+    if (!copyChannel(channel, name))
+        return this->publish(std::string(channel), msg, buf, buflen);
+    return this->publish(static_cast<const char *>(name), msg, buf, buflen);
+}
+#endif
+
+inline int LCM::publishAsync(const std::string &channel, const void *data, unsigned int datalen)
+{
+    if (!this->lcm) {
+        fprintf(stderr, "LCM instance not initialized.  Ignoring call to publishAsync()\n");
+        return -1;
+    }
+    return lcm_publish_async(this->lcm, channel.c_str(), data, datalen);
+}
+
+#if LCM_CXX_11_ENABLED
+inline int LCM::publishAsync(const std::string &channel, std::vector<uint8_t> &&buf)
+{
+    if (!this->lcm) {
+        fprintf(stderr, "LCM instance not initialized.  Ignoring call to publishAsync()\n");
+        return -1;
+    }
+    std::vector<uint8_t> *owned = new std::vector<uint8_t>(std::move(buf));
+    return lcm_publish_async_buffer(this->lcm, channel.c_str(), owned->data(), owned->size(),
+                                    &LCM::releaseVector, owned);
+}
+
+inline void LCM::releaseVector(void * /* data */, void *user_data)
+{
+    delete static_cast<std::vector<uint8_t> *>(user_data);
+}
+#endif
+
+template <class MessageType>
+inline int LCM::publishAsync(const std::string &channel, const MessageType *msg)
+{
+    if (!this->lcm) {
+        fprintf(stderr, "LCM instance not initialized.  Ignoring call to publishAsync()\n");
+        return -1;
+    }
     unsigned int datalen = msg->getEncodedSize();
     uint8_t *buf = new uint8_t[datalen];
     msg->encode(buf, 0, datalen);
-    int status = this->publish(channel, buf, datalen);
-    delete[] buf;
-    return status;
+    return lcm_publish_async_buffer(this->lcm, channel.c_str(), buf, datalen, &LCM::releaseArray,
+                                    NULL);
+}
+
+inline void LCM::releaseArray(void *data, void * /* user_data */)
+{
+    delete[] static_cast<uint8_t *>(data);
+}
+
+inline int LCM::publishBatch(const Batch &batch)
+{
+    if (!this->lcm) {
+        fprintf(stderr, "LCM instance not initialized.  Ignoring call to publishBatch()\n");
+        return -1;
+    }
+    // the buffer may have moved while messages were added
+    batch.msgs.resize(batch.num_msgs);
+    size_t start = 0;
+    for (int i = 0; i < batch.num_msgs; i++) {
+        batch.msgs[i].channel = batch.channels[i].c_str();
+        batch.msgs[i].data = batch.buf.empty() ? NULL : &batch.buf[start];
+        batch.msgs[i].datalen = static_cast<unsigned int>(batch.ends[i] - start);
+        start = batch.ends[i];
+    }
+    return lcm_publish_batch(this->lcm, batch.msgs.empty() ? NULL : &batch.msgs[0],
+                             batch.num_msgs);
+}
+
+inline LCM::Batch::Batch() : num_msgs(0), buf_len(0) {}
+
+inline std::string &LCM::Batch::nextChannel(const std::string &channel)
+{
+    // the strings are reused, so that their memory is too
+    if (channels.size() <= static_cast<size_t>(num_msgs)) {
+        channels.push_back(channel);
+        ends.push_back(0);
+    } else {
+        channels[num_msgs] = channel;
+    }
+    return channels[num_msgs];
+}
+
+template <class MessageType>
+inline int LCM::Batch::add(const std::string &channel, const MessageType *msg)
+{
+    int maxlen = msg->getEncodedSize();
+    if (maxlen < 0)
+        return -1;
+    if (buf.size() < buf_len + maxlen)
+        buf.resize(buf_len + maxlen);
+    int datalen = maxlen ? msg->encode(&buf[buf_len], 0, maxlen) : 0;
+    if (datalen < 0)
+        return -1;
+    nextChannel(channel);
+    buf_len += datalen;
+    ends[num_msgs++] = buf_len;
+    return 0;
+}
+
+inline void LCM::Batch::add(const std::string &channel, const void *data, unsigned int datalen)
+{
+    if (buf.size() < buf_len + datalen)
+        buf.resize(buf_len + datalen);
+    if (datalen)
+        memcpy(&buf[buf_len], data, datalen);
+    nextChannel(channel);
+    buf_len += datalen;
+    ends[num_msgs++] = buf_len;
+}
+
+inline void LCM::Batch::clear()
+{
+    num_msgs = 0;
+    buf_len = 0;
+}
+
+inline int LCM::Batch::size() const
+{
+    return num_msgs;
+}
+
+template <class MessageType>
+LCM::Publisher<MessageType>::Publisher(LCM *lcm, const std::string &channel)
+    : publisher(lcm->lcm ? lcm_publisher_create(lcm->lcm, channel.c_str()) : NULL)
+{
+}
+
+template <class MessageType>
+LCM::Publisher<MessageType>::~Publisher()
+{
+    lcm_publisher_destroy(publisher);
+}
+
+template <class MessageType>
+bool LCM::Publisher<MessageType>::good() const
+{
+    return publisher != NULL;
+}
+
+template <class MessageType>
+inline int encodeToVector(const MessageType &msg, std::vector<uint8_t> &buf)
+{
+    // encode() fails if the buffer is too small
+    buf.resize(buf.capacity());
+    int datalen = buf.empty() ? -1 : msg.encode(&buf[0], 0, static_cast<int>(buf.size()));
+    if (datalen < 0) {
+        int maxlen = msg.getEncodedSize();
+        if (maxlen < 0 || static_cast<size_t>(maxlen) <= buf.size())
+            return -1;
+        buf.resize(maxlen);
+        datalen = msg.encode(&buf[0], 0, maxlen);
+        if (datalen < 0)
+            return -1;
+    }
+    buf.resize(datalen);
+    return datalen;
+}
+
+template <class MessageType>
+int LCM::Publisher<MessageType>::publish(const MessageType *msg)
+{
+    // the message would be dropped anyway
+    if (publisher && !lcm_publisher_has_subscribers(publisher))
+        return 0;
+    int datalen = encodeToVector(*msg, buf);
+    if (datalen < 0)
+        return -1;
+    return this->publish(&buf[0], datalen);
+}
+
+template <class MessageType>
+int LCM::Publisher<MessageType>::publish(const void *data, unsigned int datalen)
+{
+    if (!publisher) {
+        fprintf(stderr, "LCM publisher not initialized.  Ignoring call to publish()\n");
+        return -1;
+    }
+    return lcm_publisher_publish(publisher, data, datalen);
+}
+
+template <class MessageType>
+lcm_publisher_t *LCM::Publisher<MessageType>::getUnderlyingPublisher()
+{
+    return publisher;
+}
+
+template <class MessageType>
+bool LCM::Publisher<MessageType>::hasSubscribers()
+{
+    return !publisher || lcm_publisher_has_subscribers(publisher);
 }
 
 inline int LCM::unsubscribe(Subscription *subscription)
@@ -179,6 +676,19 @@ inline int LCM::unsubscribe(Subscription *subscription)
     std::vector<Subscription *>::iterator eiter = subscriptions.end();
     for (iter = subscriptions.begin(); iter != eiter; ++iter) {
         if (*iter == subscription) {
+#if LCM_CXX_11_ENABLED
+            // drop its messages that are still being decoded
+            std::deque<LCMDecodeAheadJob *>::iterator job = decode_ahead_jobs.begin();
+            while (job != decode_ahead_jobs.end()) {
+                if ((*job)->subscription != subscription) {
+                    ++job;
+                    continue;
+                }
+                (*job)->wait();
+                delete *job;
+                job = decode_ahead_jobs.erase(job);
+            }
+#endif
             int status = lcm_unsubscribe(lcm, subscription->c_subs);
             subscriptions.erase(iter);
             delete subscription;
@@ -188,6 +698,15 @@ inline int LCM::unsubscribe(Subscription *subscription)
     return -1;
 }
 
+inline int LCM::setChannelPriority(const std::string &channel, int priority)
+{
+    if (!this->lcm) {
+        fprintf(stderr, "LCM instance not initialized.  Ignoring call to setChannelPriority()\n");
+        return -1;
+    }
+    return lcm_set_channel_priority(lcm, channel.c_str(), priority);
+}
+
 inline int LCM::getFileno()
 {
     if (!this->lcm) {
@@ -203,7 +722,11 @@ inline int LCM::handle()
         fprintf(stderr, "LCM instance not initialized.  Ignoring call to handle()\n");
         return -1;
     }
-    return lcm_handle(this->lcm);
+    int status = lcm_handle(this->lcm);
+#if LCM_CXX_11_ENABLED
+    finishDecodeAhead();
+#endif
+    return status;
 }
 
 inline int LCM::handleTimeout(int timeout_millis)
@@ -212,13 +735,83 @@ inline int LCM::handleTimeout(int timeout_millis)
         fprintf(stderr, "LCM instance not initialized.  Ignoring call to handle()\n");
         return -1;
     }
-    return lcm_handle_timeout(this->lcm, timeout_millis);
+    int status = lcm_handle_timeout(this->lcm, timeout_millis);
+#if LCM_CXX_11_ENABLED
+    finishDecodeAhead();
+#endif
+    return status;
+}
+
+inline int LCM::handleBatch(int max_msgs, int timeout_millis)
+{
+    if (!this->lcm) {
+        fprintf(stderr, "LCM instance not initialized.  Ignoring call to handleBatch()\n");
+        return -1;
+    }
+    int status = lcm_handle_batch(this->lcm, max_msgs, timeout_millis);
+#if LCM_CXX_11_ENABLED
+    finishDecodeAhead();
+#endif
+    return status;
+}
+
+inline int LCM::tryHandle(int max_msgs)
+{
+    if (!this->lcm) {
+        fprintf(stderr, "LCM instance not initialized.  Ignoring call to tryHandle()\n");
+        return -1;
+    }
+    int status = lcm_try_handle(this->lcm, max_msgs);
+#if LCM_CXX_11_ENABLED
+    finishDecodeAhead();
+#endif
+    return status;
+}
+
+#if LCM_CXX_11_ENABLED
+inline void LCM::finishDecodeAhead()
+{
+    while (!decode_ahead_jobs.empty()) {
+        LCMDecodeAheadJob *job = decode_ahead_jobs.front();
+        decode_ahead_jobs.pop_front();
+        job->wait();
+        job->handle();
+        delete job;
+    }
+}
+#endif
+
+inline int LCM::getStats(lcm_stats_t *stats)
+{
+    if (!this->lcm) {
+        fprintf(stderr, "LCM instance not initialized.  Ignoring call to getStats()\n");
+        return -1;
+    }
+    return lcm_get_stats(this->lcm, stats);
+}
+
+inline int LCM::setHandlerStats(bool enable)
+{
+    if (!this->lcm) {
+        fprintf(stderr, "LCM instance not initialized.  Ignoring call to setHandlerStats()\n");
+        return -1;
+    }
+    return lcm_set_handler_stats(this->lcm, enable ? 1 : 0);
 }
 
-template <class MessageType, class MessageHandlerClass>
+inline int LCM::publishHandlerStats(const std::string &channel)
+{
+    if (!this->lcm) {
+        fprintf(stderr, "LCM instance not initialized.  Ignoring call to publishHandlerStats()\n");
+        return -1;
+    }
+    return lcm_publish_handler_stats(this->lcm, channel.c_str());
+}
+
+template <class MessageType, class MessageHandlerClass, class ChannelType>
 Subscription *LCM::subscribe(const std::string &channel,
                              void (MessageHandlerClass::*handlerMethod)(const ReceiveBuffer *rbuf,
-                                                                        const std::string &channel,
+                                                                        ChannelType channel,
                                                                         const MessageType *msg),
                              MessageHandlerClass *handler)
 {
@@ -226,73 +819,73 @@ Subscription *LCM::subscribe(const std::string &channel,
         fprintf(stderr, "LCM instance not initialized.  Ignoring call to subscribe()\n");
         return NULL;
     }
-    LCMMHSubscription<MessageType, MessageHandlerClass> *subs =
-        new LCMMHSubscription<MessageType, MessageHandlerClass>();
+    typedef LCMMHSubscription<MessageType, MessageHandlerClass, ChannelType> SubsClass;
+    SubsClass *subs = new SubsClass();
     subs->handler = handler;
     subs->handlerMethod = handlerMethod;
-    subs->c_subs =
-        lcm_subscribe(this->lcm, channel.c_str(),
-                      LCMMHSubscription<MessageType, MessageHandlerClass>::cb_func, subs);
+    subs->c_subs = lcm_subscribe(this->lcm, channel.c_str(), SubsClass::cb_func, subs);
+    subs->owner = this;
     subscriptions.push_back(subs);
     return subs;
 }
 
-template <class MessageHandlerClass>
+template <class MessageHandlerClass, class ChannelType>
 Subscription *LCM::subscribe(const std::string &channel,
                              void (MessageHandlerClass::*handlerMethod)(const ReceiveBuffer *rbuf,
-                                                                        const std::string &channel),
+                                                                        ChannelType channel),
                              MessageHandlerClass *handler)
 {
     if (!this->lcm) {
         fprintf(stderr, "LCM instance not initialized.  Ignoring call to subscribe()\n");
         return NULL;
     }
-    LCMMHUntypedSubscription<MessageHandlerClass> *subs =
-        new LCMMHUntypedSubscription<MessageHandlerClass>();
+    typedef LCMMHUntypedSubscription<MessageHandlerClass, ChannelType> SubsClass;
+    SubsClass *subs = new SubsClass();
     subs->handler = handler;
     subs->handlerMethod = handlerMethod;
-    subs->c_subs = lcm_subscribe(this->lcm, channel.c_str(),
-                                 LCMMHUntypedSubscription<MessageHandlerClass>::cb_func, subs);
+    subs->c_subs = lcm_subscribe(this->lcm, channel.c_str(), SubsClass::cb_func, subs);
+    subs->owner = this;
     subscriptions.push_back(subs);
     return subs;
 }
 
-template <class MessageType, class ContextClass>
+template <class MessageType, class ContextClass, class ChannelType>
 Subscription *LCM::subscribeFunction(const std::string &channel,
                                      void (*handler)(const ReceiveBuffer *rbuf,
-                                                     const std::string &channel,
-                                                     const MessageType *msg, ContextClass context),
+                                                     ChannelType channel, const MessageType *msg,
+                                                     ContextClass context),
                                      ContextClass context)
 {
     if (!this->lcm) {
         fprintf(stderr, "LCM instance not initialized.  Ignoring call to subscribeFunction()\n");
         return NULL;
     }
-    typedef LCMTypedSubscription<MessageType, ContextClass> SubsClass;
+    typedef LCMTypedSubscription<MessageType, ContextClass, ChannelType> SubsClass;
     SubsClass *sub = new SubsClass();
     sub->handler = handler;
     sub->context = context;
     sub->c_subs = lcm_subscribe(lcm, channel.c_str(), SubsClass::cb_func, sub);
+    sub->owner = this;
     subscriptions.push_back(sub);
     return sub;
 }
 
-template <class ContextClass>
+template <class ContextClass, class ChannelType>
 Subscription *LCM::subscribeFunction(const std::string &channel,
                                      void (*handler)(const ReceiveBuffer *rbuf,
-                                                     const std::string &channel,
-                                                     ContextClass context),
+                                                     ChannelType channel, ContextClass context),
                                      ContextClass context)
 {
     if (!this->lcm) {
         fprintf(stderr, "LCM instance not initialized.  Ignoring call to subscribeFunction()\n");
         return NULL;
     }
-    typedef LCMUntypedSubscription<ContextClass> SubsClass;
+    typedef LCMUntypedSubscription<ContextClass, ChannelType> SubsClass;
     SubsClass *sub = new SubsClass();
     sub->handler = handler;
     sub->context = context;
     sub->c_subs = lcm_subscribe(lcm, channel.c_str(), SubsClass::cb_func, sub);
+    sub->owner = this;
     subscriptions.push_back(sub);
     return sub;
 }
@@ -309,29 +902,117 @@ Subscription *LCM::subscribe(const std::string &channel, LCM::HandlerFunction<Me
     subs->handler = handler;
     subs->c_subs = lcm_subscribe(this->lcm, channel.c_str(),
                                  LCMLambdaSubscription<MessageType>::cb_func, subs);
+    subs->owner = this;
     subscriptions.push_back(subs);
     return subs;
 }
 #endif
 
+#if LCM_CXX_COROUTINES_ENABLED
+template <class MessageType>
+MessageStream<MessageType> LCM::next(const std::string &channel)
+{
+    return MessageStream<MessageType>(this, channel);
+}
+
+template <class MessageType>
+MessageStream<MessageType>::MessageStream(LCM *lcm_, const std::string &channel_)
+    : lcm(lcm_), subscription(lcm_->subscribeFunction(channel_, &MessageStream::onMessage, this))
+{
+}
+
+template <class MessageType>
+MessageStream<MessageType>::~MessageStream()
+{
+    if (subscription)
+        lcm->unsubscribe(subscription);
+}
+
+template <class MessageType>
+typename MessageStream<MessageType>::Awaiter MessageStream<MessageType>::next()
+{
+    return Awaiter(this);
+}
+
+template <class MessageType>
+typename MessageStream<MessageType>::Awaiter MessageStream<MessageType>::operator co_await()
+{
+    return Awaiter(this);
+}
+
+template <class MessageType>
+size_t MessageStream<MessageType>::getQueueSize() const
+{
+    return messages.size();
+}
+
+template <class MessageType>
+Subscription *MessageStream<MessageType>::getSubscription()
+{
+    return subscription;
+}
+
+template <class MessageType>
+void MessageStream<MessageType>::onMessage(const ReceiveBuffer *, const char *,
+                                           const MessageType *msg, MessageStream *stream)
+{
+    stream->messages.push_back(*msg);
+    std::coroutine_handle<> waiter = stream->waiter;
+    stream->waiter = nullptr;
+    // the coroutine can destroy the stream, so it isn't used after this
+    if (waiter)
+        waiter.resume();
+}
+
+template <class MessageType>
+bool MessageStream<MessageType>::Awaiter::await_ready() const
+{
+    return !stream->messages.empty();
+}
+
+template <class MessageType>
+void MessageStream<MessageType>::Awaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    stream->waiter = handle;
+}
+
+template <class MessageType>
+MessageType MessageStream<MessageType>::Awaiter::await_resume()
+{
+    MessageType msg = std::move(stream->messages.front());
+    stream->messages.pop_front();
+    return msg;
+}
+#endif
+
 lcm_t *LCM::getUnderlyingLCM()
 {
     return this->lcm;
 }
 
 LogFile::LogFile(const std::string &path, const std::string &mode)
-    : eventlog(lcm_eventlog_create(path.c_str(), mode.c_str())), last_event(NULL)
+    : eventlog(lcm_eventlog_create(path.c_str(), mode.c_str())),
+      last_event(NULL),
+      filename(path),
+      mapped(NULL),
+      cursor(NULL)
 {
 }
 
 LogFile::~LogFile()
 {
+    if (cursor)
+        lcm_eventlog_cursor_destroy(cursor);
+    cursor = NULL;
     if (eventlog)
         lcm_eventlog_destroy(eventlog);
     eventlog = NULL;
     if (last_event)
         lcm_eventlog_free_event(last_event);
     last_event = NULL;
+    if (mapped)
+        lcm_eventlog_mmap_close(mapped);
+    mapped = NULL;
 }
 
 bool LogFile::good() const
@@ -341,7 +1022,11 @@ bool LogFile::good() const
 
 const LogEvent *LogFile::readNextEvent()
 {
-    lcm_eventlog_event_t *evt = lcm_eventlog_read_next_event(eventlog);
+    return setCurEvent(lcm_eventlog_read_next_event(eventlog));
+}
+
+const LogEvent *LogFile::setCurEvent(lcm_eventlog_event_t *evt)
+{
     if (last_event)
         lcm_eventlog_free_event(last_event);
     last_event = evt;
@@ -360,6 +1045,24 @@ int LogFile::seekToTimestamp(int64_t timestamp)
     return lcm_eventlog_seek_to_timestamp(eventlog, timestamp);
 }
 
+int LogFile::seekToEventnum(int64_t eventnum)
+{
+    return lcm_eventlog_seek_to_eventnum(eventlog, eventnum);
+}
+
+const LogEvent *LogFile::readChannelEvent(const std::string &channel, int64_t n)
+{
+    if (!cursor || cursor_channel != channel) {
+        if (cursor)
+            lcm_eventlog_cursor_destroy(cursor);
+        cursor = lcm_eventlog_cursor_create(eventlog, channel.c_str());
+        cursor_channel = channel;
+    }
+    if (lcm_eventlog_cursor_seek(cursor, n) != 0)
+        return setCurEvent(NULL);
+    return setCurEvent(lcm_eventlog_cursor_next(cursor));
+}
+
 int LogFile::writeEvent(LogEvent *event)
 {
     lcm_eventlog_event_t evt;
@@ -376,3 +1079,73 @@ FILE *LogFile::getFilePtr()
 {
     return eventlog->f;
 }
+
+LogFile::iterator LogFile::begin()
+{
+    if (!mapped && eventlog)
+        mapped = lcm_eventlog_mmap_open(filename.c_str());
+    if (!mapped)
+        return iterator();
+    return iterator(mapped);
+}
+
+LogFile::iterator LogFile::end()
+{
+    return iterator();
+}
+
+LogFile::iterator::iterator() : log(NULL) {}
+
+LogFile::iterator::iterator(const lcm_eventlog_mmap_t *mapped) : log(mapped)
+{
+    view.channel = NULL;
+    view.offset = 0;
+    read();
+}
+
+void LogFile::iterator::read()
+{
+    if (lcm_eventlog_next_view(log, &view) < 0) {
+        log = NULL;
+        return;
+    }
+    event.eventnum = view.eventnum;
+    event.timestamp = view.timestamp;
+    event.channel = view.channel;
+    event.channellen = view.channellen;
+    event.datalen = view.datalen;
+    event.data = view.data;
+}
+
+LogFile::iterator::reference LogFile::iterator::operator*() const
+{
+    return event;
+}
+
+LogFile::iterator::pointer LogFile::iterator::operator->() const
+{
+    return &event;
+}
+
+LogFile::iterator &LogFile::iterator::operator++()
+{
+    read();
+    return *this;
+}
+
+LogFile::iterator LogFile::iterator::operator++(int)
+{
+    iterator prev = *this;
+    read();
+    return prev;
+}
+
+bool LogFile::iterator::operator==(const iterator &other) const
+{
+    return log == other.log && (!log || view.offset == other.view.offset);
+}
+
+bool LogFile::iterator::operator!=(const iterator &other) const
+{
+    return !(*this == other);
+}
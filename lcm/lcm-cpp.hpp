@@ -9,14 +9,45 @@
 #endif
 #endif
 
+#ifndef LCM_CXX_17_ENABLED
+#if __cplusplus >= 201703L
+#define LCM_CXX_17_ENABLED 1
+#else
+#define LCM_CXX_17_ENABLED 0
+#endif
+#endif
+
+#ifndef LCM_CXX_COROUTINES_ENABLED
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+#define LCM_CXX_COROUTINES_ENABLED 1
+#else
+#define LCM_CXX_COROUTINES_ENABLED 0
+#endif
+#endif
+
+#include <cstddef>
 #include <cstdio> /* needed for FILE* */
+#include <cstring>
+#include <iterator>
 #include <string>
 #include <vector>
 
 #include "lcm.h"
 
+#if LCM_CXX_17_ENABLED
+#include <string_view>
+#endif
+
 #if LCM_CXX_11_ENABLED
+#include <condition_variable>
+#include <deque>
 #include <functional>
+#include <mutex>
+#include <utility>
+#endif
+
+#if LCM_CXX_COROUTINES_ENABLED
+#include <coroutine>
 #endif
 
 namespace lcm {
@@ -34,8 +65,22 @@ namespace lcm {
 
 class Subscription;
 
+class Dispatcher;
+
 struct ReceiveBuffer;
 
+#if LCM_CXX_11_ENABLED
+class LCMDecodeAheadJob;
+
+template <class MessageType>
+class LCMDecodingSubscription;
+#endif
+
+#if LCM_CXX_COROUTINES_ENABLED
+template <class MessageType>
+class MessageStream;
+#endif
+
 /**
  * @brief Core communications class for the C++ API.
  *
@@ -95,7 +140,10 @@ class LCM {
      * @brief Publishes a message with automatic message encoding.
      *
      * This template method is designed for use with C++ classes generated
-     * by lcm-gen.
+     * by lcm-gen.  The message is encoded into a buffer from
+     * lcm_publish_reserve(), which the memq, shm and tcpq providers send it
+     * from without copying it.  The other providers reuse the buffers, so
+     * that publishing doesn't allocate memory once they are large enough.
      *
      * @param channel the channel to publish the message on.
      * @param msg the message to publish.
@@ -105,6 +153,127 @@ class LCM {
     template <class MessageType>
     inline int publish(const std::string &channel, const MessageType *msg);
 
+    /**
+     * @brief Publishes a message, encoding it into a buffer provided by the
+     * caller.
+     *
+     * @param channel the channel to publish the message on.
+     * @param msg the message to publish.
+     * @param buf the buffer to encode the message into
+     * @param buflen the size of buf, which must be at least
+     *        msg->getEncodedSize() bytes
+     *
+     * @return 0 on success, -1 on failure, or if buf is too small.
+     */
+    template <class MessageType>
+    inline int publish(const std::string &channel, const MessageType *msg, void *buf,
+                       unsigned int buflen);
+
+    /**
+     * @brief Publishes a raw data message on a channel given as a C string,
+     * which doesn't need to be copied into a std::string first.
+     */
+    inline int publish(const char *channel, const void *data, unsigned int datalen);
+
+    /**
+     * @brief Publishes a message on a channel given as a C string.
+     */
+    template <class MessageType>
+    inline int publish(const char *channel, const MessageType *msg);
+
+    /**
+     * @brief Publishes a message on a channel given as a C string, encoding
+     * it into a buffer provided by the caller.
+     */
+    template <class MessageType>
+    inline int publish(const char *channel, const MessageType *msg, void *buf,
+                       unsigned int buflen);
+
+#if LCM_CXX_17_ENABLED
+    /**
+     * @brief Publishes a raw data message on a channel given as a
+     * std::string_view.  The channel name is copied to the stack, unless it
+     * is too long to be a valid channel name.
+     */
+    inline int publish(std::string_view channel, const void *data, unsigned int datalen);
+
+    /**
+     * @brief Publishes a message on a channel given as a std::string_view.
+     */
+    template <class MessageType>
+    inline int publish(std::string_view channel, const MessageType *msg);
+
+    /**
+     * @brief Publishes a message on a channel given as a std::string_view,
+     * encoding it into a buffer provided by the caller.
+     */
+    template <class MessageType>
+    inline int publish(std::string_view channel, const MessageType *msg, void *buf,
+                       unsigned int buflen);
+#endif
+
+    /**
+     * @brief Publishes a raw data message without waiting for it to be
+     * transmitted.
+     *
+     * The message is copied to the send queue, which is enabled with the
+     * @c send_queue option of the udpm provider.  See lcm_publish_async().
+     *
+     * @param channel the channel to publish the message on.
+     * @param data data buffer containing the message to publish
+     * @param datalen length of the message, in bytes.
+     *
+     * @return 0 on success, -1 on failure, or if the send queue was full.
+     */
+    inline int publishAsync(const std::string &channel, const void *data, unsigned int datalen);
+
+#if LCM_CXX_11_ENABLED
+    /**
+     * @brief Publishes an already encoded message without waiting for it to
+     * be transmitted, or copying it.
+     *
+     * The send queue takes ownership of buf, and frees it once the message has
+     * been transmitted.  See lcm_publish_async_buffer().
+     *
+     * @param channel the channel to publish the message on.
+     * @param buf the encoded message.
+     *
+     * @return 0 on success, -1 on failure, or if the send queue was full.
+     */
+    inline int publishAsync(const std::string &channel, std::vector<uint8_t> &&buf);
+#endif
+
+    /**
+     * @brief Publishes a message with automatic message encoding, without
+     * waiting for it to be transmitted.
+     *
+     * The message is encoded into a buffer that is handed over to the send
+     * queue, so it is not copied again.  See lcm_publish_async_buffer().
+     *
+     * @param channel the channel to publish the message on.
+     * @param msg the message to publish.
+     *
+     * @return 0 on success, -1 on failure, or if the send queue was full.
+     */
+    template <class MessageType>
+    inline int publishAsync(const std::string &channel, const MessageType *msg);
+
+    template <class MessageType>
+    class Publisher;
+
+    class Batch;
+
+    /**
+     * @brief Publishes the messages of a batch, in order.
+     *
+     * @param batch the messages to publish.  They stay in the batch until it
+     * is cleared.
+     *
+     * @return 0 on success, -1 if any of the messages failed to be published.
+     * @sa lcm_publish_batch()
+     */
+    inline int publishBatch(const Batch &batch);
+
     /**
      * @brief Returns a file descriptor or socket that can be used with
      * @c select(), @c poll(), or other event loops for asynchronous
@@ -142,6 +311,50 @@ class LCM {
      */
     inline int handleTimeout(int timeout_millis);
 
+    /**
+     * @brief Waits for messages, then dispatches up to @p max_msgs of the
+     * ones that have been received, with a timeout.
+     *
+     * @return the number of messages handled, 0 if the function timed out,
+     * and <0 if an error occured.
+     * @sa lcm_handle_batch()
+     */
+    inline int handleBatch(int max_msgs, int timeout_millis);
+
+    /**
+     * @brief Dispatches up to @p max_msgs of the messages that have already
+     * been received, without blocking.  Call this from an external event
+     * loop when getFileno() is readable.
+     *
+     * @return the number of messages handled, 0 if none were ready, and <0
+     * if an error occured.
+     * @sa lcm_try_handle()
+     */
+    inline int tryHandle(int max_msgs);
+
+    /**
+     * @brief Reads the receive statistics of this LCM instance.
+     *
+     * @return 0 on success, -1 if the provider does not keep statistics.
+     * @sa lcm_get_stats()
+     */
+    inline int getStats(lcm_stats_t *stats);
+
+    /**
+     * @brief Enables or disables timing the calls to the handlers of the
+     * subscriptions.
+     *
+     * @sa lcm_set_handler_stats()
+     */
+    inline int setHandlerStats(bool enable);
+
+    /**
+     * @brief Publishes the timings of the handlers of all subscriptions.
+     *
+     * @sa lcm_publish_handler_stats()
+     */
+    inline int publishHandlerStats(const std::string &channel = LCM_STATS_CHANNEL);
+
     /**
      * @brief Subscribes a callback method of an object to a channel, with
      * automatic message decoding.
@@ -187,7 +400,9 @@ class LCM {
      * @param channel The channel to subscribe to.  This is treated as a
      * regular expression implicitly surrounded by '^' and '$'.
      * @param handlerMethod A class method pointer identifying the callback
-     * method.
+     * method.  Its channel parameter can be a const std::string &, a const
+     * char * or, with C++17, a std::string_view.  The latter two don't copy
+     * the channel name for every message.
      * @param handler A class instance that the callback method will be
      * invoked on.
      *
@@ -196,10 +411,10 @@ class LCM {
      * the LCM class, and is automatically destroyed when its LCM instance
      * is destroyed.
      */
-    template <class MessageType, class MessageHandlerClass>
+    template <class MessageType, class MessageHandlerClass, class ChannelType>
     Subscription *subscribe(const std::string &channel,
                             void (MessageHandlerClass::*handlerMethod)(const ReceiveBuffer *rbuf,
-                                                                       const std::string &channel,
+                                                                       ChannelType channel,
                                                                        const MessageType *msg),
                             MessageHandlerClass *handler);
 
@@ -241,7 +456,8 @@ class LCM {
      * @param channel The channel to subscribe to.  This is treated as a
      * regular expression implicitly surrounded by '^' and '$'.
      * @param handlerMethod A class method pointer identifying the callback
-     * method.
+     * method.  Its channel parameter can have the same types as for the
+     * subscribe() method with automatic message decoding.
      * @param handler A class instance that the callback method will be
      * invoked on.
      *
@@ -250,10 +466,10 @@ class LCM {
      * the LCM class, and is automatically destroyed when its LCM instance
      * is destroyed.
      */
-    template <class MessageHandlerClass>
+    template <class MessageHandlerClass, class ChannelType>
     Subscription *subscribe(const std::string &channel,
                             void (MessageHandlerClass::*handlerMethod)(const ReceiveBuffer *rbuf,
-                                                                       const std::string &channel),
+                                                                       ChannelType channel),
                             MessageHandlerClass *handler);
 
     /**
@@ -303,7 +519,8 @@ class LCM {
      * @param channel The channel to subscribe to.  This is treated as a
      * regular expression implicitly surrounded by '^' and '$'.
      * @param handler A function pointer identifying the callback
-     * function.
+     * function.  Its channel parameter can have the same types as for
+     * subscribe().
      * @param context A context variable that will be passed to the
      * callback function.  This can be used to pass state or other
      * information to the callback function.  If not needed, then @c
@@ -314,11 +531,11 @@ class LCM {
      * the LCM class, and is automatically destroyed when its LCM instance
      * is destroyed.
      */
-    template <class MessageType, class ContextClass>
+    template <class MessageType, class ContextClass, class ChannelType>
     Subscription *subscribeFunction(const std::string &channel,
                                     void (*handler)(const ReceiveBuffer *rbuf,
-                                                    const std::string &channel,
-                                                    const MessageType *msg, ContextClass context),
+                                                    ChannelType channel, const MessageType *msg,
+                                                    ContextClass context),
                                     ContextClass context);
 
     /**
@@ -350,7 +567,8 @@ class LCM {
      * @param channel The channel to subscribe to.  This is treated as a
      * regular expression implicitly surrounded by '^' and '$'.
      * @param handler A function pointer identifying the callback
-     * function.
+     * function.  Its channel parameter can have the same types as for
+     * subscribe().
      * @param context A context variable that will be passed to the
      * callback function.  This can be used to pass state or other
      * information to the callback function.  If not needed, then @c
@@ -361,11 +579,10 @@ class LCM {
      * the LCM class, and is automatically destroyed when its LCM instance
      * is destroyed.
      */
-    template <class ContextClass>
+    template <class ContextClass, class ChannelType>
     Subscription *subscribeFunction(const std::string &channel,
                                     void (*handler)(const ReceiveBuffer *rbuf,
-                                                    const std::string &channel,
-                                                    ContextClass context),
+                                                    ChannelType channel, ContextClass context),
                                     ContextClass context);
 
 #if LCM_CXX_11_ENABLED
@@ -427,6 +644,31 @@ class LCM {
     Subscription *subscribe(const std::string &channel, HandlerFunction<MessageType> handler);
 #endif
 
+#if LCM_CXX_COROUTINES_ENABLED
+    /**
+     * @brief Subscribes to a channel for a coroutine to await its next
+     * message.
+     *
+     * For example:
+     *
+     * \code
+     * exlcm::example_t msg = co_await lcm.next<exlcm::example_t>("CHANNEL");
+     * \endcode
+     *
+     * The subscription is made by this call and removed when the returned
+     * MessageStream is destroyed, at the end of the co_await expression.
+     * Use a MessageStream object directly to await more than one message.
+     *
+     * @param channel The channel to subscribe to.  This is treated as a
+     * regular expression implicitly surrounded by '^' and '$'.
+     *
+     * @return a MessageStream for the subscription.  Awaiting it gives the
+     * next message.
+     */
+    template <class MessageType>
+    MessageStream<MessageType> next(const std::string &channel);
+#endif
+
     /**
      * @brief Unsubscribes a message handler.
      *
@@ -443,6 +685,18 @@ class LCM {
      */
     inline int unsubscribe(Subscription *subscription);
 
+    /**
+     * @brief Puts the channels matching a pattern in a priority class, so
+     * that their received messages are dispatched before the ones of lower
+     * classes.
+     *
+     * @param channel the channel name pattern, a regular expression
+     * @param priority the priority class, from 0 to LCM_MAX_PRIORITY
+     *
+     * @sa lcm_set_channel_priority()
+     */
+    inline int setChannelPriority(const std::string &channel, int priority);
+
     /**
      * @brief retrives the lcm_t C data structure wrapped by this class.
      *
@@ -460,7 +714,30 @@ class LCM {
     lcm_t *lcm;
     bool owns_lcm;
 
+    // frees the buffers handed over by publishAsync()
+    static inline void releaseArray(void *data, void *user_data);
+#if LCM_CXX_11_ENABLED
+    static inline void releaseVector(void *data, void *user_data);
+#endif
+#if LCM_CXX_17_ENABLED
+    // copies channel to name, which has room for the longest valid channel
+    // name, and terminates it.  Returns false if channel is too long.
+    static inline bool copyChannel(std::string_view channel, char *name);
+#endif
+
     std::vector<Subscription *> subscriptions;
+
+#if LCM_CXX_11_ENABLED
+    template <class MessageType>
+    friend class LCMDecodingSubscription;
+
+    // calls the handlers of the messages that the subscriptions with
+    // Subscription::setDecodeAhead() have started decoding, in order
+    inline void finishDecodeAhead();
+
+    // the messages that are being decoded ahead of their handlers
+    std::deque<LCMDecodeAheadJob *> decode_ahead_jobs;
+#endif
 };
 
 /**
@@ -482,6 +759,17 @@ struct ReceiveBuffer {
      * microseconds since the UNIX epoch.
      */
     int64_t recv_utime;
+    /**
+     * The same timestamp, in nanoseconds since the UNIX epoch.  See
+     * lcm_recv_buf_t::recv_time_ns for when it is more precise than
+     * recv_utime.
+     */
+    int64_t recv_time_ns;
+    /**
+     * When the message was received, in nanoseconds on the monotonic clock
+     * of lcm_monotonic_ns().  See lcm_recv_buf_t::recv_mono_ns.
+     */
+    int64_t recv_mono_ns;
 };
 
 /**
@@ -516,16 +804,129 @@ class Subscription {
      */
     inline int setQueueCapacity(int num_messages);
 
+    /**
+     * @brief Makes this subscription keep only the latest of its received
+     * messages, and drop the older ones that are still waiting.
+     *
+     * @sa lcm_subscription_set_conflate()
+     */
+    inline int setConflate(bool conflate);
+
+    /**
+     * @brief Limits how often the handler of this subscription is called,
+     * skipping the messages in between before they are decoded.
+     *
+     * @sa lcm_subscription_set_max_rate()
+     */
+    inline int setMaxRate(double hz);
+
+    /**
+     * @brief Chooses what this subscription does with a received message when
+     * its queue is full.
+     *
+     * @sa lcm_subscription_set_drop_policy()
+     */
+    inline int setDropPolicy(lcm_drop_policy_t policy);
+
+    /**
+     * @brief Puts the channels that this subscription matches in a priority
+     * class.
+     *
+     * @sa lcm_subscription_set_priority()
+     */
+    inline int setPriority(int priority);
+
     /**
      * @brief Query the current number of unhandled messages queued up for
      * this subscription.
      */
     inline int getQueueSize() const;
 
+    /**
+     * @brief Query the number of messages dropped so far because the queue
+     * of this subscription was full, or because newer messages replaced them.
+     */
+    inline uint64_t getDropCount() const;
+
+    /**
+     * @brief Query the number of messages dropped so far under one drop
+     * policy.
+     *
+     * @sa lcm_subscription_get_policy_drop_count()
+     */
+    inline uint64_t getPolicyDropCount(lcm_drop_policy_t policy) const;
+
+    /**
+     * @brief Reads the timings of the calls to the handler of this
+     * subscription.
+     *
+     * @sa lcm_subscription_get_handler_stats()
+     */
+    inline int getHandlerStats(lcm_handler_stats_t *stats) const;
+
+    /**
+     * @brief Runs the handler of this subscription on a dispatcher, instead
+     * of in LCM::handle().
+     *
+     * The handler gets the messages of this subscription in order, one at a
+     * time, in parallel with the handlers of other subscriptions.
+     *
+     * @param dispatcher the dispatcher to run the handler on, or NULL to go
+     * back to running it in LCM::handle()
+     *
+     * @sa lcm_subscription_set_executor()
+     */
+    inline int setExecutor(Dispatcher *dispatcher);
+
+    /**
+     * @brief Makes this subscription decode every message into the same
+     * message object, instead of a new one each time.
+     *
+     * The object keeps the capacity of its vectors and strings between
+     * messages, so that decoding a message no larger than the previous ones
+     * doesn't allocate memory.  The handler must not use the message after it
+     * returns, since the next message overwrites it.  This has no effect on
+     * subscriptions that don't decode their messages.
+     *
+     * @param reuse true to reuse the message object, false to decode into a
+     * new one for every message, which is the default.
+     */
+    inline void setMessageReuse(bool reuse);
+
+#if LCM_CXX_11_ENABLED
+    /**
+     * @brief Decodes the messages of this subscription on a dispatcher, ahead
+     * of the handler.
+     *
+     * The messages are handed to the dispatcher as soon as LCM::handle(),
+     * or one of the other handle methods, receives them, and decoded there
+     * in parallel.  The handler is still called from the handle method, on
+     * its thread, with the decoded messages in the order in which they were
+     * received, before the method returns.  So when LCM::handleBatch() or
+     * LCM::tryHandle() dispatch several messages, the handler of one runs
+     * while the next ones are decoded.  The handlers of the other
+     * subscriptions may run before it.
+     *
+     * Every message is decoded into a message object of its own, so
+     * setMessageReuse() has no effect, and the received buffer is kept with
+     * lcm_recv_buf_retain() until the handler returns.  This has no effect on
+     * subscriptions that don't decode their messages, or while the handler
+     * runs on a dispatcher of setExecutor().
+     *
+     * @param dispatcher the dispatcher to decode on, or NULL to decode in the
+     * handle methods again, which is the default.  It has to outlive the
+     * subscription.
+     */
+    inline void setDecodeAhead(Dispatcher *dispatcher);
+#endif
+
     friend class LCM;
 
   protected:
-    Subscription() { channel_buf.reserve(LCM_MAX_CHANNEL_NAME_LENGTH); };
+    Subscription() : reuse_message(false), owner(NULL), executor(NULL), decode_ahead(NULL)
+    {
+        channel_buf.reserve(LCM_MAX_CHANNEL_NAME_LENGTH);
+    };
 
     /**
      * The underlying lcm_subscription_t object wrapped by this
@@ -538,7 +939,317 @@ class Subscription {
     // would otherwise occur and which could preclude use in real-time
     // applications.
     std::string channel_buf;
+
+    // set by setMessageReuse()
+    bool reuse_message;
+
+    // the LCM that the subscription belongs to
+    LCM *owner;
+    // set by setExecutor()
+    lcm_dispatcher_t *executor;
+    // set by setDecodeAhead()
+    lcm_dispatcher_t *decode_ahead;
+};
+
+/**
+ * @brief Encodes a message into a vector, reusing its capacity.
+ *
+ * The message is encoded straight into the capacity of @p buf.  Only when
+ * that is too small is the encoded size computed, and the vector grown to
+ * it, so that encoding into the same vector again takes a single pass over
+ * the message once the vector is large enough.  @p buf is resized to the
+ * encoded message.
+ *
+ * @param msg the message to encode, of a type generated by lcm-gen.
+ * @param buf the vector to encode the message into.
+ * @return the number of bytes encoded, or -1 on failure.
+ *
+ * @headerfile lcm/lcm-cpp.hpp
+ */
+template <class MessageType>
+inline int encodeToVector(const MessageType &msg, std::vector<uint8_t> &buf);
+
+/**
+ * @brief Publishes messages on one channel, without looking up the channel
+ * for every message.
+ *
+ * This class is the C++ counterpart for lcm_publisher_t.  Messages are
+ * encoded into a buffer that the publisher keeps, so that publishing doesn't
+ * allocate memory once it is large enough.  Use a publisher from one thread
+ * at a time, and destroy it before its LCM instance.
+ *
+ * For example:
+ *
+ * \code
+ * lcm::LCM::Publisher<exlcm::example_t> publisher(&lcm, "EXAMPLE");
+ * publisher.publish(&msg);
+ * \endcode
+ *
+ * @sa lcm_publisher_create()
+ *
+ * @headerfile lcm/lcm-cpp.hpp
+ */
+template <class MessageType>
+class LCM::Publisher {
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param lcm the LCM instance to publish with
+     * @param channel the channel to publish on
+     */
+    inline Publisher(LCM *lcm, const std::string &channel);
+
+    inline ~Publisher();
+
+    /**
+     * @return true if the channel can be published on.
+     */
+    inline bool good() const;
+
+    /**
+     * @brief Encodes and publishes a message, unless nobody subscribes to the
+     * channel.
+     *
+     * @return 0 on success, -1 on failure.
+     */
+    inline int publish(const MessageType *msg);
+
+    /**
+     * @brief Publishes a message that is already encoded.
+     *
+     * @return 0 on success, -1 on failure.
+     */
+    inline int publish(const void *data, unsigned int datalen);
+
+    /**
+     * @brief retrieves the lcm_publisher_t C data structure wrapped by this
+     * class.
+     */
+    inline lcm_publisher_t *getUnderlyingPublisher();
+
+    /**
+     * @return false if nobody subscribes to the channel.
+     *
+     * @sa lcm_publisher_has_subscribers()
+     */
+    inline bool hasSubscribers();
+
+  private:
+    lcm_publisher_t *publisher;
+    std::vector<uint8_t> buf;
+
+    // not copyable
+    Publisher(const Publisher &);
+    Publisher &operator=(const Publisher &);
+};
+
+/**
+ * @brief Messages encoded ahead of time, to be published together with
+ * LCM::publishBatch().
+ *
+ * The messages are encoded into a buffer that the batch keeps, so that a batch
+ * that is cleared and filled again doesn't allocate memory once it is large
+ * enough.  For example, once per cycle:
+ *
+ * \code
+ * batch.clear();
+ * batch.add("POSE", &pose);
+ * batch.add("VELOCITY", &velocity);
+ * lcm.publishBatch(batch);
+ * \endcode
+ *
+ * @headerfile lcm/lcm-cpp.hpp
+ */
+class LCM::Batch {
+  public:
+    inline Batch();
+
+    /**
+     * @brief Encodes a message, and adds it to the batch.
+     *
+     * @return 0 on success, -1 if the message failed to be encoded.
+     */
+    template <class MessageType>
+    inline int add(const std::string &channel, const MessageType *msg);
+
+    /**
+     * @brief Adds a copy of a message that is already encoded to the batch.
+     */
+    inline void add(const std::string &channel, const void *data, unsigned int datalen);
+
+    /**
+     * @brief Removes the messages from the batch, keeping its buffers.
+     */
+    inline void clear();
+
+    /**
+     * @return the number of messages in the batch.
+     */
+    inline int size() const;
+
+  private:
+    friend class LCM;
+
+    int num_msgs;
+    // the encoded messages, back to back
+    std::vector<uint8_t> buf;
+    size_t buf_len;
+    // the channel of each message, and where it ends in buf
+    std::vector<std::string> channels;
+    std::vector<size_t> ends;
+    mutable std::vector<lcm_publish_msg_t> msgs;
+
+    inline std::string &nextChannel(const std::string &channel);
+};
+
+/**
+ * @brief A pool of threads that runs message handlers outside of
+ * LCM::handle().
+ *
+ * This class is the C++ counterpart for lcm_dispatcher_t.  Pass it to
+ * Subscription::setExecutor().  Destroy it after the LCM instances whose
+ * subscriptions use it.
+ *
+ * @headerfile lcm/lcm-cpp.hpp
+ */
+class Dispatcher {
+  public:
+    /**
+     * @brief Constructor.  Starts the threads.
+     *
+     * @param num_threads the number of threads, at least 1
+     *
+     * @sa lcm_dispatcher_create()
+     */
+    inline explicit Dispatcher(int num_threads);
+
+    /**
+     * @brief Destructor.  Waits for the queued messages to be handled, and
+     * stops the threads.
+     */
+    inline ~Dispatcher();
+
+    /**
+     * @return true if the threads were started successfully.
+     */
+    inline bool good() const;
+
+    /**
+     * @brief retrieves the lcm_dispatcher_t C data structure wrapped by this
+     * class.
+     */
+    inline lcm_dispatcher_t *getUnderlyingDispatcher();
+
+  private:
+    lcm_dispatcher_t *dispatcher;
+
+    // not copyable
+    Dispatcher(const Dispatcher &);
+    Dispatcher &operator=(const Dispatcher &);
+};
+
+#if LCM_CXX_COROUTINES_ENABLED
+/**
+ * @brief A subscription whose decoded messages are awaited by a coroutine.
+ *
+ * The messages are queued by the subscription as they are handled, and
+ * given out in order by <tt>co_await stream.next()</tt>.  A coroutine that
+ * has to wait for a message is resumed by the thread that handles it, from
+ * within LCM::handle(), LCM::tryHandle() or the other handle methods.  So
+ * one thread can serve any number of coroutines, for example by calling
+ * LCM::tryHandle() whenever LCM::getFileno() is readable in its own event
+ * loop, and no thread has to block in LCM::handle().
+ *
+ * Only one coroutine at a time can await a stream.  Don't set an executor
+ * on its subscription.  Destroy the stream before its LCM instance.
+ *
+ * For example:
+ *
+ * \code
+ * lcm::MessageStream<exlcm::example_t> stream(&lcm, "CHANNEL");
+ * while (true) {
+ *     exlcm::example_t msg = co_await stream.next();
+ *     // do something with the message
+ * }
+ * \endcode
+ *
+ * @headerfile lcm/lcm-cpp.hpp
+ */
+template <class MessageType>
+class MessageStream {
+  public:
+    /**
+     * @brief The awaitable returned by next().
+     */
+    class Awaiter {
+      public:
+        inline bool await_ready() const;
+        inline void await_suspend(std::coroutine_handle<> handle);
+        inline MessageType await_resume();
+
+      private:
+        friend class MessageStream;
+        explicit Awaiter(MessageStream *stream_) : stream(stream_) {}
+
+        MessageStream *stream;
+    };
+
+    /**
+     * @brief Constructor.  Subscribes to a channel.
+     *
+     * @param lcm_ the LCM instance to subscribe with
+     * @param channel_ The channel to subscribe to.  This is treated as a
+     * regular expression implicitly surrounded by '^' and '$'.
+     */
+    inline MessageStream(LCM *lcm_, const std::string &channel_);
+
+    /**
+     * @brief Destructor.  Unsubscribes, and drops the queued messages.
+     */
+    inline ~MessageStream();
+
+    MessageStream(const MessageStream &) = delete;
+    MessageStream &operator=(const MessageStream &) = delete;
+
+    /**
+     * @brief Awaits the next message of the subscription.
+     *
+     * The returned object is awaited with co_await, which suspends the
+     * coroutine until a message is handled if none is queued yet, and gives
+     * the message.
+     */
+    inline Awaiter next();
+
+    /**
+     * @brief Same as next(), so that the stream can be awaited itself.
+     */
+    inline Awaiter operator co_await();
+
+    /**
+     * @return the number of messages that have been handled but not awaited
+     * yet.
+     */
+    inline size_t getQueueSize() const;
+
+    /**
+     * @return the subscription of the stream, for example to adjust its
+     * queue, or NULL if the LCM instance isn't initialized.  It is managed by
+     * the stream.
+     */
+    inline Subscription *getSubscription();
+
+  private:
+    static inline void onMessage(const ReceiveBuffer *rbuf, const char *channel,
+                                 const MessageType *msg, MessageStream *stream);
+
+    LCM *lcm;
+    Subscription *subscription;
+    std::deque<MessageType> messages;
+    // the coroutine that is suspended until a message is handled
+    std::coroutine_handle<> waiter;
 };
+#endif
 
 /**
  * @brief Represents a single event (message) in a log file.
@@ -576,6 +1287,46 @@ struct LogEvent {
     void *data;
 };
 
+/**
+ * @brief An event in a log file, read without copying it.
+ *
+ * This struct is the C++ counterpart for lcm_eventlog_view_t.  The channel
+ * and data point into the log file mapped into memory, and are valid until
+ * the LogFile is destroyed.
+ *
+ * @sa lcm_eventlog_view_t
+ *
+ * @headerfile lcm/lcm-cpp.hpp
+ */
+struct LogEventView {
+    /**
+     * The number of the event in the log file.
+     */
+    int64_t eventnum;
+    /**
+     * Timestamp identifying when the event was received.  Represented in
+     * microseconds since the UNIX epoch.
+     */
+    int64_t timestamp;
+    /**
+     * The LCM channel on which the message was received.  Not
+     * NUL-terminated.
+     */
+    const char *channel;
+    /**
+     * The length of the channel, in bytes
+     */
+    int32_t channellen;
+    /**
+     * The length of the message payload, in bytes
+     */
+    int32_t datalen;
+    /**
+     * The message payload.
+     */
+    const void *data;
+};
+
 /**
  * @brief Read and write %LCM log files.
  *
@@ -587,6 +1338,43 @@ struct LogEvent {
  */
 class LogFile {
   public:
+    /**
+     * @brief Iterates over the events in a log file mapped into memory.
+     *
+     * @sa lcm_eventlog_next_view()
+     */
+    class iterator {
+      public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef LogEventView value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const LogEventView *pointer;
+        typedef const LogEventView &reference;
+
+        /**
+         * Constructs the iterator past the last event.
+         */
+        inline iterator();
+
+        inline reference operator*() const;
+        inline pointer operator->() const;
+        inline iterator &operator++();
+        inline iterator operator++(int);
+        inline bool operator==(const iterator &other) const;
+        inline bool operator!=(const iterator &other) const;
+
+      private:
+        friend class LogFile;
+
+        inline explicit iterator(const lcm_eventlog_mmap_t *mapped);
+        inline void read();
+
+        // NULL past the last event
+        const lcm_eventlog_mmap_t *log;
+        lcm_eventlog_view_t view;
+        LogEventView event;
+    };
+
     /**
      * Constructor.  Opens the specified log file for reading or writing.
      * @param path the file to open
@@ -628,6 +1416,34 @@ class LogFile {
      */
     inline int seekToTimestamp(int64_t timestamp);
 
+    /**
+     * Seek to the event with the specified event number, or to the first
+     * event after it.  Valid in read mode only.
+     *
+     * @param eventnum the event number of the desired event.
+     *
+     * @return 0 on success, -1 if there's no such event.
+     * @sa lcm_eventlog_seek_to_eventnum()
+     */
+    inline int seekToEventnum(int64_t eventnum);
+
+    /**
+     * Reads the nth event on a channel, counting from 0.  Valid in read mode
+     * only.  The next readNextEvent() returns the event after it.
+     *
+     * The returned event is valid until the next call to this method or to
+     * readNextEvent().  The events on the channel before it are found from
+     * the index of the log file, or from the last event read on the same
+     * channel, without reading them if possible.
+     *
+     * @param channel the channel of the event.
+     * @param n the number of events on the channel before it.
+     *
+     * @return the event, or NULL if the channel doesn't have that many.
+     * @sa lcm_eventlog_cursor_seek()
+     */
+    inline const LogEvent *readChannelEvent(const std::string &channel, int64_t n);
+
     /**
      * Writes an event to the log file.  Valid in write mode only.
      *
@@ -652,10 +1468,39 @@ class LogFile {
      */
     inline FILE *getFilePtr();
 
+    /**
+     * Maps the log file into memory, the first time that it's called, and
+     * iterates over its events from the start without copying them.  Valid
+     * in read mode only, and independent of readNextEvent() and
+     * seekToTimestamp().
+     *
+     * @code
+     * for (lcm::LogFile::iterator it = log.begin(); it != log.end(); ++it)
+     *     handle(it->channel, it->channellen, it->data, it->datalen);
+     * @endcode
+     *
+     * @return an iterator at the first event, or end() if the log file
+     * can't be mapped.
+     * @sa lcm_eventlog_mmap_open()
+     */
+    inline iterator begin();
+
+    /**
+     * @return an iterator past the last event.
+     */
+    inline iterator end();
+
   private:
+    inline const LogEvent *setCurEvent(lcm_eventlog_event_t *evt);
+
     LogEvent curEvent;
     lcm_eventlog_t *eventlog;
     lcm_eventlog_event_t *last_event;
+    std::string filename;
+    lcm_eventlog_mmap_t *mapped;
+    // the cursor of the last readChannelEvent(), and its channel
+    lcm_eventlog_cursor_t *cursor;
+    std::string cursor_channel;
 };
 
 /**
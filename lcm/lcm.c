@@ -1,38 +1,156 @@
+#ifdef __linux__
+// sched_setaffinity() is a GNU extension
+#define _GNU_SOURCE
+#endif
 
 #include "lcm.h"
 
 #include <assert.h>
+#include <errno.h>
 #include <glib.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include <time.h>
 
 #include "dbg.h"
+#include "dispatcher.h"
 #include "lcm_internal.h"
+#include "lcm_trace.h"
+#include "lcmtypes/handler_stats_report_t.h"
 
 #ifdef WIN32
+#include <process.h>
 #include <winsock2.h>
+#define getpid _getpid
 #else
-#include <sys/select.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 typedef int SOCKET;
 #endif
 
 #define LCM_DEFAULT_URL "udpm://239.255.76.67:7667?ttl=0"
 
+// the most channel names that handlers_map remembers the matching
+// subscriptions for.  Looking up a channel name that is not there runs all of
+// the subscriptions against it.
+#define LCM_MAX_CACHED_CHANNELS 2048
+
+// the size of the process-wide table of lcm_intern_channel(), a power of 2.
+// It takes new channel names until it is 3/4 full.
+#define LCM_INTERNED_CHANNELS_SIZE 8192
+
+// how long a read thread waits for room in the queue of an LCM_BLOCK
+// subscription before it drops the message
+#define LCM_BLOCK_TIMEOUT_USEC 100000
+
+#define LCM_NUM_DROP_POLICIES 3
+
+// the most messages that a dispatcher thread handles for one subscription
+// before it lets the other subscriptions queued on the thread have a turn
+#define LCM_EXECUTOR_BATCH_SIZE 16
+
+// the buffers that lcm_publish_reserve() allocates for providers that don't
+// lend their own are kept for reuse, up to this many of up to this size
+#define LCM_MAX_CACHED_PUBLISH_BUFFERS 4
+#define LCM_MAX_CACHED_PUBLISH_BUFFER_SIZE (1 << 20)
+
+// the header of a buffer from lcm_publish_reserve(), which is followed by the
+// maxlen bytes of the message, and the channel name
+typedef struct {
+    size_t capacity;  // bytes after the header
+    unsigned int maxlen;
+} lcm_publish_buffer_t;
+
+struct _lcm_publisher_t {
+    lcm_t *lcm;
+    char *channel;
+    // what the provider's publisher_create() returned, or NULL if it has none
+    void *provider_publisher;
+};
+
+// how a subscription matches channel names.  Patterns that are plain strings,
+// except for a leading or trailing .*, are compared without GRegex.
+typedef enum {
+    LCM_MATCH_LITERAL,
+    LCM_MATCH_PREFIX,
+    LCM_MATCH_SUFFIX,
+    LCM_MATCH_REGEX,
+} lcm_match_type_t;
+
+// the channel name pattern of a subscription or a priority rule
+typedef struct {
+    lcm_match_type_t type;
+    // the channel name, prefix or suffix to compare against, without any
+    // .* and escapes
+    char *string;
+    size_t string_len;
+    GRegex *regex;  // only for LCM_MATCH_REGEX
+} lcm_channel_pattern_t;
+
+// messages on the channels matching pattern are dispatched in the priority
+// class priority, or a higher one
+typedef struct {
+    char *channel;
+    lcm_channel_pattern_t pattern;
+    int priority;
+} lcm_priority_rule_t;
+
 struct _lcm_t {
     GRecMutex mutex;         // guards data structures
     GRecMutex handle_mutex;  // only one thread allowed in lcm_handle at a time
 
-    GPtrArray *handlers_all;   // list containing *all* handlers
-    GHashTable *handlers_map;  // map of channel name (string) to GPtrArray
-                               // of matching handlers (lcm_subscription_t*)
+    GPtrArray *handlers_all;  // list containing *all* handlers
+    // the lcm_priority_rule_t*s set by lcm_set_channel_priority(), guarded by
+    // mutex
+    GPtrArray *priority_rules;
+
+    // map of channel name (string) to the channel_handlers_t of its
+    // matching handlers, for at most LCM_MAX_CACHED_CHANNELS recently seen
+    // channels.  A published map is never modified.  Instead, it is replaced
+    // by a modified copy while holding mutex, so that the read threads can
+    // look up handlers without taking any lock.  The copies share the
+    // unchanged entries.
+    GHashTable *handlers_map;
+    // the channel_handlers_t*s of handlers_map indexed by the channel ids of
+    // lcm_intern_channel(), or NULL for the ids that were not dispatched yet.
+    // The array holds references to them.  Guarded by mutex.
+    GPtrArray *channels_by_id;
+    // the number of threads looking at handlers_map without holding mutex,
+    // counted separately for each parity of handlers_epoch.  See
+    // handlers_read_begin().
+    int handlers_epoch;
+    int handlers_readers[2];
 
     lcm_provider_vtable_t *vtable;
     lcm_provider_t *provider;
 
     int default_max_num_queued_messages;
     int in_handle;
+
+    // the read threads that wait for room in the queue of an LCM_BLOCK
+    // subscription sleep on space_cond until space_generation changes.  Both
+    // counters are changed atomically, and space_generation only while
+    // holding space_mutex.
+    GMutex space_mutex;
+    GCond space_cond;
+    int space_waiters;
+    int space_generation;
+
+    uint64_t num_queue_drops;    // messages that no subscription had room for
+    uint64_t num_channels_evicted;  // channel names dropped from handlers_map
+    // set by lcm_set_handler_stats(), read atomically
+    int handler_stats;
+
+    GMutex publish_buffers_mutex;
+    GQueue publish_buffers;  // lcm_publish_buffer_t*s to reuse
 };
 
 struct _lcm_subscription_t {
@@ -40,14 +158,223 @@ struct _lcm_subscription_t {
     lcm_msg_handler_t handler;
     void *userdata;
     lcm_t *lcm;
-    GRegex *regex;
-    int callback_scheduled;
-    int marked_for_deletion;
-
+    lcm_channel_pattern_t pattern;
+    // the channels that it matches are at least in this priority class.
+    // Guarded by mutex.
+    int priority;
+    // set by lcm_unsubscribe(), so that the handler isn't called anymore by
+    // a dispatch that is under way.  Guarded by mutex.
+    int unsubscribed;
+    // the channel_handlers_t*s that list the subscription, so that it can be
+    // removed from them without looking at the other channels.  Guarded by
+    // mutex.
+    GPtrArray *entries;
+    // held by lcm_t until the subscription is unsubscribed, by the handler
+    // lists that it is in, and by the dispatcher while the executor is
+    // scheduled on it.  Changed atomically.
+    int refcount;
+
+    // The executor runs the handler on a dispatcher, or in a dispatch
+    // context.  Guarded by executor_mutex, except that dispatcher, context
+    // and executor_scheduled are also read atomically.
+    GMutex executor_mutex;
+    lcm_dispatcher_t *dispatcher;  // NULL to run the handler in lcm_handle()
+    lcm_dispatch_context_t *context;  // used instead of dispatcher if set
+    lcm_dispatcher_task_t executor_task;
+    GQueue executor_queue;  // lcm_async_msg_t*, waiting for the handler
+    // messages in executor_queue or being handled, which are still counted
+    // in num_queued_messages
+    int executor_pending;
+    int executor_scheduled;          // executor_task is queued or running
+    GThread *executor_thread;        // the thread running the handler, or NULL
+    GCond executor_idle;             // signaled when executor_thread is reset
+    int executor_closed;             // unsubscribed, so don't call the handler
+
+    // accessed atomically, since the read threads queue messages without
+    // holding mutex
     int max_num_queued_messages;
     int num_queued_messages;
+    // keep only the newest of the queued messages, and drop the others when
+    // they are dispatched
+    int conflate;
+    int drop_policy;  // lcm_drop_policy_t
+    // messages dropped, by the lcm_drop_policy_t that dropped them
+    uint64_t num_dropped[LCM_NUM_DROP_POLICIES];
+    // set by lcm_subscription_set_max_rate(), the shortest time between
+    // messages on average, or 0 for no limit, and the time before which no
+    // message is queued.  Both in nanoseconds, and accessed with
+    // lcm_stat_get() and lcm_stat_set().
+    uint64_t rate_period_ns;
+    uint64_t rate_next_ns;
+    // timings of the handler, updated with lcm_stat_add() and lcm_stat_max()
+    lcm_handler_stats_t stats;
 };
 
+// An entry of handlers_map, which may be shared by several versions of the
+// map.
+typedef struct {
+    char *channel;  // also the key of the entry in the maps
+    // the lcm_subscription_t*s matching the channel, which the list holds
+    // references to.  A list is never modified once it is published.  It is
+    // replaced while holding mutex, and read atomically.
+    GPtrArray *handlers;
+    int refcount;  // maps holding the entry, only changed under mutex
+    // set when the channel is looked up, and cleared when looking for
+    // channels to evict
+    int used;
+    int evicted;   // dropped from handlers_map, guarded by mutex
+    int priority;  // the priority class of the channel, read atomically
+    int id;        // index in lcm->channels_by_id, or -1, guarded by mutex
+} channel_handlers_t;
+
+static channel_handlers_t *channel_handlers_new(const char *channel, GPtrArray *handlers)
+{
+    channel_handlers_t *entry = (channel_handlers_t *) calloc(1, sizeof(channel_handlers_t));
+    entry->channel = strdup(channel);
+    entry->handlers = handlers;
+    entry->refcount = 1;
+    entry->id = -1;
+    return entry;
+}
+
+static void channel_handlers_unref(channel_handlers_t *entry)
+{
+    if (--entry->refcount)
+        return;
+    g_ptr_array_unref(entry->handlers);
+    free(entry->channel);
+    free(entry);
+}
+
+static GPtrArray *channel_handlers_use(channel_handlers_t *entry)
+{
+    if (!g_atomic_int_get(&entry->used))
+        g_atomic_int_set(&entry->used, 1);
+    return (GPtrArray *) g_atomic_pointer_get(&entry->handlers);
+}
+
+// Finds out whether the regular expression channel only matches one channel
+// name, or the channel names with some prefix or suffix, and sets up pattern
+// to compare those without GRegex.  Returns 0 if channel needs a GRegex.
+static int compile_simple_pattern(lcm_channel_pattern_t *pattern, const char *channel)
+{
+    size_t len = strlen(channel);
+    lcm_match_type_t type = LCM_MATCH_LITERAL;
+    if (len >= 2 && !strncmp(channel, ".*", 2)) {
+        type = LCM_MATCH_SUFFIX;
+        channel += 2;
+        len -= 2;
+    } else if (len >= 3 && !strcmp(channel + len - 2, ".*") && channel[len - 3] != '\\') {
+        type = LCM_MATCH_PREFIX;
+        len -= 2;
+    }
+
+    char *match_string = (char *) malloc(len + 1);
+    size_t match_string_len = 0;
+    for (size_t i = 0; i < len; i++) {
+        char c = channel[i];
+        if (c == '\\') {
+            // an escaped punctuation character matches itself.  Other escapes
+            // like \d are character classes.
+            if (i + 1 == len || g_ascii_isalnum(channel[i + 1])) {
+                free(match_string);
+                return 0;
+            }
+            c = channel[++i];
+        } else if (strchr(".^$*+?()[]{}|", c)) {
+            free(match_string);
+            return 0;
+        }
+        match_string[match_string_len++] = c;
+    }
+    match_string[match_string_len] = 0;
+
+    pattern->type = type;
+    pattern->string = match_string;
+    pattern->string_len = match_string_len;
+    return 1;
+}
+
+// Sets up pattern to match the channel names that the regular expression
+// channel matches in full.  Returns -1 and sets err if channel is invalid.
+static int channel_pattern_init(lcm_channel_pattern_t *pattern, const char *channel,
+                                GError **err)
+{
+    memset(pattern, 0, sizeof(lcm_channel_pattern_t));
+    if (compile_simple_pattern(pattern, channel))
+        return 0;
+
+    pattern->type = LCM_MATCH_REGEX;
+    char *regexbuf = g_strdup_printf("^%s$", channel);
+    pattern->regex = g_regex_new(regexbuf, (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, err);
+    g_free(regexbuf);
+    return pattern->regex ? 0 : -1;
+}
+
+static void channel_pattern_clear(lcm_channel_pattern_t *pattern)
+{
+    if (pattern->regex)
+        g_regex_unref(pattern->regex);
+    free(pattern->string);
+}
+
+static int channel_pattern_match(const lcm_channel_pattern_t *pattern, const char *channel_name)
+{
+    size_t len;
+    switch (pattern->type) {
+    case LCM_MATCH_LITERAL:
+        return !strcmp(channel_name, pattern->string);
+    case LCM_MATCH_PREFIX:
+        return !strncmp(channel_name, pattern->string, pattern->string_len);
+    case LCM_MATCH_SUFFIX:
+        len = strlen(channel_name);
+        return len >= pattern->string_len &&
+               !memcmp(channel_name + len - pattern->string_len, pattern->string,
+                       pattern->string_len);
+    default:
+        return g_regex_match(pattern->regex, channel_name, (GRegexMatchFlags) 0, NULL);
+    }
+}
+
+static int is_handler_subscriber(lcm_subscription_t *subscription, const char *channel_name)
+{
+    return channel_pattern_match(&subscription->pattern, channel_name);
+}
+
+static void priority_rule_free(lcm_priority_rule_t *rule)
+{
+    channel_pattern_clear(&rule->pattern);
+    free(rule->channel);
+    free(rule);
+}
+
+// Returns the priority class of the messages on channel, which is the highest
+// class of the priority rules and the subscriptions in handlers that match
+// it.  The caller must hold lcm->mutex.
+static int channel_priority(lcm_t *lcm, const char *channel, GPtrArray *handlers)
+{
+    int priority = 0;
+    for (unsigned int i = 0; i < lcm->priority_rules->len; i++) {
+        lcm_priority_rule_t *rule =
+            (lcm_priority_rule_t *) g_ptr_array_index(lcm->priority_rules, i);
+        if (rule->priority > priority && channel_pattern_match(&rule->pattern, channel))
+            priority = rule->priority;
+    }
+    for (unsigned int i = 0; i < handlers->len; i++) {
+        lcm_subscription_t *subscription = (lcm_subscription_t *) g_ptr_array_index(handlers, i);
+        priority = MAX(priority, subscription->priority);
+    }
+    return priority;
+}
+
+// The map releases the entry that we associate for each channel when it is
+// removed.  The key is the channel name stored in the entry.
+static GHashTable *handlers_map_new(void)
+{
+    return g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                 (GDestroyNotify) channel_handlers_unref);
+}
+
 lcm_t *lcm_create(const char *url)
 {
 #ifdef WIN32
@@ -70,6 +397,7 @@ lcm_t *lcm_create(const char *url)
     lcm_tcpq_provider_init(providers);
     lcm_mpudpm_provider_init(providers);
     lcm_memq_provider_init(providers);
+    lcm_shm_provider_init(providers);
     if (providers->len == 0) {
         fprintf(stderr, "Error: no LCM providers found\n");
         goto fail;
@@ -107,10 +435,16 @@ lcm_t *lcm_create(const char *url)
 
     lcm->vtable = info->vtable;
     lcm->handlers_all = g_ptr_array_new();
-    lcm->handlers_map = g_hash_table_new(g_str_hash, g_str_equal);
+    lcm->priority_rules = g_ptr_array_new();
+    lcm->handlers_map = handlers_map_new();
+    lcm->channels_by_id = g_ptr_array_new();
 
     g_rec_mutex_init(&lcm->mutex);
     g_rec_mutex_init(&lcm->handle_mutex);
+    g_mutex_init(&lcm->space_mutex);
+    g_cond_init(&lcm->space_cond);
+    g_mutex_init(&lcm->publish_buffers_mutex);
+    g_queue_init(&lcm->publish_buffers);
 
     lcm->provider = info->vtable->create(lcm, network, args);
     lcm->in_handle = 0;
@@ -141,47 +475,329 @@ fail:
     return NULL;
 }
 
-// free the array that we associate for each channel, and the key. Don't free
-// the lcm_subscription_t*s.
-static void map_free_handlers_callback(gpointer _key, gpointer _value, gpointer _data)
-{
-    (void) _data;
-    GPtrArray *handlers = (GPtrArray *) _value;
-    g_ptr_array_free(handlers, TRUE);
-    free(_key);
-}
-
 static void lcm_handler_free(lcm_subscription_t *subscription)
 {
-    assert(!subscription->callback_scheduled);
-    g_regex_unref(subscription->regex);
+    assert(g_queue_is_empty(&subscription->executor_queue));
+    g_ptr_array_free(subscription->entries, TRUE);
+    g_mutex_clear(&subscription->executor_mutex);
+    g_cond_clear(&subscription->executor_idle);
+    channel_pattern_clear(&subscription->pattern);
     free(subscription->channel);
     memset(subscription, 0, sizeof(lcm_subscription_t));
     free(subscription);
 }
 
-void lcm_destroy(lcm_t *lcm)
+static void subscription_unref(lcm_subscription_t *subscription)
+{
+    if (g_atomic_int_dec_and_test(&subscription->refcount))
+        lcm_handler_free(subscription);
+}
+
+// The message that the handler called on this thread was passed, for
+// lcm_recv_buf_retain().
+typedef struct {
+    const lcm_recv_buf_t *rbuf;
+    const lcm_recv_buf_lender_t *lender;  // NULL if the message is copied
+    void *msg;
+} lcm_lent_buf_t;
+
+static GPrivate lent_buf_key;
+
+// A message kept by lcm_recv_buf_retain().  Unless ref is set, the copy of
+// the data follows it.
+typedef struct {
+    lcm_recv_buf_t rbuf;
+    const lcm_recv_buf_lender_t *lender;
+    void *ref;
+} lcm_retained_buf_t;
+
+// Calls the handler of subscription, and times it if lcm_set_handler_stats()
+// enabled that.  lender and msg are from lcm_dispatch_channel_handlers().
+static void subscription_call(lcm_subscription_t *subscription, const lcm_recv_buf_t *buf,
+                              const char *channel, const lcm_recv_buf_lender_t *lender,
+                              void *msg)
+{
+    // handlers may dispatch messages of another lcm_t
+    lcm_lent_buf_t lent = {buf, lender, msg};
+    void *outer = g_private_get(&lent_buf_key);
+    g_private_set(&lent_buf_key, &lent);
+
+    if (!g_atomic_int_get(&subscription->lcm->handler_stats)) {
+        subscription->handler(buf, channel, subscription->userdata);
+        g_private_set(&lent_buf_key, outer);
+        return;
+    }
+
+    int64_t queue_delay = (lcm_monotonic_ns() - buf->recv_mono_ns) / 1000;
+    int64_t start = g_get_monotonic_time();
+    subscription->handler(buf, channel, subscription->userdata);
+    uint64_t usec = (uint64_t) (g_get_monotonic_time() - start);
+    g_private_set(&lent_buf_key, outer);
+
+    lcm_handler_stats_t *stats = &subscription->stats;
+    lcm_stat_add(&stats->num_calls, 1);
+    lcm_stat_add(&stats->total_usec, usec);
+    lcm_stat_max(&stats->max_usec, usec);
+    if (queue_delay > 0) {
+        lcm_stat_add(&stats->total_queue_delay_usec, (uint64_t) queue_delay);
+        lcm_stat_max(&stats->max_queue_delay_usec, (uint64_t) queue_delay);
+    }
+    int bucket = 0;
+    while (usec >> bucket && bucket < LCM_HANDLER_STATS_BUCKETS - 1)
+        bucket++;
+    lcm_stat_add(&stats->histogram[bucket], 1);
+}
+
+// A message copied for the executors of subscriptions, which may handle it
+// after the provider has reused its buffer.
+typedef struct {
+    int refcount;  // changed atomically
+    char *channel;
+    lcm_recv_buf_t rbuf;
+} lcm_async_msg_t;
+
+// Wakes up the read threads that wait for room in the queue of an LCM_BLOCK
+// subscription, so that they look at the queues again.
+static void lcm_wake_space_waiters(lcm_t *lcm)
+{
+    if (g_atomic_int_get(&lcm->space_waiters) <= 0)
+        return;
+    g_mutex_lock(&lcm->space_mutex);
+    g_atomic_int_inc(&lcm->space_generation);
+    g_cond_broadcast(&lcm->space_cond);
+    g_mutex_unlock(&lcm->space_mutex);
+}
+
+// removes a handled or dropped message from the count of queued messages of
+// subscription
+static void subscription_dequeue(lcm_subscription_t *subscription)
+{
+    g_atomic_int_add(&subscription->num_queued_messages, -1);
+    lcm_wake_space_waiters(subscription->lcm);
+}
+
+// drops one of the queued messages of a subscription that only keeps the
+// newest ones
+static void subscription_drop_stale(lcm_subscription_t *subscription)
+{
+    subscription_dequeue(subscription);
+    lcm_stat_add(&subscription->num_dropped[LCM_DROP_OLDEST], 1);
+}
+
+// Returns how many of the newest queued messages of subscription are kept,
+// while the older ones are dropped as they are dispatched, or 0 to keep all of
+// them.
+static int subscription_keep_limit(lcm_subscription_t *subscription)
+{
+    if (g_atomic_int_get(&subscription->conflate))
+        return 1;
+    if (g_atomic_int_get(&subscription->drop_policy) == LCM_DROP_OLDEST)
+        return g_atomic_int_get(&subscription->max_num_queued_messages);
+    return 0;
+}
+
+static lcm_async_msg_t *async_msg_new(const lcm_recv_buf_t *buf, const char *channel)
+{
+    size_t channel_size = strlen(channel) + 1;
+    lcm_async_msg_t *msg =
+        (lcm_async_msg_t *) malloc(sizeof(lcm_async_msg_t) + channel_size + buf->data_size);
+    msg->refcount = 1;
+    msg->channel = (char *) (msg + 1);
+    memcpy(msg->channel, channel, channel_size);
+    msg->rbuf = *buf;
+    msg->rbuf.data = msg->channel + channel_size;
+    memcpy(msg->rbuf.data, buf->data, buf->data_size);
+    return msg;
+}
+
+static void async_msg_unref(lcm_async_msg_t *msg)
+{
+    if (g_atomic_int_dec_and_test(&msg->refcount))
+        free(msg);
+}
+
+static void *async_msg_retain(void *msg)
+{
+    g_atomic_int_inc(&((lcm_async_msg_t *) msg)->refcount);
+    return msg;
+}
+
+static void async_msg_release(void *msg)
+{
+    async_msg_unref((lcm_async_msg_t *) msg);
+}
+
+// the handlers of executors keep the copy that they were passed
+static const lcm_recv_buf_lender_t async_msg_lender = {async_msg_retain, async_msg_release};
+
+// Returns 1 if the message being dispatched to subscription is followed by
+// enough newer ones to push it out of the queue, and drops it then.  num_new
+// is the number of messages counted for the subscription that it hasn't
+// gotten yet.
+static int subscription_is_stale(lcm_subscription_t *subscription, int num_new)
+{
+    int keep_limit = subscription_keep_limit(subscription);
+    if (keep_limit <= 0 || num_new <= keep_limit)
+        return 0;
+    subscription_drop_stale(subscription);
+    return 1;
+}
+
+// Runs on a dispatcher thread, or in lcm_dispatch_context_handle(), and calls
+// the handler for the messages that are waiting.
+static int executor_run(lcm_dispatcher_task_t *task)
+{
+    lcm_subscription_t *subscription =
+        (lcm_subscription_t *) ((char *) task - offsetof(lcm_subscription_t, executor_task));
+    g_mutex_lock(&subscription->executor_mutex);
+    for (int i = 0; i < LCM_EXECUTOR_BATCH_SIZE && !subscription->executor_closed; i++) {
+        lcm_async_msg_t *msg = (lcm_async_msg_t *) g_queue_pop_head(&subscription->executor_queue);
+        if (!msg)
+            break;
+        subscription->executor_thread = g_thread_self();
+        g_mutex_unlock(&subscription->executor_mutex);
+
+        subscription_call(subscription, &msg->rbuf, msg->channel, &async_msg_lender, msg);
+        async_msg_unref(msg);
+
+        g_mutex_lock(&subscription->executor_mutex);
+        subscription->executor_thread = NULL;
+        g_cond_broadcast(&subscription->executor_idle);
+        subscription->executor_pending--;
+        subscription_dequeue(subscription);
+    }
+
+    int again = !subscription->executor_closed && !g_queue_is_empty(&subscription->executor_queue);
+    if (!again)
+        g_atomic_int_set(&subscription->executor_scheduled, 0);
+    g_mutex_unlock(&subscription->executor_mutex);
+
+    // the dispatcher no longer holds the subscription when it goes idle
+    if (!again)
+        subscription_unref(subscription);
+    return again;
+}
+
+// Hands the message to the executor of subscription, copying it to *msg
+// first if that is NULL.  Returns 0 if the subscription has no executor, and
+// its handler has to be called right away instead.  The caller must hold
+// lcm->mutex.
+static int executor_push(lcm_subscription_t *subscription, const lcm_recv_buf_t *buf,
+                         const char *channel, lcm_async_msg_t **msg)
 {
-    if (lcm->provider) {
-        for (unsigned int i = 0; i < lcm->handlers_all->len; i++) {
-            // unsubscribe from all handlers
-            lcm_subscription_t *subscription =
-                (lcm_subscription_t *) g_ptr_array_index(lcm->handlers_all, i);
-            lcm_unsubscribe(lcm, subscription);
+    g_mutex_lock(&subscription->executor_mutex);
+    // keep using the executor while it is still busy with earlier messages,
+    // so that they are handled in order
+    lcm_dispatcher_t *dispatcher = subscription->dispatcher;
+    lcm_dispatch_context_t *context = subscription->context;
+    if (!dispatcher && !context && !subscription->executor_scheduled) {
+        g_mutex_unlock(&subscription->executor_mutex);
+        return 0;
+    }
+
+    // the message was dropped by lcm_try_enqueue_message() if all of the
+    // messages counted for the subscription are with the executor already
+    int submit = 0;
+    int num_new =
+        g_atomic_int_get(&subscription->num_queued_messages) - subscription->executor_pending;
+    if (subscription->executor_closed || num_new <= 0) {
+        // not for this subscription
+    } else if (subscription_is_stale(subscription, num_new)) {
+        // a newer message for the subscription is on its way
+    } else {
+        if (!*msg)
+            *msg = async_msg_new(buf, channel);
+        g_atomic_int_inc(&(*msg)->refcount);
+        // make room by dropping the oldest of the messages that are still
+        // waiting for the handler
+        int keep_limit = subscription_keep_limit(subscription);
+        while (keep_limit > 0 &&
+               g_queue_get_length(&subscription->executor_queue) >= (guint) keep_limit) {
+            async_msg_unref((lcm_async_msg_t *) g_queue_pop_head(&subscription->executor_queue));
+            subscription_drop_stale(subscription);
+            subscription->executor_pending--;
+        }
+        g_queue_push_tail(&subscription->executor_queue, *msg);
+        subscription->executor_pending++;
+        if (!subscription->executor_scheduled) {
+            g_atomic_int_set(&subscription->executor_scheduled, 1);
+            g_atomic_int_inc(&subscription->refcount);
+            submit = 1;
         }
-        lcm->vtable->destroy(lcm->provider);
     }
-    g_hash_table_foreach(lcm->handlers_map, map_free_handlers_callback, NULL);
-    g_hash_table_destroy(lcm->handlers_map);
+    g_mutex_unlock(&subscription->executor_mutex);
 
-    for (unsigned int i = 0; i < lcm->handlers_all->len; i++) {
-        lcm_subscription_t *subscription =
-            (lcm_subscription_t *) g_ptr_array_index(lcm->handlers_all, i);
-        subscription->callback_scheduled = 0;  // XXX hack...
-        lcm_handler_free(subscription);
+    if (submit && context)
+        lcm_dispatch_context_submit(context, &subscription->executor_task);
+    else if (submit)
+        lcm_dispatcher_submit(dispatcher, &subscription->executor_task);
+    return 1;
+}
+
+// Stops the executor of an unsubscribed subscription from calling its
+// handler.  Drops the waiting messages, and waits for the handler if it is
+// running on another thread.  The caller must not hold lcm->mutex, which the
+// handler may need.
+static void executor_close(lcm_subscription_t *subscription)
+{
+    g_mutex_lock(&subscription->executor_mutex);
+    subscription->executor_closed = 1;
+    lcm_async_msg_t *msg;
+    while ((msg = (lcm_async_msg_t *) g_queue_pop_head(&subscription->executor_queue)))
+        async_msg_unref(msg);
+    while (subscription->executor_thread && subscription->executor_thread != g_thread_self())
+        g_cond_wait(&subscription->executor_idle, &subscription->executor_mutex);
+    g_mutex_unlock(&subscription->executor_mutex);
+}
+
+int lcm_subscription_set_executor(lcm_subscription_t *subs, lcm_dispatcher_t *dispatcher)
+{
+    g_mutex_lock(&subs->executor_mutex);
+    g_atomic_pointer_set(&subs->dispatcher, dispatcher);
+    g_atomic_pointer_set(&subs->context, NULL);
+    g_mutex_unlock(&subs->executor_mutex);
+    return 0;
+}
+
+int lcm_subscription_set_dispatch_context(lcm_subscription_t *subs,
+                                          lcm_dispatch_context_t *context)
+{
+    g_mutex_lock(&subs->executor_mutex);
+    g_atomic_pointer_set(&subs->context, context);
+    g_atomic_pointer_set(&subs->dispatcher, NULL);
+    g_mutex_unlock(&subs->executor_mutex);
+    return 0;
+}
+
+void lcm_destroy(lcm_t *lcm)
+{
+    // unsubscribe from all handlers.  lcm_unsubscribe() removes them from
+    // handlers_all.
+    while (lcm->handlers_all->len) {
+        lcm_subscription_t *subscription = (lcm_subscription_t *) g_ptr_array_index(
+            lcm->handlers_all, lcm->handlers_all->len - 1);
+        lcm_unsubscribe(lcm, subscription);
+    }
+    if (lcm->provider)
+        lcm->vtable->destroy(lcm->provider);
+    for (unsigned int i = 0; i < lcm->channels_by_id->len; i++) {
+        channel_handlers_t *entry =
+            (channel_handlers_t *) g_ptr_array_index(lcm->channels_by_id, i);
+        if (entry)
+            channel_handlers_unref(entry);
     }
+    g_ptr_array_free(lcm->channels_by_id, TRUE);
+    g_hash_table_destroy(lcm->handlers_map);
     g_ptr_array_free(lcm->handlers_all, TRUE);
-
+    for (unsigned int i = 0; i < lcm->priority_rules->len; i++)
+        priority_rule_free((lcm_priority_rule_t *) g_ptr_array_index(lcm->priority_rules, i));
+    g_ptr_array_free(lcm->priority_rules, TRUE);
+
+    g_cond_clear(&lcm->space_cond);
+    g_mutex_clear(&lcm->space_mutex);
+    while (!g_queue_is_empty(&lcm->publish_buffers))
+        free(g_queue_pop_head(&lcm->publish_buffers));
+    g_mutex_clear(&lcm->publish_buffers_mutex);
     g_rec_mutex_clear(&lcm->handle_mutex);
     g_rec_mutex_clear(&lcm->mutex);
     free(lcm);
@@ -205,32 +821,90 @@ int lcm_handle(lcm_t *lcm)
         return -1;
 }
 
-int lcm_handle_timeout(lcm_t *lcm, int timeout_milis)
+// wait up to timeout_milis for the LCM file descriptor to become readable,
+// unless the provider already has received messages pending.  Returns >0 if
+// it is readable, 0 on timeout, and <0 on error.  poll() works
+// for descriptors of any number, which select() doesn't past FD_SETSIZE.
+// Winsock's select() takes a list of sockets instead, without that limit.
+static int lcm_wait_for_fileno(lcm_t *lcm, int timeout_milis)
 {
+    if (lcm->provider && lcm->vtable->has_pending && lcm->vtable->has_pending(lcm->provider))
+        return 1;
+    SOCKET lcm_fd = lcm_get_fileno(lcm);
+#ifdef WIN32
     fd_set fds;
     FD_ZERO(&fds);
-    SOCKET lcm_fd = lcm_get_fileno(lcm);
     FD_SET(lcm_fd, &fds);
 
     struct timeval timeout;
     timeout.tv_sec = timeout_milis / 1000;
     timeout.tv_usec = (timeout_milis % 1000) * 1000;
 
+    return select(lcm_fd + 1, &fds, NULL, NULL, &timeout);
+#else
+    struct pollfd pfd;
+    pfd.fd = lcm_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, timeout_milis);
+#endif
+}
+
+int lcm_handle_timeout(lcm_t *lcm, int timeout_milis)
+{
     if (timeout_milis < 0) {
         return -1;
     }
 
-    int select_result = select(lcm_fd + 1, &fds, NULL, NULL, &timeout);
+    int select_result = lcm_wait_for_fileno(lcm, timeout_milis);
     if (select_result > 0) {
         int lcm_handle_result = lcm_handle(lcm);
         return lcm_handle_result == 0 ? 1 : lcm_handle_result;
-    } else if (select_result == 0) {
-        return 0;
     } else {
         return select_result;
     }
 }
 
+int lcm_try_handle(lcm_t *lcm, int max_msgs)
+{
+    return lcm_handle_batch(lcm, max_msgs, 0);
+}
+
+int lcm_handle_batch(lcm_t *lcm, int max_msgs, int timeout_milis)
+{
+    if (max_msgs <= 0 || !lcm->provider || !lcm->vtable->handle) {
+        return -1;
+    }
+
+    if (timeout_milis >= 0) {
+        int select_result = lcm_wait_for_fileno(lcm, timeout_milis);
+        if (select_result <= 0)
+            return select_result;
+    }
+
+    if (!lcm->vtable->handle_batch) {
+        // provider can only dispatch one message at a time.  Keep calling it
+        // for as long as more messages are ready.
+        int nhandled = 0;
+        do {
+            int status = lcm_handle(lcm);
+            if (status < 0)
+                return nhandled ? nhandled : status;
+            nhandled++;
+        } while (nhandled < max_msgs && lcm_wait_for_fileno(lcm, 0) > 0);
+        return nhandled;
+    }
+
+    int ret;
+    g_rec_mutex_lock(&lcm->handle_mutex);
+    assert(!lcm->in_handle);  // recursive calls to lcm_handle are not allowed
+    lcm->in_handle = 1;
+    ret = lcm->vtable->handle_batch(lcm->provider, max_msgs);
+    lcm->in_handle = 0;
+    g_rec_mutex_unlock(&lcm->handle_mutex);
+    return ret;
+}
+
 int lcm_get_fileno(lcm_t *lcm)
 {
     if (lcm->provider && lcm->vtable->get_fileno)
@@ -241,210 +915,884 @@ int lcm_get_fileno(lcm_t *lcm)
 
 int lcm_publish(lcm_t *lcm, const char *channel, const void *data, unsigned int datalen)
 {
+    LCM_TRACE(publish, channel, (int) datalen);
     if (lcm->provider && lcm->vtable->publish)
         return lcm->vtable->publish(lcm->provider, channel, data, datalen);
     else
         return -1;
 }
 
-static int is_handler_subscriber(lcm_subscription_t *subscription, const char *channel_name)
+int lcm_publishv(lcm_t *lcm, const char *channel, const lcm_iovec_t *iov, int iovcnt)
 {
-    return g_regex_match(subscription->regex, channel_name, (GRegexMatchFlags) 0, NULL);
+    if (iovcnt < 0)
+        return -1;
+    if (iovcnt == 1)
+        return lcm_publish(lcm, channel, iov[0].data, iov[0].len);
+    uint64_t datalen = 0;
+    for (int i = 0; i < iovcnt; i++)
+        datalen += iov[i].len;
+    if (datalen > LCM_MAX_MESSAGE_SIZE) {
+        fprintf(stderr, "Error: message of %llu bytes is too large\n",
+                (unsigned long long) datalen);
+        return -1;
+    }
+    if (!lcm->provider)
+        return -1;
+    if (lcm->vtable->publishv && iovcnt > 1) {
+        LCM_TRACE(publish, channel, (int) datalen);
+        return lcm->vtable->publishv(lcm->provider, channel, iov, iovcnt, (unsigned int) datalen);
+    }
+
+    // gathered into the buffer that the provider lends, if it does
+    char *buf = (char *) lcm_publish_reserve(lcm, channel, (unsigned int) datalen);
+    if (!buf)
+        return -1;
+    unsigned int offset = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        memcpy(buf + offset, iov[i].data, iov[i].len);
+        offset += iov[i].len;
+    }
+    return lcm_publish_commit(lcm, buf, offset);
 }
 
-// add the handler to any channel's handler list if its subscription matches
-static void map_add_handler_callback(gpointer _key, gpointer _value, gpointer _data)
+int lcm_publish_batch(lcm_t *lcm, const lcm_publish_msg_t *msgs, int num_msgs)
 {
-    lcm_subscription_t *subscription = (lcm_subscription_t *) _data;
-    char *channel_name = (char *) _key;
-    GPtrArray *handlers = (GPtrArray *) _value;
-
-    if (!is_handler_subscriber(subscription, channel_name))
-        return;
+    if (!lcm->provider)
+        return -1;
+    if (lcm->vtable->publish_batch)
+        return lcm->vtable->publish_batch(lcm->provider, msgs, num_msgs);
 
-    g_ptr_array_add(handlers, subscription);
+    int status = 0;
+    for (int i = 0; i < num_msgs; i++) {
+        if (0 != lcm_publish(lcm, msgs[i].channel, msgs[i].data, msgs[i].datalen))
+            status = -1;
+    }
+    return status;
 }
 
-// remove from a channel's handler list
-static void map_remove_handler_callback(gpointer _key, gpointer _value, gpointer _data)
+int lcm_publish_async(lcm_t *lcm, const char *channel, const void *data, unsigned int datalen)
 {
-    (void) _key;
-    lcm_subscription_t *subscription = (lcm_subscription_t *) _data;
-    GPtrArray *handlers = (GPtrArray *) _value;
-    g_ptr_array_remove_fast(handlers, subscription);
+    if (lcm->provider && lcm->vtable->publish_async)
+        return lcm->vtable->publish_async(lcm->provider, channel, (void *) data, datalen, NULL,
+                                          NULL);
+    return lcm_publish(lcm, channel, data, datalen);
 }
 
-lcm_subscription_t *lcm_subscribe(lcm_t *lcm, const char *channel, lcm_msg_handler_t handler,
-                                  void *userdata)
+int lcm_publish_async_buffer(lcm_t *lcm, const char *channel, void *data, unsigned int datalen,
+                             lcm_buffer_release_t release, void *user_data)
 {
-    dbg(DBG_LCM, "registering %s handler %p\n", channel, handler);
+    if (lcm->provider && lcm->vtable->publish_async)
+        return lcm->vtable->publish_async(lcm->provider, channel, data, datalen, release,
+                                          user_data);
+    int status = lcm_publish(lcm, channel, data, datalen);
+    if (release)
+        release(data, user_data);
+    return status;
+}
 
-    if (lcm->provider && lcm->vtable->subscribe) {
-        if (0 != lcm->vtable->subscribe(lcm->provider, channel)) {
+void *lcm_publish_reserve(lcm_t *lcm, const char *channel, unsigned int maxlen)
+{
+    if (!lcm->provider)
+        return NULL;
+    if (lcm->vtable->publish_reserve)
+        return lcm->vtable->publish_reserve(lcm->provider, channel, maxlen);
+
+    size_t size = (size_t) maxlen + strlen(channel) + 1;
+    g_mutex_lock(&lcm->publish_buffers_mutex);
+    lcm_publish_buffer_t *pb = (lcm_publish_buffer_t *) g_queue_pop_head(&lcm->publish_buffers);
+    g_mutex_unlock(&lcm->publish_buffers_mutex);
+    if (!pb || pb->capacity < size) {
+        lcm_publish_buffer_t *grown =
+            (lcm_publish_buffer_t *) realloc(pb, sizeof(lcm_publish_buffer_t) + size);
+        if (!grown) {
+            free(pb);
             return NULL;
         }
+        pb = grown;
+        pb->capacity = size;
     }
+    pb->maxlen = maxlen;
+    char *data = (char *) (pb + 1);
+    strcpy(data + maxlen, channel);
+    return data;
+}
 
-    // create and populate a new message handler struct
-    lcm_subscription_t *subscription = (lcm_subscription_t *) calloc(1, sizeof(lcm_subscription_t));
-    subscription->channel = strdup(channel);
-    subscription->handler = handler;
-    subscription->userdata = userdata;
-    subscription->callback_scheduled = 0;
-    subscription->marked_for_deletion = 0;
-    subscription->max_num_queued_messages = lcm->default_max_num_queued_messages;
-    subscription->num_queued_messages = 0;
-    subscription->lcm = lcm;
-
-    char *regexbuf = g_strdup_printf("^%s$", channel);
-    GError *rerr = NULL;
-    subscription->regex =
-        g_regex_new(regexbuf, (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, &rerr);
-    g_free(regexbuf);
-    if (rerr) {
-        fprintf(stderr, "%s: %s\n", __FUNCTION__, rerr->message);
-        dbg(DBG_LCM, "%s: %s\n", __FUNCTION__, rerr->message);
-        g_error_free(rerr);
-        free(subscription);
-        return NULL;
+static void publish_buffer_release(lcm_t *lcm, lcm_publish_buffer_t *pb)
+{
+    if (pb->capacity <= LCM_MAX_CACHED_PUBLISH_BUFFER_SIZE) {
+        g_mutex_lock(&lcm->publish_buffers_mutex);
+        if (lcm->publish_buffers.length < LCM_MAX_CACHED_PUBLISH_BUFFERS) {
+            g_queue_push_head(&lcm->publish_buffers, pb);
+            pb = NULL;
+        }
+        g_mutex_unlock(&lcm->publish_buffers_mutex);
     }
-    g_rec_mutex_lock(&lcm->mutex);
-    g_ptr_array_add(lcm->handlers_all, subscription);
-    g_hash_table_foreach(lcm->handlers_map, map_add_handler_callback, subscription);
-    g_rec_mutex_unlock(&lcm->mutex);
-
-    return subscription;
+    free(pb);
 }
 
-int lcm_unsubscribe(lcm_t *lcm, lcm_subscription_t *subscription)
+int lcm_publish_commit(lcm_t *lcm, void *buf, unsigned int datalen)
 {
-    g_rec_mutex_lock(&lcm->mutex);
+    if (lcm->vtable->publish_reserve)
+        return lcm->vtable->publish_commit(lcm->provider, buf, datalen);
 
-    // remove the handler from the master list
-    int foundit = g_ptr_array_remove(lcm->handlers_all, subscription);
+    lcm_publish_buffer_t *pb = (lcm_publish_buffer_t *) buf - 1;
+    int status = -1;
+    if (datalen <= pb->maxlen)
+        status = lcm_publish(lcm, (char *) buf + pb->maxlen, buf, datalen);
+    else
+        fprintf(stderr, "Error: committed %u bytes of %u reserved\n", datalen, pb->maxlen);
+    publish_buffer_release(lcm, pb);
+    return status;
+}
 
-    if (lcm->provider && lcm->vtable->unsubscribe) {
-        lcm->vtable->unsubscribe(lcm->provider, subscription->channel);
-    }
+void lcm_publish_cancel(lcm_t *lcm, void *buf)
+{
+    if (lcm->vtable->publish_reserve)
+        lcm->vtable->publish_cancel(lcm->provider, buf);
+    else
+        publish_buffer_release(lcm, (lcm_publish_buffer_t *) buf - 1);
+}
 
-    if (foundit) {
-        // remove the handler from all the lists in the hash table
-        g_hash_table_foreach(lcm->handlers_map, map_remove_handler_callback, subscription);
-        if (!subscription->callback_scheduled)
-            lcm_handler_free(subscription);
-        else
-            subscription->marked_for_deletion = 1;
+lcm_publisher_t *lcm_publisher_create(lcm_t *lcm, const char *channel)
+{
+    if (!lcm->provider)
+        return NULL;
+    lcm_publisher_t *publisher = (lcm_publisher_t *) calloc(1, sizeof(lcm_publisher_t));
+    publisher->lcm = lcm;
+    publisher->channel = strdup(channel);
+    if (lcm->vtable->publisher_create) {
+        publisher->provider_publisher =
+            lcm->vtable->publisher_create(lcm->provider, publisher->channel);
+        if (!publisher->provider_publisher) {
+            free(publisher->channel);
+            free(publisher);
+            return NULL;
+        }
     }
+    return publisher;
+}
 
-    g_rec_mutex_unlock(&lcm->mutex);
+int lcm_publisher_publish(lcm_publisher_t *publisher, const void *data, unsigned int datalen)
+{
+    lcm_t *lcm = publisher->lcm;
+    if (!publisher->provider_publisher)
+        return lcm_publish(lcm, publisher->channel, data, datalen);
+    LCM_TRACE(publish, publisher->channel, (int) datalen);
+    return lcm->vtable->publisher_publish(lcm->provider, publisher->provider_publisher, data,
+                                          datalen);
+}
 
-    return foundit ? 0 : -1;
+int lcm_publisher_has_subscribers(lcm_publisher_t *publisher)
+{
+    lcm_t *lcm = publisher->lcm;
+    if (!publisher->provider_publisher || !lcm->vtable->publisher_has_subscribers)
+        return 1;
+    return lcm->vtable->publisher_has_subscribers(lcm->provider, publisher->provider_publisher);
 }
 
-/* ==== Internal API for Providers ==== */
+void lcm_publisher_destroy(lcm_publisher_t *publisher)
+{
+    if (!publisher)
+        return;
+    lcm_t *lcm = publisher->lcm;
+    if (publisher->provider_publisher)
+        lcm->vtable->publisher_destroy(lcm->provider, publisher->provider_publisher);
+    free(publisher->channel);
+    free(publisher);
+}
 
-static GPtrArray *lcm_get_handlers(lcm_t *lcm, const char *channel)
+// Starts looking at lcm->handlers_map without holding lcm->mutex.  The map and
+// the subscriptions in it stay valid until handlers_read_end() is called with
+// the returned value.
+static int handlers_read_begin(lcm_t *lcm)
 {
-    g_rec_mutex_lock(&lcm->mutex);
-    GPtrArray *handlers = (GPtrArray *) g_hash_table_lookup(lcm->handlers_map, channel);
-    if (handlers)
-        goto finished;
+    while (1) {
+        int parity = g_atomic_int_get(&lcm->handlers_epoch) & 1;
+        g_atomic_int_inc(&lcm->handlers_readers[parity]);
+        // if the epoch changed in the meantime, handlers_map_replace() may
+        // already have stopped waiting for readers of this parity.
+        if ((g_atomic_int_get(&lcm->handlers_epoch) & 1) == parity)
+            return parity;
+        g_atomic_int_add(&lcm->handlers_readers[parity], -1);
+    }
+}
+
+static void handlers_read_end(lcm_t *lcm, int parity)
+{
+    g_atomic_int_add(&lcm->handlers_readers[parity], -1);
+}
+
+// Waits until the readers that may have found what was unpublished before the
+// call are done.  The caller must hold lcm->mutex.
+static void handlers_synchronize(lcm_t *lcm)
+{
+    // readers that start from now on find what was published since.  Wait
+    // for the ones that may have started before.
+    int parity = g_atomic_int_get(&lcm->handlers_epoch) & 1;
+    g_atomic_int_inc(&lcm->handlers_epoch);
+    while (g_atomic_int_get(&lcm->handlers_readers[parity]) > 0)
+        g_thread_yield();
+}
+
+// Publishes map as the new handlers_map, and frees the old one once no reader
+// can be looking at it anymore.  The caller must hold lcm->mutex.
+static void handlers_map_replace(lcm_t *lcm, GHashTable *map)
+{
+    GHashTable *old_map = lcm->handlers_map;
+    g_atomic_pointer_set(&lcm->handlers_map, map);
+    handlers_synchronize(lcm);
+    g_hash_table_destroy(old_map);
+}
+
+// Returns a copy of lcm->handlers_map that shares its entries.  The caller
+// must hold lcm->mutex.
+static GHashTable *handlers_map_copy(lcm_t *lcm)
+{
+    GHashTable *map = handlers_map_new();
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, lcm->handlers_map);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        channel_handlers_t *entry = (channel_handlers_t *) value;
+        entry->refcount++;
+        g_hash_table_insert(map, entry->channel, entry);
+    }
+    return map;
+}
+
+// Makes room in map, a copy of lcm->handlers_map, by dropping the channels
+// that were not looked up since the last time that this was called.  This
+// approximates evicting the least recently used channels.  If not enough of
+// them were unused, arbitrary channels are dropped too.  Evicts down to 3/4
+// of the limit so that this isn't needed again for the next new channel.  The
+// caller must hold lcm->mutex.
+static void handlers_map_evict(lcm_t *lcm, GHashTable *map)
+{
+    const unsigned int target_size = LCM_MAX_CACHED_CHANNELS * 3 / 4;
+    unsigned int old_size = g_hash_table_size(map);
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, map);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        channel_handlers_t *entry = (channel_handlers_t *) value;
+        if (g_atomic_int_get(&entry->used)) {
+            g_atomic_int_set(&entry->used, 0);
+        } else {
+            entry->evicted = 1;
+            g_hash_table_iter_remove(&iter);
+        }
+    }
+    g_hash_table_iter_init(&iter, map);
+    while (g_hash_table_size(map) > target_size && g_hash_table_iter_next(&iter, &key, &value)) {
+        ((channel_handlers_t *) value)->evicted = 1;
+        g_hash_table_iter_remove(&iter);
+    }
+    lcm_stat_add(&lcm->num_channels_evicted, old_size - g_hash_table_size(map));
+
+    for (unsigned int i = 0; i < lcm->channels_by_id->len; i++) {
+        channel_handlers_t *entry =
+            (channel_handlers_t *) g_ptr_array_index(lcm->channels_by_id, i);
+        if (entry && entry->evicted) {
+            g_ptr_array_index(lcm->channels_by_id, i) = NULL;
+            entry->id = -1;
+            channel_handlers_unref(entry);
+        }
+    }
+
+    // the old map still holds the evicted entries, until it is replaced by
+    // this one.  Forget them before then.
+    for (unsigned int i = 0; i < lcm->handlers_all->len; i++) {
+        lcm_subscription_t *subscription =
+            (lcm_subscription_t *) g_ptr_array_index(lcm->handlers_all, i);
+        GPtrArray *entries = subscription->entries;
+        unsigned int num_kept = 0;
+        for (unsigned int j = 0; j < entries->len; j++) {
+            channel_handlers_t *entry = (channel_handlers_t *) g_ptr_array_index(entries, j);
+            if (!entry->evicted)
+                g_ptr_array_index(entries, num_kept++) = entry;
+        }
+        g_ptr_array_set_size(entries, num_kept);
+    }
+}
+
+// Returns an empty handler list, which holds a reference to each of the
+// subscriptions that are added to it with handlers_add().
+static GPtrArray *handlers_new(void)
+{
+    return g_ptr_array_new_with_free_func((GDestroyNotify) subscription_unref);
+}
+
+static void handlers_add(GPtrArray *handlers, lcm_subscription_t *subscription)
+{
+    g_atomic_int_inc(&subscription->refcount);
+    g_ptr_array_add(handlers, subscription);
+}
+
+// Publishes handlers as the handler list of entry.  The old list is added to
+// retired, to be released once no reader can be looking at it anymore.  The
+// caller must hold lcm->mutex.
+static void channel_handlers_set(lcm_t *lcm, channel_handlers_t *entry, GPtrArray *handlers,
+                                 GPtrArray *retired)
+{
+    g_ptr_array_add(retired, entry->handlers);
+    g_atomic_int_set(&entry->priority, channel_priority(lcm, entry->channel, handlers));
+    g_atomic_pointer_set(&entry->handlers, handlers);
+}
+
+// Releases the handler lists that were replaced by channel_handlers_set(), and
+// so the subscriptions that only they still held.  The caller must hold
+// lcm->mutex.
+static void handlers_retire(lcm_t *lcm, GPtrArray *retired)
+{
+    if (retired->len)
+        handlers_synchronize(lcm);
+    for (unsigned int i = 0; i < retired->len; i++)
+        g_ptr_array_unref((GPtrArray *) g_ptr_array_index(retired, i));
+    g_ptr_array_free(retired, TRUE);
+}
+
+// Adds subscription to the handler list of every channel in handlers_map that
+// it matches.  The caller must hold lcm->mutex.
+static void handlers_map_add(lcm_t *lcm, lcm_subscription_t *subscription)
+{
+    GPtrArray *retired = g_ptr_array_new();
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, lcm->handlers_map);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        channel_handlers_t *entry = (channel_handlers_t *) value;
+        if (!is_handler_subscriber(subscription, entry->channel))
+            continue;
+
+        // the old list may still be in use by readers, so build a new one
+        GPtrArray *handlers = handlers_new();
+        for (unsigned int i = 0; i < entry->handlers->len; i++)
+            handlers_add(handlers, (lcm_subscription_t *) g_ptr_array_index(entry->handlers, i));
+        handlers_add(handlers, subscription);
+        channel_handlers_set(lcm, entry, handlers, retired);
+        g_ptr_array_add(subscription->entries, entry);
+    }
+    handlers_retire(lcm, retired);
+}
+
+// Removes subscription from the handler lists of the channels that it
+// matched.  Once that returns, no reader can be looking at it anymore.  The
+// caller must hold lcm->mutex.
+static void handlers_map_remove(lcm_t *lcm, lcm_subscription_t *subscription)
+{
+    GPtrArray *retired = g_ptr_array_sized_new(subscription->entries->len);
+    for (unsigned int i = 0; i < subscription->entries->len; i++) {
+        channel_handlers_t *entry =
+            (channel_handlers_t *) g_ptr_array_index(subscription->entries, i);
+        GPtrArray *handlers = handlers_new();
+        for (unsigned int j = 0; j < entry->handlers->len; j++) {
+            lcm_subscription_t *other =
+                (lcm_subscription_t *) g_ptr_array_index(entry->handlers, j);
+            if (other != subscription)
+                handlers_add(handlers, other);
+        }
+        channel_handlers_set(lcm, entry, handlers, retired);
+    }
+    g_ptr_array_set_size(subscription->entries, 0);
+    handlers_retire(lcm, retired);
+}
+
+// Looks up the priority class of every channel in handlers_map again, after a
+// priority was changed.  The caller must hold lcm->mutex.
+static void handlers_map_reprioritize(lcm_t *lcm)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, lcm->handlers_map);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        channel_handlers_t *entry = (channel_handlers_t *) value;
+        g_atomic_int_set(&entry->priority,
+                         channel_priority(lcm, entry->channel, entry->handlers));
+    }
+}
+
+lcm_subscription_t *lcm_subscribe(lcm_t *lcm, const char *channel, lcm_msg_handler_t handler,
+                                  void *userdata)
+{
+    dbg(DBG_LCM, "registering %s handler %p\n", channel, handler);
+
+    if (lcm->provider && lcm->vtable->subscribe) {
+        if (0 != lcm->vtable->subscribe(lcm->provider, channel)) {
+            return NULL;
+        }
+    }
+
+    // create and populate a new message handler struct
+    lcm_subscription_t *subscription = (lcm_subscription_t *) calloc(1, sizeof(lcm_subscription_t));
+    subscription->channel = strdup(channel);
+    subscription->handler = handler;
+    subscription->userdata = userdata;
+    subscription->max_num_queued_messages = lcm->default_max_num_queued_messages;
+    subscription->num_queued_messages = 0;
+    subscription->lcm = lcm;
+    subscription->refcount = 1;
+    subscription->executor_task.run = executor_run;
+
+    GError *rerr = NULL;
+    if (channel_pattern_init(&subscription->pattern, channel, &rerr) < 0) {
+        fprintf(stderr, "%s: %s\n", __FUNCTION__, rerr->message);
+        dbg(DBG_LCM, "%s: %s\n", __FUNCTION__, rerr->message);
+        g_error_free(rerr);
+        free(subscription->channel);
+        free(subscription);
+        if (lcm->provider && lcm->vtable->unsubscribe)
+            lcm->vtable->unsubscribe(lcm->provider, channel);
+        return NULL;
+    }
+    g_mutex_init(&subscription->executor_mutex);
+    g_cond_init(&subscription->executor_idle);
+    g_queue_init(&subscription->executor_queue);
+    subscription->entries = g_ptr_array_new();
+
+    g_rec_mutex_lock(&lcm->mutex);
+    g_ptr_array_add(lcm->handlers_all, subscription);
+    handlers_map_add(lcm, subscription);
+    g_rec_mutex_unlock(&lcm->mutex);
+
+    if (lcm->provider && lcm->vtable->subscribed)
+        lcm->vtable->subscribed(lcm->provider, channel);
+
+    return subscription;
+}
+
+int lcm_unsubscribe(lcm_t *lcm, lcm_subscription_t *subscription)
+{
+    g_rec_mutex_lock(&lcm->mutex);
+
+    // remove the handler from the master list
+    int foundit = g_ptr_array_remove(lcm->handlers_all, subscription);
+
+    if (foundit && lcm->provider && lcm->vtable->unsubscribe) {
+        lcm->vtable->unsubscribe(lcm->provider, subscription->channel);
+    }
+
+    if (foundit) {
+        // remove the handler from the lists of the channels that it matched.
+        // A dispatch that is under way may still hold one of the old lists,
+        // and the subscription with it, but doesn't call the handler anymore.
+        handlers_map_remove(lcm, subscription);
+        subscription->unsubscribed = 1;
+    }
+
+    g_rec_mutex_unlock(&lcm->mutex);
+
+    if (foundit) {
+        // a read thread may be waiting for room in the queue of the
+        // subscription
+        lcm_wake_space_waiters(lcm);
+        executor_close(subscription);
+        // release the reference of handlers_all
+        subscription_unref(subscription);
+    }
+
+    return foundit ? 0 : -1;
+}
+
+int lcm_set_channel_priority(lcm_t *lcm, const char *channel, int priority)
+{
+    if (priority < 0 || priority > LCM_MAX_PRIORITY) {
+        fprintf(stderr, "Error: invalid priority %d\n", priority);
+        return -1;
+    }
+
+    lcm_priority_rule_t *rule = (lcm_priority_rule_t *) calloc(1, sizeof(lcm_priority_rule_t));
+    GError *rerr = NULL;
+    if (channel_pattern_init(&rule->pattern, channel, &rerr) < 0) {
+        fprintf(stderr, "%s: %s\n", __FUNCTION__, rerr->message);
+        g_error_free(rerr);
+        free(rule);
+        return -1;
+    }
+    rule->channel = strdup(channel);
+    rule->priority = priority;
+
+    g_rec_mutex_lock(&lcm->mutex);
+    // the rule replaces an earlier one for the same pattern, and a priority
+    // of 0 only removes that
+    for (unsigned int i = 0; i < lcm->priority_rules->len; i++) {
+        lcm_priority_rule_t *old_rule =
+            (lcm_priority_rule_t *) g_ptr_array_index(lcm->priority_rules, i);
+        if (!strcmp(old_rule->channel, channel)) {
+            g_ptr_array_remove_index(lcm->priority_rules, i);
+            priority_rule_free(old_rule);
+            break;
+        }
+    }
+    if (priority)
+        g_ptr_array_add(lcm->priority_rules, rule);
+    else
+        priority_rule_free(rule);
+    handlers_map_reprioritize(lcm);
+    g_rec_mutex_unlock(&lcm->mutex);
+    return 0;
+}
+
+/* ==== Internal API for Providers ==== */
+
+// Returns the entry of channel in handlers_map, and adds it first if it isn't
+// there.  The caller must hold lcm->mutex.
+static channel_handlers_t *lcm_get_channel_handlers(lcm_t *lcm, const char *channel)
+{
+    channel_handlers_t *entry =
+        (channel_handlers_t *) g_hash_table_lookup(lcm->handlers_map, channel);
+    if (entry) {
+        channel_handlers_use(entry);
+        return entry;
+    }
+
+    GHashTable *map = handlers_map_copy(lcm);
+    if (g_hash_table_size(map) >= LCM_MAX_CACHED_CHANNELS)
+        handlers_map_evict(lcm, map);
 
     // if we haven't seen this channel name before, create a new list
     // of subscribed handlers.
-    handlers = g_ptr_array_new();
-    // alloc channel name
-    g_hash_table_insert(lcm->handlers_map, strdup(channel), handlers);
+    entry = channel_handlers_new(channel, handlers_new());
 
     // find all the matching handlers
     for (unsigned int i = 0; i < lcm->handlers_all->len; i++) {
         lcm_subscription_t *subscription =
             (lcm_subscription_t *) g_ptr_array_index(lcm->handlers_all, i);
-        if (is_handler_subscriber(subscription, channel))
-            g_ptr_array_add(handlers, subscription);
+        if (is_handler_subscriber(subscription, channel)) {
+            handlers_add(entry->handlers, subscription);
+            g_ptr_array_add(subscription->entries, entry);
+        }
     }
 
-finished:
-    g_rec_mutex_unlock(&lcm->mutex);
-    return handlers;
+    entry->priority = channel_priority(lcm, channel, entry->handlers);
+    g_hash_table_insert(map, entry->channel, entry);
+    handlers_map_replace(lcm, map);
+    channel_handlers_use(entry);
+    return entry;
 }
 
-int lcm_try_enqueue_message(lcm_t *lcm, const char *channel)
+// Returns 1 if the queue of subscription is full, and it would drop a new
+// message
+static int subscription_is_full(lcm_subscription_t *subscription)
 {
-    g_rec_mutex_lock(&lcm->mutex);
-    GPtrArray *handlers = lcm_get_handlers(lcm, channel);
+    int max_num_queued_messages = g_atomic_int_get(&subscription->max_num_queued_messages);
+    return max_num_queued_messages > 0 &&
+           g_atomic_int_get(&subscription->num_queued_messages) >= max_num_queued_messages;
+}
+
+// Returns whether a subscription with lcm_subscription_set_max_rate() takes
+// the next message, which it does once a period has passed since the one it
+// took last.  The messages it takes are a period apart on average, so that
+// rates that don't divide the rate of the channel are still kept to.
+static int subscription_rate_admit(lcm_subscription_t *subscription)
+{
+    uint64_t period = lcm_stat_get(&subscription->rate_period_ns);
+    if (!period)
+        return 1;
+    uint64_t now = (uint64_t) lcm_monotonic_ns();
+    uint64_t next = lcm_stat_get(&subscription->rate_next_ns);
+    if (now < next)
+        return 0;
+    // after a pause of the channel, start over rather than catch up
+    uint64_t new_next = next + period > now ? next + period : now + period;
+    // another read thread may have taken a message in the meantime
+    return lcm_stat_compare_and_swap(&subscription->rate_next_ns, next, new_next);
+}
+
+// Counts a message against the queue of subscription.  Returns 1 if the
+// message was queued, or 0 if it was dropped.
+static int subscription_try_enqueue(lcm_subscription_t *subscription)
+{
+    // a conflating subscription takes every message, and so does one that
+    // drops the oldest messages.  They drop the stale ones later.
+    int drop_policy = g_atomic_int_get(&subscription->drop_policy);
+    if (g_atomic_int_get(&subscription->conflate) || drop_policy == LCM_DROP_OLDEST) {
+        g_atomic_int_inc(&subscription->num_queued_messages);
+        return 1;
+    }
+
+    int max_num_queued_messages = g_atomic_int_get(&subscription->max_num_queued_messages);
+    int num_queued_messages;
+    do {
+        num_queued_messages = g_atomic_int_get(&subscription->num_queued_messages);
+        if (num_queued_messages >= max_num_queued_messages && max_num_queued_messages > 0) {
+            lcm_stat_add(&subscription->num_dropped[drop_policy], 1);
+            return 0;
+        }
+    } while (!g_atomic_int_compare_and_exchange(&subscription->num_queued_messages,
+                                                num_queued_messages, num_queued_messages + 1));
+    return 1;
+}
+
+// Queues a message on channel for the matching subscriptions, and stores the
+// priority class of channel in priority.  Returns -1 without queueing it if
+// may_block is set, and one of them has the LCM_BLOCK policy and a full
+// queue.
+static int lcm_enqueue_message(lcm_t *lcm, const char *channel, int may_block, int *priority)
+{
+    int parity = handlers_read_begin(lcm);
+    GHashTable *map = (GHashTable *) g_atomic_pointer_get(&lcm->handlers_map);
+    channel_handlers_t *entry = (channel_handlers_t *) g_hash_table_lookup(map, channel);
+    GPtrArray *handlers;
+    if (entry) {
+        handlers = channel_handlers_use(entry);
+    } else {
+        // a channel we haven't seen before, which has to be added to the map
+        handlers_read_end(lcm, parity);
+        g_rec_mutex_lock(&lcm->mutex);
+        entry = lcm_get_channel_handlers(lcm, channel);
+        handlers = entry->handlers;
+        parity = handlers_read_begin(lcm);
+        g_rec_mutex_unlock(&lcm->mutex);
+    }
+    if (priority)
+        *priority = g_atomic_int_get(&entry->priority);
+
+    for (unsigned int i = 0; may_block && i < handlers->len; i++) {
+        lcm_subscription_t *subscription = (lcm_subscription_t *) g_ptr_array_index(handlers, i);
+        if (g_atomic_int_get(&subscription->drop_policy) == LCM_BLOCK &&
+            !g_atomic_int_get(&subscription->conflate) && subscription_is_full(subscription)) {
+            handlers_read_end(lcm, parity);
+            return -1;
+        }
+    }
+
     int num_keepers = 0;
+    unsigned int num_limited = 0;
     for (unsigned int i = 0; i < handlers->len; i++) {
         lcm_subscription_t *subscription = (lcm_subscription_t *) g_ptr_array_index(handlers, i);
-        if (subscription->num_queued_messages < subscription->max_num_queued_messages ||
-            subscription->max_num_queued_messages <= 0) {
-            subscription->num_queued_messages++;
-            num_keepers++;
-        }
+        if (!subscription_rate_admit(subscription))
+            num_limited++;
+        else
+            num_keepers += subscription_try_enqueue(subscription);
     }
-    g_rec_mutex_unlock(&lcm->mutex);
+    if (!num_keepers && handlers->len > num_limited)
+        lcm_stat_add(&lcm->num_queue_drops, 1);
+    handlers_read_end(lcm, parity);
     return num_keepers > 0;
 }
 
+int lcm_try_enqueue_message(lcm_t *lcm, const char *channel)
+{
+    return lcm_try_enqueue_message_priority(lcm, channel, NULL);
+}
+
+int lcm_try_enqueue_message_priority(lcm_t *lcm, const char *channel, int *priority)
+{
+    // wait for room in the queues of LCM_BLOCK subscriptions, for up to
+    // LCM_BLOCK_TIMEOUT_USEC.  The thread counts as a waiter before it looks
+    // at the queues again, so that it can't miss the wakeup for a message
+    // that is dequeued in between.
+    gint64 deadline = 0;
+    int generation = 0;
+    int result;
+    while ((result = lcm_enqueue_message(lcm, channel, deadline >= 0, priority)) < 0) {
+        if (!deadline) {
+            deadline = g_get_monotonic_time() + LCM_BLOCK_TIMEOUT_USEC;
+            g_atomic_int_inc(&lcm->space_waiters);
+            generation = g_atomic_int_get(&lcm->space_generation);
+            continue;
+        }
+
+        g_mutex_lock(&lcm->space_mutex);
+        while (deadline > 0 && g_atomic_int_get(&lcm->space_generation) == generation) {
+            if (!g_cond_wait_until(&lcm->space_cond, &lcm->space_mutex, deadline))
+                deadline = -1;
+        }
+        generation = g_atomic_int_get(&lcm->space_generation);
+        g_mutex_unlock(&lcm->space_mutex);
+    }
+    if (deadline)
+        g_atomic_int_add(&lcm->space_waiters, -1);
+    return result;
+}
+
 int lcm_has_handlers(lcm_t *lcm, const char *channel)
 {
-    int has_handlers = 1;
+    int parity = handlers_read_begin(lcm);
+    GHashTable *map = (GHashTable *) g_atomic_pointer_get(&lcm->handlers_map);
+    channel_handlers_t *entry = (channel_handlers_t *) g_hash_table_lookup(map, channel);
+    int has_handlers = entry && channel_handlers_use(entry)->len;
+    handlers_read_end(lcm, parity);
+    if (entry)
+        return has_handlers;
+
     g_rec_mutex_lock(&lcm->mutex);
-    GPtrArray *handlers = lcm_get_handlers(lcm, channel);
-    if (!handlers || !handlers->len)
-        has_handlers = 0;
+    has_handlers = lcm_get_channel_handlers(lcm, channel)->handlers->len > 0;
     g_rec_mutex_unlock(&lcm->mutex);
     return has_handlers;
 }
 
-int lcm_dispatch_handlers(lcm_t *lcm, lcm_recv_buf_t *buf, const char *channel)
+int lcm_has_handlers_cached(lcm_t *lcm, const char *channel, lcm_handlers_cache_t *cache)
 {
-    g_rec_mutex_lock(&lcm->mutex);
-
-    GPtrArray *handlers = lcm_get_handlers(lcm, channel);
-
-    // ref the handlers to prevent them from being destroyed by an
-    // lcm_unsubscribe.  This guarantees that handlers 0-(nhandlers-1) will not
-    // be destroyed during the callbacks.  Store nhandlers in a local variable
-    // so that we don't iterate over handlers that are added during the
-    // callbacks.
-    int nhandlers = handlers->len;
-    for (int i = 0; i < nhandlers; i++) {
-        lcm_subscription_t *subscription = (lcm_subscription_t *) g_ptr_array_index(handlers, i);
-        subscription->callback_scheduled = 1;
-    }
+    // every change to the handler lists, or to which channels handlers_map
+    // holds, is followed by a new epoch.  Read it first, so that a change
+    // during the lookup makes the next call look up the channel again.
+    int epoch = g_atomic_int_get(&lcm->handlers_epoch);
+    if (cache->has_handlers >= 0 && cache->epoch == epoch)
+        return cache->has_handlers;
+    cache->has_handlers = lcm_has_handlers(lcm, channel);
+    cache->epoch = epoch;
+    return cache->has_handlers;
+}
 
-    // now, call the handlers.
-    for (int i = 0; i < nhandlers; i++) {
+// Calls the handlers in entry, the entry of channel in handlers_map, and
+// releases lcm->mutex, which the caller must hold.
+static int dispatch_channel_handlers(lcm_t *lcm, lcm_recv_buf_t *buf, const char *channel,
+                                     channel_handlers_t *entry,
+                                     const lcm_recv_buf_lender_t *lender, void *msg)
+{
+    // ref the list, since subscribing or unsubscribing during the callbacks
+    // replaces it, and new channels may evict it.  The list holds the
+    // subscriptions in it, so they aren't destroyed by an lcm_unsubscribe()
+    // during the callbacks either.
+    GPtrArray *handlers = g_ptr_array_ref(entry->handlers);
+
+    // now, call the handlers, or hand the message to their executors.
+    // Messages only leave the queue of a subscription without an executor
+    // here, under lcm->mutex, so the queue can't empty between the check and
+    // the decrement.
+    lcm_async_msg_t *async_msg = NULL;
+    for (unsigned int i = 0; i < handlers->len; i++) {
         lcm_subscription_t *subscription = (lcm_subscription_t *) g_ptr_array_index(handlers, i);
-
-        if (!subscription->marked_for_deletion && subscription->num_queued_messages > 0) {
-            subscription->num_queued_messages--;
+        if (subscription->unsubscribed)
+            continue;
+
+        if ((g_atomic_pointer_get(&subscription->dispatcher) ||
+             g_atomic_pointer_get(&subscription->context) ||
+             g_atomic_int_get(&subscription->executor_scheduled)) &&
+            executor_push(subscription, buf, channel, &async_msg))
+            continue;
+
+        int num_queued_messages = g_atomic_int_get(&subscription->num_queued_messages);
+        if (num_queued_messages > 0 && !subscription_is_stale(subscription, num_queued_messages)) {
+            subscription_dequeue(subscription);
             g_rec_mutex_unlock(&lcm->mutex);
-            subscription->handler(buf, channel, subscription->userdata);
+            LCM_TRACE(handler_enter, channel, (int) buf->data_size, buf->recv_utime);
+            subscription_call(subscription, buf, channel, lender, msg);
+            LCM_TRACE(handler_exit, channel, (int) buf->data_size, buf->recv_utime);
             g_rec_mutex_lock(&lcm->mutex);
         }
     }
 
-    // unref the handlers and check if any should be deleted
-    GList *to_remove = NULL;
-    for (int i = 0; i < nhandlers; i++) {
-        lcm_subscription_t *subscription = (lcm_subscription_t *) g_ptr_array_index(handlers, i);
+    // this deletes the subscriptions that were unsubscribed during the
+    // callbacks, if the list was replaced in the meantime
+    g_ptr_array_unref(handlers);
+    if (async_msg)
+        async_msg_unref(async_msg);
+    g_rec_mutex_unlock(&lcm->mutex);
 
-        subscription->callback_scheduled = 0;
-        if (subscription->marked_for_deletion)
-            to_remove = g_list_prepend(to_remove, subscription);
+    return 0;
+}
+
+int lcm_dispatch_handlers(lcm_t *lcm, lcm_recv_buf_t *buf, const char *channel)
+{
+    g_rec_mutex_lock(&lcm->mutex);
+    return dispatch_channel_handlers(lcm, buf, channel, lcm_get_channel_handlers(lcm, channel),
+                                     NULL, NULL);
+}
+
+int lcm_dispatch_channel_handlers(lcm_t *lcm, lcm_recv_buf_t *buf, int channel_id,
+                                  const char *channel, const lcm_recv_buf_lender_t *lender,
+                                  void *msg)
+{
+    g_rec_mutex_lock(&lcm->mutex);
+    if (channel_id < 0) {
+        return dispatch_channel_handlers(lcm, buf, channel,
+                                         lcm_get_channel_handlers(lcm, channel), lender, msg);
     }
-    // actually delete handlers marked for deletion
-    for (; to_remove; to_remove = g_list_delete_link(to_remove, to_remove)) {
-        lcm_subscription_t *subscription = (lcm_subscription_t *) to_remove->data;
-        g_ptr_array_remove(lcm->handlers_all, subscription);
-        g_hash_table_foreach(lcm->handlers_map, map_remove_handler_callback, subscription);
-        lcm_handler_free(subscription);
+
+    GPtrArray *by_id = lcm->channels_by_id;
+    channel_handlers_t *entry = NULL;
+    if ((unsigned int) channel_id < by_id->len)
+        entry = (channel_handlers_t *) g_ptr_array_index(by_id, channel_id);
+    if (entry) {
+        channel_handlers_use(entry);
+    } else {
+        entry = lcm_get_channel_handlers(lcm, channel);
+        // an entry has a single id, since there is one id for each name
+        if (entry->id < 0) {
+            if ((unsigned int) channel_id >= by_id->len)
+                g_ptr_array_set_size(by_id, channel_id + 1);
+            g_ptr_array_index(by_id, channel_id) = entry;
+            entry->id = channel_id;
+            entry->refcount++;
+        }
     }
-    g_rec_mutex_unlock(&lcm->mutex);
+    return dispatch_channel_handlers(lcm, buf, channel, entry, lender, msg);
+}
 
-    return 0;
+lcm_recv_buf_t *lcm_recv_buf_retain(const lcm_recv_buf_t *rbuf)
+{
+    lcm_lent_buf_t *lent = (lcm_lent_buf_t *) g_private_get(&lent_buf_key);
+    void *ref = NULL;
+    if (lent && lent->rbuf == rbuf && lent->lender)
+        ref = lent->lender->retain(lent->msg);
+
+    lcm_retained_buf_t *retained;
+    if (ref) {
+        retained = (lcm_retained_buf_t *) malloc(sizeof(lcm_retained_buf_t));
+        if (!retained) {
+            lent->lender->release(ref);
+            return NULL;
+        }
+        retained->rbuf = *rbuf;
+        retained->lender = lent->lender;
+    } else {
+        retained = (lcm_retained_buf_t *) malloc(sizeof(lcm_retained_buf_t) + rbuf->data_size);
+        if (!retained)
+            return NULL;
+        retained->rbuf = *rbuf;
+        retained->rbuf.data = retained + 1;
+        memcpy(retained->rbuf.data, rbuf->data, rbuf->data_size);
+        retained->lender = NULL;
+    }
+    retained->ref = ref;
+    return &retained->rbuf;
+}
+
+void lcm_recv_buf_release(lcm_recv_buf_t *rbuf)
+{
+    if (!rbuf)
+        return;
+    lcm_retained_buf_t *retained = (lcm_retained_buf_t *) rbuf;
+    if (retained->ref)
+        retained->lender->release(retained->ref);
+    free(retained);
+}
+
+// The interned channel names, at the slot that the hash of each name leads to
+// with linear probing.  Slots are only ever filled, with a compare and swap,
+// so the table is read without a lock.
+static char *interned_channels[LCM_INTERNED_CHANNELS_SIZE];
+static int num_interned_channels;
+
+int lcm_intern_channel(const char *channel, const char **name)
+{
+    unsigned int i = g_str_hash(channel) & (LCM_INTERNED_CHANNELS_SIZE - 1);
+    char *copy = NULL;
+    while (1) {
+        char *slot = (char *) g_atomic_pointer_get(&interned_channels[i]);
+        if (!slot) {
+            if (g_atomic_int_get(&num_interned_channels) >= LCM_INTERNED_CHANNELS_SIZE * 3 / 4)
+                break;
+            if (!copy)
+                copy = strdup(channel);
+            if (!g_atomic_pointer_compare_and_exchange(&interned_channels[i], NULL, copy))
+                continue;  // another thread filled the slot, look at it again
+            g_atomic_int_inc(&num_interned_channels);
+            *name = copy;
+            return (int) i;
+        }
+        if (!strcmp(slot, channel)) {
+            free(copy);
+            *name = slot;
+            return (int) i;
+        }
+        i = (i + 1) & (LCM_INTERNED_CHANNELS_SIZE - 1);
+    }
+    free(copy);
+    *name = NULL;
+    return -1;
 }
 
 int lcm_parse_url(const char *url, char **provider, char **network, GHashTable *args)
@@ -493,16 +1841,356 @@ int lcm_parse_url(const char *url, char **provider, char **network, GHashTable *
 
 int lcm_subscription_set_queue_capacity(lcm_subscription_t *subs, int num_messages)
 {
-    g_rec_mutex_lock(&subs->lcm->mutex);
-    subs->max_num_queued_messages = num_messages;
-    g_rec_mutex_unlock(&subs->lcm->mutex);
+    g_atomic_int_set(&subs->max_num_queued_messages, num_messages);
+    lcm_wake_space_waiters(subs->lcm);
+    return 0;
+}
+
+int lcm_subscription_set_drop_policy(lcm_subscription_t *subs, lcm_drop_policy_t policy)
+{
+    if (policy != LCM_DROP_NEWEST && policy != LCM_DROP_OLDEST && policy != LCM_BLOCK) {
+        fprintf(stderr, "Error: invalid drop policy %d\n", (int) policy);
+        return -1;
+    }
+    g_atomic_int_set(&subs->drop_policy, policy);
+    lcm_wake_space_waiters(subs->lcm);
+    return 0;
+}
+
+int lcm_subscription_set_conflate(lcm_subscription_t *subs, int conflate)
+{
+    g_atomic_int_set(&subs->conflate, conflate != 0);
+    return 0;
+}
+
+int lcm_subscription_set_max_rate(lcm_subscription_t *subs, double hz)
+{
+    if (hz < 0) {
+        fprintf(stderr, "Error: invalid maximum rate %f\n", hz);
+        return -1;
+    }
+    lcm_stat_set(&subs->rate_period_ns, hz > 0 ? (uint64_t) (1e9 / hz) : 0);
+    return 0;
+}
+
+int lcm_subscription_set_priority(lcm_subscription_t *subs, int priority)
+{
+    if (priority < 0 || priority > LCM_MAX_PRIORITY) {
+        fprintf(stderr, "Error: invalid priority %d\n", priority);
+        return -1;
+    }
+    lcm_t *lcm = subs->lcm;
+    g_rec_mutex_lock(&lcm->mutex);
+    subs->priority = priority;
+    handlers_map_reprioritize(lcm);
+    g_rec_mutex_unlock(&lcm->mutex);
     return 0;
 }
 
 int lcm_subscription_get_queue_size(lcm_subscription_t *subs)
 {
-    g_rec_mutex_lock(&subs->lcm->mutex);
-    int result = subs->num_queued_messages;
-    g_rec_mutex_unlock(&subs->lcm->mutex);
-    return result;
+    return g_atomic_int_get(&subs->num_queued_messages);
+}
+
+uint64_t lcm_subscription_get_drop_count(lcm_subscription_t *subs)
+{
+    uint64_t num_dropped = 0;
+    for (int i = 0; i < LCM_NUM_DROP_POLICIES; i++)
+        num_dropped += lcm_stat_get(&subs->num_dropped[i]);
+    return num_dropped;
+}
+
+uint64_t lcm_subscription_get_policy_drop_count(lcm_subscription_t *subs,
+                                                lcm_drop_policy_t policy)
+{
+    if (policy != LCM_DROP_NEWEST && policy != LCM_DROP_OLDEST && policy != LCM_BLOCK)
+        return 0;
+    return lcm_stat_get(&subs->num_dropped[policy]);
+}
+
+int lcm_get_stats(lcm_t *lcm, lcm_stats_t *stats)
+{
+    memset(stats, 0, sizeof(lcm_stats_t));
+    if (lcm->provider && lcm->vtable->get_stats && lcm->vtable->get_stats(lcm->provider, stats) < 0)
+        return -1;
+    stats->queue_drops = lcm_stat_get(&lcm->num_queue_drops);
+    stats->channels_evicted = lcm_stat_get(&lcm->num_channels_evicted);
+    return 0;
+}
+
+int lcm_set_handler_stats(lcm_t *lcm, int enable)
+{
+    g_atomic_int_set(&lcm->handler_stats, enable != 0);
+    return 0;
+}
+
+int lcm_subscription_get_handler_stats(lcm_subscription_t *subs, lcm_handler_stats_t *stats)
+{
+    uint64_t *counters = (uint64_t *) &subs->stats;
+    uint64_t *copy = (uint64_t *) stats;
+    for (size_t i = 0; i < sizeof(lcm_handler_stats_t) / sizeof(uint64_t); i++)
+        copy[i] = lcm_stat_get(&counters[i]);
+    return 0;
+}
+
+int lcm_publish_handler_stats(lcm_t *lcm, const char *channel)
+{
+    handler_stats_report_t report;
+    report.utime = g_get_real_time();
+    report.source = g_strdup_printf("%s:%d", g_get_host_name(), (int) getpid());
+
+    lcm_stats_t counters;
+    if (lcm_get_stats(lcm, &counters) < 0)
+        memset(&counters, 0, sizeof(counters));
+    report.packets_received = (int64_t) counters.packets_received;
+    report.bytes_received = (int64_t) counters.bytes_received;
+    report.packets_bad = (int64_t) counters.packets_bad;
+    report.frag_bufs_evicted = (int64_t) counters.frag_bufs_evicted;
+    report.messages_incomplete = (int64_t) counters.messages_incomplete;
+    report.kernel_drops = (int64_t) counters.kernel_drops;
+    report.queue_drops = (int64_t) counters.queue_drops;
+    report.seqno_gaps = (int64_t) counters.seqno_gaps;
+
+    g_rec_mutex_lock(&lcm->mutex);
+    report.num_handlers = lcm->handlers_all->len;
+    report.handlers = (handler_stats_t *) calloc(report.num_handlers + 1, sizeof(handler_stats_t));
+    lcm_handler_stats_t *stats =
+        (lcm_handler_stats_t *) calloc(report.num_handlers + 1, sizeof(lcm_handler_stats_t));
+    for (int i = 0; i < report.num_handlers; i++) {
+        lcm_subscription_t *subscription =
+            (lcm_subscription_t *) g_ptr_array_index(lcm->handlers_all, i);
+        lcm_subscription_get_handler_stats(subscription, &stats[i]);
+        handler_stats_t *msg = &report.handlers[i];
+        msg->channel = strdup(subscription->channel);
+        msg->num_calls = (int64_t) stats[i].num_calls;
+        msg->total_usec = (int64_t) stats[i].total_usec;
+        msg->max_usec = (int64_t) stats[i].max_usec;
+        msg->total_queue_delay_usec = (int64_t) stats[i].total_queue_delay_usec;
+        msg->max_queue_delay_usec = (int64_t) stats[i].max_queue_delay_usec;
+        msg->num_buckets = LCM_HANDLER_STATS_BUCKETS;
+        msg->histogram = (int64_t *) stats[i].histogram;
+        msg->num_dropped = (int64_t) lcm_subscription_get_drop_count(subscription);
+    }
+    g_rec_mutex_unlock(&lcm->mutex);
+
+    int size = handler_stats_report_t_encoded_size(&report);
+    void *buf = malloc(size);
+    int status = -1;
+    if (handler_stats_report_t_encode(buf, 0, size, &report) == size)
+        status = lcm_publish(lcm, channel ? channel : LCM_STATS_CHANNEL, buf, size);
+    free(buf);
+
+    for (int i = 0; i < report.num_handlers; i++)
+        free(report.handlers[i].channel);
+    free(report.handlers);
+    free(stats);
+    g_free(report.source);
+    return status;
+}
+
+// set with lcm_set_thread_start_handler()
+static GMutex thread_start_mutex;
+static lcm_thread_start_handler_t thread_start_handler;
+static void *thread_start_user;
+
+void lcm_set_thread_start_handler(lcm_thread_start_handler_t handler, void *user_data)
+{
+    g_mutex_lock(&thread_start_mutex);
+    thread_start_handler = handler;
+    thread_start_user = user_data;
+    g_mutex_unlock(&thread_start_mutex);
+}
+
+int64_t lcm_monotonic_ns(void)
+{
+#ifdef WIN32
+    return g_get_monotonic_time() * 1000;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+void lcm_thread_sched_init(lcm_thread_sched_t *sched)
+{
+    sched->cpu = -1;
+    sched->priority = 0;
+    sched->numa_node = -1;
+}
+
+void lcm_parse_thread_sched_arg(lcm_thread_sched_t *sched, const char *key, const char *value)
+{
+    char *endptr = NULL;
+    if (!strcmp(key, "recv_cpu")) {
+        sched->cpu = strtol(value, &endptr, 0);
+        if (endptr == value || sched->cpu < 0) {
+            fprintf(stderr, "Warning: Invalid value for recv_cpu\n");
+            sched->cpu = -1;
+        }
+    } else if (!strcmp(key, "recv_prio")) {
+        sched->priority = strtol(value, &endptr, 0);
+        if (endptr == value || sched->priority < 0) {
+            fprintf(stderr, "Warning: Invalid value for recv_prio\n");
+            sched->priority = 0;
+        }
+    } else if (!strcmp(key, "numa_node")) {
+        if (!strcmp(value, "auto")) {
+            sched->numa_node = LCM_NUMA_NODE_AUTO;
+            return;
+        }
+        sched->numa_node = strtol(value, &endptr, 0);
+        if (endptr == value || sched->numa_node < 0) {
+            fprintf(stderr, "Warning: Invalid value for numa_node\n");
+            sched->numa_node = -1;
+        }
+    }
+}
+
+#ifdef __linux__
+// MPOL_PREFERRED of <numaif.h>, which comes with libnuma rather than the C
+// library
+#define LCM_MPOL_PREFERRED 1
+// the nodes that fit into a node mask of one unsigned long
+#define LCM_NUMA_MAX_NODES ((int) (8 * sizeof(unsigned long)))
+
+int lcm_numa_bind(void *addr, size_t len, int node)
+{
+    if (node < 0 || node >= LCM_NUMA_MAX_NODES)
+        return -1;
+    unsigned long mask = 1UL << node;
+    // the kernel reads one bit less than maxnode
+    if (syscall(SYS_mbind, addr, len, LCM_MPOL_PREFERRED, &mask, LCM_NUMA_MAX_NODES + 1, 0) < 0)
+        return -1;
+    return 0;
+}
+
+// Has the calling thread allocate its memory from a NUMA node, and run on its
+// CPUs unless pin is 0.
+static int numa_apply_node(int node, int pin)
+{
+    if (node >= LCM_NUMA_MAX_NODES)
+        return -1;
+    if (pin) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE *f = fopen(path, "r");
+        if (!f)
+            return -1;
+        // a list of CPUs and ranges of them, such as "0-7,16-23"
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        int first, last;
+        while (fscanf(f, "%d", &first) == 1) {
+            int sep = fgetc(f);
+            last = first;
+            if (sep == '-' && fscanf(f, "%d", &last) == 1)
+                sep = fgetc(f);
+            for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+                CPU_SET(cpu, &cpus);
+            if (sep != ',')
+                break;
+        }
+        fclose(f);
+        if (sched_setaffinity(0, sizeof(cpus), &cpus) < 0)
+            return -1;
+    }
+    unsigned long mask = 1UL << node;
+    if (syscall(SYS_set_mempolicy, LCM_MPOL_PREFERRED, &mask, LCM_NUMA_MAX_NODES + 1) < 0)
+        return -1;
+    return 0;
+}
+#else
+int lcm_numa_bind(void *addr, size_t len, int node)
+{
+    (void) addr;
+    (void) len;
+    (void) node;
+    return -1;
+}
+#endif
+
+// Applies sched to the calling thread.  Failures only print a warning, since
+// the thread still works without them.
+static void apply_thread_sched(const char *name, const lcm_thread_sched_t *sched)
+{
+    if (sched->cpu >= 0) {
+#ifdef __linux__
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        if (sched->cpu < CPU_SETSIZE)
+            CPU_SET(sched->cpu, &cpus);
+        // an empty set fails with EINVAL, like a CPU that does not exist
+        if (sched_setaffinity(0, sizeof(cpus), &cpus) < 0)
+            fprintf(stderr, "Warning: Unable to pin %s thread to CPU %d: %s\n", name, sched->cpu,
+                    strerror(errno));
+#elif defined(WIN32)
+        if (!SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) 1 << sched->cpu))
+            fprintf(stderr, "Warning: Unable to pin %s thread to CPU %d\n", name, sched->cpu);
+#else
+        fprintf(stderr, "Warning: recv_cpu is not supported on this platform\n");
+#endif
+    }
+
+    if (sched->numa_node >= 0) {
+#ifdef __linux__
+        if (numa_apply_node(sched->numa_node, sched->cpu < 0) < 0)
+            fprintf(stderr, "Warning: Unable to place %s thread on NUMA node %d: %s\n", name,
+                    sched->numa_node, strerror(errno));
+#else
+        fprintf(stderr, "Warning: numa_node is not supported on this platform\n");
+#endif
+    }
+
+    if (sched->priority > 0) {
+#ifdef WIN32
+        // Windows has no fixed-priority scheduling class to match SCHED_FIFO
+        if (!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+            fprintf(stderr, "Warning: Unable to raise priority of %s thread\n", name);
+#else
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = sched->priority;
+        int status = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (status != 0)
+            fprintf(stderr, "Warning: Unable to set SCHED_FIFO priority %d for %s thread: %s\n",
+                    sched->priority, name, strerror(status));
+#endif
+    }
+}
+
+typedef struct {
+    const char *name;
+    GThreadFunc func;
+    gpointer data;
+    lcm_thread_sched_t sched;
+} thread_start_t;
+
+static gpointer thread_start(gpointer user)
+{
+    thread_start_t *start = (thread_start_t *) user;
+    apply_thread_sched(start->name, &start->sched);
+
+    g_mutex_lock(&thread_start_mutex);
+    lcm_thread_start_handler_t handler = thread_start_handler;
+    void *handler_user = thread_start_user;
+    g_mutex_unlock(&thread_start_mutex);
+    if (handler)
+        handler(start->name, handler_user);
+
+    GThreadFunc func = start->func;
+    gpointer data = start->data;
+    free(start);
+    return func(data);
+}
+
+GThread *lcm_internal_thread_new(const char *name, GThreadFunc func, gpointer data,
+                                 const lcm_thread_sched_t *sched)
+{
+    thread_start_t *start = (thread_start_t *) malloc(sizeof(thread_start_t));
+    start->name = name;
+    start->func = func;
+    start->data = data;
+    start->sched = *sched;
+    return g_thread_new(name, thread_start, start);
 }
@@ -18,6 +18,21 @@
 
 #define LCM_MAX_CHANNEL_NAME_LENGTH 63
 
+/**
+ * The highest priority class of a channel.  See lcm_set_channel_priority().
+ */
+#define LCM_MAX_PRIORITY 3
+
+/**
+ * The number of buckets in the histogram of lcm_handler_stats_t.
+ */
+#define LCM_HANDLER_STATS_BUCKETS 24
+
+/**
+ * The channel that lcm_publish_handler_stats() publishes on by default.
+ */
+#define LCM_STATS_CHANNEL "LCM_STATS"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -27,11 +42,49 @@ extern "C" {
 #define lcm_get_fileno LCM_C_NAMESPACED(get_fileno)
 #define lcm_subscribe LCM_C_NAMESPACED(subscribe)
 #define lcm_unsubscribe LCM_C_NAMESPACED(unsubscribe)
+#define lcm_recv_buf_retain LCM_C_NAMESPACED(recv_buf_retain)
+#define lcm_recv_buf_release LCM_C_NAMESPACED(recv_buf_release)
 #define lcm_publish LCM_C_NAMESPACED(publish)
+#define lcm_publishv LCM_C_NAMESPACED(publishv)
+#define lcm_publish_batch LCM_C_NAMESPACED(publish_batch)
+#define lcm_publish_async LCM_C_NAMESPACED(publish_async)
+#define lcm_publish_async_buffer LCM_C_NAMESPACED(publish_async_buffer)
+#define lcm_publish_reserve LCM_C_NAMESPACED(publish_reserve)
+#define lcm_publish_commit LCM_C_NAMESPACED(publish_commit)
+#define lcm_publish_cancel LCM_C_NAMESPACED(publish_cancel)
+#define lcm_publisher_create LCM_C_NAMESPACED(publisher_create)
+#define lcm_publisher_publish LCM_C_NAMESPACED(publisher_publish)
+#define lcm_publisher_destroy LCM_C_NAMESPACED(publisher_destroy)
+#define lcm_publisher_has_subscribers LCM_C_NAMESPACED(publisher_has_subscribers)
 #define lcm_handle LCM_C_NAMESPACED(handle)
 #define lcm_handle_timeout LCM_C_NAMESPACED(handle_timeout)
+#define lcm_handle_batch LCM_C_NAMESPACED(handle_batch)
+#define lcm_try_handle LCM_C_NAMESPACED(try_handle)
 #define lcm_subscription_set_queue_capacity LCM_C_NAMESPACED(subscription_set_queue_capacity)
+#define lcm_subscription_set_drop_policy LCM_C_NAMESPACED(subscription_set_drop_policy)
+#define lcm_subscription_set_conflate LCM_C_NAMESPACED(subscription_set_conflate)
+#define lcm_subscription_set_priority LCM_C_NAMESPACED(subscription_set_priority)
+#define lcm_subscription_set_max_rate LCM_C_NAMESPACED(subscription_set_max_rate)
+#define lcm_set_channel_priority LCM_C_NAMESPACED(set_channel_priority)
 #define lcm_subscription_get_queue_size LCM_C_NAMESPACED(subscription_get_queue_size)
+#define lcm_subscription_get_drop_count LCM_C_NAMESPACED(subscription_get_drop_count)
+#define lcm_subscription_get_policy_drop_count LCM_C_NAMESPACED(subscription_get_policy_drop_count)
+#define lcm_get_stats LCM_C_NAMESPACED(get_stats)
+#define lcm_set_handler_stats LCM_C_NAMESPACED(set_handler_stats)
+#define lcm_subscription_get_handler_stats LCM_C_NAMESPACED(subscription_get_handler_stats)
+#define lcm_publish_handler_stats LCM_C_NAMESPACED(publish_handler_stats)
+#define lcm_set_thread_start_handler LCM_C_NAMESPACED(set_thread_start_handler)
+#define lcm_monotonic_ns LCM_C_NAMESPACED(monotonic_ns)
+#define lcm_dispatcher_create LCM_C_NAMESPACED(dispatcher_create)
+#define lcm_dispatcher_destroy LCM_C_NAMESPACED(dispatcher_destroy)
+#define lcm_dispatcher_run LCM_C_NAMESPACED(dispatcher_run)
+#define lcm_subscription_set_executor LCM_C_NAMESPACED(subscription_set_executor)
+#define lcm_dispatch_context_create LCM_C_NAMESPACED(dispatch_context_create)
+#define lcm_dispatch_context_destroy LCM_C_NAMESPACED(dispatch_context_destroy)
+#define lcm_dispatch_context_get_fileno LCM_C_NAMESPACED(dispatch_context_get_fileno)
+#define lcm_dispatch_context_handle LCM_C_NAMESPACED(dispatch_context_handle)
+#define lcm_dispatch_context_handle_timeout LCM_C_NAMESPACED(dispatch_context_handle_timeout)
+#define lcm_subscription_set_dispatch_context LCM_C_NAMESPACED(subscription_set_dispatch_context)
 
 /**
  * @defgroup LcmC C API Reference
@@ -66,6 +119,44 @@ typedef struct _lcm_t lcm_t;
  */
 typedef struct _lcm_subscription_t lcm_subscription_t;
 
+/**
+ * What a subscription does with a received message when its queue is full.
+ * See lcm_subscription_set_drop_policy().
+ */
+typedef enum {
+    /**
+     * Drop the new message.  This is the default.
+     */
+    LCM_DROP_NEWEST = 0,
+    /**
+     * Queue the new message, and drop the oldest queued message instead.
+     */
+    LCM_DROP_OLDEST = 1,
+    /**
+     * Make the thread receiving the message wait briefly for room in the
+     * queue, and drop the new message if there is still none.
+     */
+    LCM_BLOCK = 2,
+} lcm_drop_policy_t;
+
+/**
+ * A pool of threads that runs message handlers outside of lcm_handle().  See
+ * lcm_subscription_set_executor().
+ */
+typedef struct _lcm_dispatcher_t lcm_dispatcher_t;
+
+/**
+ * A queue of messages whose handlers run on the thread that calls
+ * lcm_dispatch_context_handle().  See lcm_subscription_set_dispatch_context().
+ */
+typedef struct _lcm_dispatch_context_t lcm_dispatch_context_t;
+
+/**
+ * A handle for publishing messages on one channel.  See
+ * lcm_publisher_create().
+ */
+typedef struct _lcm_publisher_t lcm_publisher_t;
+
 /**
  * Received messages are passed to user programs using this data structure.
  * Each instance represents one message.
@@ -89,6 +180,21 @@ struct _lcm_recv_buf_t {
      * pointer to the lcm_t struct that owns this buffer
      */
     lcm_t *lcm;
+    /**
+     * timestamp (nanoseconds since the epoch) at which the message was
+     * received.  Only the udpm provider with the timestamping option set
+     * provides more than microsecond resolution.  With timestamping=hw, this
+     * is taken from the network card's clock when it timestamps packets.
+     */
+    int64_t recv_time_ns;
+    /**
+     * time (nanoseconds on the monotonic clock, CLOCK_MONOTONIC on POSIX
+     * systems) at which the message was received by this process.  Unlike
+     * recv_utime, it doesn't jump when the wall clock is set, so differences
+     * between it and lcm_monotonic_ns() measure latency.  For a log file, it
+     * is when the event was read.
+     */
+    int64_t recv_mono_ns;
 };
 
 /**
@@ -128,9 +234,337 @@ typedef void (*lcm_msg_handler_t)(const lcm_recv_buf_t *rbuf, const char *channe
              size of the kernel UDP receive buffer to request.  Defaults to
              operating system defaults
 
+         recv_buf_max = N
+             If nonzero, the kernel UDP receive buffer is doubled, up to N
+             bytes, whenever the kernel drops datagrams for lack of room in
+             it, or a read thread has to wait for lcm_handle() to make room
+             in its ring buffer.  SO_RCVBUFFORCE is tried first, which lets
+             processes with CAP_NET_ADMIN go past net.core.rmem_max on
+             Linux.  The size that the kernel settled on is reported in the
+             recv_buf_size field of lcm_get_stats().  Default 0
+
          ttl = N
              time to live of transmitted packets.  Default 0
 
+         recv_batch = N
+             Linux only.  Read up to N datagrams from the socket with a single
+             recvmmsg() call, instead of one datagram at a time.  Useful for
+             high message rates.  Default 0 (disabled)
+
+         recv_threads = N
+             Number of threads that read from the receive socket and
+             reassemble fragmented messages.  Fragments are reassembled per
+             sender, so several threads help most when receiving from many
+             senders.  Messages read by different threads may be dispatched
+             out of order.  If 0, there is no read thread, and lcm_handle()
+             reads messages from the socket itself.  This saves a thread
+             handoff, but lcm_handle() may then return without dispatching a
+             message if only part of a fragmented message has arrived.
+             Default 1
+
+         busy_poll = N
+             Busy poll the receive socket for up to N microseconds before
+             blocking on it.  On Linux this also sets SO_BUSY_POLL, which
+             usually requires CAP_NET_ADMIN.  Mostly useful with
+             recv_threads = 0.  Default 0 (disabled)
+
+         timestamping = sw | hw
+             Linux only.  Fills in recv_time_ns of received messages with
+             nanosecond kernel timestamps (sw), or with the network card's
+             hardware timestamps (hw).  Hardware timestamping must also be
+             enabled on the network card, and falls back to kernel timestamps
+             otherwise.  By default recv_time_ns has microsecond resolution
+
+         mono_clock = read | kernel
+             How recv_mono_ns of received messages is filled in.  "read"
+             reads the monotonic clock for each datagram.  "kernel" derives
+             it from the kernel's receive timestamp instead, with the offset
+             between the system and monotonic clocks sampled every 1024
+             datagrams, saving a clock read per datagram where the kernel
+             timestamps them.  After the system clock is set, recv_mono_ns
+             may be off until the offset is sampled again.  Default "read"
+
+         frag_size = N
+             Largest UDP datagram to send, not counting the IP and UDP
+             headers.  Larger messages are split into fragments that fit.
+             Must be between 256 and 65507.  Default 65507 (1443 on macOS)
+
+         mtu = N | auto
+             Chooses frag_size so that every datagram fits into an MTU of N
+             bytes without IP fragmentation.  "auto" uses the MTU of the
+             interface that multicast traffic is routed to (Linux only).
+             Also applies to the mpudpm:// provider, like frag_size
+
+         recv_cpu = N
+             Pins the read thread to CPU N.  With recv_threads > 1, the
+             threads are pinned to consecutive CPUs starting at N.  Also
+             applies to the mpudpm:// provider.  Default unpinned
+
+         recv_prio = N
+             POSIX only.  Runs the read threads with SCHED_FIFO real-time
+             priority N, which usually requires CAP_SYS_NICE.  Also applies to
+             the mpudpm:// provider.  Default 0 (normal scheduling)
+
+         numa_node = N | auto
+             Linux only.  Runs the read threads on the CPUs of NUMA node N,
+             unless recv_cpu is given, and allocates the receive ring buffer
+             and the message and fragment buffers that they fill from its
+             memory.  "auto" uses the node of the network interface that
+             multicast traffic is received on.  Default any node
+
+         local_delivery = 0 | 1
+             If 1, messages published on this instance are handed to its own
+             subscribers directly, instead of being read back from the
+             network, and the copies that the network loops back are
+             discarded.  Other instances and processes still receive them
+             through the network.  Not supported with recv_threads = 0.
+             Default 0
+
+         share = 0 | 1
+             If 1, the instances of the process that are created with the
+             same URL receive through one socket and read thread, which
+             reassemble each message once and queue it for every instance
+             that subscribes to it.  The self test of the first one runs in
+             the background, as with self_test = async, and lcm_get_stats()
+             reports the counters of the shared receive side.  Up to 64
+             instances can share it.  Not supported with recv_threads = 0 or
+             local_delivery = 1.  Default 0
+
+         peers = HOST[:PORT],...
+             Sends each datagram by unicast to every one of the listed IPv4
+             addresses, instead of to the multicast group, so that a
+             high-rate stream only reaches the hosts that consume it.  PORT
+             defaults to the multicast port.  The datagrams are the same as
+             with multicast, and the self test is not run.  The peers receive
+             them with unicast = 1.  Default none
+
+         ifaces = [REGEX:]ADDR,...
+             Sends multicast datagrams out of the local interfaces with the
+             listed IPv4 addresses, and joins the group on each of them, to
+             spread the traffic over several links.  Channels that match
+             REGEX in full are sent out of that interface.  The others are
+             hashed to the interfaces without a REGEX, or to all of them if
+             every one has one.  Each message goes out of a single interface,
+             so the messages of a channel stay in order.  Each interface
+             should be on a network of its own, or receivers get every
+             datagram once per interface.  Not supported with retransmit.
+             Default the interface that the multicast route points to
+
+         unicast = 0 | 1
+             If 1, the receive socket is bound to the port on all local
+             addresses instead of only to the multicast address, so that it
+             also receives datagrams sent to it with peers.  It then also
+             receives datagrams for other multicast groups that another
+             socket of the host joined on the same port.  Default 0
+
+         send_queue = N
+             Size in bytes of a send queue for lcm_publish_async().  Messages
+             published with it are queued, and transmitted by a separate
+             sender thread.  Each message takes up its size plus about 100
+             bytes, and larger messages can not be published this way.
+             Default 0 (lcm_publish_async() is the same as lcm_publish())
+
+         send_policy = block | drop
+             What lcm_publish_async() does when the send queue is full: wait
+             for room (block), or discard the message and return -1 (drop).
+             Default block
+
+         bundle_size = N
+             If nonzero, short messages are collected into bundle packets of
+             up to N bytes (at most the packet_size), instead of being sent
+             as one datagram each.  A bundle is sent when the next message
+             does not fit, or bundle_interval after its first message.
+             Receivers that do not understand bundles ignore them.  Default 0
+
+         bundle_interval = N
+             How long in microseconds a bundle may wait for more messages
+             before it is sent.  Default 1000
+
+         send_rate = N
+             If nonzero, datagrams are sent at no more than N bytes per
+             second, so that the fragments of large messages do not overflow
+             the buffers of switches and receivers in bursts.  lcm_publish()
+             waits as needed.  Default 0
+
+         send_burst = N
+             How many bytes may be sent at once, without waiting, after a
+             pause, with send_rate.  Default 65536
+
+         send_pacing = bucket | kernel
+             How send_rate is applied: by a token bucket in liblcm, or by the
+             kernel with SO_MAX_PACING_RATE, which does not block the
+             publisher and takes effect with the fq queueing discipline
+             (tc qdisc replace dev IFACE root fq).  kernel is only supported
+             on Linux.  Default bucket
+
+         compress = REGEX
+             Messages too large for a single datagram, on channels that match
+             REGEX in full, are sent LZ4 compressed in fewer fragments.
+             Receivers decompress them before they are dispatched, and ones
+             that predate compression ignore them.  Requires liblcm to be
+             built with LZ4, on the receiving side too.  Also applies to the
+             mpudpm:// provider.  Default none
+
+         fec = N
+             Messages too large for a single datagram are followed by a
+             parity packet for every N of their fragments, from which
+             receivers rebuild a fragment that was lost, if at most one of
+             those N was.  Costs one datagram in N+1, and makes each
+             fragment smaller by the size of the channel name.  Receivers
+             that predate parity packets ignore them.  Default 0
+
+         delta = REGEX
+             Messages too large for a single datagram, on channels that match
+             REGEX in full, are sent as the bytes that changed since the
+             previous message on the channel, if it had the same size, with
+             every delta_keyframe-th message sent whole as a keyframe.
+             Receivers rebuild the messages before they are dispatched, and
+             drop those after a message that they missed until the next
+             keyframe.  Ones that predate deltas ignore them.  These channels
+             are not compressed.  Default none
+
+         delta_keyframe = N
+             How many messages are sent on each channel of delta for each
+             keyframe.  Default 10
+
+         retransmit = REGEX
+             Reliable delivery of messages too large for a single datagram,
+             on channels that match REGEX in full.  Publishers keep the
+             messages that they sent lately, and receivers whose fragments of
+             one stop arriving before it is complete ask its publisher for
+             the missing ones, with a NACK.  The publisher then sends them to
+             the multicast group again.  Needs to be given on both sides.
+             Default none
+
+         retransmit_buffer = N
+             How many bytes of recently sent messages a publisher keeps for
+             retransmission.  Default 16777216
+
+         nack_timeout = N
+             How many milliseconds a receiver waits, after the last fragment
+             of an incomplete message arrived, before it asks for the missing
+             ones.  It asks up to 3 times.  Default 20
+
+         interest = PORT
+             Processes announce the channels that they subscribe to, every
+             interest_period, to port PORT of the multicast group.  Publishers
+             created with lcm_publisher_create(), and lcm::LCM::Publisher,
+             then skip the messages of channels that nobody on the group
+             subscribes to, without sending them.  lcm_publish() always
+             sends.  Every subscribing process needs the option, or its
+             channels may be skipped.  For a short while after the instance
+             is created, every channel counts as subscribed.  Not supported
+             with peers.  Default none
+
+         interest_period = N
+             How many milliseconds apart the announcements of interest are.
+             A process that stops announcing counts as unsubscribed after 3
+             of them.  Default 1000
+
+         latch = REGEX
+             Channels that match REGEX in full are latched: the last message
+             published on each is kept, and sent to the group again as soon
+             as a process starts subscribing to the channel, so that a
+             process that starts late gets it without it being published
+             over and over.  Those that already subscribe get it again too.
+             Publishers keep it even when nobody subscribes yet.  Only the
+             publishing process needs the option, but it and the subscribers
+             need interest.  Default none
+
+         xdp = IFACE[:QUEUE]
+             Linux only, and only if LCM was built with AF_XDP support.  The
+             first read thread receives the datagrams to the multicast group
+             and port that arrive on receive queue QUEUE (default 0) of the
+             network interface IFACE through an AF_XDP socket, bypassing the
+             kernel network stack.  An XDP program on the interface takes
+             them away from every other socket on the host.  It leaves IP
+             fragments, and the datagrams of other queues, to the receive
+             socket, so publishers should use mtu to stay unfragmented, and
+             the network card should steer the LCM traffic to QUEUE.  Frames
+             are at most 4 kB, so the MTU of IFACE should be at most about
+             3500 bytes.  Needs CAP_NET_ADMIN and CAP_BPF.  Default none
+
+         io_uring = 0 | 1
+             Linux 6.3 or later only.  If 1, the read threads receive through
+             an io_uring with a multishot recvmsg request, into 64 buffers of
+             64 kB that the kernel picks from a ring, so that a burst of
+             datagrams takes one system call instead of one each.  Fragments
+             are reassembled straight from those buffers.  Falls back to
+             recvmsg() if the kernel does not support it, or it is not
+             allowed, e.g. by seccomp.  Not used with recv_threads = 0, nor by
+             the read thread of xdp.  Also applies to the mpudpm:// provider.
+             Default 0
+
+         iocp = 0 | 1
+             Windows only.  If 1, the read threads receive through an I/O
+             completion port, with 32 overlapped WSARecvMsg() requests of
+             64 kB outstanding, instead of with select() and one recvmsg()
+             call per datagram.  The kernel fills the buffers while the read
+             threads handle the previous datagrams, and a burst of them is
+             taken with one call.  Fragments are reassembled straight from
+             those buffers.  Not used with recv_threads = 0.  Default 0
+
+         self_test = 0 | 1 | async
+             When the first subscription is made, a message is sent to the
+             multicast group to check that it comes back.  With 1, that
+             lcm_subscribe() waits for it, and fails after 10 seconds if it
+             does not arrive.  With async, lcm_subscribe() returns right away,
+             the check runs in the background, and a failure is only printed
+             and counted in the self_test_failures of lcm_get_stats().  Not
+             supported with recv_threads = 0, where async is the same as 0.
+             0 skips the check.  Default 1
+
+         ringbuf_size = N
+             Initial size in bytes of the buffer that each read thread
+             receives datagrams into, until lcm_handle() has dispatched them.
+             Must be at least 196800.  A larger buffer rides out longer bursts
+             without having to grow.  Default 204800
+
+         ringbuf_max = N
+             Largest size in bytes that the receive buffer of each read thread
+             may grow to when messages arrive faster than lcm_handle()
+             dispatches them.  Once it is full, the read thread waits for
+             lcm_handle() instead, and further datagrams queue up in the
+             kernel, which drops them when its receive buffer is full too.
+             Default 0 (no limit)
+
+         ringbuf_lock = 0 | 1
+             If 1, the receive buffers of ringbuf_size bytes are allocated up
+             front, from huge pages if there are any to spare, and locked into
+             memory, which may require CAP_IPC_LOCK or a higher RLIMIT_MEMLOCK.
+             They never grow, so receiving never allocates memory or page
+             faults.  Default 0
+
+         recv_bufs = N
+             Number of message buffers that each read thread allocates up
+             front, and adds whenever it runs out of them.  Default 2000
+
+         frag_store = N
+             Total size in bytes of the fragmented messages that are being
+             reassembled at once.  Once it is exceeded, the partial messages
+             that went longest without a new fragment are dropped.  A single
+             message larger than this is still reassembled.  Default 16777216
+
+         max_frag_bufs = N
+             Number of fragmented messages that are reassembled at once.
+             Default 1000
+
+         lean = 0 | 1
+             If 1, the defaults of recv_bufs, frag_store, max_frag_bufs and
+             ringbuf_size are 32, 1048576, 32 and 196800, for processes that
+             receive little and should take little memory.  The buffers still
+             grow as needed.  Options that are given explicitly override
+             these.  Default 0
+
+         align = N
+             Places the payload of each received message at an address that
+             is a multiple of N, a power of two up to 64, so that handlers
+             can decode it in place with aligned loads.  Short messages are
+             moved over their header, and fragmented messages are reassembled
+             into aligned buffers.  The messages of bundles (see
+             bundle_size) are not aligned.  Also applies to the mpudpm://
+             provider.  Default 1
+
      examples:
          "udpm://239.255.76.67:7667"
              Default initialization string
@@ -141,6 +575,66 @@ typedef void (*lcm_msg_handler_t)(const lcm_recv_buf_t *rbuf, const char *channe
  @endverbatim
  *
  * @verbatim
+ mpudpm://
+     Multi-port UDP Multicast provider
+     Like udpm://, but each channel is sent to one of a range of ports, so
+     that subscribers only receive the channels that they subscribed to.
+     network can be of the form "multicast_address:port", where port is the
+     first port of the range.  The processes agree on the port of each
+     channel by broadcasting the mappings that they add or change as they
+     do, and all of their mappings about every 30 seconds, or when another
+     process missed an update.  All processes should use the same options
+     below.
+
+     options:
+         nports = N
+             Number of ports in the range.  Default 500
+
+         port_pins = REGEX:PORT[-LAST],...
+             Channels that match REGEX in full are sent to PORT, or hashed
+             to the ports from PORT to LAST, and no other channels are
+             hashed to those ports.  The first pin that matches a channel
+             applies.  The ports must be within the range
+
+         port_pins_file = FILE
+             Reads more port pins from FILE, one REGEX:PORT[-LAST] per line.
+             Empty lines and lines starting with # are skipped.  These are
+             tried after the ones of port_pins
+
+         port_assign = hash | load
+             With hash, channels are hashed to a port.  With load, channels
+             are not hashed to ports that already carry heavy_rate bytes/s if
+             possible, and a process that publishes a channel with at least
+             heavy_rate bytes/s moves it to a port of its own, or if there is
+             none left to the port with the least traffic.  Pinned channels
+             are never moved.  Default hash
+
+         heavy_rate = N
+             Bytes/s at which port_assign=load moves a channel to a port of
+             its own.  Default 10000000
+
+         group_per_port = 0 | 1
+             If 1, each port also has a multicast group of its own, the
+             multicast address plus the offset of the port in the range, and
+             a process only joins the groups of the ports of the channels
+             that it subscribes to.  Switches with IGMP snooping then only
+             forward a channel to the hosts that subscribe to it.  Pinning
+             heavy channels to ports of their own (see port_pins) gives
+             them groups of their own.  Default 0
+
+         recv_threads = N
+             Number of threads that read from the ports and reassemble
+             fragmented messages.  Each port is read by one of them, so
+             several threads help most when the traffic is spread over
+             several ports.  Messages on different ports may then be
+             dispatched out of order.  Unlike the options above, this does
+             not need to match between processes.  Default 1
+
+     Also takes the recv_buf_size, ttl, frag_size, mtu, recv_cpu, recv_prio,
+     compress, io_uring and align options of udpm://.
+ @endverbatim
+ *
+ * @verbatim
  file://
      LCM Log file-based provider
      network should be the path to the log file
@@ -150,6 +644,10 @@ typedef void (*lcm_msg_handler_t)(const lcm_recv_buf_t *rbuf, const char *channe
      by the speed option.  In write mode, events published to the LCM instance
      will be written to the log file in real-time.
 
+     In read mode, network may also list several log files separated by
+     commas, which are played as one, in order of their events' timestamps.
+     Their events are renumbered in that order.
+
      options:
          speed = N
              Scale factor controlling the playback speed of the log file.
@@ -168,6 +666,34 @@ typedef void (*lcm_msg_handler_t)(const lcm_recv_buf_t *rbuf, const char *channe
              log file.  If it is after the last event, calls to lcm_handle will
              return -1.
 
+         pace_tolerance = USEC
+             Read mode only.  Events due within USEC microseconds of each
+             other are dispatched together, instead of each waiting for the
+             thread that times playback.  Defaults to 50.
+
+         pace_stats = 0 | 1
+             Read mode only.  If 1, then how early or late events were
+             dispatched is printed to stderr when playback ends.  Defaults
+             to 0.
+
+         prefetch_mb = MB
+             Read mode only.  If above 0, then a thread reads events ahead
+             of playback, keeping up to MB megabytes of them in memory, so
+             that slow storage doesn't delay playback.  Defaults to 0.
+
+         write_queue_mb = MB
+             Write mode only.  If above 0, then events published are queued,
+             and a thread writes all those queued at once, so that publishing
+             doesn't wait for the disk.  Publishing blocks while the events
+             queued take up MB megabytes.  The events queued are written
+             before lcm_destroy() returns.  Defaults to 0.
+
+         recv_cpu = N
+         recv_prio = N
+             Read mode only.  Pins the thread that times playback to CPU N,
+             and runs it with SCHED_FIFO priority N, like the udpm options of
+             the same names.
+
      examples:
          "file:///home/albert/path/to/logfile"
              Loads the file "/home/albert/path/to/logfile" as an LCM event
@@ -177,6 +703,10 @@ typedef void (*lcm_msg_handler_t)(const lcm_recv_buf_t *rbuf, const char *channe
              Loads the file "/home/albert/path/to/logfile" as an LCM event
              source.  Events are played back at 4x speed.
 
+         "file:///logs/camera.lcm,/logs/lidar.lcm"
+             Plays back the files "/logs/camera.lcm" and "/logs/lidar.lcm"
+             together.
+
  @endverbatim
  *
  * @verbatim
@@ -190,10 +720,99 @@ typedef void (*lcm_msg_handler_t)(const lcm_recv_buf_t *rbuf, const char *channe
     that require deterministic and predictable behavior that is independent of
     a system's network configuration.
 
-    example:
+    Messages are passed to lcm_handle() through a ring of preallocated slots
+    without a lock, so any number of threads may publish at once.  The buffer
+    of lcm_publish_async_buffer() is dispatched without being copied.
+
+    options:
+        dispatch = [queue|inline]
+            With inline, lcm_publish() calls the handlers of the message
+            itself before it returns, and lcm_handle() has nothing to
+            dispatch.  Messages published by those handlers are dispatched
+            after them, before the outer lcm_publish() returns.  Handlers are
+            still called by one thread at a time.  Default queue
+
+    examples:
         "memq://"
-            This is the only valid way to instantiate this provider.
+            Messages are dispatched by lcm_handle().
+
+        "memq://?dispatch=inline"
+            Messages are dispatched by lcm_publish().
+
+ @endverbatim
+ *
+ * @verbatim
+ shm://
+     Shared memory provider
+     Linux only.  network is a group name, which defaults to "default".
+
+     Processes on the same host that use the same group name exchange
+     messages through a ring buffer in the shared memory object
+     /dev/shm/lcm-<group>.  The first process to use a group creates the
+     object, and it is never removed automatically.  Messages are copied
+     once into shared memory by the publisher, and handlers are given
+     pointers straight into shared memory, which are only valid until the
+     handler returns.  As with UDP, publishers never wait for subscribers:
+     a subscriber that falls behind by more than half of the ring loses
+     messages.  recv_utime is the time the message was published.
+
+     options:
+         size = N
+             Size of the ring buffer in bytes, rounded up to a power of two.
+             Only used by the process that creates the shared memory object.
+             Messages can be up to a quarter of this size.  Default 64 MiB
+
+         recv_cpu = N
+         recv_prio = N
+             Placement of the thread that waits for messages, like the udpm
+             options of the same names.
 
+     examples:
+         "shm://"
+             Uses the default group.
+
+         "shm://camera?size=268435456"
+             Uses the group "camera", with a 256 MiB ring buffer if this
+             process creates it.
+ @endverbatim
+ *
+ * @verbatim
+ tcpq://
+     TCP queue provider
+     network is host:port of an LCM TCP server, which defaults to
+     "127.0.0.1:7700".  lcm-tcpq-hub is such a server on Linux, which only
+     sends each client the channels it subscribed to, and drops messages
+     for clients that fall behind.  lcm-java provides one as well.
+
+     Each message is sent to the server in a single write.  TCP_NODELAY is
+     set, so that messages aren't held back by the kernel waiting for more.
+     Publishers that send many small messages can instead collect them into
+     batches.
+
+     Messages are received in as large pieces as the server has sent, and
+     lcm_handle() dispatches all of the complete ones.  Those that are left
+     over by lcm_try_handle() with a small max_msgs don't make
+     lcm_get_fileno() readable again, so call it until it returns 0.
+
+     options:
+         nodelay = [0|1]
+             Whether TCP_NODELAY is set.  Default 1
+
+         batch_size = N
+             Collects published messages into batches of up to N bytes,
+             which are sent once they're full, or batch_interval after the
+             first message of the batch was published.  Messages larger
+             than N bytes are sent on their own.  Default 0, which sends
+             every message as it's published
+
+         batch_interval = USEC
+             Longest time in microseconds that a message waits in a
+             batch.  Default 1000
+
+     examples:
+         "tcpq://localhost:7700?batch_size=65536&batch_interval=500"
+             Sends messages in batches of up to 64 KiB, none of which waits
+             longer than half a millisecond.
  @endverbatim
  *
  * @return a newly allocated lcm_t instance, or NULL on failure.  Free with
@@ -219,6 +838,13 @@ void lcm_destroy(lcm_t *lcm);
  * (e.g., GTK+, QT, etc.)  For an example using select(), see
  * examples/c/listener-async.c
  *
+ * The descriptor only needs to be watched for readability.  Once it is
+ * readable, call lcm_try_handle() to dispatch the received messages without
+ * blocking.  When messages are left over after that, the descriptor stays
+ * readable, or becomes readable again, so it also works with edge-triggered
+ * reactors such as epoll with EPOLLET or io_uring multishot polls.  Don't read
+ * from the descriptor yourself.
+ *
  * @return a file descriptor suitable for use with select, poll, etc.
  */
 LCM_EXPORT
@@ -240,7 +866,9 @@ int lcm_get_fileno(lcm_t *lcm);
  * @param lcm      the LCM object
  * @param channel  the channel to listen on.  This can also be a GLib regular
  *                 expression, and is treated as a regex implicitly surrounded
- *                 by '^' and '$'
+ *                 by '^' and '$'.  Channel names, and channel names
+ *                 followed or preceded by ".*", are matched without running
+ *                 the regex
  * @param handler  the callback function to be invoked when a message is
  *                 received on the specified channel
  * @param userdata this will be passed to the callback function
@@ -271,6 +899,64 @@ lcm_subscription_t *lcm_subscribe(lcm_t *lcm, const char *channel, lcm_msg_handl
 LCM_EXPORT
 int lcm_unsubscribe(lcm_t *lcm, lcm_subscription_t *handler);
 
+/**
+ * @brief Keeps a received message after the handler returns.
+ *
+ * A handler can call this with the @p rbuf that it was passed, to keep using
+ * the message after it returns.  The udpm and mpudpm providers lend the
+ * buffer that the message was received into, and memq lends the buffer of
+ * messages that it didn't copy into its queue, so the data is not copied.
+ * Until the message is released, their read threads can't reuse that memory
+ * for new messages.  Otherwise, the message is copied.
+ *
+ * The retained buffer must be released with lcm_recv_buf_release() before
+ * the %LCM object is destroyed.
+ *
+ * @param rbuf  The message passed to the handler
+ *
+ * @return a buffer with the same data, timestamps and %LCM object as @p rbuf,
+ * which stays valid until it is released, or NULL if @p rbuf couldn't be
+ * copied.
+ */
+LCM_EXPORT
+lcm_recv_buf_t *lcm_recv_buf_retain(const lcm_recv_buf_t *rbuf);
+
+/**
+ * @brief Releases a message kept with lcm_recv_buf_retain().
+ *
+ * This may be called from any thread.
+ *
+ * @param rbuf  The buffer returned by lcm_recv_buf_retain()
+ */
+LCM_EXPORT
+void lcm_recv_buf_release(lcm_recv_buf_t *rbuf);
+
+/**
+ * @brief Puts the channels matching a pattern in a priority class.
+ *
+ * Received messages that are waiting for lcm_handle() are dispatched by
+ * priority class, highest first, and in the order they arrived within a
+ * class.  This lets an urgent message, such as an emergency stop, overtake a
+ * burst of large messages on other channels.  The class of a channel is the
+ * highest of the classes of the patterns and subscriptions that match it.
+ * All channels are in class 0 by default.
+ *
+ * Only the udpm and mpudpm providers with read threads reorder messages.  The
+ * other providers, and udpm with recv_threads=0, dispatch messages in the
+ * order they arrive.
+ *
+ * @param lcm the LCM object
+ * @param channel the channel name pattern, a regular expression like the one
+ *        of lcm_subscribe().  Setting a class for the same pattern again
+ *        replaces the previous one.
+ * @param priority the priority class, from 0 to #LCM_MAX_PRIORITY.  0 removes
+ *        the class set for the pattern.
+ *
+ * @return 0 on success, -1 if the pattern or priority is invalid
+ */
+LCM_EXPORT
+int lcm_set_channel_priority(lcm_t *lcm, const char *channel, int priority);
+
 /**
  * @brief Publish a message, specified as a raw byte buffer.
  *
@@ -289,6 +975,230 @@ int lcm_unsubscribe(lcm_t *lcm, lcm_subscription_t *handler);
 LCM_EXPORT
 int lcm_publish(lcm_t *lcm, const char *channel, const void *data, unsigned int datalen);
 
+/**
+ * @brief A piece of a message published by lcm_publishv().
+ */
+typedef struct _lcm_iovec_t {
+    /** Start of the piece */
+    const void *data;
+    /** Size of the piece in bytes */
+    unsigned int len;
+} lcm_iovec_t;
+
+/**
+ * @brief Publish a message that is made up of several buffers.
+ *
+ * This is the same as lcm_publish() with the pieces concatenated, such as a
+ * header followed by a large buffer of existing data, but saves copying them
+ * into one buffer first.  The udpm://, mpudpm:// and tcpq:// providers send
+ * the pieces as they are, and the memq:// and shm:// providers copy them
+ * straight into the memory that they publish from.  A udpm:// message that is
+ * bundled, compressed, delta encoded or retransmitted, and one of more than
+ * 16 pieces, is still copied into a single buffer.
+ *
+ * @param lcm      The %LCM object
+ * @param channel  The channel to publish on
+ * @param iov      The pieces of the message, in order
+ * @param iovcnt   The number of pieces
+ *
+ * @return 0 on success, -1 on failure.
+ */
+LCM_EXPORT
+int lcm_publishv(lcm_t *lcm, const char *channel, const lcm_iovec_t *iov, int iovcnt);
+
+/**
+ * @brief A message published by lcm_publish_batch().
+ */
+typedef struct _lcm_publish_msg_t {
+    /** The channel to publish on */
+    const char *channel;
+    /** The raw byte buffer */
+    const void *data;
+    /** Size of the byte buffer */
+    unsigned int datalen;
+} lcm_publish_msg_t;
+
+/**
+ * @brief Publish several messages, in order.
+ *
+ * This is the same as calling lcm_publish() for each message, but the udpm://
+ * and mpudpm:// providers send runs of messages that fit into a datagram each
+ * with a single @c sendmmsg() call, where it's available.  Messages that are
+ * bundled or fragmented are sent one at a time as usual.  The tcpq:// provider
+ * frames up to 64 messages at a time into a single send, and the memq://
+ * provider queues them all at once, with a single notification of
+ * lcm_handle().
+ *
+ * @param lcm       The %LCM object
+ * @param msgs      The messages
+ * @param num_msgs  The number of messages
+ *
+ * @return 0 on success, -1 if any of the messages failed to be published.
+ */
+LCM_EXPORT
+int lcm_publish_batch(lcm_t *lcm, const lcm_publish_msg_t *msgs, int num_msgs);
+
+/**
+ * @brief Reserve a buffer to encode a message into, and publish it from.
+ *
+ * The memq, shm and tcpq providers lend a buffer of their own, so that the
+ * message is encoded straight into the memory it is sent from, without being
+ * copied.  The other providers copy it as lcm_publish() does.  Encode the
+ * message into the buffer, then publish it with lcm_publish_commit(), or give
+ * the buffer back with lcm_publish_cancel().  One of them has to be called for
+ * every reservation, from the thread that made it.
+ *
+ * A reservation may hold a lock that other publishers on the instance wait
+ * for, so commit it right after encoding, and don't publish anything else from
+ * the same thread in between.
+ *
+ * @param lcm      The %LCM object
+ * @param channel  The channel to publish on
+ * @param maxlen   The number of bytes to reserve, such as the encoded size of
+ *                 the message
+ *
+ * @return a buffer of at least @p maxlen bytes, or NULL on failure.
+ */
+LCM_EXPORT
+void *lcm_publish_reserve(lcm_t *lcm, const char *channel, unsigned int maxlen);
+
+/**
+ * @brief Publish a message encoded into a buffer from lcm_publish_reserve().
+ *
+ * @param lcm      The %LCM object
+ * @param buf      The buffer returned by lcm_publish_reserve(), which is
+ *                 released even if publishing fails
+ * @param datalen  Size of the message, at most the number of bytes reserved
+ *
+ * @return 0 on success, -1 on failure.
+ */
+LCM_EXPORT
+int lcm_publish_commit(lcm_t *lcm, void *buf, unsigned int datalen);
+
+/**
+ * @brief Release a buffer from lcm_publish_reserve() without publishing it.
+ *
+ * @param lcm  The %LCM object
+ * @param buf  The buffer returned by lcm_publish_reserve()
+ */
+LCM_EXPORT
+void lcm_publish_cancel(lcm_t *lcm, void *buf);
+
+/**
+ * @brief Create a handle for publishing messages on one channel.
+ *
+ * The provider looks up what it needs to publish on the channel once, instead
+ * of for every message as lcm_publish() does: udpm:// checks the length of the
+ * channel name and matches it against the compress and retransmit options,
+ * mpudpm:// finds the port of the channel, and memq:// keeps track of whether
+ * the channel has subscribers, without looking it up again until the
+ * subscriptions change, as does udpm:// with the interest option.  The other
+ * providers publish as lcm_publish() does.
+ *
+ * A publisher is used by one thread at a time, and has to be destroyed with
+ * lcm_publisher_destroy() before @p lcm is.
+ *
+ * @param lcm      The %LCM object
+ * @param channel  The channel to publish on, which is copied
+ *
+ * @return a new publisher, or NULL if @p channel can't be published on.
+ */
+LCM_EXPORT
+lcm_publisher_t *lcm_publisher_create(lcm_t *lcm, const char *channel);
+
+/**
+ * @brief Publish a message with a publisher from lcm_publisher_create().
+ *
+ * The same as lcm_publish() on the channel of the publisher.
+ *
+ * @param publisher  The publisher
+ * @param data       The raw byte buffer
+ * @param datalen    Size of the byte buffer
+ *
+ * @return 0 on success, -1 on failure.
+ */
+LCM_EXPORT
+int lcm_publisher_publish(lcm_publisher_t *publisher, const void *data, unsigned int datalen);
+
+/**
+ * @brief Destroy a publisher from lcm_publisher_create().
+ *
+ * @param publisher  The publisher
+ */
+LCM_EXPORT
+void lcm_publisher_destroy(lcm_publisher_t *publisher);
+
+/**
+ * @brief Whether anybody may subscribe to the channel of a publisher.
+ *
+ * memq:// knows the subscriptions of its instance, and udpm:// those of the
+ * processes on its group with the interest option.  lcm_publisher_publish()
+ * drops the messages of channels that nobody subscribes to, and this lets
+ * the caller skip preparing them too.  It is cheap enough to call for every
+ * message.
+ *
+ * @param publisher  The publisher
+ *
+ * @return 0 if nobody subscribes to the channel, 1 if somebody may.
+ */
+LCM_EXPORT
+int lcm_publisher_has_subscribers(lcm_publisher_t *publisher);
+
+/**
+ * @brief Callback function prototype for lcm_publish_async_buffer().
+ *
+ * @param data the buffer passed to lcm_publish_async_buffer()
+ * @param user_data the user_data parameter passed to
+ *        lcm_publish_async_buffer()
+ */
+typedef void (*lcm_buffer_release_t)(void *data, void *user_data);
+
+/**
+ * @brief Publish a message without waiting for it to be transmitted.
+ *
+ * The message is copied to the send queue of the %LCM instance, and a separate
+ * thread transmits it.  Only the udpm:// provider has a send queue, which is
+ * enabled with its @c send_queue option.  For other providers, or without
+ * a send queue, this is the same as lcm_publish().  The memq:// provider
+ * dispatches the buffer of lcm_publish_async_buffer() without copying it.
+ *
+ * Messages published with this function are transmitted in order, but may be
+ * transmitted after messages that are published later with lcm_publish().
+ * Queued messages are transmitted before lcm_destroy() returns.
+ *
+ * @param lcm      The %LCM object
+ * @param channel  The channel to publish on
+ * @param data     The raw byte buffer
+ * @param datalen  Size of the byte buffer
+ *
+ * @return 0 on success, -1 on failure, or if the message was dropped because
+ *         the send queue was full.
+ */
+LCM_EXPORT
+int lcm_publish_async(lcm_t *lcm, const char *channel, const void *data, unsigned int datalen);
+
+/**
+ * @brief Publish a message without waiting for it to be transmitted or copied.
+ *
+ * Like lcm_publish_async(), but the send queue takes ownership of data
+ * instead of copying it.  Once data has been transmitted or dropped, @p
+ * release is called with it from an unspecified thread, possibly before this
+ * function returns.
+ *
+ * @param lcm        The %LCM object
+ * @param channel    The channel to publish on
+ * @param data       The raw byte buffer
+ * @param datalen    Size of the byte buffer
+ * @param release    Called to free data once it is no longer needed, or NULL
+ * @param user_data  Passed to release
+ *
+ * @return 0 on success, -1 on failure, or if the message was dropped because
+ *         the send queue was full.
+ */
+LCM_EXPORT
+int lcm_publish_async_buffer(lcm_t *lcm, const char *channel, void *data, unsigned int datalen,
+                             lcm_buffer_release_t release, void *user_data);
+
 /**
  * @brief Wait for and dispatch the next incoming message.
  *
@@ -319,7 +1229,9 @@ int lcm_handle(lcm_t *lcm);
  *
  * This function largely exists for convenience, and its behavior can be
  * replicated by using lcm_fileno() and lcm_handle() in conjunction with
- * select() or poll().
+ * select() or poll().  It dispatches one message per call; use
+ * lcm_handle_batch() or lcm_try_handle() to dispatch several for the price of
+ * one wait.
  *
  * New in LCM 1.1.0.
  *
@@ -334,6 +1246,56 @@ int lcm_handle(lcm_t *lcm);
 LCM_EXPORT
 int lcm_handle_timeout(lcm_t *lcm, int timeout_millis);
 
+/**
+ * @brief Wait for incoming messages, and dispatch as many of them as are
+ * available, up to a limit.
+ *
+ * This function waits like lcm_handle_timeout() for at least one message to
+ * arrive, and then dispatches it along with any other messages that have
+ * already been received, up to @p max_msgs in total.  It does not wait for
+ * more messages once the first one has been dispatched.  Draining several
+ * messages in one call is cheaper than calling lcm_handle() once per message,
+ * since the internal queue and notification descriptor are only consulted once
+ * for the whole batch.
+ *
+ * Message handlers are invoked as in lcm_handle(), and the same restrictions
+ * on recursive calls apply.
+ *
+ * @param lcm the %LCM object
+ * @param max_msgs the maximum number of messages to dispatch.  Must be > 0.
+ * @param timeout_millis the maximum amount of time to wait for the first
+ *        message, in milliseconds.  If 0, then dispatches any available
+ *        messages and then returns immediately.  If less than 0, then waits
+ *        indefinitely.
+ *
+ * @return the number of messages dispatched, 0 if the function timed out, and
+ * <0 if an error occured.
+ */
+LCM_EXPORT
+int lcm_handle_batch(lcm_t *lcm, int max_msgs, int timeout_millis);
+
+/**
+ * @brief Dispatches up to @p max_msgs of the messages that have already been
+ * received, without blocking.
+ *
+ * This lets an external event loop, such as epoll, io_uring, libuv or asio,
+ * drive LCM without a dedicated thread: watch lcm_get_fileno() for
+ * readability, and call this function when it is readable.  It is the same as
+ * lcm_handle_batch() with a timeout of 0.  Any number of messages costs one
+ * check of the descriptor.
+ *
+ * Message handlers are invoked as in lcm_handle(), and the same restrictions
+ * on recursive calls apply.
+ *
+ * @param lcm the %LCM object
+ * @param max_msgs the maximum number of messages to dispatch.  Must be > 0.
+ *
+ * @return the number of messages dispatched, 0 if none were ready, and <0 if
+ * an error occured.
+ */
+LCM_EXPORT
+int lcm_try_handle(lcm_t *lcm, int max_msgs);
+
 /**
  * @brief Adjusts the maximum number of received messages that can be queued up
  * for a subscription.
@@ -355,12 +1317,456 @@ int lcm_handle_timeout(lcm_t *lcm, int timeout_millis);
 LCM_EXPORT
 int lcm_subscription_set_queue_capacity(lcm_subscription_t *handler, int num_messages);
 
+/**
+ * @brief Chooses what a subscription does with a received message when its
+ * queue is full.
+ *
+ * With #LCM_DROP_OLDEST, the subscription queues every message, and the ones
+ * that more than the queue capacity of newer messages arrived after are
+ * dropped when they are dispatched, so that its handler gets the newest
+ * messages.  lcm_subscription_get_queue_size() can then exceed the capacity
+ * for a while.
+ *
+ * With #LCM_BLOCK, the receive thread of the provider stops for up to 100 ms
+ * until the queue has room, and then drops the message.  That delays the
+ * messages of all of the other channels as well, and the provider may lose
+ * packets instead while it waits, so it suits a subscriber such as a logger
+ * that is rarely slow.  Providers that only read messages in lcm_handle(),
+ * such as memq, don't block.
+ *
+ * @param handler the subscription object
+ * @param policy the policy.  The default is #LCM_DROP_NEWEST.
+ *
+ * @return 0 on success, -1 if policy is invalid
+ */
+LCM_EXPORT
+int lcm_subscription_set_drop_policy(lcm_subscription_t *handler, lcm_drop_policy_t policy);
+
+/**
+ * @brief Makes a subscription keep only the latest of its received messages.
+ *
+ * A conflating subscription never drops a message because its queue is full.
+ * Instead, its handler is called only for the newest message that it has
+ * received, and the older messages that are still waiting for the handler are
+ * dropped and counted by lcm_subscription_get_drop_count().  This suits
+ * subscribers that only care about the current state, such as the latest pose
+ * or the latest sensor reading, and would otherwise fall behind.  The queue
+ * capacity of the subscription is ignored while it conflates.
+ *
+ * @param handler the subscription object
+ * @param conflate nonzero to only keep the latest message, 0 to queue every
+ *        message again.  Subscriptions don't conflate by default.
+ *
+ * @return 0 on success
+ */
+LCM_EXPORT
+int lcm_subscription_set_conflate(lcm_subscription_t *handler, int conflate);
+
+/**
+ * @brief Limits how often the handler of a subscription is called.
+ *
+ * Once the subscription has taken a message, it skips the messages that are
+ * received in the next 1/@p hz seconds.  A 10 Hz limit on a 200 Hz channel
+ * passes every 20th message or so.  The skipped messages are left out before
+ * they are queued, so they don't take room in the queue of the subscription,
+ * wake up lcm_handle(), or get decoded by the C++ API.  They don't count as
+ * dropped either.
+ *
+ * @param handler the subscription object
+ * @param hz the highest average rate of messages, or 0 for no limit.  There
+ *        is no limit by default.
+ *
+ * @return 0 on success, -1 if hz is negative
+ */
+LCM_EXPORT
+int lcm_subscription_set_max_rate(lcm_subscription_t *handler, double hz);
+
+/**
+ * @brief Puts the channels that a subscription matches in a priority class.
+ *
+ * See lcm_set_channel_priority().
+ *
+ * @param handler the subscription object
+ * @param priority the lowest priority class of the channels of the
+ *        subscription, from 0 to #LCM_MAX_PRIORITY.  The default is 0.
+ *
+ * @return 0 on success, -1 if priority is invalid
+ */
+LCM_EXPORT
+int lcm_subscription_set_priority(lcm_subscription_t *handler, int priority);
+
 /**
  * @brief Query the current number of unhandled messages queued up for a subscription.
+ *
+ * For a subscription with an executor, this includes the messages that are
+ * waiting for the dispatcher.
  */
 LCM_EXPORT
 int lcm_subscription_get_queue_size(lcm_subscription_t *handler);
 
+/**
+ * @brief Query the number of received messages that were dropped for a
+ * subscription because its queue was full, or because a newer message replaced
+ * them on a conflating subscription.
+ */
+LCM_EXPORT
+uint64_t lcm_subscription_get_drop_count(lcm_subscription_t *handler);
+
+/**
+ * @brief Query the number of received messages that a subscription dropped
+ * under one drop policy.
+ *
+ * The counts of all of the policies add up to
+ * lcm_subscription_get_drop_count().  The messages replaced on a conflating
+ * subscription count as dropped by #LCM_DROP_OLDEST.
+ *
+ * @param handler the subscription object
+ * @param policy the policy that dropped them
+ */
+LCM_EXPORT
+uint64_t lcm_subscription_get_policy_drop_count(lcm_subscription_t *handler,
+                                                lcm_drop_policy_t policy);
+
+/**
+ * @brief Creates a pool of threads to run message handlers on.
+ *
+ * @param num_threads the number of threads, at least 1
+ *
+ * @return the new dispatcher, or NULL if num_threads is invalid
+ */
+LCM_EXPORT
+lcm_dispatcher_t *lcm_dispatcher_create(int num_threads);
+
+/**
+ * @brief Stops and destroys a dispatcher.
+ *
+ * This waits for the messages that are queued on the dispatcher to be
+ * handled.  Unsubscribe the subscriptions that use the dispatcher, or
+ * destroy their lcm_t, first.
+ */
+LCM_EXPORT
+void lcm_dispatcher_destroy(lcm_dispatcher_t *dispatcher);
+
+/**
+ * @brief Function prototype for lcm_dispatcher_run().
+ */
+typedef void (*lcm_dispatcher_func_t)(void *user_data);
+
+/**
+ * @brief Calls a function once on one of the threads of a dispatcher.
+ *
+ * The function is queued behind the handlers that are already waiting, and
+ * runs in parallel with the others.  This is how the C++ API decodes messages
+ * ahead of their handlers.
+ *
+ * @param dispatcher the dispatcher
+ * @param func the function to call
+ * @param user_data passed to @p func
+ *
+ * @return 0 on success, -1 if the dispatcher is stopping
+ */
+LCM_EXPORT
+int lcm_dispatcher_run(lcm_dispatcher_t *dispatcher, lcm_dispatcher_func_t func,
+                       void *user_data);
+
+/**
+ * @brief Runs the handler of a subscription on a dispatcher, instead of in
+ * lcm_handle().
+ *
+ * lcm_handle() then copies the messages for the subscription and returns
+ * without waiting for the handler.  The subscription is a serial executor:
+ * its handler gets its messages in order, and is never called for two
+ * messages at once.  The handlers of different subscriptions run in parallel
+ * on the threads of the dispatcher, so a slow handler doesn't delay the
+ * others.  Messages count against the queue capacity of the subscription
+ * until their handler returns.
+ *
+ * The handler must not use the lcm field of the lcm_recv_buf_t after the
+ * lcm_t is destroyed.  lcm_unsubscribe() drops the messages that are still
+ * waiting, and waits for a call of the handler that is running, unless it
+ * is called from that handler.
+ *
+ * @param handler the subscription
+ * @param dispatcher the dispatcher to run the handler on, or NULL to go back
+ *        to running it in lcm_handle().  Messages that are already waiting
+ *        for the previous dispatcher are still handled there first.
+ *
+ * @return 0 on success
+ */
+LCM_EXPORT
+int lcm_subscription_set_executor(lcm_subscription_t *handler, lcm_dispatcher_t *dispatcher);
+
+/**
+ * @brief Creates a dispatch context.
+ *
+ * A dispatch context lets several threads handle the messages of one lcm_t
+ * at the same time, without opening the network once per thread.  Each
+ * thread handles a context of its own, which has its own queue of messages
+ * and its own file descriptor, and only runs the handlers of the
+ * subscriptions that are bound to it.  Contexts can be shared by several
+ * lcm_t.
+ *
+ * @return the new context, or NULL on error
+ */
+LCM_EXPORT
+lcm_dispatch_context_t *lcm_dispatch_context_create(void);
+
+/**
+ * @brief Destroys a dispatch context.
+ *
+ * Unsubscribe the subscriptions that use the context, or destroy their
+ * lcm_t, first.
+ */
+LCM_EXPORT
+void lcm_dispatch_context_destroy(lcm_dispatch_context_t *context);
+
+/**
+ * @brief Returns a file descriptor that is readable while messages are
+ * waiting on the context.
+ *
+ * Use it with select() or poll(), like lcm_get_fileno(), and call
+ * lcm_dispatch_context_handle() once it is readable.
+ */
+LCM_EXPORT
+int lcm_dispatch_context_get_fileno(lcm_dispatch_context_t *context);
+
+/**
+ * @brief Waits for messages on the context, and handles them.
+ *
+ * This calls the handler of one of the subscriptions bound to the context,
+ * for the messages that are waiting for it.  Different contexts may be
+ * handled by different threads at the same time, and at the same time as
+ * lcm_handle().
+ *
+ * @return 0 on success
+ */
+LCM_EXPORT
+int lcm_dispatch_context_handle(lcm_dispatch_context_t *context);
+
+/**
+ * @brief Like lcm_dispatch_context_handle(), but gives up after a timeout.
+ *
+ * @param context the context
+ * @param timeout_millis how long to wait for messages, in milliseconds
+ *
+ * @return >0 if messages were handled, 0 on timeout, and <0 if
+ *         @p timeout_millis is negative
+ */
+LCM_EXPORT
+int lcm_dispatch_context_handle_timeout(lcm_dispatch_context_t *context, int timeout_millis);
+
+/**
+ * @brief Binds a subscription to a dispatch context.
+ *
+ * lcm_handle() then copies the messages for the subscription to the
+ * context, and returns without calling the handler, which runs in
+ * lcm_dispatch_context_handle() instead.  The read threads and sockets of the
+ * lcm_t are shared by all of its contexts, and lcm_handle() still has to be
+ * called to take the messages from them.  The handler gets its messages in
+ * order, with the same rules as for lcm_subscription_set_executor(), whose
+ * dispatcher this replaces.
+ *
+ * @param handler the subscription
+ * @param context the context to handle the messages on, or NULL to go back
+ *        to handling them in lcm_handle().  Messages that are already waiting
+ *        on the previous context are still handled there first.
+ *
+ * @return 0 on success
+ */
+LCM_EXPORT
+int lcm_subscription_set_dispatch_context(lcm_subscription_t *handler,
+                                          lcm_dispatch_context_t *context);
+
+/**
+ * @brief Counters of the messages and packets received by an lcm_t, filled
+ * in by lcm_get_stats().
+ *
+ * All of them count from the creation of the lcm_t.  The udpm:// and
+ * mpudpm:// providers keep all of them, and other providers only keep
+ * queue_drops and channels_evicted.  The rest stay 0 for those.
+ */
+typedef struct _lcm_stats_t {
+    /** Datagrams read from the network, including bad ones */
+    uint64_t packets_received;
+    /** Bytes in those datagrams, not counting IP and UDP headers */
+    uint64_t bytes_received;
+    /** Datagrams discarded because they were malformed or could not be read */
+    uint64_t packets_bad;
+    /** Partly received messages evicted to make room for newer ones */
+    uint64_t frag_bufs_evicted;
+    /** Partly received messages abandoned because their sender moved on to
+     * the next message, which means that some of their fragments were lost */
+    uint64_t messages_incomplete;
+    /** Datagrams dropped by the kernel because the receive buffer of the
+     * socket was full.  Linux only */
+    uint64_t kernel_drops;
+    /** Received messages that no subscription had room for in its queue */
+    uint64_t queue_drops;
+    /** The most bytes that were held in a receive ring buffer at once */
+    uint64_t ringbuf_high_water;
+    /** Size in bytes of the largest receive ring buffer */
+    uint64_t ringbuf_capacity;
+    /** Multicast self tests that failed in the background, with the udpm://
+     * option self_test=async */
+    uint64_t self_test_failures;
+    /** Channel names whose matching subscriptions were forgotten because
+     * too many different channel names were received.  They are matched
+     * against the subscriptions again when they are received next */
+    uint64_t channels_evicted;
+    /** Lost fragments that were rebuilt from parity packets, with the
+     * udpm:// option fec */
+    uint64_t fragments_recovered;
+    /** Lost fragments that were requested again from their publishers with
+     * NACKs, with the udpm:// option retransmit */
+    uint64_t fragments_requested;
+    /** Sequence numbers that senders skipped between two of their datagrams
+     * that arrived, which are messages, or bundle packets, that were lost or
+     * had not arrived yet.  Counted per sender */
+    uint64_t seqno_gaps;
+    /** Datagrams that arrived again with the same sequence number, not
+     * counting the further fragments and parity packets of a message */
+    uint64_t seqno_duplicates;
+    /** Datagrams that arrived after one with a later sequence number from the
+     * same sender.  Each of these was also counted in seqno_gaps when it was
+     * skipped */
+    uint64_t seqno_reorders;
+    /** Messages sent as deltas, with the udpm:// option delta, that were
+     * dropped because the message before them on their channel was not
+     * received */
+    uint64_t deltas_dropped;
+    /** Size in bytes of the kernel receive buffer of the socket, as the
+     * kernel reports it, which grows with the udpm:// option recv_buf_max */
+    uint64_t recv_buf_size;
+} lcm_stats_t;
+
+/**
+ * @brief Reads the statistics of an lcm_t.
+ *
+ * This is cheap, and can be called from any thread at any time, including
+ * from within message handlers.
+ *
+ * @param lcm the %LCM object
+ * @param stats filled in with the current counters
+ *
+ * @return 0 on success, -1 on failure
+ */
+LCM_EXPORT
+int lcm_get_stats(lcm_t *lcm, lcm_stats_t *stats);
+
+/**
+ * @brief Timings of the calls to the handler of a subscription, filled in by
+ * lcm_subscription_get_handler_stats().
+ *
+ * They are only kept while lcm_set_handler_stats() has enabled them.  All
+ * times are in microseconds.
+ */
+typedef struct _lcm_handler_stats_t {
+    /** Calls to the handler */
+    uint64_t num_calls;
+    /** Time spent in the handler, in total and in the longest call */
+    uint64_t total_usec;
+    uint64_t max_usec;
+    /** Time from the recv_mono_ns of the messages to calling the handler.
+     * For a log file, this is the time from reading the event */
+    uint64_t total_queue_delay_usec;
+    uint64_t max_queue_delay_usec;
+    /** histogram[0] counts the calls that took less than 1 microsecond, and
+     * histogram[i] the ones that took less than 2^i microseconds but at
+     * least 2^(i-1).  The last bucket also counts the longer calls */
+    uint64_t histogram[LCM_HANDLER_STATS_BUCKETS];
+} lcm_handler_stats_t;
+
+/**
+ * @brief Enables or disables keeping the lcm_handler_stats_t of all the
+ * subscriptions of an lcm_t.
+ *
+ * They are disabled by default.  While they are, dispatching a message costs
+ * one more check of a flag.  While they are enabled, each call to a handler
+ * also reads the clock three times.  Disabling them keeps the timings
+ * collected so far.
+ *
+ * @param lcm the %LCM object
+ * @param enable 1 to keep timings, 0 to stop keeping them
+ *
+ * @return 0 on success
+ */
+LCM_EXPORT
+int lcm_set_handler_stats(lcm_t *lcm, int enable);
+
+/**
+ * @brief Reads the timings of the calls to the handler of a subscription.
+ *
+ * This can be called from any thread at any time, including from within
+ * message handlers.
+ *
+ * @param handler the subscription
+ * @param stats filled in with the timings collected so far
+ *
+ * @return 0 on success
+ */
+LCM_EXPORT
+int lcm_subscription_get_handler_stats(lcm_subscription_t *handler, lcm_handler_stats_t *stats);
+
+/**
+ * @brief Publishes the timings of the handlers of all the subscriptions of an
+ * lcm_t, so that tools can watch them.
+ *
+ * The message is a handler_stats_report_t, which is defined in
+ * lcm/lcmtypes/handler_stats.lcm of the %LCM sources.  It has an entry for
+ * every subscription, in the order in which they were subscribed, with its
+ * timings and the messages it dropped.  It also carries the counters of
+ * lcm_get_stats(), and names the process by its host name and process ID.
+ * Call this periodically, for example every second, to watch the handlers of
+ * a running program with lcm-top.
+ *
+ * @param lcm the %LCM object
+ * @param channel the channel to publish on, or NULL for #LCM_STATS_CHANNEL
+ *
+ * @return 0 on success, -1 on failure
+ */
+LCM_EXPORT
+int lcm_publish_handler_stats(lcm_t *lcm, const char *channel);
+
+/**
+ * @brief Callback function prototype for lcm_set_thread_start_handler().
+ *
+ * @param name identifies the thread: "lcm-udpm-recv", "lcm-udpm-send",
+ *        "lcm-udpm-bundle", "lcm-udpm-test", "lcm-mpudpm-recv", "lcm-file-timer",
+ *        "lcm-file-prefetch", "lcm-file-write", "lcm-shm-wait", "lcm-tcpq-batch" or
+ *        "lcm-dispatch"
+ * @param user_data the user-specified parameter passed to
+ *        lcm_set_thread_start_handler()
+ */
+typedef void (*lcm_thread_start_handler_t)(const char *name, void *user_data);
+
+/**
+ * @brief Sets a function to be called at the start of each thread that %LCM
+ * creates internally.
+ *
+ * The handler runs on the new thread, before it does any work, so it can set
+ * the thread's CPU affinity, scheduling policy, or name.  It applies to every
+ * thread created afterwards by any lcm_t in the process, including threads
+ * started by lcm_create().  This is more flexible than the recv_cpu and
+ * recv_prio options of the providers, which are applied before the handler is
+ * called.
+ *
+ * @param handler the function to call, or NULL to stop calling one
+ * @param user_data passed to the handler
+ */
+LCM_EXPORT
+void lcm_set_thread_start_handler(lcm_thread_start_handler_t handler, void *user_data);
+
+/**
+ * @brief Reads the clock of lcm_recv_buf_t::recv_mono_ns.
+ *
+ * This is CLOCK_MONOTONIC on POSIX systems, which Linux reads without a
+ * system call, and the clock of g_get_monotonic_time() elsewhere.
+ *
+ * @return the current time, in nanoseconds
+ */
+LCM_EXPORT
+int64_t lcm_monotonic_ns(void);
+
 /**
  * @}
  */
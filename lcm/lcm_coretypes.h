@@ -6,6 +6,25 @@
 #include <stdlib.h>
 #include <string.h>
 
+// The host byte order, so that arrays can be converted to and from the
+// big-endian encoding in bulk.  When it isn't known, they are converted one
+// byte at a time.
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__) && \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define __LCM_LITTLE_ENDIAN 1
+#elif defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && \
+    __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define __LCM_BIG_ENDIAN 1
+#elif defined(_MSC_VER)
+#define __LCM_LITTLE_ENDIAN 1
+#endif
+
+#if defined(__LCM_LITTLE_ENDIAN) && (defined(__AVX2__) || defined(__SSSE3__))
+#include <immintrin.h>
+#elif defined(__LCM_LITTLE_ENDIAN) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #ifdef __cplusplus
 
 // Suppress warnings about C-style casts, since this code needs to build in
@@ -37,6 +56,137 @@ struct ___lcm_hash_ptr {
     int64_t (*v)(void);
 };
 
+/**
+ * BYTE ORDER
+ */
+#if defined(__LCM_LITTLE_ENDIAN) || defined(__LCM_BIG_ENDIAN)
+#define __LCM_BULK_BYTE_ORDER 1
+
+#if defined(__LCM_BIG_ENDIAN)
+// the encoding is the host order, so the arrays are copied as they are
+static inline void __lcm_copy_bytes(void *dst, const void *src, int size)
+{
+    if (size > 0)
+        memcpy(dst, src, size);
+}
+#define __lcm_copy_swap16(dst, src, elements) __lcm_copy_bytes(dst, src, (elements) * 2)
+#define __lcm_copy_swap32(dst, src, elements) __lcm_copy_bytes(dst, src, (elements) * 4)
+#define __lcm_copy_swap64(dst, src, elements) __lcm_copy_bytes(dst, src, (elements) * 8)
+#else
+#if defined(_MSC_VER)
+#define __lcm_bswap16(v) _byteswap_ushort(v)
+#define __lcm_bswap32(v) _byteswap_ulong(v)
+#define __lcm_bswap64(v) _byteswap_uint64(v)
+#else
+#define __lcm_bswap16(v) __builtin_bswap16(v)
+#define __lcm_bswap32(v) __builtin_bswap32(v)
+#define __lcm_bswap64(v) __builtin_bswap64(v)
+#endif
+
+// Copies elements values of 2, 4 or 8 bytes from src to dst, reversing the
+// bytes of each.  This converts between the host order and the encoding in
+// both directions.  The buffers can have any alignment, and must not overlap.
+static inline void __lcm_copy_swap16(void *_dst, const void *_src, int elements)
+{
+    uint8_t *dst = (uint8_t *) _dst;
+    const uint8_t *src = (const uint8_t *) _src;
+    int element = 0;
+#if defined(__AVX2__)
+    const __m256i shuffle256 =
+        _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14, 1, 0, 3, 2, 5, 4,
+                         7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    for (; element + 16 <= elements; element += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (src + element * 2));
+        _mm256_storeu_si256((__m256i *) (dst + element * 2), _mm256_shuffle_epi8(v, shuffle256));
+    }
+#endif
+#if defined(__SSSE3__)
+    const __m128i shuffle =
+        _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    for (; element + 8 <= elements; element += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + element * 2));
+        _mm_storeu_si128((__m128i *) (dst + element * 2), _mm_shuffle_epi8(v, shuffle));
+    }
+#elif defined(__ARM_NEON)
+    for (; element + 8 <= elements; element += 8)
+        vst1q_u8(dst + element * 2, vrev16q_u8(vld1q_u8(src + element * 2)));
+#endif
+    for (; element < elements; element++) {
+        uint16_t v;
+        memcpy(&v, src + element * 2, 2);
+        v = __lcm_bswap16(v);
+        memcpy(dst + element * 2, &v, 2);
+    }
+}
+
+static inline void __lcm_copy_swap32(void *_dst, const void *_src, int elements)
+{
+    uint8_t *dst = (uint8_t *) _dst;
+    const uint8_t *src = (const uint8_t *) _src;
+    int element = 0;
+#if defined(__AVX2__)
+    const __m256i shuffle256 =
+        _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6,
+                         5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    for (; element + 8 <= elements; element += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (src + element * 4));
+        _mm256_storeu_si256((__m256i *) (dst + element * 4), _mm256_shuffle_epi8(v, shuffle256));
+    }
+#endif
+#if defined(__SSSE3__)
+    const __m128i shuffle =
+        _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    for (; element + 4 <= elements; element += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + element * 4));
+        _mm_storeu_si128((__m128i *) (dst + element * 4), _mm_shuffle_epi8(v, shuffle));
+    }
+#elif defined(__ARM_NEON)
+    for (; element + 4 <= elements; element += 4)
+        vst1q_u8(dst + element * 4, vrev32q_u8(vld1q_u8(src + element * 4)));
+#endif
+    for (; element < elements; element++) {
+        uint32_t v;
+        memcpy(&v, src + element * 4, 4);
+        v = __lcm_bswap32(v);
+        memcpy(dst + element * 4, &v, 4);
+    }
+}
+
+static inline void __lcm_copy_swap64(void *_dst, const void *_src, int elements)
+{
+    uint8_t *dst = (uint8_t *) _dst;
+    const uint8_t *src = (const uint8_t *) _src;
+    int element = 0;
+#if defined(__AVX2__)
+    const __m256i shuffle256 =
+        _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2,
+                         1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    for (; element + 4 <= elements; element += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (src + element * 8));
+        _mm256_storeu_si256((__m256i *) (dst + element * 8), _mm256_shuffle_epi8(v, shuffle256));
+    }
+#endif
+#if defined(__SSSE3__)
+    const __m128i shuffle =
+        _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    for (; element + 2 <= elements; element += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + element * 8));
+        _mm_storeu_si128((__m128i *) (dst + element * 8), _mm_shuffle_epi8(v, shuffle));
+    }
+#elif defined(__ARM_NEON)
+    for (; element + 2 <= elements; element += 2)
+        vst1q_u8(dst + element * 8, vrev64q_u8(vld1q_u8(src + element * 8)));
+#endif
+    for (; element < elements; element++) {
+        uint64_t v;
+        memcpy(&v, src + element * 8, 8);
+        v = __lcm_bswap64(v);
+        memcpy(dst + element * 8, &v, 8);
+    }
+}
+#endif
+#endif
+
 /**
  * BOOLEAN
  */
@@ -158,11 +308,14 @@ static inline int __int16_t_encode_array(void *_buf, int offset, int maxlen, con
     int total_size = sizeof(int16_t) * elements;
     uint8_t *buf = (uint8_t *) _buf;
     int pos = offset;
-    int element;
 
     if (maxlen < total_size)
         return -1;
 
+#ifdef __LCM_BULK_BYTE_ORDER
+    __lcm_copy_swap16(buf + pos, p, elements);
+#else
+    int element;
     //  See Section 5.8 paragraph 3 of the standard
     //  http://open-std.org/JTC1/SC22/WG21/docs/papers/2015/n4527.pdf
     //  use uint for shifting instead if int
@@ -172,6 +325,7 @@ static inline int __int16_t_encode_array(void *_buf, int offset, int maxlen, con
         buf[pos++] = (v >> 8) & 0xff;
         buf[pos++] = (v & 0xff);
     }
+#endif
 
     return total_size;
 }
@@ -182,15 +336,19 @@ static inline int __int16_t_decode_array(const void *_buf, int offset, int maxle
     int total_size = sizeof(int16_t) * elements;
     const uint8_t *buf = (const uint8_t *) _buf;
     int pos = offset;
-    int element;
 
     if (maxlen < total_size)
         return -1;
 
+#ifdef __LCM_BULK_BYTE_ORDER
+    __lcm_copy_swap16(p, buf + pos, elements);
+#else
+    int element;
     for (element = 0; element < elements; element++) {
         p[element] = (buf[pos] << 8) + buf[pos + 1];
         pos += 2;
     }
+#endif
 
     return total_size;
 }
@@ -222,11 +380,14 @@ static inline int __int32_t_encode_array(void *_buf, int offset, int maxlen, con
     int total_size = sizeof(int32_t) * elements;
     uint8_t *buf = (uint8_t *) _buf;
     int pos = offset;
-    int element;
 
     if (maxlen < total_size)
         return -1;
 
+#ifdef __LCM_BULK_BYTE_ORDER
+    __lcm_copy_swap32(buf + pos, p, elements);
+#else
+    int element;
     //  See Section 5.8 paragraph 3 of the standard
     //  http://open-std.org/JTC1/SC22/WG21/docs/papers/2015/n4527.pdf
     //  use uint for shifting instead if int
@@ -238,6 +399,7 @@ static inline int __int32_t_encode_array(void *_buf, int offset, int maxlen, con
         buf[pos++] = (v >> 8) & 0xff;
         buf[pos++] = (v & 0xff);
     }
+#endif
 
     return total_size;
 }
@@ -248,11 +410,14 @@ static inline int __int32_t_decode_array(const void *_buf, int offset, int maxle
     int total_size = sizeof(int32_t) * elements;
     const uint8_t *buf = (const uint8_t *) _buf;
     int pos = offset;
-    int element;
 
     if (maxlen < total_size)
         return -1;
 
+#ifdef __LCM_BULK_BYTE_ORDER
+    __lcm_copy_swap32(p, buf + pos, elements);
+#else
+    int element;
     //  See Section 5.8 paragraph 3 of the standard
     //  http://open-std.org/JTC1/SC22/WG21/docs/papers/2015/n4527.pdf
     //  use uint for shifting instead if int
@@ -261,6 +426,7 @@ static inline int __int32_t_decode_array(const void *_buf, int offset, int maxle
                      (((uint32_t) buf[pos + 2]) << 8) + ((uint32_t) buf[pos + 3]);
         pos += 4;
     }
+#endif
 
     return total_size;
 }
@@ -292,11 +458,14 @@ static inline int __int64_t_encode_array(void *_buf, int offset, int maxlen, con
     int total_size = sizeof(int64_t) * elements;
     uint8_t *buf = (uint8_t *) _buf;
     int pos = offset;
-    int element;
 
     if (maxlen < total_size)
         return -1;
 
+#ifdef __LCM_BULK_BYTE_ORDER
+    __lcm_copy_swap64(buf + pos, p, elements);
+#else
+    int element;
     //  See Section 5.8 paragraph 3 of the standard
     //  http://open-std.org/JTC1/SC22/WG21/docs/papers/2015/n4527.pdf
     //  use uint for shifting instead if int
@@ -312,6 +481,7 @@ static inline int __int64_t_encode_array(void *_buf, int offset, int maxlen, con
         buf[pos++] = (v >> 8) & 0xff;
         buf[pos++] = (v & 0xff);
     }
+#endif
 
     return total_size;
 }
@@ -322,11 +492,14 @@ static inline int __int64_t_decode_array(const void *_buf, int offset, int maxle
     int total_size = sizeof(int64_t) * elements;
     const uint8_t *buf = (const uint8_t *) _buf;
     int pos = offset;
-    int element;
 
     if (maxlen < total_size)
         return -1;
 
+#ifdef __LCM_BULK_BYTE_ORDER
+    __lcm_copy_swap64(p, buf + pos, elements);
+#else
+    int element;
     //  See Section 5.8 paragraph 3 of the standard
     //  http://open-std.org/JTC1/SC22/WG21/docs/papers/2015/n4527.pdf
     //  use uint for shifting instead if int
@@ -339,6 +512,7 @@ static inline int __int64_t_decode_array(const void *_buf, int offset, int maxle
         pos += 4;
         p[element] = (a << 32) + (b & 0xffffffff);
     }
+#endif
 
     return total_size;
 }
@@ -516,6 +690,165 @@ static inline void *lcm_malloc(size_t sz)
     return NULL;
 }
 
+/**
+ * A bump allocator to decode messages into with <TYPE>_decode_arena(), which
+ * allocates strings and variable-length arrays from one caller-supplied block
+ * instead of with a malloc() each.  Nothing allocated is freed individually:
+ * reset the arena, or free its memory, when done with the decoded messages.
+ */
+typedef struct _lcm_arena_t lcm_arena_t;
+struct _lcm_arena_t {
+    char *data;
+    size_t size;
+    size_t used;
+};
+
+/**
+ * Initializes an arena to allocate from the @p size bytes at @p data, which
+ * should be aligned like memory returned by malloc().
+ */
+static inline void lcm_arena_init(lcm_arena_t *arena, void *data, size_t size)
+{
+    arena->data = (char *) data;
+    arena->size = size;
+    arena->used = 0;
+}
+
+/**
+ * Releases everything allocated from an arena, to reuse its memory.
+ */
+static inline void lcm_arena_reset(lcm_arena_t *arena)
+{
+    arena->used = 0;
+}
+
+// Allocations are rounded up to keep the next one aligned for any member
+static inline size_t __lcm_arena_aligned_size(size_t sz)
+{
+    return (sz + 7) & ~(size_t) 7;
+}
+
+/**
+ * Allocates @p sz bytes from an arena.
+ *
+ * @return The allocated memory, or NULL if @p sz is 0 or the arena hasn't
+ * enough space left.
+ */
+static inline void *lcm_arena_alloc(lcm_arena_t *arena, size_t sz)
+{
+    if (!sz || sz > arena->size - arena->used)
+        return NULL;
+    sz = __lcm_arena_aligned_size(sz);
+    if (sz > arena->size - arena->used)
+        sz = arena->size - arena->used;
+
+    void *p = arena->data + arena->used;
+    arena->used += sz;
+    return p;
+}
+
+// Allocates an array of a decoded length, or returns NULL if it's empty or
+// the arena is exhausted.
+static inline void *__lcm_arena_alloc_array(lcm_arena_t *arena, size_t size, int64_t elements)
+{
+    if (elements <= 0 || (uint64_t) elements > ((size_t) -1 >> 1) / size)
+        return NULL;
+    return lcm_arena_alloc(arena, size * (size_t) elements);
+}
+
+// Adds the arena space that __lcm_arena_alloc_array() takes to *total, for
+// <TYPE>_decode_arena_size().  Returns -1 if it can't be allocated.
+static inline int __lcm_arena_add_array(size_t *total, size_t size, int64_t elements)
+{
+    if (elements <= 0)
+        return 0;
+    if ((uint64_t) elements > ((size_t) -1 >> 1) / size)
+        return -1;
+    size_t sz = __lcm_arena_aligned_size(size * (size_t) elements);
+    if (sz > ((size_t) -1 >> 1) - *total)
+        return -1;
+    *total += sz;
+    return 0;
+}
+
+// Returns the encoded length of an array of elements with a constant encoded
+// size, for <TYPE>_decode_arena_size(), or -1 if it exceeds maxlen.
+static inline int __lcm_skip_array(int maxlen, int size, int elements)
+{
+    if (elements < 0 || (int64_t) size * elements > maxlen)
+        return -1;
+    return size * elements;
+}
+
+// Multiplies *elements by the length of a dimension of an array being decoded,
+// from the last one to the first, so that the whole array is checked before
+// it's allocated.  Returns -1 if the length is negative, or the elements, of
+// at least size bytes each, exceed maxlen.
+static inline int __lcm_check_array_dim(int64_t *elements, int64_t length, int maxlen, int size)
+{
+    if (length < 0 || (*elements && length > maxlen / size / *elements))
+        return -1;
+    *elements *= length;
+    return 0;
+}
+
+static inline int __string_decode_array_arena(const void *_buf, int offset, int maxlen, char **p,
+                                              int elements, lcm_arena_t *arena)
+{
+    int pos = 0, thislen;
+    int element;
+
+    for (element = 0; element < elements; element++) {
+        int32_t length;
+
+        // read length including \0
+        thislen = __int32_t_decode_array(_buf, offset + pos, maxlen - pos, &length, 1);
+        if (thislen < 0)
+            return thislen;
+        else
+            pos += thislen;
+
+        if (length <= 0 || length > maxlen - pos)
+            return -1;
+        p[element] = (char *) lcm_arena_alloc(arena, length);
+        if (!p[element])
+            return -1;
+        thislen =
+            __int8_t_decode_array(_buf, offset + pos, maxlen - pos, (int8_t *) p[element], length);
+        if (thislen < 0)
+            return thislen;
+        else
+            pos += thislen;
+    }
+
+    return pos;
+}
+
+static inline int __string_decode_array_arena_size(const void *_buf, int offset, int maxlen,
+                                                   int elements, size_t *total)
+{
+    int pos = 0, thislen;
+    int element;
+
+    for (element = 0; element < elements; element++) {
+        int32_t length;
+
+        thislen = __int32_t_decode_array(_buf, offset + pos, maxlen - pos, &length, 1);
+        if (thislen < 0)
+            return thislen;
+        else
+            pos += thislen;
+
+        if (length <= 0 || length > maxlen - pos)
+            return -1;
+        if (__lcm_arena_add_array(total, 1, length))
+            return -1;
+        pos += length;
+    }
+
+    return pos;
+}
+
 /**
  * Describes the type of a single field in an LCM message.
  */
@@ -602,8 +935,251 @@ struct _lcm_type_info_t {
     lcm_get_hash_t get_hash;
 };
 
+/**
+ * Describes a message type in a registry generated by lcm-gen --c-registry,
+ * which finds the type of an encoded message by its fingerprint.
+ */
+typedef struct _lcm_registry_entry_t lcm_registry_entry_t;
+struct _lcm_registry_entry_t {
+    /**
+     * the fingerprint that begins the encoded messages
+     */
+    int64_t fingerprint;
+
+    /**
+     * the full name of the type, e.g. "package.type_t"
+     */
+    const char *name;
+
+    /**
+     * sizeof() the struct that messages are decoded into
+     */
+    int struct_size;
+
+    lcm_decode_t decode;
+    lcm_decode_cleanup_t decode_cleanup;
+    lcm_encoded_size_t encoded_size;
+
+    /**
+     * returns the typeinfo of the type, or NULL if it wasn't generated with
+     * --c-typeinfo
+     */
+    const lcm_type_info_t *(*get_type_info)(void);
+};
+
+/**
+ * Returns the entry with a fingerprint among the num_entries entries, which
+ * are sorted by fingerprint, or NULL if there is none.
+ */
+static inline const lcm_registry_entry_t *lcm_registry_find(const lcm_registry_entry_t *entries,
+                                                            int num_entries, int64_t fingerprint)
+{
+    int lo = 0, hi = num_entries;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (entries[mid].fingerprint < fingerprint)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < num_entries && entries[lo].fingerprint == fingerprint)
+        return &entries[lo];
+    return NULL;
+}
+
+/**
+ * Returns the entry of the type of the encoded message in buf, found by the
+ * fingerprint it begins with, or NULL if there is none.
+ */
+static inline const lcm_registry_entry_t *lcm_registry_find_message(
+    const lcm_registry_entry_t *entries, int num_entries, const void *buf, int offset, int maxlen)
+{
+    int64_t fingerprint;
+    if (__int64_t_decode_array(buf, offset, maxlen, &fingerprint, 1) < 0)
+        return NULL;
+    return lcm_registry_find(entries, num_entries, fingerprint);
+}
+
 #ifdef __cplusplus
 }
+
+// The header can be included within extern "C"
+extern "C++" {
+
+// The element decoders of lcm::ArrayView
+static inline int __lcm_decode_array(const void *buf, int offset, int maxlen, int8_t *p,
+                                     int elements)
+{
+    return __int8_t_decode_array(buf, offset, maxlen, p, elements);
+}
+
+static inline int __lcm_decode_array(const void *buf, int offset, int maxlen, uint8_t *p,
+                                     int elements)
+{
+    return __byte_decode_array(buf, offset, maxlen, p, elements);
+}
+
+static inline int __lcm_decode_array(const void *buf, int offset, int maxlen, int16_t *p,
+                                     int elements)
+{
+    return __int16_t_decode_array(buf, offset, maxlen, p, elements);
+}
+
+static inline int __lcm_decode_array(const void *buf, int offset, int maxlen, int32_t *p,
+                                     int elements)
+{
+    return __int32_t_decode_array(buf, offset, maxlen, p, elements);
+}
+
+static inline int __lcm_decode_array(const void *buf, int offset, int maxlen, int64_t *p,
+                                     int elements)
+{
+    return __int64_t_decode_array(buf, offset, maxlen, p, elements);
+}
+
+static inline int __lcm_decode_array(const void *buf, int offset, int maxlen, float *p,
+                                     int elements)
+{
+    return __float_decode_array(buf, offset, maxlen, p, elements);
+}
+
+static inline int __lcm_decode_array(const void *buf, int offset, int maxlen, double *p,
+                                     int elements)
+{
+    return __double_decode_array(buf, offset, maxlen, p, elements);
+}
+
+// Decodes elements values that are stride bytes apart in buf into the array p,
+// for the Columns of the generated C++ types.  Once inlined, this is a loop of
+// a strided load and a byte swap, which compilers can vectorize.
+template <class T>
+static inline void __lcm_decode_column(const void *buf, int stride, T *p, int elements)
+{
+    const uint8_t *src = (const uint8_t *) buf;
+    for (int element = 0; element < elements; element++)
+        __lcm_decode_array(src + element * stride, 0, (int) sizeof(T), p + element, 1);
+}
+
+namespace lcm {
+
+/**
+ * A read-only array of a primitive type in an encoded message, as returned
+ * by the views of the generated C++ types.  It refers to the encoded
+ * elements, which are decoded when they are accessed.
+ */
+template <class T>
+class ArrayView {
+  public:
+    ArrayView() : data_(NULL), size_(0) {}
+    ArrayView(const void *data, int size) : data_(data), size_(size) {}
+
+    /**
+     * Returns the number of elements.
+     */
+    int size() const { return size_; }
+
+    /**
+     * Decodes the element at index, which must be less than size().
+     */
+    T operator[](int index) const
+    {
+        T value;
+        __lcm_decode_array(data_, index * (int) sizeof(T), (int) sizeof(T), &value, 1);
+        return value;
+    }
+
+    /**
+     * Decodes all of the elements into p, which must have room for size() of
+     * them.
+     */
+    void copyTo(T *p) const { __lcm_decode_array(data_, 0, size_ * (int) sizeof(T), p, size_); }
+
+    /**
+     * Returns the encoded elements, which are in big-endian byte order.
+     */
+    const void *data() const { return data_; }
+
+  private:
+    const void *data_;
+    int size_;
+};
+
+/**
+ * An array of up to N elements that are stored inline, which the generated
+ * C++ types use in place of std::vector for the variable size arrays that
+ * have a "max N" comment.  Like a std::vector, it is resized to the length
+ * member of the message before encoding, but it never allocates.
+ */
+template <class T, int N>
+class BoundedArray {
+  public:
+    typedef T value_type;
+    typedef T *iterator;
+    typedef const T *const_iterator;
+
+    BoundedArray() : size_(0) {}
+
+    /**
+     * Returns the number of elements.
+     */
+    int size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    /**
+     * Returns N, the most elements that the array can hold.
+     */
+    static int capacity() { return N; }
+
+    /**
+     * Changes the number of elements to n, which is clamped to N.  Elements
+     * that are added are value-initialized, like those of std::vector.
+     */
+    void resize(int n)
+    {
+        if (n > N)
+            n = N;
+        else if (n < 0)
+            n = 0;
+        for (int i = size_; i < n; i++)
+            elements_[i] = T();
+        size_ = n;
+    }
+
+    void clear() { size_ = 0; }
+
+    /**
+     * Appends value, unless the array already holds N elements.  Returns
+     * false if it does.
+     */
+    bool push_back(const T &value)
+    {
+        if (size_ == N)
+            return false;
+        elements_[size_++] = value;
+        return true;
+    }
+
+    T &operator[](int index) { return elements_[index]; }
+    const T &operator[](int index) const { return elements_[index]; }
+
+    T *data() { return elements_; }
+    const T *data() const { return elements_; }
+
+    iterator begin() { return elements_; }
+    iterator end() { return elements_ + size_; }
+    const_iterator begin() const { return elements_; }
+    const_iterator end() const { return elements_ + size_; }
+
+  private:
+    T elements_[N];
+    int size_;
+};
+
+}  // namespace lcm
+
+}  // extern "C++"
+
 #if defined(__GNUC__) && defined(__clang__)
 #pragma clang diagnostic pop
 #elif defined(__GNUC__)
@@ -5,6 +5,7 @@
 #ifndef WIN32
 #include <sys/select.h>
 #include <sys/time.h>
+#include <unistd.h>
 #else
 #include <Winsock2.h>
 #endif
@@ -13,6 +14,16 @@
 #include "eventlog.h"
 #include "lcm_internal.h"
 
+#ifdef __linux__
+#include <sys/timerfd.h>
+#endif
+
+// The timer thread sleeps until this many microseconds before an event is
+// due, and spins from then on, since sleeps wake up late by about as much.
+#define PACE_SPIN_USEC 50
+// events are dispatched together if they're due within this many microseconds
+#define DEFAULT_PACE_TOLERANCE_USEC 50
+
 typedef enum {
     LCM_LOGPROV_READ_MODE = 0,
     LCM_LOGPROV_WRITE_MODE = 1,
@@ -29,11 +40,67 @@ struct _lcm_provider_t {
     lcm_log_provider_mode_t log_mode;
 
     lcm_eventlog_t *log;
+    // the log, instead of log, if it's in the block format
+    lcm_blocklog_t *blocklog;
+    // the logs, instead of log, if the file is a manifest of log files
+    lcm_eventlog_merge_t *merge;
+    // set once there's a subscription, so that only the blocks of a block
+    // log with subscribed channels are read
+    int subscribed;
+    // the last event read, or NULL.  It points to event_buf, which every
+    // event is read into, or into blocklog or merge.
     lcm_eventlog_event_t *event;
+    lcm_eventlog_event_t event_buf;
+    size_t event_capacity;
 
     double speed;
     int64_t next_clock_time;
     int64_t start_timestamp;
+    int64_t pace_tolerance;
+
+    // how late events were dispatched in microseconds, negative if early,
+    // which is printed when playback ends if pace_stats is set
+    int pace_stats;  // bool
+    int64_t pace_events;
+    int64_t pace_error_sum;
+    int64_t pace_error_max;
+    int64_t pace_error_min;
+    int64_t pace_late_events;
+
+    // CPU and priority of the timer thread
+    lcm_thread_sched_t timer_sched;
+
+    // If prefetch_bytes is set, prefetch_thread reads events ahead into
+    // prefetch_queue, until the events queued take up that many bytes, so that
+    // reads don't delay playback.  prefetched is the event popped last.
+    int64_t prefetch_bytes;
+    GThread *prefetch_thread;
+    GMutex prefetch_mutex;
+    GCond prefetch_cond;
+    GQueue prefetch_queue;  // lcm_eventlog_event_t*, allocated with its channel and data
+    int64_t prefetch_queued;
+    int prefetch_done;  // bool, set at the end of the log
+    // bool, set while the queue is being refilled, which it is once it's
+    // half empty, and while playback waits for an event
+    int prefetch_filling;
+    int prefetch_waiting;
+    int prefetch_stop;  // bool
+    int64_t prefetch_stalls;
+    lcm_eventlog_event_t *prefetched;
+
+    // If write_queue_bytes is set, publishing queues a copy of each event in
+    // write_queue, and write_thread writes all the events queued with one
+    // lcm_eventlog_write_events(), so that publishing doesn't wait for the
+    // disk.  Publishing blocks while the events queued take up that many
+    // bytes, and the events left are written before the log is closed.
+    int64_t write_queue_bytes;
+    GThread *write_thread;
+    GMutex write_mutex;
+    GCond write_cond;
+    GQueue write_queue;  // lcm_eventlog_event_t*, allocated with its channel and data
+    int64_t write_queued;
+    int write_stop;    // bool
+    int write_failed;  // bool, set once a write failed
 
     int thread_created;
     GThread *timer_thread;
@@ -44,6 +111,40 @@ struct _lcm_provider_t {
 static void lcm_logprov_destroy(lcm_logprov_t *lr)
 {
     dbg(DBG_LCM, "closing lcm log provider context\n");
+    if (lr->pace_stats && lr->pace_events > 0) {
+        fprintf(stderr,
+                "Playback pacing: %lld events, mean error %.1f us, %lld to %lld us, "
+                "%lld late by more than 1 ms\n",
+                (long long) lr->pace_events, (double) lr->pace_error_sum / lr->pace_events,
+                (long long) lr->pace_error_min, (long long) lr->pace_error_max,
+                (long long) lr->pace_late_events);
+        if (lr->prefetch_bytes > 0)
+            fprintf(stderr, "Playback waited for the prefetch thread %lld times\n",
+                    (long long) lr->prefetch_stalls);
+    }
+    if (lr->prefetch_thread) {
+        g_mutex_lock(&lr->prefetch_mutex);
+        lr->prefetch_stop = 1;
+        g_cond_broadcast(&lr->prefetch_cond);
+        g_mutex_unlock(&lr->prefetch_mutex);
+        g_thread_join(lr->prefetch_thread);
+        g_mutex_clear(&lr->prefetch_mutex);
+        g_cond_clear(&lr->prefetch_cond);
+    }
+    lcm_eventlog_event_t *queued;
+    while ((queued = (lcm_eventlog_event_t *) g_queue_pop_head(&lr->prefetch_queue)))
+        g_free(queued);
+    g_free(lr->prefetched);
+    if (lr->write_thread) {
+        // the thread writes the events left before it exits
+        g_mutex_lock(&lr->write_mutex);
+        lr->write_stop = 1;
+        g_cond_broadcast(&lr->write_cond);
+        g_mutex_unlock(&lr->write_mutex);
+        g_thread_join(lr->write_thread);
+        g_mutex_clear(&lr->write_mutex);
+        g_cond_clear(&lr->write_cond);
+    }
     if (lr->thread_created) {
         /* Destroy the timer thread */
         int64_t abort_cmd = -1;
@@ -63,52 +164,97 @@ static void lcm_logprov_destroy(lcm_logprov_t *lr)
     if (lr->timer_pipe[1] >= 0)
         lcm_internal_pipe_close(lr->timer_pipe[1]);
 
-    if (lr->event)
-        lcm_eventlog_free_event(lr->event);
+    free(lr->event_buf.channel);
     if (lr->log)
         lcm_eventlog_destroy(lr->log);
+    if (lr->blocklog)
+        lcm_blocklog_destroy(lr->blocklog);
+    if (lr->merge)
+        lcm_eventlog_merge_close(lr->merge);
 
     free(lr->filename);
     free(lr);
 }
 
+// Sleeps until abstime, returning 0 then, or until a command is written to
+// timer_pipe, returning 1, or returns -1 on an error.
+static int sleep_until(lcm_logprov_t *lr, int timer_fd, int64_t abstime)
+{
+    while (1) {
+        int64_t now = g_get_real_time();
+        if (abstime <= now)
+            return 0;
+
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(lr->timer_pipe[0], &fds);
+        int status;
+#ifdef __linux__
+        if (timer_fd >= 0) {
+            // a timer of absolute time, unlike a timeout, doesn't wake up late
+            // by the time taken to get to select
+            struct itimerspec its;
+            memset(&its, 0, sizeof(its));
+            its.it_value.tv_sec = abstime / 1000000;
+            its.it_value.tv_nsec = (abstime % 1000000) * 1000;
+            timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+            FD_SET(timer_fd, &fds);
+            status = select(MAX(lr->timer_pipe[0], timer_fd) + 1, &fds, NULL, NULL, NULL);
+            if (status > 0 && !FD_ISSET(lr->timer_pipe[0], &fds)) {
+                uint64_t expirations;
+                if (read(timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+                    return -1;
+                continue;
+            }
+        } else
+#endif
+        {
+            struct timeval sleep_tv;
+            sleep_tv.tv_sec = (abstime - now) / 1000000;
+            sleep_tv.tv_usec = (abstime - now) % 1000000;
+            status = select(lr->timer_pipe[0] + 1, &fds, NULL, NULL, &sleep_tv);
+        }
+        if (status > 0)
+            return 1;
+        if (status < 0 && errno != EINTR)
+            return -1;
+    }
+}
+
 static void *timer_thread(void *user)
 {
     lcm_logprov_t *lr = (lcm_logprov_t *) user;
     int64_t abstime;
-    struct timeval sleep_tv;
+    int timer_fd = -1;
+#ifdef __linux__
+    timer_fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+#endif
 
     while (lcm_internal_pipe_read(lr->timer_pipe[0], &abstime, 8) == 8) {
         if (abstime < 0)
-            return NULL;
-
-        int64_t now = g_get_real_time();
-
-        if (abstime > now) {
-            int64_t sleep_utime = abstime - now;
-            sleep_tv.tv_sec = sleep_utime / 1000000;
-            sleep_tv.tv_usec = sleep_utime % 1000000;
-
-            // sleep until the next timed message, or until an abort message
-            fd_set fds;
-            FD_ZERO(&fds);
-            FD_SET(lr->timer_pipe[0], &fds);
-
-            int status = select(lr->timer_pipe[0] + 1, &fds, NULL, NULL, &sleep_tv);
+            break;
+
+        // sleep until just before the next timed message, or until an abort
+        // message, and then spin until the message is due
+        int status = sleep_until(lr, timer_fd, abstime - PACE_SPIN_USEC);
+        if (status < 0)
+            perror(__FILE__ " - select (timer)");
+        if (status > 0)
+            continue;
+        int64_t now;
+        while ((now = g_get_real_time()) < abstime && abstime - now <= PACE_SPIN_USEC) {
+        }
 
-            if (0 == status) {
-                // select timed out
-                if (lcm_internal_pipe_write(lr->notify_pipe[1], "+", 1) < 0) {
-                    perror(__FILE__ " - write (timer select)");
-                }
-            }
-        } else {
-            if (lcm_internal_pipe_write(lr->notify_pipe[1], "+", 1) < 0) {
-                perror(__FILE__ " - write (timer)");
-            }
+        if (lcm_internal_pipe_write(lr->notify_pipe[1], "+", 1) < 0) {
+            perror(__FILE__ " - write (timer)");
         }
     }
-    perror("timer_thread read failed");
+    if (abstime >= 0)
+        perror("timer_thread read failed");
+#ifdef __linux__
+    if (timer_fd >= 0)
+        close(timer_fd);
+#endif
     return NULL;
 }
 
@@ -125,6 +271,34 @@ static void new_argument(gpointer key, gpointer value, gpointer user)
         lr->start_timestamp = strtoll((char *) value, &endptr, 10);
         if (endptr == value)
             fprintf(stderr, "Warning: Invalid value for start_timestamp\n");
+    } else if (!strcmp((char *) key, "pace_tolerance")) {
+        char *endptr = NULL;
+        lr->pace_tolerance = strtoll((char *) value, &endptr, 10);
+        if (endptr == value || lr->pace_tolerance < 0) {
+            fprintf(stderr, "Warning: Invalid value for pace_tolerance\n");
+            lr->pace_tolerance = DEFAULT_PACE_TOLERANCE_USEC;
+        }
+    } else if (!strcmp((char *) key, "pace_stats")) {
+        if (!strcmp((char *) value, "1"))
+            lr->pace_stats = 1;
+        else if (strcmp((char *) value, "0"))
+            fprintf(stderr, "Warning: Invalid value for pace_stats\n");
+    } else if (!strcmp((char *) key, "prefetch_mb")) {
+        char *endptr = NULL;
+        double mb = strtod((char *) value, &endptr);
+        if (endptr == value || mb < 0)
+            fprintf(stderr, "Warning: Invalid value for prefetch_mb\n");
+        else
+            lr->prefetch_bytes = (int64_t) (mb * (1 << 20));
+    } else if (!strcmp((char *) key, "write_queue_mb")) {
+        char *endptr = NULL;
+        double mb = strtod((char *) value, &endptr);
+        if (endptr == value || mb < 0)
+            fprintf(stderr, "Warning: Invalid value for write_queue_mb\n");
+        else
+            lr->write_queue_bytes = (int64_t) (mb * (1 << 20));
+    } else if (!strcmp((char *) key, "recv_cpu") || !strcmp((char *) key, "recv_prio")) {
+        lcm_parse_thread_sched_arg(&lr->timer_sched, (char *) key, (char *) value);
     } else if (!strcmp((char *) key, "mode")) {
         const char *mode = (char *) value;
         if (!strcmp(mode, "r")) {
@@ -141,16 +315,161 @@ static void new_argument(gpointer key, gpointer value, gpointer user)
     }
 }
 
+static int has_handlers(const char *channel, void *user)
+{
+    lcm_logprov_t *lr = (lcm_logprov_t *) user;
+    return lcm_has_handlers(lr->lcm, channel);
+}
+
+// Reads the next event, which stays valid until the next read, or returns NULL
+// at the end of the log.
+static lcm_eventlog_event_t *read_next_event(lcm_logprov_t *lr)
+{
+    if (lr->blocklog) {
+        // until something subscribes, every block is read, since the events
+        // are dispatched ahead of the subscriptions that a program makes
+        // right after creating the lcm_t
+        if (g_atomic_int_get(&lr->subscribed))
+            lcm_blocklog_set_channel_filter(lr->blocklog, has_handlers, lr);
+        return (lcm_eventlog_event_t *) lcm_blocklog_read_next_event(lr->blocklog);
+    }
+    // the events on channels without subscriptions aren't read either
+    if (lr->merge) {
+        if (g_atomic_int_get(&lr->subscribed))
+            lcm_eventlog_merge_set_channel_filter(lr->merge, has_handlers, lr);
+        return (lcm_eventlog_event_t *) lcm_eventlog_merge_next(lr->merge);
+    }
+    if (g_atomic_int_get(&lr->subscribed))
+        lcm_eventlog_set_channel_filter(lr->log, has_handlers, lr);
+    if (lcm_eventlog_read_next_event_into(lr->log, &lr->event_buf, &lr->event_capacity) < 0)
+        return NULL;
+    return &lr->event_buf;
+}
+
+static int64_t prefetched_size(const lcm_eventlog_event_t *le)
+{
+    return sizeof(*le) + le->channellen + 1 + le->datalen;
+}
+
+// Copies an event into a single allocation, since the next read overwrites it.
+static lcm_eventlog_event_t *copy_event(const lcm_eventlog_event_t *le)
+{
+    lcm_eventlog_event_t *copy = (lcm_eventlog_event_t *) g_malloc(prefetched_size(le));
+    *copy = *le;
+    copy->channel = (char *) (copy + 1);
+    memcpy(copy->channel, le->channel, le->channellen + 1);
+    copy->data = copy->channel + le->channellen + 1;
+    memcpy(copy->data, le->data, le->datalen);
+    return copy;
+}
+
+static void *prefetch_thread(void *user)
+{
+    lcm_logprov_t *lr = (lcm_logprov_t *) user;
+    g_mutex_lock(&lr->prefetch_mutex);
+    while (!lr->prefetch_stop) {
+        // an event is queued even if it's bigger than the whole queue
+        if (lr->prefetch_queued >= lr->prefetch_bytes &&
+            !g_queue_is_empty(&lr->prefetch_queue))
+            lr->prefetch_filling = 0;
+        if (!lr->prefetch_filling) {
+            g_cond_wait(&lr->prefetch_cond, &lr->prefetch_mutex);
+            continue;
+        }
+        g_mutex_unlock(&lr->prefetch_mutex);
+
+        const lcm_eventlog_event_t *le = read_next_event(lr);
+        lcm_eventlog_event_t *copy = le ? copy_event(le) : NULL;
+
+        g_mutex_lock(&lr->prefetch_mutex);
+        if (!copy) {
+            lr->prefetch_done = 1;
+            g_cond_broadcast(&lr->prefetch_cond);
+            break;
+        }
+        g_queue_push_tail(&lr->prefetch_queue, copy);
+        lr->prefetch_queued += prefetched_size(copy);
+        if (lr->prefetch_waiting)
+            g_cond_broadcast(&lr->prefetch_cond);
+    }
+    g_mutex_unlock(&lr->prefetch_mutex);
+    return NULL;
+}
+
 static int load_next_event(lcm_logprov_t *lr)
 {
-    if (lr->event)
-        lcm_eventlog_free_event(lr->event);
+    if (!lr->prefetch_thread) {
+        lr->event = read_next_event(lr);
+        return lr->event ? 0 : -1;
+    }
 
-    lr->event = lcm_eventlog_read_next_event(lr->log);
-    if (!lr->event)
-        return -1;
+    lr->event = NULL;
+    g_free(lr->prefetched);
+    g_mutex_lock(&lr->prefetch_mutex);
+    if (g_queue_is_empty(&lr->prefetch_queue) && !lr->prefetch_done)
+        lr->prefetch_stalls++;
+    lr->prefetch_waiting = 1;
+    while (g_queue_is_empty(&lr->prefetch_queue) && !lr->prefetch_done) {
+        lr->prefetch_filling = 1;
+        g_cond_broadcast(&lr->prefetch_cond);
+        g_cond_wait(&lr->prefetch_cond, &lr->prefetch_mutex);
+    }
+    lr->prefetch_waiting = 0;
+    lr->prefetched = (lcm_eventlog_event_t *) g_queue_pop_head(&lr->prefetch_queue);
+    if (lr->prefetched) {
+        lr->prefetch_queued -= prefetched_size(lr->prefetched);
+        // the thread is woken up once the queue is half empty, rather than
+        // for every event
+        if (!lr->prefetch_filling && lr->prefetch_queued <= lr->prefetch_bytes / 2) {
+            lr->prefetch_filling = 1;
+            g_cond_broadcast(&lr->prefetch_cond);
+        }
+    }
+    g_mutex_unlock(&lr->prefetch_mutex);
+    lr->event = lr->prefetched;
+    return lr->event ? 0 : -1;
+}
 
-    return 0;
+static void *write_thread(void *user)
+{
+    lcm_logprov_t *lr = (lcm_logprov_t *) user;
+    GPtrArray *events = g_ptr_array_new();
+    g_mutex_lock(&lr->write_mutex);
+    while (1) {
+        if (g_queue_is_empty(&lr->write_queue)) {
+            if (lr->write_stop)
+                break;
+            g_cond_wait(&lr->write_cond, &lr->write_mutex);
+            continue;
+        }
+        // everything queued is written at once, while publishing goes on
+        lcm_eventlog_event_t *le;
+        int64_t size = 0;
+        while ((le = (lcm_eventlog_event_t *) g_queue_pop_head(&lr->write_queue))) {
+            g_ptr_array_add(events, le);
+            size += prefetched_size(le);
+        }
+        g_mutex_unlock(&lr->write_mutex);
+
+        int status = lcm_eventlog_write_events(
+            lr->log, (lcm_eventlog_event_t *const *) events->pdata, events->len);
+        for (guint i = 0; i < events->len; i++)
+            g_free(g_ptr_array_index(events, i));
+        g_ptr_array_set_size(events, 0);
+
+        g_mutex_lock(&lr->write_mutex);
+        if (status < 0 && !lr->write_failed) {
+            fprintf(stderr, "Error: Failed to write to %s: %s\n", lr->filename, strerror(errno));
+            lr->write_failed = 1;
+        }
+        // the queued bytes are only released once they're written, so that
+        // publishing can't get further ahead of the disk than that
+        lr->write_queued -= size;
+        g_cond_broadcast(&lr->write_cond);
+    }
+    g_mutex_unlock(&lr->write_mutex);
+    g_ptr_array_free(events, TRUE);
+    return NULL;
 }
 
 static lcm_provider_t *lcm_logprov_create(lcm_t *parent, const char *target, const GHashTable *args)
@@ -166,6 +485,8 @@ static lcm_provider_t *lcm_logprov_create(lcm_t *parent, const char *target, con
     lr->speed = 1;
     lr->next_clock_time = -1;
     lr->start_timestamp = -1;
+    lr->pace_tolerance = DEFAULT_PACE_TOLERANCE_USEC;
+    lcm_thread_sched_init(&lr->timer_sched);
 
     g_hash_table_foreach((GHashTable *) args, new_argument, lr);
 
@@ -186,7 +507,17 @@ static lcm_provider_t *lcm_logprov_create(lcm_t *parent, const char *target, con
 
     switch (lr->log_mode) {
     case LCM_LOGPROV_READ_MODE:
-        lr->log = lcm_eventlog_create(lr->filename, "r");
+        if (lcm_blocklog_detect(lr->filename))
+            lr->blocklog = lcm_blocklog_create(lr->filename, "r");
+        else if (lcm_eventlog_merge_detect(lr->filename))
+            lr->merge = lcm_eventlog_merge_open(lr->filename);
+        else if (strchr(lr->filename, ',') && !g_file_test(lr->filename, G_FILE_TEST_EXISTS)) {
+            char **paths = g_strsplit(lr->filename, ",", -1);
+            lr->merge = lcm_eventlog_merge_open_files((const char *const *) paths,
+                                                      g_strv_length(paths));
+            g_strfreev(paths);
+        } else
+            lr->log = lcm_eventlog_create(lr->filename, "r");
         break;
     case LCM_LOGPROV_WRITE_MODE:
         lr->log = lcm_eventlog_create(lr->filename, "w");
@@ -200,7 +531,7 @@ static lcm_provider_t *lcm_logprov_create(lcm_t *parent, const char *target, con
         return NULL;
     }
 
-    if (!lr->log) {
+    if (!lr->log && !lr->blocklog && !lr->merge) {
         fprintf(stderr, "Error: Failed to open %s: %s\n", lr->filename, strerror(errno));
         lcm_logprov_destroy(lr);
         return NULL;
@@ -215,7 +546,8 @@ static lcm_provider_t *lcm_logprov_create(lcm_t *parent, const char *target, con
         }
 
         /* Start the reader thread */
-        lr->timer_thread = g_thread_new(NULL, timer_thread, lr);
+        lr->timer_thread =
+            lcm_internal_thread_new("lcm-file-timer", timer_thread, lr, &lr->timer_sched);
         if (!lr->timer_thread) {
             fprintf(stderr, "Error: LCM failed to start timer thread\n");
             lcm_logprov_destroy(lr);
@@ -229,19 +561,47 @@ static lcm_provider_t *lcm_logprov_create(lcm_t *parent, const char *target, con
 
         if (lr->start_timestamp > 0) {
             dbg(DBG_LCM, "Seeking to timestamp: %lld\n", (long long) lr->start_timestamp);
-            lcm_eventlog_seek_to_timestamp(lr->log, lr->start_timestamp);
+            if (lr->blocklog)
+                lcm_blocklog_seek_to_timestamp(lr->blocklog, lr->start_timestamp);
+            else if (lr->merge)
+                lcm_eventlog_merge_seek_to_timestamp(lr->merge, lr->start_timestamp);
+            else
+                lcm_eventlog_seek_to_timestamp(lr->log, lr->start_timestamp);
         }
+
+        // the thread reads past the seek, and the first event, which it would
+        // overwrite, is copied
+        if (lr->prefetch_bytes > 0) {
+            lr->prefetched = copy_event(lr->event);
+            lr->event = lr->prefetched;
+            lr->prefetch_filling = 1;
+            g_mutex_init(&lr->prefetch_mutex);
+            g_cond_init(&lr->prefetch_cond);
+            lr->prefetch_thread = g_thread_new("lcm-file-prefetch", prefetch_thread, lr);
+        }
+    } else if (lr->write_queue_bytes > 0) {
+        lcm_thread_sched_t sched;
+        lcm_thread_sched_init(&sched);
+        g_mutex_init(&lr->write_mutex);
+        g_cond_init(&lr->write_cond);
+        lr->write_thread = lcm_internal_thread_new("lcm-file-write", write_thread, lr, &sched);
     }
 
     return lr;
 }
 
+static int lcm_logprov_subscribe(lcm_logprov_t *lr, const char *channel)
+{
+    g_atomic_int_set(&lr->subscribed, 1);
+    return 0;
+}
+
 static int lcm_logprov_get_fileno(lcm_logprov_t *lr)
 {
     return lr->notify_pipe[0];
 }
 
-static int lcm_logprov_handle(lcm_logprov_t *lr)
+static int lcm_logprov_handle_batch(lcm_logprov_t *lr, int max_msgs)
 {
     lcm_recv_buf_t rbuf;
 
@@ -263,45 +623,77 @@ static int lcm_logprov_handle(lcm_logprov_t *lr)
     if (lr->next_clock_time < 0)
         lr->next_clock_time = now;
 
-    //    rbuf.channel = lr->event->channel,
-    rbuf.data = (uint8_t *) lr->event->data;
-    rbuf.data_size = lr->event->datalen;
-    rbuf.recv_utime = lr->next_clock_time;
-    rbuf.lcm = lr->lcm;
+    int nhandled = 0;
+    while (1) {
+        //    rbuf.channel = lr->event->channel,
+        rbuf.data = (uint8_t *) lr->event->data;
+        rbuf.data_size = lr->event->datalen;
+        rbuf.recv_utime = lr->next_clock_time;
+        rbuf.recv_time_ns = rbuf.recv_utime * 1000;
+        rbuf.recv_mono_ns = lcm_monotonic_ns();
+        rbuf.lcm = lr->lcm;
+
+        if (lr->pace_stats && lr->speed > 0) {
+            int64_t error = g_get_real_time() - lr->next_clock_time;
+            if (lr->pace_events == 0 || error > lr->pace_error_max)
+                lr->pace_error_max = error;
+            if (lr->pace_events == 0 || error < lr->pace_error_min)
+                lr->pace_error_min = error;
+            lr->pace_error_sum += error;
+            lr->pace_late_events += error > 1000;
+            lr->pace_events++;
+        }
 
-    if (lcm_try_enqueue_message(lr->lcm, lr->event->channel))
-        lcm_dispatch_handlers(lr->lcm, &rbuf, lr->event->channel);
+        if (lcm_try_enqueue_message(lr->lcm, lr->event->channel))
+            lcm_dispatch_handlers(lr->lcm, &rbuf, lr->event->channel);
+        nhandled++;
 
-    int64_t prev_log_time = lr->event->timestamp;
-    if (load_next_event(lr) < 0) {
-        /* end-of-file reached.  This call succeeds, but next call to
-         * _handle will fail */
-        lr->event = NULL;
-        if (lcm_internal_pipe_write(lr->notify_pipe[1], "+", 1) < 0) {
-            perror(__FILE__ " - write(notify)");
+        int64_t prev_log_time = lr->event->timestamp;
+        if (load_next_event(lr) < 0) {
+            /* end-of-file reached.  This call succeeds, but next call to
+             * _handle will fail */
+            lr->event = NULL;
+            if (lcm_internal_pipe_write(lr->notify_pipe[1], "+", 1) < 0) {
+                perror(__FILE__ " - write(notify)");
+            }
+            return nhandled;
         }
-        return 0;
-    }
 
-    /* Compute the wall time for the next event */
-    if (lr->speed > 0)
-        lr->next_clock_time += (lr->event->timestamp - prev_log_time) / lr->speed;
-    else
-        lr->next_clock_time = now;
-
-    if (lr->next_clock_time > now) {
-        int wstatus = lcm_internal_pipe_write(lr->timer_pipe[1], &lr->next_clock_time, 8);
-        if (wstatus < 0) {
-            perror(__FILE__ " - write(timer_pipe)");
+        /* Compute the wall time for the next event */
+        if (lr->speed > 0)
+            lr->next_clock_time += (lr->event->timestamp - prev_log_time) / lr->speed;
+        else
+            lr->next_clock_time = now;
+
+        // the events due within the tolerance are dispatched with this one,
+        // rather than each waking up the timer thread
+        if (lr->next_clock_time > now + lr->pace_tolerance)
+            now = g_get_real_time();
+        if (lr->next_clock_time > now + lr->pace_tolerance) {
+            int wstatus = lcm_internal_pipe_write(lr->timer_pipe[1], &lr->next_clock_time, 8);
+            if (wstatus < 0) {
+                perror(__FILE__ " - write(timer_pipe)");
+            }
+            break;
         }
-    } else {
-        int wstatus = lcm_internal_pipe_write(lr->notify_pipe[1], "+", 1);
-        if (wstatus < 0) {
-            perror(__FILE__ " - write(notify_pipe)");
+
+        /* The next event is already due.  Dispatch it right away if the batch
+         * has room, otherwise leave it for the next call. */
+        if (nhandled >= max_msgs) {
+            int wstatus = lcm_internal_pipe_write(lr->notify_pipe[1], "+", 1);
+            if (wstatus < 0) {
+                perror(__FILE__ " - write(notify_pipe)");
+            }
+            break;
         }
     }
 
-    return 0;
+    return nhandled;
+}
+
+static int lcm_logprov_handle(lcm_logprov_t *lr)
+{
+    return lcm_logprov_handle_batch(lr, 1) < 0 ? -1 : 0;
 }
 
 static int lcm_logprov_publish(lcm_logprov_t *lcm, const char *channel, const void *data,
@@ -313,6 +705,32 @@ static int lcm_logprov_publish(lcm_logprov_t *lcm, const char *channel, const vo
     }
     int channellen = strlen(channel);
 
+    if (lcm->write_thread) {
+        lcm_eventlog_event_t event;
+        event.timestamp = g_get_real_time();
+        event.channellen = channellen;
+        event.channel = (char *) channel;
+        event.datalen = datalen;
+        event.data = (void *) data;
+        lcm_eventlog_event_t *copy = copy_event(&event);
+
+        g_mutex_lock(&lcm->write_mutex);
+        // an event is queued once all those before it were written, even if
+        // it's bigger than the whole queue
+        while (lcm->write_queued >= lcm->write_queue_bytes && !lcm->write_failed)
+            g_cond_wait(&lcm->write_cond, &lcm->write_mutex);
+        int status = lcm->write_failed ? -1 : 0;
+        if (status == 0) {
+            g_queue_push_tail(&lcm->write_queue, copy);
+            lcm->write_queued += prefetched_size(copy);
+            g_cond_broadcast(&lcm->write_cond);
+        } else {
+            g_free(copy);
+        }
+        g_mutex_unlock(&lcm->write_mutex);
+        return status;
+    }
+
     int64_t mem_sz = sizeof(lcm_eventlog_event_t) + channellen + 1 + datalen;
 
     lcm_eventlog_event_t *le = (lcm_eventlog_event_t *) malloc(mem_sz);
@@ -342,11 +760,12 @@ static lcm_provider_vtable_t logprov_vtable;
 static lcm_provider_vtable_t logprov_vtable = {
     .create = lcm_logprov_create,
     .destroy = lcm_logprov_destroy,
-    .subscribe = NULL,
+    .subscribe = lcm_logprov_subscribe,
     .unsubscribe = NULL,
     .publish = lcm_logprov_publish,
     .handle = lcm_logprov_handle,
     .get_fileno = lcm_logprov_get_fileno,
+    .handle_batch = lcm_logprov_handle_batch,
 };
 #endif
 
@@ -358,11 +777,12 @@ void lcm_logprov_provider_init(GPtrArray *providers)
     // Microsoft VS compiler issues. Can't do this statically
     logprov_vtable.create = lcm_logprov_create;
     logprov_vtable.destroy = lcm_logprov_destroy;
-    logprov_vtable.subscribe = NULL;
+    logprov_vtable.subscribe = lcm_logprov_subscribe;
     logprov_vtable.unsubscribe = NULL;
     logprov_vtable.publish = lcm_logprov_publish;
     logprov_vtable.handle = lcm_logprov_handle;
     logprov_vtable.get_fileno = lcm_logprov_get_fileno;
+    logprov_vtable.handle_batch = lcm_logprov_handle_batch;
 #endif
 
     logprov_info.name = "file";
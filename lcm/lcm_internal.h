@@ -12,6 +12,10 @@
 #error "LCM requires a glib version >= 2.32.0"
 #endif
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #ifdef WIN32
 #include <winsock2.h>
 
@@ -43,8 +47,115 @@ struct _lcm_provider_vtable_t {
     int (*publish)(lcm_provider_t *, const char *, const void *, unsigned int);
     int (*handle)(lcm_provider_t *);
     int (*get_fileno)(lcm_provider_t *);
+    // Optional.  Blocks like handle() until a message is available, then
+    // dispatches up to max_msgs already received messages.  Returns the number
+    // of messages dispatched, or -1 on error.
+    int (*handle_batch)(lcm_provider_t *, int max_msgs);
+    // Optional.  Whether messages that were already received are waiting to
+    // be dispatched, which doesn't make get_fileno() readable.
+    int (*has_pending)(lcm_provider_t *);
+    // Optional.  Queues a message to be published by another thread.  If
+    // release is NULL, data is copied, and otherwise release(data, user) is
+    // called once data is no longer needed, even if the message is dropped.
+    int (*publish_async)(lcm_provider_t *, const char *channel, void *data, unsigned int datalen,
+                         lcm_buffer_release_t release, void *user);
+    // Optional, all three or none.  publish_reserve() returns a buffer of at
+    // least maxlen bytes that a message on channel is encoded into, which
+    // publish_commit() publishes and publish_cancel() drops.  Both are called
+    // from the thread that reserved the buffer, and release it.
+    void *(*publish_reserve)(lcm_provider_t *, const char *channel, unsigned int maxlen);
+    int (*publish_commit)(lcm_provider_t *, void *buf, unsigned int datalen);
+    void (*publish_cancel)(lcm_provider_t *, void *buf);
+    // Optional.  Fills in the counters of stats that the provider keeps.  May
+    // be called from any thread at any time.
+    int (*get_stats)(lcm_provider_t *, lcm_stats_t *stats);
+    // Optional.  Publishes the messages in order, like publish() for each of
+    // them.  Returns 0 on success, -1 if any of them failed.
+    int (*publish_batch)(lcm_provider_t *, const lcm_publish_msg_t *msgs, int num_msgs);
+    // Optional.  Publishes a message like publish(), made up of the iovcnt
+    // pieces of iov, which are at least 2 and hold datalen bytes in all.
+    int (*publishv)(lcm_provider_t *, const char *channel, const lcm_iovec_t *iov, int iovcnt,
+                    unsigned int datalen);
+    // Optional, all three or none.  publisher_create() looks up what publish()
+    // would for every message on channel, and returns it, or NULL if the
+    // channel can't be published on.  channel stays valid until
+    // publisher_destroy().  publisher_publish() publishes a message like
+    // publish() with what it returned, and is only called by one thread at a
+    // time for each publisher.
+    void *(*publisher_create)(lcm_provider_t *, const char *channel);
+    int (*publisher_publish)(lcm_provider_t *, void *publisher, const void *data,
+                             unsigned int datalen);
+    void (*publisher_destroy)(lcm_provider_t *, void *publisher);
+    // Optional, with the publisher functions.  Returns 0 if the provider knows
+    // that nobody subscribes to the channel of publisher, so that its
+    // messages would be dropped, and 1 otherwise.
+    int (*publisher_has_subscribers)(lcm_provider_t *, void *publisher);
+    // Optional.  Called after subscribe() once the subscription is in place,
+    // so that the messages on channel that arrive from then on reach its
+    // handler.
+    void (*subscribed)(lcm_provider_t *, const char *channel);
 };
 
+// Statistics counters are updated and read with relaxed atomic operations,
+// so that lcm_get_stats() never waits for a lock.
+static inline uint64_t lcm_stat_get(uint64_t *counter)
+{
+#ifdef _MSC_VER
+    return (uint64_t) _InterlockedCompareExchange64((volatile __int64 *) counter, 0, 0);
+#else
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline void lcm_stat_add(uint64_t *counter, uint64_t n)
+{
+#ifdef _MSC_VER
+    _InterlockedExchangeAdd64((volatile __int64 *) counter, (__int64) n);
+#else
+    __atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline void lcm_stat_set(uint64_t *counter, uint64_t value)
+{
+#ifdef _MSC_VER
+    _InterlockedExchange64((volatile __int64 *) counter, (__int64) value);
+#else
+    __atomic_store_n(counter, value, __ATOMIC_RELAXED);
+#endif
+}
+
+// sets counter to value if it is still old, and returns whether it was
+static inline int lcm_stat_compare_and_swap(uint64_t *counter, uint64_t old, uint64_t value)
+{
+#ifdef _MSC_VER
+    return (uint64_t) _InterlockedCompareExchange64((volatile __int64 *) counter,
+                                                    (__int64) value, (__int64) old) == old;
+#else
+    return __atomic_compare_exchange_n(counter, &old, value, 0, __ATOMIC_RELAXED,
+                                       __ATOMIC_RELAXED);
+#endif
+}
+
+// raises counter to value, unless it is already higher
+static inline void lcm_stat_max(uint64_t *counter, uint64_t value)
+{
+    uint64_t old = lcm_stat_get(counter);
+    while (old < value) {
+#ifdef _MSC_VER
+        uint64_t prev = (uint64_t) _InterlockedCompareExchange64((volatile __int64 *) counter,
+                                                                 (__int64) value, (__int64) old);
+        if (prev == old)
+            break;
+        old = prev;
+#else
+        if (__atomic_compare_exchange_n(counter, &old, value, 1, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED))
+            break;
+#endif
+    }
+}
+
 LCM_NO_EXPORT
 int lcm_parse_url(const char *url, char **provider, char **target, GHashTable *args);
 
@@ -56,12 +167,108 @@ int lcm_parse_url(const char *url, char **provider, char **target, GHashTable *a
 LCM_NO_EXPORT
 int lcm_try_enqueue_message(lcm_t *lcm, const char *channel);
 
+/**
+ * Like lcm_try_enqueue_message(), and also stores the priority class of the
+ * channel, from 0 to LCM_MAX_PRIORITY, in priority.  Providers that queue
+ * received messages for lcm_handle() keep a queue for each class, and
+ * dispatch the highest class first.
+ */
+LCM_NO_EXPORT
+int lcm_try_enqueue_message_priority(lcm_t *lcm, const char *channel, int *priority);
+
 LCM_NO_EXPORT
 int lcm_has_handlers(lcm_t *lcm, const char *channel);
 
+// What lcm_has_handlers_cached() last found out about a channel.  Initialize
+// with has_handlers -1.
+typedef struct {
+    int epoch;
+    int has_handlers;
+} lcm_handlers_cache_t;
+
+/**
+ * Like lcm_has_handlers(), but only looks up the channel again if handlers
+ * were added or removed since the last call with cache.
+ */
+LCM_NO_EXPORT
+int lcm_has_handlers_cached(lcm_t *lcm, const char *channel, lcm_handlers_cache_t *cache);
+
 LCM_NO_EXPORT
 int lcm_dispatch_handlers(lcm_t *lcm, lcm_recv_buf_t *buf, const char *channel);
 
+/**
+ * Returns the id of channel in a process-wide table of channel names, and
+ * stores the copy of channel in the table, which is never freed, in name.
+ * Providers keep the id and name with a received message instead of copying
+ * the channel name, and pass them to lcm_dispatch_channel_handlers().
+ * Returns -1 and stores NULL if the table has no room for another name.
+ */
+LCM_NO_EXPORT
+int lcm_intern_channel(const char *channel, const char **name);
+
+// How a provider lends the buffer of a message that it dispatches to the
+// handlers that call lcm_recv_buf_retain().
+typedef struct {
+    // Called by the handler with the msg passed to
+    // lcm_dispatch_channel_handlers().  Returns a reference on the buffer,
+    // which release is called with once the handler is done with it, or NULL
+    // if the message can't be lent and is copied instead.
+    void *(*retain)(void *msg);
+    // May be called from any thread.
+    void (*release)(void *ref);
+} lcm_recv_buf_lender_t;
+
+/**
+ * Like lcm_dispatch_handlers(), for a channel with the channel_id from
+ * lcm_intern_channel(), which finds the handlers by indexing an array instead
+ * of hashing the channel name.  channel_id may be -1.  If lender is set, the
+ * handlers that retain buf get a reference on msg from it instead of a copy.
+ */
+LCM_NO_EXPORT
+int lcm_dispatch_channel_handlers(lcm_t *lcm, lcm_recv_buf_t *buf, int channel_id,
+                                  const char *channel, const lcm_recv_buf_lender_t *lender,
+                                  void *msg);
+
+// the numa_node of numa_node=auto, which the provider resolves to the node of
+// its network interface
+#define LCM_NUMA_NODE_AUTO -2
+
+// How to schedule a thread started with lcm_internal_thread_new().
+typedef struct {
+    int cpu;       // CPU to pin the thread to, or -1 to let it run anywhere
+    int priority;  // SCHED_FIFO priority, or 0 to keep the default scheduling
+    // NUMA node that the thread runs on, unless cpu is set, and allocates its
+    // memory from, or -1 for any
+    int numa_node;
+} lcm_thread_sched_t;
+
+LCM_NO_EXPORT
+void lcm_thread_sched_init(lcm_thread_sched_t *sched);
+
+/**
+ * Parses the recv_cpu, recv_prio or numa_node URL option named by key into
+ * sched.  Prints a warning and leaves the default if value is invalid.
+ */
+LCM_NO_EXPORT
+void lcm_parse_thread_sched_arg(lcm_thread_sched_t *sched, const char *key, const char *value);
+
+/**
+ * Has the pages of [addr, addr + len), which must start on a page boundary,
+ * allocated from NUMA node when they are first touched.  Returns 0 on success,
+ * -1 on failure or where this is not supported.
+ */
+LCM_NO_EXPORT
+int lcm_numa_bind(void *addr, size_t len, int node);
+
+/**
+ * Starts a thread like g_thread_new().  The new thread applies sched to itself
+ * and calls the handler set with lcm_set_thread_start_handler() before it
+ * runs func.  name must stay valid for the lifetime of the thread.
+ */
+LCM_NO_EXPORT
+GThread *lcm_internal_thread_new(const char *name, GThreadFunc func, gpointer data,
+                                 const lcm_thread_sched_t *sched);
+
 // Each provider-init is defined in a separate source file; list them all here
 // so that lcm.c can call them.
 
@@ -80,4 +287,7 @@ void lcm_mpudpm_provider_init(GPtrArray *providers);
 LCM_NO_EXPORT
 void lcm_memq_provider_init(GPtrArray *providers);
 
+LCM_NO_EXPORT
+void lcm_shm_provider_init(GPtrArray *providers);
+
 #endif
@@ -2,121 +2,531 @@
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #ifndef WIN32
 #include <sys/time.h>
+#include <unistd.h>
 #else
 #include <Winsock2.h>
 #endif
 
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
 #include "dbg.h"
 #include "lcm_internal.h"
 
+/*
+ * Messages are passed from the publishers to lcm_handle() through a ring of
+ * MEMQ_RING_SIZE slots, which publishers claim with a compare-and-swap on the
+ * position of the next free slot rather than under a lock.  Each slot keeps
+ * the buffer that it copies the channel and data of its messages into, so
+ * that publishing doesn't allocate once the buffers have grown to fit.  The
+ * data of messages of more than MEMQ_SLOT_DATA_MAX bytes is allocated for
+ * each of them instead, so that the buffers stay small.
+ *
+ * When the ring is full, messages are queued under a mutex instead, and so
+ * are all of the messages published until lcm_handle() has emptied that
+ * queue, so that the messages of each publisher stay in order.
+ */
+#define MEMQ_RING_SIZE 1024
+#define MEMQ_SLOT_DATA_MAX 16384
+
+// The data of a dispatched message that handlers kept with
+// lcm_recv_buf_retain(), which is released once the last of them is done.
+typedef struct {
+    int refcount;  // the message and the handlers, changed atomically
+    void *data;
+    lcm_buffer_release_t release;
+    void *release_user;
+} memq_loan_t;
+
+typedef struct _memq_msg memq_msg_t;
+struct _memq_msg {
+    char *channel;
+    lcm_recv_buf_t rbuf;
+    // if set, called with rbuf.data once the message has been dispatched
+    lcm_buffer_release_t release;
+    void *release_user;
+    // set once a handler retains the message, and releases it instead
+    memq_loan_t *loan;
+};
+
+typedef struct {
+    // the position in the ring of the message that the slot holds plus one
+    // once the message is published, and the position of the next message
+    // that it's free for after that has been dispatched
+    gint seq;
+    memq_msg_t msg;
+    // the channel of msg, followed by its data unless msg.release is set
+    char *buf;
+    size_t buf_size;
+} memq_slot_t;
+
 typedef struct _lcm_provider_t lcm_memq_t;
 struct _lcm_provider_t {
     lcm_t *lcm;
-    GQueue *queue;
+
+    memq_slot_t *ring;
+    gint tail;  // the position of the next slot to be claimed
+    guint head;  // the position of the next slot to dispatch, only used by lcm_handle()
+    // the messages that are published and not yet dispatched
+    gint pending;
+
+    // the messages published while the ring was full, and those after them
     GMutex mutex;
+    GQueue *overflow;
+    gint overflow_len;  // changed with mutex held
+
+#ifdef __linux__
+    int notify_fd;  // eventfd, readable while messages are pending
+#else
     int notify_pipe[2];
-};
+#endif
 
-typedef struct _memq_msg memq_msg_t;
-struct _memq_msg {
-    char *channel;
-    lcm_recv_buf_t rbuf;
+    // With dispatch=inline, lcm_publish() dispatches the message itself while
+    // holding inline_mutex.  The messages that the handlers publish are queued
+    // in inline_queue, and dispatched once the handlers have returned.
+    int dispatch_inline;
+    GRecMutex inline_mutex;
+    GQueue inline_queue;
+    int inline_depth;
 };
 
-static memq_msg_t *memq_msg_new(lcm_t *lcm, const char *channel, const void *data, int data_size,
-                                int64_t utime)
+// The data and then the channel name follow the message in the same
+// allocation, so that lcm_memq_publish_reserve() can hand out the data.
+static memq_msg_t *memq_msg_new(lcm_t *lcm, const char *channel, unsigned int data_size)
 {
-    memq_msg_t *msg = (memq_msg_t *) malloc(sizeof(memq_msg_t));
-    msg->rbuf.data = malloc(data_size);
+    size_t channel_size = strlen(channel) + 1;
+    memq_msg_t *msg = (memq_msg_t *) malloc(sizeof(memq_msg_t) + data_size + channel_size);
+    if (!msg)
+        return NULL;
+    msg->rbuf.data = msg + 1;
     msg->rbuf.data_size = data_size;
-    memcpy(msg->rbuf.data, data, data_size);
-    msg->rbuf.recv_utime = utime;
     msg->rbuf.lcm = lcm;
-    msg->channel = g_strdup(channel);
+    msg->channel = (char *) msg->rbuf.data + data_size;
+    memcpy(msg->channel, channel, channel_size);
+    msg->release = NULL;
+    msg->release_user = NULL;
+    msg->loan = NULL;
     return msg;
 }
 
-static void memq_msg_destroy(memq_msg_t *msg)
+static void memq_loan_release(void *ref)
+{
+    memq_loan_t *loan = (memq_loan_t *) ref;
+    if (!g_atomic_int_dec_and_test(&loan->refcount))
+        return;
+    loan->release(loan->data, loan->release_user);
+    free(loan);
+}
+
+// Lends the data of a message that memq doesn't reuse, which is the data that
+// it calls release with.  Other messages are copied by lcm_recv_buf_retain().
+static void *memq_msg_retain(void *p)
+{
+    memq_msg_t *msg = (memq_msg_t *) p;
+    if (!msg->release)
+        return NULL;
+    if (!msg->loan) {
+        memq_loan_t *loan = (memq_loan_t *) malloc(sizeof(memq_loan_t));
+        if (!loan)
+            return NULL;
+        loan->refcount = 1;
+        loan->data = msg->rbuf.data;
+        loan->release = msg->release;
+        loan->release_user = msg->release_user;
+        msg->loan = loan;
+    }
+    g_atomic_int_inc(&msg->loan->refcount);
+    return msg->loan;
+}
+
+static const lcm_recv_buf_lender_t memq_lender = {memq_msg_retain, memq_loan_release};
+
+static void memq_msg_release(memq_msg_t *msg)
+{
+    if (msg->loan)
+        memq_loan_release(msg->loan);
+    else if (msg->release)
+        msg->release(msg->rbuf.data, msg->release_user);
+    msg->release = NULL;
+    msg->loan = NULL;
+}
+
+static void memq_free_data(void *data, void *user)
+{
+    (void) user;
+    free(data);
+}
+
+// releases the buffer of lcm_memq_publish_reserve()
+static void memq_free_reserved(void *data, void *user)
+{
+    (void) user;
+    free((memq_msg_t *) data - 1);
+}
+
+static void memq_notify(lcm_memq_t *self)
 {
-    free(msg->rbuf.data);
-    g_free(msg->channel);
-    memset(msg, 0, sizeof(memq_msg_t));
-    free(msg);
+#ifdef __linux__
+    uint64_t one = 1;
+    if (write(self->notify_fd, &one, sizeof(one)) < 0)
+        perror(__FILE__ " - write to notify eventfd");
+#else
+    if (lcm_internal_pipe_write(self->notify_pipe[1], "+", 1) < 0)
+        perror(__FILE__ " - write to notify pipe");
+#endif
+}
+
+// Waits until messages are pending, and consumes the notification.
+static int memq_wait(lcm_memq_t *self)
+{
+#ifdef __linux__
+    uint64_t count;
+    while (read(self->notify_fd, &count, sizeof(count)) < 0) {
+        if (errno != EINTR) {
+            perror(__FILE__ " - read from notify eventfd");
+            return -1;
+        }
+    }
+#else
+    char ch;
+    int status = lcm_internal_pipe_read(self->notify_pipe[0], &ch, 1);
+    if (status <= 0) {
+        fprintf(stderr, "Error: lcm_memq_handle read 0 bytes from notify_pipe\n");
+        return -1;
+    }
+#endif
+    return 0;
 }
 
 static void lcm_memq_destroy(lcm_memq_t *self)
 {
     dbg(DBG_LCM, "destroying LCM memq provider context\n");
+#ifdef __linux__
+    if (self->notify_fd >= 0)
+        close(self->notify_fd);
+#else
     if (self->notify_pipe[0] >= 0)
         lcm_internal_pipe_close(self->notify_pipe[0]);
     if (self->notify_pipe[1] >= 0)
         lcm_internal_pipe_close(self->notify_pipe[1]);
+#endif
 
-    while (!g_queue_is_empty(self->queue)) {
-        memq_msg_t *msg = (memq_msg_t *) g_queue_pop_head(self->queue);
-        memq_msg_destroy(msg);
+    for (; (gint) self->head != self->tail; self->head++)
+        memq_msg_release(&self->ring[self->head % MEMQ_RING_SIZE].msg);
+    for (int i = 0; i < MEMQ_RING_SIZE; i++)
+        free(self->ring[i].buf);
+    free(self->ring);
+    while (!g_queue_is_empty(self->overflow)) {
+        memq_msg_t *msg = (memq_msg_t *) g_queue_pop_head(self->overflow);
+        memq_msg_release(msg);
+        free(msg);
     }
-    g_queue_free(self->queue);
+    g_queue_free(self->overflow);
     g_mutex_clear(&self->mutex);
+    g_rec_mutex_clear(&self->inline_mutex);
     memset(self, 0, sizeof(lcm_memq_t));
     free(self);
 }
 
+static void new_argument(gpointer key, gpointer value, gpointer user)
+{
+    lcm_memq_t *self = (lcm_memq_t *) user;
+    if (!strcmp((char *) key, "dispatch")) {
+        if (!strcmp((char *) value, "inline"))
+            self->dispatch_inline = 1;
+        else if (!strcmp((char *) value, "queue"))
+            self->dispatch_inline = 0;
+        else
+            fprintf(stderr, "Warning: Invalid value for dispatch\n");
+    } else {
+        fprintf(stderr, "%s:%d -- unknown provider argument %s\n", __FILE__, __LINE__,
+                (char *) key);
+    }
+}
+
 static lcm_provider_t *lcm_memq_create(lcm_t *parent, const char *target, const GHashTable *args)
 {
     (void) target;
-    (void) args;
     lcm_memq_t *self = (lcm_memq_t *) calloc(1, sizeof(lcm_memq_t));
     self->lcm = parent;
-    self->queue = g_queue_new();
+    self->ring = (memq_slot_t *) calloc(MEMQ_RING_SIZE, sizeof(memq_slot_t));
+    for (int i = 0; i < MEMQ_RING_SIZE; i++)
+        self->ring[i].seq = i;
+    self->overflow = g_queue_new();
     g_mutex_init(&self->mutex);
+    g_rec_mutex_init(&self->inline_mutex);
+    g_queue_init(&self->inline_queue);
+    g_hash_table_foreach((GHashTable *) args, new_argument, self);
 
     dbg(DBG_LCM, "Initializing LCM memq provider context...\n");
 
+#ifdef __linux__
+    self->notify_fd = eventfd(0, EFD_CLOEXEC);
+    if (self->notify_fd < 0) {
+        perror(__FILE__ " - eventfd (notify)");
+        lcm_memq_destroy(self);
+        return NULL;
+    }
+#else
     if (lcm_internal_pipe_create(self->notify_pipe) != 0) {
         perror(__FILE__ " - pipe (notify)");
+        self->notify_pipe[0] = self->notify_pipe[1] = -1;
         lcm_memq_destroy(self);
         return NULL;
     }
+#endif
     return self;
 }
 
 static int lcm_memq_get_fileno(lcm_memq_t *self)
 {
+#ifdef __linux__
+    return self->notify_fd;
+#else
     return self->notify_pipe[0];
+#endif
 }
 
-static int lcm_memq_handle(lcm_memq_t *self)
+static void memq_dispatch(lcm_memq_t *self, memq_msg_t *msg)
 {
-    char ch;
-    int status = lcm_internal_pipe_read(self->notify_pipe[0], &ch, 1);
-    if (status == 0) {
-        fprintf(stderr, "Error: lcm_memq_handle read 0 bytes from notify_pipe\n");
-        return -1;
+    // a message that couldn't be copied has no channel
+    if (msg->channel) {
+        dbg(DBG_LCM, "Dispatching message on channel [%s], size [%d]\n", msg->channel,
+            msg->rbuf.data_size);
+        if (lcm_try_enqueue_message(self->lcm, msg->channel))
+            lcm_dispatch_channel_handlers(self->lcm, &msg->rbuf, -1, msg->channel, &memq_lender,
+                                          msg);
     }
+    memq_msg_release(msg);
+}
+
+static int lcm_memq_handle_batch(lcm_memq_t *self, int max_msgs)
+{
+    if (0 != memq_wait(self))
+        return -1;
 
-    g_mutex_lock(&self->mutex);
-    memq_msg_t *msg = (memq_msg_t *) g_queue_pop_head(self->queue);
-    if (!g_queue_is_empty(self->queue)) {
-        if (lcm_internal_pipe_write(self->notify_pipe[1], "+", 1) < 0) {
-            perror(__FILE__ " - write to notify pipe (lcm_memq_handle)");
+    // Messages published by the handlers below are left for the next call.
+    // Each message that is pending is either in a slot between head and tail,
+    // or in the overflow queue, whose messages all came after those.
+    int nmsgs = MIN(max_msgs, g_atomic_int_get(&self->pending));
+    for (int i = 0; i < nmsgs; i++) {
+        if ((gint) self->head != g_atomic_int_get(&self->tail)) {
+            memq_slot_t *slot = &self->ring[self->head % MEMQ_RING_SIZE];
+            // the publisher that claimed the slot may still be filling it in
+            while (g_atomic_int_get(&slot->seq) != (gint) (self->head + 1))
+                g_thread_yield();
+            memq_dispatch(self, &slot->msg);
+            g_atomic_int_set(&slot->seq, (gint) (self->head + MEMQ_RING_SIZE));
+            self->head++;
+        } else {
+            g_mutex_lock(&self->mutex);
+            memq_msg_t *msg = (memq_msg_t *) g_queue_pop_head(self->overflow);
+            g_atomic_int_add(&self->overflow_len, -1);
+            g_mutex_unlock(&self->mutex);
+            memq_dispatch(self, msg);
+            free(msg);
         }
     }
-    g_mutex_unlock(&self->mutex);
 
-    dbg(DBG_LCM, "Dispatching message on channel [%s], size [%d]\n", msg->channel,
-        msg->rbuf.data_size);
+    // the publishers only notify when no messages were pending before theirs
+    if (g_atomic_int_add(&self->pending, -nmsgs) > nmsgs)
+        memq_notify(self);
+    return nmsgs;
+}
 
-    if (lcm_try_enqueue_message(self->lcm, msg->channel)) {
-        lcm_dispatch_handlers(self->lcm, &msg->rbuf, msg->channel);
+static int lcm_memq_handle(lcm_memq_t *self)
+{
+    return lcm_memq_handle_batch(self, 1) < 0 ? -1 : 0;
+}
+
+// Fills in a message that is handed over, or copies it, into a slot.
+static int memq_fill_slot(lcm_memq_t *self, memq_slot_t *slot, const char *channel,
+                          const void *data, unsigned int datalen, lcm_buffer_release_t release,
+                          void *user)
+{
+    memq_msg_t *msg = &slot->msg;
+    msg->rbuf.data = (void *) data;
+    msg->rbuf.data_size = datalen;
+    msg->rbuf.lcm = self->lcm;
+    msg->release = release;
+    msg->release_user = user;
+    msg->loan = NULL;
+    msg->channel = NULL;
+
+    size_t channel_size = strlen(channel) + 1;
+    int copy_into_slot = !release && datalen <= MEMQ_SLOT_DATA_MAX;
+    size_t size = channel_size + (copy_into_slot ? datalen : 0);
+    if (size > slot->buf_size) {
+        char *buf = (char *) realloc(slot->buf, size);
+        if (!buf)
+            return -1;
+        slot->buf = buf;
+        slot->buf_size = size;
     }
 
-    memq_msg_destroy(msg);
+    if (copy_into_slot) {
+        msg->rbuf.data = slot->buf;
+        memcpy(msg->rbuf.data, data, datalen);
+    } else if (!release) {
+        msg->rbuf.data = malloc(datalen);
+        if (!msg->rbuf.data)
+            return -1;
+        memcpy(msg->rbuf.data, data, datalen);
+        msg->release = memq_free_data;
+    }
+    msg->channel = slot->buf + (copy_into_slot ? datalen : 0);
+    memcpy(msg->channel, channel, channel_size);
     return 0;
 }
 
+// Allocates a message that holds a copy of data, or data itself if release is
+// set.  On failure, data is released.
+static memq_msg_t *memq_msg_copy(lcm_memq_t *self, const char *channel, const void *data,
+                                 unsigned int datalen, lcm_buffer_release_t release, void *user,
+                                 int64_t utime, int64_t mono_ns)
+{
+    memq_msg_t *msg = memq_msg_new(self->lcm, channel, release ? 0 : datalen);
+    if (!msg) {
+        if (release)
+            release((void *) data, user);
+        return NULL;
+    }
+    if (release) {
+        msg->rbuf.data = (void *) data;
+        msg->rbuf.data_size = datalen;
+        msg->release = release;
+        msg->release_user = user;
+    } else {
+        memcpy(msg->rbuf.data, data, datalen);
+    }
+    msg->rbuf.recv_utime = utime;
+    msg->rbuf.recv_time_ns = utime * 1000;
+    msg->rbuf.recv_mono_ns = mono_ns;
+    return msg;
+}
+
+// Dispatches a message before returning, for dispatch=inline.  Messages
+// published while it's dispatched are queued, and dispatched after it.
+static int memq_dispatch_inline(lcm_memq_t *self, const char *channel, const void *data,
+                                unsigned int datalen, lcm_buffer_release_t release, void *user)
+{
+    int64_t utime = g_get_real_time();
+    int64_t mono_ns = lcm_monotonic_ns();
+    g_rec_mutex_lock(&self->inline_mutex);
+    if (self->inline_depth > 0) {
+        memq_msg_t *queued =
+            memq_msg_copy(self, channel, data, datalen, release, user, utime, mono_ns);
+        if (queued)
+            g_queue_push_tail(&self->inline_queue, queued);
+        g_rec_mutex_unlock(&self->inline_mutex);
+        return queued ? 0 : -1;
+    }
+
+    self->inline_depth++;
+    memq_msg_t msg;
+    msg.channel = (char *) channel;
+    msg.rbuf.data = (void *) data;
+    msg.rbuf.data_size = datalen;
+    msg.rbuf.recv_utime = utime;
+    msg.rbuf.recv_time_ns = utime * 1000;
+    msg.rbuf.recv_mono_ns = mono_ns;
+    msg.rbuf.lcm = self->lcm;
+    msg.release = release;
+    msg.release_user = user;
+    msg.loan = NULL;
+    memq_dispatch(self, &msg);
+
+    memq_msg_t *queued;
+    while ((queued = (memq_msg_t *) g_queue_pop_head(&self->inline_queue))) {
+        memq_dispatch(self, queued);
+        free(queued);
+    }
+    self->inline_depth--;
+    g_rec_mutex_unlock(&self->inline_mutex);
+    return 0;
+}
+
+// Claims up to n consecutive free slots of the ring with a single
+// compare-and-swap, unless messages are waiting in the overflow queue.
+// Returns how many it claimed, the first of them at the position pos.
+static int memq_claim_slots(lcm_memq_t *self, int n, gint *pos)
+{
+    gint tail = g_atomic_int_get(&self->tail);
+    while (!g_atomic_int_get(&self->overflow_len)) {
+        memq_slot_t *first = &self->ring[(guint) tail % MEMQ_RING_SIZE];
+        gint diff = g_atomic_int_get(&first->seq) - tail;
+        if (diff < 0)
+            return 0;
+        if (diff == 0) {
+            int nfree = 1;
+            while (nfree < n &&
+                   g_atomic_int_get(&self->ring[(guint) (tail + nfree) % MEMQ_RING_SIZE].seq) ==
+                       tail + nfree)
+                nfree++;
+            if (g_atomic_int_compare_and_exchange(&self->tail, tail, tail + nfree)) {
+                *pos = tail;
+                return nfree;
+            }
+        }
+        tail = g_atomic_int_get(&self->tail);
+    }
+    return 0;
+}
+
+// Fills in the slot claimed at pos, and hands it over to lcm_memq_handle().
+static int memq_publish_slot(lcm_memq_t *self, gint pos, const char *channel, const void *data,
+                             unsigned int datalen, lcm_buffer_release_t release, void *user,
+                             int64_t utime, int64_t mono_ns)
+{
+    memq_slot_t *slot = &self->ring[(guint) pos % MEMQ_RING_SIZE];
+    int status = memq_fill_slot(self, slot, channel, data, datalen, release, user);
+    if (status != 0) {
+        // the slot is still published, and skipped when it's dispatched
+        memq_msg_release(&slot->msg);
+        slot->msg.channel = NULL;
+    }
+    slot->msg.rbuf.recv_utime = utime;
+    slot->msg.rbuf.recv_time_ns = utime * 1000;
+    slot->msg.rbuf.recv_mono_ns = mono_ns;
+    g_atomic_int_set(&slot->seq, pos + 1);
+    return status;
+}
+
+// Queues a message for lcm_memq_handle(), copying its data unless release is
+// set, in which case release is called once the data is no longer needed.
+static int memq_push(lcm_memq_t *self, const char *channel, const void *data,
+                     unsigned int datalen, lcm_buffer_release_t release, void *user)
+{
+    int64_t utime = g_get_real_time();
+    int64_t mono_ns = lcm_monotonic_ns();
+    int status = 0;
+
+    // claim the next slot, unless the ring is full or messages are waiting
+    // in the overflow queue
+    gint pos;
+    if (memq_claim_slots(self, 1, &pos)) {
+        status =
+            memq_publish_slot(self, pos, channel, data, datalen, release, user, utime, mono_ns);
+    } else {
+        memq_msg_t *msg =
+            memq_msg_copy(self, channel, data, datalen, release, user, utime, mono_ns);
+        if (!msg)
+            return -1;
+        g_mutex_lock(&self->mutex);
+        g_queue_push_tail(self->overflow, msg);
+        g_atomic_int_add(&self->overflow_len, 1);
+        g_mutex_unlock(&self->mutex);
+    }
+
+    if (g_atomic_int_add(&self->pending, 1) == 0)
+        memq_notify(self);
+    return status;
+}
+
 static int lcm_memq_publish(lcm_memq_t *self, const char *channel, const void *data,
                             unsigned int datalen)
 {
@@ -125,18 +535,163 @@ static int lcm_memq_publish(lcm_memq_t *self, const char *channel, const void *d
         return 0;
     }
     dbg(DBG_LCM, "Publishing to [%s] message size [%d]\n", channel, datalen);
-    memq_msg_t *msg = memq_msg_new(self->lcm, channel, data, datalen, g_get_real_time());
-
-    g_mutex_lock(&self->mutex);
-    int was_empty = g_queue_is_empty(self->queue);
-    g_queue_push_tail(self->queue, msg);
-    if (was_empty) {
-        if (lcm_internal_pipe_write(self->notify_pipe[1], "+", 1) < 0) {
-            perror(__FILE__ " - write to notify pipe (lcm_memq_publish)");
+    if (self->dispatch_inline)
+        return memq_dispatch_inline(self, channel, data, datalen, NULL, NULL);
+    return memq_push(self, channel, data, datalen, NULL, NULL);
+}
+
+static int lcm_memq_publish_async(lcm_memq_t *self, const char *channel, void *data,
+                                  unsigned int datalen, lcm_buffer_release_t release, void *user)
+{
+    if (!release)
+        return lcm_memq_publish(self, channel, data, datalen);
+    if (!lcm_has_handlers(self->lcm, channel)) {
+        dbg(DBG_LCM, "Publishing [%s] size [%d] - dropping (no subscribers)\n", channel, datalen);
+        release(data, user);
+        return 0;
+    }
+    dbg(DBG_LCM, "Publishing to [%s] message size [%d]\n", channel, datalen);
+    if (self->dispatch_inline)
+        return memq_dispatch_inline(self, channel, data, datalen, release, user);
+    return memq_push(self, channel, data, datalen, release, user);
+}
+
+// Queues the messages that have subscribers with a single compare-and-swap
+// for the slots that they fit into, and a single lock of the overflow queue
+// for the rest, and notifies lcm_memq_handle() once.
+static int lcm_memq_publish_batch(lcm_memq_t *self, const lcm_publish_msg_t *msgs, int num_msgs)
+{
+    if (self->dispatch_inline) {
+        int status = 0;
+        for (int i = 0; i < num_msgs; i++) {
+            if (0 != lcm_memq_publish(self, msgs[i].channel, msgs[i].data, msgs[i].datalen))
+                status = -1;
         }
+        return status;
     }
-    g_mutex_unlock(&self->mutex);
-    return 0;
+
+    int64_t utime = g_get_real_time();
+    int64_t mono_ns = lcm_monotonic_ns();
+    int status = 0;
+    int i = 0;
+    int npublished = 0;
+    while (i < num_msgs) {
+        // the next run of messages that have subscribers
+        while (i < num_msgs && !lcm_has_handlers(self->lcm, msgs[i].channel))
+            i++;
+        int n = 0;
+        while (i + n < num_msgs && lcm_has_handlers(self->lcm, msgs[i + n].channel))
+            n++;
+        if (!n)
+            break;
+
+        gint pos;
+        int nslots = memq_claim_slots(self, n, &pos);
+        for (int j = 0; j < nslots; j++) {
+            const lcm_publish_msg_t *msg = &msgs[i + j];
+            if (0 != memq_publish_slot(self, pos + j, msg->channel, msg->data, msg->datalen, NULL,
+                                       NULL, utime, mono_ns))
+                status = -1;
+        }
+        npublished += nslots;
+        i += nslots;
+        if (nslots == n)
+            continue;
+
+        // the ring is full, so the rest go to the overflow queue
+        GQueue overflowed = G_QUEUE_INIT;
+        for (; i < num_msgs; i++) {
+            const lcm_publish_msg_t *msg = &msgs[i];
+            if (!lcm_has_handlers(self->lcm, msg->channel))
+                continue;
+            memq_msg_t *copy = memq_msg_copy(self, msg->channel, msg->data, msg->datalen, NULL,
+                                             NULL, utime, mono_ns);
+            if (copy)
+                g_queue_push_tail(&overflowed, copy);
+            else
+                status = -1;
+        }
+        g_mutex_lock(&self->mutex);
+        int noverflowed = overflowed.length;
+        memq_msg_t *copy;
+        while ((copy = (memq_msg_t *) g_queue_pop_head(&overflowed)))
+            g_queue_push_tail(self->overflow, copy);
+        g_atomic_int_add(&self->overflow_len, noverflowed);
+        g_mutex_unlock(&self->mutex);
+        npublished += noverflowed;
+    }
+
+    if (npublished && g_atomic_int_add(&self->pending, npublished) == 0)
+        memq_notify(self);
+    return status;
+}
+
+static void *lcm_memq_publish_reserve(lcm_memq_t *self, const char *channel, unsigned int maxlen)
+{
+    memq_msg_t *msg = memq_msg_new(self->lcm, channel, maxlen);
+    return msg ? msg->rbuf.data : NULL;
+}
+
+static int lcm_memq_publish_commit(lcm_memq_t *self, void *buf, unsigned int datalen)
+{
+    memq_msg_t *msg = (memq_msg_t *) buf - 1;
+    if (datalen > msg->rbuf.data_size) {
+        fprintf(stderr, "Error: committed %u bytes of %u reserved\n", datalen,
+                msg->rbuf.data_size);
+        free(msg);
+        return -1;
+    }
+    // the reserved buffer is handed over rather than copied
+    return lcm_memq_publish_async(self, msg->channel, buf, datalen, memq_free_reserved, NULL);
+}
+
+static void lcm_memq_publish_cancel(lcm_memq_t *self, void *buf)
+{
+    (void) self;
+    free((memq_msg_t *) buf - 1);
+}
+
+// the publisher of lcm_publisher_create(), which remembers whether the channel
+// has subscribers until they change
+typedef struct {
+    const char *channel;
+    lcm_handlers_cache_t handlers;
+} memq_publisher_t;
+
+static void *lcm_memq_publisher_create(lcm_memq_t *self, const char *channel)
+{
+    (void) self;
+    memq_publisher_t *pub = (memq_publisher_t *) calloc(1, sizeof(memq_publisher_t));
+    pub->channel = channel;
+    pub->handlers.has_handlers = -1;
+    return pub;
+}
+
+static int lcm_memq_publisher_publish(lcm_memq_t *self, void *publisher, const void *data,
+                                      unsigned int datalen)
+{
+    memq_publisher_t *pub = (memq_publisher_t *) publisher;
+    if (!lcm_has_handlers_cached(self->lcm, pub->channel, &pub->handlers)) {
+        dbg(DBG_LCM, "Publishing [%s] size [%d] - dropping (no subscribers)\n", pub->channel,
+            datalen);
+        return 0;
+    }
+    dbg(DBG_LCM, "Publishing to [%s] message size [%d]\n", pub->channel, datalen);
+    if (self->dispatch_inline)
+        return memq_dispatch_inline(self, pub->channel, data, datalen, NULL, NULL);
+    return memq_push(self, pub->channel, data, datalen, NULL, NULL);
+}
+
+static int lcm_memq_publisher_has_subscribers(lcm_memq_t *self, void *publisher)
+{
+    memq_publisher_t *pub = (memq_publisher_t *) publisher;
+    return lcm_has_handlers_cached(self->lcm, pub->channel, &pub->handlers);
+}
+
+static void lcm_memq_publisher_destroy(lcm_memq_t *self, void *publisher)
+{
+    (void) self;
+    free(publisher);
 }
 
 #ifdef WIN32
@@ -150,6 +705,16 @@ static lcm_provider_vtable_t memq_vtable = {
     .publish = lcm_memq_publish,
     .handle = lcm_memq_handle,
     .get_fileno = lcm_memq_get_fileno,
+    .handle_batch = lcm_memq_handle_batch,
+    .publish_async = lcm_memq_publish_async,
+    .publish_reserve = lcm_memq_publish_reserve,
+    .publish_commit = lcm_memq_publish_commit,
+    .publish_cancel = lcm_memq_publish_cancel,
+    .publish_batch = lcm_memq_publish_batch,
+    .publisher_create = lcm_memq_publisher_create,
+    .publisher_publish = lcm_memq_publisher_publish,
+    .publisher_destroy = lcm_memq_publisher_destroy,
+    .publisher_has_subscribers = lcm_memq_publisher_has_subscribers,
 };
 #endif
 static lcm_provider_info_t memq_info;
@@ -164,6 +729,16 @@ void lcm_memq_provider_init(GPtrArray *providers)
     memq_vtable.publish = lcm_memq_publish;
     memq_vtable.handle = lcm_memq_handle;
     memq_vtable.get_fileno = lcm_memq_get_fileno;
+    memq_vtable.handle_batch = lcm_memq_handle_batch;
+    memq_vtable.publish_async = lcm_memq_publish_async;
+    memq_vtable.publish_reserve = lcm_memq_publish_reserve;
+    memq_vtable.publish_commit = lcm_memq_publish_commit;
+    memq_vtable.publish_cancel = lcm_memq_publish_cancel;
+    memq_vtable.publish_batch = lcm_memq_publish_batch;
+    memq_vtable.publisher_create = lcm_memq_publisher_create;
+    memq_vtable.publisher_publish = lcm_memq_publisher_publish;
+    memq_vtable.publisher_destroy = lcm_memq_publisher_destroy;
+    memq_vtable.publisher_has_subscribers = lcm_memq_publisher_has_subscribers;
 #endif
     memq_info.name = "memq";
     memq_info.vtable = &memq_vtable;
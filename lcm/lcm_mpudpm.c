@@ -1,3 +1,8 @@
+#ifdef __linux__
+// sendmmsg() is a GNU extension
+#define _GNU_SOURCE
+#endif
+
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -24,9 +29,14 @@
 #include "lcm_internal.h"
 #include "lcmtypes/channel_port_map_update_t.h"
 #include "ringbuffer.h"
+#include "udpm_uring.h"
 #include "udpm_util.h"
 
 // Lets reserve channels starting with #! for internal use
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+#define USE_SENDMMSG
+#endif
+
 #define RESERVED_CHANNEL_PREFIX "#!"
 // The number of LCM channels that we use internally for stuff.
 // Updating the channel to port map efficiently depends on this number
@@ -39,8 +49,67 @@
 // regex to check with the channel is a string literal
 #define REGEX_FINDER_RE "[^\\\\][\\.\\[\\{\\(\\)\\\\\\*\\+\\?\\|\\^\\$]"
 
-// broadcast channel to port mapping this frequently
-#define CHANNEL_TO_PORT_MAP_UPDATE_NOMINAL_PERIOD 5e6
+// broadcast all of the channel to port mapping this frequently.  Changes to
+// it are broadcast right away, so this only repairs lost updates.
+#define CHANNEL_TO_PORT_MAP_UPDATE_NOMINAL_PERIOD 30e6
+
+// ask a process for all of its mappings at most this often, when an update
+// from it was lost
+#define CHANNEL_TO_PORT_MAP_REQUEST_PERIOD 1e6
+
+// measure the bandwidth published on each channel over this period
+#define CHANNEL_RATE_WINDOW 1e6
+
+// channels published with this many bytes/s get a port of their own with the
+// port_assign=load option, unless heavy_rate says otherwise
+#define DEFAULT_HEAVY_RATE 10000000
+
+typedef struct _lcm_provider_t lcm_mpudpm_t;
+
+/**
+ * mpudpm_recv_thread_t:
+ * A thread that reads from some of the receive sockets, and the buffers it
+ * fills.  All fragments of a message arrive on the same port, so each thread
+ * reassembles messages in a fragment store of its own.  Once the thread is
+ * running, only it touches the ring buffer, the inbufs_empty queue and the
+ * fragment store, so none of them needs locking.
+ */
+typedef struct _mpudpm_recv_thread_t mpudpm_recv_thread_t;
+struct _mpudpm_recv_thread_t {
+    lcm_mpudpm_t *lcm;
+    GThread *thread;
+    int thread_msg_pipe[2];  // pipe to notify the thread when to cancel a
+                             // wait or terminate
+    lcm_poller_t *poller;    // waits on the sockets and thread_msg_pipe
+#ifdef USE_IO_URING
+    lcm_uring_t *uring;  // receives instead of the poller, with io_uring=1
+#endif
+
+    /* Guarded by the receive_lock: the sockets that were assigned to this
+     * thread or closed since it last updated its poller, and the number of
+     * open sockets assigned to it. */
+    GSList *recv_sockets_added;
+    GSList *recv_sockets_removed;
+    int num_sockets;
+
+    /* Packet structures available for receiving use are stored in the
+     * *_empty queue. */
+    lcm_buf_queue_t *inbufs_empty;
+    /* Received packets that are filled with data are handed from the read
+     * thread to lcm_handle() through these lock-free queues, one for each
+     * priority class... */
+    lcm_buf_ring_t *inbufs_filled[LCM_MAX_PRIORITY + 1];
+    /* ...and come back through this one once they have been dispatched, or
+     * through returns once the handlers that retained them release them. */
+    lcm_buf_ring_t *inbufs_done;
+    lcm_buf_returns_t returns;
+
+    /* Memory for received small packets is taken from a fixed-size ring buffer
+     * so we don't have to do any mallocs */
+    lcm_ringbuf_t *ringbuf;
+
+    lcm_frag_buf_store *frag_bufs;
+};
 
 /**
  * mpudpm_socket_t:
@@ -48,11 +117,16 @@
  * @port                multicast port
  * @num_subscribers     the number of subscribers to enable closing this socket
  *                             when it's no longer in use
+ * @kernel_drops        the datagrams dropped by the kernel on this socket, as
+ *                             last reported with SO_RXQ_OVFL
+ * @owner               the read thread that reads from this socket
  */
 typedef struct _mpudpm_socket_t {
     SOCKET fd;
     uint16_t port;
     int num_subscribers;
+    uint32_t kernel_drops;
+    mpudpm_recv_thread_t *owner;
 } mpudpm_socket_t;
 
 /**
@@ -61,14 +135,68 @@ typedef struct _mpudpm_socket_t {
  * @regex           Compiled regex to match explicit channels to this subscriber
  * @sockets         The list of sockets that are used for this subscription
  * @channel_set     Set of active channels that the channel_regex matches
+ * @resolved        Number of channels of the channel_list that the regex was
+ *                  matched against.  Those that are not in @channel_set didn't
+ *                  match, and aren't matched again.
  */
 typedef struct _mpudpm_subscriber_t {
     char *channel_string;
     GRegex *regex;            // compiled regex for the channel_string (if it's a regex)
     GSList *sockets;          // type: mpudpm_socket_t
-    GHashTable *channel_set;  // GHashTable used as a set (value points to key)
+    GHashTable *channel_set;  // type: char* -> uint16_t port (via GUINT_TO_POINTER macro)
+    guint resolved;
 } mpudpm_subscriber_t;
 
+/**
+ * mpudpm_port_pin_t:
+ * @regex       Compiled regex of the channels that are pinned
+ * @first_port  First port of the range that the pinned channels are hashed to
+ * @num_ports   Number of ports in that range
+ */
+typedef struct _mpudpm_port_pin_t {
+    GRegex *regex;
+    uint16_t first_port;
+    uint16_t num_ports;
+} mpudpm_port_pin_t;
+
+/**
+ * mpudpm_map_sender_t:
+ * @version     Version of the sender's mappings after its last update
+ * @last_utime  When the last update of the sender was received
+ * @request_utime  When all of the sender's mappings were last requested
+ */
+typedef struct _mpudpm_map_sender_t {
+    int32_t version;
+    int64_t last_utime;
+    int64_t request_utime;
+} mpudpm_map_sender_t;
+
+/**
+ * mpudpm_channel_t:
+ * @channel          The channel, which is also its key in the channel_to_port_map
+ * @index            Position of the channel in the channel_list
+ * @port             The multicast port that the channel is sent to
+ * @pinned           The port comes from a port pin, and is never moved
+ * @bandwidth        Bytes/s last reported by another process publishing the channel
+ * @bandwidth_utime  When @bandwidth was reported
+ * @tx_bytes         Bytes published on the channel since @tx_start_utime
+ * @tx_start_utime   Start of the current CHANNEL_RATE_WINDOW
+ * @tx_rate          Bytes/s published on the channel in the last window
+ * @changed          The channel is in map_changes
+ */
+typedef struct _mpudpm_channel_t {
+    const char *channel;
+    guint index;
+    uint16_t port;
+    int8_t pinned;
+    int32_t bandwidth;
+    int64_t bandwidth_utime;
+    int64_t tx_bytes;
+    int64_t tx_start_utime;
+    int32_t tx_rate;
+    int8_t changed;
+} mpudpm_channel_t;
+
 /**
  * mpudpm_params_t:
  * @mc_addr:              multicast address
@@ -80,6 +208,27 @@ typedef struct _mpudpm_subscriber_t {
  *                        don't use > 1.  that's just rude.
  * @recv_buf_size:        requested size of the kernel receive buffer, set with
  *                        SO_RCVBUF.  0 indicates to use the default settings.
+ * @packet_size:          largest UDP payload of a transmitted datagram.  Larger
+ *                        messages are fragmented to fit.
+ * @recv_sched:           CPU and priority of the read thread.
+ * @recv_threads:         number of threads reading from the receive sockets,
+ *                        each of which reads from some of the ports.
+ * @compress_re:          channels whose fragmented messages are sent LZ4
+ *                        compressed, or NULL.
+ * @port_pins:            the mpudpm_port_pin_t of the port_pins option, which
+ *                        are tried in order before hashing a channel
+ * @port_pins_file:       the mpudpm_port_pin_t of the port_pins_file option,
+ *                        moved to the end of @port_pins once all are parsed
+ * @load_aware:           if set, channels are kept off the ports of channels
+ *                        published with at least @heavy_rate bytes/s, and
+ *                        channels published that heavily are moved to ports
+ *                        of their own.
+ * @heavy_rate:           see @load_aware
+ * @io_uring:             if 1, the read threads receive through an io_uring.
+ * @align:                alignment in bytes of the payloads that are
+ *                        dispatched, or 1 for none.
+ * @group_per_port:       if set, each port has a multicast group of its own,
+ *                        @mc_addr plus its offset in the range.
  *
  */
 typedef struct _mpudpm_params_t mpudpm_params_t;
@@ -89,9 +238,19 @@ struct _mpudpm_params_t {
     uint16_t num_mc_ports;
     uint8_t mc_ttl;
     int recv_buf_size;
+    int packet_size;
+    lcm_thread_sched_t recv_sched;
+    int recv_threads;
+    GRegex *compress_re;
+    GSList *port_pins;
+    GSList *port_pins_file;
+    int8_t load_aware;
+    int32_t heavy_rate;
+    int io_uring;
+    int align;
+    int8_t group_per_port;
 };
 
-typedef struct _lcm_provider_t lcm_mpudpm_t;
 struct _lcm_provider_t {
     lcm_t *lcm;
     mpudpm_params_t params;
@@ -102,6 +261,11 @@ struct _lcm_provider_t {
 
     int64_t channel_to_port_map_update_period;
 
+    /* the ports of the range that are not pinned, which the other channels are
+     * hashed to */
+    uint16_t *hash_ports;
+    int num_hash_ports;
+
     /***********************************************************
      *  begin variables guarded by receive_lock
      *  Access to the following members must be guarded by the receive_lock */
@@ -109,29 +273,22 @@ struct _lcm_provider_t {
 
     /* list of mpudpm_socket_t structs */
     GSList *recv_sockets;
-    /* flag for whether the subscriptions have changed since they were last
-     * accessed. must be protected by the receive_lock.*/
-    int8_t recv_sockets_changed;
 
     /* list of mpudpm_subscriber_t structs */
     GSList *subscribers;
 
-    /* Packet structures available for sending or receiving use are
-     * stored in the *_empty queues. */
-    lcm_buf_queue_t *inbufs_empty;
-    /* Received packets that are filled with data are queued here. */
-    lcm_buf_queue_t *inbufs_filled;
-
-    /* Memory for received small packets is taken from a fixed-size ring buffer
-     * so we don't have to do any mallocs */
-    lcm_ringbuf_t *ringbuf;
-
     /* Indicates whether the receive thread was successfully created */
     int8_t recv_thread_created;
 
     /* END VARIABLES GUARDED BY receive_lock
      **************************************************************/
 
+    /* The read threads, and the next one that lcm_handle() takes a
+     * message from, so that it takes turns between them. */
+    mpudpm_recv_thread_t *recv_threads;
+    int num_recv_threads;
+    int next_recv_thread;
+
     /***********************************************************
      *  begin variables guarded by transmit_lock
      *  Access to the following members must be guarded by the transmit_lock
@@ -145,12 +302,31 @@ struct _lcm_provider_t {
     struct sockaddr_in dest_addr;
 
     /* Hash table for mapping between channel and destination addresses
-     * type: char* -> uint16_t (via GUINT_TO_POINTER macro)*/
+     * type: char* -> mpudpm_channel_t* */
     GHashTable *channel_to_port_map;
+    /* the entries of the channel_to_port_map, in the order they were added,
+     * which the regexes of subscribers are matched against as they come
+     * type: mpudpm_channel_t* */
+    GPtrArray *channel_list;
+
+    /* set when a channel was moved to another port by the publishing thread,
+     * which then updates the subscriptions once it released the lock */
+    int8_t channel_moved;
 
     /* Last time the channel_to_port mapping was broadcast by someone */
     int64_t last_mapping_update_utime;
 
+    /* random id that the channel_to_port mapping updates of this instance are
+     * sent with, and the version of the mappings that it added or moved */
+    int64_t map_sender_id;
+    int32_t map_version;
+    /* channels that this instance added or moved since its last update
+     * type: mpudpm_channel_t* */
+    GPtrArray *map_changes;
+    /* the versions of the other instances' mappings
+     * type: int64_t sender id -> mpudpm_map_sender_t* */
+    GHashTable *map_senders;
+
     /* rolling counter of how many messages transmitted */
     uint32_t msg_seqno;
 
@@ -159,10 +335,8 @@ struct _lcm_provider_t {
     /* END VARIABLES GUARDED BY transmit_lock
      **************************************************************/
 
-    GThread *read_thread;
-    int notify_pipe[2];      // pipe to notify application when messages arrive
-    int thread_msg_pipe[2];  // pipe to notify read thread when to cancel a
-                             // select or terminate
+    int notify_pipe[2];  // pipe to notify application when messages arrive
+    int notified;        // whether there is a notification in notify_pipe
 
     /* synchronization variables used only while allocating receive resources
      */
@@ -172,13 +346,10 @@ struct _lcm_provider_t {
     GMutex *p_create_read_thread_mutex;
 
     /* other variables */
-    lcm_frag_buf_store *frag_bufs;
+    lcm_buf_pool_t *frag_pool;  // recycles the payload buffers of fragmented messages
 
-    uint32_t udp_rx;             // packets received and processed
-    uint32_t udp_discarded_bad;  // packets discarded because they were bad
-    // somehow
-    double udp_low_watermark;  // least buffer available
-    int32_t udp_last_report_secs;
+    // counters for lcm_get_stats(), updated with lcm_stat_add()
+    lcm_stats_t stats;
 
     // regex to check whether a passed in channel is a regex :-)
     GRegex *regex_finder_re;
@@ -192,10 +363,12 @@ static int lcm_mpudpm_unsubscribe(lcm_mpudpm_t *lcm, const char *channel);
 static int publish_message_internal(lcm_mpudpm_t *lcm, const char *channel, const void *data,
                                     unsigned int datalen);
 static void publish_channel_mapping_update(lcm_mpudpm_t *lcm);
+static void publish_channel_mapping_changes(lcm_mpudpm_t *lcm);
+static void request_channel_mapping_update(lcm_mpudpm_t *lcm, int64_t sender_id);
 static void channel_port_mapping_update_handler(lcm_mpudpm_t *lcm,
                                                 const channel_port_map_update_t *msg,
                                                 int64_t recv_time);
-static void update_subscription_ports(lcm_mpudpm_t *lcm);
+static void update_subscription_ports(lcm_mpudpm_t *lcm, const GPtrArray *channels);
 static void add_channel_to_subscriber(lcm_mpudpm_t *lcm, mpudpm_subscriber_t *sub,
                                       const char *channel, uint16_t port);
 
@@ -224,49 +397,111 @@ static void mpudpm_socket_t_destroy(mpudpm_socket_t *sock)
     free(sock);
 }
 
-static void destroy_recv_parts(lcm_mpudpm_t *lcm)
+static void mpudpm_port_pin_t_destroy(mpudpm_port_pin_t *pin)
 {
-    if (lcm->recv_thread_created) {
-        // send the read thread an exit command
-        int wstatus = lcm_internal_pipe_write(lcm->thread_msg_pipe[1], "\0", 1);
-        if (wstatus < 0) {
-            perror(__FILE__ " thread_msg_pipe write: terminate");
-        } else {
-            g_thread_join(lcm->read_thread);
-        }
-        lcm->read_thread = NULL;
-        lcm->recv_thread_created = 0;
+    g_regex_unref(pin->regex);
+    free(pin);
+}
+
+static void mpudpm_params_t_clear(mpudpm_params_t *params)
+{
+    if (params->compress_re != NULL)
+        g_regex_unref(params->compress_re);
+    g_slist_free_full(params->port_pins, (GDestroyNotify) mpudpm_port_pin_t_destroy);
+    g_slist_free_full(params->port_pins_file, (GDestroyNotify) mpudpm_port_pin_t_destroy);
+}
+
+// Frees the parts of a read thread, which must not be running anymore.
+static void destroy_recv_thread(mpudpm_recv_thread_t *rt)
+{
+#ifdef USE_IO_URING
+    if (rt->uring) {
+        lcm_uring_destroy(rt->uring);
+        rt->uring = NULL;
+    }
+#endif
+    if (rt->poller) {
+        lcm_poller_destroy(rt->poller);
+        rt->poller = NULL;
+    }
+
+    if (rt->thread_msg_pipe[0] >= 0) {
+        lcm_internal_pipe_close(rt->thread_msg_pipe[0]);
+        lcm_internal_pipe_close(rt->thread_msg_pipe[1]);
+        rt->thread_msg_pipe[0] = rt->thread_msg_pipe[1] = -1;
     }
 
-    if (lcm->thread_msg_pipe[0] >= 0) {
-        lcm_internal_pipe_close(lcm->thread_msg_pipe[0]);
-        lcm_internal_pipe_close(lcm->thread_msg_pipe[1]);
-        lcm->thread_msg_pipe[0] = lcm->thread_msg_pipe[1] = -1;
+    // the sockets that the thread did not get to unregister are destroyed here
+    g_slist_free_full(rt->recv_sockets_removed, (GDestroyNotify) mpudpm_socket_t_destroy);
+    g_slist_free(rt->recv_sockets_added);
+    rt->recv_sockets_removed = rt->recv_sockets_added = NULL;
+
+    if (rt->frag_bufs) {
+        lcm_frag_buf_store_destroy(rt->frag_bufs);
+        rt->frag_bufs = NULL;
     }
 
-    if (lcm->subscribers) {
-        for (GSList *it = lcm->subscribers; it != NULL; it = it->next) {
-            mpudpm_subscriber_t *sub = (mpudpm_subscriber_t *) it->data;
-            lcm_mpudpm_unsubscribe(lcm, sub->channel_string);
+    if (rt->inbufs_empty) {
+        lcm_buf_queue_free(rt->inbufs_empty, rt->ringbuf);
+        rt->inbufs_empty = NULL;
+    }
+    if (rt->inbufs_done) {
+        lcm_buf_ring_free(rt->inbufs_done, rt->ringbuf);
+        rt->inbufs_done = NULL;
+    }
+    lcm_buf_returns_clear(&rt->returns, rt->ringbuf);
+    for (int i = 0; i <= LCM_MAX_PRIORITY; i++) {
+        if (rt->inbufs_filled[i]) {
+            lcm_buf_ring_free(rt->inbufs_filled[i], rt->ringbuf);
+            rt->inbufs_filled[i] = NULL;
         }
-        g_slist_free(lcm->subscribers);
     }
+    if (rt->ringbuf) {
+        lcm_ringbuf_free(rt->ringbuf);
+        rt->ringbuf = NULL;
+    }
+}
 
-    if (lcm->frag_bufs) {
-        lcm_frag_buf_store_destroy(lcm->frag_bufs);
+static void destroy_recv_parts(lcm_mpudpm_t *lcm)
+{
+    if (lcm->recv_thread_created) {
+        // send the read threads an exit command
+        for (int i = 0; i < lcm->num_recv_threads; i++) {
+            mpudpm_recv_thread_t *rt = &lcm->recv_threads[i];
+            if (!rt->thread)
+                continue;
+            int wstatus = lcm_internal_pipe_write(rt->thread_msg_pipe[1], "\0", 1);
+            if (wstatus < 0) {
+                perror(__FILE__ " thread_msg_pipe write: terminate");
+            } else {
+                g_thread_join(rt->thread);
+            }
+            rt->thread = NULL;
+        }
+        lcm->recv_thread_created = 0;
     }
 
-    if (lcm->inbufs_empty) {
-        lcm_buf_queue_free(lcm->inbufs_empty, lcm->ringbuf);
-        lcm->inbufs_empty = NULL;
+    // unsubscribing removes the subscriber from the list
+    while (lcm->subscribers) {
+        mpudpm_subscriber_t *sub = (mpudpm_subscriber_t *) lcm->subscribers->data;
+        lcm_mpudpm_unsubscribe(lcm, sub->channel_string);
     }
-    if (lcm->inbufs_filled) {
-        lcm_buf_queue_free(lcm->inbufs_filled, lcm->ringbuf);
-        lcm->inbufs_filled = NULL;
+
+    // the read threads have exited, so the sockets that are still open are
+    // destroyed here
+    g_slist_free_full(lcm->recv_sockets, (GDestroyNotify) mpudpm_socket_t_destroy);
+    lcm->recv_sockets = NULL;
+
+    if (lcm->recv_threads) {
+        for (int i = 0; i < lcm->num_recv_threads; i++)
+            destroy_recv_thread(&lcm->recv_threads[i]);
+        free(lcm->recv_threads);
+        lcm->recv_threads = NULL;
+        lcm->num_recv_threads = 0;
     }
-    if (lcm->ringbuf) {
-        lcm_ringbuf_free(lcm->ringbuf);
-        lcm->ringbuf = NULL;
+    if (lcm->frag_pool) {
+        lcm_buf_pool_destroy(lcm->frag_pool);
+        lcm->frag_pool = NULL;
     }
 }
 
@@ -281,6 +516,15 @@ static void lcm_mpudpm_destroy(lcm_mpudpm_t *lcm)
     if (lcm->channel_to_port_map != NULL) {
         g_hash_table_destroy(lcm->channel_to_port_map);
     }
+    if (lcm->channel_list != NULL) {
+        g_ptr_array_free(lcm->channel_list, TRUE);
+    }
+    if (lcm->map_changes != NULL) {
+        g_ptr_array_free(lcm->map_changes, TRUE);
+    }
+    if (lcm->map_senders != NULL) {
+        g_hash_table_destroy(lcm->map_senders);
+    }
 
     lcm_internal_pipe_close(lcm->notify_pipe[0]);
     lcm_internal_pipe_close(lcm->notify_pipe[1]);
@@ -296,6 +540,8 @@ static void lcm_mpudpm_destroy(lcm_mpudpm_t *lcm)
     if (lcm->regex_finder_re != NULL) {
         g_regex_unref(lcm->regex_finder_re);
     }
+    mpudpm_params_t_clear(&lcm->params);
+    free(lcm->hash_ports);
 
     free(lcm);
 }
@@ -313,10 +559,256 @@ static uint32_t mpudpm_str_hash(const char *str)
     return hash;
 }
 
+static int8_t is_reserved_channel(const char *channel)
+{
+    return (strncmp(RESERVED_CHANNEL_PREFIX, channel, strlen(RESERVED_CHANNEL_PREFIX)) == 0);
+}
+
+static const mpudpm_port_pin_t *find_port_pin(lcm_mpudpm_t *lcm, const char *channel)
+{
+    for (GSList *it = lcm->params.port_pins; it != NULL; it = it->next) {
+        const mpudpm_port_pin_t *pin = (const mpudpm_port_pin_t *) it->data;
+        if (g_regex_match(pin->regex, channel, (GRegexMatchFlags) 0, NULL))
+            return pin;
+    }
+    return NULL;
+}
+
+// The bandwidth of a channel, as published by this process or as last
+// reported by another process that publishes it.  Old reports are ignored,
+// as that process may have stopped publishing.
+static int32_t channel_load(lcm_mpudpm_t *lcm, const mpudpm_channel_t *chan, int64_t now)
+{
+    if (now - chan->bandwidth_utime > 3 * lcm->channel_to_port_map_update_period)
+        return chan->tx_rate;
+    return MAX(chan->tx_rate, chan->bandwidth);
+}
+
+// Ends the CHANNEL_RATE_WINDOW of a channel if it is over, and returns
+// whether it did.  The caller must hold the transmit_lock.
+static int8_t channel_update_rate(mpudpm_channel_t *chan, int64_t now)
+{
+    int64_t elapsed = now - chan->tx_start_utime;
+    if (elapsed < CHANNEL_RATE_WINDOW)
+        return FALSE;
+    chan->tx_rate = (int32_t) MIN(chan->tx_bytes * 1000000 / elapsed, INT32_MAX);
+    chan->tx_bytes = 0;
+    chan->tx_start_utime = now;
+    return TRUE;
+}
+
+// Adds up the bandwidth and the number of the channels on each port of the
+// range, leaving out the channel @skip.  @load and @num_channels, which may be
+// NULL, have an entry for each port that the caller zeroes.  The caller must
+// hold the transmit_lock.
+static void get_port_loads(lcm_mpudpm_t *lcm, const char *skip, int64_t now, int64_t *load,
+                           int *num_channels)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, lcm->channel_to_port_map);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        const mpudpm_channel_t *chan = (const mpudpm_channel_t *) value;
+        int ind = chan->port - lcm->params.mc_port_range_start;
+        if ((skip && !strcmp((const char *) key, skip)) || ind < 0 ||
+            ind >= lcm->params.num_mc_ports) {
+            continue;
+        }
+        load[ind] += channel_load(lcm, chan, now);
+        if (num_channels)
+            num_channels[ind]++;
+    }
+}
+
+// Chooses the port for a channel that isn't in the channel_to_port_map yet.
+// Channels that match a port pin are hashed to the ports of the pin, and the
+// others to the ports that no pin uses.  With port_assign=load, ports that
+// already carry heavy_rate bytes/s are skipped if possible.  The caller must
+// hold the transmit_lock.
 static uint16_t map_channel_to_port(lcm_mpudpm_t *lcm, const char *channel)
 {
     uint32_t channel_hash = mpudpm_str_hash(channel);
-    return lcm->params.mc_port_range_start + channel_hash % lcm->params.num_mc_ports;
+    const mpudpm_port_pin_t *pin = find_port_pin(lcm, channel);
+    if (pin)
+        return pin->first_port + channel_hash % pin->num_ports;
+
+    int start = channel_hash % lcm->num_hash_ports;
+    uint16_t port = lcm->hash_ports[start];
+    if (lcm->params.load_aware) {
+        int64_t *load = (int64_t *) calloc(lcm->params.num_mc_ports, sizeof(int64_t));
+        get_port_loads(lcm, NULL, g_get_real_time(), load, NULL);
+        for (int i = 0; i < lcm->num_hash_ports; i++) {
+            uint16_t candidate = lcm->hash_ports[(start + i) % lcm->num_hash_ports];
+            if (load[candidate - lcm->params.mc_port_range_start] < lcm->params.heavy_rate) {
+                port = candidate;
+                break;
+            }
+        }
+        free(load);
+    }
+    return port;
+}
+
+// Queues a mapping that this instance added or moved for the next update.
+// The caller must hold the transmit_lock.
+static void mark_channel_changed(lcm_mpudpm_t *lcm, mpudpm_channel_t *chan)
+{
+    if (!chan->changed && !is_reserved_channel(chan->channel)) {
+        chan->changed = TRUE;
+        g_ptr_array_add(lcm->map_changes, chan);
+    }
+}
+
+// Adds a channel to the channel_to_port_map, on the given port, or on the one
+// that map_channel_to_port() chooses if that is 0.  The caller must hold the
+// transmit_lock.
+static mpudpm_channel_t *add_channel_mapping(lcm_mpudpm_t *lcm, const char *channel,
+                                             uint16_t port)
+{
+    mpudpm_channel_t *chan = (mpudpm_channel_t *) calloc(1, sizeof(mpudpm_channel_t));
+    chan->channel = strdup(channel);
+    chan->port = port ? port : map_channel_to_port(lcm, channel);
+    chan->pinned = find_port_pin(lcm, channel) != NULL;
+    chan->index = lcm->channel_list->len;
+    g_hash_table_insert(lcm->channel_to_port_map, (char *) chan->channel, chan);
+    g_ptr_array_add(lcm->channel_list, chan);
+    if (!port)
+        mark_channel_changed(lcm, chan);
+    return chan;
+}
+
+// Moves a channel that this process publishes with at least heavy_rate
+// bytes/s off a port that it shares with other channels, to a port of its own
+// if there is one, or else to the port with the least bandwidth, if that has
+// less than the current one.  Returns whether the channel was moved.  The
+// caller must hold the transmit_lock.
+static int8_t move_heavy_channel(lcm_mpudpm_t *lcm, const char *channel, mpudpm_channel_t *chan,
+                                 int64_t now)
+{
+    if (chan->pinned || chan->tx_rate < lcm->params.heavy_rate)
+        return FALSE;
+
+    int64_t *load = (int64_t *) calloc(lcm->params.num_mc_ports, sizeof(int64_t));
+    int *num_channels = (int *) calloc(lcm->params.num_mc_ports, sizeof(int));
+    get_port_loads(lcm, channel, now, load, num_channels);
+
+    int cur = chan->port - lcm->params.mc_port_range_start;
+    int best = -1;
+    if (cur >= 0 && cur < lcm->params.num_mc_ports && num_channels[cur] > 0) {
+        int start = mpudpm_str_hash(channel) % lcm->num_hash_ports;
+        for (int i = 0; i < lcm->num_hash_ports; i++) {
+            int ind = lcm->hash_ports[(start + i) % lcm->num_hash_ports] -
+                      lcm->params.mc_port_range_start;
+            if (num_channels[ind] == 0) {
+                best = ind;
+                break;
+            }
+            if (best < 0 || load[ind] < load[best])
+                best = ind;
+        }
+        if (best >= 0 && num_channels[best] > 0 && load[best] >= load[cur])
+            best = -1;
+    }
+    free(load);
+    free(num_channels);
+    if (best < 0)
+        return FALSE;
+
+    dbg(DBG_LCM, "Moving channel %s with %d B/s from port %d to %d\n", channel, chan->tx_rate,
+        chan->port, lcm->params.mc_port_range_start + best);
+    chan->port = lcm->params.mc_port_range_start + best;
+    return TRUE;
+}
+
+// Parses a port pin of the form REGEX:PORT or REGEX:FIRST-LAST, and appends
+// it to @pins.  Returns 0 on success, or -1 if it is invalid.
+static int parse_port_pin(const char *str, GSList **pins)
+{
+    const char *colon = strrchr(str, ':');
+    if (colon == NULL || colon == str)
+        return -1;
+    char *st = NULL;
+    long first = strtol(colon + 1, &st, 0);
+    long last = first;
+    if (st == colon + 1)
+        return -1;
+    if (*st == '-') {
+        const char *last_str = st + 1;
+        last = strtol(last_str, &st, 0);
+        if (st == last_str)
+            return -1;
+    }
+    if (*st != '\0' || first <= 0 || last > 65535 || last < first)
+        return -1;
+
+    char *regexbuf = g_strdup_printf("^%.*s$", (int) (colon - str), str);
+    GError *rerr = NULL;
+    GRegex *regex = g_regex_new(regexbuf, (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, &rerr);
+    g_free(regexbuf);
+    if (rerr) {
+        fprintf(stderr, "Warning: %s\n", rerr->message);
+        g_error_free(rerr);
+        return -1;
+    }
+    mpudpm_port_pin_t *pin = (mpudpm_port_pin_t *) calloc(1, sizeof(mpudpm_port_pin_t));
+    pin->regex = regex;
+    pin->first_port = first;
+    pin->num_ports = last - first + 1;
+    *pins = g_slist_append(*pins, pin);
+    return 0;
+}
+
+// Parses the port pins in @strs, skipping empty ones and # comments.
+static void parse_port_pins(char **strs, GSList **pins)
+{
+    for (char **str = strs; *str != NULL; str++) {
+        g_strstrip(*str);
+        if (**str == '\0' || **str == '#')
+            continue;
+        if (parse_port_pin(*str, pins) < 0)
+            fprintf(stderr, "Warning: Invalid port pin \"%s\"\n", *str);
+    }
+}
+
+// Drops the port pins that aren't within the port range, and collects the
+// ports that no pin uses into hash_ports.
+static void setup_port_pins(lcm_mpudpm_t *lcm)
+{
+    mpudpm_params_t *params = &lcm->params;
+    params->port_pins = g_slist_concat(params->port_pins, params->port_pins_file);
+    params->port_pins_file = NULL;
+
+    int8_t *pinned = (int8_t *) calloc(params->num_mc_ports, sizeof(int8_t));
+    GSList *it = params->port_pins;
+    while (it != NULL) {
+        GSList *next = it->next;
+        mpudpm_port_pin_t *pin = (mpudpm_port_pin_t *) it->data;
+        int first = pin->first_port - params->mc_port_range_start;
+        if (first < 0 || first + pin->num_ports > params->num_mc_ports) {
+            fprintf(stderr, "Warning: Ignoring port pin to ports %d-%d outside of %d-%d\n",
+                    pin->first_port, pin->first_port + pin->num_ports - 1,
+                    params->mc_port_range_start,
+                    params->mc_port_range_start + params->num_mc_ports - 1);
+            mpudpm_port_pin_t_destroy(pin);
+            params->port_pins = g_slist_delete_link(params->port_pins, it);
+        } else {
+            memset(pinned + first, 1, pin->num_ports);
+        }
+        it = next;
+    }
+
+    lcm->hash_ports = (uint16_t *) calloc(params->num_mc_ports, sizeof(uint16_t));
+    for (int i = 0; i < params->num_mc_ports; i++) {
+        if (!pinned[i])
+            lcm->hash_ports[lcm->num_hash_ports++] = params->mc_port_range_start + i;
+    }
+    if (lcm->num_hash_ports == 0) {
+        // the pins take up every port, so hash the other channels to all of them
+        for (int i = 0; i < params->num_mc_ports; i++)
+            lcm->hash_ports[i] = params->mc_port_range_start + i;
+        lcm->num_hash_ports = params->num_mc_ports;
+    }
+    free(pinned);
 }
 
 static int parse_mc_addr_and_port(const char *str, mpudpm_params_t *params)
@@ -347,6 +839,16 @@ fail:
     return -1;
 }
 
+// the multicast group of port, which is only joined by the processes that
+// subscribe to a channel on it
+static struct in_addr port_group(const mpudpm_params_t *params, uint16_t port)
+{
+    struct in_addr group = params->mc_addr;
+    if (params->group_per_port)
+        group.s_addr = htonl(ntohl(group.s_addr) + (port - params->mc_port_range_start));
+    return group;
+}
+
 static void new_argument(gpointer key, gpointer value, gpointer user)
 {
     mpudpm_params_t *params = (mpudpm_params_t *) user;
@@ -370,19 +872,90 @@ static void new_argument(gpointer key, gpointer value, gpointer user)
             fprintf(stderr, "Warning: num_ports must be > 0. Setting to 1\n");
             params->num_mc_ports = 1;
         }
+    } else if (!strcmp((char *) key, "recv_cpu") || !strcmp((char *) key, "recv_prio")) {
+        lcm_parse_thread_sched_arg(&params->recv_sched, (char *) key, (char *) value);
+    } else if (!strcmp((char *) key, "recv_threads")) {
+        char *endptr = NULL;
+        params->recv_threads = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->recv_threads < 1) {
+            fprintf(stderr, "Warning: Invalid value for recv_threads\n");
+            params->recv_threads = 1;
+        }
+    } else if (!strcmp((char *) key, "frag_size") || !strcmp((char *) key, "mtu")) {
+        int packet_size = lcm_parse_packet_size((char *) key, (char *) value);
+        if (packet_size == 0)
+            fprintf(stderr, "Warning: Invalid value for %s\n", (char *) key);
+        else
+            params->packet_size = packet_size;
+    } else if (!strcmp((char *) key, "compress")) {
+        params->compress_re = lcm_parse_compress_option((char *) value);
+    } else if (!strcmp((char *) key, "port_pins")) {
+        char **pins = g_strsplit((char *) value, ",", -1);
+        parse_port_pins(pins, &params->port_pins);
+        g_strfreev(pins);
+    } else if (!strcmp((char *) key, "port_pins_file")) {
+        char *contents = NULL;
+        GError *err = NULL;
+        if (!g_file_get_contents((char *) value, &contents, NULL, &err)) {
+            fprintf(stderr, "Warning: Invalid value for port_pins_file: %s\n", err->message);
+            g_error_free(err);
+        } else {
+            char **pins = g_strsplit(contents, "\n", -1);
+            parse_port_pins(pins, &params->port_pins_file);
+            g_strfreev(pins);
+            g_free(contents);
+        }
+    } else if (!strcmp((char *) key, "port_assign")) {
+        if (!strcmp((char *) value, "hash"))
+            params->load_aware = 0;
+        else if (!strcmp((char *) value, "load"))
+            params->load_aware = 1;
+        else
+            fprintf(stderr, "Warning: Invalid value for port_assign\n");
+    } else if (!strcmp((char *) key, "heavy_rate")) {
+        char *endptr = NULL;
+        long heavy_rate = strtol((char *) value, &endptr, 0);
+        if (endptr == value || heavy_rate <= 0 || heavy_rate > INT32_MAX)
+            fprintf(stderr, "Warning: Invalid value for heavy_rate\n");
+        else
+            params->heavy_rate = heavy_rate;
+    } else if (!strcmp((char *) key, "group_per_port")) {
+        char *endptr = NULL;
+        params->group_per_port = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->group_per_port < 0 || params->group_per_port > 1) {
+            fprintf(stderr, "Warning: Invalid value for group_per_port\n");
+            params->group_per_port = 0;
+        }
+    } else if (!strcmp((char *) key, "io_uring")) {
+        char *endptr = NULL;
+        params->io_uring = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->io_uring < 0 || params->io_uring > 1) {
+            fprintf(stderr, "Warning: Invalid value for io_uring\n");
+            params->io_uring = 0;
+        }
+#ifndef USE_IO_URING
+        if (params->io_uring) {
+            fprintf(stderr, "Warning: io_uring is not supported on this platform\n");
+            params->io_uring = 0;
+        }
+#endif
+    } else if (!strcmp((char *) key, "align")) {
+        char *endptr = NULL;
+        params->align = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->align < 1 || params->align > LCM_MAX_DATA_ALIGNMENT ||
+            (params->align & (params->align - 1))) {
+            fprintf(stderr, "Warning: Invalid value for align\n");
+            params->align = 1;
+        }
     } else {
         fprintf(stderr, "%s:%d -- unknown provider argument %s\n", __FILE__, __LINE__,
                 (char *) key);
     }
 }
 
-static int8_t is_reserved_channel(const char *channel)
-{
-    return (strncmp(RESERVED_CHANNEL_PREFIX, channel, strlen(RESERVED_CHANNEL_PREFIX)) == 0);
-}
-
-static int recv_message_fragment(lcm_mpudpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz)
+static int recv_message_fragment(mpudpm_recv_thread_t *rt, lcm_buf_t *lcmb, uint32_t sz)
 {
+    lcm_mpudpm_t *lcm = rt->lcm;
     lcm2_header_long_t *hdr = (lcm2_header_long_t *) lcmb->buf;
 
     // any existing fragment buffer for this message source?
@@ -390,7 +963,7 @@ static int recv_message_fragment(lcm_mpudpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz
     uint32_t msg_seqno = ntohl(hdr->msg_seqno);
     uint32_t data_size = ntohl(hdr->msg_size);
     uint32_t fragment_offset = ntohl(hdr->fragment_offset);
-    //    uint16_t fragment_no = ntohs (hdr->fragment_no);
+    uint16_t fragment_no = ntohs(hdr->fragment_no);
     uint16_t fragments_in_msg = ntohs(hdr->fragments_in_msg);
     uint32_t frag_size = sz - sizeof(lcm2_header_long_t);
     char *data_start = (char *) (hdr + 1);
@@ -399,15 +972,21 @@ static int recv_message_fragment(lcm_mpudpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz
     lcm_frag_key_t key;
     key.from = (struct sockaddr_in *) &(lcmb->from);
     key.msg_seqno = msg_seqno;
-    lcm_frag_buf_t *fbuf = lcm_frag_buf_store_lookup(lcm->frag_bufs, &key);
+    lcm_frag_buf_t *fbuf = lcm_frag_buf_store_lookup(rt->frag_bufs, &key);
 
     // discard any stale fragments from previous messages
-    if (fbuf && (fbuf->data_size != data_size)) {
-        lcm_frag_buf_store_remove(lcm->frag_bufs, fbuf);
+    if (fbuf && (fbuf->data_size != data_size || fbuf->fragments_in_msg != fragments_in_msg)) {
         dbg(DBG_LCM, "Dropping message (missing %d fragments)\n", fbuf->fragments_remaining);
+        lcm_frag_buf_store_remove(rt->frag_bufs, fbuf);
+        lcm_stat_add(&lcm->stats.messages_incomplete, 1);
         fbuf = NULL;
     }
 
+    // remaining fragments of a message that nobody here subscribes to
+    if (!fbuf && lcm_frag_buf_store_is_ignored(rt->frag_bufs, &key)) {
+        return 0;
+    }
+
     if (data_size > LCM_MAX_MESSAGE_SIZE) {
         dbg(DBG_LCM, "rejecting huge message (%d bytes)\n", data_size);
         return 0;
@@ -416,23 +995,35 @@ static int recv_message_fragment(lcm_mpudpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz
     // if this is the first packet, set some values
     char *channel = NULL;
     int channel_sz = 0;
-    if (hdr->fragment_no == 0) {
+    if (fragment_no == 0) {
         channel = (char *) (hdr + 1);
         channel_sz = strlen(channel);
         if (channel_sz > LCM_MAX_CHANNEL_NAME_LENGTH) {
             dbg(DBG_LCM, "bad channel name length\n");
-            lcm->udp_discarded_bad++;
+            lcm_stat_add(&lcm->stats.packets_bad, 1);
             return 0;
         }
         data_start += channel_sz + 1;
         frag_size -= (channel_sz + 1);
+
+        // Skip reassembly of messages that nobody here subscribes to.  Any
+        // fragments that arrived before this one were buffered like any
+        // other partial message, and are bounded by the store's limits.
+        if (!is_reserved_channel(channel) && !lcm_has_handlers(lcm->lcm, channel)) {
+            dbg(DBG_LCM, "ignoring fragmented message on %s\n", channel);
+            if (fbuf) {
+                lcm_frag_buf_store_remove(rt->frag_bufs, fbuf);
+            }
+            lcm_frag_buf_store_ignore(rt->frag_bufs, &key);
+            return 0;
+        }
     }
 
     // create a new fragment buffer if necessary
     if (!fbuf) {
-        fbuf = lcm_frag_buf_new(*((struct sockaddr_in *) &lcmb->from), msg_seqno, data_size,
-                                fragments_in_msg, lcmb->recv_utime);
-        lcm_frag_buf_store_add(lcm->frag_bufs, fbuf);
+        fbuf = lcm_frag_buf_new(lcm->frag_pool, *((struct sockaddr_in *) &lcmb->from), msg_seqno,
+                                data_size, fragments_in_msg, lcmb->recv_utime);
+        lcm_stat_add(&lcm->stats.frag_bufs_evicted, lcm_frag_buf_store_add(rt->frag_bufs, fbuf));
     }
 
     if (channel != NULL) {
@@ -457,47 +1048,68 @@ static int recv_message_fragment(lcm_mpudpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz
     if (fragment_offset + frag_size > fbuf->data_size) {
         dbg(DBG_LCM, "dropping invalid fragment (off: %d, %d / %d)\n", fragment_offset, frag_size,
             fbuf->data_size);
-        lcm_frag_buf_store_remove(lcm->frag_bufs, fbuf);
+        lcm_frag_buf_store_remove(rt->frag_bufs, fbuf);
+        return 0;
+    }
+
+    // drop duplicated fragments without copying them again
+    int is_new_fragment = lcm_frag_buf_mark_received(fbuf, fragment_no);
+    if (is_new_fragment < 0) {
+        dbg(DBG_LCM, "dropping invalid fragment (%d / %d)\n", fragment_no, fragments_in_msg);
+        lcm_frag_buf_store_remove(rt->frag_bufs, fbuf);
+        return 0;
+    }
+    if (!is_new_fragment) {
+        dbg(DBG_LCM, "dropping duplicate fragment %d\n", fragment_no);
         return 0;
     }
 
     // copy data
     memcpy(fbuf->data + fragment_offset, data_start, frag_size);
     fbuf->last_packet_utime = lcmb->recv_utime;
+    fbuf->last_packet_mono_ns = lcmb->recv_mono_ns;
 
     fbuf->fragments_remaining--;
 
     if (0 == fbuf->fragments_remaining) {
+        if (ntohl(hdr->magic) == LCM2_MAGIC_LONG_LZ4 && lcm_frag_buf_decompress(fbuf) < 0) {
+            dbg(DBG_LCM, "dropping message that does not decompress\n");
+            lcm_stat_add(&lcm->stats.packets_bad, 1);
+            lcm_frag_buf_store_remove(rt->frag_bufs, fbuf);
+            return 0;
+        }
+
         // complete message received.  Is there a subscriber that still
         // wants it?  (i.e., does any subscriber have space in its queue?)
         // WARNING: lcm_try_enqueue_message increments the number of queued
         // messages, so we must check whether it is a reserved channel FIRST
+        lcmb->priority = 0;
         if (!is_reserved_channel(fbuf->channel) &&
-            !lcm_try_enqueue_message(lcm->lcm, fbuf->channel)) {
+            !lcm_try_enqueue_message_priority(lcm->lcm, fbuf->channel, &lcmb->priority)) {
             // no... sad... free the fragment buffer and return
-            lcm_frag_buf_store_remove(lcm->frag_bufs, fbuf);
+            lcm_frag_buf_store_remove(rt->frag_bufs, fbuf);
             return 0;
         }
 
         // yes, transfer the message into the lcm_buf_t
 
         // deallocate the ringbuffer-allocated buffer
-        g_mutex_lock(&lcm->receive_lock);
-        lcm_buf_free_data(lcmb, lcm->ringbuf);
-        g_mutex_unlock(&lcm->receive_lock);
+        lcm_buf_free_data(lcmb, rt->ringbuf);
 
         // transfer ownership of the message's payload buffer
         lcmb->buf = fbuf->data;
+        lcmb->buf_size = fbuf->data_size;
+        lcmb->pool = fbuf->pool;
         fbuf->data = NULL;
 
-        strcpy(lcmb->channel_name, fbuf->channel);
-        lcmb->channel_size = strlen(lcmb->channel_name);
+        lcm_buf_set_channel(lcmb, fbuf->channel, strlen(fbuf->channel));
         lcmb->data_offset = 0;
         lcmb->data_size = fbuf->data_size;
         lcmb->recv_utime = fbuf->last_packet_utime;
+        lcmb->recv_mono_ns = fbuf->last_packet_mono_ns;
 
         // don't need the fragment buffer anymore
-        lcm_frag_buf_store_remove(lcm->frag_bufs, fbuf);
+        lcm_frag_buf_store_remove(rt->frag_bufs, fbuf);
 
         return 1;
     }
@@ -517,36 +1129,118 @@ static int recv_short_message(lcm_mpudpm_t *lcm, lcm_buf_t *lcmb, int sz)
 
     if (lcmb->channel_size > LCM_MAX_CHANNEL_NAME_LENGTH) {
         dbg(DBG_LCM, "bad channel name length\n");
-        lcm->udp_discarded_bad++;
+        lcm_stat_add(&lcm->stats.packets_bad, 1);
         return 0;
     }
 
-    lcm->udp_rx++;
-
     // if the packet has no subscribers, drop the message now.
     // WARNING: lcm_try_enqueue_message increments the number of queued
     // messages, so we must check whether it is a reserved channel FIRST
+    lcmb->priority = 0;
     if (!is_reserved_channel(pkt_channel_str) || strcmp(pkt_channel_str, SELF_TEST_CHANNEL) == 0) {
-        if (!lcm_try_enqueue_message(lcm->lcm, pkt_channel_str)) {
+        if (!lcm_try_enqueue_message_priority(lcm->lcm, pkt_channel_str, &lcmb->priority)) {
             return 0;
         }
     }
 
-    strcpy(lcmb->channel_name, pkt_channel_str);
+    lcm_buf_set_channel(lcmb, pkt_channel_str, lcmb->channel_size);
 
     lcmb->data_offset = sizeof(lcm2_header_short_t) + lcmb->channel_size + 1;
 
     lcmb->data_size = sz - lcmb->data_offset;
+    if (lcm->params.align > 1)
+        lcm_buf_align_data(lcmb, lcm->params.align);
     return 1;
 }
 
-// this function will aquire locks if needed
-static void dispatch_complete_message(lcm_mpudpm_t *lcm, lcm_buf_t *lcmb, int actual_size)
+// Releases the packets that lcm_handle() has handed back through inbufs_done.
+// Only called by the read thread.
+static void reclaim_handled(mpudpm_recv_thread_t *rt)
+{
+    lcm_buf_t *lcmb;
+    while ((lcmb = lcm_buf_ring_pop(rt->inbufs_done))) {
+        lcm_buf_free_data(lcmb, rt->ringbuf);
+        lcm_buf_enqueue(rt->inbufs_empty, lcmb);
+    }
+    lcm_buf_returns_take(&rt->returns, rt->inbufs_empty, rt->ringbuf);
+}
+
+// wait up to timeout_ms for a message on the thread_msg_pipe.  Returns -1 if
+// the read thread was told to exit, 0 otherwise.  A changed set of receive
+// sockets is picked up when the read thread waits for packets again.
+static int recv_wait_for_exit(mpudpm_recv_thread_t *rt, int timeout_ms)
+{
+    fd_set readfds;
+    FD_ZERO(&readfds);
+    FD_SET(rt->thread_msg_pipe[0], &readfds);
+
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+    int status = select(rt->thread_msg_pipe[0] + 1, &readfds, NULL, NULL, &tv);
+    if (status > 0 && FD_ISSET(rt->thread_msg_pipe[0], &readfds)) {
+        char ch;
+        if (lcm_internal_pipe_read(rt->thread_msg_pipe[0], &ch, 1) <= 0 || ch != 'c') {
+            dbg(DBG_LCM, "read thread received exit command\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// wake up lcm_handle() and make lcm_get_fileno() readable, unless that has
+// already been done.  Several read threads may call this at once, and
+// lcm_handle() only ever takes one notification at a time, so keeping at most
+// one in notify_pipe is what keeps it from waiting on a notification for
+// packets that it has already dispatched.
+static void notify_handle(lcm_mpudpm_t *lcm)
+{
+    if (g_atomic_int_compare_and_exchange(&lcm->notified, 0, 1)) {
+        if (lcm_internal_pipe_write(lcm->notify_pipe[1], "+", 1) < 0) {
+            perror("write to notify");
+        }
+    }
+}
+
+// Queue a complete message for retrieval by lcm_handle().  The message has
+// already been counted against its subscriptions' queue limits, so if the
+// queue is full this waits for lcm_handle() to make room instead of dropping
+// it.  Returns -1 if the read thread was told to exit in the meantime, in
+// which case the caller still owns lcmb.
+static int queue_message(mpudpm_recv_thread_t *rt, lcm_buf_t *lcmb)
 {
+    lcm_mpudpm_t *lcm = rt->lcm;
+    int status;
+    while ((status = lcm_buf_ring_push(rt->inbufs_filled[lcmb->priority], lcmb)) < 0) {
+        reclaim_handled(rt);
+        if (recv_wait_for_exit(rt, 1) < 0)
+            return -1;
+    }
+
+    // If necessary, notify the reading thread by writing to a pipe.  This is
+    // only needed when a queue transitions from empty to non-empty.
+    // Otherwise lcm_handle() will find this message when it checks the queues
+    // again after dequeueing the previous one.
+    if (status > 0)
+        notify_handle(lcm);
+    return 0;
+}
+
+// Returns -1 if the read thread was told to exit before lcmb could be queued,
+// in which case the caller still owns it.
+static int dispatch_complete_message(mpudpm_recv_thread_t *rt, lcm_buf_t *lcmb, int actual_size)
+{
+    lcm_mpudpm_t *lcm = rt->lcm;
     int handled_internal_message = 0;
     if (strcmp(lcmb->channel_name, CHANNEL_TO_PORT_MAP_REQUEST_CHANNEL) == 0) {
+        // a request may name the instance that it is for
+        char request[18] = { 0 };
+        memcpy(request, lcmb->buf + lcmb->data_offset, MIN(lcmb->data_size, sizeof(request) - 1));
+        int64_t sender_id = (int64_t) strtoull(request + 1, NULL, 16);
         g_mutex_lock(&lcm->transmit_lock);
-        publish_channel_mapping_update(lcm);
+        if (sender_id == 0 || sender_id == lcm->map_sender_id)
+            publish_channel_mapping_update(lcm);
         g_mutex_unlock(&lcm->transmit_lock);
         // discard the received message
         handled_internal_message = 1;
@@ -566,34 +1260,209 @@ static void dispatch_complete_message(lcm_mpudpm_t *lcm, lcm_buf_t *lcmb, int ac
 
     if (handled_internal_message) {
         // one of the handlers above took it, so discard lcmb
-        g_mutex_lock(&lcm->receive_lock);
-        lcm_buf_free_data(lcmb, lcm->ringbuf);
-        lcm_buf_enqueue(lcm->inbufs_empty, lcmb);
-        g_mutex_unlock(&lcm->receive_lock);
-    } else {
-        // enqueue the lcmb for handling by the user
-        g_mutex_lock(&lcm->receive_lock);
+        lcm_buf_free_data(lcmb, rt->ringbuf);
+        lcm_buf_enqueue(rt->inbufs_empty, lcmb);
+        return 0;
+    }
+
+    // enqueue the lcmb for handling by the user
+
+    // if the newly received packet is a short packet, then resize the space
+    // allocated in the ringbuffer to exactly match the amount of space
+    // required.  That way, we do not use 64k of the ringbuffer for every
+    // incoming message.
+    if (lcmb->ringbuf) {
+        lcm_ringbuf_shrink_last(lcmb->ringbuf, lcmb->buf,
+                                MAX(actual_size, lcmb->data_offset + lcmb->data_size));
+    }
+    if (rt->ringbuf) {
+        lcm_stat_max(&lcm->stats.ringbuf_high_water, lcm_ringbuf_used(rt->ringbuf));
+        lcm_stat_max(&lcm->stats.ringbuf_capacity, lcm_ringbuf_capacity(rt->ringbuf));
+    }
+    /* Queue the packet for future retrieval by lcm_handle (). */
+    return queue_message(rt, lcmb);
+}
+
+// Handles a datagram of sz bytes that was received from sock into lcmb, with
+// the source address and control messages of msg.  Returns 1 if a complete
+// message was queued with lcmb, 0 if lcmb may be reused, or -1 if the read
+// thread should exit.
+static int recv_datagram(mpudpm_recv_thread_t *rt, mpudpm_socket_t *sock, lcm_buf_t *lcmb,
+                         struct msghdr *msg, int sz)
+{
+    lcm_mpudpm_t *lcm = rt->lcm;
+    lcm_stat_add(&lcm->stats.packets_received, 1);
+    lcm_stat_add(&lcm->stats.bytes_received, sz);
+    if (sz < sizeof(lcm2_header_short_t)) {
+        // packet too short to be LCM
+        lcm_stat_add(&lcm->stats.packets_bad, 1);
+        return 0;
+    }
+
+    lcmb->fromlen = msg->msg_namelen;
+    // overwrite upper 16 bits of the address in lcmb->from with the
+    // recv_port since all channels are sent from the same port, and
+    // the from address is used to retrieve fragment buffers. If
+    // there is an existing fragment buffer with a different seqno
+    // the message would get dropped. This ensures that messages on
+    // different channels will appear as though they are coming from
+    // different senders
+    struct sockaddr_in *from_addr = (struct sockaddr_in *) &lcmb->from;
+    // s_addr is network order, so we actually modify lower 16
+    from_addr->sin_addr.s_addr &= 0xFFFF0000;
+    from_addr->sin_addr.s_addr |= htons(sock->port);
+
+    int got_utime = 0;
+#ifdef SO_TIMESTAMP
+    struct cmsghdr *cmsg;
+    // Get the receive timestamp and the kernel's drop count out
+    // of the packet headers (if possible)
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET)
+            continue;
+        if (!got_utime && cmsg->cmsg_type == SCM_TIMESTAMP) {
+            struct timeval *t = (struct timeval *) CMSG_DATA(cmsg);
+            lcmb->recv_utime = (int64_t) t->tv_sec * 1000000 + t->tv_usec;
+            got_utime = 1;
+        }
+#ifdef SO_RXQ_OVFL
+        // cumulative per socket, so add what is new since last time
+        if (cmsg->cmsg_type == SO_RXQ_OVFL) {
+            uint32_t drops;
+            memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+            lcm_stat_add(&lcm->stats.kernel_drops,
+                         (uint32_t) (drops - sock->kernel_drops));
+            sock->kernel_drops = drops;
+        }
+#endif
+    }
+#endif
+    if (!got_utime)
+        lcmb->recv_utime = g_get_real_time();
+    lcmb->recv_mono_ns = lcm_monotonic_ns();
+
+    lcm2_header_short_t *hdr2 = (lcm2_header_short_t *) lcmb->buf;
+    uint32_t rcvd_magic = ntohl(hdr2->magic);
+    int got_complete_message = 0;
+    if (rcvd_magic == LCM2_MAGIC_SHORT)
+        got_complete_message = recv_short_message(lcm, lcmb, sz);
+    else if (rcvd_magic == LCM2_MAGIC_LONG || rcvd_magic == LCM2_MAGIC_LONG_LZ4)
+        got_complete_message = recv_message_fragment(rt, lcmb, sz);
+    else {
+        dbg(DBG_LCM, "LCM: bad magic\n");
+        lcm_stat_add(&lcm->stats.packets_bad, 1);
+        return 0;
+    }
+
+    // dispatch internal messages
+    if (!got_complete_message)
+        return 0;
+    return dispatch_complete_message(rt, lcmb, sz) < 0 ? -1 : 1;
+}
+
+#ifdef USE_IO_URING
+// most datagrams that are taken off the completion queue at once
+#define MPUDPM_URING_BATCH 64
 
-        // if the newly received packet is a short packet, then resize the space
-        // allocated in the ringbuffer to exactly match the amount of space
-        // required.  That way, we do not use 64k of the ringbuffer for every
-        // incoming message.
-        if (lcmb->ringbuf) {
-            lcm_ringbuf_shrink_last(lcmb->ringbuf, lcmb->buf, actual_size);
-        }
-        // If necessary, notify the reading thread by writing to a pipe.  We
-        // only want one character in the pipe at a time to avoid blocking
-        // writes, so we only do this when the queue transitions from empty to
-        // non-empty.
-        if (lcm_buf_queue_is_empty(lcm->inbufs_filled)) {
-            if (lcm_internal_pipe_write(lcm->notify_pipe[1], "+", 1) < 0) {
-                perror("write to notify");
+// Handles the datagrams that the io_uring received, after waiting for one if
+// there are none yet.  Unlike the udpm provider, which reassembles fragments
+// straight from the provided buffers, this copies each datagram into the
+// ring buffer, as recvmsg() would have.  *lcmb is the buffer to receive the
+// next one into, or NULL.  Returns -1 when the read thread should exit.
+static int recv_uring(mpudpm_recv_thread_t *rt, lcm_buf_t **lcmb)
+{
+    lcm_uring_packet_t pkts[MPUDPM_URING_BATCH];
+    int npkts = lcm_uring_wait(rt->uring, pkts, MPUDPM_URING_BATCH);
+    if (npkts < 0) {
+        perror("recv_thread -- lcm_uring_wait() failed:");
+        return 0;
+    }
+
+    int status = 0;
+    for (int i = 0; i < npkts && status == 0; i++) {
+        lcm_uring_packet_t *pkt = &pkts[i];
+        if (pkt->user == rt->thread_msg_pipe) {
+            char ch;
+            if (lcm_internal_pipe_read(rt->thread_msg_pipe[0], &ch, 1) <= 0) {
+                fprintf(stderr, "Error: Problem reading from thread_msg_pipe\n");
+                status = -1;
+            } else if (ch == 'c') {
+                dbg(DBG_LCM, "Aborted wait due to changed receive sockets\n");
+            } else {
+                dbg(DBG_LCM, "read thread received exit command\n");
+                status = -1;
             }
+            continue;
+        }
+
+        if (*lcmb == NULL) {
+            reclaim_handled(rt);
+            *lcmb = lcm_buf_allocate_data(rt->inbufs_empty, &rt->ringbuf, 0);
+        }
+        memcpy((*lcmb)->buf, pkt->data, MIN(pkt->size, LCM_MAX_UNFRAGMENTED_PACKET_SIZE));
+        memcpy(&(*lcmb)->from, pkt->msg.msg_name, pkt->msg.msg_namelen);
+        status = recv_datagram(rt, (mpudpm_socket_t *) pkt->user, *lcmb, &pkt->msg, pkt->size);
+        if (status > 0) {
+            *lcmb = NULL;
+            status = 0;
         }
-        /* Queue the packet for future retrieval by lcm_handle (). */
-        lcm_buf_enqueue(lcm->inbufs_filled, lcmb);
-        g_mutex_unlock(&lcm->receive_lock);
     }
+    lcm_uring_release(rt->uring, pkts, npkts);
+    return status;
+}
+#endif
+
+// Starts waiting for datagrams on sock, with the io_uring if the thread has
+// one, or else the poller.
+static int watch_recv_socket(mpudpm_recv_thread_t *rt, mpudpm_socket_t *sock)
+{
+#ifdef USE_IO_URING
+    if (rt->uring)
+        return lcm_uring_add(rt->uring, sock->fd, sock);
+#endif
+    return lcm_poller_add(rt->poller, sock->fd, sock);
+}
+
+static int unwatch_recv_socket(mpudpm_recv_thread_t *rt, mpudpm_socket_t *sock)
+{
+#ifdef USE_IO_URING
+    if (rt->uring) {
+        lcm_uring_remove(rt->uring, sock->fd);
+        return 0;
+    }
+#endif
+    return lcm_poller_remove(rt->poller, sock->fd);
+}
+
+// Brings the poller, or the io_uring, up to date with the receive sockets that
+// were opened or closed since the last call, and destroys the closed ones.
+// nsockets is the number of receive sockets registered with it.  Only called
+// by the read thread, between waits, so no ready socket is destroyed while it
+// is still being read.
+static void apply_recv_socket_changes(mpudpm_recv_thread_t *rt, int *nsockets)
+{
+    lcm_mpudpm_t *lcm = rt->lcm;
+    g_mutex_lock(&lcm->receive_lock);
+    GSList *added = rt->recv_sockets_added;
+    GSList *removed = rt->recv_sockets_removed;
+    rt->recv_sockets_added = rt->recv_sockets_removed = NULL;
+    g_mutex_unlock(&lcm->receive_lock);
+
+    // a socket may have been opened and closed again in the meantime, so the
+    // new sockets are registered first
+    for (GSList *it = added; it != NULL; it = it->next) {
+        mpudpm_socket_t *sock = (mpudpm_socket_t *) it->data;
+        if (watch_recv_socket(rt, sock) == 0)
+            (*nsockets)++;
+    }
+    for (GSList *it = removed; it != NULL; it = it->next) {
+        mpudpm_socket_t *sock = (mpudpm_socket_t *) it->data;
+        if (unwatch_recv_socket(rt, sock) == 0)
+            (*nsockets)--;
+        mpudpm_socket_t_destroy(sock);
+    }
+    g_slist_free(added);
+    g_slist_free(removed);
 }
 
 /* This is the receiver thread that runs continuously to retrieve any incoming
@@ -607,99 +1476,78 @@ static void *recv_thread(void *user)
     pthread_sigmask(SIG_SETMASK, &mask, NULL);
 #endif
 
-    lcm_mpudpm_t *lcm = (lcm_mpudpm_t *) user;
+    mpudpm_recv_thread_t *rt = (mpudpm_recv_thread_t *) user;
+    lcm_mpudpm_t *lcm = rt->lcm;
 
     lcm_buf_t *lcmb = NULL;
+    void **ready = NULL;
+    int max_ready = 0;
+    int nsockets = 0;
     // loop until we get an exit message on the thread_msg_pipe
     while (1) {
-        // lock subscription lists so things don't change on us
-        g_mutex_lock(&lcm->receive_lock);
-
-        // setup file descriptors for select
-        fd_set fds;
-        FD_ZERO(&fds);
-
-        // thread_msg_pipe fd
-        FD_SET(lcm->thread_msg_pipe[0], &fds);
-        SOCKET maxfd = lcm->thread_msg_pipe[0];
-
-        for (GSList *it = lcm->recv_sockets; it != NULL; it = it->next) {
-            mpudpm_socket_t *sub_socket = (mpudpm_socket_t *) it->data;
-            FD_SET(sub_socket->fd, &fds);
-            if (sub_socket->fd > maxfd) {
-                maxfd = sub_socket->fd;
-            }
+        // The poller keeps its registrations between waits, so it only needs
+        // to hear about the receive sockets that were opened or closed.
+        apply_recv_socket_changes(rt, &nsockets);
+#ifdef USE_IO_URING
+        if (rt->uring) {
+            if (recv_uring(rt, &lcmb) < 0)
+                break;
+            continue;
+        }
+#endif
+        if (nsockets + 1 > max_ready) {
+            max_ready = nsockets + 1;
+            ready = (void **) realloc(ready, max_ready * sizeof(void *));
         }
-        lcm->recv_sockets_changed = 0;
-
-        // unlock receive_lock while we wait for a message
-        g_mutex_unlock(&lcm->receive_lock);
 
-        if (select(maxfd + 1, &fds, NULL, NULL, NULL) < 0) {
-            perror("udp_read_packet -- select() failed:");
+        int nready = lcm_poller_wait(rt->poller, ready, max_ready);
+        if (nready < 0) {
+            perror("recv_thread -- lcm_poller_wait() failed:");
             continue;
         }
 
         // check for a signaling message
-        if (FD_ISSET(lcm->thread_msg_pipe[0], &fds)) {
+        int got_thread_msg = 0;
+        for (int i = 0; i < nready; i++) {
+            if (ready[i] == rt->thread_msg_pipe) {
+                got_thread_msg = 1;
+                break;
+            }
+        }
+        if (got_thread_msg) {
             char ch;
-            int status = lcm_internal_pipe_read(lcm->thread_msg_pipe[0], &ch, 1);
+            int status = lcm_internal_pipe_read(rt->thread_msg_pipe[0], &ch, 1);
             if (status <= 0) {
                 fprintf(stderr, "Error: Problem reading from thread_msg_pipe\n");
                 break;
             }
             if (ch == 'c') {
-                dbg(DBG_LCM, "Aborted select due to changed receive sockets\n");
+                dbg(DBG_LCM, "Aborted wait due to changed receive sockets\n");
                 continue;
             } else {
                 // received an exit message.
                 dbg(DBG_LCM, "read thread received exit command\n");
-                if (lcmb) {
-                    // lcmb is not on one of the memory managed buffer queues.
-                    // We could either put it back on one of the queues, or
-                    // just free it here.  Do the latter.
-                    //
-                    // Can also just free its lcm_buf_t here.  Its data buffer
-                    // is managed either by the ring buffer or the fragment
-                    // buffer, so we can ignore it.
-                    free(lcmb);
-                }
                 break;
             }
         }
-        g_mutex_lock(&lcm->receive_lock);
-        if (lcm->recv_sockets_changed) {
-            // the set of receive sockets has changed, so we need to start
-            // over
-            g_mutex_unlock(&lcm->receive_lock);
-            continue;
-        }
 
         // there is incoming UDP data ready on at least one of our sockets.
-        // loop over sockets and receive data on all the ones that have data
-        SOCKET recv_fd = -1;
-        uint16_t recv_port = -1;
-        int poll_i = 1;
-        for (GSList *it = lcm->recv_sockets; it != NULL; it = it->next, ++poll_i) {
-            // We should be holding receive_lock at the start of this loop
-            mpudpm_socket_t *sub_socket = (mpudpm_socket_t *) it->data;
-            if (!FD_ISSET(sub_socket->fd, &fds)) {
-                continue;
-            } else {
-                recv_fd = sub_socket->fd;
-                recv_port = sub_socket->port;
-            }
+        // loop over sockets and receive data on all the ones that have data.
+        // Closed sockets are only destroyed before the next wait, so the
+        // ready sockets are all still valid, and none of this needs the
+        // receive_lock.
+        for (int ready_i = 0; ready_i < nready; ready_i++) {
+            mpudpm_socket_t *sub_socket = (mpudpm_socket_t *) ready[ready_i];
+            SOCKET recv_fd = sub_socket->fd;
 
             // loop until recvmsg would block (we've read all available data)
             // or a read fails
             while (1) {
-                // We should be holding receive_lock at the start of this loop
                 if (lcmb == NULL) {
-                    lcmb = lcm_buf_allocate_data(lcm->inbufs_empty, &lcm->ringbuf);
+                    reclaim_handled(rt);
+                    lcmb = lcm_buf_allocate_data(rt->inbufs_empty, &rt->ringbuf, 0);
                 }
 
-                // unlock while we actually receive the incoming message
-                g_mutex_unlock(&lcm->receive_lock);
                 struct iovec vec;
                 vec.iov_base = lcmb->buf;
                 vec.iov_len = 65535;
@@ -727,85 +1575,32 @@ static void *recv_thread(void *user)
                     if (WSAGetLastError() != WSAEWOULDBLOCK) {
 #endif
                         perror("udp_read_packet -- recvmsg");
-                        lcm->udp_discarded_bad++;
+                        lcm_stat_add(&lcm->stats.packets_bad, 1);
                     }
                     break;
                 }
 
-                if (sz < sizeof(lcm2_header_short_t)) {
-                    // packet too short to be LCM
-                    lcm->udp_discarded_bad++;
-                    g_mutex_lock(&lcm->receive_lock);
-                    continue;
-                }
-
-                lcmb->fromlen = msg.msg_namelen;
-                // overwrite upper 16 bits of the address in lcmb->from with the
-                // recv_port since all channels are sent from the same port, and
-                // the from address is used to retrieve fragment buffers. If
-                // there is an existing fragment buffer with a different seqno
-                // the message would get dropped. This ensures that messages on
-                // different channels will appear as though they are coming from
-                // different senders
-                struct sockaddr_in *from_addr = (struct sockaddr_in *) &lcmb->from;
-                // s_addr is network order, so we actually modify lower 16
-                from_addr->sin_addr.s_addr &= 0xFFFF0000;
-                from_addr->sin_addr.s_addr |= htons(recv_port);
-
-                int got_utime = 0;
-#ifdef SO_TIMESTAMP
-                struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
-                // Get the receive timestamp out of the packet headers
-                // (if possible)
-                while (!lcmb->recv_utime && cmsg) {
-                    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMP) {
-                        struct timeval *t = (struct timeval *) CMSG_DATA(cmsg);
-                        lcmb->recv_utime = (int64_t) t->tv_sec * 1000000 + t->tv_usec;
-                        got_utime = 1;
-                        break;
-                    }
-                    cmsg = CMSG_NXTHDR(&msg, cmsg);
-                }
-#endif
-                if (!got_utime)
-                    lcmb->recv_utime = g_get_real_time();
-
-                lcm2_header_short_t *hdr2 = (lcm2_header_short_t *) lcmb->buf;
-                uint32_t rcvd_magic = ntohl(hdr2->magic);
-                int got_complete_message = 0;
-                if (rcvd_magic == LCM2_MAGIC_SHORT)
-                    got_complete_message = recv_short_message(lcm, lcmb, sz);
-                else if (rcvd_magic == LCM2_MAGIC_LONG)
-                    got_complete_message = recv_message_fragment(lcm, lcmb, sz);
-                else {
-                    dbg(DBG_LCM, "LCM: bad magic\n");
-                    lcm->udp_discarded_bad++;
-                    g_mutex_lock(&lcm->receive_lock);
-                    continue;
-                }
-
-                // dispatch internal messages
-                if (got_complete_message) {
-                    dispatch_complete_message(lcm, lcmb, sz);
+                int status = recv_datagram(rt, sub_socket, lcmb, &msg, sz);
+                if (status < 0)
+                    goto recv_thread_exit;
+                if (status > 0)
                     lcmb = NULL;
-                }
-                // lock to go back around the while loop
-                g_mutex_lock(&lcm->receive_lock);
-            }
-
-            // we're done with this file descriptor
-            // lock the receive lock to check whether the receive sockets have
-            // changed and go back around the loop
-            g_mutex_lock(&lcm->receive_lock);
-            if (lcm->recv_sockets_changed) {
-                // the set of receive sockets may have changed, so we need to
-                // break and wait again on the appropriate set of sockets
-                break;
             }
         }
-        g_mutex_unlock(&lcm->receive_lock);
     }
 
+recv_thread_exit:
+    if (lcmb) {
+        // lcmb is not on one of the memory managed buffer queues.
+        // We could either put it back on one of the queues, or
+        // just free it here.  Do the latter.
+        //
+        // Can also just free its lcm_buf_t here.  Its data buffer
+        // is managed either by the ring buffer or the fragment
+        // buffer, so we can ignore it.
+        free(lcmb);
+    }
+    free(ready);
     dbg(DBG_LCM, "read thread exiting\n");
     return NULL;
 }
@@ -845,28 +1640,23 @@ static int lcm_mpudpm_subscribe(lcm_mpudpm_t *lcm, const char *channel)
         }
         // Request an update to the channel to port map
         dbg(DBG_LCM, "Requesting a channel to port map update\n");
-        char *msg = "r";
         g_mutex_lock(&lcm->transmit_lock);
-        publish_message_internal(lcm, CHANNEL_TO_PORT_MAP_REQUEST_CHANNEL, (uint8_t *) msg,
-                                 strlen(msg));
+        request_channel_mapping_update(lcm, 0);
         g_mutex_unlock(&lcm->transmit_lock);
     } else {
         dbg(DBG_LCM, "Subscribing to single channel: %s\n", channel);
         // add it to our channel map
         g_mutex_lock(&lcm->transmit_lock);
 
-        void *lookup_value = g_hash_table_lookup(lcm->channel_to_port_map, channel);
-        uint16_t port;
-        if (lookup_value == NULL) {
+        mpudpm_channel_t *chan =
+            (mpudpm_channel_t *) g_hash_table_lookup(lcm->channel_to_port_map, channel);
+        if (chan == NULL) {
             // insert the new destination into the hash table
-            port = map_channel_to_port(lcm, channel);
-            g_hash_table_insert(lcm->channel_to_port_map, strdup(channel), GUINT_TO_POINTER(port));
-            // broadcast the updated channel map...
-            lcm->last_mapping_update_utime = 0;
-            publish_channel_mapping_update(lcm);
-        } else {
-            port = GPOINTER_TO_UINT(lookup_value);
+            chan = add_channel_mapping(lcm, channel, 0);
+            // broadcast the new mapping...
+            publish_channel_mapping_changes(lcm);
         }
+        uint16_t port = chan->port;
         g_mutex_unlock(&lcm->transmit_lock);
 
         g_mutex_lock(&lcm->receive_lock);
@@ -881,7 +1671,7 @@ static int lcm_mpudpm_subscribe(lcm_mpudpm_t *lcm, const char *channel)
 
     // Do an update to set the ports used by this subscription
     // this is what will actually open the sockets if needed...
-    update_subscription_ports(lcm);
+    update_subscription_ports(lcm, NULL);
     return 0;
 }
 
@@ -922,53 +1712,111 @@ static int lcm_mpudpm_unsubscribe(lcm_mpudpm_t *lcm, const char *channel)
     return 0;
 }
 
+// Fills in a channel_port_map_update_t with the given mappings and publishes
+// it.  This function assumes that the caller is holding the transmit_lock
+static void publish_mappings(lcm_mpudpm_t *lcm, channel_port_map_update_t *msg,
+                             mpudpm_channel_t **chans, int num_chans, int64_t now)
+{
+    msg->num_ports = lcm->params.num_mc_ports;
+    msg->sender_id = lcm->map_sender_id;
+    msg->version = lcm->map_version;
+    msg->mapping = (channel_to_port_t *) calloc(num_chans, sizeof(channel_to_port_t));
+    msg->num_channels = num_chans;
+    for (int i = 0; i < num_chans; i++) {
+        channel_update_rate(chans[i], now);
+        msg->mapping[i].channel = strdup(chans[i]->channel);
+        msg->mapping[i].port = (int16_t) chans[i]->port;  // cast to int16_t for LCM
+        msg->mapping[i].bandwidth = chans[i]->tx_rate;
+    }
+
+    if (msg->num_channels > 0) {
+        // publish the message
+        int msg_sz = channel_port_map_update_t_encoded_size(msg);
+        void *buf = malloc(msg_sz);
+        channel_port_map_update_t_encode(buf, 0, msg_sz, msg);
+        dbg(DBG_LCM, "Publishing a %dB channel_port_map %s with %d mappings (version %d)\n",
+            msg_sz, msg->base_version ? "delta" : "snapshot", msg->num_channels, msg->version);
+        publish_message_internal(lcm, CHANNEL_TO_PORT_MAP_UPDATE_CHANNEL, buf, msg_sz);
+        free(buf);
+    }
+}
+
+// Publishes all of the mappings.
 // This function assumes that the caller is holding the transmit_lock
 static void publish_channel_mapping_update(lcm_mpudpm_t *lcm)
 {
     int64_t now = g_get_real_time();
     if (now - lcm->last_mapping_update_utime < 1e4) {
         // lets not publish updates too often.
-        // if we actually have new information (ie a new channel),
-        // last_mapping_update_utime will have been set to 0, so this check
-        // is bypassed
+        // new information (ie a new channel) is published by
+        // publish_channel_mapping_changes() instead
         return;
     }
-    lcm->last_mapping_update_utime = g_get_real_time();
+    lcm->last_mapping_update_utime = now;
+
+    // the snapshot includes the changes that weren't published yet, so bump
+    // the version for whoever didn't receive it
+    if (lcm->map_changes->len > 0) {
+        for (guint i = 0; i < lcm->map_changes->len; i++)
+            ((mpudpm_channel_t *) g_ptr_array_index(lcm->map_changes, i))->changed = FALSE;
+        g_ptr_array_set_size(lcm->map_changes, 0);
+        lcm->map_version++;
+    }
 
-    channel_port_map_update_t *msg =
-        (channel_port_map_update_t *) calloc(1, sizeof(channel_port_map_update_t));
-    msg->num_ports = lcm->params.num_mc_ports;
     int table_size = g_hash_table_size(lcm->channel_to_port_map);
-    msg->mapping = (channel_to_port_t *) calloc(table_size, sizeof(channel_to_port_t));
+    mpudpm_channel_t **chans = (mpudpm_channel_t **) calloc(table_size, sizeof(mpudpm_channel_t *));
     GHashTableIter iter;
     gpointer key, value;
     g_hash_table_iter_init(&iter, lcm->channel_to_port_map);
     int ind = 0;
     while (g_hash_table_iter_next(&iter, &key, &value)) {
-        const char *channel = (const char *) key;
-        uint16_t port = GPOINTER_TO_UINT(value);
         // filter out reserved channels
-        if (is_reserved_channel(channel)) {
+        if (is_reserved_channel((const char *) key)) {
             continue;
         }
-        msg->mapping[ind].channel = strdup(channel);
-        msg->mapping[ind].port = (int16_t) port;  // cast to int16_t for LCM
-        ind++;
+        chans[ind++] = (mpudpm_channel_t *) value;
     }
-    msg->num_channels = ind;
-    assert(msg->num_channels == table_size - NUM_INTERNAL_CHANNELS);
+    assert(ind == table_size - NUM_INTERNAL_CHANNELS);
 
-    if (msg->num_channels > 0) {
-        // publish the message
-        int msg_sz = channel_port_map_update_t_encoded_size(msg);
-        void *buf = malloc(msg_sz);
-        channel_port_map_update_t_encode(buf, 0, msg_sz, msg);
-        dbg(DBG_LCM, "Publishing a %dB channel_port_map with %d mappings\n", msg_sz,
-            msg->num_channels);
-        publish_message_internal(lcm, CHANNEL_TO_PORT_MAP_UPDATE_CHANNEL, buf, msg_sz);
-        free(buf);
-    }
-    channel_port_map_update_t_destroy(msg);
+    channel_port_map_update_t msg;
+    memset(&msg, 0, sizeof(msg));
+    publish_mappings(lcm, &msg, chans, ind, now);
+    channel_port_map_update_t_decode_cleanup(&msg);
+    free(chans);
+}
+
+// Publishes the mappings that this instance added or moved since its last
+// update, as a change to the version that the other instances last received.
+// This function assumes that the caller is holding the transmit_lock
+static void publish_channel_mapping_changes(lcm_mpudpm_t *lcm)
+{
+    if (lcm->map_changes->len == 0)
+        return;
+
+    int num_chans = lcm->map_changes->len;
+    mpudpm_channel_t **chans = (mpudpm_channel_t **) g_ptr_array_free(lcm->map_changes, FALSE);
+    lcm->map_changes = g_ptr_array_new();
+    for (int i = 0; i < num_chans; i++)
+        chans[i]->changed = FALSE;
+
+    channel_port_map_update_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.base_version = lcm->map_version++;
+    publish_mappings(lcm, &msg, chans, num_chans, g_get_real_time());
+    channel_port_map_update_t_decode_cleanup(&msg);
+    g_free(chans);
+}
+
+// Asks the instance with the given id to publish all of its mappings, or
+// every instance if it is 0.
+// This function assumes that the caller is holding the transmit_lock
+static void request_channel_mapping_update(lcm_mpudpm_t *lcm, int64_t sender_id)
+{
+    char *msg = sender_id ? g_strdup_printf("r%016llx", (unsigned long long) sender_id)
+                          : g_strdup("r");
+    publish_message_internal(lcm, CHANNEL_TO_PORT_MAP_REQUEST_CHANNEL, (uint8_t *) msg,
+                             strlen(msg));
+    g_free(msg);
 }
 
 static void channel_port_mapping_update_handler(lcm_mpudpm_t *lcm,
@@ -983,40 +1831,101 @@ static void channel_port_mapping_update_handler(lcm_mpudpm_t *lcm,
                 msg->num_ports, lcm->params.num_mc_ports);
         return;
     }
+    if (msg->sender_id == lcm->map_sender_id) {
+        // our own update, looped back
+        return;
+    }
     g_mutex_lock(&lcm->transmit_lock);
-    int8_t updated_channel_to_port_map = FALSE;
+
+    // Deltas from a sender must continue from the version of its last
+    // update.  Otherwise an update was lost, and the sender is asked for a
+    // snapshot of all its mappings.
+    int8_t is_snapshot = msg->base_version == 0;
+    mpudpm_map_sender_t *sender =
+        (mpudpm_map_sender_t *) g_hash_table_lookup(lcm->map_senders, &msg->sender_id);
+    if (sender == NULL) {
+        int64_t *sender_id = (int64_t *) malloc(sizeof(int64_t));
+        *sender_id = msg->sender_id;
+        sender = (mpudpm_map_sender_t *) calloc(1, sizeof(mpudpm_map_sender_t));
+        // the first version of a sender has no mappings, so a delta from
+        // that version is all there is to know
+        sender->version = 1;
+        g_hash_table_insert(lcm->map_senders, sender_id, sender);
+    }
+    if (!is_snapshot && msg->base_version != sender->version &&
+        recv_utime - sender->request_utime > CHANNEL_TO_PORT_MAP_REQUEST_PERIOD) {
+        dbg(DBG_LCM, "Missed channel_port_map versions %d-%d, requesting a snapshot\n",
+            sender->version, msg->base_version);
+        sender->request_utime = recv_utime;
+        request_channel_mapping_update(lcm, msg->sender_id);
+    }
+    sender->version = msg->version;
+    sender->last_utime = recv_utime;
+
+    // the channels whose mapping changed, for update_subscription_ports()
+    GPtrArray *changed = g_ptr_array_new();
+    int8_t missing_bandwidth = FALSE;
     for (int i = 0; i < msg->num_channels; i++) {
-        void *lookup_value = g_hash_table_lookup(lcm->channel_to_port_map, msg->mapping[i].channel);
-        if (lookup_value == NULL) {
-            // cast back to uint16_t for LCM
-            uint16_t port = (uint16_t) msg->mapping[i].port;
-            dbg(DBG_LCM, "Received mapping for new channel %s on port %d\n",
-                msg->mapping[i].channel, port);
+        const channel_to_port_t *mapping = &msg->mapping[i];
+        // cast back to uint16_t for LCM
+        uint16_t port = (uint16_t) mapping->port;
+        mpudpm_channel_t *chan =
+            (mpudpm_channel_t *) g_hash_table_lookup(lcm->channel_to_port_map, mapping->channel);
+        if (chan == NULL) {
+            dbg(DBG_LCM, "Received mapping for new channel %s on port %d\n", mapping->channel,
+                port);
 
             // insert the new destination into the hash table
-            g_hash_table_insert(lcm->channel_to_port_map, strdup(msg->mapping[i].channel),
-                                GUINT_TO_POINTER(port));
-            updated_channel_to_port_map = TRUE;
+            chan = add_channel_mapping(lcm, mapping->channel, port);
+            g_ptr_array_add(changed, chan);
+        } else if (chan->port != port && mapping->bandwidth > 0 &&
+                   !(chan->tx_rate > 0 && (chan->pinned || chan->port < port))) {
+            // the sender publishes the channel on another port, which is where
+            // it has to be received.  If this process publishes the channel
+            // too, the lower port wins.
+            dbg(DBG_LCM, "Channel %s moved from port %d to %d\n", mapping->channel, chan->port,
+                port);
+            chan->port = port;
+            g_ptr_array_add(changed, chan);
+        }
+        if (mapping->bandwidth > 0) {
+            chan->bandwidth = mapping->bandwidth;
+            chan->bandwidth_utime = recv_utime;
+        } else if (chan->tx_rate > 0) {
+            // this process should report the bandwidth that it publishes
+            missing_bandwidth = TRUE;
         }
     }
     int channel_to_port_map_size = g_hash_table_size(lcm->channel_to_port_map);
-    if (!updated_channel_to_port_map &&
+    if (is_snapshot && changed->len == 0 && !missing_bandwidth &&
         channel_to_port_map_size - NUM_INTERNAL_CHANNELS == msg->num_channels) {
         // the broadcast message is identical to mine...
         // treat it as if I just published an update :-)
         dbg(DBG_LCM, "Channel to port map is up to date\n");
         lcm->last_mapping_update_utime = recv_utime;
     }
+    if (is_snapshot) {
+        // forget about senders that haven't published in a long time
+        GHashTableIter iter;
+        gpointer value;
+        g_hash_table_iter_init(&iter, lcm->map_senders);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+            const mpudpm_map_sender_t *other = (const mpudpm_map_sender_t *) value;
+            if (recv_utime - other->last_utime > 3 * lcm->channel_to_port_map_update_period)
+                g_hash_table_iter_remove(&iter);
+        }
+    }
     g_mutex_unlock(&lcm->transmit_lock);
 
-    if (updated_channel_to_port_map) {
-        update_subscription_ports(lcm);
+    if (changed->len > 0) {
+        update_subscription_ports(lcm, changed);
     }
+    g_ptr_array_free(changed, TRUE);
 }
 
 // This function assumes that the caller is holding the receive_lock
-static void add_channel_to_subscriber(lcm_mpudpm_t *lcm, mpudpm_subscriber_t *sub,
-                                      const char *channel, uint16_t port)
+static void add_socket_to_subscriber(lcm_mpudpm_t *lcm, mpudpm_subscriber_t *sub,
+                                     const char *channel, uint16_t port)
 {
     mpudpm_socket_t *subscription_socket = NULL;
     for (GSList *sock_it = lcm->recv_sockets; sock_it != NULL; sock_it = sock_it->next) {
@@ -1039,11 +1948,82 @@ static void add_channel_to_subscriber(lcm_mpudpm_t *lcm, mpudpm_subscriber_t *su
     // increment socket reference counter
     subscription_socket->num_subscribers++;
     sub->sockets = g_slist_prepend(sub->sockets, subscription_socket);
-    char *key = strdup(channel);
-    g_hash_table_replace(sub->channel_set, key, key);
 }
 
-static void update_subscription_ports(lcm_mpudpm_t *lcm)
+// This function assumes that the caller is holding the receive_lock
+static void remove_socket_from_subscriber(lcm_mpudpm_t *lcm, mpudpm_subscriber_t *sub,
+                                          uint16_t port)
+{
+    for (GSList *it = sub->sockets; it != NULL; it = it->next) {
+        mpudpm_socket_t *sock = (mpudpm_socket_t *) it->data;
+        if (sock->port == port) {
+            sub->sockets = g_slist_delete_link(sub->sockets, it);
+            sock->num_subscribers--;
+            if (sock->num_subscribers == 0) {
+                dbg(DBG_LCM, "No more subscribers using port %d, closing it\n", sock->port);
+                remove_recv_socket(lcm, sock);
+            }
+            return;
+        }
+    }
+}
+
+// This function assumes that the caller is holding the receive_lock
+static void add_channel_to_subscriber(lcm_mpudpm_t *lcm, mpudpm_subscriber_t *sub,
+                                      const char *channel, uint16_t port)
+{
+    add_socket_to_subscriber(lcm, sub, channel, port);
+    g_hash_table_replace(sub->channel_set, strdup(channel), GUINT_TO_POINTER(port));
+}
+
+// Matches the regex of a subscriber against the channels that were added to
+// the channel_list since it was last resolved, and listens for those that
+// match.
+// This function assumes that the caller is holding both locks
+static void resolve_subscriber_regex(lcm_mpudpm_t *lcm, mpudpm_subscriber_t *sub)
+{
+    for (; sub->resolved < lcm->channel_list->len; sub->resolved++) {
+        const mpudpm_channel_t *chan =
+            (const mpudpm_channel_t *) g_ptr_array_index(lcm->channel_list, sub->resolved);
+        if (!is_reserved_channel(chan->channel) &&
+            !g_hash_table_contains(sub->channel_set, chan->channel) &&
+            g_regex_match(sub->regex, chan->channel, (GRegexMatchFlags) 0, NULL))
+            add_channel_to_subscriber(lcm, sub, chan->channel, chan->port);
+    }
+}
+
+// Makes a subscriber listen for a channel on its current port, if the
+// subscriber is looking for that channel.
+// This function assumes that the caller is holding both locks
+static void update_subscriber_channel(lcm_mpudpm_t *lcm, mpudpm_subscriber_t *sub,
+                                      const mpudpm_channel_t *chan)
+{
+    gpointer value;
+    if (g_hash_table_lookup_extended(sub->channel_set, chan->channel, NULL, &value)) {
+        uint16_t port = GPOINTER_TO_UINT(value);
+        if (port == chan->port) {
+            dbg(DBG_LCM,
+                "Subscriber (%s) already listening for [%s] "
+                "on port %d\n",
+                sub->channel_string, chan->channel, port);
+        } else {
+            // the channel was moved to another port
+            add_channel_to_subscriber(lcm, sub, chan->channel, chan->port);
+            remove_socket_from_subscriber(lcm, sub, port);
+        }
+    } else if (sub->regex != NULL && chan->index >= sub->resolved) {
+        // a channel that the regex wasn't matched against yet.  The channels
+        // before it are resolved too, the ones that this process added itself
+        // included.
+        resolve_subscriber_regex(lcm, sub);
+    }
+}
+
+// Updates the subscriptions for the mpudpm_channel_t in @channels, or for all
+// channels if it is NULL.  The regex of a subscriber is only matched against
+// the channels that it wasn't matched against before; the channels that it
+// matched are in its channel_set.
+static void update_subscription_ports(lcm_mpudpm_t *lcm, const GPtrArray *channels)
 {
     // grab both locks in the proper order
     g_mutex_lock(&lcm->receive_lock);
@@ -1051,30 +2031,37 @@ static void update_subscription_ports(lcm_mpudpm_t *lcm)
 
     for (GSList *it = lcm->subscribers; it != NULL; it = it->next) {
         mpudpm_subscriber_t *sub = (mpudpm_subscriber_t *) it->data;
-        if (sub->regex == NULL) {
+        if (channels != NULL) {
+            for (guint i = 0; i < channels->len; i++) {
+                const mpudpm_channel_t *chan =
+                    (const mpudpm_channel_t *) g_ptr_array_index(channels, i);
+                update_subscriber_channel(lcm, sub, chan);
+            }
+        } else if (sub->regex == NULL) {
             // Subscriber is looking for a single channel
-            // We should have already subscribed
-            continue;
+            const mpudpm_channel_t *chan = (const mpudpm_channel_t *) g_hash_table_lookup(
+                lcm->channel_to_port_map, sub->channel_string);
+            if (chan != NULL)
+                update_subscriber_channel(lcm, sub, chan);
         } else {
-            // Subscriber uses a regex to match a set of channels
+            // Subscriber uses a regex to match a set of channels.  Of the
+            // channels that it matched, only those on another port now need
+            // updating, which can't be done while walking the channel_set.
+            GPtrArray *moved = g_ptr_array_new();
             GHashTableIter iter;
             gpointer key, value;
-            g_hash_table_iter_init(&iter, lcm->channel_to_port_map);
+            g_hash_table_iter_init(&iter, sub->channel_set);
             while (g_hash_table_iter_next(&iter, &key, &value)) {
-                char *channel = (char *) key;
-                uint16_t port = GPOINTER_TO_UINT(value);
-                if (g_regex_match(sub->regex, channel, (GRegexMatchFlags) 0, NULL) &&
-                    !is_reserved_channel(channel)) {
-                    if (g_hash_table_lookup_extended(sub->channel_set, channel, NULL, NULL)) {
-                        dbg(DBG_LCM,
-                            "Subscriber (%s) already listening for [%s] "
-                            "on port %d\n",
-                            sub->channel_string, channel, port);
-                    } else {
-                        add_channel_to_subscriber(lcm, sub, channel, port);
-                    }
-                }
+                const mpudpm_channel_t *chan = (const mpudpm_channel_t *) g_hash_table_lookup(
+                    lcm->channel_to_port_map, key);
+                if (chan != NULL && chan->port != GPOINTER_TO_UINT(value))
+                    g_ptr_array_add(moved, (gpointer) chan);
             }
+            for (guint i = 0; i < moved->len; i++)
+                update_subscriber_channel(lcm, sub,
+                                          (const mpudpm_channel_t *) g_ptr_array_index(moved, i));
+            g_ptr_array_free(moved, TRUE);
+            resolve_subscriber_regex(lcm, sub);
         }
     }
     // Release both locks in the proper order
@@ -1086,15 +2073,36 @@ static void update_subscription_ports(lcm_mpudpm_t *lcm)
 // The transmit lock is held so that all fragments are transmitted
 // together, and so that no other message uses the same sequence number
 // (at least until the sequence # rolls over)
-// transmit_lock also protects the channel_to_port_map
-static int publish_message_internal(lcm_mpudpm_t *lcm, const char *channel, const void *data,
-                                    unsigned int datalen)
+// What publish_message_internal() needs to know about the channel of a
+// message.  A publisher from lcm_publisher_create() finds it out once, instead
+// of for every message.
+typedef struct {
+    const char *channel;
+    int channel_size;
+    int8_t compress;  // matches the compress option, or -1 if not known yet
+    // the entry of the channel in the channel_to_port_map, which is never
+    // removed, or NULL if not known yet.  Guarded by the transmit_lock.
+    mpudpm_channel_t *chan;
+} mpudpm_publisher_t;
+
+static int mpudpm_publisher_init(mpudpm_publisher_t *pub, const char *channel)
 {
-    int channel_size = strlen(channel);
-    if (channel_size > LCM_MAX_CHANNEL_NAME_LENGTH) {
+    pub->channel = channel;
+    pub->channel_size = strlen(channel);
+    if (pub->channel_size > LCM_MAX_CHANNEL_NAME_LENGTH) {
         fprintf(stderr, "LCM Error: channel name too long [%s]\n", channel);
         return -1;
     }
+    pub->compress = -1;
+    pub->chan = NULL;
+    return 0;
+}
+
+// Points dest_addr at the port of the channel of pub, for a message of
+// datalen bytes.  transmit_lock also protects the channel_to_port_map
+static int mpudpm_set_dest(lcm_mpudpm_t *lcm, mpudpm_publisher_t *pub, unsigned int datalen)
+{
+    const char *channel = pub->channel;
 
     // Set up the receive thread to manage port mapping requests if needed
     if (!lcm->recv_thread_created_tx) {
@@ -1108,41 +2116,91 @@ static int publish_message_internal(lcm_mpudpm_t *lcm, const char *channel, cons
     }
 
     // get the port for this channel
-    void *lookup_value = g_hash_table_lookup(lcm->channel_to_port_map, channel);
-    uint16_t chan_port = GPOINTER_TO_UINT(lookup_value);
-    if (lookup_value == NULL) {
+    if (pub->chan == NULL)
+        pub->chan = (mpudpm_channel_t *) g_hash_table_lookup(lcm->channel_to_port_map, channel);
+    if (pub->chan == NULL) {
         // we need to create a new destination address
-        // setup destination multicast address
-        chan_port = map_channel_to_port(lcm, channel);
-        dbg(DBG_LCM, "Messages for channel %s will be sent to port %d\n", channel, chan_port);
-
         // insert the new destination into the hash table
-        g_hash_table_insert(lcm->channel_to_port_map, strdup(channel), GUINT_TO_POINTER(chan_port));
-        // force an update to get sent
-        lcm->last_mapping_update_utime = 0;
+        pub->chan = add_channel_mapping(lcm, channel, 0);
+        dbg(DBG_LCM, "Messages for channel %s will be sent to port %d\n", channel,
+            pub->chan->port);
     }
-    if (g_get_real_time() - lcm->last_mapping_update_utime >
-        lcm->channel_to_port_map_update_period) {
+    mpudpm_channel_t *chan = pub->chan;
+    int64_t now = g_get_real_time();
+    if (channel_update_rate(chan, now) && lcm->params.load_aware &&
+        move_heavy_channel(lcm, channel, chan, now)) {
+        // tell the other processes, and the subscriptions of this one
+        mark_channel_changed(lcm, chan);
+        lcm->channel_moved = 1;
+    }
+    chan->tx_bytes += datalen;
+    // publish new or moved mappings right away
+    publish_channel_mapping_changes(lcm);
+    if (now - lcm->last_mapping_update_utime > lcm->channel_to_port_map_update_period) {
         // publish the mapping if no one has broadcast in a while
         publish_channel_mapping_update(lcm);
     }
-    // set the destination port
-    lcm->dest_addr.sin_port = htons(chan_port);
+    // set the destination port, and its group
+    lcm->dest_addr.sin_addr = port_group(&lcm->params, chan->port);
+    lcm->dest_addr.sin_port = htons(chan->port);
+    return 0;
+}
+
+// Sends a message made up of the iovcnt pieces of iov.  transmit_lock must be
+// held.
+static int publish_publisher_iov(lcm_mpudpm_t *lcm, mpudpm_publisher_t *pub,
+                                 const lcm_iovec_t *iov, int iovcnt, unsigned int datalen)
+{
+    const char *channel = pub->channel;
+    int channel_size = pub->channel_size;
+    if (mpudpm_set_dest(lcm, pub, datalen) < 0)
+        return -1;
 
     int payload_size = channel_size + 1 + datalen;
-    if (payload_size <= LCM_SHORT_MESSAGE_MAX_SIZE) {
+    int is_short = payload_size <= lcm->params.packet_size - (int) sizeof(lcm2_header_short_t);
+
+    // large messages on the channels of the compress option are sent
+    // compressed, unless that doesn't make them any smaller
+    uint32_t magic = LCM2_MAGIC_LONG;
+    char *compressed = NULL;
+    if (!is_short && pub->compress < 0)
+        pub->compress = lcm->params.compress_re &&
+                        g_regex_match(lcm->params.compress_re, channel, (GRegexMatchFlags) 0, NULL);
+    // compression, and messages of many pieces, need them in one buffer
+    char *gathered = NULL;
+    lcm_iovec_t whole;
+    if (iovcnt > 1 && ((!is_short && pub->compress) || iovcnt > LCM_MAX_PUBLISHV_IOVS)) {
+        gathered = lcm_iov_gather(iov, iovcnt, datalen);
+        whole.data = gathered;
+        whole.len = datalen;
+        iov = &whole;
+        iovcnt = 1;
+    }
+    if (!is_short && pub->compress) {
+        uint32_t compressed_size;
+        compressed = lcm_compress_payload(iov[0].data, datalen, &compressed_size);
+        if (compressed) {
+            magic = LCM2_MAGIC_LONG_LZ4;
+            datalen = compressed_size;
+            payload_size = channel_size + 1 + datalen;
+            whole.data = compressed;
+            whole.len = datalen;
+            iov = &whole;
+        }
+    }
+
+    if (is_short) {
         // message is short.  send in a single packet
         lcm2_header_short_t hdr;
         hdr.magic = htonl(LCM2_MAGIC_SHORT);
         hdr.msg_seqno = htonl(lcm->msg_seqno);
 
-        struct iovec sendbufs[3];
+        struct iovec sendbufs[2 + LCM_MAX_PUBLISHV_IOVS];
         sendbufs[0].iov_base = (char *) &hdr;
         sendbufs[0].iov_len = sizeof(hdr);
         sendbufs[1].iov_base = (char *) channel;
         sendbufs[1].iov_len = channel_size + 1;
-        sendbufs[2].iov_base = (char *) data;
-        sendbufs[2].iov_len = datalen;
+        int niov = 2 + lcm_iov_slice(iov, iovcnt, 0, datalen, sendbufs + 2);
 
         // transmit
         int packet_size = datalen + sizeof(hdr) + channel_size + 1;
@@ -1150,13 +2208,14 @@ static int publish_message_internal(lcm_mpudpm_t *lcm, const char *channel, cons
         msg.msg_name = (struct sockaddr *) &lcm->dest_addr;
         msg.msg_namelen = sizeof(lcm->dest_addr);
         msg.msg_iov = sendbufs;
-        msg.msg_iovlen = 3;
+        msg.msg_iovlen = niov;
         msg.msg_control = NULL;
         msg.msg_controllen = 0;
         msg.msg_flags = 0;
         int status = sendmsg(lcm->send_fd, &msg, 0);
 
         ++lcm->msg_seqno;
+        free(gathered);
 
         if (status == packet_size)
             return 0;
@@ -1164,35 +2223,36 @@ static int publish_message_internal(lcm_mpudpm_t *lcm, const char *channel, cons
             return status;
     } else {
         // message is large.  fragment into multiple packets
-        int fragment_size = LCM_FRAGMENT_MAX_PAYLOAD;
+        int fragment_size = lcm->params.packet_size - sizeof(lcm2_header_long_t);
         int nfragments = payload_size / fragment_size + !!(payload_size % fragment_size);
 
         if (nfragments > 65535) {
             fprintf(stderr, "LCM error: too much data for a single message\n");
+            free(compressed);
+            free(gathered);
             return -1;
         }
 
         uint32_t fragment_offset = 0;
 
         lcm2_header_long_t hdr;
-        hdr.magic = htonl(LCM2_MAGIC_LONG);
+        hdr.magic = htonl(magic);
         hdr.msg_seqno = htonl(lcm->msg_seqno);
         hdr.msg_size = htonl(datalen);
         hdr.fragment_offset = 0;
         hdr.fragment_no = 0;
         hdr.fragments_in_msg = htons(nfragments);
 
-        // first fragment is special.  insert channel before data
-        int firstfrag_datasize = fragment_size - (channel_size + 1);
-        assert(firstfrag_datasize <= datalen);
+        // first fragment is special.  insert channel before data.  A
+        // compressed message may fit in it entirely.
+        int firstfrag_datasize = MIN(fragment_size - (channel_size + 1), (int) datalen);
 
-        struct iovec first_sendbufs[3];
+        struct iovec first_sendbufs[2 + LCM_MAX_PUBLISHV_IOVS];
         first_sendbufs[0].iov_base = (char *) &hdr;
         first_sendbufs[0].iov_len = sizeof(hdr);
         first_sendbufs[1].iov_base = (char *) channel;
         first_sendbufs[1].iov_len = channel_size + 1;
-        first_sendbufs[2].iov_base = (char *) data;
-        first_sendbufs[2].iov_len = firstfrag_datasize;
+        int niov = 2 + lcm_iov_slice(iov, iovcnt, 0, firstfrag_datasize, first_sendbufs + 2);
 
         int packet_size = sizeof(hdr) + channel_size + 1 + firstfrag_datasize;
         fragment_offset += firstfrag_datasize;
@@ -1200,7 +2260,7 @@ static int publish_message_internal(lcm_mpudpm_t *lcm, const char *channel, cons
         msg.msg_name = (struct sockaddr *) &lcm->dest_addr;
         msg.msg_namelen = sizeof(lcm->dest_addr);
         msg.msg_iov = first_sendbufs;
-        msg.msg_iovlen = 3;
+        msg.msg_iovlen = niov;
         msg.msg_control = NULL;
         msg.msg_controllen = 0;
         msg.msg_flags = 0;
@@ -1213,14 +2273,13 @@ static int publish_message_internal(lcm_mpudpm_t *lcm, const char *channel, cons
 
             int fraglen = MIN(fragment_size, datalen - fragment_offset);
 
-            struct iovec sendbufs[2];
+            struct iovec sendbufs[1 + LCM_MAX_PUBLISHV_IOVS];
             sendbufs[0].iov_base = (char *) &hdr;
             sendbufs[0].iov_len = sizeof(hdr);
-            sendbufs[1].iov_base = (char *) ((char *) data + fragment_offset);
-            sendbufs[1].iov_len = fraglen;
+            niov = 1 + lcm_iov_slice(iov, iovcnt, fragment_offset, fraglen, sendbufs + 1);
 
             msg.msg_iov = sendbufs;
-            msg.msg_iovlen = 2;
+            msg.msg_iovlen = niov;
             status = sendmsg(lcm->send_fd, &msg, 0);
 
             fragment_offset += fraglen;
@@ -1233,10 +2292,58 @@ static int publish_message_internal(lcm_mpudpm_t *lcm, const char *channel, cons
         }
 
         ++lcm->msg_seqno;
+        free(compressed);
+        free(gathered);
         return 0;
     }
 }
 
+static int publish_publisher_message(lcm_mpudpm_t *lcm, mpudpm_publisher_t *pub,
+                                     const void *data, unsigned int datalen)
+{
+    lcm_iovec_t iov;
+    iov.data = data;
+    iov.len = datalen;
+    return publish_publisher_iov(lcm, pub, &iov, 1, datalen);
+}
+
+static int publish_message_internal(lcm_mpudpm_t *lcm, const char *channel, const void *data,
+                                    unsigned int datalen)
+{
+    mpudpm_publisher_t pub;
+    if (mpudpm_publisher_init(&pub, channel) < 0)
+        return -1;
+    return publish_publisher_message(lcm, &pub, data, datalen);
+}
+
+// Publishes a message of the user, made up of the iovcnt pieces of iov, on a
+// channel that isn't reserved.
+static int publish_user_iov(lcm_mpudpm_t *lcm, mpudpm_publisher_t *pub, const lcm_iovec_t *iov,
+                            int iovcnt, unsigned int datalen)
+{
+    // acquire lock so that we can call the internal publish function
+    g_mutex_lock(&lcm->transmit_lock);
+    int status = publish_publisher_iov(lcm, pub, iov, iovcnt, datalen);
+    int8_t channel_moved = lcm->channel_moved;
+    lcm->channel_moved = 0;
+    g_mutex_unlock(&lcm->transmit_lock);
+
+    if (channel_moved) {
+        // listen on the new port of the channel, which needs the receive_lock
+        update_subscription_ports(lcm, NULL);
+    }
+    return status;
+}
+
+static int publish_user_message(lcm_mpudpm_t *lcm, mpudpm_publisher_t *pub, const void *data,
+                                unsigned int datalen)
+{
+    lcm_iovec_t iov;
+    iov.data = data;
+    iov.len = datalen;
+    return publish_user_iov(lcm, pub, &iov, 1, datalen);
+}
+
 static int lcm_mpudpm_publish(lcm_mpudpm_t *lcm, const char *channel, const void *data,
                               unsigned int datalen)
 {
@@ -1248,14 +2355,189 @@ static int lcm_mpudpm_publish(lcm_mpudpm_t *lcm, const char *channel, const void
         return -1;
     }
 
-    // acquire lock so that we can call the internal publish function
+    mpudpm_publisher_t pub;
+    if (mpudpm_publisher_init(&pub, channel) < 0)
+        return -1;
+    return publish_user_message(lcm, &pub, data, datalen);
+}
+
+static int lcm_mpudpm_publishv(lcm_mpudpm_t *lcm, const char *channel, const lcm_iovec_t *iov,
+                               int iovcnt, unsigned int datalen)
+{
+    if (is_reserved_channel(channel)) {
+        fprintf(stderr,
+                "ERROR: can't publish to channel %s."
+                "It uses a reserved channel prefix (%s)\n",
+                channel, RESERVED_CHANNEL_PREFIX);
+        return -1;
+    }
+
+    mpudpm_publisher_t pub;
+    if (mpudpm_publisher_init(&pub, channel) < 0)
+        return -1;
+    return publish_user_iov(lcm, &pub, iov, iovcnt, datalen);
+}
+
+#ifdef USE_SENDMMSG
+// most messages passed to a single sendmmsg() call
+#define MPUDPM_SENDMMSG_BATCH 64
+
+// Sends the n datagrams of msgs with as few sendmmsg() calls as possible.
+// Returns 0 on success, -1 on error.
+static int mpudpm_sendmmsg(lcm_mpudpm_t *lcm, struct mmsghdr *msgs, int n)
+{
+    int sent = 0;
+    while (sent < n) {
+        int status = sendmmsg(lcm->send_fd, msgs + sent, n - sent, 0);
+        if (status < 0 && errno == EINTR)
+            continue;
+        if (status <= 0)
+            return -1;
+        sent += status;
+    }
+    return 0;
+}
+
+// Publishes the messages in order, with the transmit_lock taken once.  The
+// messages that fit into a datagram are sent with as few sendmmsg() calls as
+// possible, each to the port of its channel, and the others one at a time.
+static int lcm_mpudpm_publish_batch(lcm_mpudpm_t *lcm, const lcm_publish_msg_t *msgs,
+                                    int num_msgs)
+{
+    lcm2_header_short_t hdrs[MPUDPM_SENDMMSG_BATCH];
+    struct sockaddr_in dests[MPUDPM_SENDMMSG_BATCH];
+    struct iovec iovs[MPUDPM_SENDMMSG_BATCH][3];
+    struct mmsghdr mmsgs[MPUDPM_SENDMMSG_BATCH];
+    int status = 0;
+    int n = 0;
+
     g_mutex_lock(&lcm->transmit_lock);
-    int status = publish_message_internal(lcm, channel, data, datalen);
+    for (int i = 0; i < num_msgs; i++) {
+        const lcm_publish_msg_t *msg = &msgs[i];
+        mpudpm_publisher_t pub;
+        if (is_reserved_channel(msg->channel)) {
+            fprintf(stderr,
+                    "ERROR: can't publish to channel %s."
+                    "It uses a reserved channel prefix (%s)\n",
+                    msg->channel, RESERVED_CHANNEL_PREFIX);
+            status = -1;
+            continue;
+        }
+        if (mpudpm_publisher_init(&pub, msg->channel) < 0) {
+            status = -1;
+            continue;
+        }
+
+        int packet_size = (int) sizeof(lcm2_header_short_t) + pub.channel_size + 1 + msg->datalen;
+        if (packet_size > lcm->params.packet_size) {
+            // fragmented, after the messages before it
+            if (n > 0 && mpudpm_sendmmsg(lcm, mmsgs, n) < 0)
+                status = -1;
+            n = 0;
+            if (0 != publish_publisher_message(lcm, &pub, msg->data, msg->datalen))
+                status = -1;
+            continue;
+        }
+
+        if (mpudpm_set_dest(lcm, &pub, msg->datalen) < 0) {
+            status = -1;
+            continue;
+        }
+        dests[n] = lcm->dest_addr;
+        hdrs[n].magic = htonl(LCM2_MAGIC_SHORT);
+        hdrs[n].msg_seqno = htonl(lcm->msg_seqno++);
+        iovs[n][0].iov_base = (char *) &hdrs[n];
+        iovs[n][0].iov_len = sizeof(lcm2_header_short_t);
+        iovs[n][1].iov_base = (char *) msg->channel;
+        iovs[n][1].iov_len = pub.channel_size + 1;
+        iovs[n][2].iov_base = (char *) msg->data;
+        iovs[n][2].iov_len = msg->datalen;
+        memset(&mmsgs[n], 0, sizeof(struct mmsghdr));
+        mmsgs[n].msg_hdr.msg_name = (struct sockaddr *) &dests[n];
+        mmsgs[n].msg_hdr.msg_namelen = sizeof(dests[n]);
+        mmsgs[n].msg_hdr.msg_iov = iovs[n];
+        mmsgs[n].msg_hdr.msg_iovlen = 3;
+        if (++n == MPUDPM_SENDMMSG_BATCH) {
+            if (mpudpm_sendmmsg(lcm, mmsgs, n) < 0)
+                status = -1;
+            n = 0;
+        }
+    }
+    if (n > 0 && mpudpm_sendmmsg(lcm, mmsgs, n) < 0)
+        status = -1;
+    int8_t channel_moved = lcm->channel_moved;
+    lcm->channel_moved = 0;
     g_mutex_unlock(&lcm->transmit_lock);
+
+    if (channel_moved) {
+        // listen on the new port of the channel, which needs the receive_lock
+        update_subscription_ports(lcm, NULL);
+    }
     return status;
 }
+#endif
 
-static int lcm_mpudpm_handle(lcm_mpudpm_t *lcm)
+static void *lcm_mpudpm_publisher_create(lcm_mpudpm_t *lcm, const char *channel)
+{
+    if (is_reserved_channel(channel)) {
+        fprintf(stderr,
+                "ERROR: can't publish to channel %s."
+                "It uses a reserved channel prefix (%s)\n",
+                channel, RESERVED_CHANNEL_PREFIX);
+        return NULL;
+    }
+    mpudpm_publisher_t *pub = (mpudpm_publisher_t *) malloc(sizeof(mpudpm_publisher_t));
+    if (mpudpm_publisher_init(pub, channel) < 0) {
+        free(pub);
+        return NULL;
+    }
+    return pub;
+}
+
+static int lcm_mpudpm_publisher_publish(lcm_mpudpm_t *lcm, void *publisher, const void *data,
+                                        unsigned int datalen)
+{
+    return publish_user_message(lcm, (mpudpm_publisher_t *) publisher, data, datalen);
+}
+
+static void lcm_mpudpm_publisher_destroy(lcm_mpudpm_t *lcm, void *publisher)
+{
+    (void) lcm;
+    free(publisher);
+}
+
+// take the next received message of the highest priority class from any of
+// the read threads, taking turns between them.  Stores the thread that the
+// message came from in owner.
+static lcm_buf_t *pop_filled(lcm_mpudpm_t *lcm, mpudpm_recv_thread_t **owner)
+{
+    for (int priority = LCM_MAX_PRIORITY; priority >= 0; priority--) {
+        for (int i = 0; i < lcm->num_recv_threads; i++) {
+            mpudpm_recv_thread_t *rt = &lcm->recv_threads[lcm->next_recv_thread];
+            lcm->next_recv_thread = (lcm->next_recv_thread + 1) % lcm->num_recv_threads;
+
+            lcm_buf_t *lcmb = lcm_buf_ring_pop(rt->inbufs_filled[priority]);
+            if (lcmb) {
+                *owner = rt;
+                return lcmb;
+            }
+        }
+    }
+    return NULL;
+}
+
+static int any_filled(lcm_mpudpm_t *lcm)
+{
+    for (int priority = 0; priority <= LCM_MAX_PRIORITY; priority++) {
+        for (int i = 0; i < lcm->num_recv_threads; i++) {
+            if (!lcm_buf_ring_is_empty(lcm->recv_threads[i].inbufs_filled[priority]))
+                return 1;
+        }
+    }
+    return 0;
+}
+
+static int lcm_mpudpm_handle_batch(lcm_mpudpm_t *lcm, int max_msgs)
 {
     int status;
     char ch;
@@ -1264,7 +2546,8 @@ static int lcm_mpudpm_handle(lcm_mpudpm_t *lcm)
     }
 
     /* Read one byte from the notify pipe.  This will block if no packets are
-     * available yet and wake up when they are. */
+     * available yet and wake up when they are.  Packets that arrive from now
+     * on need a new notification. */
     status = lcm_internal_pipe_read(lcm->notify_pipe[0], &ch, 1);
     if (status == 0) {
         fprintf(stderr, "Error: lcm_handle read 0 bytes from notify_pipe\n");
@@ -1273,44 +2556,71 @@ static int lcm_mpudpm_handle(lcm_mpudpm_t *lcm)
         fprintf(stderr, "Error: lcm_handle read: %s\n", strerror(errno));
         return -1;
     }
+    g_atomic_int_set(&lcm->notified, 0);
 
-    /* Dequeue the next received packet */
-    g_mutex_lock(&lcm->receive_lock);
-    lcm_buf_t *lcmb = lcm_buf_dequeue(lcm->inbufs_filled);
-
+    mpudpm_recv_thread_t *owner;
+    lcm_buf_t *lcmb = pop_filled(lcm, &owner);
     if (!lcmb) {
         fprintf(stderr, "Error: no packet available despite getting notification.\n");
-        g_mutex_unlock(&lcm->receive_lock);
         return -1;
     }
 
-    /* If there are still packets in the queue, put something back in the pipe
-     * so that future invocations will get called. */
-    if (!lcm_buf_queue_is_empty(lcm->inbufs_filled))
-        if (lcm_internal_pipe_write(lcm->notify_pipe[1], "+", 1) < 0)
-            perror("write to notify");
-    g_mutex_unlock(&lcm->receive_lock);
+    /* Dispatch up to max_msgs received packets */
+    int nhandled = 0;
+    while (lcmb) {
+        lcm_recv_buf_t rbuf;
+        rbuf.data = (uint8_t *) lcmb->buf + lcmb->data_offset;
+        rbuf.data_size = lcmb->data_size;
+        rbuf.recv_utime = lcmb->recv_utime;
+        rbuf.recv_time_ns = lcmb->recv_utime * 1000;
+        rbuf.recv_mono_ns = lcmb->recv_mono_ns;
+        rbuf.lcm = lcm->lcm;
 
-    lcm_recv_buf_t rbuf;
-    rbuf.data = (uint8_t *) lcmb->buf + lcmb->data_offset;
-    rbuf.data_size = lcmb->data_size;
-    rbuf.recv_utime = lcmb->recv_utime;
-    rbuf.lcm = lcm->lcm;
-
-    if (lcm->creating_read_thread) {
+        lcm_buf_lend(lcmb, &owner->returns);
         // special case:  If we're creating the read thread and are in
         // self-test mode, then only dispatch the self-test message.
-        if (!strcmp(lcmb->channel_name, SELF_TEST_CHANNEL))
-            lcm_dispatch_handlers(lcm->lcm, &rbuf, lcmb->channel_name);
-    } else {
-        lcm_dispatch_handlers(lcm->lcm, &rbuf, lcmb->channel_name);
+        if (!lcm->creating_read_thread || !strcmp(lcmb->channel_name, SELF_TEST_CHANNEL))
+            lcm_dispatch_channel_handlers(lcm->lcm, &rbuf, lcmb->channel_id, lcmb->channel_name,
+                                          &lcm_buf_lender, lcmb);
+
+        /* Hand the packet back to its read thread, which owns the ringbuffer.
+         * This never fails: the read thread reclaims every handled packet
+         * before it allocates new ones, so inbufs_done never holds more than
+         * all of the inbufs_filled queues worth of packets plus one batch, and
+         * it is sized for that. */
+        if (lcm_buf_lend_end(lcmb)) {
+            status = lcm_buf_ring_push(owner->inbufs_done, lcmb);
+            assert(status >= 0);
+        }
+        nhandled++;
+        lcmb = nhandled < max_msgs ? pop_filled(lcm, &owner) : NULL;
     }
 
-    g_mutex_lock(&lcm->receive_lock);
-    lcm_buf_free_data(lcmb, lcm->ringbuf);
-    lcm_buf_enqueue(lcm->inbufs_empty, lcmb);
-    g_mutex_unlock(&lcm->receive_lock);
+    /* If there are still packets in the queues, put something back in the
+     * pipe so that future invocations will get called.  Otherwise, take back
+     * the notification that a read thread may have left in the meantime for
+     * packets that were dispatched above already, or lcm_get_fileno() would
+     * stay readable without a packet to dispatch. */
+    while (!any_filled(lcm)) {
+        if (!g_atomic_int_compare_and_exchange(&lcm->notified, 1, 0))
+            return nhandled;
+        // the read thread may not have written it yet, but is about to
+        if (lcm_internal_pipe_read(lcm->notify_pipe[0], &ch, 1) <= 0)
+            return nhandled;
+    }
+    notify_handle(lcm);
+
+    return nhandled;
+}
+
+static int lcm_mpudpm_handle(lcm_mpudpm_t *lcm)
+{
+    return lcm_mpudpm_handle_batch(lcm, 1) < 0 ? -1 : 0;
+}
 
+static int lcm_mpudpm_get_stats(lcm_mpudpm_t *lcm, lcm_stats_t *stats)
+{
+    lcm_udp_stats_read(&lcm->stats, stats);
     return 0;
 }
 
@@ -1378,6 +2688,23 @@ static int mpudpm_self_test(lcm_mpudpm_t *lcm)
     return (success == 1) ? 0 : -1;
 }
 
+// Hands an opened or closed receive socket to its read thread, which updates
+// its poller before it waits again.  Only the first change since the last
+// update needs to wake it up.
+// This function assumes that the caller is holding the lcm->receive_lock
+static void queue_recv_socket_change(lcm_mpudpm_t *lcm, GSList **changes, mpudpm_socket_t *sock)
+{
+    mpudpm_recv_thread_t *rt = sock->owner;
+    int wake = rt->recv_sockets_added == NULL && rt->recv_sockets_removed == NULL;
+    *changes = g_slist_prepend(*changes, sock);
+    if (wake && lcm->recv_thread_created) {
+        int wstatus = lcm_internal_pipe_write(rt->thread_msg_pipe[1], "c", 1);
+        if (wstatus < 0) {
+            perror(__FILE__ " thread_msg_pipe write: cancel_wait");
+        }
+    }
+}
+
 // This function assumes that the caller is holding the lcm->receive_lock
 static mpudpm_socket_t *add_recv_socket(lcm_mpudpm_t *lcm, uint16_t port)
 {
@@ -1392,7 +2719,7 @@ static mpudpm_socket_t *add_recv_socket(lcm_mpudpm_t *lcm, uint16_t port)
     memset(&addr, 0, sizeof(addr));
     addr.sin_family = AF_INET;
 #ifndef WIN32
-    addr.sin_addr = lcm->params.mc_addr;
+    addr.sin_addr = port_group(&lcm->params, port);
 #else
     // On WIN32 if we try to bind to mc_addr, we get WSAEADDRNOTAVAIL.
     // See https://github.com/lcm-proj/lcm/issues/258.
@@ -1464,6 +2791,11 @@ static mpudpm_socket_t *add_recv_socket(lcm_mpudpm_t *lcm, uint16_t port)
     opt = 1;
     setsockopt(recv_fd, SOL_SOCKET, SO_TIMESTAMP, &opt, sizeof(opt));
 #endif
+#ifdef SO_RXQ_OVFL
+    // report datagrams dropped because the socket buffer was full
+    opt = 1;
+    setsockopt(recv_fd, SOL_SOCKET, SO_RXQ_OVFL, &opt, sizeof(opt));
+#endif
 
     if (bind(recv_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
         perror("bind");
@@ -1471,10 +2803,10 @@ static mpudpm_socket_t *add_recv_socket(lcm_mpudpm_t *lcm, uint16_t port)
     }
 
     struct ip_mreq mreq;
-    mreq.imr_multiaddr = lcm->params.mc_addr;
+    mreq.imr_multiaddr = port_group(&lcm->params, port);
     mreq.imr_interface.s_addr = INADDR_ANY;
     // join the multicast group
-    dbg(DBG_LCM, "LCM: joining multicast group\n");
+    dbg(DBG_LCM, "LCM: joining multicast group %s\n", inet_ntoa(mreq.imr_multiaddr));
     if (setsockopt(recv_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, (char *) &mreq, sizeof(mreq)) < 0) {
         perror("setsockopt (IPPROTO_IP, IP_ADD_MEMBERSHIP)");
         goto add_recv_socket_fail;
@@ -1485,13 +2817,16 @@ static mpudpm_socket_t *add_recv_socket(lcm_mpudpm_t *lcm, uint16_t port)
     subscriber_socket->port = port;
     subscriber_socket->num_subscribers = 0;
     lcm->recv_sockets = g_slist_prepend(lcm->recv_sockets, subscriber_socket);
-    lcm->recv_sockets_changed = 1;
 
-    // Tell read thread that a select should be canceled
-    int wstatus = lcm_internal_pipe_write(lcm->thread_msg_pipe[1], "c", 1);
-    if (wstatus < 0) {
-        perror(__FILE__ " thread_msg_pipe write: cancel_select");
+    // the read thread with the fewest sockets reads from this one
+    mpudpm_recv_thread_t *owner = &lcm->recv_threads[0];
+    for (int i = 1; i < lcm->num_recv_threads; i++) {
+        if (lcm->recv_threads[i].num_sockets < owner->num_sockets)
+            owner = &lcm->recv_threads[i];
     }
+    owner->num_sockets++;
+    subscriber_socket->owner = owner;
+    queue_recv_socket_change(lcm, &owner->recv_sockets_added, subscriber_socket);
     return subscriber_socket;
 
 add_recv_socket_fail:
@@ -1499,18 +2834,13 @@ add_recv_socket_fail:
     return NULL;
 }
 
-// This function assumes that the caller is holding the lcm->receive_lock
+// This function assumes that the caller is holding the lcm->receive_lock.
+// The socket is destroyed by its read thread once it stopped polling it.
 static void remove_recv_socket(lcm_mpudpm_t *lcm, mpudpm_socket_t *sock)
 {
-    // Tell read thread that a select should be canceled
-    int wstatus = lcm_internal_pipe_write(lcm->thread_msg_pipe[1], "c", 1);
-    if (wstatus < 0) {
-        perror(__FILE__ " thread_msg_pipe write: cancel_select");
-    }
-    lcm->recv_sockets_changed = 1;
-
     lcm->recv_sockets = g_slist_remove(lcm->recv_sockets, sock);
-    mpudpm_socket_t_destroy(sock);
+    sock->owner->num_sockets--;
+    queue_recv_socket_change(lcm, &sock->owner->recv_sockets_removed, sock);
 }
 
 static int setup_recv_parts(lcm_mpudpm_t *lcm)
@@ -1561,34 +2891,80 @@ static int setup_recv_parts(lcm_mpudpm_t *lcm)
 
     dbg(DBG_LCM, "allocating resources for receiving messages\n");
 
-    // allocate the fragment buffer hashtable
-    lcm->frag_bufs = lcm_frag_buf_store_new(MAX_FRAG_BUF_TOTAL_SIZE, MAX_NUM_FRAG_BUFS);
+    lcm->frag_pool = lcm_buf_pool_new(MAX_FRAG_BUF_TOTAL_SIZE, lcm->params.align);
+
+    // a thread without ports would have nothing to do
+    lcm->num_recv_threads = MIN(lcm->params.recv_threads, lcm->params.num_mc_ports);
+    lcm->next_recv_thread = 0;
+    lcm->recv_threads =
+        (mpudpm_recv_thread_t *) calloc(lcm->num_recv_threads, sizeof(mpudpm_recv_thread_t));
+    for (int i = 0; i < lcm->num_recv_threads; i++)
+        lcm->recv_threads[i].thread_msg_pipe[0] = lcm->recv_threads[i].thread_msg_pipe[1] = -1;
+
+    for (int i = 0; i < lcm->num_recv_threads; i++) {
+        mpudpm_recv_thread_t *rt = &lcm->recv_threads[i];
+        rt->lcm = lcm;
+
+        // allocate the fragment buffer hashtable
+        rt->frag_bufs = lcm_frag_buf_store_new(MAX_FRAG_BUF_TOTAL_SIZE, MAX_NUM_FRAG_BUFS);
+
+        rt->inbufs_empty = lcm_buf_queue_new();
+        rt->inbufs_filled[0] = lcm_buf_ring_new(LCM_RECV_QUEUE_SIZE);
+        for (int priority = 1; priority <= LCM_MAX_PRIORITY; priority++)
+            rt->inbufs_filled[priority] = lcm_buf_ring_new(LCM_PRIORITY_QUEUE_SIZE);
+        rt->inbufs_done = lcm_buf_ring_new(2 * LCM_RECV_QUEUE_SIZE);
+        lcm_buf_returns_init(&rt->returns);
+        rt->ringbuf = lcm_ringbuf_new(LCM_RINGBUF_SIZE);
+
+        for (int j = 0; j < LCM_DEFAULT_RECV_BUFS; j++) {
+            /* We don't set the receive buffer's data pointer yet because it
+             * will be taken from the ringbuffer at receive time. */
+            lcm_buf_t *lcmb = (lcm_buf_t *) calloc(1, sizeof(lcm_buf_t));
+            lcm_buf_enqueue(rt->inbufs_empty, lcmb);
+        }
 
-    lcm->inbufs_empty = lcm_buf_queue_new();
-    lcm->inbufs_filled = lcm_buf_queue_new();
-    lcm->ringbuf = lcm_ringbuf_new(LCM_RINGBUF_SIZE);
+        // setup a pipe for notifying the reader thread when to quit
+        if (0 != lcm_internal_pipe_create(rt->thread_msg_pipe)) {
+            perror(__FILE__ " pipe(setup)");
+            goto setup_recv_thread_fail;
+        }
+        fcntl(rt->thread_msg_pipe[1], F_SETFL, O_NONBLOCK);
 
-    for (int i = 0; i < LCM_DEFAULT_RECV_BUFS; i++) {
-        /* We don't set the receive buffer's data pointer yet because it
-         * will be taken from the ringbuffer at receive time. */
-        lcm_buf_t *lcmb = (lcm_buf_t *) calloc(1, sizeof(lcm_buf_t));
-        lcm_buf_enqueue(lcm->inbufs_empty, lcmb);
-    }
+        rt->poller = lcm_poller_new();
+        if (!rt->poller ||
+            lcm_poller_add(rt->poller, rt->thread_msg_pipe[0], rt->thread_msg_pipe) < 0) {
+            fprintf(stderr, "Error: LCM failed to set up socket polling\n");
+            goto setup_recv_thread_fail;
+        }
 
-    // setup a pipe for notifying the reader thread when to quit
-    if (0 != lcm_internal_pipe_create(lcm->thread_msg_pipe)) {
-        perror(__FILE__ " pipe(setup)");
-        goto setup_recv_thread_fail;
+#ifdef USE_IO_URING
+        if (lcm->params.io_uring) {
+            rt->uring = lcm_uring_new();
+            if (!rt->uring) {
+                fprintf(stderr,
+                        "Warning: LCM failed to set up io_uring, receiving with recvmsg()\n");
+            } else if (lcm_uring_poll(rt->uring, rt->thread_msg_pipe[0], rt->thread_msg_pipe) <
+                       0) {
+                fprintf(stderr, "Error: LCM failed to set up io_uring\n");
+                goto setup_recv_thread_fail;
+            }
+        }
+#endif
     }
-    fcntl(lcm->thread_msg_pipe[1], F_SETFL, O_NONBLOCK);
 
-    /* Start the reader thread */
-    lcm->read_thread = g_thread_new(NULL, recv_thread, lcm);
-    if (!lcm->read_thread) {
-        fprintf(stderr, "Error: LCM failed to start reader thread\n");
-        goto setup_recv_thread_fail;
-    }
+    /* Start the reader threads */
     lcm->recv_thread_created = 1;
+    for (int i = 0; i < lcm->num_recv_threads; i++) {
+        mpudpm_recv_thread_t *rt = &lcm->recv_threads[i];
+        lcm_thread_sched_t sched = lcm->params.recv_sched;
+        if (sched.cpu >= 0)
+            sched.cpu += i;
+        rt->thread = lcm_internal_thread_new("lcm-mpudpm-recv", recv_thread, rt, &sched);
+        if (!rt->thread) {
+            fprintf(stderr, "Error: LCM failed to start reader thread\n");
+            goto setup_recv_thread_fail;
+        }
+    }
 
     // add receive socket to listen for updates to the channel mapping
     mpudpm_socket_t *sock = add_recv_socket(lcm, lcm->params.mc_port_range_start);
@@ -1645,27 +3021,36 @@ static lcm_provider_t *lcm_mpudpm_create(lcm_t *parent, const char *network, con
     mpudpm_params_t params;
     memset(&params, 0, sizeof(mpudpm_params_t));
     params.num_mc_ports = 500;
+    params.heavy_rate = DEFAULT_HEAVY_RATE;
+    lcm_thread_sched_init(&params.recv_sched);
+    params.recv_threads = 1;
 
     g_hash_table_foreach((GHashTable *) args, new_argument, &params);
 
     if (parse_mc_addr_and_port(network, &params) < 0) {
+        mpudpm_params_t_clear(&params);
         return NULL;
     }
+    params.packet_size = lcm_resolve_packet_size(params.packet_size, params.mc_addr);
+    // the groups of all the ports have to be multicast addresses
+    uint32_t last_group = ntohl(params.mc_addr.s_addr) + params.num_mc_ports - 1;
+    if (params.group_per_port && (last_group >> 28) != 0xe) {
+        fprintf(stderr, "Warning: group_per_port needs %d multicast addresses from %s\n",
+                params.num_mc_ports, inet_ntoa(params.mc_addr));
+        params.group_per_port = 0;
+    }
 
     lcm_mpudpm_t *lcm = (lcm_mpudpm_t *) calloc(1, sizeof(lcm_mpudpm_t));
 
     lcm->lcm = parent;
     lcm->params = params;
+    setup_port_pins(lcm);
     lcm->recv_sockets = NULL;
     lcm->send_fd = -1;
-    lcm->thread_msg_pipe[0] = lcm->thread_msg_pipe[1] = -1;
-    lcm->udp_low_watermark = 1.0;
 
     lcm->kernel_rbuf_sz = 0;
     lcm->warned_about_small_kernel_buf = 0;
 
-    lcm->frag_bufs = NULL;
-
     // synchronization variables used when allocating receive resources
     lcm->creating_read_thread = 0;
     lcm->p_create_read_thread_mutex = NULL;
@@ -1686,9 +3071,16 @@ static lcm_provider_t *lcm_mpudpm_create(lcm_t *parent, const char *network, con
         params.mc_port_range_start, params.mc_port_range_start + params.num_mc_ports - 1);
 
     // create the channel string to port number hash table
-    // we strdup keys so pass free() as the destory function for keys,
-    // but store shorts as pointers so no destroy function for values
-    lcm->channel_to_port_map = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
+    // we strdup keys and calloc values so pass free() as the destory function
+    // for both
+    lcm->channel_to_port_map = g_hash_table_new_full(g_str_hash, g_str_equal, free, free);
+    lcm->channel_list = g_ptr_array_new();
+    lcm->map_changes = g_ptr_array_new();
+    lcm->map_senders = g_hash_table_new_full(g_int64_hash, g_int64_equal, free, free);
+    do {
+        lcm->map_sender_id = ((int64_t) g_random_int() << 32) | g_random_int();
+    } while (lcm->map_sender_id == 0);
+    lcm->map_version = 1;
 
     // Create a regex to find whether subscribers use a regex to get a set of
     // channels instead of just listening to a single channel.
@@ -1703,12 +3095,9 @@ static lcm_provider_t *lcm_mpudpm_create(lcm_t *parent, const char *network, con
     }
 
     // put all the internal channels into the channel_to_port_map
-    g_hash_table_insert(lcm->channel_to_port_map, strdup(CHANNEL_TO_PORT_MAP_UPDATE_CHANNEL),
-                        GUINT_TO_POINTER(lcm->params.mc_port_range_start));
-    g_hash_table_insert(lcm->channel_to_port_map, strdup(CHANNEL_TO_PORT_MAP_REQUEST_CHANNEL),
-                        GUINT_TO_POINTER(lcm->params.mc_port_range_start));
-    g_hash_table_insert(lcm->channel_to_port_map, strdup(SELF_TEST_CHANNEL),
-                        GUINT_TO_POINTER(map_channel_to_port(lcm, SELF_TEST_CHANNEL)));
+    add_channel_mapping(lcm, CHANNEL_TO_PORT_MAP_UPDATE_CHANNEL, lcm->params.mc_port_range_start);
+    add_channel_mapping(lcm, CHANNEL_TO_PORT_MAP_REQUEST_CHANNEL, lcm->params.mc_port_range_start);
+    add_channel_mapping(lcm, SELF_TEST_CHANNEL, 0);
 
     // setup destination multicast address (
     memset(&lcm->dest_addr, 0, sizeof(lcm->dest_addr));
@@ -1807,6 +3196,15 @@ static lcm_provider_vtable_t mpudpm_vtable = {
     .publish = lcm_mpudpm_publish,
     .handle = lcm_mpudpm_handle,
     .get_fileno = lcm_mpudpm_get_fileno,
+    .handle_batch = lcm_mpudpm_handle_batch,
+    .get_stats = lcm_mpudpm_get_stats,
+    .publishv = lcm_mpudpm_publishv,
+#ifdef USE_SENDMMSG
+    .publish_batch = lcm_mpudpm_publish_batch,
+#endif
+    .publisher_create = lcm_mpudpm_publisher_create,
+    .publisher_publish = lcm_mpudpm_publisher_publish,
+    .publisher_destroy = lcm_mpudpm_publisher_destroy,
 };
 #endif
 static lcm_provider_info_t mpudpm_info;
@@ -1823,6 +3221,12 @@ void lcm_mpudpm_provider_init(GPtrArray *providers)
     mpudpm_vtable.publish = lcm_mpudpm_publish;
     mpudpm_vtable.handle = lcm_mpudpm_handle;
     mpudpm_vtable.get_fileno = lcm_mpudpm_get_fileno;
+    mpudpm_vtable.handle_batch = lcm_mpudpm_handle_batch;
+    mpudpm_vtable.get_stats = lcm_mpudpm_get_stats;
+    mpudpm_vtable.publishv = lcm_mpudpm_publishv;
+    mpudpm_vtable.publisher_create = lcm_mpudpm_publisher_create;
+    mpudpm_vtable.publisher_publish = lcm_mpudpm_publisher_publish;
+    mpudpm_vtable.publisher_destroy = lcm_mpudpm_publisher_destroy;
 #endif
     mpudpm_info.name = "mpudpm";
     mpudpm_info.vtable = &mpudpm_vtable;
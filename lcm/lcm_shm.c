@@ -0,0 +1,613 @@
+#ifdef __linux__
+// syscall() is a GNU extension
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dbg.h"
+#include "lcm_internal.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * The shm provider exchanges messages between processes on the same host
+ * through a ring buffer in a POSIX shared memory segment, one per group name.
+ *
+ * Publishers append records to the ring under a process-shared mutex, then
+ * advance write_pos and wake up waiting subscribers with a futex.  There is no
+ * flow control: publishers overwrite the oldest records, like a UDP socket
+ * whose receive buffer is full.
+ *
+ * Each subscribing process keeps its own read position.  A thread per lcm_t
+ * waits on the futex and makes the eventfd returned by lcm_get_fileno()
+ * readable.  lcm_handle() then dispatches messages straight out of the
+ * shared memory segment, without copying them.
+ */
+
+#define SHM_MAGIC 0x4c434d53  // "LCMS"
+#define SHM_VERSION 1
+
+#define SHM_DEFAULT_SIZE (64 * 1024 * 1024)
+#define SHM_MIN_SIZE (64 * 1024)
+#define SHM_MAX_SIZE (1U << 31)
+
+// records, and so the channel name and data in them, are 8-byte aligned
+#define SHM_ALIGN 8
+
+// shm_record_t.flags: skip to the start of the ring
+#define SHM_RECORD_PADDING 1
+
+typedef struct _shm_header_t shm_header_t;
+struct _shm_header_t {
+    uint32_t magic;  // set last, once the rest of the header is initialized
+    uint32_t version;
+    uint64_t capacity;  // size of the data area that follows the header
+
+    pthread_mutex_t write_lock;  // serializes publishers
+    uint64_t write_pos;          // bytes ever written.  Records end here.
+    uint64_t last_record_pos;    // start of the newest record
+
+    uint32_t futex_seq;    // incremented after every publish
+    uint32_t num_waiters;  // threads waiting on futex_seq
+};
+
+typedef struct _shm_record_t shm_record_t;
+struct _shm_record_t {
+    uint32_t size;  // bytes from the start of this record to the next one
+    uint32_t flags;
+    uint32_t channel_len;  // not counting the terminating NUL
+    uint32_t data_size;
+    int64_t time_ns;  // publish time, in nanoseconds since the epoch
+    // followed by the channel name, NUL, and the data
+};
+
+/**
+ * shm_params_t:
+ * @size:        size of the ring, if this process creates the segment
+ * @wait_sched:  CPU and priority of the thread waiting for messages
+ */
+typedef struct _shm_params_t shm_params_t;
+struct _shm_params_t {
+    uint64_t size;
+    lcm_thread_sched_t wait_sched;
+};
+
+typedef struct _lcm_provider_t lcm_shm_t;
+struct _lcm_provider_t {
+    lcm_t *lcm;
+    char *name;  // of the shared memory object
+
+    shm_header_t *hdr;
+    uint8_t *ring;
+    uint64_t capacity;
+    size_t map_size;
+    // largest record a publisher may write.  A reader must stay within
+    // capacity - 2 * max_record of write_pos, since a publisher may write up
+    // to that much (padding and a record) past write_pos before advancing it.
+    uint32_t max_record;
+
+    // the record of lcm_shm_publish_reserve() and its position, guarded by the
+    // write lock
+    shm_record_t *reserved;
+    uint64_t reserved_pos;
+
+    uint64_t read_pos;
+    uint32_t num_overruns;   // times the reader fell behind and lost messages
+    int warned_overwritten;  // a handler saw its message overwritten
+
+    int notify_fd;  // eventfd, readable when messages may be waiting
+    uint32_t futex_seq;  // the last futex_seq that the wait thread saw
+    GThread *wait_thread;
+    int quit;
+};
+
+static long futex(uint32_t *addr, int op, uint32_t val)
+{
+    return syscall(SYS_futex, addr, op, val, NULL, NULL, 0);
+}
+
+static void shm_lock(shm_header_t *hdr)
+{
+    int status = pthread_mutex_lock(&hdr->write_lock);
+    // a publisher died while holding the lock.  Its record was never
+    // committed, so the ring is still consistent.
+    if (status == EOWNERDEAD)
+        pthread_mutex_consistent(&hdr->write_lock);
+}
+
+static void shm_notify(lcm_shm_t *shm)
+{
+    uint64_t one = 1;
+    if (write(shm->notify_fd, &one, sizeof(one)) < 0)
+        perror("lcm_shm -- write to notify");
+}
+
+static gpointer wait_thread(gpointer user)
+{
+    lcm_shm_t *shm = (lcm_shm_t *) user;
+    shm_header_t *hdr = shm->hdr;
+    uint32_t seen = shm->futex_seq;
+
+    while (!g_atomic_int_get(&shm->quit)) {
+        uint32_t seq = __atomic_load_n(&hdr->futex_seq, __ATOMIC_SEQ_CST);
+        if (seq != seen) {
+            seen = seq;
+            shm_notify(shm);
+            continue;
+        }
+        // publishers only wake the futex if they see a waiter, so register
+        // before checking one last time
+        __atomic_add_fetch(&hdr->num_waiters, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&hdr->futex_seq, __ATOMIC_SEQ_CST) == seen)
+            futex(&hdr->futex_seq, FUTEX_WAIT, seen);
+        __atomic_sub_fetch(&hdr->num_waiters, 1, __ATOMIC_SEQ_CST);
+    }
+    return NULL;
+}
+
+static void shm_wake_waiters(shm_header_t *hdr)
+{
+    __atomic_add_fetch(&hdr->futex_seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&hdr->num_waiters, __ATOMIC_SEQ_CST))
+        futex(&hdr->futex_seq, FUTEX_WAKE, INT_MAX);
+}
+
+static void lcm_shm_destroy(lcm_shm_t *shm)
+{
+    dbg(DBG_LCM, "closing lcm shm context\n");
+    if (shm->wait_thread) {
+        // wakes up the other processes' waiting threads too, which only
+        // costs them a spurious notification
+        g_atomic_int_set(&shm->quit, 1);
+        shm_wake_waiters(shm->hdr);
+        g_thread_join(shm->wait_thread);
+    }
+    if (shm->notify_fd >= 0)
+        close(shm->notify_fd);
+    // the segment is left in place for the other processes using it
+    if (shm->hdr)
+        munmap(shm->hdr, shm->map_size);
+    g_free(shm->name);
+    free(shm);
+}
+
+static uint64_t round_up_pow2(uint64_t size)
+{
+    uint64_t result = SHM_MIN_SIZE;
+    while (result < size)
+        result <<= 1;
+    return result;
+}
+
+// Creates and initializes the shared memory segment.  Returns its file
+// descriptor, or -1 with errno set to EEXIST if another process got there
+// first.
+static int shm_create_segment(lcm_shm_t *shm, uint64_t capacity)
+{
+    int fd = shm_open(shm->name, O_RDWR | O_CREAT | O_EXCL, 0666);
+    if (fd < 0) {
+        if (errno != EEXIST)
+            fprintf(stderr, "Error: Unable to create shared memory %s: %s\n", shm->name,
+                    strerror(errno));
+        return -1;
+    }
+
+    shm->map_size = sizeof(shm_header_t) + capacity;
+    if (ftruncate(fd, shm->map_size) < 0) {
+        perror("lcm_shm -- ftruncate");
+        goto fail;
+    }
+    shm->hdr = (shm_header_t *) mmap(NULL, shm->map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                                     fd, 0);
+    if (shm->hdr == MAP_FAILED) {
+        shm->hdr = NULL;
+        perror("lcm_shm -- mmap");
+        goto fail;
+    }
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&shm->hdr->write_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    shm->hdr->version = SHM_VERSION;
+    shm->hdr->capacity = capacity;
+    __atomic_store_n(&shm->hdr->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+    return fd;
+
+fail:
+    close(fd);
+    shm_unlink(shm->name);
+    // don't report EEXIST for a segment this process failed to create
+    errno = EIO;
+    return -1;
+}
+
+// Maps a segment created by another process, waiting briefly for it to
+// finish initializing the segment.  Returns 0 on success, -1 on failure.
+static int shm_open_segment(lcm_shm_t *shm)
+{
+    int fd = shm_open(shm->name, O_RDWR, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Unable to open shared memory %s: %s\n", shm->name,
+                strerror(errno));
+        return -1;
+    }
+
+    shm_header_t *hdr = MAP_FAILED;
+    for (int attempt = 0; attempt < 1000; attempt++) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(shm_header_t)) {
+            if (hdr == MAP_FAILED)
+                hdr = (shm_header_t *) mmap(NULL, sizeof(shm_header_t), PROT_READ, MAP_SHARED,
+                                            fd, 0);
+            if (hdr != MAP_FAILED && __atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) == SHM_MAGIC)
+                break;
+        }
+        g_usleep(1000);
+    }
+    if (hdr == MAP_FAILED || __atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC) {
+        fprintf(stderr, "Error: Shared memory %s is not an LCM segment\n", shm->name);
+        goto fail;
+    }
+    if (hdr->version != SHM_VERSION) {
+        fprintf(stderr, "Error: Shared memory %s has incompatible version %u\n", shm->name,
+                hdr->version);
+        goto fail;
+    }
+    uint64_t capacity = hdr->capacity;
+    munmap(hdr, sizeof(shm_header_t));
+    hdr = MAP_FAILED;
+
+    struct stat st;
+    shm->map_size = sizeof(shm_header_t) + capacity;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t) shm->map_size) {
+        fprintf(stderr, "Error: Shared memory %s is truncated\n", shm->name);
+        goto fail;
+    }
+    shm->hdr = (shm_header_t *) mmap(NULL, shm->map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                                     fd, 0);
+    if (shm->hdr == MAP_FAILED) {
+        shm->hdr = NULL;
+        perror("lcm_shm -- mmap");
+        goto fail;
+    }
+    close(fd);
+    return 0;
+
+fail:
+    if (hdr != MAP_FAILED)
+        munmap(hdr, sizeof(shm_header_t));
+    close(fd);
+    return -1;
+}
+
+static void new_argument(gpointer key, gpointer value, gpointer user)
+{
+    shm_params_t *params = (shm_params_t *) user;
+    if (!strcmp((char *) key, "size")) {
+        char *endptr = NULL;
+        long long size = strtoll((char *) value, &endptr, 0);
+        if (endptr == value || size <= 0 || size > SHM_MAX_SIZE)
+            fprintf(stderr, "Warning: Invalid value for size\n");
+        else
+            params->size = size;
+    } else if (!strcmp((char *) key, "recv_cpu") || !strcmp((char *) key, "recv_prio")) {
+        lcm_parse_thread_sched_arg(&params->wait_sched, (char *) key, (char *) value);
+    } else {
+        fprintf(stderr, "%s:%d -- unknown provider argument %s\n", __FILE__, __LINE__,
+                (char *) key);
+    }
+}
+
+static lcm_provider_t *lcm_shm_create(lcm_t *parent, const char *network, const GHashTable *args)
+{
+    if (!network || !strlen(network))
+        network = "default";
+    if (strchr(network, '/') || strlen(network) > NAME_MAX - 8) {
+        fprintf(stderr, "Error: Invalid shm group name \"%s\"\n", network);
+        return NULL;
+    }
+
+    shm_params_t params;
+    params.size = SHM_DEFAULT_SIZE;
+    lcm_thread_sched_init(&params.wait_sched);
+    g_hash_table_foreach((GHashTable *) args, new_argument, &params);
+
+    lcm_shm_t *shm = (lcm_shm_t *) calloc(1, sizeof(lcm_shm_t));
+    shm->lcm = parent;
+    shm->name = g_strdup_printf("/lcm-%s", network);
+    shm->notify_fd = -1;
+
+    dbg(DBG_LCM, "Initializing LCM shm context...\n");
+    dbg(DBG_LCM, "Shared memory %s\n", shm->name);
+
+    // the first process to use the group creates the segment
+    int fd = shm_create_segment(shm, round_up_pow2(params.size));
+    if (fd >= 0) {
+        close(fd);
+    } else if (errno != EEXIST || shm_open_segment(shm) < 0) {
+        lcm_shm_destroy(shm);
+        return NULL;
+    }
+    shm->ring = (uint8_t *) (shm->hdr + 1);
+    shm->capacity = shm->hdr->capacity;
+    shm->max_record = shm->capacity / 4;
+    // messages published from here on are received, including those published
+    // before the wait thread starts
+    shm->futex_seq = __atomic_load_n(&shm->hdr->futex_seq, __ATOMIC_SEQ_CST);
+    shm->read_pos = __atomic_load_n(&shm->hdr->write_pos, __ATOMIC_ACQUIRE);
+
+    shm->notify_fd = eventfd(0, EFD_CLOEXEC);
+    if (shm->notify_fd < 0) {
+        perror("lcm_shm -- eventfd");
+        lcm_shm_destroy(shm);
+        return NULL;
+    }
+    shm->wait_thread =
+        lcm_internal_thread_new("lcm-shm-wait", wait_thread, shm, &params.wait_sched);
+    if (!shm->wait_thread) {
+        fprintf(stderr, "Error: LCM failed to start shm wait thread\n");
+        lcm_shm_destroy(shm);
+        return NULL;
+    }
+    return shm;
+}
+
+static uint64_t shm_record_size(size_t channel_len, unsigned int datalen)
+{
+    uint64_t size = sizeof(shm_record_t) + channel_len + 1 + datalen;
+    return (size + SHM_ALIGN - 1) & ~(uint64_t) (SHM_ALIGN - 1);
+}
+
+// Takes the write lock, and starts a record in the ring with room for maxlen
+// bytes of data.  lcm_shm_publish_commit() or lcm_shm_publish_cancel() then
+// releases the lock.
+static void *lcm_shm_publish_reserve(lcm_shm_t *shm, const char *channel, unsigned int maxlen)
+{
+    size_t channel_len = strlen(channel);
+    uint64_t record_size = shm_record_size(channel_len, maxlen);
+    if (record_size > shm->max_record) {
+        fprintf(stderr, "Error: message of %u bytes is too large for shared memory %s\n", maxlen,
+                shm->name);
+        return NULL;
+    }
+
+    shm_header_t *hdr = shm->hdr;
+    shm_lock(hdr);
+    uint64_t pos = hdr->write_pos;
+    uint64_t offset = pos % shm->capacity;
+    uint64_t remaining = shm->capacity - offset;
+    if (remaining < record_size) {
+        // the record would wrap around.  Skip to the start of the ring.
+        if (remaining >= sizeof(shm_record_t)) {
+            shm_record_t *pad = (shm_record_t *) (shm->ring + offset);
+            pad->size = remaining;
+            pad->flags = SHM_RECORD_PADDING;
+        }
+        pos += remaining;
+        offset = 0;
+    }
+
+    shm_record_t *record = (shm_record_t *) (shm->ring + offset);
+    record->flags = 0;
+    record->channel_len = channel_len;
+    record->data_size = maxlen;
+    char *record_channel = (char *) (record + 1);
+    memcpy(record_channel, channel, channel_len + 1);
+    shm->reserved = record;
+    shm->reserved_pos = pos;
+    return record_channel + channel_len + 1;
+}
+
+static int lcm_shm_publish_commit(lcm_shm_t *shm, void *buf, unsigned int datalen)
+{
+    (void) buf;
+    shm_header_t *hdr = shm->hdr;
+    shm_record_t *record = shm->reserved;
+    if (datalen > record->data_size) {
+        fprintf(stderr, "Error: committed %u bytes of %u reserved\n", datalen, record->data_size);
+        pthread_mutex_unlock(&hdr->write_lock);
+        return -1;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint64_t record_size = shm_record_size(record->channel_len, datalen);
+    record->size = record_size;
+    record->data_size = datalen;
+    record->time_ns = (int64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+
+    // stored after write_pos, so that a reader that sees the new
+    // last_record_pos also sees the record as written
+    __atomic_store_n(&hdr->write_pos, shm->reserved_pos + record_size, __ATOMIC_RELEASE);
+    __atomic_store_n(&hdr->last_record_pos, shm->reserved_pos, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&hdr->write_lock);
+
+    shm_wake_waiters(hdr);
+    return 0;
+}
+
+static void lcm_shm_publish_cancel(lcm_shm_t *shm, void *buf)
+{
+    (void) buf;
+    // the record is past write_pos, so readers never look at it
+    pthread_mutex_unlock(&shm->hdr->write_lock);
+}
+
+static int lcm_shm_publish(lcm_shm_t *shm, const char *channel, const void *data,
+                           unsigned int datalen)
+{
+    void *buf = lcm_shm_publish_reserve(shm, channel, datalen);
+    if (!buf)
+        return -1;
+    // data may be NULL for an empty message
+    if (datalen)
+        memcpy(buf, data, datalen);
+    return lcm_shm_publish_commit(shm, buf, datalen);
+}
+
+// whether a publisher may have overwritten the record at pos
+static int shm_overwritten(lcm_shm_t *shm, uint64_t pos)
+{
+    uint64_t write_pos = __atomic_load_n(&shm->hdr->write_pos, __ATOMIC_ACQUIRE);
+    return write_pos - pos > shm->capacity - 2 * shm->max_record;
+}
+
+// Finds the next message after read_pos.  Copies its header and channel
+// name, and returns a pointer to its data in the ring, or NULL if no message
+// is waiting.
+static const uint8_t *shm_next_message(lcm_shm_t *shm, shm_record_t *record, char *channel)
+{
+    while (1) {
+        uint64_t write_pos = __atomic_load_n(&shm->hdr->write_pos, __ATOMIC_ACQUIRE);
+        if (shm->read_pos == write_pos)
+            return NULL;
+        if (shm_overwritten(shm, shm->read_pos))
+            goto overrun;
+
+        uint64_t offset = shm->read_pos % shm->capacity;
+        uint64_t remaining = shm->capacity - offset;
+        if (remaining < sizeof(shm_record_t)) {
+            shm->read_pos += remaining;
+            continue;
+        }
+        const uint8_t *start = shm->ring + offset;
+        memcpy(record, start, sizeof(shm_record_t));
+        if (record->size < sizeof(shm_record_t) || record->size > remaining ||
+            record->size % SHM_ALIGN)
+            goto overrun;
+        if (record->flags & SHM_RECORD_PADDING) {
+            shm->read_pos += record->size;
+            continue;
+        }
+        if (record->channel_len > LCM_MAX_CHANNEL_NAME_LENGTH ||
+            sizeof(shm_record_t) + record->channel_len + 1 + (uint64_t) record->data_size >
+                record->size)
+            goto overrun;
+        memcpy(channel, start + sizeof(shm_record_t), record->channel_len);
+        channel[record->channel_len] = 0;
+
+        // the record could have been overwritten while it was copied
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (shm_overwritten(shm, shm->read_pos))
+            goto overrun;
+        return start + sizeof(shm_record_t) + record->channel_len + 1;
+
+    overrun:
+        // the reader fell too far behind to find the next record boundary.
+        // Skip ahead to the newest message.
+        shm->num_overruns++;
+        dbg(DBG_LCM, "shm reader fell behind, dropping messages (%u times)\n", shm->num_overruns);
+        shm->read_pos = __atomic_load_n(&shm->hdr->last_record_pos, __ATOMIC_ACQUIRE);
+    }
+}
+
+static int shm_dispatch_available(lcm_shm_t *shm, int max_msgs)
+{
+    int nhandled = 0;
+    shm_record_t record;
+    char channel[LCM_MAX_CHANNEL_NAME_LENGTH + 1];
+    const uint8_t *data;
+
+    while (nhandled < max_msgs && (data = shm_next_message(shm, &record, channel))) {
+        uint64_t pos = shm->read_pos;
+        shm->read_pos += record.size;
+        if (!lcm_try_enqueue_message(shm->lcm, channel))
+            continue;
+
+        lcm_recv_buf_t rbuf;
+        rbuf.data = (void *) data;
+        rbuf.data_size = record.data_size;
+        rbuf.recv_utime = record.time_ns / 1000;
+        rbuf.lcm = shm->lcm;
+        rbuf.recv_time_ns = record.time_ns;
+        rbuf.recv_mono_ns = lcm_monotonic_ns();
+        lcm_dispatch_handlers(shm->lcm, &rbuf, channel);
+        nhandled++;
+
+        if (!shm->warned_overwritten && shm_overwritten(shm, pos)) {
+            fprintf(stderr,
+                    "Warning: a message on %s was overwritten while it was being handled.  "
+                    "Increase the size of shared memory %s.\n",
+                    channel, shm->name);
+            shm->warned_overwritten = 1;
+        }
+    }
+    return nhandled;
+}
+
+// Blocks until messages are published, then dispatches up to max_msgs of
+// them.  May return without dispatching anything if the messages were all on
+// channels that nobody here subscribes to, or were already dispatched by an
+// earlier call.
+static int lcm_shm_handle_batch(lcm_shm_t *shm, int max_msgs)
+{
+    uint64_t count;
+    while (read(shm->notify_fd, &count, sizeof(count)) < 0) {
+        if (errno != EINTR) {
+            fprintf(stderr, "Error: lcm_handle read: %s\n", strerror(errno));
+            return -1;
+        }
+    }
+    int nhandled = shm_dispatch_available(shm, max_msgs);
+
+    // keep lcm_get_fileno() readable while messages are waiting
+    if (shm->read_pos != __atomic_load_n(&shm->hdr->write_pos, __ATOMIC_ACQUIRE))
+        shm_notify(shm);
+    return nhandled;
+}
+
+static int lcm_shm_handle(lcm_shm_t *shm)
+{
+    return lcm_shm_handle_batch(shm, 1) < 0 ? -1 : 0;
+}
+
+static int lcm_shm_get_fileno(lcm_shm_t *shm)
+{
+    return shm->notify_fd;
+}
+
+static lcm_provider_vtable_t shm_vtable = {
+    .create = lcm_shm_create,
+    .destroy = lcm_shm_destroy,
+    .subscribe = NULL,
+    .unsubscribe = NULL,
+    .publish = lcm_shm_publish,
+    .handle = lcm_shm_handle,
+    .get_fileno = lcm_shm_get_fileno,
+    .handle_batch = lcm_shm_handle_batch,
+    .publish_reserve = lcm_shm_publish_reserve,
+    .publish_commit = lcm_shm_publish_commit,
+    .publish_cancel = lcm_shm_publish_cancel,
+};
+static lcm_provider_info_t shm_info;
+#endif
+
+void lcm_shm_provider_init(GPtrArray *providers)
+{
+    // futexes and eventfds are needed to wake up subscribers
+#ifdef __linux__
+    shm_info.name = "shm";
+    shm_info.vtable = &shm_vtable;
+
+    g_ptr_array_add(providers, &shm_info);
+#else
+    (void) providers;
+#endif
+}
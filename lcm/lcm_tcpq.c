@@ -1,19 +1,27 @@
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifndef WIN32
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <signal.h>
+#include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/uio.h>
 #else
 #include <Ws2tcpip.h>
 #include <winsock2.h>
+struct iovec {
+    void *iov_base;
+    size_t iov_len;
+};
 #endif
 
 #include "dbg.h"
@@ -27,20 +35,54 @@
 #define MESSAGE_TYPE_SUBSCRIBE 2
 #define MESSAGE_TYPE_UNSUBSCRIBE 3
 
+// microseconds that a message may wait in a batch by default
+#define TCPQ_DEFAULT_BATCH_INTERVAL 1000
+
+// bytes that are received with one recv() at most, unless a message is larger
+#define TCPQ_RECV_BUF_SIZE 65536
+
 typedef struct _lcm_provider_t lcm_tcpq_t;
 struct _lcm_provider_t {
     lcm_t *lcm;
     int socket;
 
-    char *recv_channel_buf;
-    uint32_t recv_channel_buf_len;
-    void *data_buf;
-    uint32_t data_buf_len;
+    // the bytes received from the server that aren't dispatched yet run from
+    // recv_start to recv_end of recv_buf, which fits at least one message
+    uint8_t *recv_buf;
+    uint32_t recv_buf_len;
+    uint32_t recv_start;
+    uint32_t recv_end;
+
+    // lcm_tcpq_publish_reserve() encodes into publish_buf after the header of
+    // the publish message, so that it is sent at once.  The mutex is held
+    // until the message is committed.
+    GMutex publish_mutex;
+    uint8_t *publish_buf;
+    uint32_t publish_buf_len;
+    uint32_t publish_header_len;
+    uint32_t publish_maxlen;
 
     char *server_addr_str;
     struct in_addr server_addr;
     uint16_t server_port;
     GSList *subs;
+
+    // set unless the nodelay option is 0, so that each message is sent as
+    // soon as it's published
+    int nodelay;
+
+    /* With batch_size > 0, published messages are collected into batch_buf,
+     * and sent together once there are batch_size bytes of them, or by the
+     * batch thread once the first of them has waited for batch_interval.
+     * Protected by publish_mutex. */
+    int batch_size;
+    int batch_interval;
+    uint8_t *batch_buf;
+    int batch_len;
+    int64_t batch_deadline;  // monotonic time at which the batch is sent
+    GCond batch_cond;        // a batch was started, or batch_exit was set
+    int batch_exit;
+    GThread *batch_thread;
 };
 
 static int _sub_unsub_helper(lcm_tcpq_t *self, const char *channel, uint32_t msg_type);
@@ -94,6 +136,42 @@ static int _send_fully(int fd, const void *b, int len)
     return cnt;
 }
 
+// Sends all of the buffers, which it modifies, with a single call unless the
+// socket takes only part of them.
+static int _send_iov(int fd, struct iovec *iov, int iovcnt)
+{
+#ifndef WIN32
+    while (iovcnt > 0) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+        ssize_t sent = sendmsg(fd, &msg, 0);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0) {
+            perror("_send_iov");
+            return -1;
+        }
+        while (iovcnt > 0 && (size_t) sent >= iov->iov_len) {
+            sent -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *) iov->iov_base + sent;
+            iov->iov_len -= sent;
+        }
+    }
+#else
+    for (int i = 0; i < iovcnt; i++) {
+        if ((int) iov[i].iov_len != _send_fully(fd, iov[i].iov_base, (int) iov[i].iov_len))
+            return -1;
+    }
+#endif
+    return 0;
+}
+
 static int _recv_uint32(int fd, uint32_t *result)
 {
     uint32_t v;
@@ -111,13 +189,24 @@ static int _send_uint32(int fd, uint32_t v)
 
 static void lcm_tcpq_destroy(lcm_tcpq_t *self)
 {
+    if (self->batch_thread) {
+        // the batch thread sends the last batch before it exits
+        g_mutex_lock(&self->publish_mutex);
+        self->batch_exit = 1;
+        g_cond_signal(&self->batch_cond);
+        g_mutex_unlock(&self->publish_mutex);
+        g_thread_join(self->batch_thread);
+    }
+    free(self->batch_buf);
+    g_cond_clear(&self->batch_cond);
     g_slist_free(self->subs);
     if (self->socket >= 0)
         _close_socket(self->socket);
     if (self->server_addr_str)
         g_free(self->server_addr_str);
-    free(self->recv_channel_buf);
-    free(self->data_buf);
+    free(self->recv_buf);
+    free(self->publish_buf);
+    g_mutex_clear(&self->publish_mutex);
     free(self);
 }
 
@@ -127,6 +216,8 @@ static int _connect_to_server(lcm_tcpq_t *self)
 
     if (self->socket)
         _close_socket(self->socket);
+    // a message cut off by the old connection won't be finished
+    self->recv_start = self->recv_end = 0;
 
     self->socket = socket(AF_INET, SOCK_STREAM, 0);
     if (self->socket < 0) {
@@ -144,6 +235,13 @@ static int _connect_to_server(lcm_tcpq_t *self)
         goto fail;
     }
 
+    // messages are framed into a single send each, so waiting to coalesce
+    // them only delays them
+    int nodelay = 1;
+    if (self->nodelay && 0 != setsockopt(self->socket, IPPROTO_TCP, TCP_NODELAY,
+                                         (const char *) &nodelay, sizeof(nodelay)))
+        perror("lcm_tcpq setsockopt (TCP_NODELAY)");
+
     if (_send_uint32(self->socket, MAGIC_CLIENT) || _send_uint32(self->socket, PROTOCOL_VERSION)) {
         goto fail;
     }
@@ -177,6 +275,101 @@ fail:
     return -1;
 }
 
+static void new_argument(gpointer key, gpointer value, gpointer user)
+{
+    lcm_tcpq_t *self = (lcm_tcpq_t *) user;
+    char *endptr = NULL;
+    if (!strcmp((char *) key, "nodelay")) {
+        self->nodelay = strtol((char *) value, &endptr, 0);
+        if (endptr == value) {
+            fprintf(stderr, "Warning: Invalid value for nodelay\n");
+            self->nodelay = 1;
+        }
+    } else if (!strcmp((char *) key, "batch_size")) {
+        self->batch_size = strtol((char *) value, &endptr, 0);
+        if (endptr == value || self->batch_size < 0) {
+            fprintf(stderr, "Warning: Invalid value for batch_size\n");
+            self->batch_size = 0;
+        }
+    } else if (!strcmp((char *) key, "batch_interval")) {
+        self->batch_interval = strtol((char *) value, &endptr, 0);
+        if (endptr == value || self->batch_interval <= 0) {
+            fprintf(stderr, "Warning: Invalid value for batch_interval\n");
+            self->batch_interval = TCPQ_DEFAULT_BATCH_INTERVAL;
+        }
+    } else {
+        fprintf(stderr, "%s:%d -- unknown provider argument %s\n", __FILE__, __LINE__,
+                (char *) key);
+    }
+}
+
+// Sends the messages of the batch.
+static int _batch_flush(lcm_tcpq_t *self)
+{
+    if (!self->batch_len)
+        return 0;
+    int len = self->batch_len;
+    self->batch_len = 0;
+    if (self->socket < 0 && 0 != _connect_to_server(self))
+        return -1;
+    if (len != _send_fully(self->socket, self->batch_buf, len)) {
+        perror("LCM tcpq send");
+        dbg(DBG_LCM, "Disconnected!\n");
+        _close_socket(self->socket);
+        self->socket = -1;
+        return -1;
+    }
+    return 0;
+}
+
+static void *batch_thread(void *user)
+{
+    lcm_tcpq_t *self = (lcm_tcpq_t *) user;
+    g_mutex_lock(&self->publish_mutex);
+    while (!self->batch_exit) {
+        if (!self->batch_len)
+            g_cond_wait(&self->batch_cond, &self->publish_mutex);
+        else if (g_get_monotonic_time() >= self->batch_deadline)
+            _batch_flush(self);
+        else
+            g_cond_wait_until(&self->batch_cond, &self->publish_mutex, self->batch_deadline);
+    }
+    _batch_flush(self);
+    g_mutex_unlock(&self->publish_mutex);
+    return NULL;
+}
+
+// Sends a framed message of len bytes in all, or adds it to the batch.  The
+// publish mutex is held.
+static int _send_message(lcm_tcpq_t *self, struct iovec *iov, int iovcnt, int len)
+{
+    if (self->batch_size > 0 && self->batch_len + len > self->batch_size &&
+        0 != _batch_flush(self))
+        return -1;
+    if (len <= self->batch_size) {
+        if (!self->batch_len) {
+            self->batch_deadline = g_get_monotonic_time() + self->batch_interval;
+            g_cond_signal(&self->batch_cond);
+        }
+        for (int i = 0; i < iovcnt; i++) {
+            memcpy(self->batch_buf + self->batch_len, iov[i].iov_base, iov[i].iov_len);
+            self->batch_len += iov[i].iov_len;
+        }
+        return self->batch_len == self->batch_size ? _batch_flush(self) : 0;
+    }
+
+    if (self->socket < 0 && 0 != _connect_to_server(self))
+        return -1;
+    if (0 != _send_iov(self->socket, iov, iovcnt)) {
+        perror("LCM tcpq send");
+        dbg(DBG_LCM, "Disconnected!\n");
+        _close_socket(self->socket);
+        self->socket = -1;
+        return -1;
+    }
+    return 0;
+}
+
 static lcm_provider_t *lcm_tcpq_create(lcm_t *parent, const char *network, const GHashTable *args)
 {
 #ifndef WIN32
@@ -188,12 +381,14 @@ static lcm_provider_t *lcm_tcpq_create(lcm_t *parent, const char *network, const
     self->socket = -1;
     self->server_port = htons(7700);
 
-    self->recv_channel_buf_len = 64;
-    self->recv_channel_buf = (char *) calloc(1, self->recv_channel_buf_len);
-
-    self->data_buf_len = 1024;
-    self->data_buf = calloc(1, self->data_buf_len);
+    self->recv_buf_len = TCPQ_RECV_BUF_SIZE;
+    self->recv_buf = (uint8_t *) malloc(self->recv_buf_len);
     self->subs = NULL;
+    g_mutex_init(&self->publish_mutex);
+    g_cond_init(&self->batch_cond);
+    self->nodelay = 1;
+    self->batch_interval = TCPQ_DEFAULT_BATCH_INTERVAL;
+    g_hash_table_foreach((GHashTable *) args, new_argument, self);
 
     // parse server address and port
     if (!network || !strlen(network)) {
@@ -230,8 +425,20 @@ static lcm_provider_t *lcm_tcpq_create(lcm_t *parent, const char *network, const
     dbg(DBG_LCM, "Server address %s:%d\n", inet_ntoa(self->server_addr), ntohs(self->server_port));
 
     if (_connect_to_server(self) != 0) {
-        free(self);
-        self = NULL;
+        lcm_tcpq_destroy(self);
+        return NULL;
+    }
+
+    if (self->batch_size > 0) {
+        self->batch_buf = (uint8_t *) malloc(self->batch_size);
+        lcm_thread_sched_t sched;
+        lcm_thread_sched_init(&sched);
+        self->batch_thread = lcm_internal_thread_new("lcm-tcpq-batch", batch_thread, self, &sched);
+        if (!self->batch_thread) {
+            fprintf(stderr, "Error: LCM failed to start batch thread\n");
+            lcm_tcpq_destroy(self);
+            return NULL;
+        }
     }
 
     return self;
@@ -250,8 +457,13 @@ static int _sub_unsub_helper(lcm_tcpq_t *self, const char *channel, uint32_t msg
     }
 
     uint32_t channel_len = strlen(channel);
-    if (_send_uint32(self->socket, msg_type) || _send_uint32(self->socket, channel_len) ||
-        (channel_len != _send_fully(self->socket, channel, channel_len))) {
+    uint32_t words[2] = {htonl(msg_type), htonl(channel_len)};
+    struct iovec iov[2];
+    iov[0].iov_base = words;
+    iov[0].iov_len = sizeof(words);
+    iov[1].iov_base = (void *) channel;
+    iov[1].iov_len = channel_len;
+    if (0 != _send_iov(self->socket, iov, 2)) {
         perror("LCM tcpq");
         dbg(DBG_LCM, "Disconnected!\n");
         _close_socket(self->socket);
@@ -312,79 +524,339 @@ static int _ensure_buf_capacity(void **buf, uint32_t *cur_size, int req_size)
     return 0;
 }
 
-static int lcm_tcpq_handle(lcm_tcpq_t *self)
+static uint32_t _get_uint32(const uint8_t *p)
 {
-    if (self->socket < 0 && 0 != _connect_to_server(self)) {
-        return -1;
-    }
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return ntohl(v);
+}
+
+// Returns the length of the message at the start of the received bytes if
+// they're complete, and otherwise the number of bytes needed before more of
+// its length is known.
+static uint64_t _frame_len(lcm_tcpq_t *self)
+{
+    const uint8_t *p = self->recv_buf + self->recv_start;
+    uint32_t avail = self->recv_end - self->recv_start;
+    if (avail < 8)
+        return 8;
+    uint64_t channel_len = _get_uint32(p + 4);
+    if (avail < 12 + channel_len)
+        return 12 + channel_len;
+    return 12 + channel_len + _get_uint32(p + 8 + channel_len);
+}
+
+static int _has_frame(lcm_tcpq_t *self)
+{
+    return _frame_len(self) <= self->recv_end - self->recv_start;
+}
 
-    // read, ignore message type
-    uint32_t msg_type;
-    if (_recv_uint32(self->socket, &msg_type))
-        goto disconnected;
+#ifdef WIN32
+// returns 1 if more data can be read from the socket without blocking
+static int _socket_readable(int fd)
+{
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(fd, &fds);
+
+    struct timeval timeout = { 0, 0 };
+    return select(fd + 1, &fds, NULL, NULL, &timeout) > 0;
+}
+#endif
 
-    // read channel length, channel
-    uint32_t channel_len;
-    if (_recv_uint32(self->socket, &channel_len))
-        goto disconnected;
-    if (_ensure_buf_capacity((void **) &self->recv_channel_buf, &self->recv_channel_buf_len,
-                             channel_len + 1)) {
+// Receives as many bytes as the server has sent, or waits for the first of
+// them if wait is set.  Returns the number received, 0 if none have arrived,
+// or -1 once disconnected.
+static int _recv_available(lcm_tcpq_t *self, int wait)
+{
+    // the incomplete message is moved to the start of the buffer, which is
+    // grown to fit it
+    uint64_t needed = _frame_len(self);
+    if (needed > INT_MAX) {
+        fprintf(stderr, "Error: message of %llu bytes is too large for tcpq\n",
+                (unsigned long long) needed);
+        return -1;
+    }
+    uint32_t avail = self->recv_end - self->recv_start;
+    if (self->recv_start > 0) {
+        memmove(self->recv_buf, self->recv_buf + self->recv_start, avail);
+        self->recv_start = 0;
+        self->recv_end = avail;
+    }
+    if (_ensure_buf_capacity((void **) &self->recv_buf, &self->recv_buf_len, (int) needed)) {
         fprintf(stderr, "Memory allocation error\n");
         return -1;
     }
-    if (channel_len != _recv_fully(self->socket, self->recv_channel_buf, channel_len))
-        goto disconnected;
-    self->recv_channel_buf[channel_len] = 0;
 
-    // read payload size, payload
-    uint32_t data_len;
-    if (_recv_uint32(self->socket, &data_len))
-        goto disconnected;
-    if (_ensure_buf_capacity(&self->data_buf, &self->data_buf_len, data_len)) {
-        fprintf(stderr, "Memory allocation error\n");
+    int len = self->recv_buf_len - self->recv_end;
+#ifndef WIN32
+    ssize_t n;
+    do {
+        n = recv(self->socket, self->recv_buf + self->recv_end, len, wait ? 0 : MSG_DONTWAIT);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0 && !wait && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return 0;
+#else
+    if (!wait && !_socket_readable(self->socket))
+        return 0;
+    int n = recv(self->socket, (char *) self->recv_buf + self->recv_end, len, 0);
+#endif
+    if (n <= 0) {
+        if (n < 0)
+            perror("lcm_tcpq recv");
         return -1;
     }
-    if (data_len != _recv_fully(self->socket, self->data_buf, data_len))
-        goto disconnected;
+    self->recv_end += n;
+    return (int) n;
+}
+
+// Dispatches the message at the start of the received bytes, which is
+// complete.
+static void _dispatch_frame(lcm_tcpq_t *self)
+{
+    // the message type is ignored
+    uint8_t *p = self->recv_buf + self->recv_start;
+    uint32_t channel_len = _get_uint32(p + 4);
+    uint32_t data_len = _get_uint32(p + 8 + channel_len);
+    self->recv_start += 12 + channel_len + data_len;
+
+    // the channel is terminated over the data length, which was read already
+    char *channel = (char *) p + 8;
+    channel[channel_len] = 0;
 
     lcm_recv_buf_t rbuf;
-    rbuf.data = self->data_buf;
+    rbuf.data = p + 12 + channel_len;
     rbuf.data_size = data_len;
     rbuf.recv_utime = g_get_real_time();
+    rbuf.recv_time_ns = rbuf.recv_utime * 1000;
+    rbuf.recv_mono_ns = lcm_monotonic_ns();
     rbuf.lcm = self->lcm;
 
-    if (lcm_try_enqueue_message(self->lcm, self->recv_channel_buf))
-        lcm_dispatch_handlers(self->lcm, &rbuf, self->recv_channel_buf);
-    return 0;
+    if (lcm_try_enqueue_message(self->lcm, channel))
+        lcm_dispatch_handlers(self->lcm, &rbuf, channel);
+}
+
+// Dispatches every complete message that has been received, receiving more as
+// long as the server has sent them, and up to max_msgs messages.  Only the
+// first recv() waits, so a message that has only partly arrived doesn't block
+// the caller if it was just told that the socket is readable, and it doesn't
+// once a message was dispatched, which may have been received earlier.
+static int _handle_available(lcm_tcpq_t *self, int max_msgs)
+{
+    if (self->socket < 0 && 0 != _connect_to_server(self)) {
+        return -1;
+    }
+
+    int nhandled = 0;
+    int wait = 1;
+    while (nhandled < max_msgs) {
+        if (_has_frame(self)) {
+            _dispatch_frame(self);
+            nhandled++;
+            wait = 0;
+            continue;
+        }
+        int n = _recv_available(self, wait);
+        if (n < 0)
+            goto disconnected;
+        if (n == 0)
+            break;
+        wait = 0;
+    }
+    return nhandled;
 
 disconnected:
     _close_socket(self->socket);
     self->socket = -1;
-    return -1;
+    self->recv_start = self->recv_end = 0;
+    return nhandled ? nhandled : -1;
+}
+
+static int lcm_tcpq_handle(lcm_tcpq_t *self)
+{
+    return _handle_available(self, INT_MAX) < 0 ? -1 : 0;
+}
+
+static int lcm_tcpq_handle_batch(lcm_tcpq_t *self, int max_msgs)
+{
+    return _handle_available(self, max_msgs);
+}
+
+static int lcm_tcpq_has_pending(lcm_tcpq_t *self)
+{
+    return _has_frame(self);
 }
 
 static int lcm_tcpq_publish(lcm_tcpq_t *self, const char *channel, const void *data,
                             unsigned int datalen)
 {
-    if (self->socket < 0 && 0 != _connect_to_server(self)) {
+    uint32_t channel_len = strlen(channel);
+    uint64_t len = 12 + (uint64_t) channel_len + datalen;
+    if (len > INT_MAX) {
+        fprintf(stderr, "Error: message of %u bytes is too large for tcpq\n", datalen);
         return -1;
     }
 
-    uint32_t channel_len = strlen(channel);
+    // the message is framed into a single send
+    uint32_t words[2] = {htonl(MESSAGE_TYPE_PUBLISH), htonl(channel_len)};
+    uint32_t n = htonl(datalen);
+    struct iovec iov[4];
+    iov[0].iov_base = words;
+    iov[0].iov_len = sizeof(words);
+    iov[1].iov_base = (void *) channel;
+    iov[1].iov_len = channel_len;
+    iov[2].iov_base = &n;
+    iov[2].iov_len = 4;
+    iov[3].iov_base = (void *) data;
+    iov[3].iov_len = datalen;
+
+    g_mutex_lock(&self->publish_mutex);
+    int status = _send_message(self, iov, 4, (int) len);
+    g_mutex_unlock(&self->publish_mutex);
+    return status;
+}
 
-    if (_send_uint32(self->socket, MESSAGE_TYPE_PUBLISH) ||
-        _send_uint32(self->socket, channel_len) ||
-        (channel_len != _send_fully(self->socket, channel, channel_len)) ||
-        _send_uint32(self->socket, datalen) ||
-        (datalen != _send_fully(self->socket, data, datalen))) {
-        perror("LCM tcpq send");
-        dbg(DBG_LCM, "Disconnected!\n");
-        _close_socket(self->socket);
-        self->socket = -1;
+static int lcm_tcpq_publishv(lcm_tcpq_t *self, const char *channel, const lcm_iovec_t *iov,
+                             int iovcnt, unsigned int datalen)
+{
+    uint32_t channel_len = strlen(channel);
+    uint64_t len = 12 + (uint64_t) channel_len + datalen;
+    if (len > INT_MAX) {
+        fprintf(stderr, "Error: message of %u bytes is too large for tcpq\n", datalen);
         return -1;
     }
 
-    return 0;
+    // the header and the pieces are framed into a single send
+    uint32_t words[2] = {htonl(MESSAGE_TYPE_PUBLISH), htonl(channel_len)};
+    uint32_t n = htonl(datalen);
+    struct iovec frame_buf[19];
+    struct iovec *frame = frame_buf;
+    if (3 + iovcnt > 19)
+        frame = (struct iovec *) malloc((3 + iovcnt) * sizeof(struct iovec));
+    frame[0].iov_base = words;
+    frame[0].iov_len = sizeof(words);
+    frame[1].iov_base = (void *) channel;
+    frame[1].iov_len = channel_len;
+    frame[2].iov_base = &n;
+    frame[2].iov_len = 4;
+    for (int i = 0; i < iovcnt; i++) {
+        frame[3 + i].iov_base = (void *) iov[i].data;
+        frame[3 + i].iov_len = iov[i].len;
+    }
+
+    g_mutex_lock(&self->publish_mutex);
+    int status = _send_message(self, frame, 3 + iovcnt, (int) len);
+    g_mutex_unlock(&self->publish_mutex);
+    if (frame != frame_buf)
+        free(frame);
+    return status;
+}
+
+// most messages that are framed into a single send by lcm_tcpq_publish_batch()
+#define TCPQ_PUBLISH_BATCH 64
+
+// Frames runs of the messages into a single send each, with the publish mutex
+// taken once.
+static int lcm_tcpq_publish_batch(lcm_tcpq_t *self, const lcm_publish_msg_t *msgs, int num_msgs)
+{
+    uint32_t words[TCPQ_PUBLISH_BATCH][3];
+    struct iovec iov[4 * TCPQ_PUBLISH_BATCH];
+    int status = 0;
+
+    g_mutex_lock(&self->publish_mutex);
+    for (int i = 0; i < num_msgs;) {
+        int n = 0;
+        uint64_t len = 0;
+        while (n < TCPQ_PUBLISH_BATCH && i + n < num_msgs) {
+            const lcm_publish_msg_t *msg = &msgs[i + n];
+            uint32_t channel_len = strlen(msg->channel);
+            uint64_t msg_len = 12 + (uint64_t) channel_len + msg->datalen;
+            if (msg_len > INT_MAX) {
+                fprintf(stderr, "Error: message of %u bytes is too large for tcpq\n",
+                        msg->datalen);
+                status = -1;
+                break;
+            }
+            if (n > 0 && len + msg_len > INT_MAX)
+                break;
+
+            words[n][0] = htonl(MESSAGE_TYPE_PUBLISH);
+            words[n][1] = htonl(channel_len);
+            words[n][2] = htonl(msg->datalen);
+            iov[4 * n].iov_base = words[n];
+            iov[4 * n].iov_len = 8;
+            iov[4 * n + 1].iov_base = (void *) msg->channel;
+            iov[4 * n + 1].iov_len = channel_len;
+            iov[4 * n + 2].iov_base = &words[n][2];
+            iov[4 * n + 2].iov_len = 4;
+            iov[4 * n + 3].iov_base = (void *) msg->data;
+            iov[4 * n + 3].iov_len = msg->datalen;
+            len += msg_len;
+            n++;
+        }
+
+        if (n > 0 && 0 != _send_message(self, iov, 4 * n, (int) len))
+            status = -1;
+        // a message that is too large is skipped
+        i += n ? n : 1;
+    }
+    g_mutex_unlock(&self->publish_mutex);
+    return status;
+}
+
+static void *lcm_tcpq_publish_reserve(lcm_tcpq_t *self, const char *channel, unsigned int maxlen)
+{
+    uint32_t channel_len = strlen(channel);
+    uint64_t size = 12 + (uint64_t) channel_len + maxlen;
+    if (size > INT_MAX) {
+        fprintf(stderr, "Error: message of %u bytes is too large for tcpq\n", maxlen);
+        return NULL;
+    }
+
+    g_mutex_lock(&self->publish_mutex);
+    if (self->publish_buf_len < size) {
+        uint8_t *grown = (uint8_t *) realloc(self->publish_buf, size);
+        if (!grown) {
+            g_mutex_unlock(&self->publish_mutex);
+            return NULL;
+        }
+        self->publish_buf = grown;
+        self->publish_buf_len = size;
+    }
+
+    uint32_t words[2] = {htonl(MESSAGE_TYPE_PUBLISH), htonl(channel_len)};
+    memcpy(self->publish_buf, words, 8);
+    memcpy(self->publish_buf + 8, channel, channel_len);
+    // followed by the data size, which is filled in by commit
+    self->publish_header_len = 12 + channel_len;
+    self->publish_maxlen = maxlen;
+    return self->publish_buf + self->publish_header_len;
+}
+
+static int lcm_tcpq_publish_commit(lcm_tcpq_t *self, void *buf, unsigned int datalen)
+{
+    (void) buf;
+    int status = 0;
+    if (datalen > self->publish_maxlen) {
+        fprintf(stderr, "Error: committed %u bytes of %u reserved\n", datalen,
+                self->publish_maxlen);
+        status = -1;
+    } else {
+        uint32_t n = htonl(datalen);
+        memcpy(self->publish_buf + self->publish_header_len - 4, &n, 4);
+        struct iovec iov;
+        iov.iov_base = self->publish_buf;
+        iov.iov_len = self->publish_header_len + datalen;
+        status = _send_message(self, &iov, 1, (int) iov.iov_len);
+    }
+    g_mutex_unlock(&self->publish_mutex);
+    return status;
+}
+
+static void lcm_tcpq_publish_cancel(lcm_tcpq_t *self, void *buf)
+{
+    (void) buf;
+    g_mutex_unlock(&self->publish_mutex);
 }
 
 #ifdef WIN32
@@ -398,6 +870,13 @@ static lcm_provider_vtable_t tcpq_vtable = {
     .publish = lcm_tcpq_publish,
     .handle = lcm_tcpq_handle,
     .get_fileno = lcm_tcpq_get_fileno,
+    .handle_batch = lcm_tcpq_handle_batch,
+    .has_pending = lcm_tcpq_has_pending,
+    .publish_reserve = lcm_tcpq_publish_reserve,
+    .publish_commit = lcm_tcpq_publish_commit,
+    .publish_cancel = lcm_tcpq_publish_cancel,
+    .publishv = lcm_tcpq_publishv,
+    .publish_batch = lcm_tcpq_publish_batch,
 };
 #endif
 static lcm_provider_info_t tcpq_info;
@@ -412,6 +891,13 @@ void lcm_tcpq_provider_init(GPtrArray *providers)
     tcpq_vtable.publish = lcm_tcpq_publish;
     tcpq_vtable.handle = lcm_tcpq_handle;
     tcpq_vtable.get_fileno = lcm_tcpq_get_fileno;
+    tcpq_vtable.handle_batch = lcm_tcpq_handle_batch;
+    tcpq_vtable.has_pending = lcm_tcpq_has_pending;
+    tcpq_vtable.publish_reserve = lcm_tcpq_publish_reserve;
+    tcpq_vtable.publish_commit = lcm_tcpq_publish_commit;
+    tcpq_vtable.publish_cancel = lcm_tcpq_publish_cancel;
+    tcpq_vtable.publishv = lcm_tcpq_publishv;
+    tcpq_vtable.publish_batch = lcm_tcpq_publish_batch;
 #endif
     tcpq_info.name = "tcpq";
     tcpq_info.vtable = &tcpq_vtable;
@@ -0,0 +1,4 @@
+// the probes of the LTTng-UST tracepoint provider of liblcm
+#define TRACEPOINT_CREATE_PROBES
+#define TRACEPOINT_DEFINE
+#include "lcm_tp.h"
@@ -0,0 +1,80 @@
+/* LTTng-UST tracepoint provider of liblcm, built with LCM_TRACEPOINTS=lttng.
+ * The tracepoints are described in lcm_trace.h, which is what the rest of
+ * liblcm includes. */
+
+#undef TRACEPOINT_PROVIDER
+#define TRACEPOINT_PROVIDER lcm
+
+#undef TRACEPOINT_INCLUDE
+#define TRACEPOINT_INCLUDE "./lcm_tp.h"
+
+#if !defined(__lcm_tp_h__) || defined(TRACEPOINT_HEADER_MULTI_READ)
+#define __lcm_tp_h__
+
+#include <stdint.h>
+
+#include <lttng/tracepoint.h>
+
+// clang-format off
+TRACEPOINT_EVENT(lcm, publish,
+    TP_ARGS(const char *, channel, int, size),
+    TP_FIELDS(
+        ctf_string(channel, channel)
+        ctf_integer(int, size, size)))
+
+TRACEPOINT_EVENT(lcm, udpm_send_packet,
+    TP_ARGS(const char *, channel, uint32_t, seqno, int, fragment_no, int, fragments_in_msg,
+            int, size),
+    TP_FIELDS(
+        ctf_string(channel, channel)
+        ctf_integer(uint32_t, seqno, seqno)
+        ctf_integer(int, fragment_no, fragment_no)
+        ctf_integer(int, fragments_in_msg, fragments_in_msg)
+        ctf_integer(int, size, size)))
+
+TRACEPOINT_EVENT(lcm, udpm_recv_datagram,
+    TP_ARGS(int, size, uint32_t, seqno, int64_t, recv_utime),
+    TP_FIELDS(
+        ctf_integer(int, size, size)
+        ctf_integer(uint32_t, seqno, seqno)
+        ctf_integer(int64_t, recv_utime, recv_utime)))
+
+TRACEPOINT_EVENT(lcm, udpm_message_complete,
+    TP_ARGS(const char *, channel, uint32_t, seqno, int, size, int64_t, recv_utime),
+    TP_FIELDS(
+        ctf_string(channel, channel)
+        ctf_integer(uint32_t, seqno, seqno)
+        ctf_integer(int, size, size)
+        ctf_integer(int64_t, recv_utime, recv_utime)))
+
+TRACEPOINT_EVENT_CLASS(lcm, queue_class,
+    TP_ARGS(const char *, channel, int, size, int, priority, int, num_bundled),
+    TP_FIELDS(
+        ctf_string(channel, channel)
+        ctf_integer(int, size, size)
+        ctf_integer(int, priority, priority)
+        ctf_integer(int, num_bundled, num_bundled)))
+
+TRACEPOINT_EVENT_INSTANCE(lcm, queue_class, udpm_enqueue,
+    TP_ARGS(const char *, channel, int, size, int, priority, int, num_bundled))
+
+TRACEPOINT_EVENT_INSTANCE(lcm, queue_class, udpm_dequeue,
+    TP_ARGS(const char *, channel, int, size, int, priority, int, num_bundled))
+
+TRACEPOINT_EVENT_CLASS(lcm, handler_class,
+    TP_ARGS(const char *, channel, int, size, int64_t, recv_utime),
+    TP_FIELDS(
+        ctf_string(channel, channel)
+        ctf_integer(int, size, size)
+        ctf_integer(int64_t, recv_utime, recv_utime)))
+
+TRACEPOINT_EVENT_INSTANCE(lcm, handler_class, handler_enter,
+    TP_ARGS(const char *, channel, int, size, int64_t, recv_utime))
+
+TRACEPOINT_EVENT_INSTANCE(lcm, handler_class, handler_exit,
+    TP_ARGS(const char *, channel, int, size, int64_t, recv_utime))
+// clang-format on
+
+#endif
+
+#include <lttng/tracepoint-event.h>
@@ -0,0 +1,61 @@
+#ifndef __lcm_trace_h__
+#define __lcm_trace_h__
+
+/* Static tracepoints of liblcm, for attributing latency to publishing,
+ * sending, receiving, reassembly, queueing and dispatch.  Built with
+ * LCM_TRACEPOINTS=usdt they are USDT probes of the provider "lcm", which
+ * bpftrace, perf and SystemTap attach to, and which are a single nop
+ * instruction each until then.  Built with LCM_TRACEPOINTS=lttng they are
+ * LTTng-UST tracepoints of the provider "lcm", defined in lcm_tp.h.  Otherwise
+ * they compile to nothing, without evaluating their arguments.
+ *
+ * The probes, and their arguments:
+ *
+ *   publish(channel, size)
+ *     lcm_publish() was called.
+ *   udpm_send_packet(channel, seqno, fragment_no, fragments_in_msg, size)
+ *     udpm sent a datagram of a message, or one of its fragments.
+ *   udpm_recv_datagram(size, seqno, recv_utime)
+ *     udpm read a datagram from its socket.
+ *   udpm_message_complete(channel, seqno, size, recv_utime)
+ *     udpm received a whole message for a subscriber, in a single datagram or
+ *     by reassembling its fragments.
+ *   udpm_enqueue(channel, size, priority, num_bundled)
+ *     a read thread queued a message, or a bundle packet of num_bundled
+ *     messages with an empty channel, for lcm_handle().
+ *   udpm_dequeue(channel, size, priority, num_bundled)
+ *     lcm_handle() took a message or bundle packet from the queue.
+ *   handler_enter(channel, size, recv_utime)
+ *   handler_exit(channel, size, recv_utime)
+ *     lcm_dispatch_handlers() called a message handler, and it returned.
+ *
+ * Channels are NUL-terminated strings, seqno is the sequence number of the
+ * message from its sender, and recv_utime is when it was received, in
+ * microseconds since the epoch.  For example, a histogram of how long the
+ * handlers of each channel take:
+ *
+ *   bpftrace -e '
+ *       usdt:/usr/local/lib/liblcm.so:lcm:handler_enter { @start[tid] = nsecs; }
+ *       usdt:/usr/local/lib/liblcm.so:lcm:handler_exit /@start[tid]/ {
+ *           @us[str(arg0)] = hist((nsecs - @start[tid]) / 1000);
+ *           delete(@start[tid]);
+ *       }'
+ */
+
+#if defined(LCM_HAVE_LTTNG)
+
+#include "lcm_tp.h"
+#define LCM_TRACE(name, ...) tracepoint(lcm, name, __VA_ARGS__)
+
+#elif defined(LCM_HAVE_USDT)
+
+#include <sys/sdt.h>
+#define LCM_TRACE(name, ...) STAP_PROBEV(lcm, name, __VA_ARGS__)
+
+#else
+
+#define LCM_TRACE(name, ...) ((void) 0)
+
+#endif
+
+#endif
@@ -1,6 +1,13 @@
+#ifdef __linux__
+// recvmmsg() is a GNU extension
+#define _GNU_SOURCE
+#endif
+
 #include <assert.h>
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -22,6 +29,28 @@
 #define MSG_EXT_HDR
 #endif
 
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+#define USE_RECVMMSG
+#define USE_SENDMMSG
+#endif
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#define USE_EVENTFD
+#endif
+
+#if defined(__linux__) && defined(SO_TIMESTAMPING)
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#define USE_TIMESTAMPING
+#endif
+
+#if defined(__linux__) && defined(SO_ATTACH_FILTER)
+#include <linux/filter.h>
+#include <stddef.h>
+#define USE_SOCKET_FILTER
+#endif
+
 #ifdef WIN32
 #include <Ws2tcpip.h>
 #include <winsock2.h>
@@ -34,11 +63,59 @@
 #include "dbg.h"
 #include "lcm.h"
 #include "lcm_internal.h"
+#include "lcm_trace.h"
 #include "ringbuffer.h"
+#include "udpm_iocp.h"
+#include "udpm_uring.h"
 #include "udpm_util.h"
+#ifdef LCM_HAVE_XDP
+#include "udpm_xdp.h"
+#endif
 
 #define SELF_TEST_CHANNEL "LCM_SELF_TEST"
 
+// microseconds that a message may wait in a bundle packet by default
+#define UDPM_DEFAULT_BUNDLE_INTERVAL 1000
+
+// bytes that the token bucket of send_rate holds by default
+#define UDPM_DEFAULT_SEND_BURST 65536
+
+// bytes of messages kept for retransmission by default, with retransmit
+#define UDPM_DEFAULT_RETRANSMIT_BUFFER (16 * 1024 * 1024)
+
+// milliseconds without new fragments after which an incomplete message is
+// NACKed by default, and the most NACKs sent without a fragment arriving
+#define UDPM_DEFAULT_NACK_TIMEOUT 20
+#define UDPM_MAX_NACKS 3
+
+// milliseconds between two interest announcements by default
+#define UDPM_DEFAULT_INTEREST_PERIOD 1000
+
+// messages of a channel of the delta option that are sent between two
+// keyframes, by default, and the most senders and channels whose last
+// message a receiver keeps to apply deltas to, per shard
+#define UDPM_DEFAULT_DELTA_KEYFRAME 10
+
+// microseconds between two doublings of the kernel receive buffer, with
+// recv_buf_max, so that each has time to take effect
+#define UDPM_RECV_BUF_GROW_INTERVAL 100000
+#define UDPM_MAX_DELTA_BASES 64
+
+// marks a message of a received bundle packet that is not dispatched
+#define UDPM_BUNDLE_SKIPPED 0x80000000u
+
+// the smallest ringbuffer that always has room for the next datagram, as
+// long as lcm_handle() keeps up
+#define UDPM_MIN_RINGBUF_SIZE (3 * (LCM_MAX_UNFRAGMENTED_PACKET_SIZE + 64))
+
+// most interfaces of the ifaces option
+#define UDPM_MAX_IFACES 16
+
+// the defaults of the lean option
+#define UDPM_LEAN_RECV_BUFS 32
+#define UDPM_LEAN_FRAG_STORE (1 << 20)
+#define UDPM_LEAN_MAX_FRAG_BUFS 32
+
 /**
  * udpm_params_t:
  * @mc_addr:        multicast address
@@ -49,49 +126,442 @@
  *                  don't use > 1.  that's just rude.
  * @recv_buf_size:  requested size of the kernel receive buffer, set with
  *                  SO_RCVBUF.  0 indicates to use the default settings.
+ * @recv_buf_max:   size that the kernel receive buffer is grown to when
+ *                  datagrams are dropped, or 0 to leave it as it is.
+ * @recv_batch:     maximum number of datagrams read from the socket with a
+ *                  single recvmmsg() call.  0 or 1 reads one datagram at a
+ *                  time.
+ * @recv_threads:   number of threads reading from the receive socket.  If 0,
+ *                  lcm_handle() reads from the socket itself.
+ * @busy_poll:      microseconds to busy poll the receive socket for before
+ *                  blocking.  0 disables busy polling.
+ * @packet_size:    largest UDP payload of a transmitted datagram.  Larger
+ *                  messages are fragmented to fit.
+ * @timestamping:   source of the nanosecond receive timestamps.
+ * @mono_clock:     source of the monotonic receive timestamps.
+ * @recv_sched:     CPU, priority and NUMA node of the read threads.  With several read
+ *                  threads, each is pinned to the CPU after the previous one.
+ * @local_delivery: if 1, messages published on this instance are handed to
+ *                  its own subscribers directly, and their copies looped back
+ *                  through the network are discarded.
+ * @send_queue:     bytes of messages queued by lcm_publish_async() for the
+ *                  sender thread.  0 disables the queue.
+ * @send_drop:      if 1, lcm_publish_async() drops messages that don't fit in
+ *                  the queue, and otherwise it waits for room.
+ * @bundle_size:    largest bundle packet that short messages are collected
+ *                  into before they are sent.  0 disables bundling.
+ * @bundle_interval: microseconds that a message may wait in a bundle packet.
+ * @send_rate:      bytes per second that datagrams are sent at, at most, or 0
+ *                  to send them as fast as possible.
+ * @send_burst:     bytes that may be sent at once at the full speed of the
+ *                  network after a pause, with send_rate.
+ * @send_pacing_kernel: if 1, send_rate is left to the kernel, with
+ *                  SO_MAX_PACING_RATE, instead of the token bucket.
+ * @compress_re:    channels whose fragmented messages are sent LZ4 compressed,
+ *                  or NULL.
+ * @fec_group:      number of fragments of a message covered by each of its
+ *                  parity packets.  0 sends no parity packets.
+ * @retransmit_re:  channels whose fragmented messages are kept for
+ *                  retransmission, and NACKed when incomplete, or NULL.
+ * @retransmit_buffer: bytes of the messages kept for retransmission.
+ * @nack_timeout:   milliseconds without new fragments after which the
+ *                  missing fragments of a message are NACKed.
+ * @interest_port:  port of the multicast group that subscriptions are
+ *                  announced on, in network byte order like mc_port, or 0 to
+ *                  announce none and publish every message.
+ * @interest_period: milliseconds between two announcements.
+ * @latch_re:       channels whose last message is kept, and sent again when an
+ *                  instance starts subscribing to them, or NULL.
+ * @delta_re:       channels whose fragmented messages are sent as deltas from
+ *                  the previous message, or NULL.
+ * @delta_keyframe: messages sent on each of those channels for each one that
+ *                  is sent whole.
+ * @xdp_ifname:     interface whose receive queue xdp_queue is read through an
+ *                  AF_XDP socket, or NULL.
+ * @io_uring:       if 1, the read threads receive through an io_uring.
+ * @iocp:           if 1, the read threads receive through an I/O completion
+ *                  port, on Windows.
+ * @self_test:      whether, and how, the multicast self test is run when the
+ *                  read threads are started.
+ * @ringbuf_size:   initial size in bytes of the ringbuffer of each read thread,
+ *                  or 0 for the default.
+ * @ringbuf_max:    size that the ringbuffers may grow to, or 0 for no limit.
+ * @ringbuf_lock:   if 1, the ringbuffers are preallocated and locked into
+ *                  memory, and never grow.
+ * @align:          alignment in bytes of the payloads that are dispatched, or
+ *                  1 for none.
+ * @share:          if 1, instances with the same URL receive through a single
+ *                  udpm_shared_t.
+ * @recv_bufs:      lcm_buf_t allocated for each read thread at a time.
+ * @frag_store:     bytes of fragmented messages being reassembled, at most.
+ * @max_frag_bufs:  fragmented messages being reassembled, at most.
+ * @lean:           if 1, the defaults of the sizes above, and of
+ *                  ringbuf_size, are small.
+ * @peers:          unicast addresses that datagrams are sent to instead of the
+ *                  multicast group, or NULL.  A port of 0 stands for mc_port.
+ * @unicast:        if 1, the receive socket is bound to the port on all
+ *                  addresses, so that it also receives unicast datagrams.
+ * @ifaces:         local interfaces that multicast datagrams are sent out of,
+ *                  and that the group is joined on, or NULL for the default.
  *
  */
+typedef enum {
+    UDPM_TIMESTAMPING_DEFAULT = 0,  // microsecond kernel timestamps
+    UDPM_TIMESTAMPING_SW,           // nanosecond kernel timestamps
+    UDPM_TIMESTAMPING_HW,           // NIC timestamps, or kernel ones if unavailable
+} udpm_timestamping_t;
+
+typedef enum {
+    UDPM_MONO_CLOCK_READ = 0,  // read for each datagram
+    UDPM_MONO_CLOCK_KERNEL,    // derived from the kernel timestamps
+} udpm_mono_clock_t;
+
+typedef enum {
+    UDPM_SELF_TEST_ON = 0,  // the first lcm_subscribe() waits for the self test
+    UDPM_SELF_TEST_OFF,     // no self test
+    UDPM_SELF_TEST_ASYNC,   // the self test runs in its own thread
+} udpm_self_test_t;
+
+/**
+ * udpm_iface_t:
+ * An interface of the ifaces option, given by its address.  The channels
+ * that match @re are sent out of it, or if @re is NULL, its share of the
+ * channels that match no @re.  Receivers tell senders apart by their source
+ * address, so each interface has a message sequence number of its own.
+ */
+typedef struct _udpm_iface_t udpm_iface_t;
+struct _udpm_iface_t {
+    struct in_addr addr;
+    GRegex *re;
+    uint32_t msg_seqno;
+};
+
 typedef struct _udpm_params_t udpm_params_t;
 struct _udpm_params_t {
     struct in_addr mc_addr;
     uint16_t mc_port;
     uint8_t mc_ttl;
     int recv_buf_size;
+    int recv_buf_max;
+    int recv_batch;
+    int recv_threads;
+    int busy_poll;
+    int packet_size;
+    lcm_thread_sched_t recv_sched;
+    udpm_timestamping_t timestamping;
+    udpm_mono_clock_t mono_clock;
+    int local_delivery;
+    int send_queue;
+    int send_drop;
+    int bundle_size;
+    int bundle_interval;
+    int64_t send_rate;
+    int send_burst;
+    int send_pacing_kernel;
+    GRegex *compress_re;
+    int fec_group;
+    GRegex *retransmit_re;
+    int64_t retransmit_buffer;
+    int nack_timeout;
+    uint16_t interest_port;
+    int interest_period;
+    GRegex *latch_re;
+    GRegex *delta_re;
+    int delta_keyframe;
+    char *xdp_ifname;
+    int xdp_queue;
+    int io_uring;
+    int iocp;
+    udpm_self_test_t self_test;
+    int ringbuf_size;
+    int ringbuf_max;
+    int ringbuf_lock;
+    int align;
+    int share;
+    int recv_bufs;
+    int frag_store;
+    int max_frag_bufs;
+    int lean;
+    struct sockaddr_in *peers;
+    int num_peers;
+    int unicast;
+    udpm_iface_t *ifaces;
+    int num_ifaces;
+};
+
+/**
+ * udpm_local_msg_t:
+ * A message published with local_delivery=1, queued for the subscribers of
+ * the same instance.  The channel name and payload follow the struct.
+ */
+typedef struct _udpm_local_msg_t udpm_local_msg_t;
+struct _udpm_local_msg_t {
+    char *channel;
+    lcm_recv_buf_t rbuf;
+};
+
+/**
+ * udpm_send_msg_t:
+ * A message waiting in the send queue.  The channel name follows the struct,
+ * and is followed by a copy of the payload unless the publisher handed over
+ * its buffer, to be released once it has been sent.
+ */
+typedef struct _udpm_send_msg_t udpm_send_msg_t;
+struct _udpm_send_msg_t {
+    udpm_send_msg_t *next;
+    void *data;
+    unsigned int datalen;
+    lcm_buffer_release_t release;
+    void *release_user;
+    char channel[];
+};
+
+/**
+ * udpm_recv_batch_t:
+ * Scratch space used by the read thread when batched receives are enabled.
+ * Each array has one entry per datagram in the batch.
+ */
+typedef struct _udpm_recv_batch_t udpm_recv_batch_t;
+struct _udpm_recv_batch_t {
+    int depth;
+    lcm_buf_t **lcmbs;
+    char **bufs;          // ringbuffer slot of each lcm_buf_t
+    unsigned int *lens;  // bytes of each slot to keep, 0 to release it
+    int *complete;       // whether each slot holds a complete message
+#ifdef USE_RECVMMSG
+    struct mmsghdr *msgs;
+    struct iovec *vecs;
+    char *controlbufs;
+#endif
 };
 
 typedef struct _lcm_provider_t lcm_udpm_t;
+
+/**
+ * udpm_recv_thread_t:
+ * A thread that reads from the receive socket, and the buffers it fills.
+ * Once the thread is running, only it touches the ring buffer and the
+ * inbufs_empty queue, so neither needs locking.
+ */
+typedef struct _udpm_recv_thread_t udpm_recv_thread_t;
+struct _udpm_recv_thread_t {
+    lcm_udpm_t *lcm;
+    GThread *thread;
+    lcm_poller_t *poller;  // waits on recvfd and thread_msg_pipe
+
+    /* Packet structures available for receiving use are stored in the
+     * *_empty queue. */
+    lcm_buf_queue_t *inbufs_empty;
+    /* Received packets that are filled with data are handed from the read
+     * thread to lcm_handle() through these lock-free queues, one for each
+     * priority class... */
+    lcm_buf_ring_t *inbufs_filled[LCM_MAX_PRIORITY + 1];
+    /* ...and come back through this one once they have been dispatched, or
+     * through returns once the handlers that retained them release them. */
+    lcm_buf_ring_t *inbufs_done;
+    lcm_buf_returns_t returns;
+
+    /* Memory for received small packets is taken from a fixed-size ring buffer
+     * so we don't have to do any mallocs */
+    lcm_ringbuf_t *ringbuf;
+
+    udpm_recv_batch_t *recv_batch;
+#ifdef LCM_HAVE_XDP
+    // the AF_XDP socket of the xdp option, in the first read thread
+    lcm_xdp_t *xdp;
+#endif
+#ifdef USE_IO_URING
+    // what the thread receives through, with io_uring=1, instead of the poller
+    lcm_uring_t *uring;
+#endif
+};
+
+/**
+ * udpm_frag_shard_t:
+ * Fragmented messages being reassembled, and the sequence numbers seen, for
+ * the senders that hash to this shard.  Fragments of one message may be read
+ * by different receive threads, which then meet here.
+ */
+typedef struct _udpm_frag_shard_t udpm_frag_shard_t;
+struct _udpm_frag_shard_t {
+    GMutex lock;
+    lcm_frag_buf_store *frag_bufs;
+    GHashTable *senders;  // udpm_sender_t by address and port
+    // udpm_delta_base_t by address, port and channel, for the delta option
+    GHashTable *delta_bases;
+};
+
+// most senders whose sequence numbers a shard tracks at once
+#define UDPM_MAX_SENDERS 1024
+
+typedef struct _udpm_sender_t {
+    gint64 key;  // IPv4 address and port
+    lcm_seqno_state_t seqno;
+} udpm_sender_t;
+
+/**
+ * udpm_delta_base_t:
+ * The last message that was sent on a channel of the delta option, as it was
+ * reconstructed by a receiver, or as a publisher sent it.  Deltas are taken
+ * from it.  @data is NULL if the next message has to be a keyframe.
+ */
+typedef struct _udpm_delta_base_t {
+    char *data;
+    uint32_t size;
+    uint32_t seqno;
+    int since_keyframe;  // messages sent since the last keyframe
+} udpm_delta_base_t;
+
+static void udpm_delta_base_free(gpointer data)
+{
+    udpm_delta_base_t *base = (udpm_delta_base_t *) data;
+    free(base->data);
+    free(base);
+}
+
+/**
+ * udpm_retained_msg_t:
+ * A fragmented message that was sent, kept to send its fragments again when
+ * a receiver NACKs them.  The payload, as it was sent, follows the struct.
+ */
+typedef struct _udpm_retained_msg_t {
+    lcm2_header_long_t hdr;  // the header fields that all fragments share
+    char channel[LCM_MAX_CHANNEL_NAME_LENGTH + 1];
+    int channel_size;
+    int fragment_size;
+    uint32_t datalen;
+} udpm_retained_msg_t;
+
+// most instances that can share a receive side with share=1
+#define UDPM_MAX_SHARED 64
+
+/**
+ * udpm_shared_t:
+ * The receive side that the instances created with share=1 and the same URL
+ * have in common.  The hub is an instance without an lcm_t, whose read
+ * threads queue each message for every member that subscribes to it.  Each
+ * member has a queue per read thread of the hub, to keep them single
+ * producer.  The messages go back to the read thread that received them once
+ * every member that queued them has dispatched them.
+ */
+typedef struct _udpm_shared_t udpm_shared_t;
+struct _udpm_shared_t {
+    char *key;     // the URL, with its options in order
+    int refcount;  // instances created with the URL, protected by udpm_shared_lock
+    lcm_udpm_t *hub;
+
+    /* The members that receive, at their share_slot, and the number of slots
+     * up to the last one that was taken.  Protected by lock. */
+    GMutex lock;
+    lcm_udpm_t *members[UDPM_MAX_SHARED];
+    int num_slots;
+};
+
 struct _lcm_provider_t {
     SOCKET recvfd;
     SOCKET sendfd;
     struct sockaddr_in dest_addr;
 
+    /* Where each datagram is sent to: the peers, or else dest_addr. */
+    struct sockaddr_in *dests;
+    int num_dests;
+
     lcm_t *lcm;
 
     udpm_params_t params;
 
     /* size of the kernel UDP receive buffer */
     int kernel_rbuf_sz;
+    /* With recv_buf_max: the size last requested for the kernel receive
+     * buffer, the drops that the kernel last reported, and when the buffer
+     * was last grown.  rbuf_requested and rbuf_grow_utime are guarded by
+     * rbuf_lock, and rbuf_drops is changed atomically. */
+    GMutex rbuf_lock;
+    int rbuf_requested;
+    int rbuf_drops;
+    int64_t rbuf_grow_utime;
     int warned_about_small_kernel_buf;
 
-    /* Packet structures available for sending or receiving use are
-     * stored in the *_empty queues. */
-    lcm_buf_queue_t *inbufs_empty;
-    /* Received packets that are filled with data are queued here. */
-    lcm_buf_queue_t *inbufs_filled;
-
-    /* Memory for received small packets is taken from a fixed-size ring buffer
-     * so we don't have to do any mallocs */
-    lcm_ringbuf_t *ringbuf;
-
-    GRecMutex mutex; /* Must be locked when reading/writing to the above three queues */
+    GRecMutex mutex; /* Protects setup and teardown of the receive resources */
 
     int thread_created;
-    GThread *read_thread;
-    int notify_pipe[2];      // pipe to notify application when messages arrive
-    int thread_msg_pipe[2];  // pipe to notify read thread when to quit
+    udpm_recv_thread_t *recv_threads;
+    int num_recv_threads;
+    int next_recv_thread;    // where lcm_handle() looks for a message first
+#ifdef USE_IOCP
+    // what all the read threads receive through, with iocp=1, instead of
+    // their pollers.  A socket can only have one completion port.
+    lcm_iocp_t *iocp;
+#endif
+    // size that the ringbuffer of a read thread may grow to, or 0 for no limit
+    unsigned int ringbuf_max;
+    // a bundle packet that lcm_handle() has dispatched only some messages of,
+    // and the read thread that it came from
+    lcm_buf_t *bundle_pending;
+    udpm_recv_thread_t *bundle_pending_owner;
+    int notify_pipe[2];      // notifies application when messages arrive.  Both
+                             // ends are the same eventfd on Linux.
+    int thread_msg_pipe[2];  // pipe to notify read threads when to quit
 
     GMutex transmit_lock;  // so that only thread at a time can transmit
 
+    /* Short messages collected into a bundle packet, with bundle_size > 0.
+     * The bundle thread sends the packet once the oldest message in it has
+     * waited for bundle_interval.  Protected by transmit_lock. */
+    char *bundle_buf;
+    int bundle_len;           // bytes in bundle_buf, or 0 if there is no packet
+    int64_t bundle_deadline;  // monotonic time at which the packet is sent
+    GCond bundle_cond;        // a packet was started, or bundle_exit was set
+    int bundle_exit;
+    GThread *bundle_thread;
+
+    /* The token bucket of send_rate: bytes that may be sent right away, which
+     * goes negative after a datagram larger than what was left, and when it
+     * was last refilled.  Protected by transmit_lock. */
+    double pace_tokens;
+    int64_t pace_utime;
+
+    /* Fragmented messages kept for retransmission, on the channels of the
+     * retransmit option, oldest first, and the bytes of their payloads.
+     * Protected by transmit_lock. */
+    GQueue *retained;
+    int64_t retained_bytes;
+
+    /* The udpm_delta_base_t of each channel of the delta option, by channel
+     * name.  delta_lock is held from the delta of a message until it has been
+     * sent, so that the messages of a channel go out in the order their
+     * deltas were taken in. */
+    GHashTable *delta_bases;
+    GMutex delta_lock;
+
+    /* The repair thread answers the NACKs that arrive on sendfd, and sends
+     * NACKs for the incomplete messages of frag_shards.  It holds repair_lock
+     * while it looks at frag_shards, which is taken to set them up and tear
+     * them down too. */
+    GThread *repair_thread;
+    int repair_exit;
+    GMutex repair_lock;
+
+    /* With the interest option, the interest thread reads the announcements
+     * of every instance on the group from interestfd into interest, and
+     * announces interest_channels, the number of subscriptions of this
+     * instance to each channel pattern, which is protected by interest_lock.
+     * interest_id is in the announcements of this instance. */
+    lcm_interest_t *interest;
+    SOCKET interestfd;
+    GHashTable *interest_channels;
+    GMutex interest_lock;
+    uint32_t interest_id;
+    GThread *interest_thread;
+    int interest_exit;
+
+    /* The udpm_latched_t of each channel of the latch option that a message
+     * was published on, by channel name.  latch_lock is held while they are
+     * sent again, so that a message that is published meanwhile goes out
+     * after them. */
+    GHashTable *latched;
+    GMutex latch_lock;
+
     /* synchronization variables used only while allocating receive resources
      */
     int creating_read_thread;
@@ -100,34 +570,270 @@ struct _lcm_provider_t {
     GMutex *p_create_read_thread_mutex;
 
     /* other variables */
-    lcm_frag_buf_store *frag_bufs;
-
-    uint32_t udp_rx;             // packets received and processed
-    uint32_t udp_discarded_bad;  // packets discarded because they were bad
-                                 // somehow
-    double udp_low_watermark;    // least buffer available
-    int32_t udp_last_report_secs;
+    udpm_frag_shard_t *frag_shards;
+    int num_frag_shards;
+    // recycles the payload buffers of fragmented messages
+    lcm_buf_pool_t *frag_pool;
+
+    // number of subscriptions to each channel pattern, for the socket filter
+    GHashTable *filter_channels;
+
+    // messages published for subscribers of this instance, with
+    // local_delivery=1.  Protected by local_lock.
+    GQueue *local_queue;
+    GMutex local_lock;
+    // source address of the datagrams sent from sendfd, so that their
+    // loopback copies can be recognized with local_delivery=1
+    struct sockaddr_in send_addr;
+
+    /* Messages published with lcm_publish_async(), oldest first, and the
+     * thread that transmits them.  The messages are allocated from send_ring
+     * in the same order, so the oldest one can always be released.  All of
+     * this is protected by send_lock. */
+    GMutex send_lock;
+    GCond send_cond;        // the queue became non-empty, or send_exit was set
+    GCond send_space_cond;  // a message was removed from the queue
+    lcm_ringbuf_t *send_ring;
+    udpm_send_msg_t *send_head;
+    udpm_send_msg_t *send_tail;
+    int send_exit;
+    GThread *send_thread;
+
+    /* The self test of self_test=async.  The read threads set
+     * self_test_passed when the self test message arrives.  Protected by
+     * self_test_lock. */
+    GMutex self_test_lock;
+    GCond self_test_cond;  // self_test_passed or self_test_exit was set
+    int self_test_passed;
+    int self_test_exit;
+    GThread *self_test_thread;
+
+    // counters for lcm_get_stats(), updated with lcm_stat_add()
+    lcm_stats_t stats;
+
+    // with mono_clock=kernel, the system clock minus the monotonic clock, in
+    // nanoseconds, read and written with relaxed atomic operations
+    int64_t mono_offset_ns;
 
     uint32_t msg_seqno;  // rolling counter of how many messages transmitted
+    int cur_iface;       // of params.ifaces that sendfd sends out of
+
+    // with share=1, what this instance receives through, and its slot in
+    // its members once it receives.  The receive threads of a member only
+    // have the inbufs_filled queues, which the hub fills.
+    udpm_shared_t *shared;
+    int share_slot;
+    // if this is the hub of a udpm_shared_t, that udpm_shared_t
+    udpm_shared_t *fanout;
 };
 
+// the udpm_shared_t of each key, protected by udpm_shared_lock
+static GMutex udpm_shared_lock;
+static GHashTable *udpm_shared_by_key;
+
 static int _setup_recv_parts(lcm_udpm_t *lcm);
+static void udpm_shared_unref(udpm_shared_t *shared);
+static void udpm_interest_stop(lcm_udpm_t *lcm);
+static void udpm_latch_replay(lcm_udpm_t *lcm, uint32_t id);
 
 static GPrivate CREATE_READ_THREAD_PKEY;
 
+static int udpm_notify_create(lcm_udpm_t *lcm)
+{
+#ifdef USE_EVENTFD
+    int fd = eventfd(0, EFD_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    lcm->notify_pipe[0] = lcm->notify_pipe[1] = fd;
+#else
+    if (0 != lcm_internal_pipe_create(lcm->notify_pipe))
+        return -1;
+    fcntl(lcm->notify_pipe[1], F_SETFL, O_NONBLOCK);
+#endif
+    return 0;
+}
+
+static void udpm_notify_close(lcm_udpm_t *lcm)
+{
+    if (lcm->notify_pipe[0] < 0)
+        return;
+    lcm_internal_pipe_close(lcm->notify_pipe[0]);
+#ifndef USE_EVENTFD
+    lcm_internal_pipe_close(lcm->notify_pipe[1]);
+#endif
+    lcm->notify_pipe[0] = lcm->notify_pipe[1] = -1;
+}
+
+// wake up lcm_handle() and make lcm_get_fileno() readable
+static void udpm_notify(lcm_udpm_t *lcm)
+{
+#ifdef USE_EVENTFD
+    uint64_t one = 1;
+    if (write(lcm->notify_pipe[1], &one, sizeof(one)) < 0)
+#else
+    if (lcm_internal_pipe_write(lcm->notify_pipe[1], "+", 1) < 0)
+#endif
+        perror("write to notify");
+}
+
+// Block until notified.  On Linux, this consumes every pending notification at
+// once.  Returns 0 on success, -1 on error.
+static int udpm_notify_consume(lcm_udpm_t *lcm)
+{
+#ifdef USE_EVENTFD
+    uint64_t count;
+    int status = read(lcm->notify_pipe[0], &count, sizeof(count));
+#else
+    char ch;
+    int status = lcm_internal_pipe_read(lcm->notify_pipe[0], &ch, 1);
+#endif
+    if (status == 0) {
+        fprintf(stderr, "Error: lcm_handle read 0 bytes from notify_pipe\n");
+        return -1;
+    } else if (status < 0) {
+        fprintf(stderr, "Error: lcm_handle read: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// room for any of the timestamp control messages that may be received
+#define RECV_CONTROLBUF_SIZE 128
+
+static udpm_recv_batch_t *udpm_recv_batch_new(int depth)
+{
+    udpm_recv_batch_t *batch = (udpm_recv_batch_t *) calloc(1, sizeof(udpm_recv_batch_t));
+    batch->depth = depth;
+    batch->lcmbs = (lcm_buf_t **) calloc(depth, sizeof(lcm_buf_t *));
+    batch->bufs = (char **) calloc(depth, sizeof(char *));
+    batch->lens = (unsigned int *) calloc(depth, sizeof(unsigned int));
+    batch->complete = (int *) calloc(depth, sizeof(int));
+#ifdef USE_RECVMMSG
+    batch->msgs = (struct mmsghdr *) calloc(depth, sizeof(struct mmsghdr));
+    batch->vecs = (struct iovec *) calloc(depth, sizeof(struct iovec));
+    batch->controlbufs = (char *) calloc(depth, RECV_CONTROLBUF_SIZE);
+#endif
+    return batch;
+}
+
+static void udpm_recv_batch_free(udpm_recv_batch_t *batch)
+{
+    free(batch->lcmbs);
+    free(batch->bufs);
+    free(batch->lens);
+    free(batch->complete);
+#ifdef USE_RECVMMSG
+    free(batch->msgs);
+    free(batch->vecs);
+    free(batch->controlbufs);
+#endif
+    free(batch);
+}
+
+static void _destroy_recv_thread(udpm_recv_thread_t *rt)
+{
+    if (rt->poller)
+        lcm_poller_destroy(rt->poller);
+    if (rt->recv_batch)
+        udpm_recv_batch_free(rt->recv_batch);
+#ifdef LCM_HAVE_XDP
+    if (rt->xdp)
+        lcm_xdp_close(rt->xdp);
+#endif
+#ifdef USE_IO_URING
+    if (rt->uring)
+        lcm_uring_destroy(rt->uring);
+#endif
+
+    if (rt->inbufs_done)
+        lcm_buf_ring_free(rt->inbufs_done, rt->ringbuf);
+    lcm_buf_returns_clear(&rt->returns, rt->ringbuf);
+    int i;
+    for (i = 0; i <= LCM_MAX_PRIORITY; i++) {
+        if (rt->inbufs_filled[i])
+            lcm_buf_ring_free(rt->inbufs_filled[i], rt->ringbuf);
+    }
+    if (rt->inbufs_empty)
+        lcm_buf_queue_free(rt->inbufs_empty, rt->ringbuf);
+    if (rt->ringbuf)
+        lcm_ringbuf_free(rt->ringbuf);
+    memset(rt, 0, sizeof(udpm_recv_thread_t));
+}
+
+// Stops a member of a udpm_shared_t from receiving, and hands the messages
+// that were queued for it back to the hub.
+static void udpm_shared_leave(lcm_udpm_t *lcm)
+{
+    udpm_shared_t *shared = lcm->shared;
+    if (!lcm->recv_threads)
+        return;
+    g_mutex_lock(&shared->lock);
+    shared->members[lcm->share_slot] = NULL;
+    g_mutex_unlock(&shared->lock);
+
+    // the hub queues nothing more here
+    int i, priority;
+    for (i = 0; i < lcm->num_recv_threads; i++) {
+        udpm_recv_thread_t *rt = &lcm->recv_threads[i];
+        for (priority = 0; priority <= LCM_MAX_PRIORITY; priority++) {
+            lcm_buf_t *lcmb;
+            while ((lcmb = lcm_buf_ring_pop(rt->inbufs_filled[priority])))
+                lcm_buf_lender.release(lcmb);
+        }
+        _destroy_recv_thread(rt);
+    }
+    free(lcm->recv_threads);
+    lcm->recv_threads = NULL;
+    lcm->num_recv_threads = 0;
+    lcm->thread_created = 0;
+}
+
 static void _destroy_recv_parts(lcm_udpm_t *lcm)
 {
-    if (lcm->thread_created) {
-        // send the read thread an exit command
-        int wstatus = lcm_internal_pipe_write(lcm->thread_msg_pipe[1], "\0", 1);
-        if (wstatus < 0) {
+    int i;
+    if (lcm->shared) {
+        udpm_shared_leave(lcm);
+        return;
+    }
+    if (lcm->self_test_thread) {
+        g_mutex_lock(&lcm->self_test_lock);
+        lcm->self_test_exit = 1;
+        g_cond_signal(&lcm->self_test_cond);
+        g_mutex_unlock(&lcm->self_test_lock);
+        g_thread_join(lcm->self_test_thread);
+        lcm->self_test_thread = NULL;
+    }
+    if (lcm->bundle_pending) {
+        lcm_buf_ring_push(lcm->bundle_pending_owner->inbufs_done, lcm->bundle_pending);
+        lcm->bundle_pending = NULL;
+    }
+    if (lcm->recv_threads) {
+        // send the read threads an exit command.  Nobody reads it, so it wakes
+        // up every one of them.
+        int wstatus = 0;
+        if (lcm->thread_created)
+            wstatus = lcm_internal_pipe_write(lcm->thread_msg_pipe[1], "\0", 1);
+        if (wstatus < 0)
             perror(__FILE__ " write(destroy)");
-        } else {
-            g_thread_join(lcm->read_thread);
+
+        for (i = 0; i < lcm->num_recv_threads; i++) {
+            udpm_recv_thread_t *rt = &lcm->recv_threads[i];
+            if (rt->thread && wstatus >= 0)
+                g_thread_join(rt->thread);
+        }
+#ifdef USE_IOCP
+        if (lcm->iocp) {
+            lcm_iocp_destroy(lcm->iocp);
+            lcm->iocp = NULL;
         }
-        lcm->read_thread = NULL;
-        lcm->thread_created = 0;
+#endif
+        for (i = 0; i < lcm->num_recv_threads; i++)
+            _destroy_recv_thread(&lcm->recv_threads[i]);
+        free(lcm->recv_threads);
+        lcm->recv_threads = NULL;
+        lcm->num_recv_threads = 0;
     }
+    lcm->thread_created = 0;
 
     if (lcm->thread_msg_pipe[0] >= 0) {
         lcm_internal_pipe_close(lcm->thread_msg_pipe[0]);
@@ -140,36 +846,110 @@ static void _destroy_recv_parts(lcm_udpm_t *lcm)
         lcm->recvfd = -1;
     }
 
-    if (lcm->frag_bufs) {
-        lcm_frag_buf_store_destroy(lcm->frag_bufs);
-        lcm->frag_bufs = NULL;
+    g_mutex_lock(&lcm->repair_lock);
+    if (lcm->frag_shards) {
+        for (i = 0; i < lcm->num_frag_shards; i++) {
+            lcm_frag_buf_store_destroy(lcm->frag_shards[i].frag_bufs);
+            g_hash_table_destroy(lcm->frag_shards[i].senders);
+            g_hash_table_destroy(lcm->frag_shards[i].delta_bases);
+            g_mutex_clear(&lcm->frag_shards[i].lock);
+        }
+        free(lcm->frag_shards);
+        lcm->frag_shards = NULL;
+        lcm->num_frag_shards = 0;
     }
+    g_mutex_unlock(&lcm->repair_lock);
 
-    if (lcm->inbufs_empty) {
-        lcm_buf_queue_free(lcm->inbufs_empty, lcm->ringbuf);
-        lcm->inbufs_empty = NULL;
+    // after the read threads and the fragment buffers, which release their
+    // payload buffers into the pool
+    if (lcm->frag_pool) {
+        lcm_buf_pool_destroy(lcm->frag_pool);
+        lcm->frag_pool = NULL;
     }
-    if (lcm->inbufs_filled) {
-        lcm_buf_queue_free(lcm->inbufs_filled, lcm->ringbuf);
-        lcm->inbufs_filled = NULL;
-    }
-    if (lcm->ringbuf) {
-        lcm_ringbuf_free(lcm->ringbuf);
-        lcm->ringbuf = NULL;
+}
+
+static void udpm_free_ifaces(udpm_iface_t *ifaces, int num_ifaces)
+{
+    for (int i = 0; i < num_ifaces; i++) {
+        if (ifaces[i].re)
+            g_regex_unref(ifaces[i].re);
     }
+    g_free(ifaces);
 }
 
 static void lcm_udpm_destroy(lcm_udpm_t *lcm)
 {
     dbg(DBG_LCM, "closing lcm context\n");
+    udpm_interest_stop(lcm);
+    if (lcm->repair_thread) {
+        g_atomic_int_set(&lcm->repair_exit, 1);
+        g_thread_join(lcm->repair_thread);
+    }
+    if (lcm->send_thread) {
+        // the sender thread transmits whatever is still queued before it exits
+        g_mutex_lock(&lcm->send_lock);
+        lcm->send_exit = 1;
+        g_cond_signal(&lcm->send_cond);
+        g_mutex_unlock(&lcm->send_lock);
+        g_thread_join(lcm->send_thread);
+    }
+    if (lcm->send_ring)
+        lcm_ringbuf_free(lcm->send_ring);
+    g_mutex_clear(&lcm->send_lock);
+    g_cond_clear(&lcm->send_cond);
+    g_cond_clear(&lcm->send_space_cond);
+    if (lcm->bundle_thread) {
+        // the bundle thread sends the last packet before it exits
+        g_mutex_lock(&lcm->transmit_lock);
+        lcm->bundle_exit = 1;
+        g_cond_signal(&lcm->bundle_cond);
+        g_mutex_unlock(&lcm->transmit_lock);
+        g_thread_join(lcm->bundle_thread);
+    }
+    free(lcm->bundle_buf);
+    g_cond_clear(&lcm->bundle_cond);
+
     _destroy_recv_parts(lcm);
+    if (lcm->shared)
+        udpm_shared_unref(lcm->shared);
 
     if (lcm->sendfd >= 0)
         lcm_close_socket(lcm->sendfd);
 
-    lcm_internal_pipe_close(lcm->notify_pipe[0]);
-    lcm_internal_pipe_close(lcm->notify_pipe[1]);
-
+    udpm_notify_close(lcm);
+
+    g_hash_table_destroy(lcm->filter_channels);
+    udpm_local_msg_t *msg;
+    while ((msg = (udpm_local_msg_t *) g_queue_pop_head(lcm->local_queue)))
+        free(msg);
+    g_queue_free(lcm->local_queue);
+    g_mutex_clear(&lcm->local_lock);
+    if (lcm->params.compress_re)
+        g_regex_unref(lcm->params.compress_re);
+    if (lcm->params.retransmit_re)
+        g_regex_unref(lcm->params.retransmit_re);
+    if (lcm->params.latch_re)
+        g_regex_unref(lcm->params.latch_re);
+    if (lcm->latched)
+        g_hash_table_destroy(lcm->latched);
+    g_mutex_clear(&lcm->latch_lock);
+    if (lcm->params.delta_re)
+        g_regex_unref(lcm->params.delta_re);
+    if (lcm->delta_bases)
+        g_hash_table_destroy(lcm->delta_bases);
+    g_mutex_clear(&lcm->delta_lock);
+    g_mutex_clear(&lcm->interest_lock);
+    g_mutex_clear(&lcm->rbuf_lock);
+    g_free(lcm->params.xdp_ifname);
+    g_free(lcm->params.peers);
+    udpm_free_ifaces(lcm->params.ifaces, lcm->params.num_ifaces);
+    udpm_retained_msg_t *retained;
+    while ((retained = (udpm_retained_msg_t *) g_queue_pop_head(lcm->retained)))
+        free(retained);
+    g_queue_free(lcm->retained);
+    g_mutex_clear(&lcm->repair_lock);
+    g_mutex_clear(&lcm->self_test_lock);
+    g_cond_clear(&lcm->self_test_cond);
     g_rec_mutex_clear(&lcm->mutex);
     g_mutex_clear(&lcm->transmit_lock);
     if (lcm->p_create_read_thread_mutex) {
@@ -207,6 +987,77 @@ fail:
     return -1;
 }
 
+// Parses the peers option, a list of HOST[:PORT] separated by commas.
+// Returns the number of peers, or -1 if one of them is not valid.
+static int parse_peers(const char *str, struct sockaddr_in **peers)
+{
+    char **words = g_strsplit(str, ",", -1);
+    int num_peers = g_strv_length(words);
+    *peers = g_new0(struct sockaddr_in, num_peers);
+    for (int i = 0; i < num_peers; i++) {
+        char **host_port = g_strsplit(g_strstrip(words[i]), ":", 2);
+        struct sockaddr_in *peer = &(*peers)[i];
+        peer->sin_family = AF_INET;
+        int valid = inet_aton(host_port[0], &peer->sin_addr) != 0;
+        if (valid && host_port[1]) {
+            char *endptr = NULL;
+            int port = strtol(host_port[1], &endptr, 0);
+            valid = endptr != host_port[1] && !*endptr && port > 0 && port <= 65535;
+            peer->sin_port = htons(port);
+        }
+        g_strfreev(host_port);
+        if (!valid) {
+            num_peers = -1;
+            break;
+        }
+    }
+    g_strfreev(words);
+    if (num_peers <= 0) {
+        g_free(*peers);
+        *peers = NULL;
+    }
+    return num_peers;
+}
+
+// Parses the ifaces option, a list of [REGEX:]ADDR separated by commas.
+// Returns the number of interfaces, or -1 if one of them is not valid.
+static int parse_ifaces(const char *str, udpm_iface_t **ifaces)
+{
+    char **words = g_strsplit(str, ",", -1);
+    int num_ifaces = g_strv_length(words);
+    if (num_ifaces > UDPM_MAX_IFACES)
+        num_ifaces = -1;
+    *ifaces = g_new0(udpm_iface_t, MAX(num_ifaces, 0));
+    for (int i = 0; i < num_ifaces; i++) {
+        udpm_iface_t *iface = &(*ifaces)[i];
+        const char *addr = words[i];
+        const char *colon = strrchr(words[i], ':');
+        if (colon) {
+            addr = colon + 1;
+            char *regexbuf = g_strdup_printf("^%.*s$", (int) (colon - words[i]), words[i]);
+            GError *rerr = NULL;
+            iface->re = g_regex_new(regexbuf, (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, &rerr);
+            g_free(regexbuf);
+            if (rerr) {
+                fprintf(stderr, "Warning: %s\n", rerr->message);
+                g_error_free(rerr);
+            }
+        }
+        if ((colon && !iface->re) || inet_aton(addr, &iface->addr) == 0) {
+            udpm_free_ifaces(*ifaces, i + 1);
+            num_ifaces = -1;
+            break;
+        }
+    }
+    g_strfreev(words);
+    if (num_ifaces <= 0) {
+        if (num_ifaces == 0)
+            g_free(*ifaces);
+        *ifaces = NULL;
+    }
+    return num_ifaces;
+}
+
 static void new_argument(gpointer key, gpointer value, gpointer user)
 {
     udpm_params_t *params = (udpm_params_t *) user;
@@ -215,88 +1066,665 @@ static void new_argument(gpointer key, gpointer value, gpointer user)
         params->recv_buf_size = strtol((char *) value, &endptr, 0);
         if (endptr == value)
             fprintf(stderr, "Warning: Invalid value for recv_buf_size\n");
+    } else if (!strcmp((char *) key, "recv_buf_max")) {
+        char *endptr = NULL;
+        params->recv_buf_max = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->recv_buf_max < 0) {
+            fprintf(stderr, "Warning: Invalid value for recv_buf_max\n");
+            params->recv_buf_max = 0;
+        }
     } else if (!strcmp((char *) key, "ttl")) {
         char *endptr = NULL;
         params->mc_ttl = strtol((char *) value, &endptr, 0);
         if (endptr == value)
             fprintf(stderr, "Warning: Invalid value for ttl\n");
-    } else if (!strcmp((char *) key, "transmit_only")) {
-        fprintf(stderr, "%s:%d -- transmit_only option is now obsolete\n", __FILE__, __LINE__);
-    } else {
-        fprintf(stderr, "%s:%d -- unknown provider argument %s\n", __FILE__, __LINE__,
-                (char *) key);
-    }
-}
-
-static int _recv_message_fragment(lcm_udpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz)
-{
-    lcm2_header_long_t *hdr = (lcm2_header_long_t *) lcmb->buf;
-
-    uint32_t msg_seqno = ntohl(hdr->msg_seqno);
-    uint32_t data_size = ntohl(hdr->msg_size);
-    uint32_t fragment_offset = ntohl(hdr->fragment_offset);
-    //    uint16_t fragment_no = ntohs (hdr->fragment_no);
-    uint16_t fragments_in_msg = ntohs(hdr->fragments_in_msg);
-    uint32_t frag_size = sz - sizeof(lcm2_header_long_t);
-    char *data_start = (char *) (hdr + 1);
-
-    // any existing fragment buffer for this message source?
-    lcm_frag_key_t key;
-    key.from = (struct sockaddr_in *) &(lcmb->from);
-    key.msg_seqno = msg_seqno;
-    lcm_frag_buf_t *fbuf = lcm_frag_buf_store_lookup(lcm->frag_bufs, &key);
-
-    // discard any stale fragments from previous messages
-    if (fbuf && (fbuf->data_size != data_size)) {
-        lcm_frag_buf_store_remove(lcm->frag_bufs, fbuf);
-        dbg(DBG_LCM, "Dropping message (missing %d fragments)\n", fbuf->fragments_remaining);
-        fbuf = NULL;
-    }
-
-    //    printf ("fragment %d/%d (offset %d/%d) seq %d packet sz: %d %p\n",
-    //        ntohs(hdr->fragment_no) + 1, fragments_in_msg,
-    //        fragment_offset, data_size, msg_seqno, sz, fbuf);
-
-    if (data_size > LCM_MAX_MESSAGE_SIZE) {
-        dbg(DBG_LCM, "rejecting huge message (%d bytes)\n", data_size);
-        return 0;
-    }
-
-    // if this is the first packet, set some values
-    char *channel = NULL;
-    int channel_sz = 0;
-    if (hdr->fragment_no == 0) {
-        channel = (char *) (hdr + 1);
-        channel_sz = strlen(channel);
-        if (channel_sz > LCM_MAX_CHANNEL_NAME_LENGTH) {
-            dbg(DBG_LCM, "bad channel name length\n");
-            lcm->udp_discarded_bad++;
-            return 0;
+    } else if (!strcmp((char *) key, "recv_batch")) {
+        char *endptr = NULL;
+        params->recv_batch = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->recv_batch < 0) {
+            fprintf(stderr, "Warning: Invalid value for recv_batch\n");
+            params->recv_batch = 0;
         }
-        data_start += channel_sz + 1;
-        frag_size -= (channel_sz + 1);
-    }
-
-    if (!fbuf) {
-        fbuf = lcm_frag_buf_new(*((struct sockaddr_in *) &lcmb->from), msg_seqno, data_size,
-                                fragments_in_msg, lcmb->recv_utime);
-        lcm_frag_buf_store_add(lcm->frag_bufs, fbuf);
-    }
-
-    if (channel != NULL) {
-        memcpy(fbuf->channel, channel, channel_sz + 1);
-    }
-
-#ifdef __linux__
-    if (lcm->kernel_rbuf_sz < 262145 && data_size > lcm->kernel_rbuf_sz &&
-        !lcm->warned_about_small_kernel_buf) {
-        fprintf(stderr,
-                "==== LCM Warning ===\n"
-                "LCM detected that large packets are being received, but the kernel UDP\n"
-                "receive buffer is very small.  The possibility of dropping packets due to\n"
-                "insufficient buffer space is very high.\n"
-                "\n"
-                "For more information, visit:\n"
+#ifndef USE_RECVMMSG
+        if (params->recv_batch > 1)
+            fprintf(stderr, "Warning: recv_batch is not supported on this platform\n");
+#endif
+        if (params->recv_batch > LCM_RECV_QUEUE_SIZE / 2) {
+            fprintf(stderr, "Warning: recv_batch is limited to %d\n", LCM_RECV_QUEUE_SIZE / 2);
+            params->recv_batch = LCM_RECV_QUEUE_SIZE / 2;
+        }
+    } else if (!strcmp((char *) key, "recv_threads")) {
+        char *endptr = NULL;
+        params->recv_threads = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->recv_threads < 0) {
+            fprintf(stderr, "Warning: Invalid value for recv_threads\n");
+            params->recv_threads = 1;
+        }
+    } else if (!strcmp((char *) key, "busy_poll")) {
+        char *endptr = NULL;
+        params->busy_poll = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->busy_poll < 0) {
+            fprintf(stderr, "Warning: Invalid value for busy_poll\n");
+            params->busy_poll = 0;
+        }
+    } else if (!strcmp((char *) key, "recv_cpu") || !strcmp((char *) key, "recv_prio") ||
+               !strcmp((char *) key, "numa_node")) {
+        lcm_parse_thread_sched_arg(&params->recv_sched, (char *) key, (char *) value);
+    } else if (!strcmp((char *) key, "frag_size") || !strcmp((char *) key, "mtu")) {
+        int packet_size = lcm_parse_packet_size((char *) key, (char *) value);
+        if (packet_size == 0)
+            fprintf(stderr, "Warning: Invalid value for %s\n", (char *) key);
+        else
+            params->packet_size = packet_size;
+    } else if (!strcmp((char *) key, "timestamping")) {
+        if (!strcmp((char *) value, "sw"))
+            params->timestamping = UDPM_TIMESTAMPING_SW;
+        else if (!strcmp((char *) value, "hw"))
+            params->timestamping = UDPM_TIMESTAMPING_HW;
+        else
+            fprintf(stderr, "Warning: Invalid value for timestamping\n");
+#ifndef USE_TIMESTAMPING
+        if (params->timestamping != UDPM_TIMESTAMPING_DEFAULT)
+            fprintf(stderr, "Warning: timestamping is not supported on this platform\n");
+#endif
+    } else if (!strcmp((char *) key, "mono_clock")) {
+        if (!strcmp((char *) value, "read"))
+            params->mono_clock = UDPM_MONO_CLOCK_READ;
+        else if (!strcmp((char *) value, "kernel"))
+            params->mono_clock = UDPM_MONO_CLOCK_KERNEL;
+        else
+            fprintf(stderr, "Warning: Invalid value for mono_clock\n");
+    } else if (!strcmp((char *) key, "local_delivery")) {
+        char *endptr = NULL;
+        params->local_delivery = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->local_delivery < 0 || params->local_delivery > 1) {
+            fprintf(stderr, "Warning: Invalid value for local_delivery\n");
+            params->local_delivery = 0;
+        }
+    } else if (!strcmp((char *) key, "send_queue")) {
+        char *endptr = NULL;
+        params->send_queue = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->send_queue < 0) {
+            fprintf(stderr, "Warning: Invalid value for send_queue\n");
+            params->send_queue = 0;
+        }
+    } else if (!strcmp((char *) key, "send_policy")) {
+        if (!strcmp((char *) value, "drop"))
+            params->send_drop = 1;
+        else if (!strcmp((char *) value, "block"))
+            params->send_drop = 0;
+        else
+            fprintf(stderr, "Warning: Invalid value for send_policy\n");
+    } else if (!strcmp((char *) key, "bundle_size")) {
+        char *endptr = NULL;
+        params->bundle_size = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->bundle_size < 0) {
+            fprintf(stderr, "Warning: Invalid value for bundle_size\n");
+            params->bundle_size = 0;
+        }
+    } else if (!strcmp((char *) key, "bundle_interval")) {
+        char *endptr = NULL;
+        params->bundle_interval = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->bundle_interval <= 0) {
+            fprintf(stderr, "Warning: Invalid value for bundle_interval\n");
+            params->bundle_interval = UDPM_DEFAULT_BUNDLE_INTERVAL;
+        }
+    } else if (!strcmp((char *) key, "send_rate")) {
+        char *endptr = NULL;
+        params->send_rate = strtoll((char *) value, &endptr, 0);
+        if (endptr == value || params->send_rate < 0) {
+            fprintf(stderr, "Warning: Invalid value for send_rate\n");
+            params->send_rate = 0;
+        }
+    } else if (!strcmp((char *) key, "send_burst")) {
+        char *endptr = NULL;
+        params->send_burst = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->send_burst <= 0) {
+            fprintf(stderr, "Warning: Invalid value for send_burst\n");
+            params->send_burst = UDPM_DEFAULT_SEND_BURST;
+        }
+    } else if (!strcmp((char *) key, "send_pacing")) {
+        if (!strcmp((char *) value, "kernel"))
+            params->send_pacing_kernel = 1;
+        else if (!strcmp((char *) value, "bucket"))
+            params->send_pacing_kernel = 0;
+        else
+            fprintf(stderr, "Warning: Invalid value for send_pacing\n");
+#ifndef SO_MAX_PACING_RATE
+        if (params->send_pacing_kernel) {
+            fprintf(stderr, "Warning: send_pacing=kernel is not supported on this platform\n");
+            params->send_pacing_kernel = 0;
+        }
+#endif
+    } else if (!strcmp((char *) key, "fec")) {
+        char *endptr = NULL;
+        params->fec_group = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->fec_group < 0 || params->fec_group > 65535) {
+            fprintf(stderr, "Warning: Invalid value for fec\n");
+            params->fec_group = 0;
+        }
+    } else if (!strcmp((char *) key, "retransmit")) {
+        char *regexbuf = g_strdup_printf("^%s$", (char *) value);
+        GError *rerr = NULL;
+        if (params->retransmit_re)
+            g_regex_unref(params->retransmit_re);
+        params->retransmit_re =
+            g_regex_new(regexbuf, (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, &rerr);
+        g_free(regexbuf);
+        if (rerr) {
+            fprintf(stderr, "Warning: Invalid value for retransmit: %s\n", rerr->message);
+            g_error_free(rerr);
+            params->retransmit_re = NULL;
+        }
+    } else if (!strcmp((char *) key, "latch")) {
+        char *regexbuf = g_strdup_printf("^%s$", (char *) value);
+        GError *rerr = NULL;
+        if (params->latch_re)
+            g_regex_unref(params->latch_re);
+        params->latch_re =
+            g_regex_new(regexbuf, (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, &rerr);
+        g_free(regexbuf);
+        if (rerr) {
+            fprintf(stderr, "Warning: Invalid value for latch: %s\n", rerr->message);
+            g_error_free(rerr);
+            params->latch_re = NULL;
+        }
+    } else if (!strcmp((char *) key, "delta")) {
+        char *regexbuf = g_strdup_printf("^%s$", (char *) value);
+        GError *rerr = NULL;
+        if (params->delta_re)
+            g_regex_unref(params->delta_re);
+        params->delta_re =
+            g_regex_new(regexbuf, (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, &rerr);
+        g_free(regexbuf);
+        if (rerr) {
+            fprintf(stderr, "Warning: Invalid value for delta: %s\n", rerr->message);
+            g_error_free(rerr);
+            params->delta_re = NULL;
+        }
+    } else if (!strcmp((char *) key, "delta_keyframe")) {
+        char *endptr = NULL;
+        params->delta_keyframe = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->delta_keyframe < 1) {
+            fprintf(stderr, "Warning: Invalid value for delta_keyframe\n");
+            params->delta_keyframe = UDPM_DEFAULT_DELTA_KEYFRAME;
+        }
+    } else if (!strcmp((char *) key, "retransmit_buffer")) {
+        char *endptr = NULL;
+        params->retransmit_buffer = strtoll((char *) value, &endptr, 0);
+        if (endptr == value || params->retransmit_buffer < 0) {
+            fprintf(stderr, "Warning: Invalid value for retransmit_buffer\n");
+            params->retransmit_buffer = UDPM_DEFAULT_RETRANSMIT_BUFFER;
+        }
+    } else if (!strcmp((char *) key, "nack_timeout")) {
+        char *endptr = NULL;
+        params->nack_timeout = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->nack_timeout <= 0) {
+            fprintf(stderr, "Warning: Invalid value for nack_timeout\n");
+            params->nack_timeout = UDPM_DEFAULT_NACK_TIMEOUT;
+        }
+    } else if (!strcmp((char *) key, "interest")) {
+        char *endptr = NULL;
+        long port = strtol((char *) value, &endptr, 0);
+        if (endptr == value || port < 0 || port > 65535) {
+            fprintf(stderr, "Warning: Invalid value for interest\n");
+            port = 0;
+        }
+        params->interest_port = htons((uint16_t) port);
+    } else if (!strcmp((char *) key, "interest_period")) {
+        char *endptr = NULL;
+        params->interest_period = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->interest_period <= 0) {
+            fprintf(stderr, "Warning: Invalid value for interest_period\n");
+            params->interest_period = UDPM_DEFAULT_INTEREST_PERIOD;
+        }
+    } else if (!strcmp((char *) key, "xdp")) {
+        g_free(params->xdp_ifname);
+        params->xdp_ifname = g_strdup((char *) value);
+        params->xdp_queue = 0;
+        char *colon = strchr(params->xdp_ifname, ':');
+        if (colon) {
+            *colon = 0;
+            char *endptr = NULL;
+            params->xdp_queue = strtol(colon + 1, &endptr, 0);
+            if (endptr == colon + 1 || *endptr || params->xdp_queue < 0) {
+                fprintf(stderr, "Warning: Invalid value for xdp\n");
+                g_free(params->xdp_ifname);
+                params->xdp_ifname = NULL;
+            }
+        }
+#ifndef LCM_HAVE_XDP
+        if (params->xdp_ifname) {
+            fprintf(stderr, "Warning: LCM was built without AF_XDP support, ignoring xdp\n");
+            g_free(params->xdp_ifname);
+            params->xdp_ifname = NULL;
+        }
+#endif
+    } else if (!strcmp((char *) key, "io_uring")) {
+        char *endptr = NULL;
+        params->io_uring = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->io_uring < 0 || params->io_uring > 1) {
+            fprintf(stderr, "Warning: Invalid value for io_uring\n");
+            params->io_uring = 0;
+        }
+#ifndef USE_IO_URING
+        if (params->io_uring) {
+            fprintf(stderr, "Warning: io_uring is not supported on this platform\n");
+            params->io_uring = 0;
+        }
+#endif
+    } else if (!strcmp((char *) key, "peers")) {
+        g_free(params->peers);
+        params->num_peers = parse_peers((char *) value, &params->peers);
+        if (params->num_peers < 0) {
+            fprintf(stderr, "Warning: Invalid value for peers\n");
+            params->num_peers = 0;
+        }
+    } else if (!strcmp((char *) key, "ifaces")) {
+        udpm_free_ifaces(params->ifaces, params->num_ifaces);
+        params->num_ifaces = parse_ifaces((char *) value, &params->ifaces);
+        if (params->num_ifaces < 0) {
+            fprintf(stderr, "Warning: Invalid value for ifaces\n");
+            params->num_ifaces = 0;
+        }
+    } else if (!strcmp((char *) key, "unicast")) {
+        char *endptr = NULL;
+        params->unicast = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->unicast < 0 || params->unicast > 1) {
+            fprintf(stderr, "Warning: Invalid value for unicast\n");
+            params->unicast = 0;
+        }
+    } else if (!strcmp((char *) key, "iocp")) {
+        char *endptr = NULL;
+        params->iocp = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->iocp < 0 || params->iocp > 1) {
+            fprintf(stderr, "Warning: Invalid value for iocp\n");
+            params->iocp = 0;
+        }
+#ifndef USE_IOCP
+        if (params->iocp) {
+            fprintf(stderr, "Warning: iocp is only supported on Windows\n");
+            params->iocp = 0;
+        }
+#endif
+    } else if (!strcmp((char *) key, "compress")) {
+        params->compress_re = lcm_parse_compress_option((char *) value);
+    } else if (!strcmp((char *) key, "ringbuf_size")) {
+        char *endptr = NULL;
+        params->ringbuf_size = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->ringbuf_size < UDPM_MIN_RINGBUF_SIZE) {
+            fprintf(stderr, "Warning: Invalid value for ringbuf_size\n");
+            params->ringbuf_size = 0;
+        }
+    } else if (!strcmp((char *) key, "ringbuf_max")) {
+        char *endptr = NULL;
+        params->ringbuf_max = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->ringbuf_max < 0) {
+            fprintf(stderr, "Warning: Invalid value for ringbuf_max\n");
+            params->ringbuf_max = 0;
+        }
+    } else if (!strcmp((char *) key, "ringbuf_lock")) {
+        char *endptr = NULL;
+        params->ringbuf_lock = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->ringbuf_lock < 0 || params->ringbuf_lock > 1) {
+            fprintf(stderr, "Warning: Invalid value for ringbuf_lock\n");
+            params->ringbuf_lock = 0;
+        }
+    } else if (!strcmp((char *) key, "align")) {
+        char *endptr = NULL;
+        params->align = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->align < 1 || params->align > LCM_MAX_DATA_ALIGNMENT ||
+            (params->align & (params->align - 1))) {
+            fprintf(stderr, "Warning: Invalid value for align\n");
+            params->align = 1;
+        }
+    } else if (!strcmp((char *) key, "recv_bufs")) {
+        char *endptr = NULL;
+        params->recv_bufs = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->recv_bufs < 1) {
+            fprintf(stderr, "Warning: Invalid value for recv_bufs\n");
+            params->recv_bufs = 0;
+        }
+    } else if (!strcmp((char *) key, "frag_store")) {
+        char *endptr = NULL;
+        params->frag_store = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->frag_store < LCM_MAX_UNFRAGMENTED_PACKET_SIZE) {
+            fprintf(stderr, "Warning: Invalid value for frag_store\n");
+            params->frag_store = 0;
+        }
+    } else if (!strcmp((char *) key, "max_frag_bufs")) {
+        char *endptr = NULL;
+        params->max_frag_bufs = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->max_frag_bufs < 1) {
+            fprintf(stderr, "Warning: Invalid value for max_frag_bufs\n");
+            params->max_frag_bufs = 0;
+        }
+    } else if (!strcmp((char *) key, "lean")) {
+        char *endptr = NULL;
+        params->lean = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->lean < 0 || params->lean > 1) {
+            fprintf(stderr, "Warning: Invalid value for lean\n");
+            params->lean = 0;
+        }
+    } else if (!strcmp((char *) key, "share")) {
+        char *endptr = NULL;
+        params->share = strtol((char *) value, &endptr, 0);
+        if (endptr == value || params->share < 0 || params->share > 1) {
+            fprintf(stderr, "Warning: Invalid value for share\n");
+            params->share = 0;
+        }
+    } else if (!strcmp((char *) key, "self_test")) {
+        if (!strcmp((char *) value, "1"))
+            params->self_test = UDPM_SELF_TEST_ON;
+        else if (!strcmp((char *) value, "0"))
+            params->self_test = UDPM_SELF_TEST_OFF;
+        else if (!strcmp((char *) value, "async"))
+            params->self_test = UDPM_SELF_TEST_ASYNC;
+        else
+            fprintf(stderr, "Warning: Invalid value for self_test\n");
+    } else if (!strcmp((char *) key, "transmit_only")) {
+        fprintf(stderr, "%s:%d -- transmit_only option is now obsolete\n", __FILE__, __LINE__);
+    } else {
+        fprintf(stderr, "%s:%d -- unknown provider argument %s\n", __FILE__, __LINE__,
+                (char *) key);
+    }
+}
+
+// fragments are reassembled by the shard that their sender hashes to
+// Queues a message on channel for the subscriptions that want it, of lcm, or
+// if lcm is the hub of a udpm_shared_t, of its members, which are added to
+// the share_mask of lcmb.  Stores the highest priority class of channel among
+// them in priority.  Returns whether any of them kept it.
+static int udpm_try_enqueue(lcm_udpm_t *lcm, lcm_buf_t *lcmb, const char *channel, int *priority)
+{
+    udpm_shared_t *shared = lcm->fanout;
+    if (!shared)
+        return lcm_try_enqueue_message_priority(lcm->lcm, channel, priority);
+
+    int kept = 0;
+    *priority = 0;
+    g_mutex_lock(&shared->lock);
+    int i;
+    for (i = 0; i < shared->num_slots; i++) {
+        lcm_udpm_t *member = shared->members[i];
+        int member_priority;
+        if (member && lcm_try_enqueue_message_priority(member->lcm, channel, &member_priority)) {
+            lcmb->share_mask |= (uint64_t) 1 << i;
+            *priority = MAX(*priority, member_priority);
+            kept = 1;
+        }
+    }
+    g_mutex_unlock(&shared->lock);
+    return kept;
+}
+
+// whether anybody that lcm receives for subscribes to channel
+static int udpm_has_handlers(lcm_udpm_t *lcm, const char *channel)
+{
+    udpm_shared_t *shared = lcm->fanout;
+    if (!shared)
+        return lcm_has_handlers(lcm->lcm, channel);
+
+    int has_handlers = 0;
+    g_mutex_lock(&shared->lock);
+    int i;
+    for (i = 0; i < shared->num_slots && !has_handlers; i++) {
+        lcm_udpm_t *member = shared->members[i];
+        has_handlers = member && lcm_has_handlers(member->lcm, channel);
+    }
+    g_mutex_unlock(&shared->lock);
+    return has_handlers;
+}
+
+static udpm_frag_shard_t *_frag_shard_for(lcm_udpm_t *lcm, const struct sockaddr_in *from)
+{
+    uint32_t hash = ntohl(from->sin_addr.s_addr) * 31 + ntohs(from->sin_port);
+    return &lcm->frag_shards[hash % lcm->num_frag_shards];
+}
+
+// Reconstructs a message that was received with LCM2_MAGIC_LONG_DELTA, in
+// fbuf, from the previous one on its channel, and keeps it for the next.
+// Returns like lcm_frag_buf_delta_decode().
+static int udpm_delta_decode(udpm_frag_shard_t *shard, lcm_frag_buf_t *fbuf)
+{
+    char *key = g_strdup_printf("%08x:%04x:%s", ntohl(fbuf->from.sin_addr.s_addr),
+                                ntohs(fbuf->from.sin_port), fbuf->channel);
+    udpm_delta_base_t *base = (udpm_delta_base_t *) g_hash_table_lookup(shard->delta_bases, key);
+    int status = lcm_frag_buf_delta_decode(fbuf, base ? base->data : NULL, base ? base->size : 0,
+                                           base ? base->seqno : 0);
+    if (status != 0) {
+        g_free(key);
+        return status;
+    }
+
+    if (!base) {
+        // senders that come and go, with a new port each time, are forgotten
+        if (g_hash_table_size(shard->delta_bases) >= UDPM_MAX_DELTA_BASES)
+            g_hash_table_remove_all(shard->delta_bases);
+        base = (udpm_delta_base_t *) calloc(1, sizeof(udpm_delta_base_t));
+        g_hash_table_insert(shard->delta_bases, key, base);
+    } else {
+        g_free(key);
+    }
+    if (base->size != fbuf->data_size) {
+        free(base->data);
+        base->data = (char *) malloc(fbuf->data_size);
+        base->size = fbuf->data_size;
+    }
+    memcpy(base->data, fbuf->data, fbuf->data_size);
+    base->seqno = fbuf->msg_seqno;
+    return 0;
+}
+
+// Hands over a message whose fragments have all been received, in lcmb.
+// magic is that of the fragments.
+static int _recv_message_complete(lcm_udpm_t *lcm, udpm_frag_shard_t *shard,
+                                  lcm_frag_buf_t *fbuf, lcm_buf_t *lcmb, uint32_t magic)
+{
+    lcm_frag_buf_store *frag_bufs = shard->frag_bufs;
+    if (magic == LCM2_MAGIC_LONG_LZ4 && lcm_frag_buf_decompress(fbuf) < 0) {
+        dbg(DBG_LCM, "dropping message that does not decompress\n");
+        lcm_stat_add(&lcm->stats.packets_bad, 1);
+        lcm_frag_buf_store_remove(frag_bufs, fbuf);
+        return 0;
+    }
+    if (magic == LCM2_MAGIC_LONG_DELTA) {
+        int status = udpm_delta_decode(shard, fbuf);
+        if (status != 0) {
+            dbg(DBG_LCM, "dropping delta that %s\n",
+                status < 0 ? "is invalid" : "is from a message that was not received");
+            lcm_stat_add(status < 0 ? &lcm->stats.packets_bad : &lcm->stats.deltas_dropped, 1);
+            lcm_frag_buf_store_remove(frag_bufs, fbuf);
+            return 0;
+        }
+    }
+
+    // complete message received.  Is there a subscriber that still
+    // wants it?  (i.e., does any subscriber have space in its queue?)
+    if (!udpm_try_enqueue(lcm, lcmb, fbuf->channel, &lcmb->priority)) {
+        // no... sad... free the fragment buffer and return
+        lcm_frag_buf_store_remove(frag_bufs, fbuf);
+        return 0;
+    }
+
+    // yes, transfer ownership of the message's payload buffer into the
+    // lcm_buf_t.  The caller is responsible for releasing the
+    // ringbuffer-allocated packet buffer that lcmb->buf used to point to.
+    lcmb->buf = fbuf->data;
+    lcmb->buf_size = fbuf->data_size;
+    lcmb->ringbuf = NULL;
+    lcmb->pool = fbuf->pool;
+    fbuf->data = NULL;
+
+    lcm_buf_set_channel(lcmb, fbuf->channel, strlen(fbuf->channel));
+    lcmb->data_offset = 0;
+    lcmb->data_size = fbuf->data_size;
+    lcmb->recv_utime = fbuf->last_packet_utime;
+    lcmb->recv_time_ns = fbuf->last_packet_time_ns;
+    lcmb->recv_mono_ns = fbuf->last_packet_mono_ns;
+    LCM_TRACE(udpm_message_complete, lcmb->channel_name, fbuf->msg_seqno, (int) lcmb->data_size,
+              lcmb->recv_utime);
+
+    // don't need the fragment buffer anymore
+    lcm_frag_buf_store_remove(frag_bufs, fbuf);
+
+    return 1;
+}
+
+// A parity packet rebuilds a fragment that was lost from a message whose
+// other fragments are being reassembled.  Those of messages that were already
+// completed, or have none of their fragments in a buffer, are of no use.
+static int _recv_parity_locked(lcm_udpm_t *lcm, udpm_frag_shard_t *shard, lcm_buf_t *lcmb,
+                               uint32_t sz)
+{
+    lcm_frag_buf_store *frag_bufs = shard->frag_bufs;
+    lcm2_header_long_t *hdr = (lcm2_header_long_t *) lcmb->buf;
+    lcm2_header_parity_t *phdr = (lcm2_header_parity_t *) (hdr + 1);
+    if (sz < sizeof(lcm2_header_long_t) + sizeof(lcm2_header_parity_t)) {
+        lcm_stat_add(&lcm->stats.packets_bad, 1);
+        return 0;
+    }
+
+    const char *channel = (const char *) (phdr + 1);
+    int channel_sz = strlen(channel);
+    uint32_t header_size = sizeof(lcm2_header_long_t) + sizeof(lcm2_header_parity_t) +
+                           channel_sz + 1;
+    if (channel_sz > LCM_MAX_CHANNEL_NAME_LENGTH || sz < header_size) {
+        dbg(DBG_LCM, "bad channel name length\n");
+        lcm_stat_add(&lcm->stats.packets_bad, 1);
+        return 0;
+    }
+
+    lcm_frag_key_t key;
+    key.from = (struct sockaddr_in *) &(lcmb->from);
+    key.msg_seqno = ntohl(hdr->msg_seqno);
+    lcm_frag_buf_t *fbuf = lcm_frag_buf_store_lookup(frag_bufs, &key);
+    if (!fbuf || fbuf->data_size != ntohl(hdr->msg_size) ||
+        fbuf->fragments_in_msg != ntohs(hdr->fragments_in_msg))
+        return 0;
+
+    int status = lcm_frag_buf_recover(fbuf, ntohl(phdr->fragment_size), channel_sz,
+                                      ntohs(hdr->fragment_no), ntohs(phdr->group_size),
+                                      (const char *) lcmb->buf + header_size, sz - header_size);
+    if (status < 0) {
+        dbg(DBG_LCM, "dropping parity packet that does not match its message\n");
+        lcm_stat_add(&lcm->stats.packets_bad, 1);
+        return 0;
+    }
+    if (status == 0)
+        return 0;
+
+    dbg(DBG_LCM, "recovered a lost fragment of [%s] from parity\n", channel);
+    lcm_stat_add(&lcm->stats.fragments_recovered, 1);
+    // the rebuilt fragment may have been the first one
+    memcpy(fbuf->channel, channel, channel_sz + 1);
+    fbuf->last_packet_utime = lcmb->recv_utime;
+    fbuf->last_packet_time_ns = lcmb->recv_time_ns;
+    fbuf->last_packet_mono_ns = lcmb->recv_mono_ns;
+
+    if (0 == fbuf->fragments_remaining) {
+        uint16_t flags = ntohs(phdr->flags);
+        uint32_t magic = LCM2_MAGIC_LONG;
+        if (flags & LCM2_PARITY_LZ4)
+            magic = LCM2_MAGIC_LONG_LZ4;
+        else if (flags & LCM2_PARITY_DELTA)
+            magic = LCM2_MAGIC_LONG_DELTA;
+        return _recv_message_complete(lcm, shard, fbuf, lcmb, magic);
+    }
+    return 0;
+}
+
+static int _recv_message_fragment_locked(lcm_udpm_t *lcm, udpm_frag_shard_t *shard,
+                                         lcm_buf_t *lcmb, uint32_t sz)
+{
+    lcm2_header_long_t *hdr = (lcm2_header_long_t *) lcmb->buf;
+    if (ntohl(hdr->magic) == LCM2_MAGIC_PARITY)
+        return _recv_parity_locked(lcm, shard, lcmb, sz);
+    lcm_frag_buf_store *frag_bufs = shard->frag_bufs;
+
+    uint32_t msg_seqno = ntohl(hdr->msg_seqno);
+    uint32_t data_size = ntohl(hdr->msg_size);
+    uint32_t fragment_offset = ntohl(hdr->fragment_offset);
+    uint16_t fragment_no = ntohs(hdr->fragment_no);
+    uint16_t fragments_in_msg = ntohs(hdr->fragments_in_msg);
+    uint32_t frag_size = sz - sizeof(lcm2_header_long_t);
+    char *data_start = (char *) (hdr + 1);
+
+    // any existing fragment buffer for this message source?
+    lcm_frag_key_t key;
+    key.from = (struct sockaddr_in *) &(lcmb->from);
+    key.msg_seqno = msg_seqno;
+    lcm_frag_buf_t *fbuf = lcm_frag_buf_store_lookup(frag_bufs, &key);
+
+    // discard any stale fragments from previous messages
+    if (fbuf && (fbuf->data_size != data_size || fbuf->fragments_in_msg != fragments_in_msg)) {
+        dbg(DBG_LCM, "Dropping message (missing %d fragments)\n", fbuf->fragments_remaining);
+        lcm_frag_buf_store_remove(frag_bufs, fbuf);
+        lcm_stat_add(&lcm->stats.messages_incomplete, 1);
+        fbuf = NULL;
+    }
+
+    //    printf ("fragment %d/%d (offset %d/%d) seq %d packet sz: %d %p\n",
+    //        ntohs(hdr->fragment_no) + 1, fragments_in_msg,
+    //        fragment_offset, data_size, msg_seqno, sz, fbuf);
+
+    // remaining fragments of a message that nobody here subscribes to
+    if (!fbuf && lcm_frag_buf_store_is_ignored(frag_bufs, &key)) {
+        return 0;
+    }
+
+    if (data_size > LCM_MAX_MESSAGE_SIZE) {
+        dbg(DBG_LCM, "rejecting huge message (%d bytes)\n", data_size);
+        return 0;
+    }
+
+    // if this is the first packet, set some values
+    char *channel = NULL;
+    int channel_sz = 0;
+    if (fragment_no == 0) {
+        channel = (char *) (hdr + 1);
+        channel_sz = strlen(channel);
+        if (channel_sz > LCM_MAX_CHANNEL_NAME_LENGTH) {
+            dbg(DBG_LCM, "bad channel name length\n");
+            lcm_stat_add(&lcm->stats.packets_bad, 1);
+            return 0;
+        }
+        data_start += channel_sz + 1;
+        frag_size -= (channel_sz + 1);
+
+        // Skip reassembly of messages that nobody here subscribes to.  Any
+        // fragments that arrived before this one were buffered like any
+        // other partial message, and are bounded by the store's limits.
+        if (!udpm_has_handlers(lcm, channel)) {
+            dbg(DBG_LCM, "ignoring fragmented message on %s\n", channel);
+            if (fbuf) {
+                lcm_frag_buf_store_remove(frag_bufs, fbuf);
+            }
+            lcm_frag_buf_store_ignore(frag_bufs, &key);
+            return 0;
+        }
+    }
+
+    if (!fbuf) {
+        fbuf = lcm_frag_buf_new(lcm->frag_pool, *((struct sockaddr_in *) &lcmb->from), msg_seqno,
+                                data_size, fragments_in_msg, lcmb->recv_utime);
+        lcm_stat_add(&lcm->stats.frag_bufs_evicted, lcm_frag_buf_store_add(frag_bufs, fbuf));
+    }
+
+    if (channel != NULL) {
+        memcpy(fbuf->channel, channel, channel_sz + 1);
+    }
+
+#ifdef __linux__
+    if (lcm->kernel_rbuf_sz < 262145 && data_size > lcm->kernel_rbuf_sz &&
+        !lcm->warned_about_small_kernel_buf) {
+        fprintf(stderr,
+                "==== LCM Warning ===\n"
+                "LCM detected that large packets are being received, but the kernel UDP\n"
+                "receive buffer is very small.  The possibility of dropping packets due to\n"
+                "insufficient buffer space is very high.\n"
+                "\n"
+                "For more information, visit:\n"
                 "   https://lcm-proj.github.io/lcm/content/multicast-setup.html\n\n");
         lcm->warned_about_small_kernel_buf = 1;
     }
@@ -305,49 +1733,100 @@ static int _recv_message_fragment(lcm_udpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz)
     if (fragment_offset + frag_size > fbuf->data_size) {
         dbg(DBG_LCM, "dropping invalid fragment (off: %d, %d / %d)\n", fragment_offset, frag_size,
             fbuf->data_size);
-        lcm_frag_buf_store_remove(lcm->frag_bufs, fbuf);
+        lcm_frag_buf_store_remove(frag_bufs, fbuf);
+        return 0;
+    }
+
+    // drop duplicated fragments without copying them again
+    int is_new_fragment = lcm_frag_buf_mark_received(fbuf, fragment_no);
+    if (is_new_fragment < 0) {
+        dbg(DBG_LCM, "dropping invalid fragment (%d / %d)\n", fragment_no, fragments_in_msg);
+        lcm_frag_buf_store_remove(frag_bufs, fbuf);
+        return 0;
+    }
+    if (!is_new_fragment) {
+        dbg(DBG_LCM, "dropping duplicate fragment %d\n", fragment_no);
         return 0;
     }
 
     // copy data
     memcpy(fbuf->data + fragment_offset, data_start, frag_size);
     fbuf->last_packet_utime = lcmb->recv_utime;
+    fbuf->last_packet_time_ns = lcmb->recv_time_ns;
+    fbuf->last_packet_mono_ns = lcmb->recv_mono_ns;
+    fbuf->nacks_sent = 0;
 
     fbuf->fragments_remaining--;
 
-    if (0 == fbuf->fragments_remaining) {
-        // complete message received.  Is there a subscriber that still
-        // wants it?  (i.e., does any subscriber have space in its queue?)
-        if (!lcm_try_enqueue_message(lcm->lcm, fbuf->channel)) {
-            // no... sad... free the fragment buffer and return
-            lcm_frag_buf_store_remove(lcm->frag_bufs, fbuf);
-            return 0;
-        }
-
-        // yes, transfer the message into the lcm_buf_t
-
-        // deallocate the ringbuffer-allocated buffer
-        g_rec_mutex_lock(&lcm->mutex);
-        lcm_buf_free_data(lcmb, lcm->ringbuf);
-        g_rec_mutex_unlock(&lcm->mutex);
+    if (0 == fbuf->fragments_remaining)
+        return _recv_message_complete(lcm, shard, fbuf, lcmb, ntohl(hdr->magic));
 
-        // transfer ownership of the message's payload buffer
-        lcmb->buf = fbuf->data;
-        fbuf->data = NULL;
+    return 0;
+}
 
-        strcpy(lcmb->channel_name, fbuf->channel);
-        lcmb->channel_size = strlen(lcmb->channel_name);
-        lcmb->data_offset = 0;
-        lcmb->data_size = fbuf->data_size;
-        lcmb->recv_utime = fbuf->last_packet_utime;
+// whether lcmb holds the loopback copy of a datagram sent by this instance,
+// whose message was already delivered with local_delivery=1
+static int udpm_is_own_datagram(lcm_udpm_t *lcm, const lcm_buf_t *lcmb)
+{
+    const struct sockaddr_in *from = (const struct sockaddr_in *) &lcmb->from;
+    if (!lcm->params.local_delivery || from->sin_port != lcm->send_addr.sin_port)
+        return 0;
+    // with ifaces, sent from the address of any of them
+    for (int i = 0; i < lcm->params.num_ifaces; i++) {
+        if (from->sin_addr.s_addr == lcm->params.ifaces[i].addr.s_addr)
+            return 1;
+    }
+    return from->sin_addr.s_addr == lcm->send_addr.sin_addr.s_addr;
+}
 
-        // don't need the fragment buffer anymore
-        lcm_frag_buf_store_remove(lcm->frag_bufs, fbuf);
+static int _recv_message_fragment(lcm_udpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz)
+{
+    lcmb->num_bundled = 0;
+    if (udpm_is_own_datagram(lcm, lcmb))
+        return 0;
+    udpm_frag_shard_t *shard = _frag_shard_for(lcm, (struct sockaddr_in *) &lcmb->from);
+    g_mutex_lock(&shard->lock);
+    int status = _recv_message_fragment_locked(lcm, shard, lcmb, sz);
+    g_mutex_unlock(&shard->lock);
+    return status;
+}
 
-        return 1;
+// counts the sequence numbers that the sender of a datagram skipped, repeated,
+// or sent out of order
+static void udpm_track_seqno(lcm_udpm_t *lcm, lcm_buf_t *lcmb, uint32_t magic)
+{
+    if (magic != LCM2_MAGIC_SHORT && magic != LCM2_MAGIC_BUNDLE && magic != LCM2_MAGIC_LONG &&
+        magic != LCM2_MAGIC_LONG_LZ4 && magic != LCM2_MAGIC_LONG_DELTA &&
+        magic != LCM2_MAGIC_PARITY)
+        return;
+    const struct sockaddr_in *from = (const struct sockaddr_in *) &lcmb->from;
+    uint32_t msg_seqno = ntohl(((lcm2_header_short_t *) lcmb->buf)->msg_seqno);
+    gint64 key = (gint64) ntohl(from->sin_addr.s_addr) << 16 | ntohs(from->sin_port);
+    udpm_frag_shard_t *shard = _frag_shard_for(lcm, from);
+    g_mutex_lock(&shard->lock);
+    udpm_sender_t *sender = (udpm_sender_t *) g_hash_table_lookup(shard->senders, &key);
+    if (sender) {
+        lcm_seqno_track(&sender->seqno, msg_seqno,
+                        magic != LCM2_MAGIC_SHORT && magic != LCM2_MAGIC_BUNDLE, &lcm->stats);
+    } else {
+        // senders that come and go, with a new port each time, are forgotten
+        if (g_hash_table_size(shard->senders) >= UDPM_MAX_SENDERS)
+            g_hash_table_remove_all(shard->senders);
+        sender = (udpm_sender_t *) malloc(sizeof(udpm_sender_t));
+        sender->key = key;
+        lcm_seqno_init(&sender->seqno, msg_seqno);
+        g_hash_table_insert(shard->senders, &sender->key, sender);
     }
+    g_mutex_unlock(&shard->lock);
+}
 
-    return 0;
+// tells the thread of self_test=async that its message came back
+static void udpm_self_test_received(lcm_udpm_t *lcm)
+{
+    g_mutex_lock(&lcm->self_test_lock);
+    lcm->self_test_passed = 1;
+    g_cond_signal(&lcm->self_test_cond);
+    g_mutex_unlock(&lcm->self_test_lock);
 }
 
 static int _recv_short_message(lcm_udpm_t *lcm, lcm_buf_t *lcmb, int sz)
@@ -362,80 +1841,524 @@ static int _recv_short_message(lcm_udpm_t *lcm, lcm_buf_t *lcmb, int sz)
 
     if (lcmb->channel_size > LCM_MAX_CHANNEL_NAME_LENGTH) {
         dbg(DBG_LCM, "bad channel name length\n");
-        lcm->udp_discarded_bad++;
+        lcm_stat_add(&lcm->stats.packets_bad, 1);
         return 0;
     }
 
-    lcm->udp_rx++;
+    // the self test message is the only one sent here that has to come back
+    // through the network
+    if (udpm_is_own_datagram(lcm, lcmb) && strcmp(pkt_channel_str, SELF_TEST_CHANNEL))
+        return 0;
+
+    if (lcm->params.self_test == UDPM_SELF_TEST_ASYNC &&
+        !strcmp(pkt_channel_str, SELF_TEST_CHANNEL)) {
+        udpm_self_test_received(lcm);
+        return 0;
+    }
 
     // if the packet has no subscribers, drop the message now.
-    if (!lcm_try_enqueue_message(lcm->lcm, pkt_channel_str))
+    if (!udpm_try_enqueue(lcm, lcmb, pkt_channel_str, &lcmb->priority))
         return 0;
 
-    strcpy(lcmb->channel_name, pkt_channel_str);
+    lcm_buf_set_channel(lcmb, pkt_channel_str, lcmb->channel_size);
 
     lcmb->data_offset = sizeof(lcm2_header_short_t) + lcmb->channel_size + 1;
 
     lcmb->data_size = sz - lcmb->data_offset;
+    lcmb->num_bundled = 0;
+    LCM_TRACE(udpm_message_complete, lcmb->channel_name, ntohl(hdr2->msg_seqno),
+              (int) lcmb->data_size, lcmb->recv_utime);
     return 1;
 }
 
-// read continuously until a complete message arrives
-static lcm_buf_t *udp_read_packet(lcm_udpm_t *lcm)
+// Parses the message of a bundle packet that starts at p.  Stores its payload
+// in data and data_size, and returns the start of the next message, or NULL
+// if the message is cut off or its channel name is too long.
+static char *_bundle_next(char *p, char *end, char **data, uint32_t *data_size)
 {
-    lcm_buf_t *lcmb = NULL;
+    char *nul = (char *) memchr(p, 0, MIN(end - p, LCM_MAX_CHANNEL_NAME_LENGTH + 1));
+    if (!nul || end - nul < LCM2_BUNDLE_ENTRY_OVERHEAD)
+        return NULL;
+    memcpy(data_size, nul + 1, sizeof(*data_size));
+    *data_size = ntohl(*data_size) & ~UDPM_BUNDLE_SKIPPED;
+    *data = nul + LCM2_BUNDLE_ENTRY_OVERHEAD;
+    if (*data_size > (uint32_t) (end - *data))
+        return NULL;
+    return *data + *data_size;
+}
 
-    int sz = 0;
+// Messages of a bundle packet that nobody here keeps are marked by the top
+// bit of their size, which is never set in a valid packet.
+static void _bundle_skip(char *data)
+{
+    ((uint8_t *) data)[-(int) sizeof(uint32_t)] |= UDPM_BUNDLE_SKIPPED >> 24;
+}
 
-    // TODO warn about message loss somewhere else.
+static int _bundle_is_skipped(const char *data)
+{
+    return ((const uint8_t *) data)[-(int) sizeof(uint32_t)] & (UDPM_BUNDLE_SKIPPED >> 24);
+}
 
-    /*
-    g_rec_mutex_lock(&lcm->mutex);
-    unsigned int ring_capacity = lcm_ringbuf_capacity(lcm->ringbuf);
-    unsigned int ring_used = lcm_ringbuf_used(lcm->ringbuf);
-    double buf_avail = ((double) (ring_capacity - ring_used)) / ring_capacity;
-    g_rec_mutex_unlock(&lcm->mutex);
-    if (buf_avail < lcm->udp_low_watermark)
-        lcm->udp_low_watermark = buf_avail;
-
-    GTimeVal tv;
-    g_get_current_time(&tv);
-    int elapsedsecs = tv.tv_sec - lcm->udp_last_report_secs;
-    if (elapsedsecs > 2) {
-        uint32_t total_bad = lcm->udp_discarded_bad;
-        if (total_bad > 0 || lcm->udp_low_watermark < 0.5) {
-            fprintf(stderr,
-                    "%d.%03d LCM loss %4.1f%% : %5d err, "
-                    "buf avail %4.1f%%\n",
-                    (int) tv.tv_sec, (int) tv.tv_usec / 1000,
-                    total_bad * 100.0 / (lcm->udp_rx + total_bad), lcm->udp_discarded_bad,
-                    100.0 * lcm->udp_low_watermark);
-            lcm->udp_rx = 0;
-            lcm->udp_discarded_bad = 0;
-            lcm->udp_last_report_secs = tv.tv_sec;
-            lcm->udp_low_watermark = HUGE;
-        }
-    }
-    */
-
-    int got_complete_message = 0;
-
-    while (!got_complete_message) {
-        // wait for either incoming UDP data, or for an abort message
-        fd_set fds;
-        FD_ZERO(&fds);
-        FD_SET(lcm->recvfd, &fds);
-        FD_SET(lcm->thread_msg_pipe[0], &fds);
-        SOCKET maxfd = MAX(lcm->recvfd, lcm->thread_msg_pipe[0]);
-
-        if (select(maxfd + 1, &fds, NULL, NULL, NULL) <= 0) {
-            perror("udp_read_packet -- select:");
+// Checks the messages of a bundle packet, and counts each of them against
+// the queue limits of its subscriptions.  Every message that nobody here
+// keeps is marked, so that udpm_dispatch() skips it.
+// Returns 1 if any message is kept, and 0 otherwise.
+static int _recv_bundle(lcm_udpm_t *lcm, lcm_buf_t *lcmb, int sz)
+{
+    if (udpm_is_own_datagram(lcm, lcmb))
+        return 0;
+
+    char *start = lcmb->buf + sizeof(lcm2_header_short_t);
+    char *end = lcmb->buf + sz;
+    char *data;
+    uint32_t data_size;
+
+    // don't count any message against the queue limits unless all of them
+    // are intact
+    int num_msgs = 0;
+    char *p;
+    for (p = start; p < end; num_msgs++) {
+        p = _bundle_next(p, end, &data, &data_size);
+        if (!p || _bundle_is_skipped(data)) {
+            dbg(DBG_LCM, "bad bundle packet\n");
+            lcm_stat_add(&lcm->stats.packets_bad, 1);
+            return 0;
+        }
+    }
+
+
+    // the packet is dispatched in the class of its most urgent message
+    int num_kept = 0;
+    lcmb->priority = 0;
+    for (p = start; p < end;) {
+        char *next = _bundle_next(p, end, &data, &data_size);
+        int priority;
+        if (udpm_try_enqueue(lcm, lcmb, p, &priority)) {
+            num_kept++;
+            lcmb->priority = MAX(lcmb->priority, priority);
+        } else {
+            _bundle_skip(data);
+        }
+        p = next;
+    }
+
+    lcmb->data_offset = sizeof(lcm2_header_short_t);
+    lcmb->data_size = sz - lcmb->data_offset;
+    lcmb->num_bundled = num_msgs;
+    return num_kept > 0;
+}
+
+// With recv_buf_max, doubles the kernel receive buffer, up to recv_buf_max,
+// unless it was grown less than UDPM_RECV_BUF_GROW_INTERVAL ago, or another
+// thread is growing it.  Gives up once the kernel no longer grants more.
+static void udpm_grow_recv_buf(lcm_udpm_t *lcm)
+{
+    if (!lcm->params.recv_buf_max || !g_mutex_trylock(&lcm->rbuf_lock))
+        return;
+    int64_t now = g_get_monotonic_time();
+    int size = (int) MIN((int64_t) lcm->rbuf_requested * 2, (int64_t) lcm->params.recv_buf_max);
+    if (size <= lcm->rbuf_requested || now - lcm->rbuf_grow_utime < UDPM_RECV_BUF_GROW_INTERVAL) {
+        g_mutex_unlock(&lcm->rbuf_lock);
+        return;
+    }
+    lcm->rbuf_grow_utime = now;
+    lcm->rbuf_requested = size;
+
+    int status = -1;
+#ifdef SO_RCVBUFFORCE
+    status = setsockopt(lcm->recvfd, SOL_SOCKET, SO_RCVBUFFORCE, (char *) &size, sizeof(size));
+#endif
+    if (status < 0)
+        setsockopt(lcm->recvfd, SOL_SOCKET, SO_RCVBUF, (char *) &size, sizeof(size));
+    int kernel_size = 0;
+    unsigned int retsize = sizeof(int);
+    getsockopt(lcm->recvfd, SOL_SOCKET, SO_RCVBUF, (char *) &kernel_size, (socklen_t *) &retsize);
+    dbg(DBG_LCM, "LCM: grew receive buffer to %d bytes, of %d requested\n", kernel_size, size);
+    if (kernel_size <= lcm->kernel_rbuf_sz) {
+        // capped by net.core.rmem_max
+        lcm->rbuf_requested = lcm->params.recv_buf_max;
+    }
+    lcm->kernel_rbuf_sz = MAX(lcm->kernel_rbuf_sz, kernel_size);
+    lcm_stat_max(&lcm->stats.recv_buf_size, (uint64_t) lcm->kernel_rbuf_sz);
+    g_mutex_unlock(&lcm->rbuf_lock);
+}
+
+#ifdef SO_TIMESTAMP
+// datagrams received between samples of mono_offset_ns
+#define UDPM_MONO_OFFSET_INTERVAL 1024
+
+static void udpm_sample_mono_offset(lcm_udpm_t *lcm)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    int64_t offset = (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec - lcm_monotonic_ns();
+    __atomic_store_n(&lcm->mono_offset_ns, offset, __ATOMIC_RELAXED);
+}
+
+// Turns a kernel timestamp on the system clock into one on the monotonic
+// clock, for mono_clock=kernel.  The offset between the clocks is sampled
+// again every UDPM_MONO_OFFSET_INTERVAL datagrams or so, to follow changes of
+// the system clock.
+static int64_t udpm_kernel_to_mono_ns(lcm_udpm_t *lcm, int64_t kernel_ns)
+{
+    if (lcm_stat_get(&lcm->stats.packets_received) % UDPM_MONO_OFFSET_INTERVAL == 0)
+        udpm_sample_mono_offset(lcm);
+    return kernel_ns - __atomic_load_n(&lcm->mono_offset_ns, __ATOMIC_RELAXED);
+}
+#endif
+
+// counts a datagram of sz bytes that was read from the socket, and stores
+// its receive timestamps in lcmb, using the timestamps that the kernel
+// attached to it if available, or the current time otherwise
+static void _recv_control(lcm_udpm_t *lcm, lcm_buf_t *lcmb, struct msghdr *msg, int sz)
+{
+    lcm_stat_add(&lcm->stats.packets_received, 1);
+    lcm_stat_add(&lcm->stats.bytes_received, sz);
+    lcmb->recv_utime = 0;
+    lcmb->recv_mono_ns = 0;
+#ifdef SO_TIMESTAMP
+    int64_t kernel_ns = 0;  // the kernel's timestamp on the system clock
+    struct cmsghdr *cmsg;
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET)
+            continue;
+#ifdef SO_RXQ_OVFL
+        // the number of datagrams the kernel has dropped on this socket so far
+        if (cmsg->cmsg_type == SO_RXQ_OVFL) {
+            uint32_t drops;
+            memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+            lcm_stat_max(&lcm->stats.kernel_drops, drops);
+            if (lcm->params.recv_buf_max && drops > (uint32_t) g_atomic_int_get(&lcm->rbuf_drops)) {
+                g_atomic_int_set(&lcm->rbuf_drops, (int) drops);
+                udpm_grow_recv_buf(lcm);
+            }
             continue;
         }
+#endif
+        if (lcmb->recv_utime)
+            continue;
+        if (cmsg->cmsg_type == SCM_TIMESTAMP) {
+            struct timeval *t = (struct timeval *) CMSG_DATA(cmsg);
+            lcmb->recv_utime = (int64_t) t->tv_sec * 1000000 + t->tv_usec;
+            lcmb->recv_time_ns = lcmb->recv_utime * 1000;
+            kernel_ns = lcmb->recv_time_ns;
+        }
+#ifdef USE_TIMESTAMPING
+        if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec *t = (struct timespec *) CMSG_DATA(cmsg);
+            lcmb->recv_time_ns = (int64_t) t->tv_sec * 1000000000 + t->tv_nsec;
+            lcmb->recv_utime = lcmb->recv_time_ns / 1000;
+            kernel_ns = lcmb->recv_time_ns;
+        }
+        if (cmsg->cmsg_type == SCM_TIMESTAMPING) {
+            // ts[0] is the software timestamp and ts[2] the raw hardware
+            // one.  recv_utime stays on the system clock either way.
+            struct scm_timestamping *t = (struct scm_timestamping *) CMSG_DATA(cmsg);
+            lcmb->recv_utime = (int64_t) t->ts[0].tv_sec * 1000000 + t->ts[0].tv_nsec / 1000;
+            if (t->ts[2].tv_sec || t->ts[2].tv_nsec)
+                lcmb->recv_time_ns = (int64_t) t->ts[2].tv_sec * 1000000000 + t->ts[2].tv_nsec;
+            else
+                lcmb->recv_time_ns = (int64_t) t->ts[0].tv_sec * 1000000000 + t->ts[0].tv_nsec;
+            kernel_ns = (int64_t) t->ts[0].tv_sec * 1000000000 + t->ts[0].tv_nsec;
+        }
+#endif
+    }
+    if (kernel_ns && lcm->params.mono_clock == UDPM_MONO_CLOCK_KERNEL)
+        lcmb->recv_mono_ns = udpm_kernel_to_mono_ns(lcm, kernel_ns);
+#endif
+    if (!lcmb->recv_utime) {
+        lcmb->recv_utime = g_get_real_time();
+        lcmb->recv_time_ns = lcmb->recv_utime * 1000;
+    }
+    if (!lcmb->recv_mono_ns)
+        lcmb->recv_mono_ns = lcm_monotonic_ns();
+}
+
+// wait for either incoming UDP data, or for an abort message.  Returns 1 if
+// there is data to read, 0 if there is not, and -1 if the read thread was
+// told to exit.
+static int udp_wait_for_data(udpm_recv_thread_t *rt)
+{
+    lcm_udpm_t *lcm = rt->lcm;
+    void *ready[2];
+    int nready = lcm_poller_wait(rt->poller, ready, 2);
+    if (nready < 0) {
+        perror("udp_wait_for_data -- lcm_poller_wait");
+        return 0;
+    }
 
-        if (FD_ISSET(lcm->thread_msg_pipe[0], &fds)) {
+    int i;
+    for (i = 0; i < nready; i++) {
+        if (ready[i] == lcm->thread_msg_pipe) {
             // received an exit command.
             dbg(DBG_LCM, "read thread received exit command\n");
+            return -1;
+        }
+    }
+    return nready > 0;
+}
+
+// wait up to timeout_ms for an exit command.  Returns -1 if the read thread
+// was told to exit, 0 otherwise.
+static int udp_wait_for_exit(lcm_udpm_t *lcm, int timeout_ms)
+{
+    fd_set readfds;
+    FD_ZERO(&readfds);
+    FD_SET(lcm->thread_msg_pipe[0], &readfds);
+
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+    int status = select(lcm->thread_msg_pipe[0] + 1, &readfds, NULL, NULL, &tv);
+    if (status > 0 && FD_ISSET(lcm->thread_msg_pipe[0], &readfds)) {
+        dbg(DBG_LCM, "read thread received exit command\n");
+        return -1;
+    }
+    return 0;
+}
+
+// take back the buffers that lcm_handle() has finished dispatching, so that
+// their ringbuffer space can be reused.
+static void udp_reclaim_handled(udpm_recv_thread_t *rt)
+{
+    lcm_buf_t *lcmb;
+    while ((lcmb = lcm_buf_ring_pop(rt->inbufs_done))) {
+        lcm_buf_free_data(lcmb, rt->ringbuf);
+        lcm_buf_enqueue(rt->inbufs_empty, lcmb);
+    }
+    lcm_buf_returns_take(&rt->returns, rt->inbufs_empty, rt->ringbuf);
+}
+
+// Takes a ringbuffer slot for the next datagram.  If the ringbuffer is full
+// and may not grow, this waits for lcm_handle() to release some of it, while
+// the kernel buffers or drops the incoming datagrams.  Returns NULL if the
+// read thread was told to exit in the meantime.
+static lcm_buf_t *udp_allocate_buf(udpm_recv_thread_t *rt)
+{
+    lcm_udpm_t *lcm = rt->lcm;
+    lcm_buf_t *lcmb;
+    udp_reclaim_handled(rt);
+    while (!(lcmb = lcm_buf_allocate_data(rt->inbufs_empty, &rt->ringbuf, lcm->ringbuf_max))) {
+        // the kernel holds on to the datagrams in the meantime
+        udpm_grow_recv_buf(lcm);
+        if (udp_wait_for_exit(lcm, 1) < 0)
+            return NULL;
+        udp_reclaim_handled(rt);
+    }
+    return lcmb;
+}
+
+// Queue a complete message for retrieval by lcm_handle().  The message has
+// already been counted against its subscriptions' queue limits, so if the
+// queue is full this waits for lcm_handle() to make room instead of dropping
+// it.  Returns -1 if the read thread was told to exit in the meantime, in
+// which case the caller still owns lcmb.
+static int udp_share_message(udpm_recv_thread_t *rt, lcm_buf_t *lcmb);
+
+static int udp_queue_message(udpm_recv_thread_t *rt, lcm_buf_t *lcmb)
+{
+    lcm_udpm_t *lcm = rt->lcm;
+    int status;
+    if (lcm->fanout)
+        return udp_share_message(rt, lcmb);
+    // lcmb belongs to lcm_handle() once it's queued
+    LCM_TRACE(udpm_enqueue, lcmb->num_bundled ? "" : lcmb->channel_name, (int) lcmb->data_size,
+              lcmb->priority, lcmb->num_bundled);
+    while ((status = lcm_buf_ring_push(rt->inbufs_filled[lcmb->priority], lcmb)) < 0) {
+        udp_reclaim_handled(rt);
+        if (udp_wait_for_exit(lcm, 1) < 0)
+            return -1;
+    }
+    if (rt->ringbuf) {
+        lcm_stat_max(&lcm->stats.ringbuf_high_water, lcm_ringbuf_used(rt->ringbuf));
+        lcm_stat_max(&lcm->stats.ringbuf_capacity, lcm_ringbuf_capacity(rt->ringbuf));
+    }
+
+    /* Only notify lcm_handle() when a queue transitions from empty to
+     * non-empty.  Otherwise it is either busy, or will find this message
+     * when it checks the queues again after dequeueing the previous one. */
+    if (status > 0)
+        udpm_notify(lcm);
+    return 0;
+}
+
+// With the align option, moves the payload of the short message in lcmb to
+// an aligned address within its ringbuffer slot.  Fragmented messages are
+// aligned by the pool that their buffers come from, and the messages of
+// bundles are left where they are.
+static void udp_align_message(lcm_udpm_t *lcm, lcm_buf_t *lcmb)
+{
+    if (lcm->params.align > 1 && lcmb->ringbuf && !lcmb->num_bundled)
+        lcm_buf_align_data(lcmb, lcm->params.align);
+}
+
+// Like udp_queue_message(), for the hub of a udpm_shared_t: queues lcmb for
+// each member in its share_mask that still receives, in the queues of the
+// members that mirror rt.  lcmb goes back to rt once all of them have
+// dispatched it, or right away if none of them is left.
+static int udp_share_message(udpm_recv_thread_t *rt, lcm_buf_t *lcmb)
+{
+    lcm_udpm_t *lcm = rt->lcm;
+    udpm_shared_t *shared = lcm->fanout;
+    int index = rt - lcm->recv_threads;
+    uint64_t pending = lcmb->share_mask;
+    lcmb->share_mask = 0;
+    LCM_TRACE(udpm_enqueue, lcmb->num_bundled ? "" : lcmb->channel_name, (int) lcmb->data_size,
+              lcmb->priority, lcmb->num_bundled);
+
+    // a reference of its own, so that no member can hand it back before it
+    // has been queued for all of them
+    lcmb->refcount = 1;
+    lcmb->returns = &rt->returns;
+    int exiting = 0;
+    g_mutex_lock(&shared->lock);
+    while (pending && !exiting) {
+        int slot = 0;
+        while (!(pending & ((uint64_t) 1 << slot)))
+            slot++;
+        lcm_udpm_t *member = shared->members[slot];
+        if (!member) {
+            pending &= ~((uint64_t) 1 << slot);
+            continue;
+        }
+        g_atomic_int_inc(&lcmb->refcount);
+        int status = lcm_buf_ring_push(member->recv_threads[index].inbufs_filled[lcmb->priority],
+                                       lcmb);
+        if (status >= 0) {
+            if (status > 0)
+                udpm_notify(member);
+            pending &= ~((uint64_t) 1 << slot);
+            continue;
+        }
+        // the queue is full.  Wait for the member without holding the lock,
+        // since it takes it to stop receiving.
+        g_atomic_int_add(&lcmb->refcount, -1);
+        g_mutex_unlock(&shared->lock);
+        udp_reclaim_handled(rt);
+        exiting = udp_wait_for_exit(lcm, 1) < 0;
+        g_mutex_lock(&shared->lock);
+    }
+    g_mutex_unlock(&shared->lock);
+    if (rt->ringbuf) {
+        lcm_stat_max(&lcm->stats.ringbuf_high_water, lcm_ringbuf_used(rt->ringbuf));
+        lcm_stat_max(&lcm->stats.ringbuf_capacity, lcm_ringbuf_capacity(rt->ringbuf));
+    }
+
+    if (!lcm_buf_lend_end(lcmb))
+        return 0;
+    // none of them has it, so it's still the caller's
+    lcmb->returns = NULL;
+    if (exiting)
+        return -1;
+    lcm_buf_free_data(lcmb, rt->ringbuf);
+    lcm_buf_enqueue(rt->inbufs_empty, lcmb);
+    return 0;
+}
+
+// Handles a datagram of sz bytes that was read into the ringbuffer slot of
+// lcmb.  Returns 1 if it completed a message, and 0 if it did not, in which
+// case the slot can be used for the next datagram.
+static int udp_process_datagram(udpm_recv_thread_t *rt, lcm_buf_t *lcmb, int sz)
+{
+    lcm_udpm_t *lcm = rt->lcm;
+    char *pktbuf = lcmb->buf;
+
+    if (sz < sizeof(lcm2_header_short_t)) {
+        // packet too short to be LCM
+        lcm_stat_add(&lcm->stats.packets_bad, 1);
+        return 0;
+    }
+    LCM_TRACE(udpm_recv_datagram, sz, ntohl(((lcm2_header_short_t *) lcmb->buf)->msg_seqno),
+              lcmb->recv_utime);
+
+    int got_complete_message;
+    lcm2_header_short_t *hdr2 = (lcm2_header_short_t *) lcmb->buf;
+    uint32_t rcvd_magic = ntohl(hdr2->magic);
+    udpm_track_seqno(lcm, lcmb, rcvd_magic);
+    if (rcvd_magic == LCM2_MAGIC_SHORT)
+        got_complete_message = _recv_short_message(lcm, lcmb, sz);
+    else if (rcvd_magic == LCM2_MAGIC_BUNDLE)
+        got_complete_message = _recv_bundle(lcm, lcmb, sz);
+    else if (rcvd_magic == LCM2_MAGIC_LONG || rcvd_magic == LCM2_MAGIC_LONG_LZ4 ||
+             rcvd_magic == LCM2_MAGIC_LONG_DELTA || rcvd_magic == LCM2_MAGIC_PARITY)
+        got_complete_message = _recv_message_fragment(lcm, lcmb, sz);
+    else {
+        dbg(DBG_LCM, "LCM: bad magic\n");
+        lcm_stat_add(&lcm->stats.packets_bad, 1);
+        return 0;
+    }
+    if (!got_complete_message)
+        return 0;
+
+    // if the newly received packet is a short packet, then resize the space
+    // allocated to it on the ringbuffer to exactly match the amount of space
+    // required.  That way, we do not use 64k of the ringbuffer for every
+    // incoming message.  If it completed a fragmented message, then the
+    // packet buffer is no longer needed at all.
+    if (lcmb->ringbuf) {
+        udp_align_message(lcm, lcmb);
+        lcm_ringbuf_shrink_last(lcmb->ringbuf, lcmb->buf,
+                                MAX(sz, lcmb->data_offset + lcmb->data_size));
+    } else
+        lcm_ringbuf_dealloc(rt->ringbuf, pktbuf);
+    return 1;
+}
+
+// Reads one datagram into lcmb, which must hold a fresh ringbuffer slot.
+// Returns 1 if it completed a message, 0 if it did not, in which case the
+// slot can be used for the next datagram, and -1 if no datagram was waiting.
+static int udp_recv_datagram(udpm_recv_thread_t *rt, lcm_buf_t *lcmb)
+{
+    lcm_udpm_t *lcm = rt->lcm;
+
+    struct iovec vec;
+    vec.iov_base = lcmb->buf;
+    vec.iov_len = 65535;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(struct msghdr));
+    msg.msg_name = &lcmb->from;
+    msg.msg_namelen = sizeof(struct sockaddr);
+    msg.msg_iov = &vec;
+    msg.msg_iovlen = 1;
+#ifdef MSG_EXT_HDR
+    // operating systems that provide SO_TIMESTAMP allow us to obtain more
+    // accurate timestamps by having the kernel produce timestamps as soon
+    // as packets are received.
+    char controlbuf[RECV_CONTROLBUF_SIZE];
+    msg.msg_control = controlbuf;
+    msg.msg_controllen = sizeof(controlbuf);
+    msg.msg_flags = 0;
+#endif
+    int sz = recvmsg(lcm->recvfd, &msg, 0);
+
+    if (sz < 0) {
+        // with several read threads, another one may have taken the
+        // datagram first.
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return -1;
+        perror("udp_read_packet -- recvmsg");
+        lcm_stat_add(&lcm->stats.packets_bad, 1);
+        return 0;
+    }
+
+    _recv_control(lcm, lcmb, &msg, sz);
+    lcmb->fromlen = msg.msg_namelen;
+    return udp_process_datagram(rt, lcmb, sz);
+}
+
+// read continuously until a complete message arrives
+static lcm_buf_t *udp_read_packet(udpm_recv_thread_t *rt)
+{
+    lcm_buf_t *lcmb = NULL;
+
+    while (1) {
+        int status = udp_wait_for_data(rt);
+        if (status == 0)
+            continue;
+
+        if (status < 0) {
             if (lcmb) {
                 // lcmb is not on one of the memory managed buffer queues.  We could
                 // either put it back on one of the queues, or just free it here.  Do the
@@ -450,167 +2373,1554 @@ static lcm_buf_t *udp_read_packet(lcm_udpm_t *lcm)
         }
 
         // there is incoming UDP data ready.
-        assert(FD_ISSET(lcm->recvfd, &fds));
+        if (!lcmb && !(lcmb = udp_allocate_buf(rt)))
+            return NULL;
+        if (udp_recv_datagram(rt, lcmb) > 0)
+            return lcmb;
+    }
+}
 
-        if (!lcmb) {
-            g_rec_mutex_lock(&lcm->mutex);
-            lcmb = lcm_buf_allocate_data(lcm->inbufs_empty, &lcm->ringbuf);
-            g_rec_mutex_unlock(&lcm->mutex);
+#ifdef USE_RECVMMSG
+// Drains up to recv_batch datagrams from the socket with a single recvmmsg()
+// call and queues every complete message for lcm_handle().  The ringbuffer
+// slots for the whole batch are taken, and later compacted, in one go.
+// Returns -1 when the read thread should exit.
+static int udp_read_batch(udpm_recv_thread_t *rt)
+{
+    lcm_udpm_t *lcm = rt->lcm;
+    udpm_recv_batch_t *batch = rt->recv_batch;
+
+    int status = udp_wait_for_data(rt);
+    if (status <= 0)
+        return status;
+
+    udp_reclaim_handled(rt);
+    int nbufs;
+    while (!(nbufs = lcm_buf_allocate_data_batch(rt->inbufs_empty, &rt->ringbuf, lcm->ringbuf_max,
+                                                 batch->lcmbs, batch->depth))) {
+        if (udp_wait_for_exit(lcm, 1) < 0)
+            return -1;
+        udp_reclaim_handled(rt);
+    }
+    lcm_ringbuf_t *ringbuf = rt->ringbuf;
+
+    int i;
+    for (i = 0; i < nbufs; i++) {
+        lcm_buf_t *lcmb = batch->lcmbs[i];
+        batch->bufs[i] = lcmb->buf;
+        batch->lens[i] = 0;
+        batch->complete[i] = 0;
+
+        batch->vecs[i].iov_base = lcmb->buf;
+        batch->vecs[i].iov_len = 65535;
+
+        struct msghdr *msg = &batch->msgs[i].msg_hdr;
+        memset(msg, 0, sizeof(struct msghdr));
+        msg->msg_name = &lcmb->from;
+        msg->msg_namelen = sizeof(struct sockaddr);
+        msg->msg_iov = &batch->vecs[i];
+        msg->msg_iovlen = 1;
+        msg->msg_control = batch->controlbufs + i * RECV_CONTROLBUF_SIZE;
+        msg->msg_controllen = RECV_CONTROLBUF_SIZE;
+    }
+
+    // the poller reported data, so this returns at least one datagram
+    // without blocking, plus whatever else is already queued in the kernel.
+    int npackets = recvmmsg(lcm->recvfd, batch->msgs, nbufs, MSG_DONTWAIT, NULL);
+    if (npackets < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            perror("udp_read_batch -- recvmmsg");
+            lcm_stat_add(&lcm->stats.packets_bad, 1);
         }
-        struct iovec vec;
-        vec.iov_base = lcmb->buf;
-        vec.iov_len = 65535;
+        npackets = 0;
+    }
 
-        struct msghdr msg;
-        memset(&msg, 0, sizeof(struct msghdr));
-        msg.msg_name = &lcmb->from;
-        msg.msg_namelen = sizeof(struct sockaddr);
-        msg.msg_iov = &vec;
-        msg.msg_iovlen = 1;
-#ifdef MSG_EXT_HDR
-        // operating systems that provide SO_TIMESTAMP allow us to obtain more
-        // accurate timestamps by having the kernel produce timestamps as soon
-        // as packets are received.
-        char controlbuf[64];
-        msg.msg_control = controlbuf;
-        msg.msg_controllen = sizeof(controlbuf);
-        msg.msg_flags = 0;
+    for (i = 0; i < npackets; i++) {
+        lcm_buf_t *lcmb = batch->lcmbs[i];
+        struct msghdr *msg = &batch->msgs[i].msg_hdr;
+        int sz = batch->msgs[i].msg_len;
+
+        _recv_control(lcm, lcmb, msg, sz);
+        if (sz < sizeof(lcm2_header_short_t)) {
+            // packet too short to be LCM
+            lcm_stat_add(&lcm->stats.packets_bad, 1);
+            continue;
+        }
+        LCM_TRACE(udpm_recv_datagram, sz, ntohl(((lcm2_header_short_t *) lcmb->buf)->msg_seqno),
+                  lcmb->recv_utime);
+
+        lcmb->fromlen = msg->msg_namelen;
+
+        lcm2_header_short_t *hdr2 = (lcm2_header_short_t *) lcmb->buf;
+        uint32_t rcvd_magic = ntohl(hdr2->magic);
+        udpm_track_seqno(lcm, lcmb, rcvd_magic);
+        if (rcvd_magic == LCM2_MAGIC_SHORT || rcvd_magic == LCM2_MAGIC_BUNDLE) {
+            if (rcvd_magic == LCM2_MAGIC_SHORT)
+                batch->complete[i] = _recv_short_message(lcm, lcmb, sz);
+            else
+                batch->complete[i] = _recv_bundle(lcm, lcmb, sz);
+            // with room for udp_align_message() to move the payload forward,
+            // since it can only do that once the slot is in its final place
+            if (batch->complete[i])
+                batch->lens[i] = sz + (lcm->params.align > 1 ? lcm->params.align : 0);
+        } else if (rcvd_magic == LCM2_MAGIC_LONG || rcvd_magic == LCM2_MAGIC_LONG_LZ4 ||
+                   rcvd_magic == LCM2_MAGIC_LONG_DELTA || rcvd_magic == LCM2_MAGIC_PARITY) {
+            // the packet buffer of a completed fragmented message is
+            // released, since the message now lives in its own buffer.
+            batch->complete[i] = _recv_message_fragment(lcm, lcmb, sz);
+        } else {
+            dbg(DBG_LCM, "LCM: bad magic\n");
+            lcm_stat_add(&lcm->stats.packets_bad, 1);
+        }
+    }
+
+    // shrink each short message to its actual size and release the slots
+    // that did not end up holding one.
+    lcm_ringbuf_compact_tail(ringbuf, batch->bufs, batch->lens, nbufs);
+
+    int nqueued = 0;
+    for (i = 0; i < nbufs; i++) {
+        lcm_buf_t *lcmb = batch->lcmbs[i];
+        if (batch->lens[i]) {
+            lcmb->buf = batch->bufs[i];
+            udp_align_message(lcm, lcmb);
+        } else if (lcmb->ringbuf) {
+            lcmb->buf = NULL;
+            lcmb->ringbuf = NULL;
+        }
+
+        if (!batch->complete[i]) {
+            lcm_buf_enqueue(rt->inbufs_empty, lcmb);
+        } else if (udp_queue_message(rt, lcmb) == 0) {
+            nqueued++;
+        } else {
+            // told to exit.  Release the rest of the batch, newest first,
+            // since the ringbuffer can only release from its ends.
+            int j;
+            for (j = nbufs - 1; j >= i; j--) {
+                lcm_buf_free_data(batch->lcmbs[j], rt->ringbuf);
+                free(batch->lcmbs[j]);
+            }
+            return -1;
+        }
+    }
+
+    return nqueued;
+}
+#endif
+
+#if defined(LCM_HAVE_XDP) || defined(USE_IO_URING) || defined(USE_IOCP)
+// Handles a datagram whose payload is in a buffer of the kernel's, such as a
+// UMEM frame, a provided buffer or that of an overlapped receive, which goes
+// back to it once the batch of the datagram is handled.  lcmb holds a fresh
+// ringbuffer slot, and the source and receive time of the datagram.
+// Fragments are reassembled straight from data, while short messages and
+// bundles are copied into the slot, since they are dispatched later.  data
+// must be followed by a 0 byte.
+// Returns like udp_process_datagram().
+static int udp_process_borrowed_datagram(udpm_recv_thread_t *rt, lcm_buf_t *lcmb, char *data,
+                                         int size)
+{
+    lcm_udpm_t *lcm = rt->lcm;
+    uint32_t magic = 0;
+    if (size >= sizeof(lcm2_header_short_t))
+        magic = ntohl(((lcm2_header_short_t *) data)->magic);
+    if (magic != LCM2_MAGIC_LONG && magic != LCM2_MAGIC_LONG_LZ4 &&
+        magic != LCM2_MAGIC_LONG_DELTA && magic != LCM2_MAGIC_PARITY) {
+        // with the 0 byte after the payload
+        memcpy(lcmb->buf, data, size + 1);
+        return udp_process_datagram(rt, lcmb, size);
+    }
+
+    char *slot = lcmb->buf;
+    lcmb->buf = data;
+    LCM_TRACE(udpm_recv_datagram, size, ntohl(((lcm2_header_short_t *) lcmb->buf)->msg_seqno),
+              lcmb->recv_utime);
+    udpm_track_seqno(lcm, lcmb, magic);
+    if (!_recv_message_fragment(lcm, lcmb, size)) {
+        lcmb->buf = slot;
+        return 0;
+    }
+    lcm_ringbuf_dealloc(rt->ringbuf, slot);
+    return 1;
+}
+
+// Queues the complete message in lcmb, or releases it if the read thread was
+// told to exit in the meantime.  Returns -1 in that case.
+static int udp_queue_or_release(udpm_recv_thread_t *rt, lcm_buf_t *lcmb)
+{
+    if (udp_queue_message(rt, lcmb) == 0)
+        return 0;
+    lcm_buf_free_data(lcmb, rt->ringbuf);
+    free(lcmb);
+    return -1;
+}
+#endif
+
+#ifdef LCM_HAVE_XDP
+// most datagrams that are taken off the AF_XDP receive ring at once
+#define UDPM_XDP_BATCH 64
+
+static int udp_process_xdp_datagram(udpm_recv_thread_t *rt, lcm_buf_t *lcmb,
+                                    const lcm_xdp_packet_t *pkt)
+{
+    lcm_udpm_t *lcm = rt->lcm;
+    lcm_stat_add(&lcm->stats.packets_received, 1);
+    lcm_stat_add(&lcm->stats.bytes_received, pkt->size);
+    lcmb->recv_utime = g_get_real_time();
+    lcmb->recv_time_ns = lcmb->recv_utime * 1000;
+    lcmb->recv_mono_ns = lcm_monotonic_ns();
+    memcpy(&lcmb->from, &pkt->from, sizeof(pkt->from));
+    lcmb->fromlen = sizeof(pkt->from);
+    return udp_process_borrowed_datagram(rt, lcmb, pkt->data, pkt->size);
+}
+
+// Reads the datagrams that arrived on the AF_XDP socket, and one from the
+// receive socket, which still gets those that the XDP program passed on to
+// the kernel, and queues every complete message for lcm_handle().  Returns
+// -1 when the read thread should exit.
+static int udp_read_xdp(udpm_recv_thread_t *rt)
+{
+    lcm_udpm_t *lcm = rt->lcm;
+    void *ready[3];
+    int nready = lcm_poller_wait(rt->poller, ready, 3);
+    if (nready < 0) {
+        perror("udp_read_xdp -- lcm_poller_wait");
+        return 0;
+    }
+    int i;
+    for (i = 0; i < nready; i++) {
+        if (ready[i] == lcm->thread_msg_pipe) {
+            dbg(DBG_LCM, "read thread received exit command\n");
+            return -1;
+        }
+    }
+
+    lcm_xdp_packet_t pkts[UDPM_XDP_BATCH];
+    int npkts = lcm_xdp_receive(rt->xdp, pkts, UDPM_XDP_BATCH);
+    lcm_buf_t *lcmb = NULL;
+    int status = 0;
+    for (i = 0; i < npkts && status == 0; i++) {
+        if (!lcmb && !(lcmb = udp_allocate_buf(rt)))
+            status = -1;
+        else if (udp_process_xdp_datagram(rt, lcmb, &pkts[i]) > 0) {
+            status = udp_queue_or_release(rt, lcmb);
+            lcmb = NULL;
+        }
+    }
+    lcm_xdp_release(rt->xdp, pkts, npkts);
+
+    for (i = 0; i < nready && status == 0; i++) {
+        if (ready[i] != &lcm->recvfd)
+            continue;
+        if (!lcmb && !(lcmb = udp_allocate_buf(rt)))
+            status = -1;
+        else if (udp_recv_datagram(rt, lcmb) > 0) {
+            status = udp_queue_or_release(rt, lcmb);
+            lcmb = NULL;
+        }
+    }
+
+    if (lcmb) {
+        lcm_buf_free_data(lcmb, rt->ringbuf);
+        lcm_buf_enqueue(rt->inbufs_empty, lcmb);
+    }
+    return status;
+}
+#endif
+
+#ifdef USE_IO_URING
+// most datagrams that are taken off the completion queue at once
+#define UDPM_URING_BATCH 64
+
+// Reads the datagrams that the io_uring received, after waiting for one if
+// there are none yet, and queues every complete message for lcm_handle().
+// Returns -1 when the read thread should exit.
+static int udp_read_uring(udpm_recv_thread_t *rt)
+{
+    lcm_udpm_t *lcm = rt->lcm;
+    lcm_uring_packet_t pkts[UDPM_URING_BATCH];
+    int npkts = lcm_uring_wait(rt->uring, pkts, UDPM_URING_BATCH);
+    if (npkts < 0) {
+        perror("udp_read_uring -- lcm_uring_wait");
+        return 0;
+    }
+
+    lcm_buf_t *lcmb = NULL;
+    int status = 0;
+    int i;
+    for (i = 0; i < npkts && status == 0; i++) {
+        lcm_uring_packet_t *pkt = &pkts[i];
+        if (pkt->user == lcm->thread_msg_pipe) {
+            dbg(DBG_LCM, "read thread received exit command\n");
+            status = -1;
+        } else if (!lcmb && !(lcmb = udp_allocate_buf(rt))) {
+            status = -1;
+        } else {
+            _recv_control(lcm, lcmb, &pkt->msg, pkt->size);
+            memcpy(&lcmb->from, pkt->msg.msg_name, pkt->msg.msg_namelen);
+            lcmb->fromlen = pkt->msg.msg_namelen;
+            if (udp_process_borrowed_datagram(rt, lcmb, pkt->data, pkt->size) > 0) {
+                status = udp_queue_or_release(rt, lcmb);
+                lcmb = NULL;
+            }
+        }
+    }
+    lcm_uring_release(rt->uring, pkts, npkts);
+
+    if (lcmb) {
+        lcm_buf_free_data(lcmb, rt->ringbuf);
+        lcm_buf_enqueue(rt->inbufs_empty, lcmb);
+    }
+    return status;
+}
+#endif
+
+#ifdef USE_IOCP
+// most datagrams that are taken off the completion port at once
+#define UDPM_IOCP_BATCH 64
+
+// Reads the datagrams that the completion port received, after waiting for
+// one if there are none yet, and queues every complete message for
+// lcm_handle().  Returns -1 when the read thread should exit.
+static int udp_read_iocp(udpm_recv_thread_t *rt)
+{
+    lcm_udpm_t *lcm = rt->lcm;
+    lcm_iocp_packet_t pkts[UDPM_IOCP_BATCH];
+    int npkts = lcm_iocp_wait(lcm->iocp, pkts, UDPM_IOCP_BATCH);
+    if (npkts < 0) {
+        perror("udp_read_iocp -- lcm_iocp_wait");
+        return 0;
+    }
+
+    lcm_buf_t *lcmb = NULL;
+    int status = 0;
+    int i;
+    for (i = 0; i < npkts && status == 0; i++) {
+        lcm_iocp_packet_t *pkt = &pkts[i];
+        if (pkt->user == lcm->thread_msg_pipe) {
+            dbg(DBG_LCM, "read thread received exit command\n");
+            status = -1;
+        } else if (!lcmb && !(lcmb = udp_allocate_buf(rt))) {
+            status = -1;
+        } else {
+            _recv_control(lcm, lcmb, &pkt->msg, pkt->size);
+            memcpy(&lcmb->from, pkt->msg.msg_name, pkt->msg.msg_namelen);
+            lcmb->fromlen = pkt->msg.msg_namelen;
+            if (udp_process_borrowed_datagram(rt, lcmb, pkt->data, pkt->size) > 0) {
+                status = udp_queue_or_release(rt, lcmb);
+                lcmb = NULL;
+            }
+        }
+    }
+    // the exit command is handed back too, for the next read thread
+    lcm_iocp_release(lcm->iocp, pkts, npkts);
+
+    if (lcmb) {
+        lcm_buf_free_data(lcmb, rt->ringbuf);
+        lcm_buf_enqueue(rt->inbufs_empty, lcmb);
+    }
+    return status;
+}
+#endif
+
+/* This is the receiver thread that runs continuously to retrieve any incoming
+ * LCM packets from the network and queues them locally. */
+static void *recv_thread(void *user)
+{
+#ifdef G_OS_UNIX
+    // Mask out all signals on this thread.
+    sigset_t mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_SETMASK, &mask, NULL);
+#endif
+
+    udpm_recv_thread_t *rt = (udpm_recv_thread_t *) user;
+
+    while (1) {
+#ifdef LCM_HAVE_XDP
+        if (rt->xdp) {
+            if (udp_read_xdp(rt) < 0)
+                break;
+            continue;
+        }
+#endif
+#ifdef USE_IO_URING
+        if (rt->uring) {
+            if (udp_read_uring(rt) < 0)
+                break;
+            continue;
+        }
+#endif
+#ifdef USE_IOCP
+        if (rt->lcm->iocp) {
+            if (udp_read_iocp(rt) < 0)
+                break;
+            continue;
+        }
+#endif
+#ifdef USE_RECVMMSG
+        if (rt->recv_batch) {
+            if (udp_read_batch(rt) < 0)
+                break;
+            continue;
+        }
+#endif
+        lcm_buf_t *lcmb = udp_read_packet(rt);
+        if (!lcmb)
+            break;
+
+        if (udp_queue_message(rt, lcmb) < 0) {
+            lcm_buf_free_data(lcmb, rt->ringbuf);
+            free(lcmb);
+            break;
+        }
+    }
+    dbg(DBG_LCM, "read thread exiting\n");
+    return NULL;
+}
+
+// the file descriptor that becomes readable when lcm_handle() has work to do
+static int udpm_fileno(lcm_udpm_t *lcm)
+{
+    return lcm->params.recv_threads ? lcm->notify_pipe[0] : lcm->recvfd;
+}
+
+static int lcm_udpm_get_fileno(lcm_udpm_t *lcm)
+{
+    if (_setup_recv_parts(lcm) < 0) {
+        return -1;
+    }
+    return udpm_fileno(lcm);
+}
+
+#ifdef USE_SOCKET_FILTER
+/* The receive socket has a classic BPF program attached that drops datagrams
+ * on channels that nobody here subscribes to, before they are copied out of
+ * the kernel.  Only subscriptions to a channel name, or to a channel name
+ * followed by ".*", can be matched that way.  Any other regular expression
+ * removes the filter, and messages are filtered in lcm_try_enqueue_message()
+ * as usual. */
+
+// the program sees each datagram starting with its UDP header
+#define FILTER_UDP_HDR_SIZE 8
+#define FILTER_ACCEPT 0xffffffff
+
+// Parses a subscription into the channel name or channel name prefix that it
+// matches.  Returns the length of the name, or -1 if the subscription is some
+// other regular expression.
+static int filter_parse_channel(const char *channel, uint8_t *name, int *is_prefix)
+{
+    int len = 0;
+    *is_prefix = 0;
+    for (const char *p = channel; *p; p++) {
+        if (p[0] == '.' && p[1] == '*' && !p[2]) {
+            *is_prefix = 1;
+            break;
+        }
+        char c = *p;
+        if (c == '\\') {
+            // an escaped punctuation character matches itself, but \d, \w,
+            // etc. are character classes
+            c = *++p;
+            if (!c || isalnum((unsigned char) c))
+                return -1;
+        } else if (strchr(".[]()*+?{}|^$", c)) {
+            return -1;
+        }
+        if (len == LCM_MAX_CHANNEL_NAME_LENGTH)
+            return -1;
+        name[len++] = c;
+    }
+    return len;
+}
+
+static void filter_emit(GArray *prog, uint16_t code, uint8_t jt, uint8_t jf, uint32_t k)
+{
+    struct sock_filter insn = { code, jt, jf, k };
+    g_array_append_val(prog, insn);
+}
+
+// Appends instructions that accept the datagram if the len bytes at offset X
+// are name, and otherwise continue after them.  M[0] must hold the number of
+// bytes from offset X to the end of the datagram.
+static void filter_emit_match(GArray *prog, const uint8_t *name, int len)
+{
+    // a load and a comparison for every 4, 2 or 1 bytes, and the return
+    int remaining = 2 * (len / 4 + len % 4 / 2 + len % 2) + 1;
+    filter_emit(prog, BPF_LD | BPF_MEM, 0, 0, 0);
+    filter_emit(prog, BPF_JMP | BPF_JGE | BPF_K, 0, remaining, len);
+    for (int off = 0; off < len;) {
+        int size = len - off >= 4 ? 4 : len - off >= 2 ? 2 : 1;
+        uint32_t value = 0;
+        for (int i = 0; i < size; i++)
+            value = value << 8 | name[off + i];
+        filter_emit(prog, BPF_LD | BPF_IND | (size == 4 ? BPF_W : size == 2 ? BPF_H : BPF_B), 0,
+                    0, off);
+        remaining -= 2;
+        filter_emit(prog, BPF_JMP | BPF_JEQ | BPF_K, 0, remaining, value);
+        off += size;
+    }
+    filter_emit(prog, BPF_RET | BPF_K, 0, 0, FILTER_ACCEPT);
+}
+
+// Builds a filter for the current subscriptions and attaches it to the
+// receive socket, or removes the filter if the subscriptions can't all be
+// matched by one.  lcm->mutex must be held.
+static void udpm_update_channel_filter(lcm_udpm_t *lcm)
+{
+    if (lcm->recvfd < 0)
+        return;
+
+    GArray *prog = g_array_new(FALSE, FALSE, sizeof(struct sock_filter));
+    const uint32_t magic_off = FILTER_UDP_HDR_SIZE;
+    const uint32_t fragment_no_off =
+        FILTER_UDP_HDR_SIZE + offsetof(lcm2_header_long_t, fragment_no);
+    filter_emit(prog, BPF_LD | BPF_W | BPF_ABS, 0, 0, magic_off);
+    filter_emit(prog, BPF_JMP | BPF_JEQ | BPF_K, 7, 0, LCM2_MAGIC_SHORT);
+    filter_emit(prog, BPF_JMP | BPF_JEQ | BPF_K, 8, 0, LCM2_MAGIC_LONG);
+    filter_emit(prog, BPF_JMP | BPF_JEQ | BPF_K, 7, 0, LCM2_MAGIC_LONG_LZ4);
+    filter_emit(prog, BPF_JMP | BPF_JEQ | BPF_K, 6, 0, LCM2_MAGIC_LONG_DELTA);
+    // parity packets are only used for messages that are being reassembled,
+    // and bundle packets may hold messages on several channels, so both are
+    // filtered after they are read
+    filter_emit(prog, BPF_JMP | BPF_JEQ | BPF_K, 1, 0, LCM2_MAGIC_PARITY);
+    filter_emit(prog, BPF_JMP | BPF_JEQ | BPF_K, 0, 1, LCM2_MAGIC_BUNDLE);
+    filter_emit(prog, BPF_RET | BPF_K, 0, 0, FILTER_ACCEPT);
+    filter_emit(prog, BPF_RET | BPF_K, 0, 0, 0);
+    // short message: the channel name follows the header
+    filter_emit(prog, BPF_LDX | BPF_W | BPF_IMM, 0, 0,
+                FILTER_UDP_HDR_SIZE + sizeof(lcm2_header_short_t));
+    filter_emit(prog, BPF_JMP | BPF_JA, 0, 0, 4);
+    // fragment: only the first one carries the channel name
+    filter_emit(prog, BPF_LD | BPF_H | BPF_ABS, 0, 0, fragment_no_off);
+    filter_emit(prog, BPF_JMP | BPF_JEQ | BPF_K, 1, 0, 0);
+    filter_emit(prog, BPF_RET | BPF_K, 0, 0, FILTER_ACCEPT);
+    filter_emit(prog, BPF_LDX | BPF_W | BPF_IMM, 0, 0,
+                FILTER_UDP_HDR_SIZE + sizeof(lcm2_header_long_t));
+    // M[0] = bytes from the channel name to the end of the datagram
+    filter_emit(prog, BPF_LD | BPF_W | BPF_LEN, 0, 0, 0);
+    filter_emit(prog, BPF_ALU | BPF_SUB | BPF_X, 0, 0, 0);
+    filter_emit(prog, BPF_ST, 0, 0, 0);
+
+    int filterable = 1;
+    GHashTableIter iter;
+    gpointer channel;
+    g_hash_table_iter_init(&iter, lcm->filter_channels);
+    while (filterable && g_hash_table_iter_next(&iter, &channel, NULL)) {
+        uint8_t name[LCM_MAX_CHANNEL_NAME_LENGTH + 1];
+        int is_prefix;
+        int len = filter_parse_channel((const char *) channel, name, &is_prefix);
+        if (len < 0) {
+            filterable = 0;
+            break;
+        }
+        // match the terminating NUL of a whole channel name too
+        if (!is_prefix)
+            name[len++] = 0;
+        filter_emit_match(prog, name, len);
+    }
+    filter_emit(prog, BPF_RET | BPF_K, 0, 0, 0);
+
+    if (filterable && prog->len <= BPF_MAXINSNS) {
+        struct sock_fprog fprog;
+        fprog.len = prog->len;
+        fprog.filter = (struct sock_filter *) prog->data;
+        if (setsockopt(lcm->recvfd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) < 0) {
+            dbg(DBG_LCM, "unable to attach channel filter: %s\n", strerror(errno));
+            filterable = 0;
+        }
+    } else {
+        filterable = 0;
+    }
+    if (!filterable) {
+        // fails harmlessly if no filter is attached
+        int dummy = 0;
+        setsockopt(lcm->recvfd, SOL_SOCKET, SO_DETACH_FILTER, &dummy, sizeof(dummy));
+    }
+    g_array_free(prog, TRUE);
+}
 #endif
-        sz = recvmsg(lcm->recvfd, &msg, 0);
 
-        if (sz < 0) {
-            perror("udp_read_packet -- recvmsg");
-            lcm->udp_discarded_bad++;
-            continue;
+// lets datagrams on channel through the socket filter
+static void udpm_filter_add(lcm_udpm_t *lcm, const char *channel)
+{
+#ifdef USE_SOCKET_FILTER
+    g_rec_mutex_lock(&lcm->mutex);
+    int count = GPOINTER_TO_INT(g_hash_table_lookup(lcm->filter_channels, channel));
+    g_hash_table_replace(lcm->filter_channels, strdup(channel), GINT_TO_POINTER(count + 1));
+    if (!count)
+        udpm_update_channel_filter(lcm);
+    g_rec_mutex_unlock(&lcm->mutex);
+#endif
+}
+
+// joins fd to the multicast group, on each of the ifaces
+static int udpm_join_group(lcm_udpm_t *lcm, SOCKET fd)
+{
+    for (int i = 0; i < MAX(lcm->params.num_ifaces, 1); i++) {
+        struct ip_mreq mreq;
+        mreq.imr_multiaddr = lcm->params.mc_addr;
+        mreq.imr_interface.s_addr = INADDR_ANY;
+        if (lcm->params.num_ifaces)
+            mreq.imr_interface = lcm->params.ifaces[i].addr;
+        // several channel groups may be sent out of the same interface
+        int joined = 0;
+        for (int j = 0; j < i; j++)
+            joined |= lcm->params.ifaces[j].addr.s_addr == mreq.imr_interface.s_addr;
+        if (joined)
+            continue;
+        dbg(DBG_LCM, "LCM: joining multicast group on %s\n", inet_ntoa(mreq.imr_interface));
+        if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, (char *) &mreq, sizeof(mreq)) < 0) {
+            perror("setsockopt (IPPROTO_IP, IP_ADD_MEMBERSHIP)");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Announces the channel patterns that this instance subscribes to, to the
+// interest port of the group, or with goodbye, that it subscribes to none.
+static void udpm_interest_announce(lcm_udpm_t *lcm, int goodbye)
+{
+    char *buf = (char *) malloc(lcm->params.packet_size);
+    g_mutex_lock(&lcm->interest_lock);
+    int size = lcm_interest_encode(lcm->interest_id, goodbye ? NULL : lcm->interest_channels, buf,
+                                   lcm->params.packet_size);
+    g_mutex_unlock(&lcm->interest_lock);
+
+    struct sockaddr_in dest = lcm->dest_addr;
+    dest.sin_port = lcm->params.interest_port;
+    if (sendto(lcm->sendfd, buf, size, 0, (struct sockaddr *) &dest, sizeof(dest)) != size)
+        dbg(DBG_LCM, "LCM: failed to send interest announcement\n");
+    free(buf);
+}
+
+// Reads the interest announcements of the instances on the group, including
+// this one, and announces the subscriptions of this one every
+// interest_period, if it has any.
+static void *interest_thread(void *user)
+{
+    lcm_udpm_t *lcm = (lcm_udpm_t *) user;
+    int64_t period = (int64_t) lcm->params.interest_period * 1000;
+    int64_t next_announce = g_get_monotonic_time() + period;
+    char *buf = (char *) malloc(LCM_MAX_UNFRAGMENTED_PACKET_SIZE);
+    while (!g_atomic_int_get(&lcm->interest_exit)) {
+        int64_t now = g_get_monotonic_time();
+        if (now >= next_announce) {
+            g_mutex_lock(&lcm->interest_lock);
+            int subscribed = g_hash_table_size(lcm->interest_channels) > 0;
+            g_mutex_unlock(&lcm->interest_lock);
+            if (subscribed)
+                udpm_interest_announce(lcm, 0);
+            next_announce = now + period;
+        }
+        lcm_interest_expire(lcm->interest, now);
+
+        // wakes up often enough to end the warm up of lcm->interest on time
+        int64_t wait = MIN(next_announce - now, period / 2);
+        fd_set readfds;
+        FD_ZERO(&readfds);
+        FD_SET(lcm->interestfd, &readfds);
+        struct timeval tv;
+        tv.tv_sec = wait / 1000000;
+        tv.tv_usec = wait % 1000000;
+        if (select(lcm->interestfd + 1, &readfds, NULL, NULL, &tv) > 0) {
+            int sz = recv(lcm->interestfd, buf, LCM_MAX_UNFRAGMENTED_PACKET_SIZE, 0);
+            uint32_t id;
+            if (sz > 0 &&
+                lcm_interest_receive(lcm->interest, buf, sz, g_get_monotonic_time(), &id) > 0 &&
+                lcm->latched && id != lcm->interest_id)
+                udpm_latch_replay(lcm, id);
+        }
+    }
+    free(buf);
+    return NULL;
+}
+
+// Opens interestfd on the interest port of the group, and starts the interest
+// thread.
+static int udpm_interest_start(lcm_udpm_t *lcm)
+{
+    lcm->interestfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (lcm->interestfd < 0) {
+        perror("socket(interest)");
+        return -1;
+    }
+    int opt = 1;
+    if (setsockopt(lcm->interestfd, SOL_SOCKET, SO_REUSEADDR, (char *) &opt, sizeof(opt)) < 0) {
+        perror("setsockopt (SOL_SOCKET, SO_REUSEADDR)");
+        return -1;
+    }
+#ifdef USE_REUSEPORT
+    if (setsockopt(lcm->interestfd, SOL_SOCKET, SO_REUSEPORT, (char *) &opt, sizeof(opt)) < 0) {
+        perror("setsockopt (SOL_SOCKET, SO_REUSEPORT)");
+        return -1;
+    }
+#endif
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+#ifndef WIN32
+    addr.sin_addr = lcm->params.mc_addr;
+#else
+    addr.sin_addr.s_addr = INADDR_ANY;
+#endif
+    addr.sin_port = lcm->params.interest_port;
+    if (bind(lcm->interestfd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        perror("bind(interest)");
+        return -1;
+    }
+    if (udpm_join_group(lcm, lcm->interestfd) < 0)
+        return -1;
+
+    lcm->interest =
+        lcm_interest_new((int64_t) lcm->params.interest_period * 1000, g_get_monotonic_time());
+    lcm->interest_channels = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
+    lcm->interest_id = g_random_int();
+
+    lcm_thread_sched_t sched;
+    lcm_thread_sched_init(&sched);
+    lcm->interest_thread =
+        lcm_internal_thread_new("lcm-udpm-interest", interest_thread, lcm, &sched);
+    return lcm->interest_thread ? 0 : -1;
+}
+
+static void udpm_interest_stop(lcm_udpm_t *lcm)
+{
+    if (lcm->interest_thread) {
+        g_atomic_int_set(&lcm->interest_exit, 1);
+        // the goodbye also wakes up the interest thread, through the loopback
+        udpm_interest_announce(lcm, 1);
+        g_thread_join(lcm->interest_thread);
+        lcm->interest_thread = NULL;
+    }
+    if (lcm->interestfd >= 0) {
+        lcm_close_socket(lcm->interestfd);
+        lcm->interestfd = -1;
+    }
+    if (lcm->interest) {
+        lcm_interest_destroy(lcm->interest);
+        lcm->interest = NULL;
+    }
+    if (lcm->interest_channels) {
+        g_hash_table_destroy(lcm->interest_channels);
+        lcm->interest_channels = NULL;
+    }
+}
+
+// counts a subscription to channel in the announcements of this instance
+static void udpm_interest_add(lcm_udpm_t *lcm, const char *channel)
+{
+    if (!lcm->interest)
+        return;
+    g_mutex_lock(&lcm->interest_lock);
+    int count = GPOINTER_TO_INT(g_hash_table_lookup(lcm->interest_channels, channel));
+    g_hash_table_replace(lcm->interest_channels, strdup(channel), GINT_TO_POINTER(count + 1));
+    g_mutex_unlock(&lcm->interest_lock);
+    // right away, so that publishers start sending the channel
+    if (!count)
+        udpm_interest_announce(lcm, 0);
+}
+
+static void udpm_interest_remove(lcm_udpm_t *lcm, const char *channel)
+{
+    if (!lcm->interest)
+        return;
+    g_mutex_lock(&lcm->interest_lock);
+    int count = GPOINTER_TO_INT(g_hash_table_lookup(lcm->interest_channels, channel));
+    if (count > 1)
+        g_hash_table_replace(lcm->interest_channels, strdup(channel), GINT_TO_POINTER(count - 1));
+    else
+        g_hash_table_remove(lcm->interest_channels, channel);
+    g_mutex_unlock(&lcm->interest_lock);
+    if (count == 1)
+        udpm_interest_announce(lcm, 0);
+}
+
+static int lcm_udpm_subscribe(lcm_udpm_t *lcm, const char *channel)
+{
+    if (_setup_recv_parts(lcm) < 0)
+        return -1;
+    udpm_filter_add(lcm->shared ? lcm->shared->hub : lcm, channel);
+    return 0;
+}
+
+// announced once the handler is in place, since the latched messages that it
+// brings may arrive right away
+static void lcm_udpm_subscribed(lcm_udpm_t *lcm, const char *channel)
+{
+    udpm_interest_add(lcm, channel);
+}
+
+static int lcm_udpm_unsubscribe(lcm_udpm_t *lcm, const char *channel)
+{
+    udpm_interest_remove(lcm, channel);
+#ifdef USE_SOCKET_FILTER
+    if (lcm->shared)
+        lcm = lcm->shared->hub;
+    g_rec_mutex_lock(&lcm->mutex);
+    int count = GPOINTER_TO_INT(g_hash_table_lookup(lcm->filter_channels, channel));
+    if (count > 1) {
+        g_hash_table_replace(lcm->filter_channels, strdup(channel), GINT_TO_POINTER(count - 1));
+    } else if (count == 1) {
+        g_hash_table_remove(lcm->filter_channels, channel);
+        udpm_update_channel_filter(lcm);
+    }
+    g_rec_mutex_unlock(&lcm->mutex);
+#endif
+    return 0;
+}
+
+// whether datagrams are paced by the token bucket of send_rate
+static int udpm_is_paced(lcm_udpm_t *lcm)
+{
+    return lcm->params.send_rate > 0 && !lcm->params.send_pacing_kernel;
+}
+
+static void udpm_pace_refill(lcm_udpm_t *lcm)
+{
+    int64_t now = g_get_monotonic_time();
+    lcm->pace_tokens += (now - lcm->pace_utime) * 1e-6 * lcm->params.send_rate;
+    lcm->pace_tokens = MIN(lcm->pace_tokens, lcm->params.send_burst);
+    lcm->pace_utime = now;
+}
+
+// Waits until the token bucket of send_rate allows size more bytes to be
+// sent, and takes them from it.  The bucket holds up to send_burst bytes.  It
+// goes into debt by any datagram larger than what is left, so that datagrams
+// are never split, and a sleep that runs long is made up for by the time
+// that the next refill counts.  transmit_lock must be held.
+static void udpm_pace(lcm_udpm_t *lcm, int size)
+{
+    if (!udpm_is_paced(lcm))
+        return;
+    udpm_pace_refill(lcm);
+    if (lcm->pace_tokens < 0) {
+        g_usleep((gulong) (-lcm->pace_tokens * 1e6 / lcm->params.send_rate));
+        udpm_pace_refill(lcm);
+    }
+    lcm->pace_tokens -= size;
+}
+
+// Sends the datagram of msg, of packet_size bytes, to each destination.
+// Returns what the last sendmsg() returned, which is packet_size on success.
+// transmit_lock must be held.
+static int udpm_sendmsg(lcm_udpm_t *lcm, struct msghdr *msg, int packet_size)
+{
+    int status = -1;
+    for (int i = 0; i < lcm->num_dests; i++) {
+        msg->msg_name = (struct sockaddr *) &lcm->dests[i];
+        msg->msg_namelen = sizeof(lcm->dests[i]);
+        udpm_pace(lcm, packet_size);
+        status = sendmsg(lcm->sendfd, msg, 0);
+        if (status != packet_size)
+            break;
+    }
+    return status;
+}
+
+// Transmits the parity packets of a message that was sent in nfragments
+// fragments of fragment_size bytes, one for every fec_group of them.  hdr
+// holds the header fields of the fragments.  transmit_lock must be held.
+static void udpm_send_parity(lcm_udpm_t *lcm, const lcm2_header_long_t *hdr,
+                             const char *channel, int channel_size, const void *data,
+                             unsigned int datalen, int fragment_size, int nfragments)
+{
+    char *parity = (char *) malloc(fragment_size);
+    lcm2_header_long_t parity_hdr = *hdr;
+    parity_hdr.magic = htonl(LCM2_MAGIC_PARITY);
+    parity_hdr.fragment_offset = 0;
+    lcm2_header_parity_t phdr;
+    phdr.fragment_size = htonl(fragment_size);
+    phdr.flags = 0;
+    if (ntohl(hdr->magic) == LCM2_MAGIC_LONG_LZ4)
+        phdr.flags = htons(LCM2_PARITY_LZ4);
+    else if (ntohl(hdr->magic) == LCM2_MAGIC_LONG_DELTA)
+        phdr.flags = htons(LCM2_PARITY_DELTA);
+
+    for (int first = 0; first < nfragments; first += lcm->params.fec_group) {
+        int group_size = MIN(lcm->params.fec_group, nfragments - first);
+        uint32_t parity_size = 0;
+        for (int frag_no = first; frag_no < first + group_size; frag_no++) {
+            uint32_t offset, size;
+            lcm_fragment_extent(datalen, fragment_size, channel_size, frag_no, &offset, &size);
+            if (size > parity_size) {
+                memset(parity + parity_size, 0, size - parity_size);
+                parity_size = size;
+            }
+            lcm_xor_bytes(parity, (const char *) data + offset, size);
+        }
+        parity_hdr.fragment_no = htons(first);
+        phdr.group_size = htons(group_size);
+
+        struct iovec sendbufs[4];
+        sendbufs[0].iov_base = (char *) &parity_hdr;
+        sendbufs[0].iov_len = sizeof(parity_hdr);
+        sendbufs[1].iov_base = (char *) &phdr;
+        sendbufs[1].iov_len = sizeof(phdr);
+        sendbufs[2].iov_base = (char *) channel;
+        sendbufs[2].iov_len = channel_size + 1;
+        sendbufs[3].iov_base = parity;
+        sendbufs[3].iov_len = parity_size;
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = sendbufs;
+        msg.msg_iovlen = 4;
+        int packet_size = sizeof(parity_hdr) + sizeof(phdr) + channel_size + 1 + parity_size;
+        if (udpm_sendmsg(lcm, &msg, packet_size) != packet_size)
+            break;
+    }
+    free(parity);
+}
+
+// Keeps a fragmented message that was just sent for retransmission, in place
+// of the oldest ones that no longer fit.  transmit_lock must be held.
+static void udpm_retain_message(lcm_udpm_t *lcm, const lcm2_header_long_t *hdr,
+                                const char *channel, int channel_size, const void *data,
+                                unsigned int datalen, int fragment_size)
+{
+    if (datalen > lcm->params.retransmit_buffer)
+        return;
+    while (lcm->retained_bytes + datalen > lcm->params.retransmit_buffer) {
+        udpm_retained_msg_t *oldest = (udpm_retained_msg_t *) g_queue_pop_head(lcm->retained);
+        lcm->retained_bytes -= oldest->datalen;
+        free(oldest);
+    }
+
+    udpm_retained_msg_t *msg = (udpm_retained_msg_t *) malloc(sizeof(*msg) + datalen);
+    msg->hdr = *hdr;
+    memcpy(msg->channel, channel, channel_size + 1);
+    msg->channel_size = channel_size;
+    msg->fragment_size = fragment_size;
+    msg->datalen = datalen;
+    memcpy(msg + 1, data, datalen);
+    g_queue_push_tail(lcm->retained, msg);
+    lcm->retained_bytes += datalen;
+}
+
+// Sends the fragments of a kept message that a NACK lists to the destinations
+// again.  transmit_lock must be held.
+static void udpm_retransmit(lcm_udpm_t *lcm, udpm_retained_msg_t *retained,
+                            const uint16_t *fragments, int num_fragments)
+{
+    const char *data = (const char *) (retained + 1);
+    uint16_t nfragments = ntohs(retained->hdr.fragments_in_msg);
+    for (int i = 0; i < num_fragments; i++) {
+        uint16_t frag_no = ntohs(fragments[i]);
+        if (frag_no >= nfragments)
+            continue;
+        uint32_t offset, size;
+        lcm_fragment_extent(retained->datalen, retained->fragment_size, retained->channel_size,
+                            frag_no, &offset, &size);
+
+        lcm2_header_long_t hdr = retained->hdr;
+        hdr.fragment_offset = htonl(offset);
+        hdr.fragment_no = htons(frag_no);
+        struct iovec sendbufs[3];
+        int niov = 0;
+        sendbufs[niov].iov_base = (char *) &hdr;
+        sendbufs[niov++].iov_len = sizeof(hdr);
+        if (frag_no == 0) {
+            sendbufs[niov].iov_base = retained->channel;
+            sendbufs[niov++].iov_len = retained->channel_size + 1;
+        }
+        sendbufs[niov].iov_base = (char *) data + offset;
+        sendbufs[niov++].iov_len = size;
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = sendbufs;
+        msg.msg_iovlen = niov;
+        int packet_size = sizeof(hdr) + (frag_no ? 0 : retained->channel_size + 1) + size;
+        if (udpm_sendmsg(lcm, &msg, packet_size) != packet_size)
+            break;
+        LCM_TRACE(udpm_send_packet, retained->channel, ntohl(hdr.msg_seqno), frag_no,
+                  nfragments, packet_size);
+    }
+}
+
+// answers the NACKs waiting on the transmit socket
+static void udpm_recv_nacks(lcm_udpm_t *lcm)
+{
+    char buf[sizeof(lcm2_header_short_t) + 2 + 2 * LCM2_NACK_MAX_FRAGMENTS];
+    while (1) {
+        int sz = recv(lcm->sendfd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (sz < 0)
+            return;
+        lcm2_header_short_t *hdr = (lcm2_header_short_t *) buf;
+        uint16_t count;
+        if (sz < (int) (sizeof(*hdr) + sizeof(count)) || ntohl(hdr->magic) != LCM2_MAGIC_NACK)
+            continue;
+        memcpy(&count, hdr + 1, sizeof(count));
+        count = ntohs(count);
+        if (sz < (int) (sizeof(*hdr) + sizeof(count) + count * sizeof(uint16_t)))
+            continue;
+        uint16_t fragments[LCM2_NACK_MAX_FRAGMENTS];
+        memcpy(fragments, buf + sizeof(*hdr) + sizeof(count), count * sizeof(uint16_t));
+
+        g_mutex_lock(&lcm->transmit_lock);
+        GList *link;
+        for (link = lcm->retained->tail; link; link = link->prev) {
+            udpm_retained_msg_t *retained = (udpm_retained_msg_t *) link->data;
+            if (retained->hdr.msg_seqno == hdr->msg_seqno) {
+                dbg(DBG_LCM, "retransmitting %d fragments of [%s]\n", count, retained->channel);
+                udpm_retransmit(lcm, retained, fragments, count);
+                break;
+            }
+        }
+        g_mutex_unlock(&lcm->transmit_lock);
+    }
+}
+
+// Sends NACKs for the messages on the channels of the retransmit option that
+// have not received a fragment in nack_timeout.  The channel of a message is
+// not known until its first fragment arrives, so the ones without it are
+// NACKed too.
+static void udpm_send_nacks(lcm_udpm_t *lcm)
+{
+    int64_t now = g_get_real_time();
+    int64_t timeout = lcm->params.nack_timeout * 1000;
+    char buf[sizeof(lcm2_header_short_t) + 2 + 2 * LCM2_NACK_MAX_FRAGMENTS];
+    lcm2_header_short_t *hdr = (lcm2_header_short_t *) buf;
+    uint16_t *fragments = (uint16_t *) (buf + sizeof(*hdr) + sizeof(uint16_t));
+    hdr->magic = htonl(LCM2_MAGIC_NACK);
+
+    g_mutex_lock(&lcm->repair_lock);
+    for (int i = 0; i < lcm->num_frag_shards; i++) {
+        udpm_frag_shard_t *shard = &lcm->frag_shards[i];
+        g_mutex_lock(&shard->lock);
+        lcm_frag_buf_t *fbuf;
+        for (fbuf = shard->frag_bufs->lru_head; fbuf; fbuf = fbuf->lru_next) {
+            if (now - fbuf->last_packet_utime < timeout || now - fbuf->nack_utime < timeout ||
+                fbuf->nacks_sent >= UDPM_MAX_NACKS)
+                continue;
+            if (fbuf->channel[0] &&
+                !g_regex_match(lcm->params.retransmit_re, fbuf->channel, (GRegexMatchFlags) 0,
+                               NULL))
+                continue;
+
+            int count = lcm_frag_buf_missing(fbuf, fragments, LCM2_NACK_MAX_FRAGMENTS);
+            for (int j = 0; j < count; j++)
+                fragments[j] = htons(fragments[j]);
+            uint16_t count_be = htons(count);
+            memcpy(buf + sizeof(*hdr), &count_be, sizeof(count_be));
+            hdr->msg_seqno = htonl(fbuf->msg_seqno);
+            int size = sizeof(*hdr) + sizeof(count_be) + count * sizeof(uint16_t);
+            dbg(DBG_LCM, "NACKing %d fragments of message %u\n", count, fbuf->msg_seqno);
+            if (sendto(lcm->sendfd, buf, size, 0, (struct sockaddr *) &fbuf->from,
+                       sizeof(fbuf->from)) == size)
+                lcm_stat_add(&lcm->stats.fragments_requested, count);
+            fbuf->nack_utime = now;
+            fbuf->nacks_sent++;
+        }
+        g_mutex_unlock(&shard->lock);
+    }
+    g_mutex_unlock(&lcm->repair_lock);
+}
+
+// answers NACKs, and sends them, with the retransmit option
+static void *repair_thread(void *user)
+{
+    lcm_udpm_t *lcm = (lcm_udpm_t *) user;
+    int interval_ms = MAX(1, lcm->params.nack_timeout / 2);
+    int64_t next_scan = g_get_monotonic_time();
+    while (!g_atomic_int_get(&lcm->repair_exit)) {
+        fd_set readfds;
+        FD_ZERO(&readfds);
+        FD_SET(lcm->sendfd, &readfds);
+        struct timeval tv;
+        tv.tv_sec = interval_ms / 1000;
+        tv.tv_usec = (interval_ms % 1000) * 1000;
+        if (select(lcm->sendfd + 1, &readfds, NULL, NULL, &tv) > 0)
+            udpm_recv_nacks(lcm);
+
+        if (g_get_monotonic_time() >= next_scan) {
+            udpm_send_nacks(lcm);
+            next_scan = g_get_monotonic_time() + interval_ms * 1000;
+        }
+    }
+    return NULL;
+}
+
+#ifdef USE_SENDMMSG
+// maximum number of fragments passed to a single sendmmsg() call
+#define UDPM_SENDMMSG_BATCH 64
+
+// Sends the n datagrams of msgs to each destination, with as few sendmmsg()
+// calls as possible.  Returns 0 on success, -1 on error.
+static int udpm_sendmmsg(lcm_udpm_t *lcm, struct mmsghdr *msgs, int n)
+{
+    for (int i = 0; i < lcm->num_dests; i++) {
+        for (int j = 0; j < n; j++) {
+            msgs[j].msg_hdr.msg_name = (struct sockaddr *) &lcm->dests[i];
+            msgs[j].msg_hdr.msg_namelen = sizeof(lcm->dests[i]);
         }
-
-        if (sz < sizeof(lcm2_header_short_t)) {
-            // packet too short to be LCM
-            lcm->udp_discarded_bad++;
-            continue;
+        int sent = 0;
+        while (sent < n) {
+            int status = sendmmsg(lcm->sendfd, msgs + sent, n - sent, 0);
+            if (status < 0 && errno == EINTR)
+                continue;
+            if (status <= 0)
+                return -1;
+            sent += status;
         }
+    }
+    return 0;
+}
 
-        lcmb->fromlen = msg.msg_namelen;
-
-        int got_utime = 0;
-#ifdef SO_TIMESTAMP
-        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
-        /* Get the receive timestamp out of the packet headers if possible */
-        while (!lcmb->recv_utime && cmsg) {
-            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMP) {
-                struct timeval *t = (struct timeval *) CMSG_DATA(cmsg);
-                lcmb->recv_utime = (int64_t) t->tv_sec * 1000000 + t->tv_usec;
-                got_utime = 1;
-                break;
+// Transmits all the fragments of a message, made up of the iovcnt pieces of
+// iov, with as few sendmmsg() calls as possible.  hdr holds the header fields
+// that are the same for every fragment.  Returns 0 on success, -1 on error.
+static int udpm_send_fragments(lcm_udpm_t *lcm, const lcm2_header_long_t *hdr,
+                               const char *channel, int channel_size, const lcm_iovec_t *iov,
+                               int iovcnt, unsigned int datalen, int fragment_size, int nfragments)
+{
+    lcm2_header_long_t hdrs[UDPM_SENDMMSG_BATCH];
+    struct iovec iovs[UDPM_SENDMMSG_BATCH][2 + LCM_MAX_PUBLISHV_IOVS];
+    struct mmsghdr msgs[UDPM_SENDMMSG_BATCH];
+    uint32_t fragment_offset = 0;
+    int frag_no = 0;
+
+    // with send_rate, no more fragments at once than the bucket holds
+    int max_batch = UDPM_SENDMMSG_BATCH;
+    if (udpm_is_paced(lcm))
+        max_batch = CLAMP(lcm->params.send_burst / lcm->params.packet_size, 1, max_batch);
+
+    while (frag_no < nfragments) {
+        int n;
+        int batch_size = 0;
+        for (n = 0; n < max_batch && frag_no < nfragments; n++, frag_no++) {
+            struct iovec *frag_iov = iovs[n];
+            int niov = 0;
+            int fraglen;
+
+            hdrs[n] = *hdr;
+            hdrs[n].fragment_offset = htonl(fragment_offset);
+            hdrs[n].fragment_no = htons(frag_no);
+            frag_iov[niov].iov_base = (char *) &hdrs[n];
+            frag_iov[niov++].iov_len = sizeof(lcm2_header_long_t);
+
+            if (frag_no == 0) {
+                // first fragment is special.  insert channel before data
+                frag_iov[niov].iov_base = (char *) channel;
+                frag_iov[niov++].iov_len = channel_size + 1;
+                fraglen = MIN(fragment_size - (channel_size + 1), (int) datalen);
+            } else {
+                fraglen = MIN(fragment_size, datalen - fragment_offset);
             }
-            cmsg = CMSG_NXTHDR(&msg, cmsg);
-        }
-#endif
-        if (!got_utime)
-            lcmb->recv_utime = g_get_real_time();
+            niov += lcm_iov_slice(iov, iovcnt, fragment_offset, fraglen, frag_iov + niov);
+            fragment_offset += fraglen;
 
-        lcm2_header_short_t *hdr2 = (lcm2_header_short_t *) lcmb->buf;
-        uint32_t rcvd_magic = ntohl(hdr2->magic);
-        if (rcvd_magic == LCM2_MAGIC_SHORT)
-            got_complete_message = _recv_short_message(lcm, lcmb, sz);
-        else if (rcvd_magic == LCM2_MAGIC_LONG)
-            got_complete_message = _recv_message_fragment(lcm, lcmb, sz);
-        else {
-            dbg(DBG_LCM, "LCM: bad magic\n");
-            lcm->udp_discarded_bad++;
-            continue;
+            memset(&msgs[n], 0, sizeof(struct mmsghdr));
+            msgs[n].msg_hdr.msg_iov = frag_iov;
+            msgs[n].msg_hdr.msg_iovlen = niov;
+            int packet_size =
+                (int) sizeof(lcm2_header_long_t) + (frag_no ? 0 : channel_size + 1) + fraglen;
+            batch_size += packet_size;
+            LCM_TRACE(udpm_send_packet, channel, ntohl(hdr->msg_seqno), frag_no, nfragments,
+                      packet_size);
         }
-    }
 
-    // if the newly received packet is a short packet, then resize the space
-    // allocated to it on the ringbuffer to exactly match the amount of space
-    // required.  That way, we do not use 64k of the ringbuffer for every
-    // incoming message.
-    if (lcmb->ringbuf) {
-        g_rec_mutex_lock(&lcm->mutex);
-        lcm_ringbuf_shrink_last(lcmb->ringbuf, lcmb->buf, sz);
-        g_rec_mutex_unlock(&lcm->mutex);
+        udpm_pace(lcm, batch_size * lcm->num_dests);
+        if (udpm_sendmmsg(lcm, msgs, n) < 0)
+            return -1;
     }
 
-    return lcmb;
+    assert(fragment_offset == datalen);
+    return 0;
 }
-
-/* This is the receiver thread that runs continuously to retrieve any incoming
- * LCM packets from the network and queues them locally. */
-static void *recv_thread(void *user)
-{
-#ifdef G_OS_UNIX
-    // Mask out all signals on this thread.
-    sigset_t mask;
-    sigfillset(&mask);
-    pthread_sigmask(SIG_SETMASK, &mask, NULL);
 #endif
 
-    lcm_udpm_t *lcm = (lcm_udpm_t *) user;
+// Sends the pending bundle packet, if there is one.  transmit_lock must be
+// held.  Returns 0 on success, -1 on error.
+static int udpm_flush_bundle(lcm_udpm_t *lcm)
+{
+    if (!lcm->bundle_len)
+        return 0;
 
-    while (1) {
-        lcm_buf_t *lcmb = udp_read_packet(lcm);
-        if (!lcmb)
+    lcm2_header_short_t *hdr = (lcm2_header_short_t *) lcm->bundle_buf;
+    hdr->msg_seqno = htonl(lcm->msg_seqno);
+    dbg(DBG_LCM_MSG, "transmitting %d byte bundle packet\n", lcm->bundle_len);
+    int status = -1;
+    for (int i = 0; i < lcm->num_dests; i++) {
+        udpm_pace(lcm, lcm->bundle_len);
+        status = sendto(lcm->sendfd, lcm->bundle_buf, lcm->bundle_len, 0,
+                        (struct sockaddr *) &lcm->dests[i], sizeof(lcm->dests[i]));
+        if (status != lcm->bundle_len)
             break;
+    }
+    int expected = lcm->bundle_len;
+    lcm->msg_seqno++;
+    lcm->bundle_len = 0;
+    return status == expected ? 0 : -1;
+}
 
-        /* If necessary, notify the reading thread by writing to a pipe.  We
-         * only want one character in the pipe at a time to avoid blocking
-         * writes, so we only do this when the queue transitions from empty to
-         * non-empty. */
-        g_rec_mutex_lock(&lcm->mutex);
+// Makes sendfd send out of interface iface of the ifaces option, with the
+// sequence numbers of that interface, after sending the pending bundle
+// packet out of the previous one.  transmit_lock must be held.
+static void udpm_use_iface(lcm_udpm_t *lcm, int iface)
+{
+    if (!lcm->params.num_ifaces || iface == lcm->cur_iface)
+        return;
+    udpm_flush_bundle(lcm);
+    udpm_iface_t *ifaces = lcm->params.ifaces;
+    if (setsockopt(lcm->sendfd, IPPROTO_IP, IP_MULTICAST_IF, (char *) &ifaces[iface].addr,
+                   sizeof(ifaces[iface].addr)) < 0) {
+        perror("setsockopt (IPPROTO_IP, IP_MULTICAST_IF)");
+        return;
+    }
+    if (lcm->cur_iface >= 0)
+        ifaces[lcm->cur_iface].msg_seqno = lcm->msg_seqno;
+    lcm->msg_seqno = ifaces[iface].msg_seqno;
+    lcm->cur_iface = iface;
+}
 
-        if (lcm_buf_queue_is_empty(lcm->inbufs_filled))
-            if (lcm_internal_pipe_write(lcm->notify_pipe[1], "+", 1) < 0)
-                perror("write to notify");
+// Adds a short message to the pending bundle packet, after sending the packet
+// first if the message does not fit into it anymore.
+static int udpm_bundle_append(lcm_udpm_t *lcm, int iface, const char *channel, int channel_size,
+                              const void *data, unsigned int datalen)
+{
+    int entry_size = channel_size + LCM2_BUNDLE_ENTRY_OVERHEAD + datalen;
+    int status = 0;
+
+    g_mutex_lock(&lcm->transmit_lock);
+    udpm_use_iface(lcm, iface);
+    if (lcm->bundle_len + entry_size > lcm->params.bundle_size)
+        status = udpm_flush_bundle(lcm);
+    if (!lcm->bundle_len) {
+        lcm2_header_short_t *hdr = (lcm2_header_short_t *) lcm->bundle_buf;
+        hdr->magic = htonl(LCM2_MAGIC_BUNDLE);
+        lcm->bundle_len = sizeof(lcm2_header_short_t);
+        lcm->bundle_deadline = g_get_monotonic_time() + lcm->params.bundle_interval;
+        g_cond_signal(&lcm->bundle_cond);
+    }
 
-        /* Queue the packet for future retrieval by lcm_handle (). */
-        lcm_buf_enqueue(lcm->inbufs_filled, lcmb);
+    char *p = lcm->bundle_buf + lcm->bundle_len;
+    memcpy(p, channel, channel_size + 1);
+    uint32_t size = htonl(datalen);
+    memcpy(p + channel_size + 1, &size, sizeof(size));
+    memcpy(p + channel_size + LCM2_BUNDLE_ENTRY_OVERHEAD, data, datalen);
+    lcm->bundle_len += entry_size;
+    g_mutex_unlock(&lcm->transmit_lock);
+    return status;
+}
 
-        g_rec_mutex_unlock(&lcm->mutex);
+// sends bundle packets once their oldest message has waited long enough
+static void *bundle_thread(void *user)
+{
+    lcm_udpm_t *lcm = (lcm_udpm_t *) user;
+    g_mutex_lock(&lcm->transmit_lock);
+    while (!lcm->bundle_exit) {
+        if (!lcm->bundle_len)
+            g_cond_wait(&lcm->bundle_cond, &lcm->transmit_lock);
+        else if (g_get_monotonic_time() >= lcm->bundle_deadline)
+            udpm_flush_bundle(lcm);
+        else
+            g_cond_wait_until(&lcm->bundle_cond, &lcm->transmit_lock, lcm->bundle_deadline);
     }
-    dbg(DBG_LCM, "read thread exiting\n");
+    udpm_flush_bundle(lcm);
+    g_mutex_unlock(&lcm->transmit_lock);
     return NULL;
 }
 
-static int lcm_udpm_get_fileno(lcm_udpm_t *lcm)
+// What udpm_transmit() needs to know about the channel of a message.  A
+// publisher from lcm_publisher_create() finds it out once, instead of for
+// every message.
+typedef struct {
+    const char *channel;
+    int channel_size;
+    int8_t bundle;      // may be bundled, which the self test message may not
+    int8_t compress;    // matches the compress option, or -1 if not known yet
+    int8_t delta;       // matches the delta option, or -1 if not known yet
+    int8_t retransmit;  // matches the retransmit option, or -1 if not known yet
+    int8_t latch;       // matches the latch option, or -1 if not known yet
+    int8_t iface;       // of the ifaces option that it is sent out of, or -1
+    int8_t interested;  // anybody subscribes to it, as of interest_generation,
+                        // with the interest option, or -1 if not known yet
+    uint32_t interest_generation;
+} udpm_publisher_t;
+
+static int udpm_publisher_init(udpm_publisher_t *pub, const char *channel)
 {
-    if (_setup_recv_parts(lcm) < 0) {
+    pub->channel = channel;
+    pub->channel_size = strlen(channel);
+    if (pub->channel_size > LCM_MAX_CHANNEL_NAME_LENGTH) {
+        fprintf(stderr, "LCM Error: channel name too long [%s]\n", channel);
         return -1;
     }
-    return lcm->notify_pipe[0];
+    pub->bundle = strcmp(channel, SELF_TEST_CHANNEL) != 0;
+    pub->compress = pub->delta = pub->retransmit = pub->latch = pub->iface = -1;
+    pub->interested = -1;
+    pub->interest_generation = 0;
+    return 0;
 }
 
-static int lcm_udpm_subscribe(lcm_udpm_t *lcm, const char *channel)
+// Whether anybody subscribes to the channel of pub, with the interest option,
+// which is only looked up again when the announcements change.
+static int udpm_publisher_interested(lcm_udpm_t *lcm, udpm_publisher_t *pub)
 {
-    return _setup_recv_parts(lcm);
+    if (!lcm->interest)
+        return 1;
+    uint32_t generation = lcm_interest_generation(lcm->interest);
+    if (pub->interested < 0 || pub->interest_generation != generation) {
+        pub->interest_generation = generation;
+        pub->interested = lcm_interest_has_subscribers(lcm->interest, pub->channel);
+    }
+    return pub->interested;
 }
 
-static int lcm_udpm_publish(lcm_udpm_t *lcm, const char *channel, const void *data,
-                            unsigned int datalen)
+// whether the channel of pub matches re, which is only looked up the first time
+static int udpm_publisher_matches(const udpm_publisher_t *pub, GRegex *re, int8_t *match)
 {
-    int channel_size = strlen(channel);
-    if (channel_size > LCM_MAX_CHANNEL_NAME_LENGTH) {
-        fprintf(stderr, "LCM Error: channel name too long [%s]\n", channel);
-        return -1;
+    if (*match < 0)
+        *match = re && g_regex_match(re, pub->channel, (GRegexMatchFlags) 0, NULL);
+    return *match;
+}
+
+// The interface of the ifaces option that the channel of pub is sent out of:
+// the first one whose regex it matches, or else one of those without a regex,
+// or of all of them if there are none, picked by its hash.
+static int udpm_publisher_iface(lcm_udpm_t *lcm, udpm_publisher_t *pub)
+{
+    if (pub->iface >= 0 || !lcm->params.num_ifaces)
+        return MAX(pub->iface, 0);
+    const udpm_iface_t *ifaces = lcm->params.ifaces;
+    int num_ifaces = lcm->params.num_ifaces;
+    int hashed[UDPM_MAX_IFACES];
+    int num_hashed = 0;
+    for (int i = 0; i < num_ifaces; i++) {
+        if (!ifaces[i].re)
+            hashed[num_hashed++] = i;
+        else if (g_regex_match(ifaces[i].re, pub->channel, (GRegexMatchFlags) 0, NULL))
+            return pub->iface = i;
+    }
+    guint hash = g_str_hash(pub->channel);
+    pub->iface = num_hashed ? hashed[hash % num_hashed] : (int) (hash % num_ifaces);
+    return pub->iface;
+}
+
+// Encodes a message on a channel of the delta option, as its differences from
+// base, the previous message on the channel, or as a keyframe every
+// delta_keyframe messages, after a message of another size, or when the delta
+// would not be smaller.  Returns the payload, to be released with free().
+// delta_lock must be held.
+static char *udpm_delta_encode(lcm_udpm_t *lcm, udpm_delta_base_t *base, const void *data,
+                               unsigned int datalen, uint32_t *payload_size)
+{
+    char *payload = NULL;
+    if (base->data && base->size == datalen &&
+        base->since_keyframe + 1 < lcm->params.delta_keyframe)
+        payload = lcm_delta_encode(data, datalen, base->data, base->seqno, payload_size);
+    if (payload) {
+        base->since_keyframe++;
+        return payload;
+    }
+    base->since_keyframe = 0;
+    return lcm_delta_keyframe(data, datalen, payload_size);
+}
+
+// Keeps a message that was sent with sequence number seqno, on a channel of
+// the delta option, for the delta of the next one.  A message that could not
+// be sent is not kept, so that the next one is a keyframe.  delta_lock must
+// be held.
+static void udpm_delta_sent(udpm_delta_base_t *base, const void *data, unsigned int datalen,
+                            uint32_t seqno, int sent)
+{
+    if (!sent) {
+        free(base->data);
+        base->data = NULL;
+        base->size = 0;
+        return;
+    }
+    if (!base->data || base->size != datalen) {
+        free(base->data);
+        base->data = (char *) malloc(datalen);
+        base->size = datalen;
+    }
+    memcpy(base->data, data, datalen);
+    base->seqno = seqno;
+}
+
+// the last message published on a channel of the latch option
+typedef struct {
+    char *channel;
+    char *data;
+    unsigned int datalen;
+    // interest id -> how many of the channel patterns of that instance matched
+    // the channel when it was last looked at
+    GHashTable *matches;
+} udpm_latched_t;
+
+static void udpm_latched_free(gpointer data)
+{
+    udpm_latched_t *latched = (udpm_latched_t *) data;
+    g_hash_table_destroy(latched->matches);
+    free(latched->channel);
+    free(latched->data);
+    free(latched);
+}
+
+// keeps a message published on a channel of the latch option
+static void udpm_latch_store(lcm_udpm_t *lcm, const char *channel, const lcm_iovec_t *iov,
+                             int iovcnt, unsigned int datalen)
+{
+    g_mutex_lock(&lcm->latch_lock);
+    udpm_latched_t *latched = (udpm_latched_t *) g_hash_table_lookup(lcm->latched, channel);
+    if (!latched) {
+        latched = (udpm_latched_t *) calloc(1, sizeof(udpm_latched_t));
+        latched->channel = strdup(channel);
+        latched->matches = g_hash_table_new(g_direct_hash, g_direct_equal);
+        g_hash_table_insert(lcm->latched, latched->channel, latched);
+    }
+    free(latched->data);
+    latched->data = lcm_iov_gather(iov, iovcnt, datalen);
+    latched->datalen = datalen;
+    g_mutex_unlock(&lcm->latch_lock);
+}
+
+static int udpm_transmit_publisher(lcm_udpm_t *lcm, udpm_publisher_t *pub, const void *data,
+                                   unsigned int datalen);
+
+// Sends the latched messages on the channels that the instance with id has
+// a new subscription to again.  Called by the interest thread when the
+// announcements of the instance change.
+static void udpm_latch_replay(lcm_udpm_t *lcm, uint32_t id)
+{
+    gpointer key = GUINT_TO_POINTER(id);
+    g_mutex_lock(&lcm->latch_lock);
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, lcm->latched);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        udpm_latched_t *latched = (udpm_latched_t *) value;
+        int num_matches = lcm_interest_num_matches(lcm->interest, id, latched->channel);
+        int had_matches = GPOINTER_TO_INT(g_hash_table_lookup(latched->matches, key));
+        if (num_matches)
+            g_hash_table_replace(latched->matches, key, GINT_TO_POINTER(num_matches));
+        else
+            g_hash_table_remove(latched->matches, key);
+        if (num_matches <= had_matches)
+            continue;
+
+        udpm_publisher_t pub;
+        udpm_publisher_init(&pub, latched->channel);
+        pub.latch = 0;  // already kept, and latch_lock is held
+        dbg(DBG_LCM, "LCM: sending latched [%s] again\n", latched->channel);
+        udpm_transmit_publisher(lcm, &pub, latched->data, latched->datalen);
     }
+    g_mutex_unlock(&lcm->latch_lock);
+}
 
+// sends a message, made up of the iovcnt pieces of iov, to the multicast group
+static int udpm_transmit_iov(lcm_udpm_t *lcm, udpm_publisher_t *pub, const lcm_iovec_t *iov,
+                             int iovcnt, unsigned int datalen)
+{
+    // kept before it is sent, so that a replay never sends an older one after it
+    if (udpm_publisher_matches(pub, lcm->params.latch_re, &pub->latch))
+        udpm_latch_store(lcm, pub->channel, iov, iovcnt, datalen);
+
+    const char *channel = pub->channel;
+    int channel_size = pub->channel_size;
+    int iface = udpm_publisher_iface(lcm, pub);
+
+    int bundle_space = lcm->params.bundle_size - (int) sizeof(lcm2_header_short_t) -
+                       channel_size - LCM2_BUNDLE_ENTRY_OVERHEAD;
+    int is_bundled = bundle_space >= 0 && datalen <= (unsigned int) bundle_space && pub->bundle;
     int payload_size = channel_size + 1 + datalen;
-    if (payload_size <= LCM_SHORT_MESSAGE_MAX_SIZE) {
+    int is_short = payload_size <= lcm->params.packet_size - (int) sizeof(lcm2_header_short_t);
+
+    // bundling, and the options that work on the whole of a large message,
+    // need it in one buffer
+    char *gathered = NULL;
+    lcm_iovec_t whole;
+    if (iovcnt > 1 &&
+        (is_bundled || iovcnt > LCM_MAX_PUBLISHV_IOVS ||
+         (!is_short && (lcm->params.fec_group > 0 ||
+                        udpm_publisher_matches(pub, lcm->params.delta_re, &pub->delta) ||
+                        udpm_publisher_matches(pub, lcm->params.compress_re, &pub->compress) ||
+                        udpm_publisher_matches(pub, lcm->params.retransmit_re,
+                                               &pub->retransmit))))) {
+        gathered = lcm_iov_gather(iov, iovcnt, datalen);
+        whole.data = gathered;
+        whole.len = datalen;
+        iov = &whole;
+        iovcnt = 1;
+    }
+    // the whole message, if it is in one buffer
+    const void *data = iov[0].data;
+
+    // short messages are collected into bundle packets.  The self test
+    // message has to make it back on its own.
+    if (is_bundled) {
+        int status = udpm_bundle_append(lcm, iface, channel, channel_size, data, datalen);
+        free(gathered);
+        return status;
+    }
+
+    // large messages on the channels of the delta option are sent as their
+    // differences from the previous message on the channel.  Those of the
+    // compress option are sent compressed, unless that doesn't make them any
+    // smaller.
+    uint32_t magic = LCM2_MAGIC_LONG;
+    char *compressed = NULL;
+    udpm_delta_base_t *delta = NULL;
+    const void *message = data;
+    unsigned int message_size = datalen;
+    if (!is_short && udpm_publisher_matches(pub, lcm->params.delta_re, &pub->delta)) {
+        g_mutex_lock(&lcm->delta_lock);
+        delta = (udpm_delta_base_t *) g_hash_table_lookup(lcm->delta_bases, channel);
+        if (!delta) {
+            delta = (udpm_delta_base_t *) calloc(1, sizeof(udpm_delta_base_t));
+            g_hash_table_insert(lcm->delta_bases, g_strdup(channel), delta);
+        }
+        uint32_t encoded_size;
+        compressed = udpm_delta_encode(lcm, delta, data, datalen, &encoded_size);
+        dbg(DBG_LCM_MSG, "encoded %d byte [%s] payload as a %s of %d bytes\n", datalen, channel,
+            delta->since_keyframe ? "delta" : "keyframe", encoded_size);
+        magic = LCM2_MAGIC_LONG_DELTA;
+        data = compressed;
+        datalen = encoded_size;
+        payload_size = channel_size + 1 + datalen;
+        whole.data = data;
+        whole.len = datalen;
+        iov = &whole;
+    } else if (!is_short &&
+               udpm_publisher_matches(pub, lcm->params.compress_re, &pub->compress)) {
+        uint32_t compressed_size;
+        compressed = lcm_compress_payload(data, datalen, &compressed_size);
+        if (compressed) {
+            dbg(DBG_LCM_MSG, "compressed %d byte [%s] payload to %d bytes\n", datalen, channel,
+                compressed_size);
+            magic = LCM2_MAGIC_LONG_LZ4;
+            data = compressed;
+            datalen = compressed_size;
+            payload_size = channel_size + 1 + datalen;
+            whole.data = data;
+            whole.len = datalen;
+            iov = &whole;
+        }
+    }
+
+    if (is_short) {
         // message is short.  send in a single packet
 
         g_mutex_lock(&lcm->transmit_lock);
+        udpm_use_iface(lcm, iface);
+        // messages stay in order with those that were bundled
+        udpm_flush_bundle(lcm);
 
         lcm2_header_short_t hdr;
         hdr.magic = htonl(LCM2_MAGIC_SHORT);
         hdr.msg_seqno = htonl(lcm->msg_seqno);
 
-        struct iovec sendbufs[3];
+        struct iovec sendbufs[2 + LCM_MAX_PUBLISHV_IOVS];
         sendbufs[0].iov_base = (char *) &hdr;
         sendbufs[0].iov_len = sizeof(hdr);
         sendbufs[1].iov_base = (char *) channel;
         sendbufs[1].iov_len = channel_size + 1;
-        sendbufs[2].iov_base = (char *) data;
-        sendbufs[2].iov_len = datalen;
+        int niov = 2 + lcm_iov_slice(iov, iovcnt, 0, datalen, sendbufs + 2);
 
         // transmit
         int packet_size = datalen + sizeof(hdr) + channel_size + 1;
@@ -619,17 +3929,17 @@ static int lcm_udpm_publish(lcm_udpm_t *lcm, const char *channel, const void *da
 
         //        int status = writev (lcm->sendfd, sendbufs, 3);
         struct msghdr msg;
-        msg.msg_name = (struct sockaddr *) &lcm->dest_addr;
-        msg.msg_namelen = sizeof(lcm->dest_addr);
         msg.msg_iov = sendbufs;
-        msg.msg_iovlen = 3;
+        msg.msg_iovlen = niov;
         msg.msg_control = NULL;
         msg.msg_controllen = 0;
         msg.msg_flags = 0;
-        int status = sendmsg(lcm->sendfd, &msg, 0);
+        int status = udpm_sendmsg(lcm, &msg, packet_size);
+        LCM_TRACE(udpm_send_packet, channel, lcm->msg_seqno, 0, 1, packet_size);
 
         lcm->msg_seqno++;
         g_mutex_unlock(&lcm->transmit_lock);
+        free(gathered);
 
         if (status == packet_size)
             return 0;
@@ -638,11 +3948,20 @@ static int lcm_udpm_publish(lcm_udpm_t *lcm, const char *channel, const void *da
     } else {
         // message is large.  fragment into multiple packets
 
-        int fragment_size = LCM_FRAGMENT_MAX_PAYLOAD;
+        // parity packets also hold the channel name, and have to fit too
+        int fragment_size = lcm->params.packet_size - sizeof(lcm2_header_long_t);
+        if (lcm->params.fec_group > 0)
+            fragment_size -= sizeof(lcm2_header_parity_t) + channel_size + 1;
         int nfragments = payload_size / fragment_size + !!(payload_size % fragment_size);
 
         if (nfragments > 65535) {
             fprintf(stderr, "LCM error: too much data for a single message\n");
+            if (delta) {
+                udpm_delta_sent(delta, message, message_size, 0, 0);
+                g_mutex_unlock(&lcm->delta_lock);
+            }
+            free(compressed);
+            free(gathered);
             return -1;
         }
 
@@ -650,133 +3969,659 @@ static int lcm_udpm_publish(lcm_udpm_t *lcm, const char *channel, const void *da
         // together, and so that no other message uses the same sequence number
         // (at least until the sequence # rolls over)
         g_mutex_lock(&lcm->transmit_lock);
+        udpm_use_iface(lcm, iface);
+        udpm_flush_bundle(lcm);
         dbg(DBG_LCM_MSG, "transmitting %d byte [%s] payload in %d fragments\n", payload_size,
             channel, nfragments);
 
-        uint32_t fragment_offset = 0;
-
         lcm2_header_long_t hdr;
-        hdr.magic = htonl(LCM2_MAGIC_LONG);
+        hdr.magic = htonl(magic);
         hdr.msg_seqno = htonl(lcm->msg_seqno);
         hdr.msg_size = htonl(datalen);
         hdr.fragment_offset = 0;
         hdr.fragment_no = 0;
         hdr.fragments_in_msg = htons(nfragments);
 
-        // first fragment is special.  insert channel before data
-        int firstfrag_datasize = fragment_size - (channel_size + 1);
-        assert(firstfrag_datasize <= datalen);
+#ifdef USE_SENDMMSG
+        int status = udpm_send_fragments(lcm, &hdr, channel, channel_size, iov, iovcnt, datalen,
+                                         fragment_size, nfragments);
+#else
+        // first fragment is special.  insert channel before data.  A
+        // compressed message may fit in it entirely.
+        int firstfrag_datasize = MIN(fragment_size - (channel_size + 1), (int) datalen);
+        uint32_t fragment_offset = 0;
 
-        struct iovec first_sendbufs[3];
+        struct iovec first_sendbufs[2 + LCM_MAX_PUBLISHV_IOVS];
         first_sendbufs[0].iov_base = (char *) &hdr;
         first_sendbufs[0].iov_len = sizeof(hdr);
         first_sendbufs[1].iov_base = (char *) channel;
         first_sendbufs[1].iov_len = channel_size + 1;
-        first_sendbufs[2].iov_base = (char *) data;
-        first_sendbufs[2].iov_len = firstfrag_datasize;
+        int niov = 2 + lcm_iov_slice(iov, iovcnt, 0, firstfrag_datasize, first_sendbufs + 2);
 
         int packet_size = sizeof(hdr) + channel_size + 1 + firstfrag_datasize;
         fragment_offset += firstfrag_datasize;
         //        int status = writev (lcm->sendfd, first_sendbufs, 3);
         struct msghdr msg;
-        msg.msg_name = (struct sockaddr *) &lcm->dest_addr;
-        msg.msg_namelen = sizeof(lcm->dest_addr);
         msg.msg_iov = first_sendbufs;
-        msg.msg_iovlen = 3;
+        msg.msg_iovlen = niov;
         msg.msg_control = NULL;
         msg.msg_controllen = 0;
         msg.msg_flags = 0;
-        int status = sendmsg(lcm->sendfd, &msg, 0);
+        int status = udpm_sendmsg(lcm, &msg, packet_size);
+        LCM_TRACE(udpm_send_packet, channel, lcm->msg_seqno, 0, nfragments, packet_size);
 
         // transmit the rest of the fragments
         for (uint16_t frag_no = 1; packet_size == status && frag_no < nfragments; frag_no++) {
             hdr.fragment_offset = htonl(fragment_offset);
             hdr.fragment_no = htons(frag_no);
 
-            int fraglen = MIN(fragment_size, datalen - fragment_offset);
+            int fraglen = MIN(fragment_size, datalen - fragment_offset);
+
+            struct iovec sendbufs[1 + LCM_MAX_PUBLISHV_IOVS];
+            sendbufs[0].iov_base = (char *) &hdr;
+            sendbufs[0].iov_len = sizeof(hdr);
+            niov = 1 + lcm_iov_slice(iov, iovcnt, fragment_offset, fraglen, sendbufs + 1);
+
+            //            status = writev (lcm->sendfd, sendbufs, 2);
+            msg.msg_iov = sendbufs;
+            msg.msg_iovlen = niov;
+            status = udpm_sendmsg(lcm, &msg, (int) (sizeof(hdr) + fraglen));
+            LCM_TRACE(udpm_send_packet, channel, lcm->msg_seqno, frag_no, nfragments,
+                      (int) (sizeof(hdr) + fraglen));
+
+            fragment_offset += fraglen;
+            packet_size = sizeof(hdr) + fraglen;
+        }
+
+        // sanity check
+        if (0 == status) {
+            assert(fragment_offset == datalen);
+        }
+        status = packet_size == status ? 0 : -1;
+#endif
+
+        if (status == 0 && lcm->params.fec_group > 0)
+            udpm_send_parity(lcm, &hdr, channel, channel_size, data, datalen, fragment_size,
+                             nfragments);
+        if (udpm_publisher_matches(pub, lcm->params.retransmit_re, &pub->retransmit))
+            udpm_retain_message(lcm, &hdr, channel, channel_size, data, datalen, fragment_size);
+        if (delta)
+            udpm_delta_sent(delta, message, message_size, lcm->msg_seqno, status == 0);
+
+        lcm->msg_seqno++;
+        g_mutex_unlock(&lcm->transmit_lock);
+        if (delta)
+            g_mutex_unlock(&lcm->delta_lock);
+        free(compressed);
+        free(gathered);
+    }
+
+    return 0;
+}
+
+static int udpm_transmit_publisher(lcm_udpm_t *lcm, udpm_publisher_t *pub, const void *data,
+                                   unsigned int datalen)
+{
+    lcm_iovec_t iov;
+    iov.data = data;
+    iov.len = datalen;
+    return udpm_transmit_iov(lcm, pub, &iov, 1, datalen);
+}
+
+static int udpm_transmit(lcm_udpm_t *lcm, const char *channel, const void *data,
+                         unsigned int datalen)
+{
+    udpm_publisher_t pub;
+    if (udpm_publisher_init(&pub, channel) < 0)
+        return -1;
+    return udpm_transmit_publisher(lcm, &pub, data, datalen);
+}
+
+// queues a copy of a published message for the subscribers of this instance
+static void udpm_deliver_local(lcm_udpm_t *lcm, const char *channel, const void *data,
+                               unsigned int datalen)
+{
+    // counted against the queue limits right away, like a received message
+    if (!lcm_try_enqueue_message(lcm->lcm, channel))
+        return;
+
+    int channel_size = strlen(channel);
+    udpm_local_msg_t *msg =
+        (udpm_local_msg_t *) malloc(sizeof(udpm_local_msg_t) + channel_size + 1 + datalen);
+    msg->channel = (char *) (msg + 1);
+    memcpy(msg->channel, channel, channel_size + 1);
+    msg->rbuf.data = msg->channel + channel_size + 1;
+    memcpy(msg->rbuf.data, data, datalen);
+    msg->rbuf.data_size = datalen;
+    msg->rbuf.recv_utime = g_get_real_time();
+    msg->rbuf.recv_time_ns = msg->rbuf.recv_utime * 1000;
+    msg->rbuf.recv_mono_ns = lcm_monotonic_ns();
+    msg->rbuf.lcm = lcm->lcm;
+
+    g_mutex_lock(&lcm->local_lock);
+    int was_empty = g_queue_is_empty(lcm->local_queue);
+    g_queue_push_tail(lcm->local_queue, msg);
+    g_mutex_unlock(&lcm->local_lock);
+    if (was_empty)
+        udpm_notify(lcm);
+}
+
+static int lcm_udpm_publish(lcm_udpm_t *lcm, const char *channel, const void *data,
+                            unsigned int datalen)
+{
+    int status = udpm_transmit(lcm, channel, data, datalen);
+    if (status == 0 && lcm->params.local_delivery)
+        udpm_deliver_local(lcm, channel, data, datalen);
+    return status;
+}
+
+static void *lcm_udpm_publisher_create(lcm_udpm_t *lcm, const char *channel)
+{
+    udpm_publisher_t *pub = (udpm_publisher_t *) malloc(sizeof(udpm_publisher_t));
+    if (udpm_publisher_init(pub, channel) < 0) {
+        free(pub);
+        return NULL;
+    }
+    udpm_publisher_matches(pub, lcm->params.compress_re, &pub->compress);
+    udpm_publisher_matches(pub, lcm->params.delta_re, &pub->delta);
+    udpm_publisher_matches(pub, lcm->params.retransmit_re, &pub->retransmit);
+    udpm_publisher_matches(pub, lcm->params.latch_re, &pub->latch);
+    return pub;
+}
+
+static int lcm_udpm_publisher_publish(lcm_udpm_t *lcm, void *publisher, const void *data,
+                                      unsigned int datalen)
+{
+    udpm_publisher_t *pub = (udpm_publisher_t *) publisher;
+    if (!udpm_publisher_interested(lcm, pub)) {
+        // kept for the instances that subscribe later
+        if (udpm_publisher_matches(pub, lcm->params.latch_re, &pub->latch)) {
+            lcm_iovec_t iov;
+            iov.data = data;
+            iov.len = datalen;
+            udpm_latch_store(lcm, pub->channel, &iov, 1, datalen);
+        }
+        dbg(DBG_LCM, "Publishing [%s] size [%d] - dropping (no subscribers)\n", pub->channel,
+            datalen);
+        return 0;
+    }
+    int status = udpm_transmit_publisher(lcm, pub, data, datalen);
+    if (status == 0 && lcm->params.local_delivery)
+        udpm_deliver_local(lcm, pub->channel, data, datalen);
+    return status;
+}
+
+static int lcm_udpm_publisher_has_subscribers(lcm_udpm_t *lcm, void *publisher)
+{
+    return udpm_publisher_interested(lcm, (udpm_publisher_t *) publisher);
+}
+
+static void lcm_udpm_publisher_destroy(lcm_udpm_t *lcm, void *publisher)
+{
+    (void) lcm;
+    free(publisher);
+}
+
+static int lcm_udpm_publishv(lcm_udpm_t *lcm, const char *channel, const lcm_iovec_t *iov,
+                             int iovcnt, unsigned int datalen)
+{
+    udpm_publisher_t pub;
+    if (udpm_publisher_init(&pub, channel) < 0)
+        return -1;
+    int status = udpm_transmit_iov(lcm, &pub, iov, iovcnt, datalen);
+    if (status == 0 && lcm->params.local_delivery) {
+        char *data = lcm_iov_gather(iov, iovcnt, datalen);
+        udpm_deliver_local(lcm, channel, data, datalen);
+        free(data);
+    }
+    return status;
+}
+
+#ifdef USE_SENDMMSG
+// whether a message is sent in a single datagram of its own, which is how
+// lcm_udpm_publish_batch() sends it
+static int udpm_is_single_datagram(lcm_udpm_t *lcm, const lcm_publish_msg_t *msg)
+{
+    if (lcm->params.bundle_size > 0 || lcm->params.local_delivery || udpm_is_paced(lcm) ||
+        lcm->params.num_ifaces)
+        return 0;
+    if (lcm->params.latch_re &&
+        g_regex_match(lcm->params.latch_re, msg->channel, (GRegexMatchFlags) 0, NULL))
+        return 0;
+    int channel_size = strlen(msg->channel);
+    return channel_size <= LCM_MAX_CHANNEL_NAME_LENGTH &&
+           channel_size + 1 + msg->datalen <=
+               lcm->params.packet_size - (int) sizeof(lcm2_header_short_t);
+}
+
+// Publishes the messages in order, sending each run of messages that take up
+// a datagram each with as few sendmmsg() calls as possible.  The others are
+// published one at a time.
+static int lcm_udpm_publish_batch(lcm_udpm_t *lcm, const lcm_publish_msg_t *msgs, int num_msgs)
+{
+    lcm2_header_short_t hdrs[UDPM_SENDMMSG_BATCH];
+    struct iovec iovs[UDPM_SENDMMSG_BATCH][3];
+    struct mmsghdr mmsgs[UDPM_SENDMMSG_BATCH];
+    int status = 0;
+
+    for (int i = 0; i < num_msgs;) {
+        int n = 0;
+        while (n < UDPM_SENDMMSG_BATCH && i + n < num_msgs &&
+               udpm_is_single_datagram(lcm, &msgs[i + n]))
+            n++;
+        if (n == 0) {
+            if (0 != lcm_udpm_publish(lcm, msgs[i].channel, msgs[i].data, msgs[i].datalen))
+                status = -1;
+            i++;
+            continue;
+        }
+
+        g_mutex_lock(&lcm->transmit_lock);
+        for (int j = 0; j < n; j++) {
+            const lcm_publish_msg_t *msg = &msgs[i + j];
+            hdrs[j].magic = htonl(LCM2_MAGIC_SHORT);
+            hdrs[j].msg_seqno = htonl(lcm->msg_seqno++);
+            iovs[j][0].iov_base = (char *) &hdrs[j];
+            iovs[j][0].iov_len = sizeof(lcm2_header_short_t);
+            iovs[j][1].iov_base = (char *) msg->channel;
+            iovs[j][1].iov_len = strlen(msg->channel) + 1;
+            iovs[j][2].iov_base = (char *) msg->data;
+            iovs[j][2].iov_len = msg->datalen;
+
+            memset(&mmsgs[j], 0, sizeof(struct mmsghdr));
+            mmsgs[j].msg_hdr.msg_iov = iovs[j];
+            mmsgs[j].msg_hdr.msg_iovlen = 3;
+        }
+        dbg(DBG_LCM_MSG, "transmitting %d messages with sendmmsg\n", n);
+
+        if (udpm_sendmmsg(lcm, mmsgs, n) < 0)
+            status = -1;
+        g_mutex_unlock(&lcm->transmit_lock);
+        i += n;
+    }
+    return status;
+}
+#endif
+
+// transmits the messages in the send queue, until told to exit and the queue
+// is empty
+static void *send_thread(void *user)
+{
+    lcm_udpm_t *lcm = (lcm_udpm_t *) user;
+    g_mutex_lock(&lcm->send_lock);
+    while (1) {
+        while (!lcm->send_head && !lcm->send_exit)
+            g_cond_wait(&lcm->send_cond, &lcm->send_lock);
+        udpm_send_msg_t *msg = lcm->send_head;
+        if (!msg)
+            break;
+
+        // the message stays at the head of the queue, so that publishers
+        // can't reuse its memory while it is transmitted
+        g_mutex_unlock(&lcm->send_lock);
+        lcm_udpm_publish(lcm, msg->channel, msg->data, msg->datalen);
+        if (msg->release)
+            msg->release(msg->data, msg->release_user);
+        g_mutex_lock(&lcm->send_lock);
+
+        lcm->send_head = msg->next;
+        if (!lcm->send_head)
+            lcm->send_tail = NULL;
+        lcm_ringbuf_dealloc(lcm->send_ring, (char *) msg);
+        g_cond_broadcast(&lcm->send_space_cond);
+    }
+    g_mutex_unlock(&lcm->send_lock);
+    return NULL;
+}
+
+static int lcm_udpm_publish_async(lcm_udpm_t *lcm, const char *channel, void *data,
+                                  unsigned int datalen, lcm_buffer_release_t release, void *user)
+{
+    if (!lcm->send_ring) {
+        int status = lcm_udpm_publish(lcm, channel, data, datalen);
+        if (release)
+            release(data, user);
+        return status;
+    }
+
+    int channel_size = strlen(channel);
+    if (channel_size > LCM_MAX_CHANNEL_NAME_LENGTH) {
+        fprintf(stderr, "LCM Error: channel name too long [%s]\n", channel);
+        goto fail;
+    }
+    // the payload is copied unless the publisher hands over its buffer
+    unsigned int copylen = release ? 0 : datalen;
+    unsigned int size = sizeof(udpm_send_msg_t) + channel_size + 1 + copylen;
+    // leave room for the ringbuffer's own bookkeeping, so that a message that
+    // is accepted here fits once the queue is empty
+    if (datalen > LCM_MAX_MESSAGE_SIZE || size + 64 > lcm_ringbuf_capacity(lcm->send_ring)) {
+        fprintf(stderr, "LCM Error: message too large for the send queue [%s]\n", channel);
+        goto fail;
+    }
+
+    // the message is copied and queued under the lock, since the queue must
+    // stay in the same order as the ringbuffer
+    g_mutex_lock(&lcm->send_lock);
+    udpm_send_msg_t *msg;
+    while (!(msg = (udpm_send_msg_t *) lcm_ringbuf_alloc(lcm->send_ring, size))) {
+        if (lcm->params.send_drop) {
+            g_mutex_unlock(&lcm->send_lock);
+            dbg(DBG_LCM, "send queue full, dropping [%s]\n", channel);
+            goto fail;
+        }
+        g_cond_wait(&lcm->send_space_cond, &lcm->send_lock);
+    }
+    memcpy(msg->channel, channel, channel_size + 1);
+    if (release) {
+        msg->data = data;
+    } else {
+        msg->data = msg->channel + channel_size + 1;
+        memcpy(msg->data, data, datalen);
+    }
+    msg->datalen = datalen;
+    msg->release = release;
+    msg->release_user = user;
+    msg->next = NULL;
+    if (lcm->send_tail) {
+        lcm->send_tail->next = msg;
+    } else {
+        lcm->send_head = msg;
+        g_cond_signal(&lcm->send_cond);
+    }
+    lcm->send_tail = msg;
+    g_mutex_unlock(&lcm->send_lock);
+    return 0;
+
+fail:
+    if (release)
+        release(data, user);
+    return -1;
+}
+
+// take the next received message of the highest priority class from any of
+// the read threads, taking turns between them.  Stores the thread that the
+// message came from in owner.
+static lcm_buf_t *udpm_pop_filled(lcm_udpm_t *lcm, udpm_recv_thread_t **owner)
+{
+    // the rest of a partly dispatched bundle packet goes first
+    if (lcm->bundle_pending) {
+        lcm_buf_t *lcmb = lcm->bundle_pending;
+        *owner = lcm->bundle_pending_owner;
+        lcm->bundle_pending = NULL;
+        return lcmb;
+    }
+
+    int priority, i;
+    for (priority = LCM_MAX_PRIORITY; priority >= 0; priority--) {
+        for (i = 0; i < lcm->num_recv_threads; i++) {
+            udpm_recv_thread_t *rt = &lcm->recv_threads[lcm->next_recv_thread];
+            lcm->next_recv_thread = (lcm->next_recv_thread + 1) % lcm->num_recv_threads;
+
+            lcm_buf_t *lcmb = lcm_buf_ring_pop(rt->inbufs_filled[priority]);
+            if (lcmb) {
+                LCM_TRACE(udpm_dequeue, lcmb->num_bundled ? "" : lcmb->channel_name,
+                          (int) lcmb->data_size, priority, lcmb->num_bundled);
+                *owner = rt;
+                return lcmb;
+            }
+        }
+    }
+    return NULL;
+}
+
+static int udpm_any_filled(lcm_udpm_t *lcm)
+{
+    if (lcm->bundle_pending)
+        return 1;
+    int priority, i;
+    for (priority = 0; priority <= LCM_MAX_PRIORITY; priority++) {
+        for (i = 0; i < lcm->num_recv_threads; i++) {
+            if (!lcm_buf_ring_is_empty(lcm->recv_threads[i].inbufs_filled[priority]))
+                return 1;
+        }
+    }
+    return 0;
+}
+
+// channel_id is from lcm_intern_channel(), or -1.  The handlers may retain
+// lcmb, which holds the message.
+static void udpm_dispatch_message(lcm_udpm_t *lcm, lcm_recv_buf_t *rbuf, int channel_id,
+                                  const char *channel, lcm_buf_t *lcmb)
+{
+    // special case:  If we're creating the read thread and are in self-test
+    // mode, then only dispatch the self-test message.
+    if (lcm->creating_read_thread && strcmp(channel, SELF_TEST_CHANNEL))
+        return;
+    lcm_dispatch_channel_handlers(lcm->lcm, rbuf, channel_id, channel, &lcm_buf_lender, lcmb);
+}
+
+// Dispatches up to max_msgs of the messages in lcmb, and hands lcmb back to
+// its read thread once all of them have been dispatched.  The rest of a bundle
+// packet that has more messages is kept in bundle_pending for the next call.
+// Returns the number of messages dispatched.
+static int udpm_dispatch(lcm_udpm_t *lcm, udpm_recv_thread_t *owner, lcm_buf_t *lcmb,
+                         int max_msgs)
+{
+    lcm_recv_buf_t rbuf;
+    rbuf.data = (uint8_t *) lcmb->buf + lcmb->data_offset;
+    rbuf.data_size = lcmb->data_size;
+    rbuf.recv_utime = lcmb->recv_utime;
+    rbuf.lcm = lcm->lcm;
+    rbuf.recv_time_ns = lcmb->recv_time_ns;
+    rbuf.recv_mono_ns = lcmb->recv_mono_ns;
+    lcm_buf_lend(lcmb, &owner->returns);
+
+    int ndispatched = 0;
+    if (!lcmb->num_bundled) {
+        udpm_dispatch_message(lcm, &rbuf, lcmb->channel_id, lcmb->channel_name, lcmb);
+        ndispatched = 1;
+    } else {
+        // the messages were checked by _recv_bundle(), which also marked the
+        // ones that are not kept.  The members of a udpm_shared_t dispatch all
+        // of them at once, since the others dispatch the same lcmb.
+        char *p = lcmb->buf + lcmb->data_offset;
+        char *end = p + lcmb->data_size;
+        int num_bundled = lcmb->num_bundled;
+        if (lcm->shared)
+            max_msgs = INT_MAX;
+        while (num_bundled && ndispatched < max_msgs) {
+            char *data;
+            char *next = _bundle_next(p, end, &data, &rbuf.data_size);
+            rbuf.data = data;
+            if (!_bundle_is_skipped(data)) {
+                udpm_dispatch_message(lcm, &rbuf, -1, p, lcmb);
+                ndispatched++;
+            }
+            num_bundled--;
+            p = next;
+        }
+        if (num_bundled) {
+            lcmb->data_offset = p - lcmb->buf;
+            lcmb->data_size = end - p;
+            lcmb->num_bundled = num_bundled;
+            lcm->bundle_pending = lcmb;
+            lcm->bundle_pending_owner = owner;
+            return ndispatched;
+        }
+    }
+
+    // which hands it back to the hub once the other members are done too
+    if (lcm->shared) {
+        lcm_buf_lender.release(lcmb);
+        return ndispatched;
+    }
+    if (!lcm_buf_lend_end(lcmb))
+        return ndispatched;
+
+    /* Hand the buffer back to the read thread, which owns the ringbuffer.
+     * This never fails: the read thread reclaims every handled buffer before
+     * it allocates new ones, so inbufs_done never holds more than all of the
+     * inbufs_filled queues worth of buffers plus one batch, and it is sized
+     * for that.
+     */
+    int status = lcm_buf_ring_push(owner->inbufs_done, lcmb);
+    assert(status >= 0);
+    (void) status;
+    return ndispatched;
+}
 
-            struct iovec sendbufs[2];
-            sendbufs[0].iov_base = (char *) &hdr;
-            sendbufs[0].iov_len = sizeof(hdr);
-            sendbufs[1].iov_base = (char *) ((char *) data + fragment_offset);
-            sendbufs[1].iov_len = fraglen;
+// block until fd is readable.  Returns 0 once it is, or -1 on error.
+static int udpm_wait_readable(SOCKET fd)
+{
+    while (1) {
+        fd_set readfds;
+        FD_ZERO(&readfds);
+        FD_SET(fd, &readfds);
+        int status = select(fd + 1, &readfds, NULL, NULL, NULL);
+        if (status > 0)
+            return 0;
+        if (status < 0 && errno != EINTR) {
+            perror("udpm_wait_readable -- select");
+            return -1;
+        }
+    }
+}
 
-            //            status = writev (lcm->sendfd, sendbufs, 2);
-            msg.msg_iov = sendbufs;
-            msg.msg_iovlen = 2;
-            status = sendmsg(lcm->sendfd, &msg, 0);
+// With recv_threads=0, messages are read from the socket and dispatched by
+// the thread calling lcm_handle(), without a read thread or notification in
+// between.  The socket is busy polled for up to busy_poll microseconds before
+// blocking.  Returns without dispatching anything if only part of a
+// fragmented message was waiting.
+static int udpm_handle_direct(lcm_udpm_t *lcm, int max_msgs)
+{
+    udpm_recv_thread_t *rt = &lcm->recv_threads[0];
+    lcm_buf_t *lcmb = NULL;
+    int nhandled = 0;
+    int nread = 0;
+    int64_t spin_end = 0;
 
-            fragment_offset += fraglen;
-            packet_size = sizeof(hdr) + fraglen;
+    while (nhandled < max_msgs) {
+        if (!lcmb) {
+            udp_reclaim_handled(rt);
+            // lcm_handle() can't wait for itself to release ringbuffer space
+            lcmb = lcm_buf_allocate_data(rt->inbufs_empty, &rt->ringbuf, lcm->ringbuf_max);
+            if (!lcmb)
+                break;
         }
 
-        // sanity check
-        if (0 == status) {
-            assert(fragment_offset == datalen);
+        int status = udp_recv_datagram(rt, lcmb);
+        if (status > 0) {
+            // all of a bundle packet, since nothing would wake up the next
+            // call for the rest of it
+            nhandled += udpm_dispatch(lcm, rt, lcmb, INT_MAX);
+            lcmb = NULL;
+            continue;
+        }
+        if (status == 0) {
+            nread++;
+            continue;
         }
 
-        lcm->msg_seqno++;
-        g_mutex_unlock(&lcm->transmit_lock);
+        // nothing waiting on the socket
+        if (nhandled || nread)
+            break;
+        if (lcm->params.busy_poll > 0) {
+            int64_t now = g_get_monotonic_time();
+            if (!spin_end)
+                spin_end = now + lcm->params.busy_poll;
+            if (now < spin_end)
+                continue;
+        }
+        if (udpm_wait_readable(lcm->recvfd) < 0)
+            break;
+        spin_end = 0;
     }
 
-    return 0;
+    if (lcmb) {
+        lcm_buf_free_data(lcmb, rt->ringbuf);
+        lcm_buf_enqueue(rt->inbufs_empty, lcmb);
+    }
+    udp_reclaim_handled(rt);
+    return nhandled || nread ? nhandled : -1;
 }
 
-static int lcm_udpm_handle(lcm_udpm_t *lcm)
+// Dispatches up to max_msgs messages published on this instance with
+// local_delivery=1.  Messages published by the handlers are left for the next
+// call.  Returns the number of messages dispatched.
+static int udpm_dispatch_local(lcm_udpm_t *lcm, int max_msgs)
 {
-    int status;
-    char ch;
-    if (0 != _setup_recv_parts(lcm))
-        return -1;
+    // not while the self test runs, since it only dispatches its own message
+    if (!lcm->params.local_delivery || lcm->creating_read_thread)
+        return 0;
 
-    /* Read one byte from the notify pipe.  This will block if no packets are
-     * available yet and wake up when they are. */
-    status = lcm_internal_pipe_read(lcm->notify_pipe[0], &ch, 1);
-    if (status == 0) {
-        fprintf(stderr, "Error: lcm_handle read 0 bytes from notify_pipe\n");
-        return -1;
-    } else if (status < 0) {
-        fprintf(stderr, "Error: lcm_handle read: %s\n", strerror(errno));
-        return -1;
+    GQueue batch;
+    g_queue_init(&batch);
+    g_mutex_lock(&lcm->local_lock);
+    while ((int) batch.length < max_msgs && !g_queue_is_empty(lcm->local_queue))
+        g_queue_push_tail(&batch, g_queue_pop_head(lcm->local_queue));
+    g_mutex_unlock(&lcm->local_lock);
+
+    int nhandled = batch.length;
+    udpm_local_msg_t *msg;
+    while ((msg = (udpm_local_msg_t *) g_queue_pop_head(&batch))) {
+        lcm_dispatch_handlers(lcm->lcm, &msg->rbuf, msg->channel);
+        free(msg);
     }
+    return nhandled;
+}
 
-    /* Dequeue the next received packet */
-    g_rec_mutex_lock(&lcm->mutex);
-    lcm_buf_t *lcmb = lcm_buf_dequeue(lcm->inbufs_filled);
+static int udpm_any_local(lcm_udpm_t *lcm)
+{
+    g_mutex_lock(&lcm->local_lock);
+    int any = !g_queue_is_empty(lcm->local_queue);
+    g_mutex_unlock(&lcm->local_lock);
+    return any;
+}
 
-    if (!lcmb) {
-        fprintf(stderr, "Error: no packet available despite getting notification.\n");
-        g_rec_mutex_unlock(&lcm->mutex);
+static int lcm_udpm_handle_batch(lcm_udpm_t *lcm, int max_msgs)
+{
+    if (0 != _setup_recv_parts(lcm))
         return -1;
-    }
 
-    /* If there are still packets in the queue, put something back in the pipe
-     * so that future invocations will get called. */
-    if (!lcm_buf_queue_is_empty(lcm->inbufs_filled))
-        if (lcm_internal_pipe_write(lcm->notify_pipe[1], "+", 1) < 0)
-            perror("write to notify");
-    g_rec_mutex_unlock(&lcm->mutex);
+    if (!lcm->params.recv_threads)
+        return udpm_handle_direct(lcm, max_msgs);
 
-    lcm_recv_buf_t rbuf;
-    rbuf.data = (uint8_t *) lcmb->buf + lcmb->data_offset;
-    rbuf.data_size = lcmb->data_size;
-    rbuf.recv_utime = lcmb->recv_utime;
-    rbuf.lcm = lcm->lcm;
+    udpm_recv_thread_t *owner;
+    lcm_buf_t *lcmb;
+    int nhandled;
+    do {
+        /* Wait for a notification.  This will block if no packets are
+         * available yet and wake up when they are. */
+        if (udpm_notify_consume(lcm) < 0)
+            return -1;
 
-    if (lcm->creating_read_thread) {
-        // special case:  If we're creating the read thread and are in
-        // self-test mode, then only dispatch the self-test message.
-        if (!strcmp(lcmb->channel_name, SELF_TEST_CHANNEL))
-            lcm_dispatch_handlers(lcm->lcm, &rbuf, lcmb->channel_name);
-    } else {
-        lcm_dispatch_handlers(lcm->lcm, &rbuf, lcmb->channel_name);
+        /* Dispatch the messages published here, and dequeue the next
+         * received packet.  The read thread and this function may both leave
+         * a notification for the same packet, so a notification without a
+         * packet is possible, and just means that we have to wait again. */
+        nhandled = udpm_dispatch_local(lcm, max_msgs);
+        lcmb = nhandled < max_msgs ? udpm_pop_filled(lcm, &owner) : NULL;
+    } while (!nhandled && !lcmb);
+
+    /* Dispatch whatever else has already been queued, without waiting for
+     * further notifications. */
+    while (lcmb) {
+        nhandled += udpm_dispatch(lcm, owner, lcmb, max_msgs - nhandled);
+        lcmb = nhandled < max_msgs ? udpm_pop_filled(lcm, &owner) : NULL;
     }
 
-    g_rec_mutex_lock(&lcm->mutex);
-    lcm_buf_free_data(lcmb, lcm->ringbuf);
-    lcm_buf_enqueue(lcm->inbufs_empty, lcmb);
-    g_rec_mutex_unlock(&lcm->mutex);
+    /* If there are still packets in the queue, notify again so that future
+     * invocations will get called. */
+    if (udpm_any_filled(lcm) || (lcm->params.local_delivery && udpm_any_local(lcm)))
+        udpm_notify(lcm);
+
+    return nhandled;
+}
+
+static int lcm_udpm_handle(lcm_udpm_t *lcm)
+{
+    return lcm_udpm_handle_batch(lcm, 1) < 0 ? -1 : 0;
+}
 
+static int lcm_udpm_get_stats(lcm_udpm_t *lcm, lcm_stats_t *stats)
+{
+    // with share=1, only the hub receives
+    lcm_udp_stats_read(lcm->shared ? &lcm->shared->hub->stats : &lcm->stats, stats);
     return 0;
 }
 
@@ -795,7 +4640,7 @@ static int udpm_self_test(lcm_udpm_t *lcm)
 
     // transmit a message
     char *msg = "lcm self test";
-    lcm_udpm_publish(lcm, SELF_TEST_CHANNEL, (uint8_t *) msg, strlen(msg));
+    udpm_transmit(lcm, SELF_TEST_CHANNEL, (uint8_t *) msg, strlen(msg));
 
     // wait 10 seconds for message to be received
     int64_t now, endtime;
@@ -806,7 +4651,7 @@ static int udpm_self_test(lcm_udpm_t *lcm)
     int64_t retransmit_interval = 100 * G_TIME_SPAN_MILLISECOND;
     int64_t next_retransmit = now + retransmit_interval;
 
-    int recvfd = lcm->notify_pipe[0];
+    int recvfd = udpm_fileno(lcm);
 
     do {
         struct timeval selectto;
@@ -819,7 +4664,7 @@ static int udpm_self_test(lcm_udpm_t *lcm)
 
         now = g_get_real_time();
         if (now > next_retransmit) {
-            status = lcm_udpm_publish(lcm, SELF_TEST_CHANNEL, (uint8_t *) msg, strlen(msg));
+            status = udpm_transmit(lcm, SELF_TEST_CHANNEL, (uint8_t *) msg, strlen(msg));
             next_retransmit = now + retransmit_interval;
         }
 
@@ -840,8 +4685,151 @@ static int udpm_self_test(lcm_udpm_t *lcm)
     return (success == 1) ? 0 : -1;
 }
 
+// Runs the self test of self_test=async.  Instead of queueing the self test
+// message for lcm_handle(), the read threads report it with
+// udpm_self_test_received().
+static void *self_test_thread(void *user)
+{
+    lcm_udpm_t *lcm = (lcm_udpm_t *) user;
+    const char *msg = "lcm self test";
+    int64_t endtime = g_get_monotonic_time() + 10 * G_TIME_SPAN_SECOND;
+
+    g_mutex_lock(&lcm->self_test_lock);
+    int64_t now;
+    while (!lcm->self_test_passed && !lcm->self_test_exit &&
+           (now = g_get_monotonic_time()) < endtime) {
+        g_mutex_unlock(&lcm->self_test_lock);
+        udpm_transmit(lcm, SELF_TEST_CHANNEL, msg, strlen(msg));
+        g_mutex_lock(&lcm->self_test_lock);
+        // periodically retransmit, just in case
+        g_cond_wait_until(&lcm->self_test_cond, &lcm->self_test_lock,
+                          MIN(now + 100 * G_TIME_SPAN_MILLISECOND, endtime));
+    }
+    int passed = lcm->self_test_passed;
+    int aborted = lcm->self_test_exit;
+    g_mutex_unlock(&lcm->self_test_lock);
+
+    lcm_udpm_unsubscribe(lcm, SELF_TEST_CHANNEL);
+    if (passed) {
+        dbg(DBG_LCM, "LCM: self test successful\n");
+    } else if (!aborted) {
+        fprintf(stderr,
+                "LCM self test failed!!\n"
+                "Check your routing tables and firewall settings\n");
+        lcm_stat_add(&lcm->stats.self_test_failures, 1);
+    }
+    return NULL;
+}
+
+// Enable per-packet timestamping by the kernel, if available
+static void udpm_enable_timestamps(lcm_udpm_t *lcm)
+{
+#ifdef USE_TIMESTAMPING
+    if (lcm->params.timestamping == UDPM_TIMESTAMPING_HW) {
+        // the NIC must also be configured to timestamp incoming packets, for
+        // example with hwstamp_ctl.  Until it is, software timestamps are used.
+        int flags = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE |
+                    SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+        if (setsockopt(lcm->recvfd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0)
+            return;
+        perror("setsockopt (SOL_SOCKET, SO_TIMESTAMPING)");
+    } else if (lcm->params.timestamping == UDPM_TIMESTAMPING_SW) {
+        int opt = 1;
+        if (setsockopt(lcm->recvfd, SOL_SOCKET, SO_TIMESTAMPNS, &opt, sizeof(opt)) == 0)
+            return;
+        perror("setsockopt (SOL_SOCKET, SO_TIMESTAMPNS)");
+    }
+#endif
+#ifdef SO_TIMESTAMP
+    int opt = 1;
+    setsockopt(lcm->recvfd, SOL_SOCKET, SO_TIMESTAMP, &opt, sizeof(opt));
+#endif
+}
+
+// Have the kernel report how many datagrams it dropped because the socket
+// buffer was full, if it can.  See lcm_get_stats().
+static void udpm_enable_drop_count(lcm_udpm_t *lcm)
+{
+#ifdef SO_RXQ_OVFL
+    int opt = 1;
+    setsockopt(lcm->recvfd, SOL_SOCKET, SO_RXQ_OVFL, &opt, sizeof(opt));
+#endif
+}
+
+static void udpm_enable_busy_poll(lcm_udpm_t *lcm)
+{
+    if (lcm->params.busy_poll <= 0)
+        return;
+#ifdef SO_BUSY_POLL
+    // have the kernel poll the network card while waiting for packets.  This
+    // usually requires CAP_NET_ADMIN, and is only a small part of the latency
+    // saved by busy polling in lcm_handle() with recv_threads=0.
+    if (setsockopt(lcm->recvfd, SOL_SOCKET, SO_BUSY_POLL, &lcm->params.busy_poll,
+                   sizeof(lcm->params.busy_poll)) < 0) {
+        fprintf(stderr, "Warning: Unable to set SO_BUSY_POLL: %s\n", strerror(errno));
+        return;
+    }
+#ifdef SO_PREFER_BUSY_POLL
+    int opt = 1;
+    setsockopt(lcm->recvfd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &opt, sizeof(opt));
+#endif
+#endif
+}
+
+// Starts receiving through the udpm_shared_t of lcm, with a queue for each
+// read thread of its hub.
+static int udpm_shared_join(lcm_udpm_t *lcm)
+{
+    udpm_shared_t *shared = lcm->shared;
+    g_rec_mutex_lock(&lcm->mutex);
+    if (lcm->thread_created) {
+        g_rec_mutex_unlock(&lcm->mutex);
+        return 0;
+    }
+    if (_setup_recv_parts(shared->hub) < 0) {
+        g_rec_mutex_unlock(&lcm->mutex);
+        return -1;
+    }
+
+    g_mutex_lock(&shared->lock);
+    int slot = 0;
+    while (slot < UDPM_MAX_SHARED && shared->members[slot])
+        slot++;
+    if (slot == UDPM_MAX_SHARED) {
+        g_mutex_unlock(&shared->lock);
+        g_rec_mutex_unlock(&lcm->mutex);
+        fprintf(stderr, "Error: more than %d LCM instances share %s\n", UDPM_MAX_SHARED,
+                shared->key);
+        return -1;
+    }
+
+    lcm->num_recv_threads = shared->hub->num_recv_threads;
+    lcm->next_recv_thread = 0;
+    lcm->recv_threads =
+        (udpm_recv_thread_t *) calloc(lcm->num_recv_threads, sizeof(udpm_recv_thread_t));
+    int i, priority;
+    for (i = 0; i < lcm->num_recv_threads; i++) {
+        udpm_recv_thread_t *rt = &lcm->recv_threads[i];
+        rt->lcm = lcm;
+        rt->inbufs_filled[0] = lcm_buf_ring_new(LCM_RECV_QUEUE_SIZE);
+        for (priority = 1; priority <= LCM_MAX_PRIORITY; priority++)
+            rt->inbufs_filled[priority] = lcm_buf_ring_new(LCM_PRIORITY_QUEUE_SIZE);
+    }
+    lcm->share_slot = slot;
+    shared->members[slot] = lcm;
+    shared->num_slots = MAX(shared->num_slots, slot + 1);
+    g_mutex_unlock(&shared->lock);
+
+    lcm->thread_created = 1;
+    g_rec_mutex_unlock(&lcm->mutex);
+    return 0;
+}
+
 static int _setup_recv_parts(lcm_udpm_t *lcm)
 {
+    if (lcm->shared)
+        return udpm_shared_join(lcm);
+
     g_rec_mutex_lock(&lcm->mutex);
 
     // some thread synchronization code to ensure that only one thread sets up the
@@ -887,8 +4875,38 @@ static int _setup_recv_parts(lcm_udpm_t *lcm)
 
     dbg(DBG_LCM, "allocating resources for receiving messages\n");
 
-    // allocate the fragment buffer hashtable
-    lcm->frag_bufs = lcm_frag_buf_store_new(MAX_FRAG_BUF_TOTAL_SIZE, MAX_NUM_FRAG_BUFS);
+    // the read threads allocate from their NUMA node the buffers that they
+    // fill, and the memory that is faulted in up front is bound to it here
+    if (lcm->params.recv_sched.numa_node == LCM_NUMA_NODE_AUTO) {
+        struct in_addr iface_addr;
+        iface_addr.s_addr = INADDR_ANY;
+        if (lcm->params.num_ifaces)
+            iface_addr = lcm->params.ifaces[0].addr;
+        lcm->params.recv_sched.numa_node =
+            lcm_resolve_numa_node(iface_addr, lcm->params.mc_addr);
+        if (lcm->params.recv_sched.numa_node < 0)
+            fprintf(stderr, "Warning: Unable to determine the NUMA node of the interface\n");
+    }
+
+    // allocate the fragment buffer hashtables, splitting the limits between
+    // them.  Use one per read thread so that they rarely contend.
+    int i;
+    lcm->frag_pool = lcm_buf_pool_new(lcm->params.frag_store, lcm->params.align);
+    g_mutex_lock(&lcm->repair_lock);
+    lcm->num_frag_shards = MAX(1, lcm->params.recv_threads);
+    lcm->frag_shards =
+        (udpm_frag_shard_t *) calloc(lcm->num_frag_shards, sizeof(udpm_frag_shard_t));
+    for (i = 0; i < lcm->num_frag_shards; i++) {
+        g_mutex_init(&lcm->frag_shards[i].lock);
+        lcm->frag_shards[i].frag_bufs =
+            lcm_frag_buf_store_new(lcm->params.frag_store / lcm->num_frag_shards,
+                                   MAX(1, lcm->params.max_frag_bufs / lcm->num_frag_shards));
+        lcm->frag_shards[i].senders =
+            g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, free);
+        lcm->frag_shards[i].delta_bases =
+            g_hash_table_new_full(g_str_hash, g_str_equal, g_free, udpm_delta_base_free);
+    }
+    g_mutex_unlock(&lcm->repair_lock);
 
     // allocate multicast socket
     lcm->recvfd = socket(AF_INET, SOCK_DGRAM, 0);
@@ -896,12 +4914,20 @@ static int _setup_recv_parts(lcm_udpm_t *lcm)
         perror("allocating LCM recv socket");
         goto setup_recv_thread_fail;
     }
+#ifdef USE_SOCKET_FILTER
+    udpm_update_channel_filter(lcm);
+#endif
 
     struct sockaddr_in addr;
     memset(&addr, 0, sizeof(addr));
     addr.sin_family = AF_INET;
 #ifndef WIN32
-    addr.sin_addr = lcm->params.mc_addr;
+    // binding to mc_addr keeps out datagrams to other groups on the same port,
+    // but also unicast ones
+    if (lcm->params.unicast)
+        addr.sin_addr.s_addr = INADDR_ANY;
+    else
+        addr.sin_addr = lcm->params.mc_addr;
 #else
     // On WIN32 if we try to bind to mc_addr, we get WSAEADDRNOTAVAIL.
     // See https://github.com/lcm-proj/lcm/issues/258.
@@ -973,64 +4999,189 @@ static int _setup_recv_parts(lcm_udpm_t *lcm)
                 lcm->kernel_rbuf_sz, lcm->params.recv_buf_size);
         }
     }
+    lcm->rbuf_requested = lcm->params.recv_buf_size ? lcm->params.recv_buf_size
+                                                     : lcm->kernel_rbuf_sz;
+    lcm_stat_max(&lcm->stats.recv_buf_size, (uint64_t) lcm->kernel_rbuf_sz);
 
-/* Enable per-packet timestamping by the kernel, if available */
+    udpm_enable_timestamps(lcm);
 #ifdef SO_TIMESTAMP
-    opt = 1;
-    setsockopt(lcm->recvfd, SOL_SOCKET, SO_TIMESTAMP, &opt, sizeof(opt));
+    udpm_sample_mono_offset(lcm);
 #endif
+    udpm_enable_drop_count(lcm);
+    udpm_enable_busy_poll(lcm);
 
     if (bind(lcm->recvfd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
         perror("bind");
         goto setup_recv_thread_fail;
     }
 
-    struct ip_mreq mreq;
-    mreq.imr_multiaddr = lcm->params.mc_addr;
-    mreq.imr_interface.s_addr = INADDR_ANY;
-    // join the multicast group
-    dbg(DBG_LCM, "LCM: joining multicast group\n");
-    if (setsockopt(lcm->recvfd, IPPROTO_IP, IP_ADD_MEMBERSHIP, (char *) &mreq, sizeof(mreq)) < 0) {
-        perror("setsockopt (IPPROTO_IP, IP_ADD_MEMBERSHIP)");
+    if (udpm_join_group(lcm, lcm->recvfd) < 0)
         goto setup_recv_thread_fail;
-    }
-
-    lcm->inbufs_empty = lcm_buf_queue_new();
-    lcm->inbufs_filled = lcm_buf_queue_new();
-    lcm->ringbuf = lcm_ringbuf_new(LCM_RINGBUF_SIZE);
 
-    int i;
-    for (i = 0; i < LCM_DEFAULT_RECV_BUFS; i++) {
-        /* We don't set the receive buffer's data pointer yet because it
-         * will be taken from the ringbuffer at receive time. */
-        lcm_buf_t *lcmb = (lcm_buf_t *) calloc(1, sizeof(lcm_buf_t));
-        lcm_buf_enqueue(lcm->inbufs_empty, lcmb);
+    if (lcm->params.recv_threads != 1) {
+        // several threads read from the socket, so a thread that saw it
+        // become readable may still find it empty.  Without a read thread,
+        // lcm_handle() polls the socket instead of blocking on it.
+        fcntl(lcm->recvfd, F_SETFL, O_NONBLOCK);
     }
 
-    // setup a pipe for notifying the reader thread when to quit
+    // setup a pipe for notifying the reader threads when to quit
     if (0 != lcm_internal_pipe_create(lcm->thread_msg_pipe)) {
         perror(__FILE__ " pipe(setup)");
         goto setup_recv_thread_fail;
     }
     fcntl(lcm->thread_msg_pipe[1], F_SETFL, O_NONBLOCK);
 
-    /* Start the reader thread */
-    lcm->read_thread = g_thread_new(NULL, recv_thread, lcm);
-    if (!lcm->read_thread) {
-        fprintf(stderr, "Error: LCM failed to start reader thread\n");
-        goto setup_recv_thread_fail;
+    unsigned int ringbuf_size = LCM_RINGBUF_SIZE;
+    if (lcm->params.ringbuf_size)
+        ringbuf_size = lcm->params.ringbuf_size;
+#ifdef USE_RECVMMSG
+    if (lcm->params.recv_batch > 1) {
+        // room for two full batches, so that a new batch can be received
+        // while the previous one is still being handled.
+        unsigned int batch_ringbuf_size =
+            2 * lcm->params.recv_batch * (LCM_MAX_UNFRAGMENTED_PACKET_SIZE + 64);
+        ringbuf_size = MAX(ringbuf_size, batch_ringbuf_size);
+    }
+#endif
+    if (lcm->params.ringbuf_lock)
+        lcm->ringbuf_max = ringbuf_size;
+    else if (lcm->params.ringbuf_max)
+        lcm->ringbuf_max = MAX(ringbuf_size, (unsigned int) lcm->params.ringbuf_max);
+
+    // without read threads, lcm_handle() uses the buffers of the first one
+    lcm->num_recv_threads = MAX(1, lcm->params.recv_threads);
+    lcm->next_recv_thread = 0;
+    lcm->recv_threads =
+        (udpm_recv_thread_t *) calloc(lcm->num_recv_threads, sizeof(udpm_recv_thread_t));
+    for (i = 0; i < lcm->num_recv_threads; i++) {
+        udpm_recv_thread_t *rt = &lcm->recv_threads[i];
+        rt->lcm = lcm;
+        rt->inbufs_empty = lcm_buf_queue_new();
+        rt->inbufs_empty->grow = lcm->params.recv_bufs;
+        rt->inbufs_filled[0] = lcm_buf_ring_new(LCM_RECV_QUEUE_SIZE);
+        int priority;
+        for (priority = 1; priority <= LCM_MAX_PRIORITY; priority++)
+            rt->inbufs_filled[priority] = lcm_buf_ring_new(LCM_PRIORITY_QUEUE_SIZE);
+        rt->inbufs_done = lcm_buf_ring_new(2 * LCM_RECV_QUEUE_SIZE);
+        lcm_buf_returns_init(&rt->returns);
+        if (lcm->params.ringbuf_lock)
+            rt->ringbuf = lcm_ringbuf_new_locked(ringbuf_size, lcm->params.recv_sched.numa_node);
+        else
+            rt->ringbuf = lcm_ringbuf_new(ringbuf_size);
+#ifdef USE_RECVMMSG
+        if (lcm->params.recv_batch > 1 && lcm->params.recv_threads)
+            rt->recv_batch = udpm_recv_batch_new(lcm->params.recv_batch);
+#endif
+
+        int j;
+        for (j = 0; j < lcm->params.recv_bufs; j++) {
+            /* We don't set the receive buffer's data pointer yet because it
+             * will be taken from the ringbuffer at receive time. */
+            lcm_buf_t *lcmb = (lcm_buf_t *) calloc(1, sizeof(lcm_buf_t));
+            lcm_buf_enqueue(rt->inbufs_empty, lcmb);
+        }
+
+        rt->poller = lcm_poller_new();
+        if (!rt->poller || lcm_poller_add(rt->poller, lcm->recvfd, &lcm->recvfd) < 0 ||
+            lcm_poller_add(rt->poller, lcm->thread_msg_pipe[0], lcm->thread_msg_pipe) < 0) {
+            fprintf(stderr, "Error: LCM failed to set up socket polling\n");
+            goto setup_recv_thread_fail;
+        }
+    }
+
+#ifdef LCM_HAVE_XDP
+    if (lcm->params.xdp_ifname && !lcm->params.recv_threads) {
+        fprintf(stderr, "Warning: xdp needs a read thread, receiving from the socket only\n");
+    } else if (lcm->params.xdp_ifname) {
+        udpm_recv_thread_t *rt = &lcm->recv_threads[0];
+        rt->xdp = lcm_xdp_open(lcm->params.xdp_ifname, lcm->params.xdp_queue,
+                               lcm->params.mc_addr, lcm->params.mc_port);
+        if (!rt->xdp) {
+            fprintf(stderr, "Warning: LCM failed to set up AF_XDP on %s, receiving from the "
+                            "socket only\n", lcm->params.xdp_ifname);
+        } else if (lcm_poller_add(rt->poller, lcm_xdp_fileno(rt->xdp), rt->xdp) < 0) {
+            fprintf(stderr, "Error: LCM failed to set up socket polling\n");
+            goto setup_recv_thread_fail;
+        }
+    }
+#endif
+
+#ifdef USE_IO_URING
+    if (lcm->params.io_uring && !lcm->params.recv_threads)
+        fprintf(stderr, "Warning: io_uring needs a read thread, ignoring it\n");
+    for (i = 0; lcm->params.io_uring && i < lcm->params.recv_threads; i++) {
+        udpm_recv_thread_t *rt = &lcm->recv_threads[i];
+#ifdef LCM_HAVE_XDP
+        if (rt->xdp)
+            continue;
+#endif
+        rt->uring = lcm_uring_new();
+        if (!rt->uring) {
+            fprintf(stderr, "Warning: LCM failed to set up io_uring, receiving with recvmsg()\n");
+            break;
+        }
+        if (lcm_uring_add(rt->uring, lcm->recvfd, &lcm->recvfd) < 0 ||
+            lcm_uring_poll(rt->uring, lcm->thread_msg_pipe[0], lcm->thread_msg_pipe) < 0) {
+            fprintf(stderr, "Error: LCM failed to set up io_uring\n");
+            goto setup_recv_thread_fail;
+        }
+    }
+#endif
+
+#ifdef USE_IOCP
+    if (lcm->params.iocp && !lcm->params.recv_threads)
+        fprintf(stderr, "Warning: iocp needs a read thread, ignoring it\n");
+    if (lcm->params.iocp && lcm->params.recv_threads) {
+        lcm->iocp = lcm_iocp_new();
+        if (!lcm->iocp) {
+            fprintf(stderr, "Warning: LCM failed to set up iocp, receiving with recvmsg()\n");
+        } else if (lcm_iocp_add(lcm->iocp, lcm->recvfd, &lcm->recvfd) < 0 ||
+                   lcm_iocp_poll(lcm->iocp, (SOCKET) lcm->thread_msg_pipe[0],
+                                 lcm->thread_msg_pipe) < 0) {
+            fprintf(stderr, "Error: LCM failed to set up iocp\n");
+            goto setup_recv_thread_fail;
+        }
     }
+#endif
+
+    /* Start the reader threads */
     lcm->thread_created = 1;
+    for (i = 0; i < lcm->params.recv_threads; i++) {
+        udpm_recv_thread_t *rt = &lcm->recv_threads[i];
+        lcm_thread_sched_t sched = lcm->params.recv_sched;
+        if (sched.cpu >= 0)
+            sched.cpu += i;
+        rt->thread = lcm_internal_thread_new("lcm-udpm-recv", recv_thread, rt, &sched);
+        if (!rt->thread) {
+            fprintf(stderr, "Error: LCM failed to start reader thread\n");
+            goto setup_recv_thread_fail;
+        }
+    }
     g_rec_mutex_unlock(&lcm->mutex);
 
-    // conduct a self-test just to make sure everything is working.
-    dbg(DBG_LCM, "LCM: conducting self test\n");
-    int self_test_results = udpm_self_test(lcm);
+    int self_test_results = 0;
+    if (lcm->params.self_test == UDPM_SELF_TEST_ON) {
+        // conduct a self-test just to make sure everything is working.
+        dbg(DBG_LCM, "LCM: conducting self test\n");
+        self_test_results = udpm_self_test(lcm);
+        if (0 == self_test_results)
+            dbg(DBG_LCM, "LCM: self test successful\n");
+    } else if (lcm->params.self_test == UDPM_SELF_TEST_ASYNC) {
+        dbg(DBG_LCM, "LCM: starting self test\n");
+        udpm_filter_add(lcm, SELF_TEST_CHANNEL);
+        lcm->self_test_passed = 0;
+        lcm->self_test_exit = 0;
+        lcm_thread_sched_t sched;
+        lcm_thread_sched_init(&sched);
+        lcm->self_test_thread =
+            lcm_internal_thread_new("lcm-udpm-test", self_test_thread, lcm, &sched);
+        if (!lcm->self_test_thread)
+            fprintf(stderr, "Warning: LCM failed to start self test thread\n");
+    }
     g_rec_mutex_lock(&lcm->mutex);
 
-    if (0 == self_test_results) {
-        dbg(DBG_LCM, "LCM: self test successful\n");
-    } else {
+    if (self_test_results < 0) {
         // self test failed.  destroy the read thread
         fprintf(stderr,
                 "LCM self test failed!!\n"
@@ -1053,16 +5204,187 @@ setup_recv_thread_fail:
     return -1;
 }
 
+// Binds the transmit socket to an ephemeral port, so that the source address
+// of its datagrams is known before the first one is sent.
+static int udpm_bind_send_socket(lcm_udpm_t *lcm)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = 0;
+    socklen_t addrlen = sizeof(addr);
+    if (bind(lcm->sendfd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+        getsockname(lcm->sendfd, (struct sockaddr *) &addr, &addrlen) < 0) {
+        perror("bind (sendfd)");
+        return -1;
+    }
+    lcm->send_addr.sin_port = addr.sin_port;
+    return 0;
+}
+
+static void udpm_shared_key_add(gpointer key, gpointer value, gpointer user)
+{
+    g_ptr_array_add((GPtrArray *) user, g_strdup_printf("%s=%s", (char *) key, (char *) value));
+}
+
+static gint udpm_shared_key_compare(gconstpointer a, gconstpointer b)
+{
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+// The key of the instances that share a receive side, which is their URL
+// with the options in order.
+static char *udpm_shared_key(const char *network, const GHashTable *args)
+{
+    GPtrArray *options = g_ptr_array_new_with_free_func(g_free);
+    g_hash_table_foreach((GHashTable *) args, udpm_shared_key_add, options);
+    g_ptr_array_sort(options, udpm_shared_key_compare);
+    GString *key = g_string_new(network);
+    unsigned int i;
+    for (i = 0; i < options->len; i++) {
+        g_string_append_c(key, i ? '&' : '?');
+        g_string_append(key, (char *) g_ptr_array_index(options, i));
+    }
+    g_ptr_array_free(options, TRUE);
+    return g_string_free(key, FALSE);
+}
+
+static lcm_provider_t *lcm_udpm_create(lcm_t *parent, const char *network, const GHashTable *args);
+
+// Returns the udpm_shared_t of network and args, after creating it and its
+// hub for the first instance that shares it.  Returns NULL if that fails.
+static udpm_shared_t *udpm_shared_ref(const char *network, const GHashTable *args)
+{
+    char *key = udpm_shared_key(network, args);
+    g_mutex_lock(&udpm_shared_lock);
+    if (!udpm_shared_by_key)
+        udpm_shared_by_key = g_hash_table_new(g_str_hash, g_str_equal);
+    udpm_shared_t *shared = (udpm_shared_t *) g_hash_table_lookup(udpm_shared_by_key, key);
+    if (shared) {
+        shared->refcount++;
+        g_free(key);
+        g_mutex_unlock(&udpm_shared_lock);
+        return shared;
+    }
+
+    lcm_udpm_t *hub = (lcm_udpm_t *) lcm_udpm_create(NULL, network, args);
+    if (!hub) {
+        g_free(key);
+        g_mutex_unlock(&udpm_shared_lock);
+        return NULL;
+    }
+    shared = (udpm_shared_t *) calloc(1, sizeof(udpm_shared_t));
+    shared->key = key;
+    shared->refcount = 1;
+    shared->hub = hub;
+    g_mutex_init(&shared->lock);
+    hub->fanout = shared;
+    g_hash_table_insert(udpm_shared_by_key, key, shared);
+    g_mutex_unlock(&udpm_shared_lock);
+    return shared;
+}
+
+// Destroys the udpm_shared_t and its hub once the last instance that shares it
+// is gone.
+static void udpm_shared_unref(udpm_shared_t *shared)
+{
+    g_mutex_lock(&udpm_shared_lock);
+    int last = !--shared->refcount;
+    if (last)
+        g_hash_table_remove(udpm_shared_by_key, shared->key);
+    g_mutex_unlock(&udpm_shared_lock);
+    if (!last)
+        return;
+
+    lcm_udpm_destroy(shared->hub);
+    g_mutex_clear(&shared->lock);
+    g_free(shared->key);
+    free(shared);
+}
+
 static lcm_provider_t *lcm_udpm_create(lcm_t *parent, const char *network, const GHashTable *args)
 {
     udpm_params_t params;
     memset(&params, 0, sizeof(udpm_params_t));
+    params.recv_threads = 1;
+    params.bundle_interval = UDPM_DEFAULT_BUNDLE_INTERVAL;
+    params.send_burst = UDPM_DEFAULT_SEND_BURST;
+    params.retransmit_buffer = UDPM_DEFAULT_RETRANSMIT_BUFFER;
+    params.nack_timeout = UDPM_DEFAULT_NACK_TIMEOUT;
+    params.interest_period = UDPM_DEFAULT_INTEREST_PERIOD;
+    params.delta_keyframe = UDPM_DEFAULT_DELTA_KEYFRAME;
+    lcm_thread_sched_init(&params.recv_sched);
 
     g_hash_table_foreach((GHashTable *) args, new_argument, &params);
+    if (params.local_delivery && !params.recv_threads) {
+        fprintf(stderr, "Warning: local_delivery is not supported with recv_threads=0\n");
+        params.local_delivery = 0;
+    }
+    // without a read thread, nothing would read the self test message until
+    // the application calls lcm_handle()
+    if (params.self_test == UDPM_SELF_TEST_ASYNC && !params.recv_threads)
+        params.self_test = UDPM_SELF_TEST_OFF;
+    // what lean changes is only the defaults, whatever order the options
+    // come in
+    if (!params.recv_bufs)
+        params.recv_bufs = params.lean ? UDPM_LEAN_RECV_BUFS : LCM_DEFAULT_RECV_BUFS;
+    if (!params.frag_store)
+        params.frag_store = params.lean ? UDPM_LEAN_FRAG_STORE : MAX_FRAG_BUF_TOTAL_SIZE;
+    if (!params.max_frag_bufs)
+        params.max_frag_bufs = params.lean ? UDPM_LEAN_MAX_FRAG_BUFS : MAX_NUM_FRAG_BUFS;
+    if (!params.ringbuf_size && params.lean)
+        params.ringbuf_size = UDPM_MIN_RINGBUF_SIZE;
+    if (params.share && !params.recv_threads) {
+        fprintf(stderr, "Warning: share is not supported with recv_threads=0\n");
+        params.share = 0;
+    }
+    if (params.share && params.local_delivery) {
+        fprintf(stderr, "Warning: local_delivery is not supported with share=1\n");
+        params.local_delivery = 0;
+    }
+    // the hub of a udpm_shared_t has no lcm_subscribe() to wait for the self
+    // test in
+    if (params.share && !parent && params.self_test == UDPM_SELF_TEST_ON)
+        params.self_test = UDPM_SELF_TEST_ASYNC;
+    // the self test message goes to the peers, which need not include this
+    // instance
+    if (params.num_peers)
+        params.self_test = UDPM_SELF_TEST_OFF;
+    // the announcements only go to the multicast group
+    if (params.num_peers && params.interest_port) {
+        fprintf(stderr, "Warning: interest is not supported with peers\n");
+        params.interest_port = 0;
+    }
+    // the latched messages are sent again when the announcements say so
+    if (params.latch_re && !params.interest_port) {
+        fprintf(stderr, "Warning: latch needs interest\n");
+        g_regex_unref(params.latch_re);
+        params.latch_re = NULL;
+    }
+    // a NACK does not tell which interface the message came out of, whose
+    // sequence numbers are only unique per interface
+    if (params.num_ifaces && params.retransmit_re) {
+        fprintf(stderr, "Warning: retransmit is not supported with ifaces\n");
+        g_regex_unref(params.retransmit_re);
+        params.retransmit_re = NULL;
+    }
 
     if (parse_mc_addr_and_port(network, &params) < 0) {
+        if (params.compress_re)
+            g_regex_unref(params.compress_re);
+        if (params.retransmit_re)
+            g_regex_unref(params.retransmit_re);
+        if (params.latch_re)
+            g_regex_unref(params.latch_re);
+        if (params.delta_re)
+            g_regex_unref(params.delta_re);
+        g_free(params.peers);
+        udpm_free_ifaces(params.ifaces, params.num_ifaces);
         return NULL;
     }
+    params.packet_size = lcm_resolve_packet_size(params.packet_size, params.mc_addr);
+    params.bundle_size = MIN(params.bundle_size, params.packet_size);
 
     lcm_udpm_t *lcm = (lcm_udpm_t *) calloc(1, sizeof(lcm_udpm_t));
 
@@ -1070,28 +5392,48 @@ static lcm_provider_t *lcm_udpm_create(lcm_t *parent, const char *network, const
     lcm->params = params;
     lcm->recvfd = -1;
     lcm->sendfd = -1;
+    lcm->interestfd = -1;
+    g_mutex_init(&lcm->interest_lock);
+    if (params.latch_re)
+        lcm->latched = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, udpm_latched_free);
+    g_mutex_init(&lcm->latch_lock);
+    lcm->filter_channels = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
+    lcm->local_queue = g_queue_new();
+    g_mutex_init(&lcm->local_lock);
+    lcm->retained = g_queue_new();
+    g_mutex_init(&lcm->repair_lock);
+    lcm->delta_bases = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, udpm_delta_base_free);
+    g_mutex_init(&lcm->delta_lock);
+    g_mutex_init(&lcm->rbuf_lock);
+    g_mutex_init(&lcm->send_lock);
+    g_cond_init(&lcm->send_cond);
+    g_cond_init(&lcm->send_space_cond);
+    g_cond_init(&lcm->bundle_cond);
+    g_mutex_init(&lcm->self_test_lock);
+    g_cond_init(&lcm->self_test_cond);
     lcm->thread_msg_pipe[0] = lcm->thread_msg_pipe[1] = -1;
-    lcm->udp_low_watermark = 1.0;
+    lcm->notify_pipe[0] = lcm->notify_pipe[1] = -1;
 
     lcm->kernel_rbuf_sz = 0;
     lcm->warned_about_small_kernel_buf = 0;
 
-    lcm->frag_bufs = NULL;
+    lcm->frag_shards = NULL;
 
     // synchronization variables used when allocating receive resources
     lcm->creating_read_thread = 0;
     lcm->p_create_read_thread_mutex = NULL;
 
     // internal notification pipe
-    if (0 != lcm_internal_pipe_create(lcm->notify_pipe)) {
+    if (0 != udpm_notify_create(lcm)) {
         perror(__FILE__ " pipe(create)");
         lcm_udpm_destroy(lcm);
         return NULL;
     }
-    fcntl(lcm->notify_pipe[1], F_SETFL, O_NONBLOCK);
 
     g_rec_mutex_init(&lcm->mutex);
     g_mutex_init(&lcm->transmit_lock);
+    lcm->pace_tokens = params.send_burst;
+    lcm->pace_utime = g_get_monotonic_time();
 
     dbg(DBG_LCM, "Initializing LCM UDPM context...\n");
     dbg(DBG_LCM, "Multicast %s:%d\n", inet_ntoa(params.mc_addr), ntohs(params.mc_port));
@@ -1101,6 +5443,18 @@ static lcm_provider_t *lcm_udpm_create(lcm_t *parent, const char *network, const
     lcm->dest_addr.sin_family = AF_INET;
     lcm->dest_addr.sin_addr = params.mc_addr;
     lcm->dest_addr.sin_port = params.mc_port;
+    lcm->dests = &lcm->dest_addr;
+    lcm->num_dests = 1;
+    if (params.num_peers) {
+        lcm->dests = lcm->params.peers;
+        lcm->num_dests = params.num_peers;
+        for (int i = 0; i < lcm->num_dests; i++) {
+            if (!lcm->dests[i].sin_port)
+                lcm->dests[i].sin_port = params.mc_port;
+            dbg(DBG_LCM, "Unicast peer %s:%d\n", inet_ntoa(lcm->dests[i].sin_addr),
+                ntohs(lcm->dests[i].sin_port));
+        }
+    }
 
     // test connectivity
     SOCKET testfd = socket(AF_INET, SOCK_DGRAM, 0);
@@ -1112,6 +5466,9 @@ static lcm_provider_t *lcm_udpm_create(lcm_t *parent, const char *network, const
 #endif
         return NULL;
     }
+    // the address that datagrams to the group are sent from
+    socklen_t send_addr_len = sizeof(lcm->send_addr);
+    getsockname(testfd, (struct sockaddr *) &lcm->send_addr, &send_addr_len);
     lcm_close_socket(testfd);
 
     // create a transmit socket
@@ -1141,6 +5498,16 @@ static lcm_provider_t *lcm_udpm_create(lcm_t *parent, const char *network, const
     setsockopt(lcm->sendfd, SOL_SOCKET, SO_SNDBUF, (char *) &send_buf_size, sizeof(send_buf_size));
 #endif
 
+#ifdef SO_MAX_PACING_RATE
+    // paced by the kernel, which takes effect with the fq queueing discipline
+    if (params.send_rate > 0 && params.send_pacing_kernel) {
+        unsigned int rate = (unsigned int) MIN(params.send_rate, (int64_t) UINT_MAX - 1);
+        if (setsockopt(lcm->sendfd, SOL_SOCKET, SO_MAX_PACING_RATE, (char *) &rate,
+                       sizeof(rate)) < 0)
+            perror("setsockopt(SOL_SOCKET, SO_MAX_PACING_RATE)");
+    }
+#endif
+
     // debugging... how big is the send buffer?
     int sockbufsize = 0;
     unsigned int retsize = sizeof(int);
@@ -1160,6 +5527,62 @@ static lcm_provider_t *lcm_udpm_create(lcm_t *parent, const char *network, const
         return NULL;
     }
 
+    // with ifaces, start out of the first one
+    if (params.num_ifaces) {
+        lcm->cur_iface = -1;
+        udpm_use_iface(lcm, 0);
+        if (lcm->cur_iface < 0) {
+            lcm_udpm_destroy(lcm);
+            return NULL;
+        }
+    }
+
+    if (params.local_delivery && udpm_bind_send_socket(lcm) < 0) {
+        lcm_udpm_destroy(lcm);
+        return NULL;
+    }
+
+    lcm_thread_sched_t sched;
+    lcm_thread_sched_init(&sched);
+    if (params.bundle_size > 0) {
+        lcm->bundle_buf = (char *) malloc(params.bundle_size);
+        lcm->bundle_thread =
+            lcm_internal_thread_new("lcm-udpm-bundle", bundle_thread, lcm, &sched);
+        if (!lcm->bundle_thread) {
+            fprintf(stderr, "Error: LCM failed to start bundle thread\n");
+            lcm_udpm_destroy(lcm);
+            return NULL;
+        }
+    }
+
+    if (params.retransmit_re) {
+        lcm->repair_thread =
+            lcm_internal_thread_new("lcm-udpm-repair", repair_thread, lcm, &sched);
+        if (!lcm->repair_thread) {
+            fprintf(stderr, "Error: LCM failed to start repair thread\n");
+            lcm_udpm_destroy(lcm);
+            return NULL;
+        }
+    }
+
+    // not for the hub of a udpm_shared_t, which subscribes and publishes
+    // nothing
+    if (params.interest_port && parent && udpm_interest_start(lcm) < 0) {
+        fprintf(stderr, "Error: LCM failed to start interest thread\n");
+        lcm_udpm_destroy(lcm);
+        return NULL;
+    }
+
+    if (params.send_queue > 0) {
+        lcm->send_ring = lcm_ringbuf_new(params.send_queue);
+        lcm->send_thread = lcm_internal_thread_new("lcm-udpm-send", send_thread, lcm, &sched);
+        if (!lcm->send_thread) {
+            fprintf(stderr, "Error: LCM failed to start sender thread\n");
+            lcm_udpm_destroy(lcm);
+            return NULL;
+        }
+    }
+
     // don't start the receive thread yet.  Only allocate resources for
     // receiving messages when a subscription is made.
 
@@ -1178,6 +5601,14 @@ static lcm_provider_t *lcm_udpm_create(lcm_t *parent, const char *network, const
 #endif
     }
 
+    if (params.share && parent) {
+        lcm->shared = udpm_shared_ref(network, args);
+        if (!lcm->shared) {
+            lcm_udpm_destroy(lcm);
+            return NULL;
+        }
+    }
+
     return lcm;
 }
 
@@ -1188,10 +5619,22 @@ static lcm_provider_vtable_t udpm_vtable = {
     .create = lcm_udpm_create,
     .destroy = lcm_udpm_destroy,
     .subscribe = lcm_udpm_subscribe,
-    .unsubscribe = NULL,
+    .unsubscribe = lcm_udpm_unsubscribe,
+    .subscribed = lcm_udpm_subscribed,
     .publish = lcm_udpm_publish,
     .handle = lcm_udpm_handle,
     .get_fileno = lcm_udpm_get_fileno,
+    .handle_batch = lcm_udpm_handle_batch,
+    .publish_async = lcm_udpm_publish_async,
+    .get_stats = lcm_udpm_get_stats,
+#ifdef USE_SENDMMSG
+    .publish_batch = lcm_udpm_publish_batch,
+#endif
+    .publishv = lcm_udpm_publishv,
+    .publisher_create = lcm_udpm_publisher_create,
+    .publisher_publish = lcm_udpm_publisher_publish,
+    .publisher_destroy = lcm_udpm_publisher_destroy,
+    .publisher_has_subscribers = lcm_udpm_publisher_has_subscribers,
 };
 #endif
 
@@ -1205,10 +5648,19 @@ void lcm_udpm_provider_init(GPtrArray *providers)
     udpm_vtable.create = lcm_udpm_create;
     udpm_vtable.destroy = lcm_udpm_destroy;
     udpm_vtable.subscribe = lcm_udpm_subscribe;
-    udpm_vtable.unsubscribe = NULL;
+    udpm_vtable.unsubscribe = lcm_udpm_unsubscribe;
+    udpm_vtable.subscribed = lcm_udpm_subscribed;
     udpm_vtable.publish = lcm_udpm_publish;
     udpm_vtable.handle = lcm_udpm_handle;
     udpm_vtable.get_fileno = lcm_udpm_get_fileno;
+    udpm_vtable.handle_batch = lcm_udpm_handle_batch;
+    udpm_vtable.publish_async = lcm_udpm_publish_async;
+    udpm_vtable.get_stats = lcm_udpm_get_stats;
+    udpm_vtable.publishv = lcm_udpm_publishv;
+    udpm_vtable.publisher_create = lcm_udpm_publisher_create;
+    udpm_vtable.publisher_publish = lcm_udpm_publisher_publish;
+    udpm_vtable.publisher_destroy = lcm_udpm_publisher_destroy;
+    udpm_vtable.publisher_has_subscribers = lcm_udpm_publisher_has_subscribers;
 #endif
     udpm_info.name = "udpm";
     udpm_info.vtable = &udpm_vtable;
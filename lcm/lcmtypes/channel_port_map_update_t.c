@@ -22,8 +22,11 @@ uint64_t __channel_port_map_update_t_hash_recursive(const __lcm_hash_ptr *p)
     cp.v = __channel_port_map_update_t_get_hash;
     (void) cp;
 
-    uint64_t hash = (uint64_t)0x4216b98388375d0bLL
+    uint64_t hash = (uint64_t)0xc07e86062b375de5LL
          + __int16_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int32_t_hash_recursive(&cp)
+         + __int32_t_hash_recursive(&cp)
          + __int16_t_hash_recursive(&cp)
          + __channel_to_port_t_hash_recursive(&cp)
         ;
@@ -53,6 +56,15 @@ int __channel_port_map_update_t_encode_array(void *buf, int offset, int maxlen,
         thislen = __int16_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_ports), 1);
         if (thislen < 0) return thislen; else pos += thislen;
 
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].sender_id), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].version), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].base_version), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
         thislen = __int16_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_channels), 1);
         if (thislen < 0) return thislen; else pos += thislen;
 
@@ -86,6 +98,12 @@ int __channel_port_map_update_t_encoded_array_size(const channel_port_map_update
 
         size += __int16_t_encoded_array_size(&(p[element].num_ports), 1);
 
+        size += __int64_t_encoded_array_size(&(p[element].sender_id), 1);
+
+        size += __int32_t_encoded_array_size(&(p[element].version), 1);
+
+        size += __int32_t_encoded_array_size(&(p[element].base_version), 1);
+
         size += __int16_t_encoded_array_size(&(p[element].num_channels), 1);
 
         size += __channel_to_port_t_encoded_array_size(p[element].mapping, p[element].num_channels);
@@ -110,6 +128,15 @@ int __channel_port_map_update_t_decode_array(const void *buf, int offset, int ma
         thislen = __int16_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_ports), 1);
         if (thislen < 0) return thislen; else pos += thislen;
 
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].sender_id), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].version), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].base_version), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
         thislen = __int16_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_channels), 1);
         if (thislen < 0) return thislen; else pos += thislen;
 
@@ -130,6 +157,12 @@ int __channel_port_map_update_t_decode_array_cleanup(channel_port_map_update_t *
 
         __int16_t_decode_array_cleanup(&(p[element].num_ports), 1);
 
+        __int64_t_decode_array_cleanup(&(p[element].sender_id), 1);
+
+        __int32_t_decode_array_cleanup(&(p[element].version), 1);
+
+        __int32_t_decode_array_cleanup(&(p[element].base_version), 1);
+
         __int16_t_decode_array_cleanup(&(p[element].num_channels), 1);
 
         __channel_to_port_t_decode_array_cleanup(p[element].mapping, p[element].num_channels);
@@ -170,6 +203,12 @@ int __channel_port_map_update_t_clone_array(const channel_port_map_update_t *p,
 
         __int16_t_clone_array(&(p[element].num_ports), &(q[element].num_ports), 1);
 
+        __int64_t_clone_array(&(p[element].sender_id), &(q[element].sender_id), 1);
+
+        __int32_t_clone_array(&(p[element].version), &(q[element].version), 1);
+
+        __int32_t_clone_array(&(p[element].base_version), &(q[element].base_version), 1);
+
         __int16_t_clone_array(&(p[element].num_channels), &(q[element].num_channels), 1);
 
         q[element].mapping = (channel_to_port_t*) lcm_malloc(sizeof(channel_to_port_t) * q[element].num_channels);
@@ -19,11 +19,27 @@ extern "C" {
 typedef struct _channel_port_map_update_t channel_port_map_update_t;
 struct _channel_port_map_update_t
 {
-    int16_t    num_ports;
 
     /**
      * size of the port range for the mappings
      */
+    int16_t    num_ports;
+
+    /**
+     * random id of the instance that sent the update
+     */
+    int64_t    sender_id;
+
+    /**
+     * version of the sender's mappings after the update
+     */
+    int32_t    version;
+
+    /**
+     * 0 if the update holds all of the sender's mappings, or else the version
+     * that the mappings in the update were changed from
+     */
+    int32_t    base_version;
     int16_t    num_channels;
 
     /**
@@ -22,9 +22,10 @@ uint64_t __channel_to_port_t_hash_recursive(const __lcm_hash_ptr *p)
     cp.v = __channel_to_port_t_get_hash;
     (void) cp;
 
-    uint64_t hash = (uint64_t)0x11dde9fa42a43913LL
+    uint64_t hash = (uint64_t)0x894ef1dee33632bcLL
          + __string_hash_recursive(&cp)
          + __int16_t_hash_recursive(&cp)
+         + __int32_t_hash_recursive(&cp)
         ;
 
     return (hash<<1) + ((hash>>63)&1);
@@ -55,6 +56,9 @@ int __channel_to_port_t_encode_array(void *buf, int offset, int maxlen, const ch
         thislen = __int16_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].port), 1);
         if (thislen < 0) return thislen; else pos += thislen;
 
+        thislen = __int32_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].bandwidth), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
     }
     return pos;
 }
@@ -84,6 +88,8 @@ int __channel_to_port_t_encoded_array_size(const channel_to_port_t *p, int eleme
 
         size += __int16_t_encoded_array_size(&(p[element].port), 1);
 
+        size += __int32_t_encoded_array_size(&(p[element].bandwidth), 1);
+
     }
     return size;
 }
@@ -107,6 +113,9 @@ int __channel_to_port_t_decode_array(const void *buf, int offset, int maxlen, ch
         thislen = __int16_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].port), 1);
         if (thislen < 0) return thislen; else pos += thislen;
 
+        thislen = __int32_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].bandwidth), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
     }
     return pos;
 }
@@ -122,6 +131,8 @@ int __channel_to_port_t_decode_array_cleanup(channel_to_port_t *p, int elements)
 
         __int16_t_decode_array_cleanup(&(p[element].port), 1);
 
+        __int32_t_decode_array_cleanup(&(p[element].bandwidth), 1);
+
     }
     return 0;
 }
@@ -159,6 +170,8 @@ int __channel_to_port_t_clone_array(const channel_to_port_t *p, channel_to_port_
 
         __int16_t_clone_array(&(p[element].port), &(q[element].port), 1);
 
+        __int32_t_clone_array(&(p[element].bandwidth), &(q[element].bandwidth), 1);
+
     }
     return 0;
 }
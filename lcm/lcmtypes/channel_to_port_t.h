@@ -32,7 +32,16 @@ struct _channel_to_port_t
      * LCM Type: string
      */
     char*      channel;
+
+    /**
+     * ports are uint16_t
+     */
     int16_t    port;
+
+    /**
+     * bytes/s that the sender publishes on the channel, 0 if it doesn't
+     */
+    int32_t    bandwidth;
 };
 
 /**
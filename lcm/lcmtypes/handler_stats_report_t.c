@@ -0,0 +1,443 @@
+// THIS IS AN AUTOMATICALLY GENERATED FILE.  DO NOT MODIFY
+// BY HAND!!
+//
+// Generated by the regenerate.sh script in this directory
+
+#include <string.h>
+#include "handler_stats_report_t.h"
+
+LCM_NO_EXPORT
+uint64_t __handler_stats_report_t_hash_recursive(const __lcm_hash_ptr *p)
+{
+    const __lcm_hash_ptr *fp;
+    for (fp = p; fp != NULL; fp = fp->parent)
+        if (fp->v == __handler_stats_report_t_get_hash)
+            return 0;
+
+    __lcm_hash_ptr cp;
+    cp.parent =  p;
+    cp.v = __handler_stats_report_t_get_hash;
+    (void) cp;
+
+    uint64_t hash = (uint64_t)0xbf00860ed8d63c24LL
+         + __int64_t_hash_recursive(&cp)
+         + __string_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int32_t_hash_recursive(&cp)
+         + __handler_stats_t_hash_recursive(&cp)
+        ;
+
+    return (hash<<1) + ((hash>>63)&1);
+}
+
+LCM_NO_EXPORT
+int64_t __handler_stats_report_t_get_hash(void)
+{
+    return (int64_t) 0xb65301db40b83529ULL;
+}
+
+LCM_NO_EXPORT
+int __handler_stats_report_t_encode_array(void *buf, int offset, int maxlen, const handler_stats_report_t *p, int elements)
+{
+    int pos = 0, element;
+    int thislen;
+
+    for (element = 0; element < elements; element++) {
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].utime), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __string_encode_array(buf, offset + pos, maxlen - pos, &(p[element].source), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].packets_received), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].bytes_received), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].packets_bad), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].frag_bufs_evicted), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].messages_incomplete), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].kernel_drops), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].queue_drops), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].seqno_gaps), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_handlers), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __handler_stats_t_encode_array(buf, offset + pos, maxlen - pos, p[element].handlers, p[element].num_handlers);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+    }
+    return pos;
+}
+
+LCM_NO_EXPORT
+int handler_stats_report_t_encode(void *buf, int offset, int maxlen, const handler_stats_report_t *p)
+{
+    int pos = 0, thislen;
+    int64_t hash = HANDLER_STATS_REPORT_T_FINGERPRINT;
+
+    thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &hash, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    thislen = __handler_stats_report_t_encode_array(buf, offset + pos, maxlen - pos, p, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    return pos;
+}
+
+LCM_NO_EXPORT
+int __handler_stats_report_t_encoded_array_size(const handler_stats_report_t *p, int elements)
+{
+    int size = 0, element;
+    for (element = 0; element < elements; element++) {
+
+        size += __int64_t_encoded_array_size(&(p[element].utime), 1);
+
+        size += __string_encoded_array_size(&(p[element].source), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].packets_received), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].bytes_received), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].packets_bad), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].frag_bufs_evicted), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].messages_incomplete), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].kernel_drops), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].queue_drops), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].seqno_gaps), 1);
+
+        size += __int32_t_encoded_array_size(&(p[element].num_handlers), 1);
+
+        size += __handler_stats_t_encoded_array_size(p[element].handlers, p[element].num_handlers);
+
+    }
+    return size;
+}
+
+LCM_NO_EXPORT
+int handler_stats_report_t_encoded_size(const handler_stats_report_t *p)
+{
+    return 8 + __handler_stats_report_t_encoded_array_size(p, 1);
+}
+
+LCM_NO_EXPORT
+int __handler_stats_report_t_decode_array(const void *buf, int offset, int maxlen, handler_stats_report_t *p, int elements)
+{
+    int pos = 0, thislen, element;
+
+    for (element = 0; element < elements; element++) {
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].utime), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __string_decode_array(buf, offset + pos, maxlen - pos, &(p[element].source), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].packets_received), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].bytes_received), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].packets_bad), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].frag_bufs_evicted), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].messages_incomplete), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].kernel_drops), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].queue_drops), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].seqno_gaps), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_handlers), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        p[element].handlers = (handler_stats_t*) lcm_malloc(sizeof(handler_stats_t) * p[element].num_handlers);
+        thislen = __handler_stats_t_decode_array(buf, offset + pos, maxlen - pos, p[element].handlers, p[element].num_handlers);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+    }
+    return pos;
+}
+
+LCM_NO_EXPORT
+int __handler_stats_report_t_decode_array_cleanup(handler_stats_report_t *p, int elements)
+{
+    (void)p;
+    int element;
+    for (element = 0; element < elements; element++) {
+
+        __int64_t_decode_array_cleanup(&(p[element].utime), 1);
+
+        __string_decode_array_cleanup(&(p[element].source), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].packets_received), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].bytes_received), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].packets_bad), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].frag_bufs_evicted), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].messages_incomplete), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].kernel_drops), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].queue_drops), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].seqno_gaps), 1);
+
+        __int32_t_decode_array_cleanup(&(p[element].num_handlers), 1);
+
+        __handler_stats_t_decode_array_cleanup(p[element].handlers, p[element].num_handlers);
+        if (p[element].handlers) free(p[element].handlers);
+
+    }
+    return 0;
+}
+
+LCM_NO_EXPORT
+int handler_stats_report_t_decode(const void *buf, int offset, int maxlen, handler_stats_report_t *p)
+{
+    int pos = 0, thislen;
+    int64_t hash = HANDLER_STATS_REPORT_T_FINGERPRINT;
+
+    int64_t this_hash;
+    thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &this_hash, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+    if (this_hash != hash) return -1;
+
+    thislen = __handler_stats_report_t_decode_array(buf, offset + pos, maxlen - pos, p, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    return pos;
+}
+
+LCM_NO_EXPORT
+int handler_stats_report_t_decode_cleanup(handler_stats_report_t *p)
+{
+    return __handler_stats_report_t_decode_array_cleanup(p, 1);
+}
+
+LCM_NO_EXPORT
+int __handler_stats_report_t_decode_array_arena(const void *buf, int offset, int maxlen, handler_stats_report_t *p,
+    int elements, lcm_arena_t *arena)
+{
+    (void) arena;
+    int pos = 0, thislen, element;
+
+    for (element = 0; element < elements; element++) {
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].utime), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __string_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].source), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].packets_received), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].bytes_received), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].packets_bad), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].frag_bufs_evicted), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].messages_incomplete), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].kernel_drops), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].queue_drops), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].seqno_gaps), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_handlers), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        p[element].handlers = (handler_stats_t*) __lcm_arena_alloc_array(arena, sizeof(handler_stats_t), p[element].num_handlers);
+        if (!p[element].handlers && p[element].num_handlers > 0) return -1;
+        thislen = __handler_stats_t_decode_array_arena(buf, offset + pos, maxlen - pos, p[element].handlers, p[element].num_handlers, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+    }
+    return pos;
+}
+
+LCM_NO_EXPORT
+int __handler_stats_report_t_decode_array_arena_size(const void *buf, int offset, int maxlen,
+    int elements, size_t *size)
+{
+    (void) size;
+    int pos = 0, thislen, element;
+
+    for (element = 0; element < elements; element++) {
+        int32_t __num_handlers;
+
+        thislen = __lcm_skip_array(maxlen - pos, 8, 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __string_decode_array_arena_size(buf, offset + pos, maxlen - pos, 1, size);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __lcm_skip_array(maxlen - pos, 8, 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __lcm_skip_array(maxlen - pos, 8, 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __lcm_skip_array(maxlen - pos, 8, 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __lcm_skip_array(maxlen - pos, 8, 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __lcm_skip_array(maxlen - pos, 8, 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __lcm_skip_array(maxlen - pos, 8, 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __lcm_skip_array(maxlen - pos, 8, 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __lcm_skip_array(maxlen - pos, 8, 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_decode_array(buf, offset + pos, maxlen - pos, &__num_handlers, 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        if (__lcm_arena_add_array(size, sizeof(handler_stats_t), __num_handlers)) return -1;
+        thislen = __handler_stats_t_decode_array_arena_size(buf, offset + pos, maxlen - pos, __num_handlers, size);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+    }
+    return pos;
+}
+
+LCM_NO_EXPORT
+int handler_stats_report_t_decode_arena(const void *buf, int offset, int maxlen, handler_stats_report_t *p,
+    lcm_arena_t *arena)
+{
+    int pos = 0, thislen;
+    int64_t hash = HANDLER_STATS_REPORT_T_FINGERPRINT;
+
+    int64_t this_hash;
+    thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &this_hash, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+    if (this_hash != hash) return -1;
+
+    thislen = __handler_stats_report_t_decode_array_arena(buf, offset + pos, maxlen - pos, p, 1, arena);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    return pos;
+}
+
+LCM_NO_EXPORT
+int handler_stats_report_t_decode_arena_size(const void *buf, int offset, int maxlen, size_t *size)
+{
+    int pos = 0, thislen;
+    int64_t hash = HANDLER_STATS_REPORT_T_FINGERPRINT;
+
+    int64_t this_hash;
+    thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &this_hash, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+    if (this_hash != hash) return -1;
+
+    *size = 0;
+    thislen = __handler_stats_report_t_decode_array_arena_size(buf, offset + pos, maxlen - pos, 1, size);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    return pos;
+}
+
+LCM_NO_EXPORT
+int __handler_stats_report_t_clone_array(const handler_stats_report_t *p, handler_stats_report_t *q, int elements)
+{
+    int element;
+    for (element = 0; element < elements; element++) {
+
+        __int64_t_clone_array(&(p[element].utime), &(q[element].utime), 1);
+
+        __string_clone_array(&(p[element].source), &(q[element].source), 1);
+
+        __int64_t_clone_array(&(p[element].packets_received), &(q[element].packets_received), 1);
+
+        __int64_t_clone_array(&(p[element].bytes_received), &(q[element].bytes_received), 1);
+
+        __int64_t_clone_array(&(p[element].packets_bad), &(q[element].packets_bad), 1);
+
+        __int64_t_clone_array(&(p[element].frag_bufs_evicted), &(q[element].frag_bufs_evicted), 1);
+
+        __int64_t_clone_array(&(p[element].messages_incomplete), &(q[element].messages_incomplete), 1);
+
+        __int64_t_clone_array(&(p[element].kernel_drops), &(q[element].kernel_drops), 1);
+
+        __int64_t_clone_array(&(p[element].queue_drops), &(q[element].queue_drops), 1);
+
+        __int64_t_clone_array(&(p[element].seqno_gaps), &(q[element].seqno_gaps), 1);
+
+        __int32_t_clone_array(&(p[element].num_handlers), &(q[element].num_handlers), 1);
+
+        q[element].handlers = (handler_stats_t*) lcm_malloc(sizeof(handler_stats_t) * q[element].num_handlers);
+        __handler_stats_t_clone_array(p[element].handlers, q[element].handlers, p[element].num_handlers);
+
+    }
+    return 0;
+}
+
+LCM_NO_EXPORT
+handler_stats_report_t *handler_stats_report_t_copy(const handler_stats_report_t *p)
+{
+    handler_stats_report_t *q = (handler_stats_report_t*) malloc(sizeof(handler_stats_report_t));
+    __handler_stats_report_t_clone_array(p, q, 1);
+    return q;
+}
+
+LCM_NO_EXPORT
+void handler_stats_report_t_destroy(handler_stats_report_t *p)
+{
+    __handler_stats_report_t_decode_array_cleanup(p, 1);
+    free(p);
+}
+
@@ -0,0 +1,171 @@
+// THIS IS AN AUTOMATICALLY GENERATED FILE.  DO NOT MODIFY
+// BY HAND!!
+//
+// Generated by the regenerate.sh script in this directory
+
+#ifndef _handler_stats_report_t_h
+#define _handler_stats_report_t_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "../lcm_coretypes.h"
+#include "../lcm_export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "handler_stats_t.h"
+/**
+ * The fingerprint that begins every encoded handler_stats_report_t, the value of
+ * __handler_stats_report_t_get_hash()
+ */
+#define HANDLER_STATS_REPORT_T_FINGERPRINT ((int64_t) 0xb65301db40b83529ULL)
+
+typedef struct _handler_stats_report_t handler_stats_report_t;
+struct _handler_stats_report_t
+{
+
+    /**
+     * when the statistics were read, in microseconds since the epoch
+     */
+    int64_t    utime;
+
+    /**
+     * the process that published the report, as "hostname:pid"
+     * LCM Type: string
+     */
+    char*      source;
+
+    /**
+     * the counters of lcm_get_stats() that tell how much was received and
+     * lost
+     */
+    int64_t    packets_received;
+    int64_t    bytes_received;
+    int64_t    packets_bad;
+    int64_t    frag_bufs_evicted;
+    int64_t    messages_incomplete;
+    int64_t    kernel_drops;
+    int64_t    queue_drops;
+    int64_t    seqno_gaps;
+    int32_t    num_handlers;
+
+    /**
+     * LCM Type: handler_stats_t[num_handlers]
+     */
+    handler_stats_t *handlers;
+};
+
+/**
+ * Create a deep copy of a handler_stats_report_t.
+ * When no longer needed, destroy it with handler_stats_report_t_destroy()
+ */
+LCM_NO_EXPORT
+handler_stats_report_t* handler_stats_report_t_copy(const handler_stats_report_t* to_copy);
+
+/**
+ * Destroy an instance of handler_stats_report_t created by handler_stats_report_t_copy()
+ */
+LCM_NO_EXPORT
+void handler_stats_report_t_destroy(handler_stats_report_t* to_destroy);
+
+/**
+ * Encode a message of type handler_stats_report_t into binary form.
+ *
+ * @param buf The output buffer.
+ * @param offset Encoding starts at this byte offset into @p buf.
+ * @param maxlen Maximum number of bytes to write.  This should generally
+ *               be equal to handler_stats_report_t_encoded_size().
+ * @param msg The message to encode.
+ * @return The number of bytes encoded, or <0 if an error occured.
+ */
+LCM_NO_EXPORT
+int handler_stats_report_t_encode(void *buf, int offset, int maxlen, const handler_stats_report_t *p);
+
+/**
+ * Decode a message of type handler_stats_report_t from binary form.
+ * When decoding messages containing strings or variable-length arrays, this
+ * function may allocate memory.  When finished with the decoded message,
+ * release allocated resources with handler_stats_report_t_decode_cleanup().
+ *
+ * @param buf The buffer containing the encoded message
+ * @param offset The byte offset into @p buf where the encoded message starts.
+ * @param maxlen The maximum number of bytes to read while decoding.
+ * @param msg Output parameter where the decoded message is stored
+ * @return The number of bytes decoded, or <0 if an error occured.
+ */
+LCM_NO_EXPORT
+int handler_stats_report_t_decode(const void *buf, int offset, int maxlen, handler_stats_report_t *msg);
+
+/**
+ * Release resources allocated by handler_stats_report_t_decode()
+ * @return 0
+ */
+LCM_NO_EXPORT
+int handler_stats_report_t_decode_cleanup(handler_stats_report_t *p);
+
+/**
+ * Decode a message of type handler_stats_report_t like handler_stats_report_t_decode(), but allocate its
+ * strings and variable-length arrays from @p arena instead of with malloc().
+ * The message is valid as long as the arena memory is, and must not be passed
+ * to handler_stats_report_t_decode_cleanup().  Use handler_stats_report_t_decode_arena_size() to allocate
+ * the arena memory as one block, which releases the message with one free().
+ *
+ * @param buf The buffer containing the encoded message
+ * @param offset The byte offset into @p buf where the encoded message starts.
+ * @param maxlen The maximum number of bytes to read while decoding.
+ * @param msg Output parameter where the decoded message is stored
+ * @param arena The arena to allocate from.
+ * @return The number of bytes decoded, or <0 if an error occured or the arena
+ * hasn't enough space.
+ */
+LCM_NO_EXPORT
+int handler_stats_report_t_decode_arena(const void *buf, int offset, int maxlen, handler_stats_report_t *msg,
+    lcm_arena_t *arena);
+
+/**
+ * Compute the arena space that handler_stats_report_t_decode_arena() needs to decode a
+ * message, without decoding it.
+ *
+ * @param size Output parameter where the number of bytes is stored
+ * @return The number of bytes that decoding reads, or <0 if an error occured.
+ */
+LCM_NO_EXPORT
+int handler_stats_report_t_decode_arena_size(const void *buf, int offset, int maxlen, size_t *size);
+
+/**
+ * Check how many bytes are required to encode a message of type handler_stats_report_t
+ */
+LCM_NO_EXPORT
+int handler_stats_report_t_encoded_size(const handler_stats_report_t *p);
+
+// LCM support functions. Users should not call these
+LCM_NO_EXPORT
+int64_t __handler_stats_report_t_get_hash(void);
+LCM_NO_EXPORT
+uint64_t __handler_stats_report_t_hash_recursive(const __lcm_hash_ptr *p);
+LCM_NO_EXPORT
+int __handler_stats_report_t_encode_array(
+    void *buf, int offset, int maxlen, const handler_stats_report_t *p, int elements);
+LCM_NO_EXPORT
+int __handler_stats_report_t_decode_array(
+    const void *buf, int offset, int maxlen, handler_stats_report_t *p, int elements);
+LCM_NO_EXPORT
+int __handler_stats_report_t_decode_array_cleanup(handler_stats_report_t *p, int elements);
+LCM_NO_EXPORT
+int __handler_stats_report_t_decode_array_arena(const void *buf, int offset, int maxlen, handler_stats_report_t *p,
+    int elements, lcm_arena_t *arena);
+LCM_NO_EXPORT
+int __handler_stats_report_t_decode_array_arena_size(const void *buf, int offset, int maxlen,
+    int elements, size_t *size);
+LCM_NO_EXPORT
+int __handler_stats_report_t_encoded_array_size(const handler_stats_report_t *p, int elements);
+LCM_NO_EXPORT
+int __handler_stats_report_t_clone_array(const handler_stats_report_t *p, handler_stats_report_t *q, int elements);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
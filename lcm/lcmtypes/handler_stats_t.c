@@ -0,0 +1,386 @@
+// THIS IS AN AUTOMATICALLY GENERATED FILE.  DO NOT MODIFY
+// BY HAND!!
+//
+// Generated by the regenerate.sh script in this directory
+
+#include <string.h>
+#include "handler_stats_t.h"
+
+LCM_NO_EXPORT
+uint64_t __handler_stats_t_hash_recursive(const __lcm_hash_ptr *p)
+{
+    const __lcm_hash_ptr *fp;
+    for (fp = p; fp != NULL; fp = fp->parent)
+        if (fp->v == __handler_stats_t_get_hash)
+            return 0;
+
+    __lcm_hash_ptr cp;
+    cp.parent =  p;
+    cp.v = __handler_stats_t_get_hash;
+    (void) cp;
+
+    uint64_t hash = (uint64_t)0x0e147d6f63c2ef38LL
+         + __string_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int16_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+        ;
+
+    return (hash<<1) + ((hash>>63)&1);
+}
+
+LCM_NO_EXPORT
+int64_t __handler_stats_t_get_hash(void)
+{
+    return (int64_t) 0x1c28fadec785de70ULL;
+}
+
+LCM_NO_EXPORT
+int __handler_stats_t_encode_array(void *buf, int offset, int maxlen, const handler_stats_t *p, int elements)
+{
+    int pos = 0, element;
+    int thislen;
+
+    for (element = 0; element < elements; element++) {
+
+        thislen = __string_encode_array(buf, offset + pos, maxlen - pos, &(p[element].channel), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_calls), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].total_usec), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].max_usec), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].total_queue_delay_usec), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].max_queue_delay_usec), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int16_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_buckets), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, p[element].histogram, p[element].num_buckets);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_dropped), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+    }
+    return pos;
+}
+
+LCM_NO_EXPORT
+int handler_stats_t_encode(void *buf, int offset, int maxlen, const handler_stats_t *p)
+{
+    int pos = 0, thislen;
+    int64_t hash = HANDLER_STATS_T_FINGERPRINT;
+
+    thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &hash, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    thislen = __handler_stats_t_encode_array(buf, offset + pos, maxlen - pos, p, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    return pos;
+}
+
+LCM_NO_EXPORT
+int __handler_stats_t_encoded_array_size(const handler_stats_t *p, int elements)
+{
+    int size = 0, element;
+    for (element = 0; element < elements; element++) {
+
+        size += __string_encoded_array_size(&(p[element].channel), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].num_calls), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].total_usec), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].max_usec), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].total_queue_delay_usec), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].max_queue_delay_usec), 1);
+
+        size += __int16_t_encoded_array_size(&(p[element].num_buckets), 1);
+
+        size += __int64_t_encoded_array_size(p[element].histogram, p[element].num_buckets);
+
+        size += __int64_t_encoded_array_size(&(p[element].num_dropped), 1);
+
+    }
+    return size;
+}
+
+LCM_NO_EXPORT
+int handler_stats_t_encoded_size(const handler_stats_t *p)
+{
+    return 8 + __handler_stats_t_encoded_array_size(p, 1);
+}
+
+LCM_NO_EXPORT
+int __handler_stats_t_decode_array(const void *buf, int offset, int maxlen, handler_stats_t *p, int elements)
+{
+    int pos = 0, thislen, element;
+
+    for (element = 0; element < elements; element++) {
+
+        thislen = __string_decode_array(buf, offset + pos, maxlen - pos, &(p[element].channel), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_calls), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].total_usec), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].max_usec), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].total_queue_delay_usec), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].max_queue_delay_usec), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int16_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_buckets), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        p[element].histogram = (int64_t*) lcm_malloc(sizeof(int64_t) * p[element].num_buckets);
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, p[element].histogram, p[element].num_buckets);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_dropped), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+    }
+    return pos;
+}
+
+LCM_NO_EXPORT
+int __handler_stats_t_decode_array_cleanup(handler_stats_t *p, int elements)
+{
+    (void)p;
+    int element;
+    for (element = 0; element < elements; element++) {
+
+        __string_decode_array_cleanup(&(p[element].channel), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].num_calls), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].total_usec), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].max_usec), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].total_queue_delay_usec), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].max_queue_delay_usec), 1);
+
+        __int16_t_decode_array_cleanup(&(p[element].num_buckets), 1);
+
+        __int64_t_decode_array_cleanup(p[element].histogram, p[element].num_buckets);
+        if (p[element].histogram) free(p[element].histogram);
+
+        __int64_t_decode_array_cleanup(&(p[element].num_dropped), 1);
+
+    }
+    return 0;
+}
+
+LCM_NO_EXPORT
+int handler_stats_t_decode(const void *buf, int offset, int maxlen, handler_stats_t *p)
+{
+    int pos = 0, thislen;
+    int64_t hash = HANDLER_STATS_T_FINGERPRINT;
+
+    int64_t this_hash;
+    thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &this_hash, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+    if (this_hash != hash) return -1;
+
+    thislen = __handler_stats_t_decode_array(buf, offset + pos, maxlen - pos, p, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    return pos;
+}
+
+LCM_NO_EXPORT
+int handler_stats_t_decode_cleanup(handler_stats_t *p)
+{
+    return __handler_stats_t_decode_array_cleanup(p, 1);
+}
+
+LCM_NO_EXPORT
+int __handler_stats_t_decode_array_arena(const void *buf, int offset, int maxlen, handler_stats_t *p,
+    int elements, lcm_arena_t *arena)
+{
+    (void) arena;
+    int pos = 0, thislen, element;
+
+    for (element = 0; element < elements; element++) {
+
+        thislen = __string_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].channel), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_calls), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].total_usec), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].max_usec), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].total_queue_delay_usec), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].max_queue_delay_usec), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int16_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_buckets), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        p[element].histogram = (int64_t*) __lcm_arena_alloc_array(arena, sizeof(int64_t), p[element].num_buckets);
+        if (!p[element].histogram && p[element].num_buckets > 0) return -1;
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, p[element].histogram, p[element].num_buckets);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_dropped), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+    }
+    return pos;
+}
+
+LCM_NO_EXPORT
+int __handler_stats_t_decode_array_arena_size(const void *buf, int offset, int maxlen,
+    int elements, size_t *size)
+{
+    (void) size;
+    int pos = 0, thislen, element;
+
+    for (element = 0; element < elements; element++) {
+        int16_t __num_buckets;
+
+        thislen = __string_decode_array_arena_size(buf, offset + pos, maxlen - pos, 1, size);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __lcm_skip_array(maxlen - pos, 8, 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __lcm_skip_array(maxlen - pos, 8, 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __lcm_skip_array(maxlen - pos, 8, 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __lcm_skip_array(maxlen - pos, 8, 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __lcm_skip_array(maxlen - pos, 8, 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int16_t_decode_array(buf, offset + pos, maxlen - pos, &__num_buckets, 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        if (__lcm_arena_add_array(size, sizeof(int64_t), __num_buckets)) return -1;
+        thislen = __lcm_skip_array(maxlen - pos, 8, __num_buckets);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __lcm_skip_array(maxlen - pos, 8, 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+    }
+    return pos;
+}
+
+LCM_NO_EXPORT
+int handler_stats_t_decode_arena(const void *buf, int offset, int maxlen, handler_stats_t *p,
+    lcm_arena_t *arena)
+{
+    int pos = 0, thislen;
+    int64_t hash = HANDLER_STATS_T_FINGERPRINT;
+
+    int64_t this_hash;
+    thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &this_hash, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+    if (this_hash != hash) return -1;
+
+    thislen = __handler_stats_t_decode_array_arena(buf, offset + pos, maxlen - pos, p, 1, arena);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    return pos;
+}
+
+LCM_NO_EXPORT
+int handler_stats_t_decode_arena_size(const void *buf, int offset, int maxlen, size_t *size)
+{
+    int pos = 0, thislen;
+    int64_t hash = HANDLER_STATS_T_FINGERPRINT;
+
+    int64_t this_hash;
+    thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &this_hash, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+    if (this_hash != hash) return -1;
+
+    *size = 0;
+    thislen = __handler_stats_t_decode_array_arena_size(buf, offset + pos, maxlen - pos, 1, size);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    return pos;
+}
+
+LCM_NO_EXPORT
+int __handler_stats_t_clone_array(const handler_stats_t *p, handler_stats_t *q, int elements)
+{
+    int element;
+    for (element = 0; element < elements; element++) {
+
+        __string_clone_array(&(p[element].channel), &(q[element].channel), 1);
+
+        __int64_t_clone_array(&(p[element].num_calls), &(q[element].num_calls), 1);
+
+        __int64_t_clone_array(&(p[element].total_usec), &(q[element].total_usec), 1);
+
+        __int64_t_clone_array(&(p[element].max_usec), &(q[element].max_usec), 1);
+
+        __int64_t_clone_array(&(p[element].total_queue_delay_usec), &(q[element].total_queue_delay_usec), 1);
+
+        __int64_t_clone_array(&(p[element].max_queue_delay_usec), &(q[element].max_queue_delay_usec), 1);
+
+        __int16_t_clone_array(&(p[element].num_buckets), &(q[element].num_buckets), 1);
+
+        q[element].histogram = (int64_t*) lcm_malloc(sizeof(int64_t) * q[element].num_buckets);
+        __int64_t_clone_array(p[element].histogram, q[element].histogram, p[element].num_buckets);
+
+        __int64_t_clone_array(&(p[element].num_dropped), &(q[element].num_dropped), 1);
+
+    }
+    return 0;
+}
+
+LCM_NO_EXPORT
+handler_stats_t *handler_stats_t_copy(const handler_stats_t *p)
+{
+    handler_stats_t *q = (handler_stats_t*) malloc(sizeof(handler_stats_t));
+    __handler_stats_t_clone_array(p, q, 1);
+    return q;
+}
+
+LCM_NO_EXPORT
+void handler_stats_t_destroy(handler_stats_t *p)
+{
+    __handler_stats_t_decode_array_cleanup(p, 1);
+    free(p);
+}
+
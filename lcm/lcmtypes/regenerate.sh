@@ -15,11 +15,15 @@ LCMTYPES="$(cd $(dirname "$0") && pwd)"
 
 # Generate the files into the source tree.
 lcmgen/lcm-gen -c --c-no-pubsub --c-cpath="${LCMTYPES}" --c-hpath="${LCMTYPES}" \
-    "${LCMTYPES}"/channel_port_mapping.lcm
+    "${LCMTYPES}"/channel_port_mapping.lcm "${LCMTYPES}"/handler_stats.lcm
 
 # Edit the generated code in the source tree.
 sed -i -f "${LCMTYPES}"/regenerate.sed \
     "${LCMTYPES}"/channel_to_port_t.h \
     "${LCMTYPES}"/channel_to_port_t.c \
     "${LCMTYPES}"/channel_port_map_update_t.h \
-    "${LCMTYPES}"/channel_port_map_update_t.c
+    "${LCMTYPES}"/channel_port_map_update_t.c \
+    "${LCMTYPES}"/handler_stats_t.h \
+    "${LCMTYPES}"/handler_stats_t.c \
+    "${LCMTYPES}"/handler_stats_report_t.h \
+    "${LCMTYPES}"/handler_stats_report_t.c
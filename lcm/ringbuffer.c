@@ -1,45 +1,66 @@
 #include "ringbuffer.h"
 
+// the consistency checks are asserts, so keep them in builds with NDEBUG too
+#ifdef LCM_RINGBUF_DEBUG
+#undef NDEBUG
+#endif
+
 #include <assert.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
+#include "lcm_internal.h"
 
 // must be power of 2
 #define ALIGNMENT 32
+// of the memory of a ringbuffer, so that a record is at worst ALIGNMENT bytes
+// off from this alignment
+#define DATA_ALIGNMENT 64
 
 #define MAGIC 0x067f8687
+// a chunk that was released while chunks on both sides of it were still in use
+#define MAGIC_RELEASED 0x2f8b1e05
 typedef struct _lcm_ringbuf_rec lcm_ringbuf_rec_t;
 
-#define EXTRA_RETENTIVE 0
+// the most strictly aligned types, which the header of a record is padded to,
+// so that a chunk can hold any of them like the memory of malloc()
+typedef union {
+    long double ld;
+    int64_t i;
+    void *p;
+    void (*f)(void);
+} lcm_ringbuf_align_t;
 
 struct _lcm_ringbuf_rec {
     int32_t magic;
     lcm_ringbuf_rec_t *prev;
     lcm_ringbuf_rec_t *next;
     unsigned int length;
-    char buf[];
+    lcm_ringbuf_align_t buf[];
 };
 
 struct _lcm_ringbuf {
     char *data;
     unsigned int size;  // allocated size of data
     unsigned int used;  // total bytes currently allocated
+    size_t map_size;    // if nonzero, data was mapped by lcm_ringbuf_new_locked()
 
     lcm_ringbuf_rec_t *head;
     lcm_ringbuf_rec_t *tail;
 };
 
+// Walks the whole record list to check that it is consistent.  Only built
+// with LCM_RINGBUF_DEBUG, since it makes every operation O(n).
 static inline void ringbuf_self_test(lcm_ringbuf_t *ring)
 {
-    if (!EXTRA_RETENTIVE)
-        return;
-
-#if !defined(NDEBUG)
+#ifdef LCM_RINGBUF_DEBUG
     lcm_ringbuf_rec_t *prev = NULL;
-#endif
     lcm_ringbuf_rec_t *rec = ring->head;
 
     if (rec == NULL) {
@@ -48,33 +69,52 @@ static inline void ringbuf_self_test(lcm_ringbuf_t *ring)
         return;
     }
 
-#if !defined(NDEBUG)
-    int total_length = 0;
-#endif
+    // released chunks are only kept between chunks that are in use
+    assert(ring->head->magic == MAGIC);
+    assert(ring->tail->magic == MAGIC);
 
+    unsigned int total_length = 0;
     while (1) {
         assert(rec->prev == prev);
-        assert(rec->magic == MAGIC);
-
-#if !defined(NDEBUG)
+        assert(rec->magic == MAGIC || rec->magic == MAGIC_RELEASED);
         total_length += rec->length;
-#endif
 
         if (!rec->next)
             break;
 
-#if !defined(NDEBUG)
         prev = rec;
-#endif
         rec = rec->next;
     }
 
     assert(ring->tail == rec);
-#if !defined(NDEBUG)
     assert(total_length == ring->used);
-#endif
 
     // check for loops?
+#else
+    (void) ring;
+#endif
+}
+
+// gives back the space of the released chunks at either end
+static void ringbuf_trim(lcm_ringbuf_t *ring)
+{
+    while (ring->head && ring->head->magic == MAGIC_RELEASED) {
+        lcm_ringbuf_rec_t *rec = ring->head;
+        ring->used -= rec->length;
+        ring->head = rec->next;
+        if (!ring->head)
+            ring->tail = NULL;
+        else
+            ring->head->prev = NULL;
+        rec->magic = 0;
+    }
+    while (ring->tail && ring->tail->magic == MAGIC_RELEASED) {
+        lcm_ringbuf_rec_t *rec = ring->tail;
+        ring->used -= rec->length;
+        ring->tail = rec->prev;
+        ring->tail->next = NULL;
+        rec->magic = 0;
+    }
 }
 
 lcm_ringbuf_t *lcm_ringbuf_new(unsigned int ring_size)
@@ -82,17 +122,76 @@ lcm_ringbuf_t *lcm_ringbuf_new(unsigned int ring_size)
     lcm_ringbuf_t *ring;
 
     ring = (lcm_ringbuf_t *) malloc(sizeof(lcm_ringbuf_t));
-    ring->data = (char *) malloc(ring_size);
+#ifdef WIN32
+    ring->data = (char *) _aligned_malloc(ring_size, DATA_ALIGNMENT);
+#else
+    void *data = NULL;
+    if (posix_memalign(&data, DATA_ALIGNMENT, ring_size))
+        data = NULL;
+    ring->data = (char *) data;
+#endif
+    ring->size = ring_size;
+    ring->used = 0;
+    ring->map_size = 0;
+    ring->head = NULL;
+    ring->tail = NULL;
+    return ring;
+}
+
+lcm_ringbuf_t *lcm_ringbuf_new_locked(unsigned int ring_size, int numa_node)
+{
+#ifdef WIN32
+    (void) numa_node;
+    return lcm_ringbuf_new(ring_size);
+#else
+    // a whole number of 2 MB huge pages
+    size_t map_size = ((size_t) ring_size + (1 << 21) - 1) & ~(size_t) ((1 << 21) - 1);
+    void *data = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    data = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                -1, 0);
+#endif
+    if (data == MAP_FAILED) {
+        data = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED) {
+            perror("mmap (ring buffer)");
+            return lcm_ringbuf_new(ring_size);
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(data, map_size, MADV_HUGEPAGE);
+#endif
+    }
+    // before any of it is faulted in
+    if (numa_node >= 0 && lcm_numa_bind(data, map_size, numa_node) < 0)
+        fprintf(stderr, "Warning: Unable to allocate ring buffer on NUMA node %d\n", numa_node);
+    // mlock() also faults all of it in.  Without the privilege to lock that
+    // much memory, at least touch every page now.
+    if (mlock(data, map_size) < 0) {
+        fprintf(stderr, "Warning: Unable to lock %u byte ring buffer into memory\n", ring_size);
+        memset(data, 0, map_size);
+    }
+
+    lcm_ringbuf_t *ring = (lcm_ringbuf_t *) malloc(sizeof(lcm_ringbuf_t));
+    ring->data = (char *) data;
     ring->size = ring_size;
     ring->used = 0;
+    ring->map_size = map_size;
     ring->head = NULL;
     ring->tail = NULL;
     return ring;
+#endif
 }
 
 void lcm_ringbuf_free(lcm_ringbuf_t *ring)
 {
-    free(ring->data);
+#ifdef WIN32
+    _aligned_free(ring->data);
+#else
+    if (ring->map_size)
+        munmap(ring->data, ring->map_size);
+    else
+        free(ring->data);
+#endif
     free(ring);
 }
 
@@ -124,7 +223,7 @@ char *lcm_ringbuf_alloc(lcm_ringbuf_t *ring, unsigned int len)
         rec->magic = MAGIC;
 
         ringbuf_self_test(ring);
-        return rec->buf;
+        return (char *) rec->buf;
     }
 
     assert(ring->head && ring->tail);
@@ -163,7 +262,7 @@ char *lcm_ringbuf_alloc(lcm_ringbuf_t *ring, unsigned int len)
     rec->magic = MAGIC;
 
     ringbuf_self_test(ring);
-    return rec->buf;
+    return (char *) rec->buf;
 }
 
 unsigned int lcm_ringbuf_capacity(lcm_ringbuf_t *ring)
@@ -201,40 +300,105 @@ void lcm_ringbuf_shrink_last(lcm_ringbuf_t *ring, const char *buf, unsigned int
 }
 
 /*
- * Releases a previously-allocated chunk of the ring buffer.  Only the most
- * recently allocated, or the least recently allocated chunk can be released.
+ * Resizes the n most recently allocated chunks of the ring buffer in one pass,
+ * sliding each surviving chunk down so that the space given up by its
+ * predecessors can be reused.  A length of zero releases the chunk.  On
+ * return, bufs[] holds the new location of every surviving chunk, and NULL
+ * for released ones.
  */
-void lcm_ringbuf_dealloc(lcm_ringbuf_t *ring, char *buf)
+void lcm_ringbuf_compact_tail(lcm_ringbuf_t *ring, char **bufs, const unsigned int *lens, int n)
 {
     ringbuf_self_test(ring);
 
-    lcm_ringbuf_rec_t *rec = (lcm_ringbuf_rec_t *) (buf - offsetof(lcm_ringbuf_rec_t, buf));
-
-    assert(rec == ring->head || rec == ring->tail);
+    if (n <= 0)
+        return;
 
+    lcm_ringbuf_rec_t *rec = (lcm_ringbuf_rec_t *) (bufs[0] - offsetof(lcm_ringbuf_rec_t, buf));
     assert(rec->magic == MAGIC);
+    assert((lcm_ringbuf_rec_t *) (bufs[n - 1] - offsetof(lcm_ringbuf_rec_t, buf)) == ring->tail);
 
-    ring->used -= rec->length;
+    lcm_ringbuf_rec_t *prev = rec->prev;
+    char *pos = (char *) rec;
 
-    if (rec == ring->head) {
-        ring->head = rec->next;
-        if (!ring->head)
-            ring->tail = NULL;
-        else
-            ring->head->prev = NULL;
-    } else if (rec == ring->tail) {
-        ring->tail = rec->prev;
-        if (!ring->tail)
-            ring->head = NULL;
+    int i;
+    for (i = 0; i < n; i++) {
+        rec = (lcm_ringbuf_rec_t *) (bufs[i] - offsetof(lcm_ringbuf_rec_t, buf));
+        assert(rec->magic == MAGIC);
+
+        // chunks after a wrap-around start over at the beginning of the data
+        if ((char *) rec < pos)
+            pos = (char *) rec;
+
+        ring->used -= rec->length;
+
+        if (!lens[i]) {
+            rec->magic = 0;
+            bufs[i] = NULL;
+            continue;
+        }
+
+        unsigned int newlen = lens[i] + sizeof(lcm_ringbuf_rec_t);
+        newlen = (newlen + ALIGNMENT - 1) & (~(ALIGNMENT - 1));
+        assert(rec->length >= newlen);
+
+        // the destination never lies past the source, and the header of the
+        // destination never overlaps the data of the source.
+        lcm_ringbuf_rec_t *dst = (lcm_ringbuf_rec_t *) pos;
+        if (dst != rec)
+            memmove(dst->buf, rec->buf, lens[i]);
+
+        dst->magic = MAGIC;
+        dst->length = newlen;
+        dst->prev = prev;
+        dst->next = NULL;
+        if (prev)
+            prev->next = dst;
         else
-            ring->tail->next = NULL;
+            ring->head = dst;
+        ring->used += newlen;
+
+        prev = dst;
+        pos += newlen;
+        bufs[i] = (char *) dst->buf;
+    }
+
+    ring->tail = prev;
+    if (prev)
+        prev->next = NULL;
+    else
+        ring->head = NULL;
+    // the chunks before the released ones may have been released already
+    ringbuf_trim(ring);
+
+    ringbuf_self_test(ring);
+}
+
+/*
+ * Releases a previously-allocated chunk of the ring buffer.  A chunk in the
+ * middle is only marked as released, and its space is reused once all of the
+ * chunks allocated before it, or all of the ones allocated after it, are
+ * released as well.
+ */
+void lcm_ringbuf_dealloc(lcm_ringbuf_t *ring, char *buf)
+{
+    ringbuf_self_test(ring);
+
+    lcm_ringbuf_rec_t *rec = (lcm_ringbuf_rec_t *) (buf - offsetof(lcm_ringbuf_rec_t, buf));
+
+    assert(rec->magic == MAGIC);
+    assert(ring->head && ring->tail);
+
+    rec->magic = MAGIC_RELEASED;
+    if (rec != ring->head && rec != ring->tail) {
+        ringbuf_self_test(ring);
+        return;
     }
 
+    ringbuf_trim(ring);
     assert((!ring->head && !ring->tail) || (ring->head->prev == NULL && ring->tail->next == NULL));
     if (0 == ring->used) {
         assert(!ring->head && !ring->tail);
     }
 
-    rec->magic = 0;
     ringbuf_self_test(ring);
 }
@@ -13,6 +13,16 @@ typedef struct _lcm_ringbuf lcm_ringbuf_t;
 
 LCM_NO_EXPORT
 lcm_ringbuf_t *lcm_ringbuf_new(unsigned int ring_size);
+
+/*
+ * Like lcm_ringbuf_new(), but the memory is mapped up front, from huge pages
+ * if the system has some to spare, and locked into RAM, so that using the
+ * ring buffer never page faults.  Falls back to ordinary memory where that
+ * is not possible.  If numa_node is not -1, the memory is allocated from that
+ * NUMA node.
+ */
+LCM_NO_EXPORT
+lcm_ringbuf_t *lcm_ringbuf_new_locked(unsigned int ring_size, int numa_node);
 LCM_NO_EXPORT
 void lcm_ringbuf_free(lcm_ringbuf_t *ring);
 
@@ -30,6 +40,15 @@ char *lcm_ringbuf_alloc(lcm_ringbuf_t *ring, unsigned int len);
 LCM_NO_EXPORT
 void lcm_ringbuf_shrink_last(lcm_ringbuf_t *ring, const char *buf, unsigned int len);
 
+/*
+ * Resizes the n most recently allocated chunks of the ring buffer, oldest
+ * first, to lens[i] bytes each.  Surviving chunks are moved so that they stay
+ * packed, and a length of zero releases the chunk.  On return, bufs[] holds
+ * the new location of each chunk, or NULL if it was released.
+ */
+LCM_NO_EXPORT
+void lcm_ringbuf_compact_tail(lcm_ringbuf_t *ring, char **bufs, const unsigned int *lens, int n);
+
 LCM_NO_EXPORT
 unsigned int lcm_ringbuf_capacity(lcm_ringbuf_t *ring);
 
@@ -37,8 +56,10 @@ LCM_NO_EXPORT
 unsigned int lcm_ringbuf_used(lcm_ringbuf_t *ring);
 
 /*
- * Releases a previously-allocated chunk of the ring buffer.  Only the most
- * recently allocated, or the least recently allocated chunk can be released.
+ * Releases a previously-allocated chunk of the ring buffer.  Chunks can be
+ * released in any order, but the space of a chunk can only be allocated again
+ * once every chunk allocated before it, or every chunk allocated after it, is
+ * released too.
  */
 LCM_NO_EXPORT
 void lcm_ringbuf_dealloc(lcm_ringbuf_t *ring, char *buf);
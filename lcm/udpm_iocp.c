@@ -0,0 +1,216 @@
+#include "udpm_iocp.h"
+
+#ifdef USE_IOCP
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <mswsock.h>
+
+// The overlapped receives that are outstanding on each socket.  Each has
+// room for the source address, the control messages, and the largest
+// datagram followed by a 0 byte.  Datagrams that arrive while all of them are
+// filled wait in the socket, until some are handed back.
+#define IOCP_DEPTH 32
+#define IOCP_CONTROL_SIZE 128
+#define IOCP_DATA_SIZE 65536
+
+// most completions that are taken off the port at once
+#define IOCP_MAX_WAIT 64
+
+typedef struct _iocp_source_t iocp_source_t;
+
+// an overlapped receive, and what it receives into
+typedef struct _iocp_request_t {
+    OVERLAPPED overlapped;  // first, so that its completion leads back here
+    iocp_source_t *src;
+    WSAMSG wsamsg;
+    WSABUF wsabuf;
+    struct sockaddr_in from;
+    char control[IOCP_CONTROL_SIZE];
+    char data[IOCP_DATA_SIZE + 1];
+} iocp_request_t;
+
+// a socket, or a socket of lcm_iocp_poll(), and its requests
+struct _iocp_source_t {
+    SOCKET fd;
+    void *user;
+    int is_poll;
+    int num_requests;
+    iocp_request_t *requests;
+};
+
+struct _lcm_iocp {
+    HANDLE port;
+    LPFN_WSARECVMSG recvmsg;  // WSARecvMsg(), which is only found at run time
+    GPtrArray *sources;
+    volatile LONG pending;  // requests that have not completed yet
+};
+
+// starts the receive of req
+static int iocp_arm(lcm_iocp_t *iocp, iocp_request_t *req)
+{
+    iocp_source_t *src = req->src;
+    memset(&req->overlapped, 0, sizeof(req->overlapped));
+    req->wsabuf.buf = req->data;
+    int status;
+    if (src->is_poll) {
+        // a 0 byte receive completes once there is data, and takes none of it
+        DWORD flags = 0;
+        req->wsabuf.len = 0;
+        status = WSARecv(src->fd, &req->wsabuf, 1, NULL, &flags, &req->overlapped, NULL);
+    } else {
+        req->wsabuf.len = IOCP_DATA_SIZE;
+        memset(&req->wsamsg, 0, sizeof(req->wsamsg));
+        req->wsamsg.name = (LPSOCKADDR) &req->from;
+        req->wsamsg.namelen = sizeof(req->from);
+        req->wsamsg.lpBuffers = &req->wsabuf;
+        req->wsamsg.dwBufferCount = 1;
+        req->wsamsg.Control.buf = req->control;
+        req->wsamsg.Control.len = sizeof(req->control);
+        status = iocp->recvmsg(src->fd, &req->wsamsg, NULL, &req->overlapped, NULL);
+    }
+    // even a receive that is done right away completes through the port
+    if (status == SOCKET_ERROR && WSAGetLastError() != WSA_IO_PENDING) {
+        fprintf(stderr, "LCM: overlapped receive failed (%d)\n", WSAGetLastError());
+        return -1;
+    }
+    InterlockedIncrement(&iocp->pending);
+    return 0;
+}
+
+static int iocp_add_source(lcm_iocp_t *iocp, SOCKET fd, void *user, int is_poll, int depth)
+{
+    if (!CreateIoCompletionPort((HANDLE) fd, iocp->port, 0, 0)) {
+        fprintf(stderr, "LCM: CreateIoCompletionPort failed (%lu)\n", GetLastError());
+        return -1;
+    }
+    iocp_source_t *src = (iocp_source_t *) calloc(1, sizeof(iocp_source_t));
+    src->fd = fd;
+    src->user = user;
+    src->is_poll = is_poll;
+    src->num_requests = depth;
+    src->requests = (iocp_request_t *) calloc(depth, sizeof(iocp_request_t));
+    g_ptr_array_add(iocp->sources, src);
+    for (int i = 0; i < depth; i++) {
+        src->requests[i].src = src;
+        if (iocp_arm(iocp, &src->requests[i]) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+lcm_iocp_t *lcm_iocp_new(void)
+{
+    HANDLE port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0);
+    if (!port) {
+        fprintf(stderr, "LCM: CreateIoCompletionPort failed (%lu)\n", GetLastError());
+        return NULL;
+    }
+    lcm_iocp_t *iocp = (lcm_iocp_t *) calloc(1, sizeof(lcm_iocp_t));
+    iocp->port = port;
+    iocp->sources = g_ptr_array_new();
+    return iocp;
+}
+
+void lcm_iocp_destroy(lcm_iocp_t *iocp)
+{
+    guint i;
+    for (i = 0; i < iocp->sources->len; i++) {
+        iocp_source_t *src = (iocp_source_t *) g_ptr_array_index(iocp->sources, i);
+        CancelIoEx((HANDLE) src->fd, NULL);
+    }
+    // the canceled requests still complete, and write to their buffers until
+    // they do
+    while (iocp->pending > 0) {
+        OVERLAPPED_ENTRY entries[IOCP_MAX_WAIT];
+        ULONG n = 0;
+        if (!GetQueuedCompletionStatusEx(iocp->port, entries, IOCP_MAX_WAIT, &n, 1000, FALSE)) {
+            fprintf(stderr, "LCM: %ld overlapped receives did not end\n", iocp->pending);
+            break;
+        }
+        InterlockedAdd(&iocp->pending, -(LONG) n);
+    }
+    CloseHandle(iocp->port);
+    for (i = 0; i < iocp->sources->len; i++) {
+        iocp_source_t *src = (iocp_source_t *) g_ptr_array_index(iocp->sources, i);
+        free(src->requests);
+        free(src);
+    }
+    g_ptr_array_free(iocp->sources, TRUE);
+    free(iocp);
+}
+
+int lcm_iocp_add(lcm_iocp_t *iocp, SOCKET fd, void *user)
+{
+    if (!iocp->recvmsg) {
+        GUID guid = WSAID_WSARECVMSG;
+        DWORD size;
+        if (WSAIoctl(fd, SIO_GET_EXTENSION_FUNCTION_POINTER, &guid, sizeof(guid),
+                     &iocp->recvmsg, sizeof(iocp->recvmsg), &size, NULL, NULL) == SOCKET_ERROR) {
+            fprintf(stderr, "LCM: WSARecvMsg is not available (%d)\n", WSAGetLastError());
+            return -1;
+        }
+    }
+    return iocp_add_source(iocp, fd, user, 0, IOCP_DEPTH);
+}
+
+int lcm_iocp_poll(lcm_iocp_t *iocp, SOCKET fd, void *user)
+{
+    return iocp_add_source(iocp, fd, user, 1, 1);
+}
+
+int lcm_iocp_wait(lcm_iocp_t *iocp, lcm_iocp_packet_t *pkts, int max)
+{
+    OVERLAPPED_ENTRY entries[IOCP_MAX_WAIT];
+    ULONG n = 0;
+    if (!GetQueuedCompletionStatusEx(iocp->port, entries, MIN(max, IOCP_MAX_WAIT), &n, INFINITE,
+                                     FALSE)) {
+        errno = GetLastError();
+        return -1;
+    }
+    InterlockedAdd(&iocp->pending, -(LONG) n);
+
+    int npkts = 0;
+    for (ULONG i = 0; i < n; i++) {
+        iocp_request_t *req = (iocp_request_t *) entries[i].lpOverlapped;
+        iocp_source_t *src = req->src;
+        DWORD size = 0;
+        DWORD flags = 0;
+        BOOL ok = WSAGetOverlappedResult(src->fd, &req->overlapped, &size, FALSE, &flags);
+        lcm_iocp_packet_t *pkt = &pkts[npkts];
+        memset(pkt, 0, sizeof(*pkt));
+        pkt->user = src->user;
+        pkt->request = req;
+        if (src->is_poll) {
+            // readable, or closed
+            npkts++;
+            continue;
+        }
+        // a datagram that did not fit, or an error such as the WSAECONNRESET
+        // of an ICMP port unreachable, is skipped
+        if (!ok || (flags & MSG_PARTIAL)) {
+            iocp_arm(iocp, req);
+            continue;
+        }
+        req->data[size] = 0;
+        pkt->data = req->data;
+        pkt->size = size;
+        pkt->msg.msg_name = (struct sockaddr *) &req->from;
+        pkt->msg.msg_namelen = req->wsamsg.namelen;
+        pkt->msg.msg_control = req->control;
+        pkt->msg.msg_controllen = req->wsamsg.Control.len;
+        npkts++;
+    }
+    return npkts;
+}
+
+void lcm_iocp_release(lcm_iocp_t *iocp, const lcm_iocp_packet_t *pkts, int n)
+{
+    for (int i = 0; i < n; i++)
+        iocp_arm(iocp, (iocp_request_t *) pkts[i].request);
+}
+
+#endif
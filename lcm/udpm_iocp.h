@@ -0,0 +1,85 @@
+#ifndef __lcm_udpm_iocp_h__
+#define __lcm_udpm_iocp_h__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef WIN32
+#define USE_IOCP
+#endif
+
+#ifdef USE_IOCP
+
+#include "lcm_export.h"
+#include "udpm_util.h"
+
+/*
+ * An I/O completion port that receives from several datagram sockets at
+ * once, for the iocp option of udpm on Windows.  Each socket has a number of
+ * overlapped WSARecvMsg() requests outstanding, each into a buffer of its
+ * own, which the kernel fills while the read thread is busy with the previous
+ * datagrams.  A batch of them is taken off the port with a single call,
+ * instead of a select() and a recvmsg() for each datagram.
+ */
+typedef struct _lcm_iocp lcm_iocp_t;
+
+typedef struct _lcm_iocp_packet_t {
+    void *user;  // of the socket, or of the socket of lcm_iocp_poll()
+    char *data;  // payload, followed by a 0 byte, or NULL for lcm_iocp_poll()
+    int size;
+    struct msghdr msg;  // the source address and control messages
+    void *request;      // the request that holds it
+} lcm_iocp_packet_t;
+
+/*
+ * Returns NULL, after printing why, if the completion port can not be
+ * created.
+ */
+LCM_NO_EXPORT
+lcm_iocp_t *lcm_iocp_new(void);
+
+/*
+ * Cancels the requests, and waits for them to end, so that the sockets may be
+ * closed right after.
+ */
+LCM_NO_EXPORT
+void lcm_iocp_destroy(lcm_iocp_t *iocp);
+
+/*
+ * Starts receiving from the socket fd.  user is returned with each of its
+ * datagrams.
+ */
+LCM_NO_EXPORT
+int lcm_iocp_add(lcm_iocp_t *iocp, SOCKET fd, void *user);
+
+/*
+ * Makes lcm_iocp_wait() return a packet with data NULL, and user, once the
+ * stream socket fd is readable, such as the emulated pipe that tells read
+ * threads to exit.  Nothing is read from it.
+ */
+LCM_NO_EXPORT
+int lcm_iocp_poll(lcm_iocp_t *iocp, SOCKET fd, void *user);
+
+/*
+ * Waits until something arrives, and takes up to max datagrams, and the
+ * readable socket of lcm_iocp_poll(), off the completion port.  Their buffers
+ * belong to the caller until they are handed back with lcm_iocp_release().
+ * Returns the number of packets, which may be 0, or -1 on error.
+ */
+LCM_NO_EXPORT
+int lcm_iocp_wait(lcm_iocp_t *iocp, lcm_iocp_packet_t *pkts, int max);
+
+/*
+ * Hands the buffers of n packets back, for their next datagrams.
+ */
+LCM_NO_EXPORT
+void lcm_iocp_release(lcm_iocp_t *iocp, const lcm_iocp_packet_t *pkts, int n);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,374 @@
+#include "udpm_uring.h"
+
+#ifdef USE_IO_URING
+
+#include <endian.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <netinet/in.h>
+
+// the kernel that has this also has multishot recvmsg and provided buffer
+// rings, which have no feature flags of their own
+#ifndef IORING_FEAT_REG_REG_RING
+#define IORING_FEAT_REG_REG_RING (1U << 13)
+#endif
+
+#define URING_ENTRIES 256
+
+// The provided buffers, all in one buffer group.  Each has room for the
+// header of its completion, the source address, the control messages, and
+// the largest datagram followed by a 0 byte.  A socket whose multishot
+// request runs out of buffers keeps its datagrams, and is read again once
+// some are handed back.
+#define URING_NUM_BUFS 64
+#define URING_BGID 0
+#define URING_NAME_SIZE sizeof(struct sockaddr_in)
+#define URING_CONTROL_SIZE 128
+#define URING_BUF_SIZE \
+    (sizeof(struct io_uring_recvmsg_out) + URING_NAME_SIZE + URING_CONTROL_SIZE + 65536)
+
+// a socket, or a file descriptor of lcm_uring_poll(), and its request
+typedef struct _uring_source_t {
+    int fd;
+    void *user;
+    int is_poll;
+    // removed sources report nothing more, and are freed once their request
+    // has ended
+    int removed;
+    struct msghdr msg;
+} uring_source_t;
+
+struct _lcm_uring {
+    int fd;
+    void *ring;
+    size_t ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    uint32_t sq_entries;
+    uint32_t *sq_head;
+    uint32_t *sq_tail;
+    uint32_t *sq_mask;
+    uint32_t *sq_array;
+    uint32_t *cq_head;
+    uint32_t *cq_tail;
+    uint32_t *cq_mask;
+    struct io_uring_cqe *cqes;
+    uint32_t to_submit;
+
+    struct io_uring_buf_ring *buf_ring;
+    size_t buf_ring_size;
+    char *bufs;
+
+    GHashTable *sources;  // uring_source_t by file descriptor
+    GSList *removed;      // uring_source_t whose request has not ended yet
+};
+
+static int uring_enter(lcm_uring_t *uring, unsigned int min_complete, unsigned int flags)
+{
+    int status = syscall(__NR_io_uring_enter, uring->fd, uring->to_submit, min_complete, flags,
+                         NULL, 0);
+    if (status > 0)
+        uring->to_submit -= status;
+    return status;
+}
+
+// takes the next submission queue entry, submitting the queued ones first if
+// there is none left
+static struct io_uring_sqe *uring_get_sqe(lcm_uring_t *uring)
+{
+    uint32_t tail = *uring->sq_tail;
+    if (tail - __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE) >= uring->sq_entries) {
+        if (uring_enter(uring, 0, 0) < 0)
+            return NULL;
+    }
+    uint32_t index = tail & *uring->sq_mask;
+    struct io_uring_sqe *sqe = &uring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    uring->sq_array[index] = index;
+    return sqe;
+}
+
+static void uring_commit_sqe(lcm_uring_t *uring)
+{
+    __atomic_store_n(uring->sq_tail, *uring->sq_tail + 1, __ATOMIC_RELEASE);
+    uring->to_submit++;
+}
+
+// queues the request of src, which is submitted by the next lcm_uring_wait()
+static int uring_arm(lcm_uring_t *uring, uring_source_t *src)
+{
+    struct io_uring_sqe *sqe = uring_get_sqe(uring);
+    if (!sqe)
+        return -1;
+    sqe->fd = src->fd;
+    sqe->user_data = (uintptr_t) src;
+    if (src->is_poll) {
+        // one shot, so that it is checked again after each read
+        sqe->opcode = IORING_OP_POLL_ADD;
+#if __BYTE_ORDER == __BIG_ENDIAN
+        sqe->poll32_events = POLLIN << 16;
+#else
+        sqe->poll32_events = POLLIN;
+#endif
+    } else {
+        sqe->opcode = IORING_OP_RECVMSG;
+        sqe->addr = (uintptr_t) &src->msg;
+        sqe->len = 1;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = URING_BGID;
+    }
+    uring_commit_sqe(uring);
+    return 0;
+}
+
+static void uring_provide_buf(lcm_uring_t *uring, uint16_t bid, uint16_t *tail)
+{
+    struct io_uring_buf *buf = &uring->buf_ring->bufs[*tail & (URING_NUM_BUFS - 1)];
+    buf->addr = (uintptr_t) (uring->bufs + (size_t) bid * URING_BUF_SIZE);
+    buf->len = URING_BUF_SIZE;
+    buf->bid = bid;
+    (*tail)++;
+}
+
+lcm_uring_t *lcm_uring_new(void)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_COOP_TASKRUN;
+    int fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    if (fd < 0) {
+        perror("lcm_uring_new -- io_uring_setup");
+        return NULL;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) ||
+        !(params.features & IORING_FEAT_REG_REG_RING)) {
+        fprintf(stderr, "lcm_uring_new -- io_uring needs Linux 6.3 or later\n");
+        close(fd);
+        return NULL;
+    }
+
+    lcm_uring_t *uring = (lcm_uring_t *) calloc(1, sizeof(lcm_uring_t));
+    uring->fd = fd;
+    uring->sources = g_hash_table_new(g_direct_hash, g_direct_equal);
+    uring->ring_size = MAX(params.sq_off.array + params.sq_entries * sizeof(uint32_t),
+                           params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe));
+    uring->ring = mmap(NULL, uring->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       fd, IORING_OFF_SQ_RING);
+    uring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    uring->sqes = (struct io_uring_sqe *) mmap(NULL, uring->sqes_size, PROT_READ | PROT_WRITE,
+                                               MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (uring->ring == MAP_FAILED || uring->sqes == MAP_FAILED) {
+        perror("lcm_uring_new -- mmap");
+        goto fail;
+    }
+    char *ring = (char *) uring->ring;
+    uring->sq_entries = params.sq_entries;
+    uring->sq_head = (uint32_t *) (ring + params.sq_off.head);
+    uring->sq_tail = (uint32_t *) (ring + params.sq_off.tail);
+    uring->sq_mask = (uint32_t *) (ring + params.sq_off.ring_mask);
+    uring->sq_array = (uint32_t *) (ring + params.sq_off.array);
+    uring->cq_head = (uint32_t *) (ring + params.cq_off.head);
+    uring->cq_tail = (uint32_t *) (ring + params.cq_off.tail);
+    uring->cq_mask = (uint32_t *) (ring + params.cq_off.ring_mask);
+    uring->cqes = (struct io_uring_cqe *) (ring + params.cq_off.cqes);
+
+    // the buffer ring has to be page aligned
+    uring->buf_ring_size = URING_NUM_BUFS * sizeof(struct io_uring_buf);
+    uring->buf_ring = (struct io_uring_buf_ring *) mmap(
+        NULL, uring->buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    uring->bufs = (char *) malloc((size_t) URING_NUM_BUFS * URING_BUF_SIZE);
+    if (uring->buf_ring == MAP_FAILED || !uring->bufs) {
+        perror("lcm_uring_new -- allocating the buffers");
+        goto fail;
+    }
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uintptr_t) uring->buf_ring;
+    reg.ring_entries = URING_NUM_BUFS;
+    reg.bgid = URING_BGID;
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        perror("lcm_uring_new -- IORING_REGISTER_PBUF_RING");
+        goto fail;
+    }
+    uint16_t tail = 0;
+    int i;
+    for (i = 0; i < URING_NUM_BUFS; i++)
+        uring_provide_buf(uring, i, &tail);
+    __atomic_store_n(&uring->buf_ring->tail, tail, __ATOMIC_RELEASE);
+    return uring;
+
+fail:
+    lcm_uring_destroy(uring);
+    return NULL;
+}
+
+void lcm_uring_destroy(lcm_uring_t *uring)
+{
+    // closing the ring cancels the requests
+    close(uring->fd);
+    if (uring->ring && uring->ring != MAP_FAILED)
+        munmap(uring->ring, uring->ring_size);
+    if (uring->sqes && uring->sqes != MAP_FAILED)
+        munmap(uring->sqes, uring->sqes_size);
+    if (uring->buf_ring && uring->buf_ring != MAP_FAILED)
+        munmap(uring->buf_ring, uring->buf_ring_size);
+    free(uring->bufs);
+
+    GHashTableIter iter;
+    gpointer src;
+    g_hash_table_iter_init(&iter, uring->sources);
+    while (g_hash_table_iter_next(&iter, NULL, &src))
+        free(src);
+    g_hash_table_destroy(uring->sources);
+    g_slist_free_full(uring->removed, free);
+    free(uring);
+}
+
+static int uring_add_source(lcm_uring_t *uring, int fd, void *user, int is_poll)
+{
+    uring_source_t *src = (uring_source_t *) calloc(1, sizeof(uring_source_t));
+    src->fd = fd;
+    src->user = user;
+    src->is_poll = is_poll;
+    // space for both is set aside in each buffer
+    src->msg.msg_namelen = URING_NAME_SIZE;
+    src->msg.msg_controllen = URING_CONTROL_SIZE;
+    if (uring_arm(uring, src) < 0) {
+        free(src);
+        return -1;
+    }
+    g_hash_table_insert(uring->sources, GINT_TO_POINTER(fd), src);
+    return 0;
+}
+
+int lcm_uring_add(lcm_uring_t *uring, SOCKET fd, void *user)
+{
+    return uring_add_source(uring, fd, user, 0);
+}
+
+int lcm_uring_poll(lcm_uring_t *uring, int fd, void *user)
+{
+    return uring_add_source(uring, fd, user, 1);
+}
+
+void lcm_uring_remove(lcm_uring_t *uring, SOCKET fd)
+{
+    uring_source_t *src =
+        (uring_source_t *) g_hash_table_lookup(uring->sources, GINT_TO_POINTER(fd));
+    if (!src)
+        return;
+    g_hash_table_remove(uring->sources, GINT_TO_POINTER(fd));
+    src->removed = 1;
+    uring->removed = g_slist_prepend(uring->removed, src);
+
+    // the request ends with -ECANCELED.  The cancellation itself completes
+    // with user_data 0, which is ignored.
+    struct io_uring_sqe *sqe = uring_get_sqe(uring);
+    if (sqe) {
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = (uintptr_t) src;
+        uring_commit_sqe(uring);
+    }
+}
+
+// Fills in pkt from the provided buffer bid, which a datagram of res bytes,
+// with its headers, was received into.
+static void uring_parse_buf(lcm_uring_t *uring, uint16_t bid, lcm_uring_packet_t *pkt)
+{
+    char *buf = uring->bufs + (size_t) bid * URING_BUF_SIZE;
+    struct io_uring_recvmsg_out *out = (struct io_uring_recvmsg_out *) buf;
+    char *name = buf + sizeof(*out);
+    char *control = name + URING_NAME_SIZE;
+    memset(&pkt->msg, 0, sizeof(pkt->msg));
+    pkt->msg.msg_name = name;
+    pkt->msg.msg_namelen = MIN(out->namelen, URING_NAME_SIZE);
+    pkt->msg.msg_control = control;
+    pkt->msg.msg_controllen = MIN(out->controllen, URING_CONTROL_SIZE);
+    pkt->msg.msg_flags = out->flags;
+    pkt->data = control + URING_CONTROL_SIZE;
+    // 65536 bytes of room are more than any datagram
+    pkt->size = MIN(out->payloadlen, 65535);
+    pkt->data[pkt->size] = 0;
+    pkt->bid = bid;
+}
+
+int lcm_uring_wait(lcm_uring_t *uring, lcm_uring_packet_t *pkts, int max)
+{
+    // submit what was queued, and wait if nothing has completed yet
+    int cq_empty = *uring->cq_head == __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+    if (uring->to_submit || cq_empty) {
+        if (uring_enter(uring, cq_empty, cq_empty ? IORING_ENTER_GETEVENTS : 0) < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                return 0;
+            return -1;
+        }
+    }
+
+    uint16_t buf_tail = uring->buf_ring->tail;
+    uint32_t head = *uring->cq_head;
+    uint32_t tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+    int n = 0;
+    while (head != tail && n < max) {
+        struct io_uring_cqe *cqe = &uring->cqes[head & *uring->cq_mask];
+        head++;
+        uring_source_t *src = (uring_source_t *) (uintptr_t) cqe->user_data;
+        if (!src)
+            continue;
+
+        if (cqe->flags & IORING_CQE_F_BUFFER) {
+            uint16_t bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+            if (cqe->res >= 0 && !src->removed) {
+                pkts[n].user = src->user;
+                uring_parse_buf(uring, bid, &pkts[n]);
+                n++;
+            } else {
+                uring_provide_buf(uring, bid, &buf_tail);
+            }
+        } else if (src->is_poll && cqe->res > 0 && !src->removed) {
+            memset(&pkts[n], 0, sizeof(pkts[n]));
+            pkts[n].user = src->user;
+            n++;
+        }
+
+        if (cqe->flags & IORING_CQE_F_MORE)
+            continue;
+        // the request ended: it was a poll, it was cancelled, it ran out of
+        // provided buffers, or it failed
+        if (src->removed) {
+            uring->removed = g_slist_remove(uring->removed, src);
+            free(src);
+        } else if (cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -EINTR) {
+            errno = -cqe->res;
+            perror("lcm_uring_wait -- recvmsg");
+            g_hash_table_remove(uring->sources, GINT_TO_POINTER(src->fd));
+            free(src);
+        } else {
+            uring_arm(uring, src);
+        }
+    }
+    __atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+    __atomic_store_n(&uring->buf_ring->tail, buf_tail, __ATOMIC_RELEASE);
+    return n;
+}
+
+void lcm_uring_release(lcm_uring_t *uring, const lcm_uring_packet_t *pkts, int n)
+{
+    uint16_t tail = uring->buf_ring->tail;
+    int i;
+    for (i = 0; i < n; i++) {
+        if (pkts[i].data)
+            uring_provide_buf(uring, pkts[i].bid, &tail);
+    }
+    __atomic_store_n(&uring->buf_ring->tail, tail, __ATOMIC_RELEASE);
+}
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef __lcm_udpm_uring_h__
+#define __lcm_udpm_uring_h__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#ifdef IORING_RECV_MULTISHOT
+#define USE_IO_URING
+#endif
+#endif
+#endif
+
+#ifdef USE_IO_URING
+
+#include <sys/socket.h>
+
+#include "lcm_export.h"
+#include "udpm_util.h"
+
+/*
+ * An io_uring that receives from several datagram sockets at once, for the
+ * io_uring option of udpm and mpudpm.  Each socket has a multishot recvmsg
+ * request, which the kernel completes once per datagram, into a buffer that
+ * it picks from a ring of provided buffers.  Reading a batch of datagrams
+ * from all of the sockets takes a single system call, or none if they are
+ * already there.
+ */
+typedef struct _lcm_uring lcm_uring_t;
+
+typedef struct _lcm_uring_packet_t {
+    void *user;  // of the socket, or of the file descriptor with lcm_uring_poll()
+    char *data;  // payload, followed by a 0 byte, or NULL for lcm_uring_poll()
+    int size;
+    struct msghdr msg;  // the source address and control messages
+    uint16_t bid;       // the provided buffer that holds it
+} lcm_uring_packet_t;
+
+/*
+ * Returns NULL, after printing why, if the kernel does not have multishot
+ * recvmsg and provided buffer rings (Linux 6.3 or later), or does not let
+ * this process use io_uring.
+ */
+LCM_NO_EXPORT
+lcm_uring_t *lcm_uring_new(void);
+
+LCM_NO_EXPORT
+void lcm_uring_destroy(lcm_uring_t *uring);
+
+/*
+ * Starts receiving from the socket fd.  user is returned with each of its
+ * datagrams.
+ */
+LCM_NO_EXPORT
+int lcm_uring_add(lcm_uring_t *uring, SOCKET fd, void *user);
+
+/*
+ * Stops receiving from fd.  Datagrams of it that lcm_uring_wait() has not
+ * returned yet are discarded, so that fd may be closed right after.
+ */
+LCM_NO_EXPORT
+void lcm_uring_remove(lcm_uring_t *uring, SOCKET fd);
+
+/*
+ * Makes lcm_uring_wait() return a packet with data NULL, and user, whenever
+ * fd is readable.
+ */
+LCM_NO_EXPORT
+int lcm_uring_poll(lcm_uring_t *uring, int fd, void *user);
+
+/*
+ * Waits until something arrives, and takes up to max datagrams, and readable
+ * file descriptors of lcm_uring_poll(), off the completion queue.  Their
+ * buffers belong to the caller until they are handed back with
+ * lcm_uring_release().  Returns the number of packets, which may be 0, or -1
+ * on error.
+ */
+LCM_NO_EXPORT
+int lcm_uring_wait(lcm_uring_t *uring, lcm_uring_packet_t *pkts, int max);
+
+/*
+ * Hands the buffers of n packets back to the kernel.
+ */
+LCM_NO_EXPORT
+void lcm_uring_release(lcm_uring_t *uring, const lcm_uring_packet_t *pkts, int n);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
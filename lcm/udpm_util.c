@@ -2,35 +2,373 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "dbg.h"
+#include "lcm_internal.h"
 
-#define LCM_MAX_UNFRAGMENTED_PACKET_SIZE 65536
+#ifdef LCM_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef __linux__
+#include <ifaddrs.h>
+#include <sys/epoll.h>
+#define LCM_POLLER_EPOLL
+#elif !defined(WIN32)
+#include <poll.h>
+#define LCM_POLLER_POLL
+#endif
+
+/******************** payload buffer pool **********************/
+// smallest and largest size classes, as powers of two
+#define LCM_BUF_POOL_MIN_SHIFT 16
+#define LCM_BUF_POOL_MAX_SHIFT 28
+#define LCM_BUF_POOL_NUM_CLASSES (LCM_BUF_POOL_MAX_SHIFT - LCM_BUF_POOL_MIN_SHIFT + 1)
+
+struct _lcm_buf_pool {
+    GMutex lock;
+    uint32_t alignment;  // 0 for malloc()
+    uint32_t cached_size;
+    uint32_t max_cached_size;
+    // released buffers of each size class, linked through their first bytes
+    char *free_bufs[LCM_BUF_POOL_NUM_CLASSES];
+};
+
+// returns the size class for a buffer of size bytes, or -1 if it is too big
+// to be pooled
+static int _lcm_buf_pool_class(lcm_buf_pool_t *pool, uint32_t size)
+{
+    int c = 0;
+    while (c < LCM_BUF_POOL_NUM_CLASSES && ((uint32_t) 1 << (LCM_BUF_POOL_MIN_SHIFT + c)) < size)
+        c++;
+    if (c == LCM_BUF_POOL_NUM_CLASSES ||
+        ((uint32_t) 1 << (LCM_BUF_POOL_MIN_SHIFT + c)) > pool->max_cached_size)
+        return -1;
+    return c;
+}
+
+lcm_buf_pool_t *lcm_buf_pool_new(uint32_t max_cached_size, uint32_t alignment)
+{
+    lcm_buf_pool_t *pool = (lcm_buf_pool_t *) calloc(1, sizeof(lcm_buf_pool_t));
+    g_mutex_init(&pool->lock);
+    pool->max_cached_size = max_cached_size;
+    // malloc() aligns for any type already
+    pool->alignment = alignment > sizeof(double) ? alignment : 0;
+    return pool;
+}
+
+static char *_lcm_buf_pool_malloc(lcm_buf_pool_t *pool, size_t size)
+{
+    if (!pool->alignment)
+        return (char *) malloc(size);
+#ifdef WIN32
+    return (char *) _aligned_malloc(size, pool->alignment);
+#else
+    void *data;
+    return posix_memalign(&data, pool->alignment, size) ? NULL : (char *) data;
+#endif
+}
+
+static void _lcm_buf_pool_free(lcm_buf_pool_t *pool, char *data)
+{
+#ifdef WIN32
+    if (pool->alignment) {
+        _aligned_free(data);
+        return;
+    }
+#else
+    (void) pool;
+#endif
+    free(data);
+}
+
+void lcm_buf_pool_destroy(lcm_buf_pool_t *pool)
+{
+    int c;
+    for (c = 0; c < LCM_BUF_POOL_NUM_CLASSES; c++) {
+        while (pool->free_bufs[c]) {
+            char *data = pool->free_bufs[c];
+            pool->free_bufs[c] = *(char **) data;
+            _lcm_buf_pool_free(pool, data);
+        }
+    }
+    g_mutex_clear(&pool->lock);
+    free(pool);
+}
+
+char *lcm_buf_pool_alloc(lcm_buf_pool_t *pool, uint32_t size)
+{
+    if (!pool)
+        return (char *) malloc(size);
+    int c = _lcm_buf_pool_class(pool, size);
+    if (c < 0)
+        return _lcm_buf_pool_malloc(pool, size);
+
+    g_mutex_lock(&pool->lock);
+    char *data = pool->free_bufs[c];
+    if (data) {
+        pool->free_bufs[c] = *(char **) data;
+        pool->cached_size -= (uint32_t) 1 << (LCM_BUF_POOL_MIN_SHIFT + c);
+    }
+    g_mutex_unlock(&pool->lock);
+
+    if (!data)
+        data = _lcm_buf_pool_malloc(pool, (size_t) 1 << (LCM_BUF_POOL_MIN_SHIFT + c));
+    return data;
+}
+
+void lcm_buf_pool_release(lcm_buf_pool_t *pool, char *data, uint32_t size)
+{
+    int c = pool ? _lcm_buf_pool_class(pool, size) : -1;
+    if (c < 0) {
+        if (pool)
+            _lcm_buf_pool_free(pool, data);
+        else
+            free(data);
+        return;
+    }
+
+    uint32_t class_size = (uint32_t) 1 << (LCM_BUF_POOL_MIN_SHIFT + c);
+    g_mutex_lock(&pool->lock);
+    if (pool->cached_size + class_size <= pool->max_cached_size) {
+        *(char **) data = pool->free_bufs[c];
+        pool->free_bufs[c] = data;
+        pool->cached_size += class_size;
+        data = NULL;
+    }
+    g_mutex_unlock(&pool->lock);
+    if (data)
+        _lcm_buf_pool_free(pool, data);
+}
 
 /******************** fragment buffer **********************/
-lcm_frag_buf_t *lcm_frag_buf_new(struct sockaddr_in from, uint32_t msg_seqno, uint32_t data_size,
-                                 uint16_t nfragments, int64_t first_packet_utime)
+lcm_frag_buf_t *lcm_frag_buf_new(lcm_buf_pool_t *pool, struct sockaddr_in from,
+                                 uint32_t msg_seqno, uint32_t data_size, uint16_t nfragments,
+                                 int64_t first_packet_utime)
 {
     lcm_frag_buf_t *fbuf = (lcm_frag_buf_t *) malloc(sizeof(lcm_frag_buf_t));
     fbuf->from = from;
     fbuf->msg_seqno = msg_seqno;
-    fbuf->data = (char *) malloc(data_size);
+    fbuf->data = lcm_buf_pool_alloc(pool, data_size);
     fbuf->data_size = data_size;
     fbuf->fragments_remaining = nfragments;
+    fbuf->fragments_in_msg = nfragments;
+    if (nfragments <= LCM_FRAG_BITMAP_INLINE_BITS) {
+        fbuf->received = fbuf->received_inline;
+        memset(fbuf->received_inline, 0, sizeof(fbuf->received_inline));
+    } else {
+        fbuf->received = (uint64_t *) calloc((nfragments + 63) / 64, sizeof(uint64_t));
+    }
     fbuf->last_packet_utime = first_packet_utime;
+    fbuf->last_packet_time_ns = first_packet_utime * 1000;
+    fbuf->last_packet_mono_ns = 0;
+    fbuf->nack_utime = 0;
+    fbuf->nacks_sent = 0;
+    fbuf->channel[0] = 0;
     fbuf->key.from = &(fbuf->from);
     fbuf->key.msg_seqno = msg_seqno;
+    fbuf->pool = pool;
+    fbuf->lru_prev = NULL;
+    fbuf->lru_next = NULL;
     return fbuf;
 }
 
 void lcm_frag_buf_destroy(lcm_frag_buf_t *fbuf)
 {
-    free(fbuf->data);
+    if (fbuf->data)
+        lcm_buf_pool_release(fbuf->pool, fbuf->data, fbuf->data_size);
+    if (fbuf->received != fbuf->received_inline)
+        free(fbuf->received);
     free(fbuf);
 }
 
+int lcm_frag_buf_mark_received(lcm_frag_buf_t *fbuf, uint16_t fragment_no)
+{
+    if (fragment_no >= fbuf->fragments_in_msg)
+        return -1;
+    uint64_t bit = (uint64_t) 1 << (fragment_no % 64);
+    uint64_t *word = &fbuf->received[fragment_no / 64];
+    if (*word & bit)
+        return 0;
+    *word |= bit;
+    return 1;
+}
+
+int lcm_frag_buf_decompress(lcm_frag_buf_t *fbuf)
+{
+#ifdef LCM_HAVE_LZ4
+    uint32_t size;
+    if (fbuf->data_size < sizeof(size))
+        return -1;
+    memcpy(&size, fbuf->data, sizeof(size));
+    size = ntohl(size);
+    if (size > LCM_MAX_MESSAGE_SIZE)
+        return -1;
+
+    char *data = lcm_buf_pool_alloc(fbuf->pool, size);
+    int status = LZ4_decompress_safe(fbuf->data + sizeof(size), data,
+                                     fbuf->data_size - sizeof(size), size);
+    if (status != (int) size) {
+        lcm_buf_pool_release(fbuf->pool, data, size);
+        return -1;
+    }
+    lcm_buf_pool_release(fbuf->pool, fbuf->data, fbuf->data_size);
+    fbuf->data = data;
+    fbuf->data_size = size;
+    return 0;
+#else
+    (void) fbuf;
+    return -1;
+#endif
+}
+
+static int lcm_frag_buf_is_received(lcm_frag_buf_t *fbuf, uint16_t fragment_no)
+{
+    return (fbuf->received[fragment_no / 64] >> (fragment_no % 64)) & 1;
+}
+
+int lcm_frag_buf_missing(lcm_frag_buf_t *fbuf, uint16_t *missing, int max_missing)
+{
+    int n = 0;
+    for (int frag_no = 0; frag_no < fbuf->fragments_in_msg && n < max_missing; frag_no++) {
+        // skip whole words of received fragments
+        if (frag_no % 64 == 0 && fbuf->received[frag_no / 64] == UINT64_MAX) {
+            frag_no += 63;
+            continue;
+        }
+        if (!lcm_frag_buf_is_received(fbuf, frag_no))
+            missing[n++] = frag_no;
+    }
+    return n;
+}
+
+int lcm_frag_buf_recover(lcm_frag_buf_t *fbuf, uint32_t fragment_size, int channel_size,
+                         uint16_t first_fragment, uint16_t group_size, const char *parity,
+                         uint32_t parity_size)
+{
+    if (fragment_size <= (uint32_t) channel_size + 1 || group_size == 0 ||
+        first_fragment + group_size > fbuf->fragments_in_msg)
+        return -1;
+
+    int missing = -1;
+    for (uint16_t frag_no = first_fragment; frag_no < first_fragment + group_size; frag_no++) {
+        uint32_t offset, size;
+        lcm_fragment_extent(fbuf->data_size, fragment_size, channel_size, frag_no, &offset,
+                            &size);
+        if (offset + size > fbuf->data_size || size > parity_size)
+            return -1;
+        if (!lcm_frag_buf_is_received(fbuf, frag_no)) {
+            if (missing >= 0)
+                return 0;
+            missing = frag_no;
+        }
+    }
+    if (missing < 0)
+        return 0;
+
+    uint32_t offset, size;
+    lcm_fragment_extent(fbuf->data_size, fragment_size, channel_size, missing, &offset, &size);
+    char *dst = fbuf->data + offset;
+    memcpy(dst, parity, size);
+    for (uint16_t frag_no = first_fragment; frag_no < first_fragment + group_size; frag_no++) {
+        uint32_t other_offset, other_size;
+        if (frag_no == missing)
+            continue;
+        lcm_fragment_extent(fbuf->data_size, fragment_size, channel_size, frag_no,
+                            &other_offset, &other_size);
+        lcm_xor_bytes(dst, fbuf->data + other_offset, MIN(size, other_size));
+    }
+    lcm_frag_buf_mark_received(fbuf, missing);
+    fbuf->fragments_remaining--;
+    return 1;
+}
+
+int lcm_frag_buf_delta_decode(lcm_frag_buf_t *fbuf, const char *base, uint32_t base_size,
+                              uint32_t base_seqno)
+{
+    lcm2_header_delta_t hdr;
+    if (fbuf->data_size < sizeof(hdr))
+        return -1;
+    memcpy(&hdr, fbuf->data, sizeof(hdr));
+    uint32_t size = ntohl(hdr.msg_size);
+    const char *src = fbuf->data + sizeof(hdr);
+    uint32_t src_size = fbuf->data_size - sizeof(hdr);
+    int keyframe = ntohl(hdr.flags) & LCM2_DELTA_KEYFRAME;
+    if (size > LCM_MAX_MESSAGE_SIZE || (keyframe && src_size != size))
+        return -1;
+    if (!keyframe && (!base || base_size != size || ntohl(hdr.base_seqno) != base_seqno))
+        return 1;
+
+    char *data = lcm_buf_pool_alloc(fbuf->pool, size);
+    if (keyframe) {
+        memcpy(data, src, size);
+    } else {
+        memcpy(data, base, size);
+        uint32_t pos = 0;
+        uint32_t offset = 0;
+        while (pos < src_size) {
+            uint32_t run[2];
+            if (src_size - pos < sizeof(run)) {
+                lcm_buf_pool_release(fbuf->pool, data, size);
+                return -1;
+            }
+            memcpy(run, src + pos, sizeof(run));
+            pos += sizeof(run);
+            uint32_t unchanged = ntohl(run[0]);
+            uint32_t changed = ntohl(run[1]);
+            if (unchanged > size - offset || changed > size - offset - unchanged ||
+                changed > src_size - pos) {
+                lcm_buf_pool_release(fbuf->pool, data, size);
+                return -1;
+            }
+            offset += unchanged;
+            lcm_xor_bytes(data + offset, src + pos, changed);
+            offset += changed;
+            pos += changed;
+        }
+    }
+    lcm_buf_pool_release(fbuf->pool, fbuf->data, fbuf->data_size);
+    fbuf->data = data;
+    fbuf->data_size = size;
+    return 0;
+}
+
+/******************** sequence numbers **********************/
+
+void lcm_seqno_init(lcm_seqno_state_t *state, uint32_t msg_seqno)
+{
+    state->last = msg_seqno;
+    state->seen = 1;
+}
+
+void lcm_seqno_track(lcm_seqno_state_t *state, uint32_t msg_seqno, int is_fragment,
+                     lcm_stats_t *stats)
+{
+    // sequence numbers wrap around
+    int32_t ahead = (int32_t) (msg_seqno - state->last);
+    if (ahead > 0) {
+        if (ahead > 1)
+            lcm_stat_add(&stats->seqno_gaps, ahead - 1);
+        state->seen = ahead < 64 ? state->seen << ahead | 1 : 1;
+        state->last = msg_seqno;
+    } else if (ahead > -64) {
+        uint64_t bit = (uint64_t) 1 << -ahead;
+        if (!(state->seen & bit)) {
+            lcm_stat_add(&stats->seqno_reorders, 1);
+            state->seen |= bit;
+        } else if (!is_fragment) {
+            lcm_stat_add(&stats->seqno_duplicates, 1);
+        }
+    } else {
+        // too far behind to tell, most likely because the sender restarted
+        // on the same port
+        lcm_seqno_init(state, msg_seqno);
+    }
+}
+
 /******************** fragment buffer store **********************/
 
 static guint _lcm_frag_key_hash(const void *key)
@@ -54,13 +392,29 @@ static gboolean _lcm_frag_key_equal(const void *a, const void *b)
            a_key->msg_seqno == b_key->msg_seqno;
 }
 
-static void _find_lru_frag_buf(gpointer key, gpointer value, void *user_data)
+static void _lru_unlink(lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf)
 {
-    lcm_frag_buf_t **lru_fbuf = (lcm_frag_buf_t **) user_data;
-    lcm_frag_buf_t *c_fbuf = (lcm_frag_buf_t *) value;
-    if (!*lru_fbuf || (c_fbuf->last_packet_utime < (*lru_fbuf)->last_packet_utime)) {
-        *lru_fbuf = c_fbuf;
-    }
+    if (fbuf->lru_prev)
+        fbuf->lru_prev->lru_next = fbuf->lru_next;
+    else
+        store->lru_head = fbuf->lru_next;
+    if (fbuf->lru_next)
+        fbuf->lru_next->lru_prev = fbuf->lru_prev;
+    else
+        store->lru_tail = fbuf->lru_prev;
+    fbuf->lru_prev = NULL;
+    fbuf->lru_next = NULL;
+}
+
+static void _lru_append(lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf)
+{
+    fbuf->lru_prev = store->lru_tail;
+    fbuf->lru_next = NULL;
+    if (store->lru_tail)
+        store->lru_tail->lru_next = fbuf;
+    else
+        store->lru_head = fbuf;
+    store->lru_tail = fbuf;
 }
 
 lcm_frag_buf_store *lcm_frag_buf_store_new(uint32_t max_total_size, uint32_t max_n_frag_bufs)
@@ -83,30 +437,54 @@ void lcm_frag_buf_store_destroy(lcm_frag_buf_store *store)
 
 lcm_frag_buf_t *lcm_frag_buf_store_lookup(lcm_frag_buf_store *store, lcm_frag_key_t *key)
 {
-    return (lcm_frag_buf_t *) g_hash_table_lookup(store->frag_bufs, key);
+    lcm_frag_buf_t *fbuf = (lcm_frag_buf_t *) g_hash_table_lookup(store->frag_bufs, key);
+    if (fbuf && fbuf != store->lru_tail) {
+        _lru_unlink(store, fbuf);
+        _lru_append(store, fbuf);
+    }
+    return fbuf;
 }
 
-void lcm_frag_buf_store_add(lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf)
+int lcm_frag_buf_store_add(lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf)
 {
-    while (store->total_size > store->max_total_size ||
-           g_hash_table_size(store->frag_bufs) > store->max_n_frag_bufs) {
-        // find and remove the least recently updated fragment buffer
-        lcm_frag_buf_t *lru_fbuf = NULL;
-        g_hash_table_foreach(store->frag_bufs, _find_lru_frag_buf, &lru_fbuf);
-        if (lru_fbuf) {
-            lcm_frag_buf_store_remove(store, lru_fbuf);
-        }
+    // remove the least recently updated fragment buffers
+    int num_evicted = 0;
+    while (store->lru_head && (store->total_size > store->max_total_size ||
+                               g_hash_table_size(store->frag_bufs) > store->max_n_frag_bufs)) {
+        lcm_frag_buf_store_remove(store, store->lru_head);
+        num_evicted++;
     }
     g_hash_table_insert(store->frag_bufs, &fbuf->key, fbuf);
+    _lru_append(store, fbuf);
     store->total_size += fbuf->data_size;
+    return num_evicted;
 }
 
 void lcm_frag_buf_store_remove(lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf)
 {
     store->total_size -= fbuf->data_size;
+    _lru_unlink(store, fbuf);
     g_hash_table_remove(store->frag_bufs, &fbuf->key);
 }
 
+void lcm_frag_buf_store_ignore(lcm_frag_buf_store *store, lcm_frag_key_t *key)
+{
+    lcm_frag_ignored_t *ig =
+        &store->ignored[_lcm_frag_key_hash(key) & (LCM_FRAG_IGNORED_SIZE - 1)];
+    ig->msg_seqno = key->msg_seqno;
+    ig->addr = key->from->sin_addr.s_addr;
+    ig->port = key->from->sin_port;
+    ig->valid = 1;
+}
+
+int lcm_frag_buf_store_is_ignored(lcm_frag_buf_store *store, lcm_frag_key_t *key)
+{
+    lcm_frag_ignored_t *ig =
+        &store->ignored[_lcm_frag_key_hash(key) & (LCM_FRAG_IGNORED_SIZE - 1)];
+    return ig->valid && ig->msg_seqno == key->msg_seqno &&
+           ig->addr == key->from->sin_addr.s_addr && ig->port == key->from->sin_port;
+}
+
 /*** Functions for managing a queue of lcm buffers ***/
 lcm_buf_queue_t *lcm_buf_queue_new(void)
 {
@@ -115,6 +493,7 @@ lcm_buf_queue_t *lcm_buf_queue_new(void)
     q->head = NULL;
     q->tail = &q->head;
     q->count = 0;
+    q->grow = LCM_DEFAULT_RECV_BUFS;
     return q;
 }
 
@@ -143,6 +522,34 @@ void lcm_buf_enqueue(lcm_buf_queue_t *q, lcm_buf_t *el)
     q->count++;
 }
 
+void lcm_buf_align_data(lcm_buf_t *lcmb, int alignment)
+{
+    char *data = lcmb->buf + lcmb->data_offset;
+    int misalignment = (int) ((uintptr_t) data & (alignment - 1));
+    if (!misalignment)
+        return;
+    // Back over the header if it's long enough, or else forward.  The
+    // ringbuffer aligns its slots to half of LCM_MAX_DATA_ALIGNMENT, so data
+    // starts less than that many bytes into the slot when this moves it
+    // forward, and its end moves to less than that many bytes past the end of
+    // the datagram, within the slot.
+    char *aligned = data - misalignment;
+    if (aligned < lcmb->buf)
+        aligned = data + alignment - misalignment;
+    memmove(aligned, data, lcmb->data_size);
+    lcmb->data_offset = aligned - lcmb->buf;
+}
+
+void lcm_buf_set_channel(lcm_buf_t *lcmb, const char *channel, int channel_size)
+{
+    lcmb->channel_size = channel_size;
+    lcmb->channel_id = lcm_intern_channel(channel, &lcmb->channel_name);
+    if (lcmb->channel_id < 0) {
+        memcpy(lcmb->channel_copy, channel, channel_size + 1);
+        lcmb->channel_name = lcmb->channel_copy;
+    }
+}
+
 void lcm_buf_free_data(lcm_buf_t *lcmb, lcm_ringbuf_t *ringbuf)
 {
     if (!lcmb->buf)
@@ -157,32 +564,48 @@ void lcm_buf_free_data(lcm_buf_t *lcmb, lcm_ringbuf_t *ringbuf)
             dbg(DBG_LCM, "Destroying unused orphan ringbuffer %p\n", lcmb->ringbuf);
         }
     } else {
-        free(lcmb->buf);
+        lcm_buf_pool_release(lcmb->pool, lcmb->buf, lcmb->buf_size);
     }
     lcmb->buf = NULL;
     lcmb->buf_size = 0;
     lcmb->ringbuf = NULL;
+    lcmb->pool = NULL;
 }
 
-lcm_buf_t *lcm_buf_allocate_data(lcm_buf_queue_t *inbufs_empty, lcm_ringbuf_t **ringbuf)
+static lcm_buf_t *_lcm_buf_dequeue_empty(lcm_buf_queue_t *inbufs_empty)
 {
-    lcm_buf_t *lcmb = NULL;
-    // first allocate a buffer struct for the packet metadata
     if (lcm_buf_queue_is_empty(inbufs_empty)) {
         // allocate additional buffer structs if needed
         int i;
-        for (i = 0; i < LCM_DEFAULT_RECV_BUFS; i++) {
+        for (i = 0; i < inbufs_empty->grow; i++) {
             lcm_buf_t *nbuf = (lcm_buf_t *) calloc(1, sizeof(lcm_buf_t));
             lcm_buf_enqueue(inbufs_empty, nbuf);
         }
     }
 
-    lcmb = lcm_buf_dequeue(inbufs_empty);
+    lcm_buf_t *lcmb = lcm_buf_dequeue(inbufs_empty);
     assert(lcmb);
+    return lcmb;
+}
 
+lcm_buf_t *lcm_buf_allocate_data(lcm_buf_queue_t *inbufs_empty, lcm_ringbuf_t **ringbuf,
+                                 unsigned int max_size)
+{
     // allocate space on the ringbuffer for the packet data.
     // give it the maximum possible size for an unfragmented packet
-    lcmb->buf = lcm_ringbuf_alloc(*ringbuf, LCM_MAX_UNFRAGMENTED_PACKET_SIZE);
+    char *buf = lcm_ringbuf_alloc(*ringbuf, LCM_MAX_UNFRAGMENTED_PACKET_SIZE);
+    unsigned int old_capacity = lcm_ringbuf_capacity(*ringbuf);
+    unsigned int new_capacity = (unsigned int) (old_capacity * 1.5);
+    if (max_size && new_capacity > max_size)
+        new_capacity = max_size;
+    if (!buf && new_capacity <= old_capacity) {
+        // the ringbuffer may not grow any further
+        return NULL;
+    }
+
+    // allocate a buffer struct for the packet metadata
+    lcm_buf_t *lcmb = _lcm_buf_dequeue_empty(inbufs_empty);
+    lcmb->buf = buf;
     if (lcmb->buf == NULL) {
         // ringbuffer is full.  allocate a larger ringbuffer
 
@@ -191,8 +614,6 @@ lcm_buf_t *lcm_buf_allocate_data(lcm_buf_queue_t *inbufs_empty, lcm_ringbuf_t **
         assert(lcm_ringbuf_used(*ringbuf) > 0);
         dbg(DBG_LCM, "Orphaning ringbuffer %p\n", *ringbuf);
 
-        unsigned int old_capacity = lcm_ringbuf_capacity(*ringbuf);
-        unsigned int new_capacity = (unsigned int) (old_capacity * 1.5);
         // replace the passed in ringbuf with the new one
         *ringbuf = lcm_ringbuf_new(new_capacity);
         lcmb->buf = lcm_ringbuf_alloc(*ringbuf, 65536);
@@ -207,6 +628,31 @@ lcm_buf_t *lcm_buf_allocate_data(lcm_buf_queue_t *inbufs_empty, lcm_ringbuf_t **
     return lcmb;
 }
 
+int lcm_buf_allocate_data_batch(lcm_buf_queue_t *inbufs_empty, lcm_ringbuf_t **ringbuf,
+                                unsigned int max_size, lcm_buf_t **lcmbs, int max_bufs)
+{
+    // Only the first buffer is allowed to replace the ringbuffer.  The rest
+    // must come from that same ringbuffer, back to back, so that the whole
+    // batch can be compacted with lcm_ringbuf_compact_tail() afterwards.
+    lcmbs[0] = lcm_buf_allocate_data(inbufs_empty, ringbuf, max_size);
+    if (!lcmbs[0])
+        return 0;
+
+    int n;
+    for (n = 1; n < max_bufs; n++) {
+        char *buf = lcm_ringbuf_alloc(*ringbuf, LCM_MAX_UNFRAGMENTED_PACKET_SIZE);
+        if (!buf)
+            break;
+
+        lcm_buf_t *lcmb = _lcm_buf_dequeue_empty(inbufs_empty);
+        lcmb->buf = buf;
+        lcmb->ringbuf = *ringbuf;
+        lcmb->buf[LCM_MAX_UNFRAGMENTED_PACKET_SIZE - 1] = 0;
+        lcmbs[n] = lcmb;
+    }
+    return n;
+}
+
 void lcm_buf_queue_free(lcm_buf_queue_t *q, lcm_ringbuf_t *ringbuf)
 {
     lcm_buf_t *el;
@@ -217,11 +663,823 @@ void lcm_buf_queue_free(lcm_buf_queue_t *q, lcm_ringbuf_t *ringbuf)
     free(q);
 }
 
+void lcm_buf_returns_init(lcm_buf_returns_t *returns)
+{
+    g_mutex_init(&returns->mutex);
+    returns->bufs = lcm_buf_queue_new();
+    returns->count = 0;
+}
+
+void lcm_buf_returns_clear(lcm_buf_returns_t *returns, lcm_ringbuf_t *ringbuf)
+{
+    if (!returns->bufs)
+        return;
+    lcm_buf_queue_free(returns->bufs, ringbuf);
+    returns->bufs = NULL;
+    g_mutex_clear(&returns->mutex);
+}
+
+void lcm_buf_returns_take(lcm_buf_returns_t *returns, lcm_buf_queue_t *inbufs_empty,
+                          lcm_ringbuf_t *ringbuf)
+{
+    if (!g_atomic_int_get(&returns->count))
+        return;
+    g_mutex_lock(&returns->mutex);
+    lcm_buf_t *lcmb;
+    while ((lcmb = lcm_buf_dequeue(returns->bufs))) {
+        lcm_buf_free_data(lcmb, ringbuf);
+        lcm_buf_enqueue(inbufs_empty, lcmb);
+    }
+    g_atomic_int_set(&returns->count, 0);
+    g_mutex_unlock(&returns->mutex);
+}
+
+static void *lcm_buf_retain(void *msg)
+{
+    lcm_buf_t *lcmb = (lcm_buf_t *) msg;
+    g_atomic_int_inc(&lcmb->refcount);
+    return lcmb;
+}
+
+static void lcm_buf_release(void *ref)
+{
+    lcm_buf_t *lcmb = (lcm_buf_t *) ref;
+    if (!g_atomic_int_dec_and_test(&lcmb->refcount))
+        return;
+    lcm_buf_returns_t *returns = lcmb->returns;
+    g_mutex_lock(&returns->mutex);
+    lcm_buf_enqueue(returns->bufs, lcmb);
+    g_atomic_int_set(&returns->count, returns->bufs->count);
+    g_mutex_unlock(&returns->mutex);
+}
+
+const lcm_recv_buf_lender_t lcm_buf_lender = {lcm_buf_retain, lcm_buf_release};
+
+void lcm_buf_lend(lcm_buf_t *lcmb, lcm_buf_returns_t *returns)
+{
+    if (lcmb->refcount)
+        return;
+    lcmb->refcount = 1;
+    lcmb->returns = returns;
+}
+
+int lcm_buf_lend_end(lcm_buf_t *lcmb)
+{
+    return g_atomic_int_dec_and_test(&lcmb->refcount);
+}
+
 int lcm_buf_queue_is_empty(lcm_buf_queue_t *q)
 {
     return q->head == NULL ? 1 : 0;
 }
 
+/*** Functions for managing a lock-free ring of lcm buffers ***/
+// head and tail count up forever and are reduced modulo the capacity when
+// indexing, so that a full ring can be told apart from an empty one.  The
+// g_atomic operations are sequentially consistent: a push that publishes a
+// buffer and then finds head == the old tail is guaranteed that the consumer's
+// emptiness check, which follows its own update of head, sees that buffer.
+lcm_buf_ring_t *lcm_buf_ring_new(unsigned int capacity)
+{
+    unsigned int size = 1;
+    while (size < capacity)
+        size <<= 1;
+
+    lcm_buf_ring_t *ring = (lcm_buf_ring_t *) malloc(sizeof(lcm_buf_ring_t));
+    ring->bufs = (lcm_buf_t **) calloc(size, sizeof(lcm_buf_t *));
+    ring->mask = size - 1;
+    ring->head = 0;
+    ring->tail = 0;
+    return ring;
+}
+
+void lcm_buf_ring_free(lcm_buf_ring_t *ring, lcm_ringbuf_t *ringbuf)
+{
+    lcm_buf_t *el;
+    while ((el = lcm_buf_ring_pop(ring))) {
+        lcm_buf_free_data(el, ringbuf);
+        free(el);
+    }
+    free(ring->bufs);
+    free(ring);
+}
+
+unsigned int lcm_buf_ring_capacity(lcm_buf_ring_t *ring)
+{
+    return ring->mask + 1;
+}
+
+int lcm_buf_ring_push(lcm_buf_ring_t *ring, lcm_buf_t *el)
+{
+    unsigned int tail = (unsigned int) ring->tail;
+    unsigned int head = (unsigned int) g_atomic_int_get(&ring->head);
+    if (tail - head > ring->mask)
+        return -1;
+
+    el->next = NULL;
+    ring->bufs[tail & ring->mask] = el;
+    g_atomic_int_set(&ring->tail, (gint) (tail + 1));
+
+    // re-read head now that the buffer is visible to the consumer
+    return (unsigned int) g_atomic_int_get(&ring->head) == tail ? 1 : 0;
+}
+
+lcm_buf_t *lcm_buf_ring_pop(lcm_buf_ring_t *ring)
+{
+    unsigned int head = (unsigned int) ring->head;
+    if (head == (unsigned int) g_atomic_int_get(&ring->tail))
+        return NULL;
+
+    lcm_buf_t *el = ring->bufs[head & ring->mask];
+    g_atomic_int_set(&ring->head, (gint) (head + 1));
+    return el;
+}
+
+int lcm_buf_ring_is_empty(lcm_buf_ring_t *ring)
+{
+    return g_atomic_int_get(&ring->head) == g_atomic_int_get(&ring->tail) ? 1 : 0;
+}
+
+/******************** socket readiness **********************/
+struct _lcm_poller {
+#ifdef LCM_POLLER_EPOLL
+    int epfd;
+    struct epoll_event *events;
+    int max_events;
+#else
+    int nfds;
+    int capacity;
+    void **users;
+#ifdef LCM_POLLER_POLL
+    struct pollfd *pollfds;
+#else
+    SOCKET *fds;
+#endif
+#endif
+};
+
+lcm_poller_t *lcm_poller_new(void)
+{
+    lcm_poller_t *poller = (lcm_poller_t *) calloc(1, sizeof(lcm_poller_t));
+#ifdef LCM_POLLER_EPOLL
+    poller->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (poller->epfd < 0) {
+        perror("epoll_create1");
+        free(poller);
+        return NULL;
+    }
+#endif
+    return poller;
+}
+
+void lcm_poller_destroy(lcm_poller_t *poller)
+{
+#ifdef LCM_POLLER_EPOLL
+    close(poller->epfd);
+    free(poller->events);
+#else
+    free(poller->users);
+#ifdef LCM_POLLER_POLL
+    free(poller->pollfds);
+#else
+    free(poller->fds);
+#endif
+#endif
+    free(poller);
+}
+
+int lcm_poller_add(lcm_poller_t *poller, SOCKET fd, void *user)
+{
+#ifdef LCM_POLLER_EPOLL
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = user;
+    if (epoll_ctl(poller->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        perror("epoll_ctl(EPOLL_CTL_ADD)");
+        return -1;
+    }
+#else
+    if (poller->nfds == poller->capacity) {
+        poller->capacity = poller->capacity ? 2 * poller->capacity : 8;
+        poller->users = (void **) realloc(poller->users, poller->capacity * sizeof(void *));
+#ifdef LCM_POLLER_POLL
+        poller->pollfds = (struct pollfd *) realloc(poller->pollfds,
+                                                    poller->capacity * sizeof(struct pollfd));
+#else
+        poller->fds = (SOCKET *) realloc(poller->fds, poller->capacity * sizeof(SOCKET));
+#endif
+    }
+    poller->users[poller->nfds] = user;
+#ifdef LCM_POLLER_POLL
+    poller->pollfds[poller->nfds].fd = fd;
+    poller->pollfds[poller->nfds].events = POLLIN;
+    poller->pollfds[poller->nfds].revents = 0;
+#else
+    poller->fds[poller->nfds] = fd;
+#endif
+    poller->nfds++;
+#endif
+    return 0;
+}
+
+int lcm_poller_remove(lcm_poller_t *poller, SOCKET fd)
+{
+#ifdef LCM_POLLER_EPOLL
+    // kernels before 2.6.9 require a non-NULL event even though it is ignored
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    if (epoll_ctl(poller->epfd, EPOLL_CTL_DEL, fd, &ev) < 0) {
+        perror("epoll_ctl(EPOLL_CTL_DEL)");
+        return -1;
+    }
+#else
+    int i;
+    for (i = 0; i < poller->nfds; i++) {
+#ifdef LCM_POLLER_POLL
+        if (poller->pollfds[i].fd == fd)
+            break;
+#else
+        if (poller->fds[i] == fd)
+            break;
+#endif
+    }
+    if (i == poller->nfds)
+        return -1;
+    // the order of the registrations does not matter, so fill the hole with
+    // the last one
+    poller->nfds--;
+    poller->users[i] = poller->users[poller->nfds];
+#ifdef LCM_POLLER_POLL
+    poller->pollfds[i] = poller->pollfds[poller->nfds];
+#else
+    poller->fds[i] = poller->fds[poller->nfds];
+#endif
+#endif
+    return 0;
+}
+
+int lcm_poller_wait(lcm_poller_t *poller, void **ready, int max_ready)
+{
+#ifdef LCM_POLLER_EPOLL
+    if (max_ready > poller->max_events) {
+        poller->events =
+            (struct epoll_event *) realloc(poller->events, max_ready * sizeof(struct epoll_event));
+        poller->max_events = max_ready;
+    }
+    int nready = epoll_wait(poller->epfd, poller->events, max_ready, -1);
+    if (nready < 0)
+        return errno == EINTR ? 0 : -1;
+    int i;
+    for (i = 0; i < nready; i++)
+        ready[i] = poller->events[i].data.ptr;
+    return nready;
+#elif defined(LCM_POLLER_POLL)
+    int status = poll(poller->pollfds, poller->nfds, -1);
+    if (status < 0)
+        return errno == EINTR ? 0 : -1;
+    int nready = 0;
+    int i;
+    for (i = 0; i < poller->nfds && nready < max_ready; i++) {
+        if (poller->pollfds[i].revents)
+            ready[nready++] = poller->users[i];
+    }
+    return nready;
+#else
+    fd_set fds;
+    FD_ZERO(&fds);
+    SOCKET maxfd = 0;
+    int i;
+    for (i = 0; i < poller->nfds; i++) {
+        FD_SET(poller->fds[i], &fds);
+        maxfd = MAX(maxfd, poller->fds[i]);
+    }
+    if (select(maxfd + 1, &fds, NULL, NULL, NULL) < 0)
+        return -1;
+    int nready = 0;
+    for (i = 0; i < poller->nfds && nready < max_ready; i++) {
+        if (FD_ISSET(poller->fds[i], &fds))
+            ready[nready++] = poller->users[i];
+    }
+    return nready;
+#endif
+}
+
+/******************** datagram size **********************/
+int lcm_parse_packet_size(const char *key, const char *value)
+{
+    int is_mtu = !strcmp(key, "mtu");
+    if (is_mtu && !strcmp(value, "auto"))
+        return LCM_PACKET_SIZE_AUTO;
+
+    char *endptr = NULL;
+    long size = strtol(value, &endptr, 0);
+    if (endptr == value || *endptr)
+        return 0;
+    if (is_mtu)
+        size -= LCM_UDP_IP_OVERHEAD;
+    if (size < LCM_MIN_PACKET_SIZE || size > LCM_MAX_PACKET_SIZE)
+        return 0;
+    return (int) size;
+}
+
+int lcm_resolve_packet_size(int packet_size, struct in_addr mc_addr)
+{
+    if (packet_size != LCM_PACKET_SIZE_AUTO)
+        return packet_size > 0 ? packet_size : (int) LCM_DEFAULT_PACKET_SIZE;
+
+    int mtu = -1;
+#if defined(__linux__) && defined(IP_MTU)
+    // the kernel reports the MTU of the route to a connected socket's peer
+    SOCKET fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd >= 0) {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr = mc_addr;
+        socklen_t optlen = sizeof(mtu);
+        if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+            getsockopt(fd, IPPROTO_IP, IP_MTU, &mtu, &optlen) < 0)
+            mtu = -1;
+        lcm_close_socket(fd);
+    }
+#else
+    (void) mc_addr;
+#endif
+    if (mtu < 0) {
+        fprintf(stderr, "Warning: Unable to determine the MTU, using the default frag_size\n");
+        return (int) LCM_DEFAULT_PACKET_SIZE;
+    }
+    dbg(DBG_LCM, "detected MTU %d\n", mtu);
+    return CLAMP(mtu - LCM_UDP_IP_OVERHEAD, LCM_MIN_PACKET_SIZE, LCM_MAX_PACKET_SIZE);
+}
+
+int lcm_resolve_numa_node(struct in_addr iface_addr, struct in_addr mc_addr)
+{
+#ifdef __linux__
+    if (iface_addr.s_addr == INADDR_ANY) {
+        // the local address of a socket connected to the group is the one of
+        // the interface that the group is routed to
+        SOCKET fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0)
+            return -1;
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr = mc_addr;
+        socklen_t addrlen = sizeof(addr);
+        int status = connect(fd, (struct sockaddr *) &addr, sizeof(addr));
+        if (status == 0)
+            status = getsockname(fd, (struct sockaddr *) &addr, &addrlen);
+        lcm_close_socket(fd);
+        if (status < 0)
+            return -1;
+        iface_addr = addr.sin_addr;
+    }
+
+    struct ifaddrs *ifaddrs;
+    if (getifaddrs(&ifaddrs) < 0)
+        return -1;
+    int node = -1;
+    for (struct ifaddrs *ifa = ifaddrs; ifa; ifa = ifa->ifa_next) {
+        if (!ifa->ifa_addr || ifa->ifa_addr->sa_family != AF_INET ||
+            ((struct sockaddr_in *) ifa->ifa_addr)->sin_addr.s_addr != iface_addr.s_addr)
+            continue;
+        // virtual interfaces have no device, and devices without an affinity
+        // report -1
+        char path[128];
+        snprintf(path, sizeof(path), "/sys/class/net/%s/device/numa_node", ifa->ifa_name);
+        FILE *f = fopen(path, "r");
+        if (f) {
+            if (fscanf(f, "%d", &node) != 1)
+                node = -1;
+            fclose(f);
+        }
+        dbg(DBG_LCM, "interface %s is on NUMA node %d\n", ifa->ifa_name, node);
+        break;
+    }
+    freeifaddrs(ifaddrs);
+    return node;
+#else
+    (void) iface_addr;
+    (void) mc_addr;
+    return -1;
+#endif
+}
+
+/******************** delta encoding **********************/
+// unchanged bytes that end a run of changed ones.  Shorter gaps cost less to
+// send as part of the run than as the header of another one.
+#define LCM_DELTA_MIN_GAP 8
+
+static inline int delta_words_equal(const char *a, const char *b)
+{
+    uint64_t x, y;
+    memcpy(&x, a, sizeof(x));
+    memcpy(&y, b, sizeof(y));
+    return x == y;
+}
+
+char *lcm_delta_encode(const void *data, uint32_t datalen, const void *base,
+                       uint32_t base_seqno, uint32_t *payload_size)
+{
+    const char *cur = (const char *) data;
+    const char *prev = (const char *) base;
+    uint32_t capacity = sizeof(lcm2_header_delta_t) + datalen;
+    char *payload = (char *) malloc(capacity);
+    uint32_t pos = sizeof(lcm2_header_delta_t);
+    uint32_t i = 0;
+    while (1) {
+        // skip the unchanged bytes, a word at a time where possible
+        uint32_t start = i;
+        while (i + sizeof(uint64_t) <= datalen && delta_words_equal(cur + i, prev + i))
+            i += sizeof(uint64_t);
+        while (i < datalen && cur[i] == prev[i])
+            i++;
+        if (i == datalen)
+            break;  // the unchanged bytes at the end need no run
+
+        uint32_t run_start = i;
+        uint32_t run_end = i;
+        while (i < datalen && i - run_end < LCM_DELTA_MIN_GAP) {
+            if (cur[i] != prev[i])
+                run_end = i + 1;
+            i++;
+        }
+        i = run_end;
+
+        uint32_t run[2] = {htonl(run_start - start), htonl(run_end - run_start)};
+        if (capacity - pos < sizeof(run) + (run_end - run_start)) {
+            free(payload);
+            return NULL;
+        }
+        memcpy(payload + pos, run, sizeof(run));
+        pos += sizeof(run);
+        for (uint32_t j = run_start; j < run_end; j++)
+            payload[pos++] = cur[j] ^ prev[j];
+    }
+
+    lcm2_header_delta_t hdr = {htonl(base_seqno), htonl(datalen), 0};
+    memcpy(payload, &hdr, sizeof(hdr));
+    *payload_size = pos;
+    return payload;
+}
+
+char *lcm_delta_keyframe(const void *data, uint32_t datalen, uint32_t *payload_size)
+{
+    lcm2_header_delta_t hdr = {0, htonl(datalen), htonl(LCM2_DELTA_KEYFRAME)};
+    char *payload = (char *) malloc(sizeof(hdr) + datalen);
+    memcpy(payload, &hdr, sizeof(hdr));
+    memcpy(payload + sizeof(hdr), data, datalen);
+    *payload_size = sizeof(hdr) + datalen;
+    return payload;
+}
+
+/******************** compression **********************/
+GRegex *lcm_parse_compress_option(const char *value)
+{
+#ifdef LCM_HAVE_LZ4
+    char *regexbuf = g_strdup_printf("^%s$", value);
+    GError *rerr = NULL;
+    GRegex *regex = g_regex_new(regexbuf, (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, &rerr);
+    g_free(regexbuf);
+    if (rerr) {
+        fprintf(stderr, "Warning: Invalid value for compress: %s\n", rerr->message);
+        g_error_free(rerr);
+        return NULL;
+    }
+    return regex;
+#else
+    (void) value;
+    fprintf(stderr, "Warning: LCM was built without LZ4, ignoring compress\n");
+    return NULL;
+#endif
+}
+
+char *lcm_compress_payload(const void *data, uint32_t datalen, uint32_t *payload_size)
+{
+#ifdef LCM_HAVE_LZ4
+    uint32_t size = htonl(datalen);
+    if (datalen <= sizeof(size) + 1 || datalen > LZ4_MAX_INPUT_SIZE)
+        return NULL;
+
+    // LZ4 gives up once the output would be no smaller than the message
+    int capacity = datalen - sizeof(size) - 1;
+    char *payload = (char *) malloc(sizeof(size) + capacity);
+    int compressed_size =
+        LZ4_compress_default((const char *) data, payload + sizeof(size), datalen, capacity);
+    if (compressed_size <= 0) {
+        free(payload);
+        return NULL;
+    }
+    memcpy(payload, &size, sizeof(size));
+    *payload_size = sizeof(size) + compressed_size;
+    return payload;
+#else
+    (void) data;
+    (void) datalen;
+    (void) payload_size;
+    return NULL;
+#endif
+}
+
+/******************** forward error correction **********************/
+
+void lcm_fragment_extent(uint32_t msg_size, uint32_t fragment_size, int channel_size,
+                         uint16_t fragment_no, uint32_t *offset, uint32_t *size)
+{
+    uint32_t first_size = fragment_size - (channel_size + 1);
+    if (fragment_no == 0) {
+        *offset = 0;
+        *size = MIN(first_size, msg_size);
+        return;
+    }
+    *offset = first_size + (uint32_t) (fragment_no - 1) * fragment_size;
+    *size = *offset < msg_size ? MIN(fragment_size, msg_size - *offset) : 0;
+}
+
+void lcm_xor_bytes(char *dst, const char *src, uint32_t size)
+{
+    // written plainly, for the compiler to vectorize
+    for (uint32_t i = 0; i < size; i++)
+        dst[i] ^= src[i];
+}
+
+/******************** scatter-gather **********************/
+
+int lcm_iov_slice(const lcm_iovec_t *iov, int iovcnt, uint32_t offset, uint32_t len,
+                  struct iovec *out)
+{
+    int n = 0;
+    for (int i = 0; i < iovcnt && len > 0; i++) {
+        if (offset >= iov[i].len) {
+            offset -= iov[i].len;
+            continue;
+        }
+        uint32_t piece = MIN(iov[i].len - offset, len);
+        out[n].iov_base = (char *) iov[i].data + offset;
+        out[n].iov_len = piece;
+        n++;
+        offset = 0;
+        len -= piece;
+    }
+    return n;
+}
+
+char *lcm_iov_gather(const lcm_iovec_t *iov, int iovcnt, uint32_t datalen)
+{
+    char *buf = (char *) malloc(MAX(datalen, 1));
+    uint32_t offset = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        memcpy(buf + offset, iov[i].data, iov[i].len);
+        offset += iov[i].len;
+    }
+    return buf;
+}
+
+/******************** subscriber interest **********************/
+
+// a channel pattern of an interest announcement
+typedef struct {
+    const char *name;  // in the announcement
+    GRegex *re;        // if it is not a plain channel name, or NULL
+    int match_all;     // if it could not be compiled
+} lcm_interest_pattern_t;
+
+// what an instance announced last
+typedef struct {
+    char *patterns;  // NULL-terminated, back to back, as announced
+    int size;
+    lcm_interest_pattern_t *compiled;
+    int num_patterns;
+    int64_t last_seen;
+} lcm_interest_sender_t;
+
+struct _lcm_interest {
+    GMutex lock;
+    GHashTable *senders;  // id -> lcm_interest_sender_t
+    int64_t period;
+    int64_t warm_after;
+    int warm;
+    guint generation;  // changed atomically
+};
+
+static void lcm_interest_sender_free(gpointer data)
+{
+    lcm_interest_sender_t *sender = (lcm_interest_sender_t *) data;
+    for (int i = 0; i < sender->num_patterns; i++) {
+        if (sender->compiled[i].re)
+            g_regex_unref(sender->compiled[i].re);
+    }
+    free(sender->compiled);
+    free(sender->patterns);
+    free(sender);
+}
+
+// whether a channel pattern matches itself only, so that it is compared
+// rather than compiled
+static int lcm_interest_is_plain(const char *pattern)
+{
+    return !strpbrk(pattern, ".[]()*+?{}|^$\\");
+}
+
+static void lcm_interest_compile(lcm_interest_sender_t *sender)
+{
+    sender->num_patterns = 0;
+    for (int pos = 0; pos < sender->size; pos += strlen(sender->patterns + pos) + 1)
+        sender->num_patterns++;
+    sender->compiled =
+        (lcm_interest_pattern_t *) calloc(sender->num_patterns, sizeof(lcm_interest_pattern_t));
+    int i = 0;
+    for (int pos = 0; pos < sender->size; pos += strlen(sender->patterns + pos) + 1) {
+        lcm_interest_pattern_t *pattern = &sender->compiled[i++];
+        pattern->name = sender->patterns + pos;
+        if (lcm_interest_is_plain(pattern->name))
+            continue;
+        char *regexbuf = g_strdup_printf("^%s$", pattern->name);
+        pattern->re = g_regex_new(regexbuf, (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, NULL);
+        g_free(regexbuf);
+        // better to send what nobody wants than to miss what somebody does
+        pattern->match_all = !pattern->re;
+    }
+}
+
+lcm_interest_t *lcm_interest_new(int64_t period, int64_t now)
+{
+    lcm_interest_t *interest = (lcm_interest_t *) calloc(1, sizeof(lcm_interest_t));
+    g_mutex_init(&interest->lock);
+    interest->senders =
+        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, lcm_interest_sender_free);
+    interest->period = period;
+    interest->warm_after = now + period + period / 2;
+    return interest;
+}
+
+void lcm_interest_destroy(lcm_interest_t *interest)
+{
+    g_hash_table_destroy(interest->senders);
+    g_mutex_clear(&interest->lock);
+    free(interest);
+}
+
+int lcm_interest_receive(lcm_interest_t *interest, const char *buf, int size, int64_t now,
+                         uint32_t *id)
+{
+    lcm2_header_short_t hdr;
+    if (size < (int) sizeof(hdr))
+        return -1;
+    memcpy(&hdr, buf, sizeof(hdr));
+    const char *patterns = buf + sizeof(hdr);
+    int patterns_size = size - sizeof(hdr);
+    if (ntohl(hdr.magic) != LCM2_MAGIC_INTEREST ||
+        (patterns_size > 0 && patterns[patterns_size - 1] != '\0'))
+        return -1;
+    *id = ntohl(hdr.msg_seqno);
+    gpointer key = GUINT_TO_POINTER(*id);
+
+    g_mutex_lock(&interest->lock);
+    lcm_interest_sender_t *sender =
+        (lcm_interest_sender_t *) g_hash_table_lookup(interest->senders, key);
+    int changed = 1;
+    if (!patterns_size) {
+        changed = sender != NULL;
+        if (sender) {
+            g_hash_table_remove(interest->senders, key);
+            g_atomic_int_inc(&interest->generation);
+        }
+    } else if (sender && sender->size == patterns_size &&
+               !memcmp(sender->patterns, patterns, patterns_size)) {
+        sender->last_seen = now;
+        changed = 0;
+    } else {
+        sender = (lcm_interest_sender_t *) calloc(1, sizeof(lcm_interest_sender_t));
+        sender->patterns = (char *) malloc(patterns_size);
+        memcpy(sender->patterns, patterns, patterns_size);
+        sender->size = patterns_size;
+        sender->last_seen = now;
+        lcm_interest_compile(sender);
+        g_hash_table_replace(interest->senders, key, sender);
+        g_atomic_int_inc(&interest->generation);
+    }
+    g_mutex_unlock(&interest->lock);
+    return changed;
+}
+
+static gboolean lcm_interest_is_stale(gpointer key, gpointer value, gpointer user)
+{
+    (void) key;
+    const lcm_interest_sender_t *sender = (const lcm_interest_sender_t *) value;
+    return sender->last_seen < *(const int64_t *) user;
+}
+
+void lcm_interest_expire(lcm_interest_t *interest, int64_t now)
+{
+    int64_t oldest = now - LCM_INTEREST_EXPIRY * interest->period;
+    g_mutex_lock(&interest->lock);
+    int changed = g_hash_table_foreach_remove(interest->senders, lcm_interest_is_stale, &oldest);
+    if (!interest->warm && now >= interest->warm_after) {
+        interest->warm = 1;
+        changed = 1;
+    }
+    if (changed)
+        g_atomic_int_inc(&interest->generation);
+    g_mutex_unlock(&interest->lock);
+}
+
+uint32_t lcm_interest_generation(lcm_interest_t *interest)
+{
+    return g_atomic_int_get(&interest->generation);
+}
+
+static int lcm_interest_pattern_matches(const lcm_interest_pattern_t *pattern,
+                                        const char *channel)
+{
+    if (pattern->re)
+        return g_regex_match(pattern->re, channel, (GRegexMatchFlags) 0, NULL);
+    return pattern->match_all || !strcmp(pattern->name, channel);
+}
+
+static int lcm_interest_sender_matches(const lcm_interest_sender_t *sender, const char *channel)
+{
+    for (int i = 0; i < sender->num_patterns; i++) {
+        if (lcm_interest_pattern_matches(&sender->compiled[i], channel))
+            return 1;
+    }
+    return 0;
+}
+
+int lcm_interest_has_subscribers(lcm_interest_t *interest, const char *channel)
+{
+    g_mutex_lock(&interest->lock);
+    int found = !interest->warm;
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, interest->senders);
+    while (!found && g_hash_table_iter_next(&iter, NULL, &value))
+        found = lcm_interest_sender_matches((const lcm_interest_sender_t *) value, channel);
+    g_mutex_unlock(&interest->lock);
+    return found;
+}
+
+int lcm_interest_num_matches(lcm_interest_t *interest, uint32_t id, const char *channel)
+{
+    g_mutex_lock(&interest->lock);
+    const lcm_interest_sender_t *sender = (const lcm_interest_sender_t *) g_hash_table_lookup(
+        interest->senders, GUINT_TO_POINTER(id));
+    int num_matches = 0;
+    for (int i = 0; sender && i < sender->num_patterns; i++)
+        num_matches += lcm_interest_pattern_matches(&sender->compiled[i], channel);
+    g_mutex_unlock(&interest->lock);
+    return num_matches;
+}
+
+int lcm_interest_encode(uint32_t id, GHashTable *channels, char *buf, int maxlen)
+{
+    lcm2_header_short_t hdr;
+    hdr.magic = htonl(LCM2_MAGIC_INTEREST);
+    hdr.msg_seqno = htonl(id);
+    memcpy(buf, &hdr, sizeof(hdr));
+    int size = sizeof(hdr);
+
+    if (!channels)
+        return size;
+    GHashTableIter iter;
+    gpointer key;
+    g_hash_table_iter_init(&iter, channels);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        int len = strlen((const char *) key) + 1;
+        if (size + len > maxlen) {
+            memcpy(buf + sizeof(hdr), ".*", 3);
+            return sizeof(hdr) + 3;
+        }
+        memcpy(buf + size, key, len);
+        size += len;
+    }
+    return size;
+}
+
+/******************** statistics **********************/
+
+void lcm_udp_stats_read(lcm_stats_t *src, lcm_stats_t *dst)
+{
+    dst->packets_received = lcm_stat_get(&src->packets_received);
+    dst->bytes_received = lcm_stat_get(&src->bytes_received);
+    dst->packets_bad = lcm_stat_get(&src->packets_bad);
+    dst->frag_bufs_evicted = lcm_stat_get(&src->frag_bufs_evicted);
+    dst->messages_incomplete = lcm_stat_get(&src->messages_incomplete);
+    dst->kernel_drops = lcm_stat_get(&src->kernel_drops);
+    dst->ringbuf_high_water = lcm_stat_get(&src->ringbuf_high_water);
+    dst->ringbuf_capacity = lcm_stat_get(&src->ringbuf_capacity);
+    dst->self_test_failures = lcm_stat_get(&src->self_test_failures);
+    dst->fragments_recovered = lcm_stat_get(&src->fragments_recovered);
+    dst->fragments_requested = lcm_stat_get(&src->fragments_requested);
+    dst->seqno_gaps = lcm_stat_get(&src->seqno_gaps);
+    dst->seqno_duplicates = lcm_stat_get(&src->seqno_duplicates);
+    dst->seqno_reorders = lcm_stat_get(&src->seqno_reorders);
+    dst->deltas_dropped = lcm_stat_get(&src->deltas_dropped);
+    dst->recv_buf_size = lcm_stat_get(&src->recv_buf_size);
+}
+
 #ifdef __linux__
 static inline int _parse_inaddr(const char *addr_str, struct in_addr *addr)
 {
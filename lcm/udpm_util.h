@@ -12,6 +12,7 @@ extern "C" {
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <unistd.h>
 typedef int SOCKET;
 #endif
@@ -29,11 +30,18 @@ typedef int SOCKET;
 #include <glib.h>
 
 #include "lcm.h"
+#include "lcm_internal.h"
 #include "ringbuffer.h"
 
 /************************* Important Defines *******************/
 #define LCM2_MAGIC_SHORT 0x4c433032  // hex repr of ascii "LC02"
 #define LCM2_MAGIC_LONG 0x4c433033   // hex repr of ascii "LC03"
+#define LCM2_MAGIC_BUNDLE 0x4c433034  // hex repr of ascii "LC04"
+#define LCM2_MAGIC_LONG_LZ4 0x4c433035  // hex repr of ascii "LC05"
+#define LCM2_MAGIC_PARITY 0x4c433036  // hex repr of ascii "LC06"
+#define LCM2_MAGIC_NACK 0x4c433037  // hex repr of ascii "LC07"
+#define LCM2_MAGIC_LONG_DELTA 0x4c433038  // hex repr of ascii "LC08"
+#define LCM2_MAGIC_INTEREST 0x4c433039  // hex repr of ascii "LC09"
 
 #ifdef __APPLE__
 #define LCM_SHORT_MESSAGE_MAX_SIZE 1435
@@ -45,8 +53,18 @@ typedef int SOCKET;
 
 #define LCM_RINGBUF_SIZE (200 * 1024)
 
+// largest datagram that the receive path accepts into a ringbuffer slot
+#define LCM_MAX_UNFRAGMENTED_PACKET_SIZE 65536
+
 #define LCM_DEFAULT_RECV_BUFS 2000
 
+// maximum number of received messages waiting to be dispatched by lcm_handle()
+#define LCM_RECV_QUEUE_SIZE 4096
+
+// maximum number of received messages of each priority class above 0 waiting
+// to be dispatched, which are expected to be few
+#define LCM_PRIORITY_QUEUE_SIZE (LCM_RECV_QUEUE_SIZE / 8)
+
 #define MAX_FRAG_BUF_TOTAL_SIZE (1 << 24)  // 16 megabytes
 #define MAX_NUM_FRAG_BUFS 1000
 
@@ -81,6 +99,147 @@ typedef struct _lcm2_header_long {
 // if fragment_no == 0, then header is immediately followed by NULL-terminated
 // ASCII-encoded channel name, followed by the payload data
 // if fragment_no > 0, then header is immediately followed by the payload data
+// Fragments with magic LCM2_MAGIC_LONG_LZ4 are the same, except that the
+// payload, and msg_size, are those of the LZ4 compressed message, preceded by
+// the size of the uncompressed message as a 32-bit big-endian integer.
+// Receivers that predate compression discard them as bad packets.
+// Fragments with magic LCM2_MAGIC_LONG_DELTA are the same, except that the
+// payload, and msg_size, are a lcm2_header_delta_t followed by the message if
+// it is a keyframe, and otherwise by its differences from the message that
+// the sender sent before it on the same channel, with sequence number
+// base_seqno.  Those are runs of changed bytes, each given by the number of
+// unchanged bytes before it and its own length, as 32-bit big-endian
+// integers, followed by the XOR of its bytes with those of the previous
+// message.  Receivers that predate deltas discard them as bad packets.
+typedef struct _lcm2_header_delta {
+    uint32_t base_seqno;  // of the previous message, unless a keyframe
+    uint32_t msg_size;    // of the message
+    uint32_t flags;
+} lcm2_header_delta_t;
+#define LCM2_DELTA_KEYFRAME 1  // the message follows as it is
+
+// A bundle packet is a lcm2_header_short_t with magic LCM2_MAGIC_BUNDLE,
+// followed by one or more short messages.  Each is a NULL-terminated channel
+// name, the size of its payload as a 32-bit big-endian integer, and the
+// payload data.  Receivers that predate bundles discard them as bad packets.
+#define LCM2_BUNDLE_ENTRY_OVERHEAD 5  // bytes of each message besides channel and payload
+
+// A parity packet is a lcm2_header_long_t with magic LCM2_MAGIC_PARITY,
+// followed by a lcm2_header_parity_t, the NULL-terminated channel name, and the
+// XOR of the payloads of a group of consecutive fragments, each padded with
+// zeros to the length of the longest.  msg_seqno, msg_size and
+// fragments_in_msg are those of the fragments, fragment_no is the first
+// fragment of the group, and fragment_offset is 0.  A receiver that is missing
+// one of the fragments of the group rebuilds it from the parity and the
+// others.  Receivers that predate parity packets discard them as bad packets.
+typedef struct _lcm2_header_parity {
+    uint32_t fragment_size;  // payload of each fragment, the first one's including the channel
+    uint16_t group_size;     // number of fragments in the group
+    uint16_t flags;
+} lcm2_header_parity_t;
+#define LCM2_PARITY_LZ4 1  // the fragments have magic LCM2_MAGIC_LONG_LZ4
+#define LCM2_PARITY_DELTA 2  // the fragments have magic LCM2_MAGIC_LONG_DELTA
+
+// A NACK is a lcm2_header_short_t with magic LCM2_MAGIC_NACK, which a receiver
+// sends to the address that the fragments of an incomplete message came from.
+// It is followed by the number of fragments that are missing, as a 16-bit
+// big-endian integer, and the fragment_no of each, in the same format.
+// msg_seqno is that of the message.  A publisher that still has the message
+// sends those fragments to the multicast group again, and others ignore it.
+#define LCM2_NACK_MAX_FRAGMENTS 512  // most fragments that a NACK lists
+
+// An interest announcement is a lcm2_header_short_t with magic
+// LCM2_MAGIC_INTEREST, sent to the interest port of the multicast group rather
+// than to its data port, followed by the channel patterns that the sender
+// subscribes to, as they were given to lcm_subscribe(), each NULL-terminated.
+// msg_seqno is a random number that identifies the sending instance.  A
+// sender whose patterns don't fit in a datagram announces ".*" instead, and
+// one that stops subscribing announces no patterns at all.
+
+/************************* Datagram Size *******************/
+// default, smallest and largest UDP payload of a datagram sent by a publisher
+#define LCM_DEFAULT_PACKET_SIZE (LCM_SHORT_MESSAGE_MAX_SIZE + sizeof(lcm2_header_short_t))
+#define LCM_MIN_PACKET_SIZE 256
+#define LCM_MAX_PACKET_SIZE 65507
+
+// bytes of IPv4 and UDP headers that precede the payload of a datagram
+#define LCM_UDP_IP_OVERHEAD 28
+
+// requests that the packet size be derived from the MTU of the interface
+// that multicast traffic leaves on
+#define LCM_PACKET_SIZE_AUTO -1
+
+// Parses the value of a "frag_size" or "mtu" provider option.  Returns the
+// requested packet size, LCM_PACKET_SIZE_AUTO for "mtu=auto", or 0 if the
+// value is invalid.
+LCM_NO_EXPORT
+int lcm_parse_packet_size(const char *key, const char *value);
+
+// Returns the packet size to transmit with.  packet_size is the value from
+// lcm_parse_packet_size(), or 0 if no option was given.
+LCM_NO_EXPORT
+int lcm_resolve_packet_size(int packet_size, struct in_addr mc_addr);
+
+// Returns the NUMA node of the network interface with address iface_addr, or
+// of the one that mc_addr is routed to if iface_addr is INADDR_ANY.  Returns
+// -1 if that is unknown, or not on Linux.
+LCM_NO_EXPORT
+int lcm_resolve_numa_node(struct in_addr iface_addr, struct in_addr mc_addr);
+
+/************************* Compression *******************/
+// Parses the value of a "compress" provider option, a regular expression that
+// the whole channel name must match.  Returns NULL, with a warning, if the
+// value is invalid or liblcm was built without LZ4.
+LCM_NO_EXPORT
+GRegex *lcm_parse_compress_option(const char *value);
+
+// Compresses a message for sending with LCM2_MAGIC_LONG_LZ4.  Returns the
+// payload, to be released with free(), and stores its size in payload_size.
+// Returns NULL if the message would not get any smaller.
+LCM_NO_EXPORT
+char *lcm_compress_payload(const void *data, uint32_t datalen, uint32_t *payload_size);
+
+/************************* Delta Encoding *******************/
+// Encodes a message for sending with LCM2_MAGIC_LONG_DELTA, as its
+// differences from base, the previous message of the same size on its
+// channel, which was sent with sequence number base_seqno.  Returns the
+// payload, to be released with free(), and stores its size in payload_size.
+// Returns NULL if the delta would not be any smaller than the message.
+LCM_NO_EXPORT
+char *lcm_delta_encode(const void *data, uint32_t datalen, const void *base,
+                       uint32_t base_seqno, uint32_t *payload_size);
+
+// Like lcm_delta_encode(), but for a keyframe, which holds the whole message.
+LCM_NO_EXPORT
+char *lcm_delta_keyframe(const void *data, uint32_t datalen, uint32_t *payload_size);
+
+/************************* Forward Error Correction *******************/
+// Finds where a fragment's payload lies in a message of msg_size bytes that
+// was split into fragments of fragment_size bytes, the first of which also
+// holds a channel name of channel_size characters and its NULL terminator.
+LCM_NO_EXPORT
+void lcm_fragment_extent(uint32_t msg_size, uint32_t fragment_size, int channel_size,
+                         uint16_t fragment_no, uint32_t *offset, uint32_t *size);
+
+// XORs size bytes of src into dst
+LCM_NO_EXPORT
+void lcm_xor_bytes(char *dst, const char *src, uint32_t size);
+
+/************************* Scatter-Gather *******************/
+// most pieces of a message from lcm_publishv() that are sent as they are.
+// Messages of more pieces are gathered into one buffer first.
+#define LCM_MAX_PUBLISHV_IOVS 16
+
+// Stores in out the pieces of iov that hold the len bytes from offset on, of
+// which there are at most iovcnt.  Returns how many it stored.
+LCM_NO_EXPORT
+int lcm_iov_slice(const lcm_iovec_t *iov, int iovcnt, uint32_t offset, uint32_t len,
+                  struct iovec *out);
+
+// Copies the pieces of iov, of datalen bytes in all, into a buffer to be
+// released with free().
+LCM_NO_EXPORT
+char *lcm_iov_gather(const lcm_iovec_t *iov, int iovcnt, uint32_t datalen);
 
 /************************* Utility Functions *******************/
 static inline int lcm_close_socket(SOCKET fd)
@@ -92,12 +251,41 @@ static inline int lcm_close_socket(SOCKET fd)
 #endif
 }
 
+/******************** payload buffer pool **********************/
+// Recycles the payload buffers of fragmented messages.  Buffers are grouped
+// into power-of-two size classes, and up to max_cached_size bytes of released
+// buffers are kept around for reuse.  Safe to use from multiple threads.
+typedef struct _lcm_buf_pool lcm_buf_pool_t;
+
+// the buffers are aligned to alignment bytes, a power of two, or as malloc()
+// aligns them if that is 0
+LCM_NO_EXPORT
+lcm_buf_pool_t *lcm_buf_pool_new(uint32_t max_cached_size, uint32_t alignment);
+LCM_NO_EXPORT
+void lcm_buf_pool_destroy(lcm_buf_pool_t *pool);
+
+// allocate a buffer of at least size bytes.  If pool is NULL, this is the
+// same as malloc().
+LCM_NO_EXPORT
+char *lcm_buf_pool_alloc(lcm_buf_pool_t *pool, uint32_t size);
+
+// return a buffer from lcm_buf_pool_alloc().  size must be the same as the
+// size it was allocated with.
+LCM_NO_EXPORT
+void lcm_buf_pool_release(lcm_buf_pool_t *pool, char *data, uint32_t size);
+
 /******************** message buffer **********************/
 typedef struct _lcm_buf {
-    char channel_name[LCM_MAX_CHANNEL_NAME_LENGTH + 1];
+    // the channel name interned by lcm_intern_channel(), or channel_copy if
+    // the table of interned names is full
+    const char *channel_name;
+    int channel_id;    // from lcm_intern_channel(), or -1
     int channel_size;  // length of channel name
+    char channel_copy[LCM_MAX_CHANNEL_NAME_LENGTH + 1];
 
     int64_t recv_utime;  // timestamp of first datagram receipt
+    int64_t recv_time_ns;  // the same timestamp, with nanosecond resolution
+    int64_t recv_mono_ns;  // the same timestamp, on the monotonic clock
     char *buf;           // pointer to beginning of message.  This includes
                          // the header for unfragmented messages, and does
                          // not include the header for fragmented messages.
@@ -106,12 +294,28 @@ typedef struct _lcm_buf {
     int data_size;           // size of payload
     lcm_ringbuf_t *ringbuf;  // the ringbuffer used to allocate buf.  NULL if
                              // not allocated from ringbuf
+    lcm_buf_pool_t *pool;    // the pool used to allocate buf.  NULL if not
+                             // allocated from a pool
 
     int packet_size;  // total bytes received
     int buf_size;     // bytes allocated
+    int num_bundled;  // messages left in a bundle packet, or 0 if buf holds a
+                      // single message
+    int priority;     // the priority class of the channel, or the highest
+                      // class of the messages in a bundle packet
 
     struct sockaddr from;  // sender
     socklen_t fromlen;
+
+    // lcm_handle() and the handlers that retained the buffer, or 0 before it
+    // is dispatched.  Changed atomically.
+    int refcount;
+    // where the handler that releases the buffer last puts it
+    struct _lcm_buf_returns *returns;
+    // with the share option of udpm, the instances that queued the message,
+    // by their slot
+    uint64_t share_mask;
+
     struct _lcm_buf *next;
 } lcm_buf_t;
 
@@ -120,6 +324,7 @@ typedef struct _lcm_buf_queue {
     lcm_buf_t *head;
     lcm_buf_t **tail;
     int count;
+    int grow;  // buffers that lcm_buf_allocate_data() adds when there are none
 } lcm_buf_queue_t;
 
 LCM_NO_EXPORT
@@ -131,60 +336,343 @@ void lcm_buf_enqueue(lcm_buf_queue_t *q, lcm_buf_t *el);
 
 LCM_NO_EXPORT
 void lcm_buf_queue_free(lcm_buf_queue_t *q, lcm_ringbuf_t *ringbuf);
+
+/******* Lending message buffers to handlers *******/
+// The buffers that handlers released with lcm_recv_buf_release() after
+// lcm_handle() was done with them, on their way back to the read thread that
+// owns their ringbuffer.
+typedef struct _lcm_buf_returns {
+    GMutex mutex;
+    lcm_buf_queue_t *bufs;
+    int count;  // read atomically, changed with mutex held
+} lcm_buf_returns_t;
+
+LCM_NO_EXPORT
+void lcm_buf_returns_init(lcm_buf_returns_t *returns);
+
+// frees the buffers that were not taken back yet
+LCM_NO_EXPORT
+void lcm_buf_returns_clear(lcm_buf_returns_t *returns, lcm_ringbuf_t *ringbuf);
+
+// takes back the released buffers, frees their data and puts them in
+// inbufs_empty.  Called by the owner of ringbuf.
+LCM_NO_EXPORT
+void lcm_buf_returns_take(lcm_buf_returns_t *returns, lcm_buf_queue_t *inbufs_empty,
+                          lcm_ringbuf_t *ringbuf);
+
+// passes lcmb to lcm_dispatch_channel_handlers() as the msg of lcm_buf_lender
+extern LCM_NO_EXPORT const lcm_recv_buf_lender_t lcm_buf_lender;
+
+// lends lcmb to the handlers of its messages, unless that was done for an
+// earlier message of the same bundle packet already.  The handlers that
+// retain it put it in returns once they release it.
+LCM_NO_EXPORT
+void lcm_buf_lend(lcm_buf_t *lcmb, lcm_buf_returns_t *returns);
+
+// Returns 1 if lcm_handle() can hand lcmb back once it has dispatched all of
+// the messages in it, or 0 if a handler still holds it.
+LCM_NO_EXPORT
+int lcm_buf_lend_end(lcm_buf_t *lcmb);
 LCM_NO_EXPORT
 int lcm_buf_queue_is_empty(lcm_buf_queue_t *q);
 
+/***** Bounded lock-free queue of message buffers *****/
+// A fixed-capacity ring of lcm_buf_t pointers that one producer thread and one
+// consumer thread can use concurrently without locking.  Each index is written
+// by only one side.
+typedef struct _lcm_buf_ring {
+    lcm_buf_t **bufs;
+    unsigned int mask;  // capacity - 1
+    gint head;          // next slot to pop, written by the consumer
+    gint tail;          // next slot to push, written by the producer
+} lcm_buf_ring_t;
+
+// capacity is rounded up to a power of two
+LCM_NO_EXPORT
+lcm_buf_ring_t *lcm_buf_ring_new(unsigned int capacity);
+LCM_NO_EXPORT
+void lcm_buf_ring_free(lcm_buf_ring_t *ring, lcm_ringbuf_t *ringbuf);
+LCM_NO_EXPORT
+unsigned int lcm_buf_ring_capacity(lcm_buf_ring_t *ring);
+
+// Producer side.  Returns -1 if the ring is full, 1 if the consumer had
+// already taken every previously pushed buffer (i.e., the consumer may be
+// waiting and should be notified), and 0 otherwise.
+LCM_NO_EXPORT
+int lcm_buf_ring_push(lcm_buf_ring_t *ring, lcm_buf_t *el);
+
+// Consumer side.  Returns NULL if the ring is empty.
+LCM_NO_EXPORT
+lcm_buf_t *lcm_buf_ring_pop(lcm_buf_ring_t *ring);
+LCM_NO_EXPORT
+int lcm_buf_ring_is_empty(lcm_buf_ring_t *ring);
+
 // allocate a lcm_buf from the ringbuf. If there is no more space in the ringbuf
 // it is replaced with a bigger one. In this case, the old ringbuffer will be
-// cleaned up when lcm_buf_free_data() is called;
+// cleaned up when lcm_buf_free_data() is called.  If max_size is nonzero, the
+// ringbuf is not replaced with one larger than max_size bytes, and NULL is
+// returned when it has reached that size.
+LCM_NO_EXPORT
+lcm_buf_t *lcm_buf_allocate_data(lcm_buf_queue_t *inbufs_empty, lcm_ringbuf_t **ringbuf,
+                                 unsigned int max_size);
+
+// allocate up to max_bufs lcm_bufs at once.  The first one is allocated like
+// lcm_buf_allocate_data(), the remaining ones only while they still fit in the
+// same ringbuffer.  Returns the number of buffers stored in lcmbs, which is
+// at least 1 unless the first allocation failed.
 LCM_NO_EXPORT
-lcm_buf_t *lcm_buf_allocate_data(lcm_buf_queue_t *inbufs_empty, lcm_ringbuf_t **ringbuf);
+int lcm_buf_allocate_data_batch(lcm_buf_queue_t *inbufs_empty, lcm_ringbuf_t **ringbuf,
+                                unsigned int max_size, lcm_buf_t **lcmbs, int max_bufs);
 
 LCM_NO_EXPORT
 void lcm_buf_free_data(lcm_buf_t *lcmb, lcm_ringbuf_t *ringbuf);
 
+// the largest alignment that lcm_buf_align_data() can move data to
+#define LCM_MAX_DATA_ALIGNMENT 64
+
+// moves the payload of the short message in lcmb, which fills its ringbuffer
+// slot from the start, to an address that is a multiple of alignment, a power
+// of two.  The header and channel name in front of it may be overwritten.
+LCM_NO_EXPORT
+void lcm_buf_align_data(lcm_buf_t *lcmb, int alignment);
+
+// sets the channel of lcmb to channel, which has channel_size characters, by
+// interning it, or copying it if that isn't possible.
+LCM_NO_EXPORT
+void lcm_buf_set_channel(lcm_buf_t *lcmb, const char *channel, int channel_size);
+
 /******************** fragment buffer **********************/
 typedef struct _lcm_frag_key {
     uint32_t msg_seqno;
     struct sockaddr_in *from;
 } lcm_frag_key_t;
 
+// largest number of fragments tracked without allocating a separate bitmap
+#define LCM_FRAG_BITMAP_INLINE_BITS 128
+
 typedef struct _lcm_frag_buf {
     char channel[LCM_MAX_CHANNEL_NAME_LENGTH + 1];
     struct sockaddr_in from;
     char *data;
     uint32_t data_size;
     uint16_t fragments_remaining;
+    uint16_t fragments_in_msg;
     uint32_t msg_seqno;
     int64_t last_packet_utime;
+    int64_t last_packet_time_ns;
+    int64_t last_packet_mono_ns;
+    int64_t nack_utime;  // when a NACK was last sent for the missing fragments
+    int nacks_sent;      // NACKs sent since a fragment was last received
     lcm_frag_key_t key;
+    lcm_buf_pool_t *pool;  // the pool used to allocate data, or NULL
+
+    // one bit per fragment that has already been received.  Points to
+    // received_inline for messages of up to LCM_FRAG_BITMAP_INLINE_BITS
+    // fragments, and to a heap allocation for larger ones.
+    uint64_t *received;
+    uint64_t received_inline[LCM_FRAG_BITMAP_INLINE_BITS / 64];
+
+    // least recently updated order within a lcm_frag_buf_store
+    struct _lcm_frag_buf *lru_prev;
+    struct _lcm_frag_buf *lru_next;
 } lcm_frag_buf_t;
 
+// pool may be NULL, in which case the payload buffer is malloc'ed
 LCM_NO_EXPORT
-lcm_frag_buf_t *lcm_frag_buf_new(struct sockaddr_in from, uint32_t msg_seqno, uint32_t data_size,
-                                 uint16_t nfragments, int64_t first_packet_utime);
+lcm_frag_buf_t *lcm_frag_buf_new(lcm_buf_pool_t *pool, struct sockaddr_in from,
+                                 uint32_t msg_seqno, uint32_t data_size, uint16_t nfragments,
+                                 int64_t first_packet_utime);
 LCM_NO_EXPORT
 void lcm_frag_buf_destroy(lcm_frag_buf_t *fbuf);
 
+// records that fragment_no has been received.  Returns 1 if it is new, 0 if
+// it is a duplicate, and -1 if the message has no such fragment.
+LCM_NO_EXPORT
+int lcm_frag_buf_mark_received(lcm_frag_buf_t *fbuf, uint16_t fragment_no);
+
+// Stores the numbers of up to max_missing fragments that have not been
+// received yet in missing, and returns how many it stored.
+LCM_NO_EXPORT
+int lcm_frag_buf_missing(lcm_frag_buf_t *fbuf, uint16_t *missing, int max_missing);
+
+// Replaces the reassembled payload of a message that was received with
+// LCM2_MAGIC_LONG_LZ4 by the uncompressed message.  Returns 0 on success, or
+// -1 if the payload is invalid.
+LCM_NO_EXPORT
+int lcm_frag_buf_decompress(lcm_frag_buf_t *fbuf);
+
+// Replaces the reassembled payload of a message that was received with
+// LCM2_MAGIC_LONG_DELTA by the message.  base is the message before it from
+// the same sender on the same channel, of base_size bytes and with sequence
+// number base_seqno, or NULL if none was received.  Returns 0 on success, 1
+// if the payload is a delta from a message other than base, or -1 if it is
+// invalid.
+LCM_NO_EXPORT
+int lcm_frag_buf_delta_decode(lcm_frag_buf_t *fbuf, const char *base, uint32_t base_size,
+                              uint32_t base_seqno);
+
+// Rebuilds the fragment that fbuf is missing from the group_size fragments
+// that start at first_fragment, from the parity of a parity packet, and
+// records it as received.  Returns 1 if a fragment was rebuilt, 0 if the group
+// is missing no fragment or more than one, and -1 if the parity packet does
+// not match the message.
+LCM_NO_EXPORT
+int lcm_frag_buf_recover(lcm_frag_buf_t *fbuf, uint32_t fragment_size, int channel_size,
+                         uint16_t first_fragment, uint16_t group_size, const char *parity,
+                         uint32_t parity_size);
+
+/******************** sequence numbers **********************/
+// What a receiver has seen of the msg_seqno of the datagrams of one sender:
+// the highest one, and which of the 63 before it arrived.
+typedef struct _lcm_seqno_state {
+    uint32_t last;
+    uint64_t seen;  // bit i is set if last - i arrived
+} lcm_seqno_state_t;
+
+// Starts tracking a sender whose first datagram had msg_seqno
+LCM_NO_EXPORT
+void lcm_seqno_init(lcm_seqno_state_t *state, uint32_t msg_seqno);
+
+// Records a datagram with msg_seqno from the sender of state, and counts the
+// sequence numbers that it skipped, repeated, or arrived after in stats.  The
+// fragments of a message, and its parity packets, all have its msg_seqno,
+// which is not a duplicate if is_fragment.
+LCM_NO_EXPORT
+void lcm_seqno_track(lcm_seqno_state_t *state, uint32_t msg_seqno, int is_fragment,
+                     lcm_stats_t *stats);
+
 /******************** fragment buffer store **********************/
+// number of recently ignored messages remembered by a fragment buffer store.
+// Must be a power of two.
+#define LCM_FRAG_IGNORED_SIZE 64
+
+typedef struct _lcm_frag_ignored {
+    uint32_t msg_seqno;
+    uint32_t addr;
+    uint16_t port;
+    uint16_t valid;
+} lcm_frag_ignored_t;
+
 typedef struct _lcm_frag_buf_store {
     uint32_t total_size;
     uint32_t max_total_size;
     uint32_t max_n_frag_bufs;
     GHashTable *frag_bufs;
+    // fragment buffers from least to most recently updated
+    lcm_frag_buf_t *lru_head;
+    lcm_frag_buf_t *lru_tail;
+    // messages whose remaining fragments are dropped without reassembly.
+    // Direct-mapped, so a newer entry may evict an older one.
+    lcm_frag_ignored_t ignored[LCM_FRAG_IGNORED_SIZE];
 } lcm_frag_buf_store;
 
 LCM_NO_EXPORT
 lcm_frag_buf_store *lcm_frag_buf_store_new(uint32_t max_total_size, uint32_t max_n_frag_bufs);
 LCM_NO_EXPORT
 void lcm_frag_buf_store_destroy(lcm_frag_buf_store *store);
+// finds the fragment buffer for key, and marks it as the most recently updated
 LCM_NO_EXPORT
 lcm_frag_buf_t *lcm_frag_buf_store_lookup(lcm_frag_buf_store *store, lcm_frag_key_t *key);
 
 LCM_NO_EXPORT
 void lcm_frag_buf_store_remove(lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf);
+// adds fbuf to the store, first removing the least recently updated fragment
+// buffers if the store is full.  Returns how many were removed.
+LCM_NO_EXPORT
+int lcm_frag_buf_store_add(lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf);
+
+// remember that the message identified by key is not wanted, so that its
+// remaining fragments can be dropped without allocating a fragment buffer
+LCM_NO_EXPORT
+void lcm_frag_buf_store_ignore(lcm_frag_buf_store *store, lcm_frag_key_t *key);
+LCM_NO_EXPORT
+int lcm_frag_buf_store_is_ignored(lcm_frag_buf_store *store, lcm_frag_key_t *key);
+
+/******************** socket readiness **********************/
+// Waits for incoming data on a set of sockets.  Registrations persist across
+// calls to lcm_poller_wait(), so the cost of a wakeup depends on the number
+// of ready sockets rather than on the number of registered ones.  Uses epoll
+// on Linux, poll() on other POSIX systems and select() on Windows.  A poller
+// must only be used from one thread at a time.
+typedef struct _lcm_poller lcm_poller_t;
+
+LCM_NO_EXPORT
+lcm_poller_t *lcm_poller_new(void);
+LCM_NO_EXPORT
+void lcm_poller_destroy(lcm_poller_t *poller);
+
+// start waiting for data on fd.  user is returned by lcm_poller_wait() when
+// fd becomes readable.
+LCM_NO_EXPORT
+int lcm_poller_add(lcm_poller_t *poller, SOCKET fd, void *user);
+
+// stop waiting for data on fd, which must not have been closed yet.  Returns
+// -1 if fd was not registered.
+LCM_NO_EXPORT
+int lcm_poller_remove(lcm_poller_t *poller, SOCKET fd);
+
+// block until at least one registered socket is readable.  Stores the user
+// pointers of up to max_ready readable sockets in ready, and returns how many
+// were stored, or -1 on error.
+LCM_NO_EXPORT
+int lcm_poller_wait(lcm_poller_t *poller, void **ready, int max_ready);
+
+/******************** subscriber interest **********************/
+// What the instances on a multicast group subscribe to, collected from their
+// interest announcements, so that publishers can skip the channels that
+// nobody subscribes to.  An instance that has not announced itself for
+// LCM_INTEREST_EXPIRY periods is forgotten.  Until a period and a half after
+// the table was created, every channel counts as subscribed to, since the
+// announcements of the others may not have arrived yet.
+#define LCM_INTEREST_EXPIRY 3
+
+typedef struct _lcm_interest lcm_interest_t;
+
+// period and now are in microseconds, of g_get_monotonic_time()
+LCM_NO_EXPORT
+lcm_interest_t *lcm_interest_new(int64_t period, int64_t now);
+LCM_NO_EXPORT
+void lcm_interest_destroy(lcm_interest_t *interest);
+
+// Records an interest announcement of size bytes, received at now, and sets
+// id to the instance that sent it.  Returns 1 if the channel patterns of that
+// instance changed, 0 if not, or -1 if the announcement is malformed.
+LCM_NO_EXPORT
+int lcm_interest_receive(lcm_interest_t *interest, const char *buf, int size, int64_t now,
+                         uint32_t *id);
+
+// Forgets the instances that have not announced themselves lately, and ends
+// the warm up.  Called at least once a period.
+LCM_NO_EXPORT
+void lcm_interest_expire(lcm_interest_t *interest, int64_t now);
+
+// A number that changes whenever lcm_interest_has_subscribers() may give a
+// different answer, so that publishers only ask it again then.  Can be read
+// from any thread without a lock.
+LCM_NO_EXPORT
+uint32_t lcm_interest_generation(lcm_interest_t *interest);
+
+// Whether any instance subscribes to channel, or the table is warming up.
+LCM_NO_EXPORT
+int lcm_interest_has_subscribers(lcm_interest_t *interest, const char *channel);
+
+// How many of the channel patterns of the instance with id match channel, as
+// of its last announcement.
+LCM_NO_EXPORT
+int lcm_interest_num_matches(lcm_interest_t *interest, uint32_t id, const char *channel);
+
+// Writes the interest announcement of the instance with id, which subscribes
+// to the channel patterns that are the keys of channels, or to none if channels
+// is NULL, into buf.  Returns its size, which is at most maxlen.
+LCM_NO_EXPORT
+int lcm_interest_encode(uint32_t id, GHashTable *channels, char *buf, int maxlen);
+
+/******************** statistics ****************************/
+
+// copies the counters that a receive thread updates in src to dst.  Does not
+// set dst->queue_drops, which is counted by lcm_get_stats() itself.
 LCM_NO_EXPORT
-void lcm_frag_buf_store_add(lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf);
+void lcm_udp_stats_read(lcm_stats_t *src, lcm_stats_t *dst);
 
 /************************* Linux Specific Functions *******************/
 #ifdef __linux__
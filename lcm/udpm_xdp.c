@@ -0,0 +1,376 @@
+#include <errno.h>
+#include <net/if.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+
+#include "udpm_xdp.h"
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+// The UMEM area is split into XDP_NUM_FRAMES frames of XDP_FRAME_SIZE bytes,
+// each of which holds one received frame.  All of them start out on the
+// fill ring, and the fill and receive rings are as large, so that neither
+// can overflow.
+#define XDP_FRAME_SIZE 4096
+#define XDP_NUM_FRAMES 4096
+
+// Ethernet, IPv4 without options, and UDP headers in front of the payload
+#define XDP_HEADERS_SIZE (14 + 20 + 8)
+
+typedef struct _xdp_ring_t {
+    uint32_t *producer;
+    uint32_t *consumer;
+    uint32_t *flags;
+    void *descs;
+    void *map;
+    size_t map_size;
+} xdp_ring_t;
+
+struct _lcm_xdp {
+    int fd;
+    int map_fd;
+    int prog_fd;
+    int link_fd;
+    char *umem;
+    xdp_ring_t fill;
+    xdp_ring_t comp;
+    xdp_ring_t rx;
+};
+
+static int sys_bpf(int cmd, union bpf_attr *attr)
+{
+    return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+static int xdp_map_ring(lcm_xdp_t *xdp, xdp_ring_t *ring, const struct xdp_ring_offset *off,
+                        size_t desc_size, off_t pgoff)
+{
+    ring->map_size = off->desc + XDP_NUM_FRAMES * desc_size;
+    ring->map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     xdp->fd, pgoff);
+    if (ring->map == MAP_FAILED) {
+        ring->map = NULL;
+        return -1;
+    }
+    ring->producer = (uint32_t *) ((char *) ring->map + off->producer);
+    ring->consumer = (uint32_t *) ((char *) ring->map + off->consumer);
+    ring->flags = (uint32_t *) ((char *) ring->map + off->flags);
+    ring->descs = (char *) ring->map + off->desc;
+    return 0;
+}
+
+static void xdp_unmap_ring(xdp_ring_t *ring)
+{
+    if (ring->map)
+        munmap(ring->map, ring->map_size);
+}
+
+#define XDP_INSN(code, dst, src, off, imm) ((struct bpf_insn){(code), (dst), (src), (off), (imm)})
+
+// Builds the XDP program into prog, and returns its length.  It redirects
+// the unfragmented IPv4 UDP datagrams to mc_addr:mc_port to the socket of
+// its receive queue in map_fd, and passes everything else.
+static int xdp_build_prog(struct bpf_insn *prog, int map_fd, struct in_addr mc_addr,
+                          uint16_t mc_port)
+{
+    // the conditions that a frame must meet, each a load from the packet
+    // into r5 and a value that it must equal
+    static const struct {
+        uint8_t size;
+        int16_t offset;
+        uint32_t mask;
+    } checks[] = {
+        {BPF_H, 12, 0},       // EtherType
+        {BPF_B, 14, 0},       // IP version and header length
+        {BPF_B, 23, 0},       // IP protocol
+        {BPF_H, 20, 0x3fff},  // more fragments flag and fragment offset
+        {BPF_W, 30, 0},       // destination address
+        {BPF_H, 36, 0},       // destination port
+    };
+    // the EtherType and port load in network byte order, just like they are
+    // given
+    uint32_t values[] = {htons(0x0800), 0x45, IPPROTO_UDP, 0, mc_addr.s_addr, mc_port};
+    int jumps[6];
+    int n = 0;
+
+    prog[n++] = XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_6, BPF_REG_1, 0, 0);
+    prog[n++] = XDP_INSN(BPF_LDX | BPF_W | BPF_MEM, BPF_REG_2, BPF_REG_6,
+                         offsetof(struct xdp_md, data), 0);
+    prog[n++] = XDP_INSN(BPF_LDX | BPF_W | BPF_MEM, BPF_REG_3, BPF_REG_6,
+                         offsetof(struct xdp_md, data_end), 0);
+    prog[n++] = XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_4, BPF_REG_2, 0, 0);
+    prog[n++] = XDP_INSN(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_4, 0, 0, XDP_HEADERS_SIZE);
+    int bounds_jump = n;
+    prog[n++] = XDP_INSN(BPF_JMP | BPF_JGT | BPF_X, BPF_REG_4, BPF_REG_3, 0, 0);
+
+    int i;
+    for (i = 0; i < 6; i++) {
+        prog[n++] = XDP_INSN(BPF_LDX | checks[i].size | BPF_MEM, BPF_REG_5, BPF_REG_2,
+                             checks[i].offset, 0);
+        if (checks[i].mask)
+            prog[n++] =
+                XDP_INSN(BPF_ALU64 | BPF_AND | BPF_K, BPF_REG_5, 0, 0, htons(checks[i].mask));
+        jumps[i] = n;
+        prog[n++] = XDP_INSN(BPF_JMP32 | BPF_JNE | BPF_K, BPF_REG_5, 0, 0, (int32_t) values[i]);
+    }
+
+    // bpf_redirect_map(map, rx_queue_index, XDP_PASS) passes the frames of
+    // the queues without a socket
+    prog[n++] = XDP_INSN(BPF_LDX | BPF_W | BPF_MEM, BPF_REG_2, BPF_REG_6,
+                         offsetof(struct xdp_md, rx_queue_index), 0);
+    prog[n++] = XDP_INSN(BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, map_fd);
+    prog[n++] = XDP_INSN(0, 0, 0, 0, 0);
+    prog[n++] = XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS);
+    prog[n++] = XDP_INSN(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map);
+    prog[n++] = XDP_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+
+    int pass = n;
+    prog[n++] = XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, XDP_PASS);
+    prog[n++] = XDP_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+
+    prog[bounds_jump].off = pass - bounds_jump - 1;
+    for (i = 0; i < 6; i++)
+        prog[jumps[i]].off = pass - jumps[i] - 1;
+    return n;
+}
+
+static int xdp_attach_prog(lcm_xdp_t *xdp, int ifindex, int queue, struct in_addr mc_addr,
+                           uint16_t mc_port)
+{
+    union bpf_attr attr;
+    int i;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof(uint32_t);
+    attr.value_size = sizeof(uint32_t);
+    attr.max_entries = queue + 1;
+    xdp->map_fd = sys_bpf(BPF_MAP_CREATE, &attr);
+    if (xdp->map_fd < 0) {
+        perror("lcm_xdp_open -- BPF_MAP_CREATE");
+        return -1;
+    }
+
+    uint32_t key = queue;
+    uint32_t value = xdp->fd;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = xdp->map_fd;
+    attr.key = (uintptr_t) &key;
+    attr.value = (uintptr_t) &value;
+    if (sys_bpf(BPF_MAP_UPDATE_ELEM, &attr) < 0) {
+        perror("lcm_xdp_open -- BPF_MAP_UPDATE_ELEM");
+        return -1;
+    }
+
+    struct bpf_insn prog[32];
+    char log[4096] = "";
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insn_cnt = xdp_build_prog(prog, xdp->map_fd, mc_addr, mc_port);
+    attr.insns = (uintptr_t) prog;
+    attr.license = (uintptr_t) "LGPL";
+    attr.log_level = 1;
+    attr.log_size = sizeof(log);
+    attr.log_buf = (uintptr_t) log;
+    xdp->prog_fd = sys_bpf(BPF_PROG_LOAD, &attr);
+    if (xdp->prog_fd < 0) {
+        perror("lcm_xdp_open -- BPF_PROG_LOAD");
+        fprintf(stderr, "%s", log);
+        return -1;
+    }
+
+    // in the driver if it supports XDP, and in the generic network stack
+    // otherwise.  The interface drops the program again when the link is
+    // closed.
+    uint32_t modes[] = {0, XDP_FLAGS_SKB_MODE};
+    for (i = 0; i < 2 && xdp->link_fd < 0; i++) {
+        memset(&attr, 0, sizeof(attr));
+        attr.link_create.prog_fd = xdp->prog_fd;
+        attr.link_create.target_ifindex = ifindex;
+        attr.link_create.attach_type = BPF_XDP;
+        attr.link_create.flags = modes[i];
+        xdp->link_fd = sys_bpf(BPF_LINK_CREATE, &attr);
+    }
+    if (xdp->link_fd < 0) {
+        perror("lcm_xdp_open -- BPF_LINK_CREATE");
+        return -1;
+    }
+    return 0;
+}
+
+lcm_xdp_t *lcm_xdp_open(const char *ifname, int queue, struct in_addr mc_addr, uint16_t mc_port)
+{
+    int ifindex = if_nametoindex(ifname);
+    if (!ifindex) {
+        fprintf(stderr, "lcm_xdp_open -- no interface %s\n", ifname);
+        return NULL;
+    }
+
+    lcm_xdp_t *xdp = (lcm_xdp_t *) calloc(1, sizeof(lcm_xdp_t));
+    xdp->map_fd = -1;
+    xdp->prog_fd = -1;
+    xdp->link_fd = -1;
+    xdp->fd = socket(AF_XDP, SOCK_RAW, 0);
+    if (xdp->fd < 0) {
+        perror("lcm_xdp_open -- socket");
+        goto fail;
+    }
+
+    xdp->umem = (char *) mmap(NULL, (size_t) XDP_NUM_FRAMES * XDP_FRAME_SIZE,
+                              PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (xdp->umem == MAP_FAILED) {
+        xdp->umem = NULL;
+        perror("lcm_xdp_open -- mmap");
+        goto fail;
+    }
+
+    struct xdp_umem_reg mr;
+    memset(&mr, 0, sizeof(mr));
+    mr.addr = (uintptr_t) xdp->umem;
+    mr.len = (uint64_t) XDP_NUM_FRAMES * XDP_FRAME_SIZE;
+    mr.chunk_size = XDP_FRAME_SIZE;
+    int ring_size = XDP_NUM_FRAMES;
+    // nothing is sent, but a UMEM needs a completion ring all the same
+    if (setsockopt(xdp->fd, SOL_XDP, XDP_UMEM_REG, &mr, sizeof(mr)) < 0 ||
+        setsockopt(xdp->fd, SOL_XDP, XDP_UMEM_FILL_RING, &ring_size, sizeof(ring_size)) < 0 ||
+        setsockopt(xdp->fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &ring_size, sizeof(ring_size)) <
+            0 ||
+        setsockopt(xdp->fd, SOL_XDP, XDP_RX_RING, &ring_size, sizeof(ring_size)) < 0) {
+        perror("lcm_xdp_open -- setsockopt");
+        goto fail;
+    }
+
+    struct xdp_mmap_offsets off;
+    socklen_t optlen = sizeof(off);
+    if (getsockopt(xdp->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) < 0 ||
+        xdp_map_ring(xdp, &xdp->fill, &off.fr, sizeof(uint64_t), XDP_UMEM_PGOFF_FILL_RING) < 0 ||
+        xdp_map_ring(xdp, &xdp->comp, &off.cr, sizeof(uint64_t),
+                     XDP_UMEM_PGOFF_COMPLETION_RING) < 0 ||
+        xdp_map_ring(xdp, &xdp->rx, &off.rx, sizeof(struct xdp_desc), XDP_PGOFF_RX_RING) < 0) {
+        perror("lcm_xdp_open -- mapping the rings");
+        goto fail;
+    }
+
+    uint64_t *fill = (uint64_t *) xdp->fill.descs;
+    uint32_t i;
+    for (i = 0; i < XDP_NUM_FRAMES; i++)
+        fill[i] = (uint64_t) i * XDP_FRAME_SIZE;
+    __atomic_store_n(xdp->fill.producer, XDP_NUM_FRAMES, __ATOMIC_RELEASE);
+
+    // zero copy if the driver supports it, and copy mode otherwise
+    struct sockaddr_xdp sxdp;
+    memset(&sxdp, 0, sizeof(sxdp));
+    sxdp.sxdp_family = AF_XDP;
+    sxdp.sxdp_ifindex = ifindex;
+    sxdp.sxdp_queue_id = queue;
+    sxdp.sxdp_flags = XDP_USE_NEED_WAKEUP;
+    if (bind(xdp->fd, (struct sockaddr *) &sxdp, sizeof(sxdp)) < 0) {
+        perror("lcm_xdp_open -- bind");
+        goto fail;
+    }
+
+    if (xdp_attach_prog(xdp, ifindex, queue, mc_addr, mc_port) < 0)
+        goto fail;
+    return xdp;
+
+fail:
+    lcm_xdp_close(xdp);
+    return NULL;
+}
+
+void lcm_xdp_close(lcm_xdp_t *xdp)
+{
+    if (xdp->link_fd >= 0)
+        close(xdp->link_fd);
+    if (xdp->prog_fd >= 0)
+        close(xdp->prog_fd);
+    if (xdp->map_fd >= 0)
+        close(xdp->map_fd);
+    xdp_unmap_ring(&xdp->rx);
+    xdp_unmap_ring(&xdp->comp);
+    xdp_unmap_ring(&xdp->fill);
+    if (xdp->fd >= 0)
+        close(xdp->fd);
+    if (xdp->umem)
+        munmap(xdp->umem, (size_t) XDP_NUM_FRAMES * XDP_FRAME_SIZE);
+    free(xdp);
+}
+
+int lcm_xdp_fileno(lcm_xdp_t *xdp)
+{
+    return xdp->fd;
+}
+
+// parses the frame of desc into pkt.  Returns 0 if it is not a whole IPv4
+// UDP datagram, or has no room for the 0 byte after it.
+static int xdp_parse_frame(lcm_xdp_t *xdp, const struct xdp_desc *desc, lcm_xdp_packet_t *pkt)
+{
+    unsigned char *frame = (unsigned char *) xdp->umem + desc->addr;
+    if (desc->len < XDP_HEADERS_SIZE ||
+        desc->addr % XDP_FRAME_SIZE + desc->len >= XDP_FRAME_SIZE)
+        return 0;
+    uint16_t udp_len = (frame[38] << 8) | frame[39];
+    if (udp_len < 8 || 14 + 20 + udp_len > desc->len)
+        return 0;
+
+    pkt->data = (char *) frame + XDP_HEADERS_SIZE;
+    pkt->size = udp_len - 8;
+    pkt->data[pkt->size] = 0;
+    memset(&pkt->from, 0, sizeof(pkt->from));
+    pkt->from.sin_family = AF_INET;
+    memcpy(&pkt->from.sin_addr, frame + 26, 4);
+    memcpy(&pkt->from.sin_port, frame + 34, 2);
+    pkt->addr = desc->addr;
+    return 1;
+}
+
+int lcm_xdp_receive(lcm_xdp_t *xdp, lcm_xdp_packet_t *pkts, int max)
+{
+    uint32_t prod = __atomic_load_n(xdp->rx.producer, __ATOMIC_ACQUIRE);
+    uint32_t cons = *xdp->rx.consumer;
+    const struct xdp_desc *descs = (const struct xdp_desc *) xdp->rx.descs;
+    int n = 0;
+    lcm_xdp_packet_t bad;
+    while (cons != prod && n < max) {
+        const struct xdp_desc *desc = &descs[cons % XDP_NUM_FRAMES];
+        if (xdp_parse_frame(xdp, desc, &pkts[n])) {
+            n++;
+        } else {
+            bad.addr = desc->addr;
+            lcm_xdp_release(xdp, &bad, 1);
+        }
+        cons++;
+    }
+    __atomic_store_n(xdp->rx.consumer, cons, __ATOMIC_RELEASE);
+    return n;
+}
+
+void lcm_xdp_release(lcm_xdp_t *xdp, const lcm_xdp_packet_t *pkts, int n)
+{
+    uint64_t *fill = (uint64_t *) xdp->fill.descs;
+    uint32_t prod = *xdp->fill.producer;
+    int i;
+    for (i = 0; i < n; i++)
+        fill[(prod + i) % XDP_NUM_FRAMES] = pkts[i].addr;
+    __atomic_store_n(xdp->fill.producer, prod + n, __ATOMIC_RELEASE);
+
+    // the kernel stops looking at the fill ring after finding it empty, until
+    // it is woken up
+    if (__atomic_load_n(xdp->fill.flags, __ATOMIC_ACQUIRE) & XDP_RING_NEED_WAKEUP)
+        recvfrom(xdp->fd, NULL, 0, MSG_DONTWAIT, NULL, NULL);
+}
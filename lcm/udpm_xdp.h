@@ -0,0 +1,71 @@
+#ifndef __lcm_udpm_xdp_h__
+#define __lcm_udpm_xdp_h__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include <netinet/in.h>
+
+#include "lcm_export.h"
+
+/*
+ * An AF_XDP socket on one receive queue of a network interface, for the
+ * xdp option of udpm.  An XDP program on the interface redirects the UDP
+ * datagrams to one multicast group and port that arrive on that queue to the
+ * socket, and passes everything else, including IP fragments, on to the
+ * kernel.  The datagrams land in frames of a UMEM area that is shared with
+ * the kernel, and are read from there without being copied.
+ */
+typedef struct _lcm_xdp lcm_xdp_t;
+
+typedef struct _lcm_xdp_packet_t {
+    char *data;  // UDP payload, followed by a 0 byte
+    uint32_t size;
+    struct sockaddr_in from;
+    uint64_t addr;  // of the frame in the UMEM area
+} lcm_xdp_packet_t;
+
+/*
+ * Opens the socket on queue of the interface ifname and attaches the XDP
+ * program for mc_addr and mc_port, in network byte order.  Needs
+ * CAP_NET_ADMIN and CAP_BPF, or root.  Returns NULL, after printing why, if
+ * that is not possible.
+ */
+LCM_NO_EXPORT
+lcm_xdp_t *lcm_xdp_open(const char *ifname, int queue, struct in_addr mc_addr, uint16_t mc_port);
+
+/*
+ * Detaches the XDP program and closes the socket.
+ */
+LCM_NO_EXPORT
+void lcm_xdp_close(lcm_xdp_t *xdp);
+
+/*
+ * The file descriptor that becomes readable when datagrams have arrived.
+ */
+LCM_NO_EXPORT
+int lcm_xdp_fileno(lcm_xdp_t *xdp);
+
+/*
+ * Takes up to max received datagrams off the receive ring, without waiting.
+ * Their frames belong to the caller until they are handed back with
+ * lcm_xdp_release().  Frames that don't hold a whole IPv4 UDP datagram are
+ * handed back right away.  Returns the number of datagrams.
+ */
+LCM_NO_EXPORT
+int lcm_xdp_receive(lcm_xdp_t *xdp, lcm_xdp_packet_t *pkts, int max);
+
+/*
+ * Hands the frames of n datagrams back to the kernel.
+ */
+LCM_NO_EXPORT
+void lcm_xdp_release(lcm_xdp_t *xdp, const lcm_xdp_packet_t *pkts, int n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
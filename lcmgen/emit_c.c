@@ -39,6 +39,7 @@
 
 // flags for emit_c_array_loops_start
 #define FLAG_EMIT_MALLOCS 1
+#define FLAG_EMIT_ARENA_ALLOCS 4
 
 // flags for emit_c_array_loops_end
 #define FLAG_EMIT_FREES 2
@@ -107,7 +108,10 @@ static void emit_type_comment(FILE *f, lcm_member_t *structure_member)
     for (guint dim_num = 0; dim_num < structure_member->dimensions->len; dim_num++) {
         lcm_dimension_t *dim =
             (lcm_dimension_t *) g_ptr_array_index(structure_member->dimensions, dim_num);
-        fprintf(f, "[%s]", dim->size);
+        if (dim->max_size)
+            fprintf(f, "[%s (max %d)]", dim->size, dim->max_size);
+        else
+            fprintf(f, "[%s]", dim->size);
     }
 }
 
@@ -185,6 +189,8 @@ void setup_c_options(getopt_t *gopt)
     getopt_add_string(gopt, 0, "cinclude", "", "Generated #include lines reference this folder");
     getopt_add_bool(gopt, 0, "c-no-pubsub", 0, "Do not generate _publish and _subscribe functions");
     getopt_add_bool(gopt, 0, "c-typeinfo", 0, "Generate typeinfo functions for each type");
+    getopt_add_bool(gopt, 0, "c-registry", 0,
+                    "Generate a registry of the types of each package by fingerprint");
 }
 
 /** Emit output that is common to every header file **/
@@ -233,6 +239,52 @@ static void emit_header_bottom(lcmgen_t *lcm, FILE *f)
     fprintf(f, "#endif\n");
 }
 
+// Returns the size of every encoding of the struct without the fingerprint,
+// if it is emitted as the <TYPE>_ENCODED_SIZE macro, or -1 if the size
+// varies, or the type has a constant called ENCODED_SIZE.
+static int get_constant_encoded_size(lcmgen_t *lcm, lcm_struct_t *structure)
+{
+    if (!g_ptr_array_size(structure->members) || lcm_find_const(structure, "ENCODED_SIZE"))
+        return -1;
+    return lcm_get_fixed_encoded_size(lcm, structure);
+}
+
+// Returns the expression for the fingerprint of structure in its .c file:
+// the <TYPE>_FINGERPRINT macro if it has one, or else the call of
+// __<TYPE>_get_hash().  Free it with g_free().
+static char *get_fingerprint_expr(lcmgen_t *lcm, lcm_struct_t *structure)
+{
+    char *type_name = dots_to_underscores(structure->structname->lctypename);
+    uint64_t fingerprint;
+    char *expr;
+    if (lcm_compute_fingerprint(lcm, structure, &fingerprint) == 0 &&
+        !lcm_find_const(structure, "FINGERPRINT")) {
+        char *tn_upper = g_utf8_strup(type_name, -1);
+        expr = g_strdup_printf("%s_FINGERPRINT", tn_upper);
+        g_free(tn_upper);
+    } else {
+        expr = g_strdup_printf("__%s_get_hash()", type_name);
+    }
+    free(type_name);
+    return expr;
+}
+
+// Returns the encoded size of one element of a member of a type with a
+// constant encoded size.
+static int fixed_member_element_size(lcmgen_t *lcm, lcm_member_t *member)
+{
+    if (lcm_is_primitive_type(member->type->lctypename))
+        return lcm_get_primitive_encoded_size(member->type->lctypename);
+    return lcm_get_fixed_encoded_size(lcm, lcm_find_struct(lcm, member));
+}
+
+// Returns 1 if the elements of an array member are stored in the struct,
+// because it has a constant size or is bounded, rather than allocated.
+static int has_inline_storage(lcm_member_t *member)
+{
+    return lcm_is_constant_size_array(member) || lcm_is_bounded_array(member);
+}
+
 /** Emit header file output specific to a particular type of struct. **/
 static void emit_header_struct(lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
 {
@@ -267,6 +319,27 @@ static void emit_header_struct(lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
         emit(0, "");
     }
 
+    int encoded_size = get_constant_encoded_size(lcm, structure);
+    if (encoded_size >= 0) {
+        emit(0, "/**");
+        emit(0, " * The size of every encoded %s, the value of %s_encoded_size()", type_name,
+             type_name);
+        emit(0, " */");
+        emit(0, "#define %s_ENCODED_SIZE %d", tn_upper, encoded_size + 8);
+        emit(0, "");
+    }
+
+    uint64_t fingerprint;
+    if (lcm_compute_fingerprint(lcm, structure, &fingerprint) == 0 &&
+        !lcm_find_const(structure, "FINGERPRINT")) {
+        emit(0, "/**");
+        emit(0, " * The fingerprint that begins every encoded %s, the value of", type_name);
+        emit(0, " * __%s_get_hash()", type_name);
+        emit(0, " */");
+        emit(0, "#define %s_FINGERPRINT ((int64_t) 0x%016" PRIx64 "ULL)", tn_upper, fingerprint);
+        emit(0, "");
+    }
+
     // define the struct
     emit_comment(f, 0, structure->comment);
     emit(0, "typedef struct _%s %s;", type_name, type_name);
@@ -282,13 +355,16 @@ static void emit_header_struct(lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
         if (ndim == 0) {
             emit(1, "%-10s %s;", map_type_name(member->type->lctypename), member->membername);
         } else {
-            if (lcm_is_constant_size_array(member)) {
+            if (has_inline_storage(member)) {
                 emit_start(1, "%-10s %s", map_type_name(member->type->lctypename),
                            member->membername);
                 for (unsigned int d = 0; d < ndim; d++) {
                     lcm_dimension_t *ld =
                         (lcm_dimension_t *) g_ptr_array_index(member->dimensions, d);
-                    emit_continue("[%s]", ld->size);
+                    if (ld->mode == LCM_VAR)
+                        emit_continue("[%d]", ld->max_size);
+                    else
+                        emit_continue("[%s]", ld->size);
                 }
                 emit_end(";");
             } else {
@@ -367,7 +443,19 @@ static void emit_header_prototypes(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *stru
              type_name);
         emit(0, "");
         emit(0, "/**");
-        emit(0, " * Removes and destroys a subscription created by %s_subscribe()", type_name);
+        emit(0, " * Subscribe to messages of type %s like %s_subscribe(), but decode", type_name,
+             type_name);
+        emit(0, " * every message into the same storage, which grows only to fit a larger");
+        emit(0, " * message than any before, so that handling messages allocates no memory.");
+        emit(0, " * @p handler must not keep the message after it returns.");
+        emit(0, " */");
+        emit(0, "%s%s_subscription_t* %s_subscribe_persistent(", xd_, type_name, type_name);
+        emit(0, "    lcm_t *lcm, const char *channel, %s_handler_t handler, void *userdata);",
+             type_name);
+        emit(0, "");
+        emit(0, "/**");
+        emit(0, " * Removes and destroys a subscription created by %s_subscribe() or", type_name);
+        emit(0, " * %s_subscribe_persistent()", type_name);
         emit(0, " */");
         emit(0, "%sint %s_unsubscribe(lcm_t *lcm, %s_subscription_t* hid);", xd_, type_name,
              type_name);
@@ -424,6 +512,37 @@ static void emit_header_prototypes(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *stru
     emit(0, "%sint %s_decode_cleanup(%s *p);", xd_, type_name, type_name);
     emit(0, "");
     emit(0, "/**");
+    emit(0, " * Decode a message of type %s like %s_decode(), but allocate its", type_name,
+         type_name);
+    emit(0, " * strings and variable-length arrays from @p arena instead of with malloc().");
+    emit(0, " * The message is valid as long as the arena memory is, and must not be passed");
+    emit(0, " * to %s_decode_cleanup().  Use %s_decode_arena_size() to allocate", type_name,
+         type_name);
+    emit(0, " * the arena memory as one block, which releases the message with one free().");
+    emit(0, " *");
+    emit(0, " * @param buf The buffer containing the encoded message");
+    emit(0, " * @param offset The byte offset into @p buf where the encoded message starts.");
+    emit(0, " * @param maxlen The maximum number of bytes to read while decoding.");
+    emit(0, " * @param msg Output parameter where the decoded message is stored");
+    emit(0, " * @param arena The arena to allocate from.");
+    emit(0, " * @return The number of bytes decoded, or <0 if an error occured or the arena");
+    emit(0, " * hasn't enough space.");
+    emit(0, " */");
+    emit(0, "%sint %s_decode_arena(const void *buf, int offset, int maxlen, %s *msg,", xd_,
+         type_name, type_name);
+    emit(0, "    lcm_arena_t *arena);");
+    emit(0, "");
+    emit(0, "/**");
+    emit(0, " * Compute the arena space that %s_decode_arena() needs to decode a", type_name);
+    emit(0, " * message, without decoding it.");
+    emit(0, " *");
+    emit(0, " * @param size Output parameter where the number of bytes is stored");
+    emit(0, " * @return The number of bytes that decoding reads, or <0 if an error occured.");
+    emit(0, " */");
+    emit(0, "%sint %s_decode_arena_size(const void *buf, int offset, int maxlen, size_t *size);",
+         xd_, type_name);
+    emit(0, "");
+    emit(0, "/**");
     emit(0, " * Check how many bytes are required to encode a message of type %s", type_name);
     emit(0, " */");
     emit(0, "%sint %s_encoded_size(const %s *p);", xd_, type_name, type_name);
@@ -444,6 +563,12 @@ static void emit_header_prototypes(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *stru
     emit(0, "%sint __%s_decode_array(", xd_, type_name);
     emit(0, "    const void *buf, int offset, int maxlen, %s *p, int elements);", type_name);
     emit(0, "%sint __%s_decode_array_cleanup(%s *p, int elements);", xd_, type_name, type_name);
+    emit(0, "%sint __%s_decode_array_arena(const void *buf, int offset, int maxlen, %s *p,", xd_,
+         type_name, type_name);
+    emit(0, "    int elements, lcm_arena_t *arena);");
+    emit(0, "%sint __%s_decode_array_arena_size(const void *buf, int offset, int maxlen,", xd_,
+         type_name);
+    emit(0, "    int elements, size_t *size);");
     emit(0, "%sint __%s_encoded_array_size(const %s *p, int elements);", xd_, type_name, type_name);
     emit(0, "%sint __%s_clone_array(const %s *p, %s *q, int elements);", xd_, type_name, type_name,
          type_name);
@@ -453,10 +578,16 @@ static void emit_header_prototypes(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *stru
 static void emit_c_struct_get_hash(lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
 {
     char *type_name = dots_to_underscores(structure->structname->lctypename);
-
-    emit(0, "static int __%s_hash_computed;", type_name);
-    emit(0, "static uint64_t __%s_hash;", type_name);
-    emit(0, "");
+    uint64_t fingerprint;
+    int constant = lcm_compute_fingerprint(lcm, structure, &fingerprint) == 0;
+
+    if (!constant) {
+        // the fingerprints of member types from other runs of lcm-gen are
+        // only known at run time
+        emit(0, "static int __%s_hash_computed;", type_name);
+        emit(0, "static uint64_t __%s_hash;", type_name);
+        emit(0, "");
+    }
 
     // clang-format off
     emit(0, "uint64_t __%s_hash_recursive(const __lcm_hash_ptr *p)", type_name);
@@ -487,6 +618,15 @@ static void emit_c_struct_get_hash(lcmgen_t *lcm, FILE *f, lcm_struct_t *structu
     emit(0, "}");
     emit(0, "");
 
+    if (constant) {
+        emit(0, "int64_t __%s_get_hash(void)", type_name);
+        emit(0, "{");
+        emit(1, "return (int64_t) 0x%016" PRIx64 "ULL;", fingerprint);
+        emit(0, "}");
+        emit(0, "");
+        return;
+    }
+
     emit(0, "int64_t __%s_get_hash(void)", type_name);
     emit(0, "{");
     emit(1,     "if (!__%s_hash_computed) {", type_name);
@@ -535,6 +675,36 @@ static char *make_array_size(lcm_member_t *member, const char *n, int dim)
     return NULL;
 }
 
+// Emits the check that the lengths of a bounded array member fit into its
+// storage, before it is encoded or decoded.  prefix is what the length
+// members are accessed with.  Negative lengths are converted to large ones.
+static void emit_c_bounded_dims_check(FILE *f, int indent, lcm_member_t *member,
+                                      const char *prefix)
+{
+    if (!lcm_is_bounded_array(member))
+        return;
+    for (unsigned int d = 0; d < g_ptr_array_size(member->dimensions); d++) {
+        lcm_dimension_t *ld = (lcm_dimension_t *) g_ptr_array_index(member->dimensions, d);
+        if (ld->mode == LCM_VAR)
+            emit(indent, "if ((uint64_t) %s%s > %d) return -1;", prefix, ld->size, ld->max_size);
+    }
+}
+
+// Emits the allocation of the array at accessor, of count elements of the
+// type with the stars, with lcm_malloc() or from the arena.
+static void emit_c_array_alloc(FILE *f, int indent, int flags, const char *accessor,
+                               const char *type, const char *stars, const char *count)
+{
+    if (flags & FLAG_EMIT_MALLOCS) {
+        emit(indent, "%s = (%s%s*) lcm_malloc(sizeof(%s%s) * %s);", accessor, type, stars, type,
+             stars, count);
+    } else if (flags & FLAG_EMIT_ARENA_ALLOCS) {
+        emit(indent, "%s = (%s%s*) __lcm_arena_alloc_array(arena, sizeof(%s%s), %s);", accessor,
+             type, stars, type, stars, count);
+        emit(indent, "if (!%s && %s > 0) return -1;", accessor, count);
+    }
+}
+
 static void emit_c_array_loops_start(lcmgen_t *lcm, FILE *f, lcm_member_t *member, const char *n,
                                      int flags)
 {
@@ -544,30 +714,24 @@ static void emit_c_array_loops_start(lcmgen_t *lcm, FILE *f, lcm_member_t *membe
     for (unsigned int i = 0; i < g_ptr_array_size(member->dimensions) - 1; i++) {
         char var = 'a' + i;
 
-        if (flags & FLAG_EMIT_MALLOCS) {
-            char stars[1000];
-            for (unsigned int s = 0; s < g_ptr_array_size(member->dimensions) - 1 - i; s++) {
-                stars[s] = '*';
-                stars[s + 1] = 0;
-            }
-
-            emit(2 + i, "%s = (%s%s*) lcm_malloc(sizeof(%s%s) * %s);", make_accessor(member, n, i),
-                 map_type_name(member->type->lctypename), stars,
-                 map_type_name(member->type->lctypename), stars, make_array_size(member, n, i));
+        char stars[1000] = "";
+        for (unsigned int s = 0; s < g_ptr_array_size(member->dimensions) - 1 - i; s++) {
+            stars[s] = '*';
+            stars[s + 1] = 0;
         }
+        emit_c_array_alloc(f, 2 + i, flags, make_accessor(member, n, i),
+                           map_type_name(member->type->lctypename), stars,
+                           make_array_size(member, n, i));
 
         emit(2 + i, "{ int %c;", var);
         emit(2 + i, "for (%c = 0; %c < %s; %c++) {", var, var, make_array_size(member, "p", i),
              var);
     }
 
-    if (flags & FLAG_EMIT_MALLOCS) {
-        emit(2 + g_ptr_array_size(member->dimensions) - 1,
-             "%s = (%s*) lcm_malloc(sizeof(%s) * %s);",
-             make_accessor(member, n, g_ptr_array_size(member->dimensions) - 1),
-             map_type_name(member->type->lctypename), map_type_name(member->type->lctypename),
-             make_array_size(member, n, g_ptr_array_size(member->dimensions) - 1));
-    }
+    int last_dim = g_ptr_array_size(member->dimensions) - 1;
+    emit_c_array_alloc(f, 2 + last_dim, flags, make_accessor(member, n, last_dim),
+                       map_type_name(member->type->lctypename), "",
+                       make_array_size(member, n, last_dim));
 }
 
 static void emit_c_array_loops_end(lcmgen_t *lcm, FILE *f, lcm_member_t *member, const char *n,
@@ -593,6 +757,39 @@ static void emit_c_array_loops_end(lcmgen_t *lcm, FILE *f, lcm_member_t *member,
     }
 }
 
+// Emits the body of the encode or decode array function of a type with a
+// constant encoded size.  The bounds are checked once per element, so every
+// member is passed the exact buffer length that it needs.
+static void emit_c_fixed_array(lcmgen_t *lcm, FILE *f, lcm_struct_t *structure, int encoded_size,
+                               const char *op)
+{
+    emit(1, "int pos = 0, element;");
+    emit(0, "");
+    emit(1, "for (element = 0; element < elements; element++) {");
+    emit(2, "if (maxlen - pos < %d) return -1;", encoded_size);
+    emit(0, "");
+    for (unsigned int m = 0; m < g_ptr_array_size(structure->members); m++) {
+        lcm_member_t *member = (lcm_member_t *) g_ptr_array_index(structure->members, m);
+
+        emit_c_array_loops_start(lcm, f, member, "p", FLAG_NONE);
+
+        int last_dim = imax(0, g_ptr_array_size(member->dimensions) - 1);
+        char *count = make_array_size(member, "p", last_dim);
+        int indent = 2 + last_dim;
+        emit(indent, "pos += __%s_%s_array(buf, offset + pos, %ld, %s, %s);",
+             dots_to_underscores(member->type->lctypename), op,
+             fixed_member_element_size(lcm, member) * strtol(count, NULL, 0),
+             make_accessor(member, "p", last_dim), count);
+
+        emit_c_array_loops_end(lcm, f, member, "p", FLAG_NONE);
+        emit(0, "");
+    }
+    emit(1, "}");
+    emit(1, "return pos;");
+    emit(0, "}");
+    emit(0, "");
+}
+
 static void emit_c_encode_array(lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
 {
     char *type_name = dots_to_underscores(structure->structname->lctypename);
@@ -600,6 +797,11 @@ static void emit_c_encode_array(lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
     emit(0, "int __%s_encode_array(void *buf, int offset, int maxlen, const %s *p, int elements)",
          type_name, type_name);
     emit(0, "{");
+    int encoded_size = get_constant_encoded_size(lcm, structure);
+    if (encoded_size >= 0) {
+        emit_c_fixed_array(lcm, f, structure, encoded_size, "encode");
+        return;
+    }
     emit(1, "int pos = 0, element;");
     if (g_ptr_array_size(structure->members) > 0) {
         emit(1, "int thislen;");
@@ -611,6 +813,7 @@ static void emit_c_encode_array(lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
     for (unsigned int m = 0; m < g_ptr_array_size(structure->members); m++) {
         lcm_member_t *member = (lcm_member_t *) g_ptr_array_index(structure->members, m);
 
+        emit_c_bounded_dims_check(f, 2, member, "p[element].");
         emit_c_array_loops_start(lcm, f, member, "p", FLAG_NONE);
 
         int indent = 2 + imax(0, g_ptr_array_size(member->dimensions) - 1);
@@ -632,12 +835,13 @@ static void emit_c_encode_array(lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
 static void emit_c_encode(lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
 {
     char *type_name = dots_to_underscores(structure->structname->lctypename);
+    char *hash = get_fingerprint_expr(lcm, structure);
 
     // clang-format off
     emit(0, "int %s_encode(void *buf, int offset, int maxlen, const %s *p)", type_name, type_name);
     emit(0, "{");
     emit(1,     "int pos = 0, thislen;");
-    emit(1,     "int64_t hash = __%s_get_hash();", type_name);
+    emit(1,     "int64_t hash = %s;", hash);
     emit(0, "");
     emit(1,     "thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &hash, 1);");
     emit(1,     "if (thislen < 0) return thislen; else pos += thislen;");
@@ -649,6 +853,7 @@ static void emit_c_encode(lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
     emit(0, "}");
     emit(0, "");
     // clang-format on
+    g_free(hash);
 }
 
 static void emit_c_decode_array(lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
@@ -658,6 +863,11 @@ static void emit_c_decode_array(lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
     emit(0, "int __%s_decode_array(const void *buf, int offset, int maxlen, %s *p, int elements)",
          type_name, type_name);
     emit(0, "{");
+    int encoded_size = get_constant_encoded_size(lcm, structure);
+    if (encoded_size >= 0) {
+        emit_c_fixed_array(lcm, f, structure, encoded_size, "decode");
+        return;
+    }
     if (g_ptr_array_size(structure->members) > 0) {
         emit(1, "int pos = 0, thislen, element;");
     } else {
@@ -669,9 +879,10 @@ static void emit_c_decode_array(lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
     for (unsigned int m = 0; m < g_ptr_array_size(structure->members); m++) {
         lcm_member_t *member = (lcm_member_t *) g_ptr_array_index(structure->members, m);
 
+        emit_c_bounded_dims_check(f, 2, member, "p[element].");
         emit_c_array_loops_start(
             lcm, f, member, "p",
-            lcm_is_constant_size_array(member) ? FLAG_NONE : FLAG_EMIT_MALLOCS);
+            has_inline_storage(member) ? FLAG_NONE : FLAG_EMIT_MALLOCS);
 
         int indent = 2 + imax(0, g_ptr_array_size(member->dimensions) - 1);
         emit(indent, "thislen = __%s_decode_array(buf, offset + pos, maxlen - pos, %s, %s);",
@@ -711,7 +922,7 @@ static void emit_c_decode_array_cleanup(lcmgen_t *lcm, FILE *f, lcm_struct_t *st
              make_array_size(member, "p", g_ptr_array_size(member->dimensions) - 1));
 
         emit_c_array_loops_end(lcm, f, member, "p",
-                               lcm_is_constant_size_array(member) ? FLAG_NONE : FLAG_EMIT_FREES);
+                               has_inline_storage(member) ? FLAG_NONE : FLAG_EMIT_FREES);
         emit(0, "");
     }
     emit(1, "}");
@@ -723,12 +934,13 @@ static void emit_c_decode_array_cleanup(lcmgen_t *lcm, FILE *f, lcm_struct_t *st
 static void emit_c_decode(lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
 {
     char *type_name = dots_to_underscores(structure->structname->lctypename);
+    char *hash = get_fingerprint_expr(lcm, structure);
 
     // clang-format off
     emit(0, "int %s_decode(const void *buf, int offset, int maxlen, %s *p)", type_name, type_name);
     emit(0, "{");
     emit(1,     "int pos = 0, thislen;");
-    emit(1,     "int64_t hash = __%s_get_hash();", type_name);
+    emit(1,     "int64_t hash = %s;", hash);
     emit(0, "");
     emit(1,     "int64_t this_hash;");
     emit(1,     "thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &this_hash, 1);");
@@ -742,6 +954,234 @@ static void emit_c_decode(lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
     emit(0, "}");
     emit(0, "");
     // clang-format on
+    g_free(hash);
+}
+
+// Emits the call that decodes count elements of a member from the arena, or
+// that adds the arena space that they need to *size.
+static void emit_c_arena_member_call(lcmgen_t *lcm, FILE *f, int indent, lcm_member_t *member,
+                                     const char *accessor, const char *count, int sizing)
+{
+    const char *type = member->type->lctypename;
+    if (!lcm_is_primitive_type(type) || !strcmp(type, "string")) {
+        if (sizing) {
+            emit(indent,
+                 "thislen = __%s_decode_array_arena_size(buf, offset + pos, maxlen - pos, %s, "
+                 "size);",
+                 dots_to_underscores(type), count);
+        } else {
+            emit(indent,
+                 "thislen = __%s_decode_array_arena(buf, offset + pos, maxlen - pos, %s, %s, "
+                 "arena);",
+                 dots_to_underscores(type), accessor, count);
+        }
+    } else if (sizing) {
+        emit(indent, "thislen = __lcm_skip_array(maxlen - pos, %d, %s);",
+             lcm_get_primitive_encoded_size(type), count);
+    } else {
+        emit(indent, "thislen = __%s_decode_array(buf, offset + pos, maxlen - pos, %s, %s);", type,
+             accessor, count);
+    }
+    emit(indent, "if (thislen < 0) return thislen; else pos += thislen;");
+}
+
+static void emit_c_decode_array_arena(lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
+{
+    char *type_name = dots_to_underscores(structure->structname->lctypename);
+
+    emit(0, "int __%s_decode_array_arena(const void *buf, int offset, int maxlen, %s *p,",
+         type_name, type_name);
+    emit(0, "    int elements, lcm_arena_t *arena)");
+    emit(0, "{");
+    if (get_constant_encoded_size(lcm, structure) >= 0) {
+        emit(1, "(void) arena;");
+        emit(1, "return __%s_decode_array(buf, offset, maxlen, p, elements);", type_name);
+        emit(0, "}");
+        emit(0, "");
+        return;
+    }
+    emit(1, "(void) arena;");
+    if (g_ptr_array_size(structure->members) > 0) {
+        emit(1, "int pos = 0, thislen, element;");
+    } else {
+        emit(1, "int pos = 0, element;");
+    }
+    emit(0, "");
+    emit(1, "for (element = 0; element < elements; element++) {");
+    emit(0, "");
+    for (unsigned int m = 0; m < g_ptr_array_size(structure->members); m++) {
+        lcm_member_t *member = (lcm_member_t *) g_ptr_array_index(structure->members, m);
+
+        emit_c_bounded_dims_check(f, 2, member, "p[element].");
+        emit_c_array_loops_start(
+            lcm, f, member, "p",
+            has_inline_storage(member) ? FLAG_NONE : FLAG_EMIT_ARENA_ALLOCS);
+
+        int last_dim = imax(0, g_ptr_array_size(member->dimensions) - 1);
+        emit_c_arena_member_call(lcm, f, 2 + last_dim, member,
+                                 make_accessor(member, "p", last_dim),
+                                 make_array_size(member, "p", last_dim), 0);
+
+        emit_c_array_loops_end(lcm, f, member, "p", FLAG_NONE);
+        emit(0, "");
+    }
+    emit(1, "}");
+    emit(1, "return pos;");
+    emit(0, "}");
+    emit(0, "");
+}
+
+// Returns the length of the dim'th dimension of a member, for
+// __<TYPE>_decode_array_arena_size(), which keeps the decoded lengths in
+// variables named after the members.
+static char *make_arena_size_dim(lcm_member_t *member, int dim)
+{
+    if (g_ptr_array_size(member->dimensions) == 0)
+        return g_strdup_printf("1");
+    lcm_dimension_t *ld = (lcm_dimension_t *) g_ptr_array_index(member->dimensions, dim);
+    if (ld->mode == LCM_CONST)
+        return g_strdup_printf("%s", ld->size);
+    return g_strdup_printf("__%s", ld->size);
+}
+
+static void emit_c_decode_array_arena_size(lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
+{
+    char *type_name = dots_to_underscores(structure->structname->lctypename);
+
+    emit(0, "int __%s_decode_array_arena_size(const void *buf, int offset, int maxlen,",
+         type_name);
+    emit(0, "    int elements, size_t *size)");
+    emit(0, "{");
+    int encoded_size = get_constant_encoded_size(lcm, structure);
+    if (encoded_size >= 0) {
+        emit(1, "(void) buf;");
+        emit(1, "(void) offset;");
+        emit(1, "(void) size;");
+        emit(1, "return __lcm_skip_array(maxlen, %d, elements);", encoded_size);
+        emit(0, "}");
+        emit(0, "");
+        return;
+    }
+    emit(1, "(void) size;");
+    if (g_ptr_array_size(structure->members) > 0) {
+        emit(1, "int pos = 0, thislen, element;");
+    } else {
+        emit(1, "int pos = 0, element;");
+    }
+    emit(0, "");
+    emit(1, "for (element = 0; element < elements; element++) {");
+    for (unsigned int m = 0; m < g_ptr_array_size(structure->members); m++) {
+        lcm_member_t *member = (lcm_member_t *) g_ptr_array_index(structure->members, m);
+        if (lcm_is_dimension_member(structure, member)) {
+            emit(2, "%s __%s;", map_type_name(member->type->lctypename), member->membername);
+        }
+    }
+    emit(0, "");
+    for (unsigned int m = 0; m < g_ptr_array_size(structure->members); m++) {
+        lcm_member_t *member = (lcm_member_t *) g_ptr_array_index(structure->members, m);
+
+        // decode the array lengths, and skip what takes no space in the arena
+        if (lcm_is_dimension_member(structure, member)) {
+            emit(2, "thislen = __%s_decode_array(buf, offset + pos, maxlen - pos, &__%s, 1);",
+                 member->type->lctypename, member->membername);
+            emit(2, "if (thislen < 0) return thislen; else pos += thislen;");
+            emit(0, "");
+            continue;
+        }
+        int member_size = lcm_get_fixed_member_encoded_size(lcm, member);
+        if (member_size >= 0) {
+            emit(2, "thislen = __lcm_skip_array(maxlen - pos, %d, 1);", member_size);
+            emit(2, "if (thislen < 0) return thislen; else pos += thislen;");
+            emit(0, "");
+            continue;
+        }
+
+        // add the same allocations as __<TYPE>_decode_array_arena()
+        emit_c_bounded_dims_check(f, 2, member, "__");
+        int ndim = g_ptr_array_size(member->dimensions);
+        int dynamic = !has_inline_storage(member);
+        const char *type = map_type_name(member->type->lctypename);
+        for (int i = 0; i < ndim; i++) {
+            char stars[1000] = "";
+            for (int s = 0; s < ndim - 1 - i; s++) {
+                stars[s] = '*';
+                stars[s + 1] = 0;
+            }
+            if (dynamic) {
+                emit(2 + i, "if (__lcm_arena_add_array(size, sizeof(%s%s), %s)) return -1;", type,
+                     stars, make_arena_size_dim(member, i));
+            }
+            if (i < ndim - 1) {
+                char var = 'a' + i;
+                emit(2 + i, "{ int %c;", var);
+                emit(2 + i, "for (%c = 0; %c < %s; %c++) {", var, var,
+                     make_arena_size_dim(member, i), var);
+            }
+        }
+
+        int last_dim = imax(0, ndim - 1);
+        emit_c_arena_member_call(lcm, f, 2 + last_dim, member, NULL,
+                                 make_arena_size_dim(member, last_dim), 1);
+
+        for (int i = ndim - 2; i >= 0; i--) {
+            emit(2 + i, "}");
+            emit(2 + i, "}");
+        }
+        emit(0, "");
+    }
+    emit(1, "}");
+    emit(1, "return pos;");
+    emit(0, "}");
+    emit(0, "");
+}
+
+static void emit_c_decode_arena(lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
+{
+    char *type_name = dots_to_underscores(structure->structname->lctypename);
+    char *hash = get_fingerprint_expr(lcm, structure);
+
+    // clang-format off
+    emit(0, "int %s_decode_arena(const void *buf, int offset, int maxlen, %s *p,", type_name,
+         type_name);
+    emit(0, "    lcm_arena_t *arena)");
+    emit(0, "{");
+    emit(1,     "int pos = 0, thislen;");
+    emit(1,     "int64_t hash = %s;", hash);
+    emit(0, "");
+    emit(1,     "int64_t this_hash;");
+    emit(1,     "thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &this_hash, 1);");
+    emit(1,     "if (thislen < 0) return thislen; else pos += thislen;");
+    emit(1,     "if (this_hash != hash) return -1;");
+    emit(0, "");
+    emit(1,     "thislen = __%s_decode_array_arena(buf, offset + pos, maxlen - pos, p, 1, arena);",
+         type_name);
+    emit(1,     "if (thislen < 0) return thislen; else pos += thislen;");
+    emit(0, "");
+    emit(1, "return pos;");
+    emit(0, "}");
+    emit(0, "");
+
+    emit(0, "int %s_decode_arena_size(const void *buf, int offset, int maxlen, size_t *size)",
+         type_name);
+    emit(0, "{");
+    emit(1,     "int pos = 0, thislen;");
+    emit(1,     "int64_t hash = %s;", hash);
+    emit(0, "");
+    emit(1,     "int64_t this_hash;");
+    emit(1,     "thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &this_hash, 1);");
+    emit(1,     "if (thislen < 0) return thislen; else pos += thislen;");
+    emit(1,     "if (this_hash != hash) return -1;");
+    emit(0, "");
+    emit(1,     "*size = 0;");
+    emit(1,     "thislen = __%s_decode_array_arena_size(buf, offset + pos, maxlen - pos, 1, size);",
+         type_name);
+    emit(1,     "if (thislen < 0) return thislen; else pos += thislen;");
+    emit(0, "");
+    emit(1, "return pos;");
+    emit(0, "}");
+    emit(0, "");
+    // clang-format on
+    g_free(hash);
 }
 
 static void emit_c_decode_cleanup(lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
@@ -763,6 +1203,14 @@ static void emit_c_encoded_array_size(lcmgen_t *lcm, FILE *f, lcm_struct_t *stru
 
     emit(0, "int __%s_encoded_array_size(const %s *p, int elements)", type_name, type_name);
     emit(0, "{");
+    int encoded_size = get_constant_encoded_size(lcm, structure);
+    if (encoded_size >= 0) {
+        emit(1, "(void)p;");
+        emit(1, "return %d * elements;", encoded_size);
+        emit(0, "}");
+        emit(0, "");
+        return;
+    }
     emit(1, "int size = 0, element;");
     emit(1, "for (element = 0; element < elements; element++) {");
     emit(0, "");
@@ -934,7 +1382,7 @@ static void emit_c_clone_array(lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
 
         emit_c_array_loops_start(
             lcm, f, member, "q",
-            lcm_is_constant_size_array(member) ? FLAG_NONE : FLAG_EMIT_MALLOCS);
+            has_inline_storage(member) ? FLAG_NONE : FLAG_EMIT_MALLOCS);
 
         int indent = 2 + imax(0, g_ptr_array_size(member->dimensions) - 1);
         emit(indent, "__%s_clone_array(%s, %s, %s);", dots_to_underscores(member->type->lctypename),
@@ -986,16 +1434,14 @@ static void emit_c_struct_publish(lcmgen_t *lcm, FILE *f, lcm_struct_t *structur
             "int %s_publish(lcm_t *lc, const char *channel, const %s *p)\n"
             "{\n"
             "      int max_data_size = %s_encoded_size (p);\n"
-            "      uint8_t *buf = (uint8_t*) malloc (max_data_size);\n"
+            "      void *buf = lcm_publish_reserve (lc, channel, max_data_size);\n"
             "      if (!buf) return -1;\n"
             "      int data_size = %s_encode (buf, 0, max_data_size, p);\n"
             "      if (data_size < 0) {\n"
-            "          free (buf);\n"
+            "          lcm_publish_cancel (lc, buf);\n"
             "          return data_size;\n"
             "      }\n"
-            "      int status = lcm_publish (lc, channel, buf, data_size);\n"
-            "      free (buf);\n"
-            "      return status;\n"
+            "      return lcm_publish_commit (lc, buf, data_size);\n"
             "}\n\n",
             type_name, type_name, type_name, type_name);
 }
@@ -1009,6 +1455,9 @@ static void emit_c_struct_subscribe(lcmgen_t *lcm, FILE *f, lcm_struct_t *struct
             "    %s_handler_t user_handler;\n"
             "    void *userdata;\n"
             "    lcm_subscription_t *lc_h;\n"
+            "    // the message and its arena, for a persistent subscription\n"
+            "    void *storage;\n"
+            "    size_t storage_size;\n"
             "};\n",
             type_name, type_name);
     fprintf(f,
@@ -1033,16 +1482,67 @@ static void emit_c_struct_subscribe(lcmgen_t *lcm, FILE *f, lcm_struct_t *struct
             type_name, type_name, type_name, type_name, type_name, type_name, type_name, type_name);
 
     fprintf(f,
-            "%s_subscription_t* %s_subscribe (lcm_t *lcm,\n"
+            "static\n"
+            "void %s_persistent_handler_stub (const lcm_recv_buf_t *rbuf,\n"
+            "                            const char *channel, void *userdata)\n"
+            "{\n"
+            "    %s_subscription_t *h = (%s_subscription_t*) userdata;\n"
+            "    size_t offset = __lcm_arena_aligned_size(sizeof(%s));\n"
+            "    lcm_arena_t arena;\n"
+            "    int status = -1;\n"
+            "    if (h->storage) {\n"
+            "        lcm_arena_init(&arena, (char*) h->storage + offset,\n"
+            "                       h->storage_size - offset);\n"
+            "        status = %s_decode_arena (rbuf->data, 0, rbuf->data_size,\n"
+            "                                  (%s*) h->storage, &arena);\n"
+            "    }\n"
+            "    if (status < 0) {\n"
+            "        // grow the storage, if that's why the message didn't decode\n"
+            "        size_t size;\n"
+            "        status = %s_decode_arena_size (rbuf->data, 0, rbuf->data_size, &size);\n"
+            "        if (status >= 0 && offset + size > h->storage_size) {\n"
+            "            size_t storage_size = h->storage_size * 2;\n"
+            "            if (storage_size < offset + size)\n"
+            "                storage_size = offset + size;\n"
+            "            void *storage = realloc (h->storage, storage_size);\n"
+            "            if (storage) {\n"
+            "                h->storage = storage;\n"
+            "                h->storage_size = storage_size;\n"
+            "            } else {\n"
+            "                status = -1;\n"
+            "            }\n"
+            "        }\n"
+            "        if (status >= 0) {\n"
+            "            lcm_arena_init(&arena, (char*) h->storage + offset,\n"
+            "                           h->storage_size - offset);\n"
+            "            status = %s_decode_arena (rbuf->data, 0, rbuf->data_size,\n"
+            "                                      (%s*) h->storage, &arena);\n"
+            "        }\n"
+            "    }\n"
+            "    if (status < 0) {\n"
+            "        fprintf (stderr, \"error %%d decoding %s!!!\\n\", status);\n"
+            "        return;\n"
+            "    }\n"
+            "\n"
+            "    h->user_handler (rbuf, channel, (%s*) h->storage, h->userdata);\n"
+            "}\n\n",
+            type_name, type_name, type_name, type_name, type_name, type_name, type_name,
+            type_name, type_name, type_name, type_name);
+
+    fprintf(f,
+            "static %s_subscription_t* __%s_subscribe (lcm_t *lcm,\n"
             "                    const char *channel,\n"
-            "                    %s_handler_t f, void *userdata)\n"
+            "                    %s_handler_t f, void *userdata,\n"
+            "                    lcm_msg_handler_t stub)\n"
             "{\n"
             "    %s_subscription_t *n = (%s_subscription_t*)\n"
             "                       malloc(sizeof(%s_subscription_t));\n"
             "    n->user_handler = f;\n"
             "    n->userdata = userdata;\n"
+            "    n->storage = NULL;\n"
+            "    n->storage_size = 0;\n"
             "    n->lc_h = lcm_subscribe (lcm, channel,\n"
-            "                                 %s_handler_stub, n);\n"
+            "                                 stub, n);\n"
             "    if (n->lc_h == NULL) {\n"
             "        fprintf (stderr,\"couldn't reg %s LCM handler!\\n\");\n"
             "        free (n);\n"
@@ -1050,7 +1550,26 @@ static void emit_c_struct_subscribe(lcmgen_t *lcm, FILE *f, lcm_struct_t *struct
             "    }\n"
             "    return n;\n"
             "}\n\n",
-            type_name, type_name, type_name, type_name, type_name, type_name, type_name, type_name);
+            type_name, type_name, type_name, type_name, type_name, type_name, type_name);
+
+    fprintf(f,
+            "%s_subscription_t* %s_subscribe (lcm_t *lcm,\n"
+            "                    const char *channel,\n"
+            "                    %s_handler_t f, void *userdata)\n"
+            "{\n"
+            "    return __%s_subscribe (lcm, channel, f, userdata, %s_handler_stub);\n"
+            "}\n\n",
+            type_name, type_name, type_name, type_name, type_name);
+
+    fprintf(f,
+            "%s_subscription_t* %s_subscribe_persistent (lcm_t *lcm,\n"
+            "                    const char *channel,\n"
+            "                    %s_handler_t f, void *userdata)\n"
+            "{\n"
+            "    return __%s_subscribe (lcm, channel, f, userdata,\n"
+            "                           %s_persistent_handler_stub);\n"
+            "}\n\n",
+            type_name, type_name, type_name, type_name, type_name);
 
     fprintf(f,
             "int %s_subscription_set_queue_capacity (%s_subscription_t* subs,\n"
@@ -1069,6 +1588,7 @@ static void emit_c_struct_subscribe(lcmgen_t *lcm, FILE *f, lcm_struct_t *struct
             "           \"couldn't unsubscribe %s_handler %%p!\\n\", (void*)hid);\n"
             "        return -1;\n"
             "    }\n"
+            "    free (hid->storage);\n"
             "    free (hid);\n"
             "    return 0;\n"
             "}\n\n",
@@ -1086,7 +1606,7 @@ int emit_enum(lcmgen_t *lcmgen, lcm_enum_t *enumeration)
 
     // ENUM header file
     if (lcm_needs_generation(lcmgen, enumeration->lcmfile, header_name)) {
-        FILE *f = fopen(header_name, "w");
+        FILE *f = lcm_fopen_output(lcmgen, header_name);
         if (f == NULL)
             return -1;
 
@@ -1207,6 +1727,24 @@ int emit_enum(lcmgen_t *lcmgen, lcm_enum_t *enumeration)
         emit(0,"}");
         emit(0,"");
 
+        emit(0, "static inline int __%s_decode_array_arena(const void *_buf, int offset,", type_name);
+        emit(0, "    int maxlen, %s *p, int elements, lcm_arena_t *arena)", type_name);
+        emit(0, "{");
+        emit(1,     "(void) arena;");
+        emit(1,     "return __%s_decode_array(_buf, offset, maxlen, p, elements);", type_name);
+        emit(0, "}");
+        emit(0, "");
+
+        emit(0, "static inline int __%s_decode_array_arena_size(const void *_buf, int offset,", type_name);
+        emit(0, "    int maxlen, int elements, size_t *size)");
+        emit(0, "{");
+        emit(1,     "(void) _buf;");
+        emit(1,     "(void) offset;");
+        emit(1,     "(void) size;");
+        emit(1,     "return __lcm_skip_array(maxlen, 4, elements);");
+        emit(0, "}");
+        emit(0, "");
+
         emit(0, "static inline int __%s_decode_array_cleanup(%s *in, int elements)", type_name, type_name);
         emit(0, "{");
         emit(1,     "return 0;");
@@ -1233,14 +1771,14 @@ int emit_enum(lcmgen_t *lcmgen, lcm_enum_t *enumeration)
         // clang-format on
 
         emit_header_bottom(lcmgen, f);
-        fclose(f);
+        lcm_fclose_output(lcmgen, f);
     }
 
     // ENUM C file
     if (lcm_needs_generation(lcmgen, enumeration->lcmfile, c_name)) {
         char *tn_upper = g_ascii_strup(type_name, strlen(type_name));
 
-        FILE *f = fopen(c_name, "w");
+        FILE *f = lcm_fopen_output(lcmgen, c_name);
         emit_auto_generated_warning(f);
 
         fprintf(f, "#include \"%s%s%s.h\"\n", getopt_get_string(lcmgen->gopt, "cinclude"),
@@ -1259,7 +1797,7 @@ int emit_enum(lcmgen_t *lcmgen, lcm_enum_t *enumeration)
         emit(3, "return NULL;");
         emit(1, "}");
         emit(0, "}");
-        fclose(f);
+        lcm_fclose_output(lcmgen, f);
 
         free(tn_upper);
     }
@@ -1277,7 +1815,7 @@ int emit_struct(lcmgen_t *lcmgen, lcm_struct_t *structure)
         g_strdup_printf("%s/%s.c", getopt_get_string(lcmgen->gopt, "c-cpath"), type_name);
 
     if (lcm_needs_generation(lcmgen, structure->lcmfile, header_name)) {
-        FILE *f = fopen(header_name, "w");
+        FILE *f = lcm_fopen_output(lcmgen, header_name);
         if (f == NULL)
             return -1;
 
@@ -1286,12 +1824,12 @@ int emit_struct(lcmgen_t *lcmgen, lcm_struct_t *structure)
         emit_header_prototypes(lcmgen, f, structure);
 
         emit_header_bottom(lcmgen, f);
-        fclose(f);
+        lcm_fclose_output(lcmgen, f);
     }
 
     // STRUCT C file
     if (lcm_needs_generation(lcmgen, structure->lcmfile, c_name)) {
-        FILE *f = fopen(c_name, "w");
+        FILE *f = lcm_fopen_output(lcmgen, c_name);
         if (f == NULL)
             return -1;
 
@@ -1319,6 +1857,9 @@ int emit_struct(lcmgen_t *lcmgen, lcm_struct_t *structure)
         emit_c_decode_array_cleanup(lcmgen, f, structure);
         emit_c_decode(lcmgen, f, structure);
         emit_c_decode_cleanup(lcmgen, f, structure);
+        emit_c_decode_array_arena(lcmgen, f, structure);
+        emit_c_decode_array_arena_size(lcmgen, f, structure);
+        emit_c_decode_arena(lcmgen, f, structure);
 
         emit_c_clone_array(lcmgen, f, structure);
         emit_c_copy(lcmgen, f, structure);
@@ -1329,12 +1870,112 @@ int emit_struct(lcmgen_t *lcmgen, lcm_struct_t *structure)
             emit_c_struct_subscribe(lcmgen, f, structure);
         }
 
-        fclose(f);
+        lcm_fclose_output(lcmgen, f);
     }
 
     return 0;
 }
 
+// Emits <package>_registry.h and .c, which declare and define a table of the
+// message types of a package sorted by fingerprint.
+static int emit_registry(lcmgen_t *lcmgen, const char *package)
+{
+    char *xd = getopt_get_string(lcmgen->gopt, "c-export-symbol");
+    char *xd_ = add_space_or_empty(xd);
+    const char *cinclude = getopt_get_string(lcmgen->gopt, "cinclude");
+    const char *cinclude_sep = strlen(cinclude) > 0 ? "/" : "";
+
+    char *package_name = dots_to_underscores(package);
+    char *registry_name = g_strdup_printf("%s_registry", package_name);
+    char *header_name =
+        g_strdup_printf("%s/%s.h", getopt_get_string(lcmgen->gopt, "c-hpath"), registry_name);
+    char *c_name =
+        g_strdup_printf("%s/%s.c", getopt_get_string(lcmgen->gopt, "c-cpath"), registry_name);
+
+    FILE *f = lcm_fopen_output(lcmgen, header_name);
+    if (f == NULL)
+        return -1;
+
+    emit_header_top(lcmgen, f, registry_name, NULL);
+    emit(0, "/**");
+    emit(0, " * The message types of package %s, sorted by fingerprint.", package);
+    emit(0, " */");
+    emit(0, "extern %sconst lcm_registry_entry_t %s[];", xd_, registry_name);
+    emit(0, "extern %sconst int %s_size;", xd_, registry_name);
+    emit(0, "");
+    emit(0, "/**");
+    emit(0, " * Returns the message type of package %s with a fingerprint, or NULL.", package);
+    emit(0, " */");
+    emit(0, "static inline const lcm_registry_entry_t *%s_find(int64_t fingerprint)",
+         registry_name);
+    emit(0, "{");
+    emit(1, "return lcm_registry_find(%s, %s_size, fingerprint);", registry_name, registry_name);
+    emit(0, "}");
+    emit(0, "");
+    emit(0, "/**");
+    emit(0, " * Returns the message type of package %s of the encoded message in buf,", package);
+    emit(0, " * or NULL.");
+    emit(0, " */");
+    emit(0, "static inline const lcm_registry_entry_t *%s_find_message(", registry_name);
+    emit(0, "    const void *buf, int offset, int maxlen)");
+    emit(0, "{");
+    emit(1, "return lcm_registry_find_message(%s, %s_size, buf, offset, maxlen);",
+         registry_name, registry_name);
+    emit(0, "}");
+    emit(0, "");
+    emit_header_bottom(lcmgen, f);
+    if (lcm_fclose_output(lcmgen, f))
+        return -1;
+
+    f = lcm_fopen_output(lcmgen, c_name);
+    if (f == NULL)
+        return -1;
+
+    GArray *registry = lcm_get_package_registry(lcmgen, package);
+
+    emit_auto_generated_warning(f);
+    fprintf(f, "#include \"%s%s%s.h\"\n", cinclude, cinclude_sep, registry_name);
+    for (unsigned int i = 0; i < registry->len; i++) {
+        lcm_struct_t *ls = g_array_index(registry, lcm_registered_struct_t, i).ls;
+        char *type_name = dots_to_underscores(ls->structname->lctypename);
+        fprintf(f, "#include \"%s%s%s.h\"\n", cinclude, cinclude_sep, type_name);
+        free(type_name);
+    }
+    fprintf(f, "\n");
+
+    // an array can't be empty
+    emit(0, "const lcm_registry_entry_t %s[] = {", registry_name);
+    if (registry->len == 0)
+        emit(1, "{0, NULL, 0, NULL, NULL, NULL, NULL},");
+    for (unsigned int i = 0; i < registry->len; i++) {
+        lcm_registered_struct_t *entry = &g_array_index(registry, lcm_registered_struct_t, i);
+        char *type_name = dots_to_underscores(entry->ls->structname->lctypename);
+        emit(1, "{");
+        emit(2, "0x%016" PRIx64 "LL,", (uint64_t) entry->fingerprint);
+        emit(2, "\"%s\",", entry->ls->structname->lctypename);
+        emit(2, "(int) sizeof(%s),", type_name);
+        emit(2, "(lcm_decode_t) %s_decode,", type_name);
+        emit(2, "(lcm_decode_cleanup_t) %s_decode_cleanup,", type_name);
+        emit(2, "(lcm_encoded_size_t) %s_encoded_size,", type_name);
+        if (getopt_get_bool(lcmgen->gopt, "c-typeinfo"))
+            emit(2, "%s_get_type_info,", type_name);
+        else
+            emit(2, "NULL,");
+        emit(1, "},");
+        free(type_name);
+    }
+    emit(0, "};");
+    emit(0, "");
+    emit(0, "const int %s_size = %u;", registry_name, registry->len);
+
+    g_array_free(registry, TRUE);
+    g_free(c_name);
+    g_free(header_name);
+    g_free(registry_name);
+    free(package_name);
+    return lcm_fclose_output(lcmgen, f) ? -1 : 0;
+}
+
 int emit_c(lcmgen_t *lcmgen)
 {
     ////////////////////////////////////////////////////////////
@@ -1354,5 +1995,18 @@ int emit_c(lcmgen_t *lcmgen)
             return -1;
     }
 
+    ////////////////////////////////////////////////////////////
+    // REGISTRIES
+    if (getopt_get_bool(lcmgen->gopt, "c-registry")) {
+        for (unsigned int i = 0; i < g_ptr_array_size(lcmgen->structs); i++) {
+            lcm_struct_t *structure = (lcm_struct_t *) g_ptr_array_index(lcmgen->structs, i);
+            const char *package = structure->structname->package;
+
+            if (strlen(package) > 0 && lcm_is_first_in_package(lcmgen, structure) &&
+                emit_registry(lcmgen, package))
+                return -1;
+        }
+    }
+
     return 0;
 }
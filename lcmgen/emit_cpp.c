@@ -137,11 +137,290 @@ static char *map_type_name(const char *t)
     return dots_to_double_colons(t);
 }
 
+// Like map_type_name(), but for the declarations of members, whose strings
+// and vectors are std::pmr containers with --cpp-pmr.
+static char *map_member_type_name(lcmgen_t *lcm, const char *t)
+{
+    if (!strcmp(t, "string") && getopt_get_bool(lcm->gopt, "cpp-pmr"))
+        return strdup("std::pmr::string");
+    return map_type_name(t);
+}
+
+// Returns the capacity of the lcm::BoundedArray that holds dimension d of the
+// variable size array lm, or 0 if it is a std::vector.  Every dimension of a
+// bounded array is stored inline, the others where they have a max_size.
+static int bounded_dim_capacity(lcm_member_t *lm, int d)
+{
+    lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+    if (dim->mode == LCM_VAR)
+        return dim->max_size;
+    return lcm_is_bounded_array(lm) ? (int) strtol(dim->size, NULL, 0) : 0;
+}
+
+// Emits the check that the lengths of the bounded dimensions of lm fit into
+// their lcm::BoundedArray, before lm is encoded or decoded.  Negative lengths
+// are converted to large ones.
+static void emit_bounded_dims_check(FILE *f, int indent, lcm_member_t *lm)
+{
+    for (unsigned int d = 0; d < g_ptr_array_size(lm->dimensions); d++) {
+        lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+        if (dim->mode == LCM_VAR && dim->max_size)
+            emit(indent, "if(static_cast<uint64_t>(this->%s) > %d) return -1;", dim->size,
+                 dim->max_size);
+    }
+}
+
+// Returns 1 and the fingerprint of ls if it can be emitted as the HASH
+// constant, or 0 if getHash() has to compute it at runtime.  That is the case
+// when a member type is declared in a file that isn't being generated, or
+// the type has a member or constant called HASH.
+static int get_hash_constant(lcmgen_t *lcm, lcm_struct_t *ls, uint64_t *fingerprint)
+{
+    if (lcm_find_member(ls, "HASH") || lcm_find_const(ls, "HASH"))
+        return 0;
+    return lcm_compute_fingerprint(lcm, ls, fingerprint) == 0;
+}
+
+// Returns the size of every encoding of ls without the fingerprint if it is
+// emitted as the ENCODED_SIZE constant, or -1 if the size varies, or the type
+// has a member or constant called ENCODED_SIZE.
+static int get_constant_encoded_size(lcmgen_t *lcm, lcm_struct_t *ls)
+{
+    if (!g_ptr_array_size(ls->members) || lcm_find_member(ls, "ENCODED_SIZE") ||
+        lcm_find_const(ls, "ENCODED_SIZE"))
+        return -1;
+    return lcm_get_fixed_encoded_size(lcm, ls);
+}
+
+// Emits the encoding or decoding of a member of a type with a constant
+// encoded size.  The bounds are checked once for the whole type, so every
+// array is passed the exact buffer length that it needs.
+static void emit_fixed_member(lcmgen_t *lcm, FILE *f, lcm_member_t *lm, const char *op)
+{
+    int ndim = g_ptr_array_size(lm->dimensions);
+    int primitive = lcm_is_primitive_type(lm->type->lctypename);
+    // primitive arrays are passed whole in their last dimension
+    int nloops = (primitive && ndim > 0) ? ndim - 1 : ndim;
+    for (int d = 0; d < nloops; d++) {
+        lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+        emit(1 + d, "for (int a%d = 0; a%d < %s; a%d++) {", d, d, dim->size, d);
+    }
+
+    if (primitive) {
+        const char *count = "1";
+        if (ndim > 0)
+            count = ((lcm_dimension_t *) g_ptr_array_index(lm->dimensions, ndim - 1))->size;
+        int size = lcm_get_primitive_encoded_size(lm->type->lctypename) * strtol(count, NULL, 0);
+        emit_start(1 + nloops, "pos += __%s_%s_array(buf, offset + pos, %d, &this->%s",
+                   lm->type->lctypename, op, size, lm->membername);
+        for (int d = 0; d < nloops; d++)
+            emit_continue("[a%d]", d);
+        emit_end("%s, %s);", ndim > 0 ? "[0]" : "", count);
+    } else {
+        int size = lcm_get_fixed_encoded_size(lcm, lcm_find_struct(lcm, lm));
+        emit_start(1 + nloops, "pos += this->%s", lm->membername);
+        for (int d = 0; d < nloops; d++)
+            emit_continue("[a%d]", d);
+        emit_end("._%sNoHash(buf, offset + pos, %d);", op, size);
+    }
+
+    for (int d = nloops - 1; d >= 0; d--)
+        emit(1 + d, "}");
+}
+
+static int min_struct_encoded_size(lcmgen_t *lcm, const lcm_struct_t *ls, int depth);
+
+// Returns the smallest encoded size of an element of lm, or 0 if it's unknown
+// or can be 0.
+static int min_element_encoded_size(lcmgen_t *lcm, lcm_member_t *lm, int depth)
+{
+    if (!strcmp(lm->type->lctypename, "string"))
+        return 4;
+    if (lcm_is_primitive_type(lm->type->lctypename))
+        return lcm_get_primitive_encoded_size(lm->type->lctypename);
+    const lcm_struct_t *member_ls = lcm_find_struct(lcm, lm);
+    return member_ls ? min_struct_encoded_size(lcm, member_ls, depth + 1) : 0;
+}
+
+// Returns the smallest encoded size of ls without the fingerprint, or 0.
+static int min_struct_encoded_size(lcmgen_t *lcm, const lcm_struct_t *ls, int depth)
+{
+    // a type can't contain itself by value, so this only stops on bad input
+    if (depth > 64)
+        return 0;
+
+    int64_t size = 0;
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        if (!lcm_is_constant_size_array(lm))
+            continue;
+        int64_t member_size = min_element_encoded_size(lcm, lm, depth);
+        for (unsigned int d = 0; d < g_ptr_array_size(lm->dimensions); d++) {
+            lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+            member_size *= strtol(dim->size, NULL, 0);
+            if (member_size > INT32_MAX)
+                return INT32_MAX;
+        }
+        size += member_size;
+        if (size > INT32_MAX)
+            return INT32_MAX;
+    }
+    return (int) size;
+}
+
+// Returns the encoded size of every element of lm, if it's a primitive
+// other than string or a type with a constant encoded size, or -1.
+static int fixed_element_encoded_size(lcmgen_t *lcm, lcm_member_t *lm)
+{
+    if (!strcmp(lm->type->lctypename, "string"))
+        return -1;
+    if (lcm_is_primitive_type(lm->type->lctypename))
+        return lcm_get_primitive_encoded_size(lm->type->lctypename);
+    lcm_struct_t *member_ls = lcm_find_struct(lcm, lm);
+    return member_ls ? get_constant_encoded_size(lcm, member_ls) : -1;
+}
+
+// Returns 1 if ls has a View, which it hasn't if a member or constant is
+// called View.
+static int has_view(lcm_struct_t *ls)
+{
+    return !lcm_find_member(ls, "View") && !lcm_find_const(ls, "View");
+}
+
+// Returns 1 if ls has visit(), which it hasn't if a member or constant is
+// called visit.
+static int has_visit(lcm_struct_t *ls)
+{
+    return !lcm_find_member(ls, "visit") && !lcm_find_const(ls, "visit");
+}
+
+// Returns 1 if ls has Columns and decodeColumns(), with --cpp-soa.  Those are
+// the types whose members are all primitives other than strings, and not
+// arrays, so that every element of an array of them has each member at the
+// same offset.
+static int has_columns(lcmgen_t *lcm, lcm_struct_t *ls)
+{
+    if (!getopt_get_bool(lcm->gopt, "cpp-soa") || !g_ptr_array_size(ls->members) ||
+        lcm_find_member(ls, "Columns") || lcm_find_const(ls, "Columns") ||
+        lcm_find_member(ls, "decodeColumns") || lcm_find_const(ls, "decodeColumns"))
+        return 0;
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        if (g_ptr_array_size(lm->dimensions) || !lcm_is_primitive_type(lm->type->lctypename) ||
+            !strcmp(lm->type->lctypename, "string"))
+            return 0;
+    }
+    return 1;
+}
+
+// Returns 1 if lm is named like a method or field of View.
+static int is_view_reserved(lcm_member_t *lm)
+{
+    static const char *const reserved[] = {"decode", "_decodeNoHash", "_buf", "_size"};
+    for (unsigned int i = 0; i < sizeof(reserved) / sizeof(reserved[0]); i++)
+        if (!strcmp(lm->membername, reserved[i]))
+            return 1;
+    return 0;
+}
+
+static int view_has_accessor(lcmgen_t *lcm, lcm_struct_t *ls, lcm_member_t *lm);
+
+// Returns 1 if the View of ls decodes lm into the Columns of its type.  Those
+// are the one dimensional arrays of types with Columns, that are generated
+// along with ls.
+static int view_has_columns(lcmgen_t *lcm, lcm_struct_t *ls, lcm_member_t *lm)
+{
+    if (is_view_reserved(lm) || g_ptr_array_size(lm->dimensions) != 1 ||
+        lcm_is_primitive_type(lm->type->lctypename))
+        return 0;
+    lcm_struct_t *member_ls = lcm_find_struct(lcm, lm);
+    if (!member_ls || !has_columns(lcm, member_ls))
+        return 0;
+
+    lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, 0);
+    if (dim->mode == LCM_CONST)
+        return 1;
+    lcm_member_t *length = lcm_find_member(ls, dim->size);
+    return length && view_has_accessor(lcm, ls, length);
+}
+
+// Returns 1 if the View of ls has an accessor for lm.  Those are the members
+// that aren't arrays, and the one dimensional arrays of primitives other than
+// strings, or of types with Columns.  A member named like a method or field of
+// View has none.
+static int view_has_accessor(lcmgen_t *lcm, lcm_struct_t *ls, lcm_member_t *lm)
+{
+    if (is_view_reserved(lm))
+        return 0;
+    if (view_has_columns(lcm, ls, lm))
+        return 1;
+
+    int ndim = g_ptr_array_size(lm->dimensions);
+    if (ndim == 0) {
+        if (lcm_is_primitive_type(lm->type->lctypename))
+            return 1;
+        // a type that isn't being generated is assumed to have a View
+        lcm_struct_t *member_ls = lcm_find_struct(lcm, lm);
+        return !member_ls || has_view(member_ls);
+    }
+    if (ndim > 1 || !lcm_is_primitive_type(lm->type->lctypename) ||
+        !strcmp(lm->type->lctypename, "string"))
+        return 0;
+
+    lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, 0);
+    if (dim->mode == LCM_CONST)
+        return 1;
+    lcm_member_t *length = lcm_find_member(ls, dim->size);
+    return length && view_has_accessor(lcm, ls, length);
+}
+
+// Returns the type that the View accessor of lm returns.  Free it with g_free().
+static char *view_accessor_type(lcm_member_t *lm)
+{
+    char *mapped = map_type_name(lm->type->lctypename);
+    char *type;
+    if (g_ptr_array_size(lm->dimensions))
+        type = g_strdup_printf("lcm::ArrayView<%s>", mapped);
+    else if (!strcmp(lm->type->lctypename, "string"))
+        type = g_strdup("const char *");
+    else if (!lcm_is_primitive_type(lm->type->lctypename))
+        type = g_strdup_printf("%s::View", mapped);
+    else
+        type = g_strdup(mapped);
+    free(mapped);
+    return type;
+}
+
+// Returns the offset of member m in every encoding of ls without the
+// fingerprint, or -1 if a member before it doesn't have a constant size.
+static int get_constant_member_offset(lcmgen_t *lcm, lcm_struct_t *ls, unsigned int m)
+{
+    int64_t offset = 0;
+    for (unsigned int i = 0; i < m; i++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, i);
+        int size = lcm_get_fixed_member_encoded_size(lcm, lm);
+        if (size < 0)
+            return -1;
+        offset += size;
+        if (offset > INT32_MAX)
+            return -1;
+    }
+    return (int) offset;
+}
+
 void setup_cpp_options(getopt_t *gopt)
 {
     getopt_add_string(gopt, 0, "cpp-std", "c++98", "C++ standard(c++98, c++11)");
     getopt_add_string(gopt, 0, "cpp-hpath", ".", "Location for .hpp files");
     getopt_add_string(gopt, 0, "cpp-include", "", "Generated #include lines reference this folder");
+    getopt_add_bool(gopt, 0, "cpp-registry", 0,
+                    "Generate a registry of the types of each package by fingerprint");
+    getopt_add_bool(gopt, 0, "cpp-pmr", 0,
+                    "Use std::pmr containers, for C++17 and later (needs --cpp-std=c++11)");
+    getopt_add_bool(gopt, 0, "cpp-decode-try-catch", 0,
+                    "Return an error for exceptions from resizing arrays while decoding");
+    getopt_add_bool(gopt, 0, "cpp-soa", 0,
+                    "Decode arrays of structs of primitives into a vector per member, in View");
 }
 
 static void emit_auto_generated_warning(FILE *f)
@@ -162,7 +441,10 @@ static void emit_type_comment(FILE *f, lcm_member_t *structure_member)
     for (guint dim_num = 0; dim_num < structure_member->dimensions->len; dim_num++) {
         lcm_dimension_t *dim =
             (lcm_dimension_t *) g_ptr_array_index(structure_member->dimensions, dim_num);
-        fprintf(f, "[%s]", dim->size);
+        if (dim->max_size)
+            fprintf(f, "[%s (max %d)]", dim->size, dim->max_size);
+        else
+            fprintf(f, "[%s]", dim->size);
     }
 }
 
@@ -249,11 +531,69 @@ static void emit_package_namespace_close(lcmgen_t *lcmgen, FILE *f, lcm_struct_t
 }
 
 /** Emit header file **/
+static void emit_view_declaration(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    emit(2, "/**");
+    emit(2, " * A read-only view of an encoded %s, which decodes the members",
+         ls->structname->shortname);
+    emit(2, " * when they are accessed instead of copying the whole message.  The");
+    emit(2, " * buffer has to outlive the view.  The members that are arrays with more");
+    if (getopt_get_bool(lcm->gopt, "cpp-soa")) {
+        emit(2, " * than one dimension, or arrays of strings or of structs without Columns,");
+        emit(2, " * have no accessors.  Arrays of structs with Columns are decoded into them,");
+        emit(2, " * one vector for each member of the struct.");
+    } else {
+        emit(2, " * than one dimension, or arrays of strings or structs, have no accessors.");
+    }
+    emit(2, " */");
+    emit(2, "class View");
+    emit(2, "{");
+    emit(3, "public:");
+    emit(4, "View() : _buf(NULL), _size(0) {}");
+    emit(0, "");
+    emit(4, "/**");
+    emit(4, " * Checks an encoded message and makes this a view of it.");
+    emit(4, " *");
+    emit(4, " * @param buf The buffer containing the encoded message.");
+    emit(4, " * @param offset The byte offset into @p buf where the encoded message starts.");
+    emit(4, " * @param maxlen The maximum number of bytes to read.");
+    emit(4, " * @return The number of bytes of the message, or <0 if an error occured.");
+    emit(4, " */");
+    emit(4, "inline int decode(const void *buf, int offset, int maxlen);");
+    int accessors = 0;
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        if (!view_has_accessor(lcm, ls, lm))
+            continue;
+        if (!accessors++)
+            emit(0, "");
+        if (view_has_columns(lcm, ls, lm)) {
+            char *type = map_type_name(lm->type->lctypename);
+            emit(4, "inline void %s(%s::Columns &columns) const;", lm->membername, type);
+            free(type);
+            continue;
+        }
+        char *type = view_accessor_type(lm);
+        emit(4, "inline %s%s%s() const;", type, type[strlen(type) - 1] == '*' ? "" : " ",
+             lm->membername);
+        g_free(type);
+    }
+    emit(0, "");
+    emit(4, "// LCM support function. Users should not call this");
+    emit(4, "inline int _decodeNoHash(const void *buf, int offset, int maxlen);");
+    emit(0, "");
+    emit(3, "private:");
+    emit(4, "const uint8_t *_buf;");
+    emit(4, "int _size;");
+    emit(2, "};");
+}
+
 static void emit_header_start(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *structure)
 {
     char *tn = structure->structname->lctypename;
     char *sn = structure->structname->shortname;
     char *tn_ = dots_to_underscores(tn);
+    int pmr = getopt_get_bool(lcmgen->gopt, "cpp-pmr");
 
     emit_auto_generated_warning(f);
     emit_comment(f, 0, structure->file_comment);
@@ -272,8 +612,10 @@ static void emit_header_start(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *structure
     int emit_include_string = 0;
     for (unsigned int mind = 0; mind < g_ptr_array_size(structure->members); mind++) {
         lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(structure->members, mind);
-        if (g_ptr_array_size(lm->dimensions) != 0 && !lcm_is_constant_size_array(lm) &&
-            !emit_include_vector) {
+        int has_vector = 0;
+        for (unsigned int d = 0; d < g_ptr_array_size(lm->dimensions); d++)
+            has_vector |= !lcm_is_constant_size_array(lm) && !bounded_dim_capacity(lm, d);
+        if (has_vector && !emit_include_vector) {
             emit(0, "#include <vector>");
             emit_include_vector = 1;
         }
@@ -282,6 +624,12 @@ static void emit_header_start(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *structure
             emit_include_string = 1;
         }
     }
+    if (!emit_include_vector && has_columns(lcmgen, structure))
+        emit(0, "#include <vector>");
+    // for std::swap, which <utility> has from C++11 on
+    if (!pmr)
+        emit(0, "#include <%s>",
+             strcmp(getopt_get_string(lcmgen->gopt, "cpp-std"), "c++11") ? "algorithm" : "utility");
 
     // include header files for other LCM types
     for (unsigned int mind = 0; mind < g_ptr_array_size(structure->members); mind++) {
@@ -298,6 +646,13 @@ static void emit_header_start(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *structure
         }
     }
 
+    if (pmr) {
+        emit(0, "#include <memory>");
+        emit(0, "#include <memory_resource>");
+        emit(0, "#include <new>");
+        emit(0, "#include <utility>");
+    }
+
     fprintf(f, "\n");
     emit_package_namespace_start(lcmgen, f, structure);
 
@@ -314,7 +669,7 @@ static void emit_header_start(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *structure
             lcm_member_t *member = (lcm_member_t *) g_ptr_array_index(structure->members, mind);
 
             emit_member_comment(f, 2, member->comment, member);
-            char *mapped_typename = map_type_name(member->type->lctypename);
+            char *mapped_typename = map_member_type_name(lcmgen, member->type->lctypename);
             int ndim = g_ptr_array_size(member->dimensions);
             if (ndim == 0) {
                 emit(2, "%-10s %s;", mapped_typename, member->membername);
@@ -329,11 +684,20 @@ static void emit_header_start(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *structure
                     emit_end(";");
                 } else {
                     emit_start(2, "");
-                    for (unsigned int d = 0; d < ndim; d++)
-                        emit_continue("std::vector< ");
+                    for (unsigned int d = 0; d < ndim; d++) {
+                        if (bounded_dim_capacity(member, d))
+                            emit_continue("lcm::BoundedArray< ");
+                        else
+                            emit_continue("%s< ", pmr ? "std::pmr::vector" : "std::vector");
+                    }
                     emit_continue("%s", mapped_typename);
-                    for (unsigned int d = 0; d < ndim; d++)
-                        emit_continue(" >");
+                    for (int d = ndim - 1; d >= 0; d--) {
+                        int capacity = bounded_dim_capacity(member, d);
+                        if (capacity)
+                            emit_continue(", %d >", capacity);
+                        else
+                            emit_continue(" >");
+                    }
                     emit_end(" %s;", member->membername);
                 }
             }
@@ -391,6 +755,19 @@ static void emit_header_start(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *structure
     }
 
     emit(1, "public:");
+    if (pmr) {
+        emit(2, "/**");
+        emit(2, " * The allocator of the strings and vectors, and of the members that are");
+        emit(2, " * messages, which makes them allocate from a std::pmr::memory_resource.");
+        emit(2, " */");
+        emit(2, "typedef std::pmr::polymorphic_allocator<char> allocator_type;");
+        emit(0, "");
+        emit(2, "%s() = default;", sn);
+        emit(2, "inline explicit %s(const allocator_type &alloc);", sn);
+        emit(2, "inline %s(const %s &other, const allocator_type &alloc);", sn, sn);
+        emit(2, "inline %s(%s &&other, const allocator_type &alloc);", sn, sn);
+        emit(0, "");
+    }
     emit(2, "/**");
     emit(2, " * Encode a message into binary form.");
     emit(2, " *");
@@ -417,6 +794,41 @@ static void emit_header_start(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *structure
     emit(2, " */");
     emit(2, "inline int decode(const void *buf, int offset, int maxlen);");
     emit(0, "");
+    if (pmr) {
+        emit(2, "/**");
+        emit(2, " * Decode a message into this instance, whose previous contents are");
+        emit(2, " * destroyed first, so that all of its members allocate from @p resource.");
+        emit(2, " * A monotonic resource can then release the whole message at once.  The");
+        emit(2, " * instance must not be used after @p resource is released.");
+        emit(2, " *");
+        emit(2, " * @return The number of bytes decoded, or <0 if an error occured.");
+        emit(2, " */");
+        emit(2, "inline int decode(const void *buf, int offset, int maxlen,");
+        emit(2, "                  std::pmr::memory_resource *resource);");
+        emit(0, "");
+    }
+    const char *noexcept_ =
+        strcmp(getopt_get_string(lcmgen->gopt, "cpp-std"), "c++11") ? "" : " noexcept";
+    emit(2, "/**");
+    emit(2, " * Prepare a message that is decoded into again, so that decode() reuses");
+    emit(2, " * its storage instead of allocating as long as its arrays don't grow.");
+    emit(2, " * Every member is reset to its initial value.  Variable size arrays of");
+    emit(2, " * numbers are emptied, but those of strings, structs or other arrays keep");
+    emit(2, " * their elements, which are cleared in turn, so their sizes no longer");
+    emit(2, " * match the length members until the next decode().  Don't fill in a");
+    emit(2, " * message for publishing after this, since push_back() would append after");
+    emit(2, " * the kept elements.");
+    emit(2, " */");
+    emit(2, "inline void clearForDecode();");
+    emit(0, "");
+    emit(2, "/**");
+    emit(2, " * Exchange the contents of this message with @p other, without copying the");
+    emit(2, " * strings and vectors.");
+    if (pmr)
+        emit(2, " * Both have to use the same memory resource.");
+    emit(2, " */");
+    emit(2, "inline void swap(%s &other)%s;", sn, noexcept_);
+    emit(0, "");
     emit(2, "/**");
     emit(2, " * Retrieve the 64-bit fingerprint identifying the structure of the message.");
     emit(2, " * Note that the fingerprint is the same for all instances of the same");
@@ -425,10 +837,75 @@ static void emit_header_start(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *structure
     emit(2, " */");
     emit(2, "inline static int64_t getHash();");
     emit(0, "");
+    int encoded_size = get_constant_encoded_size(lcmgen, structure);
+    if (encoded_size >= 0) {
+        emit(2, "/**");
+        emit(2, " * The size of every encoded message of this type, the value of");
+        emit(2, " * getEncodedSize().");
+        emit(2, " */");
+        emit(2, "enum { ENCODED_SIZE = %d };", encoded_size + 8);
+        emit(0, "");
+    }
+    uint64_t fingerprint;
+    if (get_hash_constant(lcmgen, structure, &fingerprint)) {
+        const char *cpp_std = getopt_get_string(lcmgen->gopt, "cpp-std");
+        emit(2, "/**");
+        emit(2, " * The 64-bit fingerprint of the message type, the value of getHash().");
+        emit(2, " */");
+        emit(2, "static %s int64_t HASH = static_cast<int64_t>(0x%016" PRIx64 "ULL);",
+             strcmp(cpp_std, "c++11") ? "const" : "constexpr", fingerprint);
+        emit(0, "");
+    }
     emit(2, "/**");
     emit(2, " * Returns \"%s\"", structure->structname->shortname);
     emit(2, " */");
     emit(2, "inline static const char* getTypeName();");
+    if (has_visit(structure)) {
+        const char *ref = strcmp(getopt_get_string(lcmgen->gopt, "cpp-std"), "c++11") ? "&" : "&&";
+        emit(0, "");
+        emit(2, "/**");
+        emit(2, " * Calls visitor(name, member) for every member, in the order of the type");
+        emit(2, " * definition, with the member name and a reference to the member.  A");
+        emit(2, " * visitor with an overload or template for each member type is specialized");
+        emit(2, " * for the message type at compile time, and can call visit() on members");
+        emit(2, " * that are messages.");
+        emit(2, " */");
+        emit(2, "template <class Visitor>");
+        emit(2, "inline void visit(Visitor %svisitor);", ref);
+        emit(0, "");
+        emit(2, "template <class Visitor>");
+        emit(2, "inline void visit(Visitor %svisitor) const;", ref);
+    }
+    if (has_columns(lcmgen, structure)) {
+        emit(0, "");
+        emit(2, "/**");
+        emit(2, " * The members of an array of %s, each in a vector of its own.", sn);
+        emit(2, " */");
+        emit(2, "struct Columns");
+        emit(2, "{");
+        for (unsigned int mind = 0; mind < g_ptr_array_size(structure->members); mind++) {
+            lcm_member_t *member = (lcm_member_t *) g_ptr_array_index(structure->members, mind);
+            char *mapped_typename = map_type_name(member->type->lctypename);
+            emit(3, "std::vector<%s> %s;", mapped_typename, member->membername);
+            free(mapped_typename);
+        }
+        emit(2, "};");
+        emit(0, "");
+        emit(2, "/**");
+        emit(2, " * Decode @p n messages that are encoded one after the other without their");
+        emit(2, " * fingerprints, as in an array member, into @p columns, whose vectors are");
+        emit(2, " * resized to @p n.  Each member is decoded by a loop over the elements, which");
+        emit(2, " * compilers can vectorize.");
+        emit(2, " *");
+        emit(2, " * @return The number of bytes decoded, or <0 if an error occured.");
+        emit(2, " */");
+        emit(2, "inline static int decodeColumns(const void *buf, int offset, int maxlen,");
+        emit(2, "                                Columns &columns, int n);");
+    }
+    if (has_view(structure)) {
+        emit(0, "");
+        emit_view_declaration(lcmgen, f, structure);
+    }
 
     emit(0, "");
     emit(2, "// LCM support functions. Users should not call these");
@@ -436,8 +913,15 @@ static void emit_header_start(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *structure
     emit(2, "inline int _getEncodedSizeNoHash() const;");
     emit(2, "inline int _decodeNoHash(const void *buf, int offset, int maxlen);");
     emit(2, "inline static uint64_t _computeHash(const __lcm_hash_ptr *p);");
+    emit(2, "inline static int _skipNoHash(const void *buf, int offset, int maxlen, int member);");
     emit(0, "};");
     emit(0, "");
+    // found by argument dependent lookup, e.g. by std::sort()
+    emit(0, "inline void swap(%s &a, %s &b)%s", sn, sn, noexcept_);
+    emit(0, "{");
+    emit(1, "a.swap(b);");
+    emit(0, "}");
+    emit(0, "");
 
     free(tn_);
 }
@@ -445,11 +929,13 @@ static void emit_header_start(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *structure
 static void emit_encode(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
 {
     const char *sn = ls->structname->shortname;
+    uint64_t fingerprint;
+    const char *hash = get_hash_constant(lcm, ls, &fingerprint) ? "HASH" : "getHash()";
     // clang-format off
     emit(0, "int %s::encode(void *buf, int offset, int maxlen) const", sn);
     emit(0, "{");
     emit(1,     "int pos = 0, tlen;");
-    emit(1,     "int64_t hash = getHash();");
+    emit(1,     "int64_t hash = %s;", hash);
     emit(0, "");
     emit(1,     "tlen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &hash, 1);");
     emit(1,     "if(tlen < 0) return tlen; else pos += tlen;");
@@ -478,6 +964,8 @@ static void emit_encoded_size(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
 static void emit_decode(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
 {
     const char *sn = ls->structname->shortname;
+    uint64_t fingerprint;
+    const char *hash = get_hash_constant(lcm, ls, &fingerprint) ? "HASH" : "getHash()";
     // clang-format off
     emit(0, "int %s::decode(const void *buf, int offset, int maxlen)", sn);
     emit(0, "{");
@@ -486,7 +974,7 @@ static void emit_decode(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
     emit(1,     "int64_t msg_hash;");
     emit(1,     "thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &msg_hash, 1);");
     emit(1,     "if (thislen < 0) return thislen; else pos += thislen;");
-    emit(1,     "if (msg_hash != getHash()) return -1;");
+    emit(1,     "if (msg_hash != %s) return -1;", hash);
     emit(0, "");
     emit(1,     "thislen = this->_decodeNoHash(buf, offset + pos, maxlen - pos);");
     emit(1,     "if (thislen < 0) return thislen; else pos += thislen;");
@@ -497,14 +985,215 @@ static void emit_decode(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
     // clang-format on
 }
 
+// Emits the constructors that take an allocator, and the decode() that takes
+// a memory resource, for --cpp-pmr.
+static void emit_allocator_support(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    const char *sn = ls->structname->shortname;
+
+    // The strings, vectors and messages are constructed with the allocator.
+    // In constant size arrays they are replaced instead.
+    int initialized = 0, replaced = 0;
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        int ndim = g_ptr_array_size(lm->dimensions);
+        if (ndim && !lcm_is_constant_size_array(lm)) {
+            // the elements of an lcm::BoundedArray use the default resource
+            if (!bounded_dim_capacity(lm, 0))
+                initialized++;
+        } else if (!lcm_is_primitive_type(lm->type->lctypename) ||
+                   !strcmp(lm->type->lctypename, "string")) {
+            if (ndim)
+                replaced++;
+            else
+                initialized++;
+        }
+    }
+
+    if (!initialized && !replaced) {
+        emit(0, "%s::%s(const allocator_type &)", sn, sn);
+        emit(0, "{");
+    } else {
+        emit(0, "%s::%s(const allocator_type &alloc)", sn, sn);
+        const char *separator = "    : ";
+        for (unsigned int m = 0; m < g_ptr_array_size(ls->members) && initialized; m++) {
+            lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+            int ndim = g_ptr_array_size(lm->dimensions);
+            if ((ndim && !lcm_is_constant_size_array(lm) && !bounded_dim_capacity(lm, 0)) ||
+                (!ndim && (!lcm_is_primitive_type(lm->type->lctypename) ||
+                           !strcmp(lm->type->lctypename, "string")))) {
+                emit(0, "%s%s(alloc)%s", separator, lm->membername, --initialized ? "," : "");
+                separator = "      ";
+            }
+        }
+        emit(0, "{");
+    }
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members) && replaced; m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        int ndim = g_ptr_array_size(lm->dimensions);
+        if (!ndim || !lcm_is_constant_size_array(lm) ||
+            (lcm_is_primitive_type(lm->type->lctypename) &&
+             strcmp(lm->type->lctypename, "string")))
+            continue;
+
+        for (int d = 0; d < ndim; d++) {
+            lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+            emit(1 + d, "for (int a%d = 0; a%d < %s; a%d++) {", d, d, dim->size, d);
+        }
+        emit_start(1 + ndim, "std::destroy_at(&this->%s", lm->membername);
+        for (int d = 0; d < ndim; d++)
+            emit_continue("[a%d]", d);
+        emit_end(");");
+        char *type = map_member_type_name(lcm, lm->type->lctypename);
+        emit_start(1 + ndim, "::new (&this->%s", lm->membername);
+        for (int d = 0; d < ndim; d++)
+            emit_continue("[a%d]", d);
+        emit_end(") %s(alloc);", type);
+        free(type);
+        for (int d = ndim - 1; d >= 0; d--)
+            emit(1 + d, "}");
+    }
+    emit(0, "}");
+    emit(0, "");
+
+    // clang-format off
+    emit(0, "%s::%s(const %s &other, const allocator_type &alloc)", sn, sn, sn);
+    emit(0, "    : %s(alloc)", sn);
+    emit(0, "{");
+    emit(1,     "*this = other;");
+    emit(0, "}");
+    emit(0, "");
+    emit(0, "%s::%s(%s &&other, const allocator_type &alloc)", sn, sn, sn);
+    emit(0, "    : %s(alloc)", sn);
+    emit(0, "{");
+    emit(1,     "*this = std::move(other);");
+    emit(0, "}");
+    emit(0, "");
+    emit(0, "int %s::decode(const void *buf, int offset, int maxlen,", sn);
+    emit(0, "    std::pmr::memory_resource *resource)");
+    emit(0, "{");
+    emit(1,     "this->~%s();", sn);
+    emit(1,     "::new (this) %s(allocator_type(resource));", sn);
+    emit(1,     "return this->decode(buf, offset, maxlen);");
+    emit(0, "}");
+    emit(0, "");
+    // clang-format on
+}
+
+// Emits the loops over the first nloops dimensions of an array member, up
+// to the current size of those of variable size.
+static void emit_array_loops(FILE *f, lcm_member_t *lm, int nloops)
+{
+    for (int d = 0; d < nloops; d++) {
+        lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+        if (dim->mode == LCM_CONST) {
+            emit(1 + d, "for (int a%d = 0; a%d < %s; a%d++) {", d, d, dim->size, d);
+            continue;
+        }
+        emit_start(1 + d, "for (int a%d = 0; a%d < (int) this->%s", d, d, lm->membername);
+        for (int i = 0; i < d; i++)
+            emit_continue("[a%d]", i);
+        emit_end(".size(); a%d++) {", d);
+    }
+}
+
+// Emits the loops over the elements of a constant size array member, and
+// returns the number of dimensions that were looped over.
+static int emit_fixed_array_loops(FILE *f, lcm_member_t *lm)
+{
+    int ndim = g_ptr_array_size(lm->dimensions);
+    if (!ndim || !lcm_is_constant_size_array(lm))
+        return 0;
+    emit_array_loops(f, lm, ndim);
+    return ndim;
+}
+
+static void emit_fixed_array_loops_end(FILE *f, int nloops)
+{
+    for (int d = nloops - 1; d >= 0; d--)
+        emit(1 + d, "}");
+}
+
+static void emit_clear_for_decode(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    const char *sn = ls->structname->shortname;
+    emit(0, "void %s::clearForDecode()", sn);
+    emit(0, "{");
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        const char *type = lm->type->lctypename;
+        int ndim = g_ptr_array_size(lm->dimensions);
+        // Arrays keep their elements if those have storage of their own,
+        // which is cleared instead, so that decode() reuses it.  Only a last
+        // dimension of numbers that is of variable size is emptied.
+        int nloops = ndim;
+        int empty = 0;
+        if (ndim && lcm_is_primitive_type(type) && strcmp(type, "string")) {
+            lcm_dimension_t *dim =
+                (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, ndim - 1);
+            if (dim->mode == LCM_VAR) {
+                nloops = ndim - 1;
+                empty = 1;
+            }
+        }
+        emit_array_loops(f, lm, nloops);
+        emit_start(1 + nloops, "this->%s", lm->membername);
+        for (int d = 0; d < nloops; d++)
+            emit_continue("[a%d]", d);
+        if (empty || !strcmp(type, "string"))
+            emit_end(".clear();");
+        else if (!lcm_is_primitive_type(type))
+            emit_end(".clearForDecode();");
+        else
+            emit_end(" = %s;", strcmp(type, "boolean") ? "0" : "false");
+        emit_fixed_array_loops_end(f, nloops);
+    }
+    emit(0, "}");
+    emit(0, "");
+}
+
+static void emit_swap(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    const char *sn = ls->structname->shortname;
+    const char *noexcept_ =
+        strcmp(getopt_get_string(lcm->gopt, "cpp-std"), "c++11") ? "" : " noexcept";
+    emit(0, "void %s::swap(%s &other)%s", sn, sn, noexcept_);
+    emit(0, "{");
+    if (!g_ptr_array_size(ls->members))
+        emit(1, "(void) other;");
+    else
+        emit(1, "using std::swap;");
+    // constant size arrays element by element, which std::swap() of C++98
+    // can't do at once
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        int nloops = emit_fixed_array_loops(f, lm);
+        emit_start(1 + nloops, "swap(this->%s", lm->membername);
+        for (int d = 0; d < nloops; d++)
+            emit_continue("[a%d]", d);
+        emit_continue(", other.%s", lm->membername);
+        for (int d = 0; d < nloops; d++)
+            emit_continue("[a%d]", d);
+        emit_end(");");
+        emit_fixed_array_loops_end(f, nloops);
+    }
+    emit(0, "}");
+    emit(0, "");
+}
+
 static void emit_get_hash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
 {
     const char *sn = ls->structname->shortname;
+    uint64_t fingerprint;
     // clang-format off
     emit(0, "int64_t %s::getHash()", sn);
     emit(0, "{");
-    emit(1,     "static int64_t hash = static_cast<int64_t>(_computeHash(NULL));");
-    emit(1,     "return hash;");
+    if (get_hash_constant(lcm, ls, &fingerprint)) {
+        emit(1, "return HASH;");
+    } else {
+        emit(1, "static int64_t hash = static_cast<int64_t>(_computeHash(NULL));");
+        emit(1, "return hash;");
+    }
     emit(0, "}");
     emit(0, "");
     // clang-format off
@@ -619,6 +1308,24 @@ static void emit_encode_nohash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
         return;
     }
 
+    if (get_constant_encoded_size(lcm, ls) >= 0) {
+        // clang-format off
+        emit(0, "int %s::_encodeNoHash(void *buf, int offset, int maxlen) const", sn);
+        emit(0, "{");
+        emit(1,     "if (maxlen < ENCODED_SIZE - 8) return -1;");
+        emit(1,     "int pos = 0;");
+        emit(0, "");
+        // clang-format on
+        for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++)
+            emit_fixed_member(lcm, f, (lcm_member_t *) g_ptr_array_index(ls->members, m),
+                              "encode");
+        emit(0, "");
+        emit(1, "return pos;");
+        emit(0, "}");
+        emit(0, "");
+        return;
+    }
+
     // clang-format off
     emit(0, "int %s::_encodeNoHash(void *buf, int offset, int maxlen) const", sn);
     emit(0, "{");
@@ -648,6 +1355,7 @@ static void emit_encode_nohash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
         } else {
             lcm_dimension_t *last_dim =
                 (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, num_dims - 1);
+            emit_bounded_dims_check(f, 1, lm);
 
             // for non-string primitive types with variable size final
             // dimension, add an optimization to only call the primitive encode
@@ -674,6 +1382,12 @@ static void emit_encoded_size_nohash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
     const char *sn = ls->structname->shortname;
     emit(0, "int %s::_getEncodedSizeNoHash() const", sn);
     emit(0, "{");
+    if (get_constant_encoded_size(lcm, ls) >= 0) {
+        emit(1, "return ENCODED_SIZE - 8;");
+        emit(0, "}");
+        emit(0, "");
+        return;
+    }
     if (0 == g_ptr_array_size(ls->members)) {
         emit(1, "return 0;");
         emit(0, "}");
@@ -699,6 +1413,14 @@ static void emit_encoded_size_nohash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
             } else {
                 emit_end("__%s_encoded_array_size(NULL, 1);", lm->type->lctypename);
             }
+        } else if (fixed_element_encoded_size(lcm, lm) >= 0) {
+            // every element has the size of its type, so the array needs no loop
+            emit_start(1, "enc_size += ");
+            for (int n = 0; n < ndim; n++) {
+                lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, n);
+                emit_continue("%s%s * ", dim_size_prefix(dim->size), dim->size);
+            }
+            emit_end("%d;", fixed_element_encoded_size(lcm, lm));
         } else {
             for (int n = 0; n < ndim; n++) {
                 lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, n);
@@ -732,11 +1454,13 @@ static void _decode_recursive(lcmgen_t *lcm, FILE *f, lcm_member_t *lm, int dept
 
         int decode_indent = 1 + depth;
         if (!lcm_is_constant_size_array(lm)) {
-            emit(1 + depth, "if(%s%s) {", dim_size_prefix(dim->size), dim->size);
-            emit_start(2 + depth, "this->%s", lm->membername);
+            // resize empty arrays too, so that nothing is left over from the
+            // previous message when a message object is decoded into again
+            emit_start(1 + depth, "this->%s", lm->membername);
             for (int i = 0; i < depth; i++)
                 emit_continue("[a%d]", i);
             emit_end(".resize(%s%s);", dim_size_prefix(dim->size), dim->size);
+            emit(1 + depth, "if(%s%s) {", dim_size_prefix(dim->size), dim->size);
             decode_indent++;
         }
 
@@ -756,12 +1480,18 @@ static void _decode_recursive(lcmgen_t *lcm, FILE *f, lcm_member_t *lm, int dept
             emit(1 + depth, "tlen = __int32_t_decode_array(");
             emit(1 + depth, "    buf, offset + pos, maxlen - pos, &__elem_len, 1);");
             emit(1 + depth, "if(tlen < 0) return tlen; else pos += tlen;");
-            emit(1 + depth, "if(__elem_len > maxlen - pos) return -1;");
+            emit(1 + depth, "if(__elem_len < 1 || __elem_len > maxlen - pos) return -1;");
             emit_start(1 + depth, "this->%s", lm->membername);
             for (int i = 0; i < depth; i++)
                 emit_continue("[a%d]", i);
             emit_end(".assign(static_cast<const char*>(buf) + offset + pos, __elem_len -  1);");
             emit(1 + depth, "pos += __elem_len;");
+        } else if (depth > 0 && fixed_element_encoded_size(lcm, lm) >= 0) {
+            // the bounds of the whole array are checked before it
+            emit_start(1 + depth, "pos += this->%s", lm->membername);
+            for (int i = 0; i < depth; i++)
+                emit_continue("[a%d]", i);
+            emit_end("._decodeNoHash(buf, offset + pos, %d);", fixed_element_encoded_size(lcm, lm));
         } else {
             emit_start(1 + depth, "tlen = this->%s", lm->membername);
             for (int i = 0; i < depth; i++)
@@ -773,15 +1503,19 @@ static void _decode_recursive(lcmgen_t *lcm, FILE *f, lcm_member_t *lm, int dept
         lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, depth);
 
         if (!lcm_is_constant_size_array(lm)) {
-            emit(1 + depth, "try {");
-            emit_start(2 + depth, "this->%s", lm->membername);
+            int try_catch = getopt_get_bool(lcm->gopt, "cpp-decode-try-catch");
+            if (try_catch)
+                emit(1 + depth, "try {");
+            emit_start(1 + depth + try_catch, "this->%s", lm->membername);
             for (int i = 0; i < depth; i++) {
                 emit_continue("[a%d]", i);
             }
             emit_end(".resize(%s%s);", dim_size_prefix(dim->size), dim->size);
-            emit(1 + depth, "} catch (...) {");
-            emit(2 + depth, "return -1;");
-            emit(1 + depth, "}");
+            if (try_catch) {
+                emit(1 + depth, "} catch (...) {");
+                emit(2 + depth, "return -1;");
+                emit(1 + depth, "}");
+            }
         }
         emit(1 + depth, "for (int a%d = 0; a%d < %s%s; a%d++) {", depth, depth,
              dim_size_prefix(dim->size), dim->size, depth);
@@ -792,6 +1526,41 @@ static void _decode_recursive(lcmgen_t *lcm, FILE *f, lcm_member_t *lm, int dept
     }
 }
 
+// Emits the bounds check of a whole array member before it's decoded, so
+// that no length makes it allocate more elements than the bytes left could
+// encode, and arrays of types with a constant encoded size are decoded
+// without checking each element.
+static void emit_decode_array_check(lcmgen_t *lcm, FILE *f, lcm_member_t *lm)
+{
+    int fixed_size = fixed_element_encoded_size(lcm, lm);
+    if (lcm_is_constant_size_array(lm)) {
+        // primitive arrays are checked as they are decoded
+        if (fixed_size >= 0 && g_ptr_array_size(lm->dimensions) > 0 &&
+            !lcm_is_primitive_type(lm->type->lctypename))
+            emit(1, "if(maxlen - pos < %d) return -1;",
+                 lcm_get_fixed_member_encoded_size(lcm, lm));
+        return;
+    }
+
+    emit_bounded_dims_check(f, 1, lm);
+
+    int min_size = fixed_size >= 0 ? fixed_size : min_element_encoded_size(lcm, lm, 0);
+    if (min_size <= 0)
+        return;
+    emit(1, "{");
+    emit(2, "int64_t __elements = 1;");
+    // from the last dimension, so that an empty one allows any number of the
+    // empty arrays
+    int ndim = g_ptr_array_size(lm->dimensions);
+    for (int d = ndim - 1; d >= 0; d--) {
+        lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+        emit(2, "%s__lcm_check_array_dim(&__elements, %s%s, maxlen - pos, %d)%s",
+             d == ndim - 1 ? "if(" : "   ", dim_size_prefix(dim->size), dim->size, min_size,
+             d == 0 ? ") return -1;" : " ||");
+    }
+    emit(1, "}");
+}
+
 static void emit_decode_nohash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
 {
     const char *sn = ls->structname->shortname;
@@ -806,6 +1575,24 @@ static void emit_decode_nohash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
         return;
     }
 
+    if (get_constant_encoded_size(lcm, ls) >= 0) {
+        // clang-format off
+        emit(0, "int %s::_decodeNoHash(const void *buf, int offset, int maxlen)", sn);
+        emit(0, "{");
+        emit(1,     "if (maxlen < ENCODED_SIZE - 8) return -1;");
+        emit(1,     "int pos = 0;");
+        emit(0, "");
+        // clang-format on
+        for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++)
+            emit_fixed_member(lcm, f, (lcm_member_t *) g_ptr_array_index(ls->members, m),
+                              "decode");
+        emit(0, "");
+        emit(1, "return pos;");
+        emit(0, "}");
+        emit(0, "");
+        return;
+    }
+
     // clang-format off
     emit(0, "int %s::_decodeNoHash(const void *buf, int offset, int maxlen)", sn);
     emit(0, "{");
@@ -821,7 +1608,8 @@ static void emit_decode_nohash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
                 emit(1, "tlen = __int32_t_decode_array(");
                 emit(1, "    buf, offset + pos, maxlen - pos, &__%s_len__, 1);", lm->membername);
                 emit(1, "if(tlen < 0) return tlen; else pos += tlen;");
-                emit(1, "if(__%s_len__ > maxlen - pos) return -1;", lm->membername);
+                emit(1, "if(__%s_len__ < 1 || __%s_len__ > maxlen - pos) return -1;",
+                     lm->membername, lm->membername);
                 emit(1, "this->%s.assign(", lm->membername);
                 emit(1, "    static_cast<const char*>(buf) + offset + pos, __%s_len__ - 1);",
                      lm->membername);
@@ -832,6 +1620,7 @@ static void emit_decode_nohash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
                 emit(1, "if(tlen < 0) return tlen; else pos += tlen;");
             }
         } else {
+            emit_decode_array_check(lcm, f, lm);
             _decode_recursive(lcm, f, lm, 0);
         }
 
@@ -842,8 +1631,436 @@ static void emit_decode_nohash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
     emit(0, "");
 }
 
+// Emits the skipping of a member that isn't fixed size, or has the lengths of
+// arrays.  The lengths are kept in locals named like the members.
+static void emit_skip_member(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls, lcm_member_t *lm)
+{
+    int ndim = g_ptr_array_size(lm->dimensions);
+    int fixed_size = lcm_get_fixed_member_encoded_size(lcm, lm);
+    if (lcm_is_dimension_member(ls, lm)) {
+        char *type = map_type_name(lm->type->lctypename);
+        emit(1, "%s __%s;", type, lm->membername);
+        emit(1, "tlen = __%s_decode_array(buf, offset + pos, maxlen - pos, &__%s, 1);",
+             lm->type->lctypename, lm->membername);
+        emit(1, "if(tlen < 0) return tlen; else pos += tlen;");
+        free(type);
+        return;
+    }
+    if (fixed_size >= 0) {
+        emit(1, "if (maxlen - pos < %d) return -1;", fixed_size);
+        emit(1, "pos += %d;", fixed_size);
+        return;
+    }
+
+    // the lengths are checked first, so that a bad one can't make this loop
+    // for long, or overflow
+    for (int d = 0; d < ndim; d++) {
+        lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+        if (dim->mode == LCM_VAR)
+            emit(1, "if (__%s < 0 || __%s > maxlen) return -1;", dim->size, dim->size);
+    }
+
+    if (lcm_is_primitive_type(lm->type->lctypename) && strcmp(lm->type->lctypename, "string")) {
+        emit(1, "{");
+        emit(2, "int64_t count = 1;");
+        for (int d = 0; d < ndim; d++) {
+            lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+            emit(2, "count *= %s%s;", dim->mode == LCM_VAR ? "__" : "", dim->size);
+            emit(2, "if (count > maxlen) return -1;");
+        }
+        int size = lcm_get_primitive_encoded_size(lm->type->lctypename);
+        emit(2, "if (count * %d > maxlen - pos) return -1;", size);
+        emit(2, "pos += static_cast<int>(count * %d);", size);
+        emit(1, "}");
+        return;
+    }
+
+    for (int d = 0; d < ndim; d++) {
+        lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+        emit(1 + d, "for (int64_t a%d = 0; a%d < %s%s; a%d++) {", d, d,
+             dim->mode == LCM_VAR ? "__" : "", dim->size, d);
+    }
+    if (!strcmp(lm->type->lctypename, "string")) {
+        emit(1 + ndim, "int32_t __%s_len__;", lm->membername);
+        emit(1 + ndim, "tlen = __int32_t_decode_array(");
+        emit(1 + ndim, "    buf, offset + pos, maxlen - pos, &__%s_len__, 1);", lm->membername);
+        emit(1 + ndim, "if(tlen < 0) return tlen; else pos += tlen;");
+        emit(1 + ndim, "if(__%s_len__ < 1 || __%s_len__ > maxlen - pos ||", lm->membername,
+             lm->membername);
+        emit(1 + ndim, "   static_cast<const char*>(buf)[offset + pos + __%s_len__ - 1] != 0)",
+             lm->membername);
+        emit(2 + ndim, "return -1;");
+        emit(1 + ndim, "pos += __%s_len__;", lm->membername);
+    } else {
+        char *type = map_type_name(lm->type->lctypename);
+        emit(1 + ndim, "tlen = %s::_skipNoHash(buf, offset + pos, maxlen - pos, -1);", type);
+        emit(1 + ndim, "if(tlen < 0) return tlen; else pos += tlen;");
+        free(type);
+    }
+    for (int d = ndim - 1; d >= 0; d--)
+        emit(1 + d, "}");
+}
+
+static void emit_skip_nohash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    const char *sn = ls->structname->shortname;
+    if (0 == g_ptr_array_size(ls->members)) {
+        // clang-format off
+        emit(0, "int %s::_skipNoHash(const void *, int, int, int)", sn);
+        emit(0, "{");
+        emit(1,     "return 0;");
+        emit(0, "}");
+        emit(0, "");
+        // clang-format on
+        return;
+    }
+
+    // the buffer is only read for the lengths of strings and arrays
+    int reads = 0;
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        if (lcm_is_dimension_member(ls, lm) || lcm_get_fixed_member_encoded_size(lcm, lm) < 0)
+            reads = 1;
+    }
+
+    // clang-format off
+    if (reads) {
+        emit(0, "int %s::_skipNoHash(const void *buf, int offset, int maxlen, int member)", sn);
+        emit(0, "{");
+        emit(1,     "int pos = 0, tlen;");
+    } else {
+        emit(0, "int %s::_skipNoHash(const void *, int, int maxlen, int member)", sn);
+        emit(0, "{");
+        emit(1,     "int pos = 0;");
+    }
+    emit(0, "");
+    // clang-format on
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        emit(1, "if (member == %u) return pos;", m);
+        emit_skip_member(lcm, f, ls, (lcm_member_t *) g_ptr_array_index(ls->members, m));
+        emit(0, "");
+    }
+    emit(1, "return pos;");
+    emit(0, "}");
+    emit(0, "");
+}
+
+// Emits the start of a View accessor, up to where the offset of member m is
+// in pos.
+static void emit_view_accessor_start(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls, unsigned int m)
+{
+    const char *sn = ls->structname->shortname;
+    lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+    if (view_has_columns(lcm, ls, lm)) {
+        char *type = map_type_name(lm->type->lctypename);
+        emit(0, "void %s::View::%s(%s::Columns &columns) const", sn, lm->membername, type);
+        free(type);
+    } else {
+        char *type = view_accessor_type(lm);
+        emit(0, "%s%s%s::View::%s() const", type, type[strlen(type) - 1] == '*' ? "" : " ", sn,
+             lm->membername);
+        g_free(type);
+    }
+    emit(0, "{");
+    int offset = get_constant_member_offset(lcm, ls, m);
+    if (offset >= 0)
+        emit(1, "const int pos = %d;", offset);
+    else
+        emit(1, "const int pos = %s::_skipNoHash(_buf, 0, _size, %u);", sn, m);
+}
+
+static void emit_decode_columns(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    const char *sn = ls->structname->shortname;
+    int try_catch = getopt_get_bool(lcm->gopt, "cpp-decode-try-catch");
+    int stride = get_constant_encoded_size(lcm, ls);
+    // clang-format off
+    emit(0, "int %s::decodeColumns(const void *buf, int offset, int maxlen,", sn);
+    emit(0, "    Columns &columns, int n)");
+    emit(0, "{");
+    emit(1,     "if (n < 0 || n > maxlen / %d) return -1;", stride);
+    emit(1,     "const uint8_t *p = static_cast<const uint8_t*>(buf) + offset;");
+    // clang-format on
+    if (try_catch)
+        emit(1, "try {");
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        emit(1 + try_catch, "columns.%s.resize(n);", lm->membername);
+    }
+    if (try_catch) {
+        emit(1, "} catch (...) {");
+        emit(2, "return -1;");
+        emit(1, "}");
+    }
+    emit(1, "if (n > 0) {");
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        emit(2, "__lcm_decode_column(p + %d, %d, &columns.%s[0], n);",
+             get_constant_member_offset(lcm, ls, m), stride, lm->membername);
+    }
+    emit(1, "}");
+    emit(1, "return n * %d;", stride);
+    emit(0, "}");
+    emit(0, "");
+}
+
+static void emit_visit(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    const char *sn = ls->structname->shortname;
+    const char *ref = strcmp(getopt_get_string(lcm->gopt, "cpp-std"), "c++11") ? "&" : "&&";
+    for (int constness = 0; constness < 2; constness++) {
+        emit(0, "template <class Visitor>");
+        emit(0, "void %s::visit(Visitor %svisitor)%s", sn, ref, constness ? " const" : "");
+        emit(0, "{");
+        if (!g_ptr_array_size(ls->members))
+            emit(1, "(void) visitor;");
+        for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+            lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+            emit(1, "visitor(\"%s\", this->%s);", lm->membername, lm->membername);
+        }
+        emit(0, "}");
+        emit(0, "");
+    }
+}
+
+static void emit_view(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    const char *sn = ls->structname->shortname;
+    uint64_t fingerprint;
+    const char *hash = get_hash_constant(lcm, ls, &fingerprint) ? "HASH" : "getHash()";
+    // clang-format off
+    emit(0, "int %s::View::decode(const void *buf, int offset, int maxlen)", sn);
+    emit(0, "{");
+    emit(1,     "int pos = 0, thislen;");
+    emit(1,     "int64_t msg_hash;");
+    emit(0, "");
+    emit(1,     "thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &msg_hash, 1);");
+    emit(1,     "if (thislen < 0) return thislen; else pos += thislen;");
+    emit(1,     "if (msg_hash != %s::%s) return -1;", sn, hash);
+    emit(0, "");
+    emit(1,     "thislen = this->_decodeNoHash(buf, offset + pos, maxlen - pos);");
+    emit(1,     "if (thislen < 0) return thislen; else pos += thislen;");
+    emit(0, "");
+    emit(1,     "return pos;");
+    emit(0, "}");
+    emit(0, "");
+    emit(0, "int %s::View::_decodeNoHash(const void *buf, int offset, int maxlen)", sn);
+    emit(0, "{");
+    emit(1,     "int tlen = %s::_skipNoHash(buf, offset, maxlen, -1);", sn);
+    emit(1,     "if (tlen < 0) return tlen;");
+    emit(1,     "_buf = static_cast<const uint8_t*>(buf) + offset;");
+    emit(1,     "_size = tlen;");
+    emit(1,     "return tlen;");
+    emit(0, "}");
+    emit(0, "");
+    // clang-format on
+
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        if (!view_has_accessor(lcm, ls, lm))
+            continue;
+
+        emit_view_accessor_start(lcm, f, ls, m);
+        char *type = map_type_name(lm->type->lctypename);
+        if (view_has_columns(lcm, ls, lm)) {
+            lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, 0);
+            if (dim->mode == LCM_VAR) {
+                emit(1, "%s::decodeColumns(_buf, pos, _size - pos, columns,", type);
+                emit(1, "    static_cast<int>(%s()));", dim->size);
+            } else {
+                emit(1, "%s::decodeColumns(_buf, pos, _size - pos, columns, %s);", type,
+                     dim->size);
+            }
+        } else if (g_ptr_array_size(lm->dimensions)) {
+            lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, 0);
+            if (dim->mode == LCM_VAR)
+                emit(1, "return lcm::ArrayView<%s>(_buf + pos, static_cast<int>(%s()));", type,
+                     dim->size);
+            else
+                emit(1, "return lcm::ArrayView<%s>(_buf + pos, %s);", type, dim->size);
+        } else if (!strcmp(lm->type->lctypename, "string")) {
+            emit(1, "return reinterpret_cast<const char*>(_buf) + pos + 4;");
+        } else if (!lcm_is_primitive_type(lm->type->lctypename)) {
+            emit(1, "%s::View view;", type);
+            emit(1, "view._decodeNoHash(_buf, pos, _size - pos);");
+            emit(1, "return view;");
+        } else {
+            emit(1, "%s value;", type);
+            emit(1, "__%s_decode_array(_buf, pos, %d, &value, 1);", lm->type->lctypename,
+                 lcm_get_primitive_encoded_size(lm->type->lctypename));
+            emit(1, "return value;");
+        }
+        emit(0, "}");
+        emit(0, "");
+        free(type);
+    }
+}
+
+// Emits <package>/lcm_registry.hpp, which finds the message types of a package
+// by fingerprint. ls is the first struct of the package.
+static int emit_registry(lcmgen_t *lcmgen, lcm_struct_t *ls)
+{
+    const char *package = ls->structname->package;
+    const char *cpp_include = getopt_get_string(lcmgen->gopt, "cpp-include");
+    const char *cpp_include_sep = strlen(cpp_include) > 0 ? G_DIR_SEPARATOR_S : "";
+    const char *ref = strcmp(getopt_get_string(lcmgen->gopt, "cpp-std"), "c++11") ? "&" : "&&";
+
+    char *package_ = dots_to_slashes(package);
+    char *guard = dots_to_underscores(package);
+    char *header_name = g_strdup_printf(
+        "%s%s%s" G_DIR_SEPARATOR_S "lcm_registry.hpp", getopt_get_string(lcmgen->gopt, "cpp-hpath"),
+        strlen(getopt_get_string(lcmgen->gopt, "cpp-hpath")) > 0 ? G_DIR_SEPARATOR_S : "", package_);
+
+    make_dirs_for_file(header_name);
+    FILE *f = lcm_fopen_output(lcmgen, header_name);
+    if (f == NULL)
+        return -1;
+
+    GArray *registry = lcm_get_package_registry(lcmgen, package);
+
+    emit_auto_generated_warning(f);
+    fprintf(f, "#ifndef __%s_lcm_registry_hpp__\n", guard);
+    fprintf(f, "#define __%s_lcm_registry_hpp__\n", guard);
+    fprintf(f, "\n");
+    if (getopt_get_bool(lcmgen->gopt, "use-quotes-for-includes"))
+        fprintf(f, "#include \"lcm/lcm_coretypes.h\"\n");
+    else
+        fprintf(f, "#include <lcm/lcm_coretypes.h>\n");
+    fprintf(f, "\n");
+    for (unsigned int i = 0; i < registry->len; i++) {
+        lcm_struct_t *entry_ls = g_array_index(registry, lcm_registered_struct_t, i).ls;
+        char *tn_ = dots_to_slashes(entry_ls->structname->lctypename);
+        emit(0, "#include \"%s%s%s.hpp\"", cpp_include, cpp_include_sep, tn_);
+        free(tn_);
+    }
+    fprintf(f, "\n");
+    emit_package_namespace_start(lcmgen, f, ls);
+
+    // clang-format off
+    emit(0, "");
+    emit(0, "/**");
+    emit(0, " * Finds the message types of package %s by their fingerprint, the first", package);
+    emit(0, " * 8 bytes of an encoded message.");
+    emit(0, " */");
+    emit(0, "class lcm_registry");
+    emit(0, "{");
+    emit(1, "public:");
+    emit(2, "/**");
+    emit(2, " * A message type of the package.");
+    emit(2, " */");
+    emit(2, "struct entry {");
+    emit(3, "int64_t fingerprint;");
+    emit(3, "const char *name;");
+    emit(2, "};");
+    emit(0, "");
+    emit(2, "/**");
+    emit(2, " * Returns the message types, sorted by fingerprint, and sets");
+    emit(2, " * num_entries to their number.");
+    emit(2, " */");
+    emit(2, "inline static const entry *entries(int &num_entries);");
+    emit(0, "");
+    emit(2, "/**");
+    emit(2, " * Returns the message type with a fingerprint, or NULL.");
+    emit(2, " */");
+    emit(2, "inline static const entry *find(int64_t fingerprint);");
+    emit(0, "");
+    emit(2, "/**");
+    emit(2, " * Decodes an encoded message of any type of the package, and calls");
+    emit(2, " * handler(msg) with the decoded message.  A handler with an overload or");
+    emit(2, " * template for each message type is specialized for it at compile time,");
+    emit(2, " * and can call visit() on the message.");
+    emit(2, " *");
+    emit(2, " * @return The number of bytes decoded, or <0 if the message isn't of a");
+    emit(2, " * type of the package or couldn't be decoded.");
+    emit(2, " */");
+    emit(2, "template <class Handler>");
+    emit(2, "inline static int decode(const void *buf, int offset, int maxlen,");
+    emit(2, "                         Handler %shandler);", ref);
+    emit(0, "};");
+    emit(0, "");
+
+    emit(0, "const lcm_registry::entry *lcm_registry::entries(int &num_entries)");
+    emit(0, "{");
+    emit(1,     "static const entry table[] = {");
+    if (registry->len == 0)
+        emit(2,     "{0, NULL},");
+    for (unsigned int i = 0; i < registry->len; i++) {
+        lcm_registered_struct_t *entry = &g_array_index(registry, lcm_registered_struct_t, i);
+        emit(2,     "{(int64_t) 0x%016" PRIx64 "ULL, \"%s\"},", (uint64_t) entry->fingerprint,
+             entry->ls->structname->lctypename);
+    }
+    emit(1,     "};");
+    emit(1,     "num_entries = %u;", registry->len);
+    emit(1,     "return table;");
+    emit(0, "}");
+    emit(0, "");
+
+    emit(0, "const lcm_registry::entry *lcm_registry::find(int64_t fingerprint)");
+    emit(0, "{");
+    emit(1,     "int num_entries;");
+    emit(1,     "const entry *table = entries(num_entries);");
+    emit(1,     "int lo = 0, hi = num_entries;");
+    emit(1,     "while (lo < hi) {");
+    emit(2,         "int mid = lo + (hi - lo) / 2;");
+    emit(2,         "if (table[mid].fingerprint < fingerprint)");
+    emit(3,             "lo = mid + 1;");
+    emit(2,         "else");
+    emit(3,             "hi = mid;");
+    emit(1,     "}");
+    emit(1,     "if (lo < num_entries && table[lo].fingerprint == fingerprint)");
+    emit(2,         "return &table[lo];");
+    emit(1,     "return NULL;");
+    emit(0, "}");
+    emit(0, "");
+
+    emit(0, "template <class Handler>");
+    emit(0, "int lcm_registry::decode(const void *buf, int offset, int maxlen,");
+    emit(0, "                         Handler %shandler)", ref);
+    emit(0, "{");
+    emit(1,     "int64_t fingerprint;");
+    emit(1,     "if (__int64_t_decode_array(buf, offset, maxlen, &fingerprint, 1) < 0)");
+    emit(2,         "return -1;");
+    emit(0, "");
+    emit(1,     "// unsigned, so that fingerprints of 2^63 and above are valid case labels");
+    emit(1,     "switch ((uint64_t) fingerprint) {");
+    for (unsigned int i = 0; i < registry->len; i++) {
+        lcm_registered_struct_t *entry = &g_array_index(registry, lcm_registered_struct_t, i);
+        char *tn = dots_to_double_colons(entry->ls->structname->lctypename);
+        emit(2,     "case 0x%016" PRIx64 "ULL: {", (uint64_t) entry->fingerprint);
+        emit(3,         "::%s msg;", tn);
+        emit(3,         "int status = msg.decode(buf, offset, maxlen);");
+        emit(3,         "if (status >= 0)");
+        emit(4,             "handler(msg);");
+        emit(3,         "return status;");
+        emit(2,     "}");
+        free(tn);
+    }
+    emit(2,     "default:");
+    emit(3,         "(void) handler;");
+    emit(3,         "return -1;");
+    emit(1,     "}");
+    emit(0, "}");
+    emit(0, "");
+    // clang-format on
+
+    emit_package_namespace_close(lcmgen, f, ls);
+    emit(0, "#endif");
+
+    g_array_free(registry, TRUE);
+    g_free(header_name);
+    free(guard);
+    free(package_);
+    return lcm_fclose_output(lcmgen, f) ? -1 : 0;
+}
+
 int emit_cpp(lcmgen_t *lcmgen)
 {
+    if (getopt_get_bool(lcmgen->gopt, "cpp-pmr") &&
+        strcmp(getopt_get_string(lcmgen->gopt, "cpp-std"), "c++11")) {
+        printf("--cpp-pmr needs --cpp-std=c++11\n");
+        return -1;
+    }
+
     // iterate through all defined message types
     for (unsigned int i = 0; i < g_ptr_array_size(lcmgen->structs); i++) {
         lcm_struct_t *structure = (lcm_struct_t *) g_ptr_array_index(lcmgen->structs, i);
@@ -860,14 +2077,18 @@ int emit_cpp(lcmgen_t *lcmgen)
         if (lcm_needs_generation(lcmgen, structure->lcmfile, header_name)) {
             make_dirs_for_file(header_name);
 
-            FILE *f = fopen(header_name, "w");
+            FILE *f = lcm_fopen_output(lcmgen, header_name);
             if (f == NULL)
                 return -1;
 
             emit_header_start(lcmgen, f, structure);
             emit_encode(lcmgen, f, structure);
             emit_decode(lcmgen, f, structure);
+            if (getopt_get_bool(lcmgen->gopt, "cpp-pmr"))
+                emit_allocator_support(lcmgen, f, structure);
             emit_encoded_size(lcmgen, f, structure);
+            emit_clear_for_decode(lcmgen, f, structure);
+            emit_swap(lcmgen, f, structure);
             emit_get_hash(lcmgen, f, structure);
 
             // clang-format off
@@ -882,15 +2103,32 @@ int emit_cpp(lcmgen_t *lcmgen)
             emit_decode_nohash(lcmgen, f, structure);
             emit_encoded_size_nohash(lcmgen, f, structure);
             emit_compute_hash(lcmgen, f, structure);
+            emit_skip_nohash(lcmgen, f, structure);
+            if (has_columns(lcmgen, structure))
+                emit_decode_columns(lcmgen, f, structure);
+            if (has_visit(structure))
+                emit_visit(lcmgen, f, structure);
+            if (has_view(structure))
+                emit_view(lcmgen, f, structure);
 
             emit_package_namespace_close(lcmgen, f, structure);
             emit(0, "#endif");
 
-            fclose(f);
+            lcm_fclose_output(lcmgen, f);
         }
         g_free(header_name);
         free(tn_);
     }
 
+    if (getopt_get_bool(lcmgen->gopt, "cpp-registry")) {
+        for (unsigned int i = 0; i < g_ptr_array_size(lcmgen->structs); i++) {
+            lcm_struct_t *structure = (lcm_struct_t *) g_ptr_array_index(lcmgen->structs, i);
+
+            if (strlen(structure->structname->package) > 0 &&
+                lcm_is_first_in_package(lcmgen, structure) && emit_registry(lcmgen, structure))
+                return -1;
+        }
+    }
+
     return 0;
 }
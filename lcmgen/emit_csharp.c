@@ -197,6 +197,23 @@ static const char *dim_size_prefix(const char *dim_size)
         return "this.";
 }
 
+// Returns the size of the elements of one dimensional arrays of type that
+// are copied with a single ReadArray/WriteArray call, or 0.
+static int bulk_array_element_size(lcm_member_t *lm)
+{
+    const char *type = lm->type->lctypename;
+
+    if (g_ptr_array_size(lm->dimensions) != 1)
+        return 0;
+    if (!strcmp(type, "int16_t"))
+        return 2;
+    if (!strcmp(type, "int32_t") || !strcmp(type, "float"))
+        return 4;
+    if (!strcmp(type, "int64_t") || !strcmp(type, "double"))
+        return 8;
+    return 0;
+}
+
 int emit_csharp(lcmgen_t *lcm)
 {
     GHashTable *type_table = g_hash_table_new(g_str_hash, g_str_equal);
@@ -244,7 +261,7 @@ int emit_csharp(lcmgen_t *lcm)
         if (getopt_get_bool(lcm->gopt, "csharp-mkdir"))
             make_dirs_for_file(path);
 
-        FILE *f = fopen(path, "w");
+        FILE *f = lcm_fopen_output(lcm, path);
         if (f == NULL)
             return -1;
 
@@ -343,7 +360,7 @@ int emit_csharp(lcmgen_t *lcm)
         emit(0, "}");
         // clang-format on
 
-        fclose(f);
+        lcm_fclose_output(lcm, f);
     }
 
     for (unsigned int st = 0; st < g_ptr_array_size(lcm->structs); st++) {
@@ -363,7 +380,7 @@ int emit_csharp(lcmgen_t *lcm)
         if (getopt_get_bool(lcm->gopt, "csharp-mkdir"))
             make_dirs_for_file(path);
 
-        FILE *f = fopen(path, "w");
+        FILE *f = lcm_fopen_output(lcm, path);
         if (f == NULL)
             return -1;
 
@@ -542,6 +559,15 @@ int emit_csharp(lcmgen_t *lcm)
                 (primitive_info_t *) g_hash_table_lookup(type_table, lm->type->lctypename);
             make_accessor(lm, "this", accessor);
 
+            int element_size = bulk_array_element_size(lm);
+            if (element_size) {
+                lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, 0);
+                emit(3, "outs.WriteArray(this.%s, %d, (int) %s%s);", lm->membername, element_size,
+                     dim_size_prefix(dim->size), dim->size);
+                emit(0, " ");
+                continue;
+            }
+
             for (unsigned int i = 0; i < g_ptr_array_size(lm->dimensions); i++) {
                 lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, i);
                 emit(3 + i, "for (int %c = 0; %c < %s%s; %c++) {", 'a' + i, 'a' + i,
@@ -629,6 +655,15 @@ int emit_csharp(lcmgen_t *lcm)
                 emit_end(";");
             }
 
+            int element_size = bulk_array_element_size(lm);
+            if (element_size) {
+                lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, 0);
+                emit(3, "ins.ReadArray(this.%s, %d, (int) %s%s);", lm->membername, element_size,
+                     dim_size_prefix(dim->size), dim->size);
+                emit(0, " ");
+                continue;
+            }
+
             for (unsigned int i = 0; i < g_ptr_array_size(lm->dimensions); i++) {
                 lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, i);
                 emit(3 + i, "for (int %c = 0; %c < %s%s; %c++) {", 'a' + i, 'a' + i,
@@ -738,7 +773,7 @@ int emit_csharp(lcmgen_t *lcm)
         ////////
         emit(1, "}");
         emit(0, "}\n");
-        fclose(f);
+        lcm_fclose_output(lcm, f);
     }
 
     return 0;
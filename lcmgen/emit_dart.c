@@ -200,9 +200,30 @@ static void emit_decode_one(FILE *f, const char *type_name, const char *accessor
     }
 }
 
+// Returns the LcmBuffer method that reads an array of type_name into a typed
+// list, or NULL if its elements are read one at a time.
+static const char *typed_list_getter(const char *type_name)
+{
+    if (!strcmp(type_name, "byte"))
+        return "getUint8View";
+    if (!strcmp(type_name, "int8_t"))
+        return "getInt8List";
+    if (!strcmp(type_name, "int16_t"))
+        return "getInt16List";
+    if (!strcmp(type_name, "int32_t"))
+        return "getInt32List";
+    if (!strcmp(type_name, "int64_t"))
+        return "getInt64List";
+    if (!strcmp(type_name, "float"))
+        return "getFloat32List";
+    if (!strcmp(type_name, "double"))
+        return "getFloat64List";
+    return NULL;
+}
+
 static int emit_struct(lcmgen_t *lcm, lcm_struct_t *ls, const char *path)
 {
-    FILE *f = fopen(path, "w");
+    FILE *f = lcm_fopen_output(lcm, path);
     if (f == NULL) {
         perror(path);
         return -1;
@@ -248,9 +269,9 @@ static int emit_struct(lcmgen_t *lcm, lcm_struct_t *ls, const char *path)
         if (lm->dimensions->len == 0) {
             emit(1, "%s %s;", map_type_dart(lm->type->lctypename), lm->membername);
         } else {
-            emit_start(1, "List");
+            emit_start(1, "");
             for (unsigned int j = 0; j < lm->dimensions->len; j++) {
-                emit_continue("<");
+                emit_continue("List<");
             }
             emit_continue("%s", map_type_dart(lm->type->lctypename));
             for (unsigned int j = 0; j < lm->dimensions->len; j++) {
@@ -362,21 +383,37 @@ static int emit_struct(lcmgen_t *lcm, lcm_struct_t *ls, const char *path)
         } else {
             // Array
             // Create nested list structure
-            emit_start(2, "final %s = ", lm->membername);
-            emit_continue("List.generate(");
+            // The innermost dimension of a numeric array is read as one
+            // typed list
+            const char *getter = typed_list_getter(lm->type->lctypename);
+            unsigned int nlists = getter ? lm->dimensions->len - 1 : lm->dimensions->len;
 
-            lcm_dimension_t *first_dim =
-                (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, 0);
-            emit_continue("%s, (_) => ", first_dim->size);
+            emit_start(2, "final %s = ", lm->membername);
 
-            for (unsigned int dim = 1; dim < lm->dimensions->len; dim++) {
+            for (unsigned int dim = 0; dim < nlists; dim++) {
                 lcm_dimension_t *ld =
                     (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, dim);
-                emit_continue("List.generate(%s, (_) => ", ld->size);
+                if (getter) {
+                    // name the element type, so that the lists hold List<int>
+                    // rather than only the typed lists read here
+                    emit_continue("List<");
+                    for (unsigned int j = dim + 1; j < lm->dimensions->len; j++)
+                        emit_continue("List<");
+                    emit_continue("%s", map_type_dart(lm->type->lctypename));
+                    for (unsigned int j = dim + 1; j < lm->dimensions->len; j++)
+                        emit_continue(">");
+                    emit_continue(">.generate(%s, (_) => ", ld->size);
+                } else {
+                    emit_continue("List.generate(%s, (_) => ", ld->size);
+                }
             }
 
             // Now emit the decode call for the innermost element
-            if (!strcmp(lm->type->lctypename, "byte")) {
+            if (getter) {
+                lcm_dimension_t *ld = (lcm_dimension_t *) g_ptr_array_index(
+                    lm->dimensions, lm->dimensions->len - 1);
+                emit_continue("buf.%s(%s)", getter, ld->size);
+            } else if (!strcmp(lm->type->lctypename, "byte")) {
                 emit_continue("buf.getUint8()");
             } else if (!strcmp(lm->type->lctypename, "int8_t")) {
                 emit_continue("buf.getInt8()");
@@ -403,7 +440,7 @@ static int emit_struct(lcmgen_t *lcm, lcm_struct_t *ls, const char *path)
                 emit_continue("%s.decode(buf)", map_type_dart(lm->type->lctypename));
             }
 
-            for (unsigned int dim = 0; dim < lm->dimensions->len; dim++) {
+            for (unsigned int dim = 0; dim < nlists; dim++) {
                 emit_continue(")");
             }
             emit_end(";");
@@ -423,7 +460,7 @@ static int emit_struct(lcmgen_t *lcm, lcm_struct_t *ls, const char *path)
     emit(0, "}");
 
     free(class_name);
-    fclose(f);
+    lcm_fclose_output(lcm, f);
     return 0;
 }
 
@@ -188,82 +188,6 @@ unsigned int lcm_find_member_with_named_dimension(lcm_struct_t *ls, const char *
     return ls->members->len;
 }
 
-/*
- * Locate the lcm_struct_t of given lcm_member_t from lcmgen_t
- */
-lcm_struct_t *lcm_find_struct(lcmgen_t *lcm, lcm_member_t *lm)
-{
-    int found = FALSE;
-    lcm_struct_t *ls = NULL;
-
-    for (unsigned int s = 0; s < lcm->structs->len; s++) {
-        ls = (lcm_struct_t *) g_ptr_array_index(lcm->structs, s);
-
-        if (strcmp(lm->type->lctypename, ls->structname->lctypename) == 0) {
-            found = TRUE;
-            break;
-        }
-    }
-
-    if (!found) {
-        return NULL;
-    }
-
-    return ls;
-}
-
-/*
- * Calculates the fingerprint during code generation.
- *
- * Algorithm as described in:
- *     https://lcm-proj.github.io/lcm/content/lcm-type-ref.html#fingerprint-computation
- *
- * Returns calculated fingerprint or 0 on error
- */
-struct __fingerprints {
-    const struct __fingerprints *parent;
-    uint64_t fingerprint;
-};
-
-uint64_t __lcm_recursive_fingerprint(lcmgen_t *lcm, lcm_struct_t *ls,
-                                     const struct __fingerprints *fs)
-{
-    uint64_t fingerprint = ls->hash;
-
-    // Check if we are present in list of hashes, bail out if its the case
-    for (const struct __fingerprints *fs_ = fs; fs_ != NULL; fs_ = fs_->parent) {
-        if (fs_->fingerprint == fingerprint) {
-            return 0;
-        }
-    }
-    struct __fingerprints fp;
-    fp.parent = fs;
-    fp.fingerprint = fingerprint;
-
-    // Compute hash for all members
-    for (unsigned int m = 0; m < ls->members->len; m++) {
-        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
-
-        if (!lcm_is_primitive_type(lm->type->lctypename)) {
-            lcm_struct_t *ls_ = lcm_find_struct(lcm, lm);
-
-            if (ls_ != NULL) {
-                fingerprint += __lcm_recursive_fingerprint(lcm, ls_, &fp);
-            } else {
-                fprintf(stderr, "Unable to locate fingerprint for member '%s' of '%s'\n",
-                        lm->membername, ls->structname->shortname);
-                return 0;
-            }
-        }
-    }
-
-    return (fingerprint << 1) + (fingerprint >> 63);
-}
-uint64_t lcm_get_fingerprint(lcmgen_t *lcm, lcm_struct_t *ls)
-{
-    return __lcm_recursive_fingerprint(lcm, ls, NULL);
-}
-
 /*
  * Returns the index of the first dimension named name or dimensions->len if
  * not found.
@@ -1333,7 +1257,7 @@ int emit_go_lcm(lcmgen_t *lcm, lcm_struct_t *ls, const char *const dir, int64_t
         }
     }
 
-    FILE *f = fopen(path, "w");
+    FILE *f = lcm_fopen_output(lcm, path);
     if (f == NULL) {
         perror(path);
         res = -1;
@@ -1390,7 +1314,7 @@ int emit_go_lcm(lcmgen_t *lcm, lcm_struct_t *ls, const char *const dir, int64_t
     emit_go_lcm_size(f, lcm, ls, gotype, fingerprint);
 
 ret_file:
-    fclose(f);
+    lcm_fclose_output(lcm, f);
 
 ret_free:
     free(typename);
@@ -1411,7 +1335,7 @@ int emit_go_gopacket(lcmgen_t *lcm, lcm_struct_t *ls, const char *const dir, int
     if (!lcm_needs_generation(lcm, ls->lcmfile, path))
         return 0;
 
-    FILE *f = fopen(path, "w");
+    FILE *f = lcm_fopen_output(lcm, path);
     if (f == NULL)
         return -1;
 
@@ -1513,7 +1437,7 @@ int emit_go_gopacket(lcmgen_t *lcm, lcm_struct_t *ls, const char *const dir, int
     free(path);
     free(typename);
 
-    fclose(f);
+    lcm_fclose_output(lcm, f);
 
     return 0;
 }
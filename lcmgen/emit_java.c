@@ -237,6 +237,23 @@ static const char *dim_size_prefix(const char *dim_size)
         return "this.";
 }
 
+// The suffix of the static LCMDataInputStream and LCMDataOutputStream methods
+// that read and write whole arrays of a primitive type, or NULL.
+static const char *bulk_array_suffix(const char *storage)
+{
+    if (!strcmp(storage, "short"))
+        return "Shorts";
+    if (!strcmp(storage, "int"))
+        return "Ints";
+    if (!strcmp(storage, "long"))
+        return "Longs";
+    if (!strcmp(storage, "float"))
+        return "Floats";
+    if (!strcmp(storage, "double"))
+        return "Doubles";
+    return NULL;
+}
+
 void encode_recursive(lcmgen_t *lcm, lcm_member_t *lm, FILE *f, primitive_info_t *pinfo,
                       char *accessor, int depth)
 {
@@ -256,17 +273,20 @@ void encode_recursive(lcmgen_t *lcm, lcm_member_t *lm, FILE *f, primitive_info_t
             return;
         }
 
-        // some other kind of primitive array.
-        // This seems to be slower than the default (and is untested for correctness), hence it is
-        // disabled.
-        if (0 && !strcmp(pinfo->storage, "float")) {
+        // some other kind of primitive array, written in one call
+        const char *suffix = bulk_array_suffix(pinfo->storage);
+        if (suffix) {
             lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, depth);
-
-            emit(2 + depth, "{ ByteBuffer bbuf = ByteBuffer.allocate(%s%s*4);",
-                 dim_size_prefix(dim->size), dim->size);
-            emit(2 + depth, "  bbuf.order(ByteOrder.BIG_ENDIAN);");
-            emit(2 + depth, "  bbuf.asFloatBuffer().put(this.%s);", accessor_array);
-            emit(2 + depth, "  outs.write(bbuf.array()); }");
+            if (dim->mode == LCM_VAR) {
+                // an empty array may be null
+                emit(2 + depth, "if (this.%s > 0)", dim->size);
+                emit(3 + depth,
+                     "lcm.lcm.LCMDataOutputStream.write%s(outs, this.%s, 0, (int) this.%s);", suffix,
+                     accessor_array, dim->size);
+            } else {
+                emit(2 + depth, "lcm.lcm.LCMDataOutputStream.write%s(outs, this.%s, 0, %s);",
+                     suffix, accessor_array, dim->size);
+            }
             return;
         }
     }
@@ -309,17 +329,13 @@ void decode_recursive(lcmgen_t *lcm, lcm_member_t *lm, FILE *f, primitive_info_t
             return;
         }
 
-        // some other kind of primitive array.
-        // This seems to be slower than the default (and is untested for correctness), hence it is
-        // disabled.
-        if (0 && !strcmp(pinfo->storage, "float")) {
+        // some other kind of primitive array, read in one call
+        const char *suffix = bulk_array_suffix(pinfo->storage);
+        if (suffix) {
             lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, depth);
-
-            emit(2 + depth, "{ byte bb[] = new byte[%s%s*4]; ins.readFully(bb);",
-                 dim_size_prefix(dim->size), dim->size);
-            emit(2 + depth, "  ByteBuffer bbuf = ByteBuffer.wrap(bb);");
-            emit(2 + depth, "  bbuf.order(ByteOrder.BIG_ENDIAN);");
-            emit(2 + depth, "  bbuf.asFloatBuffer().get(this.%s); }", accessor_array);
+            emit(2 + depth, "lcm.lcm.LCMDataInputStream.read%s(ins, this.%s, 0, %s%s%s);", suffix,
+                 accessor_array, dim->mode == LCM_VAR ? "(int) " : "", dim_size_prefix(dim->size),
+                 dim->size);
             return;
         }
     }
@@ -452,7 +468,7 @@ int emit_java(lcmgen_t *lcm)
         if (getopt_get_bool(lcm->gopt, "jmkdir"))
             make_dirs_for_file(path);
 
-        FILE *f = fopen(path, "w");
+        FILE *f = lcm_fopen_output(lcm, path);
         if (f == NULL)
             return -1;
 
@@ -548,7 +564,7 @@ int emit_java(lcmgen_t *lcm)
         emit(0, "}");
         // clang-format on
 
-        fclose(f);
+        lcm_fclose_output(lcm, f);
     }
 
     for (unsigned int st = 0; st < g_ptr_array_size(lcm->structs); st++) {
@@ -566,7 +582,7 @@ int emit_java(lcmgen_t *lcm)
         if (getopt_get_bool(lcm->gopt, "jmkdir"))
             make_dirs_for_file(path);
 
-        FILE *f = fopen(path, "w");
+        FILE *f = lcm_fopen_output(lcm, path);
         if (f == NULL)
             return -1;
 
@@ -873,7 +889,7 @@ int emit_java(lcmgen_t *lcm)
 
         ////////
         emit(0, "}\n");
-        fclose(f);
+        lcm_fclose_output(lcm, f);
     }
 
     return 0;
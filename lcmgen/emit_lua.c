@@ -176,6 +176,14 @@ static int _primitive_type_size(const char *tn)
     return 0;
 }
 
+// The name of the local that holds the compiled plan of a big-endian format
+static char *_plan_name(const char *fmt)
+{
+    char *name = g_strdup_printf("_plan_%s", fmt);
+    g_strdelimit(name, "?", '_');
+    return name;
+}
+
 static char *escape_typename_to_variablename(const char *tn)
 {
     char const *varname = g_strdup(tn);
@@ -199,7 +207,7 @@ static void _emit_decode_one(const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls, lcm
     const char *mn = lm->membername;
     const char *sn = lm->type->shortname;
     if (!strcmp("string", tn)) {
-        emit(indent, "local __%s_tmpstrlen = lcm._pack.unpack('>I', data:read(4))", mn);
+        emit(indent, "local __%s_tmpstrlen = _plan_I:unpack(data:read(4))", mn);
         emit(indent, "%s = lcm._pack.prepare_string(data:read(__%s_tmpstrlen))", accessor, mn);
     } else if (!strcmp("byte", tn)) {
         emit(indent, "%s = lcm._pack.unpack('>B', data:read(1))", accessor);
@@ -238,8 +246,12 @@ static void _emit_decode_list(const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls, lc
         !strcmp("int16_t", tn) || !strcmp("int32_t", tn) || !strcmp("int64_t", tn) ||
         !strcmp("float", tn) || !strcmp("double", tn)) {
         if (fixed_len) {
-            emit(indent, "%s = {lcm._pack.unpack('>%s%c', data:read(%d))}", accessor, len,
-                 _struct_format(lm), atoi(len) * _primitive_type_size(tn));
+            char *fmt = g_strdup_printf("%s%c", len, _struct_format(lm));
+            char *plan = _plan_name(fmt);
+            emit(indent, "%s = {%s:unpack(data:read(%d))}", accessor, plan,
+                 atoi(len) * _primitive_type_size(tn));
+            g_free(plan);
+            g_free(fmt);
         } else {
             if (_primitive_type_size(tn) > 1) {
                 emit(indent,
@@ -264,6 +276,13 @@ static void _flush_read_struct_fmt(const lcmgen_t *lcm, FILE *f, GQueue *formats
     if (nfmts == 0)
         return;
 
+    GString *fmt = g_string_new("");
+    while (!g_queue_is_empty(formats)) {
+        g_string_append_c(fmt, (char) GPOINTER_TO_INT(g_queue_pop_head(formats)));
+    }
+    char *plan = _plan_name(fmt->str);
+    g_string_free(fmt, TRUE);
+
     emit_start(1, "");  // for indent
     int fmtsize = 0;
     while (!g_queue_is_empty(members)) {
@@ -274,11 +293,8 @@ static void _flush_read_struct_fmt(const lcmgen_t *lcm, FILE *f, GQueue *formats
         }
         fmtsize += _primitive_type_size(lm->type->lctypename);
     }
-    emit_continue(" = lcm._pack.unpack('>");
-    while (!g_queue_is_empty(formats)) {
-        emit_continue("%c", GPOINTER_TO_INT(g_queue_pop_head(formats)));
-    }
-    emit_end("', data:read(%d))", fmtsize);
+    emit_end(" = %s:unpack(data:read(%d))", plan, fmtsize);
+    g_free(plan);
 }
 
 static void emit_lua_decode_one(const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
@@ -396,7 +412,7 @@ static void _emit_encode_one(const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls, lcm
     const char *mn = lm->membername;
     if (!strcmp("string", tn)) {
         emit(indent, "local __%s_tmpstr = lcm._pack.prepare_string(%s)", mn, accessor);
-        emit(indent, "table.insert(buf_table, lcm._pack.pack('>I', #__%s_tmpstr + 1))", mn);
+        emit(indent, "table.insert(buf_table, _plan_I:pack(#__%s_tmpstr + 1))", mn);
         emit(indent, "table.insert(buf_table, __%s_tmpstr .. '\\0')", mn);
     } else if (!strcmp("byte", tn)) {
         emit(indent, "table.insert(buf_table, lcm._pack.pack('>B', %s))", accessor);
@@ -427,8 +443,11 @@ static void _emit_encode_list(const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls, lc
         !strcmp("int16_t", tn) || !strcmp("int32_t", tn) || !strcmp("int64_t", tn) ||
         !strcmp("float", tn) || !strcmp("double", tn)) {
         if (fixed_len) {
-            emit(indent, "table.insert(buf_table, lcm._pack.pack('>%s%c', unpack(%s)))", len,
-                 _struct_format(lm), accessor);
+            char *fmt = g_strdup_printf("%s%c", len, _struct_format(lm));
+            char *plan = _plan_name(fmt);
+            emit(indent, "table.insert(buf_table, %s:pack(unpack(%s)))", plan, accessor);
+            g_free(plan);
+            g_free(fmt);
         } else {
             emit(indent,
                  "table.insert(buf_table, lcm._pack.pack(string.format('>%%d%c', self.%s), "
@@ -446,11 +465,15 @@ static void _flush_write_struct_fmt(FILE *f, GQueue *formats, GQueue *members)
     assert(g_queue_get_length(formats) == g_queue_get_length(members));
     if (g_queue_is_empty(formats))
         return;
-    emit_start(1, "table.insert(buf_table, lcm._pack.pack('>");
+    GString *fmt = g_string_new("");
     while (!g_queue_is_empty(formats)) {
-        emit_continue("%c", GPOINTER_TO_INT(g_queue_pop_head(formats)));
+        g_string_append_c(fmt, (char) GPOINTER_TO_INT(g_queue_pop_head(formats)));
     }
-    emit_continue("', ");
+    char *plan = _plan_name(fmt->str);
+    g_string_free(fmt, TRUE);
+
+    emit_start(1, "table.insert(buf_table, %s:pack(", plan);
+    g_free(plan);
     while (!g_queue_is_empty(members)) {
         lcm_member_t *lm = (lcm_member_t *) g_queue_pop_head(members);
         emit_continue("self.%s", lm->membername);
@@ -694,6 +717,64 @@ static void emit_lua_locals(const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
     emit(0, "");
 }
 
+static void _add_plan(GHashTable *plans, GPtrArray *formats, const char *fmt)
+{
+    if (!*fmt || g_hash_table_lookup(plans, fmt))
+        return;
+    char *key = g_strdup(fmt);
+    g_hash_table_insert(plans, key, key);
+    g_ptr_array_add(formats, key);
+}
+
+// Emits a compiled plan for each of the formats that don't depend on the
+// message, so that encoding and decoding don't parse them for every message.
+// The members are grouped the same way that emit_lua_decode_one and
+// emit_lua_encode_one group them.
+static void emit_lua_plans(const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    GHashTable *plans = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    GPtrArray *formats = g_ptr_array_new();
+    GString *run = g_string_new("");
+
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        char fmt = _struct_format(lm);
+
+        if (!lm->dimensions->len && fmt) {
+            g_string_append_c(run, fmt);
+            continue;
+        }
+        _add_plan(plans, formats, run->str);
+        g_string_truncate(run, 0);
+
+        if (!strcmp(lm->type->lctypename, "string")) {
+            _add_plan(plans, formats, "I");
+        } else if (lm->dimensions->len && fmt) {
+            lcm_dimension_t *last_dim =
+                (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, lm->dimensions->len - 1);
+            if (last_dim->mode == LCM_CONST) {
+                char *list_fmt = g_strdup_printf("%s%c", last_dim->size, fmt);
+                _add_plan(plans, formats, list_fmt);
+                g_free(list_fmt);
+            }
+        }
+    }
+    _add_plan(plans, formats, run->str);
+
+    for (unsigned int i = 0; i < formats->len; i++) {
+        const char *fmt = (const char *) g_ptr_array_index(formats, i);
+        char *plan = _plan_name(fmt);
+        emit(0, "local %s = lcm._pack.compile('>%s')", plan, fmt);
+        g_free(plan);
+    }
+    if (formats->len)
+        emit(0, "");
+
+    g_string_free(run, TRUE);
+    g_ptr_array_free(formats, TRUE);
+    g_hash_table_destroy(plans);
+}
+
 static void emit_lua_buffer_helper(const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
 {
     emit(0, "-- buffer helper for decoding");
@@ -1060,7 +1141,7 @@ static int emit_package(lcmgen_t *lcm, _package_contents_t *pc)
         if (!lcm_needs_generation(lcm, ls->lcmfile, path))
             continue;
 
-        FILE *f = fopen(path, "w");
+        FILE *f = lcm_fopen_output(lcm, path);
         if (f == NULL)
             return -1;
 
@@ -1085,6 +1166,7 @@ static int emit_package(lcmgen_t *lcm, _package_contents_t *pc)
 
         // XXX added this...
         emit_lua_locals(lcm, f, ls);
+        emit_lua_plans(lcm, f, ls);
         emit_lua_buffer_helper(lcm, f, ls);
 
         // XXX step 3, start making the object
@@ -1117,7 +1199,7 @@ static int emit_package(lcmgen_t *lcm, _package_contents_t *pc)
         emit(0, "return %s", ls->structname->shortname);
         emit(0, "");
 
-        fclose(f);
+        lcm_fclose_output(lcm, f);
     }
 
     if (init_lua_fp) {
@@ -182,6 +182,10 @@ void setup_python_options(getopt_t *gopt)
 {
     getopt_add_string(gopt, 0, "ppath", "", "Python destination directory");
     getopt_add_bool(gopt, 0, "python-no-init", 0, "Do not create __init__.py");
+    getopt_add_bool(gopt, 0, "python-numpy", 0,
+                    "Use NumPy arrays for numeric arrays, if NumPy is installed");
+    getopt_add_bool(gopt, 0, "python-cext", 0,
+                    "Also emit a C extension module per package, used when it's built");
 }
 
 static int is_same_type(const lcm_typename_t *tn1, const lcm_typename_t *tn2)
@@ -238,6 +242,26 @@ static int _primitive_type_size(const char *type_name)
     return 0;
 }
 
+// The NumPy dtype of a numeric member, or NULL if arrays of it aren't NumPy
+// arrays.  byte arrays are already decoded as bytes.
+static const char *_numpy_dtype(lcm_member_t *member)
+{
+    const char *type_name = member->type->lctypename;
+    if (!strcmp("int8_t", type_name))
+        return "i1";
+    if (!strcmp("int16_t", type_name))
+        return ">i2";
+    if (!strcmp("int32_t", type_name))
+        return ">i4";
+    if (!strcmp("int64_t", type_name))
+        return ">i8";
+    if (!strcmp("float", type_name))
+        return ">f4";
+    if (!strcmp("double", type_name))
+        return ">f8";
+    return NULL;
+}
+
 static void _emit_decode_one(const lcmgen_t *lcm, FILE *f, lcm_struct_t *structure,
                              lcm_member_t *structure_member, const char *accessor, int indent,
                              const char *sfx)
@@ -298,25 +322,42 @@ static void _emit_decode_list(const lcmgen_t *lcm, FILE *f, lcm_struct_t *struct
     } else if (!strcmp("int8_t", type_name) || !strcmp("int16_t", type_name) ||
                !strcmp("int32_t", type_name) || !strcmp("int64_t", type_name) ||
                !strcmp("float", type_name) || !strcmp("double", type_name)) {
+        char *size;
         if (fixed_len) {
-            emit(indent, "%sstruct.unpack('>%s%c', buf.read(%d))%s", accessor, len,
-                 _struct_format(structure_member), atoi(len) * _primitive_type_size(type_name),
-                 suffix);
+            size = g_strdup_printf("%d", atoi(len) * _primitive_type_size(type_name));
+        } else if (_primitive_type_size(type_name) > 1) {
+            size = g_strdup_printf("self.%s * %d", len, _primitive_type_size(type_name));
         } else {
-            if (_primitive_type_size(type_name) > 1) {
-                emit(indent, "%sstruct.unpack('>%%d%c' %% self.%s, buf.read(self.%s * %d))%s",
-                     accessor, _struct_format(structure_member), len, len,
-                     _primitive_type_size(type_name), suffix);
-            } else {
-                emit(indent, "%sstruct.unpack('>%%d%c' %% self.%s, buf.read(self.%s))%s", accessor,
-                     _struct_format(structure_member), len, len, suffix);
-            }
+            size = g_strdup_printf("self.%s", len);
         }
+        emit_start(indent, "%s", accessor);
+        if (getopt_get_bool(lcm->gopt, "python-numpy")) {
+            emit_continue("numpy.frombuffer(buf.read(%s), '%s') if numpy else ", size,
+                          _numpy_dtype(structure_member));
+        }
+        if (fixed_len) {
+            emit_end("struct.unpack('>%s%c', buf.read(%s))%s", len,
+                     _struct_format(structure_member), size, suffix);
+        } else {
+            emit_end("struct.unpack('>%%d%c' %% self.%s, buf.read(%s))%s",
+                     _struct_format(structure_member), len, size, suffix);
+        }
+        g_free(size);
     } else {
         assert(0);
     }
 }
 
+// Emits the name of the precompiled struct.Struct for the formats, emitted by
+// emit_python_structs() at the top of the module.
+static void _emit_struct_name(FILE *f, GQueue *formats)
+{
+    emit_continue("_struct_");
+    for (GList *fmt = formats->head; fmt; fmt = fmt->next) {
+        emit_continue("%c", GPOINTER_TO_INT(fmt->data));
+    }
+}
+
 static void _flush_read_struct_fmt(const lcmgen_t *lcm, FILE *f, GQueue *formats,
                                    GQueue *member_queue)
 {
@@ -325,21 +366,38 @@ static void _flush_read_struct_fmt(const lcmgen_t *lcm, FILE *f, GQueue *formats
     if (nfmts == 0)
         return;
 
-    fprintf(f, "        ");
-    int fmtsize = 0;
-    while (!g_queue_is_empty(member_queue)) {
+    if (nfmts == 1) {
         lcm_member_t *member = (lcm_member_t *) g_queue_pop_head(member_queue);
+        int is_bool = !strcmp(member->type->lctypename, "boolean");
+        emit_start(2, "self.%s = %s", member->membername, is_bool ? "bool(" : "");
+        _emit_struct_name(f, formats);
+        emit_end(".unpack(buf.read(%d))[0]%s", _primitive_type_size(member->type->lctypename),
+                 is_bool ? ")" : "");
+        g_queue_clear(formats);
+        return;
+    }
+
+    emit_start(2, "");
+    int fmtsize = 0;
+    for (GList *m = member_queue->head; m; m = m->next) {
+        lcm_member_t *member = (lcm_member_t *) m->data;
         emit_continue("self.%s", member->membername);
-        if (!g_queue_is_empty(member_queue)) {
+        if (m->next) {
             emit_continue(", ");
         }
         fmtsize += _primitive_type_size(member->type->lctypename);
     }
-    emit_continue(" = struct.unpack(\">");
-    while (!g_queue_is_empty(formats)) {
-        emit_continue("%c", GPOINTER_TO_INT(g_queue_pop_head(formats)));
+    emit_continue(" = ");
+    _emit_struct_name(f, formats);
+    emit_end(".unpack(buf.read(%d))", fmtsize);
+    g_queue_clear(formats);
+
+    // booleans are unpacked as integers
+    while (!g_queue_is_empty(member_queue)) {
+        lcm_member_t *member = (lcm_member_t *) g_queue_pop_head(member_queue);
+        if (!strcmp(member->type->lctypename, "boolean"))
+            emit(2, "self.%s = bool(self.%s)", member->membername, member->membername);
     }
-    emit_end("\", buf.read(%d))%s", fmtsize, nfmts == 1 ? "[0]" : "");
 }
 
 static void emit_python_decode_one(const lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
@@ -356,7 +414,7 @@ static void emit_python_decode_one(const lcmgen_t *lcm, FILE *f, lcm_struct_t *s
         char fmt = _struct_format(structure_member);
 
         if (!structure_member->dimensions->len) {
-            if (fmt && strcmp(structure_member->type->lctypename, "boolean")) {
+            if (fmt) {
                 g_queue_push_tail(struct_fmt, GINT_TO_POINTER((int) fmt));
                 g_queue_push_tail(struct_members, structure_member);
             } else {
@@ -445,6 +503,10 @@ static void emit_python_decode(const lcmgen_t *lcm, FILE *f, lcm_struct_t *struc
     // clang-format off
     emit(1, "@staticmethod");
     emit(1, "def decode(data: bytes):");
+    if (getopt_get_bool(lcm->gopt, "python-cext")) {
+        emit(2, "if _cext_decode is not None and not hasattr(data, 'read'):");
+        emit(3,     "return _cext_decode(data)");
+    }
     emit(2,     "if hasattr(data, 'read'):");
     emit(3,         "buf = data");
     emit(2,     "else:");
@@ -500,6 +562,16 @@ static void _emit_encode_list(const lcmgen_t *lcm, FILE *f, lcm_struct_t *struct
     if (!strcmp("byte", type_name)) {
         emit(indent, "buf.write(bytearray(%s[:%s%s]))", accessor, (fixed_len ? "" : "self."), len);
         return;
+    } else if (getopt_get_bool(lcm->gopt, "python-numpy") && _numpy_dtype(structure_member)) {
+        emit(indent, "buf.write(_numpy_pack(%s, %s%s, '%s') if numpy else", accessor,
+             fixed_len ? "" : "self.", len, _numpy_dtype(structure_member));
+        if (fixed_len) {
+            emit(indent + 2, "struct.pack('>%s%c', *%s[:%s]))", len, _struct_format(structure_member),
+                 accessor, len);
+        } else {
+            emit(indent + 2, "struct.pack('>%%d%c' %% self.%s, *%s[:self.%s]))",
+                 _struct_format(structure_member), len, accessor, len);
+        }
     } else if (!strcmp("boolean", type_name) || !strcmp("int8_t", type_name) ||
                !strcmp("int16_t", type_name) || !strcmp("int32_t", type_name) ||
                !strcmp("int64_t", type_name) || !strcmp("float", type_name) ||
@@ -521,11 +593,10 @@ static void _flush_write_struct_fmt(FILE *f, GQueue *formats, GQueue *members)
     assert(g_queue_get_length(formats) == g_queue_get_length(members));
     if (g_queue_is_empty(formats))
         return;
-    emit_start(2, "buf.write(struct.pack(\">");
-    while (!g_queue_is_empty(formats)) {
-        emit_continue("%c", GPOINTER_TO_INT(g_queue_pop_head(formats)));
-    }
-    emit_continue("\", ");
+    emit_start(2, "buf.write(");
+    _emit_struct_name(f, formats);
+    emit_continue(".pack(");
+    g_queue_clear(formats);
     while (!g_queue_is_empty(members)) {
         lcm_member_t *lm = (lcm_member_t *) g_queue_pop_head(members);
         emit_continue("self.%s", lm->membername);
@@ -608,6 +679,10 @@ static void emit_python_encode_one(const lcmgen_t *lcm, FILE *f, lcm_struct_t *s
 static void emit_python_encode(const lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
 {
     emit(1, "def encode(self):");
+    if (getopt_get_bool(lcm->gopt, "python-cext")) {
+        emit(2, "if _cext_encode is not None:");
+        emit(3, "return _cext_encode(self)");
+    }
     emit(2, "buf = BytesIO()");
     emit(2, "buf.write(%s._get_packed_fingerprint())", structure->structname->shortname);
     emit(2, "self._encode_one(buf)");
@@ -615,6 +690,63 @@ static void emit_python_encode(const lcmgen_t *lcm, FILE *f, lcm_struct_t *struc
     fprintf(f, "\n");
 }
 
+// Emits the NumPy import, which falls back to the struct module when NumPy
+// isn't installed, and the helper that encodes a numeric array with it.
+static void emit_python_numpy(const lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
+{
+    int has_numpy_arrays = 0;
+    for (unsigned int m = 0; m < g_ptr_array_size(structure->members); m++) {
+        lcm_member_t *member = (lcm_member_t *) g_ptr_array_index(structure->members, m);
+        if (member->dimensions->len && _numpy_dtype(member))
+            has_numpy_arrays = 1;
+    }
+    if (!has_numpy_arrays)
+        return;
+
+    // clang-format off
+    emit(0, "try:");
+    emit(1,     "import numpy");
+    emit(0, "except ImportError:");
+    emit(1,     "numpy = None");
+    fprintf(f, "\n");
+    emit(0, "def _numpy_pack(values, count, dtype):");
+    emit(1,     "array = numpy.asarray(values[:count], dtype)");
+    emit(1,     "if array.shape != (count,):");
+    emit(2,         "raise ValueError(\"expected %%d values\" %% count)");
+    emit(1,     "return array.tobytes()");
+    fprintf(f, "\n");
+    // clang-format on
+}
+
+// Emits a precompiled struct.Struct for each run of consecutive scalar
+// primitive members, which encode and decode pack and unpack in one call.
+static void emit_python_structs(const lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
+{
+    GHashTable *emitted = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    GString *formats = g_string_new("");
+    for (unsigned int m = 0; m <= g_ptr_array_size(structure->members); m++) {
+        char fmt = 0;
+        if (m < g_ptr_array_size(structure->members)) {
+            lcm_member_t *member = (lcm_member_t *) g_ptr_array_index(structure->members, m);
+            if (!member->dimensions->len)
+                fmt = _struct_format(member);
+        }
+        if (fmt) {
+            g_string_append_c(formats, fmt);
+            continue;
+        }
+        if (formats->len && !g_hash_table_lookup(emitted, formats->str)) {
+            emit(0, "_struct_%s = struct.Struct(\">%s\")", formats->str, formats->str);
+            g_hash_table_add(emitted, g_strdup(formats->str));
+        }
+        g_string_truncate(formats, 0);
+    }
+    if (g_hash_table_size(emitted))
+        fprintf(f, "\n");
+    g_string_free(formats, TRUE);
+    g_hash_table_destroy(emitted);
+}
+
 static void emit_member_initializer(const lcmgen_t *lcm, FILE *f, lcm_member_t *structure_member,
                                     int dim_num)
 {
@@ -798,6 +930,765 @@ static void _package_contents_free (_package_contents_t *package)
     free (package);
 }
 
+// The code that the types of a --python-cext extension module share, with
+// the encoders and decoders of primitives from lcm_coretypes.h.
+static const char *cext_runtime[] = {
+    "#define PY_SSIZE_T_CLEAN",
+    "#include <Python.h>",
+    "",
+    "#include <float.h>",
+    "#include <limits.h>",
+    "#include <math.h>",
+    "",
+    "#include <lcm/lcm_coretypes.h>",
+    "",
+    "// the encoding being written",
+    "typedef struct {",
+    "    char *data;",
+    "    Py_ssize_t len;",
+    "    Py_ssize_t size;",
+    "} _cext_wbuf_t;",
+    "",
+    "// the encoding being read, and a BytesIO over it for types of other packages",
+    "typedef struct {",
+    "    PyObject *src;",
+    "    const char *data;",
+    "    Py_ssize_t len;",
+    "    Py_ssize_t pos;",
+    "    PyObject *bytesio;",
+    "} _cext_rbuf_t;",
+    "",
+    "// a generated class, imported the first time that it's needed",
+    "typedef struct {",
+    "    const char *module;",
+    "    const char *name;",
+    "    PyObject *cls;",
+    "    PyObject *fingerprint;",
+    "} _cext_type_t;",
+    "",
+    "// Encodes and decodes one value.  arg is the _cext_type_t of a struct, the",
+    "// length of a byte array, or where a primitive integer stores its value.",
+    "typedef int (*_cext_put_t)(_cext_wbuf_t *b, PyObject *o, void *arg);",
+    "typedef PyObject *(*_cext_get_t)(_cext_rbuf_t *b, void *arg);",
+    "",
+    "static PyObject *_cext_empty_tuple;",
+    "static PyObject *_cext_BytesIO;",
+    "",
+    "static inline char *_cext_reserve(_cext_wbuf_t *b, Py_ssize_t n)",
+    "{",
+    "    if (b->len + n > b->size) {",
+    "        Py_ssize_t size = b->size ? b->size : 256;",
+    "        while (size < b->len + n)",
+    "            size *= 2;",
+    "        char *data = (char *) PyMem_Realloc(b->data, size);",
+    "        if (!data) {",
+    "            PyErr_NoMemory();",
+    "            return NULL;",
+    "        }",
+    "        b->data = data;",
+    "        b->size = size;",
+    "    }",
+    "    char *p = b->data + b->len;",
+    "    b->len += n;",
+    "    return p;",
+    "}",
+    "",
+    "static inline const char *_cext_read(_cext_rbuf_t *b, Py_ssize_t n)",
+    "{",
+    "    if (n < 0 || b->len - b->pos < n) {",
+    "        PyErr_SetString(PyExc_ValueError, \"Decode error\");",
+    "        return NULL;",
+    "    }",
+    "    const char *p = b->data + b->pos;",
+    "    b->pos += n;",
+    "    return p;",
+    "}",
+    "",
+    "static inline int _cext_resolve(_cext_type_t *t)",
+    "{",
+    "    if (t->fingerprint)",
+    "        return 0;",
+    "    if (!t->cls) {",
+    "        PyObject *module = PyImport_ImportModule(t->module);",
+    "        if (!module)",
+    "            return -1;",
+    "        t->cls = PyObject_GetAttrString(module, t->name);",
+    "        Py_DECREF(module);",
+    "        if (!t->cls)",
+    "            return -1;",
+    "    }",
+    "    PyObject *fingerprint = PyObject_CallMethod(t->cls, \"_get_packed_fingerprint\", NULL);",
+    "    if (!fingerprint)",
+    "        return -1;",
+    "    if (!PyBytes_Check(fingerprint) || PyBytes_GET_SIZE(fingerprint) != 8) {",
+    "        Py_DECREF(fingerprint);",
+    "        PyErr_Format(PyExc_TypeError, \"bad fingerprint for %s\", t->name);",
+    "        return -1;",
+    "    }",
+    "    t->fingerprint = fingerprint;",
+    "    return 0;",
+    "}",
+    "",
+    "// Checks that o has the fingerprint of t, as the generated Python asserts.",
+    "static inline int _cext_check(PyObject *o, _cext_type_t *t)",
+    "{",
+    "    if (_cext_resolve(t) < 0)",
+    "        return -1;",
+    "    if (Py_TYPE(o) == (PyTypeObject *) t->cls)",
+    "        return 0;",
+    "    PyObject *fingerprint = PyObject_CallMethod(o, \"_get_packed_fingerprint\", NULL);",
+    "    if (!fingerprint)",
+    "        return -1;",
+    "    int same = PyObject_RichCompareBool(fingerprint, t->fingerprint, Py_EQ);",
+    "    Py_DECREF(fingerprint);",
+    "    if (same < 0)",
+    "        return -1;",
+    "    if (!same) {",
+    "        PyErr_Format(PyExc_AssertionError, \"expected %s\", t->name);",
+    "        return -1;",
+    "    }",
+    "    return 0;",
+    "}",
+    "",
+    "// Creates an instance of t without running __init__(), whose members are",
+    "// all decoded next.",
+    "static inline PyObject *_cext_new(_cext_type_t *t)",
+    "{",
+    "    if (_cext_resolve(t) < 0)",
+    "        return NULL;",
+    "    PyTypeObject *type = (PyTypeObject *) t->cls;",
+    "    return type->tp_new(type, _cext_empty_tuple, NULL);",
+    "}",
+    "",
+    "static inline int _cext_check_length(Py_ssize_t size, int64_t n)",
+    "{",
+    "    if (n < 0 || n > INT_MAX / 8) {",
+    "        PyErr_Format(PyExc_ValueError, \"bad array length %lld\", (long long) n);",
+    "        return -1;",
+    "    }",
+    "    if (size < n) {",
+    "        PyErr_Format(PyExc_ValueError, \"expected %lld elements, got %zd\", (long long) n,",
+    "                     size);",
+    "        return -1;",
+    "    }",
+    "    return 0;",
+    "}",
+    "",
+    "#define _CEXT_INTEGER(NAME, T, CORE, MIN, MAX, TO_PY)                                 \\",
+    "    static inline int _cext_put_##NAME(_cext_wbuf_t *b, PyObject *o, void *arg)       \\",
+    "    {                                                                                 \\",
+    "        long long v = PyLong_AsLongLong(o);                                           \\",
+    "        if (v == -1 && PyErr_Occurred())                                              \\",
+    "            return -1;                                                                \\",
+    "        if (v < (MIN) || v > (MAX)) {                                                 \\",
+    "            PyErr_SetString(PyExc_OverflowError, #NAME \" value out of range\");        \\",
+    "            return -1;                                                                \\",
+    "        }                                                                             \\",
+    "        T x = (T) v;                                                                  \\",
+    "        char *p = _cext_reserve(b, sizeof(T));                                        \\",
+    "        if (!p)                                                                       \\",
+    "            return -1;                                                                \\",
+    "        CORE##_encode_array(p, 0, sizeof(T), &x, 1);                                  \\",
+    "        if (arg)                                                                      \\",
+    "            *(int64_t *) arg = x;                                                     \\",
+    "        return 0;                                                                     \\",
+    "    }                                                                                 \\",
+    "    static inline PyObject *_cext_get_##NAME(_cext_rbuf_t *b, void *arg)              \\",
+    "    {                                                                                 \\",
+    "        const char *p = _cext_read(b, sizeof(T));                                     \\",
+    "        if (!p)                                                                       \\",
+    "            return NULL;                                                              \\",
+    "        T x;                                                                          \\",
+    "        CORE##_decode_array(p, 0, sizeof(T), &x, 1);                                  \\",
+    "        if (arg)                                                                      \\",
+    "            *(int64_t *) arg = x;                                                     \\",
+    "        return TO_PY(x);                                                              \\",
+    "    }",
+    "",
+    "#define _CEXT_REAL(NAME, T, MAX)                                                      \\",
+    "    static inline int _cext_put_##NAME(_cext_wbuf_t *b, PyObject *o, void *arg)       \\",
+    "    {                                                                                 \\",
+    "        double v = PyFloat_AsDouble(o);                                               \\",
+    "        if (v == -1.0 && PyErr_Occurred())                                            \\",
+    "            return -1;                                                                \\",
+    "        if (isfinite(v) && fabs(v) > (MAX)) {                                         \\",
+    "            PyErr_SetString(PyExc_OverflowError, #NAME \" value out of range\");        \\",
+    "            return -1;                                                                \\",
+    "        }                                                                             \\",
+    "        T x = (T) v;                                                                  \\",
+    "        char *p = _cext_reserve(b, sizeof(T));                                        \\",
+    "        if (!p)                                                                       \\",
+    "            return -1;                                                                \\",
+    "        __##NAME##_encode_array(p, 0, sizeof(T), &x, 1);                              \\",
+    "        return 0;                                                                     \\",
+    "    }                                                                                 \\",
+    "    static inline PyObject *_cext_get_##NAME(_cext_rbuf_t *b, void *arg)              \\",
+    "    {                                                                                 \\",
+    "        const char *p = _cext_read(b, sizeof(T));                                     \\",
+    "        if (!p)                                                                       \\",
+    "            return NULL;                                                              \\",
+    "        T x;                                                                          \\",
+    "        __##NAME##_decode_array(p, 0, sizeof(T), &x, 1);                              \\",
+    "        return PyFloat_FromDouble(x);                                                 \\",
+    "    }",
+    "",
+    "_CEXT_INTEGER(byte, uint8_t, __byte, 0, UINT8_MAX, PyLong_FromLong)",
+    "_CEXT_INTEGER(boolean, int8_t, __int8_t, INT8_MIN, INT8_MAX, PyBool_FromLong)",
+    "_CEXT_INTEGER(int8_t, int8_t, __int8_t, INT8_MIN, INT8_MAX, PyLong_FromLong)",
+    "_CEXT_INTEGER(int16_t, int16_t, __int16_t, INT16_MIN, INT16_MAX, PyLong_FromLong)",
+    "_CEXT_INTEGER(int32_t, int32_t, __int32_t, INT32_MIN, INT32_MAX, PyLong_FromLong)",
+    "_CEXT_INTEGER(int64_t, int64_t, __int64_t, INT64_MIN, INT64_MAX, PyLong_FromLongLong)",
+    "_CEXT_REAL(float, float, FLT_MAX)",
+    "_CEXT_REAL(double, double, DBL_MAX)",
+    "",
+    "static inline int _cext_put_string(_cext_wbuf_t *b, PyObject *o, void *arg)",
+    "{",
+    "    Py_ssize_t n;",
+    "    const char *s = PyUnicode_AsUTF8AndSize(o, &n);",
+    "    if (!s)",
+    "        return -1;",
+    "    if (n >= INT32_MAX) {",
+    "        PyErr_SetString(PyExc_OverflowError, \"string too long\");",
+    "        return -1;",
+    "    }",
+    "    char *p = _cext_reserve(b, n + 5);",
+    "    if (!p)",
+    "        return -1;",
+    "    int32_t len = (int32_t) n + 1;",
+    "    __int32_t_encode_array(p, 0, 4, &len, 1);",
+    "    memcpy(p + 4, s, n);",
+    "    p[n + 4] = 0;",
+    "    return 0;",
+    "}",
+    "",
+    "static inline PyObject *_cext_get_string(_cext_rbuf_t *b, void *arg)",
+    "{",
+    "    const char *p = _cext_read(b, 4);",
+    "    if (!p)",
+    "        return NULL;",
+    "    int32_t len;",
+    "    __int32_t_decode_array(p, 0, 4, &len, 1);",
+    "    p = _cext_read(b, (uint32_t) len);",
+    "    if (!p)",
+    "        return NULL;",
+    "    // the terminating 0 is dropped",
+    "    return PyUnicode_DecodeUTF8(p, len ? (uint32_t) len - 1 : 0, \"replace\");",
+    "}",
+    "",
+    "// the last dimension of a byte array, which is a bytes object",
+    "static inline int _cext_put_bytes(_cext_wbuf_t *b, PyObject *o, void *arg)",
+    "{",
+    "    int64_t n = *(int64_t *) arg;",
+    "    if (PyObject_CheckBuffer(o)) {",
+    "        Py_buffer view;",
+    "        if (PyObject_GetBuffer(o, &view, PyBUF_SIMPLE) < 0)",
+    "            return -1;",
+    "        char *p = NULL;",
+    "        if (_cext_check_length(view.len, n) == 0 && (p = _cext_reserve(b, n)))",
+    "            memcpy(p, view.buf, n);",
+    "        PyBuffer_Release(&view);",
+    "        return p ? 0 : -1;",
+    "    }",
+    "    PyObject *seq = PySequence_Fast(o, \"expected bytes\");",
+    "    if (!seq)",
+    "        return -1;",
+    "    int status = _cext_check_length(PySequence_Fast_GET_SIZE(seq), n);",
+    "    for (int64_t i = 0; status == 0 && i < n; i++)",
+    "        status = _cext_put_byte(b, PySequence_Fast_GET_ITEM(seq, i), NULL);",
+    "    Py_DECREF(seq);",
+    "    return status;",
+    "}",
+    "",
+    "static inline PyObject *_cext_get_bytes(_cext_rbuf_t *b, void *arg)",
+    "{",
+    "    int64_t n = *(int64_t *) arg;",
+    "    if (_cext_check_length(PY_SSIZE_T_MAX, n) < 0)",
+    "        return NULL;",
+    "    const char *p = _cext_read(b, n);",
+    "    return p ? PyBytes_FromStringAndSize(p, n) : NULL;",
+    "}",
+    "",
+    "// types of other packages, and enums, are encoded and decoded by their own",
+    "// modules",
+    "static inline int _cext_put_other(_cext_wbuf_t *b, PyObject *o, void *arg)",
+    "{",
+    "    _cext_type_t *t = (_cext_type_t *) arg;",
+    "    if (_cext_resolve(t) < 0)",
+    "        return -1;",
+    "    PyObject *data = PyObject_CallMethod(o, \"encode\", NULL);",
+    "    if (!data)",
+    "        return -1;",
+    "    int status = -1;",
+    "    if (!PyBytes_Check(data) || PyBytes_GET_SIZE(data) < 8 ||",
+    "        memcmp(PyBytes_AS_STRING(data), PyBytes_AS_STRING(t->fingerprint), 8)) {",
+    "        PyErr_Format(PyExc_AssertionError, \"expected %s\", t->name);",
+    "    } else {",
+    "        Py_ssize_t n = PyBytes_GET_SIZE(data) - 8;",
+    "        char *p = _cext_reserve(b, n);",
+    "        if (p) {",
+    "            memcpy(p, PyBytes_AS_STRING(data) + 8, n);",
+    "            status = 0;",
+    "        }",
+    "    }",
+    "    Py_DECREF(data);",
+    "    return status;",
+    "}",
+    "",
+    "static inline PyObject *_cext_get_other(_cext_rbuf_t *b, void *arg)",
+    "{",
+    "    _cext_type_t *t = (_cext_type_t *) arg;",
+    "    if (_cext_resolve(t) < 0)",
+    "        return NULL;",
+    "    if (!b->bytesio) {",
+    "        b->bytesio = PyObject_CallFunctionObjArgs(_cext_BytesIO, b->src, NULL);",
+    "        if (!b->bytesio)",
+    "            return NULL;",
+    "    }",
+    "    PyObject *r = PyObject_CallMethod(b->bytesio, \"seek\", \"n\", b->pos);",
+    "    if (!r)",
+    "        return NULL;",
+    "    Py_DECREF(r);",
+    "    PyObject *o = PyObject_CallMethod(t->cls, \"_decode_one\", \"O\", b->bytesio);",
+    "    if (!o)",
+    "        return NULL;",
+    "    r = PyObject_CallMethod(b->bytesio, \"tell\", NULL);",
+    "    Py_ssize_t pos = r ? PyLong_AsSsize_t(r) : -1;",
+    "    Py_XDECREF(r);",
+    "    if (pos < b->pos || pos > b->len) {",
+    "        if (!PyErr_Occurred())",
+    "            PyErr_SetString(PyExc_ValueError, \"Decode error\");",
+    "        Py_DECREF(o);",
+    "        return NULL;",
+    "    }",
+    "    b->pos = pos;",
+    "    return o;",
+    "}",
+    "",
+    "// Encodes the ndims dimensions of o, whose sizes are dims, and then each",
+    "// element with put.",
+    "static inline int _cext_put_array(_cext_wbuf_t *b, PyObject *o, const int64_t *dims,",
+    "                                  int ndims, _cext_put_t put, void *arg)",
+    "{",
+    "    if (ndims == 0)",
+    "        return put(b, o, arg);",
+    "    PyObject *seq = PySequence_Fast(o, \"expected a sequence\");",
+    "    if (!seq)",
+    "        return -1;",
+    "    int status = _cext_check_length(PySequence_Fast_GET_SIZE(seq), dims[0]);",
+    "    for (int64_t i = 0; status == 0 && i < dims[0]; i++) {",
+    "        PyObject *item = PySequence_Fast_GET_ITEM(seq, i);",
+    "        status = _cext_put_array(b, item, dims + 1, ndims - 1, put, arg);",
+    "    }",
+    "    Py_DECREF(seq);",
+    "    return status;",
+    "}",
+    "",
+    "// Decodes the ndims dimensions, whose sizes are dims, into lists, or a tuple",
+    "// for the last dimension if last_tuple is set.",
+    "static inline PyObject *_cext_get_array(_cext_rbuf_t *b, const int64_t *dims, int ndims,",
+    "                                        _cext_get_t get, void *arg, int last_tuple)",
+    "{",
+    "    if (ndims == 0)",
+    "        return get(b, arg);",
+    "    if (_cext_check_length(PY_SSIZE_T_MAX, dims[0]) < 0)",
+    "        return NULL;",
+    "    int tuple = ndims == 1 && last_tuple;",
+    "    PyObject *o = tuple ? PyTuple_New(dims[0]) : PyList_New(dims[0]);",
+    "    if (!o)",
+    "        return NULL;",
+    "    for (int64_t i = 0; i < dims[0]; i++) {",
+    "        PyObject *item = _cext_get_array(b, dims + 1, ndims - 1, get, arg, last_tuple);",
+    "        if (!item) {",
+    "            Py_DECREF(o);",
+    "            return NULL;",
+    "        }",
+    "        if (tuple)",
+    "            PyTuple_SET_ITEM(o, i, item);",
+    "        else",
+    "            PyList_SET_ITEM(o, i, item);",
+    "    }",
+    "    return o;",
+    "}",
+    "",
+    "static inline int _cext_put_member(_cext_wbuf_t *b, PyObject *self, PyObject *name,",
+    "                                   const int64_t *dims, int ndims, _cext_put_t put,",
+    "                                   void *arg)",
+    "{",
+    "    PyObject *o = PyObject_GetAttr(self, name);",
+    "    if (!o)",
+    "        return -1;",
+    "    int status = _cext_put_array(b, o, dims, ndims, put, arg);",
+    "    Py_DECREF(o);",
+    "    return status;",
+    "}",
+    "",
+    "static inline int _cext_get_member(_cext_rbuf_t *b, PyObject *self, PyObject *name,",
+    "                                   const int64_t *dims, int ndims, _cext_get_t get,",
+    "                                   void *arg, int last_tuple)",
+    "{",
+    "    PyObject *o = _cext_get_array(b, dims, ndims, get, arg, last_tuple);",
+    "    if (!o)",
+    "        return -1;",
+    "    int status = PyObject_SetAttr(self, name, o);",
+    "    Py_DECREF(o);",
+    "    return status;",
+    "}",
+    "",
+    "static inline PyObject *_cext_encode(PyObject *o, _cext_type_t *t, _cext_put_t put)",
+    "{",
+    "    if (_cext_resolve(t) < 0)",
+    "        return NULL;",
+    "    _cext_wbuf_t b = {NULL, 0, 0};",
+    "    char *p = _cext_reserve(&b, 8);",
+    "    PyObject *data = NULL;",
+    "    if (p) {",
+    "        memcpy(p, PyBytes_AS_STRING(t->fingerprint), 8);",
+    "        if (put(&b, o, t) == 0)",
+    "            data = PyBytes_FromStringAndSize(b.data, b.len);",
+    "    }",
+    "    PyMem_Free(b.data);",
+    "    return data;",
+    "}",
+    "",
+    "static inline PyObject *_cext_decode(PyObject *data, _cext_type_t *t, _cext_get_t get)",
+    "{",
+    "    if (_cext_resolve(t) < 0)",
+    "        return NULL;",
+    "    Py_buffer view;",
+    "    if (PyObject_GetBuffer(data, &view, PyBUF_SIMPLE) < 0)",
+    "        return NULL;",
+    "    _cext_rbuf_t b = {data, (const char *) view.buf, view.len, 0, NULL};",
+    "    PyObject *o = NULL;",
+    "    const char *fingerprint = _cext_read(&b, 8);",
+    "    if (fingerprint && memcmp(fingerprint, PyBytes_AS_STRING(t->fingerprint), 8))",
+    "        PyErr_SetString(PyExc_ValueError, \"Decode error\");",
+    "    else if (fingerprint)",
+    "        o = get(&b, t);",
+    "    Py_XDECREF(b.bytesio);",
+    "    PyBuffer_Release(&view);",
+    "    return o;",
+    "}",
+    "",
+    "static inline int _cext_init(void)",
+    "{",
+    "    _cext_empty_tuple = PyTuple_New(0);",
+    "    if (!_cext_empty_tuple)",
+    "        return -1;",
+    "    PyObject *io = PyImport_ImportModule(\"io\");",
+    "    if (!io)",
+    "        return -1;",
+    "    _cext_BytesIO = PyObject_GetAttrString(io, \"BytesIO\");",
+    "    Py_DECREF(io);",
+    "    return _cext_BytesIO ? 0 : -1;",
+    "}",
+    NULL,
+};
+
+// Emits the import of the encoder and decoder of a struct from the extension
+// module of its package.  They are None if it wasn't built, or if the struct
+// wasn't generated into it.
+static void emit_python_cext_import(const lcmgen_t *lcm, FILE *f, lcm_struct_t *structure)
+{
+    const char *package = structure->structname->package;
+    const char *sn = structure->structname->shortname;
+    // clang-format off
+    emit(0, "try:");
+    emit(1,     "from %s%s_lcm_cext import encode_%s as _cext_encode, decode_%s as _cext_decode",
+                package, strlen(package) ? "." : "", sn, sn);
+    emit(0, "except ImportError:");
+    emit(1,     "_cext_encode = _cext_decode = None");
+    // clang-format on
+    fprintf(f, "\n");
+}
+
+static int _cext_is_local(_package_contents_t *package, const lcm_typename_t *type)
+{
+    for (unsigned int i = 0; i < package->structs->len; i++) {
+        lcm_struct_t *structure = (lcm_struct_t *) g_ptr_array_index(package->structs, i);
+        if (is_same_type(structure->structname, type))
+            return 1;
+    }
+    return 0;
+}
+
+static char *_cext_other_name(const lcm_typename_t *type)
+{
+    char *name = g_strdup_printf("_cext_o_%s", type->lctypename);
+    g_strdelimit(name, ".", '_');
+    return name;
+}
+
+// Returns whether a member has the size of an array of its struct, which is
+// kept in a variable v_<member> by the encoder and decoder.
+static int _cext_is_dimension(lcm_struct_t *structure, lcm_member_t *member)
+{
+    for (unsigned int m = 0; m < structure->members->len; m++) {
+        lcm_member_t *other = (lcm_member_t *) g_ptr_array_index(structure->members, m);
+        for (unsigned int n = 0; n < other->dimensions->len; n++) {
+            lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(other->dimensions, n);
+            if (dim->mode == LCM_VAR && !strcmp(dim->size, member->membername))
+                return 1;
+        }
+    }
+    return 0;
+}
+
+// Emits the encoding or decoding of a member, with the _cext_put_member() or
+// _cext_get_member() of the runtime.
+static void _cext_emit_member(FILE *f, _package_contents_t *package, lcm_struct_t *structure,
+                              lcm_member_t *member, int decode)
+{
+    const char *type_name = member->type->lctypename;
+    int ndims = member->dimensions->len;
+    int last_tuple = 0;
+    char *fn;
+    char *arg;
+    if (!strcmp(type_name, "byte") && ndims) {
+        // the last dimension is a bytes object
+        ndims--;
+        fn = g_strdup("bytes");
+        arg = g_strdup_printf("(void *) &dims[%d]", ndims);
+    } else if (lcm_is_primitive_type(type_name)) {
+        fn = g_strdup(type_name);
+        if (!ndims && _cext_is_dimension(structure, member))
+            arg = g_strdup_printf("&v_%s", member->membername);
+        else
+            arg = g_strdup("NULL");
+        // struct.unpack() decodes numeric arrays as tuples
+        last_tuple = strcmp(type_name, "string") && strcmp(type_name, "boolean");
+    } else if (_cext_is_local(package, member->type)) {
+        fn = g_strdup(member->type->shortname);
+        arg = g_strdup_printf("&_cext_t_%s", member->type->shortname);
+    } else {
+        char *other = _cext_other_name(member->type);
+        fn = g_strdup("other");
+        arg = g_strdup_printf("&%s", other);
+        g_free(other);
+    }
+
+    int indent = 1;
+    if (member->dimensions->len) {
+        emit(1, "{");
+        emit_start(2, "const int64_t dims[] = {");
+        for (unsigned int n = 0; n < member->dimensions->len; n++) {
+            lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(member->dimensions, n);
+            emit_continue("%s%s%s", n ? ", " : "", dim->mode == LCM_VAR ? "v_" : "", dim->size);
+        }
+        emit_end("};");
+        indent = 2;
+    }
+    const char *dims = member->dimensions->len ? "dims" : "NULL";
+    if (decode) {
+        emit(indent, "if (_cext_get_member(b, self, _cext_names[_cext_n_%s], %s, %d, _cext_get_%s,",
+             member->membername, dims, ndims, fn);
+        emit(indent, "                     %s, %d) < 0)", arg, last_tuple);
+        emit(indent + 1, "goto fail;");
+    } else {
+        emit(indent, "if (_cext_put_member(b, self, _cext_names[_cext_n_%s], %s, %d, _cext_put_%s,",
+             member->membername, dims, ndims, fn);
+        emit(indent, "                     %s) < 0)", arg);
+        emit(indent + 1, "return -1;");
+    }
+    if (member->dimensions->len)
+        emit(1, "}");
+    g_free(fn);
+    g_free(arg);
+}
+
+static void _cext_emit_dimension_variables(FILE *f, lcm_struct_t *structure)
+{
+    for (unsigned int m = 0; m < structure->members->len; m++) {
+        lcm_member_t *member = (lcm_member_t *) g_ptr_array_index(structure->members, m);
+        if (_cext_is_dimension(structure, member))
+            emit(1, "int64_t v_%s = 0;", member->membername);
+    }
+}
+
+// Emits a CPython extension module for the structs of a package, which the
+// generated Python modules use to encode and decode when it can be imported.
+// Members are read from and written to the Python objects directly, and the
+// types of other packages, and enums, are left to their Python modules.
+static int emit_python_cext(lcmgen_t *lcm, _package_contents_t *package, const char *package_dir)
+{
+    if (!package->structs->len)
+        return 0;
+
+    char path[PATH_MAX];
+    int ret = snprintf(path, sizeof(path), "%s_lcm_cext.c", package_dir);
+    if (ret >= PATH_MAX || ret < 0) {
+        err("Could not create extension module path string\n");
+        return -1;
+    }
+
+    int needs_generation = 0;
+    for (unsigned int i = 0; i < package->structs->len; i++) {
+        lcm_struct_t *structure = (lcm_struct_t *) g_ptr_array_index(package->structs, i);
+        needs_generation |= lcm_needs_generation(lcm, structure->lcmfile, path);
+    }
+    if (!needs_generation)
+        return 0;
+
+    FILE *f = lcm_fopen_output(lcm, path);
+    if (f == NULL)
+        return -1;
+
+    fprintf(f,
+            "// LCM type definitions\n"
+            "// This file automatically generated by lcm.\n"
+            "// DO NOT MODIFY BY HAND!!!!\n"
+            "// lcm-gen " LCM_VERSION_STRING "\n"
+            "//\n"
+            "// The CPython extension module of package %s.  It is built with the\n"
+            "// include directories of Python and LCM.\n"
+            "\n",
+            strlen(package->name) ? package->name : "(none)");
+    for (const char **line = cext_runtime; *line; line++)
+        fprintf(f, "%s\n", *line);
+    fprintf(f, "\n");
+
+    // the member names, as attribute name objects
+    GHashTable *names = g_hash_table_new(g_str_hash, g_str_equal);
+    GPtrArray *name_list = g_ptr_array_new();
+    for (unsigned int i = 0; i < package->structs->len; i++) {
+        lcm_struct_t *structure = (lcm_struct_t *) g_ptr_array_index(package->structs, i);
+        for (unsigned int m = 0; m < structure->members->len; m++) {
+            lcm_member_t *member = (lcm_member_t *) g_ptr_array_index(structure->members, m);
+            if (!g_hash_table_lookup(names, member->membername)) {
+                g_hash_table_insert(names, member->membername, member->membername);
+                g_ptr_array_add(name_list, member->membername);
+            }
+        }
+    }
+    emit(0, "enum {");
+    for (unsigned int i = 0; i < name_list->len; i++)
+        emit(1, "_cext_n_%s,", (char *) g_ptr_array_index(name_list, i));
+    emit(1, "_cext_num_names");
+    emit(0, "};");
+    emit(0, "");
+    emit(0, "static const char *_cext_name_strings[] = {");
+    for (unsigned int i = 0; i < name_list->len; i++)
+        emit(1, "\"%s\",", (char *) g_ptr_array_index(name_list, i));
+    emit(1, "NULL,");
+    emit(0, "};");
+    emit(0, "");
+    emit(0, "static PyObject *_cext_names[_cext_num_names + 1];");
+    emit(0, "");
+    g_ptr_array_free(name_list, TRUE);
+    g_hash_table_destroy(names);
+
+    // the types
+    GHashTable *others = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    for (unsigned int i = 0; i < package->structs->len; i++) {
+        lcm_struct_t *structure = (lcm_struct_t *) g_ptr_array_index(package->structs, i);
+        emit(0, "static _cext_type_t _cext_t_%s = {\"%s\", \"%s\", NULL, NULL};",
+             structure->structname->shortname, structure->structname->lctypename,
+             structure->structname->shortname);
+        for (unsigned int m = 0; m < structure->members->len; m++) {
+            lcm_member_t *member = (lcm_member_t *) g_ptr_array_index(structure->members, m);
+            if (lcm_is_primitive_type(member->type->lctypename) ||
+                _cext_is_local(package, member->type))
+                continue;
+            char *other = _cext_other_name(member->type);
+            if (g_hash_table_lookup(others, other)) {
+                g_free(other);
+                continue;
+            }
+            emit(0, "static _cext_type_t %s = {\"%s\", \"%s\", NULL, NULL};", other,
+                 member->type->lctypename, member->type->shortname);
+            g_hash_table_insert(others, other, other);
+        }
+    }
+    g_hash_table_destroy(others);
+    emit(0, "");
+    for (unsigned int i = 0; i < package->structs->len; i++) {
+        lcm_struct_t *structure = (lcm_struct_t *) g_ptr_array_index(package->structs, i);
+        const char *sn = structure->structname->shortname;
+        emit(0, "static int _cext_put_%s(_cext_wbuf_t *b, PyObject *self, void *arg);", sn);
+        emit(0, "static PyObject *_cext_get_%s(_cext_rbuf_t *b, void *arg);", sn);
+    }
+    emit(0, "");
+
+    for (unsigned int i = 0; i < package->structs->len; i++) {
+        lcm_struct_t *structure = (lcm_struct_t *) g_ptr_array_index(package->structs, i);
+        const char *sn = structure->structname->shortname;
+
+        // clang-format off
+        emit(0, "static int _cext_put_%s(_cext_wbuf_t *b, PyObject *self, void *arg)", sn);
+        emit(0, "{");
+        _cext_emit_dimension_variables(f, structure);
+        emit(1,     "if (_cext_check(self, &_cext_t_%s) < 0)", sn);
+        emit(2,         "return -1;");
+        for (unsigned int m = 0; m < structure->members->len; m++)
+            _cext_emit_member(f, package, structure,
+                              (lcm_member_t *) g_ptr_array_index(structure->members, m), 0);
+        emit(1,     "return 0;");
+        emit(0, "}");
+        emit(0, "");
+
+        emit(0, "static PyObject *_cext_get_%s(_cext_rbuf_t *b, void *arg)", sn);
+        emit(0, "{");
+        _cext_emit_dimension_variables(f, structure);
+        emit(1,     "PyObject *self = _cext_new(&_cext_t_%s);", sn);
+        emit(1,     "if (!self)");
+        emit(2,         "return NULL;");
+        for (unsigned int m = 0; m < structure->members->len; m++)
+            _cext_emit_member(f, package, structure,
+                              (lcm_member_t *) g_ptr_array_index(structure->members, m), 1);
+        emit(1,     "return self;");
+        emit(0, "fail:");
+        emit(1,     "Py_DECREF(self);");
+        emit(1,     "return NULL;");
+        emit(0, "}");
+        emit(0, "");
+
+        emit(0, "static PyObject *_cext_encode_%s(PyObject *module, PyObject *o)", sn);
+        emit(0, "{");
+        emit(1,     "return _cext_encode(o, &_cext_t_%s, _cext_put_%s);", sn, sn);
+        emit(0, "}");
+        emit(0, "");
+
+        emit(0, "static PyObject *_cext_decode_%s(PyObject *module, PyObject *data)", sn);
+        emit(0, "{");
+        emit(1,     "return _cext_decode(data, &_cext_t_%s, _cext_get_%s);", sn, sn);
+        emit(0, "}");
+        emit(0, "");
+        // clang-format on
+    }
+
+    emit(0, "static PyMethodDef _cext_methods[] = {");
+    for (unsigned int i = 0; i < package->structs->len; i++) {
+        lcm_struct_t *structure = (lcm_struct_t *) g_ptr_array_index(package->structs, i);
+        const char *sn = structure->structname->shortname;
+        emit(1, "{\"encode_%s\", _cext_encode_%s, METH_O, NULL},", sn, sn);
+        emit(1, "{\"decode_%s\", _cext_decode_%s, METH_O, NULL},", sn, sn);
+    }
+    emit(1, "{NULL, NULL, 0, NULL},");
+    emit(0, "};");
+    emit(0, "");
+
+    // clang-format off
+    emit(0, "static struct PyModuleDef _cext_module = {");
+    emit(1,     "PyModuleDef_HEAD_INIT, \"%s%s_lcm_cext\", NULL, -1, _cext_methods,",
+                package->name, strlen(package->name) ? "." : "");
+    emit(1,     "NULL, NULL, NULL, NULL,");
+    emit(0, "};");
+    emit(0, "");
+    emit(0, "PyMODINIT_FUNC PyInit__lcm_cext(void)");
+    emit(0, "{");
+    emit(1,     "for (int i = 0; _cext_name_strings[i]; i++) {");
+    emit(2,         "_cext_names[i] = PyUnicode_InternFromString(_cext_name_strings[i]);");
+    emit(2,         "if (!_cext_names[i])");
+    emit(3,             "return NULL;");
+    emit(1,     "}");
+    emit(1,     "if (_cext_init() < 0)");
+    emit(2,         "return NULL;");
+    emit(1,     "return PyModule_Create(&_cext_module);");
+    emit(0, "}");
+    // clang-format on
+
+    return lcm_fclose_output(lcm, f);
+}
+
 static int
 emit_package (lcmgen_t *lcm, _package_contents_t *package)
 {
@@ -950,7 +1841,7 @@ emit_package (lcmgen_t *lcm, _package_contents_t *package)
         if (!lcm_needs_generation(lcm, enumeration->lcmfile, path))
             continue;
 
-        FILE *f = fopen(path, "w");
+        FILE *f = lcm_fopen_output(lcm, path);
         if (f==NULL) return -1;
 
         fprintf(f, "\"\"\"LCM type definitions\n"
@@ -1011,7 +1902,7 @@ emit_package (lcmgen_t *lcm, _package_contents_t *package)
         // clang-format on
 
         fprintf(f, "\n");
-        fclose(f);
+        lcm_fclose_output(lcm, f);
     }
 
     ////////////////////////////////////////////////////////////
@@ -1034,7 +1925,7 @@ emit_package (lcmgen_t *lcm, _package_contents_t *package)
         if (!lcm_needs_generation(lcm, structure->lcmfile, path))
             continue;
 
-        FILE *f = fopen(path, "w");
+        FILE *f = lcm_fopen_output(lcm, path);
         if (f == NULL)
             return -1;
 
@@ -1051,8 +1942,13 @@ emit_package (lcmgen_t *lcm, _package_contents_t *package)
                 "\n"
                 "from io import BytesIO\n"
                 "import struct\n\n");
+        if (getopt_get_bool(lcm->gopt, "python-numpy"))
+            emit_python_numpy(lcm, f, structure);
 
         emit_python_dependencies(lcm, f, structure, write_init_py);
+        emit_python_structs(lcm, f, structure);
+        if (getopt_get_bool(lcm->gopt, "python-cext"))
+            emit_python_cext_import(lcm, f, structure);
 
         fprintf(f, "class %s(object):\n", structure->structname->shortname);
         emit_comment(f, 1, structure->comment);
@@ -1114,17 +2010,25 @@ emit_package (lcmgen_t *lcm, _package_contents_t *package)
         emit_python_decode(lcm, f, structure);
         emit_python_decode_one(lcm, f, structure);
         emit_python_fingerprint(lcm, f, structure);
-        fclose(f);
+        lcm_fclose_output(lcm, f);
     }
 
     if (init_py_fp)
         fclose(init_py_fp);
     g_hash_table_destroy(init_py_imports);
+
+    if (getopt_get_bool(lcm->gopt, "python-cext"))
+        return emit_python_cext(lcm, package, package_dir);
     return 0;
 }
 
 int emit_python(lcmgen_t *lcm)
 {
+    if (getopt_get_bool(lcm->gopt, "python-cext") && getopt_get_bool(lcm->gopt, "python-numpy")) {
+        err("--python-cext can't be used with --python-numpy\n");
+        return -1;
+    }
+
     GHashTable *package_table = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
                                                       (GDestroyNotify) _package_contents_free);
 
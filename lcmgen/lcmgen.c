@@ -390,6 +390,24 @@ void tokenize_next_or_fail(tokenize_t *t, const char *description)
         parse_error(t, "End of file reached, expected %s.", description);
 }
 
+// If the next token is a comment like "/* max 64 */", consume it and return
+// the number, which bounds the length of the variable size dimension that it
+// follows.  Else, return 0.
+static int parse_try_max_size(tokenize_t *t)
+{
+    if (tokenize_peek(t) == EOF || t->token_type != LCM_TOK_COMMENT)
+        return 0;
+
+    int max_size, end = 0;
+    if (sscanf(t->token, " max %d %n", &max_size, &end) != 1 || t->token[end] != '\0')
+        return 0;
+    if (max_size <= 0)
+        semantic_error(t, "Maximum array size must be > 0");
+
+    tokenize_next(t);
+    return max_size;
+}
+
 int parse_const(lcmgen_t *lcmgen, lcm_struct_t *lr, tokenize_t *t)
 {
     parse_try_consume_comment(lcmgen, t, 0);
@@ -605,7 +623,12 @@ int parse_member(lcmgen_t *lcmgen, lcm_struct_t *lr, tokenize_t *t)
                     dim->size = strdup(t->token);
                 }
             }
+            // the bound may be given inside the brackets or after them
+            if (dim->mode == LCM_VAR)
+                dim->max_size = parse_try_max_size(t);
             parse_require(t, "]");
+            if (dim->mode == LCM_VAR && !dim->max_size)
+                dim->max_size = parse_try_max_size(t);
 
             // increase the dimensionality of the array by one dimension.
             g_ptr_array_add(lm->dimensions, dim);
@@ -837,7 +860,10 @@ void lcm_member_dump(lcm_member_t *lm)
             printf(" [ (const) %s ]", dim->size);
             break;
         case LCM_VAR:
-            printf(" [ (var) %s ]", dim->size);
+            if (dim->max_size)
+                printf(" [ (var) %s (max) %d ]", dim->size, dim->max_size);
+            else
+                printf(" [ (var) %s ]", dim->size);
             break;
         default:
             // oops! unhandled case
@@ -929,6 +955,91 @@ int lcm_needs_generation(lcmgen_t *lcmgen, const char *declaringfile, const char
     return instat.st_mtime > outstat.st_mtime;
 }
 
+// Temporary output files by their FILE, whose target paths are the values.
+// Shared by parallel code generation jobs.
+static GHashTable *temp_outputs = NULL;
+static GMutex temp_outputs_mutex;
+
+FILE *lcm_fopen_output(lcmgen_t *lcmgen, const char *outfile)
+{
+    if (!getopt_get_bool(lcmgen->gopt, "skip-unchanged"))
+        return fopen(outfile, "w");
+
+    char *tmpfile = g_strdup_printf("%s.lcmgen-tmp", outfile);
+    FILE *f = fopen(tmpfile, "w");
+    g_free(tmpfile);
+    if (f == NULL)
+        return NULL;
+
+    g_mutex_lock(&temp_outputs_mutex);
+    if (temp_outputs == NULL)
+        temp_outputs = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+    g_hash_table_insert(temp_outputs, f, g_strdup(outfile));
+    g_mutex_unlock(&temp_outputs_mutex);
+    return f;
+}
+
+// Returns 1 if the files at the two paths exist and have the same contents.
+static int files_equal(const char *path_a, const char *path_b)
+{
+    FILE *a = fopen(path_a, "rb");
+    if (a == NULL)
+        return 0;
+    FILE *b = fopen(path_b, "rb");
+    if (b == NULL) {
+        fclose(a);
+        return 0;
+    }
+
+    int equal = 1;
+    char buf_a[8192], buf_b[8192];
+    while (equal) {
+        size_t n_a = fread(buf_a, 1, sizeof(buf_a), a);
+        size_t n_b = fread(buf_b, 1, sizeof(buf_b), b);
+        if (n_a != n_b || memcmp(buf_a, buf_b, n_a))
+            equal = 0;
+        else if (n_a == 0)
+            break;
+    }
+
+    fclose(a);
+    fclose(b);
+    return equal;
+}
+
+int lcm_fclose_output(lcmgen_t *lcmgen, FILE *f)
+{
+    char *outfile = NULL;
+    if (getopt_get_bool(lcmgen->gopt, "skip-unchanged")) {
+        g_mutex_lock(&temp_outputs_mutex);
+        if (temp_outputs != NULL && g_hash_table_lookup_extended(temp_outputs, f, NULL,
+                                                                 (gpointer *) &outfile))
+            g_hash_table_steal(temp_outputs, f);
+        g_mutex_unlock(&temp_outputs_mutex);
+    }
+
+    int res = fclose(f);
+    if (outfile == NULL)
+        return res;
+
+    char *tmpfile = g_strdup_printf("%s.lcmgen-tmp", outfile);
+    if (res == 0 && !files_equal(tmpfile, outfile)) {
+#ifdef WIN32
+        // rename() doesn't replace existing files on Windows
+        remove(outfile);
+#endif
+        res = rename(tmpfile, outfile);
+        if (res)
+            perror(outfile);
+    } else {
+        remove(tmpfile);
+    }
+
+    g_free(tmpfile);
+    g_free(outfile);
+    return res;
+}
+
 /** Is the member an array of constant size? If it is not an array, it returns zero. **/
 int lcm_is_constant_size_array(lcm_member_t *lm)
 {
@@ -946,3 +1057,203 @@ int lcm_is_constant_size_array(lcm_member_t *lm)
 
     return 1;
 }
+
+int lcm_is_bounded_array(lcm_member_t *lm)
+{
+    if (lcm_is_constant_size_array(lm))
+        return 0;
+
+    for (unsigned int i = 0; i < g_ptr_array_size(lm->dimensions); i++) {
+        lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, i);
+
+        if (dim->mode == LCM_VAR && !dim->max_size)
+            return 0;
+    }
+
+    return 1;
+}
+
+int lcm_is_dimension_member(lcm_struct_t *ls, lcm_member_t *lm)
+{
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *array = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        for (unsigned int d = 0; d < g_ptr_array_size(array->dimensions); d++) {
+            lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(array->dimensions, d);
+            if (dim->mode == LCM_VAR && !strcmp(dim->size, lm->membername))
+                return 1;
+        }
+    }
+    return 0;
+}
+
+lcm_struct_t *lcm_find_struct(lcmgen_t *lcm, lcm_member_t *lm)
+{
+    GPtrArray *structs = lcm->all_structs ? lcm->all_structs : lcm->structs;
+    for (unsigned int s = 0; s < g_ptr_array_size(structs); s++) {
+        lcm_struct_t *ls = (lcm_struct_t *) g_ptr_array_index(structs, s);
+        if (!strcmp(lm->type->lctypename, ls->structname->lctypename))
+            return ls;
+    }
+    return NULL;
+}
+
+// The structs that a fingerprint is being computed within, like the
+// __lcm_hash_ptr chain of the generated code.
+struct __fingerprint_parent {
+    const struct __fingerprint_parent *parent;
+    const lcm_struct_t *ls;
+};
+
+static int __lcm_recursive_fingerprint(lcmgen_t *lcm, const lcm_struct_t *ls,
+                                       const struct __fingerprint_parent *parents,
+                                       uint64_t *fingerprint)
+{
+    // A struct within itself adds nothing to the fingerprint
+    for (const struct __fingerprint_parent *p = parents; p != NULL; p = p->parent) {
+        if (p->ls == ls) {
+            *fingerprint = 0;
+            return 0;
+        }
+    }
+    struct __fingerprint_parent fp = {parents, ls};
+
+    // Compute hash for all members
+    uint64_t hash = (uint64_t) ls->hash;
+    for (unsigned int m = 0; m < ls->members->len; m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        if (lcm_is_primitive_type(lm->type->lctypename))
+            continue;
+
+        const lcm_struct_t *ls_ = lcm_find_struct(lcm, lm);
+        uint64_t member_hash;
+        if (ls_ == NULL || __lcm_recursive_fingerprint(lcm, ls_, &fp, &member_hash) < 0)
+            return -1;
+        hash += member_hash;
+    }
+
+    *fingerprint = (hash << 1) + (hash >> 63);
+    return 0;
+}
+
+int lcm_compute_fingerprint(lcmgen_t *lcm, const lcm_struct_t *ls, uint64_t *fingerprint)
+{
+    return __lcm_recursive_fingerprint(lcm, ls, NULL, fingerprint);
+}
+
+uint64_t lcm_get_fingerprint(lcmgen_t *lcm, lcm_struct_t *ls)
+{
+    uint64_t fingerprint;
+    if (lcm_compute_fingerprint(lcm, ls, &fingerprint) < 0) {
+        fprintf(stderr, "Unable to locate fingerprint for a member of '%s'\n",
+                ls->structname->shortname);
+        return 0;
+    }
+    return fingerprint;
+}
+
+int lcm_is_first_in_package(lcmgen_t *lcm, lcm_struct_t *ls)
+{
+    GPtrArray *structs = lcm->all_structs ? lcm->all_structs : lcm->structs;
+    for (unsigned int s = 0; s < g_ptr_array_size(structs); s++) {
+        lcm_struct_t *other = (lcm_struct_t *) g_ptr_array_index(structs, s);
+        if (!strcmp(other->structname->package, ls->structname->package))
+            return other == ls;
+    }
+    return 0;
+}
+
+static int compare_registered_structs(gconstpointer a, gconstpointer b)
+{
+    int64_t fa = ((const lcm_registered_struct_t *) a)->fingerprint;
+    int64_t fb = ((const lcm_registered_struct_t *) b)->fingerprint;
+    return fa < fb ? -1 : fa > fb;
+}
+
+GArray *lcm_get_package_registry(lcmgen_t *lcm, const char *package)
+{
+    GPtrArray *structs = lcm->all_structs ? lcm->all_structs : lcm->structs;
+    GArray *registry = g_array_new(FALSE, FALSE, sizeof(lcm_registered_struct_t));
+    for (unsigned int s = 0; s < g_ptr_array_size(structs); s++) {
+        lcm_struct_t *ls = (lcm_struct_t *) g_ptr_array_index(structs, s);
+        if (strcmp(ls->structname->package, package))
+            continue;
+
+        uint64_t fingerprint;
+        if (lcm_compute_fingerprint(lcm, ls, &fingerprint) < 0)
+            continue;
+        lcm_registered_struct_t entry;
+        entry.fingerprint = (int64_t) fingerprint;
+        entry.ls = ls;
+        g_array_append_val(registry, entry);
+    }
+    g_array_sort(registry, compare_registered_structs);
+    return registry;
+}
+
+int lcm_get_primitive_encoded_size(const char *t)
+{
+    if (!strcmp(t, "int16_t"))
+        return 2;
+    if (!strcmp(t, "int32_t") || !strcmp(t, "float"))
+        return 4;
+    if (!strcmp(t, "int64_t") || !strcmp(t, "double"))
+        return 8;
+    return 1;
+}
+
+static int fixed_encoded_size(lcmgen_t *lcm, const lcm_struct_t *ls, int depth);
+
+static int fixed_member_encoded_size(lcmgen_t *lcm, lcm_member_t *lm, int depth)
+{
+    if (!lcm_is_constant_size_array(lm) || !strcmp(lm->type->lctypename, "string"))
+        return -1;
+
+    int64_t size;
+    if (lcm_is_primitive_type(lm->type->lctypename)) {
+        size = lcm_get_primitive_encoded_size(lm->type->lctypename);
+    } else {
+        const lcm_struct_t *member_ls = lcm_find_struct(lcm, lm);
+        if (!member_ls)
+            return -1;
+        size = fixed_encoded_size(lcm, member_ls, depth + 1);
+        if (size < 0)
+            return -1;
+    }
+
+    for (unsigned int d = 0; d < g_ptr_array_size(lm->dimensions); d++) {
+        lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+        size *= strtol(dim->size, NULL, 0);
+        if (size > INT32_MAX)
+            return -1;
+    }
+    return (int) size;
+}
+
+static int fixed_encoded_size(lcmgen_t *lcm, const lcm_struct_t *ls, int depth)
+{
+    // a type can't contain itself by value, so this only stops on bad input
+    if (depth > 64)
+        return -1;
+
+    int64_t size = 0;
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        int member_size = fixed_member_encoded_size(lcm, lm, depth);
+        if (member_size < 0)
+            return -1;
+        size += member_size;
+        if (size > INT32_MAX)
+            return -1;
+    }
+    return (int) size;
+}
+
+int lcm_get_fixed_encoded_size(lcmgen_t *lcm, const lcm_struct_t *ls)
+{
+    return fixed_encoded_size(lcm, ls, 0);
+}
+
+int lcm_get_fixed_member_encoded_size(lcmgen_t *lcm, lcm_member_t *lm)
+{
+    return fixed_member_encoded_size(lcm, lm, 0);
+}
@@ -3,6 +3,7 @@
 
 #include <glib.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #include "getopt.h"
 
@@ -37,6 +38,10 @@ typedef struct lcm_dimension lcm_dimension_t;
 struct lcm_dimension {
     lcm_dimension_mode_t mode;
     char *size;  // a string containing either a member variable name or a constant
+
+    // The largest length of a variable size dimension, from a "/* max N */"
+    // comment right after it, or 0 if it is unbounded.
+    int max_size;
 };
 
 /////////////////////////////////////////////////
@@ -159,6 +164,10 @@ struct lcmgen {
     getopt_t *gopt;
     GPtrArray *structs;  // lcm_struct_t
     GPtrArray *enums;    // lcm_enum_t (declared at top level)
+
+    // All parsed structs, when structs only holds those that one of several
+    // parallel code generation jobs emits. NULL otherwise.
+    GPtrArray *all_structs;
 };
 
 /////////////////////////////////////////////////
@@ -180,10 +189,47 @@ lcm_member_t *lcm_find_member(lcm_struct_t *lr, const char *name);
 // Returns the constant of a struct by name. Returns NULL on error.
 lcm_constant_t *lcm_find_const(lcm_struct_t *lr, const char *name);
 
+// Returns the parsed struct that is the type of a member. Returns NULL if it
+// isn't a struct, or wasn't parsed.
+lcm_struct_t *lcm_find_struct(lcmgen_t *lcm, lcm_member_t *lm);
+
+// Computes the fingerprint of a struct, which begins its encoded messages,
+// as the generated code does at runtime. Returns 0, or -1 if the type of a
+// member wasn't parsed, so that the fingerprint is only known at runtime.
+int lcm_compute_fingerprint(lcmgen_t *lcm, const lcm_struct_t *ls, uint64_t *fingerprint);
+
+// Returns the fingerprint of a struct, which begins its encoded messages.
+// Returns 0 and warns if the type of a member wasn't parsed.
+uint64_t lcm_get_fingerprint(lcmgen_t *lcm, lcm_struct_t *ls);
+
+// Returns 1 if ls is the first parsed struct of its package, so that code for
+// a whole package is emitted once, also by parallel code generation jobs.
+int lcm_is_first_in_package(lcmgen_t *lcm, lcm_struct_t *ls);
+
+// A struct of a package registry, see lcm_get_package_registry().
+typedef struct {
+    int64_t fingerprint;
+    lcm_struct_t *ls;
+} lcm_registered_struct_t;
+
+// Returns a new array of lcm_registered_struct_t for the parsed structs of a
+// package, sorted by fingerprint as signed integers. Structs whose fingerprint
+// can't be computed, because the type of a member wasn't parsed, are left out.
+GArray *lcm_get_package_registry(lcmgen_t *lcm, const char *package);
+
 // Returns 1 if the "lazy" option is enabled AND the file "outfile" is
 // older than the file "declaringfile"
 int lcm_needs_generation(lcmgen_t *lcmgen, const char *declaringfile, const char *outfile);
 
+// Opens outfile for writing generated code. If the "skip-unchanged" option
+// is enabled, the code is written to a temporary file instead, which only
+// replaces outfile if their contents differ, so that unchanged outputs keep
+// their modification time.
+FILE *lcm_fopen_output(lcmgen_t *lcmgen, const char *outfile);
+
+// Closes a file opened by lcm_fopen_output(). Returns 0 on success.
+int lcm_fclose_output(lcmgen_t *lcmgen, FILE *f);
+
 // create a new parsing context.
 lcmgen_t *lcmgen_create();
 
@@ -197,4 +243,24 @@ int lcmgen_handle_file(lcmgen_t *lcm, const char *path);
 // (scalars return 1)
 int lcm_is_constant_size_array(lcm_member_t *lm);
 
+// Is this a variable size array whose every variable dimension has a
+// max_size?  Its elements then fit into storage of a constant size.
+int lcm_is_bounded_array(lcm_member_t *lm);
+
+// Returns 1 if lm is the length of an array member of ls.
+int lcm_is_dimension_member(lcm_struct_t *ls, lcm_member_t *lm);
+
+// Returns the encoded size of a primitive type other than string.
+int lcm_get_primitive_encoded_size(const char *t);
+
+// Returns the size that every encoding of the struct has, without the
+// fingerprint, if its members are all primitives other than strings and
+// such structs, in constant size arrays or not.  Otherwise, or if the type of
+// a member wasn't parsed, returns -1.
+int lcm_get_fixed_encoded_size(lcmgen_t *lcm, const lcm_struct_t *ls);
+
+// Returns the size that every encoding of the member has, like
+// lcm_get_fixed_encoded_size(), or -1.
+int lcm_get_fixed_member_encoded_size(lcmgen_t *lcm, lcm_member_t *lm);
+
 #endif
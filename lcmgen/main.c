@@ -41,6 +41,188 @@ int emit_dart(lcmgen_t *lcm);
 void setup_cpp_options(getopt_t *gopt);
 int emit_cpp(lcmgen_t *lcm);
 
+// A code generator for one language.
+typedef struct {
+    const char *option;
+    const char *name;
+    int (*emit)(lcmgen_t *lcm);
+    // Whether the generator writes a file per type and nothing else, so that
+    // the types can be divided among parallel jobs.
+    int per_type;
+} language_t;
+
+static const language_t languages[] = {
+    {"c", "C", emit_c, 1},
+    {"cpp", "C++", emit_cpp, 1},
+    {"java", "Java", emit_java, 1},
+    {"python", "Python", emit_python, 0},
+    {"lua", "Lua", emit_lua, 0},
+    {"csharp", "C#.NET", emit_csharp, 1},
+    {"go", "Go", emit_go, 1},
+    {"dart", "Dart", emit_dart, 1},
+};
+#define NUM_LANGUAGES (sizeof(languages) / sizeof(languages[0]))
+
+// Work shared by a pool of threads, which take the next job by index.
+typedef struct {
+    GMutex mutex;
+    unsigned int next;
+    unsigned int njobs;
+    void (*run)(gpointer job);
+    gpointer *jobs;
+} job_pool_t;
+
+static gpointer job_pool_worker(gpointer data)
+{
+    job_pool_t *pool = (job_pool_t *) data;
+    while (1) {
+        g_mutex_lock(&pool->mutex);
+        unsigned int i = pool->next++;
+        g_mutex_unlock(&pool->mutex);
+        if (i >= pool->njobs)
+            return NULL;
+        pool->run(pool->jobs[i]);
+    }
+}
+
+// Runs run(jobs[i]) for every job on nthreads threads, and waits for them.
+static void run_jobs(void (*run)(gpointer job), gpointer *jobs, unsigned int njobs,
+                     int nthreads)
+{
+    job_pool_t pool = {.next = 0, .njobs = njobs, .run = run, .jobs = jobs};
+    g_mutex_init(&pool.mutex);
+
+    if (nthreads > (int) njobs)
+        nthreads = njobs;
+    GThread **threads = (GThread **) calloc(nthreads, sizeof(GThread *));
+    for (int i = 0; i < nthreads; i++)
+        threads[i] = g_thread_new("lcm-gen", job_pool_worker, &pool);
+    for (int i = 0; i < nthreads; i++)
+        g_thread_join(threads[i]);
+
+    free(threads);
+    g_mutex_clear(&pool.mutex);
+}
+
+// Parses a run of the input files into its own lcmgen_t.
+typedef struct {
+    lcmgen_t *lcm;
+    char **paths;
+    unsigned int npaths;
+    int res;
+} parse_job_t;
+
+static void run_parse_job(gpointer data)
+{
+    parse_job_t *job = (parse_job_t *) data;
+    for (unsigned int i = 0; i < job->npaths && !job->res; i++)
+        job->res = lcmgen_handle_file(job->lcm, job->paths[i]);
+}
+
+// Parses the input files on njobs threads. Each thread parses a consecutive
+// run of the files, and the results are appended to lcm in the order of the
+// files, as if they had been parsed one after another. The only difference is
+// that a file without a package statement doesn't inherit one from a file
+// parsed by another thread.
+static int parse_files_parallel(lcmgen_t *lcm, GPtrArray *paths, int njobs)
+{
+    unsigned int npaths = g_ptr_array_size(paths);
+    if (njobs > (int) npaths)
+        njobs = npaths;
+
+    parse_job_t *jobs = (parse_job_t *) calloc(njobs, sizeof(parse_job_t));
+    gpointer *job_ptrs = (gpointer *) calloc(njobs, sizeof(gpointer));
+    unsigned int first = 0;
+    for (int i = 0; i < njobs; i++) {
+        unsigned int count = npaths / njobs + ((unsigned int) i < npaths % njobs);
+        jobs[i].lcm = lcmgen_create();
+        jobs[i].lcm->gopt = lcm->gopt;
+        jobs[i].paths = (char **) &g_ptr_array_index(paths, first);
+        jobs[i].npaths = count;
+        job_ptrs[i] = &jobs[i];
+        first += count;
+    }
+
+    run_jobs(run_parse_job, job_ptrs, njobs, njobs);
+
+    int res = 0;
+    for (int i = 0; i < njobs; i++) {
+        lcmgen_t *part = jobs[i].lcm;
+        if (jobs[i].res && !res)
+            res = jobs[i].res;
+        for (unsigned int j = 0; j < g_ptr_array_size(part->structs); j++)
+            g_ptr_array_add(lcm->structs, g_ptr_array_index(part->structs, j));
+        for (unsigned int j = 0; j < g_ptr_array_size(part->enums); j++)
+            g_ptr_array_add(lcm->enums, g_ptr_array_index(part->enums, j));
+        if (i == njobs - 1)
+            lcm->parse_cache = part->parse_cache;
+    }
+
+    free(job_ptrs);
+    free(jobs);
+    return res;
+}
+
+// Runs the generator of one language, for some or all of the types.
+typedef struct {
+    const language_t *language;
+    lcmgen_t lcm;
+    int res;
+} emit_job_t;
+
+static void run_emit_job(gpointer data)
+{
+    emit_job_t *job = (emit_job_t *) data;
+    job->res = job->language->emit(&job->lcm);
+}
+
+// Runs the generators of the languages that were asked for on njobs threads.
+// Generators that write a file per type get njobs jobs each, between which
+// the types are divided. Returns 0 if all of them succeeded.
+static int emit_parallel(lcmgen_t *lcm, const language_t **selected, unsigned int nselected,
+                         int njobs)
+{
+    GPtrArray *jobs = g_ptr_array_new();
+    for (unsigned int l = 0; l < nselected; l++) {
+        int nparts = selected[l]->per_type ? njobs : 1;
+        for (int part = 0; part < nparts; part++) {
+            emit_job_t *job = (emit_job_t *) calloc(1, sizeof(emit_job_t));
+            job->language = selected[l];
+            job->lcm = *lcm;
+            if (nparts > 1) {
+                job->lcm.structs = g_ptr_array_new();
+                job->lcm.enums = g_ptr_array_new();
+                job->lcm.all_structs = lcm->structs;
+                for (unsigned int i = part; i < g_ptr_array_size(lcm->structs); i += nparts)
+                    g_ptr_array_add(job->lcm.structs, g_ptr_array_index(lcm->structs, i));
+                for (unsigned int i = part; i < g_ptr_array_size(lcm->enums); i += nparts)
+                    g_ptr_array_add(job->lcm.enums, g_ptr_array_index(lcm->enums, i));
+            }
+            g_ptr_array_add(jobs, job);
+        }
+    }
+
+    run_jobs(run_emit_job, jobs->pdata, jobs->len, njobs);
+
+    int res = 0;
+    const language_t *failed = NULL;
+    for (unsigned int i = 0; i < jobs->len; i++) {
+        emit_job_t *job = (emit_job_t *) g_ptr_array_index(jobs, i);
+        if (job->res && job->language != failed) {
+            printf("An error occurred while emitting %s code.\n", job->language->name);
+            failed = job->language;
+            res = -1;
+        }
+        if (job->lcm.all_structs) {
+            g_ptr_array_free(job->lcm.structs, TRUE);
+            g_ptr_array_free(job->lcm.enums, TRUE);
+        }
+        free(job);
+    }
+    g_ptr_array_free(jobs, TRUE);
+    return res;
+}
+
 int main(int argc, char *argv[])
 {
     getopt_t *gopt = getopt_create();
@@ -50,6 +232,9 @@ int main(int argc, char *argv[])
     getopt_add_bool(gopt, 't', "tokenize", 0, "Show tokenization");
     getopt_add_bool(gopt, 'd', "debug",    0, "Show parsed file");
     getopt_add_bool(gopt,   0, "lazy",     0, "Generate output file only if .lcm is newer");
+    getopt_add_bool(gopt,   0, "skip-unchanged", 0,
+        "Leave output files whose contents wouldn't change untouched");
+    getopt_add_int(gopt,    0, "jobs",     "1", "Parse files and generate code using this many threads");
     getopt_add_bool(gopt,   0, "use-quotes-for-includes", 0,
         "Use quotes instead of angular brackets for including header files");
     getopt_add_string(gopt, 0, "package-prefix", "",
@@ -98,12 +283,23 @@ int main(int argc, char *argv[])
     lcmgen_t *lcm = lcmgen_create();
     lcm->gopt = gopt;
 
-    for (unsigned int i = 0; i < g_ptr_array_size(gopt->extraargs); i++) {
-        char *path = (char *) g_ptr_array_index(gopt->extraargs, i);
+    int njobs = getopt_get_int(gopt, "jobs");
+    // tokens and parse results are printed in order
+    if (getopt_get_bool(gopt, "tokenize") || getopt_get_bool(gopt, "debug"))
+        njobs = 1;
 
-        int res = lcmgen_handle_file(lcm, path);
+    if (njobs > 1 && g_ptr_array_size(gopt->extraargs) > 1) {
+        int res = parse_files_parallel(lcm, gopt->extraargs, njobs);
         if (res)
             return res;
+    } else {
+        for (unsigned int i = 0; i < g_ptr_array_size(gopt->extraargs); i++) {
+            char *path = (char *) g_ptr_array_index(gopt->extraargs, i);
+
+            int res = lcmgen_handle_file(lcm, path);
+            if (res)
+                return res;
+        }
     }
 
     // If "--version" was specified, then show version information and exit.
@@ -125,6 +321,24 @@ int main(int argc, char *argv[])
         lcmgen_dump(lcm);
     }
 
+    if (njobs > 1) {
+        const language_t *selected[NUM_LANGUAGES];
+        unsigned int nselected = 0;
+        for (unsigned int l = 0; l < NUM_LANGUAGES; l++) {
+            if (getopt_get_bool(gopt, languages[l].option))
+                selected[nselected++] = &languages[l];
+        }
+
+        if (nselected > 0) {
+            if (emit_parallel(lcm, selected, nselected, njobs))
+                res = -1;
+        } else if (!did_something) {
+            printf("No actions specified. Try --help.\n");
+            res = -1;
+        }
+        return res;
+    }
+
     if (getopt_get_bool(gopt, "c")) {
         did_something = 1;
         if (emit_c(lcm)) {
@@ -0,0 +1,842 @@
+// file: lcm-bench.c
+// desc: measures the publish to handle latency and the throughput of LCM
+//       providers, with publishers and subscribers in this process.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <getopt.h>
+#include <glib.h>
+#include <lcm/lcm.h>
+
+#define BENCH_CHANNEL "LCM_BENCH"
+#define BENCH_MAGIC 0x4c43424e
+
+#define DEFAULT_SIZES "64,1k,16k,256k,1m,8m"
+#define DEFAULT_DURATION 1.0
+#define DEFAULT_RATE 1000
+
+// Latencies kept per subscriber and run for the percentiles.
+#define MAX_LATENCY_SAMPLES 1000000
+
+// Publishers wait while this many bytes, or MAX_WINDOW messages, that they
+// published haven't reached every subscriber, so that providers that queue
+// without bounds aren't flooded.
+#define WINDOW_BYTES (16 * 1024 * 1024)
+#define MAX_WINDOW 1000
+
+// How long a publisher waits for a full window, before it assumes that the
+// rest of the window was lost and carries on.
+#define WINDOW_TIMEOUT_NS 100000000LL
+
+// How long a run waits for outstanding messages once publishing stopped.
+#define DRAIN_TIMEOUT_US 500000
+
+typedef enum { PATTERN_ZERO, PATTERN_COUNTER, PATTERN_RANDOM } pattern_t;
+static const char *pattern_names[] = {"zero", "counter", "random"};
+typedef enum { FORMAT_TEXT, FORMAT_JSON, FORMAT_CSV } format_t;
+
+// The beginning of every message, in host byte order, as publishers and
+// subscribers run in the same process.
+typedef struct {
+    uint32_t magic;
+    uint32_t run;
+    uint32_t publisher;
+    uint32_t seq;
+    int64_t sent_ns;
+} header_t;
+
+typedef struct _bench bench_t;
+
+typedef struct {
+    bench_t *bench;
+    lcm_t *lcm;
+    int id;
+    GThread *thread;
+
+    // published messages, read by other threads
+    gint sent;
+    int failed;
+} publisher_t;
+
+typedef struct {
+    bench_t *bench;
+    lcm_t *lcm;
+    lcm_subscription_t *subscription;
+
+    GMutex mutex;
+    // protected by mutex
+    uint32_t run;
+    int64_t received;
+    int64_t late;
+    int64_t corrupt;
+    GArray *latencies;  // int64_t, in ns
+
+    // the sequence number expected next from each publisher, which
+    // publishers read for flow control
+    gint *next_seq;
+} subscriber_t;
+
+// A thread that handles the messages of one lcm_t.
+typedef struct {
+    bench_t *bench;
+    lcm_t *lcm;
+    GThread *thread;
+} handler_t;
+
+struct _bench {
+    // options
+    int num_publishers;
+    int num_subscribers;
+    double duration;
+    int rate;
+    pattern_t pattern;
+    int verify;
+    format_t format;
+
+    // the provider being measured
+    const char *url;
+    int is_file;
+    publisher_t *publishers;
+    subscriber_t *subscribers;
+    GPtrArray *handlers;
+    gint quit;
+
+    // the current run
+    gint run;
+    int size;
+    int paced;
+    gint stop;
+    uint8_t *payload;
+
+    int printed_header;
+};
+
+typedef struct {
+    int64_t sent;
+    int64_t failed;
+    int64_t received;
+    int64_t lost;
+    int64_t late;
+    int64_t corrupt;
+    double elapsed;
+    GArray *latencies;
+} result_t;
+
+static int64_t now_ns(void)
+{
+#ifdef WIN32
+    return g_get_monotonic_time() * 1000;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+static int window_size(int size)
+{
+    int window = WINDOW_BYTES / size;
+    if (window > MAX_WINDOW)
+        return MAX_WINDOW;
+    return window < 1 ? 1 : window;
+}
+
+// Returns the sequence number of the oldest message of a publisher that
+// hasn't reached every subscriber.
+static uint32_t oldest_unreceived(bench_t *bench, int publisher, uint32_t sent)
+{
+    uint32_t oldest = sent;
+    // log files are read once they're written
+    if (bench->is_file)
+        return oldest;
+    for (int i = 0; i < bench->num_subscribers; i++) {
+        uint32_t next = (uint32_t) g_atomic_int_get(&bench->subscribers[i].next_seq[publisher]);
+        if (next < oldest)
+            oldest = next;
+    }
+    return oldest;
+}
+
+static gpointer publisher_thread(gpointer data)
+{
+    publisher_t *pub = (publisher_t *) data;
+    bench_t *bench = pub->bench;
+
+    uint8_t *msg = (uint8_t *) malloc(bench->size);
+    memcpy(msg, bench->payload, bench->size);
+
+    uint32_t window = window_size(bench->size);
+    int64_t interval_ns = bench->paced ? 1000000000LL / bench->rate : 0;
+    int64_t next_ns = now_ns();
+    uint32_t seq = 0;
+
+    while (!g_atomic_int_get(&bench->stop)) {
+        if (interval_ns) {
+            int64_t wait_ns = next_ns - now_ns();
+            if (wait_ns > 0)
+                g_usleep(wait_ns / 1000);
+            next_ns += interval_ns;
+        }
+
+        int64_t window_start = now_ns();
+        while (seq - oldest_unreceived(bench, pub->id, seq) >= window &&
+               !g_atomic_int_get(&bench->stop) && now_ns() - window_start < WINDOW_TIMEOUT_NS)
+            g_thread_yield();
+
+        header_t header;
+        header.magic = BENCH_MAGIC;
+        header.run = (uint32_t) g_atomic_int_get(&bench->run);
+        header.publisher = pub->id;
+        header.seq = seq;
+        header.sent_ns = now_ns();
+        memcpy(msg, &header, sizeof(header));
+
+        if (lcm_publish(pub->lcm, BENCH_CHANNEL, msg, bench->size) < 0) {
+            pub->failed++;
+            continue;
+        }
+        seq++;
+        g_atomic_int_set(&pub->sent, seq);
+    }
+
+    free(msg);
+    return NULL;
+}
+
+static void on_message(const lcm_recv_buf_t *rbuf, const char *channel, void *user)
+{
+    subscriber_t *sub = (subscriber_t *) user;
+    bench_t *bench = sub->bench;
+    int64_t received_ns = now_ns();
+
+    header_t header;
+    if (rbuf->data_size < sizeof(header))
+        return;
+    memcpy(&header, rbuf->data, sizeof(header));
+    if (header.magic != BENCH_MAGIC || header.publisher >= (uint32_t) bench->num_publishers)
+        return;
+
+    g_mutex_lock(&sub->mutex);
+    if (header.run == sub->run) {
+        sub->received++;
+
+        uint32_t expected = (uint32_t) g_atomic_int_get(&sub->next_seq[header.publisher]);
+        if (header.seq >= expected)
+            g_atomic_int_set(&sub->next_seq[header.publisher], header.seq + 1);
+        else
+            sub->late++;
+
+        if (bench->paced && sub->latencies->len < MAX_LATENCY_SAMPLES) {
+            int64_t latency = received_ns - header.sent_ns;
+            g_array_append_val(sub->latencies, latency);
+        }
+
+        if (bench->verify &&
+            (rbuf->data_size != (uint32_t) bench->size ||
+             memcmp((const uint8_t *) rbuf->data + sizeof(header),
+                    bench->payload + sizeof(header), bench->size - sizeof(header))))
+            sub->corrupt++;
+    }
+    g_mutex_unlock(&sub->mutex);
+}
+
+static gpointer handler_thread(gpointer data)
+{
+    handler_t *handler = (handler_t *) data;
+    while (!g_atomic_int_get(&handler->bench->quit)) {
+        if (lcm_handle_timeout(handler->lcm, 50) < 0) {
+            fprintf(stderr, "lcm_handle_timeout() failed\n");
+            break;
+        }
+    }
+    return NULL;
+}
+
+static void add_handler(bench_t *bench, lcm_t *lcm)
+{
+    handler_t *handler = (handler_t *) calloc(1, sizeof(handler_t));
+    handler->bench = bench;
+    handler->lcm = lcm;
+    handler->thread = g_thread_new("lcm-bench-handler", handler_thread, handler);
+    g_ptr_array_add(bench->handlers, handler);
+}
+
+static int subscribe(bench_t *bench, subscriber_t *sub, lcm_t *lcm)
+{
+    sub->lcm = lcm;
+    sub->subscription = lcm_subscribe(lcm, BENCH_CHANNEL, on_message, sub);
+    if (!sub->subscription) {
+        fprintf(stderr, "couldn't subscribe on %s\n", bench->url);
+        return -1;
+    }
+    // the publishers' window bounds the queue, so that messages are only lost
+    // by the provider
+    lcm_subscription_set_queue_capacity(sub->subscription, 0);
+    return 0;
+}
+
+// Returns a URL for opening the log file of a file:// URL for writing, or
+// for reading as fast as possible.
+static char *file_url(const char *url, const char *options)
+{
+    const char *query = strchr(url, '?');
+    int len = query ? (int) (query - url) : (int) strlen(url);
+    return g_strdup_printf("%.*s?%s", len, url, options);
+}
+
+// Creates the lcm_t instances of the publishers and subscribers. memq://
+// instances only carry their own messages, so all of them share one. The
+// instances for file:// URLs are created by each run, which writes a log and
+// then reads it back.
+static int setup_provider(bench_t *bench, const char *url)
+{
+    bench->url = url;
+    bench->is_file = g_str_has_prefix(url, "file://");
+    int shared = g_str_has_prefix(url, "memq://");
+
+    bench->publishers = (publisher_t *) calloc(bench->num_publishers, sizeof(publisher_t));
+    bench->subscribers = (subscriber_t *) calloc(bench->num_subscribers, sizeof(subscriber_t));
+    bench->handlers = g_ptr_array_new();
+    g_atomic_int_set(&bench->quit, 0);
+
+    lcm_t *shared_lcm = NULL;
+    if (shared) {
+        shared_lcm = lcm_create(url);
+        if (!shared_lcm) {
+            fprintf(stderr, "couldn't create an lcm_t for %s\n", url);
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < bench->num_publishers; i++) {
+        publisher_t *pub = &bench->publishers[i];
+        pub->bench = bench;
+        pub->id = i;
+        if (bench->is_file)
+            continue;
+        pub->lcm = shared ? shared_lcm : lcm_create(url);
+        if (!pub->lcm) {
+            fprintf(stderr, "couldn't create an lcm_t for %s\n", url);
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < bench->num_subscribers; i++) {
+        subscriber_t *sub = &bench->subscribers[i];
+        sub->bench = bench;
+        g_mutex_init(&sub->mutex);
+        sub->latencies = g_array_new(FALSE, FALSE, sizeof(int64_t));
+        sub->next_seq = (gint *) calloc(bench->num_publishers, sizeof(gint));
+        if (bench->is_file)
+            continue;
+
+        lcm_t *lcm = shared ? shared_lcm : lcm_create(url);
+        if (!lcm) {
+            fprintf(stderr, "couldn't create an lcm_t for %s\n", url);
+            return -1;
+        }
+        if (subscribe(bench, sub, lcm))
+            return -1;
+        if (!shared)
+            add_handler(bench, lcm);
+    }
+    if (shared)
+        add_handler(bench, shared_lcm);
+
+    return 0;
+}
+
+static void teardown_provider(bench_t *bench)
+{
+    g_atomic_int_set(&bench->quit, 1);
+    for (unsigned int i = 0; i < bench->handlers->len; i++) {
+        handler_t *handler = (handler_t *) g_ptr_array_index(bench->handlers, i);
+        g_thread_join(handler->thread);
+        free(handler);
+    }
+    g_ptr_array_free(bench->handlers, TRUE);
+
+    // destroy every instance once, some may be shared
+    GHashTable *instances = g_hash_table_new(g_direct_hash, g_direct_equal);
+    for (int i = 0; i < bench->num_publishers; i++) {
+        if (bench->publishers[i].lcm)
+            g_hash_table_insert(instances, bench->publishers[i].lcm, NULL);
+    }
+    for (int i = 0; i < bench->num_subscribers; i++) {
+        subscriber_t *sub = &bench->subscribers[i];
+        if (sub->lcm)
+            g_hash_table_insert(instances, sub->lcm, NULL);
+        g_mutex_clear(&sub->mutex);
+        g_array_free(sub->latencies, TRUE);
+        free(sub->next_seq);
+    }
+    GHashTableIter iter;
+    gpointer lcm;
+    g_hash_table_iter_init(&iter, instances);
+    while (g_hash_table_iter_next(&iter, &lcm, NULL))
+        lcm_destroy((lcm_t *) lcm);
+    g_hash_table_destroy(instances);
+
+    free(bench->publishers);
+    free(bench->subscribers);
+}
+
+static void fill_payload(bench_t *bench)
+{
+    free(bench->payload);
+    bench->payload = (uint8_t *) malloc(bench->size);
+    for (int i = 0; i < bench->size; i++) {
+        switch (bench->pattern) {
+        case PATTERN_ZERO:
+            bench->payload[i] = 0;
+            break;
+        case PATTERN_COUNTER:
+            bench->payload[i] = (uint8_t) i;
+            break;
+        case PATTERN_RANDOM:
+            bench->payload[i] = (uint8_t) g_random_int();
+            break;
+        }
+    }
+}
+
+// Returns 1 if every subscriber received the last message of every publisher.
+static int all_received(bench_t *bench)
+{
+    for (int p = 0; p < bench->num_publishers; p++) {
+        uint32_t sent = (uint32_t) g_atomic_int_get(&bench->publishers[p].sent);
+        if (oldest_unreceived(bench, p, sent) != sent)
+            return 0;
+    }
+    return 1;
+}
+
+// Reads the log file written by the publishers, as each subscriber.
+static double read_log(bench_t *bench)
+{
+    char *read_url = file_url(bench->url, "speed=0");
+    int64_t start_ns = now_ns();
+    for (int i = 0; i < bench->num_subscribers; i++) {
+        subscriber_t *sub = &bench->subscribers[i];
+        lcm_t *lcm = lcm_create(read_url);
+        if (!lcm) {
+            fprintf(stderr, "couldn't create an lcm_t for %s\n", read_url);
+            break;
+        }
+        if (subscribe(bench, sub, lcm) == 0) {
+            while (lcm_handle_timeout(lcm, 1000) > 0)
+                ;
+        }
+        lcm_destroy(lcm);
+        sub->lcm = NULL;
+    }
+    g_free(read_url);
+    return (now_ns() - start_ns) / 1e9 / bench->num_subscribers;
+}
+
+// Publishes messages of a size for the duration, paced at the rate or as fast
+// as possible, and collects what the subscribers received.
+static int run(bench_t *bench, int size, int paced, result_t *result)
+{
+    memset(result, 0, sizeof(*result));
+    bench->size = size;
+    bench->paced = paced;
+    fill_payload(bench);
+    uint32_t run_id = (uint32_t) g_atomic_int_add(&bench->run, 1) + 1;
+
+    for (int i = 0; i < bench->num_subscribers; i++) {
+        subscriber_t *sub = &bench->subscribers[i];
+        g_mutex_lock(&sub->mutex);
+        sub->run = run_id;
+        sub->received = 0;
+        sub->late = 0;
+        sub->corrupt = 0;
+        g_array_set_size(sub->latencies, 0);
+        for (int p = 0; p < bench->num_publishers; p++)
+            g_atomic_int_set(&sub->next_seq[p], 0);
+        g_mutex_unlock(&sub->mutex);
+    }
+
+    // file:// logs are written once, and then read back
+    lcm_t *writer = NULL;
+    if (bench->is_file) {
+        char *write_url = file_url(bench->url, "mode=w");
+        writer = lcm_create(write_url);
+        g_free(write_url);
+        if (!writer) {
+            fprintf(stderr, "couldn't create an lcm_t for %s\n", bench->url);
+            return -1;
+        }
+    }
+
+    g_atomic_int_set(&bench->stop, 0);
+    int64_t start_ns = now_ns();
+    for (int i = 0; i < bench->num_publishers; i++) {
+        publisher_t *pub = &bench->publishers[i];
+        g_atomic_int_set(&pub->sent, 0);
+        pub->failed = 0;
+        if (writer)
+            pub->lcm = writer;
+        pub->thread = g_thread_new("lcm-bench-publisher", publisher_thread, pub);
+    }
+    g_usleep((gulong) (bench->duration * 1e6));
+    g_atomic_int_set(&bench->stop, 1);
+    for (int i = 0; i < bench->num_publishers; i++)
+        g_thread_join(bench->publishers[i].thread);
+    result->elapsed = (now_ns() - start_ns) / 1e9;
+
+    if (bench->is_file) {
+        // flushes the log
+        lcm_destroy(writer);
+        for (int i = 0; i < bench->num_publishers; i++)
+            bench->publishers[i].lcm = NULL;
+        double read_elapsed = read_log(bench);
+        if (read_elapsed > result->elapsed)
+            result->elapsed = read_elapsed;
+    } else {
+        int64_t drain_start = g_get_monotonic_time();
+        while (!all_received(bench) && g_get_monotonic_time() - drain_start < DRAIN_TIMEOUT_US)
+            g_usleep(1000);
+    }
+
+    result->latencies = g_array_new(FALSE, FALSE, sizeof(int64_t));
+    for (int i = 0; i < bench->num_publishers; i++) {
+        result->sent += g_atomic_int_get(&bench->publishers[i].sent);
+        result->failed += bench->publishers[i].failed;
+    }
+    for (int i = 0; i < bench->num_subscribers; i++) {
+        subscriber_t *sub = &bench->subscribers[i];
+        g_mutex_lock(&sub->mutex);
+        // stop counting messages that are still on their way
+        sub->run = 0;
+        result->received += sub->received;
+        result->late += sub->late;
+        result->corrupt += sub->corrupt;
+        result->lost += result->sent - (sub->received - sub->late);
+        g_array_append_vals(result->latencies, sub->latencies->data, sub->latencies->len);
+        g_mutex_unlock(&sub->mutex);
+    }
+    return 0;
+}
+
+static int compare_int64(gconstpointer a, gconstpointer b)
+{
+    int64_t ia = *(const int64_t *) a;
+    int64_t ib = *(const int64_t *) b;
+    return ia < ib ? -1 : ia > ib;
+}
+
+// Returns the latency below which a fraction of the sorted samples are, in us.
+static double percentile_us(GArray *sorted, double fraction)
+{
+    guint index = (guint) ((sorted->len - 1) * fraction);
+    return g_array_index(sorted, int64_t, index) / 1000.0;
+}
+
+static void print_result(bench_t *bench, int paced, result_t *result)
+{
+    static const double fractions[] = {0.5, 0.9, 0.99, 0.999, 1.0};
+    static const char *names[] = {"p50", "p90", "p99", "p999", "max"};
+    const int nfractions = sizeof(fractions) / sizeof(fractions[0]);
+
+    const char *mode = paced ? "latency" : "throughput";
+    int64_t expected = result->sent * bench->num_subscribers;
+    double loss = expected > 0 ? (double) result->lost / expected : 0;
+    double delivered = (double) (result->received - result->late) / bench->num_subscribers;
+    double msgs_per_s = delivered / result->elapsed;
+    double mb_per_s = msgs_per_s * bench->size / (1024 * 1024);
+
+    int have_latency = result->latencies->len > 0 && !bench->is_file;
+    double latency[5] = {0};
+    if (have_latency) {
+        g_array_sort(result->latencies, compare_int64);
+        for (int i = 0; i < nfractions; i++)
+            latency[i] = percentile_us(result->latencies, fractions[i]);
+    }
+
+    switch (bench->format) {
+    case FORMAT_TEXT:
+        if (!bench->printed_header) {
+            printf("%-40s %9s %-10s %10s %10s %7s %11s %9s %9s %9s %9s %9s %9s\n", "url", "size",
+                   "mode", "sent", "received", "loss%", "msgs/s", "MB/s", "p50 us", "p90 us",
+                   "p99 us", "p999 us", "max us");
+        }
+        printf("%-40s %9d %-10s %10" PRId64 " %10" PRId64 " %7.3f %11.1f %9.2f", bench->url,
+               bench->size, mode, result->sent, result->received, loss * 100, msgs_per_s,
+               mb_per_s);
+        for (int i = 0; i < nfractions; i++) {
+            if (have_latency)
+                printf(" %9.1f", latency[i]);
+            else
+                printf(" %9s", "-");
+        }
+        printf("\n");
+        break;
+    case FORMAT_JSON:
+        printf("{\"url\": \"%s\", \"size\": %d, \"mode\": \"%s\", \"pattern\": \"%s\", "
+               "\"publishers\": %d, \"subscribers\": %d, \"elapsed_s\": %.6f, "
+               "\"sent\": %" PRId64 ", \"publish_failures\": %" PRId64 ", "
+               "\"received\": %" PRId64 ", \"lost\": %" PRId64 ", \"late\": %" PRId64 ", "
+               "\"corrupt\": %" PRId64 ", \"loss\": %.6f, \"msgs_per_s\": %.3f, "
+               "\"mb_per_s\": %.3f, \"latency_us\": ",
+               bench->url, bench->size, mode, pattern_names[bench->pattern], bench->num_publishers,
+               bench->num_subscribers, result->elapsed, result->sent, result->failed,
+               result->received, result->lost, result->late, result->corrupt, loss, msgs_per_s,
+               mb_per_s);
+        if (have_latency) {
+            printf("{");
+            for (int i = 0; i < nfractions; i++)
+                printf("%s\"%s\": %.3f", i ? ", " : "", names[i], latency[i]);
+            printf(", \"samples\": %u}", result->latencies->len);
+        } else {
+            printf("null");
+        }
+        printf("}\n");
+        break;
+    case FORMAT_CSV:
+        if (!bench->printed_header) {
+            printf("url,size,mode,pattern,publishers,subscribers,elapsed_s,sent,publish_failures,"
+                   "received,lost,late,corrupt,loss,msgs_per_s,mb_per_s");
+            for (int i = 0; i < nfractions; i++)
+                printf(",%s_us", names[i]);
+            printf("\n");
+        }
+        printf("%s,%d,%s,%s,%d,%d,%.6f,%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64
+               ",%" PRId64 ",%.6f,%.3f,%.3f",
+               bench->url, bench->size, mode, pattern_names[bench->pattern], bench->num_publishers,
+               bench->num_subscribers, result->elapsed, result->sent, result->failed,
+               result->received, result->lost, result->late, result->corrupt, loss, msgs_per_s,
+               mb_per_s);
+        for (int i = 0; i < nfractions; i++) {
+            if (have_latency)
+                printf(",%.3f", latency[i]);
+            else
+                printf(",");
+        }
+        printf("\n");
+        break;
+    }
+    bench->printed_header = 1;
+    fflush(stdout);
+}
+
+// Parses a comma separated list of sizes with optional k or m suffixes.
+static GArray *parse_sizes(const char *str)
+{
+    GArray *sizes = g_array_new(FALSE, FALSE, sizeof(int));
+    char **parts = g_strsplit(str, ",", 0);
+    for (int i = 0; parts[i]; i++) {
+        char *end;
+        long size = strtol(parts[i], &end, 10);
+        if (*end == 'k' || *end == 'K') {
+            size *= 1024;
+            end++;
+        } else if (*end == 'm' || *end == 'M') {
+            size *= 1024 * 1024;
+            end++;
+        }
+        if (*end || size < (long) sizeof(header_t) || size > (1 << 30)) {
+            fprintf(stderr, "invalid message size: %s (at least %d bytes)\n", parts[i],
+                    (int) sizeof(header_t));
+            g_array_free(sizes, TRUE);
+            sizes = NULL;
+            break;
+        }
+        int isize = (int) size;
+        g_array_append_val(sizes, isize);
+    }
+    g_strfreev(parts);
+    return sizes;
+}
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: lcm-bench [options]\n"
+            "\n"
+            "Measures the publish to handle latency and the throughput of LCM providers,\n"
+            "with publishers and subscribers in this process.  For every provider and\n"
+            "message size, a latency run publishes at a fixed rate, and a throughput run\n"
+            "publishes as fast as it can with a bounded number of messages on their way\n"
+            "to the subscribers.  Messages that don't reach a subscriber are counted as\n"
+            "lost, so the loss of a throughput run shows whether the provider sustains\n"
+            "its rate.  file:// logs are written and then read back as fast as possible,\n"
+            "at the rate of the slower of the two.\n"
+            "\n"
+            "Options:\n"
+            "\n"
+            "  -u, --lcm-url=URL          Measure the provider at URL.  Can be given more\n"
+            "                             than once.  (default: memq://, udpm://,\n"
+            "                             mpudpm:// and a file:// log in the temporary\n"
+            "                             directory.  tcpq:// needs a hub, and has to be\n"
+            "                             given.)\n"
+            "  -s, --sizes=LIST           Comma separated message sizes in bytes, with\n"
+            "                             optional k or m suffixes.\n"
+            "                             (default: " DEFAULT_SIZES ")\n"
+            "  -d, --duration=SECONDS     How long each run publishes.  (default: 1)\n"
+            "  -P, --publishers=N         Number of publishing threads.  (default: 1)\n"
+            "  -S, --subscribers=N        Number of subscribers.  (default: 1)\n"
+            "  -r, --rate=HZ              Messages per second of each publisher in\n"
+            "                             latency runs.  (default: %d)\n"
+            "  -m, --mode=MODE            latency, throughput or both.  (default: both)\n"
+            "  -p, --pattern=PATTERN      Payload bytes: zero, counter or random.\n"
+            "                             (default: counter)\n"
+            "      --verify               Check the payload of every received message.\n"
+            "  -f, --format=FORMAT        text, json (an object per line) or csv.\n"
+            "                             (default: text)\n"
+            "  -h, --help                 Shows this help text and exits.\n",
+            DEFAULT_RATE);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    bench_t bench;
+    memset(&bench, 0, sizeof(bench));
+    bench.num_publishers = 1;
+    bench.num_subscribers = 1;
+    bench.duration = DEFAULT_DURATION;
+    bench.rate = DEFAULT_RATE;
+    bench.pattern = PATTERN_COUNTER;
+    bench.format = FORMAT_TEXT;
+
+    const char *sizes_str = DEFAULT_SIZES;
+    int latency_runs = 1;
+    int throughput_runs = 1;
+    GPtrArray *urls = g_ptr_array_new_with_free_func(g_free);
+
+    char *optstring = "u:s:d:P:S:r:m:p:f:h";
+    struct option long_opts[] = {
+        {"lcm-url", required_argument, 0, 'u'},
+        {"sizes", required_argument, 0, 's'},
+        {"duration", required_argument, 0, 'd'},
+        {"publishers", required_argument, 0, 'P'},
+        {"subscribers", required_argument, 0, 'S'},
+        {"rate", required_argument, 0, 'r'},
+        {"mode", required_argument, 0, 'm'},
+        {"pattern", required_argument, 0, 'p'},
+        {"verify", no_argument, 0, 'v'},
+        {"format", required_argument, 0, 'f'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0},
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, optstring, long_opts, 0)) >= 0) {
+        switch (c) {
+        case 'u':
+            g_ptr_array_add(urls, g_strdup(optarg));
+            break;
+        case 's':
+            sizes_str = optarg;
+            break;
+        case 'd':
+            bench.duration = strtod(optarg, NULL);
+            if (bench.duration <= 0)
+                usage();
+            break;
+        case 'P':
+            bench.num_publishers = atoi(optarg);
+            if (bench.num_publishers < 1)
+                usage();
+            break;
+        case 'S':
+            bench.num_subscribers = atoi(optarg);
+            if (bench.num_subscribers < 1)
+                usage();
+            break;
+        case 'r':
+            bench.rate = atoi(optarg);
+            if (bench.rate < 1)
+                usage();
+            break;
+        case 'm':
+            latency_runs = !strcmp(optarg, "latency") || !strcmp(optarg, "both");
+            throughput_runs = !strcmp(optarg, "throughput") || !strcmp(optarg, "both");
+            if (!latency_runs && !throughput_runs)
+                usage();
+            break;
+        case 'p':
+            if (!strcmp(optarg, "zero"))
+                bench.pattern = PATTERN_ZERO;
+            else if (!strcmp(optarg, "counter"))
+                bench.pattern = PATTERN_COUNTER;
+            else if (!strcmp(optarg, "random"))
+                bench.pattern = PATTERN_RANDOM;
+            else
+                usage();
+            break;
+        case 'v':
+            bench.verify = 1;
+            break;
+        case 'f':
+            if (!strcmp(optarg, "text"))
+                bench.format = FORMAT_TEXT;
+            else if (!strcmp(optarg, "json"))
+                bench.format = FORMAT_JSON;
+            else if (!strcmp(optarg, "csv"))
+                bench.format = FORMAT_CSV;
+            else
+                usage();
+            break;
+        case 'h':
+        default:
+            usage();
+            break;
+        }
+    }
+
+    GArray *sizes = parse_sizes(sizes_str);
+    if (!sizes)
+        return 1;
+
+    char *log_path = NULL;
+    if (urls->len == 0) {
+        g_ptr_array_add(urls, g_strdup("memq://"));
+        g_ptr_array_add(urls, g_strdup("udpm://239.255.76.67:7667?ttl=0"));
+        g_ptr_array_add(urls, g_strdup("mpudpm://239.255.76.67:7667?ttl=0"));
+        log_path = g_strdup_printf("%s%slcm-bench-%08x.log", g_get_tmp_dir(), G_DIR_SEPARATOR_S,
+                                   g_random_int());
+        g_ptr_array_add(urls, g_strdup_printf("file://%s", log_path));
+    }
+
+    int status = 0;
+    for (unsigned int u = 0; u < urls->len && !status; u++) {
+        if (setup_provider(&bench, (const char *) g_ptr_array_index(urls, u))) {
+            status = 1;
+            break;
+        }
+        for (unsigned int s = 0; s < sizes->len && !status; s++) {
+            int size = g_array_index(sizes, int, s);
+            for (int paced = 1; paced >= 0 && !status; paced--) {
+                if ((paced && !latency_runs) || (!paced && !throughput_runs))
+                    continue;
+                // log files have no meaningful latency
+                if (paced && bench.is_file)
+                    continue;
+
+                result_t result;
+                if (run(&bench, size, paced, &result)) {
+                    status = 1;
+                    break;
+                }
+                print_result(&bench, paced, &result);
+                g_array_free(result.latencies, TRUE);
+            }
+        }
+        teardown_provider(&bench);
+    }
+
+    if (log_path) {
+        remove(log_path);
+        g_free(log_path);
+    }
+    free(bench.payload);
+    g_array_free(sizes, TRUE);
+    g_ptr_array_free(urls, TRUE);
+    return status;
+}
@@ -0,0 +1,715 @@
+// file: lcm-latency.c
+// desc: measures end-to-end latency over any LCM provider, either with probes
+//       that are echoed back by another lcm-latency, or passively from the
+//       send times that existing messages carry.
+
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <getopt.h>
+#include <glib.h>
+#include <lcm/lcm.h>
+
+#define DEFAULT_CHANNEL "LCM_LATENCY"
+#define PONG_SUFFIX "_PONG"
+#define PROBE_MAGIC 0x4c434c54
+
+#define DEFAULT_SIZES "64"
+#define DEFAULT_RATE 10.0
+#define DEFAULT_TIMEOUT 1.0
+#define DEFAULT_INTERVAL 1.0
+#define DEFAULT_OFFSET 8
+
+// Round trip times kept per size for the percentiles of the summary.
+#define MAX_SAMPLES 1000000
+
+// A probe starts with, in network byte order:
+//
+//   uint32_t magic;
+//   uint32_t id;          // of the pinging process, so that pings can share
+//                         // a channel
+//   int64_t sent_utime;   // when it was published, in us since the epoch
+//   uint32_t seq;
+//
+// sent_utime is at the offset of the utime field that leads most LCM types,
+// so passive mode measures the one-way latency of probes as well.
+#define PROBE_SIZE 20
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int signum)
+{
+    stop_requested = 1;
+}
+
+static int64_t now_ns(void)
+{
+#ifdef WIN32
+    return g_get_monotonic_time() * 1000;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+static void put_i64(uint8_t *p, int64_t v)
+{
+    put_u32(p, (uint32_t) ((uint64_t) v >> 32));
+    put_u32(p + 4, (uint32_t) v);
+}
+
+static int64_t get_i64(const uint8_t *p)
+{
+    return (int64_t) (((uint64_t) get_u32(p) << 32) | get_u32(p + 4));
+}
+
+static int compare_double(gconstpointer a, gconstpointer b)
+{
+    double da = *(const double *) a;
+    double db = *(const double *) b;
+    return da < db ? -1 : da > db;
+}
+
+// Sorts the samples, and prints their 50th, 90th and 99th percentiles and
+// maximum, or dashes if there are none.
+static void print_percentiles(GArray *samples)
+{
+    if (!samples->len) {
+        printf(" %10s %10s %10s %10s\n", "-", "-", "-", "-");
+        return;
+    }
+    g_array_sort(samples, compare_double);
+    static const double fractions[] = {0.5, 0.9, 0.99, 1.0};
+    for (int i = 0; i < 4; i++) {
+        guint index = (guint) ((samples->len - 1) * fractions[i]);
+        printf(" %10.1f", g_array_index(samples, double, index));
+    }
+    printf("\n");
+}
+
+// ========== ping and pong ==========
+
+typedef struct {
+    int64_t sent;
+    int64_t received;
+    int64_t lost;
+    int64_t reordered;
+    int64_t late;
+} counts_t;
+
+typedef struct {
+    int size;
+    counts_t interval;
+    counts_t total;
+    GArray *interval_rtts;  // double, in us
+    GArray *rtts;           // double, in us, the first MAX_SAMPLES
+} size_stats_t;
+
+// A probe that was sent, in a window indexed by sequence number.
+typedef struct {
+    uint32_t seq;
+    int pending;
+    int size_index;
+    int64_t sent_ns;
+} outstanding_t;
+
+typedef struct {
+    lcm_t *lcm;
+    const char *channel;
+    uint32_t id;
+    int64_t timeout_ns;
+
+    size_stats_t *sizes;
+    int num_sizes;
+    uint8_t *payload;
+
+    uint32_t next_seq;
+    // the oldest probe that may still be pending
+    uint32_t oldest_seq;
+    // the highest sequence number answered so far, for counting reordering
+    uint32_t highest_seq;
+    int any_received;
+    outstanding_t *window;
+    uint32_t window_size;
+} ping_t;
+
+static void send_probe(ping_t *ping)
+{
+    uint32_t seq = ping->next_seq;
+    int size_index = seq % ping->num_sizes;
+    size_stats_t *stats = &ping->sizes[size_index];
+
+    // a probe that outlives the window is lost
+    outstanding_t *slot = &ping->window[seq % ping->window_size];
+    if (slot->pending) {
+        slot->pending = 0;
+        ping->sizes[slot->size_index].interval.lost++;
+    }
+    while (seq - ping->oldest_seq >= ping->window_size)
+        ping->oldest_seq++;
+
+    put_u32(ping->payload, PROBE_MAGIC);
+    put_u32(ping->payload + 4, ping->id);
+    put_i64(ping->payload + 8, g_get_real_time());
+    put_u32(ping->payload + 16, seq);
+
+    slot->seq = seq;
+    slot->pending = 1;
+    slot->size_index = size_index;
+    slot->sent_ns = now_ns();
+    lcm_publish(ping->lcm, ping->channel, ping->payload, stats->size);
+    stats->interval.sent++;
+    ping->next_seq++;
+}
+
+static void on_pong(const lcm_recv_buf_t *rbuf, const char *channel, void *user)
+{
+    ping_t *ping = (ping_t *) user;
+    int64_t now = now_ns();
+    const uint8_t *data = (const uint8_t *) rbuf->data;
+    if (rbuf->data_size < PROBE_SIZE || get_u32(data) != PROBE_MAGIC ||
+        get_u32(data + 4) != ping->id)
+        return;
+
+    uint32_t seq = get_u32(data + 16);
+    outstanding_t *slot = &ping->window[seq % ping->window_size];
+    if (slot->seq != seq || !slot->pending) {
+        // answered after it was counted as lost, or more than once
+        ping->sizes[seq % ping->num_sizes].interval.late++;
+        return;
+    }
+    slot->pending = 0;
+
+    size_stats_t *stats = &ping->sizes[slot->size_index];
+    stats->interval.received++;
+    if (ping->any_received && (int32_t) (seq - ping->highest_seq) < 0)
+        stats->interval.reordered++;
+    else
+        ping->highest_seq = seq;
+    ping->any_received = 1;
+
+    double rtt_us = (now - slot->sent_ns) / 1000.0;
+    g_array_append_val(stats->interval_rtts, rtt_us);
+    if (stats->rtts->len < MAX_SAMPLES)
+        g_array_append_val(stats->rtts, rtt_us);
+}
+
+// Counts the probes that have waited longer than the timeout as lost.
+static void expire_probes(ping_t *ping, int64_t now)
+{
+    while (ping->oldest_seq != ping->next_seq) {
+        outstanding_t *slot = &ping->window[ping->oldest_seq % ping->window_size];
+        if (slot->pending) {
+            if (now - slot->sent_ns < ping->timeout_ns)
+                break;
+            slot->pending = 0;
+            ping->sizes[slot->size_index].interval.lost++;
+        }
+        ping->oldest_seq++;
+    }
+}
+
+static void add_counts(counts_t *total, const counts_t *c)
+{
+    total->sent += c->sent;
+    total->received += c->received;
+    total->lost += c->lost;
+    total->reordered += c->reordered;
+    total->late += c->late;
+}
+
+static void print_ping_header(void)
+{
+    printf("%-8s %8s %10s %10s %8s %8s %8s %10s %10s %10s %10s\n", "time", "size", "sent",
+           "received", "lost", "reorder", "late", "p50 us", "p90 us", "p99 us", "max us");
+}
+
+static void print_ping_row(const char *label, int size, const counts_t *c, GArray *rtts)
+{
+    printf("%-8s %8d %10" PRId64 " %10" PRId64 " %8" PRId64 " %8" PRId64 " %8" PRId64, label, size,
+           c->sent, c->received, c->lost, c->reordered, c->late);
+    print_percentiles(rtts);
+}
+
+static void report_interval(ping_t *ping, double elapsed)
+{
+    char label[32];
+    snprintf(label, sizeof(label), "%.1f", elapsed);
+    for (int i = 0; i < ping->num_sizes; i++) {
+        size_stats_t *stats = &ping->sizes[i];
+        print_ping_row(label, stats->size, &stats->interval, stats->interval_rtts);
+        add_counts(&stats->total, &stats->interval);
+        memset(&stats->interval, 0, sizeof(stats->interval));
+        g_array_set_size(stats->interval_rtts, 0);
+    }
+    fflush(stdout);
+}
+
+static int run_ping(lcm_t *lcm, const char *channel, GArray *sizes, double rate, double timeout,
+                    double interval, double duration)
+{
+    ping_t ping;
+    memset(&ping, 0, sizeof(ping));
+    ping.lcm = lcm;
+    ping.channel = channel;
+    ping.id = g_random_int();
+    ping.timeout_ns = (int64_t) (timeout * 1e9);
+    ping.num_sizes = sizes->len;
+    ping.sizes = g_new0(size_stats_t, ping.num_sizes);
+    int max_size = 0;
+    for (int i = 0; i < ping.num_sizes; i++) {
+        ping.sizes[i].size = g_array_index(sizes, int, i);
+        ping.sizes[i].interval_rtts = g_array_new(FALSE, FALSE, sizeof(double));
+        ping.sizes[i].rtts = g_array_new(FALSE, FALSE, sizeof(double));
+        max_size = MAX(max_size, ping.sizes[i].size);
+    }
+    ping.payload = (uint8_t *) calloc(1, max_size);
+    // room for every probe that can be outstanding before its timeout
+    ping.window_size = (uint32_t) MAX(16, 2 * rate * timeout + 16);
+    ping.window = g_new0(outstanding_t, ping.window_size);
+
+    char *pong_channel = g_strdup_printf("%s" PONG_SUFFIX, channel);
+    lcm_subscription_t *subscription = lcm_subscribe(lcm, pong_channel, on_pong, &ping);
+
+    print_ping_header();
+    int64_t period = (int64_t) (1e9 / rate);
+    int64_t report_period = (int64_t) (interval * 1e9);
+    int64_t start = now_ns();
+    int64_t end = duration > 0 ? start + (int64_t) (duration * 1e9) : INT64_MAX;
+    int64_t next_send = start;
+    int64_t next_report = start + report_period;
+    while (!stop_requested) {
+        int64_t now = now_ns();
+        if (now >= end)
+            break;
+        if (now >= next_send) {
+            send_probe(&ping);
+            next_send += period;
+            // don't catch up with a burst after a stall
+            if (next_send < now)
+                next_send = now + period;
+        }
+        if (now >= next_report) {
+            expire_probes(&ping, now);
+            report_interval(&ping, (now - start) / 1e9);
+            next_report += report_period;
+        }
+        int64_t wait = MIN(MIN(next_send, next_report), end) - now_ns();
+        lcm_handle_timeout(lcm, wait > 0 ? (int) (wait / 1000000) : 0);
+    }
+
+    // wait for the last answers, then count whatever is missing as lost
+    int64_t drain_end = now_ns() + ping.timeout_ns;
+    while (ping.oldest_seq != ping.next_seq && now_ns() < drain_end) {
+        lcm_handle_timeout(lcm, 10);
+        expire_probes(&ping, now_ns());
+    }
+    expire_probes(&ping, INT64_MAX);
+    lcm_unsubscribe(lcm, subscription);
+
+    printf("\n");
+    print_ping_header();
+    int status = 0;
+    for (int i = 0; i < ping.num_sizes; i++) {
+        size_stats_t *stats = &ping.sizes[i];
+        add_counts(&stats->total, &stats->interval);
+        print_ping_row("total", stats->size, &stats->total, stats->rtts);
+        if (stats->total.sent && !stats->total.received)
+            status = 1;
+        g_array_free(stats->interval_rtts, TRUE);
+        g_array_free(stats->rtts, TRUE);
+    }
+    if (status)
+        fprintf(stderr, "no answers on %s; is lcm-latency pong running?\n", pong_channel);
+
+    g_free(pong_channel);
+    g_free(ping.sizes);
+    g_free(ping.window);
+    free(ping.payload);
+    return status;
+}
+
+typedef struct {
+    lcm_t *lcm;
+    char *pong_channel;
+    int64_t echoed;
+} pong_t;
+
+static void on_ping(const lcm_recv_buf_t *rbuf, const char *channel, void *user)
+{
+    pong_t *pong = (pong_t *) user;
+    if (rbuf->data_size < PROBE_SIZE || get_u32((const uint8_t *) rbuf->data) != PROBE_MAGIC)
+        return;
+    lcm_publish(pong->lcm, pong->pong_channel, rbuf->data, rbuf->data_size);
+    pong->echoed++;
+}
+
+static int run_pong(lcm_t *lcm, const char *channel, double duration)
+{
+    pong_t pong;
+    pong.lcm = lcm;
+    pong.pong_channel = g_strdup_printf("%s" PONG_SUFFIX, channel);
+    pong.echoed = 0;
+    lcm_subscription_t *subscription = lcm_subscribe(lcm, channel, on_ping, &pong);
+
+    fprintf(stderr, "echoing probes from %s on %s\n", channel, pong.pong_channel);
+    int64_t end = duration > 0 ? now_ns() + (int64_t) (duration * 1e9) : INT64_MAX;
+    while (!stop_requested && now_ns() < end) {
+        if (lcm_handle_timeout(lcm, 100) < 0)
+            break;
+    }
+    fprintf(stderr, "echoed %" PRId64 " probes\n", pong.echoed);
+
+    lcm_unsubscribe(lcm, subscription);
+    g_free(pong.pong_channel);
+    return 0;
+}
+
+// ========== passive ==========
+
+typedef struct {
+    int64_t count;
+    int64_t total;
+    // messages too short to hold a send time
+    int64_t short_count;
+    int64_t short_total;
+    GArray *interval_latencies;  // double, in us
+    GArray *latencies;           // double, in us, the first MAX_SAMPLES
+} channel_stats_t;
+
+typedef struct {
+    GHashTable *channels;  // name -> channel_stats_t
+    GPtrArray *names;      // of the channels, sorted
+    int offset;
+    double units_per_us;
+} passive_t;
+
+static void channel_stats_free(gpointer data)
+{
+    channel_stats_t *stats = (channel_stats_t *) data;
+    g_array_free(stats->interval_latencies, TRUE);
+    g_array_free(stats->latencies, TRUE);
+    g_free(stats);
+}
+
+static int compare_names(gconstpointer a, gconstpointer b)
+{
+    return strcmp(*(const char *const *) a, *(const char *const *) b);
+}
+
+static void on_message(const lcm_recv_buf_t *rbuf, const char *channel, void *user)
+{
+    passive_t *passive = (passive_t *) user;
+    channel_stats_t *stats = (channel_stats_t *) g_hash_table_lookup(passive->channels, channel);
+    if (!stats) {
+        stats = g_new0(channel_stats_t, 1);
+        stats->interval_latencies = g_array_new(FALSE, FALSE, sizeof(double));
+        stats->latencies = g_array_new(FALSE, FALSE, sizeof(double));
+        char *name = g_strdup(channel);
+        g_hash_table_insert(passive->channels, name, stats);
+        g_ptr_array_add(passive->names, name);
+        g_ptr_array_sort(passive->names, compare_names);
+    }
+    if (rbuf->data_size < (uint32_t) passive->offset + 8) {
+        stats->short_count++;
+        return;
+    }
+    int64_t sent = get_i64((const uint8_t *) rbuf->data + passive->offset);
+    double latency_us = rbuf->recv_utime - sent / passive->units_per_us;
+    stats->count++;
+    g_array_append_val(stats->interval_latencies, latency_us);
+    if (stats->latencies->len < MAX_SAMPLES)
+        g_array_append_val(stats->latencies, latency_us);
+}
+
+static void print_passive_header(void)
+{
+    printf("%-8s %-24s %10s %8s %10s %10s %10s %10s\n", "time", "channel", "messages", "short",
+           "p50 us", "p90 us", "p99 us", "max us");
+}
+
+// Prints a row per channel that received messages in the interval, or with
+// summary, a row per channel with its totals, in the order of their names.
+static void report_channels(passive_t *passive, const char *label, int summary)
+{
+    for (guint i = 0; i < passive->names->len; i++) {
+        const char *name = (const char *) g_ptr_array_index(passive->names, i);
+        channel_stats_t *stats = (channel_stats_t *) g_hash_table_lookup(passive->channels, name);
+        stats->total += stats->count;
+        stats->short_total += stats->short_count;
+        if (summary) {
+            printf("%-8s %-24s %10" PRId64 " %8" PRId64, label, name, stats->total,
+                   stats->short_total);
+            print_percentiles(stats->latencies);
+        } else if (stats->count || stats->short_count) {
+            printf("%-8s %-24s %10" PRId64 " %8" PRId64, label, name, stats->count,
+                   stats->short_count);
+            print_percentiles(stats->interval_latencies);
+        }
+        stats->count = 0;
+        stats->short_count = 0;
+        g_array_set_size(stats->interval_latencies, 0);
+    }
+    fflush(stdout);
+}
+
+static int run_passive(lcm_t *lcm, const char *channels, int offset, double units_per_us,
+                       double interval, double duration)
+{
+    passive_t passive;
+    passive.channels = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, channel_stats_free);
+    passive.names = g_ptr_array_new();
+    passive.offset = offset;
+    passive.units_per_us = units_per_us;
+    lcm_subscription_t *subscription = lcm_subscribe(lcm, channels, on_message, &passive);
+
+    print_passive_header();
+    int64_t report_period = (int64_t) (interval * 1e9);
+    int64_t start = now_ns();
+    int64_t end = duration > 0 ? start + (int64_t) (duration * 1e9) : INT64_MAX;
+    int64_t next_report = start + report_period;
+    while (!stop_requested) {
+        int64_t now = now_ns();
+        if (now >= end)
+            break;
+        if (now >= next_report) {
+            char label[32];
+            snprintf(label, sizeof(label), "%.1f", (now - start) / 1e9);
+            report_channels(&passive, label, 0);
+            next_report += report_period;
+        }
+        int64_t wait = MIN(next_report, end) - now_ns();
+        if (lcm_handle_timeout(lcm, wait > 0 ? (int) (wait / 1000000) : 0) < 0)
+            break;
+    }
+    lcm_unsubscribe(lcm, subscription);
+
+    printf("\n");
+    print_passive_header();
+    report_channels(&passive, "total", 1);
+    g_ptr_array_free(passive.names, TRUE);
+    g_hash_table_destroy(passive.channels);
+    return 0;
+}
+
+// ========== main ==========
+
+static GArray *parse_sizes(const char *str)
+{
+    GArray *sizes = g_array_new(FALSE, FALSE, sizeof(int));
+    char **parts = g_strsplit(str, ",", 0);
+    for (int i = 0; parts[i]; i++) {
+        char *end;
+        long size = strtol(parts[i], &end, 10);
+        if (*end == 'k' || *end == 'K') {
+            size *= 1024;
+            end++;
+        } else if (*end == 'm' || *end == 'M') {
+            size *= 1024 * 1024;
+            end++;
+        }
+        if (*end || size < PROBE_SIZE || size > (1 << 30)) {
+            fprintf(stderr, "invalid probe size: %s (at least %d bytes)\n", parts[i],
+                    PROBE_SIZE);
+            g_array_free(sizes, TRUE);
+            sizes = NULL;
+            break;
+        }
+        int isize = (int) size;
+        g_array_append_val(sizes, isize);
+    }
+    g_strfreev(parts);
+    return sizes;
+}
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: lcm-latency ping [options]\n"
+            "       lcm-latency pong [options]\n"
+            "       lcm-latency passive [options] [CHANNEL_REGEX]\n"
+            "\n"
+            "Measures end-to-end latency over any LCM provider, without changes to the\n"
+            "applications that use it.\n"
+            "\n"
+            "ping publishes sequence numbered probes at a fixed rate, and measures the\n"
+            "round trip time of the answers from pong, which can run on another host.\n"
+            "Every interval, and once more when it stops, it prints the probes sent,\n"
+            "answered, lost (unanswered within the timeout), reordered (answered after a\n"
+            "later probe) and late (answered after they were counted as lost), and the\n"
+            "percentiles of their round trip times, for each probe size.  It exits\n"
+            "with status 1 if no probe was answered.\n"
+            "\n"
+            "pong publishes every probe it receives back to ping.\n"
+            "\n"
+            "passive subscribes to the channels that match CHANNEL_REGEX (default: .*),\n"
+            "and measures how long their messages took to arrive, as the difference\n"
+            "between the receive time and a send time that the messages carry, which\n"
+            "needs the clocks of the hosts to be synchronized.  The send time is read as\n"
+            "a big-endian int64_t at a fixed offset, by default that of an int64_t\n"
+            "utime that's the first field of an LCM type.\n"
+            "\n"
+            "Options:\n"
+            "\n"
+            "  -l, --lcm-url=URL          Provider to measure.  (default: the default\n"
+            "                             provider)\n"
+            "  -c, --channel=CHANNEL      ping, pong: probes are published on CHANNEL,\n"
+            "                             and answered on CHANNEL" PONG_SUFFIX ".\n"
+            "                             (default: " DEFAULT_CHANNEL ")\n"
+            "  -s, --sizes=LIST           ping: comma separated probe sizes in bytes,\n"
+            "                             with optional k or m suffixes, sent in turn.\n"
+            "                             (default: " DEFAULT_SIZES ")\n"
+            "  -r, --rate=HZ              ping: probes per second.  (default: %.0f)\n"
+            "  -t, --timeout=SECONDS      ping: how long to wait for an answer.\n"
+            "                             (default: %.0f)\n"
+            "      --offset=BYTES         passive: where messages hold their send time.\n"
+            "                             (default: %d)\n"
+            "      --units=UNITS          passive: units of the send time, since the\n"
+            "                             epoch: s, ms, us or ns.  (default: us)\n"
+            "  -i, --interval=SECONDS     How often to print statistics.  (default: %.0f)\n"
+            "  -d, --duration=SECONDS     Stop after this long.  (default: run until\n"
+            "                             interrupted)\n"
+            "  -h, --help                 Shows this help text and exits.\n",
+            DEFAULT_RATE, DEFAULT_TIMEOUT, DEFAULT_OFFSET, DEFAULT_INTERVAL);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+        usage();
+    const char *command = argv[1];
+    if (strcmp(command, "ping") && strcmp(command, "pong") && strcmp(command, "passive"))
+        usage();
+    argc--;
+    argv++;
+
+    const char *url = NULL;
+    const char *channel = DEFAULT_CHANNEL;
+    const char *sizes_str = DEFAULT_SIZES;
+    double rate = DEFAULT_RATE;
+    double timeout = DEFAULT_TIMEOUT;
+    int offset = DEFAULT_OFFSET;
+    double units_per_us = 1;
+    double interval = DEFAULT_INTERVAL;
+    double duration = 0;
+
+    char *optstring = "l:c:s:r:t:i:d:h";
+    struct option long_opts[] = {
+        {"lcm-url", required_argument, 0, 'l'},
+        {"channel", required_argument, 0, 'c'},
+        {"sizes", required_argument, 0, 's'},
+        {"rate", required_argument, 0, 'r'},
+        {"timeout", required_argument, 0, 't'},
+        {"offset", required_argument, 0, 128},
+        {"units", required_argument, 0, 129},
+        {"interval", required_argument, 0, 'i'},
+        {"duration", required_argument, 0, 'd'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0},
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, optstring, long_opts, 0)) >= 0) {
+        switch (c) {
+        case 'l':
+            url = optarg;
+            break;
+        case 'c':
+            channel = optarg;
+            break;
+        case 's':
+            sizes_str = optarg;
+            break;
+        case 'r':
+            rate = strtod(optarg, NULL);
+            if (rate <= 0)
+                usage();
+            break;
+        case 't':
+            timeout = strtod(optarg, NULL);
+            if (timeout <= 0)
+                usage();
+            break;
+        case 128:
+            offset = atoi(optarg);
+            if (offset < 0)
+                usage();
+            break;
+        case 129:
+            if (!strcmp(optarg, "s"))
+                units_per_us = 1e-6;
+            else if (!strcmp(optarg, "ms"))
+                units_per_us = 1e-3;
+            else if (!strcmp(optarg, "us"))
+                units_per_us = 1;
+            else if (!strcmp(optarg, "ns"))
+                units_per_us = 1e3;
+            else
+                usage();
+            break;
+        case 'i':
+            interval = strtod(optarg, NULL);
+            if (interval <= 0)
+                usage();
+            break;
+        case 'd':
+            duration = strtod(optarg, NULL);
+            break;
+        case 'h':
+        default:
+            usage();
+            break;
+        }
+    }
+
+    const char *channels = ".*";
+    if (!strcmp(command, "passive") && optind < argc)
+        channels = argv[optind++];
+    if (optind < argc)
+        usage();
+
+    GArray *sizes = parse_sizes(sizes_str);
+    if (!sizes)
+        return 1;
+
+    lcm_t *lcm = lcm_create(url);
+    if (!lcm) {
+        fprintf(stderr, "couldn't create an LCM instance for %s\n", url ? url : "the default URL");
+        g_array_free(sizes, TRUE);
+        return 1;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    int status;
+    if (!strcmp(command, "ping"))
+        status = run_ping(lcm, channel, sizes, rate, timeout, interval, duration);
+    else if (!strcmp(command, "pong"))
+        status = run_pong(lcm, channel, duration);
+    else
+        status = run_passive(lcm, channels, offset, units_per_us, interval, duration);
+
+    lcm_destroy(lcm);
+    g_array_free(sizes, TRUE);
+    return status;
+}
@@ -0,0 +1,949 @@
+// file: lcm-logbench.c
+// desc: generates synthetic log files, measures how fast log files are
+//       written, read, filtered and searched, and finds the publish rate at
+//       which lcm-logger starts to drop messages.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <signal.h>
+#include <sys/wait.h>
+#endif
+
+#include <getopt.h>
+#include <glib.h>
+#include <lcm/lcm.h>
+
+#define DEFAULT_MIX "POSE:100:128,IMU:1000:64,LIDAR:10:64k-256k,CAMERA:30:32k-128k,STATUS:1:16-1k"
+#define DEFAULT_DURATION 20.0
+#define DEFAULT_FILTER "POSE"
+#define DEFAULT_SEEKS 1000
+
+// the number of events passed to each lcm_eventlog_write_events() call
+#define WRITE_BATCH 64
+
+#define SOAK_CHANNEL "LCM_LOGBENCH"
+#define SOAK_STATS_CHANNEL "LCM_LOGBENCH_STATS"
+#define SOAK_STATS_INTERVAL_MS 100
+#define DEFAULT_SOAK_URL "udpm://239.255.76.67:7667?ttl=0"
+#define DEFAULT_SOAK_SIZE 1024
+#define DEFAULT_SOAK_START_RATE 1000
+#define DEFAULT_SOAK_MAX_RATE 1000000
+#define DEFAULT_SOAK_FACTOR 2.0
+#define DEFAULT_SOAK_STEP 2.0
+
+// ========== synthetic log files ==========
+
+typedef struct {
+    char *name;
+    double rate;
+    int min_size;
+    int max_size;
+    // log time of the next event, in microseconds
+    double next_utime;
+} gen_channel_t;
+
+typedef struct {
+    GPtrArray *channels;
+    int64_t start_utime;
+    int64_t end_utime;
+    // random bytes that the data of every event points into
+    uint8_t *payload;
+    int64_t eventnum;
+} generator_t;
+
+// Parses a size in bytes with an optional k or m suffix.
+static int parse_size(const char *str, const char **end)
+{
+    char *e;
+    long size = strtol(str, &e, 10);
+    if (*e == 'k' || *e == 'K') {
+        size *= 1024;
+        e++;
+    } else if (*e == 'm' || *e == 'M') {
+        size *= 1024 * 1024;
+        e++;
+    }
+    *end = e;
+    if (e == str || size < 0 || size > (1 << 30))
+        return -1;
+    return (int) size;
+}
+
+// Adds the channels of a mix, a comma separated list of NAME:RATE:SIZE, where
+// RATE is in events per second and SIZE is a size or a LO-HI range of sizes.
+static int generator_add_channels(generator_t *gen, const char *mix)
+{
+    int status = 0;
+    char **specs = g_strsplit(mix, ",", 0);
+    for (int i = 0; specs[i] && !status; i++) {
+        char **parts = g_strsplit(specs[i], ":", 0);
+        if (g_strv_length(parts) != 3 || !parts[0][0]) {
+            fprintf(stderr, "invalid channel: %s (expected NAME:RATE:SIZE)\n", specs[i]);
+            status = -1;
+            g_strfreev(parts);
+            break;
+        }
+
+        gen_channel_t *channel = g_new0(gen_channel_t, 1);
+        channel->name = g_strdup(parts[0]);
+        channel->rate = strtod(parts[1], NULL);
+        const char *end;
+        channel->min_size = parse_size(parts[2], &end);
+        channel->max_size = channel->min_size;
+        if (*end == '-')
+            channel->max_size = parse_size(end + 1, &end);
+        g_ptr_array_add(gen->channels, channel);
+
+        if (channel->rate <= 0 || channel->min_size < 0 || *end ||
+            channel->max_size < channel->min_size) {
+            fprintf(stderr, "invalid channel: %s (expected NAME:RATE:SIZE)\n", specs[i]);
+            status = -1;
+        }
+        g_strfreev(parts);
+    }
+    g_strfreev(specs);
+    return status;
+}
+
+static void free_channel(gpointer data)
+{
+    gen_channel_t *channel = (gen_channel_t *) data;
+    g_free(channel->name);
+    g_free(channel);
+}
+
+static generator_t *generator_new(const char *mix, double duration)
+{
+    generator_t *gen = g_new0(generator_t, 1);
+    gen->channels = g_ptr_array_new_with_free_func(free_channel);
+    if (generator_add_channels(gen, mix) || gen->channels->len == 0) {
+        g_ptr_array_free(gen->channels, TRUE);
+        g_free(gen);
+        return NULL;
+    }
+
+    gen->start_utime = g_get_real_time();
+    gen->end_utime = gen->start_utime + (int64_t) (duration * 1e6);
+
+    int max_size = 0;
+    for (unsigned int i = 0; i < gen->channels->len; i++) {
+        gen_channel_t *channel = (gen_channel_t *) g_ptr_array_index(gen->channels, i);
+        if (channel->max_size > max_size)
+            max_size = channel->max_size;
+    }
+    gen->payload = (uint8_t *) malloc(max_size + 1);
+    for (int i = 0; i < max_size; i++)
+        gen->payload[i] = (uint8_t) g_random_int();
+    return gen;
+}
+
+// Starts the log over, so that it generates the same events again.
+static void generator_rewind(generator_t *gen, guint32 seed)
+{
+    g_random_set_seed(seed);
+    gen->eventnum = 0;
+    for (unsigned int i = 0; i < gen->channels->len; i++) {
+        gen_channel_t *channel = (gen_channel_t *) g_ptr_array_index(gen->channels, i);
+        // start each channel at a random phase of its period
+        channel->next_utime = gen->start_utime + g_random_double() * 1e6 / channel->rate;
+    }
+}
+
+// Fills in the next event of the log, in timestamp order.  Returns -1 at the
+// end of the log.
+static int generator_next(generator_t *gen, lcm_eventlog_event_t *event)
+{
+    gen_channel_t *next = NULL;
+    for (unsigned int i = 0; i < gen->channels->len; i++) {
+        gen_channel_t *channel = (gen_channel_t *) g_ptr_array_index(gen->channels, i);
+        if (!next || channel->next_utime < next->next_utime)
+            next = channel;
+    }
+    if (next->next_utime >= gen->end_utime)
+        return -1;
+
+    int size = next->min_size;
+    if (next->max_size > next->min_size)
+        size = g_random_int_range(next->min_size, next->max_size + 1);
+
+    event->eventnum = gen->eventnum++;
+    event->timestamp = (int64_t) next->next_utime;
+    event->channellen = (int32_t) strlen(next->name);
+    event->datalen = size;
+    event->channel = next->name;
+    event->data = gen->payload;
+
+    next->next_utime += 1e6 / next->rate;
+    return 0;
+}
+
+static void generator_free(generator_t *gen)
+{
+    g_ptr_array_free(gen->channels, TRUE);
+    free(gen->payload);
+    g_free(gen);
+}
+
+// ========== results ==========
+
+typedef struct {
+    const char *name;
+    int indexed;
+    int64_t events;
+    int64_t bytes;
+    double seconds;
+    // seek latencies, in microseconds, sorted
+    GArray *latencies;
+} result_t;
+
+static double now_sec(void)
+{
+#ifdef WIN32
+    return g_get_monotonic_time() * 1e-6;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+static int compare_double(gconstpointer a, gconstpointer b)
+{
+    double da = *(const double *) a;
+    double db = *(const double *) b;
+    return da < db ? -1 : da > db;
+}
+
+static double percentile(GArray *sorted, double fraction)
+{
+    int i = (int) (fraction * (sorted->len - 1) + 0.5);
+    return g_array_index(sorted, double, i);
+}
+
+static void print_header(void)
+{
+    printf("%-22s %-5s %10s %10s %8s %12s %10s %9s %9s %9s\n", "benchmark", "index", "events",
+           "MB", "seconds", "events/s", "MB/s", "p50 us", "p99 us", "max us");
+}
+
+static void print_result(const result_t *r)
+{
+    double mb = r->bytes / (1024.0 * 1024.0);
+    printf("%-22s %-5s %10" PRId64 " %10.1f %8.3f %12.0f %10.1f", r->name,
+           r->indexed ? "yes" : "no", r->events, mb, r->seconds, r->events / r->seconds,
+           mb / r->seconds);
+    if (r->latencies && r->latencies->len) {
+        printf(" %9.1f %9.1f %9.1f\n", percentile(r->latencies, 0.5),
+               percentile(r->latencies, 0.99),
+               g_array_index(r->latencies, double, r->latencies->len - 1));
+    } else {
+        printf(" %9s %9s %9s\n", "-", "-", "-");
+    }
+    fflush(stdout);
+}
+
+// ========== writing ==========
+
+// Writes the generated log to path, one event at a time, or in batches of
+// WRITE_BATCH events with lcm_eventlog_write_events().
+static int bench_write(generator_t *gen, guint32 seed, const char *path, int batched, int index,
+                       result_t *r)
+{
+    memset(r, 0, sizeof(*r));
+    r->name = batched ? "write_events" : "write_event";
+    r->indexed = index;
+
+    lcm_eventlog_t *log = lcm_eventlog_create(path, "w");
+    if (!log) {
+        fprintf(stderr, "couldn't create %s\n", path);
+        return -1;
+    }
+    if (index && lcm_eventlog_write_index(log)) {
+        fprintf(stderr, "couldn't write the index of %s\n", path);
+        lcm_eventlog_destroy(log);
+        return -1;
+    }
+
+    generator_rewind(gen, seed);
+    lcm_eventlog_event_t events[WRITE_BATCH];
+    lcm_eventlog_event_t *pointers[WRITE_BATCH];
+    for (int i = 0; i < WRITE_BATCH; i++)
+        pointers[i] = &events[i];
+
+    int status = 0;
+    double start = now_sec();
+    for (;;) {
+        int n = 0;
+        while (n < (batched ? WRITE_BATCH : 1) && !generator_next(gen, &events[n])) {
+            r->bytes += events[n].datalen;
+            n++;
+        }
+        if (n == 0)
+            break;
+        r->events += n;
+        if (batched)
+            status = lcm_eventlog_write_events(log, pointers, n);
+        else
+            status = lcm_eventlog_write_event(log, &events[0]);
+        if (status) {
+            fprintf(stderr, "couldn't write to %s\n", path);
+            break;
+        }
+    }
+    // closing flushes the last events
+    lcm_eventlog_destroy(log);
+    r->seconds = now_sec() - start;
+    return status;
+}
+
+// ========== reading ==========
+
+typedef enum { READ_NEXT_EVENT, READ_NEXT_EVENT_INTO, READ_MMAP, READ_FILTERED } read_mode_t;
+
+static int filter_wanted(const char *channel, void *user)
+{
+    return g_regex_match((GRegex *) user, channel, (GRegexMatchFlags) 0, NULL);
+}
+
+// Reads path to the end, and sets first and last to the timestamps of its
+// first and last events.
+static int bench_read(const char *path, read_mode_t mode, GRegex *filter, int indexed,
+                      result_t *r, int64_t *first, int64_t *last)
+{
+    static const char *names[] = {"read_next_event", "read_next_event_into", "mmap_next_view",
+                                  "filtered_read"};
+    memset(r, 0, sizeof(*r));
+    r->name = names[mode];
+    r->indexed = indexed;
+    *first = *last = 0;
+
+    double start = now_sec();
+    if (mode == READ_MMAP) {
+        lcm_eventlog_mmap_t *log = lcm_eventlog_mmap_open(path);
+        if (!log)
+            return -1;
+        lcm_eventlog_view_t view;
+        memset(&view, 0, sizeof(view));
+        while (!lcm_eventlog_next_view(log, &view)) {
+            if (!r->events)
+                *first = view.timestamp;
+            *last = view.timestamp;
+            r->events++;
+            r->bytes += view.datalen;
+        }
+        lcm_eventlog_mmap_close(log);
+        r->seconds = now_sec() - start;
+        return 0;
+    }
+
+    lcm_eventlog_t *log = lcm_eventlog_create(path, "r");
+    if (!log) {
+        fprintf(stderr, "couldn't open %s\n", path);
+        return -1;
+    }
+    if (mode == READ_FILTERED)
+        lcm_eventlog_set_channel_filter(log, filter_wanted, filter);
+
+    if (mode == READ_NEXT_EVENT) {
+        lcm_eventlog_event_t *event;
+        while ((event = lcm_eventlog_read_next_event(log))) {
+            if (!r->events)
+                *first = event->timestamp;
+            *last = event->timestamp;
+            r->events++;
+            r->bytes += event->datalen;
+            lcm_eventlog_free_event(event);
+        }
+    } else {
+        lcm_eventlog_event_t event;
+        memset(&event, 0, sizeof(event));
+        size_t capacity = 0;
+        while (!lcm_eventlog_read_next_event_into(log, &event, &capacity)) {
+            if (!r->events)
+                *first = event.timestamp;
+            *last = event.timestamp;
+            r->events++;
+            r->bytes += event.datalen;
+        }
+        free(event.channel);
+    }
+    lcm_eventlog_destroy(log);
+    r->seconds = now_sec() - start;
+    return 0;
+}
+
+// Seeks to random timestamps between first and last, and reads the event
+// there, timing each.
+static int bench_seek(const char *path, int64_t first, int64_t last, int num_seeks, int indexed,
+                      result_t *r)
+{
+    memset(r, 0, sizeof(*r));
+    r->name = "seek_to_timestamp";
+    r->indexed = indexed;
+    r->latencies = g_array_sized_new(FALSE, FALSE, sizeof(double), num_seeks);
+
+    lcm_eventlog_t *log = lcm_eventlog_create(path, "r");
+    if (!log) {
+        fprintf(stderr, "couldn't open %s\n", path);
+        return -1;
+    }
+    lcm_eventlog_event_t event;
+    memset(&event, 0, sizeof(event));
+    size_t capacity = 0;
+
+    double start = now_sec();
+    for (int i = 0; i < num_seeks; i++) {
+        int64_t ts = first + (int64_t) (g_random_double() * (last - first));
+        double t0 = now_sec();
+        if (lcm_eventlog_seek_to_timestamp(log, ts) ||
+            lcm_eventlog_read_next_event_into(log, &event, &capacity))
+            continue;
+        double us = (now_sec() - t0) * 1e6;
+        g_array_append_val(r->latencies, us);
+        r->events++;
+        r->bytes += event.datalen;
+    }
+    r->seconds = now_sec() - start;
+    free(event.channel);
+    lcm_eventlog_destroy(log);
+    g_array_sort(r->latencies, compare_double);
+    return 0;
+}
+
+// Runs the read benchmarks on path, with its index if there is one.
+static int bench_reads(const char *path, GRegex *filter, int num_seeks)
+{
+    char *index_path = g_strdup_printf("%s.idx", path);
+    int indexed = g_file_test(index_path, G_FILE_TEST_EXISTS);
+    g_free(index_path);
+
+    int64_t first = 0, last = 0;
+    result_t r;
+    for (int mode = READ_NEXT_EVENT; mode <= READ_FILTERED; mode++) {
+        int64_t f, l;
+        if (mode == READ_FILTERED && !filter)
+            continue;
+        if (bench_read(path, (read_mode_t) mode, filter, indexed, &r, &f, &l)) {
+            if (mode == READ_MMAP)
+                continue;  // not supported here
+            return -1;
+        }
+        if (mode == READ_NEXT_EVENT) {
+            first = f;
+            last = l;
+        }
+        print_result(&r);
+    }
+
+    if (num_seeks > 0 && last > first) {
+        int status = bench_seek(path, first, last, num_seeks, indexed, &r);
+        if (!status)
+            print_result(&r);
+        g_array_free(r.latencies, TRUE);
+        return status;
+    }
+    return 0;
+}
+
+// ========== lcm-logger soak test ==========
+
+typedef struct {
+    lcm_t *lcm;
+    GThread *thread;
+    volatile int quit;
+
+    GMutex mutex;
+    // from the last statistics that the logger published, protected by mutex
+    int num_stats;
+    int64_t events;
+    int64_t dropped;
+} soak_t;
+
+// Returns the integer after "key": in a JSON object of the logger's
+// statistics, which lists the totals before the channels.
+static int64_t json_field(const char *json, const char *key)
+{
+    char *pattern = g_strdup_printf("\"%s\": ", key);
+    const char *p = strstr(json, pattern);
+    int64_t value = p ? strtoll(p + strlen(pattern), NULL, 10) : 0;
+    g_free(pattern);
+    return value;
+}
+
+static void on_stats(const lcm_recv_buf_t *rbuf, const char *channel, void *user)
+{
+    soak_t *soak = (soak_t *) user;
+    char *json = g_strndup((const char *) rbuf->data, rbuf->data_size);
+    g_mutex_lock(&soak->mutex);
+    soak->events = json_field(json, "events");
+    soak->dropped = json_field(json, "dropped");
+    soak->num_stats++;
+    g_mutex_unlock(&soak->mutex);
+    g_free(json);
+}
+
+static gpointer soak_handler_thread(gpointer data)
+{
+    soak_t *soak = (soak_t *) data;
+    while (!soak->quit)
+        lcm_handle_timeout(soak->lcm, 50);
+    return NULL;
+}
+
+static void soak_read_stats(soak_t *soak, int *num_stats, int64_t *events, int64_t *dropped)
+{
+    g_mutex_lock(&soak->mutex);
+    *num_stats = soak->num_stats;
+    *events = soak->events;
+    *dropped = soak->dropped;
+    g_mutex_unlock(&soak->mutex);
+}
+
+// Waits until the logger has published statistics twice in a row without
+// more events, so that it has handled everything that reached it.
+static void soak_settle(soak_t *soak, int64_t *events, int64_t *dropped)
+{
+    int last_num = -1;
+    int64_t last_events = -1;
+    int unchanged = 0;
+    double deadline = now_sec() + 5;
+    while (unchanged < 2 && now_sec() < deadline) {
+        int num;
+        soak_read_stats(soak, &num, events, dropped);
+        if (num != last_num) {
+            unchanged = *events == last_events ? unchanged + 1 : 0;
+            last_num = num;
+            last_events = *events;
+        }
+        g_usleep(SOAK_STATS_INTERVAL_MS * 1000 / 4);
+    }
+}
+
+static int stop_logger(GPid pid)
+{
+#ifdef WIN32
+    TerminateProcess(pid, 0);
+    WaitForSingleObject(pid, INFINITE);
+#else
+    // SIGINT, so that the logger writes what it queued and closes its log
+    kill(pid, SIGINT);
+    waitpid(pid, NULL, 0);
+#endif
+    g_spawn_close_pid(pid);
+    return 0;
+}
+
+typedef struct {
+    const char *url;
+    const char *logger;
+    const char *max_unwritten_mb;
+    int size;
+    double start_rate;
+    double max_rate;
+    double factor;
+    double step;
+} soak_options_t;
+
+// Publishes at increasing rates to an lcm-logger, and reports the rate at
+// which it starts to lose messages, either dropped from its queue of
+// unwritten messages, or lost before they reached it.
+static int soak_logger(const soak_options_t *opts, const char *path)
+{
+    if (!strncmp(opts->url, "memq://", 7)) {
+        fprintf(stderr, "memq:// doesn't reach another process; use udpm:// or tcpq://\n");
+        return 1;
+    }
+
+    soak_t soak;
+    memset(&soak, 0, sizeof(soak));
+    g_mutex_init(&soak.mutex);
+    soak.lcm = lcm_create(opts->url);
+    if (!soak.lcm) {
+        fprintf(stderr, "couldn't create an LCM instance for %s\n", opts->url);
+        return 1;
+    }
+    lcm_subscribe(soak.lcm, SOAK_STATS_CHANNEL, on_stats, &soak);
+
+    char interval[16];
+    snprintf(interval, sizeof(interval), "%d", SOAK_STATS_INTERVAL_MS);
+    const char *argv[16];
+    int argc = 0;
+    argv[argc++] = opts->logger;
+    argv[argc++] = "-q";
+    argv[argc++] = "-f";
+    argv[argc++] = "-l";
+    argv[argc++] = opts->url;
+    argv[argc++] = "-c";
+    argv[argc++] = SOAK_CHANNEL;
+    argv[argc++] = "--stats-channel=" SOAK_STATS_CHANNEL;
+    argv[argc++] = "--stats-interval";
+    argv[argc++] = interval;
+    if (opts->max_unwritten_mb) {
+        argv[argc++] = "-m";
+        argv[argc++] = opts->max_unwritten_mb;
+    }
+    argv[argc++] = path;
+    argv[argc] = NULL;
+
+    GPid pid;
+    GError *err = NULL;
+    if (!g_spawn_async(NULL, (gchar **) argv, NULL,
+                       G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &pid,
+                       &err)) {
+        fprintf(stderr, "couldn't run %s: %s\n", opts->logger, err->message);
+        g_error_free(err);
+        lcm_destroy(soak.lcm);
+        return 1;
+    }
+
+    soak.thread = g_thread_new("lcm-logbench", soak_handler_thread, &soak);
+
+    int status = 0;
+    int num_stats;
+    int64_t events, dropped;
+    double deadline = now_sec() + 5;
+    do {
+        g_usleep(10000);
+        soak_read_stats(&soak, &num_stats, &events, &dropped);
+    } while (!num_stats && now_sec() < deadline);
+    if (!num_stats) {
+        fprintf(stderr, "%s didn't publish statistics on %s\n", opts->logger, opts->url);
+        status = 1;
+    }
+
+    uint8_t *payload = (uint8_t *) calloc(1, opts->size + 1);
+    if (!status) {
+        printf("%12s %10s %12s %10s %10s %10s %10s %8s\n", "target/s", "sent", "sent/s", "MB/s",
+               "logged", "dropped", "lost", "loss %");
+    }
+
+    double onset = 0;
+    for (double rate = opts->start_rate; !status && rate <= opts->max_rate && !onset;
+         rate *= opts->factor) {
+        int64_t base_events, base_dropped;
+        soak_settle(&soak, &base_events, &base_dropped);
+
+        int64_t sent = 0;
+        double start = now_sec();
+        double elapsed = 0;
+        while (elapsed < opts->step) {
+            // publish what's due, and sleep a little when caught up
+            int64_t due = (int64_t) (elapsed * rate) + 1;
+            if (sent >= due) {
+                g_usleep(100);
+            } else {
+                if ((size_t) opts->size >= sizeof(sent))
+                    memcpy(payload, &sent, sizeof(sent));
+                lcm_publish(soak.lcm, SOAK_CHANNEL, payload, opts->size);
+                sent++;
+            }
+            elapsed = now_sec() - start;
+        }
+
+        soak_settle(&soak, &events, &dropped);
+        int64_t received = events - base_events;
+        int64_t step_dropped = dropped - base_dropped;
+        int64_t lost = sent > received ? sent - received : 0;
+        double loss = 100.0 * (step_dropped + lost) / sent;
+        printf("%12.0f %10" PRId64 " %12.0f %10.1f %10" PRId64 " %10" PRId64 " %10" PRId64
+               " %8.3f\n",
+               rate, sent, sent / elapsed, sent * (double) opts->size / elapsed / (1024 * 1024),
+               received - step_dropped, step_dropped, lost, loss);
+        fflush(stdout);
+        if (step_dropped + lost > 0)
+            onset = sent / elapsed;
+        else if (sent < 0.9 * rate * elapsed)
+            break;  // this process can't publish any faster
+    }
+
+    if (!status) {
+        if (onset) {
+            printf("drops start at %.0f messages/s (%.1f MB/s) of %d bytes\n", onset,
+                   onset * opts->size / (1024 * 1024), opts->size);
+        } else {
+            printf("no drops up to %.0f messages/s of %d bytes\n", opts->max_rate, opts->size);
+        }
+    }
+
+    stop_logger(pid);
+    soak.quit = 1;
+    g_thread_join(soak.thread);
+    lcm_destroy(soak.lcm);
+    g_mutex_clear(&soak.mutex);
+    free(payload);
+    return status;
+}
+
+// ========== main ==========
+
+static char *temp_log_path(const char *name)
+{
+    return g_strdup_printf("%s%slcm-logbench-%08x-%s.log", g_get_tmp_dir(), G_DIR_SEPARATOR_S,
+                           g_random_int(), name);
+}
+
+static void remove_log(const char *path)
+{
+    char *index_path = g_strdup_printf("%s.idx", path);
+    remove(index_path);
+    remove(path);
+    g_free(index_path);
+}
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: lcm-logbench generate [options] FILE\n"
+            "       lcm-logbench bench [options] [FILE]\n"
+            "       lcm-logbench soak [options] [FILE]\n"
+            "\n"
+            "generate writes a synthetic log file, of events on a mix of channels at\n"
+            "fixed rates, with sizes drawn evenly from a range.\n"
+            "\n"
+            "bench times writing a synthetic log file one event at a time, in batches\n"
+            "and with an index, and then reading it sequentially, in place, filtered\n"
+            "to some channels and at random timestamps, without and with its index.\n"
+            "Given FILE, the reads are of FILE instead, with its index if there is\n"
+            "one.  Log files just written are usually read from the page cache.\n"
+            "\n"
+            "soak runs lcm-logger, publishes messages to it at increasing rates, and\n"
+            "reports the rate at which it starts to lose messages, either dropped\n"
+            "because they couldn't be written fast enough, or lost before they reached\n"
+            "it.  The log is written to FILE, or to a temporary file that's removed.\n"
+            "\n"
+            "Options of generate and bench:\n"
+            "\n"
+            "  -c, --channels=MIX         Comma separated NAME:RATE:SIZE channels, with\n"
+            "                             RATE in events per second, and SIZE a size or\n"
+            "                             a LO-HI range of sizes in bytes, with optional\n"
+            "                             k or m suffixes.\n"
+            "                             (default: " DEFAULT_MIX ")\n"
+            "  -d, --duration=SECONDS     Length of the log.  (default: %.0f)\n"
+            "      --seed=N               Seed of the event sizes.  (default: 1)\n"
+            "      --index                generate: write an index with the log file.\n"
+            "  -F, --filter=REGEX         bench: channels of the filtered read.\n"
+            "                             (default: " DEFAULT_FILTER ")\n"
+            "  -n, --seeks=N              bench: number of seeks.  (default: %d)\n"
+            "\n"
+            "Options of soak:\n"
+            "\n"
+            "  -l, --lcm-url=URL          Provider to log from.\n"
+            "                             (default: " DEFAULT_SOAK_URL ")\n"
+            "  -s, --size=SIZE            Message size in bytes.  (default: %d)\n"
+            "      --start-rate=HZ        First rate.  (default: %d)\n"
+            "      --max-rate=HZ          Last rate.  (default: %d)\n"
+            "      --factor=F             Ratio of each rate to the one before.\n"
+            "                             (default: %.0f)\n"
+            "      --step=SECONDS         How long each rate is published.  (default: %.0f)\n"
+            "  -m, --max-unwritten-mb=MB  Passed to lcm-logger.\n"
+            "      --logger=PATH          lcm-logger to run.  (default: lcm-logger)\n"
+            "\n"
+            "  -h, --help                 Shows this help text and exits.\n",
+            DEFAULT_DURATION, DEFAULT_SEEKS, DEFAULT_SOAK_SIZE, DEFAULT_SOAK_START_RATE,
+            DEFAULT_SOAK_MAX_RATE, DEFAULT_SOAK_FACTOR, DEFAULT_SOAK_STEP);
+    exit(1);
+}
+
+static int run_generate(generator_t *gen, guint32 seed, int index, const char *path)
+{
+    result_t r;
+    if (bench_write(gen, seed, path, 1, index, &r))
+        return 1;
+    printf("wrote %" PRId64 " events, %.1f MB of data, to %s in %.3f s\n", r.events,
+           r.bytes / (1024.0 * 1024.0), path, r.seconds);
+    return 0;
+}
+
+static int run_bench(generator_t *gen, guint32 seed, GRegex *filter, int num_seeks,
+                     const char *path)
+{
+    print_header();
+
+    int status = 0;
+    result_t r;
+    char *written = temp_log_path("write");
+    char *indexed = temp_log_path("index");
+    if (bench_write(gen, seed, written, 0, 0, &r) == 0) {
+        print_result(&r);
+    } else {
+        status = 1;
+    }
+    if (!status && bench_write(gen, seed, written, 1, 0, &r) == 0) {
+        print_result(&r);
+    } else {
+        status = 1;
+    }
+    if (!status && bench_write(gen, seed, indexed, 1, 1, &r) == 0) {
+        print_result(&r);
+    } else {
+        status = 1;
+    }
+
+    if (!status && path) {
+        status = bench_reads(path, filter, num_seeks) ? 1 : 0;
+    } else if (!status) {
+        status = bench_reads(written, filter, num_seeks) || bench_reads(indexed, filter, num_seeks);
+    }
+
+    remove_log(written);
+    remove_log(indexed);
+    g_free(written);
+    g_free(indexed);
+    return status;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+        usage();
+    const char *command = argv[1];
+    if (strcmp(command, "generate") && strcmp(command, "bench") && strcmp(command, "soak"))
+        usage();
+    argc--;
+    argv++;
+
+    const char *mix = DEFAULT_MIX;
+    double duration = DEFAULT_DURATION;
+    guint32 seed = 1;
+    int index = 0;
+    const char *filter_str = DEFAULT_FILTER;
+    int num_seeks = DEFAULT_SEEKS;
+
+    soak_options_t soak;
+    memset(&soak, 0, sizeof(soak));
+    soak.url = DEFAULT_SOAK_URL;
+    soak.logger = "lcm-logger";
+    soak.size = DEFAULT_SOAK_SIZE;
+    soak.start_rate = DEFAULT_SOAK_START_RATE;
+    soak.max_rate = DEFAULT_SOAK_MAX_RATE;
+    soak.factor = DEFAULT_SOAK_FACTOR;
+    soak.step = DEFAULT_SOAK_STEP;
+
+    char *optstring = "c:d:F:n:l:s:m:h";
+    struct option long_opts[] = {
+        {"channels", required_argument, 0, 'c'},
+        {"duration", required_argument, 0, 'd'},
+        {"seed", required_argument, 0, 128},
+        {"index", no_argument, 0, 129},
+        {"filter", required_argument, 0, 'F'},
+        {"seeks", required_argument, 0, 'n'},
+        {"lcm-url", required_argument, 0, 'l'},
+        {"size", required_argument, 0, 's'},
+        {"start-rate", required_argument, 0, 130},
+        {"max-rate", required_argument, 0, 131},
+        {"factor", required_argument, 0, 132},
+        {"step", required_argument, 0, 133},
+        {"max-unwritten-mb", required_argument, 0, 'm'},
+        {"logger", required_argument, 0, 134},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0},
+    };
+
+    const char *end;
+    int c;
+    while ((c = getopt_long(argc, argv, optstring, long_opts, 0)) >= 0) {
+        switch (c) {
+        case 'c':
+            mix = optarg;
+            break;
+        case 'd':
+            duration = strtod(optarg, NULL);
+            if (duration <= 0)
+                usage();
+            break;
+        case 128:
+            seed = (guint32) strtoul(optarg, NULL, 10);
+            break;
+        case 129:
+            index = 1;
+            break;
+        case 'F':
+            filter_str = optarg;
+            break;
+        case 'n':
+            num_seeks = atoi(optarg);
+            break;
+        case 'l':
+            soak.url = optarg;
+            break;
+        case 's':
+            soak.size = parse_size(optarg, &end);
+            if (soak.size < 1 || *end)
+                usage();
+            break;
+        case 130:
+            soak.start_rate = strtod(optarg, NULL);
+            if (soak.start_rate <= 0)
+                usage();
+            break;
+        case 131:
+            soak.max_rate = strtod(optarg, NULL);
+            break;
+        case 132:
+            soak.factor = strtod(optarg, NULL);
+            if (soak.factor <= 1)
+                usage();
+            break;
+        case 133:
+            soak.step = strtod(optarg, NULL);
+            if (soak.step <= 0)
+                usage();
+            break;
+        case 'm':
+            soak.max_unwritten_mb = optarg;
+            break;
+        case 134:
+            soak.logger = optarg;
+            break;
+        case 'h':
+        default:
+            usage();
+            break;
+        }
+    }
+
+    const char *path = optind < argc ? argv[optind] : NULL;
+    if (optind + 1 < argc || (!path && !strcmp(command, "generate")))
+        usage();
+
+    if (!strcmp(command, "soak")) {
+        char *temp = path ? NULL : temp_log_path("soak");
+        int status = soak_logger(&soak, path ? path : temp);
+        if (temp) {
+            remove_log(temp);
+            g_free(temp);
+        }
+        return status;
+    }
+
+    generator_t *gen = generator_new(mix, duration);
+    if (!gen)
+        return 1;
+
+    int status;
+    if (!strcmp(command, "generate")) {
+        status = run_generate(gen, seed, index, path);
+    } else {
+        GError *err = NULL;
+        char *anchored = g_strdup_printf("^%s$", filter_str);
+        GRegex *filter = g_regex_new(anchored, (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, &err);
+        g_free(anchored);
+        if (!filter) {
+            fprintf(stderr, "invalid filter %s: %s\n", filter_str, err->message);
+            g_error_free(err);
+            generator_free(gen);
+            return 1;
+        }
+        status = run_bench(gen, seed, filter, num_seeks, path);
+        g_regex_unref(filter);
+    }
+    generator_free(gen);
+    return status;
+}
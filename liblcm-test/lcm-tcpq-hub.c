@@ -0,0 +1,547 @@
+// file: lcm-tcpq-hub.c
+// desc: server for the tcpq provider, which relays each published message to
+//       the clients that subscribed to its channel
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <glib.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define MAGIC_SERVER 0x287617fa
+#define MAGIC_CLIENT 0x287617fb
+#define PROTOCOL_VERSION 0x0100
+#define MESSAGE_TYPE_PUBLISH 1
+#define MESSAGE_TYPE_SUBSCRIBE 2
+#define MESSAGE_TYPE_UNSUBSCRIBE 3
+
+#define RECV_BUF_SIZE 65536
+// the largest message that is accepted from a client
+#define MAX_MESSAGE_SIZE (256 * 1024 * 1024)
+// the most channel names that a client's wanted cache holds, past which it
+// starts over
+#define MAX_CACHED_CHANNELS 2048
+#define MAX_EVENTS 64
+#define MAX_IOV 64
+
+// A published message, framed as it's sent to the clients, which all share it.
+typedef struct {
+    int refcount;
+    int len;
+    uint8_t data[];
+} message_t;
+
+typedef struct {
+    char *pattern;
+    GRegex *regex;
+} subscription_t;
+
+typedef struct {
+    int fd;
+    char *name;
+    // set once the client has sent its magic number and version
+    int greeted;
+    // received bytes that aren't handled yet run from recv_start to recv_end
+    uint8_t *recv_buf;
+    uint32_t recv_buf_len;
+    uint32_t recv_start;
+    uint32_t recv_end;
+
+    GPtrArray *subs;
+    // whether the client subscribed to a channel, for up to
+    // MAX_CACHED_CHANNELS of the channels seen since the subscriptions last
+    // changed
+    GHashTable *wanted;
+
+    // the messages that are waiting to be sent, of which the first has been
+    // sent up to out_offset
+    GQueue out;
+    int out_offset;
+    int64_t out_bytes;
+    int want_write;
+    int64_t dropped;
+    // set once the client is to be disconnected
+    int closing;
+} client_t;
+
+typedef struct {
+    int epfd;
+    int listen_fd;
+    GPtrArray *clients;
+    int64_t max_queue;
+    int verbose;
+    int64_t bytes_relayed;
+    int64_t messages_dropped;
+} hub_t;
+
+static volatile sig_atomic_t g_quit = 0;
+
+static void on_signal(int signum)
+{
+    g_quit = 1;
+}
+
+static void usage(const char *cmd)
+{
+    fprintf(stderr,
+            "\
+Usage: %s [OPTION...]\n\
+\n\
+Server for LCM clients that use the tcpq provider, e.g. tcpq://host:7700.\n\
+Relays every message that a client publishes to each client that subscribed\n\
+to its channel, including the publisher.  A client that reads its messages\n\
+more slowly than they're published loses those that don't fit in its queue.\n\
+\n\
+Options:\n\
+  -p, --port=PORT        TCP port to listen on.  Default 7700\n\
+  -q, --max-queue=BYTES  Bytes of messages that may wait to be sent to one\n\
+                         client.  Default 16777216\n\
+  -v, --verbose          Prints the throughput and clients once a second\n\
+  -h, --help             Shows this help text and exits\n\
+\n",
+            cmd);
+}
+
+static int set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static uint32_t get_uint32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return ntohl(v);
+}
+
+static void message_unref(message_t *msg)
+{
+    if (--msg->refcount == 0)
+        free(msg);
+}
+
+static void subscription_free(gpointer data)
+{
+    subscription_t *sub = (subscription_t *) data;
+    g_free(sub->pattern);
+    g_regex_unref(sub->regex);
+    free(sub);
+}
+
+static void watch(hub_t *hub, client_t *client)
+{
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | (client->want_write ? EPOLLOUT : 0);
+    ev.data.ptr = client;
+    epoll_ctl(hub->epfd, EPOLL_CTL_MOD, client->fd, &ev);
+}
+
+static void client_close(hub_t *hub, client_t *client)
+{
+    if (hub->verbose || client->dropped)
+        fprintf(stderr, "%s disconnected, %" PRIi64 " messages dropped\n", client->name,
+                (int64_t) client->dropped);
+    epoll_ctl(hub->epfd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    message_t *msg;
+    while ((msg = (message_t *) g_queue_pop_head(&client->out)))
+        message_unref(msg);
+    g_ptr_array_free(client->subs, TRUE);
+    g_hash_table_destroy(client->wanted);
+    free(client->recv_buf);
+    g_free(client->name);
+    g_ptr_array_remove_fast(hub->clients, client);
+    free(client);
+}
+
+// Sends as many of the queued messages as the socket takes.  Returns -1 if
+// the client has disconnected.
+static int client_flush(hub_t *hub, client_t *client)
+{
+    while (client->out.length > 0) {
+        struct iovec iov[MAX_IOV];
+        int iovcnt = 0;
+        int offset = client->out_offset;
+        for (GList *l = client->out.head; l && iovcnt < MAX_IOV; l = l->next) {
+            message_t *msg = (message_t *) l->data;
+            iov[iovcnt].iov_base = msg->data + offset;
+            iov[iovcnt].iov_len = msg->len - offset;
+            iovcnt++;
+            offset = 0;
+        }
+        ssize_t sent = writev(client->fd, iov, iovcnt);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (sent < 0)
+            return -1;
+
+        client->out_bytes -= sent;
+        while (sent > 0) {
+            message_t *msg = (message_t *) g_queue_peek_head(&client->out);
+            int left = msg->len - client->out_offset;
+            if (sent < left) {
+                client->out_offset += sent;
+                break;
+            }
+            sent -= left;
+            client->out_offset = 0;
+            message_unref((message_t *) g_queue_pop_head(&client->out));
+        }
+    }
+
+    int want_write = client->out.length > 0;
+    if (want_write != client->want_write) {
+        client->want_write = want_write;
+        watch(hub, client);
+    }
+    return 0;
+}
+
+static void mark_closed(GPtrArray *closed, client_t *client)
+{
+    if (!client->closing) {
+        client->closing = 1;
+        g_ptr_array_add(closed, client);
+    }
+}
+
+static int client_wants(client_t *client, const char *channel)
+{
+    gpointer value;
+    if (g_hash_table_lookup_extended(client->wanted, channel, NULL, &value))
+        return GPOINTER_TO_INT(value);
+    int wanted = 0;
+    for (guint i = 0; i < client->subs->len && !wanted; i++) {
+        subscription_t *sub = (subscription_t *) g_ptr_array_index(client->subs, i);
+        wanted = g_regex_match(sub->regex, channel, (GRegexMatchFlags) 0, NULL);
+    }
+    if (g_hash_table_size(client->wanted) >= MAX_CACHED_CHANNELS)
+        g_hash_table_remove_all(client->wanted);
+    g_hash_table_insert(client->wanted, g_strdup(channel), GINT_TO_POINTER(wanted));
+    return wanted;
+}
+
+// Queues msg for every client that subscribed to channel.  The clients that
+// disconnect are collected in closed.
+static void relay(hub_t *hub, const char *channel, message_t *msg, GPtrArray *closed)
+{
+    for (guint i = 0; i < hub->clients->len; i++) {
+        client_t *client = (client_t *) g_ptr_array_index(hub->clients, i);
+        if (!client->greeted || client->closing || !client_wants(client, channel))
+            continue;
+        if (client->out_bytes + msg->len > hub->max_queue) {
+            client->dropped++;
+            hub->messages_dropped++;
+            continue;
+        }
+        msg->refcount++;
+        g_queue_push_tail(&client->out, msg);
+        client->out_bytes += msg->len;
+        // a client that was keeping up is sent the message right away
+        if (client->out.length == 1 && 0 != client_flush(hub, client))
+            mark_closed(closed, client);
+    }
+}
+
+static void subscribe(client_t *client, const char *pattern)
+{
+    char *anchored = g_strdup_printf("^%s$", pattern);
+    GError *err = NULL;
+    GRegex *regex = g_regex_new(anchored, (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, &err);
+    g_free(anchored);
+    if (!regex) {
+        fprintf(stderr, "%s: invalid subscription %s: %s\n", client->name, pattern, err->message);
+        g_error_free(err);
+        return;
+    }
+    subscription_t *sub = (subscription_t *) malloc(sizeof(subscription_t));
+    sub->pattern = g_strdup(pattern);
+    sub->regex = regex;
+    g_ptr_array_add(client->subs, sub);
+    g_hash_table_remove_all(client->wanted);
+}
+
+static void unsubscribe(client_t *client, const char *pattern)
+{
+    for (guint i = 0; i < client->subs->len; i++) {
+        subscription_t *sub = (subscription_t *) g_ptr_array_index(client->subs, i);
+        if (!strcmp(sub->pattern, pattern)) {
+            g_ptr_array_remove_index(client->subs, i);
+            g_hash_table_remove_all(client->wanted);
+            return;
+        }
+    }
+}
+
+// Returns the length of the message at the start of the received bytes if
+// they're complete, and otherwise the number of bytes needed before more of
+// its length is known.
+static uint64_t frame_len(const client_t *client)
+{
+    const uint8_t *p = client->recv_buf + client->recv_start;
+    uint32_t avail = client->recv_end - client->recv_start;
+    if (!client->greeted)
+        return 8;
+    if (avail < 8)
+        return 8;
+    uint32_t type = get_uint32(p);
+    uint64_t channel_len = get_uint32(p + 4);
+    if (type != MESSAGE_TYPE_PUBLISH)
+        return 8 + channel_len;
+    if (avail < 12 + channel_len)
+        return 12 + channel_len;
+    return 12 + channel_len + get_uint32(p + 8 + channel_len);
+}
+
+// Handles the complete messages that the client has sent.  Returns -1 if the
+// client must be disconnected.
+static int client_handle(hub_t *hub, client_t *client, GPtrArray *closed)
+{
+    uint64_t len;
+    while ((len = frame_len(client)) <= client->recv_end - client->recv_start) {
+        uint8_t *p = client->recv_buf + client->recv_start;
+        client->recv_start += len;
+        if (!client->greeted) {
+            if (get_uint32(p) != MAGIC_CLIENT) {
+                fprintf(stderr, "%s: not an LCM tcpq client\n", client->name);
+                return -1;
+            }
+            client->greeted = 1;
+            continue;
+        }
+
+        uint32_t type = get_uint32(p);
+        uint32_t channel_len = get_uint32(p + 4);
+        char *channel = g_strndup((const char *) p + 8, channel_len);
+        if (type == MESSAGE_TYPE_PUBLISH) {
+            // the message is copied once, and shared by the clients it's
+            // queued for
+            message_t *msg = (message_t *) malloc(sizeof(message_t) + len);
+            msg->refcount = 1;
+            msg->len = (int) len;
+            memcpy(msg->data, p, len);
+            relay(hub, channel, msg, closed);
+            message_unref(msg);
+            hub->bytes_relayed += len;
+        } else if (type == MESSAGE_TYPE_SUBSCRIBE) {
+            subscribe(client, channel);
+        } else if (type == MESSAGE_TYPE_UNSUBSCRIBE) {
+            unsubscribe(client, channel);
+        }
+        g_free(channel);
+    }
+    return 0;
+}
+
+// Reads what the client has sent, and handles it.  Returns -1 if the client
+// must be disconnected.
+static int client_read(hub_t *hub, client_t *client, GPtrArray *closed)
+{
+    while (1) {
+        uint64_t needed = frame_len(client);
+        if (needed > MAX_MESSAGE_SIZE) {
+            fprintf(stderr, "%s: message of %" PRIu64 " bytes is too large\n",
+                    client->name, (uint64_t) needed);
+            return -1;
+        }
+        // the incomplete message is moved to the start of the buffer, which
+        // is grown to fit it
+        uint32_t avail = client->recv_end - client->recv_start;
+        if (client->recv_start > 0) {
+            memmove(client->recv_buf, client->recv_buf + client->recv_start, avail);
+            client->recv_start = 0;
+            client->recv_end = avail;
+        }
+        if (needed > client->recv_buf_len) {
+            client->recv_buf_len = needed;
+            client->recv_buf = (uint8_t *) realloc(client->recv_buf, client->recv_buf_len);
+        }
+
+        ssize_t n = recv(client->fd, client->recv_buf + client->recv_end,
+                         client->recv_buf_len - client->recv_end, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        if (n <= 0)
+            return -1;
+        client->recv_end += n;
+        if (0 != client_handle(hub, client, closed))
+            return -1;
+    }
+}
+
+static void accept_clients(hub_t *hub)
+{
+    while (1) {
+        struct sockaddr_in sa;
+        socklen_t sa_len = sizeof(sa);
+        int fd = accept(hub->listen_fd, (struct sockaddr *) &sa, &sa_len);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                perror("accept");
+            return;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        uint32_t hello[2] = {htonl(MAGIC_SERVER), htonl(PROTOCOL_VERSION)};
+        if (sizeof(hello) != send(fd, hello, sizeof(hello), MSG_NOSIGNAL) ||
+            0 != set_nonblocking(fd)) {
+            close(fd);
+            continue;
+        }
+
+        client_t *client = (client_t *) calloc(1, sizeof(client_t));
+        client->fd = fd;
+        client->name = g_strdup_printf("%s:%d", inet_ntoa(sa.sin_addr), ntohs(sa.sin_port));
+        client->recv_buf_len = RECV_BUF_SIZE;
+        client->recv_buf = (uint8_t *) malloc(client->recv_buf_len);
+        client->subs = g_ptr_array_new_with_free_func(subscription_free);
+        client->wanted = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        g_queue_init(&client->out);
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = client;
+        epoll_ctl(hub->epfd, EPOLL_CTL_ADD, fd, &ev);
+        g_ptr_array_add(hub->clients, client);
+        if (hub->verbose)
+            fprintf(stderr, "%s connected\n", client->name);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    hub_t hub;
+    memset(&hub, 0, sizeof(hub));
+    hub.max_queue = 16 * 1024 * 1024;
+    int port = 7700;
+
+    char *optstring = "p:q:vh";
+    int c;
+    struct option long_opts[] = {
+        {"port", required_argument, 0, 'p'},
+        {"max-queue", required_argument, 0, 'q'},
+        {"verbose", no_argument, 0, 'v'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0},
+    };
+
+    while ((c = getopt_long(argc, argv, optstring, long_opts, 0)) >= 0) {
+        char *eptr = NULL;
+        switch (c) {
+        case 'p':
+            port = strtol(optarg, &eptr, 10);
+            if (*eptr || port <= 0 || port > 65535) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'q':
+            hub.max_queue = strtoll(optarg, &eptr, 10);
+            if (*eptr || hub.max_queue <= 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'v':
+            hub.verbose = 1;
+            break;
+        case 'h':
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    hub.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(hub.listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_ANY);
+    sa.sin_port = htons(port);
+    if (0 != bind(hub.listen_fd, (struct sockaddr *) &sa, sizeof(sa)) ||
+        0 != listen(hub.listen_fd, SOMAXCONN) || 0 != set_nonblocking(hub.listen_fd)) {
+        perror("Error: Failed to listen");
+        return 1;
+    }
+
+    hub.epfd = epoll_create1(0);
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    epoll_ctl(hub.epfd, EPOLL_CTL_ADD, hub.listen_fd, &ev);
+    hub.clients = g_ptr_array_new();
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (hub.verbose)
+        fprintf(stderr, "Listening on port %d\n", port);
+    GPtrArray *closed = g_ptr_array_new();
+    int64_t last_report = g_get_monotonic_time();
+    while (!g_quit) {
+        struct epoll_event events[MAX_EVENTS];
+        int n = epoll_wait(hub.epfd, events, MAX_EVENTS, 1000);
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            client_t *client = (client_t *) events[i].data.ptr;
+            if (!client) {
+                accept_clients(&hub);
+                continue;
+            }
+            if (client->closing)
+                continue;
+            if ((events[i].events & (EPOLLERR | EPOLLHUP)) ||
+                ((events[i].events & EPOLLIN) && 0 != client_read(&hub, client, closed)) ||
+                ((events[i].events & EPOLLOUT) && 0 != client_flush(&hub, client)))
+                mark_closed(closed, client);
+        }
+        for (guint i = 0; i < closed->len; i++)
+            client_close(&hub, (client_t *) g_ptr_array_index(closed, i));
+        g_ptr_array_set_size(closed, 0);
+
+        int64_t now = g_get_monotonic_time();
+        if (hub.verbose && now - last_report >= 1000000) {
+            double dt = (now - last_report) * 1e-6;
+            fprintf(stderr, "%10.1f kB/s, %u clients, %" PRIi64 " dropped\n",
+                    hub.bytes_relayed / 1024.0 / dt, hub.clients->len,
+                    (int64_t) hub.messages_dropped);
+            hub.bytes_relayed = 0;
+            last_report = now;
+        }
+    }
+
+    while (hub.clients->len > 0)
+        client_close(&hub, (client_t *) g_ptr_array_index(hub.clients, 0));
+    g_ptr_array_free(hub.clients, TRUE);
+    g_ptr_array_free(closed, TRUE);
+    close(hub.epfd);
+    close(hub.listen_fd);
+    return 0;
+}
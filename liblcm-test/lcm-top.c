@@ -0,0 +1,469 @@
+// file: lcm-top.c
+// desc: a terminal dashboard of the traffic on each channel, and of the
+//       handler timings and receive counters that processes publish with
+//       lcm_publish_handler_stats().
+
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <getopt.h>
+#include <glib.h>
+#include <lcm/lcm.h>
+#include <lcm/lcmtypes/handler_stats_report_t.h>
+
+#define DEFAULT_INTERVAL 1.0
+
+// A process whose reports stop is forgotten after this many intervals.
+#define STALE_INTERVALS 10
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int signum)
+{
+    stop_requested = 1;
+}
+
+static int64_t now_ns(void)
+{
+#ifdef WIN32
+    return g_get_monotonic_time() * 1000;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+// What was seen of a channel in the current interval, from the traffic itself
+// and from the reports of the processes that subscribe to it.
+typedef struct {
+    int64_t messages;
+    int64_t bytes;
+
+    // whether a report had a subscription to the channel in the interval
+    int reported;
+    int64_t dropped;
+    int64_t calls;
+    int64_t queue_delay_usec;
+    int64_t max_usec;
+    int64_t histogram[LCM_HANDLER_STATS_BUCKETS];
+} channel_t;
+
+// The counters of a process, as of its last report, and their increase in
+// the current interval.
+typedef struct {
+    handler_stats_report_t last;
+    int64_t last_seen_ns;
+
+    int64_t packets_received;
+    int64_t bytes_received;
+    int64_t packets_bad;
+    int64_t frag_bufs_evicted;
+    int64_t messages_incomplete;
+    int64_t kernel_drops;
+    int64_t queue_drops;
+    int64_t seqno_gaps;
+} source_t;
+
+typedef struct {
+    lcm_t *lcm;
+    GHashTable *channels;  // name -> channel_t
+    GHashTable *sources;   // "hostname:pid" -> source_t
+    int64_t bad_reports;
+    // the counters of lcm-top's own lcm_t, for when no process reports
+    lcm_stats_t local_last;
+    lcm_stats_t local;
+} top_t;
+
+static channel_t *get_channel(top_t *top, const char *name)
+{
+    channel_t *ch = (channel_t *) g_hash_table_lookup(top->channels, name);
+    if (!ch) {
+        ch = g_new0(channel_t, 1);
+        g_hash_table_insert(top->channels, g_strdup(name), ch);
+    }
+    return ch;
+}
+
+static void source_free(gpointer data)
+{
+    source_t *src = (source_t *) data;
+    handler_stats_report_t_decode_cleanup(&src->last);
+    g_free(src);
+}
+
+// Only the size of messages is looked at, so sniffing costs no more than
+// receiving them.
+static void on_message(const lcm_recv_buf_t *rbuf, const char *channel, void *user)
+{
+    channel_t *ch = get_channel((top_t *) user, channel);
+    ch->messages++;
+    ch->bytes += rbuf->data_size;
+}
+
+// Adds what a handler did since the previous report of its process to its
+// channel.  A handler that's new, or whose counters went back, only gives a
+// starting point.
+static void add_handler(top_t *top, const handler_stats_t *prev, const handler_stats_t *h)
+{
+    channel_t *ch = get_channel(top, h->channel);
+    ch->reported = 1;
+    ch->max_usec = MAX(ch->max_usec, h->max_usec);
+    if (!prev || strcmp(prev->channel, h->channel) || h->num_calls < prev->num_calls ||
+        h->num_dropped < prev->num_dropped)
+        return;
+    ch->dropped += h->num_dropped - prev->num_dropped;
+    ch->calls += h->num_calls - prev->num_calls;
+    ch->queue_delay_usec += h->total_queue_delay_usec - prev->total_queue_delay_usec;
+    for (int i = 0; i < h->num_buckets && i < prev->num_buckets; i++)
+        ch->histogram[MIN(i, LCM_HANDLER_STATS_BUCKETS - 1)] +=
+            h->histogram[i] - prev->histogram[i];
+}
+
+static void on_report(const lcm_recv_buf_t *rbuf, const char *channel, void *user)
+{
+    top_t *top = (top_t *) user;
+    handler_stats_report_t report;
+    if (handler_stats_report_t_decode(rbuf->data, 0, rbuf->data_size, &report) < 0) {
+        top->bad_reports++;
+        return;
+    }
+
+    source_t *src = (source_t *) g_hash_table_lookup(top->sources, report.source);
+    int first = !src;
+    if (first) {
+        src = g_new0(source_t, 1);
+        g_hash_table_insert(top->sources, g_strdup(report.source), src);
+    }
+    src->last_seen_ns = now_ns();
+
+    handler_stats_report_t *last = &src->last;
+    for (int i = 0; i < report.num_handlers; i++) {
+        int have_prev = !first && i < last->num_handlers;
+        add_handler(top, have_prev ? &last->handlers[i] : NULL, &report.handlers[i]);
+    }
+    // a process that restarted with the same pid starts over
+    if (!first && report.packets_received >= last->packets_received) {
+        src->packets_received += report.packets_received - last->packets_received;
+        src->bytes_received += report.bytes_received - last->bytes_received;
+        src->packets_bad += report.packets_bad - last->packets_bad;
+        src->frag_bufs_evicted += report.frag_bufs_evicted - last->frag_bufs_evicted;
+        src->messages_incomplete += report.messages_incomplete - last->messages_incomplete;
+        src->kernel_drops += report.kernel_drops - last->kernel_drops;
+        src->queue_drops += report.queue_drops - last->queue_drops;
+        src->seqno_gaps += report.seqno_gaps - last->seqno_gaps;
+    }
+    if (!first)
+        handler_stats_report_t_decode_cleanup(last);
+    *last = report;
+}
+
+// The upper bound, in microseconds, of the histogram bucket that holds the
+// given fraction of the calls, or -1 if there were none.
+static int64_t histogram_percentile(const int64_t *histogram, int64_t calls, double fraction)
+{
+    if (calls <= 0)
+        return -1;
+    int64_t target = (int64_t) (calls * fraction);
+    int64_t seen = 0;
+    for (int i = 0; i < LCM_HANDLER_STATS_BUCKETS; i++) {
+        seen += histogram[i];
+        if (seen > target)
+            return (int64_t) 1 << i;
+    }
+    return (int64_t) 1 << (LCM_HANDLER_STATS_BUCKETS - 1);
+}
+
+static void print_usec(int64_t usec)
+{
+    if (usec < 0)
+        printf(" %8s", "-");
+    else
+        printf(" %8" PRId64, usec);
+}
+
+typedef struct {
+    const char *name;
+    channel_t *ch;
+} channel_row_t;
+
+// Busiest channels first, then by name.
+static int compare_rows(gconstpointer a, gconstpointer b)
+{
+    const channel_row_t *ra = (const channel_row_t *) a;
+    const channel_row_t *rb = (const channel_row_t *) b;
+    if (ra->ch->bytes != rb->ch->bytes)
+        return ra->ch->bytes > rb->ch->bytes ? -1 : 1;
+    return strcmp(ra->name, rb->name);
+}
+
+static void print_channels(top_t *top, double elapsed)
+{
+    GArray *rows = g_array_new(FALSE, FALSE, sizeof(channel_row_t));
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, top->channels);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        channel_row_t row = {(const char *) key, (channel_t *) value};
+        g_array_append_val(rows, row);
+    }
+    g_array_sort(rows, compare_rows);
+
+    printf("%-32s %10s %10s %8s %9s %8s %8s %8s %8s\n", "channel", "msg/s", "KB/s", "drop/s",
+           "calls/s", "delay us", "p50 us", "p99 us", "max us");
+    for (guint i = 0; i < rows->len; i++) {
+        channel_row_t *row = &g_array_index(rows, channel_row_t, i);
+        channel_t *ch = row->ch;
+        printf("%-32s %10.1f %10.1f", row->name, ch->messages / elapsed,
+               ch->bytes / 1024.0 / elapsed);
+        if (ch->reported) {
+            printf(" %8.1f %9.1f", ch->dropped / elapsed, ch->calls / elapsed);
+            print_usec(ch->calls ? ch->queue_delay_usec / ch->calls : -1);
+            print_usec(histogram_percentile(ch->histogram, ch->calls, 0.5));
+            print_usec(histogram_percentile(ch->histogram, ch->calls, 0.99));
+            print_usec(ch->max_usec);
+        } else {
+            printf(" %8s %9s %8s %8s %8s %8s", "-", "-", "-", "-", "-", "-");
+        }
+        printf("\n");
+    }
+    g_array_free(rows, TRUE);
+}
+
+static void print_source_row(const char *name, const source_t *s, double elapsed)
+{
+    printf("%-32s %10.1f %10.1f %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f\n", name,
+           s->packets_received / elapsed, s->bytes_received / 1024.0 / elapsed,
+           s->packets_bad / elapsed, s->messages_incomplete / elapsed,
+           s->frag_bufs_evicted / elapsed, s->kernel_drops / elapsed, s->queue_drops / elapsed,
+           s->seqno_gaps / elapsed);
+}
+
+static int compare_names(gconstpointer a, gconstpointer b)
+{
+    return strcmp(*(const char *const *) a, *(const char *const *) b);
+}
+
+static void print_sources(top_t *top, double elapsed)
+{
+    printf("%-32s %10s %10s %8s %8s %8s %8s %8s %8s\n", "process", "pkt/s", "KB/s", "bad/s",
+           "incmp/s", "evict/s", "kdrop/s", "qdrop/s", "gaps/s");
+
+    GPtrArray *names = g_ptr_array_new();
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, top->sources);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+        g_ptr_array_add(names, key);
+    g_ptr_array_sort(names, compare_names);
+    for (guint i = 0; i < names->len; i++) {
+        const char *name = (const char *) g_ptr_array_index(names, i);
+        print_source_row(name, (source_t *) g_hash_table_lookup(top->sources, name), elapsed);
+    }
+    g_ptr_array_free(names, TRUE);
+
+    // what lcm-top itself received, which shows the losses on this host even
+    // when no process reports
+    lcm_stats_t now;
+    if (lcm_get_stats(top->lcm, &now) == 0) {
+        source_t local;
+        memset(&local, 0, sizeof(local));
+        local.packets_received = now.packets_received - top->local_last.packets_received;
+        local.bytes_received = now.bytes_received - top->local_last.bytes_received;
+        local.packets_bad = now.packets_bad - top->local_last.packets_bad;
+        local.messages_incomplete = now.messages_incomplete - top->local_last.messages_incomplete;
+        local.frag_bufs_evicted = now.frag_bufs_evicted - top->local_last.frag_bufs_evicted;
+        local.kernel_drops = now.kernel_drops - top->local_last.kernel_drops;
+        local.queue_drops = now.queue_drops - top->local_last.queue_drops;
+        local.seqno_gaps = now.seqno_gaps - top->local_last.seqno_gaps;
+        print_source_row("(lcm-top)", &local, elapsed);
+        top->local_last = now;
+    }
+}
+
+// Starts a new interval, and forgets the channels that went quiet and the
+// processes that stopped reporting.
+static void reset_interval(top_t *top, int64_t now, int64_t stale_ns)
+{
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, top->channels);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        channel_t *ch = (channel_t *) value;
+        if (!ch->messages && !ch->reported)
+            g_hash_table_iter_remove(&iter);
+        else
+            memset(ch, 0, sizeof(*ch));
+    }
+    g_hash_table_iter_init(&iter, top->sources);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        source_t *src = (source_t *) value;
+        if (now - src->last_seen_ns > stale_ns) {
+            g_hash_table_iter_remove(&iter);
+            continue;
+        }
+        src->packets_received = 0;
+        src->bytes_received = 0;
+        src->packets_bad = 0;
+        src->frag_bufs_evicted = 0;
+        src->messages_incomplete = 0;
+        src->kernel_drops = 0;
+        src->queue_drops = 0;
+        src->seqno_gaps = 0;
+    }
+}
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: lcm-top [options] [CHANNEL_REGEX]\n"
+            "\n"
+            "Shows, every interval, the message rate and bandwidth of each channel that\n"
+            "matches CHANNEL_REGEX (default: .*), and what the processes that publish\n"
+            "handler statistics report about them: the messages their subscriptions\n"
+            "dropped, and the rate, mean queueing delay, 50th and 99th percentile and\n"
+            "maximum time of their handlers.  Processes report by calling\n"
+            "lcm_publish_handler_stats() periodically, after lcm_set_handler_stats().\n"
+            "Percentiles are the upper bounds of the power of two buckets that they fall\n"
+            "in, and the maximum is since the process enabled handler statistics.\n"
+            "\n"
+            "Below the channels, a row per reporting process, and one for lcm-top itself,\n"
+            "shows the rates of packets and bytes received, and of malformed packets,\n"
+            "messages that lost fragments, partial messages evicted, datagrams dropped\n"
+            "by the kernel and by full subscription queues, and sequence number gaps.\n"
+            "\n"
+            "Without any reports, lcm-top still shows the traffic of each channel, and\n"
+            "the losses on its own host.  It only looks at the channel and size of the\n"
+            "messages it receives, so it is cheap enough to leave running.\n"
+            "\n"
+            "Options:\n"
+            "\n"
+            "  -l, --lcm-url=URL          Provider to watch.  (default: the default\n"
+            "                             provider)\n"
+            "  -s, --stats-channel=NAME   Channel of the reports.  (default: " LCM_STATS_CHANNEL
+            ")\n"
+            "  -i, --interval=SECONDS     How often to refresh.  (default: %.0f)\n"
+            "  -b, --batch                Print each refresh after the previous one,\n"
+            "                             instead of redrawing the screen.\n"
+            "  -d, --duration=SECONDS     Stop after this long.  (default: run until\n"
+            "                             interrupted)\n"
+            "  -h, --help                 Shows this help text and exits.\n",
+            DEFAULT_INTERVAL);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    const char *url = NULL;
+    const char *stats_channel = LCM_STATS_CHANNEL;
+    double interval = DEFAULT_INTERVAL;
+    double duration = 0;
+    int batch = 0;
+
+    char *optstring = "l:s:i:bd:h";
+    struct option long_opts[] = {
+        {"lcm-url", required_argument, 0, 'l'},
+        {"stats-channel", required_argument, 0, 's'},
+        {"interval", required_argument, 0, 'i'},
+        {"batch", no_argument, 0, 'b'},
+        {"duration", required_argument, 0, 'd'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0},
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, optstring, long_opts, 0)) >= 0) {
+        switch (c) {
+        case 'l':
+            url = optarg;
+            break;
+        case 's':
+            stats_channel = optarg;
+            break;
+        case 'i':
+            interval = strtod(optarg, NULL);
+            if (interval <= 0)
+                usage();
+            break;
+        case 'b':
+            batch = 1;
+            break;
+        case 'd':
+            duration = strtod(optarg, NULL);
+            break;
+        case 'h':
+        default:
+            usage();
+            break;
+        }
+    }
+
+    const char *channels = ".*";
+    if (optind < argc)
+        channels = argv[optind++];
+    if (optind < argc)
+        usage();
+
+    top_t top;
+    memset(&top, 0, sizeof(top));
+    top.lcm = lcm_create(url);
+    if (!top.lcm) {
+        fprintf(stderr, "couldn't create an LCM instance for %s\n", url ? url : "the default URL");
+        return 1;
+    }
+    top.channels = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    top.sources = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, source_free);
+    lcm_get_stats(top.lcm, &top.local_last);
+
+    lcm_subscription_t *traffic = lcm_subscribe(top.lcm, channels, on_message, &top);
+    lcm_subscription_t *reports = lcm_subscribe(top.lcm, stats_channel, on_report, &top);
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    int64_t report_period = (int64_t) (interval * 1e9);
+    int64_t start = now_ns();
+    int64_t end = duration > 0 ? start + (int64_t) (duration * 1e9) : INT64_MAX;
+    int64_t last_report = start;
+    int64_t next_report = start + report_period;
+    while (!stop_requested) {
+        int64_t now = now_ns();
+        if (now >= end)
+            break;
+        if (now >= next_report) {
+            double elapsed = (now - last_report) / 1e9;
+            if (!batch)
+                printf("\033[H\033[2J");
+            printf("lcm-top: %s, every %.1f s, %u reporting processes", url ? url : "default URL",
+                   interval, g_hash_table_size(top.sources));
+            if (top.bad_reports)
+                printf(", %" PRId64 " undecodable reports on %s", top.bad_reports, stats_channel);
+            printf("\n\n");
+            print_channels(&top, elapsed);
+            printf("\n");
+            print_sources(&top, elapsed);
+            if (batch)
+                printf("\n");
+            fflush(stdout);
+            reset_interval(&top, now, STALE_INTERVALS * report_period);
+            last_report = now;
+            next_report += report_period;
+            if (next_report < now)
+                next_report = now + report_period;
+        }
+        int64_t wait = MIN(next_report, end) - now_ns();
+        if (lcm_handle_timeout(top.lcm, wait > 0 ? (int) (wait / 1000000) : 0) < 0)
+            break;
+    }
+
+    lcm_unsubscribe(top.lcm, traffic);
+    lcm_unsubscribe(top.lcm, reports);
+    g_hash_table_destroy(top.channels);
+    g_hash_table_destroy(top.sources);
+    lcm_destroy(top.lcm);
+    return 0;
+}
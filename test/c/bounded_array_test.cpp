@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "common.h"
+
+// The bounds of lcmtest_bounded_t don't change its fingerprint or encoding,
+// so it decodes what lcmtest_unbounded_t encodes, and the other way round.
+TEST(LCM_C, BoundedArrayRoundTrip)
+{
+    EXPECT_EQ(LCMTEST_UNBOUNDED_T_FINGERPRINT, LCMTEST_BOUNDED_T_FINGERPRINT);
+    EXPECT_EQ(__lcmtest_unbounded_t_get_hash(), __lcmtest_bounded_t_get_hash());
+
+    for (int n = 0; n < 4; n++) {
+        lcmtest_bounded_t msg;
+        fill_lcmtest_bounded_t(n, &msg);
+        int len = lcmtest_bounded_t_encoded_size(&msg);
+        std::vector<uint8_t> buf(len);
+        ASSERT_EQ(len, lcmtest_bounded_t_encode(&buf[0], 0, len, &msg));
+        clear_lcmtest_bounded_t(&msg);
+
+        lcmtest_unbounded_t unbounded;
+        fill_lcmtest_unbounded_t(n, &unbounded);
+        ASSERT_EQ(len, lcmtest_unbounded_t_encoded_size(&unbounded));
+        std::vector<uint8_t> unbounded_buf(len);
+        ASSERT_EQ(len, lcmtest_unbounded_t_encode(&unbounded_buf[0], 0, len, &unbounded));
+        clear_lcmtest_unbounded_t(&unbounded);
+        EXPECT_EQ(buf, unbounded_buf);
+
+        lcmtest_bounded_t decoded;
+        ASSERT_EQ(len, lcmtest_bounded_t_decode(&buf[0], 0, len, &decoded));
+        EXPECT_TRUE(check_lcmtest_bounded_t(&decoded, n));
+        lcmtest_bounded_t_decode_cleanup(&decoded);
+
+        ASSERT_EQ(len, lcmtest_unbounded_t_decode(&buf[0], 0, len, &unbounded));
+        lcmtest_unbounded_t_decode_cleanup(&unbounded);
+    }
+}
+
+// Encodes an lcmtest_unbounded_t whose length member at offset, counted
+// from the start of the message after the fingerprint, is replaced by
+// length.
+static std::vector<uint8_t> encode_with_length(int offset, int32_t length)
+{
+    lcmtest_unbounded_t msg;
+    fill_lcmtest_unbounded_t(1, &msg);
+    int len = lcmtest_unbounded_t_encoded_size(&msg);
+    std::vector<uint8_t> buf(len);
+    lcmtest_unbounded_t_encode(&buf[0], 0, len, &msg);
+    clear_lcmtest_unbounded_t(&msg);
+
+    uint8_t *p = &buf[8 + offset];
+    p[0] = (uint8_t) (length >> 24);
+    p[1] = (uint8_t) (length >> 16);
+    p[2] = (uint8_t) (length >> 8);
+    p[3] = (uint8_t) length;
+    return buf;
+}
+
+TEST(LCM_C, BoundedArrayDecodeRejectsLengths)
+{
+    // num_values, which is followed by 2 values, and num_rows
+    const int num_values_offset = 0;
+    const int num_rows_offset = 4 + 2 * 2;
+    const int32_t lengths[] = {9, 100000, -1, INT32_MIN};
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        std::vector<uint8_t> bufs[] = {encode_with_length(num_values_offset, lengths[i]),
+                                       encode_with_length(num_rows_offset, lengths[i])};
+        for (int b = 0; b < 2; b++) {
+            const std::vector<uint8_t> &buf = bufs[b];
+            int len = (int) buf.size();
+            lcmtest_bounded_t decoded;
+            EXPECT_EQ(-1, lcmtest_bounded_t_decode(&buf[0], 0, len, &decoded));
+            size_t size = 0;
+            EXPECT_EQ(-1, lcmtest_bounded_t_decode_arena_size(&buf[0], 0, len, &size));
+        }
+    }
+
+    // a length past the bound is rejected even if the message holds that
+    // many elements
+    lcmtest_unbounded_t msg;
+    fill_lcmtest_unbounded_t(3, &msg);
+    free(msg.values);
+    msg.num_values = 9;
+    msg.values = (int16_t *) calloc(msg.num_values, sizeof(int16_t));
+    int len = lcmtest_unbounded_t_encoded_size(&msg);
+    std::vector<uint8_t> buf(len);
+    ASSERT_EQ(len, lcmtest_unbounded_t_encode(&buf[0], 0, len, &msg));
+    clear_lcmtest_unbounded_t(&msg);
+    lcmtest_bounded_t decoded;
+    EXPECT_EQ(-1, lcmtest_bounded_t_decode(&buf[0], 0, len, &decoded));
+}
+
+TEST(LCM_C, BoundedArrayEncodeRejectsLengths)
+{
+    lcmtest_bounded_t msg;
+    memset(&msg, 0, sizeof(msg));
+    fill_lcmtest_bounded_t(3, &msg);
+    // room for the longest message that the type holds
+    std::vector<uint8_t> buf(4096);
+    int len = (int) buf.size();
+    ASSERT_LT(0, lcmtest_bounded_t_encode(&buf[0], 0, len, &msg));
+
+    msg.num_values = 9;
+    EXPECT_EQ(-1, lcmtest_bounded_t_encode(&buf[0], 0, len, &msg));
+    msg.num_values = -1;
+    EXPECT_EQ(-1, lcmtest_bounded_t_encode(&buf[0], 0, len, &msg));
+    msg.num_values = 8;
+    EXPECT_LT(0, lcmtest_bounded_t_encode(&buf[0], 0, len, &msg));
+
+    msg.num_cols = 3;
+    EXPECT_EQ(-1, lcmtest_bounded_t_encode(&buf[0], 0, len, &msg));
+    msg.num_cols = 2;
+    msg.num_rows = 5;
+    EXPECT_EQ(-1, lcmtest_bounded_t_encode(&buf[0], 0, len, &msg));
+    msg.num_rows = 4;
+
+    int num_items = msg.num_items;
+    msg.num_items = 4;
+    EXPECT_EQ(-1, lcmtest_bounded_t_encode(&buf[0], 0, len, &msg));
+    msg.num_items = num_items;
+    clear_lcmtest_bounded_t(&msg);
+}
+
+TEST(LCM_C, BoundedArrayCopy)
+{
+    // The inline arrays are copied with the struct, and the allocations of
+    // their elements are duplicated, and released by destroy().
+    for (int n = 0; n < 4; n++) {
+        lcmtest_bounded_t msg;
+        fill_lcmtest_bounded_t(n, &msg);
+        lcmtest_bounded_t *copy = lcmtest_bounded_t_copy(&msg);
+        ASSERT_TRUE(copy != NULL);
+        clear_lcmtest_bounded_t(&msg);
+        memset(&msg, 0, sizeof(msg));
+
+        EXPECT_TRUE(check_lcmtest_bounded_t(copy, n));
+        lcmtest_bounded_t *copy2 = lcmtest_bounded_t_copy(copy);
+        for (int i = 0; i < n; i++) {
+            EXPECT_NE(copy->items[i].name, copy2->items[i].name);
+            if (i > 0) {
+                EXPECT_NE(copy->items[i].ranges, copy2->items[i].ranges);
+            }
+        }
+        lcmtest_bounded_t_destroy(copy);
+        EXPECT_TRUE(check_lcmtest_bounded_t(copy2, n));
+        lcmtest_bounded_t_destroy(copy2);
+    }
+}
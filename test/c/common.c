@@ -64,6 +64,111 @@ char *_strdup(const char *src)
 }
 #endif
 
+// n is at most 3, so that the lengths fit into the bounds of the type
+int check_lcmtest_bounded_t(const lcmtest_bounded_t *msg, int expected)
+{
+    int n = expected;
+    CHECK_FIELD(msg->num_values, 2 * n, "%d");
+    int i, j;
+    for (i = 0; i < msg->num_values; i++)
+        CHECK_FIELD(msg->values[i], i - n, "%d");
+    CHECK_FIELD(msg->num_rows, n + 1, "%d");
+    CHECK_FIELD(msg->num_cols, n % 3, "%d");
+    for (i = 0; i < msg->num_rows; i++) {
+        for (j = 0; j < 3; j++)
+            CHECK_FIELD(msg->points[i][j], (float) (i * 3 + j + n), "%f");
+        for (j = 0; j < msg->num_cols; j++)
+            CHECK_FIELD(msg->grid[i][j], i * 10 + j + n, "%d");
+    }
+    CHECK_FIELD(msg->num_items, n, "%d");
+    for (i = 0; i < msg->num_items; i++) {
+        if (!check_lcmtest_primitives_t(&msg->items[i], i))
+            return 0;
+    }
+    char expected_name[80];
+    snprintf(expected_name, 79, "%d", n);
+    if (strcmp(expected_name, msg->name)) {
+        info("Expected msg->name to be %s, got %s instead\n", expected_name, msg->name);
+        return 0;
+    }
+    return 1;
+}
+
+void fill_lcmtest_bounded_t(int n, lcmtest_bounded_t *msg)
+{
+    int i, j;
+    msg->num_values = 2 * n;
+    for (i = 0; i < msg->num_values; i++)
+        msg->values[i] = i - n;
+    msg->num_rows = n + 1;
+    msg->num_cols = n % 3;
+    for (i = 0; i < msg->num_rows; i++) {
+        for (j = 0; j < 3; j++)
+            msg->points[i][j] = i * 3 + j + n;
+        for (j = 0; j < msg->num_cols; j++)
+            msg->grid[i][j] = i * 10 + j + n;
+    }
+    msg->num_items = n;
+    for (i = 0; i < msg->num_items; i++)
+        fill_lcmtest_primitives_t(i, &msg->items[i]);
+    char name_buf[80];
+    snprintf(name_buf, 79, "%d", n);
+    msg->name = _strdup(name_buf);
+}
+
+void clear_lcmtest_bounded_t(lcmtest_bounded_t *msg)
+{
+    int i;
+    for (i = 0; i < msg->num_items; i++)
+        clear_lcmtest_primitives_t(&msg->items[i]);
+    free(msg->name);
+}
+
+// fills msg with what fill_lcmtest_bounded_t() does, in allocated arrays
+void fill_lcmtest_unbounded_t(int n, lcmtest_unbounded_t *msg)
+{
+    int i, j;
+    msg->num_values = 2 * n;
+    msg->values = (int16_t *) malloc(msg->num_values * sizeof(int16_t));
+    for (i = 0; i < msg->num_values; i++)
+        msg->values[i] = i - n;
+    msg->num_rows = n + 1;
+    msg->num_cols = n % 3;
+    msg->points = (float **) malloc(msg->num_rows * sizeof(float *));
+    msg->grid = (int32_t **) malloc(msg->num_rows * sizeof(int32_t *));
+    for (i = 0; i < msg->num_rows; i++) {
+        msg->points[i] = (float *) malloc(3 * sizeof(float));
+        for (j = 0; j < 3; j++)
+            msg->points[i][j] = i * 3 + j + n;
+        msg->grid[i] = (int32_t *) malloc(msg->num_cols * sizeof(int32_t));
+        for (j = 0; j < msg->num_cols; j++)
+            msg->grid[i][j] = i * 10 + j + n;
+    }
+    msg->num_items = n;
+    msg->items = (lcmtest_primitives_t *) malloc(msg->num_items * sizeof(lcmtest_primitives_t));
+    for (i = 0; i < msg->num_items; i++)
+        fill_lcmtest_primitives_t(i, &msg->items[i]);
+    char name_buf[80];
+    snprintf(name_buf, 79, "%d", n);
+    msg->name = _strdup(name_buf);
+}
+
+void clear_lcmtest_unbounded_t(lcmtest_unbounded_t *msg)
+{
+    int i;
+    free(msg->values);
+    for (i = 0; i < msg->num_rows; i++) {
+        free(msg->points[i]);
+        free(msg->grid[i]);
+    }
+    free(msg->points);
+    free(msg->grid);
+    for (i = 0; i < msg->num_items; i++)
+        clear_lcmtest_primitives_t(&msg->items[i]);
+    free(msg->items);
+    free(msg->name);
+}
+
 int check_lcmtest_multidim_array_t(const lcmtest_multidim_array_t *msg, int expected)
 {
     CHECK_FIELD(msg->size_a, expected, "%d");
@@ -6,15 +6,24 @@ extern "C" {
 #endif
 
 #include "lcmtest2_cross_package_t.h"
+#include "lcmtest_bounded_t.h"
 #include "lcmtest_multidim_array_t.h"
 #include "lcmtest_node_t.h"
 #include "lcmtest_primitives_list_t.h"
 #include "lcmtest_primitives_t.h"
+#include "lcmtest_unbounded_t.h"
 
 #ifndef WIN32
 char *_strdup(const char *src);
 #endif
 
+int check_lcmtest_bounded_t(const lcmtest_bounded_t *msg, int expected);
+void fill_lcmtest_bounded_t(int n, lcmtest_bounded_t *msg);
+void clear_lcmtest_bounded_t(lcmtest_bounded_t *msg);
+
+void fill_lcmtest_unbounded_t(int n, lcmtest_unbounded_t *msg);
+void clear_lcmtest_unbounded_t(lcmtest_unbounded_t *msg);
+
 int check_lcmtest_multidim_array_t(const lcmtest_multidim_array_t *msg, int expected);
 void fill_lcmtest_multidim_array_t(int num_children, lcmtest_multidim_array_t *result);
 void clear_lcmtest_multidim_array_t(lcmtest_multidim_array_t *msg);
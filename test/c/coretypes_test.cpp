@@ -0,0 +1,83 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <lcm/lcm_coretypes.h>
+
+// The array lengths to check, around the block sizes of the bulk conversions
+static const int kMaxElements = 41;
+
+// Checks that the arrays encode to big-endian bytes at any alignment, and
+// decode back to the same values.
+template <class T>
+static void CheckArrays(int (*encode)(void *, int, int, const T *, int),
+                        int (*decode)(const void *, int, int, T *, int))
+{
+    for (int elements = 0; elements <= kMaxElements; elements++) {
+        std::vector<T> values(elements + 1);
+        std::vector<uint8_t> expected(elements * sizeof(T));
+        for (int element = 0; element < elements; element++) {
+            uint8_t bytes[sizeof(T)];
+            for (size_t i = 0; i < sizeof(T); i++) {
+                bytes[i] = (uint8_t) (element * 31 + i * 7 + 0x80);
+                expected[element * sizeof(T) + i] = bytes[i];
+            }
+            // the encoded bytes are most significant first
+            uint64_t v = 0;
+            for (size_t i = 0; i < sizeof(T); i++)
+                v = (v << 8) | bytes[i];
+            if (sizeof(T) == 2) {
+                uint16_t v16 = (uint16_t) v;
+                memcpy(&values[element], &v16, sizeof(T));
+            } else if (sizeof(T) == 4) {
+                uint32_t v32 = (uint32_t) v;
+                memcpy(&values[element], &v32, sizeof(T));
+            } else {
+                memcpy(&values[element], &v, sizeof(T));
+            }
+        }
+
+        for (int offset = 0; offset < 3; offset++) {
+            std::vector<uint8_t> buf(offset + expected.size() + 1, 0xaa);
+            int maxlen = (int) expected.size();
+            if (elements > 0) {
+                EXPECT_EQ(-1, encode(&buf[0], offset, maxlen - 1, &values[0], elements));
+            }
+            ASSERT_EQ(maxlen, encode(&buf[0], offset, maxlen, &values[0], elements));
+            EXPECT_TRUE(std::equal(expected.begin(), expected.end(), buf.begin() + offset));
+            EXPECT_EQ(0xaa, buf[offset + expected.size()]);
+
+            std::vector<T> decoded(elements + 1);
+            ASSERT_EQ(maxlen, decode(&buf[0], offset, maxlen, &decoded[0], elements));
+            EXPECT_EQ(0, memcmp(&values[0], &decoded[0], elements * sizeof(T)));
+        }
+    }
+}
+
+TEST(LCM_C, CoretypesInt16Array)
+{
+    CheckArrays<int16_t>(__int16_t_encode_array, __int16_t_decode_array);
+}
+
+TEST(LCM_C, CoretypesInt32Array)
+{
+    CheckArrays<int32_t>(__int32_t_encode_array, __int32_t_decode_array);
+}
+
+TEST(LCM_C, CoretypesInt64Array)
+{
+    CheckArrays<int64_t>(__int64_t_encode_array, __int64_t_decode_array);
+}
+
+TEST(LCM_C, CoretypesFloatArray)
+{
+    CheckArrays<float>(__float_encode_array, __float_decode_array);
+}
+
+TEST(LCM_C, CoretypesDoubleArray)
+{
+    CheckArrays<double>(__double_encode_array, __double_decode_array);
+}
@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "common.h"
+
+// Encodes a filled message, and checks that it decodes from an arena of the
+// size that the pre-pass computes, and not from one that is an allocation
+// smaller.
+#define CHECK_DECODE_ARENA(type, n)                                                    \
+    do {                                                                               \
+        type msg;                                                                      \
+        fill_##type(n, &msg);                                                          \
+        int len = type##_encoded_size(&msg);                                           \
+        std::vector<char> buf(len);                                                    \
+        ASSERT_EQ(len, type##_encode(&buf[0], 0, len, &msg));                          \
+        clear_##type(&msg);                                                            \
+                                                                                       \
+        size_t size = 0;                                                               \
+        ASSERT_EQ(len, type##_decode_arena_size(&buf[0], 0, len, &size));              \
+        EXPECT_GT(0, type##_decode_arena_size(&buf[0], 0, len - 1, &size));            \
+        ASSERT_EQ(len, type##_decode_arena_size(&buf[0], 0, len, &size));              \
+                                                                                       \
+        void *block = malloc(size);                                                    \
+        lcm_arena_t arena;                                                             \
+        lcm_arena_init(&arena, block, size);                                           \
+        type decoded;                                                                  \
+        ASSERT_EQ(len, type##_decode_arena(&buf[0], 0, len, &decoded, &arena));        \
+        EXPECT_EQ(size, arena.used);                                                   \
+        EXPECT_TRUE(check_##type(&decoded, n));                                        \
+                                                                                       \
+        if (size > 0) {                                                                \
+            lcm_arena_init(&arena, block, size - 8);                                   \
+            EXPECT_GT(0, type##_decode_arena(&buf[0], 0, len, &decoded, &arena));      \
+        }                                                                              \
+        lcm_arena_init(&arena, block, size);                                           \
+        EXPECT_GT(0, type##_decode_arena(&buf[0], 0, len - 1, &decoded, &arena));      \
+        lcm_arena_reset(&arena);                                                       \
+        ASSERT_EQ(len, type##_decode_arena(&buf[0], 0, len, &decoded, &arena));        \
+        EXPECT_TRUE(check_##type(&decoded, n));                                        \
+        free(block);                                                                   \
+    } while (0)
+
+TEST(LCM_C, DecodeArenaPrimitives)
+{
+    for (int n = 0; n < 4; n++) {
+        CHECK_DECODE_ARENA(lcmtest_primitives_t, n);
+        CHECK_DECODE_ARENA(lcmtest_primitives_list_t, n);
+    }
+}
+
+TEST(LCM_C, DecodeArenaNested)
+{
+    for (int n = 0; n < 4; n++) {
+        CHECK_DECODE_ARENA(lcmtest_multidim_array_t, n);
+        CHECK_DECODE_ARENA(lcmtest_node_t, n);
+        CHECK_DECODE_ARENA(lcmtest2_cross_package_t, n);
+    }
+}
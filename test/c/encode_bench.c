@@ -0,0 +1,265 @@
+// Times encoding and decoding of the lcmtest types with the generated C code.
+//
+// usage: test-c-encode_bench [--min-time SECONDS] [TYPE_FILTER]
+//
+// Each operation is repeated until it has run for at least --min-time
+// seconds (0.2 by default), and one line is printed per type, size and
+// operation. See test/README for the cases and the output format, which the
+// other languages' benchmarks share.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "common.h"
+#include "lcmtest_byte_array_t.h"
+
+static double now_sec(void)
+{
+#ifdef WIN32
+    LARGE_INTEGER count, freq;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (double) count.QuadPart / (double) freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+// byte_array_t isn't used by the client/server tests, so it has no helpers in
+// common.c.
+static void fill_lcmtest_byte_array_t(int num, lcmtest_byte_array_t *msg)
+{
+    msg->num_bytes = num;
+    msg->data = (uint8_t *) malloc(num ? num : 1);
+    for (int i = 0; i < num; i++)
+        msg->data[i] = (uint8_t) i;
+}
+
+static void clear_lcmtest_byte_array_t(lcmtest_byte_array_t *msg)
+{
+    free(msg->data);
+}
+
+static int check_lcmtest_byte_array_t(const lcmtest_byte_array_t *msg, int expected)
+{
+    if (msg->num_bytes != expected)
+        return 0;
+    for (int i = 0; i < expected; i++) {
+        if (msg->data[i] != (uint8_t) i)
+            return 0;
+    }
+    return 1;
+}
+
+typedef struct {
+    const char *name;
+    int sizes[3];
+    void *(*make)(int n);
+    void (*release)(void *msg);
+    int (*encoded_size)(const void *msg);
+    int (*encode)(void *buf, int maxlen, const void *msg);
+    // decodes and releases the message
+    int (*decode)(const void *buf, int len);
+    int (*decode_arena)(const void *buf, int len, lcm_arena_t *arena);
+    int (*arena_size)(const void *buf, int len, size_t *size);
+    // returns whether buf decodes to the message made for n
+    int (*check)(const void *buf, int len, int n);
+} bench_type_t;
+
+#define MAKE_BENCH_TYPE(type, lcm_name, s0, s1, s2)                        \
+    static void *type##_bench_make(int n)                                  \
+    {                                                                      \
+        type *msg = (type *) calloc(1, sizeof(type));                      \
+        fill_##type(n, msg);                                               \
+        return msg;                                                        \
+    }                                                                      \
+    static void type##_bench_free(void *msg)                               \
+    {                                                                      \
+        clear_##type((type *) msg);                                        \
+        free(msg);                                                         \
+    }                                                                      \
+    static int type##_bench_size(const void *msg)                          \
+    {                                                                      \
+        return type##_encoded_size((const type *) msg);                    \
+    }                                                                      \
+    static int type##_bench_encode(void *buf, int maxlen, const void *msg) \
+    {                                                                      \
+        return type##_encode(buf, 0, maxlen, (const type *) msg);          \
+    }                                                                      \
+    static int type##_bench_decode(const void *buf, int len)               \
+    {                                                                      \
+        type out;                                                          \
+        int status = type##_decode(buf, 0, len, &out);                     \
+        if (status >= 0)                                                   \
+            type##_decode_cleanup(&out);                                   \
+        return status;                                                     \
+    }                                                                      \
+    static int type##_bench_decode_arena(const void *buf, int len,         \
+                                         lcm_arena_t *arena)               \
+    {                                                                      \
+        type out;                                                          \
+        return type##_decode_arena(buf, 0, len, &out, arena);              \
+    }                                                                      \
+    static int type##_bench_arena_size(const void *buf, int len,           \
+                                       size_t *size)                       \
+    {                                                                      \
+        return type##_decode_arena_size(buf, 0, len, size);                \
+    }                                                                      \
+    static int type##_bench_check(const void *buf, int len, int n)         \
+    {                                                                      \
+        type out;                                                          \
+        if (type##_decode(buf, 0, len, &out) < 0)                          \
+            return 0;                                                      \
+        int ok = check_##type(&out, n);                                    \
+        type##_decode_cleanup(&out);                                       \
+        return ok;                                                         \
+    }                                                                      \
+    static const bench_type_t type##_bench = {                             \
+        lcm_name,                                                          \
+        {s0, s1, s2},                                                      \
+        type##_bench_make,                                                 \
+        type##_bench_free,                                                 \
+        type##_bench_size,                                                 \
+        type##_bench_encode,                                               \
+        type##_bench_decode,                                               \
+        type##_bench_decode_arena,                                         \
+        type##_bench_arena_size,                                           \
+        type##_bench_check,                                                \
+    }
+
+MAKE_BENCH_TYPE(lcmtest_byte_array_t, "lcmtest.byte_array_t", 64, 4096, 65536);
+MAKE_BENCH_TYPE(lcmtest_primitives_t, "lcmtest.primitives_t", 10, 100, 1000);
+MAKE_BENCH_TYPE(lcmtest_primitives_list_t, "lcmtest.primitives_list_t", 10, 100, 1000);
+MAKE_BENCH_TYPE(lcmtest_multidim_array_t, "lcmtest.multidim_array_t", 2, 8, 32);
+MAKE_BENCH_TYPE(lcmtest_node_t, "lcmtest.node_t", 3, 5, 7);
+
+static const bench_type_t *bench_types[] = {
+    &lcmtest_byte_array_t_bench,     &lcmtest_primitives_t_bench, &lcmtest_primitives_list_t_bench,
+    &lcmtest_multidim_array_t_bench, &lcmtest_node_t_bench,
+};
+
+enum { OP_ENCODED_SIZE, OP_ENCODE, OP_DECODE, OP_DECODE_ARENA, NUM_OPS };
+
+static const char *op_names[] = {"encoded_size", "encode", "decode", "decode_arena"};
+
+typedef struct {
+    const bench_type_t *type;
+    void *msg;
+    void *buf;
+    int len;
+    lcm_arena_t arena;
+} bench_case_t;
+
+static int run_op(bench_case_t *c, int op)
+{
+    switch (op) {
+    case OP_ENCODED_SIZE:
+        return c->type->encoded_size(c->msg);
+    case OP_ENCODE:
+        return c->type->encode(c->buf, c->len, c->msg);
+    case OP_DECODE:
+        return c->type->decode(c->buf, c->len);
+    default:
+        lcm_arena_reset(&c->arena);
+        return c->type->decode_arena(c->buf, c->len, &c->arena);
+    }
+}
+
+// Runs op in batches of doubling size until min_time has passed, and returns
+// the time per run in nanoseconds.
+static double time_op(bench_case_t *c, int op, double min_time, long *iterations)
+{
+    long total = 0;
+    long batch = 1;
+    double start = now_sec();
+    double elapsed;
+    for (;;) {
+        for (long i = 0; i < batch; i++) {
+            if (run_op(c, op) < 0) {
+                fprintf(stderr, "%s %s failed\n", c->type->name, op_names[op]);
+                exit(1);
+            }
+        }
+        total += batch;
+        elapsed = now_sec() - start;
+        if (elapsed >= min_time)
+            break;
+        batch *= 2;
+    }
+    *iterations = total;
+    return elapsed * 1e9 / total;
+}
+
+static void usage(const char *progname)
+{
+    fprintf(stderr, "usage: %s [--min-time SECONDS] [TYPE_FILTER]\n", progname);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    double min_time = 0.2;
+    const char *filter = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--min-time") && i + 1 < argc) {
+            min_time = strtod(argv[++i], NULL);
+        } else if (argv[i][0] == '-' || filter) {
+            usage(argv[0]);
+        } else {
+            filter = argv[i];
+        }
+    }
+
+    printf("%-26s %8s %-13s %10s %10s %12s %12s\n", "type", "size", "op", "bytes", "iterations",
+           "ns/op", "MB/s");
+
+    int failed = 0;
+    for (size_t t = 0; t < sizeof(bench_types) / sizeof(bench_types[0]); t++) {
+        const bench_type_t *type = bench_types[t];
+        if (filter && !strstr(type->name, filter))
+            continue;
+
+        for (int s = 0; s < 3; s++) {
+            int n = type->sizes[s];
+            bench_case_t c;
+            c.type = type;
+            c.msg = type->make(n);
+            c.len = type->encoded_size(c.msg);
+            c.buf = malloc(c.len);
+            if (type->encode(c.buf, c.len, c.msg) != c.len || !type->check(c.buf, c.len, n)) {
+                fprintf(stderr, "%s %d did not round trip\n", type->name, n);
+                failed = 1;
+                type->release(c.msg);
+                free(c.buf);
+                continue;
+            }
+
+            size_t arena_size = 0;
+            type->arena_size(c.buf, c.len, &arena_size);
+            void *block = malloc(arena_size ? arena_size : 1);
+            lcm_arena_init(&c.arena, block, arena_size);
+
+            for (int op = 0; op < NUM_OPS; op++) {
+                long iterations;
+                double ns = time_op(&c, op, min_time, &iterations);
+                printf("%-26s %8d %-13s %10d %10ld %12.1f %12.1f\n", type->name, n, op_names[op],
+                       c.len, iterations, ns, c.len / ns * 1e9 / (1 << 20));
+            }
+
+            free(block);
+            free(c.buf);
+            type->release(c.msg);
+        }
+    }
+    return failed;
+}
@@ -3,6 +3,11 @@
 #include <lcm/lcm.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
 
 #include "common.h"
 
@@ -133,3 +138,794 @@ TEST(LCM_C, EventLogCorrupt)
     lcm_eventlog_destroy(rlog);
     close(fd);
 }
+
+TEST(LCM_C, EventLogReadInto)
+{
+    // Write events of varying sizes to a log, then read them back into the
+    // same event.
+    char fname[] = "XXXXXX";
+    int fd = g_mkstemp(fname);
+
+    lcm_eventlog_t *wlog = lcm_eventlog_create(fname, "w");
+    ASSERT_NE((void *) NULL, wlog);
+
+    const char *channel = "CHANNEL_TEST";
+    const int sizes[] = {100, 10, 0, 1000, 500};
+    char data[1000];
+    for (int i = 0; i < (int) sizeof(data); i++)
+        data[i] = i * 5;
+
+    lcm_eventlog_event_t event;
+    event.channellen = strlen(channel);
+    event.channel = const_cast<char *>(channel);
+    event.data = data;
+    for (int event_num = 0; event_num < 5; ++event_num) {
+        event.timestamp = event_num;
+        event.datalen = sizes[event_num];
+        EXPECT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    }
+    lcm_eventlog_destroy(wlog);
+
+    lcm_eventlog_t *rlog = lcm_eventlog_create(fname, "r");
+    ASSERT_NE((void *) NULL, rlog);
+
+    lcm_eventlog_event_t revent;
+    memset(&revent, 0, sizeof(revent));
+    size_t capacity = 0;
+    for (int event_num = 0; event_num < 5; ++event_num) {
+        ASSERT_EQ(0, lcm_eventlog_read_next_event_into(rlog, &revent, &capacity));
+        EXPECT_EQ(event_num, revent.timestamp);
+        EXPECT_EQ(0, strcmp(channel, revent.channel));
+        ASSERT_EQ(sizes[event_num], revent.datalen);
+        EXPECT_EQ(0, memcmp(data, revent.data, revent.datalen));
+
+        // the buffer only grows for the fourth event
+        if (event_num < 3)
+            EXPECT_EQ(strlen(channel) + 1 + sizes[0] + 1, capacity);
+        else
+            EXPECT_EQ(strlen(channel) + 1 + sizes[3] + 1, capacity);
+    }
+    EXPECT_EQ(-1, lcm_eventlog_read_next_event_into(rlog, &revent, &capacity));
+
+    free(revent.channel);
+    lcm_eventlog_destroy(rlog);
+    close(fd);
+}
+
+TEST(LCM_C, EventLogWriteEvents)
+{
+    // Write batches of events around single events, then read them back.
+    char fname[] = "XXXXXX";
+    int fd = g_mkstemp(fname);
+
+    lcm_eventlog_t *wlog = lcm_eventlog_create(fname, "w");
+    ASSERT_NE((void *) NULL, wlog);
+
+    const char *channel = "CHANNEL_TEST";
+    char data[1000];
+    for (int i = 0; i < (int) sizeof(data); i++)
+        data[i] = i * 5;
+
+    const int num_events = 1000;
+    std::vector<lcm_eventlog_event_t> events(num_events);
+    std::vector<lcm_eventlog_event_t *> batch;
+    for (int event_num = 0; event_num < num_events; ++event_num) {
+        lcm_eventlog_event_t *event = &events[event_num];
+        event->timestamp = event_num;
+        event->channellen = strlen(channel);
+        event->channel = const_cast<char *>(channel);
+        event->datalen = event_num % 1000;
+        event->data = data;
+    }
+    EXPECT_EQ(0, lcm_eventlog_write_event(wlog, &events[0]));
+    for (int event_num = 1; event_num < 600; ++event_num)
+        batch.push_back(&events[event_num]);
+    EXPECT_EQ(0, lcm_eventlog_write_events(wlog, &batch[0], batch.size()));
+    EXPECT_EQ(0, lcm_eventlog_write_event(wlog, &events[600]));
+    EXPECT_EQ(0, lcm_eventlog_write_events(wlog, NULL, 0));
+    batch.clear();
+    for (int event_num = 601; event_num < num_events; ++event_num)
+        batch.push_back(&events[event_num]);
+    EXPECT_EQ(0, lcm_eventlog_write_events(wlog, &batch[0], batch.size()));
+    lcm_eventlog_destroy(wlog);
+
+    lcm_eventlog_t *rlog = lcm_eventlog_create(fname, "r");
+    ASSERT_NE((void *) NULL, rlog);
+    for (int event_num = 0; event_num < num_events; ++event_num) {
+        EXPECT_EQ(event_num, events[event_num].eventnum);
+        lcm_eventlog_event_t *revent = lcm_eventlog_read_next_event(rlog);
+        ASSERT_NE((void *) NULL, revent);
+        EXPECT_EQ(event_num, revent->eventnum);
+        EXPECT_EQ(event_num, revent->timestamp);
+        ASSERT_EQ(event_num % 1000, revent->datalen);
+        EXPECT_EQ(0, memcmp(data, revent->data, revent->datalen));
+        lcm_eventlog_free_event(revent);
+    }
+    EXPECT_EQ((void *) NULL, lcm_eventlog_read_next_event(rlog));
+    lcm_eventlog_destroy(rlog);
+
+    close(fd);
+}
+
+TEST(LCM_C, EventLogMmapRead)
+{
+    // Write some events to a log, then read them back as views into the
+    // mapped log file.
+    char fname[] = "XXXXXX";
+    int fd = g_mkstemp(fname);
+
+    lcm_eventlog_t *wlog = lcm_eventlog_create(fname, "w");
+    ASSERT_NE((void *) NULL, wlog);
+
+    const char *channels[] = {"A", "CHANNEL_TEST"};
+    char data[300];
+    for (int i = 0; i < (int) sizeof(data); i++)
+        data[i] = i * 7;
+
+    const int num_events = 50;
+    lcm_eventlog_event_t event;
+    for (int event_num = 0; event_num < num_events; ++event_num) {
+        event.timestamp = event_num * 1000;
+        event.channel = const_cast<char *>(channels[event_num % 2]);
+        event.channellen = strlen(event.channel);
+        event.datalen = event_num * 6;
+        event.data = data;
+        EXPECT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    }
+    lcm_eventlog_destroy(wlog);
+
+    lcm_eventlog_mmap_t *log = lcm_eventlog_mmap_open(fname);
+    ASSERT_NE((void *) NULL, log);
+
+    lcm_eventlog_view_t view;
+    memset(&view, 0, sizeof(view));
+    int64_t middle = 0;
+    for (int event_num = 0; event_num < num_events; ++event_num) {
+        ASSERT_EQ(0, lcm_eventlog_next_view(log, &view));
+        const char *channel = channels[event_num % 2];
+        EXPECT_EQ(event_num, view.eventnum);
+        EXPECT_EQ(event_num * 1000, view.timestamp);
+        ASSERT_EQ((int) strlen(channel), view.channellen);
+        EXPECT_EQ(0, memcmp(channel, view.channel, view.channellen));
+        ASSERT_EQ(event_num * 6, view.datalen);
+        EXPECT_EQ(0, memcmp(data, view.data, view.datalen));
+        if (event_num == num_events / 2)
+            middle = view.offset;
+    }
+    EXPECT_EQ(-1, lcm_eventlog_next_view(log, &view));
+
+    // Reading from an offset in the middle of an event finds the next one.
+    memset(&view, 0, sizeof(view));
+    view.offset = middle - 1;
+    ASSERT_EQ(0, lcm_eventlog_next_view(log, &view));
+    EXPECT_EQ(middle, view.offset);
+    EXPECT_EQ(num_events / 2, view.eventnum);
+
+    lcm_eventlog_mmap_close(log);
+    close(fd);
+}
+
+TEST(LCM_C, EventLogMmapCorrupt)
+{
+    // Tests detection of corrupt data when reading views.
+    char fname[] = "XXXXXX";
+    int fd = g_mkstemp(fname);
+
+    lcm_eventlog_t *wlog = lcm_eventlog_create(fname, "w");
+    ASSERT_NE((void *) NULL, wlog);
+
+    const char *channel = "CHANNEL_TEST";
+    const int datalen = 256;
+    char data[datalen];
+    memset(data, 127, datalen);
+
+    lcm_eventlog_event_t event;
+    event.timestamp = 0;
+    event.channellen = strlen(channel);
+    event.channel = const_cast<char *>(channel);
+    event.datalen = datalen;
+    event.data = data;
+
+    // Two valid events, garbage, and a valid event, and then a truncated one
+    EXPECT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    EXPECT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    EXPECT_EQ(datalen, fwrite(data, 1, datalen, wlog->f));
+    EXPECT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    event.datalen = 1000;
+    char truncated[1000];
+    event.data = truncated;
+    EXPECT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    lcm_eventlog_destroy(wlog);
+    ASSERT_EQ(0, truncate(fname, 3 * (28 + 12 + datalen) + datalen + 28 + 12 + 500));
+
+    lcm_eventlog_mmap_t *log = lcm_eventlog_mmap_open(fname);
+    ASSERT_NE((void *) NULL, log);
+
+    lcm_eventlog_view_t view;
+    memset(&view, 0, sizeof(view));
+    EXPECT_EQ(0, lcm_eventlog_next_view(log, &view));
+    EXPECT_EQ(0, view.eventnum);
+
+    // The second event is not valid because it's not followed by EOF or an
+    // event header.
+    lcm_eventlog_view_t next = view;
+    EXPECT_EQ(-1, lcm_eventlog_next_view(log, &next));
+
+    // Scanning from after its header skips the garbage, and finds the next
+    // event, which is followed by a truncated one.
+    next.channel = NULL;
+    next.offset = view.offset + 28 + 12 + datalen + 1;
+    ASSERT_EQ(0, lcm_eventlog_next_view(log, &next));
+    EXPECT_EQ(2, next.eventnum);
+    EXPECT_EQ(-1, lcm_eventlog_next_view(log, &next));
+
+    // Finding an event skips the invalid one, rather than failing.
+    ASSERT_EQ(0, lcm_eventlog_find_view(log, view.offset + 1, &next));
+    EXPECT_EQ(2, next.eventnum);
+    EXPECT_EQ(-1, lcm_eventlog_find_view(log, next.offset + 1, &next));
+
+    lcm_eventlog_mmap_close(log);
+    close(fd);
+}
+
+// Reads the contents of a file.
+static std::string ReadFile(const char *path)
+{
+    std::string contents;
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return contents;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        contents.append(buf, n);
+    fclose(f);
+    return contents;
+}
+
+TEST(LCM_C, EventLogIndex)
+{
+    // Write a log of a few megabytes with an index, then seek in it.
+    char fname[] = "XXXXXX";
+    int fd = g_mkstemp(fname);
+    std::string idx = std::string(fname) + ".idx";
+
+    lcm_eventlog_t *wlog = lcm_eventlog_create(fname, "w");
+    ASSERT_NE((void *) NULL, wlog);
+    ASSERT_EQ(0, lcm_eventlog_write_index(wlog));
+
+    const char *channels[] = {"A", "B", "C"};
+    char data[1000];
+    memset(data, 7, sizeof(data));
+    const int num_events = 3000;
+    lcm_eventlog_event_t event;
+    event.datalen = sizeof(data);
+    event.data = data;
+    for (int event_num = 0; event_num < num_events; ++event_num) {
+        event.timestamp = event_num * 100;
+        event.channel = const_cast<char *>(channels[event_num % 3]);
+        event.channellen = 1;
+        EXPECT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    }
+    lcm_eventlog_destroy(wlog);
+
+    lcm_eventlog_t *rlog = lcm_eventlog_create(fname, "r");
+    ASSERT_NE((void *) NULL, rlog);
+    const int64_t targets[] = {150123, 0, 200000, 100, 299950, 1000000};
+    const int64_t expected[] = {150200, 0, 200000, 100, 299900, 299900};
+    for (int i = 0; i < 6; i++) {
+        ASSERT_EQ(0, lcm_eventlog_seek_to_timestamp(rlog, targets[i]));
+        lcm_eventlog_event_t *revent = lcm_eventlog_read_next_event(rlog);
+        ASSERT_NE((void *) NULL, revent);
+        EXPECT_EQ(expected[i], revent->timestamp);
+        EXPECT_EQ(expected[i] / 100, revent->eventnum);
+        lcm_eventlog_free_event(revent);
+    }
+    lcm_eventlog_destroy(rlog);
+
+    // Rebuilding the index writes the same one.
+    std::string written = ReadFile(idx.c_str());
+    EXPECT_LT(0u, written.size());
+    ASSERT_EQ(0, unlink(idx.c_str()));
+    ASSERT_EQ(0, lcm_eventlog_build_index(fname));
+    EXPECT_EQ(written, ReadFile(idx.c_str()));
+
+    // An index that doesn't match the log file isn't used.
+    wlog = lcm_eventlog_create(fname, "w");
+    ASSERT_NE((void *) NULL, wlog);
+    for (int event_num = 0; event_num < 100; ++event_num) {
+        event.timestamp = event_num * 1000;
+        EXPECT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    }
+    lcm_eventlog_destroy(wlog);
+    rlog = lcm_eventlog_create(fname, "r");
+    ASSERT_EQ(0, lcm_eventlog_seek_to_timestamp(rlog, 50000));
+    lcm_eventlog_event_t *revent = lcm_eventlog_read_next_event(rlog);
+    ASSERT_NE((void *) NULL, revent);
+    EXPECT_EQ(revent->eventnum * 1000, revent->timestamp);
+    lcm_eventlog_free_event(revent);
+    lcm_eventlog_destroy(rlog);
+
+    unlink(idx.c_str());
+    close(fd);
+}
+
+TEST(LCM_C, EventLogRandomAccess)
+{
+    // Write a log of a few megabytes, with channel B getting every tenth
+    // event, and find events by number and by their position on a channel,
+    // with the index and without.
+    char fname[] = "XXXXXX";
+    int fd = g_mkstemp(fname);
+    std::string idx = std::string(fname) + ".idx";
+
+    lcm_eventlog_t *wlog = lcm_eventlog_create(fname, "w");
+    ASSERT_NE((void *) NULL, wlog);
+    ASSERT_EQ(0, lcm_eventlog_write_index(wlog));
+    char data[1000];
+    const int num_events = 4000;
+    lcm_eventlog_event_t event;
+    event.datalen = sizeof(data);
+    event.data = data;
+    event.channellen = 1;
+    for (int event_num = 0; event_num < num_events; ++event_num) {
+        memset(data, event_num & 0xff, sizeof(data));
+        event.timestamp = event_num * 100;
+        event.channel = const_cast<char *>(event_num % 10 ? "A" : "B");
+        EXPECT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    }
+    lcm_eventlog_destroy(wlog);
+
+    for (int indexed = 1; indexed >= 0; indexed--) {
+        if (!indexed)
+            ASSERT_EQ(0, unlink(idx.c_str()));
+        lcm_eventlog_t *rlog = lcm_eventlog_create(fname, "r");
+        ASSERT_NE((void *) NULL, rlog);
+        const int64_t targets[] = {2345, 0, 3999, 17, 1500};
+        for (int i = 0; i < 5; i++) {
+            ASSERT_EQ(0, lcm_eventlog_seek_to_eventnum(rlog, targets[i]));
+            lcm_eventlog_event_t *revent = lcm_eventlog_read_next_event(rlog);
+            ASSERT_NE((void *) NULL, revent);
+            EXPECT_EQ(targets[i], revent->eventnum);
+            EXPECT_EQ(targets[i] * 100, revent->timestamp);
+            EXPECT_EQ((char) (targets[i] & 0xff), ((char *) revent->data)[0]);
+            lcm_eventlog_free_event(revent);
+        }
+        EXPECT_EQ(-1, lcm_eventlog_seek_to_eventnum(rlog, num_events));
+
+        lcm_eventlog_cursor_t *cursor = lcm_eventlog_cursor_create(rlog, "B");
+        ASSERT_NE((void *) NULL, cursor);
+        const int64_t positions[] = {250, 3, 399, 100, 101, 0};
+        for (int i = 0; i < 6; i++) {
+            ASSERT_EQ(0, lcm_eventlog_cursor_seek(cursor, positions[i]));
+            EXPECT_EQ(positions[i], lcm_eventlog_cursor_tell(cursor));
+            lcm_eventlog_event_t *revent = lcm_eventlog_cursor_next(cursor);
+            ASSERT_NE((void *) NULL, revent);
+            EXPECT_STREQ("B", revent->channel);
+            EXPECT_EQ(positions[i] * 10, revent->eventnum);
+            EXPECT_EQ(positions[i] + 1, lcm_eventlog_cursor_tell(cursor));
+            lcm_eventlog_free_event(revent);
+        }
+        // The cursor goes on from where it is, and so does the log.
+        lcm_eventlog_event_t *revent = lcm_eventlog_cursor_next(cursor);
+        ASSERT_NE((void *) NULL, revent);
+        EXPECT_EQ(10, revent->eventnum);
+        lcm_eventlog_free_event(revent);
+        revent = lcm_eventlog_read_next_event(rlog);
+        ASSERT_NE((void *) NULL, revent);
+        EXPECT_EQ(11, revent->eventnum);
+        lcm_eventlog_free_event(revent);
+
+        EXPECT_EQ(-1, lcm_eventlog_cursor_seek(cursor, 400));
+        EXPECT_EQ(2, lcm_eventlog_cursor_tell(cursor));
+        ASSERT_EQ(0, lcm_eventlog_cursor_seek(cursor, 399));
+        revent = lcm_eventlog_cursor_next(cursor);
+        ASSERT_NE((void *) NULL, revent);
+        lcm_eventlog_free_event(revent);
+        EXPECT_EQ((void *) NULL, lcm_eventlog_cursor_next(cursor));
+        lcm_eventlog_cursor_destroy(cursor);
+
+        cursor = lcm_eventlog_cursor_create(rlog, "C");
+        EXPECT_EQ(-1, lcm_eventlog_cursor_seek(cursor, 0));
+        EXPECT_EQ((void *) NULL, lcm_eventlog_cursor_next(cursor));
+        lcm_eventlog_cursor_destroy(cursor);
+        lcm_eventlog_destroy(rlog);
+    }
+    close(fd);
+}
+
+TEST(LCM_C, EventLogRecover)
+{
+    // Write a log of a few megabytes with an index, and then an event on a new
+    // channel that's cut off, as if the logger had crashed while writing it.
+    char fname[] = "XXXXXX";
+    int fd = g_mkstemp(fname);
+    std::string idx = std::string(fname) + ".idx";
+
+    lcm_eventlog_t *wlog = lcm_eventlog_create(fname, "w");
+    ASSERT_NE((void *) NULL, wlog);
+    ASSERT_EQ(0, lcm_eventlog_write_index(wlog));
+    char data[1000];
+    memset(data, 7, sizeof(data));
+    const int num_events = 3000;
+    const int event_size = 28 + 1 + sizeof(data);
+    lcm_eventlog_event_t event;
+    event.datalen = sizeof(data);
+    event.data = data;
+    event.channellen = 1;
+    for (int event_num = 0; event_num <= num_events; ++event_num) {
+        event.timestamp = event_num * 100;
+        event.channel = const_cast<char *>(event_num < num_events ? "A" : "D");
+        EXPECT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    }
+    lcm_eventlog_destroy(wlog);
+    size_t index_size = ReadFile(idx.c_str()).size();
+    ASSERT_EQ(0, truncate(fname, num_events * event_size + 500));
+
+    // Recovering removes the partial event and its channel record.
+    int64_t next_eventnum = -1;
+    EXPECT_EQ(500, lcm_eventlog_recover(fname, &next_eventnum));
+    EXPECT_EQ(num_events, next_eventnum);
+    EXPECT_EQ(index_size - 4 - 8 - 8 - 4 - 1, ReadFile(idx.c_str()).size());
+    EXPECT_EQ(0, lcm_eventlog_recover(fname, &next_eventnum));
+    EXPECT_EQ(num_events, next_eventnum);
+
+    // Without an index, the end is searched for the last event, and a tail of
+    // zeros is removed too.
+    ASSERT_EQ(0, unlink(idx.c_str()));
+    ASSERT_EQ(0, truncate(fname, num_events * event_size + 300));
+    EXPECT_EQ(300, lcm_eventlog_recover(fname, &next_eventnum));
+    EXPECT_EQ(num_events, next_eventnum);
+
+    // Appending then continues the log file, and its event numbers.
+    wlog = lcm_eventlog_create(fname, "a");
+    ASSERT_NE((void *) NULL, wlog);
+    wlog->eventcount = next_eventnum;
+    event.timestamp = num_events * 100;
+    EXPECT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    lcm_eventlog_destroy(wlog);
+    lcm_eventlog_t *rlog = lcm_eventlog_create(fname, "r");
+    ASSERT_NE((void *) NULL, rlog);
+    lcm_eventlog_event_t revent = {0};
+    size_t capacity = 0;
+    int64_t events_read = 0;
+    while (0 == lcm_eventlog_read_next_event_into(rlog, &revent, &capacity)) {
+        EXPECT_EQ(events_read, revent.eventnum);
+        events_read++;
+    }
+    EXPECT_EQ(num_events + 1, events_read);
+    EXPECT_STREQ("D", revent.channel);
+    free(revent.channel);
+    lcm_eventlog_destroy(rlog);
+
+    // A file that doesn't end with an event isn't changed.
+    FILE *f = fopen(fname, "wb");
+    ASSERT_NE((void *) NULL, f);
+    fwrite(data, 1, sizeof(data), f);
+    fclose(f);
+    EXPECT_EQ(-1, lcm_eventlog_recover(fname, NULL));
+    EXPECT_EQ(sizeof(data), ReadFile(fname).size());
+
+    close(fd);
+}
+
+static int WantChannelC(const char *channel, void *user)
+{
+    ++*(int *) user;
+    return 0 == strcmp(channel, "C");
+}
+
+TEST(LCM_C, BlockLog)
+{
+    // Write a block log of a few megabytes.  The first half of the events are
+    // on channels A and B, and the second half on C.
+    char fname[] = "XXXXXX";
+    int fd = g_mkstemp(fname);
+
+    lcm_blocklog_t *wlog = lcm_blocklog_create(fname, "w");
+    ASSERT_NE((void *) NULL, wlog);
+    const char *channels[] = {"A", "B", "C"};
+    char data[1000];
+    const int num_events = 3000;
+    lcm_eventlog_event_t event;
+    event.datalen = sizeof(data);
+    event.data = data;
+    for (int event_num = 0; event_num < num_events; ++event_num) {
+        memset(data, event_num % 256, sizeof(data));
+        event.timestamp = event_num * 100;
+        event.channel = const_cast<char *>(event_num < 1500 ? channels[event_num % 2] : "C");
+        event.channellen = 1;
+        EXPECT_EQ(0, lcm_blocklog_write_event(wlog, &event));
+        EXPECT_EQ(event_num, event.eventnum);
+    }
+    lcm_blocklog_destroy(wlog);
+    EXPECT_EQ(1, lcm_blocklog_detect(fname));
+
+    lcm_blocklog_t *rlog = lcm_blocklog_create(fname, "r");
+    ASSERT_NE((void *) NULL, rlog);
+    for (int event_num = 0; event_num < num_events; ++event_num) {
+        const lcm_eventlog_event_t *revent = lcm_blocklog_read_next_event(rlog);
+        ASSERT_NE((void *) NULL, revent);
+        EXPECT_EQ(event_num, revent->eventnum);
+        EXPECT_EQ(event_num * 100, revent->timestamp);
+        ASSERT_EQ(1, revent->channellen);
+        EXPECT_EQ(event_num < 1500 ? channels[event_num % 2][0] : 'C', revent->channel[0]);
+        ASSERT_EQ((int) sizeof(data), revent->datalen);
+        EXPECT_EQ(event_num % 256, ((uint8_t *) revent->data)[sizeof(data) - 1]);
+    }
+    EXPECT_EQ((void *) NULL, lcm_blocklog_read_next_event(rlog));
+
+    const int64_t targets[] = {150123, 0, 200000, 100, 299900};
+    const int64_t expected[] = {150200, 0, 200000, 100, 299900};
+    for (int i = 0; i < 5; i++) {
+        ASSERT_EQ(0, lcm_blocklog_seek_to_timestamp(rlog, targets[i]));
+        const lcm_eventlog_event_t *revent = lcm_blocklog_read_next_event(rlog);
+        ASSERT_NE((void *) NULL, revent);
+        EXPECT_EQ(expected[i], revent->timestamp);
+        EXPECT_EQ(expected[i] / 100, revent->eventnum);
+    }
+    // Seeking past the last event seeks to the end.
+    ASSERT_EQ(0, lcm_blocklog_seek_to_timestamp(rlog, 1000000));
+    EXPECT_EQ((void *) NULL, lcm_blocklog_read_next_event(rlog));
+
+    // Only the blocks with channel C are read.
+    int filtered = 0;
+    lcm_blocklog_set_channel_filter(rlog, WantChannelC, &filtered);
+    ASSERT_EQ(0, lcm_blocklog_seek_to_timestamp(rlog, 0));
+    int num_read = 0;
+    int num_c = 0;
+    const lcm_eventlog_event_t *revent;
+    while ((revent = lcm_blocklog_read_next_event(rlog))) {
+        num_read++;
+        num_c += revent->channel[0] == 'C';
+    }
+    EXPECT_EQ(1500, num_c);
+    EXPECT_LT(num_read, 2000);
+    EXPECT_LT(0, filtered);
+    lcm_blocklog_destroy(rlog);
+
+    // Without its footer, the complete blocks of the log are still read.
+    struct stat st;
+    ASSERT_EQ(0, fstat(fd, &st));
+    ASSERT_EQ(0, ftruncate(fd, st.st_size / 2));
+    rlog = lcm_blocklog_create(fname, "r");
+    ASSERT_NE((void *) NULL, rlog);
+    num_read = 0;
+    while ((revent = lcm_blocklog_read_next_event(rlog))) {
+        EXPECT_EQ(num_read, revent->eventnum);
+        num_read++;
+    }
+    EXPECT_LT(0, num_read);
+    EXPECT_GT(num_events, num_read);
+    lcm_blocklog_destroy(rlog);
+
+    // A log in the original format isn't a block log.
+    lcm_eventlog_t *log = lcm_eventlog_create(fname, "w");
+    ASSERT_NE((void *) NULL, log);
+    EXPECT_EQ(0, lcm_eventlog_write_event(log, &event));
+    lcm_eventlog_destroy(log);
+    EXPECT_EQ(0, lcm_blocklog_detect(fname));
+    EXPECT_EQ((void *) NULL, lcm_blocklog_create(fname, "r"));
+
+    close(fd);
+    unlink(fname);
+}
+
+TEST(LCM_C, EventLogChannelFilter)
+{
+    // Write a log of a few megabytes with an index, where only a few events
+    // in the middle are on channel C.
+    char fname[] = "XXXXXX";
+    int fd = g_mkstemp(fname);
+    std::string idx = std::string(fname) + ".idx";
+
+    lcm_eventlog_t *wlog = lcm_eventlog_create(fname, "w");
+    ASSERT_NE((void *) NULL, wlog);
+    ASSERT_EQ(0, lcm_eventlog_write_index(wlog));
+    char data[1000];
+    memset(data, 7, sizeof(data));
+    const int num_events = 5000;
+    lcm_eventlog_event_t event;
+    event.datalen = sizeof(data);
+    event.data = data;
+    event.channellen = 1;
+    for (int event_num = 0; event_num < num_events; ++event_num) {
+        event.timestamp = event_num * 100;
+        bool on_c = event_num >= 1500 && event_num < 1510;
+        event.channel = const_cast<char *>(on_c ? "C" : event_num % 2 ? "A" : "B");
+        EXPECT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    }
+    lcm_eventlog_destroy(wlog);
+
+    // Only the events on C are read, with the index or without it, but with
+    // it, most of the other events aren't even looked at.
+    int calls[2] = {0, 0};
+    for (int with_index = 1; with_index >= 0; with_index--) {
+        if (!with_index)
+            ASSERT_EQ(0, unlink(idx.c_str()));
+        lcm_eventlog_t *rlog = lcm_eventlog_create(fname, "r");
+        ASSERT_NE((void *) NULL, rlog);
+        lcm_eventlog_set_channel_filter(rlog, WantChannelC, &calls[with_index]);
+        lcm_eventlog_event_t revent = {0};
+        size_t capacity = 0;
+        for (int event_num = 1500; event_num < 1510; event_num++) {
+            if (event_num % 2) {
+                lcm_eventlog_event_t *le = lcm_eventlog_read_next_event(rlog);
+                ASSERT_NE((void *) NULL, le);
+                EXPECT_EQ(event_num, le->eventnum);
+                EXPECT_STREQ("C", le->channel);
+                EXPECT_EQ(0, memcmp(data, le->data, sizeof(data)));
+                lcm_eventlog_free_event(le);
+            } else {
+                ASSERT_EQ(0, lcm_eventlog_read_next_event_into(rlog, &revent, &capacity));
+                EXPECT_EQ(event_num, revent.eventnum);
+                EXPECT_STREQ("C", revent.channel);
+                EXPECT_EQ(0, memcmp(data, revent.data, sizeof(data)));
+            }
+        }
+        EXPECT_NE(0, lcm_eventlog_read_next_event_into(rlog, &revent, &capacity));
+        free(revent.channel);
+        lcm_eventlog_destroy(rlog);
+    }
+    EXPECT_EQ(num_events, calls[0]);
+    EXPECT_GT(num_events / 2, calls[1]);
+
+    close(fd);
+}
+
+TEST(LCM_C, EventLogMerge)
+{
+    // Number events across two logs, the way that lcm-logger shards a log,
+    // then read them back as one.
+    char fname1[] = "XXXXXX";
+    char fname2[] = "XXXXXX";
+    int fd1 = g_mkstemp(fname1);
+    int fd2 = g_mkstemp(fname2);
+    std::string manifest = std::string(fname1) + ".shards";
+
+    lcm_eventlog_t *logs[2] = {lcm_eventlog_create(fname1, "w"), lcm_eventlog_create(fname2, "w")};
+    ASSERT_NE((void *) NULL, logs[0]);
+    ASSERT_NE((void *) NULL, logs[1]);
+    char data[10] = {0};
+    const int num_events = 100;
+    std::vector<lcm_eventlog_event_t> events(num_events);
+    for (int event_num = 0; event_num < num_events; ++event_num) {
+        lcm_eventlog_event_t *event = &events[event_num];
+        event->eventnum = event_num;
+        // Two events at a time share the timestamp.
+        event->timestamp = event_num / 2 * 10;
+        event->channellen = 1;
+        event->channel = const_cast<char *>(event_num % 3 ? "A" : "B");
+        event->datalen = sizeof(data);
+        event->data = data;
+        lcm_eventlog_event_t *batch[] = {event};
+        EXPECT_EQ(0, lcm_eventlog_write_numbered_events(logs[event_num % 3 ? 0 : 1], batch, 1));
+    }
+    lcm_eventlog_destroy(logs[0]);
+    lcm_eventlog_destroy(logs[1]);
+
+    FILE *f = fopen(manifest.c_str(), "w");
+    ASSERT_NE((void *) NULL, f);
+    fprintf(f, "LCM-SHARDS 1\n%s\n%s\t^B$\n", fname1, fname2);
+    fclose(f);
+    EXPECT_EQ(1, lcm_eventlog_merge_detect(manifest.c_str()));
+    EXPECT_EQ(0, lcm_eventlog_merge_detect(fname1));
+
+    lcm_eventlog_merge_t *merge = lcm_eventlog_merge_open(manifest.c_str());
+    ASSERT_NE((void *) NULL, merge);
+    for (int event_num = 0; event_num < num_events; ++event_num) {
+        const lcm_eventlog_event_t *revent = lcm_eventlog_merge_next(merge);
+        ASSERT_NE((void *) NULL, revent);
+        EXPECT_EQ(event_num, revent->eventnum);
+        EXPECT_EQ(event_num / 2 * 10, revent->timestamp);
+        EXPECT_EQ(event_num % 3 ? 'A' : 'B', revent->channel[0]);
+    }
+    EXPECT_EQ((void *) NULL, lcm_eventlog_merge_next(merge));
+
+    ASSERT_EQ(0, lcm_eventlog_merge_seek_to_timestamp(merge, 250));
+    const lcm_eventlog_event_t *revent = lcm_eventlog_merge_next(merge);
+    ASSERT_NE((void *) NULL, revent);
+    EXPECT_EQ(50, revent->eventnum);
+    lcm_eventlog_merge_close(merge);
+
+    // A manifest of a log file that doesn't exist can't be opened.
+    f = fopen(manifest.c_str(), "w");
+    fprintf(f, "LCM-SHARDS 1\n%s\nnonexistent-log\n", fname1);
+    fclose(f);
+    EXPECT_EQ((void *) NULL, lcm_eventlog_merge_open(manifest.c_str()));
+
+    unlink(manifest.c_str());
+    close(fd1);
+    close(fd2);
+}
+
+TEST(LCM_C, EventLogMergeFiles)
+{
+    // Write three logs separately, each numbering its own events, one of
+    // them empty.
+    char fnames[3][7] = {"XXXXXX", "XXXXXX", "XXXXXX"};
+    int fds[3];
+    lcm_eventlog_t *logs[3];
+    for (int i = 0; i < 3; i++) {
+        fds[i] = g_mkstemp(fnames[i]);
+        logs[i] = lcm_eventlog_create(fnames[i], "w");
+        ASSERT_NE((void *) NULL, logs[i]);
+    }
+    char data[10] = {0};
+    const int num_events = 100;
+    for (int event_num = 0; event_num < num_events; ++event_num) {
+        lcm_eventlog_event_t event;
+        event.timestamp = event_num * 10;
+        event.channellen = 1;
+        event.channel = const_cast<char *>(event_num % 4 ? "A" : "B");
+        event.datalen = sizeof(data);
+        event.data = data;
+        EXPECT_EQ(0, lcm_eventlog_write_event(logs[event_num % 4 ? 0 : 1], &event));
+    }
+    for (int i = 0; i < 3; i++)
+        lcm_eventlog_destroy(logs[i]);
+
+    // They're read as one log, in order, and numbered in that order.
+    const char *paths[] = {fnames[0], fnames[1], fnames[2]};
+    lcm_eventlog_merge_t *merge = lcm_eventlog_merge_open_files(paths, 3);
+    ASSERT_NE((void *) NULL, merge);
+    for (int event_num = 0; event_num < num_events; ++event_num) {
+        const lcm_eventlog_event_t *revent = lcm_eventlog_merge_next(merge);
+        ASSERT_NE((void *) NULL, revent);
+        EXPECT_EQ(event_num, revent->eventnum);
+        EXPECT_EQ(event_num * 10, revent->timestamp);
+        EXPECT_EQ(event_num % 4 ? 'A' : 'B', revent->channel[0]);
+    }
+    EXPECT_EQ((void *) NULL, lcm_eventlog_merge_next(merge));
+
+    // After a seek, the events are numbered by the events before them.
+    ASSERT_EQ(0, lcm_eventlog_merge_seek_to_timestamp(merge, 505));
+    const lcm_eventlog_event_t *revent = lcm_eventlog_merge_next(merge);
+    ASSERT_NE((void *) NULL, revent);
+    EXPECT_EQ(510, revent->timestamp);
+    EXPECT_EQ(51, revent->eventnum);
+    lcm_eventlog_merge_close(merge);
+
+    const char *missing[] = {fnames[0], "nonexistent-log"};
+    EXPECT_EQ((void *) NULL, lcm_eventlog_merge_open_files(missing, 2));
+
+    for (int i = 0; i < 3; i++)
+        close(fds[i]);
+}
+
+TEST(LCM_C, FileProviderWriteQueue)
+{
+    // Publish to a log through a write queue that is much smaller than the
+    // events, so that publishing has to wait for the writes.
+    char fname[] = "XXXXXX";
+    int fd = g_mkstemp(fname);
+    std::string url = std::string("file://") + fname + "?mode=w&write_queue_mb=0.01";
+    lcm_t *lcm = lcm_create(url.c_str());
+    ASSERT_NE((void *) NULL, lcm);
+    const int num_events = 1000;
+    char data[100];
+    for (int event_num = 0; event_num < num_events; ++event_num) {
+        memset(data, event_num & 0xff, sizeof(data));
+        EXPECT_EQ(0, lcm_publish(lcm, event_num % 2 ? "A" : "B", data, sizeof(data)));
+    }
+    // The events still queued are written before lcm_destroy() returns.
+    lcm_destroy(lcm);
+
+    lcm_eventlog_t *rlog = lcm_eventlog_create(fname, "r");
+    ASSERT_NE((void *) NULL, rlog);
+    int64_t last_timestamp = 0;
+    for (int event_num = 0; event_num < num_events; ++event_num) {
+        lcm_eventlog_event_t *event = lcm_eventlog_read_next_event(rlog);
+        ASSERT_NE((void *) NULL, event);
+        EXPECT_EQ(event_num, event->eventnum);
+        EXPECT_LE(last_timestamp, event->timestamp);
+        last_timestamp = event->timestamp;
+        EXPECT_STREQ(event_num % 2 ? "A" : "B", event->channel);
+        ASSERT_EQ((int) sizeof(data), event->datalen);
+        EXPECT_EQ((char) (event_num & 0xff), ((char *) event->data)[sizeof(data) - 1]);
+        lcm_eventlog_free_event(event);
+    }
+    EXPECT_EQ((void *) NULL, lcm_eventlog_read_next_event(rlog));
+    lcm_eventlog_destroy(rlog);
+    close(fd);
+}
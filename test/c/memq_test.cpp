@@ -1,7 +1,18 @@
 #include <gtest/gtest.h>
 #include <lcm/lcm.h>
+#ifndef _WIN32
+#include <poll.h>
+#endif
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "common.h"
 
 TEST(LCM_C, MemqConstructDestroy)
 {
@@ -47,6 +58,294 @@ TEST(LCM_C, MemqSimple)
     lcm_destroy(lcm);
 }
 
+TEST(LCM_C, MemqPublishReserve)
+{
+    // A message encoded into a reserved buffer is published from it.
+    lcm_t *lcm = lcm_create("memq://");
+    std::vector<uint8_t> received_buf;
+    lcm_subscribe(lcm, "channel", MemqSimpleHandler, &received_buf);
+
+    uint8_t *buf = (uint8_t *) lcm_publish_reserve(lcm, "channel", 100);
+    ASSERT_TRUE(buf != NULL);
+    for (int i = 0; i < 60; i++)
+        buf[i] = i;
+    EXPECT_EQ(0, lcm_publish_commit(lcm, buf, 60));
+    EXPECT_EQ(0, lcm_handle(lcm));
+    ASSERT_EQ(60u, received_buf.size());
+    for (int i = 0; i < 60; i++)
+        EXPECT_EQ(i, received_buf[i]);
+
+    // a canceled message isn't published, and more than reserved can't be
+    buf = (uint8_t *) lcm_publish_reserve(lcm, "channel", 10);
+    ASSERT_TRUE(buf != NULL);
+    lcm_publish_cancel(lcm, buf);
+    buf = (uint8_t *) lcm_publish_reserve(lcm, "channel", 10);
+    ASSERT_TRUE(buf != NULL);
+    EXPECT_EQ(-1, lcm_publish_commit(lcm, buf, 11));
+    EXPECT_EQ(0, lcm_handle_timeout(lcm, 0));
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, MemqPublishv)
+{
+    // The pieces of a message are published as one message.
+    lcm_t *lcm = lcm_create("memq://");
+    std::vector<uint8_t> received_buf;
+    lcm_subscribe(lcm, "channel", MemqSimpleHandler, &received_buf);
+
+    std::vector<uint8_t> buf(100);
+    for (int i = 0; i < 100; i++)
+        buf[i] = i;
+    lcm_iovec_t iov[3] = {{&buf[0], 10}, {&buf[10], 0}, {&buf[10], 90}};
+    EXPECT_EQ(0, lcm_publishv(lcm, "channel", iov, 3));
+    EXPECT_EQ(0, lcm_handle(lcm));
+    EXPECT_EQ(buf, received_buf);
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, MemqPublishBatch)
+{
+    // A batch larger than the ring goes partly to the overflow queue, and the
+    // messages are still handled in order.
+    lcm_t *lcm = lcm_create("memq://");
+    std::vector<uint8_t> received_buf;
+    lcm_subscribe(lcm, "channel", MemqSimpleHandler, &received_buf);
+
+    const int num_msgs = 3000;
+    std::vector<uint8_t> bufs(num_msgs);
+    std::vector<lcm_publish_msg_t> msgs(num_msgs);
+    for (int i = 0; i < num_msgs; i++) {
+        bufs[i] = i % 255;
+        msgs[i].channel = i % 2 ? "unsubscribed" : "channel";
+        msgs[i].data = &bufs[i];
+        msgs[i].datalen = 1;
+    }
+    EXPECT_EQ(0, lcm_publish_batch(lcm, &msgs[0], num_msgs));
+    for (int i = 0; i < num_msgs; i += 2) {
+        EXPECT_EQ(0, lcm_handle(lcm));
+        ASSERT_EQ(1, received_buf.size());
+        EXPECT_EQ(bufs[i], received_buf[0]);
+    }
+
+    lcm_destroy(lcm);
+}
+
+static void MemqCountRelease(void *data, void *user_data)
+{
+    free(data);
+    (*(int *) user_data)++;
+}
+
+TEST(LCM_C, MemqPublishAsyncBuffer)
+{
+    // A buffer that is handed over is dispatched without a copy, and released
+    // once it has been dispatched, or right away when nobody subscribed.
+    lcm_t *lcm = lcm_create("memq://");
+    int num_released = 0;
+    uint8_t *buf = (uint8_t *) malloc(4);
+    EXPECT_EQ(0, lcm_publish_async_buffer(lcm, "channel", buf, 4, MemqCountRelease,
+                                          &num_released));
+    EXPECT_EQ(1, num_released);
+
+    std::vector<uint8_t> received_buf;
+    lcm_subscribe(lcm, "channel", MemqSimpleHandler, &received_buf);
+    buf = (uint8_t *) malloc(4);
+    memcpy(buf, "abcd", 4);
+    EXPECT_EQ(0, lcm_publish_async_buffer(lcm, "channel", buf, 4, MemqCountRelease,
+                                          &num_released));
+    EXPECT_EQ(1, num_released);
+    EXPECT_EQ(0, lcm_handle(lcm));
+    EXPECT_EQ(2, num_released);
+    const uint8_t expected[] = { 'a', 'b', 'c', 'd' };
+    EXPECT_EQ(std::vector<uint8_t>(expected, expected + 4), received_buf);
+
+    // messages that are never dispatched are released by lcm_destroy()
+    buf = (uint8_t *) malloc(4);
+    lcm_publish_async_buffer(lcm, "channel", buf, 4, MemqCountRelease, &num_released);
+    lcm_destroy(lcm);
+    EXPECT_EQ(3, num_released);
+}
+
+void MemqValueHandler(const lcm_recv_buf_t *rbuf, const char *, void *user_data)
+{
+    std::vector<int> *values = (std::vector<int> *) user_data;
+    int value;
+    memcpy(&value, rbuf->data, sizeof(value));
+    values->push_back(value);
+}
+
+void MemqByteHandler(const lcm_recv_buf_t *rbuf, const char *, void *user_data)
+{
+    // every byte of the message is its value, or else -1 is recorded
+    std::vector<int> *values = (std::vector<int> *) user_data;
+    const uint8_t *data = (const uint8_t *) rbuf->data;
+    int value = rbuf->data_size ? data[0] : -1;
+    for (unsigned int i = 0; i < rbuf->data_size; i++) {
+        if (data[i] != value)
+            value = -1;
+    }
+    values->push_back(value);
+}
+
+TEST(LCM_C, MemqOverflow)
+{
+    // Many more messages than fit in the ring, some of them large, stay in
+    // order, and so do the messages published while they're dispatched.
+    lcm_t *lcm = lcm_create("memq://");
+    std::vector<int> values;
+    lcm_subscribe(lcm, "channel", MemqByteHandler, &values);
+
+    const int num_messages = 5000;
+    std::vector<uint8_t> buf;
+    for (int i = 0; i < num_messages; i++) {
+        int value = i % 251;
+        buf.assign(i % 100 == 0 ? 100000 : 4 + i % 7, (uint8_t) value);
+        ASSERT_EQ(0, lcm_publish(lcm, "channel", &buf[0], buf.size()));
+        if (i % 1000 == 999) {
+            EXPECT_EQ(10, lcm_handle_batch(lcm, 10, 0));
+        }
+    }
+    while (lcm_try_handle(lcm, 100) > 0) {
+    }
+
+    ASSERT_EQ((size_t) num_messages, values.size());
+    for (int i = 0; i < num_messages; i++)
+        ASSERT_EQ(i % 251, values[i]);
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, MemqManyPublishers)
+{
+    // Messages published by several threads at once all arrive, in the order
+    // that each thread published them.
+    lcm_t *lcm = lcm_create("memq://");
+    std::vector<int> values;
+    lcm_subscribe(lcm, "channel", MemqValueHandler, &values);
+
+    const int num_threads = 4;
+    const int num_messages = 20000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+        threads.push_back(std::thread([lcm, t]() {
+            for (int i = 0; i < num_messages; i++) {
+                int value = t * num_messages + i;
+                lcm_publish(lcm, "channel", &value, sizeof(value));
+            }
+        }));
+    }
+    while (values.size() < (size_t) num_threads * num_messages) {
+        if (lcm_handle_timeout(lcm, 10000) <= 0)
+            break;
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+
+    ASSERT_EQ((size_t) num_threads * num_messages, values.size());
+    std::vector<int> next(num_threads);
+    for (int value : values) {
+        int t = value / num_messages;
+        ASSERT_EQ(t * num_messages + next[t], value);
+        next[t]++;
+    }
+    lcm_destroy(lcm);
+}
+
+struct MemqInlineState {
+    lcm_t *lcm;
+    std::vector<int> values;
+};
+
+void MemqInlineHandler(const lcm_recv_buf_t *rbuf, const char *, void *user_data)
+{
+    MemqInlineState *state = (MemqInlineState *) user_data;
+    int value;
+    memcpy(&value, rbuf->data, sizeof(value));
+    state->values.push_back(value);
+    // the messages published here are dispatched after this one
+    if (value < 10) {
+        for (int i = 1; i <= 2; i++) {
+            int next = value * 10 + i;
+            lcm_publish(state->lcm, "channel", &next, sizeof(next));
+        }
+    }
+}
+
+TEST(LCM_C, MemqInlineDispatch)
+{
+    // With dispatch=inline, lcm_publish() dispatches the message, and those
+    // that its handlers publish, before it returns.
+    lcm_t *lcm = lcm_create("memq://?dispatch=inline");
+    ASSERT_TRUE(lcm != NULL);
+    MemqInlineState state;
+    state.lcm = lcm;
+    lcm_subscribe(lcm, "channel", MemqInlineHandler, &state);
+
+    int value = 1;
+    EXPECT_EQ(0, lcm_publish(lcm, "channel", &value, sizeof(value)));
+    const int expected[] = { 1, 11, 12 };
+    EXPECT_EQ(std::vector<int>(expected, expected + 3), state.values);
+    EXPECT_EQ(0, lcm_handle_timeout(lcm, 0));
+
+    int num_released = 0;
+    int *buf = (int *) malloc(sizeof(int));
+    *buf = 20;
+    EXPECT_EQ(0, lcm_publish_async_buffer(lcm, "channel", buf, sizeof(int), MemqCountRelease,
+                                          &num_released));
+    EXPECT_EQ(1, num_released);
+    EXPECT_EQ(4u, state.values.size());
+
+    lcm_destroy(lcm);
+}
+
+struct MemqPersistentState {
+    int expected;
+    const lcmtest_multidim_array_t *msg;
+};
+
+void MemqPersistentHandler(const lcm_recv_buf_t *, const char *,
+                           const lcmtest_multidim_array_t *msg, void *user_data)
+{
+    MemqPersistentState *state = (MemqPersistentState *) user_data;
+    EXPECT_TRUE(check_lcmtest_multidim_array_t(msg, state->expected));
+    state->msg = msg;
+}
+
+TEST(LCM_C, MemqPersistentSubscription)
+{
+    // Every message is decoded into the same storage, made larger only for a
+    // larger message than any before.
+    lcm_t *lcm = lcm_create("memq://");
+    MemqPersistentState state;
+    lcmtest_multidim_array_t_subscription_t *subs =
+        lcmtest_multidim_array_t_subscribe_persistent(lcm, "channel", MemqPersistentHandler,
+                                                      &state);
+    ASSERT_TRUE(subs != NULL);
+
+    const int sizes[] = { 1, 3, 2, 0, 3, 1 };
+    const lcmtest_multidim_array_t *largest = NULL;
+    for (int i = 0; i < 6; i++) {
+        lcmtest_multidim_array_t msg;
+        fill_lcmtest_multidim_array_t(sizes[i], &msg);
+        EXPECT_EQ(0, lcmtest_multidim_array_t_publish(lcm, "channel", &msg));
+        clear_lcmtest_multidim_array_t(&msg);
+
+        state.expected = sizes[i];
+        state.msg = NULL;
+        EXPECT_EQ(0, lcm_handle(lcm));
+        ASSERT_TRUE(state.msg != NULL);
+        if (i == 1) {
+            largest = state.msg;
+        } else if (i > 1) {
+            EXPECT_EQ(largest, state.msg);
+        }
+    }
+
+    EXPECT_EQ(0, lcmtest_multidim_array_t_unsubscribe(lcm, subs));
+    lcm_destroy(lcm);
+}
+
 void MemqBufferedHandler(const lcm_recv_buf_t *rbuf, const char *, void *user_data)
 {
     std::vector<std::vector<uint8_t> > *received_buffers =
@@ -116,3 +415,520 @@ TEST(LCM_C, MemqTimeout)
 
     lcm_destroy(lcm);
 }
+
+void MemqCountHandler(const lcm_recv_buf_t *, const char *, void *user_data)
+{
+    int *num_handled = (int *) user_data;
+    (*num_handled)++;
+}
+
+TEST(LCM_C, MemqHandleBatch)
+{
+    // Test lcm_handle_batch() using the memq provider
+    lcm_t *lcm = lcm_create("memq://");
+
+    // No messages available.  Call should timeout immediately.
+    EXPECT_EQ(0, lcm_handle_batch(lcm, 10, 0));
+
+    // Batch size must be positive.
+    EXPECT_GT(0, lcm_handle_batch(lcm, 0, 0));
+
+    int num_handled = 0;
+    lcm_subscribe(lcm, "channel", MemqCountHandler, &num_handled);
+    for (int i = 0; i < 25; i++) {
+        lcm_publish(lcm, "channel", "", 0);
+    }
+
+    // Messages are dispatched up to the batch size, and without waiting once
+    // the queue has been drained.
+    EXPECT_EQ(10, lcm_handle_batch(lcm, 10, 10000));
+    EXPECT_EQ(10, num_handled);
+    EXPECT_EQ(10, lcm_handle_batch(lcm, 10, -1));
+    EXPECT_EQ(5, lcm_handle_batch(lcm, 10, 10000));
+    EXPECT_EQ(25, num_handled);
+    EXPECT_EQ(0, lcm_handle_batch(lcm, 10, 10));
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, MemqMaxRate)
+{
+    // A subscription with a maximum rate skips the messages in between,
+    // without counting them as dropped, and other subscriptions get them.
+    lcm_t *lcm = lcm_create("memq://");
+    int num_limited = 0;
+    int num_all = 0;
+    lcm_subscription_t *subs = lcm_subscribe(lcm, "channel", MemqCountHandler, &num_limited);
+    lcm_subscribe(lcm, "channel", MemqCountHandler, &num_all);
+    EXPECT_GT(0, lcm_subscription_set_max_rate(subs, -1));
+    EXPECT_EQ(0, lcm_subscription_set_max_rate(subs, 0.1));
+
+    for (int i = 0; i < 10; i++)
+        lcm_publish(lcm, "channel", "", 0);
+    EXPECT_EQ(10, lcm_handle_batch(lcm, 20, 0));
+    EXPECT_EQ(1, num_limited);
+    EXPECT_EQ(10, num_all);
+    EXPECT_EQ(0u, lcm_subscription_get_drop_count(subs));
+
+    // with no limit, it gets every message again
+    EXPECT_EQ(0, lcm_subscription_set_max_rate(subs, 0));
+    for (int i = 0; i < 5; i++)
+        lcm_publish(lcm, "channel", "", 0);
+    EXPECT_EQ(5, lcm_handle_batch(lcm, 20, 0));
+    EXPECT_EQ(6, num_limited);
+    EXPECT_EQ(15, num_all);
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, MemqPublisher)
+{
+    // A publisher keeps up with the subscriptions to its channel
+    lcm_t *lcm = lcm_create("memq://");
+    lcm_publisher_t *publisher = lcm_publisher_create(lcm, "channel");
+    ASSERT_TRUE(publisher != NULL);
+
+    int num_handled = 0;
+    EXPECT_EQ(0, lcm_publisher_has_subscribers(publisher));
+    EXPECT_EQ(0, lcm_publisher_publish(publisher, "", 0));
+    EXPECT_EQ(0, lcm_try_handle(lcm, 10));
+
+    lcm_subscription_t *subs = lcm_subscribe(lcm, "chan.*", MemqCountHandler, &num_handled);
+    lcm_subscribe(lcm, "other", MemqCountHandler, &num_handled);
+    EXPECT_EQ(1, lcm_publisher_has_subscribers(publisher));
+    for (int i = 0; i < 3; i++)
+        EXPECT_EQ(0, lcm_publisher_publish(publisher, "", 0));
+    EXPECT_EQ(3, lcm_try_handle(lcm, 10));
+    EXPECT_EQ(3, num_handled);
+
+    lcm_unsubscribe(lcm, subs);
+    EXPECT_EQ(0, lcm_publisher_has_subscribers(publisher));
+    EXPECT_EQ(0, lcm_publisher_publish(publisher, "", 0));
+    EXPECT_EQ(0, lcm_try_handle(lcm, 10));
+    EXPECT_EQ(3, num_handled);
+
+    lcm_publisher_destroy(publisher);
+    lcm_destroy(lcm);
+}
+
+void MemqRetainHandler(const lcm_recv_buf_t *rbuf, const char *, void *user_data)
+{
+    std::vector<lcm_recv_buf_t *> *retained = (std::vector<lcm_recv_buf_t *> *) user_data;
+    retained->push_back(lcm_recv_buf_retain(rbuf));
+}
+
+TEST(LCM_C, MemqRetain)
+{
+    // A handler can keep a message.  Buffers that were handed over are lent,
+    // and only released once the handler is done with them, while messages
+    // that were copied into the queue are copied again.
+    lcm_t *lcm = lcm_create("memq://");
+    std::vector<lcm_recv_buf_t *> retained;
+    lcm_subscribe(lcm, "channel", MemqRetainHandler, &retained);
+
+    int num_released = 0;
+    uint8_t *buf = (uint8_t *) malloc(4);
+    memcpy(buf, "abcd", 4);
+    EXPECT_EQ(0, lcm_publish_async_buffer(lcm, "channel", buf, 4, MemqCountRelease,
+                                          &num_released));
+    EXPECT_EQ(0, lcm_publish(lcm, "channel", "efgh", 4));
+    EXPECT_EQ(2, lcm_try_handle(lcm, 10));
+    EXPECT_EQ(0, lcm_publish(lcm, "channel", "ijkl", 4));
+    EXPECT_EQ(1, lcm_try_handle(lcm, 10));
+    ASSERT_EQ(3u, retained.size());
+    EXPECT_EQ(0, num_released);
+
+    EXPECT_EQ(buf, retained[0]->data);
+    const char *expected[] = { "abcd", "efgh", "ijkl" };
+    for (int i = 0; i < 3; i++) {
+        ASSERT_TRUE(retained[i] != NULL);
+        EXPECT_EQ(4u, retained[i]->data_size);
+        EXPECT_EQ(lcm, retained[i]->lcm);
+        EXPECT_EQ(0, memcmp(expected[i], retained[i]->data, 4));
+    }
+
+    lcm_recv_buf_release(retained[0]);
+    EXPECT_EQ(1, num_released);
+    lcm_recv_buf_release(retained[1]);
+    lcm_recv_buf_release(retained[2]);
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, MemqTryHandle)
+{
+    // Test lcm_try_handle(), which dispatches what is ready without waiting
+    lcm_t *lcm = lcm_create("memq://");
+    EXPECT_EQ(0, lcm_try_handle(lcm, 10));
+    EXPECT_GT(0, lcm_try_handle(lcm, 0));
+
+    int num_handled = 0;
+    lcm_subscribe(lcm, "channel", MemqCountHandler, &num_handled);
+    for (int i = 0; i < 15; i++) {
+        lcm_publish(lcm, "channel", "", 0);
+    }
+
+    // Messages left over from one call are still ready for the next.
+    EXPECT_EQ(10, lcm_try_handle(lcm, 10));
+    EXPECT_EQ(5, lcm_try_handle(lcm, 10));
+    EXPECT_EQ(15, num_handled);
+    EXPECT_EQ(0, lcm_try_handle(lcm, 10));
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, MemqChannelPatterns)
+{
+    // Plain channel names, prefixes and suffixes are matched without GRegex,
+    // and must behave the same as the regex would.
+    lcm_t *lcm = lcm_create("memq://");
+
+    const char *patterns[] = { "FOO", "FOO.*", ".*BAR", "A\\.B", "[AB]X", ".*" };
+    const int num_patterns = sizeof(patterns) / sizeof(patterns[0]);
+    int num_handled[num_patterns] = { 0 };
+    for (int i = 0; i < num_patterns; i++) {
+        lcm_subscribe(lcm, patterns[i], MemqCountHandler, &num_handled[i]);
+    }
+
+    const char *channels[] = { "FOO", "FOOBAR", "BAR", "XBAR", "A.B", "AXB", "BX", "foo" };
+    for (const char *channel : channels) {
+        lcm_publish(lcm, channel, "", 0);
+        ASSERT_LT(0, lcm_handle_timeout(lcm, 10000));
+    }
+
+    EXPECT_EQ(1, num_handled[0]);
+    EXPECT_EQ(2, num_handled[1]);
+    EXPECT_EQ(3, num_handled[2]);
+    EXPECT_EQ(1, num_handled[3]);
+    EXPECT_EQ(1, num_handled[4]);
+    EXPECT_EQ(8, num_handled[5]);
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, MemqManyChannels)
+{
+    // The subscriptions matching each channel name are only remembered for a
+    // bounded number of channels, and forgotten channels still get their
+    // messages.
+    lcm_t *lcm = lcm_create("memq://");
+
+    int num_handled = 0;
+    int num_handled_first = 0;
+    lcm_subscribe(lcm, ".*", MemqCountHandler, &num_handled);
+    lcm_subscribe(lcm, "channel0", MemqCountHandler, &num_handled_first);
+
+    const int num_channels = 3000;
+    char channel[32];
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < num_channels; i++) {
+            snprintf(channel, sizeof(channel), "channel%d", i);
+            lcm_publish(lcm, channel, "", 0);
+            ASSERT_LT(0, lcm_handle_timeout(lcm, 10000));
+        }
+    }
+    EXPECT_EQ(2 * num_channels, num_handled);
+    EXPECT_EQ(2, num_handled_first);
+
+    lcm_stats_t stats;
+    ASSERT_EQ(0, lcm_get_stats(lcm, &stats));
+    EXPECT_GT(stats.channels_evicted, 0u);
+
+    lcm_destroy(lcm);
+}
+
+void MemqSleepHandler(const lcm_recv_buf_t *, const char *, void *)
+{
+    struct timespec sleeptime = { 0, 2000000 };
+    nanosleep(&sleeptime, NULL);
+}
+
+void MemqSizeHandler(const lcm_recv_buf_t *rbuf, const char *, void *user_data)
+{
+    *(uint32_t *) user_data = rbuf->data_size;
+}
+
+TEST(LCM_C, MemqHandlerStats)
+{
+    lcm_t *lcm = lcm_create("memq://");
+    lcm_subscription_t *subs = lcm_subscribe(lcm, "channel", MemqSleepHandler, NULL);
+    uint32_t report_size = 0;
+    lcm_subscribe(lcm, LCM_STATS_CHANNEL, MemqSizeHandler, &report_size);
+
+    // Nothing is timed until the statistics are enabled.
+    lcm_publish(lcm, "channel", "", 0);
+    EXPECT_LT(0, lcm_handle_timeout(lcm, 10000));
+    lcm_handler_stats_t stats;
+    ASSERT_EQ(0, lcm_subscription_get_handler_stats(subs, &stats));
+    EXPECT_EQ(0u, stats.num_calls);
+
+    lcm_set_handler_stats(lcm, 1);
+    for (int i = 0; i < 3; i++) {
+        lcm_publish(lcm, "channel", "", 0);
+        EXPECT_LT(0, lcm_handle_timeout(lcm, 10000));
+    }
+    lcm_set_handler_stats(lcm, 0);
+
+    ASSERT_EQ(0, lcm_subscription_get_handler_stats(subs, &stats));
+    EXPECT_EQ(3u, stats.num_calls);
+    EXPECT_GE(stats.total_usec, 6000u);
+    EXPECT_GE(stats.max_usec, 2000u);
+    EXPECT_LE(stats.max_usec, stats.total_usec);
+    EXPECT_LE(stats.max_queue_delay_usec, stats.total_queue_delay_usec);
+    uint64_t num_bucketed = 0;
+    for (int i = 0; i < LCM_HANDLER_STATS_BUCKETS; i++) {
+        num_bucketed += stats.histogram[i];
+        // 2 ms or more falls in the bucket of [2^10, 2^11) microseconds or
+        // a later one
+        if (i < 11) {
+            EXPECT_EQ(0u, stats.histogram[i]);
+        }
+    }
+    EXPECT_EQ(3u, num_bucketed);
+
+    EXPECT_EQ(0, lcm_publish_handler_stats(lcm, NULL));
+    EXPECT_LT(0, lcm_handle_timeout(lcm, 10000));
+    EXPECT_LT(0u, report_size);
+
+    lcm_destroy(lcm);
+}
+
+struct MemqUnsubscribeState {
+    lcm_t *lcm;
+    lcm_subscription_t *first;
+    lcm_subscription_t *second;
+    int num_first;
+    int num_second;
+};
+
+void MemqUnsubscribeFirstHandler(const lcm_recv_buf_t *, const char *, void *user_data)
+{
+    MemqUnsubscribeState *state = (MemqUnsubscribeState *) user_data;
+    state->num_first++;
+    lcm_unsubscribe(state->lcm, state->second);
+    lcm_unsubscribe(state->lcm, state->first);
+}
+
+void MemqUnsubscribeSecondHandler(const lcm_recv_buf_t *, const char *, void *user_data)
+{
+    ((MemqUnsubscribeState *) user_data)->num_second++;
+}
+
+TEST(LCM_C, MemqUnsubscribeInHandler)
+{
+    // A handler can unsubscribe itself and the other subscriptions of the
+    // message being dispatched, whose handlers aren't called anymore then.
+    lcm_t *lcm = lcm_create("memq://");
+    MemqUnsubscribeState state = {};
+    state.lcm = lcm;
+    state.first = lcm_subscribe(lcm, "channel.*", MemqUnsubscribeFirstHandler, &state);
+    state.second = lcm_subscribe(lcm, "channel", MemqUnsubscribeSecondHandler, &state);
+
+    // enough channels for some to be evicted, which the subscriptions matching
+    // them must forget
+    int num_other = 0;
+    lcm_subscribe(lcm, ".*", MemqCountHandler, &num_other);
+    char channel[32];
+    for (int i = 0; i < 3000; i++) {
+        snprintf(channel, sizeof(channel), "other%d", i);
+        lcm_publish(lcm, channel, "", 0);
+        ASSERT_LT(0, lcm_handle_timeout(lcm, 10000));
+    }
+
+    lcm_publish(lcm, "channel", "", 0);
+    lcm_publish(lcm, "channel", "", 0);
+    EXPECT_LT(0, lcm_handle_timeout(lcm, 10000));
+    EXPECT_LT(0, lcm_handle_timeout(lcm, 10000));
+    EXPECT_EQ(1, state.num_first);
+    EXPECT_EQ(0, state.num_second);
+    EXPECT_EQ(3002, num_other);
+
+    lcm_destroy(lcm);
+}
+
+struct MemqExecutorState {
+    std::mutex mutex;
+    std::vector<int> received;
+    std::thread::id thread_id;
+    std::atomic<int> num_running;
+    std::atomic<bool> overlapped;
+};
+
+void MemqExecutorHandler(const lcm_recv_buf_t *rbuf, const char *, void *user_data)
+{
+    MemqExecutorState *state = (MemqExecutorState *) user_data;
+    if (state->num_running++)
+        state->overlapped = true;
+    int value;
+    memcpy(&value, rbuf->data, sizeof(value));
+    struct timespec sleeptime = { 0, 1000000 };
+    nanosleep(&sleeptime, NULL);
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->received.push_back(value);
+        state->thread_id = std::this_thread::get_id();
+    }
+    state->num_running--;
+}
+
+// waits for the handler to receive at least num_messages messages
+static bool MemqExecutorWait(MemqExecutorState *state, size_t num_messages)
+{
+    for (int i = 0; i < 5000; i++) {
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (state->received.size() >= num_messages)
+                return true;
+        }
+        struct timespec sleeptime = { 0, 1000000 };
+        nanosleep(&sleeptime, NULL);
+    }
+    return false;
+}
+
+TEST(LCM_C, MemqExecutor)
+{
+    // Handlers with an executor run on the dispatcher, one message at a time
+    // and in order, and don't hold up lcm_handle() for the other handlers.
+    EXPECT_EQ(NULL, lcm_dispatcher_create(0));
+    lcm_dispatcher_t *dispatcher = lcm_dispatcher_create(2);
+    ASSERT_NE((void *) NULL, dispatcher);
+    lcm_t *lcm = lcm_create("memq://");
+
+    const int num_subscriptions = 3;
+    const int num_messages = 50;
+    MemqExecutorState states[num_subscriptions];
+    for (int i = 0; i < num_subscriptions; i++) {
+        states[i].num_running = 0;
+        states[i].overlapped = false;
+        lcm_subscription_t *subs = lcm_subscribe(lcm, "channel", MemqExecutorHandler, &states[i]);
+        lcm_subscription_set_queue_capacity(subs, 0);
+        EXPECT_EQ(0, lcm_subscription_set_executor(subs, dispatcher));
+    }
+    int num_handled = 0;
+    lcm_subscribe(lcm, "channel", MemqCountHandler, &num_handled);
+
+    for (int i = 0; i < num_messages; i++) {
+        lcm_publish(lcm, "channel", &i, sizeof(i));
+        ASSERT_LT(0, lcm_handle_timeout(lcm, 10000));
+    }
+    EXPECT_EQ(num_messages, num_handled);
+
+    for (int i = 0; i < num_subscriptions; i++) {
+        ASSERT_TRUE(MemqExecutorWait(&states[i], num_messages));
+        ASSERT_EQ((size_t) num_messages, states[i].received.size());
+        for (int j = 0; j < num_messages; j++) {
+            EXPECT_EQ(j, states[i].received[j]);
+        }
+        EXPECT_FALSE(states[i].overlapped);
+        EXPECT_NE(std::this_thread::get_id(), states[i].thread_id);
+    }
+
+    lcm_destroy(lcm);
+    lcm_dispatcher_destroy(dispatcher);
+}
+
+TEST(LCM_C, MemqDispatchContext)
+{
+    // Each context is handled by a thread of its own, which runs the
+    // handlers of the subscriptions bound to it, while lcm_handle() only
+    // hands the messages over.
+    lcm_t *lcm = lcm_create("memq://");
+    const int num_contexts = 2;
+    const int num_messages = 50;
+    lcm_dispatch_context_t *contexts[num_contexts];
+    MemqExecutorState states[num_contexts];
+    for (int i = 0; i < num_contexts; i++) {
+        contexts[i] = lcm_dispatch_context_create();
+        ASSERT_NE((void *) NULL, contexts[i]);
+        EXPECT_EQ(0, lcm_dispatch_context_handle_timeout(contexts[i], 0));
+        states[i].num_running = 0;
+        states[i].overlapped = false;
+        lcm_subscription_t *subs = lcm_subscribe(lcm, "channel", MemqExecutorHandler, &states[i]);
+        lcm_subscription_set_queue_capacity(subs, 0);
+        EXPECT_EQ(0, lcm_subscription_set_dispatch_context(subs, contexts[i]));
+    }
+
+    // the descriptor of a context is readable once messages wait on it
+    int value = -1;
+    lcm_publish(lcm, "channel", &value, sizeof(value));
+    ASSERT_LT(0, lcm_handle_timeout(lcm, 10000));
+    EXPECT_TRUE(states[0].received.empty());
+#ifndef _WIN32
+    struct pollfd pfd = {lcm_dispatch_context_get_fileno(contexts[0]), POLLIN, 0};
+    EXPECT_EQ(1, poll(&pfd, 1, 0));
+    EXPECT_EQ(1, lcm_dispatch_context_handle_timeout(contexts[0], 0));
+    EXPECT_EQ(0, poll(&pfd, 1, 0));
+#else
+    EXPECT_EQ(1, lcm_dispatch_context_handle_timeout(contexts[0], 0));
+#endif
+    ASSERT_EQ(1u, states[0].received.size());
+    EXPECT_EQ(std::this_thread::get_id(), states[0].thread_id);
+    states[0].received.clear();
+    EXPECT_EQ(1, lcm_dispatch_context_handle_timeout(contexts[1], 0));
+    states[1].received.clear();
+
+    std::atomic<bool> done(false);
+    std::thread threads[num_contexts];
+    std::thread::id thread_ids[num_contexts];
+    for (int i = 0; i < num_contexts; i++) {
+        lcm_dispatch_context_t *context = contexts[i];
+        threads[i] = std::thread([context, &done]() {
+            while (!done)
+                lcm_dispatch_context_handle_timeout(context, 10);
+        });
+        thread_ids[i] = threads[i].get_id();
+    }
+    for (int i = 0; i < num_messages; i++) {
+        lcm_publish(lcm, "channel", &i, sizeof(i));
+        ASSERT_LT(0, lcm_handle_timeout(lcm, 10000));
+    }
+    for (int i = 0; i < num_contexts; i++) {
+        ASSERT_TRUE(MemqExecutorWait(&states[i], num_messages));
+        std::lock_guard<std::mutex> lock(states[i].mutex);
+        ASSERT_EQ((size_t) num_messages, states[i].received.size());
+        for (int j = 0; j < num_messages; j++) {
+            EXPECT_EQ(j, states[i].received[j]);
+        }
+        EXPECT_EQ(thread_ids[i], states[i].thread_id);
+    }
+    done = true;
+    for (int i = 0; i < num_contexts; i++)
+        threads[i].join();
+
+    lcm_destroy(lcm);
+    for (int i = 0; i < num_contexts; i++)
+        lcm_dispatch_context_destroy(contexts[i]);
+}
+
+TEST(LCM_C, MemqExecutorUnsubscribe)
+{
+    // Unsubscribing drops the messages that are waiting for the dispatcher,
+    // and waits for the handler that is running.
+    lcm_dispatcher_t *dispatcher = lcm_dispatcher_create(1);
+    lcm_t *lcm = lcm_create("memq://");
+
+    MemqExecutorState state;
+    state.num_running = 0;
+    state.overlapped = false;
+    lcm_subscription_t *subs = lcm_subscribe(lcm, "channel", MemqExecutorHandler, &state);
+    lcm_subscription_set_queue_capacity(subs, 0);
+    lcm_subscription_set_executor(subs, dispatcher);
+
+    const int num_messages = 100;
+    for (int i = 0; i < num_messages; i++) {
+        lcm_publish(lcm, "channel", &i, sizeof(i));
+        ASSERT_LT(0, lcm_handle_timeout(lcm, 10000));
+    }
+    ASSERT_TRUE(MemqExecutorWait(&state, 1));
+    EXPECT_EQ(0, lcm_unsubscribe(lcm, subs));
+    EXPECT_EQ(0, state.num_running);
+
+    size_t num_received = state.received.size();
+    EXPECT_LT(num_received, (size_t) num_messages);
+    struct timespec sleeptime = { 0, 20000000 };
+    nanosleep(&sleeptime, NULL);
+    EXPECT_EQ(num_received, state.received.size());
+
+    lcm_destroy(lcm);
+    lcm_dispatcher_destroy(dispatcher);
+}
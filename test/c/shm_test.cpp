@@ -0,0 +1,166 @@
+#include <gtest/gtest.h>
+#include <lcm/lcm.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+// a group name that no other test process uses, and that is removed again
+// when the test ends
+class ShmGroup {
+  public:
+    explicit ShmGroup(const char *test)
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "test-%s-%d", test, (int) getpid());
+        name_ = name;
+        shm_unlink(("/lcm-" + name_).c_str());
+    }
+    ~ShmGroup() { shm_unlink(("/lcm-" + name_).c_str()); }
+
+    std::string url(const char *options = "") const { return "shm://" + name_ + options; }
+
+  private:
+    std::string name_;
+};
+
+struct ShmState {
+    std::vector<std::vector<uint8_t> > received;
+    std::vector<std::string> channels;
+};
+
+static void shm_handler(const lcm_recv_buf_t *rbuf, const char *channel, void *user_data)
+{
+    ShmState *state = (ShmState *) user_data;
+    const uint8_t *data = (const uint8_t *) rbuf->data;
+    state->received.push_back(std::vector<uint8_t>(data, data + rbuf->data_size));
+    state->channels.push_back(channel);
+}
+
+static std::vector<uint8_t> make_message(int size, int seed)
+{
+    std::vector<uint8_t> buf(size);
+    for (int i = 0; i < size; i++)
+        buf[i] = (uint8_t) (i * 7 + seed);
+    return buf;
+}
+
+TEST(LCM_C, ShmPublishSubscribe)
+{
+    ShmGroup group("pubsub");
+    lcm_t *pub = lcm_create(group.url().c_str());
+    lcm_t *sub = lcm_create(group.url().c_str());
+    ASSERT_TRUE(pub != NULL);
+    ASSERT_TRUE(sub != NULL);
+
+    ShmState state;
+    lcm_subscribe(sub, "shm.*", shm_handler, &state);
+
+    const int sizes[] = { 0, 1, 100, 70000, 3, 1000000 };
+    const int num_msgs = sizeof(sizes) / sizeof(sizes[0]);
+    for (int i = 0; i < num_msgs; i++) {
+        std::vector<uint8_t> buf = make_message(sizes[i], i);
+        EXPECT_EQ(0, lcm_publish(pub, i % 2 ? "shm_odd" : "shm_even", buf.data(), sizes[i]));
+    }
+    EXPECT_EQ(0, lcm_publish(pub, "other", "x", 1));
+
+    while ((int) state.received.size() < num_msgs && lcm_handle_timeout(sub, 1000) > 0) {
+    }
+    ASSERT_EQ(num_msgs, (int) state.received.size());
+    for (int i = 0; i < num_msgs; i++) {
+        EXPECT_EQ(make_message(sizes[i], i), state.received[i]);
+        EXPECT_EQ(i % 2 ? "shm_odd" : "shm_even", state.channels[i]);
+    }
+
+    // the message on "other" is read, but not dispatched
+    while (lcm_handle_timeout(sub, 50) > 0) {
+    }
+    EXPECT_EQ(num_msgs, (int) state.received.size());
+
+    lcm_destroy(sub);
+    lcm_destroy(pub);
+}
+
+TEST(LCM_C, ShmMessageTooLarge)
+{
+    ShmGroup group("large");
+    lcm_t *lcm = lcm_create(group.url("?size=65536").c_str());
+    ASSERT_TRUE(lcm != NULL);
+
+    // messages may use up to a quarter of the ring
+    std::vector<uint8_t> buf(65536 / 4);
+    EXPECT_EQ(-1, lcm_publish(lcm, "large", buf.data(), buf.size()));
+    EXPECT_EQ(0, lcm_publish(lcm, "large", buf.data(), buf.size() - 100));
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, ShmPublishReserve)
+{
+    ShmGroup group("reserve");
+    lcm_t *pub = lcm_create(group.url("?size=65536").c_str());
+    lcm_t *sub = lcm_create(group.url("?size=65536").c_str());
+    ASSERT_TRUE(pub != NULL);
+    ASSERT_TRUE(sub != NULL);
+    ShmState state;
+    lcm_subscribe(sub, "reserve", shm_handler, &state);
+
+    // messages are encoded straight into the ring, around its end too.  Only
+    // the committed size is used of the reservation.
+    EXPECT_TRUE(lcm_publish_reserve(pub, "reserve", 65536 / 4) == NULL);
+    const int num_msgs = 40;
+    for (int i = 0; i < num_msgs; i++) {
+        std::vector<uint8_t> msg = make_message(1000 + i * 100, i);
+        void *buf = lcm_publish_reserve(pub, "reserve", 8000);
+        ASSERT_TRUE(buf != NULL);
+        if (i % 3 == 2) {
+            lcm_publish_cancel(pub, buf);
+            continue;
+        }
+        memcpy(buf, msg.data(), msg.size());
+        EXPECT_EQ(0, lcm_publish_commit(pub, buf, msg.size()));
+        while (lcm_handle_timeout(sub, 1000) > 0 && state.received.empty()) {
+        }
+        ASSERT_EQ(1u, state.received.size());
+        EXPECT_EQ(msg, state.received[0]);
+        state.received.clear();
+    }
+
+    lcm_destroy(sub);
+    lcm_destroy(pub);
+}
+
+TEST(LCM_C, ShmSlowSubscriber)
+{
+    ShmGroup group("slow");
+    lcm_t *lcm = lcm_create(group.url("?size=65536").c_str());
+    ASSERT_TRUE(lcm != NULL);
+
+    ShmState state;
+    lcm_subscription_t *subs = lcm_subscribe(lcm, "slow", shm_handler, &state);
+    lcm_subscription_set_queue_capacity(subs, 0);
+
+    // publish far more than the ring holds before handling any of it.  The
+    // subscriber loses the oldest messages, but never sees a damaged one.
+    const int num_msgs = 1000;
+    for (int i = 0; i < num_msgs; i++) {
+        std::vector<uint8_t> buf = make_message(1000, i);
+        EXPECT_EQ(0, lcm_publish(lcm, "slow", buf.data(), buf.size()));
+    }
+    EXPECT_EQ(0, lcm_publish(lcm, "slow", "end", 3));
+
+    while (state.received.empty() || state.received.back().size() != 3) {
+        ASSERT_GT(lcm_handle_timeout(lcm, 1000), 0);
+    }
+    EXPECT_LT((int) state.received.size(), num_msgs);
+    for (size_t i = 0; i + 1 < state.received.size(); i++) {
+        int seed = state.received[i][0];
+        EXPECT_EQ(make_message(1000, seed), state.received[i]);
+    }
+
+    lcm_destroy(lcm);
+}
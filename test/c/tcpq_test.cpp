@@ -0,0 +1,338 @@
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <lcm/lcm.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define MAGIC_SERVER 0x287617fa
+#define PROTOCOL_VERSION 0x0100
+#define MESSAGE_TYPE_PUBLISH 1
+
+static int64_t elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+static void count_handler(const lcm_recv_buf_t *, const char *, void *user_data)
+{
+    (*(int *) user_data)++;
+}
+
+static void append_word(std::vector<uint8_t> *buf, uint32_t word)
+{
+    word = htonl(word);
+    const uint8_t *p = (const uint8_t *) &word;
+    buf->insert(buf->end(), p, p + 4);
+}
+
+// Returns a socket that listens on a free port of the loopback interface,
+// or -1 on failure.
+static int listen_local(int *port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sa.sin_port = 0;
+    socklen_t sa_len = sizeof(sa);
+    if (0 != bind(fd, (struct sockaddr *) &sa, sizeof(sa)) || 0 != listen(fd, 1) ||
+        0 != getsockname(fd, (struct sockaddr *) &sa, &sa_len)) {
+        close(fd);
+        return -1;
+    }
+    *port = ntohs(sa.sin_port);
+    return fd;
+}
+
+static bool recv_fully(int fd, size_t len)
+{
+    std::vector<char> buf(len);
+    size_t cnt = 0;
+    while (cnt < len) {
+        ssize_t n = recv(fd, &buf[cnt], len - cnt, 0);
+        if (n <= 0)
+            return false;
+        cnt += n;
+    }
+    return true;
+}
+
+// A tcpq server for a single client, which sends the messages it's told to
+// in one send() each, and otherwise holds the connection open without
+// sending anything.
+class FakeTcpqServer {
+  public:
+    FakeTcpqServer() : fd_(-1), port_(0) { listen_fd_ = listen_local(&port_); }
+    ~FakeTcpqServer()
+    {
+        if (fd_ >= 0)
+            close(fd_);
+        close(listen_fd_);
+    }
+
+    std::string url() const { return "tcpq://127.0.0.1:" + std::to_string(port_); }
+
+    // Accepts the client, and greets it.  Returns false on failure.
+    bool accept_client()
+    {
+        fd_ = accept(listen_fd_, NULL, NULL);
+        if (fd_ < 0 || !recv_fully(fd_, 8))
+            return false;
+        std::vector<uint8_t> hello;
+        append_word(&hello, MAGIC_SERVER);
+        append_word(&hello, PROTOCOL_VERSION);
+        return send(fd_, &hello[0], hello.size(), 0) == (ssize_t) hello.size();
+    }
+
+    // Waits for the client to subscribe to channel.
+    bool expect_subscribe(const char *channel) { return recv_fully(fd_, 8 + strlen(channel)); }
+
+    // Sends count messages on channel with a single send().
+    bool send_messages(const char *channel, int count)
+    {
+        std::vector<uint8_t> buf;
+        uint32_t channel_len = strlen(channel);
+        for (int i = 0; i < count; i++) {
+            append_word(&buf, MESSAGE_TYPE_PUBLISH);
+            append_word(&buf, channel_len);
+            buf.insert(buf.end(), channel, channel + channel_len);
+            append_word(&buf, 4);
+            append_word(&buf, i);
+        }
+        return send(fd_, &buf[0], buf.size(), 0) == (ssize_t) buf.size();
+    }
+
+    // Disconnects the client.
+    void disconnect() { shutdown(fd_, SHUT_RDWR); }
+
+  private:
+    int listen_fd_;
+    int fd_;
+    int port_;
+};
+
+static bool wait_readable(lcm_t *lcm, int timeout_millis)
+{
+    struct pollfd pfd;
+    pfd.fd = lcm_get_fileno(lcm);
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, timeout_millis) > 0;
+}
+
+TEST(LCM_C, TcpqHandleBuffered)
+{
+    // Messages that were received along with one that was dispatched are
+    // dispatched later without waiting for the server to send more.
+    FakeTcpqServer server;
+    std::atomic<int> step(0);
+    // the connection stays open without more messages until the test moves
+    // on, so that a call that waits for them blocks until the server gives up
+    // and disconnects
+    auto wait_for_step = [&](int s) {
+        for (int i = 0; i < 5000 && step.load() < s; i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return step.load() >= s;
+    };
+    std::thread server_thread([&]() {
+        if (server.accept_client() && server.expect_subscribe("TCPQ_BUF") &&
+            server.send_messages("TCPQ_BUF", 3) && wait_for_step(1) &&
+            server.send_messages("TCPQ_BUF", 3))
+            wait_for_step(2);
+        server.disconnect();
+    });
+    // the server is released even if the test fails
+    struct Release {
+        std::atomic<int> *step;
+        std::thread *thread;
+        ~Release()
+        {
+            *step = 2;
+            thread->join();
+        }
+    } release = {&step, &server_thread};
+
+    lcm_t *lcm = lcm_create(server.url().c_str());
+    ASSERT_TRUE(lcm != NULL);
+    int count = 0;
+    lcm_subscribe(lcm, "TCPQ_BUF", count_handler, &count);
+
+    ASSERT_TRUE(wait_readable(lcm, 5000));
+    EXPECT_EQ(1, lcm_try_handle(lcm, 1));
+    EXPECT_EQ(1, count);
+
+    // lcm_handle_timeout() dispatches the other two without waiting for a
+    // third
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    EXPECT_EQ(1, lcm_handle_timeout(lcm, 100));
+    EXPECT_LT(elapsed_ms(start), 2000);
+    EXPECT_EQ(3, count);
+
+    // and so does lcm_try_handle() with room for more messages
+    step = 1;
+    ASSERT_TRUE(wait_readable(lcm, 5000));
+    EXPECT_EQ(1, lcm_try_handle(lcm, 1));
+    start = std::chrono::steady_clock::now();
+    EXPECT_EQ(2, lcm_try_handle(lcm, 10));
+    EXPECT_LT(elapsed_ms(start), 2000);
+    EXPECT_EQ(6, count);
+
+    lcm_destroy(lcm);
+}
+
+#ifdef LCM_TCPQ_HUB
+// Runs lcm-tcpq-hub on a free port for as long as it exists.
+class TcpqHub {
+  public:
+    explicit TcpqHub(const char *max_queue) : pid_(-1), port_(0)
+    {
+        // the port is free again once the socket is closed
+        int fd = listen_local(&port_);
+        if (fd < 0)
+            return;
+        close(fd);
+        std::string port = std::to_string(port_);
+        pid_ = fork();
+        if (pid_ == 0) {
+            execl(LCM_TCPQ_HUB, LCM_TCPQ_HUB, "--port", port.c_str(), "--max-queue", max_queue,
+                  (char *) NULL);
+            _exit(127);
+        }
+    }
+    ~TcpqHub()
+    {
+        if (pid_ > 0) {
+            kill(pid_, SIGTERM);
+            waitpid(pid_, NULL, 0);
+        }
+    }
+
+    // Connects a client once the hub listens.  Returns NULL on failure.
+    lcm_t *connect()
+    {
+        std::string url = "tcpq://127.0.0.1:" + std::to_string(port_);
+        for (int i = 0; i < 100 && pid_ > 0; i++) {
+            lcm_t *lcm = lcm_create(url.c_str());
+            if (lcm)
+                return lcm;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        return NULL;
+    }
+
+  private:
+    pid_t pid_;
+    int port_;
+};
+
+static void channel_handler(const lcm_recv_buf_t *, const char *channel, void *user_data)
+{
+    ((std::vector<std::string> *) user_data)->push_back(channel);
+}
+
+// Handles the messages of lcm until there are count channels in received, or
+// for at most 5 seconds.
+static bool handle_until(lcm_t *lcm, const std::vector<std::string> &received, size_t count)
+{
+    for (int i = 0; i < 50 && received.size() < count; i++)
+        lcm_handle_timeout(lcm, 100);
+    return received.size() >= count;
+}
+
+// Subscribes to pattern, and waits until the hub has the subscription, which
+// it has once it relays a message on probe back to the client.
+static bool subscribe_through_hub(lcm_t *lcm, const char *pattern, const char *probe,
+                                  std::vector<std::string> *received)
+{
+    lcm_subscribe(lcm, pattern, channel_handler, received);
+    uint8_t data = 0;
+    lcm_publish(lcm, probe, &data, 1);
+    bool ok = handle_until(lcm, *received, 1);
+    received->clear();
+    return ok;
+}
+
+TEST(LCM_C, TcpqHubFiltering)
+{
+    // Each client is sent only the channels that it subscribed to.
+    TcpqHub hub("16777216");
+    lcm_t *a = hub.connect();
+    lcm_t *b = hub.connect();
+    lcm_t *pub = hub.connect();
+    ASSERT_TRUE(a != NULL);
+    ASSERT_TRUE(b != NULL);
+    ASSERT_TRUE(pub != NULL);
+
+    std::vector<std::string> a_received;
+    std::vector<std::string> b_received;
+    ASSERT_TRUE(subscribe_through_hub(a, "TCPQ_A.*", "TCPQ_A0", &a_received));
+    ASSERT_TRUE(subscribe_through_hub(b, "TCPQ_B", "TCPQ_B", &b_received));
+
+    const char *channels[] = {"TCPQ_B", "TCPQ_A1", "TCPQ_C", "TCPQ_AB", "TCPQ_B"};
+    uint8_t data = 0;
+    for (int i = 0; i < 5; i++)
+        lcm_publish(pub, channels[i], &data, 1);
+
+    // the hub relays the messages in order, so nothing else is received
+    // after the last of each
+    EXPECT_TRUE(handle_until(a, a_received, 2));
+    EXPECT_TRUE(handle_until(b, b_received, 2));
+    std::vector<std::string> a_expected = {"TCPQ_A1", "TCPQ_AB"};
+    std::vector<std::string> b_expected = {"TCPQ_B", "TCPQ_B"};
+    EXPECT_EQ(a_expected, a_received);
+    EXPECT_EQ(b_expected, b_received);
+
+    lcm_destroy(pub);
+    lcm_destroy(b);
+    lcm_destroy(a);
+}
+
+TEST(LCM_C, TcpqHubDropsForSlowClient)
+{
+    // A client that doesn't read its messages loses those that don't fit in
+    // its queue, without holding up the publisher, and is sent the later
+    // ones once it catches up.
+    TcpqHub hub("65536");
+    lcm_t *sub = hub.connect();
+    lcm_t *pub = hub.connect();
+    ASSERT_TRUE(sub != NULL);
+    ASSERT_TRUE(pub != NULL);
+
+    std::vector<std::string> received;
+    ASSERT_TRUE(subscribe_through_hub(sub, "TCPQ_DROP", "TCPQ_DROP", &received));
+
+    // more than the socket buffers between the hub and the client hold
+    const int num_msgs = 1000;
+    std::vector<uint8_t> data(60000);
+    for (int i = 0; i < num_msgs; i++)
+        ASSERT_EQ(0, lcm_publish(pub, "TCPQ_DROP", &data[0], data.size()));
+
+    while (lcm_handle_timeout(sub, 500) > 0) {
+    }
+    EXPECT_GT(received.size(), 0u);
+    EXPECT_LT(received.size(), (size_t) num_msgs);
+
+    size_t count = received.size();
+    ASSERT_EQ(0, lcm_publish(pub, "TCPQ_DROP", &data[0], 1));
+    EXPECT_TRUE(handle_until(sub, received, count + 1));
+
+    lcm_destroy(pub);
+    lcm_destroy(sub);
+}
+#endif
@@ -1,7 +1,18 @@
+#include <stdlib.h>
+#include <string.h>
 #ifndef WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sched.h>
+#include <sys/socket.h>
 #include <time.h>
+#include <unistd.h>
 #endif
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include <gtest/gtest.h>
 #include <lcm/lcm.h>
 
@@ -55,4 +66,1548 @@ TEST(LCM_C, QueueSize)
 
     lcm_destroy(lcm);
 }
+
+static void last_int_handler(const lcm_recv_buf_t *rbuf, const char * /* unused */, void *user)
+{
+    std::vector<int> *received = (std::vector<int> *) user;
+    int value;
+    memcpy(&value, rbuf->data, sizeof(value));
+    received->push_back(value);
+}
+
+TEST(LCM_C, Conflate)
+{
+    lcm_t *lcm = lcm_create(NULL);
+    ASSERT_NE((void *) NULL, lcm);
+
+    std::vector<int> received;
+    lcm_subscription_t *subs = lcm_subscribe(lcm, "conflate", last_int_handler, &received);
+    lcm_subscription_set_queue_capacity(subs, 5);
+    lcm_subscription_set_conflate(subs, 1);
+
+    // more messages than the queue capacity, none of which are dropped on
+    // arrival
+    for (int i = 0; i < 10; i++) {
+        lcm_publish(lcm, "conflate", &i, sizeof(i));
+    }
+
+    struct timespec sleeptime;
+    sleeptime.tv_sec = 0;
+    sleeptime.tv_nsec = 100000000;
+    nanosleep(&sleeptime, NULL);
+    EXPECT_EQ(10, lcm_subscription_get_queue_size(subs));
+
+    // only the newest one reaches the handler
+    while (lcm_handle_timeout(lcm, 100) > 0) {
+    }
+    ASSERT_EQ(1u, received.size());
+    EXPECT_EQ(9, received[0]);
+    EXPECT_EQ(0, lcm_subscription_get_queue_size(subs));
+    EXPECT_EQ(9u, lcm_subscription_get_drop_count(subs));
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, DropOldest)
+{
+    lcm_t *lcm = lcm_create(NULL);
+    ASSERT_NE((void *) NULL, lcm);
+
+    std::vector<int> received;
+    lcm_subscription_t *subs = lcm_subscribe(lcm, "drop_oldest", last_int_handler, &received);
+    lcm_subscription_set_queue_capacity(subs, 3);
+    EXPECT_EQ(-1, lcm_subscription_set_drop_policy(subs, (lcm_drop_policy_t) 7));
+    EXPECT_EQ(0, lcm_subscription_set_drop_policy(subs, LCM_DROP_OLDEST));
+
+    for (int i = 0; i < 10; i++) {
+        lcm_publish(lcm, "drop_oldest", &i, sizeof(i));
+    }
+
+    struct timespec sleeptime;
+    sleeptime.tv_sec = 0;
+    sleeptime.tv_nsec = 100000000;
+    nanosleep(&sleeptime, NULL);
+
+    // the handler gets the newest messages that fit in the queue
+    while (lcm_handle_timeout(lcm, 100) > 0) {
+    }
+    ASSERT_EQ(3u, received.size());
+    EXPECT_EQ(7, received[0]);
+    EXPECT_EQ(8, received[1]);
+    EXPECT_EQ(9, received[2]);
+    EXPECT_EQ(7u, lcm_subscription_get_policy_drop_count(subs, LCM_DROP_OLDEST));
+    EXPECT_EQ(0u, lcm_subscription_get_policy_drop_count(subs, LCM_DROP_NEWEST));
+    EXPECT_EQ(7u, lcm_subscription_get_drop_count(subs));
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, DropPolicyBlock)
+{
+    lcm_t *lcm = lcm_create(NULL);
+    ASSERT_NE((void *) NULL, lcm);
+
+    std::vector<int> received;
+    lcm_subscription_t *subs = lcm_subscribe(lcm, "block", last_int_handler, &received);
+    lcm_subscription_set_queue_capacity(subs, 2);
+    lcm_subscription_set_drop_policy(subs, LCM_BLOCK);
+
+    // the receive thread waits for the handler instead of dropping messages
+    for (int i = 0; i < 5; i++) {
+        lcm_publish(lcm, "block", &i, sizeof(i));
+    }
+    for (int i = 0; i < 5; i++) {
+        ASSERT_GT(lcm_handle_timeout(lcm, 500), 0);
+        EXPECT_LE(lcm_subscription_get_queue_size(subs), 2);
+    }
+    ASSERT_EQ(5u, received.size());
+    for (int i = 0; i < 5; i++) {
+        EXPECT_EQ(i, received[i]);
+    }
+    EXPECT_EQ(0u, lcm_subscription_get_drop_count(subs));
+
+    // without a handler to make room, the messages are dropped after a while
+    for (int i = 0; i < 4; i++) {
+        lcm_publish(lcm, "block", &i, sizeof(i));
+    }
+    struct timespec sleeptime;
+    sleeptime.tv_sec = 0;
+    sleeptime.tv_nsec = 500000000;
+    nanosleep(&sleeptime, NULL);
+    EXPECT_EQ(2u, lcm_subscription_get_policy_drop_count(subs, LCM_BLOCK));
+
+    lcm_destroy(lcm);
+}
+
+static void channel_order_handler(const lcm_recv_buf_t * /* unused */, const char *channel,
+                                  void *user)
+{
+    ((std::vector<std::string> *) user)->push_back(channel);
+}
+
+TEST(LCM_C, ChannelPriority)
+{
+    lcm_t *lcm = lcm_create(NULL);
+    ASSERT_NE((void *) NULL, lcm);
+
+    std::vector<std::string> received;
+    lcm_subscribe(lcm, "MAP", channel_order_handler, &received);
+    lcm_subscribe(lcm, "ESTOP_.*", channel_order_handler, &received);
+    lcm_subscription_t *pose = lcm_subscribe(lcm, "POSE", channel_order_handler, &received);
+    EXPECT_EQ(-1, lcm_set_channel_priority(lcm, "ESTOP_.*", LCM_MAX_PRIORITY + 1));
+    EXPECT_EQ(0, lcm_set_channel_priority(lcm, "ESTOP_.*", LCM_MAX_PRIORITY));
+    EXPECT_EQ(0, lcm_subscription_set_priority(pose, 1));
+
+    // the messages of higher classes overtake the ones that arrived earlier
+    for (int i = 0; i < 5; i++) {
+        lcm_publish(lcm, "MAP", "", 0);
+    }
+    lcm_publish(lcm, "POSE", "", 0);
+    lcm_publish(lcm, "ESTOP_LEFT", "", 0);
+    lcm_publish(lcm, "MAP", "", 0);
+
+    struct timespec sleeptime;
+    sleeptime.tv_sec = 0;
+    sleeptime.tv_nsec = 100000000;
+    nanosleep(&sleeptime, NULL);
+
+    while (lcm_handle_timeout(lcm, 100) > 0) {
+    }
+    ASSERT_EQ(8u, received.size());
+    EXPECT_EQ("ESTOP_LEFT", received[0]);
+    EXPECT_EQ("POSE", received[1]);
+    for (size_t i = 2; i < received.size(); i++) {
+        EXPECT_EQ("MAP", received[i]);
+    }
+
+    // removing the class puts the channel back in arrival order
+    received.clear();
+    lcm_set_channel_priority(lcm, "ESTOP_.*", 0);
+    lcm_publish(lcm, "MAP", "", 0);
+    lcm_publish(lcm, "ESTOP_LEFT", "", 0);
+    nanosleep(&sleeptime, NULL);
+    while (lcm_handle_timeout(lcm, 100) > 0) {
+    }
+    ASSERT_EQ(2u, received.size());
+    EXPECT_EQ("MAP", received[0]);
+    EXPECT_EQ("ESTOP_LEFT", received[1]);
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, Stats)
+{
+    lcm_t *lcm = lcm_create(NULL);
+    ASSERT_NE((void *) NULL, lcm);
+
+    lcm_subscription_t *subs = lcm_subscribe(lcm, "stats", empty_handler, NULL);
+    lcm_subscription_set_queue_capacity(subs, 5);
+    EXPECT_EQ(0u, lcm_subscription_get_drop_count(subs));
+
+    // the queue holds 5 of these, and the rest are dropped
+    for (int i = 0; i < 10; i++) {
+        lcm_publish(lcm, "stats", "abcd", 4);
+    }
+    struct timespec sleeptime;
+    sleeptime.tv_sec = 0;
+    sleeptime.tv_nsec = 100000000;
+    nanosleep(&sleeptime, NULL);
+
+    lcm_stats_t stats;
+    ASSERT_EQ(0, lcm_get_stats(lcm, &stats));
+    EXPECT_GE(stats.packets_received, 10u);
+    EXPECT_GE(stats.bytes_received, 10u * 4);
+    EXPECT_EQ(5u, stats.queue_drops);
+    EXPECT_EQ(5u, lcm_subscription_get_drop_count(subs));
+    EXPECT_GT(stats.ringbuf_capacity, 0u);
+    EXPECT_GT(stats.ringbuf_high_water, 0u);
+    EXPECT_LE(stats.ringbuf_high_water, stats.ringbuf_capacity);
+
+    lcm_destroy(lcm);
+}
+
+struct BatchState {
+    int num_received;
+    int num_bad;
+};
+
+static void batch_handler(const lcm_recv_buf_t *rbuf, const char * /* unused */, void *user)
+{
+    BatchState *state = (BatchState *) user;
+    // every message is filled with its size modulo 251
+    const uint8_t *data = (const uint8_t *) rbuf->data;
+    for (uint32_t i = 0; i < rbuf->data_size; i++) {
+        if (data[i] != (uint8_t) (rbuf->data_size % 251)) {
+            state->num_bad++;
+            break;
+        }
+    }
+    state->num_received++;
+}
+
+// publishes messages of various sizes on a udpm instance created from url,
+// and checks that every one of them is received intact.
+static void check_receive_all(const char *url)
+{
+    lcm_t *lcm = lcm_create(url);
+    ASSERT_NE((void *) NULL, lcm);
+
+    BatchState state = { 0, 0 };
+    lcm_subscription_t *subs = lcm_subscribe(lcm, "batch", batch_handler, &state);
+    lcm_subscription_set_queue_capacity(subs, 100);
+
+    // a burst of short messages, followed by messages that have to be
+    // fragmented.  The large messages are handled one at a time so that they
+    // do not overflow the kernel receive buffer.
+    const int sizes[] = { 0, 1, 100, 1500, 7, 4000, 12, 600, 9000, 3, 70000, 150000 };
+    const int num_msgs = sizeof(sizes) / sizeof(sizes[0]);
+    for (int i = 0; i < num_msgs; i++) {
+        uint8_t *data = (uint8_t *) malloc(sizes[i] + 1);
+        memset(data, sizes[i] % 251, sizes[i]);
+        EXPECT_EQ(0, lcm_publish(lcm, "batch", data, sizes[i]));
+        free(data);
+
+        if (sizes[i] > 65000) {
+            while (state.num_received < i + 1 && lcm_handle_timeout(lcm, 500) > 0) {
+            }
+        }
+    }
+
+    while (state.num_received < num_msgs && lcm_handle_timeout(lcm, 500) > 0) {
+    }
+    EXPECT_EQ(num_msgs, state.num_received);
+    EXPECT_EQ(0, state.num_bad);
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, LeanBuffers)
+{
+    // the buffers grow as needed, and a message larger than the fragment
+    // store is still reassembled
+    check_receive_all("udpm://239.255.76.67:7667?lean=1&recv_buf_size=1048576");
+    check_receive_all("udpm://239.255.76.67:7667?recv_bufs=1&frag_store=100000&max_frag_bufs=1"
+                      "&recv_buf_size=1048576");
+}
+
+TEST(LCM_C, UnicastPeers)
+{
+    // the messages come back by unicast through loopback, and a peer that
+    // nothing listens on does not get in the way
+    check_receive_all("udpm://239.255.76.67:7667?peers=127.0.0.1&unicast=1&recv_buf_size=1048576");
+    check_receive_all("udpm://239.255.76.67:7667?peers=127.0.0.1:7669,127.0.0.1:7667"
+                      "&unicast=1&recv_buf_size=1048576");
+}
+
+TEST(LCM_C, SendIfaces)
+{
+    // the address of the interface that the group is routed out of
+    struct sockaddr_in group;
+    memset(&group, 0, sizeof(group));
+    group.sin_family = AF_INET;
+    group.sin_port = htons(7667);
+    inet_aton("239.255.76.67", &group.sin_addr);
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_EQ(0, connect(fd, (struct sockaddr *) &group, sizeof(group)));
+    struct sockaddr_in local;
+    socklen_t len = sizeof(local);
+    getsockname(fd, (struct sockaddr *) &local, &len);
+    close(fd);
+    std::string addr = inet_ntoa(local.sin_addr);
+
+    std::string url = "udpm://239.255.76.67:7667?recv_buf_size=1048576&ifaces=";
+    check_receive_all((url + addr).c_str());
+    // a pinned channel, and the same interface listed twice
+    check_receive_all((url + "batch:" + addr + "," + addr + "&bundle_size=1400").c_str());
+}
+
+TEST(LCM_C, RecvBatch)
+{
+    // the read thread drains the socket in batches, so leave room in the
+    // kernel for the fragmented messages in between.
+    check_receive_all("udpm://239.255.76.67:7667?recv_batch=8&recv_buf_size=1048576");
+}
+
+TEST(LCM_C, RecvThreads)
+{
+    // the read threads compete for the socket, so leave more room in the
+    // kernel for the fragmented messages.
+    check_receive_all("udpm://239.255.76.67:7667?recv_threads=3&recv_buf_size=1048576");
+    check_receive_all(
+        "udpm://239.255.76.67:7667?recv_threads=2&recv_batch=8&recv_buf_size=1048576");
+}
+
+TEST(LCM_C, FragSize)
+{
+    // many more, smaller datagrams per fragmented message, so leave more room
+    // for them in the kernel
+    check_receive_all("udpm://239.255.76.67:7667?mtu=1500&recv_buf_size=1048576");
+    check_receive_all("udpm://239.255.76.67:7667?frag_size=9000&recv_buf_size=1048576");
+}
+
+static void copy_handler(const lcm_recv_buf_t *rbuf, const char *channel, void *user)
+{
+    std::vector<uint8_t> *received = (std::vector<uint8_t> *) user;
+    const uint8_t *data = (const uint8_t *) rbuf->data;
+    received->assign(data, data + rbuf->data_size);
+}
+
+TEST(LCM_C, Compress)
+{
+    // the fragmented messages compress well, most of them into a single
+    // fragment.  If liblcm is built without LZ4, they are sent as they are.
+    check_receive_all("udpm://239.255.76.67:7667?compress=bat.*&mtu=1500&recv_buf_size=1048576");
+
+    // a message that does not compress is sent as it is
+    lcm_t *lcm = lcm_create("udpm://239.255.76.67:7667?compress=noise&recv_buf_size=1048576");
+    ASSERT_NE((void *) NULL, lcm);
+    std::vector<uint8_t> received;
+    lcm_subscribe(lcm, "noise", copy_handler, &received);
+
+    std::vector<uint8_t> noise(100000);
+    uint32_t x = 12345;
+    for (size_t i = 0; i < noise.size(); i++) {
+        x = x * 1103515245 + 12345;
+        noise[i] = (uint8_t) (x >> 24);
+    }
+    EXPECT_EQ(0, lcm_publish(lcm, "noise", noise.data(), noise.size()));
+    while (received.empty() && lcm_handle_timeout(lcm, 500) > 0) {
+    }
+    EXPECT_TRUE(noise == received);
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, Delta)
+{
+    // after a keyframe, only the few bytes that change are sent, and the
+    // messages are rebuilt as they were published
+    lcm_t *lcm = lcm_create(
+        "udpm://239.255.76.67:7667?delta=grid&delta_keyframe=3&mtu=1500&recv_buf_size=1048576");
+    ASSERT_NE((void *) NULL, lcm);
+    std::vector<uint8_t> received;
+    lcm_subscribe(lcm, "grid", copy_handler, &received);
+
+    std::vector<uint8_t> grid(100000);
+    for (size_t i = 0; i < grid.size(); i++)
+        grid[i] = (uint8_t) (i * 7);
+    uint64_t packets[4];
+    for (int i = 0; i < 4; i++) {
+        grid[i * 1000] ^= 0xff;
+        grid[grid.size() - 1 - i] = (uint8_t) i;
+        lcm_stats_t stats;
+        ASSERT_EQ(0, lcm_get_stats(lcm, &stats));
+        packets[i] = stats.packets_received;
+        received.clear();
+        EXPECT_EQ(0, lcm_publish(lcm, "grid", grid.data(), grid.size()));
+        while (received.empty() && lcm_handle_timeout(lcm, 500) > 0) {
+        }
+        EXPECT_TRUE(grid == received);
+        ASSERT_EQ(0, lcm_get_stats(lcm, &stats));
+        packets[i] = stats.packets_received - packets[i];
+    }
+    EXPECT_LT(60u, packets[0]);
+    EXPECT_EQ(1u, packets[1]);
+    EXPECT_EQ(1u, packets[2]);
+    EXPECT_LT(60u, packets[3]);
+
+    // a receiver that missed the message before a delta drops it, until the
+    // next keyframe
+    lcm_t *late = lcm_create("udpm://239.255.76.67:7667?recv_buf_size=1048576");
+    ASSERT_NE((void *) NULL, late);
+    std::vector<uint8_t> late_received;
+    lcm_subscribe(late, "grid", copy_handler, &late_received);
+    for (int i = 0; i < 3; i++) {
+        grid[i] ^= 0xff;
+        EXPECT_EQ(0, lcm_publish(lcm, "grid", grid.data(), grid.size()));
+    }
+    while (late_received.empty() && lcm_handle_timeout(late, 500) > 0) {
+    }
+    EXPECT_TRUE(grid == late_received);
+    EXPECT_EQ(0, lcm_handle_timeout(late, 100));
+    lcm_stats_t stats;
+    ASSERT_EQ(0, lcm_get_stats(late, &stats));
+    EXPECT_EQ(2u, stats.deltas_dropped);
+
+    lcm_destroy(late);
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, SelfTest)
+{
+    // without the self test, or with it running in the background, messages
+    // are received as usual
+    const char *urls[] = { "udpm://239.255.76.67:7667?self_test=0",
+                           "udpm://239.255.76.67:7667?self_test=async" };
+    for (int i = 0; i < 2; i++) {
+        lcm_t *lcm = lcm_create(urls[i]);
+        ASSERT_NE((void *) NULL, lcm);
+        std::vector<uint8_t> received;
+        lcm_subscribe(lcm, "self_test", copy_handler, &received);
+        EXPECT_EQ(0, lcm_publish(lcm, "self_test", "abc", 3));
+        while (received.empty() && lcm_handle_timeout(lcm, 500) > 0) {
+        }
+        EXPECT_EQ(3u, received.size());
+
+        lcm_stats_t stats;
+        ASSERT_EQ(0, lcm_get_stats(lcm, &stats));
+        EXPECT_EQ(0u, stats.self_test_failures);
+        lcm_destroy(lcm);
+    }
+}
+
+TEST(LCM_C, RingbufSize)
+{
+    check_receive_all("udpm://239.255.76.67:7667?ringbuf_size=1048576&recv_buf_size=1048576");
+    check_receive_all("udpm://239.255.76.67:7667?ringbuf_lock=1&recv_buf_size=1048576");
+
+    // messages that are not handled fill up the ring buffer, but it does not
+    // grow beyond ringbuf_max
+    lcm_t *lcm = lcm_create("udpm://239.255.76.67:7667?ringbuf_max=300000");
+    ASSERT_NE((void *) NULL, lcm);
+    std::vector<uint8_t> received;
+    lcm_subscription_t *subs = lcm_subscribe(lcm, "ringbuf", copy_handler, &received);
+    lcm_subscription_set_queue_capacity(subs, 0);
+    std::vector<uint8_t> buf(10000);
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(0, lcm_publish(lcm, "ringbuf", buf.data(), buf.size()));
+        if (i % 10 == 9) {
+            struct timespec sleeptime = { 0, 10000000 };
+            nanosleep(&sleeptime, NULL);
+        }
+    }
+    lcm_stats_t stats;
+    ASSERT_EQ(0, lcm_get_stats(lcm, &stats));
+    EXPECT_LE(stats.ringbuf_capacity, 300000u);
+
+    // the read thread picks up again once lcm_handle() makes room
+    while (lcm_handle_timeout(lcm, 100) > 0) {
+    }
+    received.clear();
+    EXPECT_EQ(0, lcm_publish(lcm, "ringbuf", "abc", 3));
+    while (received.size() != 3 && lcm_handle_timeout(lcm, 500) > 0) {
+    }
+    EXPECT_EQ(3u, received.size());
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, RecvBufMax)
+{
+    // a full ring buffer makes the read thread leave the datagrams to the
+    // kernel, whose buffer is grown to hold them
+    lcm_t *lcm = lcm_create(
+        "udpm://239.255.76.67:7667?ringbuf_max=300000&recv_buf_size=16384&recv_buf_max=1048576");
+    ASSERT_NE((void *) NULL, lcm);
+    std::vector<uint8_t> received;
+    lcm_subscription_t *subs = lcm_subscribe(lcm, "recv_buf", copy_handler, &received);
+    lcm_subscription_set_queue_capacity(subs, 0);
+    lcm_stats_t stats;
+    ASSERT_EQ(0, lcm_get_stats(lcm, &stats));
+    uint64_t initial_size = stats.recv_buf_size;
+    EXPECT_LT(0u, initial_size);
+
+    std::vector<uint8_t> buf(10000);
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(0, lcm_publish(lcm, "recv_buf", buf.data(), buf.size()));
+        if (i % 10 == 9) {
+            struct timespec sleeptime = { 0, 50000000 };
+            nanosleep(&sleeptime, NULL);
+        }
+    }
+    ASSERT_EQ(0, lcm_get_stats(lcm, &stats));
+    EXPECT_LT(initial_size, stats.recv_buf_size);
+    EXPECT_GE(2u * 1048576, stats.recv_buf_size);
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, DirectReceive)
+{
+    // nothing reads the socket while a message is published, so the kernel
+    // has to hold all of its fragments
+    check_receive_all("udpm://239.255.76.67:7667?recv_threads=0&recv_buf_size=1048576");
+    check_receive_all(
+        "udpm://239.255.76.67:7667?recv_threads=0&busy_poll=50&recv_buf_size=1048576");
+}
+
+TEST(LCM_C, LocalDelivery)
+{
+    check_receive_all("udpm://239.255.76.67:7667?local_delivery=1");
+
+    // another instance still receives the messages through the network, and
+    // the publisher does not receive its own messages a second time.
+    lcm_t *pub = lcm_create("udpm://239.255.76.67:7667?local_delivery=1");
+    lcm_t *sub = lcm_create("udpm://239.255.76.67:7667?recv_buf_size=1048576");
+    ASSERT_NE((void *) NULL, pub);
+    ASSERT_NE((void *) NULL, sub);
+    BatchState pub_state = { 0, 0 };
+    BatchState sub_state = { 0, 0 };
+    lcm_subscribe(pub, "local", batch_handler, &pub_state);
+    lcm_subscribe(sub, "local", batch_handler, &sub_state);
+
+    const int sizes[] = { 10, 2000, 70000 };
+    const int num_msgs = sizeof(sizes) / sizeof(sizes[0]);
+    for (int i = 0; i < num_msgs; i++) {
+        uint8_t *data = (uint8_t *) malloc(sizes[i]);
+        memset(data, sizes[i] % 251, sizes[i]);
+        EXPECT_EQ(0, lcm_publish(pub, "local", data, sizes[i]));
+        free(data);
+    }
+
+    while (sub_state.num_received < num_msgs && lcm_handle_timeout(sub, 500) > 0) {
+    }
+    while (lcm_handle_timeout(pub, 100) > 0) {
+    }
+    EXPECT_EQ(num_msgs, sub_state.num_received);
+    EXPECT_EQ(num_msgs, pub_state.num_received);
+    EXPECT_EQ(0, sub_state.num_bad + pub_state.num_bad);
+
+    lcm_destroy(sub);
+    lcm_destroy(pub);
+}
+
+// publishes messages of various sizes from pub, and handles them on the
+// instances in subs until each has received num_msgs, or none receives more.
+static void publish_shared(lcm_t *pub, const char *channel, lcm_t **subs, int num_subs,
+                           BatchState *states, int num_msgs)
+{
+    const int sizes[] = { 10, 2000, 70000 };
+    for (int i = 0; i < 3; i++) {
+        uint8_t *data = (uint8_t *) malloc(sizes[i]);
+        memset(data, sizes[i] % 251, sizes[i]);
+        EXPECT_EQ(0, lcm_publish(pub, channel, data, sizes[i]));
+        free(data);
+    }
+    for (int i = 0; i < num_subs; i++) {
+        while (states[i].num_received < num_msgs && lcm_handle_timeout(subs[i], 500) > 0) {
+        }
+    }
+}
+
+TEST(LCM_C, ShareTransport)
+{
+    check_receive_all("udpm://239.255.76.67:7667?share=1&recv_buf_size=1048576");
+
+    // each of the instances that share the receive side gets the messages on
+    // its own channels, and the others keep receiving once one is destroyed.
+    const char *url = "udpm://239.255.76.67:7667?recv_buf_size=1048576&share=1";
+    lcm_t *lcms[3];
+    BatchState states[3] = { { 0, 0 }, { 0, 0 }, { 0, 0 } };
+    for (int i = 0; i < 3; i++) {
+        lcms[i] = lcm_create(url);
+        ASSERT_NE((void *) NULL, lcms[i]);
+        lcm_subscribe(lcms[i], i < 2 ? "shared" : "shared_other", batch_handler, &states[i]);
+    }
+
+    publish_shared(lcms[2], "shared", lcms, 3, states, 3);
+    publish_shared(lcms[0], "shared_other", lcms, 3, states, 3);
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(3, states[i].num_received);
+        EXPECT_EQ(0, states[i].num_bad);
+    }
+
+    lcm_destroy(lcms[0]);
+    publish_shared(lcms[2], "shared", lcms + 1, 1, states + 1, 6);
+    EXPECT_EQ(6, states[1].num_received);
+    EXPECT_EQ(0, states[1].num_bad);
+    lcm_destroy(lcms[1]);
+    lcm_destroy(lcms[2]);
+}
+
+static void count_release(void *data, void *user)
+{
+    free(data);
+    (*(int *) user)++;
+}
+
+TEST(LCM_C, SendQueue)
+{
+    // with the block policy, every message is sent eventually
+    lcm_t *lcm = lcm_create("udpm://239.255.76.67:7667?send_queue=16384&recv_buf_size=1048576");
+    ASSERT_NE((void *) NULL, lcm);
+    BatchState state = { 0, 0 };
+    lcm_subscription_t *subs = lcm_subscribe(lcm, "async", batch_handler, &state);
+    lcm_subscription_set_queue_capacity(subs, 0);
+
+    const int num_msgs = 200;
+    int num_released = 0;
+    for (int i = 0; i < num_msgs; i++) {
+        int size = 1000 + i;
+        uint8_t *data = (uint8_t *) malloc(size);
+        memset(data, size % 251, size);
+        if (i % 2) {
+            EXPECT_EQ(0, lcm_publish_async(lcm, "async", data, size));
+            free(data);
+        } else {
+            EXPECT_EQ(0, lcm_publish_async_buffer(lcm, "async", data, size, count_release,
+                                                  &num_released));
+        }
+    }
+    while (state.num_received < num_msgs && lcm_handle_timeout(lcm, 500) > 0) {
+    }
+    EXPECT_EQ(num_msgs, state.num_received);
+    EXPECT_EQ(0, state.num_bad);
+    EXPECT_EQ(num_msgs / 2, num_released);
+
+    // messages that can never fit are refused
+    uint8_t *data = (uint8_t *) calloc(1, 20000);
+    EXPECT_EQ(-1, lcm_publish_async(lcm, "async", data, 20000));
+    free(data);
+    lcm_destroy(lcm);
+
+    // with the drop policy, messages that don't fit are dropped, and the rest
+    // are sent intact.  Whatever is still queued is sent by lcm_destroy().
+    lcm = lcm_create("udpm://239.255.76.67:7667?send_queue=8192&send_policy=drop");
+    ASSERT_NE((void *) NULL, lcm);
+    num_released = 0;
+    int num_queued = 0;
+    for (int i = 0; i < num_msgs; i++) {
+        data = (uint8_t *) malloc(1000);
+        if (lcm_publish_async_buffer(lcm, "async", data, 1000, count_release, &num_released) ==
+            0)
+            num_queued++;
+    }
+    EXPECT_GT(num_queued, 0);
+    lcm_destroy(lcm);
+    EXPECT_EQ(num_msgs, num_released);
+}
+
+struct BundleState {
+    std::vector<std::string> channels;
+    std::vector<int> seqs;
+};
+
+static void bundle_handler(const lcm_recv_buf_t *rbuf, const char *channel, void *user)
+{
+    BundleState *state = (BundleState *) user;
+    int seq = -1;
+    if (rbuf->data_size >= sizeof(seq))
+        memcpy(&seq, rbuf->data, sizeof(seq));
+    state->channels.push_back(channel);
+    state->seqs.push_back(seq);
+}
+
+TEST(LCM_C, BundlePackets)
+{
+    lcm_t *lcm = lcm_create(
+        "udpm://239.255.76.67:7667?bundle_size=1400&bundle_interval=2000&recv_buf_size=1048576");
+    ASSERT_NE((void *) NULL, lcm);
+
+    // the exact channel names let the socket filter be attached too
+    BundleState state;
+    lcm_subscription_t *subs_a = lcm_subscribe(lcm, "bundle_a", bundle_handler, &state);
+    lcm_subscription_t *subs_b = lcm_subscribe(lcm, "bundle_b", bundle_handler, &state);
+    lcm_subscription_set_queue_capacity(subs_a, 0);
+    lcm_subscription_set_queue_capacity(subs_b, 0);
+
+    // short messages on several channels, with a message that is too large
+    // for a bundle in between.  All arrive in the order they were published,
+    // except for the ones on a channel that nobody subscribes to.
+    const int num_msgs = 300;
+    std::vector<uint8_t> buf(2000);
+    for (int i = 0; i < num_msgs; i++) {
+        const char *channel = i % 3 == 0 ? "bundle_a" : i % 3 == 1 ? "bundle_b" : "bundle_c";
+        memcpy(buf.data(), &i, sizeof(i));
+        int size = i == num_msgs / 2 ? 2000 : 40;
+        EXPECT_EQ(0, lcm_publish(lcm, channel, buf.data(), size));
+    }
+
+    const int num_expected = num_msgs * 2 / 3;
+    while ((int) state.seqs.size() < num_expected) {
+        // bundle packets are dispatched one message at a time
+        size_t before = state.seqs.size();
+        ASSERT_GT(lcm_handle_timeout(lcm, 500), 0);
+        EXPECT_LE(state.seqs.size(), before + 1);
+    }
+    int expected = 0;
+    for (int i = 0; i < num_expected; i++) {
+        if (expected % 3 == 2)
+            expected++;
+        EXPECT_EQ(expected, state.seqs[i]);
+        EXPECT_EQ(expected % 3 == 0 ? "bundle_a" : "bundle_b", state.channels[i]);
+        expected++;
+    }
+
+    // the messages on "bundle_c" are read, but not dispatched
+    while (lcm_handle_timeout(lcm, 50) > 0) {
+    }
+    EXPECT_EQ(num_expected, (int) state.seqs.size());
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, PublishBatch)
+{
+    lcm_t *lcm = lcm_create("udpm://239.255.76.67:7667?recv_buf_size=1048576");
+    ASSERT_NE((void *) NULL, lcm);
+    BundleState state;
+    lcm_subscription_t *subs = lcm_subscribe(lcm, "batch_.*", bundle_handler, &state);
+    lcm_subscription_set_queue_capacity(subs, 0);
+
+    // short messages on two channels, with a fragmented message in between,
+    // arrive in the order that they were published
+    const int num_msgs = 150;
+    std::vector<std::vector<uint8_t> > bufs(num_msgs);
+    std::vector<lcm_publish_msg_t> msgs(num_msgs);
+    for (int i = 0; i < num_msgs; i++) {
+        bufs[i].resize(i == num_msgs / 2 ? 100000 : 100);
+        memcpy(bufs[i].data(), &i, sizeof(i));
+        msgs[i].channel = i % 2 ? "batch_a" : "batch_b";
+        msgs[i].data = bufs[i].data();
+        msgs[i].datalen = bufs[i].size();
+    }
+    EXPECT_EQ(0, lcm_publish_batch(lcm, msgs.data(), num_msgs));
+
+    while ((int) state.seqs.size() < num_msgs && lcm_handle_timeout(lcm, 500) > 0) {
+    }
+    ASSERT_EQ(num_msgs, (int) state.seqs.size());
+    for (int i = 0; i < num_msgs; i++) {
+        EXPECT_EQ(i, state.seqs[i]);
+        EXPECT_EQ(i % 2 ? "batch_a" : "batch_b", state.channels[i]);
+    }
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, Publisher)
+{
+    lcm_t *lcm = lcm_create("udpm://239.255.76.67:7667?recv_buf_size=1048576&compress=pub_.*");
+    ASSERT_NE((void *) NULL, lcm);
+    BundleState state;
+    lcm_subscription_t *subs = lcm_subscribe(lcm, "pub_.*", bundle_handler, &state);
+    lcm_subscription_set_queue_capacity(subs, 0);
+
+    std::string long_channel(LCM_MAX_CHANNEL_NAME_LENGTH + 1, 'x');
+    EXPECT_EQ((void *) NULL, lcm_publisher_create(lcm, long_channel.c_str()));
+
+    // short and compressed fragmented messages
+    lcm_publisher_t *publisher = lcm_publisher_create(lcm, "pub_a");
+    ASSERT_NE((void *) NULL, publisher);
+    const int num_msgs = 10;
+    for (int i = 0; i < num_msgs; i++) {
+        std::vector<uint8_t> buf(i % 2 ? 100000 : 100);
+        memcpy(buf.data(), &i, sizeof(i));
+        EXPECT_EQ(0, lcm_publisher_publish(publisher, buf.data(), buf.size()));
+    }
+    lcm_publisher_destroy(publisher);
+
+    while ((int) state.seqs.size() < num_msgs && lcm_handle_timeout(lcm, 500) > 0) {
+    }
+    ASSERT_EQ(num_msgs, (int) state.seqs.size());
+    for (int i = 0; i < num_msgs; i++) {
+        EXPECT_EQ(i, state.seqs[i]);
+        EXPECT_EQ("pub_a", state.channels[i]);
+    }
+
+    lcm_destroy(lcm);
+}
+
+static void publishv_handler(const lcm_recv_buf_t *rbuf, const char * /* unused */, void *user)
+{
+    std::vector<std::vector<uint8_t> > *received = (std::vector<std::vector<uint8_t> > *) user;
+    const uint8_t *data = (const uint8_t *) rbuf->data;
+    received->push_back(std::vector<uint8_t>(data, data + rbuf->data_size));
+}
+
+TEST(LCM_C, Publishv)
+{
+    // A message published from several buffers arrives as if they had been
+    // concatenated, whether it is short, fragmented, or of more pieces than
+    // are sent as they are.
+    lcm_t *lcm = lcm_create("udpm://239.255.76.67:7667?recv_buf_size=1048576");
+    ASSERT_NE((void *) NULL, lcm);
+    std::vector<std::vector<uint8_t> > received;
+    lcm_subscription_t *subs = lcm_subscribe(lcm, "publishv", publishv_handler, &received);
+    lcm_subscription_set_queue_capacity(subs, 0);
+
+    std::vector<uint8_t> payload(200000);
+    for (size_t i = 0; i < payload.size(); i++)
+        payload[i] = (uint8_t) (i * 7);
+    uint8_t header[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+
+    std::vector<std::vector<uint8_t> > expected;
+    const unsigned int sizes[] = {100, 200000};
+    for (unsigned int size : sizes) {
+        lcm_iovec_t iov[2] = {{header, sizeof(header)}, {payload.data(), size}};
+        EXPECT_EQ(0, lcm_publishv(lcm, "publishv", iov, 2));
+        std::vector<uint8_t> msg(header, header + sizeof(header));
+        msg.insert(msg.end(), payload.begin(), payload.begin() + size);
+        expected.push_back(msg);
+    }
+    std::vector<lcm_iovec_t> pieces(40);
+    for (int i = 0; i < 40; i++) {
+        pieces[i].data = &payload[i * 1000];
+        pieces[i].len = 1000;
+    }
+    EXPECT_EQ(0, lcm_publishv(lcm, "publishv", pieces.data(), (int) pieces.size()));
+    expected.push_back(std::vector<uint8_t>(payload.begin(), payload.begin() + 40000));
+
+    while (received.size() < expected.size() && lcm_handle_timeout(lcm, 500) > 0) {
+    }
+    EXPECT_EQ(expected, received);
+
+    lcm_destroy(lcm);
+}
+
+static void retain_handler(const lcm_recv_buf_t *rbuf, const char * /* unused */, void *user)
+{
+    std::vector<lcm_recv_buf_t *> *retained = (std::vector<lcm_recv_buf_t *> *) user;
+    retained->push_back(lcm_recv_buf_retain(rbuf));
+}
+
+TEST(LCM_C, RetainReceiveBuffers)
+{
+    // Received messages that the handler retains stay intact while more
+    // messages are received, until they are released.
+    lcm_t *lcm = lcm_create("udpm://239.255.76.67:7667?recv_buf_size=1048576");
+    ASSERT_NE((void *) NULL, lcm);
+    std::vector<lcm_recv_buf_t *> retained;
+    lcm_subscription_t *subs = lcm_subscribe(lcm, "retain", retain_handler, &retained);
+    lcm_subscription_set_queue_capacity(subs, 0);
+
+    const int num_msgs = 20;
+    for (int i = 0; i < num_msgs; i++) {
+        std::vector<uint8_t> buf(i % 4 == 3 ? 100000 : 1000, (uint8_t) i);
+        EXPECT_EQ(0, lcm_publish(lcm, "retain", buf.data(), buf.size()));
+        while ((int) retained.size() <= i && lcm_handle_timeout(lcm, 500) > 0) {
+        }
+    }
+    ASSERT_EQ(num_msgs, (int) retained.size());
+    for (int i = 0; i < num_msgs; i++) {
+        ASSERT_NE((void *) NULL, retained[i]);
+        ASSERT_EQ(i % 4 == 3 ? 100000u : 1000u, retained[i]->data_size);
+        const uint8_t *data = (const uint8_t *) retained[i]->data;
+        EXPECT_EQ(i, data[0]);
+        EXPECT_EQ(i, data[retained[i]->data_size - 1]);
+        lcm_recv_buf_release(retained[i]);
+    }
+
+    // the released buffers are reused
+    retained.clear();
+    for (int i = 0; i < num_msgs; i++) {
+        EXPECT_EQ(0, lcm_publish(lcm, "retain", "abc", 3));
+        while ((int) retained.size() <= i && lcm_handle_timeout(lcm, 500) > 0) {
+        }
+        ASSERT_EQ(i + 1, (int) retained.size());
+        EXPECT_EQ(0, memcmp("abc", retained[i]->data, 3));
+        lcm_recv_buf_release(retained[i]);
+    }
+
+    lcm_destroy(lcm);
+}
+
+struct AlignState {
+    int num_received;
+    int num_misaligned;
+    int num_bad;
+};
+
+static void align_handler(const lcm_recv_buf_t *rbuf, const char *channel, void *user)
+{
+    AlignState *state = (AlignState *) user;
+    state->num_received++;
+    if ((uintptr_t) rbuf->data % 64)
+        state->num_misaligned++;
+    const uint8_t *data = (const uint8_t *) rbuf->data;
+    uint8_t expected = (uint8_t) strlen(channel);
+    for (uint32_t i = 0; i < rbuf->data_size; i++) {
+        if (data[i] != expected) {
+            state->num_bad++;
+            break;
+        }
+    }
+}
+
+TEST(LCM_C, AlignedPayload)
+{
+    // With align=64, the payloads of short and fragmented messages start at
+    // multiples of 64 bytes, whatever the length of their channel.
+    lcm_t *lcm = lcm_create("udpm://239.255.76.67:7667?recv_buf_size=1048576&align=64");
+    ASSERT_NE((void *) NULL, lcm);
+    AlignState state = { 0, 0, 0 };
+    lcm_subscribe(lcm, "align.*", align_handler, &state);
+
+    const char *channels[] = { "align", "align_", "align_payload", "align_payload_of_a_message",
+                               "align_payload_of_a_message_on_a_longer_channel" };
+    int num_sent = 0;
+    for (const char *channel : channels) {
+        for (int size : { 1, 100, 1000, 100000 }) {
+            std::vector<uint8_t> buf(size, (uint8_t) strlen(channel));
+            EXPECT_EQ(0, lcm_publish(lcm, channel, buf.data(), buf.size()));
+            num_sent++;
+            while (state.num_received < num_sent && lcm_handle_timeout(lcm, 500) > 0) {
+            }
+        }
+    }
+    EXPECT_EQ(num_sent, state.num_received);
+    EXPECT_EQ(0, state.num_misaligned);
+    EXPECT_EQ(0, state.num_bad);
+
+    lcm_destroy(lcm);
+}
+
+struct TimestampState {
+    int num_received;
+    int64_t recv_utime;
+    int64_t recv_time_ns;
+    int64_t recv_mono_ns;
+};
+
+static void timestamp_handler(const lcm_recv_buf_t *rbuf, const char * /* unused */, void *user)
+{
+    TimestampState *state = (TimestampState *) user;
+    state->recv_utime = rbuf->recv_utime;
+    state->recv_time_ns = rbuf->recv_time_ns;
+    state->recv_mono_ns = rbuf->recv_mono_ns;
+    state->num_received++;
+}
+
+static int64_t timestamp_now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// checks that the nanosecond receive timestamps of a short and a fragmented
+// message agree with their microsecond ones, and with when they were sent,
+// and so do their monotonic ones.
+static void check_timestamps(const char *url)
+{
+    lcm_t *lcm = lcm_create(url);
+    ASSERT_NE((void *) NULL, lcm);
+
+    TimestampState state = { 0, 0, 0, 0 };
+    lcm_subscribe(lcm, "timestamp", timestamp_handler, &state);
+
+    const int sizes[] = { 10, 100000 };
+    for (int i = 0; i < 2; i++) {
+        uint8_t *data = (uint8_t *) calloc(1, sizes[i]);
+        int64_t before = timestamp_now_us();
+        int64_t before_mono = lcm_monotonic_ns();
+        EXPECT_EQ(0, lcm_publish(lcm, "timestamp", data, sizes[i]));
+        free(data);
+        while (state.num_received < i + 1 && lcm_handle_timeout(lcm, 500) > 0) {
+        }
+        int64_t after = timestamp_now_us();
+        int64_t after_mono = lcm_monotonic_ns();
+
+        ASSERT_EQ(i + 1, state.num_received);
+        EXPECT_EQ(state.recv_utime, state.recv_time_ns / 1000);
+        EXPECT_LE(before * 1000, state.recv_time_ns);
+        EXPECT_GE((after + 1) * 1000, state.recv_time_ns);
+        // with mono_clock=kernel, the offset between the clocks is only
+        // sampled to within a few microseconds
+        EXPECT_LE(before_mono - 10000, state.recv_mono_ns);
+        EXPECT_GE(after_mono + 10000, state.recv_mono_ns);
+    }
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, Timestamping)
+{
+    check_timestamps("udpm://239.255.76.67:7667?ttl=0");
+    check_timestamps("udpm://239.255.76.67:7667?ttl=0&timestamping=sw");
+    // without a network card that timestamps packets, falls back to kernel
+    // timestamps
+    check_timestamps("udpm://239.255.76.67:7667?ttl=0&timestamping=hw");
+    check_timestamps("udpm://239.255.76.67:7667?ttl=0&mono_clock=kernel");
+    check_timestamps("udpm://239.255.76.67:7667?ttl=0&timestamping=sw&mono_clock=kernel");
+}
+
+// sends one fragment of a message in the LCM wire format, as a udpm
+// publisher would.
+static void send_fragment(int fd, const struct sockaddr_in *dest, uint32_t seqno,
+                          const uint8_t *data, uint32_t data_size, uint32_t offset,
+                          uint32_t frag_size, uint16_t fragment_no, uint16_t nfragments,
+                          const char *channel)
+{
+    uint8_t packet[2048];
+    uint32_t header[4] = { htonl(0x4c433033), htonl(seqno), htonl(data_size), htonl(offset) };
+    uint16_t counts[2] = { htons(fragment_no), htons(nfragments) };
+    size_t len = 0;
+    memcpy(packet, header, sizeof(header));
+    len += sizeof(header);
+    memcpy(packet + len, counts, sizeof(counts));
+    len += sizeof(counts);
+    if (fragment_no == 0) {
+        memcpy(packet + len, channel, strlen(channel) + 1);
+        len += strlen(channel) + 1;
+    }
+    memcpy(packet + len, data + offset, frag_size);
+    len += frag_size;
+    ASSERT_EQ((ssize_t) len,
+              sendto(fd, packet, len, 0, (const struct sockaddr *) dest, sizeof(*dest)));
+}
+
+TEST(LCM_C, DuplicateFragments)
+{
+    lcm_t *lcm = lcm_create("udpm://239.255.76.67:7667?ttl=0");
+    ASSERT_NE((void *) NULL, lcm);
+
+    BatchState state = { 0, 0 };
+    lcm_subscribe(lcm, "dup", batch_handler, &state);
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(fd, 0);
+    unsigned char ttl = 0;
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    struct sockaddr_in dest;
+    memset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
+    dest.sin_addr.s_addr = inet_addr("239.255.76.67");
+    dest.sin_port = htons(7667);
+
+    const uint32_t size = 1000;
+    uint8_t data[size];
+    memset(data, size % 251, size);
+
+    // a repeated fragment must neither complete a message early nor keep it
+    // from completing.
+    send_fragment(fd, &dest, 1, data, size, 600, 400, 1, 2, "dup");
+    send_fragment(fd, &dest, 1, data, size, 600, 400, 1, 2, "dup");
+    send_fragment(fd, &dest, 1, data, size, 0, 600, 0, 2, "dup");
+
+    send_fragment(fd, &dest, 2, data, size, 0, 600, 0, 2, "dup");
+    send_fragment(fd, &dest, 2, data, size, 0, 600, 0, 2, "dup");
+    send_fragment(fd, &dest, 2, data, size, 600, 400, 1, 2, "dup");
+    close(fd);
+
+    while (state.num_received < 2 && lcm_handle_timeout(lcm, 500) > 0) {
+    }
+    EXPECT_EQ(0, lcm_handle_timeout(lcm, 100));
+    EXPECT_EQ(2, state.num_received);
+    EXPECT_EQ(0, state.num_bad);
+
+    lcm_destroy(lcm);
+}
+
+// sends a short message in the LCM wire format
+static void send_short(int fd, const struct sockaddr_in *dest, uint32_t seqno, const uint8_t *data,
+                       uint32_t data_size, const char *channel)
+{
+    uint8_t packet[2048];
+    uint32_t header[2] = { htonl(0x4c433032), htonl(seqno) };
+    size_t len = 0;
+    memcpy(packet, header, sizeof(header));
+    len += sizeof(header);
+    memcpy(packet + len, channel, strlen(channel) + 1);
+    len += strlen(channel) + 1;
+    memcpy(packet + len, data, data_size);
+    len += data_size;
+    ASSERT_EQ((ssize_t) len,
+              sendto(fd, packet, len, 0, (const struct sockaddr *) dest, sizeof(*dest)));
+}
+
+TEST(LCM_C, SequenceNumbers)
+{
+    lcm_t *lcm = lcm_create("udpm://239.255.76.67:7667?ttl=0");
+    ASSERT_NE((void *) NULL, lcm);
+
+    BatchState state = { 0, 0 };
+    lcm_subscribe(lcm, "seq", batch_handler, &state);
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(fd, 0);
+    unsigned char ttl = 0;
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    struct sockaddr_in dest;
+    memset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
+    dest.sin_addr.s_addr = inet_addr("239.255.76.67");
+    dest.sin_port = htons(7667);
+
+    const uint32_t size = 1000;
+    uint8_t data[size];
+    memset(data, size % 251, size);
+
+    // 3 arrives late, and again, and 7 to 9 never do
+    const uint32_t seqnos[] = { 1, 2, 4, 3, 3, 5 };
+    for (size_t i = 0; i < sizeof(seqnos) / sizeof(seqnos[0]); i++)
+        send_short(fd, &dest, seqnos[i], data, size, "seq");
+    send_fragment(fd, &dest, 6, data, size, 0, 600, 0, 2, "seq");
+    send_fragment(fd, &dest, 6, data, size, 600, 400, 1, 2, "seq");
+    send_short(fd, &dest, 10, data, size, "seq");
+    close(fd);
+
+    while (state.num_received < 8 && lcm_handle_timeout(lcm, 500) > 0) {
+    }
+    EXPECT_EQ(8, state.num_received);
+
+    lcm_stats_t stats;
+    ASSERT_EQ(0, lcm_get_stats(lcm, &stats));
+    EXPECT_EQ(4u, stats.seqno_gaps);
+    EXPECT_EQ(1u, stats.seqno_duplicates);
+    EXPECT_EQ(1u, stats.seqno_reorders);
+
+    lcm_destroy(lcm);
+}
+
+// sends the parity packet of a group of fragments of frag_size bytes, which
+// start at first_fragment
+static void send_parity(int fd, const struct sockaddr_in *dest, uint32_t seqno,
+                        const uint8_t *data, uint32_t data_size, uint32_t frag_size,
+                        uint16_t first_fragment, uint16_t group_size, uint16_t nfragments,
+                        const char *channel)
+{
+    uint8_t packet[2048];
+    uint32_t header[4] = { htonl(0x4c433036), htonl(seqno), htonl(data_size), 0 };
+    uint16_t counts[2] = { htons(first_fragment), htons(nfragments) };
+    uint32_t parity_size = htonl(frag_size);
+    uint16_t group[2] = { htons(group_size), 0 };
+    size_t len = 0;
+    memcpy(packet, header, sizeof(header));
+    len += sizeof(header);
+    memcpy(packet + len, counts, sizeof(counts));
+    len += sizeof(counts);
+    memcpy(packet + len, &parity_size, sizeof(parity_size));
+    len += sizeof(parity_size);
+    memcpy(packet + len, group, sizeof(group));
+    len += sizeof(group);
+    memcpy(packet + len, channel, strlen(channel) + 1);
+    len += strlen(channel) + 1;
+
+    uint8_t *parity = packet + len;
+    memset(parity, 0, frag_size);
+    uint32_t first_size = frag_size - (strlen(channel) + 1);
+    for (int frag_no = first_fragment; frag_no < first_fragment + group_size; frag_no++) {
+        uint32_t offset = frag_no ? first_size + (frag_no - 1) * frag_size : 0;
+        uint32_t end = frag_no ? offset + frag_size : first_size;
+        for (uint32_t i = offset; i < end && i < data_size; i++)
+            parity[i - offset] ^= data[i];
+    }
+    len += frag_size;
+    ASSERT_EQ((ssize_t) len,
+              sendto(fd, packet, len, 0, (const struct sockaddr *) dest, sizeof(*dest)));
+}
+
+TEST(LCM_C, ParityPackets)
+{
+    lcm_t *lcm = lcm_create("udpm://239.255.76.67:7667?ttl=0");
+    ASSERT_NE((void *) NULL, lcm);
+
+    BatchState state = { 0, 0 };
+    lcm_subscribe(lcm, "fec", batch_handler, &state);
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(fd, 0);
+    unsigned char ttl = 0;
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    struct sockaddr_in dest;
+    memset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
+    dest.sin_addr.s_addr = inet_addr("239.255.76.67");
+    dest.sin_port = htons(7667);
+
+    // fragments of 400 bytes: 396 after the channel name, 400 and 204
+    const uint32_t size = 1000;
+    uint8_t data[size];
+    memset(data, size % 251, size);
+
+    // the first fragment is rebuilt, channel name and all
+    send_fragment(fd, &dest, 1, data, size, 396, 400, 1, 3, "fec");
+    send_fragment(fd, &dest, 1, data, size, 796, 204, 2, 3, "fec");
+    send_parity(fd, &dest, 1, data, size, 400, 0, 3, 3, "fec");
+
+    // the fragment in the middle is rebuilt
+    send_fragment(fd, &dest, 2, data, size, 0, 396, 0, 3, "fec");
+    send_fragment(fd, &dest, 2, data, size, 796, 204, 2, 3, "fec");
+    send_parity(fd, &dest, 2, data, size, 400, 0, 3, 3, "fec");
+
+    // two lost fragments of the same group can't be
+    send_fragment(fd, &dest, 3, data, size, 0, 396, 0, 3, "fec");
+    send_parity(fd, &dest, 3, data, size, 400, 0, 3, 3, "fec");
+    close(fd);
+
+    while (state.num_received < 2 && lcm_handle_timeout(lcm, 500) > 0) {
+    }
+    EXPECT_EQ(0, lcm_handle_timeout(lcm, 100));
+    EXPECT_EQ(2, state.num_received);
+    EXPECT_EQ(0, state.num_bad);
+
+    lcm_stats_t stats;
+    ASSERT_EQ(0, lcm_get_stats(lcm, &stats));
+    EXPECT_EQ(2u, stats.fragments_recovered);
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, ParityRoundTrip)
+{
+    // each fragment goes out with its parity, and arrives complete
+    lcm_t *lcm = lcm_create("udpm://239.255.76.67:7667?ttl=0&mtu=1500&fec=4&recv_buf_size=1048576");
+    ASSERT_NE((void *) NULL, lcm);
+    BatchState state = { 0, 0 };
+    lcm_subscription_t *subs = lcm_subscribe(lcm, "fec_round_trip", batch_handler, &state);
+    lcm_subscription_set_queue_capacity(subs, 0);
+
+    const uint32_t size = 20000;
+    std::vector<uint8_t> data(size, size % 251);
+    EXPECT_EQ(0, lcm_publish(lcm, "fec_round_trip", data.data(), size));
+    while (state.num_received < 1 && lcm_handle_timeout(lcm, 500) > 0) {
+    }
+    EXPECT_EQ(1, state.num_received);
+    EXPECT_EQ(0, state.num_bad);
+
+    lcm_stats_t stats;
+    ASSERT_EQ(0, lcm_get_stats(lcm, &stats));
+    EXPECT_EQ(0u, stats.packets_bad);
+    lcm_destroy(lcm);
+}
+
+// waits up to a second for a datagram on fd
+static ssize_t recv_timeout(int fd, void *buf, size_t len, struct sockaddr_in *from)
+{
+    struct timeval tv = { 1, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    socklen_t fromlen = sizeof(*from);
+    return recvfrom(fd, buf, len, 0, (struct sockaddr *) from, &fromlen);
+}
+
+TEST(LCM_C, NackMissingFragments)
+{
+    lcm_t *lcm = lcm_create("udpm://239.255.76.67:7667?ttl=0&retransmit=rel.*&nack_timeout=20");
+    ASSERT_NE((void *) NULL, lcm);
+
+    BatchState state = { 0, 0 };
+    lcm_subscribe(lcm, "rel", batch_handler, &state);
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(fd, 0);
+    unsigned char ttl = 0;
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    struct sockaddr_in dest;
+    memset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
+    dest.sin_addr.s_addr = inet_addr("239.255.76.67");
+    dest.sin_port = htons(7667);
+
+    const uint32_t size = 1000;
+    uint8_t data[size];
+    memset(data, size % 251, size);
+
+    // the receiver asks this "publisher" for the fragment that it skipped
+    send_fragment(fd, &dest, 7, data, size, 0, 400, 0, 3, "rel");
+    send_fragment(fd, &dest, 7, data, size, 800, 200, 2, 3, "rel");
+    uint8_t nack[64];
+    struct sockaddr_in from;
+    ASSERT_EQ(12, recv_timeout(fd, nack, sizeof(nack), &from));
+    uint32_t words[2];
+    uint16_t fragments[2];
+    memcpy(words, nack, sizeof(words));
+    memcpy(fragments, nack + sizeof(words), sizeof(fragments));
+    EXPECT_EQ(0x4c433037u, ntohl(words[0]));
+    EXPECT_EQ(7u, ntohl(words[1]));
+    EXPECT_EQ(1, ntohs(fragments[0]));
+    EXPECT_EQ(1, ntohs(fragments[1]));
+
+    send_fragment(fd, &dest, 7, data, size, 400, 400, 1, 3, "rel");
+    close(fd);
+
+    while (state.num_received < 1 && lcm_handle_timeout(lcm, 500) > 0) {
+    }
+    EXPECT_EQ(1, state.num_received);
+    EXPECT_EQ(0, state.num_bad);
+
+    lcm_stats_t stats;
+    ASSERT_EQ(0, lcm_get_stats(lcm, &stats));
+    EXPECT_EQ(1u, stats.fragments_requested);
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, RetransmitFragments)
+{
+    lcm_t *lcm = lcm_create("udpm://239.255.76.67:7667?ttl=0&mtu=576&retransmit=rel_pub");
+    ASSERT_NE((void *) NULL, lcm);
+
+    // a receiver of its own, that sees the fragments as they are sent
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(fd, 0);
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(7667);
+    ASSERT_EQ(0, bind(fd, (struct sockaddr *) &addr, sizeof(addr)));
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr.s_addr = inet_addr("239.255.76.67");
+    mreq.imr_interface.s_addr = INADDR_ANY;
+    ASSERT_EQ(0, setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)));
+
+    // sent in 4 fragments
+    std::vector<uint8_t> data(2000, 3);
+    EXPECT_EQ(0, lcm_publish(lcm, "rel_pub", data.data(), data.size()));
+    uint8_t packet[2048];
+    struct sockaddr_in from;
+    uint32_t words[2];
+    for (int i = 0; i < 4; i++) {
+        ASSERT_GT(recv_timeout(fd, packet, sizeof(packet), &from), 20);
+        memcpy(words, packet, sizeof(words));
+        ASSERT_EQ(0x4c433033u, ntohl(words[0]));
+    }
+
+    // the NACKed fragment is sent again, and one that the message doesn't
+    // have is ignored
+    uint8_t nack[14];
+    // the number of fragments, and their numbers
+    uint16_t fragments[3] = { htons(2), htons(1), htons(99) };
+    words[0] = htonl(0x4c433037);
+    memcpy(nack, words, sizeof(words));
+    memcpy(nack + sizeof(words), fragments, sizeof(fragments));
+    ASSERT_EQ(14, sendto(fd, nack, sizeof(nack), 0, (struct sockaddr *) &from, sizeof(from)));
+
+    ASSERT_GT(recv_timeout(fd, packet, sizeof(packet), &from), 20);
+    uint16_t fragment_no;
+    memcpy(words, packet, sizeof(words));
+    memcpy(&fragment_no, packet + 16, sizeof(fragment_no));
+    EXPECT_EQ(0x4c433033u, ntohl(words[0]));
+    EXPECT_EQ(1, ntohs(fragment_no));
+    EXPECT_LT(recv_timeout(fd, packet, sizeof(packet), &from), 0);
+
+    close(fd);
+    lcm_destroy(lcm);
+}
+
+struct ThreadStartState {
+    int num_started;
+    int pinned;
+};
+
+static void thread_start_handler(const char *name, void *user)
+{
+    ThreadStartState *state = (ThreadStartState *) user;
+    EXPECT_STREQ("lcm-udpm-recv", name);
+#ifdef __linux__
+    cpu_set_t cpus;
+    state->pinned = sched_getaffinity(0, sizeof(cpus), &cpus) == 0 && CPU_COUNT(&cpus) == 1 &&
+                    CPU_ISSET(0, &cpus);
+#endif
+    state->num_started++;
+}
+
+TEST(LCM_C, ThreadStartHandler)
+{
+    ThreadStartState state = { 0, 0 };
+    lcm_set_thread_start_handler(thread_start_handler, &state);
+
+    // the read thread is started on the first subscription
+    lcm_t *lcm = lcm_create("udpm://239.255.76.67:7667?ttl=0&recv_cpu=0");
+    ASSERT_NE((void *) NULL, lcm);
+    lcm_subscription_t *subs = lcm_subscribe(lcm, "thread", empty_handler, NULL);
+    EXPECT_EQ(0, lcm_handle_timeout(lcm, 0));
+    lcm_unsubscribe(lcm, subs);
+    lcm_destroy(lcm);
+    lcm_set_thread_start_handler(NULL, NULL);
+
+    EXPECT_EQ(1, state.num_started);
+#ifdef __linux__
+    EXPECT_TRUE(state.pinned);
+#endif
+}
+
+static const char *const filter_channels[] = { "FILTER_EXACT",  "FILTER_EXACTLY", "FILTER_EXAC",
+                                               "FILTER_PREFIX", "FILTER_PREFIX_", "FILTER_OTHER" };
+static const int num_filter_channels = sizeof(filter_channels) / sizeof(filter_channels[0]);
+
+static void filter_handler(const lcm_recv_buf_t * /* unused */, const char *channel, void *user)
+{
+    int *received = (int *) user;
+    for (int i = 0; i < num_filter_channels; i++) {
+        if (!strcmp(channel, filter_channels[i]))
+            *received |= 1 << i;
+    }
+}
+
+// publishes a message on each of filter_channels, and returns a bit mask of
+// the channels that messages were received on.  The message on
+// FILTER_PREFIX_ is fragmented.
+static int publish_filter_channels(lcm_t *lcm, int *received)
+{
+    static uint8_t data[100000];
+    *received = 0;
+    for (int i = 0; i < num_filter_channels; i++) {
+        int size = strcmp(filter_channels[i], "FILTER_PREFIX_") ? 10 : sizeof(data);
+        EXPECT_EQ(0, lcm_publish(lcm, filter_channels[i], data, size));
+    }
+    while (lcm_handle_timeout(lcm, 100) > 0) {
+    }
+    return *received;
+}
+
+TEST(LCM_C, ChannelFilter)
+{
+    lcm_t *lcm = lcm_create("udpm://239.255.76.67:7667?ttl=0");
+    ASSERT_NE((void *) NULL, lcm);
+
+    int received = 0;
+    lcm_subscribe(lcm, "FILTER_EXACT", filter_handler, &received);
+    lcm_subscribe(lcm, "FILTER_PREFIX.*", filter_handler, &received);
+    EXPECT_EQ(0x19, publish_filter_channels(lcm, &received));
+
+    // any other regular expression is matched outside the kernel
+    lcm_subscription_t *regex = lcm_subscribe(lcm, "FILTER_O[HT]+ER", filter_handler, &received);
+    EXPECT_EQ(0x39, publish_filter_channels(lcm, &received));
+    lcm_unsubscribe(lcm, regex);
+    EXPECT_EQ(0x19, publish_filter_channels(lcm, &received));
+
+    lcm_destroy(lcm);
+}
+
+// Waits up to a second for lcm_publisher_has_subscribers() to return expected.
+static int wait_for_interest(lcm_publisher_t *publisher, int expected)
+{
+    for (int i = 0; i < 100 && lcm_publisher_has_subscribers(publisher) != expected; i++)
+        usleep(10000);
+    return lcm_publisher_has_subscribers(publisher);
+}
+
+TEST(LCM_C, Interest)
+{
+    const char *url = "udpm://239.255.76.67:7667?ttl=0&interest=7668&interest_period=100";
+    lcm_t *pub_lcm = lcm_create(url);
+    ASSERT_NE((void *) NULL, pub_lcm);
+    lcm_publisher_t *publisher = lcm_publisher_create(pub_lcm, "INTEREST_A");
+    ASSERT_NE((void *) NULL, publisher);
+
+    // every channel counts as subscribed until the announcements are in
+    EXPECT_EQ(1, lcm_publisher_has_subscribers(publisher));
+    EXPECT_EQ(0, wait_for_interest(publisher, 0));
+    EXPECT_EQ(0, lcm_publisher_publish(publisher, "", 0));
+
+    lcm_t *sub_lcm = lcm_create(url);
+    ASSERT_NE((void *) NULL, sub_lcm);
+    std::vector<std::string> received;
+    lcm_subscription_t *subs =
+        lcm_subscribe(sub_lcm, "INTEREST_.*", channel_order_handler, &received);
+    EXPECT_EQ(1, wait_for_interest(publisher, 1));
+    EXPECT_EQ(0, lcm_publisher_publish(publisher, "", 0));
+    while (received.empty() && lcm_handle_timeout(sub_lcm, 500) > 0) {
+    }
+    ASSERT_EQ(1u, received.size());
+    EXPECT_EQ("INTEREST_A", received[0]);
+
+    lcm_unsubscribe(sub_lcm, subs);
+    EXPECT_EQ(0, wait_for_interest(publisher, 0));
+
+    // a process that goes away says goodbye
+    lcm_subscribe(sub_lcm, "INTEREST_A", channel_order_handler, &received);
+    EXPECT_EQ(1, wait_for_interest(publisher, 1));
+    lcm_destroy(sub_lcm);
+    EXPECT_EQ(0, wait_for_interest(publisher, 0));
+
+    lcm_publisher_destroy(publisher);
+    lcm_destroy(pub_lcm);
+}
+
+TEST(LCM_C, Latch)
+{
+    const char *url = "udpm://239.255.76.67:7667?ttl=0&interest=7668&interest_period=100";
+    std::string pub_url = std::string(url) + "&latch=LATCH_.*";
+    lcm_t *pub_lcm = lcm_create(pub_url.c_str());
+    ASSERT_NE((void *) NULL, pub_lcm);
+    lcm_publisher_t *publisher = lcm_publisher_create(pub_lcm, "LATCH_A");
+    ASSERT_NE((void *) NULL, publisher);
+    EXPECT_EQ(0, wait_for_interest(publisher, 0));
+
+    // published once, before anybody subscribes
+    int value = 1;
+    EXPECT_EQ(0, lcm_publisher_publish(publisher, &value, sizeof(value)));
+    EXPECT_EQ(0, lcm_publish(pub_lcm, "LATCH_B", &value, sizeof(value)));
+    value = 2;
+    EXPECT_EQ(0, lcm_publisher_publish(publisher, &value, sizeof(value)));
+
+    lcm_t *sub_lcm = lcm_create(url);
+    ASSERT_NE((void *) NULL, sub_lcm);
+    std::vector<int> values;
+    lcm_subscribe(sub_lcm, "LATCH_A", last_int_handler, &values);
+    while (values.empty() && lcm_handle_timeout(sub_lcm, 1000) > 0) {
+    }
+    ASSERT_EQ(1u, values.size());
+    EXPECT_EQ(2, values[0]);
+
+    // another subscription of the same process gets them too
+    std::vector<std::string> received;
+    lcm_subscribe(sub_lcm, "LATCH_.*", channel_order_handler, &received);
+    while (received.size() < 2 && lcm_handle_timeout(sub_lcm, 1000) > 0) {
+    }
+    std::sort(received.begin(), received.end());
+    ASSERT_EQ(2u, received.size());
+    EXPECT_EQ("LATCH_A", received[0]);
+    EXPECT_EQ("LATCH_B", received[1]);
+
+    lcm_destroy(sub_lcm);
+    lcm_publisher_destroy(publisher);
+    lcm_destroy(pub_lcm);
+}
+
+static double monotonic_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+TEST(LCM_C, SendRate)
+{
+    lcm_t *lcm =
+        lcm_create("udpm://239.255.76.67:7667?ttl=0&send_rate=1000000&send_burst=20000");
+    ASSERT_NE((void *) NULL, lcm);
+
+    // the burst is sent right away, and the rest at send_rate
+    const int num_msgs = 300;
+    uint8_t data[1000] = { 0 };
+    double start = monotonic_seconds();
+    for (int i = 0; i < num_msgs; i++)
+        EXPECT_EQ(0, lcm_publish(lcm, "SEND_RATE", data, sizeof(data)));
+    double elapsed = monotonic_seconds() - start;
+    EXPECT_GT(elapsed, (num_msgs * sizeof(data) - 20000) / 1e6 * 0.9);
+    EXPECT_LT(elapsed, num_msgs * sizeof(data) / 1e6 * 2);
+
+    lcm_destroy(lcm);
+}
 #endif
@@ -47,6 +47,77 @@ inline int c99_snprintf(char *outBuf, size_t size, const char *format, ...)
 
 #endif
 
+// Fills an lcmtest::bounded_t or lcmtest::unbounded_t, which have the same
+// members.  n is at most 3, so that the lengths fit into the bounds.
+template <class T>
+static void FillBoundedType(int n, T *msg)
+{
+    int i, j;
+    msg->num_values = 2 * n;
+    msg->values.resize(msg->num_values);
+    for (i = 0; i < msg->num_values; i++)
+        msg->values[i] = i - n;
+    msg->num_rows = n + 1;
+    msg->num_cols = n % 3;
+    msg->points.resize(msg->num_rows);
+    msg->grid.resize(msg->num_rows);
+    for (i = 0; i < msg->num_rows; i++) {
+        msg->points[i].resize(3);
+        for (j = 0; j < 3; j++)
+            msg->points[i][j] = i * 3 + j + n;
+        msg->grid[i].resize(msg->num_cols);
+        for (j = 0; j < msg->num_cols; j++)
+            msg->grid[i][j] = i * 10 + j + n;
+    }
+    msg->num_items = n;
+    msg->items.resize(msg->num_items);
+    for (i = 0; i < msg->num_items; i++)
+        FillLcmType(i, &msg->items[i]);
+    char name_buf[80];
+    snprintf(name_buf, 79, "%d", n);
+    msg->name = name_buf;
+}
+
+int CheckLcmType(const lcmtest::bounded_t *msg, int expected)
+{
+    int n = expected;
+    CHECK_FIELD(msg->num_values, 2 * n, "%d");
+    CHECK_FIELD((int) msg->values.size(), 2 * n, "%d");
+    int i, j;
+    for (i = 0; i < msg->num_values; i++)
+        CHECK_FIELD(msg->values[i], i - n, "%d");
+    CHECK_FIELD(msg->num_rows, n + 1, "%d");
+    CHECK_FIELD(msg->num_cols, n % 3, "%d");
+    for (i = 0; i < msg->num_rows; i++) {
+        for (j = 0; j < 3; j++)
+            CHECK_FIELD(msg->points[i][j], (float) (i * 3 + j + n), "%f");
+        for (j = 0; j < msg->num_cols; j++)
+            CHECK_FIELD(msg->grid[i][j], i * 10 + j + n, "%d");
+    }
+    CHECK_FIELD(msg->num_items, n, "%d");
+    for (i = 0; i < msg->num_items; i++) {
+        if (!CheckLcmType(&msg->items[i], i))
+            return 0;
+    }
+    char expected_name[80];
+    snprintf(expected_name, 79, "%d", n);
+    if (msg->name != expected_name) {
+        info("Expected msg->name to be %s, got %s instead", expected_name, msg->name.c_str());
+        return 0;
+    }
+    return 1;
+}
+
+void FillLcmType(int n, lcmtest::bounded_t *msg)
+{
+    FillBoundedType(n, msg);
+}
+
+void FillLcmType(int n, lcmtest::unbounded_t *msg)
+{
+    FillBoundedType(n, msg);
+}
+
 int CheckLcmType(const lcmtest::multidim_array_t *msg, int expected)
 {
     CHECK_FIELD(msg->size_a, expected, "%d");
@@ -3,12 +3,19 @@
 
 #include <lcm/lcm-cpp.hpp>
 
+#include "lcmtest/bounded_t.hpp"
 #include "lcmtest/multidim_array_t.hpp"
 #include "lcmtest/node_t.hpp"
 #include "lcmtest/primitives_list_t.hpp"
 #include "lcmtest/primitives_t.hpp"
+#include "lcmtest/unbounded_t.hpp"
 #include "lcmtest2/cross_package_t.hpp"
 
+// n is at most 3 for bounded_t, so that the lengths fit into its bounds
+int CheckLcmType(const lcmtest::bounded_t *msg, int expected);
+void FillLcmType(int n, lcmtest::bounded_t *msg);
+void FillLcmType(int n, lcmtest::unbounded_t *msg);
+
 int CheckLcmType(const lcmtest::multidim_array_t *msg, int expected);
 void FillLcmType(int num_children, lcmtest::multidim_array_t *result);
 void ClearLcmType(lcmtest::multidim_array_t *msg);
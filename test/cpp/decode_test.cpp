@@ -0,0 +1,222 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+
+#include <vector>
+#if __cplusplus >= 201103L
+#include <type_traits>
+#endif
+
+#include "common.hpp"
+
+// Encodes a filled message, and checks that it decodes, and that every
+// truncation of it is rejected.
+template <class T>
+static void CheckDecode(int n)
+{
+    T msg;
+    FillLcmType(n, &msg);
+    int len = msg.getEncodedSize();
+    std::vector<char> buf(len);
+    ASSERT_EQ(len, msg.encode(&buf[0], 0, len));
+
+    T decoded;
+    for (int i = 0; i < len; i++)
+        EXPECT_GT(0, decoded.decode(&buf[0], 0, i));
+    ASSERT_EQ(len, decoded.decode(&buf[0], 0, len));
+    EXPECT_TRUE(CheckLcmType(&decoded, n));
+}
+
+TEST(LCM_CPP, DecodeTruncated)
+{
+    for (int n = 0; n < 4; n++) {
+        CheckDecode<lcmtest::primitives_list_t>(n);
+        CheckDecode<lcmtest::multidim_array_t>(n);
+        CheckDecode<lcmtest::node_t>(n);
+    }
+}
+
+TEST(LCM_CPP, DecodeOversizedLengths)
+{
+    // The lengths of an array are checked against the size of the buffer
+    // before anything is allocated for it.
+    lcmtest::multidim_array_t msg;
+    FillLcmType(2, &msg);
+    int len = msg.getEncodedSize();
+    std::vector<char> buf(len);
+    ASSERT_EQ(len, msg.encode(&buf[0], 0, len));
+
+    // size_a, after the hash
+    for (int i = 0; i < 4; i++)
+        buf[8 + i] = i ? 0xff : 0x7f;
+    lcmtest::multidim_array_t decoded;
+    EXPECT_GT(0, decoded.decode(&buf[0], 0, len));
+    EXPECT_TRUE(decoded.data.empty());
+
+    // a string length of zero has no room for the terminator
+    lcmtest::primitives_t prim;
+    FillLcmType(1, &prim);
+    prim.name = "";
+    len = prim.getEncodedSize();
+    buf.resize(len);
+    ASSERT_EQ(len, prim.encode(&buf[0], 0, len));
+    for (int i = 0; i < 4; i++)
+        buf[len - 6 + i] = 0;
+    EXPECT_GT(0, prim.decode(&buf[0], 0, len));
+}
+
+// lcmtest::bounded_t is encoded the same as lcmtest::unbounded_t, which it
+// decodes as long as the lengths fit into its bounds.
+TEST(LCM_CPP, BoundedArrayRoundTrip)
+{
+    EXPECT_EQ(lcmtest::unbounded_t::getHash(), lcmtest::bounded_t::getHash());
+    for (int n = 0; n < 4; n++) {
+        lcmtest::bounded_t msg;
+        FillLcmType(n, &msg);
+        int len = msg.getEncodedSize();
+        std::vector<char> buf(len);
+        ASSERT_EQ(len, msg.encode(&buf[0], 0, len));
+
+        lcmtest::unbounded_t unbounded;
+        FillLcmType(n, &unbounded);
+        ASSERT_EQ(len, unbounded.getEncodedSize());
+        std::vector<char> unbounded_buf(len);
+        ASSERT_EQ(len, unbounded.encode(&unbounded_buf[0], 0, len));
+        EXPECT_EQ(buf, unbounded_buf);
+
+        lcmtest::bounded_t decoded;
+        ASSERT_EQ(len, decoded.decode(&buf[0], 0, len));
+        EXPECT_TRUE(CheckLcmType(&decoded, n));
+        ASSERT_EQ(len, unbounded.decode(&buf[0], 0, len));
+    }
+}
+
+TEST(LCM_CPP, BoundedArrayDecodeRejectsLengths)
+{
+    lcmtest::unbounded_t msg;
+    FillLcmType(1, &msg);
+    int len = msg.getEncodedSize();
+    std::vector<char> buf(len);
+    ASSERT_EQ(len, msg.encode(&buf[0], 0, len));
+
+    // num_values after the hash, which is followed by 2 values, and num_rows
+    const int offsets[] = {8, 8 + 4 + 2 * 2};
+    const int32_t lengths[] = {9, 100000, -1, INT32_MIN};
+    for (int i = 0; i < 2; i++) {
+        for (size_t j = 0; j < sizeof(lengths) / sizeof(lengths[0]); j++) {
+            std::vector<char> bad = buf;
+            for (int k = 0; k < 4; k++)
+                bad[offsets[i] + k] = (char) (lengths[j] >> (24 - 8 * k));
+            lcmtest::bounded_t decoded;
+            EXPECT_EQ(-1, decoded.decode(&bad[0], 0, len));
+        }
+    }
+
+    // a length past the bound is rejected even if the message holds that
+    // many elements
+    msg.num_values = 9;
+    msg.values.resize(9);
+    len = msg.getEncodedSize();
+    buf.resize(len);
+    ASSERT_EQ(len, msg.encode(&buf[0], 0, len));
+    lcmtest::bounded_t decoded;
+    EXPECT_EQ(-1, decoded.decode(&buf[0], 0, len));
+}
+
+TEST(LCM_CPP, BoundedArrayEncodeRejectsLengths)
+{
+    lcmtest::bounded_t msg;
+    FillLcmType(3, &msg);
+    // room for the longest message that the type holds
+    std::vector<char> buf(4096);
+    int len = (int) buf.size();
+    ASSERT_LT(0, msg.encode(&buf[0], 0, len));
+
+    msg.num_values = 9;
+    EXPECT_EQ(-1, msg.encode(&buf[0], 0, len));
+    msg.num_values = -1;
+    EXPECT_EQ(-1, msg.encode(&buf[0], 0, len));
+    msg.num_values = 6;
+
+    msg.num_cols = 3;
+    EXPECT_EQ(-1, msg.encode(&buf[0], 0, len));
+    msg.num_cols = 0;
+    msg.num_rows = 5;
+    EXPECT_EQ(-1, msg.encode(&buf[0], 0, len));
+    msg.num_rows = 4;
+
+    msg.num_items = 4;
+    EXPECT_EQ(-1, msg.encode(&buf[0], 0, len));
+    msg.num_items = 3;
+    EXPECT_LT(0, msg.encode(&buf[0], 0, len));
+}
+
+// std::vector::data() of C++11
+static const int16_t *RangesData(const lcmtest::primitives_t &item)
+{
+    return item.ranges.empty() ? NULL : &item.ranges[0];
+}
+
+TEST(LCM_CPP, ClearForDecode)
+{
+    // A message that is cleared and decoded into again keeps the storage of
+    // its arrays.
+    lcmtest::primitives_list_t msg;
+    FillLcmType(3, &msg);
+    int len = msg.getEncodedSize();
+    std::vector<char> buf(len);
+    ASSERT_EQ(len, msg.encode(&buf[0], 0, len));
+    const lcmtest::primitives_t *items = &msg.items[0];
+    std::vector<const int16_t *> ranges;
+    for (int i = 0; i < 3; i++)
+        ranges.push_back(RangesData(msg.items[i]));
+
+    // the elements are kept along with their own arrays
+    msg.clearForDecode();
+    EXPECT_EQ(0, msg.num_items);
+    ASSERT_EQ(3u, msg.items.size());
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(0, msg.items[i].num_ranges);
+        EXPECT_TRUE(msg.items[i].ranges.empty());
+    }
+    ASSERT_EQ(len, msg.decode(&buf[0], 0, len));
+    EXPECT_EQ(items, &msg.items[0]);
+    for (int i = 0; i < 3; i++)
+        EXPECT_EQ(ranges[i], RangesData(msg.items[i]));
+    EXPECT_TRUE(CheckLcmType(&msg, 3));
+
+    // and so are those of bounded arrays, which never allocate
+    lcmtest::bounded_t bounded;
+    FillLcmType(3, &bounded);
+    len = bounded.getEncodedSize();
+    buf.resize(len);
+    ASSERT_EQ(len, bounded.encode(&buf[0], 0, len));
+    for (int i = 0; i < 3; i++)
+        ranges[i] = RangesData(bounded.items[i]);
+    bounded.clearForDecode();
+    EXPECT_EQ(0, bounded.num_items);
+    EXPECT_EQ(0, bounded.num_values);
+    EXPECT_TRUE(bounded.values.empty());
+    EXPECT_TRUE(bounded.name.empty());
+    ASSERT_EQ(len, bounded.decode(&buf[0], 0, len));
+    for (int i = 0; i < 3; i++)
+        EXPECT_EQ(ranges[i], RangesData(bounded.items[i]));
+    EXPECT_TRUE(CheckLcmType(&bounded, 3));
+}
+
+TEST(LCM_CPP, Swap)
+{
+    lcmtest::multidim_array_t a, b;
+    FillLcmType(2, &a);
+    FillLcmType(3, &b);
+    swap(a, b);
+    EXPECT_TRUE(CheckLcmType(&a, 3));
+    EXPECT_TRUE(CheckLcmType(&b, 2));
+
+    lcmtest::node_t parent, empty;
+    FillLcmType(2, &parent);
+    parent.swap(empty);
+    EXPECT_TRUE(CheckLcmType(&empty, 2));
+#if __cplusplus >= 201103L
+    EXPECT_TRUE(std::is_nothrow_move_constructible<lcmtest::node_t>::value);
+#endif
+}
@@ -0,0 +1,155 @@
+// Times encoding and decoding of the lcmtest types with the generated C++ code.
+//
+// usage: test-cpp-encode_bench [--min-time SECONDS] [TYPE_FILTER]
+//
+// Each operation is repeated until it has run for at least --min-time
+// seconds (0.2 by default), and one line is printed per type, size and
+// operation. See test/README for the cases and the output format, which the
+// other languages' benchmarks share.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "common.hpp"
+#include "lcmtest/byte_array_t.hpp"
+
+// byte_array_t isn't used by the client/server tests, so it has no helpers in
+// common.cpp.
+static void FillLcmType(int num, lcmtest::byte_array_t *msg)
+{
+    msg->num_bytes = num;
+    msg->data.resize(num);
+    for (int i = 0; i < num; i++)
+        msg->data[i] = (uint8_t) i;
+}
+
+static int CheckLcmType(const lcmtest::byte_array_t *msg, int expected)
+{
+    if (msg->num_bytes != expected)
+        return 0;
+    for (int i = 0; i < expected; i++) {
+        if (msg->data[i] != (uint8_t) i)
+            return 0;
+    }
+    return 1;
+}
+
+enum { OP_ENCODED_SIZE, OP_ENCODE, OP_DECODE, NUM_OPS };
+
+static const char *op_names[] = {"encoded_size", "encode", "decode"};
+
+static double min_time = 0.2;
+static const char *filter = NULL;
+static bool failed = false;
+
+template <class T>
+static int RunOp(int op, const T &msg, T &decoded, std::vector<char> &buf)
+{
+    int len = (int) buf.size();
+    switch (op) {
+    case OP_ENCODED_SIZE:
+        return msg.getEncodedSize();
+    case OP_ENCODE:
+        return msg.encode(&buf[0], 0, len);
+    default:
+        return decoded.decode(&buf[0], 0, len);
+    }
+}
+
+// Runs op in batches of doubling size until min_time has passed, and returns
+// the time per run in nanoseconds.
+template <class T>
+static double TimeOp(const char *name, int op, const T &msg, std::vector<char> &buf,
+                     long *iterations)
+{
+    typedef std::chrono::steady_clock clock;
+
+    // decoded into the same message each time, so that its arrays are reused
+    T decoded;
+    // read through a volatile pointer so that the compiler can't hoist the
+    // work out of the loop
+    const T *volatile source = &msg;
+    long total = 0;
+    long batch = 1;
+    clock::time_point start = clock::now();
+    double elapsed;
+    for (;;) {
+        for (long i = 0; i < batch; i++) {
+            if (RunOp(op, *source, decoded, buf) < 0) {
+                fprintf(stderr, "%s %s failed\n", name, op_names[op]);
+                exit(1);
+            }
+        }
+        total += batch;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+        if (elapsed >= min_time)
+            break;
+        batch *= 2;
+    }
+    *iterations = total;
+    return elapsed * 1e9 / total;
+}
+
+template <class T>
+static void Bench(const char *name, int s0, int s1, int s2)
+{
+    if (filter && !strstr(name, filter))
+        return;
+
+    const int sizes[] = {s0, s1, s2};
+    for (int s = 0; s < 3; s++) {
+        int n = sizes[s];
+        T msg;
+        FillLcmType(n, &msg);
+        int len = msg.getEncodedSize();
+        std::vector<char> buf(len);
+
+        T decoded;
+        if (msg.encode(&buf[0], 0, len) != len || decoded.decode(&buf[0], 0, len) != len ||
+            !CheckLcmType(&decoded, n)) {
+            fprintf(stderr, "%s %d did not round trip\n", name, n);
+            failed = true;
+            continue;
+        }
+
+        for (int op = 0; op < NUM_OPS; op++) {
+            long iterations;
+            double ns = TimeOp(name, op, msg, buf, &iterations);
+            printf("%-26s %8d %-13s %10d %10ld %12.1f %12.1f\n", name, n, op_names[op], len,
+                   iterations, ns, len / ns * 1e9 / (1 << 20));
+        }
+    }
+}
+
+static void Usage(const char *progname)
+{
+    fprintf(stderr, "usage: %s [--min-time SECONDS] [TYPE_FILTER]\n", progname);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--min-time") && i + 1 < argc) {
+            min_time = strtod(argv[++i], NULL);
+        } else if (argv[i][0] == '-' || filter) {
+            Usage(argv[0]);
+        } else {
+            filter = argv[i];
+        }
+    }
+
+    printf("%-26s %8s %-13s %10s %10s %12s %12s\n", "type", "size", "op", "bytes", "iterations",
+           "ns/op", "MB/s");
+
+    Bench<lcmtest::byte_array_t>("lcmtest.byte_array_t", 64, 4096, 65536);
+    Bench<lcmtest::primitives_t>("lcmtest.primitives_t", 10, 100, 1000);
+    Bench<lcmtest::primitives_list_t>("lcmtest.primitives_list_t", 10, 100, 1000);
+    Bench<lcmtest::multidim_array_t>("lcmtest.multidim_array_t", 2, 8, 32);
+    Bench<lcmtest::node_t>("lcmtest.node_t", 3, 5, 7);
+    return failed ? 1 : 0;
+}
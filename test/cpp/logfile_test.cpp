@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <lcm/lcm-cpp.hpp>
+
+TEST(LCM_CPP, LogFileIterator)
+{
+    // Write some events to a log, then iterate over them in the mapped log
+    // file.
+    char fname[] = "XXXXXX";
+    int fd = mkstemp(fname);
+
+    std::vector<char> data(100);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = i * 3;
+    {
+        lcm::LogFile wlog(fname, "w");
+        ASSERT_TRUE(wlog.good());
+        lcm::LogEvent event;
+        for (int i = 0; i < 10; i++) {
+            event.timestamp = i * 10;
+            event.channel = i % 2 ? "ODD" : "EVEN";
+            event.datalen = i * 10;
+            event.data = &data[0];
+            EXPECT_EQ(0, wlog.writeEvent(&event));
+        }
+    }
+
+    lcm::LogFile rlog(fname, "r");
+    ASSERT_TRUE(rlog.good());
+    int count = 0;
+    for (lcm::LogFile::iterator it = rlog.begin(); it != rlog.end(); ++it, ++count) {
+        EXPECT_EQ(count, it->eventnum);
+        EXPECT_EQ(count * 10, it->timestamp);
+        EXPECT_EQ(std::string(count % 2 ? "ODD" : "EVEN"),
+                  std::string(it->channel, it->channellen));
+        ASSERT_EQ(count * 10, it->datalen);
+        EXPECT_EQ(0, memcmp(&data[0], it->data, it->datalen));
+    }
+    EXPECT_EQ(10, count);
+
+    // Iterating again starts over, and doesn't affect reading the events
+    // the other way.
+    lcm::LogFile::iterator it = rlog.begin();
+    EXPECT_EQ(0, (*it).eventnum);
+    EXPECT_EQ(0, (it++)->eventnum);
+    EXPECT_EQ(1, it->eventnum);
+    const lcm::LogEvent *event = rlog.readNextEvent();
+    ASSERT_TRUE(event != NULL);
+    EXPECT_EQ(0, event->eventnum);
+
+    close(fd);
+    unlink(fname);
+}
+
+TEST(LCM_CPP, LogFileRandomAccess)
+{
+    // Find events by number, and by their position on a channel.
+    char fname[] = "XXXXXX";
+    int fd = mkstemp(fname);
+
+    std::vector<char> data(10);
+    {
+        lcm::LogFile wlog(fname, "w");
+        ASSERT_TRUE(wlog.good());
+        lcm::LogEvent event;
+        for (int i = 0; i < 30; i++) {
+            event.timestamp = i * 10;
+            event.channel = i % 3 ? "OTHER" : "THIRD";
+            event.datalen = data.size();
+            event.data = &data[0];
+            EXPECT_EQ(0, wlog.writeEvent(&event));
+        }
+    }
+
+    lcm::LogFile rlog(fname, "r");
+    ASSERT_TRUE(rlog.good());
+    ASSERT_EQ(0, rlog.seekToEventnum(17));
+    const lcm::LogEvent *event = rlog.readNextEvent();
+    ASSERT_TRUE(event != NULL);
+    EXPECT_EQ(17, event->eventnum);
+    EXPECT_EQ(-1, rlog.seekToEventnum(30));
+
+    event = rlog.readChannelEvent("THIRD", 5);
+    ASSERT_TRUE(event != NULL);
+    EXPECT_EQ("THIRD", event->channel);
+    EXPECT_EQ(15, event->eventnum);
+    event = rlog.readNextEvent();
+    ASSERT_TRUE(event != NULL);
+    EXPECT_EQ(16, event->eventnum);
+    event = rlog.readChannelEvent("OTHER", 0);
+    ASSERT_TRUE(event != NULL);
+    EXPECT_EQ(1, event->eventnum);
+    event = rlog.readChannelEvent("THIRD", 9);
+    ASSERT_TRUE(event != NULL);
+    EXPECT_EQ(27, event->eventnum);
+    EXPECT_TRUE(rlog.readChannelEvent("THIRD", 10) == NULL);
+
+    close(fd);
+    unlink(fname);
+}
@@ -1,9 +1,14 @@
 #include <gtest/gtest.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#include <thread>
 
 #include <lcm/lcm-cpp.hpp>
 
+#include "lcmtest/byte_array_t.hpp"
+
 TEST(LCM_CPP, MemqConstructDestroy)
 {
     lcm::LCM lcm("memq://");
@@ -45,6 +50,284 @@ TEST(LCM_CPP, MemqSimple)
     }
 }
 
+// A message type with the encoding methods that LCM::publish() calls, which
+// encodes to its bytes
+struct MemqBytesMessage {
+    std::vector<uint8_t> bytes;
+
+    int getEncodedSize() const { return bytes.size(); }
+
+    int encode(void *buf, int offset, int maxlen) const
+    {
+        if (maxlen - offset < (int) bytes.size())
+            return -1;
+        memcpy((uint8_t *) buf + offset, &bytes[0], bytes.size());
+        return bytes.size();
+    }
+};
+
+TEST(LCM_CPP, MemqPublishMessage)
+{
+    lcm::LCM lcm("memq://");
+    std::vector<uint8_t> received_buf;
+    lcm.subscribeFunction("channel", MemqSimpleHandler, &received_buf);
+
+    MemqBytesMessage msg;
+    for (int size = 1; size <= 1000; size *= 10) {
+        msg.bytes.assign(size, size % 255);
+        EXPECT_EQ(0, lcm.publish("channel", &msg));
+        lcm.handle();
+        EXPECT_EQ(msg.bytes, received_buf);
+
+        EXPECT_EQ(0, lcm.publish(std::string("channel"), &msg));
+        lcm.handle();
+        EXPECT_EQ(msg.bytes, received_buf);
+    }
+
+    // a buffer provided by the caller must be large enough for the message
+    std::vector<uint8_t> buf(100);
+    msg.bytes.assign(50, 3);
+    EXPECT_EQ(0, lcm.publish("channel", &msg, &buf[0], buf.size()));
+    lcm.handle();
+    EXPECT_EQ(msg.bytes, received_buf);
+    msg.bytes.assign(101, 4);
+    EXPECT_EQ(-1, lcm.publish("channel", &msg, &buf[0], buf.size()));
+
+#if LCM_CXX_17_ENABLED
+    std::string_view channel("channel");
+    EXPECT_EQ(0, lcm.publish(channel, &msg));
+    lcm.handle();
+    EXPECT_EQ(msg.bytes, received_buf);
+#endif
+}
+
+TEST(LCM_CPP, MemqPublisher)
+{
+    lcm::LCM lcm("memq://");
+    std::vector<uint8_t> received_buf;
+    lcm.subscribeFunction("channel", MemqSimpleHandler, &received_buf);
+
+    lcm::LCM::Publisher<MemqBytesMessage> publisher(&lcm, "channel");
+    ASSERT_TRUE(publisher.good());
+    MemqBytesMessage msg;
+    for (int size = 1000; size >= 1; size /= 10) {
+        msg.bytes.assign(size, size % 255);
+        EXPECT_EQ(0, publisher.publish(&msg));
+        lcm.handle();
+        EXPECT_EQ(msg.bytes, received_buf);
+    }
+
+    std::vector<uint8_t> buf(20, 5);
+    EXPECT_EQ(0, publisher.publish(&buf[0], buf.size()));
+    lcm.handle();
+    EXPECT_EQ(buf, received_buf);
+}
+
+TEST(LCM_CPP, MemqPublishBatch)
+{
+    lcm::LCM lcm("memq://");
+    std::vector<uint8_t> received_a, received_b;
+    lcm.subscribeFunction("a", MemqSimpleHandler, &received_a);
+    lcm.subscribeFunction("b", MemqSimpleHandler, &received_b);
+
+    lcm::LCM::Batch batch;
+    MemqBytesMessage msg;
+    std::vector<uint8_t> buf(20, 5);
+    for (int size = 1; size <= 1000; size *= 10) {
+        batch.clear();
+        msg.bytes.assign(size, size % 255);
+        EXPECT_EQ(0, batch.add("a", &msg));
+        batch.add("b", &buf[0], buf.size());
+        EXPECT_EQ(2, batch.size());
+        EXPECT_EQ(0, lcm.publishBatch(batch));
+        EXPECT_EQ(0, lcm.handle());
+        EXPECT_EQ(0, lcm.handle());
+        EXPECT_EQ(msg.bytes, received_a);
+        EXPECT_EQ(buf, received_b);
+    }
+}
+
+TEST(LCM_CPP, EncodeToVector)
+{
+    lcmtest::byte_array_t msg;
+    std::vector<uint8_t> buf;
+    for (int size = 0; size <= 1000; size = size * 10 + 1) {
+        msg.num_bytes = size;
+        msg.data.assign(size, size % 255);
+        ASSERT_EQ(msg.getEncodedSize(), lcm::encodeToVector(msg, buf));
+        ASSERT_EQ(buf.size(), static_cast<size_t>(msg.getEncodedSize()));
+        std::vector<uint8_t> expected(buf.size());
+        msg.encode(&expected[0], 0, expected.size());
+        EXPECT_EQ(expected, buf);
+    }
+
+    // a smaller message is encoded into the same memory
+    const uint8_t *data = &buf[0];
+    msg.num_bytes = 10;
+    msg.data.assign(10, 1);
+    EXPECT_EQ(msg.getEncodedSize(), lcm::encodeToVector(msg, buf));
+    EXPECT_EQ(data, &buf[0]);
+}
+
+TEST(LCM_CPP, MemqMessageReuse)
+{
+    // With message reuse, every message is decoded into the same object,
+    // which keeps its capacity, and doesn't keep anything of the previous
+    // message.
+    lcm::LCM lcm("memq://");
+    std::vector<const lcmtest::byte_array_t *> received_msgs;
+    std::vector<std::vector<uint8_t> > received_data;
+    size_t last_capacity = 0;
+    lcm::Subscription *subs = lcm.subscribe<lcmtest::byte_array_t>(
+        "channel", [&](const lcm::ReceiveBuffer *, const std::string &,
+                       const lcmtest::byte_array_t *msg) {
+            received_msgs.push_back(msg);
+            received_data.push_back(msg->data);
+            last_capacity = msg->data.capacity();
+        });
+    subs->setMessageReuse(true);
+
+    const int sizes[] = {100, 0, 50};
+    lcmtest::byte_array_t msg;
+    for (int i = 0; i < 3; i++) {
+        msg.num_bytes = sizes[i];
+        msg.data.assign(sizes[i], i + 1);
+        lcm.publish("channel", &msg);
+        EXPECT_EQ(0, lcm.handle());
+        ASSERT_EQ(i + 1, (int) received_msgs.size());
+        EXPECT_EQ(msg.data, received_data[i]);
+        EXPECT_EQ(received_msgs[0], received_msgs[i]);
+        EXPECT_GE(last_capacity, 100u);
+    }
+}
+
+TEST(LCM_CPP, MemqMessageView)
+{
+    // A view reads the members from the received buffer.
+    lcm::LCM lcm("memq://");
+    std::vector<uint8_t> received_buf;
+    lcm.subscribeFunction("channel", MemqSimpleHandler, &received_buf);
+
+    lcmtest::byte_array_t msg;
+    msg.num_bytes = 200;
+    for (int i = 0; i < msg.num_bytes; i++)
+        msg.data.push_back(i * 3);
+    lcm.publish("channel", &msg);
+    EXPECT_EQ(0, lcm.handle());
+
+    lcmtest::byte_array_t::View view;
+    int size = (int) received_buf.size();
+    ASSERT_EQ(size, view.decode(&received_buf[0], 0, size));
+    EXPECT_EQ(msg.num_bytes, view.num_bytes());
+    lcm::ArrayView<uint8_t> data = view.data();
+    ASSERT_EQ(msg.num_bytes, data.size());
+    EXPECT_EQ(0, memcmp(&msg.data[0], data.data(), msg.num_bytes));
+    EXPECT_EQ(msg.data[199], data[199]);
+
+    // the whole message is checked up front
+    EXPECT_GT(0, lcmtest::byte_array_t::View().decode(&received_buf[0], 0, size - 1));
+    received_buf[0] ^= 1;
+    EXPECT_GT(0, lcmtest::byte_array_t::View().decode(&received_buf[0], 0, size));
+}
+
+void MemqCharChannelHandler(const lcm::ReceiveBuffer *, const char *channel,
+                            const lcmtest::byte_array_t *, std::string *received_channel)
+{
+    *received_channel = channel;
+}
+
+#if LCM_CXX_17_ENABLED
+void MemqStringViewChannelHandler(const lcm::ReceiveBuffer *, std::string_view channel,
+                                  std::string *received_channel)
+{
+    *received_channel = channel;
+}
+#endif
+
+TEST(LCM_CPP, MemqChannelParameterTypes)
+{
+    // Handlers can take the channel name without it being copied into a
+    // std::string for them.
+    lcm::LCM lcm("memq://");
+    std::string char_channel;
+    lcm.subscribeFunction("CHAR_CHANNEL", MemqCharChannelHandler, &char_channel);
+#if LCM_CXX_17_ENABLED
+    std::string view_channel;
+    lcm.subscribeFunction("VIEW_.*", MemqStringViewChannelHandler, &view_channel);
+#endif
+
+    lcmtest::byte_array_t msg;
+    msg.num_bytes = 0;
+    lcm.publish("CHAR_CHANNEL", &msg);
+    EXPECT_EQ(0, lcm.handle());
+    EXPECT_EQ("CHAR_CHANNEL", char_channel);
+#if LCM_CXX_17_ENABLED
+    lcm.publish("VIEW_CHANNEL", &msg);
+    EXPECT_EQ(0, lcm.handle());
+    EXPECT_EQ("VIEW_CHANNEL", view_channel);
+#endif
+}
+
+#if LCM_CXX_COROUTINES_ENABLED
+// A coroutine that starts right away and is not awaited
+struct MemqTask {
+    struct promise_type {
+        MemqTask get_return_object() { return MemqTask(); }
+        std::suspend_never initial_suspend() { return std::suspend_never(); }
+        std::suspend_never final_suspend() noexcept { return std::suspend_never(); }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+MemqTask MemqAwaitMessages(lcm::LCM *lcm, std::vector<int> *received_sizes, bool *done)
+{
+    lcm::MessageStream<lcmtest::byte_array_t> stream(lcm, "STREAM");
+    for (int i = 0; i < 3; i++) {
+        lcmtest::byte_array_t msg = co_await stream.next();
+        received_sizes->push_back(msg.num_bytes);
+    }
+    lcmtest::byte_array_t msg = co_await lcm->next<lcmtest::byte_array_t>("NEXT");
+    received_sizes->push_back(msg.num_bytes);
+    *done = true;
+}
+
+TEST(LCM_CPP, MemqCoroutine)
+{
+    // The coroutine gets the messages that are already queued without
+    // suspending, and is resumed by handle() when it has to wait.
+    lcm::LCM lcm("memq://");
+    std::vector<int> received_sizes;
+    bool done = false;
+    MemqAwaitMessages(&lcm, &received_sizes, &done);
+
+    lcmtest::byte_array_t msg;
+    for (int i = 1; i <= 3; i++) {
+        msg.num_bytes = i;
+        msg.data.assign(i, 0);
+        lcm.publish("STREAM", &msg);
+    }
+    for (int i = 1; i <= 3; i++) {
+        EXPECT_EQ(0, lcm.handle());
+        ASSERT_EQ(i, (int) received_sizes.size());
+        EXPECT_EQ(i, received_sizes[i - 1]);
+    }
+
+    // a message of the stream that isn't awaited is queued until the
+    // coroutine finishes
+    msg.num_bytes = 0;
+    msg.data.clear();
+    lcm.publish("STREAM", &msg);
+    lcm.publish("NEXT", &msg);
+    EXPECT_EQ(0, lcm.handle());
+    EXPECT_FALSE(done);
+    EXPECT_EQ(0, lcm.handle());
+    ASSERT_TRUE(done);
+    ASSERT_EQ(4, (int) received_sizes.size());
+    EXPECT_EQ(0, received_sizes[3]);
+}
+#endif
+
 void MemqBufferedHandler(const lcm::ReceiveBuffer *rbuf, const std::string &,
                          std::vector<std::vector<uint8_t> > *received_buffers)
 {
@@ -53,6 +336,26 @@ void MemqBufferedHandler(const lcm::ReceiveBuffer *rbuf, const std::string &,
     received_buffers->push_back(buf);
 }
 
+TEST(LCM_CPP, MemqPublishAsync)
+{
+    // without a send queue, messages are published right away
+    lcm::LCM lcm("memq://");
+    std::vector<uint8_t> buf(100, 7);
+    std::vector<uint8_t> received_buf;
+
+    lcm.subscribeFunction("channel", MemqSimpleHandler, &received_buf);
+
+    EXPECT_EQ(0, lcm.publishAsync("channel", &buf[0], buf.size()));
+    lcm.handle();
+    EXPECT_EQ(buf, received_buf);
+
+    buf.assign(200, 9);
+    std::vector<uint8_t> expected = buf;
+    EXPECT_EQ(0, lcm.publishAsync("channel", std::move(buf)));
+    lcm.handle();
+    EXPECT_EQ(expected, received_buf);
+}
+
 TEST(LCM_CPP, MemqBuffered)
 {
     // Publish many messages so that they get buffered up, then read them all.
@@ -107,3 +410,114 @@ TEST(LCM_CPP, MemqTimeout)
     EXPECT_LT(0, lcm.handleTimeout(10000));
     EXPECT_TRUE(msg_handled);
 }
+
+void MemqCountHandler(const lcm::ReceiveBuffer *, const std::string &, int *num_handled)
+{
+    (*num_handled)++;
+}
+
+TEST(LCM_CPP, MemqHandleBatch)
+{
+    // Test various usages of LCM::handleBatch() using the memq provider
+    lcm::LCM lcm("memq://");
+
+    // No messages available.  Call should timeout immediately.
+    EXPECT_EQ(0, lcm.handleBatch(10, 0));
+
+    int num_handled = 0;
+    lcm.subscribeFunction("channel", MemqCountHandler, &num_handled);
+    for (int i = 0; i < 15; i++) {
+        lcm.publish("channel", "", 0);
+    }
+    EXPECT_EQ(10, lcm.handleBatch(10, 10000));
+    EXPECT_EQ(5, lcm.handleBatch(10, 10000));
+    EXPECT_EQ(15, num_handled);
+}
+
+void MemqExecutorHandler(const lcm::ReceiveBuffer *rbuf, const std::string &,
+                         std::vector<int> *received)
+{
+    int value;
+    memcpy(&value, rbuf->data, sizeof(value));
+    received->push_back(value);
+}
+
+TEST(LCM_CPP, MemqExecutor)
+{
+    // Handlers with an executor run on the dispatcher, and in order
+    lcm::Dispatcher dispatcher(2);
+    ASSERT_TRUE(dispatcher.good());
+    lcm::LCM lcm("memq://");
+
+    std::vector<int> received;
+    lcm::Subscription *subs = lcm.subscribeFunction("channel", MemqExecutorHandler, &received);
+    EXPECT_EQ(0, subs->setExecutor(&dispatcher));
+    for (int i = 0; i < 10; i++) {
+        lcm.publish("channel", &i, sizeof(i));
+        EXPECT_EQ(0, lcm.handle());
+    }
+
+    for (int i = 0; i < 1000 && subs->getQueueSize() > 0; i++) {
+        struct timespec sleeptime = { 0, 1000000 };
+        nanosleep(&sleeptime, NULL);
+    }
+    EXPECT_EQ(0, subs->getQueueSize());
+    ASSERT_EQ(10u, received.size());
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(i, received[i]);
+    }
+}
+
+struct MemqUnsubscribeState {
+    lcm::LCM *lcm;
+    lcm::Subscription *subs;
+};
+
+void MemqUnsubscribeHandler(const lcm::ReceiveBuffer *, const std::string &,
+                            MemqUnsubscribeState *state)
+{
+    state->lcm->unsubscribe(state->subs);
+}
+
+TEST(LCM_CPP, MemqDecodeAhead)
+{
+    // Messages decoded on the dispatcher are handled in order, by the thread
+    // and the call that received them
+    lcm::Dispatcher dispatcher(2);
+    ASSERT_TRUE(dispatcher.good());
+    lcm::LCM lcm("memq://");
+
+    std::vector<int> received;
+    std::thread::id handler_thread;
+    lcm::Subscription *subs = lcm.subscribe<lcmtest::byte_array_t>(
+        "channel", [&](const lcm::ReceiveBuffer *rbuf, const std::string &channel,
+                       const lcmtest::byte_array_t *msg) {
+            EXPECT_EQ("channel", channel);
+            EXPECT_EQ(msg->getEncodedSize(), (int) rbuf->data_size);
+            received.push_back(msg->num_bytes);
+            handler_thread = std::this_thread::get_id();
+        });
+    subs->setDecodeAhead(&dispatcher);
+
+    lcmtest::byte_array_t msg;
+    for (int i = 0; i < 10; i++) {
+        msg.num_bytes = i;
+        msg.data.assign(i, i);
+        lcm.publish("channel", &msg);
+    }
+    EXPECT_EQ(1, lcm.handleTimeout(0));
+    ASSERT_EQ(1u, received.size());
+    EXPECT_EQ(9, lcm.tryHandle(100));
+    ASSERT_EQ(10u, received.size());
+    for (int i = 0; i < 10; i++)
+        EXPECT_EQ(i, received[i]);
+    EXPECT_EQ(std::this_thread::get_id(), handler_thread);
+
+    // a message that is being decoded is dropped with its subscription
+    MemqUnsubscribeState state = {&lcm, subs};
+    lcm.subscribeFunction("unsubscribe", MemqUnsubscribeHandler, &state);
+    lcm.publish("channel", &msg);
+    lcm.publish("unsubscribe", "", 0);
+    EXPECT_EQ(2, lcm.tryHandle(100));
+    EXPECT_EQ(10u, received.size());
+}
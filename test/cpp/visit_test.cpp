@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+
+// Records the member names, and sums the members that are numbers or arrays
+// of numbers.
+struct SumVisitor {
+    std::vector<std::string> names;
+    double sum;
+
+    SumVisitor() : sum(0) {}
+
+    template <class T>
+    void operator()(const char *name, const T &value)
+    {
+        names.push_back(name);
+        sum += value;
+    }
+
+    template <class T, size_t N>
+    void operator()(const char *name, const T (&values)[N])
+    {
+        names.push_back(name);
+        for (size_t i = 0; i < N; i++)
+            sum += values[i];
+    }
+
+    template <class T>
+    void operator()(const char *name, const std::vector<T> &values)
+    {
+        names.push_back(name);
+        for (size_t i = 0; i < values.size(); i++)
+            sum += values[i];
+    }
+
+    void operator()(const char *name, const std::string &) { names.push_back(name); }
+};
+
+// Counts the nodes of a tree, visiting the children of each.
+struct NodeCounter {
+    int nodes;
+
+    NodeCounter() : nodes(0) {}
+
+    void operator()(const char *, int32_t) {}
+
+    void operator()(const char *, const std::vector<lcmtest::node_t> &children)
+    {
+        for (size_t i = 0; i < children.size(); i++) {
+            nodes++;
+            children[i].visit(*this);
+        }
+    }
+};
+
+// Resets every member to its default value.
+struct ClearVisitor {
+    template <class T>
+    void operator()(const char *, T &value)
+    {
+        value = T();
+    }
+
+    template <class T, size_t N>
+    void operator()(const char *, T (&values)[N])
+    {
+        for (size_t i = 0; i < N; i++)
+            values[i] = T();
+    }
+};
+
+TEST(LCM_CPP, VisitMembers)
+{
+    lcmtest::primitives_t msg;
+    FillLcmType(3, &msg);
+
+    SumVisitor visitor;
+    msg.visit(visitor);
+    const char *names[] = { "i8",       "i16",         "num_ranges", "i64",    "ranges",
+                            "position", "orientation", "name",       "enabled" };
+    ASSERT_EQ(9u, visitor.names.size());
+    for (int i = 0; i < 9; i++)
+        EXPECT_EQ(names[i], visitor.names[i]);
+
+    double sum = msg.i8 + msg.i16 + msg.num_ranges + msg.i64 + msg.enabled;
+    for (int i = 0; i < msg.num_ranges; i++)
+        sum += msg.ranges[i];
+    for (int i = 0; i < 3; i++)
+        sum += msg.position[i];
+    for (int i = 0; i < 4; i++)
+        sum += msg.orientation[i];
+    EXPECT_DOUBLE_EQ(sum, visitor.sum);
+
+    ClearVisitor clear;
+    msg.visit(clear);
+    EXPECT_EQ(0, msg.num_ranges);
+    EXPECT_TRUE(msg.ranges.empty());
+    EXPECT_EQ("", msg.name);
+
+    const lcmtest::primitives_t &const_msg = msg;
+    SumVisitor cleared;
+    const_msg.visit(cleared);
+    EXPECT_EQ(9u, cleared.names.size());
+    EXPECT_EQ(0, cleared.sum);
+}
+
+TEST(LCM_CPP, VisitNestedMessages)
+{
+    lcmtest::node_t msg;
+    FillLcmType(3, &msg);
+
+    NodeCounter counter;
+    msg.visit(counter);
+
+    // Each child of a node filled with n children has n - 1 of its own.
+    EXPECT_EQ(3 + 3 * (2 + 2 * 1), counter.nodes);
+}
@@ -0,0 +1,261 @@
+import java.io.IOException;
+
+import lcm.lcm.LCMDataOutputStream;
+import lcm.lcm.LCMEncodable;
+
+import lcmtest.byte_array_t;
+import lcmtest.multidim_array_t;
+import lcmtest.node_t;
+import lcmtest.primitives_list_t;
+import lcmtest.primitives_t;
+
+/**
+ * Times encoding and decoding of the lcmtest types with the generated Java
+ * code, over the same cases and in the same format as test-c-encode_bench.
+ * See test/README.
+ * <p>
+ * usage: java EncodeBench [--min-time SECONDS] [TYPE_FILTER]
+ */
+public class EncodeBench
+{
+    static abstract class Case
+    {
+        final String name;
+        final int sizes[];
+
+        Case(String name, int... sizes)
+        {
+            this.name = name;
+            this.sizes = sizes;
+        }
+
+        abstract LCMEncodable make(int n);
+
+        abstract LCMEncodable decode(byte data[]) throws IOException;
+    }
+
+    static primitives_t makePrimitives(int n)
+    {
+        primitives_t msg = new primitives_t();
+        msg.i8 = (byte) (n % 100);
+        msg.i16 = (short) (n * 10);
+        msg.i64 = n * 10000L;
+        for (int i = 0; i < 3; i++)
+            msg.position[i] = n;
+        for (int i = 0; i < 4; i++)
+            msg.orientation[i] = n;
+        msg.num_ranges = n;
+        msg.ranges = new short[n];
+        for (int i = 0; i < n; i++)
+            msg.ranges[i] = (short) i;
+        msg.name = String.valueOf(n);
+        msg.enabled = n % 2 == 1;
+        return msg;
+    }
+
+    static node_t makeNode(int n)
+    {
+        node_t msg = new node_t();
+        msg.num_children = n;
+        msg.children = new node_t[n];
+        for (int i = 0; i < n; i++)
+            msg.children[i] = makeNode(n - 1);
+        return msg;
+    }
+
+    static final Case cases[] = {
+        new Case("lcmtest.byte_array_t", 64, 4096, 65536) {
+            LCMEncodable make(int n)
+            {
+                byte_array_t msg = new byte_array_t();
+                msg.num_bytes = n;
+                msg.data = new byte[n];
+                for (int i = 0; i < n; i++)
+                    msg.data[i] = (byte) i;
+                return msg;
+            }
+
+            LCMEncodable decode(byte data[]) throws IOException
+            {
+                return new byte_array_t(data);
+            }
+        },
+        new Case("lcmtest.primitives_t", 10, 100, 1000) {
+            LCMEncodable make(int n)
+            {
+                return makePrimitives(n);
+            }
+
+            LCMEncodable decode(byte data[]) throws IOException
+            {
+                return new primitives_t(data);
+            }
+        },
+        new Case("lcmtest.primitives_list_t", 10, 100, 1000) {
+            LCMEncodable make(int n)
+            {
+                primitives_list_t msg = new primitives_list_t();
+                msg.num_items = n;
+                msg.items = new primitives_t[n];
+                for (int i = 0; i < n; i++) {
+                    primitives_t item = makePrimitives(i);
+                    item.i8 = (byte) -(i % 100);
+                    item.i16 = (short) (-i * 10);
+                    item.i64 = -i * 10000L;
+                    for (int j = 0; j < 3; j++)
+                        item.position[j] = -i;
+                    for (int j = 0; j < 4; j++)
+                        item.orientation[j] = -i;
+                    for (int j = 0; j < i; j++)
+                        item.ranges[j] = (short) -j;
+                    item.name = String.valueOf(-i);
+                    item.enabled = (i + 1) % 2 == 1;
+                    msg.items[i] = item;
+                }
+                return msg;
+            }
+
+            LCMEncodable decode(byte data[]) throws IOException
+            {
+                return new primitives_list_t(data);
+            }
+        },
+        new Case("lcmtest.multidim_array_t", 2, 8, 32) {
+            LCMEncodable make(int n)
+            {
+                multidim_array_t msg = new multidim_array_t();
+                msg.size_a = n;
+                msg.size_b = n;
+                msg.size_c = n;
+                msg.data = new int[n][n][n];
+                int v = 0;
+                for (int i = 0; i < n; i++)
+                    for (int j = 0; j < n; j++)
+                        for (int k = 0; k < n; k++)
+                            msg.data[i][j][k] = v++;
+                v = 0;
+                msg.strarray = new String[2][n];
+                for (int i = 0; i < 2; i++)
+                    for (int k = 0; k < n; k++)
+                        msg.strarray[i][k] = String.valueOf(v++);
+                return msg;
+            }
+
+            LCMEncodable decode(byte data[]) throws IOException
+            {
+                return new multidim_array_t(data);
+            }
+        },
+        new Case("lcmtest.node_t", 3, 5, 7) {
+            LCMEncodable make(int n)
+            {
+                return makeNode(n);
+            }
+
+            LCMEncodable decode(byte data[]) throws IOException
+            {
+                return new node_t(data);
+            }
+        },
+    };
+
+    interface Op
+    {
+        void run() throws IOException;
+    }
+
+    static long iterations;
+
+    /** Runs op in batches of doubling size until minTime seconds have
+     * passed, and returns the time per run in nanoseconds. The JIT is warmed
+     * up by a first pass that isn't counted.
+     **/
+    static double timeOp(Op op, double minTime) throws IOException
+    {
+        for (int pass = 0; pass < 2; pass++) {
+            long total = 0;
+            long batch = 1;
+            long start = System.nanoTime();
+            while (true) {
+                for (long i = 0; i < batch; i++)
+                    op.run();
+                total += batch;
+                long elapsed = System.nanoTime() - start;
+                if (elapsed >= minTime * 1e9) {
+                    if (pass == 1) {
+                        iterations = total;
+                        return (double) elapsed / total;
+                    }
+                    break;
+                }
+                batch *= 2;
+            }
+        }
+        throw new IllegalStateException();
+    }
+
+    static final String ROW = "%-26s %8s %-13s %10s %10s %12s %12s\n";
+
+    public static void main(String args[]) throws IOException
+    {
+        double minTime = 0.2;
+        String filter = null;
+        for (int i = 0; i < args.length; i++) {
+            if (args[i].equals("--min-time") && i + 1 < args.length) {
+                minTime = Double.parseDouble(args[++i]);
+            } else if (args[i].startsWith("-") || filter != null) {
+                System.err.println("usage: java EncodeBench [--min-time SECONDS] [TYPE_FILTER]");
+                System.exit(1);
+            } else {
+                filter = args[i];
+            }
+        }
+
+        System.out.printf(ROW, "type", "size", "op", "bytes", "iterations", "ns/op", "MB/s");
+
+        boolean failed = false;
+        for (final Case c : cases) {
+            if (filter != null && !c.name.contains(filter))
+                continue;
+
+            for (int n : c.sizes) {
+                final LCMEncodable msg = c.make(n);
+                final LCMDataOutputStream outs = new LCMDataOutputStream();
+                msg.encode(outs);
+                final byte data[] = outs.toByteArray();
+
+                LCMDataOutputStream check = new LCMDataOutputStream();
+                c.decode(data).encode(check);
+                if (!java.util.Arrays.equals(check.toByteArray(), data)) {
+                    System.err.printf("%s %d did not round trip\n", c.name, n);
+                    failed = true;
+                    continue;
+                }
+
+                String names[] = {"encode", "decode"};
+                Op ops[] = {
+                    new Op() {
+                        public void run() throws IOException
+                        {
+                            outs.reset();
+                            msg.encode(outs);
+                        }
+                    },
+                    new Op() {
+                        public void run() throws IOException
+                        {
+                            c.decode(data);
+                        }
+                    },
+                };
+                for (int op = 0; op < ops.length; op++) {
+                    double ns = timeOp(ops[op], minTime);
+                    System.out.printf(ROW, c.name, n, names[op], data.length, iterations,
+                            String.format("%.1f", ns),
+                            String.format("%.1f", data.length / ns * 1e9 / (1 << 20)));
+                }
+            }
+        }
+        System.exit(failed ? 1 : 0);
+    }
+}
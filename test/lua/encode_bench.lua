@@ -0,0 +1,183 @@
+-- Times encoding and decoding of the lcmtest types with the generated Lua code,
+-- over the same cases and in the same format as test-c-encode_bench. See
+-- test/README.
+--
+-- usage: lua encode_bench.lua [--min-time SECONDS] [TYPE_FILTER]
+
+-- this line required to make `require` correctly search the working directory
+package.path = './?/init.lua;' .. package.path
+
+local lcmtest = require('lcmtest')
+
+local function make_byte_array(n)
+	local msg = lcmtest.byte_array_t:new()
+	msg.num_bytes = n
+	msg.data = {}
+	for i = 1, n do
+		msg.data[i] = (i - 1) % 256
+	end
+	return msg
+end
+
+local function make_primitives(n)
+	local msg = lcmtest.primitives_t:new()
+	msg.i8 = n % 100
+	msg.i16 = n * 10
+	msg.i64 = n * 10000
+	for i = 1, 3 do
+		msg.position[i] = n
+	end
+	for i = 1, 4 do
+		msg.orientation[i] = n
+	end
+	msg.num_ranges = n
+	msg.ranges = {}
+	for i = 1, n do
+		msg.ranges[i] = i - 1
+	end
+	msg.name = tostring(n)
+	-- because Lua evaluates 0 as true
+	msg.enabled = ((n % 2) ~= 0)
+	return msg
+end
+
+local function make_primitives_list(n)
+	local msg = lcmtest.primitives_list_t:new()
+	msg.num_items = n
+	msg.items = {}
+	for ix = 1, n do
+		local i = ix - 1
+		local item = make_primitives(0)
+		item.i8 = -(i % 100)
+		item.i16 = -i * 10
+		item.i64 = -i * 10000
+		for j = 1, 3 do
+			item.position[j] = -i
+		end
+		for j = 1, 4 do
+			item.orientation[j] = -i
+		end
+		item.num_ranges = i
+		item.ranges = {}
+		for j = 1, i do
+			item.ranges[j] = -(j - 1)
+		end
+		-- +0 is to avoid issues with tostring(-0)
+		item.name = tostring(-i + 0)
+		item.enabled = (((i + 1) % 2) ~= 0)
+		msg.items[ix] = item
+	end
+	return msg
+end
+
+local function make_multidim_array(n)
+	local msg = lcmtest.multidim_array_t:new()
+	msg.size_a = n
+	msg.size_b = n
+	msg.size_c = n
+	local v = 0
+	for i = 1, n do
+		msg.data[i] = {}
+		for j = 1, n do
+			msg.data[i][j] = {}
+			for k = 1, n do
+				msg.data[i][j][k] = v
+				v = v + 1
+			end
+		end
+	end
+	v = 0
+	for i = 1, 2 do
+		msg.strarray[i] = {}
+		for k = 1, n do
+			msg.strarray[i][k] = tostring(v)
+			v = v + 1
+		end
+	end
+	return msg
+end
+
+local function make_node(n)
+	local msg = lcmtest.node_t:new()
+	msg.num_children = n
+	msg.children = {}
+	for i = 1, n do
+		msg.children[i] = make_node(n - 1)
+	end
+	return msg
+end
+
+local cases = {
+	{'byte_array_t', make_byte_array, {64, 4096, 65536}},
+	{'primitives_t', make_primitives, {10, 100, 1000}},
+	{'primitives_list_t', make_primitives_list, {10, 100, 1000}},
+	{'multidim_array_t', make_multidim_array, {2, 8, 32}},
+	{'node_t', make_node, {3, 5, 7}},
+}
+
+local row = '%-26s %8s %-13s %10s %10s %12s %12s'
+
+-- Runs op in batches of doubling size until min_time has passed, and returns
+-- the number of runs and the time per run in nanoseconds.
+local function time_op(op, min_time)
+	local total = 0
+	local batch = 1
+	local start = os.clock()
+	while true do
+		for _ = 1, batch do
+			op()
+		end
+		total = total + batch
+		local elapsed = os.clock() - start
+		if elapsed >= min_time then
+			return total, elapsed * 1e9 / total
+		end
+		batch = batch * 2
+	end
+end
+
+local min_time = 0.2
+local filter = nil
+local argi = 1
+while arg[argi] do
+	if arg[argi] == '--min-time' and arg[argi + 1] then
+		min_time = tonumber(arg[argi + 1])
+		argi = argi + 2
+	else
+		filter = arg[argi]
+		argi = argi + 1
+	end
+end
+
+print(string.format(row, 'type', 'size', 'op', 'bytes', 'iterations', 'ns/op', 'MB/s'))
+
+local failed = false
+for _, case in ipairs(cases) do
+	local name = 'lcmtest.' .. case[1]
+	local msgtype = lcmtest[case[1]]
+	if not filter or name:find(filter, 1, true) then
+		for _, n in ipairs(case[3]) do
+			local msg = case[2](n)
+			local data = msg:encode()
+			if msgtype.decode(data):encode() ~= data then
+				io.stderr:write(string.format('%s %d did not round trip\n', name, n))
+				failed = true
+			else
+				local ops = {
+					{'encode', function() return msg:encode() end},
+					{'decode', function() return msgtype.decode(data) end},
+				}
+				for _, op in ipairs(ops) do
+					local iterations, ns = time_op(op[2], min_time)
+					print(string.format(row, name, n, op[1], #data, iterations,
+						string.format('%.1f', ns),
+						string.format('%.1f', #data / ns * 1e9 / (1024 * 1024))))
+				end
+			end
+		end
+	end
+end
+
+if failed then
+	os.exit(1)
+end
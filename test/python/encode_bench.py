@@ -0,0 +1,75 @@
+#!/usr/bin/python
+"""Times encoding and decoding of the lcmtest types with the generated Python
+code, over the same cases and in the same format as test-c-encode_bench.  See
+test/README."""
+import argparse
+import sys
+import time
+
+import lcmtest
+
+from client import MultidimArrayTest, NodeTest, PrimitivesListTest, PrimitivesTest
+
+def make_byte_array(n):
+    msg = lcmtest.byte_array_t()
+    msg.num_bytes = n
+    msg.data = bytes(bytearray(i & 0xff for i in range(n)))
+    return msg
+
+CASES = [
+    (lcmtest.byte_array_t, make_byte_array, (64, 4096, 65536)),
+    (lcmtest.primitives_t, PrimitivesTest().make_message, (10, 100, 1000)),
+    (lcmtest.primitives_list_t, PrimitivesListTest().make_message, (10, 100, 1000)),
+    (lcmtest.multidim_array_t, MultidimArrayTest().make_message, (2, 8, 32)),
+    (lcmtest.node_t, NodeTest().make_message, (3, 5, 7)),
+]
+
+ROW = "%-26s %8s %-13s %10s %10s %12s %12s"
+
+def time_op(op, min_time):
+    """Runs op in batches of doubling size until min_time has passed, and
+    returns the number of runs and the time per run in nanoseconds."""
+    total = 0
+    batch = 1
+    start = time.perf_counter()
+    while True:
+        for _ in range(batch):
+            op()
+        total += batch
+        elapsed = time.perf_counter() - start
+        if elapsed >= min_time:
+            return total, elapsed * 1e9 / total
+        batch *= 2
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--min-time", type=float, default=0.2,
+            help="seconds to run each operation for")
+    parser.add_argument("filter", nargs="?", help="only run types whose name contains this")
+    args = parser.parse_args()
+
+    print(ROW % ("type", "size", "op", "bytes", "iterations", "ns/op", "MB/s"))
+
+    failed = False
+    for msgtype, make, sizes in CASES:
+        name = "lcmtest." + msgtype.__name__
+        if args.filter and args.filter not in name:
+            continue
+        for n in sizes:
+            msg = make(n)
+            data = msg.encode()
+            if msgtype.decode(data).encode() != data:
+                sys.stderr.write("%s %d did not round trip\n" % (name, n))
+                failed = True
+                continue
+
+            for opname, op in (("encode", msg.encode), ("decode", lambda: msgtype.decode(data))):
+                iterations, ns = time_op(op, args.min_time)
+                print(ROW % (name, n, opname, len(data), iterations, "%.1f" % ns,
+                             "%.1f" % (len(data) / ns * 1e9 / (1 << 20))))
+            sys.stdout.flush()
+
+    return 1 if failed else 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,6 +1,8 @@
 #!/usr/bin/python
 import os
 import random
+import shutil
+import tempfile
 import unittest
 
 import lcm
@@ -11,6 +13,67 @@ class TestLcmEventLog(unittest.TestCase):
         log = lcm.EventLog(os.path.join(mydir, 'example.lcmlog'))
         event = log.read_next_event()
 
+    def write_log(self, events):
+        tmpdir = tempfile.mkdtemp()
+        self.addCleanup(shutil.rmtree, tmpdir)
+        path = os.path.join(tmpdir, 'test.lcmlog')
+        log = lcm.EventLog(path, 'w')
+        for timestamp, channel, data in events:
+            log.write_event(timestamp, channel, data)
+        log.close()
+        return path
+
+    def test_mapped_eventlog(self):
+        events = [(10 + i, 'A' if i % 3 else 'B', bytes([i]) * i) for i in range(20)]
+        log = lcm.MappedEventLog(self.write_log(events))
+
+        read = [(timestamp, channel, data.tobytes())
+                for eventnum, timestamp, channel, data in log]
+        self.assertEqual(events, read)
+        self.assertEqual(['B', 'A'], log.channels)
+
+        # Each iteration starts at the start of the log file.
+        self.assertEqual(20, len(list(log)))
+
+        timestamps, channel_ids, offsets = log.scan()
+        self.assertEqual([timestamp for timestamp, _, _ in events], list(timestamps))
+        self.assertEqual([channel for _, channel, _ in events],
+                         [log.channels[i] for i in channel_ids])
+        eventnum, timestamp, channel, data = log.read_event(int(offsets[5]))
+        self.assertEqual(events[5], (timestamp, channel, data.tobytes()))
+
+        # The log file can't be closed while its data is in use.
+        with self.assertRaises(BufferError):
+            log.close()
+        del data
+        log.close()
+
+    def test_mapped_eventlog_channels(self):
+        events = [(10 + i, 'A' if i % 3 else 'B', bytes([i]) * i) for i in range(20)]
+        log = lcm.MappedEventLog(self.write_log(events), channels=['B'])
+
+        read = [(timestamp, channel, data.tobytes())
+                for eventnum, timestamp, channel, data in log]
+        self.assertEqual([event for event in events if event[1] == 'B'], read)
+        timestamps, channel_ids, offsets = log.scan()
+        self.assertEqual(7, len(timestamps))
+
+    def test_eventlog_random_access(self):
+        events = [(10 + i, 'A' if i % 3 else 'B', bytes([i])) for i in range(20)]
+        log = lcm.EventLog(self.write_log(events))
+
+        log.seek_to_eventnum(7)
+        self.assertEqual(7, log.read_next_event().eventnum)
+        with self.assertRaises(ValueError):
+            log.seek_to_eventnum(20)
+
+        event = log.read_channel_event('B', 4)
+        self.assertEqual(12, event.eventnum)
+        self.assertEqual('B', event.channel)
+        self.assertEqual(13, log.read_next_event().eventnum)
+        self.assertEqual(1, log.read_channel_event('A', 0).eventnum)
+        self.assertIsNone(log.read_channel_event('B', 7))
+
 def main():
     unittest.main()
 
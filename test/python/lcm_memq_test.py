@@ -34,6 +34,52 @@ class TestLcmMemq(unittest.TestCase):
         self.assertLess(0, lcm_obj.handle_timeout(10000))
         self.assertTrue(on_msg.msg_handled)
 
+    def test_handle_batch(self):
+        lcm_obj = lcm.LCM("memq://")
+
+        # Passing an invalid number of messages should raise an exception.
+        with self.assertRaises(ValueError):
+            lcm_obj.handle_batch(0, 0)
+
+        # No messages available.
+        self.assertEqual(0, lcm_obj.handle_batch(10, 0))
+
+        received = []
+        lcm_obj.subscribe("channel", lambda channel, data: received.append(data))
+        for i in range(5):
+            lcm_obj.publish("channel", str(i).encode())
+
+        # The messages are handled in batches of at most max_msgs.
+        self.assertEqual(3, lcm_obj.handle_batch(3, 10000))
+        self.assertEqual(2, lcm_obj.handle_batch(3))
+        self.assertEqual(0, lcm_obj.handle_batch(3, 0))
+        self.assertEqual([b"0", b"1", b"2", b"3", b"4"], received)
+
+    def test_memoryview(self):
+        lcm_obj = lcm.LCM("memq://")
+
+        def on_msg(channel, data):
+            self.assertIsInstance(data, memoryview)
+            self.assertTrue(data.readonly)
+            on_msg.channels.append(channel)
+            on_msg.copies.append(data.tobytes())
+            on_msg.views.append(data)
+        on_msg.channels = []
+        on_msg.copies = []
+        on_msg.views = []
+        lcm_obj.subscribe("channel", on_msg, memoryview=True)
+        lcm_obj.publish("channel", b"first")
+        lcm_obj.publish("channel", b"second")
+        self.assertLess(0, lcm_obj.handle_timeout(10000))
+        self.assertLess(0, lcm_obj.handle_timeout(10000))
+
+        self.assertEqual(["channel", "channel"], on_msg.channels)
+        self.assertEqual([b"first", b"second"], on_msg.copies)
+        # The views are released once the handler returns.
+        for view in on_msg.views:
+            with self.assertRaises(ValueError):
+                view.tobytes()
+
 def main():
     unittest.main()
 